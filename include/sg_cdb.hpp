@@ -0,0 +1,229 @@
+#ifndef SG_CDB_HPP
+#define SG_CDB_HPP
+
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Header only C++17 layer for C++ users of the pass-through interface in
+ * sg_pt.h . The cdb templates below are laid out at compile time for a
+ * given command and cdb size, so building a command at run time is only
+ * patching its LBA and transfer length fields (compare sg_build_rw_cdb()
+ * in sg_lib.h which decides the layout on each call). sg::pt_obj owns a
+ * struct sg_pt_base instance: it can be moved but not copied, so the
+ * object is destructed exactly once. Nothing here needs to be compiled
+ * into the library. */
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+#include "sg_pt.h"
+
+namespace sg {
+
+enum class rw_dir { read, write };
+
+/* Layout of the READ and WRITE cdbs of each size (SBC) */
+template <int N> struct rw_layout;
+
+template <> struct rw_layout<6> {
+    static constexpr uint8_t rd_op = 0x8, wr_op = 0xa;
+    static constexpr int lba_off = 1, lba_len = 3, num_off = 4, num_len = 1;
+    static constexpr uint64_t max_lba = 0x1fffff;
+    static constexpr uint32_t max_num = 256;    /* 0 in the cdb means 256 */
+    static constexpr bool has_flags = false;    /* no DPO or FUA bits */
+};
+
+template <> struct rw_layout<10> {
+    static constexpr uint8_t rd_op = 0x28, wr_op = 0x2a;
+    static constexpr int lba_off = 2, lba_len = 4, num_off = 7, num_len = 2;
+    static constexpr uint64_t max_lba = 0xffffffff;
+    static constexpr uint32_t max_num = 0xffff;
+    static constexpr bool has_flags = true;
+};
+
+template <> struct rw_layout<12> {
+    static constexpr uint8_t rd_op = 0xa8, wr_op = 0xaa;
+    static constexpr int lba_off = 2, lba_len = 4, num_off = 6, num_len = 4;
+    static constexpr uint64_t max_lba = 0xffffffff;
+    static constexpr uint32_t max_num = 0xffffffff;
+    static constexpr bool has_flags = true;
+};
+
+template <> struct rw_layout<16> {
+    static constexpr uint8_t rd_op = 0x88, wr_op = 0x8a;
+    static constexpr int lba_off = 2, lba_len = 8, num_off = 10, num_len = 4;
+    static constexpr uint64_t max_lba = UINT64_MAX;
+    static constexpr uint32_t max_num = 0xffffffff;
+    static constexpr bool has_flags = true;
+};
+
+/* A cdb of N bytes, zeroed unless initialized otherwise */
+template <int N>
+class cdb {
+public:
+    static constexpr int size = N;
+
+    constexpr cdb() noexcept : b_{} {}
+    constexpr explicit cdb(const std::array<uint8_t, N> & a) noexcept
+        : b_(a) {}
+
+    /* Writes the W least significant bytes of v, big endian, from byte
+     * offset Off: the only work left to do at run time. */
+    template <int Off, int W>
+    constexpr void put_be(uint64_t v) noexcept
+    {
+        static_assert((Off >= 0) && (W > 0) && (W <= 8) && (Off + W <= N),
+                      "field outside the cdb");
+        for (int k = W - 1; k >= 0; --k, v >>= 8)
+            b_[Off + k] = static_cast<uint8_t>(v);
+    }
+
+    constexpr uint8_t & operator[](int k) noexcept { return b_[k]; }
+    constexpr uint8_t operator[](int k) const noexcept { return b_[k]; }
+    const uint8_t * data() const noexcept { return b_.data(); }
+    uint8_t * data() noexcept { return b_.data(); }
+
+private:
+    std::array<uint8_t, N> b_;
+};
+
+/* READ(N) or WRITE(N). The opcode and (except for N == 6) the DPO and FUA
+ * bits are placed by the constructor, which can be evaluated at compile
+ * time; set() then only patches in the LBA and number of blocks. */
+template <rw_dir D, int N>
+class rw_cdb : public cdb<N> {
+    using L = rw_layout<N>;
+
+public:
+    constexpr explicit rw_cdb(bool fua = false, bool dpo = false) noexcept
+        : cdb<N>()
+    {
+        (*this)[0] = (rw_dir::write == D) ? L::wr_op : L::rd_op;
+        if constexpr (L::has_flags) {
+            if (dpo)
+                (*this)[1] |= 0x10;
+            if (fua)
+                (*this)[1] |= 0x8;
+        }
+    }
+
+    /* Returns false, leaving the cdb unchanged, if lba or num_blocks do
+     * not fit this cdb size (the last block must be addressable too, and
+     * READ(6) and WRITE(6) cannot ask for 0 blocks). */
+    constexpr bool set(uint64_t lba, uint32_t num_blocks) noexcept
+    {
+        if ((num_blocks > L::max_num) || (lba > L::max_lba) ||
+            (num_blocks && ((L::max_lba - lba) < (num_blocks - 1))))
+            return false;
+        if constexpr (6 == N) {
+            if (0 == num_blocks)        /* would mean 256 */
+                return false;
+            /* top 3 bits of byte 1 are not part of the LBA */
+            (*this)[1] = static_cast<uint8_t>((lba >> 16) & 0x1f);
+            (*this)[2] = static_cast<uint8_t>(lba >> 8);
+            (*this)[3] = static_cast<uint8_t>(lba);
+            (*this)[4] = static_cast<uint8_t>(num_blocks);  /* 256 -> 0 */
+        } else {
+            this->template put_be<L::lba_off, L::lba_len>(lba);
+            this->template put_be<L::num_off, L::num_len>(num_blocks);
+        }
+        return true;
+    }
+};
+
+using read6_cdb = rw_cdb<rw_dir::read, 6>;
+using read10_cdb = rw_cdb<rw_dir::read, 10>;
+using read12_cdb = rw_cdb<rw_dir::read, 12>;
+using read16_cdb = rw_cdb<rw_dir::read, 16>;
+using write6_cdb = rw_cdb<rw_dir::write, 6>;
+using write10_cdb = rw_cdb<rw_dir::write, 10>;
+using write12_cdb = rw_cdb<rw_dir::write, 12>;
+using write16_cdb = rw_cdb<rw_dir::write, 16>;
+
+/* Some fixed cdbs, usable as they are or copied then patched */
+constexpr cdb<6> test_unit_ready_cdb{};
+constexpr cdb<6> start_unit_cdb{{0x1b, 0, 0, 0, 0x1, 0}};
+constexpr cdb<6> stop_unit_cdb{{0x1b, 0, 0, 0, 0, 0}};
+constexpr cdb<10> sync_cache10_cdb{{0x35, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+constexpr cdb<16> sync_cache16_cdb{{0x91, 0, 0, 0, 0, 0, 0, 0,
+                                    0, 0, 0, 0, 0, 0, 0, 0}};
+
+/* Owns a struct sg_pt_base instance, see sg_pt.h . Move only. */
+class pt_obj {
+public:
+    pt_obj() noexcept : p_(construct_scsi_pt_obj()) {}
+    /* get_scsi_pt_os_err() is non-zero if dev_fd is not usable */
+    explicit pt_obj(int dev_fd, int verbose = 0) noexcept
+        : p_(construct_scsi_pt_obj_with_fd(dev_fd, verbose)) {}
+    ~pt_obj() { reset(); }
+
+    pt_obj(const pt_obj &) = delete;
+    pt_obj & operator=(const pt_obj &) = delete;
+
+    pt_obj(pt_obj && o) noexcept : p_(o.p_) { o.p_ = nullptr; }
+    pt_obj & operator=(pt_obj && o) noexcept
+    {
+        if (this != &o) {
+            reset();
+            p_ = o.p_;
+            o.p_ = nullptr;
+        }
+        return *this;
+    }
+
+    /* false if out of memory or moved from */
+    explicit operator bool() const noexcept { return nullptr != p_; }
+    struct sg_pt_base * get() const noexcept { return p_; }
+
+    void reset() noexcept
+    {
+        if (p_) {
+            destruct_scsi_pt_obj(p_);
+            p_ = nullptr;
+        }
+    }
+
+    /* Ready for the next command, keeping the device file descriptor */
+    void clear() noexcept { clear_scsi_pt_obj(p_); }
+
+    template <int N>
+    void set_cdb(const cdb<N> & c) noexcept
+    {
+        set_scsi_pt_cdb(p_, c.data(), N);
+    }
+
+    void set_sense(uint8_t * sense, int max_sense_len) noexcept
+    {
+        set_scsi_pt_sense(p_, sense, max_sense_len);
+    }
+
+    void set_data_in(uint8_t * dxferp, int dxfer_ilen) noexcept
+    {
+        set_scsi_pt_data_in(p_, dxferp, dxfer_ilen);
+    }
+
+    void set_data_out(const uint8_t * dxferp, int dxfer_olen) noexcept
+    {
+        set_scsi_pt_data_out(p_, dxferp, dxfer_olen);
+    }
+
+    /* As do_scsi_pt(), with fd -1 (the one given to the constructor) */
+    int exec(int timeout_secs, int verbose) noexcept
+    {
+        return do_scsi_pt(p_, -1, timeout_secs, verbose);
+    }
+
+private:
+    struct sg_pt_base * p_;
+};
+
+}       /* namespace sg */
+
+#endif
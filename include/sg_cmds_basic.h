@@ -270,6 +270,59 @@ int sg_simple_inquiry_pt(struct sg_pt_base * ptvp,
                          struct sg_simple_inquiry_resp * inq_data, bool noisy,
                          int verbose);
 
+/* Opt-in cache, kept in files in directory 'dir', of the standard INQUIRY
+ * response and of the Supported VPD pages, Unit serial number, Device
+ * identification, Block limits, Block device characteristics and Logical
+ * block provisioning VPD pages. When enabled, sg_ll_inquiry*() and
+ * sg_simple_inquiry*() take those from the cache, rather than the device,
+ * while they are younger than 'ttl_secs' (def: 3600 when 0 or less). There
+ * is one file per logical unit, named after its NAA (or EUI-64) designator
+ * which, in Linux, is read from sysfs when available so finding it needs no
+ * command. An INQUIRY DATA HAS CHANGED unit attention seen by
+ * sg_cmds_process_resp() removes the file of that logical unit. Setting the
+ * SG3_UTILS_INQ_CACHE environment variable to a directory name (and
+ * optionally SG3_UTILS_INQ_CACHE_TTL to a number of seconds) has the same
+ * effect as calling this function. If 'dir' is NULL the cache is disabled.
+ * Returns 0 on success, else a negated errno (-ENOSYS if not supported). */
+int sg_inq_cache_enable(const char * dir, int ttl_secs);
+
+/* Removes the cache file (if any) of the logical unit that sg_fd is open
+ * on. Returns 0 if done or there was nothing to do, else a negated
+ * errno. */
+int sg_inq_cache_invalidate(int sg_fd);
+
+/* Other responses that describe a logical unit and rarely change may be
+ * kept in the same cache file, each under one of these kinds. The third
+ * party copy commands (e.g. sg_ll_receive_copy_results() ) use this. */
+#define SG_INQ_CACHE_KIND_RCOP 3        /* RECEIVE COPY OPERATING PARAMS */
+
+/* Places up to mx_resp_len bytes of a fresh cached response of 'kind' for
+ * the logical unit on sg_fd in resp. Returns the number of bytes placed,
+ * or -1 if there is none (or the cache is disabled). */
+int sg_inq_cache_get_resp(int sg_fd, int kind, uint8_t * resp,
+                          int mx_resp_len, int verbose);
+
+/* Keeps the 'len' byte response of 'kind' at resp in the cache file of the
+ * logical unit on sg_fd, if the cache is enabled. */
+void sg_inq_cache_put_resp(int sg_fd, int kind, const uint8_t * resp,
+                           int len, int verbose);
+
+/* Answers from a table of the commands that the device on sg_fd supports,
+ * built from one REPORT SUPPORTED OPERATION CODES command per device (per
+ * thread), or from the INQUIRY cache (see above) when that is enabled, so
+ * the command is not repeated by later invocations. sg_inq_cache_invalidate()
+ * and the unit attentions it is called for (and also MICROCODE HAS BEEN
+ * CHANGED and CHANGED OPERATING DEFINITION) drop the table. 'sa' is the
+ * service action, or -1 for a command without one (or for any of them).
+ * sg_opcode_is_supported() returns 1 if the command is supported, 0 if it
+ * is not, or -1 if unknown (e.g. the device does not support REPORT
+ * SUPPORTED OPERATION CODES). sg_opcode_recommended_timeout() returns the
+ * device's recommended timeout for the command, in seconds, or 'def_secs'
+ * if it gave none. */
+int sg_opcode_is_supported(int sg_fd, int opcode, int sa, int verbose);
+int sg_opcode_recommended_timeout(int sg_fd, int opcode, int sa, int def_secs,
+                                  int verbose);
+
 /* MODE SENSE commands yield a response that has header then zero or more
  * block descriptors followed by mode pages. In most cases users are
  * interested in the first mode page. This function returns the (byte)
@@ -346,11 +399,151 @@ int sg_cmds_process_resp(struct sg_pt_base * ptvp, const char * leadin,
                          int pt_res, bool noisy, int verbose,
                          int * o_sense_cat);
 
+/* Retry policy for transient conditions. When enabled the sg_ll_* functions
+ * repeat a command that fails with one of the classes below, sleeping
+ * between attempts for a backoff that starts at 'base_ms', doubles after
+ * each attempt up to 'max_ms', and is randomized (jittered) into the upper
+ * half of that so that several initiators backing off from one device do
+ * not retry in step. A command is given at most 'max_retries' repeats, and
+ * no more once 'budget_ms' (if non-zero) of sleeping has been done for it.
+ * Off (max_retries of 0) unless sg_retry_policy_set() is called or the
+ * SG3_UTILS_RETRY environment variable is set, see sg3_utils(8). INQUIRY
+ * DATA HAS CHANGED and similar unit attentions still invalidate the
+ * INQUIRY cache when they are retried. */
+#define SG_RETRY_UA 0x1         /* UNIT ATTENTION */
+#define SG_RETRY_NOT_READY 0x2  /* NOT READY, becoming ready (ASC/Q 0x4,0x1) */
+#define SG_RETRY_BUSY 0x4       /* BUSY status */
+#define SG_RETRY_TS_FULL 0x8    /* TASK SET FULL status */
+#define SG_RETRY_ABORTED 0x10   /* ABORTED COMMAND or TASK ABORTED status */
+#define SG_RETRY_ALL 0x1f
+
+#define SG_RETRY_DEF_BASE_MS 10
+#define SG_RETRY_DEF_MAX_MS 2000
+
+struct sg_retry_policy {
+    int max_retries;            /* per command, 0 for no retries */
+    unsigned int classes;       /* OR-ed SG_RETRY_* values */
+    uint32_t base_ms;           /* 0 taken as SG_RETRY_DEF_BASE_MS */
+    uint32_t max_ms;            /* 0 taken as SG_RETRY_DEF_MAX_MS */
+    uint32_t budget_ms;         /* 0 for no limit */
+};
+
+/* Sets the process wide policy, replacing the one (if any) taken from the
+ * environment. NULL turns retries off. Not thread safe: call before
+ * commands are issued. */
+void sg_retry_policy_set(const struct sg_retry_policy * rpp);
+
+/* Copies the policy in force into *rpp */
+void sg_retry_policy_get(struct sg_retry_policy * rpp);
+
+/* Classifies a completed command from its SCSI status and sense data.
+ * Returns one SG_RETRY_* value, or 0 if the condition is not transient
+ * (this does not look at the policy). */
+int sg_retry_classify(int scsi_status, const uint8_t * sbp, int slen);
+
+/* For callers that issue commands themselves. If the policy retries
+ * 'rclass' and 'attempt' (0 for the first retry) is within its limits then
+ * sleeps for the backoff and returns true; otherwise returns false at once.
+ * '*slept_msp' accumulates the sleeping done for this command towards
+ * 'budget_ms', so zero it before the first attempt. */
+bool sg_retry_wait(int rclass, int attempt, uint32_t * slept_msp,
+                   int verbose);
+
+/* Sets a deadline, 'budget_ms' milliseconds from now, for the commands
+ * this thread issues through sg_cmds_do_pt() (thus the sg_ll_* functions)
+ * and sg_retry_wait(); 0 removes it. Each command's timeout is cut down to
+ * the time left, so a command still running at the deadline is aborted
+ * by the pass-through's timeout handling (e.g. the Linux SCSI error
+ * handler sends ABORT TASK) rather than after the usual 60 seconds. No
+ * retry sleeps past the deadline and once it has passed commands are not
+ * issued, SCSI_PT_DO_TIMEOUT being returned instead. */
+void sg_cmds_deadline_set(uint32_t budget_ms);
+
+/* Milliseconds left before this thread's deadline (0 once it has passed),
+ * or -1 if none is set */
+int sg_cmds_deadline_left_ms(void);
+
+/* do_scsi_pt() plus the retry policy and deadline: 'cdbp' and 'cdb_len'
+ * must be what was given to set_scsi_pt_cdb() as the object is rearmed
+ * (see rearm_scsi_pt_obj() ) before each repeat. Returns what do_scsi_pt()
+ * returned for the last attempt, which is then given to
+ * sg_cmds_process_resp() as usual. */
+int sg_cmds_do_pt(struct sg_pt_base * ptvp, const uint8_t * cdbp,
+                  int cdb_len, int fd, int time_secs, int verbose);
+
+/* Unit attention tracker. After a reset or other event on a fabric the
+ * next command sent through each I_T nexus gets a unit attention, which a
+ * caller would typically report then repeat its command. When the tracker
+ * is on, sg_cmds_do_pt() (thus the sg_ll_* functions) absorbs a unit
+ * attention in the classes below: it is recorded against the I_T nexus it
+ * came through and the command is repeated at once (no backoff and not
+ * counted by the retry policy), up to SG_UA_MAX_ABSORB times for one
+ * command since a device may have several queued. A unit attention that
+ * several logical units (or file descriptors) behind one I_T nexus report
+ * becomes one record with a count. Callers collect the records with
+ * sg_ua_take(), e.g. to drop what they know about the logical units (the
+ * INQUIRY cache is dropped by the library as for the retry policy). Off
+ * unless sg_ua_tracker_set() is called or the SG3_UTILS_UA_TRACK
+ * environment variable is set, see sg3_utils(8). In Linux the I_T nexus is
+ * the host, channel and target (i.e. "H:C:T") from sysfs; elsewhere, or if
+ * that is not found, it is the device file (or file descriptor). */
+#define SG_UA_RESET 0x1         /* 29h/xxh: power on, reset, I_T nexus loss */
+#define SG_UA_PARAMS_CHANGED 0x2  /* 2Ah/xxh: mode, reservations, ALUA ... */
+#define SG_UA_LUNS_CHANGED 0x4  /* 3Fh/0Eh: reported luns data has changed */
+#define SG_UA_INQ_CHANGED 0x8   /* 3Fh/01h-03h: microcode, operating
+                                 * definition or inquiry data changed */
+#define SG_UA_EXPECTED 0xf      /* all of the above */
+
+#define SG_UA_MAX_ABSORB 4
+#define SG_UA_NEXUS_LEN 32
+
+struct sg_ua_record {
+    char nexus[SG_UA_NEXUS_LEN];        /* e.g. "2:0:1" in Linux */
+    int ua_class;               /* one SG_UA_* value */
+    uint8_t asc;                /* additional sense code */
+    uint8_t ascq;               /* and qualifier, of the latest */
+    uint32_t count;             /* times absorbed since last taken */
+    uint64_t first_ns;          /* sg_pt_lat_now_ns() when first seen */
+    uint64_t last_ns;
+};
+
+/* Sets the OR-ed SG_UA_* classes to absorb, 0 turns the tracker off. May
+ * be called at any time; replaces the setting (if any) taken from the
+ * environment. */
+void sg_ua_tracker_set(unsigned int ua_classes);
+
+/* Returns the classes being absorbed, 0 when the tracker is off */
+unsigned int sg_ua_tracker_get(void);
+
+/* Returns the SG_UA_* class of sense data holding a unit attention, or 0
+ * if it is some other unit attention or not one at all */
+int sg_ua_classify(const uint8_t * sbp, int slen);
+
+/* Moves up to 'max_arr' records of absorbed unit attentions into 'arr',
+ * oldest first. With 'sg_fd' >= 0 only those of the I_T nexus that sg_fd
+ * reaches are taken, else those of all I_T nexuses. Records are removed
+ * once taken. Returns the number placed in 'arr'; with 'arr' NULL returns
+ * the number held (for sg_fd's I_T nexus, or all) and takes none. */
+int sg_ua_take(int sg_fd, struct sg_ua_record * arr, int max_arr);
+
 /* NVMe devices use a different command set. This function will return true
  * if the device associated with 'pvtp' is a NVME device, else it will
  * return false (e.g. for SCSI devices). */
 bool sg_cmds_is_nvme(const struct sg_pt_base * ptvp);
 
+/* The sg_ll_* functions that take a file descriptor get their pass-through
+ * object from sg_cmds_get_pt_obj() and hand it back with
+ * sg_cmds_put_pt_obj(). One object per thread is kept for reuse so
+ * repeated commands do not allocate. sg_cmds_get_pt_obj() returns a
+ * cleared object associated with sg_fd (which may be -1), or NULL if out
+ * of memory. */
+struct sg_pt_base * sg_cmds_get_pt_obj(int sg_fd, int verbose);
+void sg_cmds_put_pt_obj(struct sg_pt_base * ptvp);
+
+/* Releases the pass-through object kept for the calling thread, if any.
+ * Worth calling before a thread that has issued sg_ll_* commands exits. */
+void sg_cmds_free_pt_obj_cache(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -381,6 +381,171 @@ int sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
                       uint64_t lba, uint32_t num_blocks, int group_num,
                       int timeout_secs, bool noisy, int verbose);
 
+/* Progress poller for long running commands started with IMMED set (e.g.
+ * FORMAT UNIT, SANITIZE and extended self-tests). Polls with TEST UNIT
+ * READY or REQUEST SENSE and reads the progress indication with
+ * sg_get_sense_progress_fld(). The interval between polls of a device
+ * adapts between min_ns and max_ns: it doubles while the progress
+ * indication is unchanged and otherwise is a quarter of the estimated time
+ * remaining, so polls get closer together near completion. Many devices
+ * can be polled from one thread with sg_progress_run(). */
+#define SG_PROGRESS_POLL_FUNCTIONS 1
+
+#define SG_PROGRESS_ACTIVE 0    /* progress indication still present */
+#define SG_PROGRESS_DONE 1      /* finished, no error reported */
+#define SG_PROGRESS_FAILED 2    /* poll failed, or sense reports an error */
+
+struct sg_progress_dev {
+    int sg_fd;
+    bool use_rs;        /* poll with REQUEST SENSE, else TEST UNIT READY */
+    bool desc;          /* REQUEST SENSE for descriptor format sense */
+    int state;          /* SG_PROGRESS_* */
+    int progress;       /* last progress indication (of 65536), -1: none */
+    int res;            /* of last poll: 0 or a SG_LIB_CAT_* value, for a
+                         * failure in the sense data from its sense key */
+    int sense_key;      /* from final REQUEST SENSE, -1: none */
+    int asc;
+    int ascq;
+    int polls;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t interval_ns;   /* before the next poll */
+    uint64_t start_ns;      /* from sg_pt_lat_now_ns() */
+    uint64_t next_ns;       /* when the next poll is due */
+    uint64_t end_ns;        /* when found done or failed */
+    uint64_t eta_ns;        /* estimated time remaining, 0: unknown */
+    uint64_t prog_ns;       /* when progress was last seen to change */
+    int prog_last;          /* progress indication at prog_ns */
+    void * user;            /* for the caller, not used by the poller */
+};
+
+/* Prepares *dp to poll sg_fd, the first poll due min_ns nanoseconds from
+ * now. When use_rs is false, polls with TEST UNIT READY until a NOT READY
+ * without a progress indication, then with REQUEST SENSE. */
+void sg_progress_init(struct sg_progress_dev * dp, int sg_fd, bool use_rs,
+                      uint64_t min_ns, uint64_t max_ns);
+
+/* Polls the device of dp once, now, and schedules the next poll. Returns
+ * the new state (SG_PROGRESS_*). */
+int sg_progress_poll(struct sg_progress_dev * dp, int verbose);
+
+/* Polls the num devices in devs, from the calling thread, each when its
+ * next poll is due, until none are SG_PROGRESS_ACTIVE. If cb is non-NULL
+ * it is called after each poll; when it returns false polling stops.
+ * Returns the number of devices in the SG_PROGRESS_FAILED state. */
+int sg_progress_run(struct sg_progress_dev * devs, int num,
+                    bool (*cb)(struct sg_progress_dev * dp, void * ctx),
+                    void * ctx, int verbose);
+
+/* Device session: a logical unit opened once whose capacity, block limits,
+ * logical block provisioning and block device characteristics are fetched
+ * when first asked for and then kept, so that the tools (and the parts of
+ * one tool) that need them do not each send the commands. Each getter
+ * returns 0 and points *(out) at the kept values, or returns the
+ * SG_LIB_CAT_* value (or -1) of a failed fetch. A failure is kept too
+ * except for a unit attention or an aborted command, after which the next
+ * call fetches again. The VPD pages are fetched with sg_ll_inquiry_v2() so
+ * they come from the INQUIRY cache when that is enabled (see
+ * sg_inq_cache_enable() ). Not thread safe: one thread per session. */
+#define SG_DEV_SESS_FUNCTIONS 1
+
+#define SG_DS_CAP 0x1           /* READ CAPACITY(16), else (10) */
+#define SG_DS_BLK_LIM 0x2       /* Block Limits VPD page */
+#define SG_DS_LBP 0x4           /* Logical Block Provisioning VPD page */
+#define SG_DS_BDC 0x8           /* Block Device Characteristics VPD page */
+#define SG_DS_ALL 0xf
+
+struct sg_ds_cap {
+    uint64_t num_blocks;        /* last LBA + 1 */
+    uint32_t lb_size;           /* logical block size in bytes */
+    bool rc16;          /* false: from READ CAPACITY(10), fields below 0 */
+    bool prot_en;
+    bool lbpme;
+    bool lbprz;
+    int p_type;         /* protection type (1 to 3) when prot_en, else 0 */
+    int p_i_exp;        /* log2 of PI intervals per logical block */
+    int lbppbe;         /* log2 of logical blocks per physical block */
+    int lowest_aligned;
+};
+
+/* Fields are as in the Block Limits VPD page, 0 when not reported */
+struct sg_ds_blk_lim {
+    int page_len;               /* bytes of the page after its header */
+    bool wsnz;
+    bool ugavalid;
+    int max_cmp_wr_len;
+    uint32_t opt_xfer_gran;
+    uint32_t max_xfer_len;
+    uint32_t opt_xfer_len;
+    uint32_t max_prefetch_len;
+    uint32_t max_unmap_lba;
+    uint32_t max_unmap_descs;
+    uint32_t unmap_gran;
+    uint32_t unmap_align;       /* when ugavalid */
+    uint64_t max_ws_len;
+};
+
+struct sg_ds_lbp {
+    bool lbpu;
+    bool lbpws;
+    bool lbpws10;
+    bool anc_sup;
+    bool dp;
+    int lbprz;                  /* 3 bit field */
+    int threshold_exp;
+    int min_prov_pct;
+    int prov_type;
+};
+
+struct sg_ds_bdc {
+    int rotation_rate;          /* 1: non-rotating medium, 0: not reported */
+    int product_type;
+    int wabereq;
+    int wacereq;
+    int form_factor;
+    int zoned;
+    bool fuab;
+    bool vbuls;
+};
+
+struct sg_dev_sess {
+    int sg_fd;
+    bool own_fd;        /* opened by sg_ds_open(), closed by sg_ds_close() */
+    int verbose;
+    unsigned int have;          /* SG_DS_* fetches done (kept) */
+    int res[4];                 /* of each fetch, by SG_DS_* bit number */
+    struct sg_ds_cap cap;
+    struct sg_ds_blk_lim bl;
+    struct sg_ds_lbp lbp;
+    struct sg_ds_bdc bdc;
+};
+
+/* Starts a session on sg_fd, already open, which sg_ds_close() leaves
+ * open. verbose applies to the commands the session sends. */
+void sg_ds_init(struct sg_dev_sess * dsp, int sg_fd, int verbose);
+
+/* Opens device_name with sg_cmds_open_device() and starts a session on it.
+ * Returns 0, or a negated errno from the open. */
+int sg_ds_open(struct sg_dev_sess * dsp, const char * device_name,
+               bool read_only, int verbose);
+
+/* Ends the session, closing the device if sg_ds_open() opened it. Returns
+ * 0, or a negated errno from the close. */
+int sg_ds_close(struct sg_dev_sess * dsp);
+
+/* Drops the kept values of the fetches in mask (SG_DS_*), e.g. after a
+ * FORMAT UNIT or a capacity changed unit attention. */
+void sg_ds_forget(struct sg_dev_sess * dsp, unsigned int mask);
+
+int sg_ds_get_cap(struct sg_dev_sess * dsp, const struct sg_ds_cap ** out);
+int sg_ds_get_blk_lim(struct sg_dev_sess * dsp,
+                      const struct sg_ds_blk_lim ** out);
+int sg_ds_get_lbp(struct sg_dev_sess * dsp, const struct sg_ds_lbp ** out);
+int sg_ds_get_bdc(struct sg_dev_sess * dsp, const struct sg_ds_bdc ** out);
+
+/* As sg_opcode_is_supported() for the device of the session. */
+int sg_ds_opcode_supported(struct sg_dev_sess * dsp, int opcode, int sa);
+
 #ifdef __cplusplus
 }
 #endif
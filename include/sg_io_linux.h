@@ -11,7 +11,7 @@
  */
 
 /*
- * Version 1.07 [20181211]
+ * Version 1.10 [20261014]
  */
 
 /*
@@ -20,6 +20,9 @@
  * block layer.
  */
 
+#include <sys/types.h>
+#include <sys/time.h>
+
 #include "sg_lib.h"
 #include "sg_linux_inc.h"
 
@@ -183,6 +186,220 @@ int sg_err_category_new(int scsi_status, int host_status, int driver_status,
 /* The following function declaration is for the sg version 3 driver. */
 int sg_err_category3(struct sg_io_hdr * hp);
 
+/* As sg_err_category3() but also leaves the decoded sense data (see
+ * sg_scsi_decode_sense() ) in '*sip' for the caller's error handling, so it
+ * is parsed once. If there is no sense data (e.g. SG_LIB_CAT_CLEAN is
+ * returned) only sip->response_code is set, to 0. */
+int sg_err_category3_sinfo(struct sg_io_hdr * hp,
+                           struct sg_scsi_sense_info * sip);
+
+
+/* What the device open on a file descriptor, and the drivers in front of
+ * it, offer the copy utilities; filled by sg_io_probe_caps(). Their
+ * engine=auto option uses it to choose how to move data. */
+struct sg_io_caps {
+    bool is_sg;         /* sg driver character device */
+    bool is_bsg;        /* other character device that accepts SG_IO */
+    bool is_blk;        /* block device that accepts SG_IO */
+    bool v4;            /* sg driver accepts struct sg_io_v4 (4.0.0+) */
+    bool v4_share;      /* sg driver has request sharing (4.0.30+) */
+    bool mmap_io;       /* sg driver can do SG_FLAG_MMAP_IO */
+    bool dio;           /* /proc/scsi/sg/allow_dio is set */
+    bool uring;         /* kernel has io_uring */
+    int sg_version;     /* e.g. 30536 for 3.5.36, 0 if no driver answer */
+    int reserved_sz;    /* sg reserved buffer size in bytes (0 if not sg) */
+};
+
+/* Probes the file (or device) open on fd and fills *capsp . Only ioctls
+ * that do not change the device's state are used. Returns 0 on success
+ * (including when fd is not a pass-through device, then only 'dio' and
+ * 'uring' may be set), else an errno value. */
+int sg_io_probe_caps(int fd, struct sg_io_caps * capsp, int verbose);
+
+/* Writes a one line summary of *capsp (e.g. "sg driver 4.0.47: v4,
+ * request sharing, mmap, dio") to b, which is returned. */
+char * sg_io_caps_str(const struct sg_io_caps * capsp, int blen, char * b);
+
+/* Returns the kernel's max_sectors_kb for the block device, or the sg
+ * device (via its attached block device, if any), open on fd. Returns 0 if
+ * it is not found in sysfs. */
+int sg_io_max_sectors_kb(int fd);
+
+/* Asks the sg driver open on fd for a reserved buffer of at least
+ * blk_sz * (*bptp) * qd bytes then reads back what was granted. If that
+ * is less a note (prefixed by leadin, may be NULL) is printed and, when
+ * fit is true, *bptp is reduced so a transfer fits the granted size (to
+ * no less than 1). Returns the granted size in bytes, else a negated
+ * errno value. */
+int sg_io_reserve(int fd, int blk_sz, int * bptp, int qd, bool fit,
+                  const char * leadin, int verbose);
+
+/* Returns true if the command in *hp was done with direct IO. If not and
+ * *warnedp is false, prints the likely reason then sets *warnedp so a
+ * caller can warn once per run. warnedp may be NULL (no message). */
+bool sg_io_dio_done(const struct sg_io_hdr * hp, const char * leadin,
+                    bool * warnedp);
+
+/*
+ * The following is the layer shared by the dd variants (sg_dd, sgm_dd and
+ * sgp_dd): classifying and opening IFILE and OFILE, fetching their
+ * capacities, bpt=auto, retried read() and write() calls and the
+ * statistics, timing and progress=SEC output. Messages go to
+ * sg_warnings_strm (or stderr), each starting with leadin when there is
+ * one.
+ */
+
+/* File types of IFILE and OFILE as determined by sg_io_filetype() */
+#define SG_IO_FT_OTHER 1        /* filetype is probably normal */
+#define SG_IO_FT_SG 2           /* filetype is sg char device or supports
+                                 * SG_IO ioctl */
+#define SG_IO_FT_RAW 4          /* filetype is raw char device */
+#define SG_IO_FT_DEV_NULL 8     /* either "/dev/null" or "." as filename */
+#define SG_IO_FT_ST 16          /* filetype is st char device (tape) */
+#define SG_IO_FT_BLOCK 32       /* filetype is block device */
+#define SG_IO_FT_FIFO 64        /* filetype is a fifo (name pipe) */
+#define SG_IO_FT_ERROR 128      /* couldn't "stat" file */
+
+/* ft_flags of sg_io_filetype(), without these bsg devices and fifos are
+ * SG_IO_FT_OTHER */
+#define SG_IO_FT_WANT_BSG 1     /* bsg char devices are SG_IO_FT_SG */
+#define SG_IO_FT_WANT_FIFO 2    /* fifos are SG_IO_FT_FIFO */
+
+/* Returns the SG_IO_FT_* type of fname. The bsg major number is looked up
+ * in /proc/devices once, on the first call that asks for it. */
+int sg_io_filetype(const char * fname, int ft_flags, int verbose);
+
+/* Writes the names of the file types set in ft (e.g. "block device ") to
+ * b, which is returned. */
+char * sg_io_filetype_str(int ft, int blen, char * b);
+
+/* fl_mask bits of sg_io_open_dd(), mostly from iflag= and oflag= */
+#define SG_IO_OPEN_DIRECT 1     /* O_DIRECT */
+#define SG_IO_OPEN_EXCL 2       /* O_EXCL */
+#define SG_IO_OPEN_DSYNC 4      /* O_SYNC */
+#define SG_IO_OPEN_APPEND 8     /* O_APPEND, OFILE that is not sg or raw */
+#define SG_IO_OPEN_NONBLOCK 16  /* O_NONBLOCK, sg devices only */
+#define SG_IO_OPEN_RDONLY_OK 32 /* IFILE sg device may be read-only */
+
+/* Opens fname, whose type from sg_io_filetype() is ft, as the IFILE (wr
+ * false) or the OFILE of a copy. A sg device is opened O_RDWR; other
+ * IFILEs O_RDONLY, raw OFILEs O_WRONLY and other OFILEs O_WRONLY | O_CREAT.
+ * Files other than sg devices are then positioned at blk_off * blk_sz
+ * bytes (i.e. skip= or seek=). Returns a file descriptor, else a negated
+ * errno value after printing why. */
+int sg_io_open_dd(const char * fname, int ft, bool wr, int fl_mask,
+                  int64_t blk_off, int blk_sz, const char * leadin,
+                  int verbose);
+
+/* Fetches the number of logical blocks and their size from the block
+ * device open on fd with the BLKGETSIZE64 and BLKSSZGET ioctls. Returns 0
+ * if ok, else -1 . */
+int sg_io_blkdev_capacity(int fd, int64_t * num_sect, int * sect_sz,
+                          int verbose);
+
+struct sg_dev_sess;      /* see sg_cmds_extra.h */
+
+/* Fetches the number of logical blocks and their size from the device
+ * session dsp (see sg_ds_get_cap() ), so READ CAPACITY is sent at most
+ * once per session unless it failed with a unit attention. Returns 0 if
+ * ok, else a SG_LIB_CAT_* value. */
+int sg_io_read_capacity(struct sg_dev_sess * dsp, int64_t * num_sect,
+                        int * sect_sz, int verbose);
+
+#define SG_IO_AUTO_BPT_MAX_BYTES (8 * 1024 * 1024) /* bpt=auto upper limit */
+
+/* One side (IFILE or OFILE) of a copy for sg_io_auto_bpt(). The Block
+ * Limits VPD page of a sg device is taken from the device session dsp;
+ * when dsp is NULL a session is started on fd just for the call. */
+struct sg_io_bpt_side {
+    int fd;             /* -1 when there is no such file */
+    int ftype;          /* SG_IO_FT_* of fd */
+    struct sg_dev_sess * dsp;
+    const char * fname;
+};
+
+/* For bpt=auto works out the transfer size (in blocks of blk_sz bytes)
+ * that suits both sides of a copy: for each the optimal transfer length
+ * from the Block Limits VPD page of a pass-through device, or failing that
+ * the largest transfer allowed, bounded by the kernel's max_sectors_kb and
+ * SG_IO_AUTO_BPT_MAX_BYTES, then rounded down to a multiple of the optimal
+ * transfer granularities. Returns def_bpt if neither side has limits. */
+int sg_io_auto_bpt(struct sg_io_bpt_side * inp, struct sg_io_bpt_side * outp,
+                   int blk_sz, int def_bpt, int verbose);
+
+/* read() and write() retried while they fail with EINTR or EAGAIN. For
+ * IFILE and OFILE data and for a sg v3 header given to (or fetched from)
+ * the sg driver. Return as read() and write() do. */
+ssize_t sg_io_read_retry(int fd, void * bp, size_t len);
+ssize_t sg_io_write_retry(int fd, const void * bp, size_t len);
+
+/* Prints the "<full>+<partial> records in" and "... records out" lines of
+ * the dd variants, preceded by the remaining block count when that is not
+ * zero. */
+void sg_io_print_records(const char * leadin, int64_t remaining,
+                         int64_t in_full, int in_partial, int64_t out_full,
+                         int out_partial);
+
+/* Prints the time since *start_tmp and, when enough was copied, the rate
+ * in MB/sec (10**6 bytes a second) for the time=1 option of the dd
+ * variants: "time to transfer data was 18.779506 secs, 57.18 MB/sec".
+ * With contin true "was" becomes "so far". */
+void sg_io_print_throughput(const struct timeval * start_tmp, int64_t blocks,
+                            int blk_sz, bool contin);
+
+/* When /proc/scsi/sg/allow_dio is 0, warns that it needs to be 1 for the
+ * sg driver to do direct IO. */
+void sg_io_dio_warn(void);
+
+/* State of the progress=SEC[,FILE] option of the dd variants: every SEC
+ * seconds, and when the copy finishes, a line of JSON is appended to FILE
+ * (default stderr). 'count' is the number of blocks requested and 'xfers'
+ * the number of transfers so far, either counted by sg_io_progress_tick()
+ * or set by the caller. */
+struct sg_io_progress {
+    FILE * fp;          /* NULL when progress=SEC is not given */
+    const char * tool;  /* "tool" member of each line */
+    int sec;
+    int bs;             /* logical block size in bytes */
+    int64_t count;
+    int64_t xfers;
+    int64_t last_xfers;
+    int64_t last_blks;
+    uint64_t start_ns;
+    uint64_t last_ns;
+};
+
+/* What one progress line reports besides what *pp holds. Read and write
+ * latency percentiles are added for the pass-through file descriptors
+ * given (-1 for none) from the sg_pt latency histograms of the opcodes. */
+struct sg_io_progress_cnt {
+    int64_t blocks_in;
+    int64_t blocks_out;
+    int64_t recovered_errs;
+    int64_t unrecovered_errs;
+    int64_t retries;
+    int rd_fd;
+    int rd_opcode;
+    int wr_fd;
+    int wr_opcode;
+};
+
+/* Opens fname (stderr when NULL or empty) for appending progress lines
+ * of tool, enables the latency histograms then calls sg_io_progress_start()
+ * with no blocks copied. Returns 0, else SG_LIB_FILE_ERROR after printing
+ * why. */
+int sg_io_progress_open(struct sg_io_progress * pp, const char * tool,
+                        int sec, const char * fname, int bs, int64_t count,
+                        const char * leadin);
+/* (Re)starts the elapsed time at now, with blks_out blocks copied */
+void sg_io_progress_start(struct sg_io_progress * pp, int64_t blks_out);
+/* Counts one transfer. Returns true when SEC seconds have passed since
+ * the last line, so another is due. */
+bool sg_io_progress_tick(struct sg_io_progress * pp);
+/* Writes a progress line; with final set it is the last one */
+void sg_io_progress_out(struct sg_io_progress * pp, bool final,
+                        const struct sg_io_progress_cnt * cp);
+void sg_io_progress_close(struct sg_io_progress * pp);
 
 /* Note about SCSI status codes found in older versions of Linux.
    Linux has traditionally used a 1 bit right shifted and masked
@@ -0,0 +1,93 @@
+#ifndef SG_JSON_H
+#define SG_JSON_H
+
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A streaming JSON writer for the utilities' '--json' option. There is no
+ * document tree: each call appends its JSON text to a buffer which is
+ * written to a file descriptor whenever it holds SGJ_FLUSH_LEN bytes or
+ * more, and when the outermost object or array is closed. So a decoder
+ * emits its fields in the same order, and at about the same cost, as the
+ * printf() calls of its human readable output. Names and strings are
+ * escaped; bytes outside printable ASCII (e.g. in T10 vendor fields) are
+ * output as \u00XX so the output is always valid UTF-8.
+ *
+ * In an object every value needs a name, in an array (or at the top
+ * level) name should be NULL. Each top level value is followed by a
+ * newline so the output of several DEVICEs is a stream of JSON texts, one
+ * per line unless 'pretty' is set. After an error (out of memory or a
+ * failed write) later calls do nothing and sgj_fini() returns the errno.
+ *
+ * After sgj_init_cbor() the same calls emit CBOR (RFC 8949) instead, for
+ * bulk collection where size and parse cost matter more than legibility.
+ * Objects and arrays are indefinite length maps and arrays (their size is
+ * not known when they are opened), integers and booleans are native CBOR
+ * values and sgj_add_hex() gives a byte string of the raw bytes. Strings
+ * that are not plain ASCII are output as byte strings. Top level values
+ * simply follow one another, a CBOR sequence (RFC 8742).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SGJ_MAX_DEPTH 32        /* of nested objects and arrays */
+#define SGJ_FLUSH_LEN 4096
+
+struct sgj_state {
+    int fd;             /* output written here */
+    int err;            /* 0 or first errno value */
+    int depth;          /* number of open objects and arrays */
+    bool pretty;        /* one value per line, indented */
+    bool cbor;          /* binary CBOR rather than JSON text */
+    bool first[SGJ_MAX_DEPTH + 1];  /* next value is first in container */
+    char * bp;          /* buffered output, not NUL terminated */
+    int len;            /* bytes in bp */
+    int cap;            /* size of bp */
+};
+
+/* Returns 0 or ENOMEM. If 'pretty' is set, output is indented by 2 spaces
+ * for each level of nesting. */
+int sgj_init(struct sgj_state * jsp, int fd, bool pretty);
+/* As sgj_init() but the output is CBOR */
+int sgj_init_cbor(struct sgj_state * jsp, int fd);
+
+/* Writes out buffered output; returns 0 or an errno value */
+int sgj_flush(struct sgj_state * jsp);
+
+/* Flushes, frees the buffer and returns 0 or the first errno value */
+int sgj_fini(struct sgj_state * jsp);
+
+void sgj_begin_obj(struct sgj_state * jsp, const char * name);
+void sgj_end_obj(struct sgj_state * jsp);
+void sgj_begin_arr(struct sgj_state * jsp, const char * name);
+void sgj_end_arr(struct sgj_state * jsp);
+
+/* NULL 's' is output as null */
+void sgj_add_str(struct sgj_state * jsp, const char * name, const char * s);
+/* At most slen bytes of s, less any trailing spaces (as found in the
+ * fixed length, space padded, fields of SCSI responses) */
+void sgj_add_strn(struct sgj_state * jsp, const char * name, const char * s,
+                  int slen);
+void sgj_add_int(struct sgj_state * jsp, const char * name, int64_t val);
+void sgj_add_uint(struct sgj_state * jsp, const char * name, uint64_t val);
+void sgj_add_bool(struct sgj_state * jsp, const char * name, bool val);
+/* A string of 2*blen lower case hex digits (a byte string in CBOR) */
+void sgj_add_hex(struct sgj_state * jsp, const char * name,
+                 const uint8_t * bp, int blen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -243,6 +243,55 @@ bool sg_get_sense_filemark_eom_ili(const uint8_t * sensep, int sb_len,
 bool sg_get_sense_progress_fld(const uint8_t * sensep, int sb_len,
                                int * progress_outp);
 
+/* Fields of interest from a sense buffer, decoded in one pass by
+ * sg_scsi_decode_sense() without allocating or formatting anything.
+ * Offsets and lengths refer to the caller's sense buffer which should be
+ * kept while this structure is used. */
+#define SG_SENSE_MAX_DESCS 32
+
+struct sg_scsi_sense_desc_ref {
+    uint8_t type;               /* descriptor type (byte 0) */
+    uint8_t len;                /* length of whole descriptor, may be cut */
+    uint16_t offset;            /* of descriptor in sense buffer */
+};
+
+struct sg_scsi_sense_info {
+    uint8_t response_code;      /* 0x70, 0x71, 0x72 or 0x73 */
+    uint8_t sense_key;
+    uint8_t asc;
+    uint8_t ascq;
+    bool descriptor_format;     /* response code 0x72 or 0x73 */
+    bool deferred;              /* response code 0x71 or 0x73 */
+    bool sdat_ovfl;             /* SDAT_OVFL bit */
+    bool info_present;          /* fixed format or information descriptor */
+    bool info_valid;            /* VALID bit (fixed), or byte 2, bit 7 */
+    bool cmd_spec_present;      /* 'cmd_spec' field available */
+    bool stream_present;        /* fixed format or stream descriptor */
+    bool filemark;
+    bool eom;
+    bool ili;
+    bool sksv;                  /* 'sks' holds sense key specific bytes */
+    bool progress_present;      /* 'progress' available */
+    uint8_t fru_code;           /* field replaceable unit code */
+    uint8_t sks[3];             /* byte 0 includes SKSV bit */
+    int len;                    /* of decoded sense, <= sb_len */
+    int progress;               /* 0 to 65535, 65536 -> 100% */
+    int num_descs;              /* may exceed SG_SENSE_MAX_DESCS */
+    uint64_t info;
+    uint64_t cmd_spec;
+    struct sg_scsi_sense_desc_ref desc[SG_SENSE_MAX_DESCS];
+};
+
+/* Decodes the commonly needed fields of fixed or descriptor format sense
+ * data into '*sip' (which is zeroed first). Returns false (leaving
+ * sip->response_code at 0) if the response code is not one of 0x70 to
+ * 0x73. The 'info', 'cmd_spec', filemark/eom/ili and 'progress' fields
+ * follow the rules of the sg_get_sense_*_fld() functions above, except
+ * that fixed format fields beyond the additional sense length are
+ * ignored. */
+bool sg_scsi_decode_sense(const uint8_t * sensep, int sb_len,
+                          struct sg_scsi_sense_info * sip);
+
 /* Closely related to sg_print_sense(). Puts decoded sense data in 'buff'.
  * Usually multiline with multiple '\n' including one trailing. If
  * 'raw_sinfo' set appends sense buffer in hex. 'leadin' is string prepended
@@ -378,6 +427,22 @@ extern FILE * sg_warnings_strm;
 
 void sg_set_warnings_strm(FILE * warnings_strm);
 
+/* Multithreaded utilities may route pr2ws() and pr2serr() output through
+ * per-thread lock-free rings so that verbose tracing does not serialize
+ * worker threads on stdio. sg_log_ring_enable(ring_sz) turns this on with
+ * rings of at least ring_sz bytes, allocated on each thread's first
+ * message; it returns -1 if not supported by this build (output then goes
+ * to stdio as usual). One thread (at a time) should then call
+ * sg_log_ring_drain() periodically: it writes out the complete lines held
+ * in the rings (everything if 'all' is true) to sg_warnings_strm (or
+ * stderr) and returns the number of bytes written. Messages that find
+ * their ring full are dropped and counted. sg_log_ring_enable(0) drains,
+ * then frees the rings; so does calling sg_log_ring_enable() again with a
+ * new size. Only do either when no other thread may be logging.
+ */
+int sg_log_ring_enable(int ring_sz);
+int sg_log_ring_drain(bool all);
+
 /* The following "print" functions send ASCII to 'sg_warnings_strm' file
  * descriptor (default value is stderr). 'leadin' is string prepended to
  * each line printed out, NULL treated as "". */
@@ -490,6 +555,11 @@ bool sg_exit2str(int exit_status, bool longer, int b_len, char * b);
  * common sense key then return SG_LIB_CAT_SENSE .*/
 int sg_err_category_sense(const uint8_t * sense_buffer, int sb_len);
 
+/* Same mapping as sg_err_category_sense() applied to sense data already
+ * decoded by sg_scsi_decode_sense(). Returns SG_LIB_CAT_SENSE if 'sip' is
+ * NULL or holds no valid sense. */
+int sg_err_category_sinfo(const struct sg_scsi_sense_info * sip);
+
 /* Here are some additional sense data categories that are not returned
  * by sg_err_category_sense() but are returned by some related functions. */
 #define SG_LIB_CAT_ILLEGAL_REQ_WITH_INFO 17 /* Illegal request (other than */
@@ -527,6 +597,32 @@ int sg_vpd_dev_id_iter(const uint8_t * initial_desig_desc, int page_len,
                        int * off, int m_assoc, int m_desig_type,
                        int m_code_set);
 
+/* Index of the designation descriptors most often looked for in a device
+ * identification VPD page, built with one pass over the page. Each offset
+ * is that of the first such descriptor, relative to 'initial_desig_desc'
+ * (as 'off' from sg_vpd_dev_id_iter()), or -1 if there is none. Only NAA
+ * and EUI-64 designators with the binary code set, and SCSI name strings
+ * with the UTF-8 code set, are indexed. */
+struct sg_vpd_dev_id_idx {
+    int num;            /* number of designation descriptors */
+    int lu_naa;         /* association: logical unit */
+    int lu_eui64;
+    int lu_sns;         /* SCSI name string */
+    int tport_naa;      /* association: target port */
+    int tport_sns;
+    int rel_tport;      /* relative target port identifier */
+    int tpg;            /* target port group */
+    int rel_tport_id;   /* the identifier itself, -1 if none */
+    int tpg_id;         /* the target port group itself, -1 if none */
+};
+
+/* Builds the index 'dip' of the designation descriptors starting at
+ * 'initial_desig_desc' (arguments as for sg_vpd_dev_id_iter()). Returns 0,
+ * or -2 if the page is malformed in which case dip covers the descriptors
+ * before the bad one. */
+int sg_vpd_dev_id_index(const uint8_t * initial_desig_desc, int page_len,
+                        struct sg_vpd_dev_id_idx * dip);
+
 
 /* <<< General purpose (i.e. not SCSI specific) utility functions >>> */
 
@@ -569,16 +665,104 @@ void hex2stderr(const uint8_t * b_str, int len, int no_ascii);
 int hex2str(const uint8_t * b_str, int len, const char * leadin, int format,
             int cb_len, char * cbp);
 
+/* Same output as hex2stdout() but written directly to file descriptor 'fd'
+ * with write(2) in large chunks, bypassing stdio. Suits dumps of large
+ * buffers. If 'fd' is also used via a FILE stream, fflush() that stream
+ * first. Returns 0 on success, else a negated errno value. */
+int hex2fd(const uint8_t * b_str, int len, int no_ascii, int fd);
+
 /* Read ASCII hex bytes or binary from fname (a file named '-' taken as
- * stdin). If reading ASCII hex then there should be either one entry per
- * line or a comma, space or tab separated list of bytes. If no_space is
- * set then a string of ACSII hex digits is expected, 2 per byte. Everything
- * from and including a '#' on a line is ignored. Returns 0 if ok, or an
- * error code. If the error code is SG_LIB_LBA_OUT_OF_RANGE then mp_arr
- * would be exceeded and both mp_arr and mp_arr_len are written to. */
+ * stdin). ASCII hex is a list of bytes, each of one or two hex digits
+ * (leading zeros are allowed, so "012" is 0x12, but a "0x" prefix is a
+ * syntax error), separated by any mix of spaces, tabs, commas and line
+ * endings; empty entries (e.g. ",12" or "12,,34") are skipped. If no_space
+ * is set then pairs of hex digits are expected, 2 per byte, and separators
+ * between (or within) pairs are ignored. Everything from and including a
+ * '#' to the end of its line is ignored. Binary input is read up to
+ * max_arr_len bytes, more is not an error. Returns 0 if ok, or an error
+ * code. If the error code is SG_LIB_LBA_OUT_OF_RANGE then mp_arr would be
+ * exceeded and both mp_arr and mp_arr_len are written to. The ASCII hex is
+ * decoded by sg_f2hex_next() so both accept (and reject) the same input. */
 int sg_f2hex_arr(const char * fname, bool as_binary, bool no_space,
                  uint8_t * mp_arr, int * mp_arr_len, int max_arr_len);
 
+/* Streaming alternative to sg_f2hex_arr() for large inputs. The input is
+ * decoded on demand, memory mapped when it is a regular file, so neither
+ * the file nor its decoded form need be held in memory. The ASCII hex
+ * syntax is that of sg_f2hex_arr(); binary input is passed through.
+ * sg_f2hex_open() returns NULL on failure (with an error code in *errp if
+ * errp is non-NULL). Each sg_f2hex_next() call decodes up to max_len bytes
+ * into bp and places the number decoded in *blen_p, which is 0 only at end
+ * of input; returns 0 if ok else an error code. */
+struct sg_f2hex_strm;
+
+struct sg_f2hex_strm * sg_f2hex_open(const char * fname, bool as_binary,
+                                     bool no_space, int * errp);
+int sg_f2hex_next(struct sg_f2hex_strm * fhp, uint8_t * bp, int max_len,
+                  int * blen_p);
+void sg_f2hex_close(struct sg_f2hex_strm * fhp);
+
+/* A set of logical block extents, each an LBA and a number of blocks. The
+ * extents are kept in the order added until sg_lba_set_coalesce() sorts
+ * them into ascending LBA order and merges those that overlap or are
+ * adjacent, dropping those of zero blocks. Adding many extents then
+ * coalescing once is O(n log n). Initialize with sg_lba_set_init() and
+ * release ext[] with sg_lba_set_free(). */
+struct sg_lba_extent {
+    uint64_t lba;
+    uint64_t num;               /* number of blocks */
+};
+
+struct sg_lba_set {
+    bool sorted;                /* coalesced and nothing added since */
+    int num;                    /* extents in ext[] */
+    int max;                    /* extents allocated */
+    struct sg_lba_extent * ext;
+};
+
+/* Flags for sg_lba_set_parse() and sg_lba_set_read_file() */
+#define SG_LBA_SET_LBAS 0x1     /* each number is an LBA, of one block */
+#define SG_LBA_SET_PAIRS 0x2    /* LBA,NUM pairs (may span lines) */
+#define SG_LBA_SET_NOMULT 0x4   /* numbers without multipliers (e.g. 'k') */
+
+void sg_lba_set_init(struct sg_lba_set * lsp);
+void sg_lba_set_free(struct sg_lba_set * lsp);
+
+/* Appends the extent of num blocks starting at lba. Returns 0 if ok,
+ * SG_LIB_LBA_OUT_OF_RANGE if the extent would pass the last 64 bit LBA or
+ * the sg_convert_errno(ENOMEM) code. */
+int sg_lba_set_add(struct sg_lba_set * lsp, uint64_t lba, uint64_t num);
+
+/* Sorts the extents by LBA and merges those that overlap or are adjacent.
+ * Returns the number of blocks that were in more than one extent (0 when
+ * none overlapped, merely adjacent extents do not count). */
+uint64_t sg_lba_set_coalesce(struct sg_lba_set * lsp);
+
+/* Returns the sum of the blocks in the extents; once coalesced, the number
+ * of distinct blocks. */
+uint64_t sg_lba_set_blocks(const struct sg_lba_set * lsp);
+
+/* Adds the extents in the comma, space or tab separated list 'lbas'. When
+ * 'nums' is given its Nth number is the number of blocks of the Nth LBA
+ * and both lists must be the same length. Otherwise with SG_LBA_SET_PAIRS
+ * 'lbas' holds LBA,NUM pairs, else each LBA is of one block. Numbers are
+ * decimal unless prefixed by '0x' or with a trailing 'h'. Returns 0 if ok,
+ * else SG_LIB_SYNTAX_ERROR, SG_LIB_CONTRADICT (lists of different lengths)
+ * or an error from sg_lba_set_add(). */
+int sg_lba_set_parse(struct sg_lba_set * lsp, const char * lbas,
+                     const char * nums, int flags);
+
+/* Adds the extents in the file fname ('-' for stdin); everything on a line
+ * from a '#' is ignored. By default each line holds an LBA, optionally
+ * followed by a comma and its number of blocks, then anything (the form
+ * written by 'sg_verify --scrub --bad='). With SG_LBA_SET_LBAS each number
+ * is an LBA of one block; with SG_LBA_SET_PAIRS the numbers are LBA,NUM
+ * pairs. Numbers on a line are separated by commas, spaces or tabs. There
+ * is no limit on the number or length of lines. Returns 0 if ok, else an
+ * error. */
+int sg_lba_set_read_file(struct sg_lba_set * lsp, const char * fname,
+                         int flags);
+
 /* Returns true when executed on big endian machine; else returns false.
  * Useful for displaying ATA identify words (which need swapping on a
  * big endian machine). */
@@ -590,6 +774,65 @@ bool sg_is_big_endian();
 bool sg_all_zeros(const uint8_t * bp, int b_len);
 bool sg_all_ffs(const uint8_t * bp, int b_len);
 
+/* Scans 'num_blks' consecutive blocks, each 'blk_sz' bytes long, starting
+ * at bp. Returns the index (origin 0) of the first block that is not all
+ * zeros, or 'num_blks' if they all are. Returns 0 if bp is NULL or either
+ * size is <= 0. Useful for skipping zeroed blocks (e.g. sparse writes). */
+int sg_first_non_zero_blk(const uint8_t * bp, int blk_sz, int num_blks);
+
+/* Returns the CRC32C (Castagnoli, as used by iSCSI) of the b_len bytes
+ * starting at bp, continuing from 'crc' which should be 0 for the first
+ * (or only) piece. Uses the CPU's CRC32 instruction (e.g. x86 SSE4.2 or
+ * the Arm CRC extension) when available. Returns 'crc' if bp is NULL or
+ * b_len <= 0. */
+uint32_t sg_crc32c(uint32_t crc, const uint8_t * bp, int b_len);
+
+/* Length of a protection information (PI) tuple: a 2 byte guard tag, a 2
+ * byte application tag and a 4 byte reference tag, all big endian. */
+#define SG_T10_PI_LEN 8
+
+/* Returns the T10-DIF CRC16 (polynomial 0x8bb7) of the b_len bytes starting
+ * at bp, continuing from 'crc' which should be 0 for the first (or only)
+ * piece. This is the guard tag of PI. Uses carry-less multiply (x86
+ * PCLMULQDQ) when available. Returns 'crc' if bp is NULL or b_len <= 0. */
+uint16_t sg_t10_crc16(uint16_t crc, const uint8_t * bp, int b_len);
+
+/* The following act on 'num_blks' logical blocks each 'blk_sz' bytes long
+ * and, except for sg_t10_pi_expand() and sg_t10_pi_strip(), each followed
+ * by a PI tuple (i.e. every (blk_sz + 8) bytes) as found in the data
+ * buffers of READ and WRITE commands with RDPROTECT or WRPROTECT set. The
+ * reference tag of the first block is 'ref_tag' and increments for
+ * subsequent blocks, except for PI type 3 (pi_type == 3) where it stays
+ * the same. */
+
+/* Computes the guard tag of each block then writes the PI tuples. */
+void sg_t10_pi_gen(uint8_t * bp, int blk_sz, int num_blks, uint16_t app_tag,
+                   uint32_t ref_tag, int pi_type);
+
+/* Only writes the reference tag of each PI tuple (e.g. when copying PI from
+ * one LBA to another). */
+void sg_t10_pi_set_ref(uint8_t * bp, int blk_sz, int num_blks,
+                       uint32_t ref_tag, int pi_type);
+
+/* Checks the guard tag of each block and, unless pi_type is 3, the
+ * reference tag. Blocks whose application tag is 0xffff (and for type 3
+ * whose reference tag is 0xffffffff) are not checked. Returns 0 if all is
+ * well, 1 for a guard tag mismatch or 3 for a reference tag mismatch (the
+ * ASCQs that a device would report with ASC 0x10). If bad_blkp is
+ * non-NULL the index of the first bad block (or num_blks) is written to
+ * it. */
+int sg_t10_pi_chk(const uint8_t * bp, int blk_sz, int num_blks,
+                  uint32_t ref_tag, int pi_type, int * bad_blkp);
+
+/* Moves 'num_blks' contiguous blocks apart, in place, to leave a gap of
+ * 8 bytes (for a PI tuple) after each. The buffer must be at least
+ * num_blks * (blk_sz + 8) bytes long. The gaps are not initialized. */
+void sg_t10_pi_expand(uint8_t * bp, int blk_sz, int num_blks);
+
+/* The reverse of sg_t10_pi_expand(): removes the PI tuple after each block
+ * so the blocks become contiguous. */
+void sg_t10_pi_strip(uint8_t * bp, int blk_sz, int num_blks);
+
 /* Extract character sequence from ATA words as in the model string
  * in a IDENTIFY DEVICE response. Returns number of characters
  * written to 'ochars' before 0 character is found or 'num' words
@@ -597,6 +840,39 @@ bool sg_all_ffs(const uint8_t * bp, int b_len);
 int sg_ata_get_chars(const uint16_t * word_arr, int start_word,
                      int num_words, bool is_big_endian, char * ochars);
 
+/* Commonly needed fields of an ATA IDENTIFY (PACKET) DEVICE response. The
+ * strings have their space padding removed and are null terminated.
+ * num_lbs is the number of user addressable logical blocks (from words 100
+ * to 103 when 48 bit addressing is supported, else words 60 and 61),
+ * lb_sz and pb_sz are the logical and physical block sizes in bytes.
+ * sata_gen is the fastest signalling speed supported (1: 1.5 Gbps, 2: 3
+ * Gbps, 3: 6 Gbps), 0 if not reported. rotation is the nominal media
+ * rotation rate in rpm, 1 for non-rotating media, 0 if not reported. */
+struct sg_ata_ident_t {
+    bool atapi;         /* word 0, bit 15 set: IDENTIFY PACKET DEVICE */
+    bool lba48;         /* word 83, bit 10 */
+    bool smart;         /* word 82, bit 0 */
+    bool security;      /* word 82, bit 1 */
+    bool ncq;           /* word 76, bit 8 */
+    bool trim;          /* word 169, bit 0 (DATA SET MANAGEMENT) */
+    bool sanitize;      /* word 59, bit 12 */
+    int sata_gen;
+    int rotation;
+    uint32_t lb_sz;
+    uint32_t pb_sz;
+    uint64_t num_lbs;
+    uint64_t wwn;       /* words 108 to 111, 0 if not available */
+    char model[41];     /* words 27 to 46 */
+    char serial[21];    /* words 10 to 19 */
+    char fw_rev[9];     /* words 23 to 26 */
+};
+
+/* Decodes the 512 byte ATA IDENTIFY (PACKET) DEVICE response 'resp' (as
+ * returned by the device, so little endian words) into *aip. Returns 0, or
+ * -1 if resp_len is less than 512 (then *aip is zeroed). */
+int sg_ata_ident_decode(const uint8_t * resp, int resp_len,
+                        struct sg_ata_ident_t * aip);
+
 /* Print (to stdout) 16 bit 'words' in hex, 8 words per line optionally
  * followed at the right hand side of the line with an ASCII interpretation
  * (pairs of ASCII characters in big endian order (upper first)).
@@ -657,6 +933,35 @@ int64_t sg_get_llnum_nomult(const char * buf);
 uint8_t * sg_memalign(uint32_t num_bytes, uint32_t align_to,
                       uint8_t ** buff_to_free, bool vb);
 
+/* Pool backed allocator for large, long lived transfer buffers. On Linux
+ * buffers of 1 MiB or more prefer huge pages: 1 GiB hugetlb pages for
+ * 1 GiB or more, then default size hugetlb pages, then a 2 MiB aligned
+ * mapping with MADV_HUGEPAGE (transparent huge pages). Smaller buffers, and
+ * other OSes, get page aligned memory. If 'lock' is true the buffer is
+ * mlock()-ed (pinned) when permitted. Returns NULL if out of memory.
+ * sg_hugebuf_put() returns a buffer to the pool: a later sg_hugebuf_get()
+ * of no more than its size may reuse it, so its contents are zeroed only
+ * when newly allocated. sg_hugebuf_pool_free() releases all buffers not
+ * in use. All three may be called from several threads. */
+uint8_t * sg_hugebuf_get(uint32_t num_bytes, bool lock, bool vb);
+void sg_hugebuf_put(uint8_t * bp);
+void sg_hugebuf_pool_free(void);
+
+/* Builds the READ (or if write_true, WRITE) cdb of cdb_sz bytes (6, 10, 12
+ * or 16) for 'blocks' logical blocks starting at start_block, with the DPO
+ * and FUA bits as given. This is the data transfer command of the copy
+ * utilities (sg_dd, sgm_dd, sgp_dd, sgh_dd and sg_read). Returns 0, or 1
+ * with a message (starting with leadin if it is non-NULL) sent to
+ * sg_warnings_strm when the cdb size is not supported or the arguments do
+ * not fit it. */
+int sg_build_rw_cdb(uint8_t * cdbp, int cdb_sz, uint32_t blocks,
+                    int64_t start_block, bool write_true, bool fua, bool dpo,
+                    const char * leadin);
+
+/* Returns the opcode that sg_build_rw_cdb() places in a cdb of cdb_sz
+ * bytes; that of READ(10) or WRITE(10) if cdb_sz is not supported. */
+int sg_rw_opcode(int cdb_sz, bool write_true);
+
 /* Returns OS page size in bytes. If uncertain returns 4096. */
 uint32_t sg_get_page_size(void);
 
@@ -686,6 +991,37 @@ void sg_set_big_endian(uint64_t val, uint8_t * to, int start_bit /* 0 to 7 */,
  * os_err_num is 0 then 0 is returned. */
 int sg_convert_errno(int os_err_num);
 
+/* An index, sorted by acronym, of a table of structures that each hold a
+ * 'const char *' acronym at byte offset acron_off (e.g. the VPD page, log
+ * page and SES field tables in the utilities) so that acronym lookup is a
+ * binary search rather than a scan. The caller supplies ent_arr with room
+ * for num_elems entries, typically a static array built on first use.
+ * Table elements with a NULL acronym are skipped. Entries with the same
+ * acronym stay in table order so sg_lib_acron_idx_find() yields the same
+ * element as a forward scan would. If nocase is true acronyms are
+ * compared ignoring (ASCII) case. */
+struct sg_lib_acron_ent {
+    const char * acron;
+    int ind;            /* index of table element holding acron */
+};
+
+struct sg_lib_acron_idx {
+    bool nocase;
+    int num;            /* number of valid entries in arr */
+    struct sg_lib_acron_ent * arr;      /* NULL until built */
+};
+
+void sg_lib_acron_idx_build(struct sg_lib_acron_idx * ip,
+                            struct sg_lib_acron_ent * ent_arr,
+                            const void * tbl, int num_elems, size_t elem_sz,
+                            size_t acron_off, bool nocase);
+
+/* Returns the position in ip->arr of the first entry whose acronym matches
+ * 'acron', any others that match follow it. Returns -1 if there is no
+ * match (or acron is NULL). */
+int sg_lib_acron_idx_find(const struct sg_lib_acron_idx * ip,
+                          const char * acron);
+
 
 /* <<< Architectural support functions [is there a better place?] >>> */
 
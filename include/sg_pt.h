@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,6 +28,8 @@ extern "C" {
  * with that instance. */
 struct sg_pt_base;
 
+struct sg_scsi_sense_info;      /* defined in sg_lib.h */
+
 
 /* The format of the version string is like this: "3.04 20180213".
  * The leading digit will be incremented if this interface changes
@@ -57,7 +60,8 @@ int scsi_pt_close_device(int device_fd);
  * device_name. Returns 1 if SCSI generic pass-though device, returns 2 if
  * secondary SCSI pass-through device (in Linux a bsg device); returns 3 is
  * char NVMe device (i.e. no NSID); returns 4 if block NVMe device (includes
- * NSID), or 0 if something else (e.g. ATA block device) or dev_fd < 0.
+ * NSID; in Linux also a NVMe generic char device such as /dev/ng0n1), or
+ * 0 if something else (e.g. ATA block device) or dev_fd < 0.
  * If error, returns negated errno (operating system) value. */
 int check_pt_file_handle(int dev_fd, const char * device_name, int verbose);
 
@@ -96,6 +100,14 @@ int get_pt_file_handle(const struct sg_pt_base * objp);
  * Use set_pt_file_handle() to change dev_fd. */
 void clear_scsi_pt_obj(struct sg_pt_base * objp);
 
+/* Lighter alternative to clear_scsi_pt_obj() for loops that issue similar
+ * commands on one object. The sense and data buffer bindings, the packet id,
+ * the dev_fd and the device type found from it are kept; the cdb binding
+ * and the results of the previous command are reset. So set_scsi_pt_cdb()
+ * should be called again (e.g. with a new LBA in the cdb) before the next
+ * do_scsi_pt(). The sense buffer is zeroed. */
+void rearm_scsi_pt_obj(struct sg_pt_base * objp);
+
 /* Set the CDB (command descriptor block). May also be a NVMe Admin command
  * which will be 64 bytes long.
  *
@@ -119,6 +131,54 @@ void set_scsi_pt_data_in(struct sg_pt_base * objp,   /* from device */
 void set_scsi_pt_data_out(struct sg_pt_base * objp,    /* to device */
                           const uint8_t * dxferp, int dxfer_olen);
 
+/* One element of a scatter gather list. Same layout as POSIX 'struct
+ * iovec' and the Linux sg driver's sg_iovec so arrays of either can be
+ * cast to this type. */
+struct sg_pt_iovec {
+    void * iov_base;
+    size_t iov_len;
+};
+
+/* Like set_scsi_pt_data_in() and set_scsi_pt_data_out() but the data is
+ * spread over the iov_count elements of the iovp array whose lengths are
+ * summed to give the transfer length. The array and what it points to
+ * must stay valid until the command completes. The OS pass-through is
+ * given the list when it can take one (e.g. Linux sg and FreeBSD CAM);
+ * otherwise (e.g. NVMe) the data goes through a bounce buffer. */
+void set_scsi_pt_data_in_iov(struct sg_pt_base * objp,
+                             const struct sg_pt_iovec * iovp, int iov_count);
+void set_scsi_pt_data_out_iov(struct sg_pt_base * objp,
+                              const struct sg_pt_iovec * iovp,
+                              int iov_count);
+
+/* Following is a guard which is defined when set_scsi_pt_data_in_mmap()
+ * is present. Older versions of this library may not have it. */
+#define SCSI_PT_DATA_IN_MMAP_FUNCTION 1
+/* Maps the pass-through's kernel buffer for the device associated with
+ * objp into user space (in Linux, the sg driver's reserved buffer, which
+ * is enlarged to dxfer_ilen bytes if needed) and binds it as the data-in
+ * buffer, as set_scsi_pt_data_in() would. The data then arrives there
+ * without being copied by the kernel. The mapping is kept until the
+ * object is destructed or given another device, so after
+ * clear_scsi_pt_obj() the returned pointer may be bound again with
+ * set_scsi_pt_data_in() for the next command. Only one command using the
+ * mapping may be outstanding per file descriptor. Returns the mapped
+ * address or NULL if not available (e.g. not a sg device or another OS);
+ * the caller should then fall back to its own buffer. */
+uint8_t * set_scsi_pt_data_in_mmap(struct sg_pt_base * objp, int dxfer_ilen,
+                                   int verbose);
+
+/* Helpers for scatter gather lists. sg_pt_iov_len() returns the sum of
+ * the element lengths (or -1 if that does not fit in an int).
+ * sg_pt_iov_gather() copies the list's data into bp which must be large
+ * enough. sg_pt_iov_scatter() copies up to len bytes from bp into the
+ * list. */
+int sg_pt_iov_len(const struct sg_pt_iovec * iovp, int iov_count);
+void sg_pt_iov_gather(const struct sg_pt_iovec * iovp, int iov_count,
+                      uint8_t * bp);
+void sg_pt_iov_scatter(const struct sg_pt_iovec * iovp, int iov_count,
+                       const uint8_t * bp, int len);
+
 /* Set a pointer and length to be used for metadata transferred to
  * (out_true=true) or from (out_true=false) device (NVMe only) */
 void set_pt_metadata_xfer(struct sg_pt_base * objp, uint8_t * mdxferp,
@@ -131,6 +191,18 @@ void set_scsi_pt_task_management(struct sg_pt_base * objp, int tmf_code);
 void set_scsi_pt_task_attr(struct sg_pt_base * objp, int attribute,
                            int priority);
 
+/* Following is a guard which is defined when set_scsi_pt_transport_req()
+ * is present. Older versions of this library may not have this function. */
+#define SCSI_PT_TRANSPORT_REQ_FUNCTION 1
+/* Used in place of set_scsi_pt_cdb() to address the transport rather than
+ * a logical unit: 'reqp' is the transport specific request (e.g. 16 zeroed
+ * bytes for SAS SMP, a struct fc_bsg_request for FC) and the frames
+ * themselves go via set_scsi_pt_data_out() and set_scsi_pt_data_in().
+ * Only Linux bsg transport nodes (e.g. /dev/bsg/expander-6:0) accept
+ * this; elsewhere the command fails with SCSI_PT_DO_BAD_PARAMS . */
+void set_scsi_pt_transport_req(struct sg_pt_base * objp,
+                               const uint8_t * reqp, int req_len);
+
 /* Following is a guard which is defined when set_scsi_pt_flags() is
  * present. Older versions of this library may not have this function. */
 #define SCSI_PT_FLAGS_FUNCTION 1
@@ -138,6 +210,12 @@ void set_scsi_pt_task_attr(struct sg_pt_base * objp, int attribute,
  * are given, use the pass-through default. */
 #define SCSI_PT_FLAGS_QUEUE_AT_TAIL 0x10
 #define SCSI_PT_FLAGS_QUEUE_AT_HEAD 0x20
+/* Request polled (rather than interrupt driven) completion, where the OS
+ * and device support it: SGV4_FLAG_HIPRI with the Linux sg v4 driver, or
+ * an io_uring set up with IORING_SETUP_IOPOLL for NVMe char devices. Then
+ * do_scsi_pt_receive() spins rather than sleeping while it waits. This
+ * flag is ignored elsewhere. */
+#define SCSI_PT_FLAGS_HIPRI 0x40
 /* Set (potentially OS dependent) flags for pass-through mechanism.
  * Apart from contradictions, flags can be OR-ed together. */
 void set_scsi_pt_flags(struct sg_pt_base * objp, int flags);
@@ -145,6 +223,7 @@ void set_scsi_pt_flags(struct sg_pt_base * objp, int flags);
 #define SCSI_PT_DO_START_OK 0
 #define SCSI_PT_DO_BAD_PARAMS 1
 #define SCSI_PT_DO_TIMEOUT 2
+#define SCSI_PT_DO_NOT_SUPPORTED 4
 #define SCSI_PT_DO_NVME_STATUS 48       /* == SG_LIB_NVME_STATUS */
 /* If OS error prior to or during command submission then returns negated
  * error value (e.g. Unix '-errno'). This includes interrupted system calls
@@ -157,6 +236,98 @@ void set_scsi_pt_flags(struct sg_pt_base * objp, int flags);
 int do_scsi_pt(struct sg_pt_base * objp, int fd, int timeout_secs,
                int verbose);
 
+/* A negative 'timeout_secs' given to do_scsi_pt() or do_scsi_pt_submit()
+ * is a timeout in milliseconds (its absolute value), as has long been the
+ * case for NVMe devices. Pass-throughs that only take seconds round it up.
+ * sg_pt_timeout_ms() returns a 'timeout_secs' value in milliseconds, or
+ * 'def_ms' if it is 0. */
+#define SG_PT_TIMEOUT_MS(ms) (-(int)(ms))
+uint32_t sg_pt_timeout_ms(int timeout_secs, uint32_t def_ms);
+
+/* Following is a guard which is defined when do_scsi_pt_submit() and
+ * do_scsi_pt_receive() are present. Older versions of this library may
+ * not have these functions. */
+#define SCSI_PT_ASYNC_FUNCTIONS 1
+/* Asynchronous (non-blocking) variant of do_scsi_pt(). Only submits the
+ * command described by 'objp' to the pass-through and returns without
+ * waiting for it to complete. Arguments and return values are the same as
+ * for do_scsi_pt(); 0 means the command was submitted. It is the caller's
+ * responsibility to keep the cdb, sense and data buffers (and objp) valid
+ * until do_scsi_pt_receive() has completed the command. When several
+ * commands are in flight on the same device file descriptor, each should
+ * be given a distinct pack_id with set_scsi_pt_packet_id() beforehand.
+ * If the pass-through (e.g. OS or device type) has no asynchronous
+ * mechanism then the command is executed synchronously by this function
+ * and the matching do_scsi_pt_receive() returns 0 immediately. In Linux
+ * the sg driver is asynchronous, as are bsg nodes (including transport
+ * nodes, see set_scsi_pt_transport_req()) opened O_RDWR on kernels that
+ * still offer the bsg write() and read() interface. */
+int do_scsi_pt_submit(struct sg_pt_base * objp, int fd, int timeout_secs,
+                      int verbose);
+
+/* Fetches the response of a command previously submitted with
+ * do_scsi_pt_submit() on the same 'objp'. If 'no_wait' is false this
+ * function blocks until that command completes. If 'no_wait' is true and
+ * the command has not yet completed then -EAGAIN is returned and this
+ * function may be called again later. Otherwise return values are as for
+ * do_scsi_pt() and, when 0 is returned, the get_scsi_pt_*() and get_pt_*()
+ * functions can be used to examine the result of the command. The file
+ * descriptor from get_pt_file_handle() may be given to poll() or select()
+ * to learn when some response is ready. */
+int do_scsi_pt_receive(struct sg_pt_base * objp, bool no_wait, int verbose);
+
+/* Following is a guard which is defined when do_scsi_pt_batch() is
+ * present. Older versions of this library may not have this function. */
+#define SCSI_PT_BATCH_FUNCTION 1
+/* Issues the 'num' commands held in objp_arr[0] to objp_arr[num - 1] and
+ * waits for all of them to complete. Each object should be set up as it
+ * would be for do_scsi_pt() and all must be associated with the same
+ * device file descriptor (e.g. by construct_scsi_pt_obj_with_fd() ).
+ * Where the pass-through permits (e.g. the Linux sg v4 driver's multiple
+ * requests) the whole batch is given to the OS in one system call,
+ * otherwise the commands are queued together (if possible) or executed
+ * one after the other. Returns 0 if all commands were issued; each
+ * object's result should then be checked in the same way as after
+ * do_scsi_pt(). Otherwise stops at the first object that could not be
+ * issued and returns the same value do_scsi_pt() would have. If
+ * 'num_donep' is not NULL then the number of objects issued is written
+ * there. */
+int do_scsi_pt_batch(struct sg_pt_base * objp_arr[], int num,
+                     int timeout_secs, int * num_donep, int verbose);
+
+/* Following is a guard which is defined when scsi_pt_share_fds(),
+ * scsi_pt_unshare_fds() and do_scsi_pt_shared_rw() are present. Older
+ * versions of this library may not have these functions. */
+#define SCSI_PT_SHARE_FUNCTIONS 1
+/* Sets up request sharing between two open pass-through file descriptors
+ * which may be to different devices. Then data read by a command on
+ * 'rd_fd' can be written by a command on 'wr_fd' directly from the kernel
+ * buffer, without being copied to or from user space. In Linux this needs
+ * the sg v4 driver on both (the driver calls 'rd_fd' the master side and
+ * 'wr_fd' the slave side). A file descriptor may take part in only one
+ * share at a time. Returns 0 on success, SCSI_PT_DO_NOT_SUPPORTED if the
+ * pass-through has no such mechanism, else a negated errno. */
+int scsi_pt_share_fds(int rd_fd, int wr_fd, int verbose);
+
+/* Undoes the share that 'fd' (either side) is part of. Closing either
+ * file descriptor also undoes it. Returns as for scsi_pt_share_fds(). */
+int scsi_pt_unshare_fds(int fd, int verbose);
+
+/* Issues the READ-like command set up in 'rd_objp' on the 'rd_fd' side of
+ * a share and, if it completes with GOOD status and no residual, then the
+ * WRITE-like command in 'wr_objp' on the 'wr_fd' side which takes its
+ * 'num_bytes' of data-out from the kernel buffer the READ filled. A data-in
+ * buffer bound to rd_objp (optional) also gets a copy of the data while
+ * wr_objp should have no data-out buffer bound. This function sets the
+ * transfer lengths and sharing flags of both objects; reuse them only via
+ * this function (or after clear_scsi_pt_obj() ). If 'wr_issuedp' is not
+ * NULL then it is set to whether the WRITE was issued. Returns the value
+ * do_scsi_pt() gave for the last command issued; check each issued
+ * object's result as after do_scsi_pt(). */
+int do_scsi_pt_shared_rw(struct sg_pt_base * rd_objp,
+                         struct sg_pt_base * wr_objp, int num_bytes,
+                         int timeout_secs, bool * wr_issuedp, int verbose);
+
 #define SCSI_PT_RESULT_GOOD 0
 #define SCSI_PT_RESULT_STATUS 1 /* other than GOOD and CHECK CONDITION */
 #define SCSI_PT_RESULT_SENSE 2
@@ -195,6 +366,24 @@ uint32_t get_pt_result(const struct sg_pt_base * objp);
 int get_scsi_pt_sense_len(const struct sg_pt_base * objp);
 uint8_t * get_scsi_pt_sense_buf(const struct sg_pt_base * objp);
 
+/* Sense data of the command just completed decoded by
+ * sg_scsi_decode_sense(). On Linux this is done at most once per
+ * completion and kept in the object, so repeated calls (and calls from
+ * several layers handling the same completion) do not parse the sense
+ * buffer again. Returns NULL if there is no valid sense data. Do not use
+ * the returned pointer after the object is next submitted, rearmed or
+ * cleared. Elsewhere each call decodes into per thread storage (one copy
+ * for the process when the compiler lacks thread local storage) so the
+ * pointer is only valid until the next get_scsi_pt_sense_info() or
+ * get_scsi_pt_sense_category() call; copy the structure to keep it. */
+const struct sg_scsi_sense_info * get_scsi_pt_sense_info(
+                                        const struct sg_pt_base * objp);
+
+/* Returns the SG_LIB_CAT_* value sg_err_category_sense() would give for the
+ * sense data of the command just completed, from the same cached decode as
+ * get_scsi_pt_sense_info(). */
+int get_scsi_pt_sense_category(const struct sg_pt_base * objp);
+
 /* If not available return 0 (for success). */
 int get_scsi_pt_os_err(const struct sg_pt_base * objp);
 char * get_scsi_pt_os_err_str(const struct sg_pt_base * objp, int max_b_len,
@@ -235,6 +424,76 @@ bool pt_device_is_nvme(const struct sg_pt_base * objp);
  * 0xffffffe). Otherwise 0 is returned. */
 uint32_t get_pt_nvme_nsid(const struct sg_pt_base * objp);
 
+/* Following is a guard which is defined when get_pt_nvme_max_xfer() and
+ * sg_pt_nvme_get_log() are present. Older versions of this library may
+ * not have these functions. */
+#define SCSI_PT_NVME_LOG_FUNCTIONS 1
+/* Returns the largest data transfer (in bytes) that the NVMe controller
+ * associated with 'objp' accepts, from the MDTS field of its (cached)
+ * Identify controller response, which is fetched if need be. MDTS is in
+ * units of CAP.MPSMIN which is taken to be 4096 bytes. Returns UINT32_MAX
+ * if the controller reports no limit and 0 if that is not known (e.g. not
+ * a NVMe device, or the pass-through has no Identify cache). */
+uint32_t get_pt_nvme_max_xfer(struct sg_pt_base * objp, int timeout_secs,
+                              int verbose);
+
+/* Fetches 'log_len' bytes of the NVMe log page 'lid' (with log specific
+ * field 'lsp', log specific identifier 'lsi' and namespace 'nsid') from
+ * the NVMe device open on 'dev_fd'. Long logs (e.g. Telemetry and the
+ * Persistent Event log) are read in chunks no larger than 'max_chunk'
+ * bytes (0: as large as get_pt_nvme_max_xfer() allows) at increasing log
+ * page offsets, with up to 'qd' chunks in flight (each on its own pt
+ * object, see do_scsi_pt_submit()). 'log_len' is rounded up to a multiple
+ * of 4. Chunks are delivered in order: copied to bp (if not NULL, it must
+ * hold the rounded up 'log_len') and/or written to 'out_fd' (if >= 0).
+ * RAE (retain asynchronous event) is set on all but the last chunk, that
+ * one takes 'rae'. For Telemetry Host-Initiated the Create bit in
+ * 'lsp' should be used on a separate (header) fetch, otherwise each chunk
+ * would create a new snapshot. If 'fetchedp' is not NULL the number of
+ * bytes delivered is written there. Returns 0 on success, a negated errno
+ * for OS errors, SG_LIB_NVME_STATUS if a command failed with a NVMe status
+ * (verbose > 0 shows it), else a SCSI_PT_DO_* value. */
+int sg_pt_nvme_get_log(int dev_fd, uint8_t lid, uint8_t lsp, uint16_t lsi,
+                       uint32_t nsid, bool rae, uint64_t log_len,
+                       uint32_t max_chunk, int qd, uint8_t * bp, int out_fd,
+                       uint64_t * fetchedp, int timeout_secs, int verbose);
+
+/* One NVMe namespace as found by sg_pt_nvme_enum_ns() */
+struct sg_pt_nvme_ns {
+    uint32_t nsid;
+    int status;             /* 0, else as sg_pt_nvme_get_log() returns */
+    uint32_t lb_size;       /* logical block size in bytes */
+    uint64_t num_lbs;       /* NSZE: READ CAPACITY(16)'s last LBA + 1 */
+    const uint8_t * id_nsp; /* Identify namespace response (4096 bytes) */
+    int devid_len;          /* of devid: a VPD page 0x83 equivalent */
+    uint8_t devid[256];
+};
+
+/* What sg_pt_nvme_enum_ns() found on one NVMe controller */
+struct sg_pt_nvme_enum {
+    bool active_list;       /* nsp follows the Active Namespace ID list,
+                             * else it holds NSIDs 1 to max_nsid */
+    uint32_t max_nsid;      /* NN field of Identify controller */
+    int num_ns;             /* number of elements in nsp */
+    uint8_t inq[36];        /* standard INQUIRY response equivalent */
+    const uint8_t * id_ctlp;    /* Identify controller response */
+    struct sg_pt_nvme_ns * nsp;
+    uint8_t * free_id_ctlp;     /* the rest is for sg_pt_nvme_enum_free() */
+    uint8_t * free_id_nsp;
+};
+
+/* Enumerates the namespaces of the NVMe controller open on 'dev_fd'
+ * (e.g. /dev/nvme0), identifying the controller once and then issuing
+ * Identify namespace for each active NSID with up to 'qd' of them in
+ * flight. For each namespace the equivalents of READ CAPACITY(16) and of
+ * the Device Identification VPD page are given, the standard INQUIRY
+ * equivalent is common to all. Returns 0 when *ep is filled (individual
+ * namespaces may still have a non-zero status), else as
+ * sg_pt_nvme_get_log() does. Always call sg_pt_nvme_enum_free() after. */
+int sg_pt_nvme_enum_ns(int dev_fd, struct sg_pt_nvme_enum * ep, int qd,
+                       int timeout_secs, int verbose);
+void sg_pt_nvme_enum_free(struct sg_pt_nvme_enum * ep);
+
 
 /* Should be invoked once per objp after other processing is complete in
  * order to clean up resources. For ever successful construct_scsi_pt_obj()
@@ -245,6 +504,202 @@ uint32_t get_pt_nvme_nsid(const struct sg_pt_base * objp);
  * scsi_pt_close_device() ).  */
 void destruct_scsi_pt_obj(struct sg_pt_base * objp);
 
+/* Opt-in per-command latency histograms, kept per device file descriptor
+ * and per opcode (first byte of the cdb; 0x100 is added for NVMe commands
+ * given directly). Enabled by sg_pt_lat_enable(true) or by setting the
+ * SG3_UTILS_PT_LATENCY environment variable. Each histogram is log-linear
+ * with 8 buckets per power of 2, so percentiles are within about 6% of the
+ * true value. */
+#define SCSI_PT_LATENCY_FUNCTIONS 1
+
+/* Returns the previous setting. */
+bool sg_pt_lat_enable(bool enable);
+
+/* Returns true if enabled by sg_pt_lat_enable() or the environment. */
+bool sg_pt_lat_is_enabled(void);
+
+/* Monotonic clock in nanoseconds, for timing a command to be passed to
+ * sg_pt_lat_record(). Returns 0 if no suitable clock is available. */
+uint64_t sg_pt_lat_now_ns(void);
+
+/* Adds one command taking dur_ns nanoseconds. Called by do_scsi_pt() on
+ * OSes where it is instrumented; utilities that issue commands directly
+ * (e.g. with ioctl(SG_IO) ) may also call it. Does nothing if disabled. */
+void sg_pt_lat_record(int dev_fd, int opcode, uint64_t dur_ns);
+
+struct sg_pt_lat_summary {
+    uint64_t count;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+};
+
+/* Fills *sp for the histogram of (dev_fd, opcode) and returns 0, or
+ * returns -1 if no commands have been recorded for that pair. If dev_fd
+ * is negative the histograms of all file descriptors are combined for
+ * that opcode (e.g. when several threads each have their own). */
+int sg_pt_lat_get(int dev_fd, int opcode, struct sg_pt_lat_summary * sp);
+
+/* Writes the histogram of (dev_fd, opcode) into b (of length blen), one
+ * line per power of 2 nanoseconds with its count, percentage, cumulative
+ * percentage and a bar. A negative dev_fd combines them as for
+ * sg_pt_lat_get(). Returns the number of characters written, excluding
+ * the trailing NUL; 0 if nothing has been recorded. */
+int sg_pt_lat_hist_str(int dev_fd, int opcode, int blen, char * b);
+
+/* Writes a table, one line per (dev_fd, opcode) pair, into b (of length
+ * blen). Returns the number of characters written, excluding the
+ * trailing NUL. */
+int sg_pt_lat_report(int blen, char * b);
+
+/* Discards all recorded latencies. */
+void sg_pt_lat_reset(void);
+
+/* Opt-in capture of the commands issued into a compact binary trace file,
+ * for later replay by the sg_replay utility. Started by sg_pt_trace_open()
+ * or by setting the SG3_UTILS_PT_TRACE environment variable to the name of
+ * the trace file (which is truncated). Each record holds the cdb, the
+ * data-in and data-out lengths (not the data), the start time relative to
+ * the start of the trace, the duration, the SCSI status, and the sense key,
+ * ASC and ASCQ. All fields are little endian. The file starts with a
+ * SG_PT_TRACE_HDR_LEN byte header whose first 8 bytes are SG_PT_TRACE_MAGIC
+ * followed by records each of SG_PT_TRACE_REC_LEN bytes then the cdb. */
+#define SCSI_PT_TRACE_FUNCTIONS 1
+
+#define SG_PT_TRACE_MAGIC "SGPTTRC1"
+#define SG_PT_TRACE_HDR_LEN 16
+#define SG_PT_TRACE_REC_LEN 40          /* without the cdb */
+#define SG_PT_TRACE_MAX_CDB_LEN 256
+
+#define SG_PT_TRACE_F_NVME 0x1          /* cdb is a NVMe command */
+
+struct sg_pt_trace_rec {
+    int dev_fd;
+    int cdb_len;
+    int din_len;
+    int dout_len;
+    int status;         /* SCSI status (or NVMe status if F_NVME) */
+    int flags;          /* SG_PT_TRACE_F_* bits */
+    uint8_t sense_key;
+    uint8_t asc;
+    uint8_t ascq;
+    uint64_t start_ns;  /* relative to the start of the trace */
+    uint64_t dur_ns;
+    uint8_t cdb[SG_PT_TRACE_MAX_CDB_LEN];
+};
+
+/* Starts a trace into the file fname, ending any current trace first.
+ * Returns 0 if successful, else a negated errno. */
+int sg_pt_trace_open(const char * fname);
+
+/* Flushes and ends the current trace, if any. Also called at exit. */
+void sg_pt_trace_close(void);
+
+/* Returns true if a trace is active, from sg_pt_trace_open() or the
+ * environment. */
+bool sg_pt_trace_is_enabled(void);
+
+/* Appends a record for a command that started at start_ns (from
+ * sg_pt_lat_now_ns() ) and took dur_ns nanoseconds. Called by do_scsi_pt()
+ * on OSes where it is instrumented. Thread safe. Does nothing if no trace
+ * is active or cdb_len exceeds SG_PT_TRACE_MAX_CDB_LEN. */
+void sg_pt_trace_record(int dev_fd, const uint8_t * cdbp, int cdb_len,
+                        int din_len, int dout_len, int flags,
+                        uint64_t start_ns, uint64_t dur_ns, int status,
+                        const uint8_t * sbp, int sb_len);
+
+/* Returns 0 if the blen bytes at bp are a valid trace file header, else
+ * -1. */
+int sg_pt_trace_check_hdr(const uint8_t * bp, int blen);
+
+/* Decodes the record at bp (with blen bytes available) into *rp. Returns
+ * the length of the record (> 0), 0 if more than blen bytes are needed, or
+ * -1 if the record is malformed. */
+int sg_pt_trace_decode(const uint8_t * bp, int blen,
+                       struct sg_pt_trace_rec * rp);
+
+/* Adaptive queue depth controller for pipelined workloads. Uses additive
+ * increase, multiplicative decrease (AIMD) on the SCSI status (BUSY and
+ * TASK SET FULL) and on a smoothed command latency to choose how many
+ * commands to keep in flight to a device. Not thread safe: callers that
+ * share one instance between threads must serialize access to it. */
+#define SCSI_PT_QDEPTH_FUNCTIONS 1
+
+struct sg_pt_qdepth {
+    int depth;          /* current number of commands allowed in flight */
+    int min_depth;
+    int max_depth;
+    int good;           /* good completions since depth last changed */
+    int hold;           /* completions to go before another decrease */
+    uint64_t target_ns; /* 0 -> only BUSY and TASK SET FULL decrease */
+    uint64_t ewma_ns;   /* smoothed latency of good completions */
+    uint64_t busy_count;
+    uint64_t ts_full_count;
+    uint64_t increases;
+    uint64_t decreases;
+};
+
+/* Starts at min_depth (at least 1); depth never exceeds max_depth. If
+ * target_ns is non-zero then a smoothed latency over it also reduces. */
+void sg_pt_qdepth_init(struct sg_pt_qdepth * qdp, int min_depth,
+                       int max_depth, uint64_t target_ns);
+
+/* Feeds one completion with SCSI status scsi_status that took lat_ns
+ * nanoseconds (0 if unknown). Returns the new depth. */
+int sg_pt_qdepth_update(struct sg_pt_qdepth * qdp, int scsi_status,
+                        uint64_t lat_ns);
+
+/* As sg_pt_qdepth_update() taking the status from objp after
+ * do_scsi_pt() or do_scsi_pt_receive(). Transport and OS errors are
+ * ignored. */
+int sg_pt_qdepth_update_pt(struct sg_pt_qdepth * qdp,
+                           const struct sg_pt_base * objp, uint64_t lat_ns);
+
+/* Token bucket rate limiter for background work (e.g. copies and verifies
+ * run alongside production I/O). Limits bytes per second and/or commands
+ * per second; a caller that has used more than its share is told how long
+ * to wait. When target_ns is non-zero a smoothed command latency over it
+ * halves both rates (down to 1/64 of them), and they recover by 1/16 per
+ * interval while the latency stays at or under target. Not thread safe:
+ * callers that share one instance between threads must serialize access
+ * to it (but should sleep outside that lock). */
+#define SCSI_PT_RATE_FUNCTIONS 1
+
+struct sg_pt_rate {
+    uint64_t bytes_ps;  /* bytes per second, 0 -> no limit */
+    uint64_t iops;      /* commands per second, 0 -> no limit */
+    uint64_t target_ns; /* 0 -> no latency backoff */
+    double byte_tokens; /* negative when in debt, paid off by waiting */
+    double cmd_tokens;
+    double scale;       /* fraction of the rates allowed: 1/64 to 1 */
+    uint64_t last_ns;   /* when tokens were last added */
+    uint64_t adj_ns;    /* when scale last changed */
+    uint64_t ewma_ns;   /* smoothed latency */
+    uint64_t waits;     /* commands that had to wait */
+    uint64_t wait_ns;   /* sum of those waits */
+    uint64_t backoffs;  /* latency reductions of scale */
+};
+
+/* Either or both of bytes_ps and iops may be 0 (no limit). The buckets
+ * start full, holding 1/8 second's worth. */
+void sg_pt_rate_init(struct sg_pt_rate * rp, uint64_t bytes_ps,
+                     uint64_t iops, uint64_t target_ns);
+
+/* Takes the tokens of one command moving num_bytes bytes. Returns the
+ * number of nanoseconds the caller should wait before issuing it, 0 to go
+ * now. */
+uint64_t sg_pt_rate_take(struct sg_pt_rate * rp, uint64_t num_bytes);
+
+/* Sleeps for wait_ns nanoseconds, as returned by sg_pt_rate_take() */
+void sg_pt_rate_sleep(uint64_t wait_ns);
+
+/* Feeds the duration (lat_ns nanoseconds) of a completed command to the
+ * latency backoff. Does nothing when target_ns is 0. */
+void sg_pt_rate_update(struct sg_pt_rate * rp, uint64_t lat_ns);
+
 #ifdef SG_LIB_WIN32
 #define SG_LIB_WIN32_DIRECT 1
 
@@ -15,6 +15,7 @@
 
 #include <linux/types.h>
 
+#include "sg_lib.h"
 #include "sg_pt_nvme.h"
 
 /* This header is for internal use by the sg3_utils library (libsgutils)
@@ -122,6 +123,15 @@ struct sg_pt_linux_scsi {
     bool nvme_stat_dnr; /* Do No Retry, part of completion status field */
     bool nvme_stat_more; /* More, part of completion status field */
     bool mdxfer_out;    /* direction of metadata xfer, true->data-out */
+    bool async_pack_id_forced;  /* SG_SET_FORCE_PACK_ID done on dev_fd */
+    bool use_uring;     /* NVMe char device: submit async via io_uring */
+    bool uring_inflight;        /* io_uring submission awaiting completion */
+    bool hipri;         /* SCSI_PT_FLAGS_HIPRI: polled completion wanted */
+    bool is_broker;     /* dev_fd is a connection to the sg_srvd daemon */
+    bool is_null;       /* dev_fd is a null device, see sg_pt_null.h */
+    bool null_inflight; /* null device command awaiting receive */
+    bool bsg_inflight;  /* queued on a bsg node with write() */
+    bool bsg_done;      /* its response was read() by another object */
     int dev_fd;                 /* -1 if not given (yet) */
     int in_err;
     int os_err;
@@ -136,11 +146,24 @@ struct sg_pt_linux_scsi {
                                  * The whole 16 byte completion q entry is
                                  * sent back as sense data */
     uint32_t mdxfer_len;
+    uint64_t lat_start_ns;      /* submit time when latency or trace on */
+    uint64_t null_done_ns;      /* when null device command "completes" */
     struct sg_sntl_dev_state_t dev_stat;
     void * mdxferp;
     uint8_t * nvme_id_ctlp;     /* cached response to controller IDENTIFY */
     uint8_t * free_nvme_id_ctlp;
+    void * nvme_idcp;           /* reference into shared Identify cache */
+    uint32_t nvme_dev_key;      /* device type+major+minor, 0: unknown */
+    void * uringp;              /* io_uring instance, see sg_pt_linux_nvme.c */
+    uint8_t * mmap_bp;          /* sg reserved buffer mapped to user space */
+    int mmap_len;               /* length of mmap_bp, 0 when not mapped */
     uint8_t tmf_request[4];
+    uint8_t nvme_lbads;         /* log2(namespace LB size), 0: not fetched */
+    bool sinfo_done;            /* 'sinfo' decoded since last submit */
+    bool sinfo_ok;              /* and held valid sense data */
+    int sinfo_len;              /* response_len when 'sinfo' decoded */
+    int sinfo_cat;              /* SG_LIB_CAT_* derived from 'sinfo' */
+    struct sg_scsi_sense_info sinfo;
 };
 
 struct sg_pt_base {
@@ -171,16 +194,89 @@ struct sg_pt_base {
 #ifndef NVME_IOCTL_SUBSYS_RESET
 #define NVME_IOCTL_SUBSYS_RESET _IO('N', 0x45)
 #endif
+/* struct nvme_uring_cmd has the same size as sg_nvme_passthru_cmd */
+#ifndef NVME_URING_CMD_IO
+#define NVME_URING_CMD_IO       _IOWR('N', 0x80, struct sg_nvme_passthru_cmd)
+#endif
+#ifndef NVME_URING_CMD_ADMIN
+#define NVME_URING_CMD_ADMIN    _IOWR('N', 0x82, struct sg_nvme_passthru_cmd)
+#endif
 
 extern bool sg_bsg_nvme_char_major_checked;
 extern int sg_bsg_major;
 extern volatile int sg_nvme_char_major;
+extern int sg_nvme_generic_major;
 extern long sg_lin_page_size;
 
 void sg_find_bsg_nvme_char_major(int verbose);
 int sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb);
+
+/* io_uring (IORING_OP_URING_CMD) submission of NVMe commands given
+ * directly (i.e. not translated by the SNTL). sg_nvme_uring_submit()
+ * returns 1 if io_uring is not available for this command, in which case
+ * the caller should use sg_do_nvme_pt() instead. */
+int sg_nvme_uring_submit(struct sg_pt_base * vp, int time_secs, int vb);
+int sg_nvme_uring_receive(struct sg_pt_base * vp, bool no_wait, int vb);
+void sg_nvme_uring_free(struct sg_pt_linux_scsi * ptp);
+
+/* Identify controller (and namespace) responses are shared between pt
+ * objects bound to the same NVMe device. sg_nvme_id_cache_put() drops the
+ * reference (or private copy) held by ptp. sg_nvme_id_cache_flush()
+ * invalidates all entries; those still referenced are freed on their last
+ * put. */
+void sg_nvme_id_cache_put(struct sg_pt_linux_scsi * ptp);
+void sg_nvme_id_cache_flush(void);
 int sg_linux_get_sg_version(const struct sg_pt_base * vp);
 
+/* Wire format between the library and the sg_srvd broker daemon, which
+ * keeps devices open and executes commands for its clients. Messages are
+ * exchanged over a Unix stream socket in host byte order and each
+ * starts with one of these headers. An OPEN request is followed by
+ * 'len1' bytes of device name (no trailing NUL) and opens that device with
+ * 'flags' (as given to open(2) ); the connection then refers to that
+ * device. A CMD request is followed by 'len1' bytes of cdb and 'dout_len'
+ * bytes of data-out; the response to it by 'sense_len' bytes of sense data
+ * and 'din_len' bytes of data-in. The socket name is taken from the
+ * SG3_UTILS_BROKER environment variable. */
+#define SG_BROKER_MAGIC 0x53474272      /* "SGBr" */
+#define SG_BROKER_OP_OPEN 1
+#define SG_BROKER_OP_CMD 2
+#define SG_BROKER_MAX_CDB 64            /* NVMe commands are 64 bytes */
+#define SG_BROKER_MAX_SENSE 256
+#define SG_BROKER_MAX_XFER (16 * 1024 * 1024)
+
+struct sg_broker_req {
+    uint32_t magic;
+    uint32_t op;                /* SG_BROKER_OP_OPEN or SG_BROKER_OP_CMD */
+    uint32_t flags;             /* OPEN: open(2) flags */
+    uint32_t len1;              /* OPEN: name length; CMD: cdb length */
+    uint32_t dout_len;
+    uint32_t din_len;           /* maximum data-in wanted */
+    uint32_t max_sense_len;
+    int32_t timeout_secs;
+};
+
+struct sg_broker_rsp {
+    uint32_t magic;
+    int32_t res;                /* OPEN: 0 or -errno; CMD: do_scsi_pt() */
+    int32_t os_err;
+    uint32_t device_status;
+    uint32_t transport_status;
+    uint32_t driver_status;
+    int32_t din_resid;
+    int32_t dout_resid;
+    uint32_t duration;          /* milliseconds */
+    uint32_t nvme_result;
+    uint32_t nvme_status;
+    uint32_t nvme_direct;       /* 1 if an NVMe command was given directly */
+    uint32_t sense_len;
+    uint32_t din_len;           /* data-in bytes that follow */
+};
+
+/* Sends or receives exactly 'len' bytes on socket 'sfd'. Returns 0 or a
+ * negated errno (-EPIPE if the peer has gone). */
+int sg_broker_xfer(int sfd, void * bp, uint32_t len, bool out);
+
 /* This trims given NVMe block device name in Linux (e.g. /dev/nvme0n1p5)
  * to the name of its associated char device (e.g. /dev/nvme0). If this
  * occurs true is returned and the char device name is placed in 'b' (as
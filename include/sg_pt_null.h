@@ -0,0 +1,98 @@
+#ifndef SG_PT_NULL_H
+#define SG_PT_NULL_H
+
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sg_pt.h"
+
+/* This header is for internal use by the sg3_utils library (libsgutils).
+ * It declares the "null" pass-through which is available on all OSes: a
+ * software only SCSI direct access device that completes each command
+ * immediately (or after an injected delay) with canned data and sense. It
+ * is selected by giving scsi_pt_open_flags() a device name that starts with
+ * SG_PT_NULL_DEV_NAME, optionally followed by comma separated settings:
+ *     /dev/null-scsi[,lat=US][,lbs=LBS][,blocks=NB][,err=N][,ua=U]
+ * where US is the latency of each command in microseconds (default 0),
+ * LBS is the logical block size (default 512), NB is the number of logical
+ * blocks (default 2**31) and N causes every Nth media access command to
+ * fail with a MEDIUM ERROR (default 0 so never). U unit attentions (POWER
+ * ON, RESET then REPORTED LUNS DATA HAS CHANGED, alternately) are reported
+ * after the open, one to each command other than INQUIRY, REPORT LUNS and
+ * REQUEST SENSE (default 0). The intention is to
+ * measure the CPU overhead of the library and the utilities above it
+ * (e.g. with sg_bench) without any device or OS driver involved. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SG_PT_NULL_DEV_NAME "/dev/null-scsi"
+
+/* Handles given out when os_fd is false in sg_pt_null_open(). High enough
+ * not to clash with file descriptors or other pass-through handles. */
+#define SG_PT_NULL_FDOFFSET 0x10000000
+#define SG_PT_NULL_MAX_OPEN 64
+
+/* What a pass-through object sends to, and gets back from, a null device.
+ * If din_iov_count is greater than zero then dinp points to an array of
+ * that many sg_pt_iovec elements, similarly for doutp. */
+struct sg_pt_null_cmd {
+    const uint8_t * cdbp;               /* input fields */
+    int cdb_len;
+    uint8_t * dinp;
+    int din_len;
+    int din_iov_count;
+    const uint8_t * doutp;
+    int dout_len;
+    int dout_iov_count;
+    uint8_t * sensep;
+    int max_sense_len;
+    int scsi_status;                    /* output fields */
+    int sense_len;
+    int din_resid;
+    int dout_resid;
+    uint64_t done_ns;   /* sg_pt_lat_now_ns() when command "completes" */
+};
+
+/* Returns true if device_name selects the null pass-through. */
+bool sg_pt_null_dev_name(const char * device_name);
+
+/* Opens a null device. If os_fd is true the handle returned is an OS file
+ * descriptor of the null device of the OS (e.g. /dev/null in Unix), else it
+ * is SG_PT_NULL_FDOFFSET or more. Returns the handle (>= 0) if successful,
+ * else a negated errno. */
+int sg_pt_null_open(const char * device_name, int flags, bool os_fd,
+                    int verbose);
+
+/* Returns true if dev_fd was returned by sg_pt_null_open() and has not been
+ * closed. Quick when no null devices are open. */
+bool sg_pt_null_is_fd(int dev_fd);
+
+/* Returns 0 if successful, else a negated errno. */
+int sg_pt_null_close(int dev_fd);
+
+/* Executes the SCSI command in ncp on the null device dev_fd. Returns 0
+ * when the output fields of ncp have been set (check scsi_status), else
+ * a negated errno. Does not wait, see sg_pt_null_wait(). */
+int sg_pt_null_cmd(int dev_fd, struct sg_pt_null_cmd * ncp, int verbose);
+
+/* Waits until done_ns (from sg_pt_null_cmd() ) has been reached then
+ * returns 0. If no_wait is true and done_ns is in the future, returns
+ * -EAGAIN immediately. */
+int sg_pt_null_wait(uint64_t done_ns, bool no_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          /* SG_PT_NULL_H */
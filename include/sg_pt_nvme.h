@@ -123,6 +123,29 @@ struct sg_sntl_dev_state_t {
     uint8_t id_ctl253;  /* NVMSR field of Identify controller (byte 253) */
 };
 
+/* SES diagnostic pages fetched with NVMe-MI SES Receive, held per NVMe
+ * device. Pages that only change with the configuration are kept until a
+ * generation code change is seen; status pages for up to
+ * SNTL_SES_STATUS_MS milliseconds (environment variable
+ * SG3_UTILS_SES_CACHE_MS overrides, a negative value disables). */
+#define SNTL_SES_CACHE_PAGES 12
+#define SNTL_SES_STATUS_MS 500
+
+struct sg_sntl_ses_pg_t {
+    uint8_t dpg_cd;     /* diagnostic page code */
+    uint32_t len;       /* bytes held in bp */
+    uint32_t full_len;  /* page length field + 4 */
+    uint64_t when_ns;   /* sg_pt_lat_now_ns() when fetched */
+    uint8_t * bp;
+};
+
+struct sg_sntl_ses_cache_t {
+    bool gen_valid;
+    uint32_t gen_code;  /* last seen enclosure generation code */
+    int num;            /* number of valid elements in pg[] */
+    struct sg_sntl_ses_pg_t pg[SNTL_SES_CACHE_PAGES];
+};
+
 struct sg_sntl_result_t {
     uint8_t sstatus;
     uint8_t sk;
@@ -198,6 +221,20 @@ int sg_make_vpd_devid_for_nvme(const uint8_t * nvme_id_ctl_p,
 /* Initialize dev_stat pointed to by dsp */
 void sntl_init_dev_stat(struct sg_sntl_dev_state_t * dsp);
 
+/* Internal functions (common to all OSes) for the SES page cache used by
+ * the SNTL's SEND DIAGNOSTIC and RECEIVE DIAGNOSTIC RESULTS. The caller
+ * serializes access to *scp . sntl_ses_cache_get() returns the number of
+ * bytes copied to dip, or -1 when the page must be fetched, after which
+ * the response is given to sntl_ses_cache_put(). After SES Send, call
+ * sntl_ses_cache_clear() with static_too=false (true if the
+ * configuration may have changed). */
+int sntl_ses_cache_get(struct sg_sntl_ses_cache_t * scp, uint8_t dpg_cd,
+                       uint8_t * dip, uint32_t max_len);
+void sntl_ses_cache_put(struct sg_sntl_ses_cache_t * scp, uint8_t dpg_cd,
+                        const uint8_t * dip, uint32_t len);
+void sntl_ses_cache_clear(struct sg_sntl_ses_cache_t * scp, bool static_too);
+void sntl_ses_cache_free(struct sg_sntl_ses_cache_t * scp);
+
 /* Internal function (common to all OSes) to support the SNTL SCSI MODE
  * SENSE(10) command. Has a vendor specific Unit Attention mpage which
  * has only one field currently: ENC_OV (enclosure override) */
@@ -0,0 +1,145 @@
+#ifndef SG_PT_SDT_H
+#define SG_PT_SDT_H
+
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* This header is for internal use by the sg3_utils library (libsgutils).
+ * It defines the static (USDT) tracepoints of the library, available in
+ * Linux when ./configure finds <sys/sdt.h> (e.g. from the systemtap-sdt-dev
+ * package), unless SG_LIB_NO_SDT is defined. The provider is "sg3_utils"
+ * and the probes, with their arguments, are:
+ *     cmd__submit     dev_fd, opcode, lba, num_blocks, data_len
+ *     cmd__complete   dev_fd, opcode, lba, num_blocks, dur_ns, status,
+ *                     pt_res (the do_scsi_pt() return value)
+ *     cmd__retry      dev_fd, opcode, errno (system call re-issued)
+ *     sense__decode   sense_cat (SG_LIB_CAT_*), sense_key, asc, ascq,
+ *                     leadin (e.g. "read capacity(10)")
+ * where opcode has 0x100 added for NVMe commands and lba and num_blocks are
+ * 0 for commands without them. Each probe has a semaphore that tracers
+ * (e.g. bpftrace and perf) increment while attached, and the arguments are
+ * only worked out when it is set, so the cost of an idle probe is a test
+ * and a nop. For example:
+ *     bpftrace -e 'usdt:/usr/lib/libsgutils2.so:sg3_utils:cmd__complete
+ *                  { @us[arg1] = hist(arg4 / 1000); }'
+ */
+
+#if defined(SG_LIB_LINUX) && defined(HAVE_SYS_SDT_H) && \
+    (! defined(SG_LIB_NO_SDT))
+
+#define SG_LIB_SDT 1
+
+#include <stdint.h>
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#include "sg_unaligned.h"
+
+#define SG_SDT_SEMAPHORE(name) sg3_utils_##name##_semaphore
+
+/* The translation unit that defines SG_SDT_DEFINE_SEMAPHORES owns them */
+#ifdef SG_SDT_DEFINE_SEMAPHORES
+#define SG_SDT_SEM(name) \
+    unsigned short SG_SDT_SEMAPHORE(name) __attribute__((section(".probes")))
+#else
+#define SG_SDT_SEM(name) extern unsigned short SG_SDT_SEMAPHORE(name)
+#endif
+
+SG_SDT_SEM(cmd__submit);
+SG_SDT_SEM(cmd__complete);
+SG_SDT_SEM(cmd__retry);
+SG_SDT_SEM(sense__decode);
+
+#define SG_SDT_IS_ENABLED(name) \
+    __builtin_expect(SG_SDT_SEMAPHORE(name) != 0, 0)
+
+#define SG_SDT_PROBE3(name, a1, a2, a3) do { \
+        if (SG_SDT_IS_ENABLED(name)) \
+            DTRACE_PROBE3(sg3_utils, name, a1, a2, a3); \
+    } while (0)
+#define SG_SDT_PROBE5(name, a1, a2, a3, a4, a5) do { \
+        if (SG_SDT_IS_ENABLED(name)) \
+            DTRACE_PROBE5(sg3_utils, name, a1, a2, a3, a4, a5); \
+    } while (0)
+#define SG_SDT_PROBE7(name, a1, a2, a3, a4, a5, a6, a7) do { \
+        if (SG_SDT_IS_ENABLED(name)) \
+            DTRACE_PROBE7(sg3_utils, name, a1, a2, a3, a4, a5, a6, a7); \
+    } while (0)
+
+/* Fetches the LBA and number of blocks from the cdb of the common media
+ * access commands, else yields zeros. */
+static inline void
+sg_sdt_cdb_lba(const uint8_t * cdbp, int cdb_len, uint64_t * lbap,
+               uint32_t * nump)
+{
+    *lbap = 0;
+    *nump = 0;
+    switch ((cdb_len > 0) ? cdbp[0] : 0) {
+    case 0x8:           /* READ(6) */
+    case 0xa:           /* WRITE(6) */
+        if (cdb_len >= 6) {
+            *lbap = sg_get_unaligned_be24(cdbp + 1) & 0x1fffff;
+            *nump = cdbp[4] ? cdbp[4] : 256;
+        }
+        break;
+    case 0x28:          /* READ(10) */
+    case 0x2a:          /* WRITE(10) */
+    case 0x2e:          /* WRITE AND VERIFY(10) */
+    case 0x2f:          /* VERIFY(10) */
+    case 0x34:          /* PRE-FETCH(10) */
+    case 0x35:          /* SYNCHRONIZE CACHE(10) */
+    case 0x41:          /* WRITE SAME(10) */
+        if (cdb_len >= 10) {
+            *lbap = sg_get_unaligned_be32(cdbp + 2);
+            *nump = sg_get_unaligned_be16(cdbp + 7);
+        }
+        break;
+    case 0xa8:          /* READ(12) */
+    case 0xaa:          /* WRITE(12) */
+    case 0xae:          /* WRITE AND VERIFY(12) */
+    case 0xaf:          /* VERIFY(12) */
+        if (cdb_len >= 12) {
+            *lbap = sg_get_unaligned_be32(cdbp + 2);
+            *nump = sg_get_unaligned_be32(cdbp + 6);
+        }
+        break;
+    case 0x88:          /* READ(16) */
+    case 0x8a:          /* WRITE(16) */
+    case 0x8e:          /* WRITE AND VERIFY(16) */
+    case 0x8f:          /* VERIFY(16) */
+    case 0x90:          /* PRE-FETCH(16) */
+    case 0x91:          /* SYNCHRONIZE CACHE(16) */
+    case 0x93:          /* WRITE SAME(16) */
+        if (cdb_len >= 16) {
+            *lbap = sg_get_unaligned_be64(cdbp + 2);
+            *nump = sg_get_unaligned_be32(cdbp + 10);
+        }
+        break;
+    case 0x89:          /* COMPARE AND WRITE */
+        if (cdb_len >= 16) {
+            *lbap = sg_get_unaligned_be64(cdbp + 2);
+            *nump = cdbp[13];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+#else   /* no static tracepoints */
+
+#define SG_SDT_IS_ENABLED(name) 0
+#define SG_SDT_PROBE3(name, a1, a2, a3) do { } while (0)
+#define SG_SDT_PROBE5(name, a1, a2, a3, a4, a5) do { } while (0)
+#define SG_SDT_PROBE7(name, a1, a2, a3, a4, a5, a6, a7) do { } while (0)
+
+#endif
+
+#endif          /* SG_PT_SDT_H */
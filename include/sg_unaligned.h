@@ -484,6 +484,66 @@ static inline void sg_nz_put_unaligned_le64(uint64_t val, void *p)
 }
 
 
+/* Bulk forms for walking arrays of fixed length descriptors (e.g. REPORT
+ * ZONES, GET LBA STATUS and REPORT LUNS responses). Each extracts one field
+ * from 'num' descriptors, the first field at 'p' and each following one
+ * 'stride' bytes further on, into the host order array 'arr' (i.e. a
+ * "struct of arrays" column). They are kept as simple loops over the single
+ * field functions above so compilers can unroll and vectorize them; the
+ * byte swaps are single instructions where GOT_UNALIGNED_SPECIALS. */
+static inline void sg_get_unaligned_be16_arr(const void *p, int stride,
+                                             int num, uint16_t *arr)
+{
+        int k;
+        const uint8_t *bp = (const uint8_t *)p;
+
+        for (k = 0; k < num; ++k, bp += stride)
+                arr[k] = sg_get_unaligned_be16(bp);
+}
+
+static inline void sg_get_unaligned_be32_arr(const void *p, int stride,
+                                             int num, uint32_t *arr)
+{
+        int k;
+        const uint8_t *bp = (const uint8_t *)p;
+
+        for (k = 0; k < num; ++k, bp += stride)
+                arr[k] = sg_get_unaligned_be32(bp);
+}
+
+static inline void sg_get_unaligned_be64_arr(const void *p, int stride,
+                                             int num, uint64_t *arr)
+{
+        int k;
+        const uint8_t *bp = (const uint8_t *)p;
+
+        for (k = 0; k < num; ++k, bp += stride)
+                arr[k] = sg_get_unaligned_be64(bp);
+}
+
+/* Contiguous (stride equal to the field size) host order to big endian
+ * conversions, convenient for building LBA lists and the like. */
+static inline void sg_put_unaligned_be32_arr(const uint32_t *arr, int num,
+                                             void *p)
+{
+        int k;
+        uint8_t *bp = (uint8_t *)p;
+
+        for (k = 0; k < num; ++k, bp += 4)
+                sg_put_unaligned_be32(arr[k], bp);
+}
+
+static inline void sg_put_unaligned_be64_arr(const uint64_t *arr, int num,
+                                             void *p)
+{
+        int k;
+        uint8_t *bp = (uint8_t *)p;
+
+        for (k = 0; k < num; ++k, bp += 8)
+                sg_put_unaligned_be64(arr[k], bp);
+}
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2019 Douglas Gilbert.
+ * Copyright (c) 1999-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -35,14 +35,35 @@
 #include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
+#include "sg_pt_sdt.h"
+#include "sg_pt_null.h"
 
 /* Needs to be after config.h */
 #ifdef SG_LIB_LINUX
 #include <errno.h>
+#include <sys/sysmacros.h>
+#endif
+#ifndef SG_LIB_WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+/* The INQUIRY cache keeps per thread state and files so is not available
+ * without thread local storage or on Windows */
+#if defined(__GNUC__) && (! defined(SG_LIB_WIN32)) && \
+    (! defined(SG_LIB_NO_INQ_CACHE))
+#define SG_INQ_CACHE 1
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef SG_LIB_LINUX
+#include <sys/sysmacros.h>
+#endif
 #endif
 
 
-static const char * const version_str = "1.93 20190128";
+static const char * const version_str = "1.97 20261014";
 
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
@@ -105,17 +126,31 @@ sg_cmds_resid_print(const char * leadin, bool is_din, int num_req,
           (is_din ? "" : " sent"));
 }
 
+/* The sense category and decoded sense ('sip', NULL if not valid) come
+ * from the pass-through object's cache so the sense buffer is only parsed
+ * again if it is to be output. */
 static int
 sg_cmds_process_helper(const char * leadin, int req_din_x, int act_din_x,
                        int req_dout_x, int act_dout_x, const uint8_t * sbp,
-                       int slen, bool noisy, int verbose, int * o_sense_cat)
+                       int slen, int scat,
+                       const struct sg_scsi_sense_info * sip, bool noisy,
+                       int verbose, int * o_sense_cat)
 {
-    int scat;
     bool n = false;
     bool check_data_in = false;
     char b[512];
 
-    scat = sg_err_category_sense(sbp, slen);
+#ifdef SG_LIB_SDT
+    if (SG_SDT_IS_ENABLED(sense__decode)) {
+        if (sip)
+            SG_SDT_PROBE5(sense__decode, scat, sip->sense_key, sip->asc,
+                          sip->ascq, leadin);
+        else
+            SG_SDT_PROBE5(sense__decode, scat, 0, 0, 0, leadin);
+    }
+#else
+    if (sip) { }        /* suppress warning */
+#endif
     switch (scat) {
     case SG_LIB_CAT_NOT_READY:
     case SG_LIB_CAT_INVALID_OP:
@@ -178,6 +213,1151 @@ sg_cmds_process_helper(const char * leadin, int req_din_x, int act_din_x,
     return -2;
 }
 
+#ifdef SG_INQ_CACHE
+
+#define SG_INQ_CACHE_MAGIC "sg3_utils inquiry cache 1"
+#define SG_INQ_CACHE_DEF_TTL 3600       /* seconds */
+#define SG_INQ_CACHE_MAX_RESP 1024      /* longer responses not cached */
+#define SG_INQ_CACHE_KEY_LEN 48         /* e.g. "naa_" + 32 hex digits */
+#define SG_INQ_CACHE_FD_SLOTS 8
+#define SG_INQ_CACHE_DI_LEN 252        /* to fetch the designator */
+#define SG_INQ_CACHE_RSOC 2     /* kind of REPORT SUPPORTED OP CODES entry */
+#define SG_INQ_CACHE_RSOC_MAX 8192      /* at 20 bytes per command */
+#define SG_INQ_CACHE_LINE_LEN ((2 * SG_INQ_CACHE_RSOC_MAX) + 64)
+
+/* Which logical unit (by designator) a file descriptor is open on */
+struct sg_inq_cache_fd {
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    char key[SG_INQ_CACHE_KEY_LEN];     /* empty if no usable designator */
+};
+
+static int inq_cache_state;     /* 0: env not checked yet, 1: off, 2: on */
+static int inq_cache_ttl = SG_INQ_CACHE_DEF_TTL;
+static char inq_cache_dir[512];
+
+static __thread struct sg_inq_cache_fd inq_cache_fds[SG_INQ_CACHE_FD_SLOTS];
+static __thread int inq_cache_next_slot;
+static __thread bool inq_cache_busy;    /* fetching a key, bypass cache */
+
+static int sg_ll_inquiry_com(struct sg_pt_base * ptvp, bool cmddt, bool evpd,
+                             int pg_op, void * resp, int mx_resp_len,
+                             int timeout_secs, int * residp, bool noisy,
+                             int verbose);
+
+int
+sg_inq_cache_enable(const char * dir, int ttl_secs)
+{
+    struct stat st;
+
+    if (NULL == dir) {
+        inq_cache_state = 1;
+        return 0;
+    }
+    if ((strlen(dir) + SG_INQ_CACHE_KEY_LEN + 16) >= sizeof(inq_cache_dir))
+        return -ENAMETOOLONG;
+    if (stat(dir, &st) < 0) {
+        if ((mkdir(dir, 0755) < 0) && (EEXIST != errno))
+            return -errno;
+    } else if (! S_ISDIR(st.st_mode))
+        return -ENOTDIR;
+    snprintf(inq_cache_dir, sizeof(inq_cache_dir), "%s", dir);
+    inq_cache_ttl = (ttl_secs > 0) ? ttl_secs : SG_INQ_CACHE_DEF_TTL;
+    inq_cache_state = 2;
+    return 0;
+}
+
+static bool
+inq_cache_on(void)
+{
+    if (0 == inq_cache_state) {
+        const char * cp = getenv("SG3_UTILS_INQ_CACHE");
+        const char * tp = getenv("SG3_UTILS_INQ_CACHE_TTL");
+
+        if (cp && *cp)
+            sg_inq_cache_enable(cp, tp ? atoi(tp) : 0);
+        if (0 == inq_cache_state)
+            inq_cache_state = 1;
+    }
+    return (2 == inq_cache_state);
+}
+
+/* The standard INQUIRY response and the VPD pages that describe a logical
+ * unit and rarely change */
+static bool
+inq_cache_page_ok(bool evpd, int pg_op)
+{
+    if (! evpd)
+        return (0 == pg_op);
+    switch (pg_op) {
+    case 0x0:           /* Supported VPD pages */
+    case 0x80:          /* Unit serial number */
+    case 0x83:          /* Device identification */
+    case 0x8f:          /* Third party copy */
+    case 0xb0:          /* Block limits */
+    case 0xb1:          /* Block device characteristics */
+    case 0xb2:          /* Logical block provisioning */
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Places in 'key' a name made from the first NAA, or failing that EUI-64,
+ * logical unit designator in a Device identification VPD page response,
+ * or an empty string if it has neither */
+static void
+inq_cache_key_from_di(const uint8_t * rp, int len, char * key)
+{
+    static const char * const desig_name[] = {"naa", "eui"};
+    int k, j, n, off, dlen;
+    const uint8_t * bp;
+    struct sg_vpd_dev_id_idx di;
+
+    key[0] = '\0';
+    if ((len < 4) || (0x83 != rp[1]))
+        return;
+    n = sg_get_unaligned_be16(rp + 2);
+    if (n > (len - 4))
+        n = len - 4;
+    sg_vpd_dev_id_index(rp + 4, n, &di);
+    for (k = 0; k < 2; ++k) {
+        off = (0 == k) ? di.lu_naa : di.lu_eui64;
+        if (off < 0)
+            continue;
+        bp = rp + 4 + off;
+        dlen = bp[3];
+        if ((off + 4 + dlen) > n)
+            dlen = n - (off + 4);
+        if (((2 * dlen) + 5) > SG_INQ_CACHE_KEY_LEN)
+            dlen = (SG_INQ_CACHE_KEY_LEN - 5) / 2;
+        if (dlen < 1)
+            continue;
+        j = sprintf(key, "%s_", desig_name[k]);
+        for (n = 0; n < dlen; ++n)
+            j += sprintf(key + j, "%02x", bp[4 + n]);
+        return;
+    }
+}
+
+static void
+inq_cache_path(const char * key, char * b, int blen)
+{
+    snprintf(b, blen, "%s/%s", inq_cache_dir, key);
+}
+
+/* Responses of these kinds start with a 4 byte length, as INQUIRY ones
+ * don't */
+static bool
+inq_cache_be32_kind(int kind)
+{
+    return (SG_INQ_CACHE_RSOC == kind) || (SG_INQ_CACHE_KIND_RCOP == kind);
+}
+
+/* Longest response of 'kind' (0: standard INQUIRY, 1: VPD page,
+ * SG_INQ_CACHE_RSOC or SG_INQ_CACHE_KIND_RCOP) that is cached */
+static int
+inq_cache_max_resp(int kind)
+{
+    return (SG_INQ_CACHE_RSOC == kind) ? SG_INQ_CACHE_RSOC_MAX :
+                                         SG_INQ_CACHE_MAX_RESP;
+}
+
+/* Returns the number of bytes (up to mx_resp_len) of a fresh cached
+ * response placed in resp, or -1 if there is none. A cached response that
+ * was itself truncated only serves requests that are no longer. */
+static int
+inq_cache_get(const char * key, int kind, int pg_op, uint8_t * resp,
+              int mx_resp_len)
+{
+    int k, e, pg, len, full, n, pos;
+    int ret = -1;
+    long long t;
+    unsigned int u;
+    FILE * fp;
+    char * line;
+    char path[sizeof(inq_cache_dir) + SG_INQ_CACHE_KEY_LEN + 2];
+
+    inq_cache_path(key, path, sizeof(path));
+    if (NULL == (fp = fopen(path, "r")))
+        return -1;
+    if (NULL == (line = (char *)malloc(SG_INQ_CACHE_LINE_LEN))) {
+        fclose(fp);
+        return -1;
+    }
+    if ((NULL == fgets(line, SG_INQ_CACHE_LINE_LEN, fp)) ||
+        strncmp(line, SG_INQ_CACHE_MAGIC, strlen(SG_INQ_CACHE_MAGIC)))
+        goto fini;
+    while (fgets(line, SG_INQ_CACHE_LINE_LEN, fp)) {
+        if ((4 != sscanf(line, "%d %d %lld %d %n", &e, &pg, &t, &len, &pos)) ||
+            (e != kind) || (pg != pg_op))
+            continue;
+        if (((long long)time(NULL) - t) > inq_cache_ttl)
+            break;      /* stale, so fetch it again */
+        if ((len < 4) || (len > inq_cache_max_resp(kind)) ||
+            ((int)strlen(line + pos) < (2 * len)))
+            break;
+        n = (len < mx_resp_len) ? len : mx_resp_len;
+        for (k = 0; k < n; ++k) {
+            if (1 != sscanf(line + pos + (2 * k), "%2x", &u))
+                goto fini;
+            resp[k] = (uint8_t)u;
+        }
+        if (inq_cache_be32_kind(kind))
+            full = sg_get_unaligned_be32(resp + 0) + 4;
+        else
+            full = kind ? (sg_get_unaligned_be16(resp + 2) + 4) :
+                          (resp[4] + 5);
+        if ((len < full) && (mx_resp_len > len))
+            break;      /* cached response was truncated */
+        if (n > full)
+            n = full;
+        ret = n;
+        break;
+    }
+fini:
+    free(line);
+    fclose(fp);
+    return ret;
+}
+
+/* Adds (or replaces) a response in the cache file of 'key', dropping any
+ * stale entries. The file is rewritten under a temporary name then renamed
+ * so readers never see it half written. */
+static void
+inq_cache_put(const char * key, int kind, int pg_op, const uint8_t * rp,
+              int len)
+{
+    int k, fd, e, pg;
+    long long t;
+    long long now = (long long)time(NULL);
+    FILE * fp;
+    FILE * ofp;
+    char * line;
+    char path[sizeof(inq_cache_dir) + SG_INQ_CACHE_KEY_LEN + 2];
+    char tpath[sizeof(path) + 8];
+
+    if ((len > inq_cache_max_resp(kind)) ||
+        (inq_cache_be32_kind(kind) ? (len < 4) :
+         ((len < 5) || (kind && (pg_op != rp[1])) ||
+          ((! kind) && (0x7f == rp[0])))))
+        return;         /* don't keep anything suspect */
+    if (NULL == (line = (char *)malloc(SG_INQ_CACHE_LINE_LEN)))
+        return;
+    inq_cache_path(key, path, sizeof(path));
+    snprintf(tpath, sizeof(tpath), "%s.XXXXXX", path);
+    if ((fd = mkstemp(tpath)) < 0) {
+        free(line);
+        return;
+    }
+    if (NULL == (ofp = fdopen(fd, "w"))) {
+        close(fd);
+        unlink(tpath);
+        free(line);
+        return;
+    }
+    fprintf(ofp, "%s\n", SG_INQ_CACHE_MAGIC);
+    if ((fp = fopen(path, "r"))) {
+        if (fgets(line, SG_INQ_CACHE_LINE_LEN, fp) &&
+            (0 == strncmp(line, SG_INQ_CACHE_MAGIC,
+                          strlen(SG_INQ_CACHE_MAGIC)))) {
+            while (fgets(line, SG_INQ_CACHE_LINE_LEN, fp)) {
+                if ((3 != sscanf(line, "%d %d %lld", &e, &pg, &t)) ||
+                    ((e == kind) && (pg == pg_op)) ||
+                    ((now - t) > inq_cache_ttl))
+                    continue;
+                fputs(line, ofp);
+            }
+        }
+        fclose(fp);
+    }
+    free(line);
+    fprintf(ofp, "%d %d %lld %d ", kind, pg_op, now, len);
+    for (k = 0; k < len; ++k)
+        fprintf(ofp, "%02x", rp[k]);
+    fputc('\n', ofp);
+    if (fclose(ofp) || rename(tpath, path))
+        unlink(tpath);
+}
+
+/* Returns the slot for 'fd' having found the designator of its logical
+ * unit if this is the first time (or the fd now refers to another file).
+ * In Linux the Device identification VPD page is read from sysfs when
+ * possible, otherwise it is fetched with 'ptvp' (and cached) unless
+ * 'no_cmd' is true, in which case NULL is returned. Returns NULL on
+ * failure. */
+static struct sg_inq_cache_fd *
+inq_cache_slot(struct sg_pt_base * ptvp, int fd, bool no_cmd, int verbose)
+{
+    int k, res, resid;
+    struct stat st;
+    struct sg_inq_cache_fd * sp;
+    uint8_t b[SG_INQ_CACHE_MAX_RESP];
+
+    if ((fd < 0) || (fstat(fd, &st) < 0))
+        return NULL;
+    for (k = 0; k < SG_INQ_CACHE_FD_SLOTS; ++k) {
+        sp = inq_cache_fds + k;
+        if ((fd == sp->fd) && (st.st_dev == sp->dev) &&
+            (st.st_ino == sp->ino))
+            return sp;
+    }
+    sp = inq_cache_fds + (inq_cache_next_slot++ % SG_INQ_CACHE_FD_SLOTS);
+    sp->fd = fd;
+    sp->dev = st.st_dev;
+    sp->ino = st.st_ino;
+    sp->key[0] = '\0';
+#ifdef SG_LIB_LINUX
+    if (S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode)) {
+        int sfd;
+        char path[96];
+
+        snprintf(path, sizeof(path), "/sys/dev/%s/%u:%u/device/vpd_pg83",
+                 S_ISCHR(st.st_mode) ? "char" : "block",
+                 major(st.st_rdev), minor(st.st_rdev));
+        if ((sfd = open(path, O_RDONLY)) >= 0) {
+            res = read(sfd, b, sizeof(b));
+            close(sfd);
+            if (res > 0)
+                inq_cache_key_from_di(b, res, sp->key);
+        }
+    }
+#endif
+    if (('\0' == sp->key[0]) && no_cmd) {
+        sp->fd = -1;    /* so a later call may fetch the designator */
+        return NULL;
+    } else if ('\0' == sp->key[0]) {
+        inq_cache_busy = true;
+        res = sg_ll_inquiry_com(ptvp, false, true, 0x83, b, SG_INQ_CACHE_DI_LEN,
+                                0, &resid, false, verbose);
+        inq_cache_busy = false;
+        clear_scsi_pt_obj(ptvp);        /* caller sets it up again */
+        if ((0 == res) && (resid >= 0) && (resid < SG_INQ_CACHE_DI_LEN)) {
+            inq_cache_key_from_di(b, SG_INQ_CACHE_DI_LEN - resid, sp->key);
+            if (sp->key[0])
+                inq_cache_put(sp->key, true, 0x83, b, SG_INQ_CACHE_DI_LEN - resid);
+        }
+    }
+    if (verbose > 1)
+        pr2ws("    %s: fd=%d key: %s\n", __func__, fd,
+              sp->key[0] ? sp->key : "<none, not cached>");
+    return sp;
+}
+
+/* Per thread tables of the commands that devices support, each from one
+ * REPORT SUPPORTED OPERATION CODES command (or the cache) */
+#define SG_OPC_SLOTS 8
+#define SG_OPC_RSOC_CMDLEN 12
+#define SG_OPC_RSOC_SA 0xc
+
+struct sg_opc_ent {
+    uint8_t opcode;
+    bool sa_valid;
+    uint16_t sa;
+    uint32_t rec_timeout;       /* recommended, in seconds; 0: not given */
+};
+
+struct sg_opc_slot {
+    int fd;
+    int num;            /* entries in tbl; 0: device didn't report any */
+    bool partial;       /* response was truncated so tbl may be short */
+    dev_t dev;
+    ino_t ino;
+    struct sg_opc_ent * tbl;    /* sorted by opcode then service action */
+};
+
+static __thread struct sg_opc_slot opc_slots[SG_OPC_SLOTS];
+static __thread int opc_next_slot;
+
+static const char * const rsoc_s = "Report supported operation codes";
+
+/* Sends REPORT SUPPORTED OPERATION CODES asking for all commands (with
+ * their timeouts if rctd). Returns 0 and sets *resp_lenp if ok, else an
+ * error, as sg_ll_*() functions do */
+static int
+opc_rsoc(struct sg_pt_base * ptvp, bool rctd, uint8_t * resp, int mx_resp_len,
+         int * resp_lenp, int verbose)
+{
+    int k, res, ret, sense_cat;
+    uint8_t rsoc_cdb[SG_OPC_RSOC_CMDLEN] = {0xa3 /* MAINTENANCE IN */,
+                                SG_OPC_RSOC_SA, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t sense_b[SENSE_BUFF_LEN];
+
+    *resp_lenp = 0;
+    if (rctd)
+        rsoc_cdb[2] |= 0x80;
+    sg_put_unaligned_be32((uint32_t)mx_resp_len, rsoc_cdb + 6);
+    if (verbose) {
+        pr2ws("    %s cdb: ", rsoc_s);
+        for (k = 0; k < SG_OPC_RSOC_CMDLEN; ++k)
+            pr2ws("%02x ", rsoc_cdb[k]);
+        pr2ws("\n");
+    }
+    clear_scsi_pt_obj(ptvp);
+    set_scsi_pt_cdb(ptvp, rsoc_cdb, sizeof(rsoc_cdb));
+    set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+    set_scsi_pt_data_in(ptvp, resp, mx_resp_len);
+    res = sg_cmds_do_pt(ptvp, rsoc_cdb, sizeof(rsoc_cdb), -1,
+                        DEF_PT_TIMEOUT, verbose);
+    ret = sg_cmds_process_resp(ptvp, rsoc_s, res, false, verbose,
+                               &sense_cat);
+    if (-1 == ret)
+        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == ret) {
+        switch (sense_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            ret = 0;
+            break;
+        default:
+            ret = sense_cat;
+            break;
+        }
+    } else {
+        *resp_lenp = ret;
+        ret = 0;
+    }
+    return ret;
+}
+
+static int
+opc_ent_compare(const void * left, const void * right)
+{
+    const struct sg_opc_ent * l = (const struct sg_opc_ent *)left;
+    const struct sg_opc_ent * r = (const struct sg_opc_ent *)right;
+
+    if (l->opcode != r->opcode)
+        return (int)l->opcode - (int)r->opcode;
+    return (int)l->sa - (int)r->sa;
+}
+
+/* Builds sp->tbl from an "all commands" REPORT SUPPORTED OPERATION CODES
+ * response of len bytes */
+static void
+opc_decode(struct sg_opc_slot * sp, const uint8_t * rp, int len)
+{
+    int k, n, d_len;
+    uint32_t u;
+    const uint8_t * bp;
+    struct sg_opc_ent * ep;
+
+    sp->num = 0;
+    if (len < 4)
+        return;
+    n = sg_get_unaligned_be32(rp + 0) + 4;
+    if (n > len) {
+        n = len;
+        sp->partial = true;
+    }
+    if (n < 12)
+        return;
+    sp->tbl = (struct sg_opc_ent *)calloc((n - 4) / 8, sizeof(*ep));
+    if (NULL == sp->tbl)
+        return;
+    for (k = 4, ep = sp->tbl; (k + 8) <= n; k += d_len, ++ep) {
+        bp = rp + k;
+        d_len = (0x2 & bp[5]) ? 20 : 8;         /* CTDP */
+        if ((k + d_len) > n) {
+            sp->partial = true;
+            break;
+        }
+        ep->opcode = bp[0];
+        ep->sa_valid = !! (0x1 & bp[5]);        /* SERVACTV */
+        ep->sa = ep->sa_valid ? sg_get_unaligned_be16(bp + 2) : 0;
+        if (20 == d_len) {
+            u = sg_get_unaligned_be32(bp + 16);
+            ep->rec_timeout = (u > 0x7fffffff) ? 0x7fffffff : u;
+        }
+        ++sp->num;
+    }
+    qsort(sp->tbl, sp->num, sizeof(*ep), opc_ent_compare);
+}
+
+/* Fills sp with the commands the device on sg_fd supports, from the cache
+ * when enabled and fresh, otherwise with a REPORT SUPPORTED OPERATION
+ * CODES command (asking for timeouts, then without if that is rejected).
+ * A device that rejects that command is cached as reporting nothing so
+ * it is not asked again until the entry is stale. */
+static void
+opc_load(struct sg_opc_slot * sp, int sg_fd, int verbose)
+{
+    int res;
+    int len = -1;
+    int vb = (verbose > 0) ? verbose - 1 : 0;
+    struct sg_pt_base * ptvp;
+    struct sg_inq_cache_fd * csp = NULL;
+    uint8_t * rp;
+
+    rp = (uint8_t *)calloc(1, SG_INQ_CACHE_RSOC_MAX);
+    if (NULL == rp)
+        return;
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
+    if (NULL == ptvp) {
+        free(rp);
+        return;
+    }
+    if (inq_cache_on()) {
+        csp = inq_cache_slot(ptvp, sg_fd, false, vb);
+        if (csp && ('\0' == csp->key[0]))
+            csp = NULL;
+        if (csp)
+            len = inq_cache_get(csp->key, SG_INQ_CACHE_RSOC, 0, rp,
+                                SG_INQ_CACHE_RSOC_MAX);
+        if ((len >= 0) && verbose)
+            pr2ws("    %s: %d bytes from cache\n", rsoc_s, len);
+    }
+    if (len < 0) {
+        res = opc_rsoc(ptvp, true, rp, SG_INQ_CACHE_RSOC_MAX, &len, vb);
+        if (SG_LIB_CAT_ILLEGAL_REQ == res)      /* perhaps RCTD */
+            res = opc_rsoc(ptvp, false, rp, SG_INQ_CACHE_RSOC_MAX, &len, vb);
+        if ((SG_LIB_CAT_ILLEGAL_REQ == res) ||
+            (SG_LIB_CAT_INVALID_OP == res)) {
+            memset(rp, 0, 4);   /* remember device reports nothing */
+            len = 4;
+        } else if (res)
+            len = -1;
+        if (csp && (len >= 4))
+            inq_cache_put(csp->key, SG_INQ_CACHE_RSOC, 0, rp, len);
+    }
+    sg_cmds_put_pt_obj(ptvp);
+    if (len > 0)
+        opc_decode(sp, rp, len);
+    if (verbose)
+        pr2ws("    %s: fd=%d, %d commands%s\n", rsoc_s, sg_fd, sp->num,
+              sp->partial ? " (truncated)" : "");
+    free(rp);
+}
+
+/* Returns the table of the device on sg_fd, loading it the first time
+ * (or when the fd now refers to another file). Returns NULL on failure. */
+static struct sg_opc_slot *
+opc_slot(int sg_fd, int verbose)
+{
+    int k;
+    struct stat st;
+    struct sg_opc_slot * sp;
+
+    if ((sg_fd < 0) || (fstat(sg_fd, &st) < 0))
+        return NULL;
+    for (k = 0; k < SG_OPC_SLOTS; ++k) {
+        sp = opc_slots + k;
+        if ((sg_fd == sp->fd) && (st.st_dev == sp->dev) &&
+            (st.st_ino == sp->ino))
+            return sp;
+    }
+    sp = opc_slots + (opc_next_slot++ % SG_OPC_SLOTS);
+    free(sp->tbl);
+    memset(sp, 0, sizeof(*sp));
+    sp->fd = sg_fd;
+    sp->dev = st.st_dev;
+    sp->ino = st.st_ino;
+    opc_load(sp, sg_fd, verbose);
+    return sp;
+}
+
+static void
+opc_forget(int sg_fd)
+{
+    int k;
+
+    for (k = 0; k < SG_OPC_SLOTS; ++k) {
+        if (sg_fd == opc_slots[k].fd) {
+            free(opc_slots[k].tbl);
+            memset(opc_slots + k, 0, sizeof(opc_slots[k]));
+            opc_slots[k].fd = -1;
+        }
+    }
+}
+
+/* Returns the entry for opcode (and service action sa if that is >= 0)
+ * or NULL if the table has none */
+static const struct sg_opc_ent *
+opc_find(const struct sg_opc_slot * sp, int opcode, int sa)
+{
+    int lo = 0;
+    int hi = sp->num;
+    int mid;
+    const struct sg_opc_ent * ep;
+
+    while (lo < hi) {   /* to first entry with opcode */
+        mid = (lo + hi) / 2;
+        if ((int)sp->tbl[mid].opcode < opcode)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (ep = sp->tbl + lo; ep < (sp->tbl + sp->num); ++ep) {
+        if ((int)ep->opcode != opcode)
+            break;
+        if ((sa < 0) || (! ep->sa_valid) || ((int)ep->sa == sa))
+            return ep;
+    }
+    return NULL;
+}
+
+int
+sg_opcode_is_supported(int sg_fd, int opcode, int sa, int verbose)
+{
+    const struct sg_opc_slot * sp = opc_slot(sg_fd, verbose);
+
+    if ((NULL == sp) || (sp->num < 1))
+        return -1;
+    if (opc_find(sp, opcode, sa))
+        return 1;
+    return sp->partial ? -1 : 0;
+}
+
+int
+sg_opcode_recommended_timeout(int sg_fd, int opcode, int sa, int def_secs,
+                              int verbose)
+{
+    const struct sg_opc_slot * sp = opc_slot(sg_fd, verbose);
+    const struct sg_opc_ent * ep;
+
+    if ((NULL == sp) || (sp->num < 1))
+        return def_secs;
+    ep = opc_find(sp, opcode, sa);
+    return (ep && (ep->rec_timeout > 0)) ? (int)ep->rec_timeout : def_secs;
+}
+
+/* Finds the cache slot, with a designator, of the logical unit on sg_fd;
+ * fetching the designator (once) with a pass-through object of our own if
+ * sysfs does not have it. Returns NULL if the cache is off or there is no
+ * usable designator. */
+static struct sg_inq_cache_fd *
+inq_cache_resp_slot(int sg_fd, int verbose)
+{
+    struct sg_pt_base * ptvp;
+    struct sg_inq_cache_fd * csp;
+
+    if ((sg_fd < 0) || inq_cache_busy || (! inq_cache_on()))
+        return NULL;
+    if (NULL == (ptvp = sg_cmds_get_pt_obj(sg_fd, verbose)))
+        return NULL;
+    csp = inq_cache_slot(ptvp, sg_fd, false, verbose);
+    sg_cmds_put_pt_obj(ptvp);
+    return (csp && csp->key[0]) ? csp : NULL;
+}
+
+int
+sg_inq_cache_get_resp(int sg_fd, int kind, uint8_t * resp, int mx_resp_len,
+                      int verbose)
+{
+    struct sg_inq_cache_fd * csp;
+
+    if ((SG_INQ_CACHE_KIND_RCOP != kind) || (NULL == resp) ||
+        (mx_resp_len < 1))
+        return -1;
+    if (NULL == (csp = inq_cache_resp_slot(sg_fd, verbose)))
+        return -1;
+    return inq_cache_get(csp->key, kind, 0, resp, mx_resp_len);
+}
+
+void
+sg_inq_cache_put_resp(int sg_fd, int kind, const uint8_t * resp, int len,
+                      int verbose)
+{
+    struct sg_inq_cache_fd * csp;
+
+    if ((SG_INQ_CACHE_KIND_RCOP != kind) || (NULL == resp))
+        return;
+    if ((csp = inq_cache_resp_slot(sg_fd, verbose)))
+        inq_cache_put(csp->key, kind, 0, resp, len);
+}
+
+int
+sg_inq_cache_invalidate(int sg_fd)
+{
+    struct sg_inq_cache_fd * sp;
+    char path[sizeof(inq_cache_dir) + SG_INQ_CACHE_KEY_LEN + 2];
+
+    opc_forget(sg_fd);
+    if (! inq_cache_on())
+        return 0;
+    sp = inq_cache_slot(NULL, sg_fd, true, 0);
+    if ((NULL == sp) || ('\0' == sp->key[0]))
+        return 0;
+    inq_cache_path(sp->key, path, sizeof(path));
+    sp->fd = -1;        /* designator may have changed as well */
+    if ((unlink(path) < 0) && (ENOENT != errno))
+        return -errno;
+    return 0;
+}
+
+/* Drops the cache file, and the supported commands table, of the logical
+ * unit if the sense data holds a MICROCODE HAS BEEN CHANGED, CHANGED
+ * OPERATING DEFINITION or INQUIRY DATA HAS CHANGED unit attention */
+static void
+inq_cache_check_ua(const struct sg_pt_base * ptvp)
+{
+    const struct sg_scsi_sense_info * sip = get_scsi_pt_sense_info(ptvp);
+
+    if (sip && (SPC_SK_UNIT_ATTENTION == sip->sense_key) &&
+        (0x3f == sip->asc) && (sip->ascq >= 0x1) && (sip->ascq <= 0x3))
+        sg_inq_cache_invalidate(get_pt_file_handle(ptvp));
+}
+
+#else   /* SG_INQ_CACHE */
+
+int
+sg_inq_cache_enable(const char * dir, int ttl_secs)
+{
+    if (ttl_secs) { }   /* suppress warning */
+    return dir ? -ENOSYS : 0;
+}
+
+int
+sg_inq_cache_invalidate(int sg_fd)
+{
+    if (sg_fd) { }      /* suppress warning */
+    return 0;
+}
+
+int
+sg_inq_cache_get_resp(int sg_fd, int kind, uint8_t * resp, int mx_resp_len,
+                      int verbose)
+{
+    if (sg_fd || kind || resp || mx_resp_len || verbose) { }
+    return -1;
+}
+
+void
+sg_inq_cache_put_resp(int sg_fd, int kind, const uint8_t * resp, int len,
+                      int verbose)
+{
+    if (sg_fd || kind || resp || len || verbose) { }
+}
+
+int
+sg_opcode_is_supported(int sg_fd, int opcode, int sa, int verbose)
+{
+    if (sg_fd || opcode || sa || verbose) { }   /* suppress warning */
+    return -1;
+}
+
+int
+sg_opcode_recommended_timeout(int sg_fd, int opcode, int sa, int def_secs,
+                              int verbose)
+{
+    if (sg_fd || opcode || sa || verbose) { }   /* suppress warning */
+    return def_secs;
+}
+
+#endif  /* SG_INQ_CACHE */
+
+static int retry_state;         /* 0: env not checked yet, 1: checked */
+static struct sg_retry_policy retry_pol;
+
+#if defined(__GNUC__)
+static __thread uint64_t deadline_ns;   /* sg_pt_lat_now_ns() based, 0: none */
+#else
+static uint64_t deadline_ns;
+#endif
+
+void
+sg_cmds_deadline_set(uint32_t budget_ms)
+{
+    deadline_ns = budget_ms ?
+                  (sg_pt_lat_now_ns() + ((uint64_t)budget_ms * 1000000)) : 0;
+}
+
+int
+sg_cmds_deadline_left_ms(void)
+{
+    uint64_t now;
+
+    if (0 == deadline_ns)
+        return -1;
+    now = sg_pt_lat_now_ns();
+    if (now >= deadline_ns)
+        return 0;
+    /* round up so that 0 only means passed */
+    return (int)((deadline_ns - now + 999999) / 1000000);
+}
+
+/* SG3_UTILS_RETRY=N[,BASE_MS[,MAX_MS[,BUDGET_MS]]] retries all classes */
+static const struct sg_retry_policy *
+retry_policy(void)
+{
+    if (0 == retry_state) {
+        unsigned int v[4] = {0, 0, 0, 0};
+        const char * cp = getenv("SG3_UTILS_RETRY");
+
+        if (cp && (sscanf(cp, "%u,%u,%u,%u", v + 0, v + 1, v + 2, v + 3) >
+                   0) && (v[0] > 0)) {
+            retry_pol.max_retries = (int)v[0];
+            retry_pol.classes = SG_RETRY_ALL;
+            retry_pol.base_ms = v[1];
+            retry_pol.max_ms = v[2];
+            retry_pol.budget_ms = v[3];
+        }
+        retry_state = 1;
+    }
+    return &retry_pol;
+}
+
+void
+sg_retry_policy_set(const struct sg_retry_policy * rpp)
+{
+    if (rpp)
+        retry_pol = *rpp;
+    else
+        memset(&retry_pol, 0, sizeof(retry_pol));
+    retry_state = 1;
+}
+
+void
+sg_retry_policy_get(struct sg_retry_policy * rpp)
+{
+    if (rpp)
+        *rpp = *retry_policy();
+}
+
+/* As sg_retry_classify() with the sense data already decoded ('sip' is
+ * NULL if there is none) */
+static int
+retry_classify_sinfo(int scsi_status, const struct sg_scsi_sense_info * sip)
+{
+    switch (scsi_status & 0x7e) {
+    case SAM_STAT_BUSY:
+        return SG_RETRY_BUSY;
+    case SAM_STAT_TASK_SET_FULL:
+        return SG_RETRY_TS_FULL;
+    case SAM_STAT_TASK_ABORTED:
+        return SG_RETRY_ABORTED;
+    case SAM_STAT_CHECK_CONDITION:
+    case SAM_STAT_COMMAND_TERMINATED:
+        break;
+    default:
+        return 0;
+    }
+    if (NULL == sip)
+        return 0;
+    switch (sip->sense_key) {
+    case SPC_SK_UNIT_ATTENTION:
+        return SG_RETRY_UA;
+    case SPC_SK_ABORTED_COMMAND:
+        /* a protection information check failure will not go away */
+        return (0x10 == sip->asc) ? 0 : SG_RETRY_ABORTED;
+    case SPC_SK_NOT_READY:
+        /* only "in process of becoming ready", not formatting and the like
+         * which take far longer than any backoff */
+        return ((0x4 == sip->asc) && (0x1 == sip->ascq)) ?
+               SG_RETRY_NOT_READY : 0;
+    default:
+        return 0;
+    }
+}
+
+int
+sg_retry_classify(int scsi_status, const uint8_t * sbp, int slen)
+{
+    int st = scsi_status & 0x7e;
+    struct sg_scsi_sense_info si;
+
+    /* only decode when the status says sense data matters */
+    if (((SAM_STAT_CHECK_CONDITION == st) ||
+         (SAM_STAT_COMMAND_TERMINATED == st)) && sbp && (slen > 0) &&
+        sg_scsi_decode_sense(sbp, slen, &si))
+        return retry_classify_sinfo(scsi_status, &si);
+    return retry_classify_sinfo(scsi_status, NULL);
+}
+
+bool
+sg_retry_wait(int rclass, int attempt, uint32_t * slept_msp, int verbose)
+{
+    int left_ms;
+    uint32_t base, mx, ms;
+    uint64_t now;
+    const struct sg_retry_policy * rpp = retry_policy();
+
+    if ((0 == rclass) || (attempt >= rpp->max_retries) ||
+        (0 == (rclass & rpp->classes)))
+        return false;
+    base = rpp->base_ms ? rpp->base_ms : SG_RETRY_DEF_BASE_MS;
+    mx = rpp->max_ms ? rpp->max_ms : SG_RETRY_DEF_MAX_MS;
+    ms = (attempt < 31) ? (base << attempt) : mx;
+    if ((ms > mx) || (ms < base))       /* second test catches overflow */
+        ms = mx;
+    /* the clock's low bits are random enough to spread the retries of
+     * different initiators over [ms/2, ms] */
+    now = sg_pt_lat_now_ns();
+    ms = (ms / 2) + (uint32_t)(((now >> 10) ^ now) % ((ms / 2) + 1));
+    if (slept_msp) {
+        if (rpp->budget_ms && ((*slept_msp + ms) > rpp->budget_ms))
+            return false;
+        *slept_msp += ms;
+    }
+    left_ms = sg_cmds_deadline_left_ms();
+    if ((left_ms >= 0) && (ms >= (uint32_t)left_ms))
+        return false;   /* no time left for the repeat */
+    if (verbose > 1)
+        pr2ws("    retry %d (class 0x%x) after %u ms\n", attempt + 1, rclass,
+              ms);
+    sg_pt_null_wait(sg_pt_lat_now_ns() + ((uint64_t)ms * 1000000), false);
+    return true;
+}
+
+#define SG_UA_MAX_REC 64        /* records held, the oldest are dropped */
+
+static int ua_state;            /* 0: env not checked yet, 1: checked */
+static unsigned int ua_classes;
+static struct sg_ua_record ua_rec_arr[SG_UA_MAX_REC];
+static int ua_num_rec;
+
+#if defined(__GNUC__)
+static char ua_lck;
+
+#define UA_LOCK() \
+    while (__atomic_test_and_set(&ua_lck, __ATOMIC_ACQUIRE)) { ; }
+#define UA_UNLOCK() __atomic_clear(&ua_lck, __ATOMIC_RELEASE)
+#else
+#define UA_LOCK()
+#define UA_UNLOCK()
+#endif
+
+/* SG3_UTILS_UA_TRACK=CLASSES, OR-ed SG_UA_* values (e.g. 0xf) */
+static unsigned int
+ua_tracker_classes(void)
+{
+    if (0 == ua_state) {
+        const char * cp = getenv("SG3_UTILS_UA_TRACK");
+
+        if (cp && *cp)
+            ua_classes = (unsigned int)strtoul(cp, NULL, 0) & SG_UA_EXPECTED;
+        ua_state = 1;
+    }
+    return ua_classes;
+}
+
+void
+sg_ua_tracker_set(unsigned int classes)
+{
+    ua_classes = classes & SG_UA_EXPECTED;
+    ua_state = 1;
+}
+
+unsigned int
+sg_ua_tracker_get(void)
+{
+    return ua_tracker_classes();
+}
+
+static int
+ua_classify_sinfo(const struct sg_scsi_sense_info * sip)
+{
+    if ((NULL == sip) || (SPC_SK_UNIT_ATTENTION != sip->sense_key))
+        return 0;
+    switch (sip->asc) {
+    case 0x29:
+        return SG_UA_RESET;
+    case 0x2a:
+        return SG_UA_PARAMS_CHANGED;
+    case 0x3f:
+        if (0xe == sip->ascq)
+            return SG_UA_LUNS_CHANGED;
+        return ((sip->ascq >= 0x1) && (sip->ascq <= 0x3)) ?
+               SG_UA_INQ_CHANGED : 0;
+    default:
+        return 0;
+    }
+}
+
+int
+sg_ua_classify(const uint8_t * sbp, int slen)
+{
+    struct sg_scsi_sense_info si;
+
+    if (sbp && (slen > 0) && sg_scsi_decode_sense(sbp, slen, &si))
+        return ua_classify_sinfo(&si);
+    return 0;
+}
+
+/* Places a name for the I_T nexus that fd reaches its logical unit through
+ * in b */
+static void
+ua_nexus_key(int fd, char * b, int blen)
+{
+#ifndef SG_LIB_WIN32
+    struct stat st;
+
+    if ((fd >= 0) && (0 == fstat(fd, &st))) {
+        if (S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode)) {
+#ifdef SG_LIB_LINUX
+            int n, h, c, t, l;
+            const char * cp;
+            char path[64];
+            char lnk[256];
+
+            /* device link ends with the H:C:T:L of a SCSI device */
+            snprintf(path, sizeof(path), "/sys/dev/%s/%u:%u/device",
+                     S_ISCHR(st.st_mode) ? "char" : "block",
+                     major(st.st_rdev), minor(st.st_rdev));
+            n = readlink(path, lnk, sizeof(lnk) - 1);
+            if (n > 0) {
+                lnk[n] = '\0';
+                cp = strrchr(lnk, '/');
+                cp = cp ? (cp + 1) : lnk;
+                if (4 == sscanf(cp, "%d:%d:%d:%d", &h, &c, &t, &l)) {
+                    snprintf(b, blen, "%d:%d:%d", h, c, t);
+                    return;
+                }
+            }
+#endif
+            snprintf(b, blen, "rdev:%" PRIx64, (uint64_t)st.st_rdev);
+        } else
+            snprintf(b, blen, "ino:%" PRIx64 ":%" PRIx64,
+                     (uint64_t)st.st_dev, (uint64_t)st.st_ino);
+        return;
+    }
+#endif
+    snprintf(b, blen, "fd:%d", fd);
+}
+
+static void
+ua_record(const char * key, int ua_class, int asc, int ascq)
+{
+    int k;
+    uint64_t now = sg_pt_lat_now_ns();
+    struct sg_ua_record * rp;
+
+    UA_LOCK();
+    for (k = 0; k < ua_num_rec; ++k) {
+        rp = ua_rec_arr + k;
+        if ((ua_class == rp->ua_class) && (0 == strcmp(key, rp->nexus)))
+            break;
+    }
+    if (k >= ua_num_rec) {
+        if (ua_num_rec >= SG_UA_MAX_REC) {      /* drop the oldest */
+            memmove(ua_rec_arr, ua_rec_arr + 1,
+                    (SG_UA_MAX_REC - 1) * sizeof(ua_rec_arr[0]));
+            --ua_num_rec;
+        }
+        rp = ua_rec_arr + ua_num_rec++;
+        memset(rp, 0, sizeof(*rp));
+        snprintf(rp->nexus, sizeof(rp->nexus), "%s", key);
+        rp->ua_class = ua_class;
+        rp->first_ns = now;
+    }
+    rp->asc = (uint8_t)asc;
+    rp->ascq = (uint8_t)ascq;
+    ++rp->count;
+    rp->last_ns = now;
+    UA_UNLOCK();
+}
+
+int
+sg_ua_take(int sg_fd, struct sg_ua_record * arr, int max_arr)
+{
+    int k, j, n;
+    char key[SG_UA_NEXUS_LEN];
+
+    if (sg_fd >= 0)
+        ua_nexus_key(sg_fd, key, sizeof(key));
+    if (NULL == arr)
+        max_arr = 0;
+    n = 0;
+    UA_LOCK();
+    for (k = 0, j = 0; k < ua_num_rec; ++k) {
+        const struct sg_ua_record * rp = ua_rec_arr + k;
+
+        if ((sg_fd < 0) || (0 == strcmp(key, rp->nexus))) {
+            if (NULL == arr) {
+                ++n;
+                continue;       /* only counting, keep it */
+            }
+            if (n < max_arr) {
+                arr[n++] = *rp;
+                continue;       /* taken */
+            }
+        }
+        if (j != k)
+            ua_rec_arr[j] = *rp;
+        ++j;
+    }
+    ua_num_rec = j;
+    UA_UNLOCK();
+    return n;
+}
+
+/* If the tracker is on and the command got a unit attention in one of the
+ * classes it absorbs, records that and returns true */
+static bool
+ua_absorb(struct sg_pt_base * ptvp, int verbose)
+{
+    int ua_class;
+    unsigned int classes = ua_tracker_classes();
+    const struct sg_scsi_sense_info * sip;
+    char key[SG_UA_NEXUS_LEN];
+
+    if ((0 == classes) || (SAM_STAT_CHECK_CONDITION !=
+                           (0x7e & get_scsi_pt_status_response(ptvp))))
+        return false;
+    sip = get_scsi_pt_sense_info(ptvp);
+    ua_class = ua_classify_sinfo(sip);
+    if (0 == (ua_class & (int)classes))
+        return false;
+    ua_nexus_key(get_pt_file_handle(ptvp), key, sizeof(key));
+    ua_record(key, ua_class, sip->asc, sip->ascq);
+#ifdef SG_INQ_CACHE
+    inq_cache_check_ua(ptvp);
+#endif
+    if (verbose > 1) {
+        char b[80];
+
+        pr2ws("    absorbed unit attention on %s: %s\n", key,
+              sg_get_asc_ascq_str(sip->asc, sip->ascq, sizeof(b), b));
+    }
+    return true;
+}
+
+int
+sg_cmds_do_pt(struct sg_pt_base * ptvp, const uint8_t * cdbp, int cdb_len,
+              int fd, int time_secs, int verbose)
+{
+    int k, res, rclass, left_ms, tmo;
+    int absorbed = 0;
+    uint32_t slept_ms = 0;
+
+    for (k = 0; ; ) {
+        tmo = time_secs;
+        if ((left_ms = sg_cmds_deadline_left_ms()) >= 0) {
+            if (0 == left_ms) {
+                if (verbose)
+                    pr2ws("%s: deadline passed, command not issued\n",
+                          __func__);
+                return SCSI_PT_DO_TIMEOUT;
+            }
+            if ((uint32_t)left_ms < sg_pt_timeout_ms(time_secs,
+                                                     DEF_PT_TIMEOUT * 1000))
+                tmo = SG_PT_TIMEOUT_MS(left_ms);
+        }
+        res = do_scsi_pt(ptvp, fd, tmo, verbose);
+        if (res)
+            return res;     /* os error or timeout: not ours to repeat */
+        if ((absorbed < SG_UA_MAX_ABSORB) && ua_absorb(ptvp, verbose))
+            ++absorbed;     /* repeat at once */
+        else {
+            if (0 == retry_policy()->max_retries)
+                return res;
+            rclass = retry_classify_sinfo(get_scsi_pt_status_response(ptvp),
+                                          get_scsi_pt_sense_info(ptvp));
+            if (0 == rclass)
+                return res;
+#ifdef SG_INQ_CACHE
+            if (SG_RETRY_UA == rclass)
+                inq_cache_check_ua(ptvp);
+#endif
+            if (! sg_retry_wait(rclass, k++, &slept_ms, verbose))
+                return res;
+        }
+        rearm_scsi_pt_obj(ptvp);
+        set_scsi_pt_cdb(ptvp, cdbp, cdb_len);
+        fd = -1;        /* now bound to the object */
+    }
+}
+
 /* This is a helper function used by sg_cmds_* implementations after the
  * call to the pass-through. pt_res is returned from do_scsi_pt(). If valid
  * sense data is found it is decoded and output to sg_warnings_strm (def:
@@ -192,7 +1372,7 @@ sg_cmds_process_resp(struct sg_pt_base * ptvp, const char * leadin,
                      int pt_res, bool noisy, int verbose, int * o_sense_cat)
 {
     bool transport_sense;
-    int cat, slen, resp_code, sstat, req_din_x, req_dout_x;
+    int cat, slen, sstat, req_din_x, req_dout_x;
     int act_din_x, act_dout_x;
     const uint8_t * sbp;
     char b[1024];
@@ -243,19 +1423,9 @@ sg_cmds_process_resp(struct sg_pt_base * ptvp, const char * leadin,
     sbp = get_scsi_pt_sense_buf(ptvp);
     switch ((cat = get_scsi_pt_result_category(ptvp))) {
     case SCSI_PT_RESULT_GOOD:
-        if (sbp && (slen > 7)) {
-            resp_code = sbp[0] & 0x7f;
-            /* SBC referrals can have status=GOOD and sense_key=COMPLETED */
-            if (resp_code >= 0x70) {
-                if (resp_code < 0x72) {
-                    if (SPC_SK_NO_SENSE != (0xf & sbp[2]))
-                        sg_err_category_sense(sbp, slen);
-                } else if (resp_code < 0x74) {
-                    if (SPC_SK_NO_SENSE != (0xf & sbp[1]))
-                        sg_err_category_sense(sbp, slen);
-                }
-            }
-        }
+        /* SBC referrals can have status=GOOD and sense_key=COMPLETED; that
+         * sense is left to get_scsi_pt_sense_info() callers, not parsed
+         * here on every good completion */
         if (req_din_x > 0) {
             if (act_din_x != req_din_x) {
                 if ((verbose > 1) && (act_din_x >= 0))
@@ -313,8 +1483,13 @@ sg_cmds_process_resp(struct sg_pt_base * ptvp, const char * leadin,
         }
         return -1;
     case SCSI_PT_RESULT_SENSE:
+#ifdef SG_INQ_CACHE
+        inq_cache_check_ua(ptvp);
+#endif
         return sg_cmds_process_helper(leadin, req_din_x, act_din_x,
                                       req_dout_x, act_dout_x, sbp, slen,
+                                      get_scsi_pt_sense_category(ptvp),
+                                      get_scsi_pt_sense_info(ptvp),
                                       noisy, verbose, o_sense_cat);
     case SCSI_PT_RESULT_TRANSPORT_ERR:
         if (verbose || noisy) {
@@ -330,6 +1505,8 @@ sg_cmds_process_resp(struct sg_pt_base * ptvp, const char * leadin,
         if (transport_sense)
             return sg_cmds_process_helper(leadin, req_din_x, act_din_x,
                                           req_dout_x, act_dout_x, sbp, slen,
+                                          get_scsi_pt_sense_category(ptvp),
+                                          get_scsi_pt_sense_info(ptvp),
                                           noisy, verbose, o_sense_cat);
         else
             return -1;
@@ -352,10 +1529,60 @@ sg_cmds_is_nvme(const struct sg_pt_base * ptvp)
     return pt_device_is_nvme(ptvp);
 }
 
+/* One cached pass-through object per thread (where the compiler supports
+ * thread local storage), so the sg_ll_* functions do not call malloc()
+ * and free() for each command. */
+#if defined(__GNUC__) && (! defined(SG_LIB_NO_PT_OBJ_CACHE))
+#define SG_CMDS_PT_OBJ_CACHE 1
+static __thread struct sg_pt_base * cached_ptvp = NULL;
+#endif
+
+struct sg_pt_base *
+sg_cmds_get_pt_obj(int sg_fd, int verbose)
+{
+#ifdef SG_CMDS_PT_OBJ_CACHE
+    struct sg_pt_base * ptvp = cached_ptvp;
+
+    if (ptvp) {
+        cached_ptvp = NULL;
+        clear_scsi_pt_obj(ptvp);
+        /* re-probe since the fd may have been closed and reused */
+        set_pt_file_handle(ptvp, sg_fd, verbose);
+        return ptvp;
+    }
+#endif
+    return construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+}
+
+void
+sg_cmds_put_pt_obj(struct sg_pt_base * ptvp)
+{
+    if (NULL == ptvp)
+        return;
+#ifdef SG_CMDS_PT_OBJ_CACHE
+    if (NULL == cached_ptvp) {
+        cached_ptvp = ptvp;
+        return;
+    }
+#endif
+    destruct_scsi_pt_obj(ptvp);
+}
+
+void
+sg_cmds_free_pt_obj_cache(void)
+{
+#ifdef SG_CMDS_PT_OBJ_CACHE
+    if (cached_ptvp) {
+        destruct_scsi_pt_obj(cached_ptvp);
+        cached_ptvp = NULL;
+    }
+#endif
+}
+
 static struct sg_pt_base *
 create_pt_obj(const char * cname)
 {
-    struct sg_pt_base * ptvp = construct_scsi_pt_obj();
+    struct sg_pt_base * ptvp = sg_cmds_get_pt_obj(-1, 0);
     if (NULL == ptvp)
         pr2ws("%s: out of memory\n", cname);
     return ptvp;
@@ -376,6 +1603,27 @@ sg_ll_inquiry_com(struct sg_pt_base * ptvp, bool cmddt, bool evpd, int pg_op,
     uint8_t inq_cdb[INQUIRY_CMDLEN] = {INQUIRY_CMD, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
     uint8_t * up;
+#ifdef SG_INQ_CACHE
+    struct sg_inq_cache_fd * csp = NULL;
+
+    if ((! cmddt) && resp && (mx_resp_len > 0) && (! inq_cache_busy) &&
+        inq_cache_page_ok(evpd, pg_op) && inq_cache_on()) {
+        csp = inq_cache_slot(ptvp, get_pt_file_handle(ptvp), false, verbose);
+        if (csp && ('\0' == csp->key[0]))
+            csp = NULL;
+        if (csp && ((k = inq_cache_get(csp->key, evpd, pg_op,
+                                       (uint8_t *)resp, mx_resp_len)) > 0)) {
+            if (verbose)
+                pr2ws("    %s: %s %d bytes from cache\n", inquiry_s,
+                      evpd ? "VPD page" : "response", k);
+            if (k < mx_resp_len)
+                memset((uint8_t *)resp + k, 0, mx_resp_len - k);
+            if (residp)
+                *residp = mx_resp_len - k;
+            return 0;
+        }
+    }
+#endif
 
     if (cmddt)
         inq_cdb[1] |= 0x2;
@@ -401,7 +1649,8 @@ sg_ll_inquiry_com(struct sg_pt_base * ptvp, bool cmddt, bool evpd, int pg_op,
     set_scsi_pt_cdb(ptvp, inq_cdb, sizeof(inq_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, -1, timeout_secs, verbose);
+    res = sg_cmds_do_pt(ptvp, inq_cdb, sizeof(inq_cdb), -1,
+                        timeout_secs, verbose);
     ret = sg_cmds_process_resp(ptvp, inquiry_s, res, noisy, verbose,
                                &sense_cat);
     resid = get_scsi_pt_resid(ptvp);
@@ -435,6 +1684,11 @@ sg_ll_inquiry_com(struct sg_pt_base * ptvp, bool cmddt, bool evpd, int pg_op,
         /* zero unfilled section of response buffer, based on resid */
         memset((uint8_t *)resp + (mx_resp_len - resid), 0, resid);
     }
+#ifdef SG_INQ_CACHE
+    if (csp && (0 == ret) && (resid >= 0))
+        inq_cache_put(csp->key, evpd, pg_op, (const uint8_t *)resp,
+                      mx_resp_len - resid);
+#endif
     return ret;
 }
 
@@ -448,12 +1702,12 @@ sg_ll_inquiry(int sg_fd, bool cmddt, bool evpd, int pg_op, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_inquiry_com(ptvp, cmddt, evpd, pg_op, resp, mx_resp_len,
                             0 /* timeout_sec */, NULL, noisy, verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -476,12 +1730,12 @@ sg_ll_inquiry_v2(int sg_fd, bool evpd, int pg_op, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_inquiry_com(ptvp, false, evpd, pg_op, resp, mx_resp_len,
                             timeout_secs, residp, noisy, verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -609,16 +1863,17 @@ sg_ll_test_unit_ready_progress_pt(struct sg_pt_base * ptvp, int pack_id,
     set_scsi_pt_cdb(ptvp, tur_cdb, sizeof(tur_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_packet_id(ptvp, pack_id);
-    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
+    res = sg_cmds_do_pt(ptvp, tur_cdb, sizeof(tur_cdb), -1,
+                        DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, tur_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
     else if (-2 == ret) {
         if (progress) {
-            int slen = get_scsi_pt_sense_len(ptvp);
+            const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-            if (! sg_get_sense_progress_fld(sense_b, slen, progress))
-                *progress = -1;
+            *progress = (sip && sip->progress_present) ? sip->progress : -1;
         }
         switch (sense_cat) {
         case SG_LIB_CAT_RECOVERED:
@@ -641,12 +1896,12 @@ sg_ll_test_unit_ready_progress(int sg_fd, int pack_id, int * progress,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_test_unit_ready_progress_pt(ptvp, pack_id, progress, noisy,
                                             verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -660,12 +1915,12 @@ sg_ll_test_unit_ready(int sg_fd, int pack_id, bool noisy, int verbose)
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_test_unit_ready_progress_pt(ptvp, pack_id, NULL, noisy,
                                             verbose);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -707,14 +1962,15 @@ sg_ll_request_sense_com(struct sg_pt_base * ptvp, int sg_fd, bool desc,
     if (ptvp)
         ptvp_given = true;
     else {
-        ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+        ptvp = sg_cmds_get_pt_obj(sg_fd, verbose);
         if (NULL == ptvp)
             return sg_convert_errno(ENOMEM);
     }
     set_scsi_pt_cdb(ptvp, rs_cdb, sizeof(rs_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
+    res = sg_cmds_do_pt(ptvp, rs_cdb, sizeof(rs_cdb), -1,
+                        DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, rq_s, res, noisy, verbose, &sense_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -738,7 +1994,7 @@ sg_ll_request_sense_com(struct sg_pt_base * ptvp, int sg_fd, bool desc,
             ret = 0;
     }
     if ((! ptvp_given) && ptvp)
-        destruct_scsi_pt_obj(ptvp);
+        sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -788,7 +2044,8 @@ sg_ll_report_luns_com(struct sg_pt_base * ptvp, int sg_fd, int select_report,
     set_scsi_pt_cdb(ptvp, rl_cdb, sizeof(rl_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    res = sg_cmds_do_pt(ptvp, rl_cdb, sizeof(rl_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, verbose);
     ret = sg_cmds_process_resp(ptvp, report_luns_s, res, noisy, verbose,
                                &sense_cat);
     if (-1 == ret)
@@ -806,7 +2063,7 @@ sg_ll_report_luns_com(struct sg_pt_base * ptvp, int sg_fd, int select_report,
     } else
         ret = 0;
     if ((! ptvp_given) && ptvp)
-        destruct_scsi_pt_obj(ptvp);
+        sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
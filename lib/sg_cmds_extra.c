@@ -70,6 +70,7 @@
 #define THIRD_PARTY_COPY_OUT_CMDLEN 16
 #define THIRD_PARTY_COPY_IN_CMD 0x84     /* was RECEIVE_COPY_RESULTS_CMD */
 #define THIRD_PARTY_COPY_IN_CMDLEN 16
+#define RCOP_SA 0x3     /* RECEIVE COPY OPERATING PARAMETERS */
 #define SEND_DIAGNOSTIC_CMD   0x1d
 #define SEND_DIAGNOSTIC_CMDLEN  6
 #define SERVICE_ACTION_IN_12_CMD 0xab
@@ -109,7 +110,7 @@
 static struct sg_pt_base *
 create_pt_obj(const char * cname)
 {
-    struct sg_pt_base * ptvp = construct_scsi_pt_obj();
+    struct sg_pt_base * ptvp = sg_cmds_get_pt_obj(-1, 0);
     if (NULL == ptvp)
         pr2ws("%s: out of memory\n", cname);
     return ptvp;
@@ -147,7 +148,8 @@ sg_ll_get_lba_status16(int sg_fd, uint64_t start_llba, uint8_t rt,
     set_scsi_pt_cdb(ptvp, getLbaStatCmd, sizeof(getLbaStatCmd));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, alloc_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, getLbaStatCmd, sizeof(getLbaStatCmd), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -175,7 +177,7 @@ sg_ll_get_lba_status16(int sg_fd, uint64_t start_llba, uint8_t rt,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -222,7 +224,8 @@ sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
     set_scsi_pt_cdb(ptvp, gls32_cmd, sizeof(gls32_cmd));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, alloc_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, gls32_cmd, sizeof(gls32_cmd), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -250,7 +253,7 @@ sg_ll_get_lba_status32(int sg_fd, uint64_t start_llba, uint32_t scan_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -291,7 +294,8 @@ sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
     set_scsi_pt_cdb(ptvp, rtpg_cdb, sizeof(rtpg_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rtpg_cdb, sizeof(rtpg_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -319,7 +323,7 @@ sg_ll_report_tgt_prt_grp2(int sg_fd, void * resp, int mx_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -354,7 +358,8 @@ sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
     set_scsi_pt_cdb(ptvp, stpg_cdb, sizeof(stpg_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, stpg_cdb, sizeof(stpg_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -370,7 +375,7 @@ sg_ll_set_tgt_prt_grp(int sg_fd, void * paramp, int param_len, bool noisy,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -405,7 +410,8 @@ sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
     set_scsi_pt_cdb(ptvp, repRef_cdb, sizeof(repRef_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, repRef_cdb, sizeof(repRef_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -433,7 +439,7 @@ sg_ll_report_referrals(int sg_fd, uint64_t start_llba, bool one_seg,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -486,7 +492,8 @@ sg_ll_send_diag_pt(struct sg_pt_base * ptvp, int st_code, bool pf_bit,
     set_scsi_pt_cdb(ptvp, senddiag_cdb, sizeof(senddiag_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, -1, tmout, vb);
+    res = sg_cmds_do_pt(ptvp, senddiag_cdb, sizeof(senddiag_cdb), -1,
+                        tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -514,13 +521,13 @@ sg_ll_send_diag(int sg_fd, int st_code, bool pf_bit, bool st_bit,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_send_diag_pt(ptvp, st_code, pf_bit, st_bit, devofl_bit,
                              unitofl_bit, long_duration, paramp, param_len,
                              noisy, vb);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -555,7 +562,8 @@ sg_ll_receive_diag_pt(struct sg_pt_base * ptvp, bool pcv, int pg_code,
     set_scsi_pt_cdb(ptvp, rcvdiag_cdb, sizeof(rcvdiag_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, -1, timeout_secs, vb);
+    res = sg_cmds_do_pt(ptvp, rcvdiag_cdb, sizeof(rcvdiag_cdb), -1,
+                        timeout_secs, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     resid = get_scsi_pt_resid(ptvp);
     if (residp)
@@ -599,12 +607,12 @@ sg_ll_receive_diag(int sg_fd, bool pcv, int pg_code, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_receive_diag_pt(ptvp, pcv, pg_code, resp, mx_resp_len, 0,
                                 NULL, noisy, vb);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -616,12 +624,12 @@ sg_ll_receive_diag_v2(int sg_fd, bool pcv, int pg_code, void * resp,
     int ret;
     struct sg_pt_base * ptvp;
 
-    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+    ptvp = sg_cmds_get_pt_obj(sg_fd, vb);
     if (NULL == ptvp)
         return sg_convert_errno(ENOMEM);
     ret = sg_ll_receive_diag_pt(ptvp, pcv, pg_code, resp, mx_resp_len,
                                 timeout_secs, residp, noisy, vb);
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -660,7 +668,8 @@ sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist, int dl_format,
     set_scsi_pt_cdb(ptvp, rdef_cdb, sizeof(rdef_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rdef_cdb, sizeof(rdef_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -688,7 +697,7 @@ sg_ll_read_defect10(int sg_fd, bool req_plist, bool req_glist, int dl_format,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -719,7 +728,8 @@ sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
     set_scsi_pt_cdb(ptvp, rmsn_cdb, sizeof(rmsn_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rmsn_cdb, sizeof(rmsn_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -747,7 +757,7 @@ sg_ll_read_media_serial_num(int sg_fd, void * resp, int mx_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -781,7 +791,8 @@ sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
     set_scsi_pt_cdb(ptvp, rii_cdb, sizeof(rii_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, max_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rii_cdb, sizeof(rii_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -809,7 +820,7 @@ sg_ll_report_id_info(int sg_fd, int itype, void * resp, int max_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -846,7 +857,8 @@ sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
     set_scsi_pt_cdb(ptvp, sii_cdb, sizeof(sii_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, sii_cdb, sizeof(sii_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -863,7 +875,7 @@ sg_ll_set_id_info(int sg_fd, int itype, void * paramp, int param_len,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -939,7 +951,7 @@ sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
     set_scsi_pt_cdb(ptvp, fu_cdb, sizeof(fu_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = sg_cmds_do_pt(ptvp, fu_cdb, sizeof(fu_cdb), sg_fd, tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -956,7 +968,7 @@ sg_ll_format_unit_v2(int sg_fd, int fmtpinfo, bool longlist, bool fmtdata,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -993,7 +1005,8 @@ sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist, void * paramp,
     set_scsi_pt_cdb(ptvp, reass_cdb, sizeof(reass_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, reass_cdb, sizeof(reass_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1010,7 +1023,7 @@ sg_ll_reassign_blocks(int sg_fd, bool longlba, bool longlist, void * paramp,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1044,7 +1057,8 @@ sg_ll_persistent_reserve_in(int sg_fd, int rq_servact, void * resp,
     set_scsi_pt_cdb(ptvp, prin_cdb, sizeof(prin_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, prin_cdb, sizeof(prin_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1072,7 +1086,7 @@ sg_ll_persistent_reserve_in(int sg_fd, int rq_servact, void * resp,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1112,7 +1126,8 @@ sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
     set_scsi_pt_cdb(ptvp, prout_cdb, sizeof(prout_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, prout_cdb, sizeof(prout_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1129,25 +1144,24 @@ sg_ll_persistent_reserve_out(int sg_fd, int rq_servact, int rq_scope,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
 static bool
-has_blk_ili(uint8_t * sensep, int sb_len)
+has_blk_ili(const uint8_t * sensep, const struct sg_scsi_sense_info * sip)
 {
-    int resp_code;
-    const uint8_t * cup;
+    int k;
 
-    if (sb_len < 8)
+    if (NULL == sip)
         return false;
-    resp_code = (0x7f & sensep[0]);
-    if (resp_code >= 0x72) { /* descriptor format */
-        /* find block command descriptor */
-        if ((cup = sg_scsi_sense_desc_find(sensep, sb_len, 0x5)))
-            return (cup[3] & 0x20);
-    } else /* fixed */
-        return (sensep[2] & 0x20);
+    if (! sip->descriptor_format)
+        return sip->ili;
+    /* block command descriptor, found via the cached decode's offsets */
+    for (k = 0; (k < sip->num_descs) && (k < SG_SENSE_MAX_DESCS); ++k) {
+        if ((0x5 == sip->desc[k].type) && (sip->desc[k].len > 3))
+            return !!(sensep[sip->desc[k].offset + 3] & 0x20);
+    }
     return false;
 }
 
@@ -1186,7 +1200,8 @@ sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
     set_scsi_pt_cdb(ptvp, readLong_cdb, sizeof(readLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, readLong_cdb, sizeof(readLong_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1199,12 +1214,14 @@ sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
         case SG_LIB_CAT_ILLEGAL_REQ:
             {
                 bool valid, ili;
-                int slen;
                 uint64_t ull = 0;
+                const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-                slen = get_scsi_pt_sense_len(ptvp);
-                valid = sg_get_sense_info_fld(sense_b, slen, &ull);
-                ili = has_blk_ili(sense_b, slen);
+                valid = sip && sip->info_valid;
+                if (sip)
+                    ull = sip->info;
+                ili = has_blk_ili(sense_b, sip);
                 if (valid && ili) {
                     if (offsetp)
                         *offsetp = (int)(int64_t)ull;
@@ -1235,7 +1252,7 @@ sg_ll_read_long10(int sg_fd, bool pblock, bool correct, unsigned int lba,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1275,7 +1292,8 @@ sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
     set_scsi_pt_cdb(ptvp, readLong_cdb, sizeof(readLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, readLong_cdb, sizeof(readLong_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1288,12 +1306,14 @@ sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
         case SG_LIB_CAT_ILLEGAL_REQ:
             {
                 bool valid, ili;
-                int slen;
                 uint64_t ull = 0;
+                const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-                slen = get_scsi_pt_sense_len(ptvp);
-                valid = sg_get_sense_info_fld(sense_b, slen, &ull);
-                ili = has_blk_ili(sense_b, slen);
+                valid = sip && sip->info_valid;
+                if (sip)
+                    ull = sip->info;
+                ili = has_blk_ili(sense_b, sip);
                 if (valid && ili) {
                     if (offsetp)
                         *offsetp = (int)(int64_t)ull;
@@ -1324,7 +1344,7 @@ sg_ll_read_long16(int sg_fd, bool pblock, bool correct, uint64_t llba,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1365,7 +1385,8 @@ sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
     set_scsi_pt_cdb(ptvp, writeLong_cdb, sizeof(writeLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, writeLong_cdb, sizeof(writeLong_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1377,12 +1398,15 @@ sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
             break;
         case SG_LIB_CAT_ILLEGAL_REQ:
             {
-                int valid, slen, ili;
+                int valid, ili;
                 uint64_t ull = 0;
+                const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-                slen = get_scsi_pt_sense_len(ptvp);
-                valid = sg_get_sense_info_fld(sense_b, slen, &ull);
-                ili = has_blk_ili(sense_b, slen);
+                valid = sip && sip->info_valid;
+                if (sip)
+                    ull = sip->info;
+                ili = has_blk_ili(sense_b, sip);
                 if (valid && ili) {
                     if (offsetp)
                         *offsetp = (int)(int64_t)ull;
@@ -1402,7 +1426,7 @@ sg_ll_write_long10(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1444,7 +1468,8 @@ sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
     set_scsi_pt_cdb(ptvp, writeLong_cdb, sizeof(writeLong_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, xfer_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, writeLong_cdb, sizeof(writeLong_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1457,12 +1482,14 @@ sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
         case SG_LIB_CAT_ILLEGAL_REQ:
             {
                 bool valid, ili;
-                int slen;
                 uint64_t ull = 0;
+                const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-                slen = get_scsi_pt_sense_len(ptvp);
-                valid = sg_get_sense_info_fld(sense_b, slen, &ull);
-                ili = has_blk_ili(sense_b, slen);
+                valid = sip && sip->info_valid;
+                if (sip)
+                    ull = sip->info;
+                ili = has_blk_ili(sense_b, sip);
                 if (valid && ili) {
                     if (offsetp)
                         *offsetp = (int)(int64_t)ull;
@@ -1482,7 +1509,7 @@ sg_ll_write_long16(int sg_fd, bool cor_dis, bool wr_uncor, bool pblock,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1497,7 +1524,7 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
                int vb)
 {
     static const char * const cdb_s = "verify(10)";
-    int k, res, ret, s_cat, slen;
+    int k, res, ret, s_cat;
     uint8_t v_cdb[VERIFY10_CMDLEN] =
                 {VERIFY10_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
@@ -1527,7 +1554,7 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     if (data_out_len > 0)
         set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, data_out_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, v_cdb, sizeof(v_cdb), sg_fd, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1541,9 +1568,12 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
             {
                 bool valid;
                 uint64_t ull = 0;
+                const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-                slen = get_scsi_pt_sense_len(ptvp);
-                valid = sg_get_sense_info_fld(sense_b, slen, &ull);
+                valid = sip && sip->info_valid;
+                if (sip)
+                    ull = sip->info;
                 if (valid) {
                     if (infop)
                         *infop = (unsigned int)ull;
@@ -1559,7 +1589,7 @@ sg_ll_verify10(int sg_fd, int vrprotect, bool dpo, int bytchk,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1573,7 +1603,7 @@ sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
                int data_out_len, uint64_t * infop, bool noisy, int vb)
 {
     static const char * const cdb_s = "verify(16)";
-    int k, res, ret, s_cat, slen;
+    int k, res, ret, s_cat;
     uint8_t v_cdb[VERIFY16_CMDLEN] =
                 {VERIFY16_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
@@ -1604,7 +1634,7 @@ sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     if (data_out_len > 0)
         set_scsi_pt_data_out(ptvp, (uint8_t *)data_out, data_out_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, v_cdb, sizeof(v_cdb), sg_fd, DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1618,9 +1648,12 @@ sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
             {
                 bool valid;
                 uint64_t ull = 0;
+                const struct sg_scsi_sense_info * sip =
+                                get_scsi_pt_sense_info(ptvp);
 
-                slen = get_scsi_pt_sense_len(ptvp);
-                valid = sg_get_sense_info_fld(sense_b, slen, &ull);
+                valid = sip && sip->info_valid;
+                if (sip)
+                    ull = sip->info;
                 if (valid) {
                     if (infop)
                         *infop = ull;
@@ -1636,7 +1669,7 @@ sg_ll_verify16(int sg_fd, int vrprotect, bool dpo, int bytchk, uint64_t llba,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1736,9 +1769,9 @@ sg_ll_ata_pt(int sg_fd, const uint8_t * cdbp, int cdb_len,
         else if (doutp)
             set_scsi_pt_data_out(ptvp, (uint8_t *)doutp, dlen);
     }
-    res = do_scsi_pt(ptvp, sg_fd,
-                     ((timeout_secs > 0) ? timeout_secs : DEF_PT_TIMEOUT),
-                     vb);
+    res = sg_cmds_do_pt(ptvp, apt_cdb, cdb_len, sg_fd,
+                        ((timeout_secs > 0) ? timeout_secs : DEF_PT_TIMEOUT),
+                        vb);
     if (SCSI_PT_DO_BAD_PARAMS == res) {
         if (vb)
             pr2ws("%s: bad parameters\n", cnamep);
@@ -1810,7 +1843,7 @@ sg_ll_ata_pt(int sg_fd, const uint8_t * cdbp, int cdb_len,
     }
 
 out:
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1843,7 +1876,8 @@ sg_ll_read_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
     set_scsi_pt_cdb(ptvp, rbuf_cdb, sizeof(rbuf_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rbuf_cdb, sizeof(rbuf_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1871,7 +1905,7 @@ sg_ll_read_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1915,7 +1949,8 @@ sg_ll_write_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
     set_scsi_pt_cdb(ptvp, wbuf_cdb, sizeof(wbuf_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, wbuf_cdb, sizeof(wbuf_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -1932,7 +1967,7 @@ sg_ll_write_buffer(int sg_fd, int mode, int buffer_id, int buffer_offset,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -1983,7 +2018,7 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
     if (timeout_secs <= 0)
         timeout_secs = DEF_PT_TIMEOUT;
 
-    ptvp = construct_scsi_pt_obj();
+    ptvp = sg_cmds_get_pt_obj(-1, 0);
     if (NULL == ptvp) {
         pr2ws("%s: out of memory\n", __func__);
         return -1;
@@ -1991,7 +2026,8 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
     set_scsi_pt_cdb(ptvp, wbuf_cdb, sizeof(wbuf_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, timeout_secs, vb);
+    res = sg_cmds_do_pt(ptvp, wbuf_cdb, sizeof(wbuf_cdb), sg_fd,
+                        timeout_secs, vb);
     ret = sg_cmds_process_resp(ptvp, "Write buffer", res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2008,7 +2044,7 @@ sg_ll_write_buffer_v2(int sg_fd, int mode, int m_specific, int buffer_id,
     } else
         ret = 0;
 
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -2056,7 +2092,7 @@ sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
     set_scsi_pt_cdb(ptvp, u_cdb, sizeof(u_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = sg_cmds_do_pt(ptvp, u_cdb, sizeof(u_cdb), sg_fd, tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2072,7 +2108,7 @@ sg_ll_unmap_v2(int sg_fd, bool anchor, int group_num, int timeout_secs,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -2101,7 +2137,8 @@ sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
     set_scsi_pt_cdb(ptvp, rl_cdb, sizeof(rl_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rl_cdb, sizeof(rl_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2129,7 +2166,7 @@ sg_ll_read_block_limits(int sg_fd, void * resp, int mx_resp_len,
         }
         ret = 0;
     }
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -2140,7 +2177,9 @@ int
 sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
                            int mx_resp_len, bool noisy, int vb)
 {
+    bool cache_it = false;
     int k, res, ret, s_cat;
+    int got = 0;
     uint8_t rcvcopyres_cdb[THIRD_PARTY_COPY_IN_CMDLEN] =
       {THIRD_PARTY_COPY_IN_CMD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t sense_b[SENSE_BUFF_LEN];
@@ -2148,6 +2187,20 @@ sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
     char b[64];
 
     sg_get_opcode_sa_name(THIRD_PARTY_COPY_IN_CMD, sa, 0, (int)sizeof(b), b);
+    /* the copy manager's operating parameters are kept with the INQUIRY
+     * cache (when enabled) so later invocations need not ask again */
+    if ((RCOP_SA == sa) && resp && (mx_resp_len > 0)) {
+        k = sg_inq_cache_get_resp(sg_fd, SG_INQ_CACHE_KIND_RCOP,
+                                  (uint8_t *)resp, mx_resp_len, vb);
+        if (k > 0) {
+            if (vb)
+                pr2ws("    %s: %d bytes from cache\n", b, k);
+            if (k < mx_resp_len)
+                memset((uint8_t *)resp + k, 0, mx_resp_len - k);
+            return 0;
+        }
+        cache_it = true;
+    }
     rcvcopyres_cdb[1] = (uint8_t)(sa & 0x1f);
     if (sa <= 4)        /* LID1 variants */
         rcvcopyres_cdb[2] = (uint8_t)(list_id);
@@ -2167,7 +2220,8 @@ sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
     set_scsi_pt_cdb(ptvp, rcvcopyres_cdb, sizeof(rcvcopyres_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, rcvcopyres_cdb, sizeof(rcvcopyres_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, b, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2181,9 +2235,14 @@ sg_ll_receive_copy_results(int sg_fd, int sa, int list_id, void * resp,
             ret = s_cat;
             break;
         }
-    } else
+    } else {
+        got = ret;
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
+    }
+    sg_cmds_put_pt_obj(ptvp);
+    if (cache_it && (0 == ret) && (got >= 4))
+        sg_inq_cache_put_resp(sg_fd, SG_INQ_CACHE_KIND_RCOP,
+                              (const uint8_t *)resp, got, vb);
     return ret;
 }
 
@@ -2225,7 +2284,8 @@ sg_ll_extended_copy(int sg_fd, void * paramp, int param_len, bool noisy,
     set_scsi_pt_cdb(ptvp, xcopy_cdb, sizeof(xcopy_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, vb);
+    res = sg_cmds_do_pt(ptvp, xcopy_cdb, sizeof(xcopy_cdb), sg_fd,
+                        DEF_PT_TIMEOUT, vb);
     ret = sg_cmds_process_resp(ptvp, cdb_s, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2241,7 +2301,7 @@ sg_ll_extended_copy(int sg_fd, void * paramp, int param_len, bool noisy,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -2301,7 +2361,7 @@ sg_ll_3party_copy_out(int sg_fd, int sa, unsigned int list_id, int group_num,
     set_scsi_pt_cdb(ptvp, xcopy_cdb, sizeof(xcopy_cdb));
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
     set_scsi_pt_data_out(ptvp, (uint8_t *)paramp, param_len);
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = sg_cmds_do_pt(ptvp, xcopy_cdb, sizeof(xcopy_cdb), sg_fd, tmout, vb);
     ret = sg_cmds_process_resp(ptvp, cname, res, noisy, vb, &s_cat);
     if (-1 == ret)
         ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
@@ -2317,7 +2377,7 @@ sg_ll_3party_copy_out(int sg_fd, int sa, unsigned int list_id, int group_num,
         }
     } else
         ret = 0;
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
 
@@ -2395,7 +2455,7 @@ sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
         return -1;
     set_scsi_pt_cdb(ptvp, preFetchCdb, cdb_len);
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
-    res = do_scsi_pt(ptvp, sg_fd, tmout, vb);
+    res = sg_cmds_do_pt(ptvp, preFetchCdb, cdb_len, sg_fd, tmout, vb);
     if (0 == res) {
         int sstat = get_scsi_pt_status_response(ptvp);
 
@@ -2422,6 +2482,458 @@ sg_ll_pre_fetch_x(int sg_fd, bool do_seek10, bool cdb16, bool immed,
     } else
         ret = 0;
 fini:
-    destruct_scsi_pt_obj(ptvp);
+    sg_cmds_put_pt_obj(ptvp);
     return ret;
 }
+
+#define SG_PROGRESS_RS_LEN 252          /* REQUEST SENSE allocation length */
+#define SG_PROGRESS_FULL 65536          /* progress indication denominator */
+
+static void
+progress_finish(struct sg_progress_dev * dp, int state, uint64_t now)
+{
+    dp->state = state;
+    dp->end_ns = now;
+}
+
+/* Sets the interval to the next poll of dp from the progress indication
+ * just read at now */
+static void
+progress_adapt(struct sg_progress_dev * dp, uint64_t now)
+{
+    uint64_t ival = dp->interval_ns;
+
+    if ((dp->prog_last < 0) || (dp->progress < dp->prog_last)) {
+        /* first indication (or restarted): measure from here */
+        dp->prog_last = dp->progress;
+        dp->prog_ns = now;
+        ival = dp->min_ns;
+    } else if (dp->progress == dp->prog_last) {
+        ival *= 2;              /* slow, back off */
+    } else {
+        double rate = (double)(dp->progress - dp->prog_last) /
+                      (double)(now - dp->prog_ns);
+
+        dp->prog_last = dp->progress;
+        dp->prog_ns = now;
+        dp->eta_ns = (uint64_t)((SG_PROGRESS_FULL - dp->progress) / rate);
+        /* a quarter of the time remaining, so tighter near the end */
+        ival = dp->eta_ns / 4;
+    }
+    if (ival < dp->min_ns)
+        ival = dp->min_ns;
+    if (ival > dp->max_ns)
+        ival = dp->max_ns;
+    dp->interval_ns = ival;
+    dp->next_ns = now + ival;
+}
+
+void
+sg_progress_init(struct sg_progress_dev * dp, int sg_fd, bool use_rs,
+                 uint64_t min_ns, uint64_t max_ns)
+{
+    memset(dp, 0, sizeof(*dp));
+    dp->sg_fd = sg_fd;
+    dp->use_rs = use_rs;
+    dp->state = SG_PROGRESS_ACTIVE;
+    dp->progress = -1;
+    dp->prog_last = -1;
+    dp->sense_key = -1;
+    dp->min_ns = (min_ns > 0) ? min_ns : 1;
+    dp->max_ns = (max_ns > dp->min_ns) ? max_ns : dp->min_ns;
+    dp->interval_ns = dp->min_ns;
+    dp->start_ns = sg_pt_lat_now_ns();
+    dp->next_ns = dp->start_ns + dp->min_ns;
+}
+
+int
+sg_progress_poll(struct sg_progress_dev * dp, int vb)
+{
+    int res, resp_len, progress;
+    uint64_t now;
+    struct sg_scsi_sense_hdr ssh;
+    uint8_t rs_b[SG_PROGRESS_RS_LEN];
+
+    if (SG_PROGRESS_ACTIVE != dp->state)
+        return dp->state;
+    ++dp->polls;
+    progress = -1;
+    if (! dp->use_rs) {
+        res = sg_ll_test_unit_ready_progress(dp->sg_fd, 0, &progress, false,
+                                             vb);
+        now = sg_pt_lat_now_ns();
+        dp->res = res;
+        if (progress >= 0) {
+            dp->progress = progress;
+            progress_adapt(dp, now);
+            return dp->state;
+        }
+        if (0 == res) {
+            dp->progress = -1;
+            progress_finish(dp, SG_PROGRESS_DONE, now);
+            return dp->state;
+        }
+        if (SG_LIB_CAT_UNIT_ATTENTION == res) {
+            dp->next_ns = now + dp->min_ns;
+            return dp->state;
+        }
+        if (SG_LIB_CAT_NOT_READY != res) {
+            progress_finish(dp, SG_PROGRESS_FAILED, now);
+            return dp->state;
+        }
+        /* not ready without a progress indication, ask REQUEST SENSE
+         * which reports why (e.g. a format or sanitize that failed) */
+        if (vb > 1)
+            pr2ws("%s: not ready, no progress: poll with REQUEST SENSE\n",
+                  __func__);
+        dp->use_rs = true;
+    }
+    memset(rs_b, 0, sizeof(rs_b));
+    res = sg_ll_request_sense(dp->sg_fd, dp->desc, rs_b, sizeof(rs_b), false,
+                              vb);
+    if ((SG_LIB_CAT_ILLEGAL_REQ == res) && dp->desc) {
+        dp->desc = false;       /* descriptor format may not be supported */
+        memset(rs_b, 0, sizeof(rs_b));
+        res = sg_ll_request_sense(dp->sg_fd, false, rs_b, sizeof(rs_b),
+                                  false, vb);
+    }
+    now = sg_pt_lat_now_ns();
+    dp->res = res;
+    if (res) {
+        progress_finish(dp, SG_PROGRESS_FAILED, now);
+        return dp->state;
+    }
+    /* "Additional sense length" same in descriptor and fixed */
+    resp_len = rs_b[7] + 8;
+    if (resp_len > (int)sizeof(rs_b))
+        resp_len = sizeof(rs_b);
+    if (sg_get_sense_progress_fld(rs_b, resp_len, &progress)) {
+        dp->progress = progress;
+        progress_adapt(dp, now);
+        return dp->state;
+    }
+    dp->progress = -1;
+    if (sg_scsi_normalize_sense(rs_b, resp_len, &ssh)) {
+        dp->sense_key = ssh.sense_key;
+        dp->asc = ssh.asc;
+        dp->ascq = ssh.ascq;
+        switch (ssh.sense_key) {
+        case SPC_SK_NO_SENSE:
+        case SPC_SK_RECOVERED_ERROR:
+        case SPC_SK_UNIT_ATTENTION:
+            break;
+        case SPC_SK_NOT_READY:
+            dp->res = SG_LIB_CAT_NOT_READY;
+            progress_finish(dp, SG_PROGRESS_FAILED, now);
+            return dp->state;
+        case SPC_SK_MEDIUM_ERROR:
+        case SPC_SK_HARDWARE_ERROR:
+            dp->res = SG_LIB_CAT_MEDIUM_HARD;
+            progress_finish(dp, SG_PROGRESS_FAILED, now);
+            return dp->state;
+        default:
+            dp->res = SG_LIB_CAT_SENSE;
+            progress_finish(dp, SG_PROGRESS_FAILED, now);
+            return dp->state;
+        }
+    }
+    progress_finish(dp, SG_PROGRESS_DONE, now);
+    return dp->state;
+}
+
+int
+sg_progress_run(struct sg_progress_dev * devs, int num,
+                bool (*cb)(struct sg_progress_dev * dp, void * ctx),
+                void * ctx, int vb)
+{
+    int k, active;
+    int failed = 0;
+    uint64_t now, next;
+    struct sg_progress_dev * dp;
+
+    while (true) {
+        active = 0;
+        next = 0;
+        for (k = 0, dp = devs; k < num; ++k, ++dp) {
+            if (SG_PROGRESS_ACTIVE != dp->state)
+                continue;
+            if ((0 == active) || (dp->next_ns < next))
+                next = dp->next_ns;
+            ++active;
+        }
+        if (0 == active)
+            break;
+        now = sg_pt_lat_now_ns();
+        if (next > now)
+            sg_pt_rate_sleep(next - now);
+        now = sg_pt_lat_now_ns();
+        for (k = 0, dp = devs; k < num; ++k, ++dp) {
+            if ((SG_PROGRESS_ACTIVE != dp->state) || (dp->next_ns > now))
+                continue;
+            sg_progress_poll(dp, vb);
+            if (cb && (! cb(dp, ctx)))
+                goto fini;
+        }
+    }
+fini:
+    for (k = 0, dp = devs; k < num; ++k, ++dp) {
+        if (SG_PROGRESS_FAILED == dp->state)
+            ++failed;
+    }
+    return failed;
+}
+
+/* Device session, see sg_cmds_extra.h */
+#define DS_VPD_BLOCK_LIMITS 0xb0
+#define DS_VPD_BDC 0xb1
+#define DS_VPD_LBP 0xb2
+#define DS_VPD_RESP_LEN 64
+#define DS_RCAP16_RESP_LEN 32
+#define DS_RCAP10_RESP_LEN 8
+
+/* Fetches VPD page 'pg' into b, zeroing what is past its page length.
+ * Fails with SG_LIB_CAT_MALFORMED if fewer than 'min_len' bytes (including
+ * the header) come back. */
+static int
+ds_fetch_vpd(struct sg_dev_sess * dsp, int pg, uint8_t * b, int blen,
+             int min_len)
+{
+    int res, n;
+    int resid = 0;
+
+    memset(b, 0, blen);
+    res = sg_ll_inquiry_v2(dsp->sg_fd, true, pg, b, blen, 0, &resid, false,
+                           dsp->verbose);
+    if (res)
+        return res;
+    n = blen - resid;
+    if ((n < min_len) || (pg != b[1])) {
+        if (dsp->verbose)
+            pr2ws("%s: VPD page 0x%x too short or malformed\n", __func__,
+                  pg);
+        return SG_LIB_CAT_MALFORMED;
+    }
+    if (n > 4 + sg_get_unaligned_be16(b + 2))
+        n = 4 + sg_get_unaligned_be16(b + 2);
+    memset(b + n, 0, blen - n);
+    return 0;
+}
+
+static int
+ds_fetch_cap(struct sg_dev_sess * dsp)
+{
+    int res;
+    struct sg_ds_cap * cp = &dsp->cap;
+    uint8_t b[DS_RCAP16_RESP_LEN];
+
+    memset(cp, 0, sizeof(*cp));
+    res = sg_ll_readcap_16(dsp->sg_fd, false, 0, b, sizeof(b), false,
+                           dsp->verbose);
+    if (0 == res) {
+        cp->rc16 = true;
+        cp->num_blocks = sg_get_unaligned_be64(b + 0) + 1;
+        cp->lb_size = sg_get_unaligned_be32(b + 8);
+        cp->prot_en = !! (0x1 & b[12]);
+        if (cp->prot_en)
+            cp->p_type = ((b[12] >> 1) & 0x7) + 1;
+        cp->p_i_exp = (b[13] >> 4) & 0xf;
+        cp->lbppbe = b[13] & 0xf;
+        cp->lbpme = !! (0x80 & b[14]);
+        cp->lbprz = !! (0x40 & b[14]);
+        cp->lowest_aligned = sg_get_unaligned_be16(b + 14) & 0x3fff;
+        return 0;
+    }
+    /* READ CAPACITY(16) is a SERVICE ACTION IN(16) command, so may be
+     * rejected either way by a device that only has READ CAPACITY(10) */
+    if ((SG_LIB_CAT_INVALID_OP != res) && (SG_LIB_CAT_ILLEGAL_REQ != res))
+        return res;
+    res = sg_ll_readcap_10(dsp->sg_fd, false, 0, b, DS_RCAP10_RESP_LEN,
+                           true, dsp->verbose);
+    if (res)
+        return res;
+    /* take care not to sign extend values > 0x7fffffff */
+    cp->num_blocks = (uint64_t)sg_get_unaligned_be32(b + 0) + 1;
+    cp->lb_size = sg_get_unaligned_be32(b + 4);
+    return 0;
+}
+
+static int
+ds_fetch_blk_lim(struct sg_dev_sess * dsp)
+{
+    int res;
+    struct sg_ds_blk_lim * blp = &dsp->bl;
+    uint8_t b[DS_VPD_RESP_LEN];
+
+    memset(blp, 0, sizeof(*blp));
+    res = ds_fetch_vpd(dsp, DS_VPD_BLOCK_LIMITS, b, sizeof(b), 16);
+    if (res)
+        return res;
+    blp->page_len = sg_get_unaligned_be16(b + 2);
+    blp->wsnz = !! (0x1 & b[4]);
+    blp->max_cmp_wr_len = b[5];
+    blp->opt_xfer_gran = sg_get_unaligned_be16(b + 6);
+    blp->max_xfer_len = sg_get_unaligned_be32(b + 8);
+    blp->opt_xfer_len = sg_get_unaligned_be32(b + 12);
+    blp->max_prefetch_len = sg_get_unaligned_be32(b + 16);
+    blp->max_unmap_lba = sg_get_unaligned_be32(b + 20);
+    blp->max_unmap_descs = sg_get_unaligned_be32(b + 24);
+    blp->unmap_gran = sg_get_unaligned_be32(b + 28);
+    blp->ugavalid = !! (0x80 & b[32]);
+    if (blp->ugavalid)
+        blp->unmap_align = sg_get_unaligned_be32(b + 32) & 0x7fffffff;
+    blp->max_ws_len = sg_get_unaligned_be64(b + 36);
+    return 0;
+}
+
+static int
+ds_fetch_lbp(struct sg_dev_sess * dsp)
+{
+    int res;
+    struct sg_ds_lbp * lp = &dsp->lbp;
+    uint8_t b[DS_VPD_RESP_LEN];
+
+    memset(lp, 0, sizeof(*lp));
+    res = ds_fetch_vpd(dsp, DS_VPD_LBP, b, sizeof(b), 8);
+    if (res)
+        return res;
+    lp->threshold_exp = b[4];
+    lp->lbpu = !! (0x80 & b[5]);
+    lp->lbpws = !! (0x40 & b[5]);
+    lp->lbpws10 = !! (0x20 & b[5]);
+    lp->lbprz = (b[5] >> 2) & 0x7;
+    lp->anc_sup = !! (0x2 & b[5]);
+    lp->dp = !! (0x1 & b[5]);
+    lp->min_prov_pct = (b[6] >> 3) & 0x1f;
+    lp->prov_type = b[6] & 0x7;
+    return 0;
+}
+
+static int
+ds_fetch_bdc(struct sg_dev_sess * dsp)
+{
+    int res;
+    struct sg_ds_bdc * bdp = &dsp->bdc;
+    uint8_t b[DS_VPD_RESP_LEN];
+
+    memset(bdp, 0, sizeof(*bdp));
+    res = ds_fetch_vpd(dsp, DS_VPD_BDC, b, sizeof(b), 8);
+    if (res)
+        return res;
+    bdp->rotation_rate = sg_get_unaligned_be16(b + 4);
+    bdp->product_type = b[6];
+    bdp->wabereq = (b[7] >> 6) & 0x3;
+    bdp->wacereq = (b[7] >> 4) & 0x3;
+    bdp->form_factor = b[7] & 0xf;
+    bdp->zoned = (b[8] >> 4) & 0x3;
+    bdp->fuab = !! (0x2 & b[8]);
+    bdp->vbuls = !! (0x1 & b[8]);
+    return 0;
+}
+
+/* Returns the kept result of the fetch 'which' (a SG_DS_* bit), doing it
+ * first if need be. A unit attention or aborted command is not kept. */
+static int
+ds_get(struct sg_dev_sess * dsp, unsigned int which,
+       int (*fetch)(struct sg_dev_sess * dsp))
+{
+    int res, k;
+
+    for (k = 0; (1U << k) != which; ++k)
+        ;
+    if (which & dsp->have)
+        return dsp->res[k];
+    res = fetch(dsp);
+    if ((SG_LIB_CAT_UNIT_ATTENTION == res) ||
+        (SG_LIB_CAT_ABORTED_COMMAND == res))
+        return res;
+    dsp->have |= which;
+    dsp->res[k] = res;
+    return res;
+}
+
+void
+sg_ds_init(struct sg_dev_sess * dsp, int sg_fd, int verbose)
+{
+    memset(dsp, 0, sizeof(*dsp));
+    dsp->sg_fd = sg_fd;
+    dsp->verbose = verbose;
+}
+
+int
+sg_ds_open(struct sg_dev_sess * dsp, const char * device_name,
+           bool read_only, int verbose)
+{
+    int sg_fd = sg_cmds_open_device(device_name, read_only, verbose);
+
+    if (sg_fd < 0)
+        return sg_fd;
+    sg_ds_init(dsp, sg_fd, verbose);
+    dsp->own_fd = true;
+    return 0;
+}
+
+int
+sg_ds_close(struct sg_dev_sess * dsp)
+{
+    int res = 0;
+
+    if (dsp->own_fd && (dsp->sg_fd >= 0))
+        res = sg_cmds_close_device(dsp->sg_fd);
+    dsp->sg_fd = -1;
+    dsp->own_fd = false;
+    dsp->have = 0;
+    return res;
+}
+
+void
+sg_ds_forget(struct sg_dev_sess * dsp, unsigned int mask)
+{
+    dsp->have &= ~mask;
+}
+
+int
+sg_ds_get_cap(struct sg_dev_sess * dsp, const struct sg_ds_cap ** out)
+{
+    int res = ds_get(dsp, SG_DS_CAP, ds_fetch_cap);
+
+    if (out)
+        *out = &dsp->cap;
+    return res;
+}
+
+int
+sg_ds_get_blk_lim(struct sg_dev_sess * dsp,
+                  const struct sg_ds_blk_lim ** out)
+{
+    int res = ds_get(dsp, SG_DS_BLK_LIM, ds_fetch_blk_lim);
+
+    if (out)
+        *out = &dsp->bl;
+    return res;
+}
+
+int
+sg_ds_get_lbp(struct sg_dev_sess * dsp, const struct sg_ds_lbp ** out)
+{
+    int res = ds_get(dsp, SG_DS_LBP, ds_fetch_lbp);
+
+    if (out)
+        *out = &dsp->lbp;
+    return res;
+}
+
+int
+sg_ds_get_bdc(struct sg_dev_sess * dsp, const struct sg_ds_bdc ** out)
+{
+    int res = ds_get(dsp, SG_DS_BDC, ds_fetch_bdc);
+
+    if (out)
+        *out = &dsp->bdc;
+    return res;
+}
+
+int
+sg_ds_opcode_supported(struct sg_dev_sess * dsp, int opcode, int sa)
+{
+    return sg_opcode_is_supported(dsp->sg_fd, opcode, sa, dsp->verbose);
+}
@@ -7,12 +7,26 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1           /* for O_DIRECT */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/ioctl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/sysmacros.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -20,11 +34,23 @@
 
 #ifdef SG_LIB_LINUX
 
+#include <linux/major.h>        /* for MEM_MAJOR, SCSI_GENERIC_MAJOR, etc */
+#include <linux/fs.h>           /* for BLKSSZGET and friends */
+
 #include "sg_io_linux.h"
+#include "sg_cmds_basic.h"
+#include "sg_cmds_extra.h"
+#include "sg_pt.h"
+#include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
 
-/* Version 1.10 20180613 */
+/* Version 1.13 20261014 */
 
 
 void
@@ -190,15 +216,6 @@ sg_chk_n_print(const char * leadin, int masked_status, int host_status,
                                 raw_sinfo);
 }
 
-#ifdef SG_IO
-int
-sg_err_category3(struct sg_io_hdr * hp)
-{
-    return sg_err_category_new(hp->status, hp->host_status,
-                               hp->driver_status, hp->sbp, hp->sb_len_wr);
-}
-#endif
-
 int
 sg_err_category(int masked_status, int host_status, int driver_status,
                 const uint8_t * sense_buffer, int sb_len)
@@ -209,20 +226,30 @@ sg_err_category(int masked_status, int host_status, int driver_status,
                                sense_buffer, sb_len);
 }
 
-int
-sg_err_category_new(int scsi_status, int host_status, int driver_status,
-                    const uint8_t * sense_buffer, int sb_len)
+/* When 'sip' is not NULL valid sense data is decoded into it once, and
+ * the category taken from that, rather than categorized then left for the
+ * caller to parse again. */
+static int
+err_category_decode(int scsi_status, int host_status, int driver_status,
+                    const uint8_t * sense_buffer, int sb_len,
+                    struct sg_scsi_sense_info * sip)
 {
     int masked_driver_status = (SG_LIB_DRIVER_MASK & driver_status);
 
+    if (sip)
+        sip->response_code = 0;
     scsi_status &= 0x7e;
     if ((0 == scsi_status) && (0 == host_status) &&
         (0 == masked_driver_status))
         return SG_LIB_CAT_CLEAN;
     if ((SAM_STAT_CHECK_CONDITION == scsi_status) ||
         (SAM_STAT_COMMAND_TERMINATED == scsi_status) ||
-        (SG_LIB_DRIVER_SENSE == masked_driver_status))
-        return sg_err_category_sense(sense_buffer, sb_len);
+        (SG_LIB_DRIVER_SENSE == masked_driver_status)) {
+        if (NULL == sip)
+            return sg_err_category_sense(sense_buffer, sb_len);
+        sg_scsi_decode_sense(sense_buffer, sb_len, sip);
+        return sg_err_category_sinfo(sip);
+    }
     if (0 != host_status) {
         if ((SG_LIB_DID_NO_CONNECT == host_status) ||
             (SG_LIB_DID_BUS_BUSY == host_status) ||
@@ -236,4 +263,792 @@ sg_err_category_new(int scsi_status, int host_status, int driver_status,
     return SG_LIB_CAT_OTHER;
 }
 
+int
+sg_err_category_new(int scsi_status, int host_status, int driver_status,
+                    const uint8_t * sense_buffer, int sb_len)
+{
+    return err_category_decode(scsi_status, host_status, driver_status,
+                               sense_buffer, sb_len, NULL);
+}
+
+#ifdef SG_IO
+int
+sg_err_category3(struct sg_io_hdr * hp)
+{
+    return sg_err_category_new(hp->status, hp->host_status,
+                               hp->driver_status, hp->sbp, hp->sb_len_wr);
+}
+
+int
+sg_err_category3_sinfo(struct sg_io_hdr * hp, struct sg_scsi_sense_info * sip)
+{
+    return err_category_decode(hp->status, hp->host_status,
+                               hp->driver_status, hp->sbp, hp->sb_len_wr,
+                               sip);
+}
+#endif
+
+#ifndef SCSI_GENERIC_MAJOR
+#define SCSI_GENERIC_MAJOR 21
+#endif
+
+#define SG_IO_CAPS_V4_BASE 40000        /* as in sg_pt_linux.c */
+#define SG_IO_CAPS_V4_SHARE 40030
+
+static bool
+allow_dio_set(void)
+{
+    bool ok = false;
+    int dfd;
+    char c;
+
+    dfd = open("/proc/scsi/sg/allow_dio", O_RDONLY);
+    if (dfd >= 0) {
+        if ((1 == read(dfd, &c, 1)) && ('1' == c))
+            ok = true;
+        close(dfd);
+    }
+    return ok;
+}
+
+int
+sg_io_probe_caps(int fd, struct sg_io_caps * capsp, int verbose)
+{
+    int ver, res;
+    struct stat a_stat;
+
+    memset(capsp, 0, sizeof(*capsp));
+    capsp->dio = allow_dio_set();
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+    {
+        int ufd;
+        struct io_uring_params params;
+
+        memset(&params, 0, sizeof(params));
+        ufd = syscall(__NR_io_uring_setup, 1, &params);
+        if (ufd >= 0) {
+            capsp->uring = true;
+            close(ufd);
+        }
+    }
+#endif
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &a_stat) < 0)
+        return errno;
+    if (ioctl(fd, SG_GET_VERSION_NUM, &ver) < 0) {
+        if (verbose > 1)
+            pr2ws("%s: no SG_IO on fd=%d\n", __func__, fd);
+        return 0;
+    }
+    capsp->sg_version = ver;
+    if (S_ISBLK(a_stat.st_mode))
+        capsp->is_blk = true;
+    else if (S_ISCHR(a_stat.st_mode) &&
+             (SCSI_GENERIC_MAJOR == major(a_stat.st_rdev)))
+        capsp->is_sg = true;
+    else
+        capsp->is_bsg = true;
+    if (capsp->is_sg) {
+        capsp->v4 = (ver >= SG_IO_CAPS_V4_BASE);
+        capsp->v4_share = (ver >= SG_IO_CAPS_V4_SHARE);
+        res = ioctl(fd, SG_GET_RESERVED_SIZE, &capsp->reserved_sz);
+        if (res < 0)
+            capsp->reserved_sz = 0;
+        /* the reserved buffer is what SG_FLAG_MMAP_IO maps */
+        capsp->mmap_io = (ver >= 30000) && (capsp->reserved_sz > 0);
+    }
+    if (verbose > 1)
+        pr2ws("%s: fd=%d, version=%d, reserved size=%d\n", __func__, fd,
+              ver, capsp->reserved_sz);
+    return 0;
+}
+
+char *
+sg_io_caps_str(const struct sg_io_caps * capsp, int blen, char * b)
+{
+    int n;
+    int ver = capsp->sg_version;
+
+    if ((NULL == b) || (blen < 1))
+        return b;
+    if (capsp->is_sg)
+        n = sg_scnpr(b, blen, "sg driver %d.%d.%d", ver / 10000,
+                     (ver / 100) % 100, ver % 100);
+    else if (capsp->is_blk)
+        n = sg_scnpr(b, blen, "block device with SG_IO");
+    else if (capsp->is_bsg)
+        n = sg_scnpr(b, blen, "bsg (or other SG_IO) device");
+    else
+        n = sg_scnpr(b, blen, "no SG_IO");
+    n += sg_scnpr(b + n, blen - n, ":");
+    if (capsp->v4)
+        n += sg_scnpr(b + n, blen - n, " v4,");
+    if (capsp->v4_share)
+        n += sg_scnpr(b + n, blen - n, " request sharing,");
+    if (capsp->mmap_io)
+        n += sg_scnpr(b + n, blen - n, " mmap,");
+    if (capsp->dio)
+        n += sg_scnpr(b + n, blen - n, " dio,");
+    if (capsp->uring)
+        n += sg_scnpr(b + n, blen - n, " io_uring,");
+    if ((n > 0) && ((',' == b[n - 1]) || (':' == b[n - 1])))
+        b[n - 1] = '\0';
+    return b;
+}
+
+int
+sg_io_max_sectors_kb(int fd)
+{
+    int kb = 0;
+    struct stat st;
+    char b[320];
+    char d[192];
+    DIR * dirp;
+    struct dirent * dep;
+    FILE * fp;
+
+    if (fstat(fd, &st) < 0)
+        return 0;
+    if (S_ISBLK(st.st_mode)) {
+        snprintf(b, sizeof(b), "/sys/dev/block/%u:%u/queue/max_sectors_kb",
+                 major(st.st_rdev), minor(st.st_rdev));
+        if (access(b, R_OK))    /* partition, look at the whole disk */
+            snprintf(b, sizeof(b), "/sys/dev/block/%u:%u/../queue/"
+                     "max_sectors_kb", major(st.st_rdev), minor(st.st_rdev));
+    } else if (S_ISCHR(st.st_mode)) {
+        snprintf(d, sizeof(d), "/sys/dev/char/%u:%u/device/block",
+                 major(st.st_rdev), minor(st.st_rdev));
+        if (NULL == (dirp = opendir(d)))
+            return 0;
+        b[0] = '\0';
+        while ((dep = readdir(dirp))) {
+            if ('.' != dep->d_name[0]) {
+                snprintf(b, sizeof(b), "%s/%.48s/queue/max_sectors_kb", d,
+                         dep->d_name);
+                break;
+            }
+        }
+        closedir(dirp);
+        if ('\0' == b[0])
+            return 0;
+    } else
+        return 0;
+    if ((fp = fopen(b, "r"))) {
+        if (1 != fscanf(fp, "%d", &kb))
+            kb = 0;
+        fclose(fp);
+    }
+    return (kb > 0) ? kb : 0;
+}
+
+int
+sg_io_reserve(int fd, int blk_sz, int * bptp, int qd, bool fit,
+              const char * leadin, int verbose)
+{
+    int want, got, bpt;
+    int64_t ll;
+    const char * lip = leadin ? leadin : "";
+
+    if ((blk_sz < 1) || (NULL == bptp) || (*bptp < 1))
+        return -EINVAL;
+    if (qd < 1)
+        qd = 1;
+    bpt = *bptp;
+    ll = (int64_t)blk_sz * bpt * qd;
+    want = (ll > INT32_MAX) ? INT32_MAX : (int)ll;
+    /* a larger reserved buffer (e.g. set by another user) is kept */
+    if ((ioctl(fd, SG_GET_RESERVED_SIZE, &got) >= 0) && (got >= want)) {
+        if (verbose > 1)
+            pr2ws("%ssg reserved buffer: %d bytes\n", lip, got);
+        return got;
+    }
+    got = want;
+    if (ioctl(fd, SG_SET_RESERVED_SIZE, &got) < 0) {
+        int err = errno;
+
+        pr2ws("%sSG_SET_RESERVED_SIZE error: %s\n", lip, safe_strerror(err));
+        return -err;
+    }
+    if (ioctl(fd, SG_GET_RESERVED_SIZE, &got) < 0) {
+        int err = errno;
+
+        pr2ws("%sSG_GET_RESERVED_SIZE error: %s\n", lip, safe_strerror(err));
+        return -err;
+    }
+    if (got >= want) {
+        if (verbose > 1)
+            pr2ws("%ssg reserved buffer: %d bytes\n", lip, got);
+        return got;
+    }
+    /* the driver clamps to its limits (e.g. max_sectors), so say so */
+    pr2ws("%ssg reserved buffer: asked for %d bytes, granted %d\n", lip,
+          want, got);
+    if (fit) {
+        bpt = got / blk_sz / qd;
+        if (bpt < 1)
+            bpt = 1;
+        if (bpt < *bptp) {
+            pr2ws("%sreducing blocks per transfer from %d to %d to fit\n",
+                  lip, *bptp, bpt);
+            *bptp = bpt;
+        }
+    }
+    return got;
+}
+
+bool
+sg_io_dio_done(const struct sg_io_hdr * hp, const char * leadin,
+               bool * warnedp)
+{
+    const char * lip = leadin ? leadin : "";
+    long psz;
+
+    if (SG_INFO_DIRECT_IO == (hp->info & SG_INFO_DIRECT_IO_MASK))
+        return true;
+    if ((NULL == warnedp) || *warnedp)
+        return false;
+    *warnedp = true;
+    if (! allow_dio_set())
+        pr2ws("%sdirect IO not done: /proc/scsi/sg/allow_dio is 0, using "
+              "indirect IO\n", lip);
+    else {
+        psz = sysconf(_SC_PAGESIZE);
+        if ((psz > 0) && ((uintptr_t)hp->dxferp % psz))
+            pr2ws("%sdirect IO not done: buffer not page aligned, using "
+                  "indirect IO\n", lip);
+        else
+            pr2ws("%sdirect IO not done (the driver fell back, e.g. due to "
+                  "transfer size), using indirect IO\n", lip);
+    }
+    return false;
+}
+
+#ifndef RAW_MAJOR
+#define RAW_MAJOR 255   /*unlikey value */
+#endif
+
+/* If platform does not support O_DIRECT then define it harmlessly */
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
+#define DEV_NULL_MINOR_NUM 3
+
+static int sg_io_bsg_major = -1;        /* -1 until /proc/devices is read */
+
+static int
+find_bsg_major(int verbose)
+{
+    int n;
+    int bsg_major = 0;
+    char * cp;
+    FILE * fp;
+    const char * proc_devices = "/proc/devices";
+    char a[128];
+    char b[128];
+
+    if (NULL == (fp = fopen(proc_devices, "r"))) {
+        if (verbose)
+            pr2ws("fopen %s failed: %s\n", proc_devices,
+                  safe_strerror(errno));
+        return 0;
+    }
+    while ((cp = fgets(b, sizeof(b), fp))) {
+        if ((1 == sscanf(b, "%126s", a)) &&
+            (0 == memcmp(a, "Character", 9)))
+            break;
+    }
+    while (cp && (cp = fgets(b, sizeof(b), fp))) {
+        if (2 == sscanf(b, "%d %126s", &n, a)) {
+            if (0 == strcmp("bsg", a)) {
+                bsg_major = n;
+                break;
+            }
+        } else
+            break;
+    }
+    if (verbose > 5) {
+        if (cp)
+            pr2ws("found bsg_major=%d\n", bsg_major);
+        else
+            pr2ws("found no bsg char device in %s\n", proc_devices);
+    }
+    fclose(fp);
+    return bsg_major;
+}
+
+int
+sg_io_filetype(const char * fname, int ft_flags, int verbose)
+{
+    size_t len = strlen(fname);
+    struct stat st;
+
+    if ((1 == len) && ('.' == fname[0]))
+        return SG_IO_FT_DEV_NULL;
+    if (stat(fname, &st) < 0)
+        return SG_IO_FT_ERROR;
+    if (S_ISCHR(st.st_mode)) {
+        if ((MEM_MAJOR == major(st.st_rdev)) &&
+            (DEV_NULL_MINOR_NUM == minor(st.st_rdev)))
+            return SG_IO_FT_DEV_NULL;
+        if (RAW_MAJOR == major(st.st_rdev))
+            return SG_IO_FT_RAW;
+        if (SCSI_GENERIC_MAJOR == major(st.st_rdev))
+            return SG_IO_FT_SG;
+        if (SCSI_TAPE_MAJOR == major(st.st_rdev))
+            return SG_IO_FT_ST;
+        if (SG_IO_FT_WANT_BSG & ft_flags) {
+            if (sg_io_bsg_major < 0)
+                sg_io_bsg_major = find_bsg_major(verbose);
+            if ((sg_io_bsg_major > 0) &&
+                (sg_io_bsg_major == (int)major(st.st_rdev)))
+                return SG_IO_FT_SG;
+        }
+    } else if (S_ISBLK(st.st_mode))
+        return SG_IO_FT_BLOCK;
+    else if (S_ISFIFO(st.st_mode) && (SG_IO_FT_WANT_FIFO & ft_flags))
+        return SG_IO_FT_FIFO;
+    return SG_IO_FT_OTHER;
+}
+
+char *
+sg_io_filetype_str(int ft, int blen, char * b)
+{
+    int n = 0;
+
+    if (blen < 1)
+        return b;
+    b[0] = '\0';
+    if (SG_IO_FT_DEV_NULL & ft)
+        n += sg_scnpr(b + n, blen - n, "null device ");
+    if (SG_IO_FT_SG & ft)
+        n += sg_scnpr(b + n, blen - n, "SCSI generic (sg) device ");
+    if (SG_IO_FT_BLOCK & ft)
+        n += sg_scnpr(b + n, blen - n, "block device ");
+    if (SG_IO_FT_FIFO & ft)
+        n += sg_scnpr(b + n, blen - n, "fifo (named pipe) ");
+    if (SG_IO_FT_ST & ft)
+        n += sg_scnpr(b + n, blen - n, "SCSI tape device ");
+    if (SG_IO_FT_RAW & ft)
+        n += sg_scnpr(b + n, blen - n, "raw device ");
+    if (SG_IO_FT_OTHER & ft)
+        n += sg_scnpr(b + n, blen - n, "other (perhaps ordinary file) ");
+    if (SG_IO_FT_ERROR & ft)
+        sg_scnpr(b + n, blen - n, "unable to 'stat' file ");
+    return b;
+}
+
+int
+sg_io_open_dd(const char * fname, int ft, bool wr, int fl_mask,
+              int64_t blk_off, int blk_sz, const char * leadin, int verbose)
+{
+    int fd, flags, fl, err;
+    off64_t offset;
+    const char * lip = leadin ? leadin : "";
+
+    flags = 0;
+    if (SG_IO_OPEN_DIRECT & fl_mask)
+        flags |= O_DIRECT;
+    if (SG_IO_OPEN_EXCL & fl_mask)
+        flags |= O_EXCL;
+    if (SG_IO_OPEN_DSYNC & fl_mask)
+        flags |= O_SYNC;
+    if (SG_IO_FT_SG & ft) {
+        if (SG_IO_OPEN_NONBLOCK & fl_mask)
+            flags |= O_NONBLOCK;
+        fl = O_RDWR;
+        fd = open(fname, fl | flags);
+        if ((fd < 0) && (! wr) && (SG_IO_OPEN_RDONLY_OK & fl_mask)) {
+            fl = O_RDONLY;
+            fd = open(fname, fl | flags);
+        }
+        if (fd < 0) {
+            err = errno;
+            pr2ws("%scould not open %s for sg %s: %s\n", lip, fname,
+                  (wr ? "writing" : "reading"), safe_strerror(err));
+            return -err;
+        }
+        if (verbose)
+            pr2ws("        open %s(sg_io), flags=0x%x\n",
+                  (wr ? "output" : "input"), fl | flags);
+        return fd;
+    }
+    if (! wr)
+        flags |= O_RDONLY;
+    else if (SG_IO_FT_RAW & ft)
+        flags |= O_WRONLY;
+    else {
+        flags |= O_WRONLY | O_CREAT;
+        if (SG_IO_OPEN_APPEND & fl_mask)
+            flags |= O_APPEND;
+    }
+    if ((fd = open(fname, flags, 0666)) < 0) {
+        err = errno;
+        pr2ws("%scould not open %s for %s: %s\n", lip, fname,
+              (wr ? ((SG_IO_FT_RAW & ft) ? "raw writing" : "writing") :
+                    "reading"), safe_strerror(err));
+        return -err;
+    }
+    if (verbose) {
+        if (wr)
+            pr2ws("        %s output, flags=0x%x\n",
+                  ((O_CREAT & flags) ? "create" : "open"), flags);
+        else
+            pr2ws("        open input, flags=0x%x\n", flags);
+    }
+    if (blk_off > 0) {
+        offset = blk_off;
+        offset *= blk_sz;       /* could exceed 32 bits here! */
+        if (lseek64(fd, offset, SEEK_SET) < 0) {
+            err = errno;
+            pr2ws("%scouldn't %s to required position on %s: %s\n", lip,
+                  (wr ? "seek" : "skip"), fname, safe_strerror(err));
+            close(fd);
+            return -err;
+        }
+        if (verbose)
+            pr2ws("%s: lseek64 SEEK_SET, byte offset=0x%" PRIx64 "\n",
+                  (wr ? "   >> seek" : "  >> skip"), (uint64_t)offset);
+    }
+    return fd;
+}
+
+int
+sg_io_blkdev_capacity(int fd, int64_t * num_sect, int * sect_sz,
+                      int verbose)
+{
+#ifdef BLKSSZGET
+    if (ioctl(fd, BLKSSZGET, sect_sz) < 0) {
+        pr2ws("BLKSSZGET ioctl error: %s\n", safe_strerror(errno));
+        return -1;
+    } else {
+ #ifdef BLKGETSIZE64
+        uint64_t ull;
+
+        if (ioctl(fd, BLKGETSIZE64, &ull) < 0) {
+            pr2ws("BLKGETSIZE64 ioctl error: %s\n", safe_strerror(errno));
+            return -1;
+        }
+        *num_sect = ((int64_t)ull / (int64_t)*sect_sz);
+        if (verbose)
+            pr2ws("      [bgs64] number of blocks=%" PRId64 " [0x%" PRIx64
+                  "], logical block size=%d\n", *num_sect, *num_sect,
+                  *sect_sz);
+ #else
+        unsigned long ul;
+
+        if (ioctl(fd, BLKGETSIZE, &ul) < 0) {
+            pr2ws("BLKGETSIZE ioctl error: %s\n", safe_strerror(errno));
+            return -1;
+        }
+        *num_sect = (int64_t)ul;
+        if (verbose)
+            pr2ws("      [bgs] number of blocks=%" PRId64 " [0x%" PRIx64
+                  "], logical block size=%d\n", *num_sect, *num_sect,
+                  *sect_sz);
+ #endif
+    }
+    return 0;
+#else
+    if (verbose)
+        pr2ws("      BLKSSZGET+BLKGETSIZE ioctl not available\n");
+    *num_sect = 0;
+    *sect_sz = 0;
+    return -1;
+#endif
+}
+
+int
+sg_io_read_capacity(struct sg_dev_sess * dsp, int64_t * num_sect,
+                    int * sect_sz, int verbose)
+{
+    int res;
+    const struct sg_ds_cap * cp;
+
+    res = sg_ds_get_cap(dsp, &cp);
+    if (0 != res)
+        return res;
+    *num_sect = (int64_t)cp->num_blocks;
+    *sect_sz = (int)cp->lb_size;
+    if (verbose)
+        pr2ws("      number of blocks=%" PRId64 " [0x%" PRIx64 "], "
+              "logical block size=%d\n", *num_sect, *num_sect, *sect_sz);
+    return 0;
+}
+
+/* Returns the bpt=auto transfer size (in blocks) that suits one side of a
+ * copy, placing its optimal transfer granularity in *granp . Returns 0 if
+ * nothing is known about the side. */
+static int
+auto_bpt_side(struct sg_io_bpt_side * sp, int blk_sz, int verbose,
+              uint32_t * granp)
+{
+    bool known = false;
+    int kb = 0;
+    uint32_t lim;
+    uint32_t max_xfer = 0;
+    uint32_t opt_xfer = 0;
+    const struct sg_ds_blk_lim * blp;
+    struct sg_dev_sess ds;
+
+    *granp = 0;
+    if ((NULL == sp) || (sp->fd < 0))
+        return 0;
+    lim = SG_IO_AUTO_BPT_MAX_BYTES / blk_sz;
+    if (SG_IO_FT_SG & sp->ftype) {
+        if (NULL == sp->dsp)
+            sg_ds_init(&ds, sp->fd, (verbose > 0) ? verbose - 1 : 0);
+        if (0 == sg_ds_get_blk_lim(sp->dsp ? sp->dsp : &ds, &blp)) {
+            known = true;
+            *granp = blp->opt_xfer_gran;
+            max_xfer = blp->max_xfer_len;
+            opt_xfer = blp->opt_xfer_len;
+        } else if (verbose)
+            pr2ws("bpt=auto: no Block Limits VPD page from %s\n", sp->fname);
+    }
+    if ((SG_IO_FT_SG | SG_IO_FT_BLOCK) & sp->ftype) {
+        kb = sg_io_max_sectors_kb(sp->fd);
+        if (kb > 0) {
+            known = true;
+            if (((uint64_t)kb * 1024 / blk_sz) < lim)
+                lim = (uint32_t)((uint64_t)kb * 1024 / blk_sz);
+        }
+        if (verbose > 1)
+            pr2ws("bpt=auto: %s: opt_gran=%u max_xfer=%u opt_xfer=%u "
+                  "blocks, max_sectors_kb=%d\n", sp->fname, *granp,
+                  max_xfer, opt_xfer, kb);
+    }
+    if (! known)
+        return 0;
+    if ((max_xfer > 0) && (max_xfer < lim))
+        lim = max_xfer;
+    if ((opt_xfer > 0) && (opt_xfer < lim))
+        lim = opt_xfer;
+    if (lim < 1)
+        lim = 1;
+    if ((*granp > 0) && (lim >= *granp))
+        lim -= lim % *granp;
+    return (int)lim;
+}
+
+int
+sg_io_auto_bpt(struct sg_io_bpt_side * inp, struct sg_io_bpt_side * outp,
+               int blk_sz, int def_bpt, int verbose)
+{
+    int ib, ob, bpt;
+    uint32_t ig, og, g, a, b;
+
+    if (blk_sz < 1)
+        return def_bpt;
+    ib = auto_bpt_side(inp, blk_sz, verbose, &ig);
+    ob = auto_bpt_side(outp, blk_sz, verbose, &og);
+    if ((0 == ib) && (0 == ob)) {
+        if (verbose)
+            pr2ws("bpt=auto: no limits found, using bpt=%d\n", def_bpt);
+        return def_bpt;
+    }
+    if (0 == ib)
+        return ob;
+    if (0 == ob)
+        return ib;
+    bpt = (ib < ob) ? ib : ob;
+    if (0 == ig)
+        g = og;
+    else if (0 == og)
+        g = ig;
+    else {
+        for (a = ig, b = og; b; ) {     /* Euclid for the gcd */
+            uint32_t t = a % b;
+
+            a = b;
+            b = t;
+        }
+        g = (ig / a) * og;              /* least common multiple */
+        if (g > (uint32_t)bpt)
+            g = (ig > og) ? ig : og;
+    }
+    if ((g > 0) && ((uint32_t)bpt >= g))
+        bpt -= bpt % g;
+    return bpt;
+}
+
+ssize_t
+sg_io_read_retry(int fd, void * bp, size_t len)
+{
+    ssize_t res;
+
+    while (((res = read(fd, bp, len)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    return res;
+}
+
+ssize_t
+sg_io_write_retry(int fd, const void * bp, size_t len)
+{
+    ssize_t res;
+
+    while (((res = write(fd, bp, len)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    return res;
+}
+
+void
+sg_io_print_records(const char * leadin, int64_t remaining, int64_t in_full,
+                    int in_partial, int64_t out_full, int out_partial)
+{
+    const char * lip = leadin ? leadin : "";
+
+    if (0 != remaining)
+        pr2ws("  remaining block count=%" PRId64 "\n", remaining);
+    pr2ws("%s%" PRId64 "+%d records in\n", lip, in_full - in_partial,
+          in_partial);
+    pr2ws("%s%" PRId64 "+%d records out\n", lip, out_full - out_partial,
+          out_partial);
+}
+
+void
+sg_io_print_throughput(const struct timeval * start_tmp, int64_t blocks,
+                       int blk_sz, bool contin)
+{
+    double a, b;
+    struct timeval end_tm, res_tm;
+
+    gettimeofday(&end_tm, NULL);
+    res_tm.tv_sec = end_tm.tv_sec - start_tmp->tv_sec;
+    res_tm.tv_usec = end_tm.tv_usec - start_tmp->tv_usec;
+    if (res_tm.tv_usec < 0) {
+        --res_tm.tv_sec;
+        res_tm.tv_usec += 1000000;
+    }
+    a = res_tm.tv_sec;
+    a += (0.000001 * res_tm.tv_usec);
+    b = (double)blk_sz * blocks;
+    pr2ws("time to transfer data %s %d.%06d secs",
+          (contin ? "so far" : "was"), (int)res_tm.tv_sec,
+          (int)res_tm.tv_usec);
+    if ((a > 0.00001) && (b > 511))
+        pr2ws(", %.2f MB/sec\n", b / (a * 1000000.0));
+    else
+        pr2ws("\n");
+}
+
+void
+sg_io_dio_warn(void)
+{
+    int fd;
+    char c;
+    static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
+
+    if ((fd = open(proc_allow_dio, O_RDONLY)) >= 0) {
+        if ((1 == read(fd, &c, 1)) && ('0' == c))
+            pr2ws(">>> %s set to '0' but should be set to '1' for direct "
+                  "IO\n", proc_allow_dio);
+        close(fd);
+    }
+}
+
+int
+sg_io_progress_open(struct sg_io_progress * pp, const char * tool, int sec,
+                    const char * fname, int bs, int64_t count,
+                    const char * leadin)
+{
+    memset(pp, 0, sizeof(*pp));
+    if ((NULL == fname) || ('\0' == fname[0]))
+        pp->fp = stderr;
+    else if (NULL == (pp->fp = fopen(fname, "a"))) {
+        pr2ws("%scould not open %s for progress: %s\n",
+              (leadin ? leadin : ""), fname, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    pp->tool = tool;
+    pp->sec = sec;
+    pp->bs = bs;
+    pp->count = count;
+    sg_pt_lat_enable(true);         /* for the latency percentiles */
+    sg_io_progress_start(pp, 0);
+    return 0;
+}
+
+void
+sg_io_progress_start(struct sg_io_progress * pp, int64_t blks_out)
+{
+    pp->start_ns = sg_pt_lat_now_ns();
+    pp->last_ns = pp->start_ns;
+    pp->last_blks = blks_out;
+    pp->last_xfers = pp->xfers;
+}
+
+bool
+sg_io_progress_tick(struct sg_io_progress * pp)
+{
+    if (NULL == pp->fp)
+        return false;
+    ++pp->xfers;
+    return ((sg_pt_lat_now_ns() - pp->last_ns) >=
+            ((uint64_t)pp->sec * 1000000000));
+}
+
+static void
+progress_lat(FILE * fp, const char * name, int fd, int opcode)
+{
+    struct sg_pt_lat_summary ls;
+
+    if ((fd < 0) || sg_pt_lat_get(fd, opcode, &ls))
+        return;
+    fprintf(fp, ",\"%s\":{\"count\":%" PRIu64 ",\"p50\":%.1f,"
+            "\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}", name, ls.count,
+            ls.p50_ns / 1000.0, ls.p99_ns / 1000.0, ls.p999_ns / 1000.0,
+            ls.max_ns / 1000.0);
+}
+
+void
+sg_io_progress_out(struct sg_io_progress * pp, bool final,
+                   const struct sg_io_progress_cnt * cp)
+{
+    double el, iv;
+    uint64_t now;
+    struct timeval tv;
+
+    if (NULL == pp->fp)
+        return;
+    now = sg_pt_lat_now_ns();
+    el = (now - pp->start_ns) / 1e9;
+    iv = (now - pp->last_ns) / 1e9;
+    if (iv < 0.000001)
+        iv = 0.000001;
+    gettimeofday(&tv, NULL);
+    fprintf(pp->fp, "{\"tool\":\"%s\",\"pid\":%d,\"time\":%ld.%03d,"
+            "\"final\":%s,\"elapsed_s\":%.3f,\"count\":%" PRId64 ","
+            "\"blocks_in\":%" PRId64 ",\"blocks_out\":%" PRId64 ",\"bs\":%d,"
+            "\"mb_s\":%.2f,\"avg_mb_s\":%.2f,\"iops\":%.1f,"
+            "\"recovered_errs\":%" PRId64 ",\"unrecovered_errs\":%" PRId64
+            ",\"retries\":%" PRId64, pp->tool, (int)getpid(),
+            (long)tv.tv_sec, (int)(tv.tv_usec / 1000),
+            final ? "true" : "false", el, pp->count, cp->blocks_in,
+            cp->blocks_out, pp->bs,
+            ((cp->blocks_out - pp->last_blks) * (double)pp->bs) /
+            (iv * 1000000.0), (el > 0.000001) ?
+            (cp->blocks_out * (double)pp->bs) / (el * 1000000.0) : 0.0,
+            (pp->xfers - pp->last_xfers) / iv, cp->recovered_errs,
+            cp->unrecovered_errs, cp->retries);
+    progress_lat(pp->fp, "read_lat_us", cp->rd_fd, cp->rd_opcode);
+    progress_lat(pp->fp, "write_lat_us", cp->wr_fd, cp->wr_opcode);
+    fprintf(pp->fp, "}\n");
+    fflush(pp->fp);
+    pp->last_ns = now;
+    pp->last_blks = cp->blocks_out;
+    pp->last_xfers = pp->xfers;
+}
+
+void
+sg_io_progress_close(struct sg_io_progress * pp)
+{
+    if (pp->fp && (stderr != pp->fp))
+        fclose(pp->fp);
+    pp->fp = NULL;
+}
+
 #endif  /* if SG_LIB_LINUX defined */
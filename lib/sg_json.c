@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_json version 1.01 20261014 */
+
+/* Streaming JSON (or CBOR) writer, see sg_json.h . */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdbool.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_json.h"
+
+#define SGJ_INIT_CAP (2 * SGJ_FLUSH_LEN)
+
+/* CBOR major types (in the top 3 bits of the initial byte) */
+#define CBOR_UINT 0
+#define CBOR_NINT 1
+#define CBOR_BSTR 2
+#define CBOR_TSTR 3
+#define CBOR_ARR 4
+#define CBOR_MAP 5
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_NULL 0xf6
+#define CBOR_BREAK 0xff         /* ends an indefinite length item */
+#define CBOR_INDEF 31           /* additional info: indefinite length */
+
+static const char * hex_digits = "0123456789abcdef";
+
+
+int
+sgj_init(struct sgj_state * jsp, int fd, bool pretty)
+{
+    memset(jsp, 0, sizeof(*jsp));
+    jsp->fd = fd;
+    jsp->pretty = pretty;
+    jsp->first[0] = true;
+    jsp->bp = (char *)malloc(SGJ_INIT_CAP);
+    if (NULL == jsp->bp) {
+        jsp->err = ENOMEM;
+        return ENOMEM;
+    }
+    jsp->cap = SGJ_INIT_CAP;
+    return 0;
+}
+
+int
+sgj_init_cbor(struct sgj_state * jsp, int fd)
+{
+    int res = sgj_init(jsp, fd, false);
+
+    jsp->cbor = true;
+    return res;
+}
+
+int
+sgj_flush(struct sgj_state * jsp)
+{
+    int k, n;
+
+    for (k = 0; (0 == jsp->err) && (k < jsp->len); k += n) {
+        n = write(jsp->fd, jsp->bp + k, jsp->len - k);
+        if (n < 0) {
+            if (EINTR == errno) {
+                n = 0;
+                continue;
+            }
+            jsp->err = errno;
+        }
+    }
+    jsp->len = 0;
+    return jsp->err;
+}
+
+int
+sgj_fini(struct sgj_state * jsp)
+{
+    if (jsp->bp) {
+        sgj_flush(jsp);
+        free(jsp->bp);
+        jsp->bp = NULL;
+    }
+    jsp->cap = 0;
+    return jsp->err;
+}
+
+/* Makes room for n more bytes, returns false after an error */
+static bool
+sgj_room(struct sgj_state * jsp, int n)
+{
+    int new_cap;
+    char * p;
+
+    if (jsp->err)
+        return false;
+    if (jsp->len + n <= jsp->cap)
+        return true;
+    if (jsp->len > 0) {
+        if (sgj_flush(jsp))
+            return false;
+        if (n <= jsp->cap)
+            return true;
+    }
+    for (new_cap = jsp->cap ? jsp->cap : SGJ_INIT_CAP; new_cap < n; )
+        new_cap *= 2;
+    p = (char *)realloc(jsp->bp, new_cap);
+    if (NULL == p) {
+        jsp->err = ENOMEM;
+        return false;
+    }
+    jsp->bp = p;
+    jsp->cap = new_cap;
+    return true;
+}
+
+static inline void
+sgj_put(struct sgj_state * jsp, const char * s, int n)
+{
+    memcpy(jsp->bp + jsp->len, s, n);
+    jsp->len += n;
+}
+
+/* Appends the CBOR head for major type mt with argument val, in the
+ * shortest form. Returns false after an error. */
+static bool
+cbor_head(struct sgj_state * jsp, int mt, uint64_t val)
+{
+    int k, n, ai;
+    uint8_t * up;
+
+    if (! sgj_room(jsp, 9))
+        return false;
+    up = (uint8_t *)jsp->bp + jsp->len;
+    if (val < 24) {
+        up[0] = (uint8_t)((mt << 5) | val);
+        ++jsp->len;
+        return true;
+    }
+    if (val <= 0xff) {
+        n = 1;
+        ai = 24;
+    } else if (val <= 0xffff) {
+        n = 2;
+        ai = 25;
+    } else if (val <= 0xffffffff) {
+        n = 4;
+        ai = 26;
+    } else {
+        n = 8;
+        ai = 27;
+    }
+    up[0] = (uint8_t)((mt << 5) | ai);
+    for (k = n; k > 0; --k, val >>= 8)
+        up[k] = (uint8_t)val;
+    jsp->len += 1 + n;
+    return true;
+}
+
+/* A text string if s (slen bytes) is plain ASCII, else a byte string */
+static void
+cbor_str(struct sgj_state * jsp, const char * s, int slen)
+{
+    int k, mt;
+
+    for (k = 0, mt = CBOR_TSTR; k < slen; ++k) {
+        if ((uint8_t)s[k] > 0x7f) {
+            mt = CBOR_BSTR;
+            break;
+        }
+    }
+    if ((! cbor_head(jsp, mt, slen)) || (! sgj_room(jsp, slen)))
+        return;
+    sgj_put(jsp, s, slen);
+}
+
+static void
+cbor_byte(struct sgj_state * jsp, uint8_t b)
+{
+    if (sgj_room(jsp, 1))
+        jsp->bp[jsp->len++] = (char)b;
+}
+
+/* Appends s as a quoted JSON string; at most slen bytes or up to a NUL */
+static void
+sgj_put_qstr(struct sgj_state * jsp, const char * s, int slen)
+{
+    int k;
+    char * cp;
+    uint8_t c;
+
+    /* worst case is 6 bytes out for each byte in, plus quotes */
+    if (! sgj_room(jsp, (6 * slen) + 2))
+        return;
+    cp = jsp->bp + jsp->len;
+    *cp++ = '"';
+    for (k = 0; (k < slen) && s[k]; ++k) {
+        c = (uint8_t)s[k];
+        if (('"' == c) || ('\\' == c)) {
+            *cp++ = '\\';
+            *cp++ = c;
+        } else if ((c >= 0x20) && (c < 0x7f))
+            *cp++ = c;
+        else if ('\n' == c) {
+            *cp++ = '\\';
+            *cp++ = 'n';
+        } else if ('\t' == c) {
+            *cp++ = '\\';
+            *cp++ = 't';
+        } else {
+            memcpy(cp, "\\u00", 4);
+            cp[4] = hex_digits[c >> 4];
+            cp[5] = hex_digits[c & 0xf];
+            cp += 6;
+        }
+    }
+    *cp++ = '"';
+    jsp->len = cp - jsp->bp;
+}
+
+/* Separator, indentation and "name": ahead of each value. Returns false
+ * after an error. */
+static bool
+sgj_lead(struct sgj_state * jsp, const char * name)
+{
+    int d = jsp->depth;
+
+    if (jsp->cbor) {
+        if (name)
+            cbor_str(jsp, name, (int)strlen(name));
+        return (0 == jsp->err);
+    }
+    if (! sgj_room(jsp, 2 + (2 * d)))
+        return false;
+    if (jsp->first[d])
+        jsp->first[d] = false;
+    else if (d > 0)
+        jsp->bp[jsp->len++] = ',';
+    if (jsp->pretty && (d > 0)) {
+        jsp->bp[jsp->len++] = '\n';
+        memset(jsp->bp + jsp->len, ' ', 2 * d);
+        jsp->len += 2 * d;
+    }
+    if (name) {
+        sgj_put_qstr(jsp, name, (int)strlen(name));
+        if (! sgj_room(jsp, 2))
+            return false;
+        jsp->bp[jsp->len++] = ':';
+        if (jsp->pretty)
+            jsp->bp[jsp->len++] = ' ';
+    }
+    return (0 == jsp->err);
+}
+
+/* After each value: end of a top level value or a flush when full */
+static void
+sgj_trail(struct sgj_state * jsp)
+{
+    if (0 == jsp->depth) {
+        if ((! jsp->cbor) && sgj_room(jsp, 1))
+            jsp->bp[jsp->len++] = '\n';
+        jsp->first[0] = true;
+        sgj_flush(jsp);
+    } else if (jsp->len >= SGJ_FLUSH_LEN)
+        sgj_flush(jsp);
+}
+
+static void
+sgj_begin(struct sgj_state * jsp, const char * name, char c)
+{
+    if (! sgj_lead(jsp, name))
+        return;
+    if (jsp->depth >= SGJ_MAX_DEPTH) {
+        jsp->err = E2BIG;
+        return;
+    }
+    if (! sgj_room(jsp, 1))
+        return;
+    if (jsp->cbor)
+        jsp->bp[jsp->len++] = (char)(((('{' == c) ? CBOR_MAP : CBOR_ARR) <<
+                                      5) | CBOR_INDEF);
+    else
+        jsp->bp[jsp->len++] = c;
+    jsp->first[++jsp->depth] = true;
+}
+
+static void
+sgj_end(struct sgj_state * jsp, char c)
+{
+    int d = jsp->depth;
+
+    if (d <= 0)
+        return;
+    if (jsp->cbor) {
+        cbor_byte(jsp, CBOR_BREAK);
+        jsp->depth = d - 1;
+        sgj_trail(jsp);
+        return;
+    }
+    if (! sgj_room(jsp, 2 + (2 * d)))
+        return;
+    --d;
+    if (jsp->pretty && (! jsp->first[d + 1])) {
+        jsp->bp[jsp->len++] = '\n';
+        memset(jsp->bp + jsp->len, ' ', 2 * d);
+        jsp->len += 2 * d;
+    }
+    jsp->bp[jsp->len++] = c;
+    jsp->depth = d;
+    sgj_trail(jsp);
+}
+
+void
+sgj_begin_obj(struct sgj_state * jsp, const char * name)
+{
+    sgj_begin(jsp, name, '{');
+}
+
+void
+sgj_end_obj(struct sgj_state * jsp)
+{
+    sgj_end(jsp, '}');
+}
+
+void
+sgj_begin_arr(struct sgj_state * jsp, const char * name)
+{
+    sgj_begin(jsp, name, '[');
+}
+
+void
+sgj_end_arr(struct sgj_state * jsp)
+{
+    sgj_end(jsp, ']');
+}
+
+/* A value that needs no escaping, e.g. a number */
+static void
+sgj_add_raw(struct sgj_state * jsp, const char * name, const char * s,
+            int slen)
+{
+    if (! sgj_lead(jsp, name))
+        return;
+    if (! sgj_room(jsp, slen))
+        return;
+    sgj_put(jsp, s, slen);
+    sgj_trail(jsp);
+}
+
+void
+sgj_add_str(struct sgj_state * jsp, const char * name, const char * s)
+{
+    if (! sgj_lead(jsp, name))
+        return;
+    if (jsp->cbor) {
+        if (s)
+            cbor_str(jsp, s, (int)strlen(s));
+        else
+            cbor_byte(jsp, CBOR_NULL);
+    } else if (s)
+        sgj_put_qstr(jsp, s, (int)strlen(s));
+    else if (sgj_room(jsp, 4))
+        sgj_put(jsp, "null", 4);
+    sgj_trail(jsp);
+}
+
+void
+sgj_add_strn(struct sgj_state * jsp, const char * name, const char * s,
+             int slen)
+{
+    int k;
+
+    for (k = 0; (k < slen) && s[k]; ++k)
+        ;
+    for (slen = k; (slen > 0) && (' ' == s[slen - 1]); --slen)
+        ;
+    if (! sgj_lead(jsp, name))
+        return;
+    if (jsp->cbor)
+        cbor_str(jsp, s, slen);
+    else
+        sgj_put_qstr(jsp, s, slen);
+    sgj_trail(jsp);
+}
+
+void
+sgj_add_int(struct sgj_state * jsp, const char * name, int64_t val)
+{
+    char b[24];
+
+    if (jsp->cbor) {
+        if (sgj_lead(jsp, name)) {
+            if (val < 0)
+                cbor_head(jsp, CBOR_NINT, (uint64_t)(-1 - val));
+            else
+                cbor_head(jsp, CBOR_UINT, (uint64_t)val);
+            sgj_trail(jsp);
+        }
+        return;
+    }
+    sgj_add_raw(jsp, name, b, snprintf(b, sizeof(b), "%" PRId64, val));
+}
+
+void
+sgj_add_uint(struct sgj_state * jsp, const char * name, uint64_t val)
+{
+    char b[24];
+
+    if (jsp->cbor) {
+        if (sgj_lead(jsp, name)) {
+            cbor_head(jsp, CBOR_UINT, val);
+            sgj_trail(jsp);
+        }
+        return;
+    }
+    sgj_add_raw(jsp, name, b, snprintf(b, sizeof(b), "%" PRIu64, val));
+}
+
+void
+sgj_add_bool(struct sgj_state * jsp, const char * name, bool val)
+{
+    if (jsp->cbor) {
+        if (sgj_lead(jsp, name)) {
+            cbor_byte(jsp, val ? CBOR_TRUE : CBOR_FALSE);
+            sgj_trail(jsp);
+        }
+    } else if (val)
+        sgj_add_raw(jsp, name, "true", 4);
+    else
+        sgj_add_raw(jsp, name, "false", 5);
+}
+
+void
+sgj_add_hex(struct sgj_state * jsp, const char * name, const uint8_t * bp,
+            int blen)
+{
+    int k;
+    char * cp;
+
+    if (! sgj_lead(jsp, name))
+        return;
+    if (jsp->cbor) {
+        if (cbor_head(jsp, CBOR_BSTR, blen) && sgj_room(jsp, blen))
+            sgj_put(jsp, (const char *)bp, blen);
+        sgj_trail(jsp);
+        return;
+    }
+    if (! sgj_room(jsp, (2 * blen) + 2))
+        return;
+    cp = jsp->bp + jsp->len;
+    *cp++ = '"';
+    for (k = 0; k < blen; ++k) {
+        *cp++ = hex_digits[bp[k] >> 4];
+        *cp++ = hex_digits[bp[k] & 0xf];
+    }
+    *cp++ = '"';
+    jsp->len = cp - jsp->bp;
+    sgj_trail(jsp);
+}
@@ -30,6 +30,7 @@
  */
 
 #define _POSIX_C_SOURCE 200809L         /* for posix_memalign() */
+#define _DEFAULT_SOURCE 1       /* for MAP_ANONYMOUS and madvise() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -44,6 +45,16 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>           /* for __crc32cd() and friends */
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>          /* for _mm_clmulepi64_si128() and friends */
+#endif
+#ifndef SG_LIB_MINGW
+#include <sys/mman.h>
+#endif
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -63,6 +74,186 @@ typedef unsigned int my_uint;    /* convenience to save a few line wraps */
 FILE * sg_warnings_strm = NULL;        /* would like to default to stderr */
 
 
+/* Optional lock-free logging. When enabled with sg_log_ring_enable(), each
+ * thread calling pr2ws() or pr2serr() formats into its own single producer,
+ * single consumer ring of bytes instead of calling stdio; one thread then
+ * writes the rings out with sg_log_ring_drain(). A full ring drops (and
+ * counts) the message rather than waiting. Rings are found by their
+ * owning threads via a thread local pointer and installed in
+ * sg_log_ring_arr[] with a compare-and-swap. */
+#if defined(__GNUC__) && defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && \
+    (__GCC_ATOMIC_LLONG_LOCK_FREE == 2) && (! defined(SG_LIB_NO_LOG_RING))
+#define SG_LIB_LOG_RING 1
+#endif
+
+#ifdef SG_LIB_LOG_RING
+
+#define SG_LOG_RING_MAX 256     /* maximum number of logging threads */
+#define SG_LOG_MSG_MAX 1024     /* longer messages are truncated */
+
+struct sg_log_ring {
+    uint64_t head;              /* only advanced by the owning thread */
+    uint64_t tail;              /* only advanced by the draining thread */
+    uint64_t dropped;
+    uint32_t mask;              /* ring size less 1 (a power of 2) */
+    char buf[];
+};
+
+static struct sg_log_ring * sg_log_ring_arr[SG_LOG_RING_MAX];
+static uint32_t sg_log_ring_sz;         /* 0 when disabled */
+static uint32_t sg_log_ring_gen;        /* bumped by each enable */
+static __thread struct sg_log_ring * sg_log_tl_ring;
+static __thread uint32_t sg_log_tl_gen;
+
+static struct sg_log_ring *
+sg_log_ring_get(uint32_t sz)
+{
+    int k;
+    struct sg_log_ring * rp = sg_log_tl_ring;
+    struct sg_log_ring * expect;
+    uint32_t gen = __atomic_load_n(&sg_log_ring_gen, __ATOMIC_ACQUIRE);
+
+    if (rp && (gen == sg_log_tl_gen))
+        return rp;
+    rp = (struct sg_log_ring *)calloc(1, sizeof(*rp) + sz);
+    if (NULL == rp)
+        return NULL;
+    rp->mask = sz - 1;
+    for (k = 0; k < SG_LOG_RING_MAX; ++k) {
+        expect = NULL;
+        if (__atomic_compare_exchange_n(sg_log_ring_arr + k, &expect, rp,
+                                        false, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE))
+            break;
+    }
+    if (k >= SG_LOG_RING_MAX) {
+        free(rp);
+        return NULL;
+    }
+    sg_log_tl_ring = rp;
+    sg_log_tl_gen = gen;
+    return rp;
+}
+
+/* Returns -1 (without touching args) if the message should go to stdio */
+static int
+sg_log_ring_vput(const char * fmt, va_list args)
+{
+    int n, k;
+    uint32_t sz = __atomic_load_n(&sg_log_ring_sz, __ATOMIC_ACQUIRE);
+    uint64_t head, tail;
+    struct sg_log_ring * rp;
+    char b[SG_LOG_MSG_MAX];
+
+    if (0 == sz)
+        return -1;
+    rp = sg_log_ring_get(sz);
+    if (NULL == rp)
+        return -1;
+    n = vsnprintf(b, sizeof(b), fmt, args);
+    if (n <= 0)
+        return n;
+    if (n >= (int)sizeof(b))
+        n = sizeof(b) - 1;
+    head = rp->head;
+    tail = __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE);
+    if ((head - tail + n) > (uint64_t)rp->mask + 1) {
+        __atomic_fetch_add(&rp->dropped, 1, __ATOMIC_RELAXED);
+        return n;
+    }
+    for (k = 0; k < n; ++k)
+        rp->buf[(head + k) & rp->mask] = b[k];
+    __atomic_store_n(&rp->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+static void
+sg_log_ring_free(void)
+{
+    int k;
+
+    for (k = 0; k < SG_LOG_RING_MAX; ++k) {
+        free(sg_log_ring_arr[k]);
+        sg_log_ring_arr[k] = NULL;
+    }
+}
+
+int
+sg_log_ring_enable(int ring_sz)
+{
+    uint32_t sz;
+
+    /* drop any existing rings, a new generation would claim fresh slots */
+    if (__atomic_load_n(&sg_log_ring_sz, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&sg_log_ring_sz, 0, __ATOMIC_RELEASE);
+        sg_log_ring_drain(true);
+        sg_log_ring_free();
+    }
+    if (ring_sz <= 0)
+        return 0;
+    for (sz = 4096; (sz < (uint32_t)ring_sz) && (sz < 0x40000000); sz <<= 1)
+        ;
+    __atomic_fetch_add(&sg_log_ring_gen, 1, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&sg_log_ring_sz, sz, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int
+sg_log_ring_drain(bool all)
+{
+    int k, total = 0;
+    uint32_t n, off, first;
+    uint64_t head, tail, end, dropped;
+    struct sg_log_ring * rp;
+    FILE * fp = sg_warnings_strm ? sg_warnings_strm : stderr;
+
+    for (k = 0; k < SG_LOG_RING_MAX; ++k) {
+        rp = __atomic_load_n(sg_log_ring_arr + k, __ATOMIC_ACQUIRE);
+        if (NULL == rp)
+            continue;
+        head = __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE);
+        tail = rp->tail;
+        end = head;
+        if (! all) {    /* stop after the last complete line */
+            while ((end > tail) && ('\n' != rp->buf[(end - 1) & rp->mask]))
+                --end;
+        }
+        if (end > tail) {
+            n = (uint32_t)(end - tail);
+            off = (uint32_t)(tail & rp->mask);
+            first = (n > (rp->mask + 1 - off)) ? (rp->mask + 1 - off) : n;
+            fwrite(rp->buf + off, 1, first, fp);
+            if (n > first)
+                fwrite(rp->buf, 1, n - first, fp);
+            total += n;
+            __atomic_store_n(&rp->tail, end, __ATOMIC_RELEASE);
+        }
+        dropped = __atomic_exchange_n(&rp->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped)
+            fprintf(fp, "[%" PRIu64 " log messages dropped]\n", dropped);
+    }
+    if (total)
+        fflush(fp);
+    return total;
+}
+
+#else   /* no lock-free logging, always use stdio */
+
+int
+sg_log_ring_enable(int ring_sz)
+{
+    return (ring_sz <= 0) ? 0 : -1;
+}
+
+int
+sg_log_ring_drain(bool all)
+{
+    (void)all;
+    return 0;
+}
+
+#endif  /* SG_LIB_LOG_RING */
+
 int
 pr2ws(const char * fmt, ...)
 {
@@ -70,7 +261,12 @@ pr2ws(const char * fmt, ...)
     int n;
 
     va_start(args, fmt);
-    n = vfprintf(sg_warnings_strm ? sg_warnings_strm : stderr, fmt, args);
+#ifdef SG_LIB_LOG_RING
+    n = sg_log_ring_vput(fmt, args);
+    if (n < 0)
+#endif
+        n = vfprintf(sg_warnings_strm ? sg_warnings_strm : stderr, fmt,
+                     args);
     va_end(args);
     return n;
 }
@@ -260,14 +456,87 @@ sg_get_sense_key_str(int sense_key, int buff_len, char * buff)
     return buff;
 }
 
+/* Index into sg_lib_asc_ascq[]: entries with ASC of 'n' start at element
+ * sg_asc_idx[n] and finish before element sg_asc_idx[n + 1]. Built on first
+ * use; concurrent builders write identical values. Stays unbuilt (and a
+ * linear scan is used) if sg_lib_asc_ascq[] is not in ascending order. */
+static uint16_t sg_asc_idx[257];
+static int sg_asc_idx_state;    /* 0: not built, 1: built, -1: unsorted */
+
+static int
+sg_asc_idx_build(void)
+{
+    int k, n, prev;
+    int state = 1;
+    const struct sg_lib_asc_ascq_t * eip;
+
+    for (k = 0, n = 0, prev = -1; sg_lib_asc_ascq[k].text_off; ++k) {
+        eip = &sg_lib_asc_ascq[k];
+        if (((eip->asc << 8) + eip->ascq) <= prev) {
+            state = -1;
+            break;
+        }
+        prev = (eip->asc << 8) + eip->ascq;
+        for ( ; n <= eip->asc; ++n)
+            sg_asc_idx[n] = k;
+    }
+    if ((state > 0) && (k > 0xffff))
+        state = -1;
+    for ( ; (state > 0) && (n < 257); ++n)
+        sg_asc_idx[n] = k;
+#if defined(__GNUC__)
+    __atomic_store_n(&sg_asc_idx_state, state, __ATOMIC_RELEASE);
+#else
+    sg_asc_idx_state = state;
+#endif
+    return state;
+}
+
+static const struct sg_lib_asc_ascq_t *
+sg_asc_ascq_find(int asc, int ascq)
+{
+    int k, lo, hi, state;
+    const struct sg_lib_asc_ascq_t * eip;
+
+#if defined(__GNUC__)
+    state = __atomic_load_n(&sg_asc_idx_state, __ATOMIC_ACQUIRE);
+#else
+    state = sg_asc_idx_state;
+#endif
+    if (0 == state)
+        state = sg_asc_idx_build();
+    if (state < 0) {
+        for (k = 0; sg_lib_asc_ascq[k].text_off; ++k) {
+            eip = &sg_lib_asc_ascq[k];
+            if ((eip->asc == asc) && (eip->ascq == ascq))
+                return eip;
+        }
+        return NULL;
+    }
+    if ((asc < 0) || (asc > 0xff))
+        return NULL;
+    lo = sg_asc_idx[asc];
+    hi = sg_asc_idx[asc + 1] - 1;
+    while (lo <= hi) {          /* binary search on ASCQ */
+        k = (lo + hi) / 2;
+        eip = &sg_lib_asc_ascq[k];
+        if (eip->ascq == ascq)
+            return eip;
+        if (eip->ascq < ascq)
+            lo = k + 1;
+        else
+            hi = k - 1;
+    }
+    return NULL;
+}
+
 /* Yield string associated with ASC/ASCQ values. Returns 'buff'. */
 char *
 sg_get_asc_ascq_str(int asc, int ascq, int buff_len, char * buff)
 {
     int k, num, rlen;
-    bool found = false;
-    struct sg_lib_asc_ascq_t * eip;
-    struct sg_lib_asc_ascq_range_t * ei2p;
+    const struct sg_lib_asc_ascq_t * eip;
+    const struct sg_lib_asc_ascq_range_t * ei2p;
 
     if (1 == buff_len) {
         buff[0] = '\0';
@@ -278,33 +547,24 @@ sg_get_asc_ascq_str(int asc, int ascq, int buff_len, char * buff)
         if ((ei2p->asc == asc) &&
             (ascq >= ei2p->ascq_min)  &&
             (ascq <= ei2p->ascq_max)) {
-            found = true;
             num = sg_scnpr(buff, buff_len, "Additional sense: ");
             rlen = buff_len - num;
             sg_scnpr(buff + num, ((rlen > 0) ? rlen : 0), ei2p->text, ascq);
+            return buff;
         }
     }
-    if (found)
-        return buff;
-
-    for (k = 0; sg_lib_asc_ascq[k].text; ++k) {
-        eip = &sg_lib_asc_ascq[k];
-        if (eip->asc == asc &&
-            eip->ascq == ascq) {
-            found = true;
-            sg_scnpr(buff, buff_len, "Additional sense: %s", eip->text);
-        }
-    }
-    if (! found) {
-        if (asc >= 0x80)
-            sg_scnpr(buff, buff_len, "vendor specific ASC=%02x, ASCQ=%02x "
-                     "(hex)", asc, ascq);
-        else if (ascq >= 0x80)
-            sg_scnpr(buff, buff_len, "ASC=%02x, vendor specific qualification "
-                     "ASCQ=%02x (hex)", asc, ascq);
-        else
-            sg_scnpr(buff, buff_len, "ASC=%02x, ASCQ=%02x (hex)", asc, ascq);
-    }
+    eip = sg_asc_ascq_find(asc, ascq);
+    if (eip)
+        sg_scnpr(buff, buff_len, "Additional sense: %s",
+                 sg_lib_asc_ascq_pool + eip->text_off);
+    else if (asc >= 0x80)
+        sg_scnpr(buff, buff_len, "vendor specific ASC=%02x, ASCQ=%02x "
+                 "(hex)", asc, ascq);
+    else if (ascq >= 0x80)
+        sg_scnpr(buff, buff_len, "ASC=%02x, vendor specific qualification "
+                 "ASCQ=%02x (hex)", asc, ascq);
+    else
+        sg_scnpr(buff, buff_len, "ASC=%02x, ASCQ=%02x (hex)", asc, ascq);
     return buff;
 }
 
@@ -504,6 +764,145 @@ sg_get_sense_progress_fld(const uint8_t * sbp, int sb_len,
     }
 }
 
+/* See description in sg_lib.h header file */
+bool
+sg_scsi_decode_sense(const uint8_t * sbp, int sb_len,
+                     struct sg_scsi_sense_info * sip)
+{
+    bool sk_pr;
+    int k, len, add_sb_len, desc_len;
+    const uint8_t * bp;
+
+    memset(sip, 0, sizeof(*sip));
+    if ((NULL == sbp) || (sb_len < 1))
+        return false;
+    sip->response_code = 0x7f & sbp[0];
+    switch (sip->response_code) {
+    case 0x70:
+    case 0x71:
+        len = (sb_len > 7) ? (sbp[7] + 8) : sb_len;
+        len = (len > sb_len) ? sb_len : len;
+        sip->len = len;
+        sip->deferred = (0x71 == sip->response_code);
+        if (len > 2) {
+            sip->sense_key = 0xf & sbp[2];
+            sip->sdat_ovfl = !!(sbp[2] & 0x10);
+            sip->stream_present = true;
+            sip->filemark = !!(sbp[2] & 0x80);
+            sip->eom = !!(sbp[2] & 0x40);
+            sip->ili = !!(sbp[2] & 0x20);
+        }
+        if (len > 6) {
+            sip->info_present = true;
+            sip->info_valid = !!(sbp[0] & 0x80);
+            sip->info = sg_get_unaligned_be32(sbp + 3);
+        }
+        if (len > 11) {
+            sip->cmd_spec_present = true;
+            sip->cmd_spec = sg_get_unaligned_be32(sbp + 8);
+        }
+        if (len > 12)
+            sip->asc = sbp[12];
+        if (len > 13)
+            sip->ascq = sbp[13];
+        if (len > 14)
+            sip->fru_code = sbp[14];
+        if ((len > 17) && (sbp[15] & 0x80)) {
+            sip->sksv = true;
+            memcpy(sip->sks, sbp + 15, 3);
+            if ((SPC_SK_NO_SENSE == sip->sense_key) ||
+                (SPC_SK_NOT_READY == sip->sense_key)) {
+                sip->progress_present = true;
+                sip->progress = sg_get_unaligned_be16(sbp + 16);
+            }
+        }
+        return true;
+    case 0x72:
+    case 0x73:
+        sip->descriptor_format = true;
+        sip->deferred = (0x73 == sip->response_code);
+        break;
+    default:
+        sip->response_code = 0;
+        return false;
+    }
+    /* descriptor format, same walk as sg_scsi_sense_desc_find() */
+    if (sb_len > 1)
+        sip->sense_key = 0xf & sbp[1];
+    if (sb_len > 2)
+        sip->asc = sbp[2];
+    if (sb_len > 3)
+        sip->ascq = sbp[3];
+    if (sb_len > 4)
+        sip->sdat_ovfl = !!(sbp[4] & 0x80);
+    sip->len = (sb_len < 8) ? sb_len : 8;
+    if ((sb_len < 8) || (0 == (add_sb_len = sbp[7])))
+        return true;
+    add_sb_len = (add_sb_len < (sb_len - 8)) ?  add_sb_len : (sb_len - 8);
+    sip->len = 8 + add_sb_len;
+    sk_pr = (SPC_SK_NO_SENSE == sip->sense_key) ||
+            (SPC_SK_NOT_READY == sip->sense_key);
+    for (k = 0; k < add_sb_len; k += desc_len) {
+        bp = sbp + 8 + k;
+        desc_len = (k < (add_sb_len - 1)) ? (bp[1] + 2) : 1;
+        if (sip->num_descs < SG_SENSE_MAX_DESCS) {
+            sip->desc[sip->num_descs].type = bp[0];
+            sip->desc[sip->num_descs].offset = 8 + k;
+            sip->desc[sip->num_descs].len = (desc_len > (add_sb_len - k)) ?
+                                            (add_sb_len - k) : desc_len;
+        }
+        ++sip->num_descs;
+        if ((desc_len < 2) || (desc_len > (add_sb_len - k)))
+            break;      /* truncated descriptor, list it but go no further */
+        switch (bp[0]) {
+        case 0:         /* information */
+            if ((0xa == bp[1]) && (! sip->info_present)) {
+                sip->info_present = true;
+                sip->info_valid = !!(bp[2] & 0x80);
+                sip->info = sg_get_unaligned_be64(bp + 4);
+            }
+            break;
+        case 1:         /* command specific information */
+            if ((0xa == bp[1]) && (! sip->cmd_spec_present)) {
+                sip->cmd_spec_present = true;
+                sip->cmd_spec = sg_get_unaligned_be64(bp + 4);
+            }
+            break;
+        case 2:         /* sense key specific */
+            if ((0x6 == bp[1]) && (! sip->sksv) && (0x80 & bp[4])) {
+                sip->sksv = true;
+                memcpy(sip->sks, bp + 4, 3);
+                if (sk_pr) {
+                    sip->progress_present = true;
+                    sip->progress = sg_get_unaligned_be16(bp + 5);
+                }
+            }
+            break;
+        case 3:         /* field replaceable unit */
+            if ((bp[1] >= 2) && (0 == sip->fru_code))
+                sip->fru_code = bp[3];
+            break;
+        case 4:         /* stream commands */
+            if ((bp[1] >= 2) && (! sip->stream_present)) {
+                sip->stream_present = true;
+                sip->filemark = !!(bp[3] & 0x80);
+                sip->eom = !!(bp[3] & 0x40);
+                sip->ili = !!(bp[3] & 0x20);
+            }
+            break;
+        case 0xa:       /* another progress indication */
+            if ((0x6 == bp[1]) && (! sip->progress_present)) {
+                sip->progress_present = true;
+                sip->progress = sg_get_unaligned_be16(bp + 6);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
 char *
 sg_get_pdt_str(int pdt, int buff_len, char * buff)
 {
@@ -1682,8 +2081,6 @@ int
 sg_get_sense_str(const char * lip, const uint8_t * sbp, int sb_len,
                  bool raw_sinfo, int cblen, char * cbp)
 {
-    bool descriptor_format = false;
-    bool sdat_ovfl = false;
     bool valid;
     int len, progress, n, r, pr, rem, blen;
     unsigned int info;
@@ -1691,7 +2088,7 @@ sg_get_sense_str(const char * lip, const uint8_t * sbp, int sb_len,
     const char * ebp = NULL;
     char ebuff[64];
     char b[256];
-    struct sg_scsi_sense_hdr ssh;
+    struct sg_scsi_sense_info si;
 
     if ((NULL == cbp) || (cblen <= 0))
         return 0;
@@ -1710,108 +2107,99 @@ sg_get_sense_str(const char * lip, const uint8_t * sbp, int sb_len,
     resp_code = 0x7f & sbp[0];
     valid = !!(sbp[0] & 0x80);
     len = sb_len;
-    if (sg_scsi_normalize_sense(sbp, sb_len, &ssh)) {
-        switch (ssh.response_code) {
+    if (sg_scsi_decode_sense(sbp, sb_len, &si)) {
+        switch (si.response_code) {
         case 0x70:      /* fixed, current */
             ebp = "Fixed format, current";
-            len = (sb_len > 7) ? (sbp[7] + 8) : sb_len;
-            len = (len > sb_len) ? sb_len : len;
-            sdat_ovfl = (len > 2) ? !!(sbp[2] & 0x10) : false;
+            len = si.len;
             break;
         case 0x71:      /* fixed, deferred */
             /* error related to a previous command */
             ebp = "Fixed format, <<<deferred>>>";
-            len = (sb_len > 7) ? (sbp[7] + 8) : sb_len;
-            len = (len > sb_len) ? sb_len : len;
-            sdat_ovfl = (len > 2) ? !!(sbp[2] & 0x10) : false;
+            len = si.len;
             break;
         case 0x72:      /* descriptor, current */
-            descriptor_format = true;
             ebp = "Descriptor format, current";
-            sdat_ovfl = (sb_len > 4) ? !!(sbp[4] & 0x80) : false;
             break;
         case 0x73:      /* descriptor, deferred */
-            descriptor_format = true;
             ebp = "Descriptor format, <<<deferred>>>";
-            sdat_ovfl = (sb_len > 4) ? !!(sbp[4] & 0x80) : false;
             break;
         case 0x0:
             ebp = "Response code: 0x0 (?)";
             break;
         default:
             sg_scnpr(ebuff, sizeof(ebuff), "Unknown response code: 0x%x",
-                     ssh.response_code);
+                     si.response_code);
             ebp = ebuff;
             break;
         }
         n += sg_scnpr(cbp + n, cblen - n, "%s%s; Sense key: %s\n", lip, ebp,
-                      sg_lib_sense_key_desc[ssh.sense_key]);
-        if (sdat_ovfl)
+                      sg_lib_sense_key_desc[si.sense_key]);
+        if (si.sdat_ovfl)
             n += sg_scnpr(cbp + n, cblen - n, "%s<<<Sense data overflow "
                           "(SDAT_OVFL)>>>\n", lip);
-        if (descriptor_format) {
+        if (si.descriptor_format) {
             n += sg_scnpr(cbp + n, cblen - n, "%s%s\n", lip,
-                          sg_get_asc_ascq_str(ssh.asc, ssh.ascq, blen, b));
+                          sg_get_asc_ascq_str(si.asc, si.ascq, blen, b));
             n += sg_get_sense_descriptors_str(lip, sbp, len,
                                               cblen - n, cbp + n);
-        } else if ((len > 12) && (0 == ssh.asc) &&
-                   (ASCQ_ATA_PT_INFO_AVAILABLE == ssh.ascq)) {
+        } else if ((len > 12) && (0 == si.asc) &&
+                   (ASCQ_ATA_PT_INFO_AVAILABLE == si.ascq)) {
             /* SAT ATA PASS-THROUGH fixed format */
             n += sg_scnpr(cbp + n, cblen - n, "%s%s\n", lip,
-                          sg_get_asc_ascq_str(ssh.asc, ssh.ascq, blen, b));
+                          sg_get_asc_ascq_str(si.asc, si.ascq, blen, b));
             n += sg_get_sense_sat_pt_fixed_str(lip, sbp, len,
                                                cblen - n, cbp + n);
         } else if (len > 2) {   /* fixed format */
             if (len > 12)
                 n += sg_scnpr(cbp + n, cblen - n, "%s%s\n", lip,
-                         sg_get_asc_ascq_str(ssh.asc, ssh.ascq, blen, b));
+                         sg_get_asc_ascq_str(si.asc, si.ascq, blen, b));
             r = 0;
             if (strlen(lip) > 0)
                 r += sg_scnpr(b + r, blen - r, "%s", lip);
-            if (len > 6) {
-                info = sg_get_unaligned_be32(sbp + 3);
+            info = (unsigned int)si.info;
+            if (si.info_present) {
                 if (valid)
                     r += sg_scnpr(b + r, blen - r, "  Info fld=0x%x [%u] ",
                                   info, info);
                 else if (info > 0)
                     r += sg_scnpr(b + r, blen - r, "  Valid=0, Info fld=0x%x "
                                   "[%u] ", info, info);
-            } else
-                info = 0;
-            if (sbp[2] & 0xe0) {
-                if (sbp[2] & 0x80)
+            }
+            if (si.filemark || si.eom || si.ili) {
+                if (si.filemark)
                    r += sg_scnpr(b + r, blen - r, " FMK");
                             /* current command has read a filemark */
-                if (sbp[2] & 0x40)
+                if (si.eom)
                    r += sg_scnpr(b + r, blen - r, " EOM");
                             /* end-of-medium condition exists */
-                if (sbp[2] & 0x20)
+                if (si.ili)
                    r += sg_scnpr(b + r, blen - r, " ILI");
                             /* incorrect block length requested */
                 r += sg_scnpr(b + r, blen - r, "\n");
             } else if (valid || (info > 0))
                 r += sg_scnpr(b + r, blen - r, "\n");
-            if ((len >= 14) && sbp[14])
+            if (si.fru_code)
                 r += sg_scnpr(b + r, blen - r, "%s  Field replaceable unit "
-                              "code: %d\n", lip, sbp[14]);
-            if ((len >= 18) && (sbp[15] & 0x80)) {
+                              "code: %d\n", lip, si.fru_code);
+            if (si.sksv) {
                 /* sense key specific decoding */
-                switch (ssh.sense_key) {
+                switch (si.sense_key) {
                 case SPC_SK_ILLEGAL_REQUEST:
                     r += sg_scnpr(b + r, blen - r, "%s  Sense Key Specific: "
                                   "Error in %s: byte %d", lip,
-                                  ((sbp[15] & 0x40) ?
+                                  ((si.sks[0] & 0x40) ?
                                          "Command" : "Data parameters"),
-                                  sg_get_unaligned_be16(sbp + 16));
-                    if (sbp[15] & 0x08)
+                                  sg_get_unaligned_be16(si.sks + 1));
+                    if (si.sks[0] & 0x08)
                         r += sg_scnpr(b + r, blen - r, " bit %d\n",
-                                      sbp[15] & 0x07);
+                                      si.sks[0] & 0x07);
                     else
                         r += sg_scnpr(b + r, blen - r, "\n");
                     break;
                 case SPC_SK_NO_SENSE:
                 case SPC_SK_NOT_READY:
-                    progress = sg_get_unaligned_be16(sbp + 16);
+                    progress = si.progress;
                     pr = (progress * 100) / 65536;
                     rem = ((progress * 100) % 65536) / 656;
                     r += sg_scnpr(b + r, blen - r, "%s  Progress indication: "
@@ -1821,18 +2209,18 @@ sg_get_sense_str(const char * lip, const uint8_t * sbp, int sb_len,
                 case SPC_SK_MEDIUM_ERROR:
                 case SPC_SK_RECOVERED_ERROR:
                     r += sg_scnpr(b + r, blen - r, "%s  Actual retry count: "
-                                  "0x%02x%02x\n", lip, sbp[16], sbp[17]);
+                                  "0x%02x%02x\n", lip, si.sks[1], si.sks[2]);
                     break;
                 case SPC_SK_COPY_ABORTED:
                     r += sg_scnpr(b + r, blen - r, "%s  Segment pointer: ",
                                   lip);
                     r += sg_scnpr(b + r, blen - r, "Relative to start of %s, "
-                                  "byte %d", ((sbp[15] & 0x20) ?
+                                  "byte %d", ((si.sks[0] & 0x20) ?
                                      "segment descriptor" : "parameter list"),
-                                  sg_get_unaligned_be16(sbp + 16));
-                    if (sbp[15] & 0x08)
+                                  sg_get_unaligned_be16(si.sks + 1));
+                    if (si.sks[0] & 0x08)
                         r += sg_scnpr(b + r, blen - r, " bit %d\n",
-                                      sbp[15] & 0x07);
+                                      si.sks[0] & 0x07);
                     else
                         r += sg_scnpr(b + r, blen - r, "\n");
                     break;
@@ -1840,11 +2228,11 @@ sg_get_sense_str(const char * lip, const uint8_t * sbp, int sb_len,
                     r += sg_scnpr(b + r, blen - r, "%s  Unit attention "
                                   "condition queue: ", lip);
                     r += sg_scnpr(b + r, blen - r, "overflow flag is %d\n",
-                                  !!(sbp[15] & 0x1));
+                                  !!(si.sks[0] & 0x1));
                     break;
                 default:
                     r += sg_scnpr(b + r, blen - r, "%s  Sense_key: 0x%x "
-                                  "unexpected\n", lip, ssh.sense_key);
+                                  "unexpected\n", lip, si.sense_key);
                     break;
                 }
             }
@@ -2103,6 +2491,53 @@ sg_scsi_normalize_sense(const uint8_t * sbp, int sb_len,
     return true;
 }
 
+/* Maps a sense key, additional sense code and its qualifier to a
+ * SG_LIB_CAT_* value. */
+static int
+sense_key_category(int sense_key, int asc, int ascq)
+{
+    switch (sense_key) {        /* 0 to 0x1f */
+    case SPC_SK_NO_SENSE:
+        return SG_LIB_CAT_NO_SENSE;
+    case SPC_SK_RECOVERED_ERROR:
+        return SG_LIB_CAT_RECOVERED;
+    case SPC_SK_NOT_READY:
+        return SG_LIB_CAT_NOT_READY;
+    case SPC_SK_MEDIUM_ERROR:
+    case SPC_SK_HARDWARE_ERROR:
+    case SPC_SK_BLANK_CHECK:
+        return SG_LIB_CAT_MEDIUM_HARD;
+    case SPC_SK_UNIT_ATTENTION:
+        return SG_LIB_CAT_UNIT_ATTENTION;
+        /* used to return SG_LIB_CAT_MEDIA_CHANGED when asc==0x28 */
+    case SPC_SK_ILLEGAL_REQUEST:
+        if ((0x20 == asc) && (0x0 == ascq))
+            return SG_LIB_CAT_INVALID_OP;
+        else if ((0x21 == asc) && (0x0 == ascq))
+            return SG_LIB_LBA_OUT_OF_RANGE;
+        else
+            return SG_LIB_CAT_ILLEGAL_REQ;
+        break;
+    case SPC_SK_ABORTED_COMMAND:
+        if (0x10 == asc)
+            return SG_LIB_CAT_PROTECTION;
+        else
+            return SG_LIB_CAT_ABORTED_COMMAND;
+    case SPC_SK_MISCOMPARE:
+        return SG_LIB_CAT_MISCOMPARE;
+    case SPC_SK_DATA_PROTECT:
+        return SG_LIB_CAT_DATA_PROTECT;
+    case SPC_SK_COPY_ABORTED:
+        return SG_LIB_CAT_COPY_ABORTED;
+    case SPC_SK_COMPLETED:
+    case SPC_SK_VOLUME_OVERFLOW:
+        return SG_LIB_CAT_SENSE;
+    default:
+        ;   /* reserved and vendor specific sense keys fall through */
+    }
+    return SG_LIB_CAT_SENSE;
+}
+
 /* Returns a SG_LIB_CAT_* value. If cannot decode sense buffer (sbp) or a
  * less common sense key then return SG_LIB_CAT_SENSE .*/
 int
@@ -2111,50 +2546,21 @@ sg_err_category_sense(const uint8_t * sbp, int sb_len)
     struct sg_scsi_sense_hdr ssh;
 
     if ((sbp && (sb_len > 2)) &&
-        (sg_scsi_normalize_sense(sbp, sb_len, &ssh))) {
-        switch (ssh.sense_key) {        /* 0 to 0x1f */
-        case SPC_SK_NO_SENSE:
-            return SG_LIB_CAT_NO_SENSE;
-        case SPC_SK_RECOVERED_ERROR:
-            return SG_LIB_CAT_RECOVERED;
-        case SPC_SK_NOT_READY:
-            return SG_LIB_CAT_NOT_READY;
-        case SPC_SK_MEDIUM_ERROR:
-        case SPC_SK_HARDWARE_ERROR:
-        case SPC_SK_BLANK_CHECK:
-            return SG_LIB_CAT_MEDIUM_HARD;
-        case SPC_SK_UNIT_ATTENTION:
-            return SG_LIB_CAT_UNIT_ATTENTION;
-            /* used to return SG_LIB_CAT_MEDIA_CHANGED when ssh.asc==0x28 */
-        case SPC_SK_ILLEGAL_REQUEST:
-            if ((0x20 == ssh.asc) && (0x0 == ssh.ascq))
-                return SG_LIB_CAT_INVALID_OP;
-            else if ((0x21 == ssh.asc) && (0x0 == ssh.ascq))
-                return SG_LIB_LBA_OUT_OF_RANGE;
-            else
-                return SG_LIB_CAT_ILLEGAL_REQ;
-            break;
-        case SPC_SK_ABORTED_COMMAND:
-            if (0x10 == ssh.asc)
-                return SG_LIB_CAT_PROTECTION;
-            else
-                return SG_LIB_CAT_ABORTED_COMMAND;
-        case SPC_SK_MISCOMPARE:
-            return SG_LIB_CAT_MISCOMPARE;
-        case SPC_SK_DATA_PROTECT:
-            return SG_LIB_CAT_DATA_PROTECT;
-        case SPC_SK_COPY_ABORTED:
-            return SG_LIB_CAT_COPY_ABORTED;
-        case SPC_SK_COMPLETED:
-        case SPC_SK_VOLUME_OVERFLOW:
-            return SG_LIB_CAT_SENSE;
-        default:
-            ;   /* reserved and vendor specific sense keys fall through */
-        }
-    }
+        (sg_scsi_normalize_sense(sbp, sb_len, &ssh)))
+        return sense_key_category(ssh.sense_key, ssh.asc, ssh.ascq);
     return SG_LIB_CAT_SENSE;
 }
 
+/* As sg_err_category_sense() but from sense data already decoded by
+ * sg_scsi_decode_sense(), so nothing is parsed again. */
+int
+sg_err_category_sinfo(const struct sg_scsi_sense_info * sip)
+{
+    if ((NULL == sip) || (0 == sip->response_code) || (sip->len < 3))
+        return SG_LIB_CAT_SENSE;
+    return sense_key_category(sip->sense_key, sip->asc, sip->ascq);
+}
+
 /* Beware: gives wrong answer for variable length command (opcode=0x7f) */
 int
 sg_get_command_size(uint8_t opcode)
@@ -2198,11 +2604,11 @@ sg_get_command_name(const uint8_t * cmdp, int peri_type, int buff_len,
 struct op_code2sa_t {
     int op_code;
     int pdt_match;      /* -1->all; 0->disk,ZBC,RCB, 1->tape+adc+smc */
-    struct sg_lib_value_name_t * arr;
+    const struct sg_lib_value_name_t * arr;
     const char * prefix;
 };
 
-static struct op_code2sa_t op_code2sa_arr[] = {
+static const struct op_code2sa_t op_code2sa_arr[] = {
     {SG_VARIABLE_LENGTH_CMD, -1, sg_lib_variable_length_arr, NULL},
     {SG_MAINTENANCE_IN, -1, sg_lib_maint_in_arr, NULL},
     {SG_MAINTENANCE_OUT, -1, sg_lib_maint_out_arr, NULL},
@@ -2227,11 +2633,78 @@ static struct op_code2sa_t op_code2sa_arr[] = {
     {0xffff, -1, NULL, NULL},
 };
 
+/* Indexes into sg_lib_normal_opcodes[] and op_code2sa_arr[].
+ * sg_opcode_idx[op] is the element number of the first entry for opcode
+ * 'op' in sg_lib_normal_opcodes[], or 0xffff if there is none.
+ * op_code2sa_idx[op] is 1 plus the element number of the first entry for
+ * 'op' in op_code2sa_arr[], or 0 if there is none. Built on first use;
+ * concurrent builders write identical values. */
+static uint16_t sg_opcode_idx[256];
+static uint8_t op_code2sa_idx[256];
+static int sg_opcode_idx_state; /* 0: not built, 1: built, -1: too big */
+
+/* Returns 1 when the indexes are usable, else -1 */
+static int
+sg_opcode_idx_get(void)
+{
+    int k, op;
+    int state;
+
+#if defined(__GNUC__)
+    state = __atomic_load_n(&sg_opcode_idx_state, __ATOMIC_ACQUIRE);
+#else
+    state = sg_opcode_idx_state;
+#endif
+    if (state)
+        return state;
+    state = 1;
+    for (k = 0; k < 256; ++k)
+        sg_opcode_idx[k] = 0xffff;
+    for (k = 0; sg_lib_normal_opcodes[k].name; ++k) {
+        if (k >= 0xffff) {
+            state = -1;
+            break;
+        }
+        op = sg_lib_normal_opcodes[k].value;
+        if ((op >= 0) && (op < 256) && (0xffff == sg_opcode_idx[op]))
+            sg_opcode_idx[op] = k;
+    }
+    for (k = 0; op_code2sa_arr[k].arr; ++k) {
+        if (k >= 0xff) {
+            state = -1;
+            break;
+        }
+        op = op_code2sa_arr[k].op_code;
+        if ((op >= 0) && (op < 256) && (0 == op_code2sa_idx[op]))
+            op_code2sa_idx[op] = k + 1;
+    }
+#if defined(__GNUC__)
+    __atomic_store_n(&sg_opcode_idx_state, state, __ATOMIC_RELEASE);
+#else
+    sg_opcode_idx_state = state;
+#endif
+    return state;
+}
+
+/* Same result as get_value_name(sg_lib_normal_opcodes, opcode, peri_type)
+ * but goes directly to the entries for 'opcode'. */
+static const struct sg_lib_value_name_t *
+get_opcode_value_name(int opcode, int peri_type)
+{
+    if (sg_opcode_idx_get() < 0)
+        return get_value_name(sg_lib_normal_opcodes, opcode, peri_type);
+    if ((opcode < 0) || (opcode > 0xff) || (0xffff == sg_opcode_idx[opcode]))
+        return NULL;
+    /* entries for the same opcode are adjacent, so start from the first */
+    return get_value_name(sg_lib_normal_opcodes + sg_opcode_idx[opcode],
+                          opcode, peri_type);
+}
+
 void
 sg_get_opcode_sa_name(uint8_t cmd_byte0, int service_action,
                       int peri_type, int buff_len, char * buff)
 {
-    int d_pdt;
+    int k, d_pdt;
     const struct sg_lib_value_name_t * vnp;
     const struct op_code2sa_t * osp;
     char b[80];
@@ -2246,7 +2719,10 @@ sg_get_opcode_sa_name(uint8_t cmd_byte0, int service_action,
     if (peri_type < 0)
         peri_type = 0;
     d_pdt = sg_lib_pdt_decay(peri_type);
-    for (osp = op_code2sa_arr; osp->arr; ++osp) {
+    /* k is 0 when cmd_byte0 has no service actions, else 1 + where to start
+     * looking (the start of op_code2sa_arr[] if there is no index) */
+    k = (sg_opcode_idx_get() > 0) ? op_code2sa_idx[cmd_byte0] : 1;
+    for (osp = op_code2sa_arr + (k ? k - 1 : 0); k && osp->arr; ++osp) {
         if ((int)cmd_byte0 == osp->op_code) {
             if ((osp->pdt_match < 0) || (d_pdt == osp->pdt_match)) {
                 vnp = get_value_name(osp->arr, service_action, peri_type);
@@ -2293,7 +2769,7 @@ sg_get_opcode_name(uint8_t cmd_byte0, int peri_type, int buff_len,
     case 2:
     case 4:
     case 5:
-        vnp = get_value_name(sg_lib_normal_opcodes, cmd_byte0, peri_type);
+        vnp = get_opcode_value_name(cmd_byte0, peri_type);
         if (vnp)
             sg_scnpr(buff, buff_len, "%s", vnp->name);
         else
@@ -2395,6 +2871,63 @@ sg_vpd_dev_id_iter(const uint8_t * initial_desig_desc, int page_len,
     return (k == page_len) ? -1 : -2;
 }
 
+int
+sg_vpd_dev_id_index(const uint8_t * initial_desig_desc, int page_len,
+                    struct sg_vpd_dev_id_idx * dip)
+{
+    int off, res, c_set, assoc, desig_type;
+    int * ip;
+    const uint8_t * bp;
+
+    dip->num = 0;
+    dip->lu_naa = -1;
+    dip->lu_eui64 = -1;
+    dip->lu_sns = -1;
+    dip->tport_naa = -1;
+    dip->tport_sns = -1;
+    dip->rel_tport = -1;
+    dip->tpg = -1;
+    dip->rel_tport_id = -1;
+    dip->tpg_id = -1;
+    for (off = -1; 0 == (res = sg_vpd_dev_id_iter(initial_desig_desc,
+                                                  page_len, &off, -1, -1,
+                                                  -1)); ) {
+        bp = initial_desig_desc + off;
+        if ((off + 4 + bp[3]) > page_len)
+            return -2;
+        ++dip->num;
+        c_set = bp[0] & 0xf;
+        assoc = (bp[1] >> 4) & 0x3;
+        desig_type = bp[1] & 0xf;
+        ip = NULL;
+        if (0 == assoc) {
+            if ((3 == desig_type) && (1 == c_set))
+                ip = &dip->lu_naa;
+            else if ((2 == desig_type) && (1 == c_set))
+                ip = &dip->lu_eui64;
+            else if ((8 == desig_type) && (3 == c_set))
+                ip = &dip->lu_sns;
+        } else if (1 == assoc) {
+            if ((3 == desig_type) && (1 == c_set))
+                ip = &dip->tport_naa;
+            else if ((8 == desig_type) && (3 == c_set))
+                ip = &dip->tport_sns;
+            else if ((4 == desig_type) && (bp[3] >= 4) &&
+                     (dip->rel_tport < 0)) {
+                dip->rel_tport = off;
+                dip->rel_tport_id = sg_get_unaligned_be16(bp + 6);
+            } else if ((5 == desig_type) && (bp[3] >= 4) &&
+                       (dip->tpg < 0)) {
+                dip->tpg = off;
+                dip->tpg_id = sg_get_unaligned_be16(bp + 6);
+            }
+        }
+        if (ip && (*ip < 0))
+            *ip = off;
+    }
+    return (-2 == res) ? -2 : 0;
+}
+
 static const char * sg_sfs_spc_reserved = "SPC Reserved";
 static const char * sg_sfs_sbc_reserved = "SBC Reserved";
 static const char * sg_sfs_ssc_reserved = "SSC Reserved";
@@ -2599,8 +3132,8 @@ sg_nvme_status2scsi(uint16_t sct_sc, uint8_t * status_p, uint8_t * sk_p,
 {
     int k, ind;
     uint16_t s = 0x3ff & sct_sc;
-    struct sg_lib_value_name_t * vp = sg_lib_nvme_cmd_status_arr;
-    struct sg_lib_4tuple_u8 * mp = sg_lib_scsi_status_sense_arr;
+    const struct sg_lib_value_name_t * vp = sg_lib_nvme_cmd_status_arr;
+    const struct sg_lib_4tuple_u8 * mp = sg_lib_scsi_status_sense_arr;
 
     for (k = 0; (vp->name && (k < 1000)); ++k, ++vp) {
         if (s == (uint16_t)vp->value)
@@ -2701,17 +3234,84 @@ safe_strerror(int errnum)
     return errstr;
 }
 
-static void
-trimTrailingSpaces(char * b)
+static const char * const sg_hex_digits = "0123456789abcdef";
+
+/* Writes the two lower case ASCII hex digits of 'c' to cp[0] and cp[1] */
+static inline void
+sg_hex_pair(char * cp, uint8_t c)
 {
-    int k;
+    cp[0] = sg_hex_digits[c >> 4];
+    cp[1] = sg_hex_digits[c & 0xf];
+}
 
-    for (k = ((int)strlen(b) - 1); k >= 0; --k) {
-        if (' ' != b[k])
-            break;
+/* Places up to 16 bytes from 'bp' as ASCII hex at 'cp' with a single space
+ * between bytes and two between the 8th and 9th bytes. Returns length. */
+static int
+sg_hex_bytes16(const uint8_t * bp, int n, char * cp)
+{
+    int k, pos;
+
+    for (k = 0, pos = 0; k < n; ++k, pos += 3) {
+        if (8 == k)
+            cp[pos++] = ' ';
+        sg_hex_pair(cp + pos, bp[k]);
+        cp[pos + 2] = ' ';
+    }
+    return (n > 0) ? (pos - 1) : 0;
+}
+
+#define DSHF_LINE_MAX 82        /* longest line from dStrHexLine() */
+
+/* Formats one line (up to 16 bytes from 'bp') of dStrHex() style output
+ * into 'cp' including the trailing newline, 'a' is the address (offset)
+ * shown when no_ascii >= 0. Returns the number of characters placed. */
+static int
+dStrHexLine(const uint8_t * bp, int n, int a, int no_ascii, char * cp)
+{
+    int k, len;
+    const int bpstart = 8;      /* address starts at 1 */
+    const int cpstart = 60;
+
+    if (no_ascii < 0) {
+        len = sg_hex_bytes16(bp, n, cp);
+        cp[len] = '\n';
+        return len + 1;
+    }
+    memset(cp, ' ', cpstart);
+    len = 2;                    /* number of hex digits in address */
+    while ((len < 8) && ((unsigned int)a >> (4 * len)))
+        ++len;
+    for (k = 0; k < len; ++k)
+        cp[len - k] = sg_hex_digits[((unsigned int)a >> (4 * k)) & 0xf];
+    k = sg_hex_bytes16(bp, n, cp + bpstart);
+    if (no_ascii) {
+        len = bpstart + k;
+    } else {
+        for (k = 0; k < n; ++k)
+            cp[cpstart + k] = my_isprint(bp[k]) ? bp[k] : '.';
+        len = cpstart + n;
+    }
+    cp[len] = '\n';
+    return len + 1;
+}
+
+/* Formats whole lines of dStrHex() style output from 'str' into 'ob'
+ * starting at offset '*offp' until 'len' bytes are done or ob_len would
+ * be exceeded; the new offset is written back. Returns characters placed. */
+static int
+dStrHexChunk(const uint8_t * str, int len, int * offp, int no_ascii,
+             char * ob, int ob_len)
+{
+    int off = *offp;
+    int n = 0;
+
+    while ((off < len) && ((ob_len - n) >= DSHF_LINE_MAX)) {
+        n += dStrHexLine(str + off, ((len - off) < 16) ? (len - off) : 16,
+                         off, no_ascii, ob + n);
+        off += 16;
     }
-    if ('\0' != b[k + 1])
-        b[k + 1] = '\0';
+    *offp = (off < len) ? off : len;
+    return n;
 }
 
 /* Note the ASCII-hex output goes to stdout. [Most other output from functions
@@ -2719,91 +3319,23 @@ trimTrailingSpaces(char * b)
  * 'no_ascii' allows for 3 output types:
  *     > 0     each line has address then up to 16 ASCII-hex bytes
  *     = 0     in addition, the bytes are listed in ASCII to the right
- *     < 0     only the ASCII-hex bytes are listed (i.e. without address) */
+ *     < 0     only the ASCII-hex bytes are listed (i.e. without address)
+ * Lines are built with a table lookup per byte and handed to 'fp' in
+ * blocks of many lines. */
 static void
 dStrHexFp(const char* str, int len, int no_ascii, FILE * fp)
 {
-    const char * p = str;
-    const char * formatstr;
-    uint8_t c;
-    char buff[82];
-    int a = 0;
-    int bpstart = 5;
-    const int cpstart = 60;
-    int cpos = cpstart;
-    int bpos = bpstart;
-    int i, k, blen;
+    int off = 0;
+    int n;
+    char ob[8192];
 
-    if (len <= 0)
-        return;
-    blen = (int)sizeof(buff);
-    if (0 == no_ascii)  /* address at left and ASCII at right */
-        formatstr = "%.76s\n";
-    else                        /* previously when > 0 str was "%.58s\n" */
-        formatstr = "%s\n";     /* when < 0 str was: "%.48s\n" */
-    memset(buff, ' ', 80);
-    buff[80] = '\0';
-    if (no_ascii < 0) {
-        bpstart = 0;
-        bpos = bpstart;
-        for (k = 0; k < len; k++) {
-            c = *p++;
-            if (bpos == (bpstart + (8 * 3)))
-                bpos++;
-            sg_scnpr(&buff[bpos], blen - bpos, "%.2x", (int)(uint8_t)c);
-            buff[bpos + 2] = ' ';
-            if ((k > 0) && (0 == ((k + 1) % 16))) {
-                trimTrailingSpaces(buff);
-                fprintf(fp, formatstr, buff);
-                bpos = bpstart;
-                memset(buff, ' ', 80);
-            } else
-                bpos += 3;
-        }
-        if (bpos > bpstart) {
-            buff[bpos + 2] = '\0';
-            trimTrailingSpaces(buff);
-            fprintf(fp, "%s\n", buff);
-        }
-        return;
+    while (off < len) {
+        n = dStrHexChunk((const uint8_t *)str, len, &off, no_ascii, ob,
+                         (int)sizeof(ob));
+        if (n > 0)
+            fwrite(ob, 1, n, fp);
     }
-    /* no_ascii>=0, start each line with address (offset) */
-    k = sg_scnpr(buff + 1, blen - 1, "%.2x", a);
-    buff[k + 1] = ' ';
-
-    for (i = 0; i < len; i++) {
-        c = *p++;
-        bpos += 3;
-        if (bpos == (bpstart + (9 * 3)))
-            bpos++;
-        sg_scnpr(&buff[bpos], blen - bpos, "%.2x", (int)(uint8_t)c);
-        buff[bpos + 2] = ' ';
-        if (no_ascii)
-            buff[cpos++] = ' ';
-        else {
-            if (! my_isprint(c))
-                c = '.';
-            buff[cpos++] = c;
-        }
-        if (cpos > (cpstart + 15)) {
-            if (no_ascii)
-                trimTrailingSpaces(buff);
-            fprintf(fp, formatstr, buff);
-            bpos = bpstart;
-            cpos = cpstart;
-            a += 16;
-            memset(buff, ' ', 80);
-            k = sg_scnpr(buff + 1, blen - 1, "%.2x", a);
-            buff[k + 1] = ' ';
-        }
-    }
-    if (cpos > cpstart) {
-        buff[cpos] = '\0';
-        if (no_ascii)
-            trimTrailingSpaces(buff);
-        fprintf(fp, "%s\n", buff);
-    }
-}
+}
 
 void
 dStrHex(const char* str, int len, int no_ascii)
@@ -2818,6 +3350,29 @@ dStrHexErr(const char* str, int len, int no_ascii)
               (sg_warnings_strm ? sg_warnings_strm : stderr));
 }
 
+/* See description in sg_lib.h header file */
+int
+hex2fd(const uint8_t * b_str, int len, int no_ascii, int fd)
+{
+    int n, k, res;
+    int off = 0;
+    char ob[32768];
+
+    while (off < len) {
+        n = dStrHexChunk(b_str, len, &off, no_ascii, ob, (int)sizeof(ob));
+        for (k = 0; k < n; k += res) {
+            res = write(fd, ob + k, n - k);
+            if (res < 0) {
+                if (EINTR == errno)
+                    res = 0;
+                else
+                    return -errno;
+            }
+        }
+    }
+    return 0;
+}
+
 #define DSHS_LINE_BLEN 160
 #define DSHS_BPL 16
 
@@ -2832,12 +3387,11 @@ int
 dStrHexStr(const char * str, int len, const char * leadin, int format,
            int b_len, char * b)
 {
-    uint8_t c;
-    int bpstart, bpos, k, n, prior_ascii_len;
     bool want_ascii;
+    int bpstart, k, j, m, num, lnlen, prior_ascii_len;
+    int n = 0;
+    const uint8_t * bp = (const uint8_t *)str;
     char buff[DSHS_LINE_BLEN + 2];
-    char a[DSHS_BPL + 1];
-    const char * p = str;
 
     if (len <= 0) {
         if (b_len > 0)
@@ -2847,10 +3401,6 @@ dStrHexStr(const char * str, int len, const char * leadin, int format,
     if (b_len <= 0)
         return 0;
     want_ascii = !format;
-    if (want_ascii) {
-        memset(a, ' ', DSHS_BPL);
-        a[DSHS_BPL] = '\0';
-    }
     if (leadin) {
         bpstart = strlen(leadin);
         /* Cap leadin at (DSHS_LINE_BLEN - 70) characters */
@@ -2858,46 +3408,29 @@ dStrHexStr(const char * str, int len, const char * leadin, int format,
             bpstart = DSHS_LINE_BLEN - 70;
     } else
         bpstart = 0;
-    bpos = bpstart;
     prior_ascii_len = bpstart + (DSHS_BPL * 3) + 1;
-    n = 0;
-    memset(buff, ' ', DSHS_LINE_BLEN);
-    buff[DSHS_LINE_BLEN] = '\0';
     if (bpstart > 0)
         memcpy(buff, leadin, bpstart);
-    for (k = 0; k < len; k++) {
-        c = *p++;
-        if (bpos == (bpstart + ((DSHS_BPL / 2) * 3)))
-            bpos++;     /* for extra space in middle of each line's hex */
-        sg_scnpr(buff + bpos, (int)sizeof(buff) - bpos, "%.2x",
-                 (int)(uint8_t)c);
-        buff[bpos + 2] = ' ';
-        if (want_ascii)
-            a[k % DSHS_BPL] = my_isprint(c) ? c : '.';
-        if ((k > 0) && (0 == ((k + 1) % DSHS_BPL))) {
-            trimTrailingSpaces(buff);
-            if (want_ascii) {
-                n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n",
-                              prior_ascii_len, buff, a);
-                memset(a, ' ', DSHS_BPL);
-            } else
-                n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
-            if (n >= (b_len - 1))
-                return n;
-            memset(buff, ' ', DSHS_LINE_BLEN);
-            bpos = bpstart;
-            if (bpstart > 0)
-                memcpy(buff, leadin, bpstart);
-        } else
-            bpos += 3;
-    }
-    if (bpos > bpstart) {
-        trimTrailingSpaces(buff);
-        if (want_ascii)
-            n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n", prior_ascii_len,
-                          buff, a);
-        else
-            n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
+    for (k = 0; k < len; k += DSHS_BPL) {
+        num = ((len - k) < DSHS_BPL) ? (len - k) : DSHS_BPL;
+        lnlen = bpstart + sg_hex_bytes16(bp + k, num, buff + bpstart);
+        if (want_ascii) {
+            memset(buff + lnlen, ' ', prior_ascii_len + 3 - lnlen);
+            lnlen = prior_ascii_len + 3;
+            for (j = 0; j < DSHS_BPL; ++j)
+                buff[lnlen + j] = (j >= num) ? ' ' :
+                                  (my_isprint(bp[k + j]) ? bp[k + j] : '.');
+            lnlen += DSHS_BPL;
+        }
+        buff[lnlen++] = '\n';
+        m = b_len - 1 - n;
+        if (m > lnlen)
+            m = lnlen;
+        memcpy(b + n, buff, m);
+        n += m;
+        b[n] = '\0';
+        if (n >= (b_len - 1))
+            return n;
     }
     return n;
 }
@@ -2937,28 +3470,529 @@ sg_is_big_endian()
                                     the most significant byte */
 }
 
-bool
-sg_all_zeros(const uint8_t * bp, int b_len)
+/* Checks the first SG_ALL_SAME_HEAD bytes one at a time (short fields are
+ * the common case); then if they all equal 'val', compares the buffer with
+ * itself offset by that amount. Since memcmp() in modern C libraries is
+ * vectorized (e.g. SSE2/AVX2 on x86, NEON on Arm, chosen at run time) this
+ * scans longer buffers many bytes per cycle without any intrinsics here. */
+#define SG_ALL_SAME_HEAD 16
+
+static bool
+sg_all_same(const uint8_t * bp, int b_len, uint8_t val)
 {
+    int k, n;
+
     if ((NULL == bp) || (b_len <= 0))
         return false;
-    for (--b_len; b_len >= 0; --b_len) {
-        if (0x0 != bp[b_len])
+    n = (b_len < SG_ALL_SAME_HEAD) ? b_len : SG_ALL_SAME_HEAD;
+    for (k = 0; k < n; ++k) {
+        if (val != bp[k])
             return false;
     }
-    return true;
+    if (b_len <= SG_ALL_SAME_HEAD)
+        return true;
+    return (0 == memcmp(bp, bp + SG_ALL_SAME_HEAD, b_len - SG_ALL_SAME_HEAD));
+}
+
+bool
+sg_all_zeros(const uint8_t * bp, int b_len)
+{
+    return sg_all_same(bp, b_len, 0x0);
 }
 
 bool
 sg_all_ffs(const uint8_t * bp, int b_len)
+{
+    return sg_all_same(bp, b_len, 0xff);
+}
+
+static int
+acron_cmp(const char * s1p, const char * s2p, bool nocase)
+{
+    int c1, c2;
+
+    do {
+        c1 = (uint8_t)*s1p++;
+        c2 = (uint8_t)*s2p++;
+        if (nocase) {
+            c1 = tolower(c1);
+            c2 = tolower(c2);
+        }
+    } while ((c1 == c2) && c1);
+    return c1 - c2;
+}
+
+/* See description in sg_lib.h header file. Insertion sort: it is stable,
+ * run once and the tables are mostly in acronym order already. */
+void
+sg_lib_acron_idx_build(struct sg_lib_acron_idx * ip,
+                       struct sg_lib_acron_ent * ent_arr, const void * tbl,
+                       int num_elems, size_t elem_sz, size_t acron_off,
+                       bool nocase)
+{
+    int k, j, n;
+    const char * ap;
+    struct sg_lib_acron_ent e;
+
+    for (k = 0, n = 0; k < num_elems; ++k) {
+        memcpy(&ap, (const uint8_t *)tbl + (k * elem_sz) + acron_off,
+               sizeof(ap));
+        if (NULL == ap)
+            continue;
+        e.acron = ap;
+        e.ind = k;
+        for (j = n; (j > 0) &&
+                    (acron_cmp(ent_arr[j - 1].acron, ap, nocase) > 0); --j)
+            ent_arr[j] = ent_arr[j - 1];
+        ent_arr[j] = e;
+        ++n;
+    }
+    ip->nocase = nocase;
+    ip->num = n;
+    ip->arr = ent_arr;
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_lib_acron_idx_find(const struct sg_lib_acron_idx * ip, const char * acron)
+{
+    int lo, hi, mid;
+
+    if ((NULL == acron) || (NULL == ip->arr))
+        return -1;
+    for (lo = 0, hi = ip->num; lo < hi; ) {     /* lower bound */
+        mid = lo + ((hi - lo) / 2);
+        if (acron_cmp(ip->arr[mid].acron, acron, ip->nocase) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ((lo < ip->num) && (0 == acron_cmp(ip->arr[lo].acron, acron,
+                                          ip->nocase)))
+        return lo;
+    return -1;
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_first_non_zero_blk(const uint8_t * bp, int blk_sz, int num_blks)
+{
+    int k;
+
+    if ((NULL == bp) || (blk_sz <= 0) || (num_blks <= 0))
+        return 0;
+    for (k = 0; k < num_blks; ++k, bp += blk_sz) {
+        if (! sg_all_same(bp, blk_sz, 0x0))
+            break;
+    }
+    return k;
+}
+
+/* CRC32C (Castagnoli, polynomial 0x1edc6f41, reflected 0x82f63b78) as used
+ * by iSCSI and SCTP, one table entry per byte value. */
+static const uint32_t sg_crc32c_table[256] = {
+    0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4,
+    0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+    0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+    0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+    0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b,
+    0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+    0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54,
+    0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+    0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+    0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+    0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5,
+    0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+    0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45,
+    0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+    0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+    0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+    0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48,
+    0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+    0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687,
+    0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+    0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+    0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+    0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8,
+    0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+    0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096,
+    0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+    0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+    0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+    0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9,
+    0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+    0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36,
+    0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+    0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+    0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+    0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043,
+    0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+    0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3,
+    0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+    0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+    0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+    0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652,
+    0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+    0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d,
+    0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+    0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+    0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+    0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2,
+    0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+    0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530,
+    0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+    0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+    0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+    0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f,
+    0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+    0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90,
+    0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+    0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+    0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+    0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321,
+    0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+    0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81,
+    0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+    0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+    0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+static uint32_t
+sg_crc32c_sw(uint32_t crc, const uint8_t * bp, int b_len)
+{
+    while (b_len-- > 0)
+        crc = sg_crc32c_table[(crc ^ *bp++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+/* SSE4.2 has a CRC32 instruction that uses the Castagnoli polynomial */
+__attribute__((target("sse4.2")))
+static uint32_t
+sg_crc32c_hw(uint32_t crc, const uint8_t * bp, int b_len)
+{
+    uint64_t c = crc;
+    uint64_t v;
+
+    for ( ; (b_len > 0) && ((uintptr_t)bp & 7); --b_len)
+        c = __builtin_ia32_crc32qi((uint32_t)c, *bp++);
+    for ( ; b_len >= 8; b_len -= 8, bp += 8) {
+        memcpy(&v, bp, 8);
+        c = __builtin_ia32_crc32di(c, v);
+    }
+    for ( ; b_len > 0; --b_len)
+        c = __builtin_ia32_crc32qi((uint32_t)c, *bp++);
+    return (uint32_t)c;
+}
+
+static bool
+sg_crc32c_have_hw(void)
+{
+    static int have = -1;       /* benign race: all threads agree */
+
+    if (have < 0)
+        have = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    return have > 0;
+}
+
+#elif defined(__GNUC__) && defined(__aarch64__) && \
+      defined(__ARM_FEATURE_CRC32)
+
+static uint32_t
+sg_crc32c_hw(uint32_t crc, const uint8_t * bp, int b_len)
+{
+    uint64_t v;
+
+    for ( ; (b_len > 0) && ((uintptr_t)bp & 7); --b_len)
+        crc = __crc32cb(crc, *bp++);
+    for ( ; b_len >= 8; b_len -= 8, bp += 8) {
+        memcpy(&v, bp, 8);
+        crc = __crc32cd(crc, v);
+    }
+    for ( ; b_len > 0; --b_len)
+        crc = __crc32cb(crc, *bp++);
+    return crc;
+}
+
+static bool
+sg_crc32c_have_hw(void)
+{
+    return true;        /* compiler told the CRC32 extension is present */
+}
+
+#else
+
+#define sg_crc32c_hw sg_crc32c_sw
+
+static bool
+sg_crc32c_have_hw(void)
+{
+    return false;
+}
+
+#endif
+
+/* See description in sg_lib.h header file */
+uint32_t
+sg_crc32c(uint32_t crc, const uint8_t * bp, int b_len)
 {
     if ((NULL == bp) || (b_len <= 0))
-        return false;
-    for (--b_len; b_len >= 0; --b_len) {
-        if (0xff != bp[b_len])
-            return false;
+        return crc;
+    crc = ~crc;
+    crc = sg_crc32c_have_hw() ? sg_crc32c_hw(crc, bp, b_len) :
+                                sg_crc32c_sw(crc, bp, b_len);
+    return ~crc;
+}
+
+/* T10-DIF CRC16 (polynomial 0x8bb7, not reflected, initial value 0) as
+ * used for the guard tag of SCSI protection information (PI). One table
+ * entry per byte value. */
+static const uint16_t sg_t10_crc16_table[256] = {
+    0x0000, 0x8bb7, 0x9cd9, 0x176e, 0xb205, 0x39b2, 0x2edc, 0xa56b,
+    0xefbd, 0x640a, 0x7364, 0xf8d3, 0x5db8, 0xd60f, 0xc161, 0x4ad6,
+    0x54cd, 0xdf7a, 0xc814, 0x43a3, 0xe6c8, 0x6d7f, 0x7a11, 0xf1a6,
+    0xbb70, 0x30c7, 0x27a9, 0xac1e, 0x0975, 0x82c2, 0x95ac, 0x1e1b,
+    0xa99a, 0x222d, 0x3543, 0xbef4, 0x1b9f, 0x9028, 0x8746, 0x0cf1,
+    0x4627, 0xcd90, 0xdafe, 0x5149, 0xf422, 0x7f95, 0x68fb, 0xe34c,
+    0xfd57, 0x76e0, 0x618e, 0xea39, 0x4f52, 0xc4e5, 0xd38b, 0x583c,
+    0x12ea, 0x995d, 0x8e33, 0x0584, 0xa0ef, 0x2b58, 0x3c36, 0xb781,
+    0xd883, 0x5334, 0x445a, 0xcfed, 0x6a86, 0xe131, 0xf65f, 0x7de8,
+    0x373e, 0xbc89, 0xabe7, 0x2050, 0x853b, 0x0e8c, 0x19e2, 0x9255,
+    0x8c4e, 0x07f9, 0x1097, 0x9b20, 0x3e4b, 0xb5fc, 0xa292, 0x2925,
+    0x63f3, 0xe844, 0xff2a, 0x749d, 0xd1f6, 0x5a41, 0x4d2f, 0xc698,
+    0x7119, 0xfaae, 0xedc0, 0x6677, 0xc31c, 0x48ab, 0x5fc5, 0xd472,
+    0x9ea4, 0x1513, 0x027d, 0x89ca, 0x2ca1, 0xa716, 0xb078, 0x3bcf,
+    0x25d4, 0xae63, 0xb90d, 0x32ba, 0x97d1, 0x1c66, 0x0b08, 0x80bf,
+    0xca69, 0x41de, 0x56b0, 0xdd07, 0x786c, 0xf3db, 0xe4b5, 0x6f02,
+    0x3ab1, 0xb106, 0xa668, 0x2ddf, 0x88b4, 0x0303, 0x146d, 0x9fda,
+    0xd50c, 0x5ebb, 0x49d5, 0xc262, 0x6709, 0xecbe, 0xfbd0, 0x7067,
+    0x6e7c, 0xe5cb, 0xf2a5, 0x7912, 0xdc79, 0x57ce, 0x40a0, 0xcb17,
+    0x81c1, 0x0a76, 0x1d18, 0x96af, 0x33c4, 0xb873, 0xaf1d, 0x24aa,
+    0x932b, 0x189c, 0x0ff2, 0x8445, 0x212e, 0xaa99, 0xbdf7, 0x3640,
+    0x7c96, 0xf721, 0xe04f, 0x6bf8, 0xce93, 0x4524, 0x524a, 0xd9fd,
+    0xc7e6, 0x4c51, 0x5b3f, 0xd088, 0x75e3, 0xfe54, 0xe93a, 0x628d,
+    0x285b, 0xa3ec, 0xb482, 0x3f35, 0x9a5e, 0x11e9, 0x0687, 0x8d30,
+    0xe232, 0x6985, 0x7eeb, 0xf55c, 0x5037, 0xdb80, 0xccee, 0x4759,
+    0x0d8f, 0x8638, 0x9156, 0x1ae1, 0xbf8a, 0x343d, 0x2353, 0xa8e4,
+    0xb6ff, 0x3d48, 0x2a26, 0xa191, 0x04fa, 0x8f4d, 0x9823, 0x1394,
+    0x5942, 0xd2f5, 0xc59b, 0x4e2c, 0xeb47, 0x60f0, 0x779e, 0xfc29,
+    0x4ba8, 0xc01f, 0xd771, 0x5cc6, 0xf9ad, 0x721a, 0x6574, 0xeec3,
+    0xa415, 0x2fa2, 0x38cc, 0xb37b, 0x1610, 0x9da7, 0x8ac9, 0x017e,
+    0x1f65, 0x94d2, 0x83bc, 0x080b, 0xad60, 0x26d7, 0x31b9, 0xba0e,
+    0xf0d8, 0x7b6f, 0x6c01, 0xe7b6, 0x42dd, 0xc96a, 0xde04, 0x55b3,
+};
+
+static uint16_t
+sg_t10_crc16_sw(uint16_t crc, const uint8_t * bp, int b_len)
+{
+    while (b_len-- > 0)
+        crc = (uint16_t)((crc << 8) ^
+                         sg_t10_crc16_table[((crc >> 8) ^ *bp++) & 0xff]);
+    return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+/* Below this length the table method is quicker */
+#define SG_T10_CRC16_HW_MIN 64
+
+/* x^N modulo the CRC polynomial, for folding 16 byte blocks */
+#define SG_T10_K128 0xa010
+#define SG_T10_K192 0x1faa
+#define SG_T10_K512 0x1069
+#define SG_T10_K576 0xdd31
+
+/* Treating a 128 bit block X (first byte most significant) as H.x^64 + L,
+ * X.x^128 is congruent (modulo the polynomial) to H.(x^192 mod P) +
+ * L.(x^128 mod P) which fits in 128 bits again. The high 64 bits of 'k'
+ * hold the former constant and the low 64 bits the latter. */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i
+sg_t10_fold(__m128i x, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11),
+                         _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+/* Uses PCLMULQDQ to fold the buffer, four blocks at a time when long
+ * enough, down to one block which, followed by the tail, is given to the
+ * table method. Expects b_len >= 16. */
+__attribute__((target("pclmul,ssse3")))
+static uint16_t
+sg_t10_crc16_hw(uint16_t crc, const uint8_t * bp, int b_len)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                       11, 12, 13, 14, 15);
+    __m128i x0, x1, x2, x3, k;
+    uint8_t b[16];
+
+#define SG_T10_LD(p) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p)), bswap)
+
+    /* 'crc' continues from an earlier piece by adding to the first bytes */
+    x0 = _mm_xor_si128(SG_T10_LD(bp),
+                       _mm_set_epi64x((int64_t)((uint64_t)crc << 48), 0));
+    bp += 16;
+    b_len -= 16;
+    k = _mm_set_epi64x(SG_T10_K192, SG_T10_K128);
+    if (b_len >= 112) {
+        x1 = SG_T10_LD(bp);
+        x2 = SG_T10_LD(bp + 16);
+        x3 = SG_T10_LD(bp + 32);
+        bp += 48;
+        b_len -= 48;
+        k = _mm_set_epi64x(SG_T10_K576, SG_T10_K512);
+        for ( ; b_len >= 64; b_len -= 64, bp += 64) {
+            x0 = _mm_xor_si128(sg_t10_fold(x0, k), SG_T10_LD(bp));
+            x1 = _mm_xor_si128(sg_t10_fold(x1, k), SG_T10_LD(bp + 16));
+            x2 = _mm_xor_si128(sg_t10_fold(x2, k), SG_T10_LD(bp + 32));
+            x3 = _mm_xor_si128(sg_t10_fold(x3, k), SG_T10_LD(bp + 48));
+        }
+        k = _mm_set_epi64x(SG_T10_K192, SG_T10_K128);
+        x0 = _mm_xor_si128(sg_t10_fold(x0, k), x1);
+        x0 = _mm_xor_si128(sg_t10_fold(x0, k), x2);
+        x0 = _mm_xor_si128(sg_t10_fold(x0, k), x3);
+    }
+    for ( ; b_len >= 16; b_len -= 16, bp += 16)
+        x0 = _mm_xor_si128(sg_t10_fold(x0, k), SG_T10_LD(bp));
+#undef SG_T10_LD
+    _mm_storeu_si128((__m128i *)b, _mm_shuffle_epi8(x0, bswap));
+    crc = sg_t10_crc16_sw(0, b, sizeof(b));
+    return sg_t10_crc16_sw(crc, bp, b_len);
+}
+
+static bool
+sg_t10_crc16_have_hw(void)
+{
+    static int have = -1;       /* benign race: all threads agree */
+    unsigned int a, b, c, d;
+
+    if (have < 0)
+        have = (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_PCLMUL) &&
+                (c & bit_SSSE3)) ? 1 : 0;
+    return have > 0;
+}
+
+#else
+
+#define SG_T10_CRC16_HW_MIN 0
+#define sg_t10_crc16_hw sg_t10_crc16_sw
+
+static bool
+sg_t10_crc16_have_hw(void)
+{
+    return false;
+}
+
+#endif
+
+/* See description in sg_lib.h header file */
+uint16_t
+sg_t10_crc16(uint16_t crc, const uint8_t * bp, int b_len)
+{
+    if ((NULL == bp) || (b_len <= 0))
+        return crc;
+    if ((b_len >= SG_T10_CRC16_HW_MIN) && sg_t10_crc16_have_hw())
+        return sg_t10_crc16_hw(crc, bp, b_len);
+    return sg_t10_crc16_sw(crc, bp, b_len);
+}
+
+/* See description in sg_lib.h header file */
+void
+sg_t10_pi_gen(uint8_t * bp, int blk_sz, int num_blks, uint16_t app_tag,
+              uint32_t ref_tag, int pi_type)
+{
+    int k;
+    uint8_t * pip;
+
+    if ((NULL == bp) || (blk_sz <= 0))
+        return;
+    for (k = 0; k < num_blks; ++k, bp += blk_sz + SG_T10_PI_LEN) {
+        pip = bp + blk_sz;
+        sg_put_unaligned_be16(sg_t10_crc16(0, bp, blk_sz), pip + 0);
+        sg_put_unaligned_be16(app_tag, pip + 2);
+        sg_put_unaligned_be32(ref_tag, pip + 4);
+        if (3 != pi_type)
+            ++ref_tag;
+    }
+}
+
+/* See description in sg_lib.h header file */
+void
+sg_t10_pi_set_ref(uint8_t * bp, int blk_sz, int num_blks, uint32_t ref_tag,
+                  int pi_type)
+{
+    int k;
+
+    if ((NULL == bp) || (blk_sz <= 0))
+        return;
+    for (k = 0; k < num_blks; ++k, bp += blk_sz + SG_T10_PI_LEN) {
+        sg_put_unaligned_be32(ref_tag, bp + blk_sz + 4);
+        if (3 != pi_type)
+            ++ref_tag;
     }
-    return true;
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_t10_pi_chk(const uint8_t * bp, int blk_sz, int num_blks, uint32_t ref_tag,
+              int pi_type, int * bad_blkp)
+{
+    int k;
+    int res = 0;
+    uint32_t rt;
+    const uint8_t * pip;
+
+    if ((NULL == bp) || (blk_sz <= 0))
+        num_blks = 0;
+    for (k = 0; k < num_blks; ++k, bp += blk_sz + SG_T10_PI_LEN) {
+        pip = bp + blk_sz;
+        rt = sg_get_unaligned_be32(pip + 4);
+        /* escape: no checks on this block */
+        if ((0xffff == sg_get_unaligned_be16(pip + 2)) &&
+            ((3 != pi_type) || (0xffffffff == rt)))
+            ;
+        else if (sg_get_unaligned_be16(pip + 0) !=
+                 sg_t10_crc16(0, bp, blk_sz)) {
+            res = 1;
+            break;
+        } else if ((3 != pi_type) && (rt != ref_tag)) {
+            res = 3;
+            break;
+        }
+        if (3 != pi_type)
+            ++ref_tag;
+    }
+    if (bad_blkp)
+        *bad_blkp = k;
+    return res;
+}
+
+/* See description in sg_lib.h header file */
+void
+sg_t10_pi_expand(uint8_t * bp, int blk_sz, int num_blks)
+{
+    int k;
+
+    if ((NULL == bp) || (blk_sz <= 0))
+        return;
+    for (k = num_blks - 1; k > 0; --k)       /* first block stays put */
+        memmove(bp + (size_t)k * (blk_sz + SG_T10_PI_LEN),
+                bp + (size_t)k * blk_sz, blk_sz);
+}
+
+/* See description in sg_lib.h header file */
+void
+sg_t10_pi_strip(uint8_t * bp, int blk_sz, int num_blks)
+{
+    int k;
+
+    if ((NULL == bp) || (blk_sz <= 0))
+        return;
+    for (k = 1; k < num_blks; ++k)
+        memmove(bp + (size_t)k * blk_sz,
+                bp + (size_t)k * (blk_sz + SG_T10_PI_LEN), blk_sz);
 }
 
 static uint16_t
@@ -3406,27 +4440,17 @@ sg_get_llnum_nomult(const char * buf)
     return (1 == res) ? num : -1;
 }
 
-/* Read ASCII hex bytes or binary from fname (a file named '-' taken as
- * stdin). If reading ASCII hex then there should be either one entry per
- * line or a comma, space or tab separated list of bytes. If no_space is
- * set then a string of ACSII hex digits is expected, 2 per byte. Everything
- * from and including a '#' on a line is ignored. Returns 0 if ok, or an
- * error code. If the error code is SG_LIB_LBA_OUT_OF_RANGE then mp_arr
- * would be exceeded and both mp_arr and mp_arr_len are written to. */
+/* See description in sg_lib.h header file */
 int
 sg_f2hex_arr(const char * fname, bool as_binary, bool no_space,
              uint8_t * mp_arr, int * mp_arr_len, int max_arr_len)
 {
-    bool has_stdin, split_line;
-    int fn_len, in_len, k, j, m, fd, err;
+    bool has_stdin;
+    int fn_len, k, m, fd, err;
     int off = 0;
     int ret = 0;
-    unsigned int h;
-    const char * lcp;
-    FILE * fp;
     struct stat a_stat;
-    char line[512];
-    char carry_over[4];
+    struct sg_f2hex_strm * fhp;
 
     if ((NULL == fname) || (NULL == mp_arr) || (NULL == mp_arr_len))
         return SG_LIB_LOGIC_ERROR;
@@ -3481,138 +4505,559 @@ bin_fini:
         return ret;
     }
 
-    /* So read the file as ASCII hex */
-    if (has_stdin)
-        fp = stdin;
+    /* So decode the file as ASCII hex, with the sg_f2hex_next() tokenizer
+     * so both accept (and reject) the same input */
+    fhp = sg_f2hex_open(fname, false, no_space, &ret);
+    if (NULL == fhp)
+        return ret;
+    ret = sg_f2hex_next(fhp, mp_arr, max_arr_len, &off);
+    if ((0 == ret) && (off >= max_arr_len)) {
+        uint8_t b[1];
+
+        ret = sg_f2hex_next(fhp, b, 1, &k);
+        if ((0 == ret) && (k > 0)) {
+            pr2serr("%s: array length exceeded\n", __func__);
+            ret = SG_LIB_LBA_OUT_OF_RANGE;
+        }
+    }
+    if ((0 == ret) || (SG_LIB_LBA_OUT_OF_RANGE == ret))
+        *mp_arr_len = off;
+    sg_f2hex_close(fhp);
+    return ret;
+}
+
+/* State for sg_f2hex_next(). Regular files are mmap()-ed (where available)
+ * and decoded in place; stdin, pipes and files that cannot be mapped are
+ * read() through 'rbuf'. */
+#define SG_F2HEX_RBUF_SZ (64 * 1024)
+
+struct sg_f2hex_strm {
+    bool as_binary;
+    bool no_space;
+    bool own_fd;
+    bool eof;           /* no more input (bytes may still be in 'rbuf') */
+    bool in_comment;    /* skipping from '#' to end of line */
+    int fd;
+    int ndig;           /* hex digits in current token */
+    int line;           /* origin 1, for error reports */
+    int col;
+    unsigned int val;   /* value of current token */
+    const uint8_t * map;
+    int64_t map_len;
+    int64_t pos;        /* of next input byte in 'map' */
+    int rlen;
+    int rpos;
+    uint8_t rbuf[SG_F2HEX_RBUF_SZ];
+};
+
+/* Hex digit value plus 1 for each character, 0 for non hex digits */
+static const uint8_t sg_hexval_p1[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+/* See description in sg_lib.h header file */
+struct sg_f2hex_strm *
+sg_f2hex_open(const char * fname, bool as_binary, bool no_space, int * errp)
+{
+    int err;
+    struct sg_f2hex_strm * fhp;
+#ifndef SG_LIB_MINGW
+    struct stat a_stat;
+#endif
+
+    if (errp)
+        *errp = 0;
+    if ((NULL == fname) || ('\0' == fname[0])) {
+        if (errp)
+            *errp = SG_LIB_SYNTAX_ERROR;
+        return NULL;
+    }
+    fhp = (struct sg_f2hex_strm *)calloc(1, sizeof(*fhp));
+    if (NULL == fhp) {
+        if (errp)
+            *errp = sg_convert_errno(ENOMEM);
+        return NULL;
+    }
+    fhp->as_binary = as_binary;
+    fhp->no_space = no_space;
+    fhp->line = 1;
+    if (0 == strcmp(fname, "-"))
+        fhp->fd = STDIN_FILENO;
     else {
-        fp = fopen(fname, "r");
-        if (NULL == fp) {
+        fhp->fd = open(fname, O_RDONLY);
+        if (fhp->fd < 0) {
             err = errno;
-            pr2serr("Unable to open %s for reading: %s\n", fname,
-                    safe_strerror(err));
-            ret = sg_convert_errno(err);
-            goto fini;
+            pr2serr("unable to open %s: %s\n", fname, safe_strerror(err));
+            free(fhp);
+            if (errp)
+                *errp = sg_convert_errno(err);
+            return NULL;
         }
+        fhp->own_fd = true;
     }
+    if (as_binary)
+        sg_set_binary_mode(fhp->fd);
+#ifndef SG_LIB_MINGW
+    if ((0 == fstat(fhp->fd, &a_stat)) && S_ISREG(a_stat.st_mode) &&
+        (a_stat.st_size > 0) && ((uint64_t)a_stat.st_size <= SIZE_MAX)) {
+        void * vp = mmap(NULL, (size_t)a_stat.st_size, PROT_READ, MAP_SHARED,
+                         fhp->fd, 0);
+
+        if (MAP_FAILED != vp) {
+#ifdef MADV_SEQUENTIAL
+            madvise(vp, (size_t)a_stat.st_size, MADV_SEQUENTIAL);
+#endif
+            fhp->map = (const uint8_t *)vp;
+            fhp->map_len = a_stat.st_size;
+        }
+    }
+#endif
+    return fhp;
+}
 
-    carry_over[0] = 0;
-    for (j = 0; j < 512; ++j) {
-        if (NULL == fgets(line, sizeof(line), fp))
-            break;
-        in_len = strlen(line);
-        if (in_len > 0) {
-            if ('\n' == line[in_len - 1]) {
-                --in_len;
-                line[in_len] = '\0';
-                split_line = false;
-            } else
-                split_line = true;
+void
+sg_f2hex_close(struct sg_f2hex_strm * fhp)
+{
+    if (NULL == fhp)
+        return;
+#ifndef SG_LIB_MINGW
+    if (fhp->map)
+        munmap((void *)fhp->map, (size_t)fhp->map_len);
+#endif
+    if (fhp->own_fd)
+        close(fhp->fd);
+    free(fhp);
+}
+
+/* Points '*bpp' at the next unconsumed input and returns how many bytes
+ * are there; 0 at end of input, negated errno on error. */
+static int64_t
+sg_f2hex_input(struct sg_f2hex_strm * fhp, const uint8_t ** bpp)
+{
+    int res;
+
+    if (fhp->map) {
+        *bpp = fhp->map + fhp->pos;
+        return fhp->map_len - fhp->pos;
+    }
+    if ((fhp->rpos >= fhp->rlen) && (! fhp->eof)) {
+        do {
+            res = read(fhp->fd, fhp->rbuf, SG_F2HEX_RBUF_SZ);
+        } while ((res < 0) && (EINTR == errno));
+        if (res < 0)
+            return -errno;
+        if (0 == res)
+            fhp->eof = true;
+        fhp->rlen = res;
+        fhp->rpos = 0;
+    }
+    *bpp = fhp->rbuf + fhp->rpos;
+    return fhp->rlen - fhp->rpos;
+}
+
+static void
+sg_f2hex_consume(struct sg_f2hex_strm * fhp, int64_t n)
+{
+    if (fhp->map)
+        fhp->pos += n;
+    else
+        fhp->rpos += (int)n;
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_f2hex_next(struct sg_f2hex_strm * fhp, uint8_t * bp, int max_len,
+              int * blen_p)
+{
+    int c, d;
+    int n = 0;
+    int64_t k, avail;
+    const uint8_t * ip = NULL;
+
+    if (blen_p)
+        *blen_p = 0;
+    if ((NULL == fhp) || (NULL == bp) || (max_len < 1) || (NULL == blen_p))
+        return SG_LIB_LOGIC_ERROR;
+    while (n < max_len) {
+        avail = sg_f2hex_input(fhp, &ip);
+        if (avail < 0) {
+            pr2serr("%s: read error: %s\n", __func__,
+                    safe_strerror((int)-avail));
+            return sg_convert_errno((int)-avail);
         }
-        if (in_len < 1) {
-            carry_over[0] = 0;
+        if (0 == avail)
+            break;
+        if (fhp->as_binary) {
+            k = ((max_len - n) < avail) ? (max_len - n) : avail;
+            memcpy(bp + n, ip, k);
+            n += (int)k;
+            sg_f2hex_consume(fhp, k);
             continue;
         }
-        if (carry_over[0]) {
-            if (isxdigit(line[0])) {
-                carry_over[1] = line[0];
-                carry_over[2] = '\0';
-                if (1 == sscanf(carry_over, "%4x", &h))
-                    mp_arr[off - 1] = h;       /* back up and overwrite */
-                else {
-                    pr2serr("%s: carry_over error ['%s'] around line %d\n",
-                            __func__, carry_over, j + 1);
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
+        for (k = 0; (k < avail) && (n < max_len); ++k) {
+            c = ip[k];
+            ++fhp->col;
+            if ('\n' == c) {
+                ++fhp->line;
+                fhp->col = 0;
+                fhp->in_comment = false;
+            } else if (fhp->in_comment)
+                continue;
+            d = sg_hexval_p1[c];
+            if (d) {
+                fhp->val = (fhp->val << 4) + (d - 1);
+                ++fhp->ndig;
+                if (fhp->no_space) {
+                    if (2 == fhp->ndig) {
+                        bp[n++] = fhp->val;
+                        fhp->val = 0;
+                        fhp->ndig = 0;
+                    }
+                } else if (fhp->val > 0xff) {
+                    pr2serr("%s: hex number larger than 0xff in line %d, pos "
+                            "%d\n", __func__, fhp->line, fhp->col);
+                    return SG_LIB_SYNTAX_ERROR;
                 }
-                lcp = line + 1;
-                --in_len;
-            } else
-                lcp = line;
-            carry_over[0] = 0;
-        } else
-            lcp = line;
+                continue;
+            }
+            if ((' ' == c) || ('\t' == c) || (',' == c) || ('\r' == c) ||
+                ('\n' == c) || ('#' == c)) {
+                if ('#' == c)
+                    fhp->in_comment = true;
+                if (fhp->ndig && (! fhp->no_space)) {
+                    bp[n++] = fhp->val;
+                    fhp->val = 0;
+                    fhp->ndig = 0;
+                }
+                continue;
+            }
+            pr2serr("%s: syntax error at line %d, pos %d\n", __func__,
+                    fhp->line, fhp->col);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        sg_f2hex_consume(fhp, k);
+    }
+    if ((n < max_len) && fhp->ndig) {   /* at end of input */
+        if (fhp->no_space) {
+            pr2serr("%s: odd number of hex digits\n", __func__);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        bp[n++] = fhp->val;
+        fhp->ndig = 0;
+    }
+    *blen_p = n;
+    return 0;
+}
 
-        m = strspn(lcp, " \t");
-        if (m == in_len)
-            continue;
-        lcp += m;
-        in_len -= m;
-        if ('#' == *lcp)
+/* Start of logical block extent set (struct sg_lba_set) functions */
+
+void
+sg_lba_set_init(struct sg_lba_set * lsp)
+{
+    if (lsp)
+        memset(lsp, 0, sizeof(*lsp));
+}
+
+void
+sg_lba_set_free(struct sg_lba_set * lsp)
+{
+    if (NULL == lsp)
+        return;
+    free(lsp->ext);
+    memset(lsp, 0, sizeof(*lsp));
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_lba_set_add(struct sg_lba_set * lsp, uint64_t lba, uint64_t num)
+{
+    int n;
+    struct sg_lba_extent * ep;
+
+    if (NULL == lsp)
+        return SG_LIB_LOGIC_ERROR;
+    if (num > (UINT64_MAX - lba))
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    if (lsp->num >= lsp->max) {
+        if (lsp->max >= (INT32_MAX / 2))
+            return sg_convert_errno(ENOMEM);
+        n = lsp->max ? (2 * lsp->max) : 64;
+        ep = (struct sg_lba_extent *)realloc(lsp->ext, n * sizeof(*ep));
+        if (NULL == ep)
+            return sg_convert_errno(ENOMEM);
+        lsp->ext = ep;
+        lsp->max = n;
+    }
+    ep = lsp->ext + lsp->num++;
+    ep->lba = lba;
+    ep->num = num;
+    lsp->sorted = false;
+    return 0;
+}
+
+static int
+lba_ext_cmp(const void * left, const void * right)
+{
+    const struct sg_lba_extent * l = (const struct sg_lba_extent *)left;
+    const struct sg_lba_extent * r = (const struct sg_lba_extent *)right;
+
+    if (l->lba == r->lba)
+        return 0;
+    return (l->lba < r->lba) ? -1 : 1;
+}
+
+/* See description in sg_lib.h header file */
+uint64_t
+sg_lba_set_coalesce(struct sg_lba_set * lsp)
+{
+    int k, n;
+    uint64_t end, w_end;
+    uint64_t dup = 0;
+    struct sg_lba_extent * rp;
+    struct sg_lba_extent * wp;
+
+    if ((NULL == lsp) || lsp->sorted)
+        return 0;
+    lsp->sorted = true;
+    if (lsp->num < 1)
+        return 0;
+    qsort(lsp->ext, lsp->num, sizeof(*rp), lba_ext_cmp);
+    for (k = 0, n = 0, wp = NULL, rp = lsp->ext; k < lsp->num; ++k, ++rp) {
+        if (0 == rp->num)
             continue;
-        k = strspn(lcp, "0123456789aAbBcCdDeEfF ,\t");
-        if ((k < in_len) && ('#' != lcp[k]) && ('\r' != lcp[k])) {
-            pr2serr("%s: syntax error at line %d, pos %d\n", __func__,
-                    j + 1, m + k + 1);
-            ret = SG_LIB_SYNTAX_ERROR;
-            goto fini;
+        end = rp->lba + rp->num;
+        if (wp && (rp->lba <= (w_end = wp->lba + wp->num))) {
+            /* overlaps or is adjacent to the one before */
+            dup += ((end < w_end) ? end : w_end) - rp->lba;
+            if (end > w_end)
+                wp->num = end - wp->lba;
+        } else {
+            wp = lsp->ext + n++;
+            *wp = *rp;
         }
-        if (no_space) {
-            for (k = 0; isxdigit(*lcp) && isxdigit(*(lcp + 1));
-                 ++k, lcp += 2) {
-                if (1 != sscanf(lcp, "%2x", &h)) {
-                    pr2serr("%s: bad hex number in line %d, pos %d\n",
-                            __func__, j + 1, (int)(lcp - line + 1));
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-                if ((off + k) >= max_arr_len) {
-                    pr2serr("%s: array length exceeded\n", __func__);
-                    *mp_arr_len = max_arr_len;
-                    ret = SG_LIB_LBA_OUT_OF_RANGE;
-                    goto fini;
-                }
-                mp_arr[off + k] = h;
+    }
+    lsp->num = n;
+    return dup;
+}
+
+/* See description in sg_lib.h header file */
+uint64_t
+sg_lba_set_blocks(const struct sg_lba_set * lsp)
+{
+    int k;
+    uint64_t sum = 0;
+
+    if (lsp) {
+        for (k = 0; k < lsp->num; ++k)
+            sum += lsp->ext[k].num;
+    }
+    return sum;
+}
+
+/* Decodes the next number in the comma, space or tab separated list at
+ * *cpp, moving *cpp past it. Returns 1 with the number in *valp, 0 at the
+ * end of the list (or a '#'), else -1. */
+static int
+lba_set_next_num(const char ** cpp, int flags, int64_t * valp)
+{
+    int n;
+    const char * cp = *cpp;
+    char b[32];
+
+    cp += strspn(cp, " ,\t\r\n");
+    if (('\0' == *cp) || ('#' == *cp)) {
+        *cpp = cp;
+        return 0;
+    }
+    n = strcspn(cp, " ,\t\r\n#");
+    if (n >= (int)sizeof(b))
+        return -1;
+    memcpy(b, cp, n);
+    b[n] = '\0';
+    *valp = (SG_LBA_SET_NOMULT & flags) ? sg_get_llnum_nomult(b) :
+                                          sg_get_llnum(b);
+    if (*valp < 0)
+        return -1;
+    *cpp = cp + n;
+    return 1;
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_lba_set_parse(struct sg_lba_set * lsp, const char * lbas,
+                 const char * nums, int flags)
+{
+    int res, ret;
+    int64_t lba, num;
+    const char * cp = lbas;
+    const char * np = nums;
+
+    if ((NULL == lsp) || (NULL == lbas))
+        return SG_LIB_LOGIC_ERROR;
+    while (true) {
+        res = lba_set_next_num(&cp, flags, &lba);
+        if (res < 0) {
+            pr2ws("%s: bad LBA at pos %d\n", __func__,
+                  (int)(cp - lbas + 1));
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        num = 1;
+        if (nums) {
+            ret = lba_set_next_num(&np, flags, &num);
+            if (ret < 0) {
+                pr2ws("%s: bad number of blocks at pos %d\n", __func__,
+                      (int)(np - nums + 1));
+                return SG_LIB_SYNTAX_ERROR;
             }
-            if (isxdigit(*lcp) && (! isxdigit(*(lcp + 1))))
-                carry_over[0] = *lcp;
-            off += k;
-        } else {
-            for (k = 0; k < 1024; ++k) {
-                if (1 == sscanf(lcp, "%10x", &h)) {
-                    if (h > 0xff) {
-                        pr2serr("%s: hex number larger than 0xff in line "
-                                "%d, pos %d\n", __func__, j + 1,
-                                (int)(lcp - line + 1));
-                        ret = SG_LIB_SYNTAX_ERROR;
-                        goto fini;
-                    }
-                    if (split_line && (1 == strlen(lcp))) {
-                        /* single trailing hex digit might be a split pair */
-                        carry_over[0] = *lcp;
-                    }
-                    if ((off + k) >= max_arr_len) {
-                        pr2serr("%s: array length exceeded\n", __func__);
-                        ret = SG_LIB_LBA_OUT_OF_RANGE;
-                        *mp_arr_len = max_arr_len;
-                        goto fini;
-                    }
-                    mp_arr[off + k] = h;
-                    lcp = strpbrk(lcp, " ,\t");
-                    if (NULL == lcp)
-                        break;
-                    lcp += strspn(lcp, " ,\t");
-                    if ('\0' == *lcp)
-                        break;
-                } else {
-                    if (('#' == *lcp) || ('\r' == *lcp)) {
-                        --k;
-                        break;
-                    }
-                    pr2serr("%s: error in line %d, at pos %d\n", __func__,
-                            j + 1, (int)(lcp - line + 1));
+            if ((res > 0) != (ret > 0)) {
+                pr2ws("%s: need the same number of LBAs and numbers of "
+                      "blocks\n", __func__);
+                return SG_LIB_CONTRADICT;
+            }
+        } else if ((res > 0) && (SG_LBA_SET_PAIRS & flags)) {
+            ret = lba_set_next_num(&cp, flags, &num);
+            if (ret <= 0) {
+                pr2ws("%s: expect LBA,NUM pairs, bad or missing NUM at pos "
+                      "%d\n", __func__, (int)(cp - lbas + 1));
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        }
+        if (0 == res)
+            break;
+        ret = sg_lba_set_add(lsp, (uint64_t)lba, (uint64_t)num);
+        if (ret) {
+            pr2ws("%s: unable to add LBA 0x%" PRIx64 " for %" PRId64
+                  " blocks\n", __func__, (uint64_t)lba, num);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/* Reads the next line from fp, of any length, into *bufp which is grown
+ * (realloc()-ed) as needed; *buf_lenp is its allocated length. The line
+ * ends with its '\n', if any. Returns the length of the line, 0 at EOF or
+ * -1 if out of memory. */
+static int
+lba_set_get_line(FILE * fp, char ** bufp, int * buf_lenp)
+{
+    int n = 0;
+    char * cp;
+
+    for (;;) {
+        if ((*buf_lenp - n) < 2) {
+            if (*buf_lenp >= (INT32_MAX / 2))
+                return -1;
+            cp = (char *)realloc(*bufp, *buf_lenp ? (2 * *buf_lenp) : 1024);
+            if (NULL == cp)
+                return -1;
+            *bufp = cp;
+            *buf_lenp = *buf_lenp ? (2 * *buf_lenp) : 1024;
+        }
+        if (NULL == fgets(*bufp + n, *buf_lenp - n, fp))
+            return n;
+        n += strlen(*bufp + n);
+        if ((n > 0) && ('\n' == (*bufp)[n - 1]))
+            return n;
+    }
+}
+
+/* See description in sg_lib.h header file */
+int
+sg_lba_set_read_file(struct sg_lba_set * lsp, const char * fname, int flags)
+{
+    bool has_stdin, have_lba;
+    int res, lnum, err, n;
+    int ret = 0;
+    int line_len = 0;
+    int64_t ll;
+    int64_t lba = 0;
+    int64_t num;
+    const char * cp;
+    const char * fn;
+    char * line = NULL;
+    FILE * fp;
+
+    if ((NULL == lsp) || (NULL == fname))
+        return SG_LIB_LOGIC_ERROR;
+    has_stdin = (('-' == fname[0]) && ('\0' == fname[1]));
+    fn = has_stdin ? "stdin" : fname;
+    if (has_stdin)
+        fp = stdin;
+    else if (NULL == (fp = fopen(fname, "r"))) {
+        err = errno;
+        pr2ws("%s: unable to open %s: %s\n", __func__, fname,
+              safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    for (lnum = 1, have_lba = false;
+         (n = lba_set_get_line(fp, &line, &line_len)) > 0; ++lnum) {
+        cp = line;
+        if (0 == (flags & (SG_LBA_SET_LBAS | SG_LBA_SET_PAIRS))) {
+            /* LBA[,NUM] then anything, e.g. 'sg_verify --bad=' output */
+            res = lba_set_next_num(&cp, flags, &lba);
+            if (0 == res)
+                continue;
+            if (res < 0) {
+                pr2ws("%s: bad LBA at line %d of %s\n", __func__, lnum, fn);
+                ret = SG_LIB_SYNTAX_ERROR;
+                break;
+            }
+            num = 1;
+            if (',' == *cp) {
+                ++cp;
+                if ((lba_set_next_num(&cp, flags, &num) <= 0) ||
+                    (num < 1)) {
+                    pr2ws("%s: bad number of blocks at line %d of %s\n",
+                          __func__, lnum, fn);
                     ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
+                    break;
                 }
             }
-            off += (k + 1);
+            if ((ret = sg_lba_set_add(lsp, (uint64_t)lba, (uint64_t)num))) {
+                pr2ws("%s: unable to add extent at line %d of %s\n",
+                      __func__, lnum, fn);
+                break;
+            }
+            continue;
+        }
+        while ((res = lba_set_next_num(&cp, flags, &ll)) > 0) {
+            if (SG_LBA_SET_LBAS & flags)
+                ret = sg_lba_set_add(lsp, (uint64_t)ll, 1);
+            else if (have_lba)          /* PAIRS, this is the NUM */
+                ret = sg_lba_set_add(lsp, (uint64_t)lba, (uint64_t)ll);
+            else
+                lba = ll;
+            have_lba = ! have_lba;
+            if (ret)
+                break;
+        }
+        if (ret) {
+            pr2ws("%s: unable to add extent at line %d of %s\n", __func__,
+                  lnum, fn);
+            break;
+        }
+        if (res < 0) {
+            pr2ws("%s: bad number at line %d, pos %d of %s\n", __func__,
+                  lnum, (int)(cp - line + 1), fn);
+            ret = SG_LIB_SYNTAX_ERROR;
+            break;
         }
     }
-    *mp_arr_len = off;
-    if (stdin != fp)
-        fclose(fp);
-    return 0;
-fini:
-    if (stdin != fp)
+    if ((0 == ret) && (n < 0)) {
+        pr2ws("%s: out of memory at line %d of %s\n", __func__, lnum, fn);
+        ret = sg_convert_errno(ENOMEM);
+    }
+    if ((0 == ret) && have_lba && (SG_LBA_SET_PAIRS & flags)) {
+        pr2ws("%s: expect LBA,NUM pairs but decoded odd number from %s\n",
+              __func__, fn);
+        ret = SG_LIB_SYNTAX_ERROR;
+    }
+    free(line);
+    if (! has_stdin)
         fclose(fp);
     return ret;
 }
@@ -3649,6 +5094,81 @@ sg_ata_get_chars(const uint16_t * word_arr, int start_word,
     return op - ochars;
 }
 
+/* Copies num_words of ATA string starting at start_word into 'ochars'
+ * without the leading and trailing space padding. */
+static void
+ata_trimmed_str(const uint8_t * resp, int start_word, int num_words,
+                char * ochars)
+{
+    int k, n;
+
+    n = sg_ata_get_chars((const uint16_t *)resp, start_word, num_words,
+                         sg_is_big_endian(), ochars);
+    while ((n > 0) && (' ' == ochars[n - 1]))
+        --n;
+    ochars[n] = '\0';
+    for (k = 0; ' ' == ochars[k]; ++k)
+        ;
+    if (k > 0)
+        memmove(ochars, ochars + k, n - k + 1);
+}
+
+int
+sg_ata_ident_decode(const uint8_t * resp, int resp_len,
+                    struct sg_ata_ident_t * aip)
+{
+    uint16_t w;
+
+    memset(aip, 0, sizeof(*aip));
+    if (resp_len < 512)
+        return -1;
+    aip->atapi = !!(0x8000 & sg_get_unaligned_le16(resp + (0 * 2)));
+    ata_trimmed_str(resp, 10, 10, aip->serial);
+    ata_trimmed_str(resp, 23, 4, aip->fw_rev);
+    ata_trimmed_str(resp, 27, 20, aip->model);
+    aip->sanitize = !!(0x1000 & sg_get_unaligned_le16(resp + (59 * 2)));
+    w = sg_get_unaligned_le16(resp + (76 * 2));
+    if ((0 != w) && (0xffff != w)) {    /* SATA capabilities are valid */
+        aip->ncq = !!(0x100 & w);
+        if (0x8 & w)
+            aip->sata_gen = 3;
+        else if (0x4 & w)
+            aip->sata_gen = 2;
+        else if (0x2 & w)
+            aip->sata_gen = 1;
+    }
+    w = sg_get_unaligned_le16(resp + (82 * 2));
+    if (0xffff != w) {
+        aip->smart = !!(0x1 & w);
+        aip->security = !!(0x2 & w);
+    }
+    aip->lba48 = !!(0x400 & sg_get_unaligned_le16(resp + (83 * 2)));
+    if (aip->lba48)
+        aip->num_lbs = sg_get_unaligned_le64(resp + (100 * 2));
+    else
+        aip->num_lbs = sg_get_unaligned_le32(resp + (60 * 2));
+    aip->lb_sz = 512;
+    aip->pb_sz = 512;
+    w = sg_get_unaligned_le16(resp + (106 * 2));
+    if (0x4000 == (0xc000 & w)) {       /* word 106 is valid */
+        if (0x1000 & w)     /* words 117 and 118: words per logical block */
+            aip->lb_sz = 2 * sg_get_unaligned_le32(resp + (117 * 2));
+        if (0x2000 & w)
+            aip->pb_sz = aip->lb_sz << (0xf & w);
+        else
+            aip->pb_sz = aip->lb_sz;
+    }
+    aip->wwn = ((uint64_t)sg_get_unaligned_le16(resp + (108 * 2)) << 48) |
+               ((uint64_t)sg_get_unaligned_le16(resp + (109 * 2)) << 32) |
+               ((uint64_t)sg_get_unaligned_le16(resp + (110 * 2)) << 16) |
+               sg_get_unaligned_le16(resp + (111 * 2));
+    aip->trim = !!(0x1 & sg_get_unaligned_le16(resp + (169 * 2)));
+    w = sg_get_unaligned_le16(resp + (217 * 2));
+    if ((1 == w) || ((w >= 0x401) && (w < 0xffff)))
+        aip->rotation = w;
+    return 0;
+}
+
 int
 pr2serr(const char * fmt, ...)
 {
@@ -3656,7 +5176,11 @@ pr2serr(const char * fmt, ...)
     int n;
 
     va_start(args, fmt);
-    n = vfprintf(stderr, fmt, args);
+#ifdef SG_LIB_LOG_RING
+    n = sg_log_ring_vput(fmt, args);
+    if (n < 0)
+#endif
+        n = vfprintf(stderr, fmt, args);
     va_end(args);
     return n;
 }
@@ -3758,6 +5282,303 @@ sg_memalign(uint32_t num_bytes, uint32_t align_to, uint8_t ** buff_to_free,
 #endif
 }
 
+/* Pool of large buffers handed out by sg_hugebuf_get(). Released buffers
+ * stay mapped (and locked, if they were) for reuse by later requests. */
+struct sg_hugebuf_t {
+    struct sg_hugebuf_t * next;
+    uint8_t * bp;               /* aligned start given to caller */
+    uint8_t * free_bp;          /* from sg_memalign() or NULL if mmap-ed */
+    size_t len;                 /* usable (and mapped) length */
+    bool in_use;
+    bool locked;                /* mlock()-ed */
+    bool hugetlb;               /* else may be THP backed */
+};
+
+#define SG_HUGEBUF_2M ((size_t)2 * 1024 * 1024)
+#define SG_HUGEBUF_1G ((size_t)1024 * 1024 * 1024)
+
+static struct sg_hugebuf_t * sg_hugebuf_head;
+#if defined(__GNUC__)
+static char sg_hugebuf_lck;
+
+#define SG_HUGEBUF_LOCK() \
+    while (__atomic_test_and_set(&sg_hugebuf_lck, __ATOMIC_ACQUIRE)) { ; }
+#define SG_HUGEBUF_UNLOCK() \
+    __atomic_clear(&sg_hugebuf_lck, __ATOMIC_RELEASE)
+#else
+#define SG_HUGEBUF_LOCK()
+#define SG_HUGEBUF_UNLOCK()
+#endif
+
+#ifdef SG_LIB_LINUX
+/* Returns mapping of 'len' bytes aligned to 'align' (a power of 2) made
+ * from a larger anonymous mapping with the excess trimmed; NULL if none. */
+static uint8_t *
+sg_hugebuf_mmap_aligned(size_t len, size_t align)
+{
+    size_t head;
+    uint8_t * bp;
+    void * vp = mmap(NULL, len + align, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (MAP_FAILED == vp)
+        return NULL;
+    bp = (uint8_t *)vp;
+    head = (align - ((sg_uintptr_t)bp & (align - 1))) & (align - 1);
+    if (head > 0)
+        munmap(bp, head);
+    if (align > head)
+        munmap(bp + head + len, align - head);
+    return bp + head;
+}
+
+/* Tries, in order: 1 GiB hugetlb pages (for 1 GiB or more), the default
+ * hugetlb page size, then an anonymous mapping aligned to 2 MiB with
+ * MADV_HUGEPAGE (transparent huge pages). Updates *lenp and *hugetlbp. */
+static uint8_t *
+sg_hugebuf_mmap(size_t * lenp, bool * hugetlbp)
+{
+    const int fl = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+    size_t len = ((*lenp + SG_HUGEBUF_2M - 1) / SG_HUGEBUF_2M) *
+                 SG_HUGEBUF_2M;
+    uint8_t * bp;
+    void * vp = MAP_FAILED;
+
+#if defined(MAP_HUGE_SHIFT)
+    if (*lenp >= SG_HUGEBUF_1G) {
+        size_t glen = ((*lenp + SG_HUGEBUF_1G - 1) / SG_HUGEBUF_1G) *
+                      SG_HUGEBUF_1G;
+
+        vp = mmap(NULL, glen, PROT_READ | PROT_WRITE,
+                  fl | (30 << MAP_HUGE_SHIFT), -1, 0);
+        if (MAP_FAILED != vp)
+            len = glen;
+    }
+#endif
+    if (MAP_FAILED == vp)
+        vp = mmap(NULL, len, PROT_READ | PROT_WRITE, fl, -1, 0);
+    if (MAP_FAILED != vp) {
+        *hugetlbp = true;
+        *lenp = len;
+        return (uint8_t *)vp;
+    }
+    bp = sg_hugebuf_mmap_aligned(len, SG_HUGEBUF_2M);
+    if (bp) {
+#ifdef MADV_HUGEPAGE
+        madvise(bp, len, MADV_HUGEPAGE);
+#endif
+        *lenp = len;
+    }
+    return bp;
+}
+#endif
+
+/* See description in sg_lib.h header file */
+uint8_t *
+sg_hugebuf_get(uint32_t num_bytes, bool lock, bool vb)
+{
+    size_t psz;
+    struct sg_hugebuf_t * hbp;
+    struct sg_hugebuf_t * best = NULL;
+
+    psz = sg_get_page_size();
+    if (0 == num_bytes)
+        num_bytes = psz;
+    SG_HUGEBUF_LOCK();
+    for (hbp = sg_hugebuf_head; hbp; hbp = hbp->next) {    /* smallest fit */
+        if ((! hbp->in_use) && (hbp->len >= num_bytes) &&
+            ((! lock) || hbp->locked) &&
+            ((NULL == best) || (hbp->len < best->len)))
+            best = hbp;
+    }
+    if (best)
+        best->in_use = true;
+    SG_HUGEBUF_UNLOCK();
+    if (best) {
+        if (vb)
+            pr2ws("%s: reuse %p, len=%u\n", __func__, (void *)best->bp,
+                  (unsigned int)best->len);
+        return best->bp;
+    }
+
+    hbp = (struct sg_hugebuf_t *)calloc(1, sizeof(*hbp));
+    if (NULL == hbp) {
+        pr2ws("%s: out of memory\n", __func__);
+        return NULL;
+    }
+    hbp->in_use = true;
+    hbp->len = ((num_bytes + psz - 1) / psz) * psz;
+#ifdef SG_LIB_LINUX
+    if (num_bytes >= (SG_HUGEBUF_2M / 2))
+        hbp->bp = sg_hugebuf_mmap(&hbp->len, &hbp->hugetlb);
+    if (NULL == hbp->bp)
+        hbp->bp = sg_hugebuf_mmap_aligned(hbp->len, psz);
+#endif
+    if (NULL == hbp->bp) {
+        hbp->bp = sg_memalign(hbp->len, 0, &hbp->free_bp, false);
+        if (NULL == hbp->bp) {
+            free(hbp);
+            return NULL;
+        }
+    }
+#ifdef SG_LIB_LINUX
+    if (lock) {
+        if (0 == mlock(hbp->bp, hbp->len))
+            hbp->locked = true;
+        else if (vb)
+            pr2ws("%s: mlock(%u bytes): %s\n", __func__,
+                  (unsigned int)hbp->len, safe_strerror(errno));
+    }
+#endif
+    if (vb)
+        pr2ws("%s: new %p, len=%u%s%s\n", __func__, (void *)hbp->bp,
+              (unsigned int)hbp->len, (hbp->hugetlb ? ", hugetlb" : ""),
+              (hbp->locked ? ", locked" : ""));
+    SG_HUGEBUF_LOCK();
+    hbp->next = sg_hugebuf_head;
+    sg_hugebuf_head = hbp;
+    SG_HUGEBUF_UNLOCK();
+    return hbp->bp;
+}
+
+/* See description in sg_lib.h header file */
+void
+sg_hugebuf_put(uint8_t * bp)
+{
+    struct sg_hugebuf_t * hbp;
+
+    if (NULL == bp)
+        return;
+    SG_HUGEBUF_LOCK();
+    for (hbp = sg_hugebuf_head; hbp; hbp = hbp->next) {
+        if (bp == hbp->bp) {
+            hbp->in_use = false;
+            break;
+        }
+    }
+    SG_HUGEBUF_UNLOCK();
+    if (NULL == hbp)
+        pr2ws("%s: %p not from sg_hugebuf_get()\n", __func__, (void *)bp);
+}
+
+/* See description in sg_lib.h header file */
+void
+sg_hugebuf_pool_free(void)
+{
+    struct sg_hugebuf_t * hbp;
+    struct sg_hugebuf_t ** prevp;
+
+    SG_HUGEBUF_LOCK();
+    for (prevp = &sg_hugebuf_head; (hbp = *prevp); ) {
+        if (hbp->in_use) {
+            prevp = &hbp->next;
+            continue;
+        }
+        *prevp = hbp->next;
+        if (hbp->free_bp)
+            free(hbp->free_bp);
+#ifdef SG_LIB_LINUX
+        else
+            munmap(hbp->bp, hbp->len);  /* also unlocks */
+#endif
+        free(hbp);
+    }
+    SG_HUGEBUF_UNLOCK();
+}
+
+/* READ and WRITE opcodes for 6, 10, 12 and 16 byte cdbs */
+static const uint8_t rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
+static const uint8_t wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
+
+int
+sg_build_rw_cdb(uint8_t * cdbp, int cdb_sz, uint32_t blocks,
+                int64_t start_block, bool write_true, bool fua, bool dpo,
+                const char * leadin)
+{
+    int sz_ind;
+
+    if (NULL == leadin)
+        leadin = "";
+    memset(cdbp, 0, cdb_sz);
+    if (dpo)
+        cdbp[1] |= 0x10;
+    if (fua)
+        cdbp[1] |= 0x8;
+    switch (cdb_sz) {
+    case 6:
+        sz_ind = 0;
+        cdbp[0] = write_true ? wr_opcode[sz_ind] : rd_opcode[sz_ind];
+        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
+        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
+        if (blocks > 256) {
+            pr2ws("%sfor 6 byte commands, maximum number of blocks is "
+                  "256\n", leadin);
+            return 1;
+        }
+        if ((start_block + blocks - 1) & (~0x1fffff)) {
+            pr2ws("%sfor 6 byte commands, can't address blocks beyond "
+                  "%d\n", leadin, 0x1fffff);
+            return 1;
+        }
+        if (dpo || fua) {
+            pr2ws("%sfor 6 byte commands, neither dpo nor fua bits "
+                  "supported\n", leadin);
+            return 1;
+        }
+        break;
+    case 10:
+        sz_ind = 1;
+        cdbp[0] = write_true ? wr_opcode[sz_ind] : rd_opcode[sz_ind];
+        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
+        sg_put_unaligned_be16((uint16_t)blocks, cdbp + 7);
+        if (blocks & (~0xffff)) {
+            pr2ws("%sfor 10 byte commands, maximum number of blocks is "
+                  "%d\n", leadin, 0xffff);
+            return 1;
+        }
+        break;
+    case 12:
+        sz_ind = 2;
+        cdbp[0] = write_true ? wr_opcode[sz_ind] : rd_opcode[sz_ind];
+        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
+        sg_put_unaligned_be32(blocks, cdbp + 6);
+        break;
+    case 16:
+        sz_ind = 3;
+        cdbp[0] = write_true ? wr_opcode[sz_ind] : rd_opcode[sz_ind];
+        sg_put_unaligned_be64((uint64_t)start_block, cdbp + 2);
+        sg_put_unaligned_be32(blocks, cdbp + 10);
+        break;
+    default:
+        pr2ws("%sexpected cdb size of 6, 10, 12, or 16 but got %d\n",
+              leadin, cdb_sz);
+        return 1;
+    }
+    return 0;
+}
+
+int
+sg_rw_opcode(int cdb_sz, bool write_true)
+{
+    int sz_ind;
+
+    switch (cdb_sz) {
+    case 6:
+        sz_ind = 0;
+        break;
+    case 12:
+        sz_ind = 2;
+        break;
+    case 16:
+        sz_ind = 3;
+        break;
+    default:
+        sz_ind = 1;
+        break;
+    }
+    return write_true ? wr_opcode[sz_ind] : rd_opcode[sz_ind];
+}
+
 /* If byte_count is 0 or less then the OS page size is used as denominator.
  * Returns true  if the remainder of ((unsigned)pointer % byte_count) is 0,
  * else returns false. */
@@ -9,10 +9,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -21,8 +23,15 @@
 #include "config.h"
 #endif
 
+#if defined(HAVE_CLOCK_GETTIME)
+#include <time.h>
+#elif defined(HAVE_GETTIMEOFDAY)
+#include <sys/time.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_pt.h"
+#include "sg_pt_null.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 #include "sg_pr2serr.h"
@@ -31,7 +40,7 @@
 #include "sg_pt_nvme.h"
 #endif
 
-static const char * scsi_pt_version_str = "3.12 20190612";
+static const char * scsi_pt_version_str = "3.16 20261014";
 
 
 const char *
@@ -46,6 +55,1000 @@ sg_pt_version()
     return scsi_pt_version_str;
 }
 
+uint32_t
+sg_pt_timeout_ms(int timeout_secs, uint32_t def_ms)
+{
+    if (timeout_secs < 0)
+        return (uint32_t)(-(int64_t)timeout_secs);
+    if (0 == timeout_secs)
+        return def_ms;
+    if ((uint32_t)timeout_secs > (UINT32_MAX / 1000))
+        return UINT32_MAX;
+    return (uint32_t)timeout_secs * 1000;
+}
+
+/* Latency histograms. Up to SG_PT_LAT_MAX (dev_fd, opcode) pairs are held,
+ * each allocated on first use and installed with a compare-and-swap so
+ * that sg_pt_lat_record() needs no lock. The bucket index of a duration
+ * 'v' (in nanoseconds) is 'v' itself when less than SG_PT_LAT_SUB,
+ * otherwise it is formed from the position of the top set bit and the
+ * SG_PT_LAT_SUB_BITS bits that follow it. */
+#define SG_PT_LAT_SUB_BITS 3
+#define SG_PT_LAT_SUB (1 << SG_PT_LAT_SUB_BITS)
+#define SG_PT_LAT_BUCKETS ((64 - SG_PT_LAT_SUB_BITS + 1) * SG_PT_LAT_SUB)
+#define SG_PT_LAT_MAX 128
+
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && \
+    (__GCC_ATOMIC_LLONG_LOCK_FREE == 2)
+#define SG_PT_LAT_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SG_PT_LAT_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define SG_PT_LAT_CAS(p, op, v) __atomic_compare_exchange_n((p), (op), (v), \
+                                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else   /* accurate only when a single thread issues commands */
+#define SG_PT_LAT_LOAD(p) (*(p))
+#define SG_PT_LAT_ADD(p, v) (*(p) += (v))
+#define SG_PT_LAT_CAS(p, op, v) ((*(p) == *(op)) ? ((*(p) = (v)), true) : \
+                                                   ((*(op) = *(p)), false))
+#endif
+
+struct sg_pt_lat_hist {
+    int dev_fd;
+    int opcode;
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t bucket[SG_PT_LAT_BUCKETS];
+};
+
+static struct sg_pt_lat_hist * sg_pt_lat_arr[SG_PT_LAT_MAX];
+static int sg_pt_lat_state = -1;  /* -1: check environment, 0: off, 1: on */
+
+bool
+sg_pt_lat_enable(bool enable)
+{
+    bool prev = sg_pt_lat_is_enabled();
+
+    sg_pt_lat_state = enable ? 1 : 0;
+    return prev;
+}
+
+bool
+sg_pt_lat_is_enabled(void)
+{
+    if (sg_pt_lat_state < 0)
+        sg_pt_lat_state = getenv("SG3_UTILS_PT_LATENCY") ? 1 : 0;
+    return !! sg_pt_lat_state;
+}
+
+uint64_t
+sg_pt_lat_now_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+        return 0;
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0)
+        return 0;
+    return ((uint64_t)tv.tv_sec * 1000000000) + (tv.tv_usec * 1000);
+#else
+    return 0;
+#endif
+}
+
+static int
+sg_pt_lat_bucket(uint64_t v)
+{
+    int e;
+
+    if (v < SG_PT_LAT_SUB)
+        return (int)v;
+    for (e = 63; 0 == (v & ((uint64_t)1 << e)); --e)
+        ;
+    return ((e - SG_PT_LAT_SUB_BITS + 1) << SG_PT_LAT_SUB_BITS) +
+           (int)((v >> (e - SG_PT_LAT_SUB_BITS)) & (SG_PT_LAT_SUB - 1));
+}
+
+/* Returns a value near the middle of the range held by bucket 'k' */
+static uint64_t
+sg_pt_lat_bucket_mid(int k)
+{
+    int e;
+    uint64_t lo;
+
+    if (k < SG_PT_LAT_SUB)
+        return k;
+    e = (k >> SG_PT_LAT_SUB_BITS) + SG_PT_LAT_SUB_BITS - 1;
+    lo = (uint64_t)(SG_PT_LAT_SUB + (k & (SG_PT_LAT_SUB - 1))) <<
+         (e - SG_PT_LAT_SUB_BITS);
+    return lo + (((uint64_t)1 << (e - SG_PT_LAT_SUB_BITS)) >> 1);
+}
+
+static struct sg_pt_lat_hist *
+sg_pt_lat_find(int dev_fd, int opcode, bool create)
+{
+    int k;
+    struct sg_pt_lat_hist * hp;
+    struct sg_pt_lat_hist * n_hp = NULL;
+
+    for (k = 0; k < SG_PT_LAT_MAX; ++k) {
+        hp = SG_PT_LAT_LOAD(sg_pt_lat_arr + k);
+        if (NULL == hp) {
+            if (! create)
+                break;
+            if (NULL == n_hp) {
+                n_hp = (struct sg_pt_lat_hist *)calloc(1, sizeof(*n_hp));
+                if (NULL == n_hp)
+                    return NULL;
+                n_hp->dev_fd = dev_fd;
+                n_hp->opcode = opcode;
+                n_hp->min_ns = UINT64_MAX;
+            }
+            if (SG_PT_LAT_CAS(sg_pt_lat_arr + k, &hp, n_hp))
+                return n_hp;
+            /* another thread filled this slot, hp now points to its entry */
+        }
+        if ((hp->dev_fd == dev_fd) && (hp->opcode == opcode)) {
+            if (n_hp)
+                free(n_hp);
+            return hp;
+        }
+    }
+    if (n_hp)
+        free(n_hp);
+    return NULL;        /* table full (or not found) */
+}
+
+void
+sg_pt_lat_record(int dev_fd, int opcode, uint64_t dur_ns)
+{
+    uint64_t v;
+    struct sg_pt_lat_hist * hp;
+
+    if (! sg_pt_lat_is_enabled())
+        return;
+    hp = sg_pt_lat_find(dev_fd, opcode, true);
+    if (NULL == hp)
+        return;
+    SG_PT_LAT_ADD(&hp->bucket[sg_pt_lat_bucket(dur_ns)], 1);
+    SG_PT_LAT_ADD(&hp->sum_ns, dur_ns);
+    v = SG_PT_LAT_LOAD(&hp->min_ns);
+    while ((dur_ns < v) && (! SG_PT_LAT_CAS(&hp->min_ns, &v, dur_ns)))
+        ;
+    v = SG_PT_LAT_LOAD(&hp->max_ns);
+    while ((dur_ns > v) && (! SG_PT_LAT_CAS(&hp->max_ns, &v, dur_ns)))
+        ;
+    SG_PT_LAT_ADD(&hp->count, 1);
+}
+
+/* Sums the histograms of (dev_fd, opcode) into *ahp, or of every dev_fd
+ * with that opcode when dev_fd is negative. Returns the number of commands
+ * found. */
+static uint64_t
+sg_pt_lat_collect(int dev_fd, int opcode, struct sg_pt_lat_hist * ahp)
+{
+    int k, j;
+    uint64_t v;
+    const struct sg_pt_lat_hist * hp;
+
+    memset(ahp, 0, sizeof(*ahp));
+    ahp->dev_fd = dev_fd;
+    ahp->opcode = opcode;
+    ahp->min_ns = UINT64_MAX;
+    for (k = 0; k < SG_PT_LAT_MAX; ++k) {
+        hp = SG_PT_LAT_LOAD(sg_pt_lat_arr + k);
+        if (NULL == hp)
+            break;
+        if ((hp->opcode != opcode) || ((dev_fd >= 0) &&
+                                       (hp->dev_fd != dev_fd)))
+            continue;
+        for (j = 0; j < SG_PT_LAT_BUCKETS; ++j) {
+            v = SG_PT_LAT_LOAD(&hp->bucket[j]);
+            ahp->bucket[j] += v;
+            ahp->count += v;
+        }
+        ahp->sum_ns += SG_PT_LAT_LOAD(&hp->sum_ns);
+        v = SG_PT_LAT_LOAD(&hp->min_ns);
+        if (v < ahp->min_ns)
+            ahp->min_ns = v;
+        v = SG_PT_LAT_LOAD(&hp->max_ns);
+        if (v > ahp->max_ns)
+            ahp->max_ns = v;
+        if (dev_fd >= 0)
+            break;
+    }
+    return ahp->count;
+}
+
+int
+sg_pt_lat_get(int dev_fd, int opcode, struct sg_pt_lat_summary * sp)
+{
+    int k, j;
+    uint64_t cum, n;
+    uint64_t rank[3];
+    uint64_t * outp[3];
+    struct sg_pt_lat_hist * hp;
+    static const int per_10k[3] = {5000, 9900, 9990};
+
+    hp = (struct sg_pt_lat_hist *)malloc(sizeof(*hp));
+    if (NULL == hp)
+        return -1;
+    n = sg_pt_lat_collect(dev_fd, opcode, hp);
+    if (0 == n) {
+        free(hp);
+        return -1;
+    }
+    memset(sp, 0, sizeof(*sp));
+    sp->count = n;
+    sp->min_ns = hp->min_ns;
+    sp->max_ns = hp->max_ns;
+    sp->mean_ns = hp->sum_ns / n;
+    outp[0] = &sp->p50_ns;
+    outp[1] = &sp->p99_ns;
+    outp[2] = &sp->p999_ns;
+    for (j = 0; j < 3; ++j) {
+        rank[j] = ((n * per_10k[j]) + 9999) / 10000;
+        if (0 == rank[j])
+            rank[j] = 1;
+    }
+    for (k = 0, j = 0, cum = 0; (k < SG_PT_LAT_BUCKETS) && (j < 3); ++k) {
+        cum += hp->bucket[k];
+        for ( ; (j < 3) && (cum >= rank[j]); ++j) {
+            *outp[j] = sg_pt_lat_bucket_mid(k);
+            if (*outp[j] < sp->min_ns)
+                *outp[j] = sp->min_ns;
+            if (*outp[j] > sp->max_ns)
+                *outp[j] = sp->max_ns;
+        }
+    }
+    free(hp);
+    return 0;
+}
+
+int
+sg_pt_lat_hist_str(int dev_fd, int opcode, int blen, char * b)
+{
+    int k, j, e, n, bar;
+    uint64_t cnt, cum, lo, hi, most;
+    struct sg_pt_lat_hist * hp;
+    uint64_t pow2[64];
+    char bars[41];
+
+    if ((NULL == b) || (blen < 1))
+        return 0;
+    b[0] = '\0';
+    hp = (struct sg_pt_lat_hist *)malloc(sizeof(*hp));
+    if (NULL == hp)
+        return 0;
+    if (0 == sg_pt_lat_collect(dev_fd, opcode, hp)) {
+        free(hp);
+        return 0;
+    }
+    /* coarsen to one row per power of 2 */
+    memset(pow2, 0, sizeof(pow2));
+    for (k = 0; k < SG_PT_LAT_BUCKETS; ++k) {
+        if (0 == hp->bucket[k])
+            continue;
+        if (k < SG_PT_LAT_SUB)
+            e = (k < 2) ? 0 : (k < 4) ? 1 : 2;
+        else
+            e = (k >> SG_PT_LAT_SUB_BITS) + SG_PT_LAT_SUB_BITS - 1;
+        pow2[e] += hp->bucket[k];
+    }
+    for (e = 0, most = 1; e < 64; ++e) {
+        if (pow2[e] > most)
+            most = pow2[e];
+    }
+    n = sg_scnpr(b, blen, "  %12s %12s %12s %7s %7s\n", "from (us)",
+                 "to (us)", "count", "%", "cum %");
+    for (e = 0, cum = 0; (e < 64) && (cum < hp->count); ++e) {
+        cnt = pow2[e];
+        if ((0 == cnt) && (0 == cum))
+            continue;
+        cum += cnt;
+        lo = (e > 0) ? ((uint64_t)1 << e) : 0;
+        hi = (uint64_t)1 << (e + 1);
+        bar = (int)((cnt * (sizeof(bars) - 1)) / most);
+        for (j = 0; j < bar; ++j)
+            bars[j] = '#';
+        bars[j] = '\0';
+        n += sg_scnpr(b + n, blen - n, "  %12.3f %12.3f %12" PRIu64
+                      " %7.3f %7.3f%s%s\n", lo / 1000.0, hi / 1000.0, cnt,
+                      (100.0 * cnt) / hp->count, (100.0 * cum) / hp->count,
+                      (bar > 0) ? " " : "", bars);
+    }
+    free(hp);
+    return n;
+}
+
+int
+sg_pt_lat_report(int blen, char * b)
+{
+    int k, n;
+    const struct sg_pt_lat_hist * hp;
+    struct sg_pt_lat_summary ls;
+    char nm[40];
+
+    if ((NULL == b) || (blen < 1))
+        return 0;
+    b[0] = '\0';
+    n = sg_scnpr(b, blen, "Latency (microseconds):\n  %-4s  %-24s %10s %10s "
+                 "%10s %10s %10s %10s\n", "fd", "command", "count", "min",
+                 "p50", "p99", "p99.9", "max");
+    for (k = 0; k < SG_PT_LAT_MAX; ++k) {
+        hp = SG_PT_LAT_LOAD(sg_pt_lat_arr + k);
+        if (NULL == hp)
+            break;
+        if (sg_pt_lat_get(hp->dev_fd, hp->opcode, &ls))
+            continue;
+        if (hp->opcode > 0xff)      /* NVMe command */
+            sg_get_nvme_opcode_name(hp->opcode & 0xff, true, sizeof(nm), nm);
+        else
+            sg_get_opcode_name((uint8_t)hp->opcode, 0, sizeof(nm), nm);
+        n += sg_scnpr(b + n, blen - n, "  %-4d  %-24.24s %10" PRIu64
+                      " %10.1f %10.1f %10.1f %10.1f %10.1f\n", hp->dev_fd, nm,
+                      ls.count, ls.min_ns / 1000.0, ls.p50_ns / 1000.0,
+                      ls.p99_ns / 1000.0, ls.p999_ns / 1000.0,
+                      ls.max_ns / 1000.0);
+    }
+    return n;
+}
+
+/* Not safe to call while other threads may be recording */
+void
+sg_pt_lat_reset(void)
+{
+    int k;
+
+    for (k = 0; k < SG_PT_LAT_MAX; ++k) {
+        if (sg_pt_lat_arr[k]) {
+            free(sg_pt_lat_arr[k]);
+            sg_pt_lat_arr[k] = NULL;
+        }
+    }
+}
+
+/* Command trace. Records are built in a local buffer then written with a
+ * single fwrite() call; stdio locks the stream for each call so records
+ * from different threads are not interleaved. The state is claimed with a
+ * compare-and-swap so only one thread acts on the environment variable. */
+#define SG_PT_TRACE_VERSION 1
+#define SG_PT_TRACE_BUFF_LEN (1024 * 1024)
+
+static int sg_pt_trace_state = -1; /* -1: check env, 0: off, 1: on, 2: busy */
+static FILE * sg_pt_trace_fp;
+static char * sg_pt_trace_buff;
+static uint64_t sg_pt_trace_start_ns;
+static bool sg_pt_trace_atexit;
+
+static int
+sg_pt_trace_open_fp(const char * fname)
+{
+    int err;
+    uint8_t hdr[SG_PT_TRACE_HDR_LEN];
+
+    sg_pt_trace_fp = fopen(fname, "wb");
+    if (NULL == sg_pt_trace_fp)
+        return errno ? -errno : -EIO;
+    sg_pt_trace_buff = (char *)malloc(SG_PT_TRACE_BUFF_LEN);
+    if (sg_pt_trace_buff)
+        setvbuf(sg_pt_trace_fp, sg_pt_trace_buff, _IOFBF,
+                SG_PT_TRACE_BUFF_LEN);
+    memcpy(hdr, SG_PT_TRACE_MAGIC, 8);
+    sg_put_unaligned_le32(SG_PT_TRACE_VERSION, hdr + 8);
+    sg_put_unaligned_le32(SG_PT_TRACE_REC_LEN, hdr + 12);
+    if (1 != fwrite(hdr, sizeof(hdr), 1, sg_pt_trace_fp)) {
+        err = errno ? -errno : -EIO;
+        fclose(sg_pt_trace_fp);
+        sg_pt_trace_fp = NULL;
+        free(sg_pt_trace_buff);
+        sg_pt_trace_buff = NULL;
+        return err;
+    }
+    sg_pt_trace_start_ns = sg_pt_lat_now_ns();
+    if (! sg_pt_trace_atexit) {
+        sg_pt_trace_atexit = true;
+        atexit(sg_pt_trace_close);
+    }
+    return 0;
+}
+
+int
+sg_pt_trace_open(const char * fname)
+{
+    int res;
+
+    if ((NULL == fname) || ('\0' == fname[0]))
+        return -EINVAL;
+    sg_pt_trace_close();
+    res = sg_pt_trace_open_fp(fname);
+    sg_pt_trace_state = (0 == res) ? 1 : 0;
+    return res;
+}
+
+/* Not safe to call while other threads may be recording */
+void
+sg_pt_trace_close(void)
+{
+    if (sg_pt_trace_state < 0)  /* environment not checked: leave it */
+        return;
+    sg_pt_trace_state = 0;
+    if (sg_pt_trace_fp) {
+        fclose(sg_pt_trace_fp);
+        sg_pt_trace_fp = NULL;
+    }
+    if (sg_pt_trace_buff) {
+        free(sg_pt_trace_buff);
+        sg_pt_trace_buff = NULL;
+    }
+}
+
+bool
+sg_pt_trace_is_enabled(void)
+{
+    int s = SG_PT_LAT_LOAD(&sg_pt_trace_state);
+
+    if (s < 0) {
+        if (SG_PT_LAT_CAS(&sg_pt_trace_state, &s, 2)) {
+            const char * cp = getenv("SG3_UTILS_PT_TRACE");
+
+            s = (cp && cp[0] && (0 == sg_pt_trace_open_fp(cp))) ? 1 : 0;
+            sg_pt_trace_state = s;
+        }
+    }
+    return 1 == s;
+}
+
+void
+sg_pt_trace_record(int dev_fd, const uint8_t * cdbp, int cdb_len,
+                   int din_len, int dout_len, int flags, uint64_t start_ns,
+                   uint64_t dur_ns, int status, const uint8_t * sbp,
+                   int sb_len)
+{
+    int len;
+    FILE * fp;
+    struct sg_scsi_sense_hdr ssh;
+    uint8_t b[SG_PT_TRACE_REC_LEN + SG_PT_TRACE_MAX_CDB_LEN];
+
+    if ((! sg_pt_trace_is_enabled()) || (NULL == cdbp) || (cdb_len < 1) ||
+        (cdb_len > SG_PT_TRACE_MAX_CDB_LEN))
+        return;
+    fp = sg_pt_trace_fp;
+    if (NULL == fp)
+        return;
+    len = SG_PT_TRACE_REC_LEN + cdb_len;
+    memset(b, 0, SG_PT_TRACE_REC_LEN);
+    sg_put_unaligned_le16(len, b + 0);
+    b[2] = (uint8_t)flags;
+    if (sbp && (sb_len > 0) && sg_scsi_normalize_sense(sbp, sb_len, &ssh)) {
+        b[4] = ssh.sense_key;
+        b[5] = ssh.asc;
+        b[6] = ssh.ascq;
+    }
+    sg_put_unaligned_le32((uint32_t)dev_fd, b + 8);
+    sg_put_unaligned_le32((uint32_t)din_len, b + 12);
+    sg_put_unaligned_le32((uint32_t)dout_len, b + 16);
+    sg_put_unaligned_le32((uint32_t)status, b + 20);
+    sg_put_unaligned_le64((start_ns > sg_pt_trace_start_ns) ?
+                          start_ns - sg_pt_trace_start_ns : 0, b + 24);
+    sg_put_unaligned_le64(dur_ns, b + 32);
+    memcpy(b + SG_PT_TRACE_REC_LEN, cdbp, cdb_len);
+    fwrite(b, len, 1, fp);
+}
+
+int
+sg_pt_trace_check_hdr(const uint8_t * bp, int blen)
+{
+    if ((NULL == bp) || (blen < SG_PT_TRACE_HDR_LEN) ||
+        memcmp(bp, SG_PT_TRACE_MAGIC, 8) ||
+        (SG_PT_TRACE_VERSION != sg_get_unaligned_le32(bp + 8)) ||
+        (SG_PT_TRACE_REC_LEN != sg_get_unaligned_le32(bp + 12)))
+        return -1;
+    return 0;
+}
+
+int
+sg_pt_trace_decode(const uint8_t * bp, int blen, struct sg_pt_trace_rec * rp)
+{
+    int len;
+
+    if (blen < 2)
+        return 0;
+    len = sg_get_unaligned_le16(bp + 0);
+    if ((len <= SG_PT_TRACE_REC_LEN) ||
+        (len > (SG_PT_TRACE_REC_LEN + SG_PT_TRACE_MAX_CDB_LEN)))
+        return -1;
+    if (blen < len)
+        return 0;
+    rp->cdb_len = len - SG_PT_TRACE_REC_LEN;
+    rp->flags = bp[2];
+    rp->sense_key = bp[4];
+    rp->asc = bp[5];
+    rp->ascq = bp[6];
+    rp->dev_fd = (int)sg_get_unaligned_le32(bp + 8);
+    rp->din_len = (int)sg_get_unaligned_le32(bp + 12);
+    rp->dout_len = (int)sg_get_unaligned_le32(bp + 16);
+    rp->status = (int)sg_get_unaligned_le32(bp + 20);
+    rp->start_ns = sg_get_unaligned_le64(bp + 24);
+    rp->dur_ns = sg_get_unaligned_le64(bp + 32);
+    memcpy(rp->cdb, bp + SG_PT_TRACE_REC_LEN, rp->cdb_len);
+    return len;
+}
+
+/* AIMD queue depth controller. Additive increase: once 'depth' good
+ * completions in a row have been seen (roughly one round trip of the
+ * current window) with the smoothed latency at or under target, depth is
+ * bumped by one. Multiplicative decrease: BUSY, TASK SET FULL or the
+ * smoothed latency going over target halves depth. After a decrease,
+ * further decreases are held off until the commands issued under the old
+ * window have completed since they are likely to see the same congestion. */
+void
+sg_pt_qdepth_init(struct sg_pt_qdepth * qdp, int min_depth, int max_depth,
+                  uint64_t target_ns)
+{
+    if (NULL == qdp)
+        return;
+    memset(qdp, 0, sizeof(*qdp));
+    if (min_depth < 1)
+        min_depth = 1;
+    if (max_depth < min_depth)
+        max_depth = min_depth;
+    qdp->min_depth = min_depth;
+    qdp->max_depth = max_depth;
+    qdp->depth = min_depth;
+    qdp->target_ns = target_ns;
+}
+
+static void
+sg_pt_qdepth_decrease(struct sg_pt_qdepth * qdp)
+{
+    int d = qdp->depth / 2;
+
+    qdp->good = 0;
+    if ((qdp->hold > 0) || (qdp->depth <= qdp->min_depth))
+        return;
+    qdp->hold = qdp->depth;
+    qdp->depth = (d < qdp->min_depth) ? qdp->min_depth : d;
+    ++qdp->decreases;
+}
+
+int
+sg_pt_qdepth_update(struct sg_pt_qdepth * qdp, int scsi_status,
+                    uint64_t lat_ns)
+{
+    if (NULL == qdp)
+        return 1;
+    if (qdp->hold > 0)
+        --qdp->hold;
+    switch (scsi_status & 0xfe) {
+    case SAM_STAT_BUSY:
+        ++qdp->busy_count;
+        sg_pt_qdepth_decrease(qdp);
+        return qdp->depth;
+    case SAM_STAT_TASK_SET_FULL:
+        ++qdp->ts_full_count;
+        sg_pt_qdepth_decrease(qdp);
+        return qdp->depth;
+    case SAM_STAT_GOOD:
+    case SAM_STAT_CONDITION_MET:
+        break;
+    default:    /* errors say nothing about congestion */
+        return qdp->depth;
+    }
+    if (lat_ns > 0) {   /* EWMA with weight 1/8 */
+        if (0 == qdp->ewma_ns)
+            qdp->ewma_ns = lat_ns;
+        else if (lat_ns > qdp->ewma_ns)
+            qdp->ewma_ns += (lat_ns - qdp->ewma_ns) / 8;
+        else
+            qdp->ewma_ns -= (qdp->ewma_ns - lat_ns) / 8;
+    }
+    if ((qdp->target_ns > 0) && (qdp->ewma_ns > qdp->target_ns)) {
+        sg_pt_qdepth_decrease(qdp);
+        return qdp->depth;
+    }
+    if (++qdp->good >= qdp->depth) {
+        qdp->good = 0;
+        if (qdp->depth < qdp->max_depth) {
+            ++qdp->depth;
+            ++qdp->increases;
+        }
+    }
+    return qdp->depth;
+}
+
+int
+sg_pt_qdepth_update_pt(struct sg_pt_qdepth * qdp,
+                       const struct sg_pt_base * objp, uint64_t lat_ns)
+{
+    if (get_scsi_pt_transport_err(objp) || get_scsi_pt_os_err(objp))
+        return qdp ? qdp->depth : 1;
+    return sg_pt_qdepth_update(qdp, get_scsi_pt_status_response(objp),
+                               lat_ns);
+}
+
+/* Token buckets hold at most 1/8 second's worth, so an idle period does
+ * not allow a long burst afterwards. A command larger than that is still
+ * allowed, it puts the bucket into debt that later callers wait off. */
+#define SG_PT_RATE_BURST_DIV 8
+#define SG_PT_RATE_MIN_SCALE (1.0 / 64)
+#define SG_PT_RATE_STEP (1.0 / 16)
+#define SG_PT_RATE_ADJ_NS 100000000ULL  /* 100 ms between scale changes */
+
+void
+sg_pt_rate_init(struct sg_pt_rate * rp, uint64_t bytes_ps, uint64_t iops,
+                uint64_t target_ns)
+{
+    if (NULL == rp)
+        return;
+    memset(rp, 0, sizeof(*rp));
+    rp->bytes_ps = bytes_ps;
+    rp->iops = iops;
+    rp->target_ns = target_ns;
+    rp->scale = 1.0;
+    rp->byte_tokens = (double)bytes_ps / SG_PT_RATE_BURST_DIV;
+    rp->cmd_tokens = (double)iops / SG_PT_RATE_BURST_DIV;
+    if ((iops > 0) && (rp->cmd_tokens < 1.0))
+        rp->cmd_tokens = 1.0;
+    rp->last_ns = sg_pt_lat_now_ns();
+}
+
+/* Adds the tokens earned in el_ns at rate (per second) to *tokp, takes
+ * 'need' and returns the nanoseconds until the bucket is out of debt */
+static uint64_t
+sg_pt_rate_bucket(double * tokp, double rate, uint64_t el_ns, double need)
+{
+    double cap = rate / SG_PT_RATE_BURST_DIV;
+
+    if (cap < 1.0)
+        cap = 1.0;
+    *tokp += (rate * (double)el_ns) / 1e9;
+    if (*tokp > cap)
+        *tokp = cap;
+    *tokp -= need;
+    return (*tokp < 0.0) ? (uint64_t)((-*tokp * 1e9) / rate) : 0;
+}
+
+uint64_t
+sg_pt_rate_take(struct sg_pt_rate * rp, uint64_t num_bytes)
+{
+    uint64_t now, el, w, wait = 0;
+
+    if ((NULL == rp) || ((0 == rp->bytes_ps) && (0 == rp->iops)))
+        return 0;
+    now = sg_pt_lat_now_ns();
+    if (0 == now)
+        return 0;       /* no clock, so no limit */
+    el = (now > rp->last_ns) ? (now - rp->last_ns) : 0;
+    rp->last_ns = now;
+    if (rp->bytes_ps > 0)
+        wait = sg_pt_rate_bucket(&rp->byte_tokens,
+                                 rp->scale * (double)rp->bytes_ps, el,
+                                 (double)num_bytes);
+    if (rp->iops > 0) {
+        w = sg_pt_rate_bucket(&rp->cmd_tokens, rp->scale * (double)rp->iops,
+                              el, 1.0);
+        if (w > wait)
+            wait = w;
+    }
+    if (wait > 0) {
+        ++rp->waits;
+        rp->wait_ns += wait;
+    }
+    return wait;
+}
+
+void
+sg_pt_rate_sleep(uint64_t wait_ns)
+{
+    if (wait_ns > 0)
+        sg_pt_null_wait(sg_pt_lat_now_ns() + wait_ns, false);
+}
+
+void
+sg_pt_rate_update(struct sg_pt_rate * rp, uint64_t lat_ns)
+{
+    uint64_t now;
+
+    if ((NULL == rp) || (0 == rp->target_ns) || (0 == lat_ns))
+        return;
+    if (0 == rp->ewma_ns)       /* EWMA with weight 1/8 */
+        rp->ewma_ns = lat_ns;
+    else if (lat_ns > rp->ewma_ns)
+        rp->ewma_ns += (lat_ns - rp->ewma_ns) / 8;
+    else
+        rp->ewma_ns -= (rp->ewma_ns - lat_ns) / 8;
+    now = sg_pt_lat_now_ns();
+    if ((now - rp->adj_ns) < SG_PT_RATE_ADJ_NS)
+        return;
+    if (rp->ewma_ns > rp->target_ns) {
+        if (rp->scale > SG_PT_RATE_MIN_SCALE) {
+            rp->scale /= 2;
+            if (rp->scale < SG_PT_RATE_MIN_SCALE)
+                rp->scale = SG_PT_RATE_MIN_SCALE;
+            ++rp->backoffs;
+            rp->adj_ns = now;
+        }
+    } else if (rp->scale < 1.0) {
+        rp->scale += SG_PT_RATE_STEP;
+        if (rp->scale > 1.0)
+            rp->scale = 1.0;
+        rp->adj_ns = now;
+    }
+}
+
+int
+sg_pt_iov_len(const struct sg_pt_iovec * iovp, int iov_count)
+{
+    int k;
+    uint64_t sum = 0;
+
+    if (NULL == iovp)
+        return 0;
+    for (k = 0; k < iov_count; ++k)
+        sum += iovp[k].iov_len;
+    return (sum > 0x7fffffff) ? -1 : (int)sum;
+}
+
+void
+sg_pt_iov_gather(const struct sg_pt_iovec * iovp, int iov_count,
+                 uint8_t * bp)
+{
+    int k;
+
+    for (k = 0; k < iov_count; ++k) {
+        if (iovp[k].iov_len > 0)
+            memcpy(bp, iovp[k].iov_base, iovp[k].iov_len);
+        bp += iovp[k].iov_len;
+    }
+}
+
+void
+sg_pt_iov_scatter(const struct sg_pt_iovec * iovp, int iov_count,
+                  const uint8_t * bp, int len)
+{
+    int k, n;
+
+    for (k = 0; (k < iov_count) && (len > 0); ++k) {
+        n = ((size_t)len < iovp[k].iov_len) ? len : (int)iovp[k].iov_len;
+        if (n > 0)
+            memcpy(iovp[k].iov_base, bp, n);
+        bp += n;
+        len -= n;
+    }
+}
+
+#ifndef SG_LIB_LINUX
+
+/* Other pass-through implementations do not keep a decode in the object so
+ * each call decodes into per thread storage (shared by all threads without
+ * thread local storage), overwritten by the next call. */
+#if defined(__GNUC__)
+static __thread struct sg_scsi_sense_info pt_sinfo;
+#else
+static struct sg_scsi_sense_info pt_sinfo;
+#endif
+
+const struct sg_scsi_sense_info *
+get_scsi_pt_sense_info(const struct sg_pt_base * objp)
+{
+    const uint8_t * sbp = get_scsi_pt_sense_buf(objp);
+    int slen = get_scsi_pt_sense_len(objp);
+
+    if ((NULL == sbp) || (slen < 1))
+        return NULL;
+    return sg_scsi_decode_sense(sbp, slen, &pt_sinfo) ? &pt_sinfo : NULL;
+}
+
+int
+get_scsi_pt_sense_category(const struct sg_pt_base * objp)
+{
+    return sg_err_category_sinfo(get_scsi_pt_sense_info(objp));
+}
+
+#endif          /* SG_LIB_LINUX */
+
+#define SG_PT_NVME_LOG_DEF_CHUNK 8192   /* MDTS not known: 2 * MPSMIN */
+#define SG_PT_NVME_LOG_MAX_CHUNK (1024 * 1024)  /* MDTS says no limit */
+#define SG_PT_NVME_LOG_MAX_QD 16
+
+#if (HAVE_NVME && (! IGNORE_NVME))
+
+struct nvme_pt_slot {
+    struct sg_pt_base * ptvp;
+    uint8_t * bp;
+    uint8_t * free_bp;
+    uint32_t len;       /* of the data in flight, 0 when idle */
+    int idx;            /* namespace index (sg_pt_nvme_enum_ns() only) */
+    uint8_t cmd[64];
+    uint8_t cqe[32];    /* completion queue entry comes back as "sense" */
+};
+
+static void
+nvme_log_build(uint8_t * cmdp, uint8_t lid, uint8_t lsp, uint16_t lsi,
+               uint32_t nsid, bool rae, uint64_t off, uint32_t len)
+{
+    uint32_t numd = (len / 4) - 1;      /* 0's based number of dwords */
+
+    memset(cmdp, 0, 64);
+    cmdp[SG_NVME_PT_OPCODE] = 0x2;      /* Get Log Page */
+    sg_put_unaligned_le32(nsid, cmdp + SG_NVME_PT_NSID);
+    sg_put_unaligned_le32(lid | ((uint32_t)(lsp & 0x7f) << 8) |
+                          (rae ? 0x8000 : 0) | ((numd & 0xffff) << 16),
+                          cmdp + SG_NVME_PT_CDW10);
+    sg_put_unaligned_le32((numd >> 16) | ((uint32_t)lsi << 16),
+                          cmdp + SG_NVME_PT_CDW11);
+    sg_put_unaligned_le32((uint32_t)off, cmdp + SG_NVME_PT_CDW12); /* LPOL */
+    sg_put_unaligned_le32((uint32_t)(off >> 32), cmdp + SG_NVME_PT_CDW13);
+}
+
+/* Returns 0 or a negated errno value */
+static int
+nvme_log_deliver(const uint8_t * cp, uint32_t len, uint8_t * bp,
+                 int out_fd)
+{
+    ssize_t n;
+
+    if (bp)
+        memcpy(bp, cp, len);
+    while ((out_fd >= 0) && (len > 0)) {
+        n = write(out_fd, cp, len);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            return -errno;
+        }
+        cp += n;
+        len -= n;
+    }
+    return 0;
+}
+
+#endif
+
+int
+sg_pt_nvme_get_log(int dev_fd, uint8_t lid, uint8_t lsp, uint16_t lsi,
+                   uint32_t nsid, bool rae, uint64_t log_len,
+                   uint32_t max_chunk, int qd, uint8_t * bp, int out_fd,
+                   uint64_t * fetchedp, int timeout_secs, int verbose)
+{
+#if (HAVE_NVME && (! IGNORE_NVME))
+    int k, res, ret, num_slots, head, inflight;
+    uint32_t chunk, len, stat;
+    uint64_t off, done_off;
+    struct nvme_pt_slot * sp;
+    struct nvme_pt_slot slots[SG_PT_NVME_LOG_MAX_QD];
+
+    if (fetchedp)
+        *fetchedp = 0;
+    log_len = (log_len + 3) & ~(uint64_t)3;     /* whole dwords */
+    if (0 == log_len)
+        return 0;
+    if (qd < 1)
+        qd = 1;
+    else if (qd > SG_PT_NVME_LOG_MAX_QD)
+        qd = SG_PT_NVME_LOG_MAX_QD;
+    memset(slots, 0, sizeof(slots));
+    ret = 0;
+    num_slots = 0;
+    for (k = 0; k < qd; ++k) {
+        slots[k].ptvp = construct_scsi_pt_obj_with_fd(dev_fd, verbose);
+        if (NULL == slots[k].ptvp) {
+            ret = -ENOMEM;
+            goto fini;
+        }
+        num_slots = k + 1;
+        res = get_scsi_pt_os_err(slots[k].ptvp);
+        if (res) {
+            ret = -res;
+            goto fini;
+        }
+    }
+    chunk = get_pt_nvme_max_xfer(slots[0].ptvp, timeout_secs, verbose);
+    if (0 == chunk)
+        chunk = SG_PT_NVME_LOG_DEF_CHUNK;
+    else if (chunk > SG_PT_NVME_LOG_MAX_CHUNK)
+        chunk = SG_PT_NVME_LOG_MAX_CHUNK;
+    if ((max_chunk > 0) && (max_chunk < chunk))
+        chunk = max_chunk;
+    chunk &= ~(uint32_t)3;      /* the log page offset is in bytes but
+                                 * must be dword aligned */
+    if (0 == chunk)
+        chunk = 4;
+    if ((uint64_t)chunk * qd > log_len)         /* no idle slots */
+        qd = (int)((log_len + chunk - 1) / chunk);
+    for (k = 0; k < qd; ++k) {
+        slots[k].bp = sg_memalign(chunk, 0, &slots[k].free_bp, false);
+        if (NULL == slots[k].bp) {
+            ret = -ENOMEM;
+            goto fini;
+        }
+    }
+    if (verbose > 1)
+        pr2ws("%s: lid=0x%x, %" PRIu64 " bytes in chunks of %u bytes, "
+              "qd=%d\n", __func__, lid, log_len, chunk, qd);
+
+    /* keep up to qd chunks in flight, reaping the oldest first */
+    off = 0;
+    done_off = 0;
+    head = 0;
+    inflight = 0;
+    while (done_off < log_len) {
+        while ((inflight < qd) && (off < log_len)) {
+            sp = slots + ((head + inflight) % qd);
+            len = ((log_len - off) > chunk) ? chunk :
+                                              (uint32_t)(log_len - off);
+            nvme_log_build(sp->cmd, lid, lsp, lsi, nsid,
+                           ((off + len) < log_len) ? true : rae, off, len);
+            clear_scsi_pt_obj(sp->ptvp);
+            set_scsi_pt_cdb(sp->ptvp, sp->cmd, sizeof(sp->cmd));
+            set_scsi_pt_sense(sp->ptvp, sp->cqe, sizeof(sp->cqe));
+            set_scsi_pt_data_in(sp->ptvp, sp->bp, len);
+            set_scsi_pt_packet_id(sp->ptvp, (int)(off / chunk));
+            res = do_scsi_pt_submit(sp->ptvp, -1, timeout_secs, verbose);
+            if (res) {
+                ret = res;
+                goto fini;
+            }
+            sp->len = len;
+            off += len;
+            ++inflight;
+        }
+        sp = slots + head;
+        res = do_scsi_pt_receive(sp->ptvp, false, verbose);
+        len = sp->len;
+        sp->len = 0;
+        head = (head + 1) % qd;
+        --inflight;
+        if (res) {
+            ret = res;
+            goto fini;
+        }
+        stat = (uint32_t)get_scsi_pt_status_response(sp->ptvp);
+        if (stat) {
+            if (verbose)
+                pr2ws("%s: lid=0x%x, offset=%" PRIu64 ": NVMe status: "
+                      "0x%x\n", __func__, lid, done_off, stat);
+            ret = SG_LIB_NVME_STATUS;
+            goto fini;
+        }
+        res = nvme_log_deliver(sp->bp, len, bp ? (bp + done_off) : NULL,
+                               out_fd);
+        if (res) {
+            ret = res;
+            goto fini;
+        }
+        done_off += len;
+        if (fetchedp)
+            *fetchedp = done_off;
+    }
+fini:
+    for (k = 0; k < num_slots; ++k) {
+        sp = slots + k;
+        if (sp->len && sp->ptvp)        /* buffer may be in use */
+            do_scsi_pt_receive(sp->ptvp, false, 0);
+        if (sp->ptvp)
+            destruct_scsi_pt_obj(sp->ptvp);
+        if (sp->free_bp)
+            free(sp->free_bp);
+    }
+    return ret;
+#else
+    if (fetchedp)
+        *fetchedp = 0;
+    if (verbose)
+        pr2ws("%s: NVMe support not built in\n", __func__);
+    if (dev_fd || lid || lsp || lsi || nsid || rae || log_len || max_chunk ||
+        qd || bp || out_fd || timeout_secs) { ; }  /* suppress warnings */
+    return SCSI_PT_DO_NOT_SUPPORTED;
+#endif
+}
+
 
 #if (HAVE_NVME && (! IGNORE_NVME))
 /* ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ */
@@ -545,4 +1548,424 @@ err_out:
     return -1;
 }
 
+/* SES diagnostic pages that only change when the enclosure's generation
+ * code does (or, lacking one, with the configuration) */
+static bool
+sntl_ses_pg_static(uint8_t dpg_cd)
+{
+    switch (dpg_cd) {
+    case 0x0:           /* Supported Diagnostic pages */
+    case 0x1:           /* Configuration */
+    case 0x3:           /* Help Text */
+    case 0x7:           /* Element Descriptor */
+    case 0xb:           /* Subenclosure Help Text */
+    case 0xd:           /* Supported SES pages */
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Those SES pages with a generation code in bytes 4 to 7 */
+static bool
+sntl_ses_pg_has_gen(uint8_t dpg_cd)
+{
+    switch (dpg_cd) {
+    case 0x1: case 0x2: case 0x5: case 0x7: case 0xa: case 0xb:
+    case 0xc: case 0xe: case 0xf:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static int sntl_ses_window_ms = -2;     /* -2: not yet read */
+
+/* Returns the window (in milliseconds) in which repeated status page
+ * reads are answered from the cache: SG3_UTILS_SES_CACHE_MS, default
+ * SNTL_SES_STATUS_MS . A negative value turns the whole cache off */
+static int
+sntl_ses_window(void)
+{
+    int w = __atomic_load_n(&sntl_ses_window_ms, __ATOMIC_RELAXED);
+
+    if (-2 == w) {
+        const char * cp = getenv("SG3_UTILS_SES_CACHE_MS");
+
+        w = (cp && *cp) ? atoi(cp) : SNTL_SES_STATUS_MS;
+        if (w < 0)
+            w = -1;
+        __atomic_store_n(&sntl_ses_window_ms, w, __ATOMIC_RELAXED);
+    }
+    return w;
+}
+
+static void
+sntl_ses_pg_drop(struct sg_sntl_ses_cache_t * scp, int k)
+{
+    free(scp->pg[k].bp);
+    if (k < --scp->num)
+        scp->pg[k] = scp->pg[scp->num];
+    memset(scp->pg + scp->num, 0, sizeof(scp->pg[0]));
+}
+
+void
+sntl_ses_cache_clear(struct sg_sntl_ses_cache_t * scp, bool static_too)
+{
+    int k;
+
+    if (NULL == scp)
+        return;
+    for (k = scp->num - 1; k >= 0; --k) {
+        if (static_too || (! sntl_ses_pg_static(scp->pg[k].dpg_cd)))
+            sntl_ses_pg_drop(scp, k);
+    }
+    if (static_too)
+        scp->gen_valid = false;
+}
+
+/* Copies up to max_len bytes of diagnostic page dpg_cd into dip if the
+ * cache can answer for it. Returns the number of bytes copied, or -1 if
+ * the page needs to be fetched. */
+int
+sntl_ses_cache_get(struct sg_sntl_ses_cache_t * scp, uint8_t dpg_cd,
+                   uint8_t * dip, uint32_t max_len)
+{
+    int k, w;
+    uint32_t n;
+    struct sg_sntl_ses_pg_t * pp;
+
+    w = sntl_ses_window();
+    if ((NULL == scp) || (w < 0))
+        return -1;
+    for (k = 0; k < scp->num; ++k) {
+        if (scp->pg[k].dpg_cd == dpg_cd)
+            break;
+    }
+    if (k >= scp->num)
+        return -1;
+    pp = scp->pg + k;
+    if ((! sntl_ses_pg_static(dpg_cd)) &&
+        ((sg_pt_lat_now_ns() - pp->when_ns) >= ((uint64_t)w * 1000000))) {
+        sntl_ses_pg_drop(scp, k);
+        return -1;
+    }
+    if ((max_len > pp->len) && (pp->len < pp->full_len))
+        return -1;      /* earlier fetch was truncated by its caller */
+    n = (max_len < pp->len) ? max_len : pp->len;
+    memcpy(dip, pp->bp, n);
+    return (int)n;
+}
+
+/* Called with what a SES receive placed in dip (len bytes). A page whose
+ * generation code differs from the one last seen drops everything held,
+ * as the enclosure's configuration has changed. */
+void
+sntl_ses_cache_put(struct sg_sntl_ses_cache_t * scp, uint8_t dpg_cd,
+                   const uint8_t * dip, uint32_t len)
+{
+    int k;
+    uint32_t full_len, gen;
+    struct sg_sntl_ses_pg_t * pp;
+
+    if ((NULL == scp) || (len < 4) || (dip[0] != dpg_cd) ||
+        (sntl_ses_window() < 0))
+        return;
+    full_len = sg_get_unaligned_be16(dip + 2) + 4;
+    if (len > full_len)
+        len = full_len;
+    if (sntl_ses_pg_has_gen(dpg_cd) && (len >= 8)) {
+        gen = sg_get_unaligned_be32(dip + 4);
+        if (scp->gen_valid && (gen != scp->gen_code))
+            sntl_ses_cache_clear(scp, true);
+        scp->gen_code = gen;
+        scp->gen_valid = true;
+    }
+    if ((! sntl_ses_pg_static(dpg_cd)) && (0 == sntl_ses_window()))
+        return;         /* status pages not coalesced */
+    for (k = 0; k < scp->num; ++k) {
+        if (scp->pg[k].dpg_cd == dpg_cd)
+            break;
+    }
+    if (k >= scp->num) {
+        if (k >= SNTL_SES_CACHE_PAGES)
+            sntl_ses_pg_drop(scp, --k);
+        k = scp->num;
+    }
+    pp = scp->pg + k;
+    if ((NULL == pp->bp) || (len > pp->len)) {
+        uint8_t * bp = (uint8_t *)realloc(pp->bp, len);
+
+        if (NULL == bp)
+            return;
+        pp->bp = bp;
+    }
+    if (k == scp->num)
+        ++scp->num;
+    memcpy(pp->bp, dip, len);
+    pp->dpg_cd = dpg_cd;
+    pp->len = len;
+    pp->full_len = full_len;
+    pp->when_ns = sg_pt_lat_now_ns();
+}
+
+void
+sntl_ses_cache_free(struct sg_sntl_ses_cache_t * scp)
+{
+    if (scp) {
+        sntl_ses_cache_clear(scp, true);
+        memset(scp, 0, sizeof(*scp));
+    }
+}
+
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) [near line 140] */
+
+#if (HAVE_NVME && (! IGNORE_NVME))
+
+#define SG_PT_NVME_ID_LEN 4096
+#define SG_PT_NVME_NSID_LIST_MAX 1024   /* NSIDs per Identify CNS=2 */
+
+static void
+nvme_id_build(uint8_t * cmdp, uint8_t cns, uint32_t nsid)
+{
+    memset(cmdp, 0, 64);
+    cmdp[SG_NVME_PT_OPCODE] = 0x6;      /* Identify */
+    sg_put_unaligned_le32(nsid, cmdp + SG_NVME_PT_NSID);
+    sg_put_unaligned_le32(cns, cmdp + SG_NVME_PT_CDW10);
+}
+
+static void
+nvme_id_prep(struct nvme_pt_slot * sp, uint8_t cns, uint32_t nsid,
+             uint8_t * bp)
+{
+    nvme_id_build(sp->cmd, cns, nsid);
+    clear_scsi_pt_obj(sp->ptvp);
+    set_scsi_pt_cdb(sp->ptvp, sp->cmd, sizeof(sp->cmd));
+    set_scsi_pt_sense(sp->ptvp, sp->cqe, sizeof(sp->cqe));
+    set_scsi_pt_data_in(sp->ptvp, bp, SG_PT_NVME_ID_LEN);
+}
+
+/* Returns 0, SG_LIB_NVME_STATUS or what do_scsi_pt() returned */
+static int
+nvme_id_sync(struct nvme_pt_slot * sp, uint8_t cns, uint32_t nsid,
+             uint8_t * bp, int timeout_secs, int vb)
+{
+    int res;
+
+    nvme_id_prep(sp, cns, nsid, bp);
+    res = do_scsi_pt(sp->ptvp, -1, timeout_secs, vb);
+    if (res)
+        return res;
+    return get_scsi_pt_status_response(sp->ptvp) ? SG_LIB_NVME_STATUS : 0;
+}
+
+/* Fills in what is derived from the Identify namespace response */
+static void
+nvme_enum_ns_fill(const struct sg_pt_nvme_enum * ep,
+                  struct sg_pt_nvme_ns * np)
+{
+    int n, index;
+    uint8_t lbads;
+    const uint8_t * up = np->id_nsp;
+
+    np->num_lbs = sg_get_unaligned_le64(up + 0);        /* NSZE */
+    index = 128 + (4 * (up[26] & 0xf));                 /* from FLBAS */
+    lbads = (sg_get_unaligned_le32(up + index) >> 16) & 0xff;
+    np->lb_size = (lbads >= 9) ? (1U << lbads) : 512;
+    n = sg_make_vpd_devid_for_nvme(ep->id_ctlp, up, 0 /* pdt */,
+                                   -1 /* tproto */, np->devid,
+                                   sizeof(np->devid));
+    if (n > 3)
+        sg_put_unaligned_be16(n - 4, np->devid + 2);
+    np->devid_len = n;
+}
+
+int
+sg_pt_nvme_enum_ns(int dev_fd, struct sg_pt_nvme_enum * ep, int qd,
+                   int timeout_secs, int verbose)
+{
+    int k, n, res, ret, num_slots, head, inflight, next;
+    uint32_t nsid, max_nsid;
+    uint32_t * nsids = NULL;
+    uint8_t * listp = NULL;
+    uint8_t * free_listp = NULL;
+    struct nvme_pt_slot * sp;
+    struct sg_pt_nvme_ns * np;
+    struct nvme_pt_slot slots[SG_PT_NVME_LOG_MAX_QD];
+
+    memset(ep, 0, sizeof(*ep));
+    if (qd < 1)
+        qd = 1;
+    else if (qd > SG_PT_NVME_LOG_MAX_QD)
+        qd = SG_PT_NVME_LOG_MAX_QD;
+    memset(slots, 0, sizeof(slots));
+    ret = 0;
+    num_slots = 0;
+    for (k = 0; k < qd; ++k) {
+        slots[k].ptvp = construct_scsi_pt_obj_with_fd(dev_fd, verbose);
+        if (NULL == slots[k].ptvp) {
+            ret = -ENOMEM;
+            goto fini;
+        }
+        num_slots = k + 1;
+        res = get_scsi_pt_os_err(slots[k].ptvp);
+        if (res) {
+            ret = -res;
+            goto fini;
+        }
+    }
+    ep->id_ctlp = sg_memalign(SG_PT_NVME_ID_LEN, 0, &ep->free_id_ctlp,
+                              false);
+    listp = sg_memalign(SG_PT_NVME_ID_LEN, 0, &free_listp, false);
+    if ((NULL == ep->id_ctlp) || (NULL == listp)) {
+        ret = -ENOMEM;
+        goto fini;
+    }
+    /* the controller is identified once, for all its namespaces */
+    ret = nvme_id_sync(slots, 0x1, 0, (uint8_t *)ep->id_ctlp, timeout_secs,
+                       verbose);
+    if (ret)
+        goto fini;
+    max_nsid = sg_get_unaligned_le32(ep->id_ctlp + 516);        /* NN */
+    ep->max_nsid = max_nsid;
+    ep->inq[2] = 6;     /* version: SPC-4 */
+    ep->inq[3] = 2;     /* response data format: 2 */
+    ep->inq[4] = 31;    /* so response length is 36 bytes */
+    ep->inq[7] = 0x2;   /* CMDQUE=1 */
+    memcpy(ep->inq + 8, nvme_scsi_vendor_str, 8);
+    memcpy(ep->inq + 16, ep->id_ctlp + 24, 16);         /* Prod <-- MN */
+    memcpy(ep->inq + 32, ep->id_ctlp + 64, 4);          /* Rev <-- FR */
+    if (0 == max_nsid)
+        goto fini;
+    nsids = (uint32_t *)calloc(max_nsid, sizeof(uint32_t));
+    if (NULL == nsids) {
+        ret = -ENOMEM;
+        goto fini;
+    }
+
+    /* Active Namespace ID list (CNS=2) gives NSIDs greater than 'nsid' */
+    ep->active_list = true;
+    for (n = 0, nsid = 0; (uint32_t)n < max_nsid; ) {
+        res = nvme_id_sync(slots, 0x2, nsid, listp, timeout_secs, verbose);
+        if (res) {
+            if ((SG_LIB_NVME_STATUS == res) && (0 == n)) {
+                ep->active_list = false;        /* e.g. NVMe 1.0 */
+                break;
+            }
+            ret = res;
+            goto fini;
+        }
+        for (k = 0; k < SG_PT_NVME_NSID_LIST_MAX; ++k) {
+            nsid = sg_get_unaligned_le32(listp + (4 * k));
+            if ((0 == nsid) || ((uint32_t)n >= max_nsid))
+                break;
+            nsids[n++] = nsid;
+        }
+        if (k < SG_PT_NVME_NSID_LIST_MAX)
+            break;
+    }
+    if (! ep->active_list) {
+        for (n = 0; (uint32_t)n < max_nsid; ++n)
+            nsids[n] = n + 1;
+    }
+    if (verbose > 1)
+        pr2ws("%s: %d namespace%s (of %u) from %s, qd=%d\n", __func__, n,
+              ((1 == n) ? "" : "s"), max_nsid,
+              (ep->active_list ? "active list" : "NN"), qd);
+    if (0 == n)
+        goto fini;
+    ep->nsp = (struct sg_pt_nvme_ns *)calloc(n, sizeof(*ep->nsp));
+    listp = sg_memalign((uint32_t)n * SG_PT_NVME_ID_LEN, 0,
+                        &ep->free_id_nsp, false);
+    if ((NULL == ep->nsp) || (NULL == listp)) {
+        ret = -ENOMEM;
+        goto fini;
+    }
+    for (k = 0; k < n; ++k) {
+        ep->nsp[k].nsid = nsids[k];
+        ep->nsp[k].id_nsp = listp + ((size_t)k * SG_PT_NVME_ID_LEN);
+    }
+    ep->num_ns = n;
+
+    /* keep up to qd Identify namespace commands in flight */
+    head = 0;
+    inflight = 0;
+    for (next = 0, k = 0; k < n; ) {
+        while ((inflight < qd) && (next < n)) {
+            sp = slots + ((head + inflight) % qd);
+            np = ep->nsp + next;
+            nvme_id_prep(sp, 0x0, np->nsid, (uint8_t *)np->id_nsp);
+            set_scsi_pt_packet_id(sp->ptvp, next);
+            res = do_scsi_pt_submit(sp->ptvp, -1, timeout_secs, verbose);
+            /* when done synchronously the status is picked up below */
+            if (res && (SG_LIB_NVME_STATUS != res)) {
+                ret = res;
+                goto fini;
+            }
+            sp->len = SG_PT_NVME_ID_LEN;
+            sp->idx = next++;
+            ++inflight;
+        }
+        sp = slots + head;
+        res = do_scsi_pt_receive(sp->ptvp, false, verbose);
+        sp->len = 0;
+        head = (head + 1) % qd;
+        --inflight;
+        np = ep->nsp + sp->idx;
+        if ((0 == res) && get_scsi_pt_status_response(sp->ptvp))
+            res = SG_LIB_NVME_STATUS;
+        if (res < 0) {          /* OS error: give up */
+            ret = res;
+            goto fini;
+        }
+        np->status = res;
+        if (0 == res)
+            nvme_enum_ns_fill(ep, np);
+        else if (verbose)
+            pr2ws("%s: Identify namespace %u failed, res=%d\n", __func__,
+                  np->nsid, res);
+        ++k;
+    }
+fini:
+    for (k = 0; k < num_slots; ++k) {
+        sp = slots + k;
+        if (sp->len && sp->ptvp)        /* buffer may be in use */
+            do_scsi_pt_receive(sp->ptvp, false, 0);
+        if (sp->ptvp)
+            destruct_scsi_pt_obj(sp->ptvp);
+    }
+    if (free_listp)
+        free(free_listp);
+    if (nsids)
+        free(nsids);
+    return ret;
+}
+
+#else
+
+int
+sg_pt_nvme_enum_ns(int dev_fd, struct sg_pt_nvme_enum * ep, int qd,
+                   int timeout_secs, int verbose)
+{
+    memset(ep, 0, sizeof(*ep));
+    if (verbose)
+        pr2ws("%s: NVMe support not built in\n", __func__);
+    if (dev_fd || qd || timeout_secs) { ; }     /* suppress warnings */
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+#endif          /* (HAVE_NVME && (! IGNORE_NVME)) */
+
+void
+sg_pt_nvme_enum_free(struct sg_pt_nvme_enum * ep)
+{
+    if (NULL == ep)
+        return;
+    if (ep->nsp)
+        free(ep->nsp);
+    if (ep->free_id_nsp)
+        free(ep->free_id_nsp);
+    if (ep->free_id_ctlp)
+        free(ep->free_id_ctlp);
+    memset(ep, 0, sizeof(*ep));
+}
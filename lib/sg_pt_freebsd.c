@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-/* sg_pt_freebsd version 1.35 20190210 */
+/* sg_pt_freebsd version 1.36 20261014 */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,8 +25,11 @@
 #include <err.h>
 #include <camlib.h>
 #include <cam/scsi/scsi_message.h>
+#include <cam/scsi/scsi_pass.h>
 // #include <sys/ata.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <glob.h>
@@ -41,6 +44,7 @@
 #include "sg_lib.h"
 #include "sg_unaligned.h"
 #include "sg_pt_nvme.h"
+#include "sg_pt_null.h"
 #include "sg_pr2serr.h"
 
 #if (HAVE_NVME && (! IGNORE_NVME))
@@ -71,6 +75,7 @@ struct freebsd_dev_channel {
     uint8_t * free_nvme_id_ctlp;
     uint8_t cq_dw0_3[16];
     struct sg_sntl_dev_state_t dev_stat;    // owner
+    struct sg_sntl_ses_cache_t ses;         // SES pages via NVMe-MI
 };
 
 // Private table of open devices: guaranteed zero on startup since
@@ -96,6 +101,9 @@ struct sg_pt_freebsd_scsi {
     uint32_t dxfer_olen;
     uint32_t mdxfer_len;
     bool mdxfer_out;
+    const struct sg_pt_iovec * iovp;    /* when non-NULL, dxferp is NULL */
+    int iov_cnt;
+    bus_dma_segment_t * segs;   /* iovp in CAM's form, for CAM_DATA_SG */
     int timeout_ms;
     int scsi_status;
     int resid;
@@ -108,6 +116,8 @@ struct sg_pt_freebsd_scsi {
                                 // index into devicetable[]
     bool is_nvme;               // copy of same field in fdc object
     bool nvme_direct;           // copy of same field in fdc object
+    bool q_inflight;            // ccb given to CAMIOQUEUE, not yet fetched
+    bool q_done;                // ccb fetched by CAMIOGET into this->ccb
     struct sg_sntl_dev_state_t * dev_statp;     // points to associated fdc
 };
 
@@ -141,6 +151,73 @@ get_fdc_cp(const struct sg_pt_freebsd_scsi * ptp)
     return devicetable[han];
 }
 
+#ifdef CAMIOQUEUE
+/* Fetches completed ccbs from the pass(4) driver with CAMIOGET until the
+ * one queued by ptp is done. Each ccb queued by do_scsi_pt_submit() holds
+ * a pointer to its owner in ppriv_ptr1, so ccbs of other objects queued on
+ * the same device are copied back to those objects and marked done. If
+ * 'no_wait' is true returns -EAGAIN rather than blocking. Returns 0 when
+ * ptp's ccb is done, else a negated errno. */
+static int
+sg_pt_freebsd_reap(struct sg_pt_freebsd_scsi * ptp, bool no_wait, int vb)
+{
+    int res, err;
+    struct sg_pt_freebsd_scsi * optp;
+    struct pollfd pfd;
+    union ccb ccb;
+
+    while (! ptp->q_done) {
+        pfd.fd = ptp->cam_dev->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        res = poll(&pfd, 1, no_wait ? 0 : -1);
+        if (res < 0) {
+            err = errno;
+            if (EINTR == err)
+                continue;
+            ptp->os_err = err;
+            return -err;
+        } else if (0 == res)
+            return -EAGAIN;
+        if (ioctl(ptp->cam_dev->fd, CAMIOGET, &ccb) < 0) {
+            err = errno;
+            if (ENOENT == err) {        /* raced with another reaper */
+                if (no_wait)
+                    return -EAGAIN;
+                continue;
+            }
+            if (vb)
+                pr2ws("%s: ioctl(CAMIOGET) failed: %s\n", __func__,
+                      strerror(err));
+            ptp->os_err = err;
+            return -err;
+        }
+        optp = (struct sg_pt_freebsd_scsi *)ccb.ccb_h.ppriv_ptr1;
+        if ((NULL == optp) || (NULL == optp->ccb) || (! optp->q_inflight)) {
+            if (vb)
+                pr2ws("%s: CAMIOGET returned unknown ccb\n", __func__);
+            continue;
+        }
+        memcpy(optp->ccb, &ccb, sizeof(ccb));
+        optp->q_done = true;
+    }
+    return 0;
+}
+#endif
+
+/* The pass(4) driver still holds a queued ccb whose owner pointer must
+ * stay valid, so wait for it to complete before ptp is freed or cleared. */
+static void
+sg_pt_freebsd_drain(struct sg_pt_freebsd_scsi * ptp)
+{
+#ifdef CAMIOQUEUE
+    if (ptp->q_inflight && ptp->cam_dev)
+        sg_pt_freebsd_reap(ptp, false, 0);
+#endif
+    ptp->q_inflight = false;
+    ptp->q_done = false;
+}
+
 /* Returns >= 0 if successful. If error in Unix returns negated errno. */
 int
 scsi_pt_open_device(const char * device_name, bool read_only, int vb)
@@ -153,7 +230,8 @@ scsi_pt_open_device(const char * device_name, bool read_only, int vb)
 
 /* Similar to scsi_pt_open_device() but takes Unix style open flags OR-ed
  * together. The 'oflags' is only used on NVMe devices. It is ignored on
- * SCSI and ATA devices in FreeBSD.
+ * SCSI and ATA devices in FreeBSD. A device_name starting with
+ * SG_PT_NULL_DEV_NAME opens a null device, see sg_pt_null.h .
  * Returns >= 0 if successful, otherwise returns negated errno. */
 int
 scsi_pt_open_flags(const char * device_name, int oflags, int vb)
@@ -169,6 +247,8 @@ scsi_pt_open_flags(const char * device_name, int oflags, int vb)
     char b[PATH_MAX];
     char  full_path[64];
 
+    if (sg_pt_null_dev_name(device_name))
+        return sg_pt_null_open(device_name, oflags, false, vb);
     // Search table for a free entry
     for (k = 0; k < FREEBSD_MAXDEV; k++)
         if (! devicetable[k])
@@ -304,6 +384,8 @@ scsi_pt_close_device(int device_han)
     struct freebsd_dev_channel *fdc_p;
     int han = device_han - FREEBSD_FDOFFSET;
 
+    if (sg_pt_null_is_fd(device_han))
+        return sg_pt_null_close(device_han);
     if ((han < 0) || (han >= FREEBSD_MAXDEV)) {
         errno = ENODEV;
         return -errno;
@@ -325,6 +407,7 @@ scsi_pt_close_device(int device_han)
             fdc_p->nvme_id_ctlp = NULL;
             fdc_p->free_nvme_id_ctlp = NULL;
         }
+        sntl_ses_cache_free(&fdc_p->ses);
     }
     free(fdc_p);
     devicetable[han] = NULL;
@@ -344,6 +427,8 @@ check_pt_file_handle(int device_han, const char * device_name, int vb)
     struct freebsd_dev_channel *fdc_p;
     int han = device_han - FREEBSD_FDOFFSET;
 
+    if (sg_pt_null_is_fd(device_han))
+        return 1;
     if ((han < 0) || (han >= FREEBSD_MAXDEV))
         return -ENODEV;
     fdc_p = devicetable[han];
@@ -392,7 +477,7 @@ construct_scsi_pt_obj_with_fd(int dev_han, int vb)
                 }
                 fdc_p->dev_stat.scsi_dsense = ev_dsense;
 #endif
-            } else if (vb)
+            } else if (vb && (! sg_pt_null_is_fd(dev_han)))
                 pr2ws("%s: bad dev_han=%d\n", __func__, dev_han);
         }
     } else if (vb)
@@ -417,8 +502,11 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
         return;
     }
     if ((ptp = &vp->impl)) {
+        sg_pt_freebsd_drain(ptp);
         if (ptp->ccb)
             cam_freeccb(ptp->ccb);
+        if (ptp->segs)
+            free(ptp->segs);
         free(ptp);
     }
 }
@@ -437,8 +525,11 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
         return;
     }
     if ((ptp = &vp->impl)) {
+        sg_pt_freebsd_drain(ptp);
         if (ptp->ccb)
             cam_freeccb(ptp->ccb);
+        if (ptp->segs)
+            free(ptp->segs);
         is_nvme = ptp->is_nvme;
         dev_han = ptp->dev_han;
         cam_dev = ptp->cam_dev;
@@ -452,6 +543,32 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
     }
 }
 
+/* Keeps the ccb, and the sense and data buffer bindings; resets the cdb
+ * binding and the results of the previous command. */
+void
+rearm_scsi_pt_obj(struct sg_pt_base * vp)
+{
+    struct sg_pt_freebsd_scsi * ptp;
+
+    if (NULL == vp) {
+        pr2ws(">>>>> %s: NULL pointer given\n", __func__);
+        return;
+    }
+    if ((ptp = &vp->impl)) {
+        if (ptp->sense && (ptp->sense_len > ptp->sense_resid))
+            memset(ptp->sense, 0, ptp->sense_len - ptp->sense_resid);
+        ptp->cdb = NULL;
+        ptp->cdb_len = 0;
+        ptp->scsi_status = 0;
+        ptp->resid = 0;
+        ptp->sense_resid = 0;
+        ptp->in_err = 0;
+        ptp->os_err = 0;
+        ptp->transport_err = 0;
+        ptp->nvme_direct = false;
+    }
+}
+
 /* Forget any previous dev_han and install the one given. May attempt to
  * find file type (e.g. if pass-though) from OS so there could be an error.
  * Returns 0 for success or the same value as get_scsi_pt_os_err()
@@ -476,6 +593,13 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_han, int vb)
             ptp->cam_dev = NULL;
             return 0;
         }
+        if (sg_pt_null_is_fd(dev_han)) {
+            ptp->os_err = 0;
+            ptp->dev_han = dev_han;
+            ptp->is_nvme = false;
+            ptp->cam_dev = NULL;
+            return 0;
+        }
         fdc_p = get_fdc_p(ptp);
         if (NULL == fdc_p) {
             if (vb)
@@ -609,6 +733,16 @@ set_scsi_pt_task_management(struct sg_pt_base * vp,
     ++ptp->in_err;
 }
 
+void
+set_scsi_pt_transport_req(struct sg_pt_base * vp,
+                          const uint8_t * reqp __attribute__ ((unused)),
+                          int req_len __attribute__ ((unused)))
+{
+    struct sg_pt_freebsd_scsi * ptp = &vp->impl;
+
+    ++ptp->in_err;
+}
+
 void
 set_scsi_pt_task_attr(struct sg_pt_base * vp,
                       int attrib __attribute__ ((unused)),
@@ -626,17 +760,182 @@ set_scsi_pt_flags(struct sg_pt_base * objp, int flags)
     if (flags) { ; }     /* unused, suppress warning */
 }
 
-/* Executes SCSI command (or at least forwards it to lower layers).
- * Clears os_err field prior to active call (whose result may set it
- * again). */
-int
-do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
+/* Common code for set_scsi_pt_data_in_iov() and
+ * set_scsi_pt_data_out_iov(). CAM takes one scatter gather list so only
+ * one direction may use one. */
+static void
+set_scsi_pt_data_iov(struct sg_pt_freebsd_scsi * ptp,
+                     const struct sg_pt_iovec * iovp, int iov_count,
+                     bool is_din)
+{
+    int len = sg_pt_iov_len(iovp, iov_count);
+
+    if ((is_din ? ptp->dxferip : ptp->dxferop) || ptp->iovp || (len < 0)) {
+        ++ptp->in_err;
+        return;
+    }
+    if (len <= 0)
+        return;
+    if (is_din) {
+        ptp->dxferip = (uint8_t *)iovp;         /* only marks it as set */
+        ptp->dxfer_ilen = len;
+    } else {
+        ptp->dxferop = (uint8_t *)iovp;
+        ptp->dxfer_olen = len;
+    }
+    ptp->iovp = iovp;
+    ptp->iov_cnt = iov_count;
+    ptp->dxferp = NULL;
+    ptp->dxfer_len = len;
+    if (CAM_DIR_NONE != ptp->dxfer_dir)
+        ptp->dxfer_dir = CAM_DIR_BOTH;
+    else
+        ptp->dxfer_dir = is_din ? CAM_DIR_IN : CAM_DIR_OUT;
+}
+
+void
+set_scsi_pt_data_in_iov(struct sg_pt_base * vp,
+                        const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(&vp->impl, iovp, iov_count, true);
+}
+
+void
+set_scsi_pt_data_out_iov(struct sg_pt_base * vp,
+                         const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(&vp->impl, iovp, iov_count, false);
+}
+
+/* This pass-through has no kernel buffer that can be mapped */
+uint8_t *
+set_scsi_pt_data_in_mmap(struct sg_pt_base * vp __attribute__ ((unused)),
+                         int dxfer_ilen __attribute__ ((unused)),
+                         int verbose __attribute__ ((unused)))
+{
+    return NULL;
+}
+
+/* Runs the command with the scatter gather list replaced by a contiguous
+ * bounce buffer. Used for NVMe devices (and if CAM lacks CAM_DATA_SG). */
+static int
+do_scsi_pt_bounce(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
+{
+    bool is_din;
+    int res, n;
+    struct sg_pt_freebsd_scsi * ptp = &vp->impl;
+    const struct sg_pt_iovec * iovp = ptp->iovp;
+    uint8_t * bp;
+    uint8_t * free_bp = NULL;
+
+    is_din = (ptp->dxferip == (const uint8_t *)iovp);
+    bp = sg_memalign(ptp->dxfer_len, 0, &free_bp, false);
+    if (NULL == bp) {
+        ptp->os_err = ENOMEM;
+        return -ptp->os_err;
+    }
+    if (! is_din)
+        sg_pt_iov_gather(iovp, ptp->iov_cnt, bp);
+    ptp->iovp = NULL;
+    ptp->dxferp = bp;
+    if (is_din)
+        ptp->dxferip = bp;
+    else
+        ptp->dxferop = bp;
+    res = do_scsi_pt(vp, dev_han, time_secs, vb);
+    if (is_din && (0 == res)) {
+        n = ptp->dxfer_len - ptp->resid;
+        if (n > 0)
+            sg_pt_iov_scatter(iovp, ptp->iov_cnt, bp, n);
+    }
+    ptp->iovp = iovp;
+    ptp->dxferp = NULL;
+    if (is_din)
+        ptp->dxferip = (uint8_t *)iovp;
+    else
+        ptp->dxferop = (uint8_t *)iovp;
+    free(free_bp);
+    return res;
+}
+
+/* Processes the response held in ptp->ccb of a SCSI command sent to
+ * cam_dev. */
+static int
+sg_pt_freebsd_ccb_fini(struct sg_pt_freebsd_scsi * ptp,
+                       struct cam_device * cam_dev)
 {
     int len;
+    union ccb *ccb = ptp->ccb;
+
+    if (((ccb->ccb_h.status & CAM_STATUS_MASK) == CAM_REQ_CMP) ||
+        ((ccb->ccb_h.status & CAM_STATUS_MASK) == CAM_SCSI_STATUS_ERROR)) {
+        ptp->scsi_status = ccb->csio.scsi_status;
+        ptp->resid = ccb->csio.resid;
+        ptp->sense_resid = ccb->csio.sense_resid;
+
+        if ((SAM_STAT_CHECK_CONDITION == ptp->scsi_status) ||
+            (SAM_STAT_COMMAND_TERMINATED == ptp->scsi_status)) {
+            if (ptp->sense_resid > ptp->sense_len)
+                len = ptp->sense_len;   /* crazy; ignore sense_resid */
+            else
+                len = ptp->sense_len - ptp->sense_resid;
+            if (len > 0)
+                memcpy(ptp->sense, &(ccb->csio.sense_data), len);
+        }
+    } else
+        ptp->transport_err = 1;
+
+    ptp->cam_dev = cam_dev;     // for error processing
+    return 0;
+}
+
+/* Hands the command in ptp to the null device dev_han and waits out its
+ * (injected) latency. */
+static int
+sg_pt_freebsd_null_do(struct sg_pt_freebsd_scsi * ptp, int dev_han, int vb)
+{
+    int res;
+    const uint8_t * iovp = (const uint8_t *)ptp->iovp;
+    struct sg_pt_null_cmd nc;
+
+    memset(&nc, 0, sizeof(nc));
+    nc.cdbp = ptp->cdb;
+    nc.cdb_len = ptp->cdb_len;
+    nc.dinp = ptp->dxferip;
+    nc.din_len = ptp->dxfer_ilen;
+    nc.din_iov_count = (iovp && (iovp == ptp->dxferip)) ? ptp->iov_cnt : 0;
+    nc.doutp = ptp->dxferop;
+    nc.dout_len = ptp->dxfer_olen;
+    nc.dout_iov_count = (iovp && (iovp == ptp->dxferop)) ? ptp->iov_cnt : 0;
+    nc.sensep = ptp->sense;
+    nc.max_sense_len = ptp->sense_len;
+    res = sg_pt_null_cmd(dev_han, &nc, vb);
+    if (res) {
+        ptp->os_err = -res;
+        return res;
+    }
+    ptp->scsi_status = nc.scsi_status;
+    ptp->resid = (nc.din_len > 0) ? nc.din_resid : nc.dout_resid;
+    ptp->sense_resid = ptp->sense_len - nc.sense_len;
+    return sg_pt_null_wait(nc.done_ns, false);
+}
+
+/* Does the work of do_scsi_pt() and do_scsi_pt_submit(). When 'async' is
+ * true SCSI commands are queued with CAMIOQUEUE (if available); NVMe and
+ * bounced scatter gather commands are always done synchronously. */
+static int
+do_scsi_pt_com(struct sg_pt_base * vp, int dev_han, int time_secs,
+               bool async, int vb)
+{
     struct sg_pt_freebsd_scsi * ptp = &vp->impl;
     struct freebsd_dev_channel *fdc_p;
     union ccb *ccb;
 
+    if (ptp->q_inflight) {
+        if (vb)
+            pr2ws("%s: previous command still queued\n", __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
     ptp->os_err = 0;
     if (ptp->in_err) {
         if (vb)
@@ -667,6 +966,14 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
             pr2ws("No command (cdb) given\n");
         return SCSI_PT_DO_BAD_PARAMS;
     }
+    if (sg_pt_null_is_fd(dev_han))
+        return sg_pt_freebsd_null_do(ptp, dev_han, vb);
+#ifdef CAM_DATA_SG
+    if (ptp->iovp && ptp->is_nvme)
+#else
+    if (ptp->iovp)
+#endif
+        return do_scsi_pt_bounce(vp, dev_han, time_secs, vb);
     if (ptp->is_nvme)
         return sg_do_nvme_pt(vp, -1, vb);
 
@@ -679,8 +986,11 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
     }
     ptp->is_nvme = fdc_p->is_nvme;
     ptp->dev_statp = &fdc_p->dev_stat;
-    if (fdc_p->is_nvme)
+    if (fdc_p->is_nvme) {
+        if (ptp->iovp)
+            return do_scsi_pt_bounce(vp, dev_han, time_secs, vb);
         return sg_do_nvme_pt(vp, -1, vb);
+    }
 
     if (NULL == fdc_p->cam_dev) {
         if (vb)
@@ -703,7 +1013,7 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
     bzero(&(&ccb->ccb_h)[1],
             sizeof(struct ccb_scsiio) - sizeof(struct ccb_hdr));
 
-    ptp->timeout_ms = (time_secs > 0) ? (time_secs * 1000) : DEF_TIMEOUT;
+    ptp->timeout_ms = (int)sg_pt_timeout_ms(time_secs, DEF_TIMEOUT);
     cam_fill_csio(&ccb->csio,
                   /* retries */ 1,
                   /* cbfcnp */ NULL,
@@ -714,8 +1024,50 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
                   /* senselen */ ptp->sense_len,
                   /* cdblen */ ptp->cdb_len,
                   /* timeout (millisecs) */ ptp->timeout_ms);
+#ifdef CAM_DATA_SG
+    if (ptp->iovp) {
+        int k;
+
+        if (NULL == ptp->segs) {
+            ptp->segs = (bus_dma_segment_t *)calloc(ptp->iov_cnt,
+                                                    sizeof(*ptp->segs));
+            if (NULL == ptp->segs) {
+                ptp->os_err = ENOMEM;
+                return -ptp->os_err;
+            }
+        }
+        for (k = 0; k < ptp->iov_cnt; ++k) {
+            ptp->segs[k].ds_addr = (bus_addr_t)(uintptr_t)
+                                   ptp->iovp[k].iov_base;
+            ptp->segs[k].ds_len = ptp->iovp[k].iov_len;
+        }
+        ccb->csio.data_ptr = (uint8_t *)ptp->segs;
+        ccb->csio.sglist_cnt = ptp->iov_cnt;
+        ccb->ccb_h.flags |= CAM_DATA_SG;
+    }
+#endif
     memcpy(ccb->csio.cdb_io.cdb_bytes, ptp->cdb, ptp->cdb_len);
 
+#ifdef CAMIOQUEUE
+    if (async) {
+        ccb->ccb_h.ppriv_ptr1 = ptp;    /* so sg_pt_freebsd_reap() finds us */
+        ptp->cam_dev = fdc_p->cam_dev;
+        if (ioctl(fdc_p->cam_dev->fd, CAMIOQUEUE, ccb) < 0) {
+            ptp->os_err = errno;
+            if (vb)
+                pr2ws("%s: ioctl(CAMIOQUEUE) failed: %s\n", __func__,
+                      strerror(ptp->os_err));
+            return -ptp->os_err;
+        }
+        ptp->q_inflight = true;
+        ptp->q_done = false;
+        return 0;
+    }
+#else
+    if (async && (vb > 3))
+        pr2ws("%s: no CAMIOQUEUE, so command done synchronously\n",
+              __func__);
+#endif
     if (cam_send_ccb(fdc_p->cam_dev, ccb) < 0) {
         if (vb) {
             warn("error sending SCSI ccb");
@@ -729,27 +1081,98 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
         ptp->os_err = EIO;
         return -ptp->os_err;
     }
+    return sg_pt_freebsd_ccb_fini(ptp, fdc_p->cam_dev);
+}
 
-    if (((ccb->ccb_h.status & CAM_STATUS_MASK) == CAM_REQ_CMP) ||
-        ((ccb->ccb_h.status & CAM_STATUS_MASK) == CAM_SCSI_STATUS_ERROR)) {
-        ptp->scsi_status = ccb->csio.scsi_status;
-        ptp->resid = ccb->csio.resid;
-        ptp->sense_resid = ccb->csio.sense_resid;
+/* Executes SCSI command (or at least forwards it to lower layers).
+ * Clears os_err field prior to active call (whose result may set it
+ * again). */
+int
+do_scsi_pt(struct sg_pt_base * vp, int dev_han, int time_secs, int vb)
+{
+    return do_scsi_pt_com(vp, dev_han, time_secs, false, vb);
+}
 
-        if ((SAM_STAT_CHECK_CONDITION == ptp->scsi_status) ||
-            (SAM_STAT_COMMAND_TERMINATED == ptp->scsi_status)) {
-            if (ptp->sense_resid > ptp->sense_len)
-                len = ptp->sense_len;   /* crazy; ignore sense_resid */
-            else
-                len = ptp->sense_len - ptp->sense_resid;
-            if (len > 0)
-                memcpy(ptp->sense, &(ccb->csio.sense_data), len);
-        }
-    } else
-        ptp->transport_err = 1;
+/* SCSI commands to pass(4) devices are queued with the CAMIOQUEUE ioctl
+ * and fetched by do_scsi_pt_receive() with CAMIOGET, so several may be in
+ * flight on one device. NVMe commands (and SCSI commands when CAMIOQUEUE
+ * is not available) are executed synchronously at submit time. */
+int
+do_scsi_pt_submit(struct sg_pt_base * vp, int dev_han, int time_secs,
+                  int vb)
+{
+    return do_scsi_pt_com(vp, dev_han, time_secs, true, vb);
+}
 
-    ptp->cam_dev = fdc_p->cam_dev;     // for error processing
+int
+do_scsi_pt_receive(struct sg_pt_base * vp,
+                   bool no_wait __attribute__ ((unused)),
+                   int vb __attribute__ ((unused)))
+{
+    struct sg_pt_freebsd_scsi * ptp = &vp->impl;
+#ifdef CAMIOQUEUE
+    int res;
+#endif
+
+    if (! ptp->q_inflight)
+        return 0;       /* was done synchronously by do_scsi_pt_submit() */
+#ifdef CAMIOQUEUE
+    res = sg_pt_freebsd_reap(ptp, no_wait, vb);
+    if (res)
+        return res;
+    ptp->q_inflight = false;
+    ptp->q_done = false;
+    return sg_pt_freebsd_ccb_fini(ptp, ptp->cam_dev);
+#else
     return 0;
+#endif
+}
+
+/* This OS has no batched pass-through mechanism, so the commands are
+ * executed one after the other. */
+int
+do_scsi_pt_batch(struct sg_pt_base * objp_arr[], int num, int time_secs,
+                 int * num_donep, int vb)
+{
+    int k;
+    int res = 0;
+
+    for (k = 0; k < num; ++k) {
+        res = do_scsi_pt(objp_arr[k], -1, time_secs, vb);
+        if (res)
+            break;
+    }
+    if (num_donep)
+        *num_donep = k;
+    return res;
+}
+
+/* This OS has no pass-through mechanism for sharing requests */
+int
+scsi_pt_share_fds(int rd_fd __attribute__ ((unused)),
+                  int wr_fd __attribute__ ((unused)),
+                  int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+scsi_pt_unshare_fds(int fd __attribute__ ((unused)),
+                    int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+do_scsi_pt_shared_rw(struct sg_pt_base * rd_vp __attribute__ ((unused)),
+                     struct sg_pt_base * wr_vp __attribute__ ((unused)),
+                     int num_bytes __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     bool * wr_issuedp, int vb __attribute__ ((unused)))
+{
+    if (wr_issuedp)
+        *wr_issuedp = false;
+    return SCSI_PT_DO_NOT_SUPPORTED;
 }
 
 int
@@ -994,6 +1417,29 @@ get_pt_nvme_nsid(const struct sg_pt_base * vp)
     return 0;
 }
 
+/* Only uses an Identify controller response the SNTL has already cached */
+uint32_t
+get_pt_nvme_max_xfer(struct sg_pt_base * vp,
+                     int time_secs __attribute__ ((unused)),
+                     int vb __attribute__ ((unused)))
+{
+    uint8_t mdts;
+    const struct sg_pt_freebsd_scsi * ptp = &vp->impl;
+    const struct freebsd_dev_channel * fdc_p;
+
+    if ((NULL == ptp) || (ptp->dev_han < 0))
+        return 0;
+    fdc_p = get_fdc_cp(ptp);
+    if ((NULL == fdc_p) || (! fdc_p->is_nvme) ||
+        (NULL == fdc_p->nvme_id_ctlp))
+        return 0;
+    mdts = fdc_p->nvme_id_ctlp[77];
+    if (0 == mdts)
+        return UINT32_MAX;
+    /* MDTS is in units of CAP.MPSMIN, assume that is 4096 bytes */
+    return ((mdts + 12) < 32) ? (1U << (mdts + 12)) : UINT32_MAX;
+}
+
 char *
 get_scsi_pt_os_err_str(const struct sg_pt_base * vp, int max_b_len, char * b)
 {
@@ -1825,6 +2271,8 @@ sntl_senddiag(struct sg_pt_freebsd_scsi * ptp, const uint8_t * cdbp, int vb)
     /* data-out length I hope */
     sg_put_unaligned_le32(n, npc_up + SG_NVME_PT_CDW13);
     err = nvme_pt_low(fdc_p, ptp->dxferp, 0x1000, false, &npc, vb);
+    /* status (and after Download microcode, all) pages may now differ */
+    sntl_ses_cache_clear(&fdc_p->ses, (0xe == dpg_cd));
 do_low:
     if (err) {
         if (err < 0) {
@@ -1901,6 +2349,14 @@ sntl_recvdiag(struct sg_pt_freebsd_scsi * ptp, const uint8_t * cdbp, int vb)
                   (uint64_t)ptp->dxferp);
         return SCSI_PT_DO_BAD_PARAMS;
     }
+    err = sntl_ses_cache_get(&fdc_p->ses, dpg_cd, ptp->dxferp, n);
+    if (err >= 0) {
+        if (vb > 1)
+            pr2ws("%s: d_pg=0x%x (%d bytes) from SES page cache\n",
+                  __func__, dpg_cd, err);
+        ptp->resid = din_len - err;
+        return 0;
+    }
 
     if (vb)
         pr2ws("%s: expecting d_pg=0x%x from NVME_MI SES receive\n", __func__,
@@ -1932,6 +2388,7 @@ sntl_recvdiag(struct sg_pt_freebsd_scsi * ptp, const uint8_t * cdbp, int vb)
             return 0;
         }
     }
+    sntl_ses_cache_put(&fdc_p->ses, dpg_cd, dip, n);
     ptp->resid = din_len - n;
     return 0;
 }
@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-/* sg_pt_linux version 1.47 20190612 */
+/* sg_pt_linux version 1.48 20261014 */
 
 
 #include <stdio.h>
@@ -19,8 +19,12 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/sysmacros.h>      /* to define 'major' */
 #ifndef major
 #include <sys/types.h>
@@ -37,16 +41,21 @@
 #include "sg_lib.h"
 #include "sg_linux_inc.h"
 #include "sg_pt_linux.h"
+#include "sg_pt_null.h"
 #include "sg_pr2serr.h"
+#define SG_SDT_DEFINE_SEMAPHORES 1
+#include "sg_pt_sdt.h"
 
 
 #ifdef major
 #define SG_DEV_MAJOR major
+#define SG_DEV_MINOR minor
 #else
 #ifdef HAVE_LINUX_KDEV_T_H
 #include <linux/kdev_t.h>
 #endif
 #define SG_DEV_MAJOR MAJOR  /* MAJOR() macro faulty if > 255 minors */
+#define SG_DEV_MINOR MINOR
 #endif
 
 #ifndef BLOCK_EXT_MAJOR
@@ -60,6 +69,8 @@
                                          * v4 interface */
 #define SG_LINUX_SG_VER_V4_FULL 40030   /* lowest version with full v4
                                          * interface */
+#define SG_LINUX_SG_VER_V4_HIPRI 40045  /* lowest version that accepts
+                                         * SGV4_FLAG_HIPRI */
 
 static const char * linux_host_bytes[] = {
     "DID_OK", "DID_NO_CONNECT", "DID_BUS_BUSY", "DID_TIME_OUT",
@@ -111,6 +122,7 @@ static const char * linux_driver_suggests[] = {
 bool sg_bsg_nvme_char_major_checked = false;
 int sg_bsg_major = 0;
 volatile int sg_nvme_char_major = 0;
+int sg_nvme_generic_major = 0;  /* NVMe generic char devices: /dev/ngXnY */
 
 bool sg_checked_version_num = false;
 int sg_driver_version_num = 0;
@@ -118,15 +130,27 @@ bool sg_duration_set_nano = false;
 
 long sg_lin_page_size = 4096;   /* default, overridden with correct value */
 
+/* Process-wide cache of NVMe namespace identifiers (from the NVME_IOCTL_ID
+ * ioctl) keyed by device type, major and minor number. Each entry holds
+ * the nsid in its upper 32 bits and the key in its lower 32 bits so it can
+ * be read and written atomically without a lock. Flushed by
+ * sg_find_bsg_nvme_char_major() since namespaces may come and go. */
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && (__GCC_ATOMIC_LLONG_LOCK_FREE == 2)
+#define SG_NSID_CACHE 1
+#define SG_NSID_CACHE_SZ 256    /* direct mapped, must be power of 2 */
+static uint64_t sg_nsid_cache[SG_NSID_CACHE_SZ];
+#endif
+
 
 /* This function only needs to be called once (unless a NVMe controller
  * can be hot-plugged into system in which case it should be called
- * (again) after that event). */
+ * (again) after that event). Also flushes the cache of NVMe namespace
+ * identifiers and invalidates the shared NVMe Identify cache. */
 void
 sg_find_bsg_nvme_char_major(int verbose)
 {
-    bool got_one = false;
     int n;
+    int num_found = 0;
     const char * proc_devices = "/proc/devices";
     char * cp;
     FILE *fp;
@@ -134,6 +158,11 @@ sg_find_bsg_nvme_char_major(int verbose)
     char b[128];
 
     sg_lin_page_size = sysconf(_SC_PAGESIZE);
+#ifdef SG_NSID_CACHE
+    for (n = 0; n < SG_NSID_CACHE_SZ; ++n)
+        __atomic_store_n(sg_nsid_cache + n, 0, __ATOMIC_RELAXED);
+#endif
+    sg_nvme_id_cache_flush();
     if (NULL == (fp = fopen(proc_devices, "r"))) {
         if (verbose)
             pr2ws("fopen %s failed: %s\n", proc_devices, strerror(errno));
@@ -148,34 +177,90 @@ sg_find_bsg_nvme_char_major(int verbose)
         if (2 == sscanf(b, "%d %126s", &n, a)) {
             if (0 == strcmp("bsg", a)) {
                 sg_bsg_major = n;
-                if (got_one)
-                    break;
-                got_one = true;
+                ++num_found;
             } else if (0 == strcmp("nvme", a)) {
                 sg_nvme_char_major = n;
-                if (got_one)
-                    break;
-                got_one = true;
+                ++num_found;
+            } else if (0 == strcmp("nvme-generic", a)) {
+                sg_nvme_generic_major = n;
+                ++num_found;
             }
+            if (num_found >= 3)
+                break;
         } else
             break;
     }
     if (verbose > 3) {
-        if (cp) {
+        if (num_found > 0) {
             if (sg_bsg_major > 0)
                 pr2ws("found sg_bsg_major=%d\n", sg_bsg_major);
             if (sg_nvme_char_major > 0)
                 pr2ws("found sg_nvme_char_major=%d\n", sg_nvme_char_major);
+            if (sg_nvme_generic_major > 0)
+                pr2ws("found sg_nvme_generic_major=%d\n",
+                      sg_nvme_generic_major);
         } else
             pr2ws("found no bsg not nvme char device in %s\n", proc_devices);
     }
     fclose(fp);
 }
 
+/* Returns a non-zero key made from the device type, major and minor
+ * number of the NVMe device described by dev_statp, or 0 if they do not
+ * fit. Used by the nsid cache below and the shared NVMe Identify cache. */
+static uint32_t
+sg_nvme_dev_key(const struct stat * dev_statp)
+{
+    unsigned int mj = SG_DEV_MAJOR(dev_statp->st_rdev);
+    unsigned int mn = SG_DEV_MINOR(dev_statp->st_rdev);
+
+    /* key is never 0 since major is non-zero for NVMe devices */
+    if ((mj < 0x800) && (mn < 0x100000))
+        return (S_ISCHR(dev_statp->st_mode) ? 0x80000000 : 0) |
+               (mj << 20) | mn;
+    return 0;
+}
+
+/* Returns the NVMe namespace identifier of dev_fd (a NVMe block device or
+ * NVMe generic char device), using the cache when possible. Returns
+ * SG_NVME_BROADCAST_NSID on error with the errno in *os_err_p . */
+static uint32_t
+sg_get_nvme_nsid(int dev_fd, const struct stat * dev_statp, int * os_err_p,
+                 int verbose)
+{
+    uint32_t nsid;
+#ifdef SG_NSID_CACHE
+    uint32_t key = sg_nvme_dev_key(dev_statp);
+    uint64_t ent;
+
+    if (key) {
+        ent = __atomic_load_n(sg_nsid_cache + (key % SG_NSID_CACHE_SZ),
+                              __ATOMIC_RELAXED);
+        if ((uint32_t)ent == key)
+            return (uint32_t)(ent >> 32);
+    }
+#endif
+    nsid = ioctl(dev_fd, NVME_IOCTL_ID, NULL);
+    if (SG_NVME_BROADCAST_NSID == nsid) {  /* means ioctl error */
+        *os_err_p = errno;
+        if (verbose)
+            pr2ws("%s: ioctl(NVME_IOCTL_ID) failed: %s (errno=%d)\n",
+                  __func__, safe_strerror(*os_err_p), *os_err_p);
+        return nsid;
+    }
+#ifdef SG_NSID_CACHE
+    if (key && (nsid > 0))
+        __atomic_store_n(sg_nsid_cache + (key % SG_NSID_CACHE_SZ),
+                         ((uint64_t)nsid << 32) | key, __ATOMIC_RELAXED);
+#endif
+    return nsid;
+}
+
 /* Assumes that sg_find_bsg_nvme_char_major() has already been called. Returns
  * true if dev_fd is a scsi generic pass-through device. If yields
  * *is_nvme_p = true with *nsid_p = 0 then dev_fd is a NVMe char device.
- * If yields *nsid_p > 0 then dev_fd is a NVMe block device. */
+ * If yields *nsid_p > 0 then dev_fd is a NVMe block device or a NVMe
+ * generic char device (e.g. /dev/ng0n1) which is tied to a namespace. */
 static bool
 check_file_type(int dev_fd, struct stat * dev_statp, bool * is_bsg_p,
                 bool * is_nvme_p, uint32_t * nsid_p, int * os_err_p,
@@ -205,19 +290,16 @@ check_file_type(int dev_fd, struct stat * dev_statp, bool * is_bsg_p,
                 is_bsg = true;
             else if (sg_nvme_char_major == major_num)
                 is_nvme = true;
+            else if ((sg_nvme_generic_major > 0) &&
+                     (sg_nvme_generic_major == major_num)) {
+                is_nvme = true;
+                nsid = sg_get_nvme_nsid(dev_fd, dev_statp, &os_err, verbose);
+            }
         } else if (S_ISBLK(dev_statp->st_mode)) {
             is_block = true;
             if (BLOCK_EXT_MAJOR == major_num) {
                 is_nvme = true;
-                nsid = ioctl(dev_fd, NVME_IOCTL_ID, NULL);
-                if (SG_NVME_BROADCAST_NSID == nsid) {  /* means ioctl error */
-                    os_err = errno;
-                    if (verbose)
-                        pr2ws("%s: ioctl(NVME_IOCTL_ID) failed: %s "
-                              "(errno=%d)\n", __func__, safe_strerror(os_err),
-                              os_err);
-                } else
-                    os_err = 0;
+                nsid = sg_get_nvme_nsid(dev_fd, dev_statp, &os_err, verbose);
             }
         }
     } else {
@@ -234,6 +316,9 @@ skip_out:
             pr2ws("bsg device\n");
         else if (is_nvme && (0 == nsid))
             pr2ws("NVMe char device\n");
+        else if (is_nvme && (! is_block))
+            pr2ws("NVMe generic char device, nsid=%lld\n",
+                  ((uint32_t)-1 == nsid) ? -1LL : (long long)nsid);
         else if (is_nvme)
             pr2ws("NVMe block device, nsid=%lld\n",
                   ((uint32_t)-1 == nsid) ? -1LL : (long long)nsid);
@@ -259,7 +344,8 @@ skip_out:
  * device_name. Returns 1 if SCSI generic pass-though device, returns 2 if
  * secondary SCSI pass-through device (in Linux a bsg device); returns 3 is
  * char NVMe device (i.e. no NSID); returns 4 if block NVMe device (includes
- * NSID), or 0 if something else (e.g. ATA block device) or dev_fd < 0.
+ * NSID; in Linux also a NVMe generic char device such as /dev/ng0n1), or
+ * 0 if something else (e.g. ATA block device) or dev_fd < 0.
  * If error, returns negated errno (operating system) value. */
 int
 check_pt_file_handle(int dev_fd, const char * device_name, int verbose)
@@ -278,6 +364,8 @@ check_pt_file_handle(int dev_fd, const char * device_name, int verbose)
         uint32_t nsid;
         struct stat a_stat;
 
+        if (sg_pt_null_is_fd(dev_fd))
+            return 1;
         is_sg = check_file_type(dev_fd, &a_stat, &is_bsg, &is_nvme, &nsid,
                                 &err, verbose);
         if (err)
@@ -328,18 +416,210 @@ check_pt_file_handle(int dev_fd, const char * device_name, int verbose)
 #endif
 
 
+int
+sg_broker_xfer(int sfd, void * bp, uint32_t len, bool out)
+{
+    ssize_t n;
+    uint8_t * p = (uint8_t *)bp;
+
+    while (len > 0) {
+        n = out ? send(sfd, p, len, MSG_NOSIGNAL) : recv(sfd, p, len, 0);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            return -errno;
+        } else if (0 == n)
+            return -EPIPE;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Reads and throws away 'len' bytes from the broker */
+static int
+sg_broker_discard(int sfd, uint32_t len)
+{
+    int res;
+    uint32_t n;
+    uint8_t b[256];
+
+    for ( ; len > 0; len -= n) {
+        n = (len > sizeof(b)) ? sizeof(b) : len;
+        res = sg_broker_xfer(sfd, b, n, false);
+        if (res)
+            return res;
+    }
+    return 0;
+}
+
+/* Connects to the broker listening on 'sock_name' and asks it to open
+ * 'device_name'. Returns the connected socket or a negated errno; if the
+ * broker could not be reached *connectedp is set false. */
+static int
+sg_broker_open(const char * sock_name, const char * device_name, int flags,
+               bool * connectedp, int verbose)
+{
+    int sfd, res;
+    struct sockaddr_un sa;
+    struct sg_broker_req req;
+    struct sg_broker_rsp rsp;
+
+    *connectedp = false;
+    if (strlen(sock_name) >= sizeof(sa.sun_path))
+        return -ENAMETOOLONG;
+    sfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sfd < 0)
+        return -errno;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, sock_name);
+    if (connect(sfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        res = -errno;
+        close(sfd);
+        return res;
+    }
+    *connectedp = true;
+    memset(&req, 0, sizeof(req));
+    req.magic = SG_BROKER_MAGIC;
+    req.op = SG_BROKER_OP_OPEN;
+    req.flags = flags;
+    req.len1 = strlen(device_name);
+    res = sg_broker_xfer(sfd, &req, sizeof(req), true);
+    if (0 == res)
+        res = sg_broker_xfer(sfd, (void *)device_name, req.len1, true);
+    if (0 == res)
+        res = sg_broker_xfer(sfd, &rsp, sizeof(rsp), false);
+    if ((0 == res) && (SG_BROKER_MAGIC != rsp.magic))
+        res = -EPROTO;
+    if (0 == res)
+        res = rsp.res;
+    if (res < 0) {
+        if (verbose > 1)
+            pr2ws("%s: broker open(%s) failed: %s\n", __func__, device_name,
+                  safe_strerror(-res));
+        close(sfd);
+        return res;
+    }
+    return sfd;
+}
+
+/* Sends the command held in ptp to the broker and waits for its response */
+static int
+sg_broker_do(struct sg_pt_linux_scsi * ptp, int sfd, int time_secs,
+             int verbose)
+{
+    int res;
+    uint32_t n;
+    struct sg_broker_req req;
+    struct sg_broker_rsp rsp;
+
+    if ((0 == ptp->io_hdr.request) ||
+        (ptp->io_hdr.request_len > SG_BROKER_MAX_CDB)) {
+        if (verbose)
+            pr2ws("%s: no command or too long for broker\n", __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    if (ptp->io_hdr.din_iovec_count || ptp->io_hdr.dout_iovec_count ||
+        (ptp->io_hdr.din_xfer_len && ptp->io_hdr.dout_xfer_len) ||
+        (ptp->io_hdr.din_xfer_len > SG_BROKER_MAX_XFER) ||
+        (ptp->io_hdr.dout_xfer_len > SG_BROKER_MAX_XFER)) {
+        if (verbose)
+            pr2ws("%s: scatter gather lists, bidi and transfers over %d "
+                  "bytes not supported by broker\n", __func__,
+                  SG_BROKER_MAX_XFER);
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    }
+    memset(&req, 0, sizeof(req));
+    req.magic = SG_BROKER_MAGIC;
+    req.op = SG_BROKER_OP_CMD;
+    req.len1 = ptp->io_hdr.request_len;
+    req.dout_len = ptp->io_hdr.dout_xfer_len;
+    req.din_len = ptp->io_hdr.din_xfer_len;
+    req.max_sense_len = ptp->io_hdr.response ?
+                        ptp->io_hdr.max_response_len : 0;
+    req.timeout_secs = time_secs;
+    res = sg_broker_xfer(sfd, &req, sizeof(req), true);
+    if (0 == res)
+        res = sg_broker_xfer(sfd, (void *)(sg_uintptr_t)ptp->io_hdr.request,
+                             req.len1, true);
+    if ((0 == res) && (req.dout_len > 0))
+        res = sg_broker_xfer(sfd,
+                             (void *)(sg_uintptr_t)ptp->io_hdr.dout_xferp,
+                             req.dout_len, true);
+    if (0 == res)
+        res = sg_broker_xfer(sfd, &rsp, sizeof(rsp), false);
+    if ((0 == res) && (SG_BROKER_MAGIC != rsp.magic))
+        res = -EPROTO;
+    if (0 == res) {
+        n = (rsp.sense_len > req.max_sense_len) ? req.max_sense_len :
+                                                  rsp.sense_len;
+        if (n > 0)
+            res = sg_broker_xfer(sfd,
+                                 (void *)(sg_uintptr_t)ptp->io_hdr.response,
+                                 n, false);
+        if ((0 == res) && (rsp.sense_len > n))
+            res = sg_broker_discard(sfd, rsp.sense_len - n);
+        ptp->io_hdr.response_len = n;
+    }
+    if (0 == res) {
+        n = (rsp.din_len > req.din_len) ? req.din_len : rsp.din_len;
+        if (n > 0)
+            res = sg_broker_xfer(sfd,
+                                 (void *)(sg_uintptr_t)ptp->io_hdr.din_xferp,
+                                 n, false);
+        if ((0 == res) && (rsp.din_len > n))
+            res = sg_broker_discard(sfd, rsp.din_len - n);
+    }
+    if (res) {
+        ptp->os_err = -res;
+        if (verbose > 1)
+            pr2ws("%s: broker connection failed: %s\n", __func__,
+                  safe_strerror(ptp->os_err));
+        return res;
+    }
+    ptp->os_err = rsp.os_err;
+    ptp->io_hdr.device_status = rsp.device_status;
+    ptp->io_hdr.transport_status = rsp.transport_status;
+    ptp->io_hdr.driver_status = rsp.driver_status;
+    ptp->io_hdr.din_resid = rsp.din_resid;
+    ptp->io_hdr.dout_resid = rsp.dout_resid;
+    ptp->io_hdr.duration = rsp.duration;
+    ptp->nvme_result = rsp.nvme_result;
+    ptp->nvme_status = rsp.nvme_status;
+    ptp->nvme_direct = !! rsp.nvme_direct;
+    return rsp.res;
+}
+
 /* Similar to scsi_pt_open_device() but takes Unix style open flags OR-ed */
 /* together. The 'flags' argument is advisory and may be ignored. */
 /* Returns >= 0 if successful, otherwise returns negated errno. */
+/* When the SG3_UTILS_BROKER environment variable names the socket of a */
+/* running sg_srvd daemon, the device is opened by (and stays open in) */
+/* that daemon and a connection to it is returned. A device_name starting */
+/* with SG_PT_NULL_DEV_NAME opens a null device, see sg_pt_null.h . */
 int
 scsi_pt_open_flags(const char * device_name, int flags, int verbose)
 {
+    bool connected;
     int fd;
+    const char * cp;
 
+    if (sg_pt_null_dev_name(device_name))
+        return sg_pt_null_open(device_name, flags, true, verbose);
     if (! sg_bsg_nvme_char_major_checked) {
         sg_bsg_nvme_char_major_checked = true;
         sg_find_bsg_nvme_char_major(verbose);
     }
+    cp = getenv("SG3_UTILS_BROKER");
+    if (cp && *cp) {
+        fd = sg_broker_open(cp, device_name, flags, &connected, verbose);
+        if (connected)
+            return fd;
+        if (verbose)
+            pr2ws("%s: broker %s not reachable, open directly\n", __func__,
+                  cp);
+    }
     if (verbose > 1) {
         pr2ws("open %s with flags=0x%x\n", device_name, flags);
     }
@@ -369,6 +649,8 @@ scsi_pt_close_device(int device_fd)
 {
     int res;
 
+    if (sg_pt_null_is_fd(device_fd))
+        return sg_pt_null_close(device_fd);
     res = close(device_fd);
     if (res < 0)
         res = -errno;
@@ -391,14 +673,6 @@ construct_scsi_pt_obj_with_fd(int dev_fd, int verbose)
     ptp = (struct sg_pt_linux_scsi *)
           calloc(1, sizeof(struct sg_pt_linux_scsi));
     if (ptp) {
-#if (HAVE_NVME && (! IGNORE_NVME))
-        sntl_init_dev_stat(&ptp->dev_stat);
-        if (! checked_ev_dsense) {
-            ev_dsense = sg_get_initial_dsense();
-            checked_ev_dsense = true;
-        }
-        ptp->dev_stat.scsi_dsense = ev_dsense;
-#endif
         err = set_pt_file_handle((struct sg_pt_base *)ptp, dev_fd, verbose);
         if ((0 == err) && (! ptp->is_nvme)) {
             ptp->io_hdr.guard = 'Q';
@@ -421,6 +695,148 @@ construct_scsi_pt_obj()
     return construct_scsi_pt_obj_with_fd(-1 /* dev_fd */, 0 /* verbose */);
 }
 
+/* bsg nodes (in kernels that still have it) accept a struct sg_io_v4
+ * with write() and return each response, in completion order, to read().
+ * usr_ptr carries the address of the submitting object so that a response
+ * read via another object sharing the file descriptor can be handed on;
+ * only objects found in this array of those queued are written to. The
+ * lock only covers the array, never a system call. */
+#define SG_BSG_Q_MAX 256
+
+static struct sg_pt_linux_scsi * sg_bsg_q_arr[SG_BSG_Q_MAX];
+static bool sg_bsg_q_locked;
+static bool sg_bsg_q_unsupported = false;       /* write() was rejected */
+
+static void
+sg_bsg_q_lock(void)
+{
+    while (__atomic_test_and_set(&sg_bsg_q_locked, __ATOMIC_ACQUIRE))
+        ;
+}
+
+static void
+sg_bsg_q_unlock(void)
+{
+    __atomic_clear(&sg_bsg_q_locked, __ATOMIC_RELEASE);
+}
+
+/* Returns true if ptp was added to the array of queued objects */
+static bool
+sg_bsg_q_add(struct sg_pt_linux_scsi * ptp)
+{
+    bool ok = false;
+    int k;
+
+    sg_bsg_q_lock();
+    for (k = 0; k < SG_BSG_Q_MAX; ++k) {
+        if (NULL == sg_bsg_q_arr[k]) {
+            sg_bsg_q_arr[k] = ptp;
+            ok = true;
+            break;
+        }
+    }
+    sg_bsg_q_unlock();
+    return ok;
+}
+
+/* Removes ptp from the array. If it was there and hp is given then the
+ * response in *hp is placed in ptp and its bsg_done flag is set. ptp is
+ * not dereferenced unless it is found. Returns true if found. */
+static bool
+sg_bsg_q_take(struct sg_pt_linux_scsi * ptp, const struct sg_io_v4 * hp)
+{
+    bool found = false;
+    int k;
+
+    sg_bsg_q_lock();
+    for (k = 0; k < SG_BSG_Q_MAX; ++k) {
+        if (ptp == sg_bsg_q_arr[k]) {
+            sg_bsg_q_arr[k] = NULL;
+            found = true;
+            if (hp) {
+                ptp->io_hdr = *hp;
+                __atomic_store_n(&ptp->bsg_done, true, __ATOMIC_RELEASE);
+            }
+            break;
+        }
+    }
+    sg_bsg_q_unlock();
+    return found;
+}
+
+/* Reads bsg responses on ptp's file descriptor, handing on those of other
+ * objects, until ptp's own has arrived in which case 0 is returned. With
+ * no_wait returns -EAGAIN when nothing more is ready. Other negative
+ * values are negated errno values. Threads sharing a file descriptor
+ * should open it O_NONBLOCK so read() cannot block on a response that
+ * another thread took between poll() and read(). */
+static int
+sg_bsg_q_receive(struct sg_pt_linux_scsi * ptp, bool no_wait, int verbose)
+{
+    int res, n;
+    struct sg_pt_linux_scsi * tp;
+    struct sg_io_v4 h;
+    struct pollfd a_poll;
+
+    while (! __atomic_load_n(&ptp->bsg_done, __ATOMIC_ACQUIRE)) {
+        a_poll.fd = ptp->dev_fd;
+        a_poll.events = POLLIN;
+        a_poll.revents = 0;
+        /* timeout as another object may read our response */
+        n = poll(&a_poll, 1, no_wait ? 0 : 10);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            ptp->os_err = errno;
+            return -ptp->os_err;
+        } else if (0 == n) {
+            if (no_wait)
+                return -EAGAIN;
+            continue;
+        }
+        memset(&h, 0, sizeof(h));
+        h.guard = 'Q';
+        res = read(ptp->dev_fd, &h, sizeof(h));
+        if (res < 0) {
+            if ((EINTR == errno) || (EAGAIN == errno))
+                continue;
+            ptp->os_err = errno;
+            if (verbose > 1)
+                pr2ws("%s: read(bsg) failed: %s (errno=%d)\n", __func__,
+                      safe_strerror(ptp->os_err), ptp->os_err);
+            return -ptp->os_err;
+        }
+        tp = (struct sg_pt_linux_scsi *)(sg_uintptr_t)h.usr_ptr;
+        if ((! sg_bsg_q_take(tp, &h)) && verbose)
+            pr2ws("%s: dropped bsg response of an unknown object\n",
+                  __func__);
+    }
+    ptp->bsg_inflight = false;
+    return 0;
+}
+
+/* Waits for a command queued on ptp before it is cleared or destructed.
+ * If that fails ptp is forgotten so a late response is dropped. */
+static void
+sg_bsg_q_drain(struct sg_pt_linux_scsi * ptp)
+{
+    if (ptp->bsg_inflight) {
+        if (sg_bsg_q_receive(ptp, false, 0) < 0)
+            sg_bsg_q_take(ptp, NULL);
+        ptp->bsg_inflight = false;
+    }
+}
+
+static void
+sg_pt_linux_munmap(struct sg_pt_linux_scsi * ptp)
+{
+    if (ptp->mmap_bp) {
+        munmap(ptp->mmap_bp, ptp->mmap_len);
+        ptp->mmap_bp = NULL;
+        ptp->mmap_len = 0;
+    }
+}
+
 void
 destruct_scsi_pt_obj(struct sg_pt_base * vp)
 {
@@ -430,11 +846,11 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
     else {
         struct sg_pt_linux_scsi * ptp = &vp->impl;
 
-        if (ptp->free_nvme_id_ctlp) {
-            free(ptp->free_nvme_id_ctlp);
-            ptp->free_nvme_id_ctlp = NULL;
-            ptp->nvme_id_ctlp = NULL;
-        }
+        sg_bsg_q_drain(ptp);
+        sg_nvme_id_cache_put(ptp);
+        if (ptp->uringp)
+            sg_nvme_uring_free(ptp);
+        sg_pt_linux_munmap(ptp);
         if (ptp)
             free(ptp);
     }
@@ -444,21 +860,37 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
 void
 clear_scsi_pt_obj(struct sg_pt_base * vp)
 {
-    bool is_sg, is_bsg, is_nvme;
-    int fd;
-    uint32_t nvme_nsid;
+    bool is_sg, is_bsg, is_nvme, use_uring, pack_id_forced, is_broker;
+    bool is_null;
+    int fd, sg_version, mmap_len;
+    uint8_t * mmap_bp;
+    uint8_t nvme_lbads;
+    uint32_t nvme_nsid, nvme_dev_key;
+    void * uringp;
     struct sg_sntl_dev_state_t dev_stat;
     struct sg_pt_linux_scsi * ptp = &vp->impl;
 
     if (ptp) {
+        if (ptp->uring_inflight)    /* unreaped completion would confuse */
+            sg_nvme_uring_free(ptp);
+        sg_bsg_q_drain(ptp);
         fd = ptp->dev_fd;
         is_sg = ptp->is_sg;
         is_bsg = ptp->is_bsg;
         is_nvme = ptp->is_nvme;
+        is_broker = ptp->is_broker;
+        is_null = ptp->is_null;
+        sg_version = ptp->sg_version;
+        pack_id_forced = ptp->async_pack_id_forced;
         nvme_nsid = ptp->nvme_nsid;
+        nvme_lbads = ptp->nvme_lbads;
         dev_stat = ptp->dev_stat;
-        if (ptp->free_nvme_id_ctlp)
-            free(ptp->free_nvme_id_ctlp);
+        use_uring = ptp->use_uring;
+        uringp = ptp->uringp;
+        nvme_dev_key = ptp->nvme_dev_key;
+        mmap_bp = ptp->mmap_bp;
+        mmap_len = ptp->mmap_len;
+        sg_nvme_id_cache_put(ptp);
         memset(ptp, 0, sizeof(struct sg_pt_linux_scsi));
         ptp->io_hdr.guard = 'Q';
 #ifdef BSG_PROTOCOL_SCSI
@@ -471,10 +903,61 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
         ptp->is_sg = is_sg;
         ptp->is_bsg = is_bsg;
         ptp->is_nvme = is_nvme;
+        ptp->is_broker = is_broker;
+        ptp->is_null = is_null;
+        ptp->sg_version = sg_version;
+        ptp->async_pack_id_forced = pack_id_forced;
         ptp->nvme_direct = false;
         ptp->nvme_nsid = nvme_nsid;
+        ptp->nvme_lbads = nvme_lbads;
+        ptp->nvme_dev_key = nvme_dev_key;
         ptp->dev_stat = dev_stat;
+        ptp->use_uring = use_uring;
+        ptp->mmap_bp = mmap_bp;
+        ptp->mmap_len = mmap_len;
+        ptp->uringp = uringp;
+    }
+}
+
+/* Keeps everything clear_scsi_pt_obj() does plus the sense and data
+ * buffer bindings, so only the cdb and the result fields are reset. */
+void
+rearm_scsi_pt_obj(struct sg_pt_base * vp)
+{
+    uint32_t n;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_io_v4 * hp = &ptp->io_hdr;
+
+    if (ptp->uring_inflight)    /* unreaped completion would confuse */
+        sg_nvme_uring_free(ptp);
+    sg_bsg_q_drain(ptp);
+    if (hp->response && (hp->response_len > 0)) {
+        n = (hp->response_len < hp->max_response_len) ? hp->response_len :
+                                                        hp->max_response_len;
+        memset((uint8_t *)(sg_uintptr_t)hp->response, 0, n);
     }
+    hp->request = 0;
+    hp->request_len = 0;
+    hp->driver_status = 0;
+    hp->transport_status = 0;
+    hp->device_status = 0;
+    hp->retry_delay = 0;
+    hp->info = 0;
+    hp->duration = 0;
+    hp->response_len = 0;
+    hp->din_resid = 0;
+    hp->dout_resid = 0;
+    hp->generated_tag = 0;
+    hp->spare_out = 0;
+    ptp->in_err = 0;
+    ptp->os_err = 0;
+    ptp->null_inflight = false;
+    ptp->nvme_direct = false;
+    ptp->nvme_stat_dnr = false;
+    ptp->nvme_stat_more = false;
+    ptp->nvme_result = 0;
+    ptp->nvme_status = 0;
+    ptp->sinfo_done = false;
 }
 
 #ifndef SG_SET_GET_EXTENDED
@@ -507,6 +990,45 @@ struct sg_extended_info {
 
 #endif
 
+/* sg v4 driver request sharing, this may not be in older sg.h headers */
+#ifndef SG_SEIM_SHARE_FD
+#define SG_SEIM_SHARE_FD        0x20
+#endif
+#ifndef SG_CTL_FLAGM_UNSHARE
+#define SG_CTL_FLAGM_UNSHARE    0x80
+#endif
+#ifndef SG_CTL_FLAGM_MASTER_FINI
+#define SG_CTL_FLAGM_MASTER_FINI 0x100
+#endif
+#ifndef SGV4_FLAG_SHARE
+#define SGV4_FLAG_SHARE 0x2000
+#endif
+#ifndef SGV4_FLAG_NO_DXFER
+#define SGV4_FLAG_NO_DXFER 0x10000
+#endif
+
+#ifndef SG_IOSUBMIT
+#define SG_IOSUBMIT _IOWR(0x22, 0x41, struct sg_io_v4)
+#endif
+#ifndef SG_IORECEIVE
+#define SG_IORECEIVE _IOWR(0x22, 0x42, struct sg_io_v4)
+#endif
+#ifndef SGV4_FLAG_MMAP_IO
+#define SGV4_FLAG_MMAP_IO 0x4
+#endif
+#ifndef SGV4_FLAG_IMMED
+#define SGV4_FLAG_IMMED 0x400
+#endif
+#ifndef SGV4_FLAG_HIPRI
+#define SGV4_FLAG_HIPRI 0x800   /* completion polled with blk_poll() */
+#endif
+#ifndef SGV4_FLAG_MULTIPLE_REQS
+#define SGV4_FLAG_MULTIPLE_REQS 0x20000
+#endif
+#ifndef SG_INFO_MRQ_FINI
+#define SG_INFO_MRQ_FINI 0x20
+#endif
+
 /* Forget any previous dev_fd and install the one given. May attempt to
  * find file type (e.g. if pass-though) from OS so there could be an error.
  * Returns 0 for success or the same value as get_scsi_pt_os_err()
@@ -517,15 +1039,38 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_fd, int verbose)
     struct sg_pt_linux_scsi * ptp = &vp->impl;
     struct stat a_stat;
 
+    memset(&a_stat, 0, sizeof(a_stat));
     if (! sg_bsg_nvme_char_major_checked) {
         sg_bsg_nvme_char_major_checked = true;
         sg_find_bsg_nvme_char_major(verbose);
     }
+#if (HAVE_NVME && (! IGNORE_NVME))
+    /* SNTL state belongs to the device, so start afresh */
+    sntl_init_dev_stat(&ptp->dev_stat);
+    if (! checked_ev_dsense) {
+        ev_dsense = sg_get_initial_dsense();
+        checked_ev_dsense = true;
+    }
+    ptp->dev_stat.scsi_dsense = ev_dsense;
+    ptp->nvme_lbads = 0;
+#endif
+    sg_nvme_id_cache_put(ptp);
+    ptp->nvme_dev_key = 0;
+    if (dev_fd != ptp->dev_fd)
+        sg_pt_linux_munmap(ptp);        /* mapping belongs to old fd */
     ptp->dev_fd = dev_fd;
     if (dev_fd >= 0) {
         ptp->is_sg = check_file_type(dev_fd, &a_stat, &ptp->is_bsg,
                                      &ptp->is_nvme, &ptp->nvme_nsid,
                                      &ptp->os_err, verbose);
+        if (ptp->is_nvme)
+            ptp->nvme_dev_key = sg_nvme_dev_key(&a_stat);
+        ptp->is_broker = S_ISSOCK(a_stat.st_mode);
+        ptp->is_null = sg_pt_null_is_fd(dev_fd);
+        /* io_uring pass-through (IORING_OP_URING_CMD) is only offered by
+         * the NVMe char devices; the sg driver uses SG_IOSUBMIT instead */
+        ptp->use_uring = ptp->is_nvme && S_ISCHR(a_stat.st_mode) &&
+                         (NULL != getenv("SG3_UTILS_LINUX_URING"));
         if (ptp->is_sg && (! sg_checked_version_num)) {
             if (ioctl(dev_fd, SG_GET_VERSION_NUM, &ptp->sg_version) < 0) {
                 ptp->sg_version = 0;
@@ -590,6 +1135,7 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_fd, int verbose)
         ptp->is_nvme = false;
         ptp->nvme_direct = false;
         ptp->nvme_nsid = 0;
+        ptp->use_uring = false;
         ptp->os_err = 0;
     }
     return ptp->os_err;
@@ -636,6 +1182,7 @@ set_scsi_pt_sense(struct sg_pt_base * vp, uint8_t * sense,
     memset(sense, 0, max_sense_len);
     ptp->io_hdr.response = (__u64)(sg_uintptr_t)sense;
     ptp->io_hdr.max_response_len = max_sense_len;
+    ptp->sinfo_done = false;
 }
 
 /* Setup for data transfer from device */
@@ -668,6 +1215,90 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* The sg driver lets its reserved buffer be mmap()-ed; a command with
+ * SG_FLAG_MMAP_IO set then uses that buffer for its data. The flag is
+ * applied (by sg_pt_linux_mmap_io() ) to any data-in command whose buffer
+ * is this mapping. */
+uint8_t *
+set_scsi_pt_data_in_mmap(struct sg_pt_base * vp, int dxfer_ilen,
+                         int verbose)
+{
+    int fd, rsv_sz;
+    void * p;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    fd = ptp->dev_fd;
+    if ((fd < 0) || (! ptp->is_sg) || (dxfer_ilen <= 0)) {
+        if (verbose > 2)
+            pr2ws("%s: needs sg device and positive length\n", __func__);
+        return NULL;
+    }
+    if (ptp->mmap_bp && (dxfer_ilen <= ptp->mmap_len)) {
+        set_scsi_pt_data_in(vp, ptp->mmap_bp, dxfer_ilen);
+        return ptp->mmap_bp;
+    }
+    sg_pt_linux_munmap(ptp);
+    if (ioctl(fd, SG_GET_RESERVED_SIZE, &rsv_sz) < 0)
+        rsv_sz = 0;
+    if (rsv_sz < dxfer_ilen) {
+        rsv_sz = dxfer_ilen;
+        if ((ioctl(fd, SG_SET_RESERVED_SIZE, &rsv_sz) < 0) ||
+            (ioctl(fd, SG_GET_RESERVED_SIZE, &rsv_sz) < 0))
+            rsv_sz = 0;
+        if (rsv_sz < dxfer_ilen) {
+            if (verbose)
+                pr2ws("%s: sg reserved buffer only %d bytes, wanted %d\n",
+                      __func__, rsv_sz, dxfer_ilen);
+            return NULL;
+        }
+    }
+    p = mmap(NULL, rsv_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == p) {
+        if (verbose)
+            pr2ws("%s: mmap() failed: %s\n", __func__, safe_strerror(errno));
+        return NULL;
+    }
+    ptp->mmap_bp = (uint8_t *)p;
+    ptp->mmap_len = rsv_sz;
+    set_scsi_pt_data_in(vp, ptp->mmap_bp, dxfer_ilen);
+    return ptp->mmap_bp;
+}
+
+/* The sg driver (v3 and v4 interfaces), the block layer's SG_IO and newer
+ * bsg drivers accept a scatter gather list in place of the data buffer;
+ * for NVMe devices do_scsi_pt() bounces the data instead. */
+void
+set_scsi_pt_data_in_iov(struct sg_pt_base * vp,
+                        const struct sg_pt_iovec * iovp, int iov_count)
+{
+    int len = sg_pt_iov_len(iovp, iov_count);
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if (ptp->io_hdr.din_xferp || (len < 0))
+        ++ptp->in_err;
+    if (len > 0) {
+        ptp->io_hdr.din_xferp = (__u64)(sg_uintptr_t)iovp;
+        ptp->io_hdr.din_xfer_len = len;
+        ptp->io_hdr.din_iovec_count = iov_count;
+    }
+}
+
+void
+set_scsi_pt_data_out_iov(struct sg_pt_base * vp,
+                         const struct sg_pt_iovec * iovp, int iov_count)
+{
+    int len = sg_pt_iov_len(iovp, iov_count);
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if (ptp->io_hdr.dout_xferp || (len < 0))
+        ++ptp->in_err;
+    if (len > 0) {
+        ptp->io_hdr.dout_xferp = (__u64)(sg_uintptr_t)iovp;
+        ptp->io_hdr.dout_xfer_len = len;
+        ptp->io_hdr.dout_iovec_count = iov_count;
+    }
+}
+
 void
 set_pt_metadata_xfer(struct sg_pt_base * vp, uint8_t * dxferp,
                      uint32_t dxfer_len, bool out_true)
@@ -697,6 +1328,21 @@ set_scsi_pt_tag(struct sg_pt_base * vp, uint64_t tag)
     ptp->io_hdr.request_tag = tag;
 }
 
+/* The transport specific request goes where the cdb would; the frames
+ * themselves are the data-out and data-in buffers */
+void
+set_scsi_pt_transport_req(struct sg_pt_base * vp, const uint8_t * reqp,
+                          int req_len)
+{
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if (ptp->io_hdr.request)
+        ++ptp->in_err;
+    ptp->io_hdr.subprotocol = BSG_SUB_PROTOCOL_SCSI_TRANSPORT;
+    ptp->io_hdr.request = (__u64)(sg_uintptr_t)reqp;
+    ptp->io_hdr.request_len = req_len;
+}
+
 /* Note that task management function codes are transport specific */
 void
 set_scsi_pt_task_management(struct sg_pt_base * vp, int tmf_code)
@@ -726,6 +1372,9 @@ set_scsi_pt_task_attr(struct sg_pt_base * vp, int attribute, int priority)
 #endif
 
 /* Need this later if translated to v3 interface */
+#ifndef SG_FLAG_MMAP_IO
+#define SG_FLAG_MMAP_IO 0x4
+#endif
 #ifndef SG_FLAG_Q_AT_TAIL
 #define SG_FLAG_Q_AT_TAIL 0x10
 #endif
@@ -747,6 +1396,34 @@ set_scsi_pt_flags(struct sg_pt_base * vp, int flags)
         ptp->io_hdr.flags |= BSG_FLAG_Q_AT_TAIL;
         ptp->io_hdr.flags &= ~BSG_FLAG_Q_AT_HEAD;
     }
+    if (SCSI_PT_FLAGS_HIPRI & flags)
+        ptp->hipri = true;      /* applied when the device is known */
+}
+
+/* True when the data-in buffer is the mmap()-ed sg reserved buffer */
+static bool
+sg_pt_linux_mmap_io(const struct sg_pt_linux_scsi * ptp)
+{
+    return ptp->mmap_bp && ptp->is_sg && (0 == ptp->io_hdr.dout_xfer_len) &&
+           (0 == ptp->io_hdr.din_iovec_count) &&
+           ((uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp == ptp->mmap_bp) &&
+           (ptp->io_hdr.din_xfer_len <= (uint32_t)ptp->mmap_len);
+}
+
+/* Only the sg v4 driver knows SGV4_FLAG_HIPRI and SGV4_FLAG_MMAP_IO, they
+ * would confuse bsg */
+static void
+sg_pt_linux_set_sg_v4_flags(struct sg_pt_linux_scsi * ptp)
+{
+    if (ptp->hipri && ptp->is_sg &&
+        (ptp->sg_version >= SG_LINUX_SG_VER_V4_HIPRI))
+        ptp->io_hdr.flags |= SGV4_FLAG_HIPRI;
+    else
+        ptp->io_hdr.flags &= ~SGV4_FLAG_HIPRI;
+    if (sg_pt_linux_mmap_io(ptp))
+        ptp->io_hdr.flags |= SGV4_FLAG_MMAP_IO;
+    else
+        ptp->io_hdr.flags &= ~SGV4_FLAG_MMAP_IO;
 }
 
 /* If supported it is the number of bytes requested to transfer less the
@@ -850,6 +1527,45 @@ get_scsi_pt_sense_buf(const struct sg_pt_base * vp)
     return (uint8_t *)ptp->io_hdr.response;
 }
 
+/* Decodes the sense buffer the first time it is asked for after a
+ * completion; a changed response_len (e.g. sense built later by the SNTL)
+ * forces another decode. */
+static struct sg_pt_linux_scsi *
+sense_info_load(const struct sg_pt_base * vp)
+{
+    struct sg_pt_linux_scsi * ptp = (struct sg_pt_linux_scsi *)&vp->impl;
+    const struct sg_io_v4 * hp = &ptp->io_hdr;
+    int slen = (int)hp->response_len;
+
+    if (ptp->sinfo_done && (slen == ptp->sinfo_len))
+        return ptp;
+    if ((slen > (int)hp->max_response_len) && (hp->max_response_len > 0))
+        slen = hp->max_response_len;
+    ptp->sinfo_ok = (hp->response && (slen > 0)) ?
+                    sg_scsi_decode_sense((const uint8_t *)
+                                        (sg_uintptr_t)hp->response, slen,
+                                         &ptp->sinfo) : false;
+    ptp->sinfo_cat = ptp->sinfo_ok ? sg_err_category_sinfo(&ptp->sinfo) :
+                                     SG_LIB_CAT_SENSE;
+    ptp->sinfo_len = (int)hp->response_len;
+    ptp->sinfo_done = true;
+    return ptp;
+}
+
+const struct sg_scsi_sense_info *
+get_scsi_pt_sense_info(const struct sg_pt_base * vp)
+{
+    const struct sg_pt_linux_scsi * ptp = sense_info_load(vp);
+
+    return ptp->sinfo_ok ? &ptp->sinfo : NULL;
+}
+
+int
+get_scsi_pt_sense_category(const struct sg_pt_base * vp)
+{
+    return sense_info_load(vp)->sinfo_cat;
+}
+
 int
 get_scsi_pt_duration_ms(const struct sg_pt_base * vp)
 {
@@ -995,50 +1711,81 @@ get_pt_nvme_nsid(const struct sg_pt_base * vp)
     return ptp->nvme_nsid;
 }
 
-/* Executes SCSI command using sg v3 interface */
+/* Converts the sg v4 header held in ptp into the sg v3 header pointed to
+ * by hp. Returns 0 if okay, else SCSI_PT_DO_BAD_PARAMS . */
 static int
-do_scsi_pt_v3(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
-              int verbose)
+sg_v4h_to_v3h(const struct sg_pt_linux_scsi * ptp, struct sg_io_hdr * hp,
+              int time_secs, int verbose)
 {
-    struct sg_io_hdr v3_hdr;
-
-    memset(&v3_hdr, 0, sizeof(v3_hdr));
+    memset(hp, 0, sizeof(*hp));
     /* convert v4 to v3 header */
-    v3_hdr.interface_id = 'S';
-    v3_hdr.dxfer_direction = SG_DXFER_NONE;
-    v3_hdr.cmdp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
-    v3_hdr.cmd_len = (uint8_t)ptp->io_hdr.request_len;
+    hp->interface_id = 'S';
+    hp->dxfer_direction = SG_DXFER_NONE;
+    hp->cmdp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+    hp->cmd_len = (uint8_t)ptp->io_hdr.request_len;
     if (ptp->io_hdr.din_xfer_len > 0) {
         if (ptp->io_hdr.dout_xfer_len > 0) {
             if (verbose)
                 pr2ws("sgv3 doesn't support bidi\n");
             return SCSI_PT_DO_BAD_PARAMS;
         }
-        v3_hdr.dxferp = (void *)(long)ptp->io_hdr.din_xferp;
-        v3_hdr.dxfer_len = (unsigned int)ptp->io_hdr.din_xfer_len;
-        v3_hdr.dxfer_direction =  SG_DXFER_FROM_DEV;
+        hp->dxferp = (void *)(long)ptp->io_hdr.din_xferp;
+        hp->dxfer_len = (unsigned int)ptp->io_hdr.din_xfer_len;
+        hp->iovec_count = (unsigned short)ptp->io_hdr.din_iovec_count;
+        hp->dxfer_direction =  SG_DXFER_FROM_DEV;
     } else if (ptp->io_hdr.dout_xfer_len > 0) {
-        v3_hdr.dxferp = (void *)(long)ptp->io_hdr.dout_xferp;
-        v3_hdr.dxfer_len = (unsigned int)ptp->io_hdr.dout_xfer_len;
-        v3_hdr.dxfer_direction =  SG_DXFER_TO_DEV;
+        hp->dxferp = (void *)(long)ptp->io_hdr.dout_xferp;
+        hp->dxfer_len = (unsigned int)ptp->io_hdr.dout_xfer_len;
+        hp->iovec_count = (unsigned short)ptp->io_hdr.dout_iovec_count;
+        hp->dxfer_direction =  SG_DXFER_TO_DEV;
     }
     if (ptp->io_hdr.response && (ptp->io_hdr.max_response_len > 0)) {
-        v3_hdr.sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
-        v3_hdr.mx_sb_len = (uint8_t)ptp->io_hdr.max_response_len;
+        hp->sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+        hp->mx_sb_len = (uint8_t)ptp->io_hdr.max_response_len;
     }
-    v3_hdr.pack_id = (int)ptp->io_hdr.request_extra;
+    hp->pack_id = (int)ptp->io_hdr.request_extra;
     if (BSG_FLAG_Q_AT_HEAD & ptp->io_hdr.flags)
-        v3_hdr.flags |= SG_FLAG_Q_AT_HEAD;      /* favour AT_HEAD */
+        hp->flags |= SG_FLAG_Q_AT_HEAD;      /* favour AT_HEAD */
     else if (BSG_FLAG_Q_AT_TAIL & ptp->io_hdr.flags)
-        v3_hdr.flags |= SG_FLAG_Q_AT_TAIL;
+        hp->flags |= SG_FLAG_Q_AT_TAIL;
+    if (sg_pt_linux_mmap_io(ptp))
+        hp->flags |= SG_FLAG_MMAP_IO;
 
-    if (NULL == v3_hdr.cmdp) {
+    if (NULL == hp->cmdp) {
         if (verbose)
             pr2ws("No SCSI command (cdb) given [v3]\n");
         return SCSI_PT_DO_BAD_PARAMS;
     }
-    /* io_hdr.timeout is in milliseconds, if greater than zero */
-    v3_hdr.timeout = ((time_secs > 0) ? (time_secs * 1000) : DEF_TIMEOUT);
+    /* io_hdr.timeout is in milliseconds */
+    hp->timeout = sg_pt_timeout_ms(time_secs, DEF_TIMEOUT);
+    return 0;
+}
+
+/* Transfers the output fields of a completed sg v3 header back into the
+ * sg v4 header held in ptp. */
+static void
+sg_v3h_to_v4h(struct sg_pt_linux_scsi * ptp, const struct sg_io_hdr * hp)
+{
+    ptp->io_hdr.device_status = (__u32)hp->status;
+    ptp->io_hdr.driver_status = (__u32)hp->driver_status;
+    ptp->io_hdr.transport_status = (__u32)hp->host_status;
+    ptp->io_hdr.response_len = (__u32)hp->sb_len_wr;
+    ptp->io_hdr.duration = (__u32)hp->duration;
+    ptp->io_hdr.din_resid = (__s32)hp->resid;
+    /* v3_hdr.info not passed back since no mapping defined (yet) */
+}
+
+/* Executes SCSI command using sg v3 interface */
+static int
+do_scsi_pt_v3(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
+              int verbose)
+{
+    int res;
+    struct sg_io_hdr v3_hdr;
+
+    res = sg_v4h_to_v3h(ptp, &v3_hdr, time_secs, verbose);
+    if (res)
+        return res;
     /* Finally do the v3 SG_IO ioctl */
     if (ioctl(fd, SG_IO, &v3_hdr) < 0) {
         ptp->os_err = errno;
@@ -1047,13 +1794,7 @@ do_scsi_pt_v3(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
                   safe_strerror(ptp->os_err), ptp->os_err);
         return -ptp->os_err;
     }
-    ptp->io_hdr.device_status = (__u32)v3_hdr.status;
-    ptp->io_hdr.driver_status = (__u32)v3_hdr.driver_status;
-    ptp->io_hdr.transport_status = (__u32)v3_hdr.host_status;
-    ptp->io_hdr.response_len = (__u32)v3_hdr.sb_len_wr;
-    ptp->io_hdr.duration = (__u32)v3_hdr.duration;
-    ptp->io_hdr.din_resid = (__s32)v3_hdr.resid;
-    /* v3_hdr.info not passed back since no mapping defined (yet) */
+    sg_v3h_to_v4h(ptp, &v3_hdr);
     return 0;
 }
 
@@ -1067,8 +1808,9 @@ do_scsi_pt_v4(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
             pr2ws("No SCSI command (cdb) given [v4]\n");
         return SCSI_PT_DO_BAD_PARAMS;
     }
-    /* io_hdr.timeout is in milliseconds, if greater than zero */
-    ptp->io_hdr.timeout = ((time_secs > 0) ? (time_secs * 1000) : DEF_TIMEOUT);
+    /* io_hdr.timeout is in milliseconds */
+    ptp->io_hdr.timeout = sg_pt_timeout_ms(time_secs, DEF_TIMEOUT);
+    sg_pt_linux_set_sg_v4_flags(ptp);
     if (ioctl(fd, SG_IO, &ptp->io_hdr) < 0) {
         ptp->os_err = errno;
         if (verbose > 1)
@@ -1079,11 +1821,13 @@ do_scsi_pt_v4(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
     return 0;
 }
 
-/* Executes SCSI command (or at least forwards it to lower layers).
- * Returns 0 for success, negative numbers are negated 'errno' values from
- * OS system calls. Positive return values are errors from this package. */
-int
-do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+/* Common checks made before a command is forwarded to the lower layers.
+ * Reconciles 'fd' with the file descriptor held in the object and, if
+ * needed, determines the file type. Returns 0 if the command can proceed
+ * with *fdp set to the file descriptor to use; otherwise returns a value
+ * suitable as the return value of do_scsi_pt(). */
+static int
+do_scsi_pt_prepare(struct sg_pt_base * vp, int fd, int * fdp, int verbose)
 {
     int err;
     struct sg_pt_linux_scsi * ptp = &vp->impl;
@@ -1093,6 +1837,7 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
         sg_bsg_nvme_char_major_checked = true;
         sg_find_bsg_nvme_char_major(verbose);
     }
+    ptp->sinfo_done = false;
     if (ptp->in_err) {
         if (verbose)
             pr2ws("Replicated or unused set_scsi_pt... functions\n");
@@ -1119,8 +1864,134 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
     }
     if (ptp->os_err)
         return -ptp->os_err;
-    if (ptp->is_nvme)
+    if ((BSG_SUB_PROTOCOL_SCSI_TRANSPORT == ptp->io_hdr.subprotocol) &&
+        (! ptp->is_bsg)) {
+        if (verbose)
+            pr2ws("%s: transport request needs a bsg transport node\n",
+                  __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    *fdp = fd;
+    return 0;
+}
+
+/* The NVMe pass-through ioctls (and the SNTL) want one contiguous data
+ * buffer, so bounce the scatter gather list(s) through one each way. The
+ * object's data fields are restored before returning. */
+static int
+sg_pt_linux_nvme_iov(struct sg_pt_base * vp, int time_secs, int verbose)
+{
+    int res, n;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_pt_iovec * din_iovp = NULL;
+    struct sg_pt_iovec * dout_iovp = NULL;
+    uint32_t din_cnt = ptp->io_hdr.din_iovec_count;
+    uint32_t dout_cnt = ptp->io_hdr.dout_iovec_count;
+    uint8_t * bp;
+    uint8_t * dinp = NULL;
+    uint8_t * free_dinp = NULL;
+    uint8_t * free_doutp = NULL;
+
+    if (din_cnt > 0) {
+        din_iovp = (struct sg_pt_iovec *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        dinp = sg_memalign(ptp->io_hdr.din_xfer_len, 0, &free_dinp, false);
+        if (NULL == dinp)
+            goto nomem;
+        ptp->io_hdr.din_xferp = (__u64)(sg_uintptr_t)dinp;
+        ptp->io_hdr.din_iovec_count = 0;
+    }
+    if (dout_cnt > 0) {
+        dout_iovp = (struct sg_pt_iovec *)
+                        (sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        bp = sg_memalign(ptp->io_hdr.dout_xfer_len, 0, &free_doutp, false);
+        if (NULL == bp)
+            goto nomem;
+        sg_pt_iov_gather(dout_iovp, dout_cnt, bp);
+        ptp->io_hdr.dout_xferp = (__u64)(sg_uintptr_t)bp;
+        ptp->io_hdr.dout_iovec_count = 0;
+    }
+    res = sg_do_nvme_pt(vp, -1, time_secs, verbose);
+    if (din_iovp) {
+        n = ptp->io_hdr.din_xfer_len - ptp->io_hdr.din_resid;
+        if ((0 == res) && (n > 0))
+            sg_pt_iov_scatter(din_iovp, din_cnt, dinp, n);
+    }
+    goto fini;
+nomem:
+    if (verbose)
+        pr2ws("%s: unable to get bounce buffer\n", __func__);
+    ptp->os_err = ENOMEM;
+    res = -ENOMEM;
+fini:
+    if (din_iovp) {
+        ptp->io_hdr.din_xferp = (__u64)(sg_uintptr_t)din_iovp;
+        ptp->io_hdr.din_iovec_count = din_cnt;
+    }
+    if (dout_iovp) {
+        ptp->io_hdr.dout_xferp = (__u64)(sg_uintptr_t)dout_iovp;
+        ptp->io_hdr.dout_iovec_count = dout_cnt;
+    }
+    if (free_dinp)
+        free(free_dinp);
+    if (free_doutp)
+        free(free_doutp);
+    return res;
+}
+
+/* Hands the command in ptp to the null device dev_fd. If wait is false
+ * the (injected) latency is left to do_scsi_pt_receive(). */
+static int
+sg_pt_linux_null_do(struct sg_pt_linux_scsi * ptp, bool wait, int verbose)
+{
+    int res;
+    struct sg_pt_null_cmd nc;
+
+    memset(&nc, 0, sizeof(nc));
+    nc.cdbp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+    nc.cdb_len = ptp->io_hdr.request_len;
+    nc.dinp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+    nc.din_len = ptp->io_hdr.din_xfer_len;
+    nc.din_iov_count = ptp->io_hdr.din_iovec_count;
+    nc.doutp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+    nc.dout_len = ptp->io_hdr.dout_xfer_len;
+    nc.dout_iov_count = ptp->io_hdr.dout_iovec_count;
+    nc.sensep = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+    nc.max_sense_len = ptp->io_hdr.max_response_len;
+    res = sg_pt_null_cmd(ptp->dev_fd, &nc, verbose);
+    if (res) {
+        ptp->os_err = -res;
+        return res;
+    }
+    ptp->io_hdr.device_status = nc.scsi_status;
+    ptp->io_hdr.response_len = nc.sense_len;
+    ptp->io_hdr.din_resid = nc.din_resid;
+    ptp->io_hdr.dout_resid = nc.dout_resid;
+    if (wait)
+        return sg_pt_null_wait(nc.done_ns, false);
+    ptp->null_done_ns = nc.done_ns;
+    ptp->null_inflight = true;
+    return 0;
+}
+
+/* Does the work of do_scsi_pt() */
+static int
+do_scsi_pt_com(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+{
+    int res;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    res = do_scsi_pt_prepare(vp, fd, &fd, verbose);
+    if (res)
+        return res;
+    if (ptp->is_broker)
+        return sg_broker_do(ptp, fd, time_secs, verbose);
+    if (ptp->is_null)
+        return sg_pt_linux_null_do(ptp, true, verbose);
+    if (ptp->is_nvme) {
+        if (ptp->io_hdr.din_iovec_count || ptp->io_hdr.dout_iovec_count)
+            return sg_pt_linux_nvme_iov(vp, time_secs, verbose);
         return sg_do_nvme_pt(vp, -1, time_secs, verbose);
+    }
     else if (ptp->is_sg) {
 #ifdef IGNORE_LINUX_SGV4
         return do_scsi_pt_v3(ptp, fd, time_secs, verbose);
@@ -1140,3 +2011,696 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
     pr2ws("%s: Should never reach this point\n", __func__);
     return 0;
 }
+
+/* Opcode of the command held by ptp (0x100 added for NVMe), as used by
+ * the latency histograms and static tracepoints. */
+static inline int
+sg_pt_linux_opcode(const struct sg_pt_linux_scsi * ptp)
+{
+    const uint8_t * cdbp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+
+    return cdbp ? (cdbp[0] | (ptp->nvme_direct ? 0x100 : 0)) : 0;
+}
+
+/* True when commands need to be timed: for the latency histograms, the
+ * command trace or an attached cmd__complete tracepoint. */
+static inline bool
+sg_pt_linux_timed(void)
+{
+    return sg_pt_lat_is_enabled() || sg_pt_trace_is_enabled() ||
+           SG_SDT_IS_ENABLED(cmd__complete);
+}
+
+#ifdef SG_LIB_SDT
+static void
+sg_pt_linux_sdt_submit(const struct sg_pt_linux_scsi * ptp, int fd)
+{
+    uint32_t num = 0;
+    uint64_t lba = 0;
+    const uint8_t * cdbp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+
+    if (NULL == cdbp)
+        return;
+    if (! ptp->nvme_direct)
+        sg_sdt_cdb_lba(cdbp, ptp->io_hdr.request_len, &lba, &num);
+    SG_SDT_PROBE5(cmd__submit, (fd >= 0) ? fd : ptp->dev_fd,
+                  sg_pt_linux_opcode(ptp), lba, num,
+                  ptp->io_hdr.din_xfer_len + ptp->io_hdr.dout_xfer_len);
+}
+
+static void
+sg_pt_linux_sdt_complete(const struct sg_pt_linux_scsi * ptp, int res,
+                         uint64_t dur_ns)
+{
+    uint32_t num = 0;
+    uint64_t lba = 0;
+    const uint8_t * cdbp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+
+    if (! ptp->nvme_direct)
+        sg_sdt_cdb_lba(cdbp, ptp->io_hdr.request_len, &lba, &num);
+    SG_SDT_PROBE7(cmd__complete, ptp->dev_fd, sg_pt_linux_opcode(ptp), lba,
+                  num, dur_ns, (ptp->nvme_direct ? ptp->nvme_status :
+                                                   ptp->io_hdr.device_status),
+                  res);
+}
+
+#define SG_PT_LINUX_SDT_SUBMIT(ptp, fd) do { \
+        if (SG_SDT_IS_ENABLED(cmd__submit)) \
+            sg_pt_linux_sdt_submit(ptp, fd); \
+    } while (0)
+#else
+#define SG_PT_LINUX_SDT_SUBMIT(ptp, fd) do { } while (0)
+#endif
+
+/* Adds the command just completed on ptp, which started at start_ns, to
+ * the latency histograms and the command trace, if they are enabled, and
+ * fires the cmd__complete tracepoint. Commands that were not issued are
+ * ignored, other than by the tracepoint. */
+static void
+sg_pt_linux_cmd_record(const struct sg_pt_linux_scsi * ptp, int res,
+                       uint64_t start_ns)
+{
+    uint64_t dur_ns;
+    const uint8_t * cdbp = (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request;
+
+    if ((NULL == cdbp) || (0 == start_ns))
+        return;
+    dur_ns = sg_pt_lat_now_ns() - start_ns;
+#ifdef SG_LIB_SDT
+    if (SG_SDT_IS_ENABLED(cmd__complete))
+        sg_pt_linux_sdt_complete(ptp, res, dur_ns);
+#endif
+    if (! (((0 == res) || (SCSI_PT_DO_NVME_STATUS == res)) &&
+           (ptp->dev_fd >= 0)))
+        return;
+    sg_pt_lat_record(ptp->dev_fd, sg_pt_linux_opcode(ptp), dur_ns);
+    if (sg_pt_trace_is_enabled())
+        sg_pt_trace_record(ptp->dev_fd, cdbp, (int)ptp->io_hdr.request_len,
+                           (int)ptp->io_hdr.din_xfer_len,
+                           (int)ptp->io_hdr.dout_xfer_len,
+                           ptp->nvme_direct ? SG_PT_TRACE_F_NVME : 0,
+                           start_ns, dur_ns,
+                           (int)(ptp->nvme_direct ? ptp->nvme_status :
+                                                    ptp->io_hdr.device_status),
+                           (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.response,
+                           (int)ptp->io_hdr.response_len);
+}
+
+/* Executes SCSI command (or at least forwards it to lower layers).
+ * Returns 0 for success, negative numbers are negated 'errno' values from
+ * OS system calls. Positive return values are errors from this package. */
+int
+do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+{
+    int res;
+    uint64_t start_ns;
+
+    SG_PT_LINUX_SDT_SUBMIT(&vp->impl, fd);
+    if (! sg_pt_linux_timed())
+        return do_scsi_pt_com(vp, fd, time_secs, verbose);
+    start_ns = sg_pt_lat_now_ns();
+    res = do_scsi_pt_com(vp, fd, time_secs, verbose);
+    sg_pt_linux_cmd_record(&vp->impl, res, start_ns);
+    return res;
+}
+
+/* Only the sg driver supports asynchronous submission. Its v3 interface
+ * uses write() and read(); the v4 interface uses the SG_IOSUBMIT and
+ * SG_IORECEIVE ioctls. bsg nodes are queued with write() where the kernel
+ * allows it (see sg_bsg_q_submit()). Other device types (NVMe and block
+ * devices) are executed synchronously at submit time. */
+static bool
+sg_pt_linux_async_ok(const struct sg_pt_linux_scsi * ptp)
+{
+    return ptp->is_sg && (! ptp->is_nvme);
+}
+
+#ifdef IGNORE_LINUX_SGV4
+static bool
+sg_pt_linux_async_v4(const struct sg_pt_linux_scsi * ptp
+                     __attribute__ ((unused)))
+{
+    return false;
+}
+#else
+static bool
+sg_pt_linux_async_v4(const struct sg_pt_linux_scsi * ptp)
+{
+    return (ptp->sg_version >= SG_LINUX_SG_VER_V4_BASE);
+}
+#endif
+
+/* Asks the sg driver to match responses by pack_id so that one file
+ * descriptor can have several commands in flight from different objects.
+ * Only needs to be done once per file descriptor but is harmless if
+ * repeated. */
+static void
+sg_pt_linux_force_pack_id(struct sg_pt_linux_scsi * ptp, int verbose)
+{
+    int one = 1;
+
+    if (ptp->async_pack_id_forced)
+        return;
+    if (ioctl(ptp->dev_fd, SG_SET_FORCE_PACK_ID, &one) < 0) {
+        if (verbose > 2)
+            pr2ws("%s: ioctl(SG_SET_FORCE_PACK_ID) failed: %s\n", __func__,
+                  safe_strerror(errno));
+    } else
+        ptp->async_pack_id_forced = true;
+}
+
+/* Queues the command in ptp on a bsg node (SCSI or transport) with
+ * write(). Returns 0 if queued, 1 if the caller should execute it
+ * synchronously instead, else a negated errno. Later kernels dropped the
+ * bsg write() and read() interface, after which SG_IO is used. */
+static int
+sg_bsg_q_submit(struct sg_pt_linux_scsi * ptp, int fd, int time_secs,
+                int verbose)
+{
+    int res, err;
+
+    if (0 == ptp->io_hdr.request) {
+        if (verbose)
+            pr2ws("No SCSI command (cdb) given [bsg submit]\n");
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    ptp->io_hdr.timeout = sg_pt_timeout_ms(time_secs, DEF_TIMEOUT);
+    sg_pt_linux_set_sg_v4_flags(ptp);
+    ptp->io_hdr.usr_ptr = (__u64)(sg_uintptr_t)ptp;
+    ptp->bsg_done = false;
+    if (! sg_bsg_q_add(ptp))
+        return 1;       /* too many queued, do this one now */
+    while ((res = write(fd, &ptp->io_hdr, sizeof(ptp->io_hdr))) < 0) {
+        if (EINTR != errno)
+            break;
+        SG_SDT_PROBE3(cmd__retry, fd, sg_pt_linux_opcode(ptp), EINTR);
+    }
+    if (res >= 0) {
+        ptp->bsg_inflight = true;
+        return 0;
+    }
+    err = errno;
+    sg_bsg_q_take(ptp, NULL);
+    switch (err) {
+    case EINVAL:
+    case ENOSYS:
+    case ENOTTY:
+    case EOPNOTSUPP:
+        __atomic_store_n(&sg_bsg_q_unsupported, true, __ATOMIC_RELAXED);
+        if (verbose > 2)
+            pr2ws("%s: bsg write() not supported: %s, use SG_IO\n",
+                  __func__, safe_strerror(err));
+        return 1;
+    case EBADF:         /* not opened O_RDWR */
+    case EAGAIN:        /* O_NONBLOCK and bsg queue full */
+        return 1;
+    default:
+        ptp->os_err = err;
+        if (verbose > 1)
+            pr2ws("write(bsg) failed: %s (errno=%d)\n",
+                  safe_strerror(err), err);
+        return -err;
+    }
+}
+
+/* Submits SCSI command without waiting for it to complete. Returns 0 for
+ * success, negative numbers are negated 'errno' values from OS system
+ * calls. Positive return values are errors from this package. NVMe
+ * commands (not SCSI cdbs) to NVMe char devices are queued with io_uring
+ * when the SG3_UTILS_LINUX_URING environment variable is set. */
+int
+do_scsi_pt_submit(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+{
+    int res;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_io_hdr v3_hdr;
+
+    res = do_scsi_pt_prepare(vp, fd, &fd, verbose);
+    if (res)
+        return res;
+    if (sg_pt_linux_timed())
+        ptp->lat_start_ns = sg_pt_lat_now_ns();
+    else
+        ptp->lat_start_ns = 0;
+    /* do_scsi_pt() fires its own cmd__submit tracepoint */
+    if (ptp->is_null) { /* its latency elapses until do_scsi_pt_receive() */
+        SG_PT_LINUX_SDT_SUBMIT(ptp, fd);
+        return sg_pt_linux_null_do(ptp, false, verbose);
+    }
+    if (ptp->use_uring) {
+        res = sg_nvme_uring_submit(vp, time_secs, verbose);
+        if (1 != res) { /* 1 means io_uring not applicable */
+            SG_PT_LINUX_SDT_SUBMIT(ptp, fd);
+            return res;
+        }
+    }
+    if (ptp->is_bsg && (! ptp->is_nvme) &&
+        (! __atomic_load_n(&sg_bsg_q_unsupported, __ATOMIC_RELAXED))) {
+        res = sg_bsg_q_submit(ptp, fd, time_secs, verbose);
+        if (1 != res) { /* 1 means run it synchronously */
+            if (0 == res)
+                SG_PT_LINUX_SDT_SUBMIT(ptp, fd);
+            return res;
+        }
+    }
+    if (! sg_pt_linux_async_ok(ptp))
+        return do_scsi_pt(vp, fd, time_secs, verbose);
+    SG_PT_LINUX_SDT_SUBMIT(ptp, fd);
+    if (0 == ptp->io_hdr.request) {
+        if (verbose)
+            pr2ws("No SCSI command (cdb) given [submit]\n");
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    sg_pt_linux_force_pack_id(ptp, verbose);
+    if (sg_pt_linux_async_v4(ptp)) {
+        ptp->io_hdr.timeout = sg_pt_timeout_ms(time_secs, DEF_TIMEOUT);
+        sg_pt_linux_set_sg_v4_flags(ptp);
+        while ((res = ioctl(fd, SG_IOSUBMIT, &ptp->io_hdr)) < 0) {
+            if (EINTR != errno)
+                break;
+            SG_SDT_PROBE3(cmd__retry, fd, sg_pt_linux_opcode(ptp), EINTR);
+        }
+        if (res < 0) {
+            ptp->os_err = errno;
+            if (verbose > 1)
+                pr2ws("ioctl(SG_IOSUBMIT) failed: %s (errno=%d)\n",
+                      safe_strerror(ptp->os_err), ptp->os_err);
+            return -ptp->os_err;
+        }
+        return 0;
+    }
+    res = sg_v4h_to_v3h(ptp, &v3_hdr, time_secs, verbose);
+    if (res)
+        return res;
+    while ((res = write(fd, &v3_hdr, sizeof(v3_hdr))) < 0) {
+        if (EINTR != errno)
+            break;
+        SG_SDT_PROBE3(cmd__retry, fd, sg_pt_linux_opcode(ptp), EINTR);
+    }
+    if (res < 0) {
+        ptp->os_err = errno;
+        if (verbose > 1)
+            pr2ws("write(sg v3) failed: %s (errno=%d)\n",
+                  safe_strerror(ptp->os_err), ptp->os_err);
+        return -ptp->os_err;
+    }
+    return 0;
+}
+
+/* Attempts to fetch the response of a command submitted on ptp, once.
+ * Returns 0 if fetched, -EAGAIN if not yet available, else returns a
+ * negated errno. The v3 read() blocks when dev_fd is a blocking file
+ * descriptor so if no_wait is true poll() first to see if it would. */
+static int
+sg_pt_linux_receive_once(struct sg_pt_linux_scsi * ptp, bool no_wait,
+                         int verbose)
+{
+    int res, err;
+    int fd = ptp->dev_fd;
+    struct sg_io_hdr v3_hdr;
+    struct pollfd a_poll;
+
+    if (sg_pt_linux_async_v4(ptp)) {
+        uint32_t flags = ptp->io_hdr.flags;
+
+        ptp->io_hdr.flags |= SGV4_FLAG_IMMED;
+        while ((res = ioctl(fd, SG_IORECEIVE, &ptp->io_hdr)) < 0) {
+            if (EINTR != errno)
+                break;
+            SG_SDT_PROBE3(cmd__retry, fd, sg_pt_linux_opcode(ptp), EINTR);
+        }
+        err = (res < 0) ? errno : 0;
+        ptp->io_hdr.flags = flags;
+    } else {
+        if (no_wait) {
+            a_poll.fd = fd;
+            a_poll.events = POLLIN;
+            a_poll.revents = 0;
+            res = poll(&a_poll, 1, 0);
+            if (res < 0) {
+                if (EINTR == errno)
+                    return -EAGAIN;
+                ptp->os_err = errno;
+                return -ptp->os_err;
+            } else if (0 == res)
+                return -EAGAIN;
+        }
+        memset(&v3_hdr, 0, sizeof(v3_hdr));
+        v3_hdr.interface_id = 'S';
+        v3_hdr.pack_id = (int)ptp->io_hdr.request_extra;
+        while ((res = read(fd, &v3_hdr, sizeof(v3_hdr))) < 0) {
+            if (EINTR != errno)
+                break;
+            SG_SDT_PROBE3(cmd__retry, fd, sg_pt_linux_opcode(ptp), EINTR);
+        }
+        err = (res < 0) ? errno : 0;
+        if (0 == err)
+            sg_v3h_to_v4h(ptp, &v3_hdr);
+    }
+    if ((EAGAIN == err) || (EBUSY == err))
+        return -EAGAIN;
+    else if (err) {
+        ptp->os_err = err;
+        if (verbose > 1)
+            pr2ws("%s: %s failed: %s (errno=%d)\n", __func__,
+                  (sg_pt_linux_async_v4(ptp) ? "ioctl(SG_IORECEIVE)" :
+                                               "read(sg v3)"),
+                  safe_strerror(err), err);
+        return -err;
+    }
+    return 0;
+}
+
+/* Fetches the response of a command previously given to
+ * do_scsi_pt_submit() on the same object. Returns 0 for success, -EAGAIN
+ * if no_wait is true and the response is not yet available; other negative
+ * numbers are negated 'errno' values from OS system calls. A command
+ * submitted with SGV4_FLAG_HIPRI is completed by the driver polling in
+ * each SG_IORECEIVE, so this function then spins instead of calling
+ * poll(). */
+int
+do_scsi_pt_receive(struct sg_pt_base * vp, bool no_wait, int verbose)
+{
+    bool other_ready = false;
+    int res, n;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct pollfd a_poll;
+
+    ptp->sinfo_done = false;
+    if (ptp->uring_inflight) {
+        res = sg_nvme_uring_receive(vp, no_wait, verbose);
+        if (ptp->lat_start_ns && (-EAGAIN != res))
+            sg_pt_linux_cmd_record(ptp, res, ptp->lat_start_ns);
+        return res;
+    }
+    if (ptp->null_inflight) {
+        res = sg_pt_null_wait(ptp->null_done_ns, no_wait);
+        if (-EAGAIN == res)
+            return res;
+        ptp->null_inflight = false;
+        if (ptp->lat_start_ns)
+            sg_pt_linux_cmd_record(ptp, res, ptp->lat_start_ns);
+        return res;
+    }
+    if (ptp->bsg_inflight) {
+        res = sg_bsg_q_receive(ptp, no_wait, verbose);
+        if (ptp->lat_start_ns && (-EAGAIN != res))
+            sg_pt_linux_cmd_record(ptp, res, ptp->lat_start_ns);
+        return res;
+    }
+    if (! sg_pt_linux_async_ok(ptp))
+        return ptp->os_err ? -ptp->os_err : 0;
+    if (ptp->dev_fd < 0) {
+        if (verbose)
+            pr2ws("%s: invalid file descriptor\n", __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    while (-EAGAIN ==
+           (res = sg_pt_linux_receive_once(ptp, no_wait, verbose))) {
+        if (no_wait)
+            break;
+        if (SGV4_FLAG_HIPRI & ptp->io_hdr.flags)
+            continue;
+        if (other_ready) {
+            /* POLLIN was for another object's response on this fd */
+            poll(NULL, 0, 1);   /* so sleep 1 millisecond */
+            other_ready = false;
+            continue;
+        }
+        a_poll.fd = ptp->dev_fd;
+        a_poll.events = POLLIN;
+        a_poll.revents = 0;
+        n = poll(&a_poll, 1, -1);
+        if ((n < 0) && (EINTR != errno)) {
+            ptp->os_err = errno;
+            return -ptp->os_err;
+        }
+        other_ready = (n > 0);
+    }
+    if (ptp->lat_start_ns && (-EAGAIN != res))
+        sg_pt_linux_cmd_record(ptp, res, ptp->lat_start_ns);
+    return res;
+}
+
+/* Set when the sg driver rejects a multiple requests (mrq) control object,
+ * after which batches fall back to submit and receive of each command. */
+static bool sg_mrq_unsupported = false;
+
+/* Issues the 'num' commands in objp_arr[] with one SG_IO ioctl() carrying
+ * a multiple requests control object, as supported by later versions of
+ * the sg v4 driver. Returns 0 if all commands were executed, 1 if the
+ * driver does not support mrq (nothing issued), else a negated errno. On
+ * return *np is the number of commands executed. */
+static int
+do_scsi_pt_mrq(struct sg_pt_base * objp_arr[], int num, int fd,
+               int time_secs, int * np, int verbose)
+{
+    int k, n, err;
+    struct sg_pt_linux_scsi * ptp;
+    struct sg_io_v4 * arr_v4;
+    struct sg_io_v4 ctl_v4;
+
+    *np = 0;
+    arr_v4 = (struct sg_io_v4 *)calloc(num, sizeof(struct sg_io_v4));
+    if (NULL == arr_v4) {
+        if (verbose)
+            pr2ws("%s: calloc() failed, out of memory?\n", __func__);
+        return -ENOMEM;
+    }
+    for (k = 0; k < num; ++k) {
+        ptp = &objp_arr[k]->impl;
+        ptp->io_hdr.timeout = sg_pt_timeout_ms(time_secs, DEF_TIMEOUT);
+        arr_v4[k] = ptp->io_hdr;
+    }
+    memset(&ctl_v4, 0, sizeof(ctl_v4));
+    ctl_v4.guard = 'Q';
+    ctl_v4.flags = SGV4_FLAG_MULTIPLE_REQS;
+    ctl_v4.dout_xferp = (__u64)(sg_uintptr_t)arr_v4;
+    ctl_v4.dout_xfer_len = num * sizeof(struct sg_io_v4);
+    ctl_v4.din_xferp = ctl_v4.dout_xferp;
+    ctl_v4.din_xfer_len = ctl_v4.dout_xfer_len;
+    if (ioctl(fd, SG_IO, &ctl_v4) < 0) {
+        err = errno;
+        free(arr_v4);
+        if ((EINVAL == err) || (ENOTTY == err) || (EOPNOTSUPP == err)) {
+            if (verbose > 2)
+                pr2ws("%s: sg driver lacks mrq support: %s\n", __func__,
+                      safe_strerror(err));
+            return 1;
+        }
+        if (verbose > 1)
+            pr2ws("ioctl(SG_IO, mrq) failed: %s (errno=%d)\n",
+                  safe_strerror(err), err);
+        for (k = 0; k < num; ++k)
+            objp_arr[k]->impl.os_err = err;
+        return -err;
+    }
+    /* ctl_v4.info is the number of requests the driver acted upon */
+    n = ((int)ctl_v4.info < num) ? (int)ctl_v4.info : num;
+    for (k = 0; k < n; ++k) {
+        ptp = &objp_arr[k]->impl;
+        ptp->io_hdr = arr_v4[k];
+        if ((verbose > 2) && (! (arr_v4[k].info & SG_INFO_MRQ_FINI)))
+            pr2ws("%s: k=%d: SG_INFO_MRQ_FINI not set on response\n",
+                  __func__, k);
+    }
+    free(arr_v4);
+    *np = n;
+    return 0;
+}
+
+/* Returns true if fd is a sg device whose driver can share requests */
+static bool
+sg_pt_linux_can_share(int fd, int verbose)
+{
+    int ver = 0;
+    struct stat a_stat;
+
+    if ((fstat(fd, &a_stat) < 0) || (! S_ISCHR(a_stat.st_mode)) ||
+        (SCSI_GENERIC_MAJOR != (int)major(a_stat.st_rdev)))
+        return false;
+    if ((ioctl(fd, SG_GET_VERSION_NUM, &ver) < 0) ||
+        (ver < SG_LINUX_SG_VER_V4_FULL)) {
+        if (verbose > 1)
+            pr2ws("%s: fd=%d sg driver version %d, need %d or later\n",
+                  __func__, fd, ver, SG_LINUX_SG_VER_V4_FULL);
+        return false;
+    }
+    return true;
+}
+
+/* Writes the boolean 'ctl_flag' (SG_CTL_FLAGM_*) as true on fd */
+static int
+sg_pt_linux_set_ctl_flag(int fd, uint32_t ctl_flag, int verbose)
+{
+    int err;
+    struct sg_extended_info sei;
+
+    memset(&sei, 0, sizeof(sei));
+    sei.sei_wr_mask = SG_SEIM_CTL_FLAGS;
+    sei.ctl_flags_wr_mask = ctl_flag;
+    sei.ctl_flags = ctl_flag;
+    if (ioctl(fd, SG_SET_GET_EXTENDED, &sei) < 0) {
+        err = errno;
+        if (verbose)
+            pr2ws("%s: ioctl(SG_SET_GET_EXTENDED, ctl_flag=0x%x) failed: "
+                  "%s\n", __func__, ctl_flag, safe_strerror(err));
+        return -err;
+    }
+    return 0;
+}
+
+int
+scsi_pt_share_fds(int rd_fd, int wr_fd, int verbose)
+{
+    int err;
+    struct sg_extended_info sei;
+
+    if ((rd_fd < 0) || (wr_fd < 0) || (rd_fd == wr_fd))
+        return SCSI_PT_DO_BAD_PARAMS;
+    if (! (sg_pt_linux_can_share(rd_fd, verbose) &&
+           sg_pt_linux_can_share(wr_fd, verbose)))
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    memset(&sei, 0, sizeof(sei));
+    sei.sei_wr_mask = SG_SEIM_SHARE_FD;
+    sei.sei_rd_mask = SG_SEIM_SHARE_FD;
+    sei.share_fd = rd_fd;
+    if (ioctl(wr_fd, SG_SET_GET_EXTENDED, &sei) < 0) {
+        err = errno;
+        if (verbose)
+            pr2ws("%s: ioctl(SG_SET_GET_EXTENDED, share_fd=%d) on fd=%d "
+                  "failed: %s\n", __func__, rd_fd, wr_fd,
+                  safe_strerror(err));
+        return -err;
+    }
+    if (verbose > 2)
+        pr2ws("%s: rd_fd=%d now shares with wr_fd=%d\n", __func__, rd_fd,
+              wr_fd);
+    return 0;
+}
+
+int
+scsi_pt_unshare_fds(int fd, int verbose)
+{
+    if (fd < 0)
+        return SCSI_PT_DO_BAD_PARAMS;
+    if (! sg_pt_linux_can_share(fd, verbose))
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    return sg_pt_linux_set_ctl_flag(fd, SG_CTL_FLAGM_UNSHARE, verbose);
+}
+
+int
+do_scsi_pt_shared_rw(struct sg_pt_base * rd_vp, struct sg_pt_base * wr_vp,
+                     int num_bytes, int time_secs, bool * wr_issuedp,
+                     int verbose)
+{
+    int res, fd;
+    struct sg_pt_linux_scsi * rptp = &rd_vp->impl;
+    struct sg_pt_linux_scsi * wptp = &wr_vp->impl;
+
+    if (wr_issuedp)
+        *wr_issuedp = false;
+    if ((num_bytes <= 0) || wptp->io_hdr.dout_xferp ||
+        wptp->io_hdr.dout_iovec_count || rptp->io_hdr.din_iovec_count) {
+        if (verbose)
+            pr2ws("%s: bad transfer length or buffer binding\n", __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    res = do_scsi_pt_prepare(rd_vp, -1, &fd, verbose);
+    if (0 == res)
+        res = do_scsi_pt_prepare(wr_vp, -1, &fd, verbose);
+    if (res)
+        return res;
+    /* sharing flags are lost if do_scsi_pt() falls back to sg v3 */
+    if (! (sg_pt_linux_async_v4(rptp) && sg_pt_linux_async_v4(wptp) &&
+           rptp->is_sg && (rptp->sg_version >= SG_LINUX_SG_VER_V4_FULL) &&
+           wptp->is_sg && (wptp->sg_version >= SG_LINUX_SG_VER_V4_FULL))) {
+        if (verbose)
+            pr2ws("%s: both sides need the sg v4 driver\n", __func__);
+        return SCSI_PT_DO_NOT_SUPPORTED;
+    }
+    rptp->io_hdr.flags |= SGV4_FLAG_SHARE;
+    if (0 == rptp->io_hdr.din_xferp) {  /* data stays in kernel */
+        rptp->io_hdr.din_xfer_len = num_bytes;
+        rptp->io_hdr.flags |= SGV4_FLAG_NO_DXFER;
+    } else if ((int)rptp->io_hdr.din_xfer_len != num_bytes) {
+        if (verbose)
+            pr2ws("%s: data-in buffer length differs from num_bytes\n",
+                  __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    res = do_scsi_pt(rd_vp, -1, time_secs, verbose);
+    if (res || (SCSI_PT_RESULT_GOOD != get_scsi_pt_result_category(rd_vp)) ||
+        (0 != rptp->io_hdr.din_resid)) {
+        /* release the buffer the driver holds for the write side */
+        sg_pt_linux_set_ctl_flag(rptp->dev_fd, SG_CTL_FLAGM_MASTER_FINI,
+                                 verbose);
+        return res;
+    }
+    wptp->io_hdr.flags |= (SGV4_FLAG_SHARE | SGV4_FLAG_NO_DXFER);
+    wptp->io_hdr.dout_xfer_len = num_bytes;
+    if (wr_issuedp)
+        *wr_issuedp = true;
+    return do_scsi_pt(wr_vp, -1, time_secs, verbose);
+}
+
+/* Issues the 'num' commands held in objp_arr[] and waits for all of them
+ * to complete. Returns 0 for success, negative numbers are negated 'errno'
+ * values from OS system calls. Positive return values are errors from this
+ * package. *num_donep (if given) is set to the number of objects issued. */
+int
+do_scsi_pt_batch(struct sg_pt_base * objp_arr[], int num, int time_secs,
+                 int * num_donep, int verbose)
+{
+    int k, j, res, fd;
+    int n = 0;
+    struct sg_pt_linux_scsi * ptp;
+
+    if (num_donep)
+        *num_donep = 0;
+    if ((NULL == objp_arr) || (num <= 0))
+        return (num < 0) ? SCSI_PT_DO_BAD_PARAMS : 0;
+    fd = objp_arr[0]->impl.dev_fd;
+    for (k = 0; k < num; ++k) {
+        res = do_scsi_pt_prepare(objp_arr[k], fd, &fd, verbose);
+        if (res)
+            return res;
+        ptp = &objp_arr[k]->impl;
+        if ((0 == ptp->io_hdr.request) && (! ptp->is_nvme)) {
+            if (verbose)
+                pr2ws("%s: No SCSI command (cdb) given for element %d\n",
+                      __func__, k);
+            return SCSI_PT_DO_BAD_PARAMS;
+        }
+    }
+    ptp = &objp_arr[0]->impl;
+    if ((num > 1) && sg_pt_linux_async_ok(ptp) &&
+        (ptp->sg_version >= SG_LINUX_SG_VER_V4_FULL) &&
+        (! sg_mrq_unsupported)) {
+        res = do_scsi_pt_mrq(objp_arr, num, fd, time_secs, &n, verbose);
+        if (res < 0)
+            return res;
+        else if (res > 0)
+            sg_mrq_unsupported = true;
+        if (n >= num) {
+            if (num_donep)
+                *num_donep = n;
+            return 0;
+        }
+    }
+    /* finish what mrq did not do: queue all, then collect responses */
+    for (k = n; k < num; ++k) {
+        res = do_scsi_pt_submit(objp_arr[k], fd, time_secs, verbose);
+        if (res)
+            break;
+    }
+    for (j = n; j < k; ++j) {
+        int r = do_scsi_pt_receive(objp_arr[j], false, verbose);
+
+        if (r && (0 == res))    /* report first failure */
+            res = r;
+    }
+    if (num_donep)
+        *num_donep = k;
+    return res;
+}
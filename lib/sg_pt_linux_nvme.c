@@ -41,7 +41,7 @@
  *                   MA 02110-1301, USA.
  */
 
-/* sg_pt_linux_nvme version 1.09 20190303 */
+/* sg_pt_linux_nvme version 1.10 20261014 */
 
 /* This file contains a small "SPC-only" SNTL to support the SES pass-through
  * of SEND DIAGNOSTIC and RECEIVE DIAGNOSTIC RESULTS through NVME-MI
@@ -73,6 +73,16 @@
 
 #include <linux/major.h>
 
+#if (HAVE_NVME && (! IGNORE_NVME)) && defined(HAVE_LINUX_IO_URING_H)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+/* IORING_SETUP_SQE128 arrived with IORING_OP_URING_CMD in lk 5.19 */
+#if defined(IORING_SETUP_SQE128) && defined(__NR_io_uring_setup)
+#define SG_PT_LINUX_URING 1
+#endif
+#endif
+
 #include "sg_pt.h"
 #include "sg_lib.h"
 #include "sg_linux_inc.h"
@@ -94,6 +104,14 @@
 #define SCSI_READ_CAPACITY10_OPC  0x25
 #define SCSI_SERVICE_ACT_IN_OPC  0x9e
 #define SCSI_READ_CAPACITY16_SA  0x10
+#define SCSI_READ10_OPC  0x28
+#define SCSI_WRITE10_OPC  0x2a
+#define SCSI_VERIFY10_OPC  0x2f
+#define SCSI_SYNC_CACHE10_OPC  0x35
+#define SCSI_READ16_OPC  0x88
+#define SCSI_WRITE16_OPC  0x8a
+#define SCSI_VERIFY16_OPC  0x8f
+#define SCSI_SYNC_CACHE16_OPC  0x91
 #define SCSI_SA_MSK  0x1f
 
 /* Additional Sense Code (ASC) */
@@ -104,6 +122,7 @@
 #define PARAMETER_LIST_LENGTH_ERR 0x1a
 #define INVALID_OPCODE 0x20
 #define LBA_OUT_OF_RANGE 0x21
+#define LOGICAL_UNIT_NOT_SUPPORTED 0x25
 #define INVALID_FIELD_IN_CDB 0x24
 #define INVALID_FIELD_IN_PARAM_LIST 0x26
 #define UA_RESET_ASC 0x29
@@ -125,6 +144,13 @@
 #define MICROCODE_CHANGED_ASCQ 0x1      /* with TARGET_CHANGED_ASC */
 #define MICROCODE_CHANGED_WO_RESET_ASCQ 0x16
 
+/* NVM command set opcodes, sent via NVME_IOCTL_IO_CMD */
+#define SG_NVME_NVM_FLUSH 0x0
+#define SG_NVME_NVM_WRITE 0x1
+#define SG_NVME_NVM_READ 0x2
+#define SG_NVME_NVM_COMPARE 0x5
+#define SG_NVME_NVM_VERIFY 0xc
+
 
 
 #if (HAVE_NVME && (! IGNORE_NVME))
@@ -268,26 +294,33 @@ mk_sense_invalid_fld(struct sg_pt_linux_scsi * ptp, bool in_cdb, int in_byte,
  * CDW0 from the completion queue is placed in ptp->nvme_result in the
  * absence of a Unix error. If time_secs is negative it is treated as
  * a timeout in milliseconds (of abs(time_secs) ). */
+static int sg_nvme_admin_fini(struct sg_pt_linux_scsi * ptp,
+                              const struct sg_nvme_passthru_cmd * cmdp,
+                              void * dp, bool is_read, bool is_admin,
+                              int res, int vb);
+
+/* Common code for NVMe Admin commands (when is_admin is true) and NVM
+ * (I/O) commands. The latter go to the namespace associated with the
+ * dev_fd (or to cmdp->nsid when dev_fd is a NVMe char device). */
 static int
-sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
-                  struct sg_nvme_passthru_cmd *cmdp, void * dp, bool is_read,
-                  int time_secs, int vb)
+sg_nvme_cmd_com(struct sg_pt_linux_scsi * ptp,
+                struct sg_nvme_passthru_cmd *cmdp, void * dp, bool is_read,
+                bool is_admin, int time_secs, int vb)
 {
     const uint32_t cmd_len = sizeof(struct sg_nvme_passthru_cmd);
     int res;
     uint32_t n;
-    uint16_t sct_sc;
     const uint8_t * up = ((const uint8_t *)cmdp) + SG_NVME_PT_OPCODE;
     char nam[64];
 
     if (vb)
-        sg_get_nvme_opcode_name(*up, true, sizeof(nam), nam);
+        sg_get_nvme_opcode_name(*up, is_admin, sizeof(nam), nam);
     else
         nam[0] = '\0';
     cmdp->timeout_ms = (time_secs < 0) ? (-time_secs) : (1000 * time_secs);
     ptp->os_err = 0;
     if (vb > 2) {
-        pr2ws("NVMe Admin command: %s\n", nam);
+        pr2ws("NVMe %s command: %s\n", (is_admin ? "Admin" : "NVM"), nam);
         hex2stderr((const uint8_t *)cmdp, cmd_len, 1);
         if ((vb > 3) && (! is_read) && dp) {
             uint32_t len = sg_get_unaligned_le32(up + SG_NVME_PT_DATA_LEN);
@@ -304,7 +337,39 @@ sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
             }
         }
     }
-    res = ioctl(ptp->dev_fd, NVME_IOCTL_ADMIN_CMD, cmdp);
+    res = ioctl(ptp->dev_fd, (is_admin ? NVME_IOCTL_ADMIN_CMD :
+                                         NVME_IOCTL_IO_CMD), cmdp);
+    return sg_nvme_admin_fini(ptp, cmdp, dp, is_read, is_admin, res, vb);
+}
+
+static int
+sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
+                  struct sg_nvme_passthru_cmd *cmdp, void * dp, bool is_read,
+                  int time_secs, int vb)
+{
+    return sg_nvme_cmd_com(ptp, cmdp, dp, is_read, true, time_secs, vb);
+}
+
+/* Post-processes the completion of an NVMe Admin command (or a NVM
+ * command when is_admin is false). 'res' is the value returned by
+ * ioctl(NVME_IOCTL_ADMIN_CMD) or from the res field of
+ * an io_uring completion (the two have the same semantics), while CDW0 of
+ * the completion is expected in cmdp->result . Return values as for
+ * sg_nvme_admin_cmd(). */
+static int
+sg_nvme_admin_fini(struct sg_pt_linux_scsi * ptp,
+                   const struct sg_nvme_passthru_cmd * cmdp, void * dp,
+                   bool is_read, bool is_admin, int res, int vb)
+{
+    uint32_t n;
+    uint16_t sct_sc;
+    const uint8_t * up = ((const uint8_t *)cmdp) + SG_NVME_PT_OPCODE;
+    char nam[64];
+
+    if (vb)
+        sg_get_nvme_opcode_name(*up, is_admin, sizeof(nam), nam);
+    else
+        nam[0] = '\0';
     if (res < 0) {  /* OS error (errno negated) */
         ptp->os_err = -res;
         if (vb > 1) {
@@ -346,6 +411,18 @@ sg_nvme_admin_cmd(struct sg_pt_linux_scsi * ptp,
         }
         return SG_LIB_NVME_STATUS;      /* == SCSI_PT_DO_NVME_STATUS */
     }
+    if (ptp->nvme_direct && is_admin) {
+        switch (*up) {
+        case 0x0d:      /* Namespace Management */
+        case 0x10:      /* Firmware Commit */
+        case 0x15:      /* Namespace Attachment */
+        case 0x80:      /* Format NVM */
+            sg_nvme_id_cache_flush();   /* Identify data may differ now */
+            break;
+        default:
+            break;
+        }
+    }
     if ((vb > 3) && is_read && dp) {
         uint32_t len = sg_get_unaligned_le32(up + SG_NVME_PT_DATA_LEN);
 
@@ -431,6 +508,252 @@ sntl_do_identify(struct sg_pt_linux_scsi * ptp, int cns, int nsid,
     return sg_nvme_admin_cmd(ptp, &cmd, up, true, time_secs, vb);
 }
 
+/* Process-wide cache of NVMe Identify responses shared (with reference
+ * counts) by all pt objects bound to the same NVMe device, keyed by
+ * ptp->nvme_dev_key. Linux does not pass Asynchronous Event Notifications
+ * to pass-through users so entries are invalidated by bumping a generation
+ * number: sg_nvme_id_cache_flush() does that, as do successful direct
+ * NVMe Admin commands that may change what Identify reports. Entries are
+ * kept once unreferenced so a later pt object can use them; stale ones are
+ * freed on their last put or when a new entry is added. The lock only
+ * covers list and reference count updates, never a command. */
+#if defined(__GNUC__) && (! defined(SG_LIB_NO_NVME_ID_CACHE))
+#define SG_NVME_ID_CACHE 1
+
+struct sg_nvme_idc_t {
+    struct sg_nvme_idc_t * nextp;
+    uint32_t key;               /* from ptp->nvme_dev_key, never 0 */
+    unsigned int gen;           /* sg_nvme_idc_gen when created */
+    int refcnt;
+    uint8_t * id_ctlp;          /* Identify controller (CNS=1) response */
+    uint8_t * free_id_ctlp;
+    uint8_t * id_nsp;           /* Identify namespace (CNS=0), may be NULL */
+    uint8_t * free_id_nsp;
+    struct sg_sntl_ses_cache_t ses;     /* SES pages, under the lock */
+};
+
+static struct sg_nvme_idc_t * sg_nvme_idc_head;
+static unsigned int sg_nvme_idc_gen = 1;
+static bool sg_nvme_idc_locked;
+
+static void
+sg_nvme_idc_lock(void)
+{
+    while (__atomic_test_and_set(&sg_nvme_idc_locked, __ATOMIC_ACQUIRE))
+        ;
+}
+
+static void
+sg_nvme_idc_unlock(void)
+{
+    __atomic_clear(&sg_nvme_idc_locked, __ATOMIC_RELEASE);
+}
+
+static void
+sg_nvme_idc_free(struct sg_nvme_idc_t * ep)
+{
+    if (ep->free_id_ctlp)
+        free(ep->free_id_ctlp);
+    if (ep->free_id_nsp)
+        free(ep->free_id_nsp);
+    sntl_ses_cache_free(&ep->ses);
+    free(ep);
+}
+
+/* If the cache has a current entry for ptp's device then ptp takes a
+ * reference to it and true is returned. */
+static bool
+sg_nvme_idc_get(struct sg_pt_linux_scsi * ptp)
+{
+    unsigned int gen;
+    struct sg_nvme_idc_t * ep;
+
+    if (0 == ptp->nvme_dev_key)
+        return false;
+    gen = __atomic_load_n(&sg_nvme_idc_gen, __ATOMIC_ACQUIRE);
+    sg_nvme_idc_lock();
+    for (ep = sg_nvme_idc_head; ep; ep = ep->nextp) {
+        if ((ep->key == ptp->nvme_dev_key) && (ep->gen == gen)) {
+            ++ep->refcnt;
+            break;
+        }
+    }
+    sg_nvme_idc_unlock();
+    if (NULL == ep)
+        return false;
+    ptp->nvme_idcp = ep;
+    ptp->nvme_id_ctlp = ep->id_ctlp;
+    return true;
+}
+
+/* Moves ptp's private Identify controller response into a new cache
+ * entry, dropping unreferenced entries that are stale or for the same
+ * device. On failure ptp simply keeps its private copy. */
+static void
+sg_nvme_idc_add(struct sg_pt_linux_scsi * ptp)
+{
+    unsigned int gen;
+    struct sg_nvme_idc_t * ep;
+    struct sg_nvme_idc_t * freep = NULL;
+    struct sg_nvme_idc_t ** epp;
+
+    if ((0 == ptp->nvme_dev_key) || (NULL == ptp->free_nvme_id_ctlp))
+        return;
+    ep = (struct sg_nvme_idc_t *)calloc(1, sizeof(*ep));
+    if (NULL == ep)
+        return;
+    gen = __atomic_load_n(&sg_nvme_idc_gen, __ATOMIC_ACQUIRE);
+    ep->key = ptp->nvme_dev_key;
+    ep->gen = gen;
+    ep->refcnt = 1;
+    ep->id_ctlp = ptp->nvme_id_ctlp;
+    ep->free_id_ctlp = ptp->free_nvme_id_ctlp;
+    ptp->free_nvme_id_ctlp = NULL;
+    ptp->nvme_idcp = ep;
+    sg_nvme_idc_lock();
+    for (epp = &sg_nvme_idc_head; *epp; ) {
+        struct sg_nvme_idc_t * p = *epp;
+
+        if ((p->refcnt <= 0) && ((p->gen != gen) || (p->key == ep->key))) {
+            *epp = p->nextp;
+            p->nextp = freep;
+            freep = p;
+        } else
+            epp = &p->nextp;
+    }
+    ep->nextp = sg_nvme_idc_head;
+    sg_nvme_idc_head = ep;
+    sg_nvme_idc_unlock();
+    while (freep) {
+        ep = freep->nextp;
+        sg_nvme_idc_free(freep);
+        freep = ep;
+    }
+}
+
+/* Returns the Identify namespace response for ptp->nvme_nsid from the
+ * cache entry that ptp references, fetching it on first use. Returns NULL
+ * if ptp has no cache entry or the fetch failed; the latter places the
+ * error in *resp . */
+static const uint8_t *
+sg_nvme_idc_ns(struct sg_pt_linux_scsi * ptp, int time_secs, int * resp,
+               int vb)
+{
+    int res;
+    uint32_t pg_sz;
+    uint8_t * up;
+    uint8_t * free_up = NULL;
+    struct sg_nvme_idc_t * ep = (struct sg_nvme_idc_t *)ptp->nvme_idcp;
+
+    *resp = 0;
+    if (NULL == ep)
+        return NULL;
+    up = __atomic_load_n(&ep->id_nsp, __ATOMIC_ACQUIRE);
+    if (up)
+        return up;
+    pg_sz = sg_get_page_size();
+    up = sg_memalign(pg_sz, pg_sz, &free_up, false);
+    if (NULL == up) {
+        *resp = -ENOMEM;
+        return NULL;
+    }
+    res = sntl_do_identify(ptp, 0x0 /* CNS */, ptp->nvme_nsid, time_secs,
+                           pg_sz, up, vb);
+    if (res) {
+        free(free_up);
+        *resp = res;
+        return NULL;
+    }
+    sg_nvme_idc_lock();
+    if (NULL == ep->id_nsp) {   /* another thread may have beaten us */
+        ep->free_id_nsp = free_up;
+        __atomic_store_n(&ep->id_nsp, up, __ATOMIC_RELEASE);
+        free_up = NULL;
+    } else
+        up = ep->id_nsp;
+    sg_nvme_idc_unlock();
+    if (free_up)
+        free(free_up);
+    return up;
+}
+
+#endif          /* SG_NVME_ID_CACHE */
+
+/* The SES page cache lives in the shared Identify cache entry so that it
+ * is per NVMe device (enclosure) and is dropped with it. A pt object not
+ * yet bound to an entry picks one up if the device has one, without
+ * issuing a command. Returns NULL (no caching) otherwise. */
+static struct sg_sntl_ses_cache_t *
+sntl_ses_cache_lock(struct sg_pt_linux_scsi * ptp)
+{
+#ifdef SG_NVME_ID_CACHE
+    struct sg_nvme_idc_t * ep;
+
+    if ((NULL == ptp->nvme_idcp) && (NULL == ptp->nvme_id_ctlp))
+        sg_nvme_idc_get(ptp);
+    ep = (struct sg_nvme_idc_t *)ptp->nvme_idcp;
+    if (NULL == ep)
+        return NULL;
+    sg_nvme_idc_lock();
+    return &ep->ses;
+#else
+    if (ptp) { ; }      /* suppress warning */
+    return NULL;
+#endif
+}
+
+static void
+sntl_ses_cache_unlock(struct sg_sntl_ses_cache_t * scp)
+{
+#ifdef SG_NVME_ID_CACHE
+    if (scp)
+        sg_nvme_idc_unlock();
+#else
+    if (scp) { ; }      /* suppress warning */
+#endif
+}
+
+void
+sg_nvme_id_cache_put(struct sg_pt_linux_scsi * ptp)
+{
+#ifdef SG_NVME_ID_CACHE
+    bool do_free = false;
+    struct sg_nvme_idc_t * ep = (struct sg_nvme_idc_t *)ptp->nvme_idcp;
+    struct sg_nvme_idc_t ** epp;
+
+    if (ep) {
+        sg_nvme_idc_lock();
+        if ((--ep->refcnt <= 0) &&
+            (ep->gen != __atomic_load_n(&sg_nvme_idc_gen, __ATOMIC_ACQUIRE))) {
+            for (epp = &sg_nvme_idc_head; *epp; epp = &(*epp)->nextp) {
+                if (*epp == ep) {
+                    *epp = ep->nextp;
+                    do_free = true;
+                    break;
+                }
+            }
+        }
+        sg_nvme_idc_unlock();
+        if (do_free)
+            sg_nvme_idc_free(ep);
+        ptp->nvme_idcp = NULL;
+    }
+#endif
+    if (ptp->free_nvme_id_ctlp) {
+        free(ptp->free_nvme_id_ctlp);
+        ptp->free_nvme_id_ctlp = NULL;
+    }
+    ptp->nvme_id_ctlp = NULL;
+}
+
+void
+sg_nvme_id_cache_flush(void)
+{
+#ifdef SG_NVME_ID_CACHE
+    __atomic_add_fetch(&sg_nvme_idc_gen, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
 /* Currently only caches associated identify controller response (4096 bytes).
  * Returns 0 on success; otherwise a positive value is returned */
 static int
@@ -440,6 +763,16 @@ sntl_cache_identity(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
     uint32_t pg_sz = sg_get_page_size();
     uint8_t * up;
 
+    sg_nvme_id_cache_put(ptp);
+#ifdef SG_NVME_ID_CACHE
+    if (sg_nvme_idc_get(ptp)) {
+        if (vb > 4)
+            pr2ws("%s: using shared Identify controller response\n",
+                  __func__);
+        sntl_check_enclosure_override(ptp, vb);
+        return 0;
+    }
+#endif
     up = sg_memalign(pg_sz, pg_sz, &ptp->free_nvme_id_ctlp, false);
     ptp->nvme_id_ctlp = up;
     if (NULL == up) {
@@ -448,8 +781,12 @@ sntl_cache_identity(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
     }
     ret = sntl_do_identify(ptp, 0x1 /* CNS */, 0 /* nsid */, time_secs,
                            pg_sz, up, vb);
-    if (0 == ret)
+    if (0 == ret) {
         sntl_check_enclosure_override(ptp, vb);
+#ifdef SG_NVME_ID_CACHE
+        sg_nvme_idc_add(ptp);
+#endif
+    }
     return (ret < 0) ? sg_convert_errno(-ret) : ret;
 }
 
@@ -513,9 +850,14 @@ sntl_inq(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int time_secs,
         case 0x83:
             if ((ptp->nvme_nsid > 0) &&
                 (ptp->nvme_nsid < SG_NVME_BROADCAST_NSID)) {
+#ifdef SG_NVME_ID_CACHE
+                nvme_id_ns = (uint8_t *)sg_nvme_idc_ns(ptp, time_secs, &res,
+                                                       vb);
+                if ((NULL == nvme_id_ns) && (0 == res))
+#endif
                 nvme_id_ns = sg_memalign(pg_sz, pg_sz, &free_nvme_id_ns,
                                          false);
-                if (nvme_id_ns) {
+                if (free_nvme_id_ns) {
                     /* CNS=0x0 Identify namespace */
                     res = sntl_do_identify(ptp, 0x0, ptp->nvme_nsid,
                                            time_secs, pg_sz, nvme_id_ns, vb);
@@ -848,6 +1190,7 @@ sntl_senddiag(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
     uint32_t alloc_len, n, dout_len, dpg_len, nvme_dst;
     const uint32_t pg_sz = sg_get_page_size();
     uint8_t * dop;
+    struct sg_sntl_ses_cache_t * scp;
     struct sg_nvme_passthru_cmd cmd;
     uint8_t * cmd_up = (uint8_t *)&cmd;
 
@@ -945,6 +1288,10 @@ sntl_senddiag(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
     cmd.cdw11 = 0x9;         /* nvme_mi_ses_send; (0x8 -> mi_ses_recv) */
     cmd.cdw13 = n;
     res = sg_nvme_admin_cmd(ptp, &cmd, dop, false, time_secs, vb);
+    /* status (and after Download microcode, all) pages may now differ */
+    scp = sntl_ses_cache_lock(ptp);
+    sntl_ses_cache_clear(scp, (0xe == dpg_cd));
+    sntl_ses_cache_unlock(scp);
     if (0 != res) {
         if (SG_LIB_NVME_STATUS == res) {
             mk_sense_from_nvme_status(ptp, vb);
@@ -969,6 +1316,7 @@ sntl_recvdiag(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
     uint32_t alloc_len, n, din_len;
     uint32_t pg_sz = sg_get_page_size();
     uint8_t * dip;
+    struct sg_sntl_ses_cache_t * scp;
     struct sg_nvme_passthru_cmd cmd;
 
     pcv = !! (0x1 & cdbp[1]);
@@ -987,6 +1335,16 @@ sntl_recvdiag(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
                   (uint64_t)ptp->io_hdr.din_xferp);
         return SCSI_PT_DO_BAD_PARAMS;
     }
+    scp = sntl_ses_cache_lock(ptp);
+    res = sntl_ses_cache_get(scp, dpg_cd, dip, n);
+    sntl_ses_cache_unlock(scp);
+    if (res >= 0) {
+        if (vb > 1)
+            pr2ws("%s: d_pg=0x%x (%d bytes) from SES page cache\n",
+                  __func__, dpg_cd, res);
+        ptp->io_hdr.din_resid = din_len - res;
+        return 0;
+    }
 
     if (vb)
         pr2ws("%s: expecting d_pg=0x%x from NVME_MI SES receive\n", __func__,
@@ -1008,6 +1366,9 @@ sntl_recvdiag(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
         } else
             return res;
     }
+    scp = sntl_ses_cache_lock(ptp);
+    sntl_ses_cache_put(scp, dpg_cd, dip, n);
+    sntl_ses_cache_unlock(scp);
     ptp->io_hdr.din_resid = din_len - n;
     return res;
 }
@@ -1243,6 +1604,309 @@ fini:
     return res;
 }
 
+/* Fetches (once per namespace) the log2 of the logical block size of the
+ * namespace associated with ptp via the NVMe Identify namespace command.
+ * Returns 0 on success with ptp->nvme_lbads set, else returns as
+ * sg_nvme_admin_cmd() does. */
+static int
+sntl_get_lbads(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    int res;
+    uint8_t flbas, index, lbads;
+    uint32_t pg_sz = sg_get_page_size();
+    const uint8_t * up = NULL;
+    uint8_t * free_up = NULL;
+
+    if (ptp->nvme_lbads > 0)
+        return 0;
+#ifdef SG_NVME_ID_CACHE
+    if ((NULL == ptp->nvme_id_ctlp) &&
+        sntl_cache_identity(ptp, time_secs, vb))
+        sg_nvme_id_cache_put(ptp);      /* not fatal here */
+    up = sg_nvme_idc_ns(ptp, time_secs, &res, vb);
+    if (res)
+        return res;
+#endif
+    if (NULL == up) {
+        up = sg_memalign(pg_sz, pg_sz, &free_up, false);
+        if (NULL == up) {
+            pr2ws("%s: sg_memalign() failed to get memory\n", __func__);
+            return -ENOMEM;
+        }
+        res = sntl_do_identify(ptp, 0x0 /* CNS */, ptp->nvme_nsid,
+                               time_secs, pg_sz, (uint8_t *)up, vb);
+    } else
+        res = 0;
+    if (0 == res) {
+        flbas = up[26];
+        index = 128 + (4 * (flbas & 0xf));
+        lbads = (sg_get_unaligned_le32(up + index) >> 16) & 0xff;
+        if (lbads < 9) {        /* NVMe says 512 bytes is the minimum */
+            if (vb)
+                pr2ws("%s: unexpected LBADS=%u, assume 512 byte LBs\n",
+                      __func__, lbads);
+            lbads = 9;
+        }
+        ptp->nvme_lbads = lbads;
+        if (vb > 3)
+            pr2ws("%s: nsid=%u, LB size=%u\n", __func__, ptp->nvme_nsid,
+                  1U << lbads);
+    }
+    if (free_up)
+        free(free_up);
+    return res;
+}
+
+uint32_t
+get_pt_nvme_max_xfer(struct sg_pt_base * vp, int time_secs, int vb)
+{
+    uint8_t mdts;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+
+    if ((! ptp->is_nvme) || (ptp->dev_fd < 0))
+        return 0;
+    if ((NULL == ptp->nvme_id_ctlp) &&
+        sntl_cache_identity(ptp, time_secs, vb)) {
+        sg_nvme_id_cache_put(ptp);
+        return 0;
+    }
+    mdts = ptp->nvme_id_ctlp[77];
+    if (0 == mdts)
+        return UINT32_MAX;
+    /* MDTS is in units of CAP.MPSMIN, assume that is 4096 bytes */
+    return ((mdts + 12) < 32) ? (1U << (mdts + 12)) : UINT32_MAX;
+}
+
+/* Translates SCSI READ(10), READ(16), WRITE(10), WRITE(16), VERIFY(10) and
+ * VERIFY(16) to the NVM command set's Read, Write, Verify (BYTCHK=0) and
+ * Compare (BYTCHK=1) commands. The NLB field in NVMe commands is only 16
+ * bits wide and the controller may have a smaller maximum data transfer
+ * size (MDTS) so a SCSI command may be split into several NVMe commands.
+ * Either way the NVMe commands are issued in LBA order and the first one
+ * that fails stops the sequence; the residual count reflects the data
+ * moved before that failure. */
+static int
+sntl_rwv(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int time_secs,
+         int vb)
+{
+    bool is_16 = (cdbp[0] >= 0x80);
+    bool is_verify = false;
+    bool fua = false;
+    bool is_read, has_data;
+    uint8_t nvme_opc, mdts;
+    int res, len;
+    uint32_t num, max_nlb, chunk;
+    uint64_t lba, off;
+    uint8_t * bp;
+    struct sg_nvme_passthru_cmd cmd;
+
+    switch (cdbp[0]) {
+    case SCSI_READ10_OPC:
+    case SCSI_READ16_OPC:
+        is_read = true;
+        has_data = true;
+        nvme_opc = SG_NVME_NVM_READ;
+        break;
+    case SCSI_WRITE10_OPC:
+    case SCSI_WRITE16_OPC:
+        is_read = false;
+        has_data = true;
+        nvme_opc = SG_NVME_NVM_WRITE;
+        break;
+    default:            /* VERIFY(10) or VERIFY(16) */
+        is_verify = true;
+        is_read = false;
+        switch ((cdbp[1] >> 1) & 0x3) {         /* BYTCHK field */
+        case 0:
+            has_data = false;
+            nvme_opc = SG_NVME_NVM_VERIFY;
+            break;
+        case 1:
+            has_data = true;
+            nvme_opc = SG_NVME_NVM_COMPARE;
+            break;
+        default:        /* BYTCHK=3 needs the LB repeated, not translated */
+            mk_sense_invalid_fld(ptp, true, 1, 2, vb);
+            return 0;
+        }
+        break;
+    }
+    if (0xe0 & cdbp[1]) {       /* [RD|WR|VR]PROTECT field */
+        mk_sense_invalid_fld(ptp, true, 1, 7, vb);
+        return 0;
+    }
+    if (! is_verify)
+        fua = !! (0x8 & cdbp[1]);
+    if (is_16) {
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+    } else {
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+    }
+    if (vb > 3)
+        pr2ws("%s: opcode=0x%x, lba=0x%" PRIx64 ", num=%u, fua=%d\n",
+              __func__, cdbp[0], lba, num, (int)fua);
+    if ((0 == ptp->nvme_nsid) || (SG_NVME_BROADCAST_NSID == ptp->nvme_nsid)) {
+        if (vb)
+            pr2ws("%s: need a NVMe namespace, not just a controller\n",
+                  __func__);
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          LOGICAL_UNIT_NOT_SUPPORTED, 0, vb);
+        return 0;
+    }
+    if (has_data) {
+        if (is_read) {
+            len = ptp->io_hdr.din_xfer_len;
+            bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        } else {
+            len = ptp->io_hdr.dout_xfer_len;
+            bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        }
+    } else {
+        len = 0;
+        bp = NULL;
+    }
+    if (0 == num) {     /* SBC: transfer length of 0 is not an error */
+        if (is_read)
+            ptp->io_hdr.din_resid = len;
+        else if (has_data)
+            ptp->io_hdr.dout_resid = len;
+        return 0;
+    }
+    res = sntl_get_lbads(ptp, time_secs, vb);
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        return 0;
+    } else if (res)
+        return res;
+    if (has_data && (((uint64_t)num << ptp->nvme_lbads) > (uint64_t)len)) {
+        if (vb)
+            pr2ws("%s: data buffer (%d bytes) smaller than %u blocks of %u "
+                  "bytes\n", __func__, len, num, 1U << ptp->nvme_lbads);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    max_nlb = 0x10000;
+    if (has_data) {
+        if ((NULL == ptp->nvme_id_ctlp) &&
+            sntl_cache_identity(ptp, time_secs, vb))
+            sg_nvme_id_cache_put(ptp);  /* carry on without MDTS */
+        /* MDTS is in units of CAP.MPSMIN, assume that is 4096 bytes */
+        mdts = ptp->nvme_id_ctlp ? ptp->nvme_id_ctlp[77] : 0;
+        if ((mdts > 0) && ((mdts + 12) > ptp->nvme_lbads) &&
+            ((mdts + 12 - ptp->nvme_lbads) < 16))
+            max_nlb = 1U << (mdts + 12 - ptp->nvme_lbads);
+    }
+    for (off = 0; num > 0; num -= chunk, lba += chunk) {
+        chunk = (num < max_nlb) ? num : max_nlb;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.opcode = nvme_opc;
+        cmd.nsid = ptp->nvme_nsid;
+        cmd.cdw10 = (uint32_t)lba;
+        cmd.cdw11 = (uint32_t)(lba >> 32);
+        cmd.cdw12 = (chunk - 1) | (fua ? 0x40000000 : 0);    /* 0 based */
+        if (has_data) {
+            cmd.addr = (uint64_t)(sg_uintptr_t)(bp + off);
+            cmd.data_len = chunk << ptp->nvme_lbads;
+        }
+        res = sg_nvme_cmd_com(ptp, &cmd, (has_data ? (bp + off) : NULL),
+                              is_read, false, time_secs, vb);
+        if (res) {
+            if (SG_LIB_NVME_STATUS == res) {
+                mk_sense_from_nvme_status(ptp, vb);
+                res = 0;
+            }
+            break;
+        }
+        if (has_data)
+            off += (uint64_t)chunk << ptp->nvme_lbads;
+    }
+    if (is_read)
+        ptp->io_hdr.din_resid = len - (int)off;
+    else if (has_data)
+        ptp->io_hdr.dout_resid = len - (int)off;
+    return res;
+}
+
+/* SYNCHRONIZE CACHE(10 or 16) --> NVMe Flush. The LBA range and IMMED bit
+ * are ignored since Flush applies to the whole namespace. When Identify
+ * controller says there is no volatile write cache there is nothing to
+ * do. */
+static int
+sntl_sync_cache(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+                int time_secs, int vb)
+{
+    int res;
+    struct sg_nvme_passthru_cmd cmd;
+
+    if (vb > 3)
+        pr2ws("%s: SYNCHRONIZE CACHE(%d), time_secs=%d\n", __func__,
+              ((SCSI_SYNC_CACHE10_OPC == cdbp[0]) ? 10 : 16), time_secs);
+    if ((0 == ptp->nvme_nsid) || (SG_NVME_BROADCAST_NSID == ptp->nvme_nsid)) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          LOGICAL_UNIT_NOT_SUPPORTED, 0, vb);
+        return 0;
+    }
+    if (NULL == ptp->nvme_id_ctlp) {
+        res = sntl_cache_identity(ptp, time_secs, vb);
+        if (SG_LIB_NVME_STATUS == res) {
+            mk_sense_from_nvme_status(ptp, vb);
+            return 0;
+        } else if (res)
+            return res;
+    }
+    if (0 == (0x1 & ptp->nvme_id_ctlp[525])) {  /* VWC bit */
+        if (vb > 3)
+            pr2ws("%s: no volatile write cache so no Flush\n", __func__);
+        return 0;
+    }
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = SG_NVME_NVM_FLUSH;
+    cmd.nsid = ptp->nvme_nsid;
+    res = sg_nvme_cmd_com(ptp, &cmd, NULL, false, false, time_secs, vb);
+    if (SG_LIB_NVME_STATUS == res) {
+        mk_sense_from_nvme_status(ptp, vb);
+        return 0;
+    }
+    return res;
+}
+
+/* Copies the NVMe command (64 bytes or more) given to set_scsi_pt_cdb()
+ * into *cmdp and adds the data-in or data-out buffer, if any. Returns 0
+ * on success, else SCSI_PT_DO_BAD_PARAMS. */
+static int
+sg_nvme_build_direct(const struct sg_pt_linux_scsi * ptp,
+                     struct sg_nvme_passthru_cmd * cmdp, void ** dpp,
+                     bool * is_readp, int vb)
+{
+    int n = ptp->io_hdr.request_len;
+    int len = (int)sizeof(*cmdp);
+
+    n = (n < len) ? n : len;
+    if (n < 64) {
+        if (vb)
+            pr2ws("%s: command length of %d bytes is too short\n", __func__,
+                  n);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    memcpy(cmdp, (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request, n);
+    if (n < len)        /* zero out rest of 'cmd' */
+        memset((uint8_t *)cmdp + n, 0, len - n);
+    *dpp = NULL;
+    *is_readp = false;
+    if (ptp->io_hdr.din_xfer_len > 0) {
+        cmdp->data_len = ptp->io_hdr.din_xfer_len;
+        *dpp = (void *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        cmdp->addr = (uint64_t)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        *is_readp = true;
+    } else if (ptp->io_hdr.dout_xfer_len > 0) {
+        cmdp->data_len = ptp->io_hdr.dout_xfer_len;
+        *dpp = (void *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        cmdp->addr = (uint64_t)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+    }
+    return 0;
+}
+
 /* Executes NVMe Admin command (or at least forwards it to lower layers).
  * Returns 0 for success, negative numbers are negated 'errno' values from
  * OS system calls. Positive return values are errors from this package.
@@ -1253,7 +1917,7 @@ sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb)
 {
     bool scsi_cdb;
     bool is_read = false;
-    int n, len, hold_dev_fd;
+    int n, hold_dev_fd;
     uint16_t sa;
     struct sg_pt_linux_scsi * ptp = &vp->impl;
     struct sg_nvme_passthru_cmd cmd;
@@ -1304,6 +1968,16 @@ sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb)
         case SCSI_MODE_SENSE10_OPC:
         case SCSI_MODE_SELECT10_OPC:
             return sntl_mode_ss(ptp, cdbp, time_secs, vb);
+        case SCSI_READ10_OPC:
+        case SCSI_READ16_OPC:
+        case SCSI_WRITE10_OPC:
+        case SCSI_WRITE16_OPC:
+        case SCSI_VERIFY10_OPC:
+        case SCSI_VERIFY16_OPC:
+            return sntl_rwv(ptp, cdbp, time_secs, vb);
+        case SCSI_SYNC_CACHE10_OPC:
+        case SCSI_SYNC_CACHE16_OPC:
+            return sntl_sync_cache(ptp, cdbp, time_secs, vb);
         case SCSI_READ_CAPACITY10_OPC:
             return sntl_readcap(ptp, cdbp, time_secs, vb);
         case SCSI_SERVICE_ACT_IN_OPC:
@@ -1331,31 +2005,272 @@ fini:
             return 0;
         }
     }
-    len = (int)sizeof(cmd);
-    n = (n < len) ? n : len;
-    if (n < 64) {
+    n = sg_nvme_build_direct(ptp, &cmd, &dp, &is_read, vb);
+    if (n)
+        return n;
+    return sg_nvme_admin_cmd(ptp, &cmd, dp, is_read, time_secs, vb);
+}
+
+#ifdef SG_PT_LINUX_URING
+
+#define SG_NVME_URING_ENTRIES 2
+#define SG_NVME_URING_SQE_SZ 128        /* due to IORING_SETUP_SQE128 */
+#define SG_NVME_URING_CQE_SZ 32         /* due to IORING_SETUP_CQE32 */
+
+/* One small ring per pt object, created on first use. Since an object
+ * has at most one command in flight, the ring is never full. */
+struct sg_nvme_uring_t {
+    int ring_fd;
+    bool is_read;               /* of the command in flight */
+    bool iopoll;                /* set up with IORING_SETUP_IOPOLL */
+    unsigned int * sq_tail;
+    unsigned int * sq_mask;
+    unsigned int * sq_array;
+    unsigned int * cq_head;
+    unsigned int * cq_tail;
+    unsigned int * cq_mask;
+    uint8_t * sqes;
+    uint8_t * cqes;
+    void * sq_ring;
+    void * cq_ring;             /* same as sq_ring if IORING_FEAT_SINGLE_MMAP */
+    size_t sq_ring_sz;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    void * dp;                  /* data buffer of the command in flight */
+    struct sg_nvme_passthru_cmd cmd;    /* the command in flight */
+};
+
+void
+sg_nvme_uring_free(struct sg_pt_linux_scsi * ptp)
+{
+    struct sg_nvme_uring_t * urp = (struct sg_nvme_uring_t *)ptp->uringp;
+
+    if (NULL == urp)
+        return;
+    if (urp->sqes && (MAP_FAILED != (void *)urp->sqes))
+        munmap(urp->sqes, urp->sqes_sz);
+    if (urp->cq_ring && (MAP_FAILED != urp->cq_ring) &&
+        (urp->cq_ring != urp->sq_ring))
+        munmap(urp->cq_ring, urp->cq_ring_sz);
+    if (urp->sq_ring && (MAP_FAILED != urp->sq_ring))
+        munmap(urp->sq_ring, urp->sq_ring_sz);
+    if (urp->ring_fd >= 0)
+        close(urp->ring_fd);
+    free(urp);
+    ptp->uringp = NULL;
+    ptp->uring_inflight = false;
+}
+
+/* Returns 0 on success, else a negated errno. On failure the partially
+ * set up ring is released. If polled completion was requested then the
+ * ring is set up with IORING_SETUP_IOPOLL; the kernel rejects commands on
+ * such a ring (with EOPNOTSUPP) for devices that can't be polled. */
+static int
+sg_nvme_uring_setup(struct sg_pt_linux_scsi * ptp, int vb)
+{
+    int err;
+    struct sg_nvme_uring_t * urp;
+    uint8_t * bp;
+    struct io_uring_params params;
+
+    urp = (struct sg_nvme_uring_t *)calloc(1, sizeof(*urp));
+    if (NULL == urp) {
         if (vb)
-            pr2ws("%s: command length of %d bytes is too short\n", __func__,
-                  n);
+            pr2ws("%s: calloc() failed, out of memory?\n", __func__);
+        return -ENOMEM;
+    }
+    ptp->uringp = urp;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+    if (ptp->hipri)
+        params.flags |= IORING_SETUP_IOPOLL;
+    urp->iopoll = ptp->hipri;
+    urp->ring_fd = syscall(__NR_io_uring_setup, SG_NVME_URING_ENTRIES,
+                           &params);
+    if (urp->ring_fd < 0) {
+        err = errno;
+        if (vb > 1)
+            pr2ws("%s: io_uring_setup() failed: %s\n", __func__,
+                  strerror(err));
+        goto err_out;
+    }
+    urp->sq_ring_sz = params.sq_off.array +
+                      (params.sq_entries * sizeof(unsigned int));
+    urp->cq_ring_sz = params.cq_off.cqes +
+                      (params.cq_entries * SG_NVME_URING_CQE_SZ);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (urp->cq_ring_sz > urp->sq_ring_sz)
+            urp->sq_ring_sz = urp->cq_ring_sz;
+        urp->cq_ring_sz = urp->sq_ring_sz;
+    }
+    urp->sq_ring = mmap(NULL, urp->sq_ring_sz, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                        IORING_OFF_SQ_RING);
+    if (MAP_FAILED == urp->sq_ring)
+        goto mmap_err;
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        urp->cq_ring = urp->sq_ring;
+    else {
+        urp->cq_ring = mmap(NULL, urp->cq_ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                            IORING_OFF_CQ_RING);
+        if (MAP_FAILED == urp->cq_ring)
+            goto mmap_err;
+    }
+    urp->sqes_sz = params.sq_entries * SG_NVME_URING_SQE_SZ;
+    urp->sqes = (uint8_t *)mmap(NULL, urp->sqes_sz, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                                IORING_OFF_SQES);
+    if (MAP_FAILED == (void *)urp->sqes)
+        goto mmap_err;
+    bp = (uint8_t *)urp->sq_ring;
+    urp->sq_tail = (unsigned int *)(bp + params.sq_off.tail);
+    urp->sq_mask = (unsigned int *)(bp + params.sq_off.ring_mask);
+    urp->sq_array = (unsigned int *)(bp + params.sq_off.array);
+    bp = (uint8_t *)urp->cq_ring;
+    urp->cq_head = (unsigned int *)(bp + params.cq_off.head);
+    urp->cq_tail = (unsigned int *)(bp + params.cq_off.tail);
+    urp->cq_mask = (unsigned int *)(bp + params.cq_off.ring_mask);
+    urp->cqes = bp + params.cq_off.cqes;
+    if (vb > 3)
+        pr2ws("%s: ring_fd=%d, sq_entries=%u, cq_entries=%u\n", __func__,
+              urp->ring_fd, params.sq_entries, params.cq_entries);
+    return 0;
+mmap_err:
+    err = errno;
+    if (vb > 1)
+        pr2ws("%s: mmap() of io_uring failed: %s\n", __func__,
+              strerror(err));
+err_out:
+    sg_nvme_uring_free(ptp);
+    return -err;
+}
+
+/* Submits a NVMe Admin command given directly (i.e. not a SCSI cdb) via
+ * io_uring to the NVMe char device (e.g. /dev/ng0n1 or /dev/nvme0) and
+ * returns without waiting for it to complete. Returns 0 if submitted, 1
+ * if io_uring cannot be used for this command or device (caller should
+ * fall back to sg_do_nvme_pt() ), other positive values are errors from
+ * this package and negative numbers are negated errno values. */
+int
+sg_nvme_uring_submit(struct sg_pt_base * vp, int time_secs, int vb)
+{
+    int res;
+    unsigned int tail, idx;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_nvme_uring_t * urp;
+    struct io_uring_sqe * sqep;
+
+    if ((! ptp->use_uring) || (0 == ptp->io_hdr.request) ||
+        sg_is_scsi_cdb((const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request,
+                       ptp->io_hdr.request_len))
+        return 1;       /* SNTL uses synchronous ioctl()s */
+    if (ptp->io_hdr.din_iovec_count || ptp->io_hdr.dout_iovec_count)
+        return 1;       /* do_scsi_pt() bounces scatter gather lists */
+    if (ptp->uring_inflight) {
+        if (vb)
+            pr2ws("%s: command already in flight on this object\n",
+                  __func__);
         return SCSI_PT_DO_BAD_PARAMS;
     }
-    memcpy(&cmd, (const uint8_t *)(sg_uintptr_t)ptp->io_hdr.request, n);
-    if (n < len)        /* zero out rest of 'cmd' */
-        memset((uint8_t *)&cmd + n, 0, len - n);
-    if (ptp->io_hdr.din_xfer_len > 0) {
-        cmd.data_len = ptp->io_hdr.din_xfer_len;
-        dp = (void *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
-        cmd.addr = (uint64_t)(sg_uintptr_t)ptp->io_hdr.din_xferp;
-        is_read = true;
-    } else if (ptp->io_hdr.dout_xfer_len > 0) {
-        cmd.data_len = ptp->io_hdr.dout_xfer_len;
-        dp = (void *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
-        cmd.addr = (uint64_t)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
-        is_read = false;
+    if (ptp->uringp &&
+        (ptp->hipri != ((struct sg_nvme_uring_t *)ptp->uringp)->iopoll))
+        sg_nvme_uring_free(ptp);        /* SCSI_PT_FLAGS_HIPRI changed */
+    if (NULL == ptp->uringp) {
+        res = sg_nvme_uring_setup(ptp, vb);
+        if (res) {      /* e.g. ENOSYS or EINVAL from older kernels */
+            ptp->use_uring = false;
+            return 1;
+        }
     }
-    return sg_nvme_admin_cmd(ptp, &cmd, dp, is_read, time_secs, vb);
+    urp = (struct sg_nvme_uring_t *)ptp->uringp;
+    ptp->nvme_direct = true;
+    res = sg_nvme_build_direct(ptp, &urp->cmd, &urp->dp, &urp->is_read, vb);
+    if (res)
+        return res;
+    urp->cmd.timeout_ms = (time_secs < 0) ? (-time_secs) :
+                                            (1000 * time_secs);
+    urp->cmd.result = 0;        /* rsvd2 in struct nvme_uring_cmd */
+    ptp->os_err = 0;
+    if (vb > 2) {
+        pr2ws("NVMe Admin command via io_uring:\n");
+        hex2stderr((const uint8_t *)&urp->cmd, sizeof(urp->cmd), 1);
+    }
+    tail = *urp->sq_tail;
+    idx = tail & *urp->sq_mask;
+    sqep = (struct io_uring_sqe *)(urp->sqes + idx * SG_NVME_URING_SQE_SZ);
+    memset(sqep, 0, SG_NVME_URING_SQE_SZ);
+    sqep->opcode = IORING_OP_URING_CMD;
+    sqep->fd = ptp->dev_fd;
+    sqep->cmd_op = NVME_URING_CMD_ADMIN;
+    sqep->user_data = (uint64_t)(sg_uintptr_t)ptp;
+    memcpy(sqep->cmd, &urp->cmd, sizeof(urp->cmd));
+    urp->sq_array[idx] = idx;
+    __atomic_store_n(urp->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    while ((res = syscall(__NR_io_uring_enter, urp->ring_fd, 1, 0, 0, NULL,
+                          0)) < 0) {
+        if (EINTR != errno)
+            break;
+    }
+    if (res < 0) {
+        ptp->os_err = errno;
+        if (vb > 1)
+            pr2ws("%s: io_uring_enter() failed: %s\n", __func__,
+                  strerror(ptp->os_err));
+        return -ptp->os_err;
+    }
+    ptp->uring_inflight = true;
+    return 0;
+}
+
+/* Reaps the completion of the command given to sg_nvme_uring_submit().
+ * Returns -EAGAIN if no_wait is true and it is not yet complete, else the
+ * same values as sg_do_nvme_pt(). On an IORING_SETUP_IOPOLL ring nothing
+ * reaches the completion queue until io_uring_enter() polls for it, so
+ * that is done (once) even when no_wait is true. */
+int
+sg_nvme_uring_receive(struct sg_pt_base * vp, bool no_wait, int vb)
+{
+    bool polled = false;
+    int res;
+    unsigned int head;
+    struct sg_pt_linux_scsi * ptp = &vp->impl;
+    struct sg_nvme_uring_t * urp = (struct sg_nvme_uring_t *)ptp->uringp;
+    const struct io_uring_cqe * cqep;
+
+    if ((! ptp->uring_inflight) || (NULL == urp))
+        return SCSI_PT_DO_BAD_PARAMS;
+    while (true) {
+        head = *urp->cq_head;
+        if (head != __atomic_load_n(urp->cq_tail, __ATOMIC_ACQUIRE))
+            break;
+        if (no_wait && (polled || (! urp->iopoll)))
+            return -EAGAIN;
+        res = syscall(__NR_io_uring_enter, urp->ring_fd, 0, (no_wait ? 0 : 1),
+                      IORING_ENTER_GETEVENTS, NULL, 0);
+        polled = true;
+        if ((res < 0) && (EINTR != errno)) {
+            ptp->os_err = errno;
+            if (vb > 1)
+                pr2ws("%s: io_uring_enter() failed: %s\n", __func__,
+                      strerror(ptp->os_err));
+            return -ptp->os_err;
+        }
+    }
+    cqep = (const struct io_uring_cqe *)
+           (urp->cqes + (head & *urp->cq_mask) * SG_NVME_URING_CQE_SZ);
+    res = cqep->res;            /* like ioctl(): NVMe status or -errno */
+    urp->cmd.result = (uint32_t)cqep->big_cqe[0];       /* CDW0 */
+    __atomic_store_n(urp->cq_head, head + 1, __ATOMIC_RELEASE);
+    ptp->uring_inflight = false;
+    if ((-EOPNOTSUPP == res) || (-ENOTTY == res) || (-EINVAL == res))
+        ptp->use_uring = false; /* later submits use ioctl() instead */
+    return sg_nvme_admin_fini(ptp, &urp->cmd, urp->dp, urp->is_read, true,
+                              res, vb);
 }
 
+#endif          /* SG_PT_LINUX_URING */
+
 #else           /* (HAVE_NVME && (! IGNORE_NVME)) [around line 140] */
 
 int
@@ -1382,4 +2297,54 @@ sg_do_nvme_pt(struct sg_pt_base * vp, int fd, int time_secs, int vb)
     return -ENOTTY;             /* inappropriate ioctl error */
 }
 
+uint32_t
+get_pt_nvme_max_xfer(struct sg_pt_base * vp __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     int vb __attribute__ ((unused)))
+{
+    return 0;
+}
+
+void
+sg_nvme_id_cache_put(struct sg_pt_linux_scsi * ptp)
+{
+    if (ptp->free_nvme_id_ctlp) {
+        free(ptp->free_nvme_id_ctlp);
+        ptp->free_nvme_id_ctlp = NULL;
+    }
+    ptp->nvme_id_ctlp = NULL;
+}
+
+void
+sg_nvme_id_cache_flush(void)
+{
+}
+
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) */
+
+#ifndef SG_PT_LINUX_URING
+
+/* io_uring is not available, so always ask the caller to fall back to
+ * sg_do_nvme_pt() . */
+int
+sg_nvme_uring_submit(struct sg_pt_base * vp __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     int vb __attribute__ ((unused)))
+{
+    return 1;
+}
+
+int
+sg_nvme_uring_receive(struct sg_pt_base * vp __attribute__ ((unused)),
+                      bool no_wait __attribute__ ((unused)),
+                      int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_BAD_PARAMS;
+}
+
+void
+sg_nvme_uring_free(struct sg_pt_linux_scsi * ptp __attribute__ ((unused)))
+{
+}
+
+#endif          /* SG_PT_LINUX_URING */
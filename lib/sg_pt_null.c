@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_pt_null version 1.00 20261014 */
+
+/* The null pass-through: a software only SCSI direct access device, see
+ * sg_pt_null.h . It is OS independent; each OS specific pass-through
+ * (e.g. sg_pt_linux.c) checks for a null device in its open, close and
+ * command submission functions and, when found, calls the functions here
+ * instead of its OS interface. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Not all environments support the Unix nanosleep() */
+#if defined(MSC_VER) || defined(__MINGW32__)
+#define HAVE_MS_SLEEP
+#endif
+#ifdef HAVE_MS_SLEEP
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <time.h>
+#endif
+
+#include "sg_lib.h"
+#include "sg_pt.h"
+#include "sg_pt_null.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#define NULL_DEF_LBS 512
+#define NULL_DEF_NUM_BLOCKS 0x80000000ULL
+#define NULL_MAX_XFER_BYTES (1024 * 1024)       /* Block Limits VPD page */
+#define NULL_OPT_XFER_BYTES (128 * 1024)
+#define NULL_RSP_SZ 256         /* large enough for any canned response */
+#define NULL_SENSE_SZ 32
+
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && \
+    (__GCC_ATOMIC_LLONG_LOCK_FREE == 2)
+#define NULL_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define NULL_ADD(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+static char null_lck;
+
+#define NULL_LOCK() \
+    while (__atomic_test_and_set(&null_lck, __ATOMIC_ACQUIRE)) { ; }
+#define NULL_UNLOCK() __atomic_clear(&null_lck, __ATOMIC_RELEASE)
+#else   /* accurate only when a single thread uses null devices */
+#define NULL_LOAD(p) (*(p))
+#define NULL_ADD(p, v) (*(p) += (v))
+#define NULL_LOCK()
+#define NULL_UNLOCK()
+#endif
+
+struct sg_pt_null_dev {
+    bool in_use;
+    int fd;             /* handle given to caller */
+    bool os_fd;         /* fd is an OS file descriptor that needs closing */
+    uint32_t lbs;       /* logical block size in bytes */
+    uint32_t err_every; /* every Nth media access fails, 0: none fail */
+    uint32_t ua_count;  /* unit attentions pending (given), then taken */
+    uint32_t ua_taken;
+    uint64_t lat_ns;    /* delay before each command "completes" */
+    uint64_t num_blocks;
+    uint64_t media_count;   /* media access commands so far */
+};
+
+static struct sg_pt_null_dev null_dev_arr[SG_PT_NULL_MAX_OPEN];
+static int null_num_open;
+
+/* Standard INQUIRY response, the additional length is 31 */
+static const uint8_t null_std_inq[36] = {
+    0x0, 0x0, 0x7, 0x2, 31, 0x0, 0x0, 0x2,
+    'S', 'G', '3', 'U', 'T', 'I', 'L', 'S',
+    'N', 'U', 'L', 'L', ' ', 'S', 'C', 'S',
+    'I', ' ', 'D', 'E', 'V', 'I', 'C', 'E',
+    '0', '1', '0', '0',
+};
+
+static const uint8_t null_vpd_pages[] = {0x0, 0x80, 0x83, 0xb0};
+
+
+bool
+sg_pt_null_dev_name(const char * device_name)
+{
+    int n = sizeof(SG_PT_NULL_DEV_NAME) - 1;
+
+    if ((NULL == device_name) ||
+        (0 != memcmp(device_name, SG_PT_NULL_DEV_NAME, n)))
+        return false;
+    return (('\0' == device_name[n]) || (',' == device_name[n]));
+}
+
+/* Parses the comma separated settings that may follow SG_PT_NULL_DEV_NAME.
+ * Returns 0 if good, else -EINVAL. */
+static int
+null_parse_settings(const char * cp, struct sg_pt_null_dev * ndp,
+                    int verbose)
+{
+    int64_t ll;
+    const char * ep;
+    char b[32];
+
+    ndp->lbs = NULL_DEF_LBS;
+    ndp->num_blocks = NULL_DEF_NUM_BLOCKS;
+    for ( ; cp && (',' == *cp); cp = ep) {
+        ++cp;
+        ep = strchr(cp, ',');
+        if (NULL == ep)
+            ep = cp + strlen(cp);
+        if ((ep - cp) >= (int)sizeof(b))
+            goto bad;
+        memcpy(b, cp, ep - cp);
+        b[ep - cp] = '\0';
+        if (0 == strncmp(b, "lat=", 4)) {
+            ll = sg_get_llnum(b + 4);
+            if (ll < 0)
+                goto bad;
+            ndp->lat_ns = (uint64_t)ll * 1000;
+        } else if (0 == strncmp(b, "lbs=", 4)) {
+            ll = sg_get_llnum(b + 4);
+            if ((ll < 1) || (ll > 0x10000))
+                goto bad;
+            ndp->lbs = (uint32_t)ll;
+        } else if (0 == strncmp(b, "blocks=", 7)) {
+            ll = sg_get_llnum(b + 7);
+            if (ll < 1)
+                goto bad;
+            ndp->num_blocks = (uint64_t)ll;
+        } else if (0 == strncmp(b, "err=", 4)) {
+            ll = sg_get_llnum(b + 4);
+            if ((ll < 0) || (ll > UINT32_MAX))
+                goto bad;
+            ndp->err_every = (uint32_t)ll;
+        } else if (0 == strncmp(b, "ua=", 3)) {
+            ll = sg_get_llnum(b + 3);
+            if ((ll < 0) || (ll > UINT32_MAX))
+                goto bad;
+            ndp->ua_count = (uint32_t)ll;
+        } else
+            goto bad;
+    }
+    return 0;
+bad:
+    if (verbose)
+        pr2ws("%s: bad setting in '%.*s', expect lat=, lbs=, blocks=, err= "
+              "or ua=\n", __func__, (int)(ep - cp), cp);
+    return -EINVAL;
+}
+
+int
+sg_pt_null_open(const char * device_name, int flags, bool os_fd,
+                int verbose)
+{
+    int k, res, fd;
+    struct sg_pt_null_dev nd;
+
+    if (! sg_pt_null_dev_name(device_name))
+        return -ENODEV;
+#ifdef HAVE_MS_SLEEP
+    (void)flags;
+#endif
+    memset(&nd, 0, sizeof(nd));
+    res = null_parse_settings(device_name + sizeof(SG_PT_NULL_DEV_NAME) - 1,
+                              &nd, verbose);
+    if (res)
+        return res;
+    fd = -1;
+    if (os_fd) {
+#ifdef HAVE_MS_SLEEP
+        if (verbose)
+            pr2ws("%s: no OS null device, use os_fd=false\n", __func__);
+        return -ENOSYS;
+#else
+#ifdef O_ACCMODE
+        fd = open("/dev/null", flags & O_ACCMODE);
+#else
+        fd = open("/dev/null", O_RDWR);
+#endif
+        if (fd < 0) {
+            res = -errno;
+            if (verbose)
+                pr2ws("%s: open(/dev/null) failed: %s\n", __func__,
+                      safe_strerror(-res));
+            return res;
+        }
+#endif
+    }
+    NULL_LOCK();
+    for (k = 0; k < SG_PT_NULL_MAX_OPEN; ++k) {
+        if (! null_dev_arr[k].in_use)
+            break;
+    }
+    if (k < SG_PT_NULL_MAX_OPEN) {
+        nd.fd = os_fd ? fd : (SG_PT_NULL_FDOFFSET + k);
+        nd.os_fd = os_fd;
+        nd.in_use = true;
+        null_dev_arr[k] = nd;
+        NULL_ADD(&null_num_open, 1);
+    }
+    NULL_UNLOCK();
+    if (k >= SG_PT_NULL_MAX_OPEN) {
+        if (verbose)
+            pr2ws("%s: too many null devices open (max: %d)\n", __func__,
+                  SG_PT_NULL_MAX_OPEN);
+#ifndef HAVE_MS_SLEEP
+        if (fd >= 0)
+            close(fd);
+#endif
+        return -EMFILE;
+    }
+    if (verbose > 1)
+        pr2ws("%s: handle=%d, lat=%" PRIu64 " us, lbs=%u, blocks=%" PRIu64
+              ", err=%u\n", __func__, nd.fd, nd.lat_ns / 1000, nd.lbs,
+              nd.num_blocks, nd.err_every);
+    return nd.fd;
+}
+
+static struct sg_pt_null_dev *
+null_find(int dev_fd)
+{
+    int k;
+
+    if ((dev_fd < 0) || (0 == NULL_LOAD(&null_num_open)))
+        return NULL;
+    if (dev_fd >= SG_PT_NULL_FDOFFSET) {
+        k = dev_fd - SG_PT_NULL_FDOFFSET;
+        if ((k < SG_PT_NULL_MAX_OPEN) && null_dev_arr[k].in_use &&
+            (dev_fd == null_dev_arr[k].fd))
+            return null_dev_arr + k;
+        return NULL;
+    }
+    for (k = 0; k < SG_PT_NULL_MAX_OPEN; ++k) {
+        if (null_dev_arr[k].in_use && (dev_fd == null_dev_arr[k].fd))
+            return null_dev_arr + k;
+    }
+    return NULL;
+}
+
+bool
+sg_pt_null_is_fd(int dev_fd)
+{
+    return !! null_find(dev_fd);
+}
+
+int
+sg_pt_null_close(int dev_fd)
+{
+    int res = 0;
+    struct sg_pt_null_dev * ndp;
+
+    NULL_LOCK();
+    ndp = null_find(dev_fd);
+    if (ndp) {
+        ndp->in_use = false;
+        NULL_ADD(&null_num_open, -1);
+    }
+    NULL_UNLOCK();
+    if (NULL == ndp)
+        return -EBADF;
+#ifndef HAVE_MS_SLEEP
+    if (ndp->os_fd && (close(dev_fd) < 0))
+        res = -errno;
+#endif
+    return res;
+}
+
+/* Copies len bytes from bp (or zeros if bp is NULL) to the data-in buffer,
+ * truncating to its length. Sets din_resid. */
+static void
+null_din(struct sg_pt_null_cmd * ncp, const uint8_t * bp, int len)
+{
+    int k, n, rem;
+    const struct sg_pt_iovec * iovp;
+
+    if (len > ncp->din_len)
+        len = ncp->din_len;
+    if (len < 0)
+        len = 0;
+    ncp->din_resid = ncp->din_len - len;
+    if ((len < 1) || (NULL == ncp->dinp))
+        return;
+    if (ncp->din_iov_count < 1) {
+        if (bp)
+            memcpy(ncp->dinp, bp, len);
+        else
+            memset(ncp->dinp, 0, len);
+        return;
+    }
+    iovp = (const struct sg_pt_iovec *)ncp->dinp;
+    for (k = 0, rem = len; (k < ncp->din_iov_count) && (rem > 0); ++k) {
+        n = ((int)iovp[k].iov_len < rem) ? (int)iovp[k].iov_len : rem;
+        if (bp) {
+            memcpy(iovp[k].iov_base, bp, n);
+            bp += n;
+        } else
+            memset(iovp[k].iov_base, 0, n);
+        rem -= n;
+    }
+}
+
+static void
+null_sense(struct sg_pt_null_cmd * ncp, int sense_key, int asc, int ascq)
+{
+    int n;
+    uint8_t b[NULL_SENSE_SZ];
+
+    ncp->scsi_status = SAM_STAT_CHECK_CONDITION;
+    ncp->din_resid = ncp->din_len;
+    ncp->dout_resid = ncp->dout_len;
+    if ((NULL == ncp->sensep) || (ncp->max_sense_len < 1))
+        return;
+    memset(b, 0, sizeof(b));
+    sg_build_sense_buffer(false, b, sense_key, asc, ascq);
+    n = (ncp->max_sense_len < 18) ? ncp->max_sense_len : 18;
+    memcpy(ncp->sensep, b, n);
+    ncp->sense_len = n;
+}
+
+/* Builds the response to INQUIRY in rsp, returns its length or -1 for an
+ * invalid field in the cdb. */
+static int
+null_inquiry(const struct sg_pt_null_dev * ndp, const uint8_t * cdbp,
+             uint8_t * rsp)
+{
+    int n;
+    uint32_t max_bl;
+
+    if (0 == (0x1 & cdbp[1])) {         /* EVPD=0 */
+        if (cdbp[2])
+            return -1;
+        memcpy(rsp, null_std_inq, sizeof(null_std_inq));
+        return sizeof(null_std_inq);
+    }
+    rsp[1] = cdbp[2];
+    switch (cdbp[2]) {
+    case 0x0:           /* Supported VPD pages */
+        n = sizeof(null_vpd_pages);
+        memcpy(rsp + 4, null_vpd_pages, n);
+        break;
+    case 0x80:          /* Unit serial number */
+        n = snprintf((char *)rsp + 4, NULL_RSP_SZ - 4, "NULLSCSI%04d",
+                     (int)(ndp - null_dev_arr));
+        break;
+    case 0x83:          /* Device identification: one NAA-5 designator */
+        rsp[4] = 0x1;           /* code set: binary */
+        rsp[5] = 0x3;           /* association: LU, designator type: NAA */
+        rsp[7] = 8;
+        sg_put_unaligned_be64(0x5000000053470000ULL +
+                              (uint64_t)(ndp - null_dev_arr), rsp + 8);
+        n = 12;
+        break;
+    case 0xb0:          /* Block limits */
+        max_bl = NULL_MAX_XFER_BYTES / ndp->lbs;
+        sg_put_unaligned_be32(max_bl ? max_bl : 1, rsp + 8);
+        max_bl = NULL_OPT_XFER_BYTES / ndp->lbs;
+        sg_put_unaligned_be32(max_bl ? max_bl : 1, rsp + 12);
+        n = 0x3c;
+        break;
+    default:
+        return -1;
+    }
+    sg_put_unaligned_be16(n, rsp + 2);
+    return n + 4;
+}
+
+/* Decodes LBA and number of blocks from media access cdbs. Returns true
+ * for those commands, with *is_rd set for commands that read the medium and
+ * *has_dout set for those with data-out. */
+static bool
+null_media_cdb(const uint8_t * cdbp, int cdb_len, uint64_t * lbap,
+               uint32_t * nump, bool * is_rd, bool * has_dout)
+{
+    *is_rd = false;
+    *has_dout = false;
+    switch (cdbp[0]) {
+    case 0x8:           /* READ(6) */
+    case 0xa:           /* WRITE(6) */
+        if (cdb_len < 6)
+            return false;
+        *lbap = sg_get_unaligned_be24(cdbp + 1) & 0x1fffff;
+        *nump = cdbp[4] ? cdbp[4] : 256;
+        *is_rd = (0x8 == cdbp[0]);
+        *has_dout = ! *is_rd;
+        return true;
+    case 0x28:          /* READ(10) */
+    case 0x2a:          /* WRITE(10) */
+    case 0x2e:          /* WRITE AND VERIFY(10) */
+    case 0x2f:          /* VERIFY(10) */
+    case 0x41:          /* WRITE SAME(10) */
+        if (cdb_len < 10)
+            return false;
+        *lbap = sg_get_unaligned_be32(cdbp + 2);
+        *nump = sg_get_unaligned_be16(cdbp + 7);
+        break;
+    case 0xa8:          /* READ(12) */
+    case 0xaa:          /* WRITE(12) */
+        if (cdb_len < 12)
+            return false;
+        *lbap = sg_get_unaligned_be32(cdbp + 2);
+        *nump = sg_get_unaligned_be32(cdbp + 6);
+        break;
+    case 0x88:          /* READ(16) */
+    case 0x8a:          /* WRITE(16) */
+    case 0x8e:          /* WRITE AND VERIFY(16) */
+    case 0x8f:          /* VERIFY(16) */
+    case 0x93:          /* WRITE SAME(16) */
+        if (cdb_len < 16)
+            return false;
+        *lbap = sg_get_unaligned_be64(cdbp + 2);
+        *nump = sg_get_unaligned_be32(cdbp + 10);
+        break;
+    default:
+        return false;
+    }
+    switch (cdbp[0]) {
+    case 0x28:
+    case 0xa8:
+    case 0x88:
+        *is_rd = true;
+        break;
+    case 0x2f:
+    case 0x8f:
+        *is_rd = true;
+        *has_dout = !! (0x6 & cdbp[1]);         /* BYTCHK */
+        break;
+    default:
+        *has_dout = true;
+        break;
+    }
+    return true;
+}
+
+int
+sg_pt_null_cmd(int dev_fd, struct sg_pt_null_cmd * ncp, int verbose)
+{
+    bool is_rd, has_dout;
+    int n;
+    uint32_t num;
+    uint64_t lba, cnt;
+    struct sg_pt_null_dev * ndp = null_find(dev_fd);
+    const uint8_t * cdbp = ncp->cdbp;
+    uint8_t rsp[NULL_RSP_SZ];
+
+    if (NULL == ndp)
+        return -EBADF;
+    if ((NULL == cdbp) || (ncp->cdb_len < 6))
+        return -EINVAL;
+    ncp->scsi_status = SAM_STAT_GOOD;
+    ncp->sense_len = 0;
+    ncp->din_resid = ncp->din_len;
+    ncp->dout_resid = 0;
+    ncp->done_ns = ndp->lat_ns ? (sg_pt_lat_now_ns() + ndp->lat_ns) : 0;
+    if ((NULL_LOAD(&ndp->ua_taken) < ndp->ua_count) &&
+        (0x12 != cdbp[0]) && (0xa0 != cdbp[0]) && (0x3 != cdbp[0])) {
+        cnt = NULL_ADD(&ndp->ua_taken, 1);
+        if (cnt <= ndp->ua_count) {
+            if (cnt & 1)        /* POWER ON, RESET, OR BUS DEVICE RESET */
+                null_sense(ncp, SPC_SK_UNIT_ATTENTION, 0x29, 0x0);
+            else                /* REPORTED LUNS DATA HAS CHANGED */
+                null_sense(ncp, SPC_SK_UNIT_ATTENTION, 0x3f, 0xe);
+            return 0;
+        }
+    }
+    if (null_media_cdb(cdbp, ncp->cdb_len, &lba, &num, &is_rd, &has_dout)) {
+        if ((lba > ndp->num_blocks) || (num > (ndp->num_blocks - lba))) {
+            null_sense(ncp, SPC_SK_ILLEGAL_REQUEST, 0x21, 0x0);
+            return 0;
+        }
+        if (ndp->err_every) {
+            cnt = NULL_ADD(&ndp->media_count, 1);
+            if (0 == (cnt % ndp->err_every)) {
+                if (is_rd)      /* unrecovered read error */
+                    null_sense(ncp, SPC_SK_MEDIUM_ERROR, 0x11, 0x0);
+                else            /* write error */
+                    null_sense(ncp, SPC_SK_MEDIUM_ERROR, 0xc, 0x0);
+                return 0;
+            }
+        }
+        if (is_rd && (! has_dout))   /* media reads as zeros */
+            null_din(ncp, NULL, (uint64_t)num * ndp->lbs > INT32_MAX ?
+                                INT32_MAX : (int)(num * ndp->lbs));
+        return 0;
+    }
+    memset(rsp, 0, sizeof(rsp));
+    n = 0;
+    switch (cdbp[0]) {
+    case 0x0:           /* TEST UNIT READY */
+    case 0x1b:          /* START STOP UNIT */
+    case 0x35:          /* SYNCHRONIZE CACHE(10) */
+    case 0x91:          /* SYNCHRONIZE CACHE(16) */
+        break;
+    case 0x3:           /* REQUEST SENSE: no sense */
+        sg_build_sense_buffer(false, rsp, SPC_SK_NO_SENSE, 0, 0);
+        n = (cdbp[4] < 18) ? cdbp[4] : 18;
+        break;
+    case 0x12:          /* INQUIRY */
+        n = null_inquiry(ndp, cdbp, rsp);
+        if (n < 0)
+            goto inv_field;
+        n = (n < sg_get_unaligned_be16(cdbp + 3)) ? n :
+                                        sg_get_unaligned_be16(cdbp + 3);
+        break;
+    case 0x1a:          /* MODE SENSE(6): header only, no pages */
+        rsp[0] = 3;
+        n = (cdbp[4] < 4) ? cdbp[4] : 4;
+        break;
+    case 0x5a:          /* MODE SENSE(10): header only, no pages */
+        rsp[1] = 6;
+        n = (sg_get_unaligned_be16(cdbp + 7) < 8) ?
+                        sg_get_unaligned_be16(cdbp + 7) : 8;
+        break;
+    case 0x25:          /* READ CAPACITY(10) */
+        sg_put_unaligned_be32((ndp->num_blocks > 0xffffffffULL) ?
+                              0xffffffff : (uint32_t)(ndp->num_blocks - 1),
+                              rsp);
+        sg_put_unaligned_be32(ndp->lbs, rsp + 4);
+        n = 8;
+        break;
+    case 0x9e:          /* SERVICE ACTION IN(16) */
+        if ((0x1f & cdbp[1]) != 0x10)   /* only READ CAPACITY(16) */
+            goto inv_opcode;
+        if (ncp->cdb_len < 16)
+            goto inv_field;
+        sg_put_unaligned_be64(ndp->num_blocks - 1, rsp);
+        sg_put_unaligned_be32(ndp->lbs, rsp + 8);
+        n = (sg_get_unaligned_be32(cdbp + 10) < 32) ?
+                        (int)sg_get_unaligned_be32(cdbp + 10) : 32;
+        break;
+    case 0x84:          /* THIRD PARTY COPY IN */
+        if ((0x1f & cdbp[1]) != 0x3)    /* only RECEIVE COPY OPERATING */
+            goto inv_opcode;            /* PARAMETERS */
+        if (ncp->cdb_len < 16)
+            goto inv_field;
+        rsp[4] = 0x1;                   /* SNLID */
+        sg_put_unaligned_be16(2, rsp + 8);      /* max target descs */
+        sg_put_unaligned_be16(1, rsp + 10);     /* max segment descs */
+        sg_put_unaligned_be32(1024, rsp + 12);  /* max desc list length */
+        sg_put_unaligned_be32(NULL_MAX_XFER_BYTES, rsp + 16);
+        rsp[36] = 1;                    /* max concurrent copies */
+        rsp[37] = 9;                    /* data segment granularity: 512 */
+        rsp[43] = 2;                    /* implemented descriptors: */
+        rsp[44] = 0x2;                  /*   block to block */
+        rsp[45] = 0xe4;                 /*   identification target */
+        sg_put_unaligned_be32(46 - 4, rsp);
+        n = (sg_get_unaligned_be32(cdbp + 10) < 46) ?
+                        (int)sg_get_unaligned_be32(cdbp + 10) : 46;
+        break;
+    case 0xa0:          /* REPORT LUNS: only LUN 0 */
+        if (ncp->cdb_len < 12)
+            goto inv_field;
+        rsp[3] = 8;
+        n = (sg_get_unaligned_be32(cdbp + 6) < 16) ?
+                        (int)sg_get_unaligned_be32(cdbp + 6) : 16;
+        break;
+    default:
+        goto inv_opcode;
+    }
+    null_din(ncp, rsp, n);
+    return 0;
+inv_opcode:
+    if (verbose > 2)
+        pr2ws("%s: opcode 0x%x not supported\n", __func__, cdbp[0]);
+    null_sense(ncp, SPC_SK_ILLEGAL_REQUEST, 0x20, 0x0);
+    return 0;
+inv_field:
+    null_sense(ncp, SPC_SK_ILLEGAL_REQUEST, 0x24, 0x0);
+    return 0;
+}
+
+int
+sg_pt_null_wait(uint64_t done_ns, bool no_wait)
+{
+    uint64_t now, d;
+
+    if (0 == done_ns)
+        return 0;
+    while ((now = sg_pt_lat_now_ns()) < done_ns) {
+        if (no_wait)
+            return -EAGAIN;
+        d = done_ns - now;
+#ifdef HAVE_MS_SLEEP
+        Sleep((DWORD)((d + 999999) / 1000000));
+#else
+        {
+            struct timespec ts;
+
+            ts.tv_sec = d / 1000000000;
+            ts.tv_nsec = d % 1000000000;
+            nanosleep(&ts, NULL);
+        }
+#endif
+    }
+    return 0;
+}
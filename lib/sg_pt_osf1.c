@@ -27,6 +27,7 @@
 #include <errno.h>
 
 #include "sg_pt.h"
+#include "sg_pt_null.h"
 #include "sg_lib.h"
 #include "sg_pr2serr.h"
 
@@ -62,7 +63,11 @@ struct sg_pt_osf1_scsi {
     int os_err;
     int transport_err;
     bool is_nvme;
+    bool iov_din;       /* direction of iovp (when non-NULL) */
     int dev_fd;
+    int iov_cnt;
+    const struct sg_pt_iovec * iovp;    /* bounced via dxferp */
+    uint8_t * free_iov_bp;
 };
 
 struct sg_pt_base {
@@ -81,7 +86,8 @@ scsi_pt_open_device(const char * device_name, bool read_only, int verbose)
 }
 
 /* Similar to scsi_pt_open_device() but takes Unix style open flags OR-ed
- * together. The 'flags' argument is ignored in OSF-1.
+ * together. The 'flags' argument is ignored in OSF-1. A device_name
+ * starting with SG_PT_NULL_DEV_NAME opens a null device, see sg_pt_null.h .
  * Returns >= 0 if successful, otherwise returns negated errno. */
 int
 scsi_pt_open_flags(const char * device_name, int flags, int verbose)
@@ -89,6 +95,9 @@ scsi_pt_open_flags(const char * device_name, int flags, int verbose)
     struct osf1_dev_channel *fdchan;
     int fd, k;
 
+    /* handles here are indexes into devicetable[], so no OS fd */
+    if (sg_pt_null_dev_name(device_name))
+        return sg_pt_null_open(device_name, flags, false, verbose);
     if (!camopened) {
         camfd = open(cam_dev, O_RDWR, 0);
         if (camfd < 0)
@@ -141,6 +150,8 @@ scsi_pt_close_device(int device_fd)
     struct osf1_dev_channel *fdchan;
     int i;
 
+    if (sg_pt_null_is_fd(device_fd))
+        return sg_pt_null_close(device_fd);
     if ((device_fd < 0) || (device_fd >= OSF1_MAXDEV)) {
         errno = ENODEV;
         return -1;
@@ -193,8 +204,11 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
 {
     struct sg_pt_osf1_scsi * ptp = &vp->impl;
 
-    if (ptp)
+    if (ptp) {
+        if (ptp->free_iov_bp)
+            free(ptp->free_iov_bp);
         free(ptp);
+    }
 }
 
 void
@@ -203,11 +217,60 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
     struct sg_pt_osf1_scsi * ptp = &vp->impl;
 
     if (ptp) {
+        int fd = ptp->dev_fd;
+
+        if (ptp->free_iov_bp)
+            free(ptp->free_iov_bp);
         bzero(ptp, sizeof(struct sg_pt_osf1_scsi));
+        ptp->dev_fd = fd;
         ptp->dxfer_dir = CAM_DIR_NONE;
     }
 }
 
+/* Keeps the sense and data buffer bindings; resets the cdb binding and the
+ * results of the previous command. */
+void
+rearm_scsi_pt_obj(struct sg_pt_base * vp)
+{
+    struct sg_pt_osf1_scsi * ptp = &vp->impl;
+
+    if (ptp) {
+        if (ptp->sense && (ptp->sense_len > ptp->sense_resid))
+            bzero(ptp->sense, ptp->sense_len - ptp->sense_resid);
+        ptp->cdb = NULL;
+        ptp->cdb_len = 0;
+        ptp->scsi_status = 0;
+        ptp->resid = 0;
+        ptp->sense_resid = 0;
+        ptp->in_err = 0;
+        ptp->os_err = 0;
+        ptp->transport_err = 0;
+    }
+}
+
+/* Forget any previous dev_fd and install the one given. Returns 0. */
+int
+set_pt_file_handle(struct sg_pt_base * vp, int dev_fd,
+                   int verbose __attribute__ ((unused)))
+{
+    struct sg_pt_osf1_scsi * ptp = &vp->impl;
+
+    ptp->dev_fd = (dev_fd < 0) ? -1 : dev_fd;
+    ptp->is_nvme = false;
+    ptp->os_err = 0;
+    return 0;
+}
+
+/* Valid file handles (which is the return value) are >= 0 . Returns -1
+ * if there is no valid file handle. */
+int
+get_pt_file_handle(const struct sg_pt_base * vp)
+{
+    const struct sg_pt_osf1_scsi * ptp = &vp->impl;
+
+    return ptp->dev_fd;
+}
+
 void
 set_scsi_pt_cdb(struct sg_pt_base * vp, const uint8_t * cdb,
                 int cdb_len)
@@ -265,6 +328,59 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* UAGT_CAM_IO takes one data buffer so the data is bounced through a
+ * buffer owned by the object; only one direction can use a list. */
+static void
+set_scsi_pt_data_iov(struct sg_pt_base * vp, const struct sg_pt_iovec * iovp,
+                     int iov_count, bool is_din)
+{
+    int len = sg_pt_iov_len(iovp, iov_count);
+    uint8_t * bp;
+    struct sg_pt_osf1_scsi * ptp = &vp->impl;
+
+    if (ptp->iovp || (len < 0)) {
+        ++ptp->in_err;
+        return;
+    }
+    if (len <= 0)
+        return;
+    bp = sg_memalign(len, 0, &ptp->free_iov_bp, false);
+    if (NULL == bp) {
+        ++ptp->in_err;
+        return;
+    }
+    ptp->iovp = iovp;
+    ptp->iov_cnt = iov_count;
+    ptp->iov_din = is_din;
+    if (is_din)
+        set_scsi_pt_data_in(vp, bp, len);
+    else
+        set_scsi_pt_data_out(vp, bp, len);
+}
+
+void
+set_scsi_pt_data_in_iov(struct sg_pt_base * vp,
+                        const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(vp, iovp, iov_count, true);
+}
+
+void
+set_scsi_pt_data_out_iov(struct sg_pt_base * vp,
+                         const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(vp, iovp, iov_count, false);
+}
+
+/* This pass-through has no kernel buffer that can be mapped */
+uint8_t *
+set_scsi_pt_data_in_mmap(struct sg_pt_base * vp __attribute__ ((unused)),
+                         int dxfer_ilen __attribute__ ((unused)),
+                         int verbose __attribute__ ((unused)))
+{
+    return NULL;
+}
+
 void
 set_scsi_pt_packet_id(struct sg_pt_base * vp, int pack_id)
 {
@@ -286,6 +402,15 @@ set_scsi_pt_task_management(struct sg_pt_base * vp, int tmf_code)
     ++ptp->in_err;
 }
 
+void
+set_scsi_pt_transport_req(struct sg_pt_base * vp, const uint8_t * reqp,
+                          int req_len)
+{
+    struct sg_pt_osf1_scsi * ptp = &vp->impl;
+
+    ++ptp->in_err;
+}
+
 void
 set_scsi_pt_task_attr(struct sg_pt_base * vp, int attrib, int priority)
 {
@@ -331,8 +456,42 @@ release_sim(struct sg_pt_base *vp, int device_fd, int verbose) {
     return retval;
 }
 
-int
-do_scsi_pt(struct sg_pt_base * vp, int device_fd, int time_secs, int verbose)
+/* Hands the command in ptp to the null device ptp->dev_fd and waits out
+ * its (injected) latency. */
+static int
+sg_pt_osf1_null_do(struct sg_pt_osf1_scsi * ptp, int verbose)
+{
+    bool is_din = (CAM_DIR_IN == ptp->dxfer_dir);
+    int res;
+    struct sg_pt_null_cmd nc;
+
+    memset(&nc, 0, sizeof(nc));
+    nc.cdbp = ptp->cdb;
+    nc.cdb_len = ptp->cdb_len;
+    if (is_din) {
+        nc.dinp = ptp->dxferp;
+        nc.din_len = ptp->dxfer_len;
+    } else if (CAM_DIR_OUT == ptp->dxfer_dir) {
+        nc.doutp = ptp->dxferp;
+        nc.dout_len = ptp->dxfer_len;
+    }
+    nc.sensep = ptp->sense;
+    nc.max_sense_len = ptp->sense_len;
+    res = sg_pt_null_cmd(ptp->dev_fd, &nc, verbose);
+    if (res) {
+        ptp->os_err = -res;
+        return res;
+    }
+    ptp->scsi_status = nc.scsi_status;
+    ptp->resid = is_din ? nc.din_resid : nc.dout_resid;
+    ptp->sense_resid = ptp->sense_len - nc.sense_len;
+    return sg_pt_null_wait(nc.done_ns, false);
+}
+
+/* Does the work of do_scsi_pt() */
+static int
+do_scsi_pt_com(struct sg_pt_base * vp, int device_fd, int time_secs,
+               int verbose)
 {
     struct sg_pt_osf1_scsi * ptp = &vp->impl;
     struct osf1_dev_channel *fdchan;
@@ -370,6 +529,8 @@ do_scsi_pt(struct sg_pt_base * vp, int device_fd, int time_secs, int verbose)
             pr2ws("No command (cdb) given\n");
         return SCSI_PT_DO_BAD_PARAMS;
     }
+    if (sg_pt_null_is_fd(ptp->dev_fd))
+        return sg_pt_osf1_null_do(ptp, verbose);
 
     if ((ptp->dev_fd < 0) || (ptp->dev_fd >= OSF1_MAXDEV)) {
         if (verbose)
@@ -401,7 +562,10 @@ do_scsi_pt(struct sg_pt_base * vp, int device_fd, int time_secs, int verbose)
     uagt.uagt_buffer = ccb.cam_data_ptr =  ptp->dxferp;
     uagt.uagt_buflen = ccb.cam_dxfer_len = ptp->dxfer_len;
 
-    ccb.cam_timeout = time_secs;
+    /* in seconds, round up milliseconds */
+    ccb.cam_timeout = (time_secs < 0) ?
+                      ((sg_pt_timeout_ms(time_secs, 0) + 999) / 1000) :
+                      time_secs;
     ccb.cam_ch.my_addr = (CCB_HEADER *) &ccb;
     ccb.cam_ch.cam_ccb_len = sizeof(ccb);
     ccb.cam_ch.cam_func_code = XPT_SCSI_IO;
@@ -436,6 +600,87 @@ do_scsi_pt(struct sg_pt_base * vp, int device_fd, int time_secs, int verbose)
     return 0;
 }
 
+int
+do_scsi_pt(struct sg_pt_base * vp, int device_fd, int time_secs, int verbose)
+{
+    int res, n;
+    struct sg_pt_osf1_scsi * ptp = &vp->impl;
+
+    if (ptp->iovp && (! ptp->iov_din))
+        sg_pt_iov_gather(ptp->iovp, ptp->iov_cnt, ptp->dxferp);
+    res = do_scsi_pt_com(vp, device_fd, time_secs, verbose);
+    if (ptp->iovp && ptp->iov_din && (0 == res)) {
+        n = ptp->dxfer_len - ptp->resid;
+        if (n > 0)
+            sg_pt_iov_scatter(ptp->iovp, ptp->iov_cnt, ptp->dxferp, n);
+    }
+    return res;
+}
+
+/* No asynchronous pass-through mechanism is used on this OS, so the
+ * command is executed synchronously at submit time. */
+int
+do_scsi_pt_submit(struct sg_pt_base * vp, int device_fd, int time_secs,
+                  int verbose)
+{
+    return do_scsi_pt(vp, device_fd, time_secs, verbose);
+}
+
+int
+do_scsi_pt_receive(struct sg_pt_base * vp __attribute__ ((unused)),
+                   bool no_wait __attribute__ ((unused)),
+                   int verbose __attribute__ ((unused)))
+{
+    return 0;
+}
+
+/* This OS has no batched pass-through mechanism, so the commands are
+ * executed one after the other. */
+int
+do_scsi_pt_batch(struct sg_pt_base * objp_arr[], int num, int time_secs,
+                 int * num_donep, int verbose)
+{
+    int k;
+    int res = 0;
+
+    for (k = 0; k < num; ++k) {
+        res = do_scsi_pt(objp_arr[k], -1, time_secs, verbose);
+        if (res)
+            break;
+    }
+    if (num_donep)
+        *num_donep = k;
+    return res;
+}
+
+/* This OS has no pass-through mechanism for sharing requests */
+int
+scsi_pt_share_fds(int rd_fd __attribute__ ((unused)),
+                  int wr_fd __attribute__ ((unused)),
+                  int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+scsi_pt_unshare_fds(int fd __attribute__ ((unused)),
+                    int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+do_scsi_pt_shared_rw(struct sg_pt_base * rd_vp __attribute__ ((unused)),
+                     struct sg_pt_base * wr_vp __attribute__ ((unused)),
+                     int num_bytes __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     bool * wr_issuedp, int vb __attribute__ ((unused)))
+{
+    if (wr_issuedp)
+        *wr_issuedp = false;
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
 int
 get_scsi_pt_result_category(const struct sg_pt_base * vp)
 {
@@ -571,6 +816,15 @@ pt_device_is_nvme(const struct sg_pt_base * vp)
     return ptp ? ptp->is_nvme : false;
 }
 
+/* No Identify cache for this pass-through */
+uint32_t
+get_pt_nvme_max_xfer(struct sg_pt_base * vp __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     int vb __attribute__ ((unused)))
+{
+    return 0;
+}
+
 char *
 get_scsi_pt_transport_err_str(const struct sg_pt_base * vp, int max_b_len,
                               char * b)
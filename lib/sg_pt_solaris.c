@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-/* sg_pt_solaris version 1.11 20190113 */
+/* sg_pt_solaris version 1.12 20261014 */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +31,7 @@
 #endif
 
 #include "sg_pt.h"
+#include "sg_pt_null.h"
 #include "sg_lib.h"
 
 
@@ -42,7 +43,11 @@ struct sg_pt_solaris_scsi {
     int in_err;
     int os_err;
     bool is_nvme;
+    bool iov_din;       /* direction of iovp (when non-NULL) */
     int dev_fd;
+    int iov_cnt;
+    const struct sg_pt_iovec * iovp;    /* bounced via uscsi_bufaddr */
+    uint8_t * free_iov_bp;
 };
 
 struct sg_pt_base {
@@ -61,7 +66,8 @@ scsi_pt_open_device(const char * device_name, bool read_only, int verbose)
 }
 
 /* Similar to scsi_pt_open_device() but takes Unix style open flags OR-ed
- * together. The 'flags' argument is ignored in Solaris.
+ * together. The 'flags' argument is ignored in Solaris. A device_name
+ * starting with SG_PT_NULL_DEV_NAME opens a null device, see sg_pt_null.h .
  * Returns >= 0 if successful, otherwise returns negated errno. */
 int
 scsi_pt_open_flags(const char * device_name, int flags_arg, int verbose)
@@ -69,6 +75,8 @@ scsi_pt_open_flags(const char * device_name, int flags_arg, int verbose)
     int oflags = O_NONBLOCK | O_RDWR;
     int fd;
 
+    if (sg_pt_null_dev_name(device_name))
+        return sg_pt_null_open(device_name, oflags, true, verbose);
     flags_arg = flags_arg;  /* ignore flags argument, suppress warning */
     if (verbose > 1) {
         fprintf(sg_warnings_strm ? sg_warnings_strm : stderr,
@@ -86,6 +94,8 @@ scsi_pt_close_device(int device_fd)
 {
     int res;
 
+    if (sg_pt_null_is_fd(device_fd))
+        return sg_pt_null_close(device_fd);
     res = close(device_fd);
     if (res < 0)
         res = -errno;
@@ -122,8 +132,11 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
 {
     struct sg_pt_solaris_scsi * ptp = &vp->impl;
 
-    if (ptp)
+    if (ptp) {
+        if (ptp->free_iov_bp)
+            free(ptp->free_iov_bp);
         free(ptp);
+    }
 }
 
 void
@@ -132,13 +145,64 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
     struct sg_pt_solaris_scsi * ptp = &vp->impl;
 
     if (ptp) {
+        int fd = ptp->dev_fd;
+
+        if (ptp->free_iov_bp)
+            free(ptp->free_iov_bp);
         memset(ptp, 0, sizeof(struct sg_pt_solaris_scsi));
+        ptp->dev_fd = fd;
         ptp->uscsi.uscsi_timeout = DEF_TIMEOUT;
         ptp->uscsi.uscsi_flags = USCSI_READ | USCSI_ISOLATE | USCSI_RQENABLE;
         ptp->uscsi.uscsi_timeout = DEF_TIMEOUT;
     }
 }
 
+/* Keeps the sense and data buffer bindings; resets the cdb binding and the
+ * results of the previous command. */
+void
+rearm_scsi_pt_obj(struct sg_pt_base * vp)
+{
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    if (ptp) {
+        if (ptp->uscsi.uscsi_rqbuf &&
+            (ptp->max_sense_len > ptp->uscsi.uscsi_rqresid))
+            memset(ptp->uscsi.uscsi_rqbuf, 0,
+                   ptp->max_sense_len - ptp->uscsi.uscsi_rqresid);
+        ptp->uscsi.uscsi_cdb = NULL;
+        ptp->uscsi.uscsi_cdblen = 0;
+        ptp->uscsi.uscsi_status = 0;
+        ptp->uscsi.uscsi_resid = 0;
+        ptp->uscsi.uscsi_rqresid = 0;
+        ptp->uscsi.uscsi_rqstatus = 0;
+        ptp->in_err = 0;
+        ptp->os_err = 0;
+    }
+}
+
+/* Forget any previous dev_fd and install the one given. Returns 0. */
+int
+set_pt_file_handle(struct sg_pt_base * vp, int dev_fd,
+                   int verbose __attribute__ ((unused)))
+{
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    ptp->dev_fd = (dev_fd < 0) ? -1 : dev_fd;
+    ptp->is_nvme = false;
+    ptp->os_err = 0;
+    return 0;
+}
+
+/* Valid file handles (which is the return value) are >= 0 . Returns -1
+ * if there is no valid file handle. */
+int
+get_pt_file_handle(const struct sg_pt_base * vp)
+{
+    const struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    return ptp->dev_fd;
+}
+
 void
 set_scsi_pt_cdb(struct sg_pt_base * vp, const uint8_t * cdb,
                 int cdb_len)
@@ -197,6 +261,59 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* uscsi has no scatter gather list so the data is bounced through a
+ * buffer owned by the object; only one direction can use a list. */
+static void
+set_scsi_pt_data_iov(struct sg_pt_base * vp, const struct sg_pt_iovec * iovp,
+                     int iov_count, bool is_din)
+{
+    int len = sg_pt_iov_len(iovp, iov_count);
+    uint8_t * bp;
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    if (ptp->iovp || (len < 0)) {
+        ++ptp->in_err;
+        return;
+    }
+    if (len <= 0)
+        return;
+    bp = sg_memalign(len, 0, &ptp->free_iov_bp, false);
+    if (NULL == bp) {
+        ++ptp->in_err;
+        return;
+    }
+    ptp->iovp = iovp;
+    ptp->iov_cnt = iov_count;
+    ptp->iov_din = is_din;
+    if (is_din)
+        set_scsi_pt_data_in(vp, bp, len);
+    else
+        set_scsi_pt_data_out(vp, bp, len);
+}
+
+void
+set_scsi_pt_data_in_iov(struct sg_pt_base * vp,
+                        const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(vp, iovp, iov_count, true);
+}
+
+void
+set_scsi_pt_data_out_iov(struct sg_pt_base * vp,
+                         const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(vp, iovp, iov_count, false);
+}
+
+/* This pass-through has no kernel buffer that can be mapped */
+uint8_t *
+set_scsi_pt_data_in_mmap(struct sg_pt_base * vp __attribute__ ((unused)),
+                         int dxfer_ilen __attribute__ ((unused)),
+                         int verbose __attribute__ ((unused)))
+{
+    return NULL;
+}
+
 void
 set_scsi_pt_packet_id(struct sg_pt_base * vp, int pack_id)
 {
@@ -225,6 +342,17 @@ set_scsi_pt_task_management(struct sg_pt_base * vp, int tmf_code)
     tmf_code = tmf_code;        /* dummy to silence compiler */
 }
 
+void
+set_scsi_pt_transport_req(struct sg_pt_base * vp, const uint8_t * reqp,
+                          int req_len)
+{
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    ++ptp->in_err;
+    reqp = reqp;                /* dummy to silence compiler */
+    req_len = req_len;
+}
+
 void
 set_scsi_pt_task_attr(struct sg_pt_base * vp, int attribute, int priority)
 {
@@ -243,11 +371,42 @@ set_scsi_pt_flags(struct sg_pt_base * objp, int flags)
     flags = flags;
 }
 
-/* Executes SCSI command (or at least forwards it to lower layers).
- * Clears os_err field prior to active call (whose result may set it
- * again). */
-int
-do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+/* Hands the command in ptp to the null device ptp->dev_fd and waits out
+ * its (injected) latency. */
+static int
+sg_pt_solaris_null_do(struct sg_pt_solaris_scsi * ptp, int verbose)
+{
+    bool is_din = !! (USCSI_READ & ptp->uscsi.uscsi_flags);
+    int res;
+    struct sg_pt_null_cmd nc;
+
+    memset(&nc, 0, sizeof(nc));
+    nc.cdbp = (const uint8_t *)ptp->uscsi.uscsi_cdb;
+    nc.cdb_len = ptp->uscsi.uscsi_cdblen;
+    if (is_din) {
+        nc.dinp = (uint8_t *)ptp->uscsi.uscsi_bufaddr;
+        nc.din_len = ptp->uscsi.uscsi_buflen;
+    } else {
+        nc.doutp = (const uint8_t *)ptp->uscsi.uscsi_bufaddr;
+        nc.dout_len = ptp->uscsi.uscsi_buflen;
+    }
+    nc.sensep = (uint8_t *)ptp->uscsi.uscsi_rqbuf;
+    nc.max_sense_len = ptp->max_sense_len;
+    res = sg_pt_null_cmd(ptp->dev_fd, &nc, verbose);
+    if (res) {
+        ptp->os_err = -res;
+        return res;
+    }
+    ptp->uscsi.uscsi_status = nc.scsi_status;
+    ptp->uscsi.uscsi_resid = is_din ? nc.din_resid : nc.dout_resid;
+    ptp->uscsi.uscsi_rqresid = ptp->max_sense_len - nc.sense_len;
+    ptp->uscsi.uscsi_rqstatus = 0;
+    return sg_pt_null_wait(nc.done_ns, false);
+}
+
+/* Does the work of do_scsi_pt() */
+static int
+do_scsi_pt_com(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
 {
     struct sg_pt_solaris_scsi * ptp = &vp->impl;
     FILE * ferr = sg_warnings_strm ? sg_warnings_strm : stderr;
@@ -281,8 +440,13 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
             fprintf(ferr, "%s: No SCSI command (cdb) given\n", __func__);
         return SCSI_PT_DO_BAD_PARAMS;
     }
+    if (sg_pt_null_is_fd(ptp->dev_fd))
+        return sg_pt_solaris_null_do(ptp, verbose);
     if (time_secs > 0)
         ptp->uscsi.uscsi_timeout = time_secs;
+    else if (time_secs < 0)     /* milliseconds, round up */
+        ptp->uscsi.uscsi_timeout = (sg_pt_timeout_ms(time_secs, 0) +
+                                    999) / 1000;
 
     if (ioctl(ptp->dev_fd, USCSICMD, &ptp->uscsi)) {
         ptp->os_err = errno;
@@ -298,6 +462,92 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
     return 0;
 }
 
+/* Executes SCSI command (or at least forwards it to lower layers).
+ * Clears os_err field prior to active call (whose result may set it
+ * again). */
+int
+do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
+{
+    int res, n;
+    struct sg_pt_solaris_scsi * ptp = &vp->impl;
+
+    if (ptp->iovp && (! ptp->iov_din))
+        sg_pt_iov_gather(ptp->iovp, ptp->iov_cnt,
+                         (uint8_t *)ptp->uscsi.uscsi_bufaddr);
+    res = do_scsi_pt_com(vp, fd, time_secs, verbose);
+    if (ptp->iovp && ptp->iov_din && (0 == res)) {
+        n = ptp->uscsi.uscsi_buflen - ptp->uscsi.uscsi_resid;
+        if (n > 0)
+            sg_pt_iov_scatter(ptp->iovp, ptp->iov_cnt,
+                              (const uint8_t *)ptp->uscsi.uscsi_bufaddr, n);
+    }
+    return res;
+}
+
+/* No asynchronous pass-through mechanism is used on this OS, so the
+ * command is executed synchronously at submit time. */
+int
+do_scsi_pt_submit(struct sg_pt_base * vp, int fd, int time_secs,
+                  int verbose)
+{
+    return do_scsi_pt(vp, fd, time_secs, verbose);
+}
+
+int
+do_scsi_pt_receive(struct sg_pt_base * vp __attribute__ ((unused)),
+                   bool no_wait __attribute__ ((unused)),
+                   int verbose __attribute__ ((unused)))
+{
+    return 0;
+}
+
+/* This OS has no batched pass-through mechanism, so the commands are
+ * executed one after the other. */
+int
+do_scsi_pt_batch(struct sg_pt_base * objp_arr[], int num, int time_secs,
+                 int * num_donep, int verbose)
+{
+    int k;
+    int res = 0;
+
+    for (k = 0; k < num; ++k) {
+        res = do_scsi_pt(objp_arr[k], -1, time_secs, verbose);
+        if (res)
+            break;
+    }
+    if (num_donep)
+        *num_donep = k;
+    return res;
+}
+
+/* This OS has no pass-through mechanism for sharing requests */
+int
+scsi_pt_share_fds(int rd_fd __attribute__ ((unused)),
+                  int wr_fd __attribute__ ((unused)),
+                  int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+scsi_pt_unshare_fds(int fd __attribute__ ((unused)),
+                    int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+do_scsi_pt_shared_rw(struct sg_pt_base * rd_vp __attribute__ ((unused)),
+                     struct sg_pt_base * wr_vp __attribute__ ((unused)),
+                     int num_bytes __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     bool * wr_issuedp, int vb __attribute__ ((unused)))
+{
+    if (wr_issuedp)
+        *wr_issuedp = false;
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
 int
 get_scsi_pt_result_category(const struct sg_pt_base * vp)
 {
@@ -455,6 +705,15 @@ pt_device_is_nvme(const struct sg_pt_base * vp)
     return ptp ? ptp->is_nvme : false;
 }
 
+/* No Identify cache for this pass-through */
+uint32_t
+get_pt_nvme_max_xfer(struct sg_pt_base * vp __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     int vb __attribute__ ((unused)))
+{
+    return 0;
+}
+
 char *
 get_scsi_pt_transport_err_str(const struct sg_pt_base * vp, int max_b_len,
                               char * b)
@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-/* sg_pt_win32 version 1.30 20190210 */
+/* sg_pt_win32 version 1.31 20261014 */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,6 +29,7 @@
 #include "sg_pt.h"
 #include "sg_pt_win32.h"
 #include "sg_pt_nvme.h"
+#include "sg_pt_null.h"
 #include "sg_pr2serr.h"
 
 
@@ -128,7 +129,9 @@ struct sg_pt_handle {
     bool bus_type_failed;
     bool is_nvme;
     bool got_physical_drive;
+    bool overlapped;    /* fh opened with FILE_FLAG_OVERLAPPED */
     HANDLE fh;
+    HANDLE iocp;        /* completion port bound to fh, or NULL */
     char adapter[32];   /* for example: '\\.\scsi3' */
     int bus;            /* a.k.a. PathId in MS docs */
     int target;
@@ -174,6 +177,15 @@ struct sg_pt_win32_scsi {
     uint8_t * nvme_id_ctlp;
     uint8_t * free_nvme_id_ctlp;
     struct sg_sntl_dev_state_t * dev_statp; /* points to handle's dev_stat */
+    const struct sg_pt_iovec * iovp;    /* bounced via dxferp */
+    int iov_cnt;
+    bool iov_din;               /* direction of iovp (when non-NULL) */
+    uint8_t * free_iov_bp;
+    bool ovl_inflight;          /* submitted on an overlapped handle */
+    bool ovl_done;              /* its completion packet was dequeued */
+    bool ovl_direct;            /* SPTD (true) or SPT (false) submitted */
+    DWORD ovl_err;              /* GetLastError() of the completion */
+    OVERLAPPED ovl;             /* must not move while ovl_inflight */
     uint8_t nvme_cmd[64];
     union {
         SCSI_PASS_THROUGH_DIRECT_WITH_BUFFER swb_d;
@@ -312,6 +324,41 @@ get_err_str(DWORD err, int max_b_len, char * b)
     return b;
 }
 
+/* Wrapper for DeviceIoControl(). When shp->fh was opened for overlapped
+ * I/O then an OVERLAPPED object must be provided, so this function uses a
+ * private one and waits for the ioctl to complete; the low order bit of
+ * its event handle is set so that the completion is not queued to the
+ * completion port. Returns as for DeviceIoControl() and GetLastError()
+ * is valid when FALSE is returned. */
+static BOOL
+win32_ioctl(struct sg_pt_handle * shp, DWORD code, void * inp, DWORD in_len,
+            void * outp, DWORD out_len, DWORD * returnedp)
+{
+    BOOL ok;
+    DWORD err;
+    HANDLE evh;
+    OVERLAPPED ov;
+
+    if (! shp->overlapped)
+        return DeviceIoControl(shp->fh, code, inp, in_len, outp, out_len,
+                               returnedp, NULL);
+    evh = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (NULL == evh)
+        return FALSE;
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = (HANDLE)((uintptr_t)evh | 1);
+    ok = DeviceIoControl(shp->fh, code, inp, in_len, outp, out_len,
+                         returnedp, &ov);
+    if ((! ok) && (ERROR_IO_PENDING == GetLastError())) {
+        WaitForSingleObject(evh, INFINITE);
+        ok = GetOverlappedResult(shp->fh, &ov, returnedp, FALSE);
+    }
+    err = GetLastError();
+    CloseHandle(evh);
+    SetLastError(err);
+    return ok;
+}
+
 /* Returns pointer to sg_pt_handle object given Unix like device_fd. If
  * device_fd is invalid or not open returns NULL. If psp is non-NULL and
  * NULL is returned then ENODEV is placed in psp->os_err. */
@@ -339,6 +386,52 @@ get_open_pt_handle(struct sg_pt_win32_scsi * psp, int device_fd, bool vbb)
     return shp;
 }
 
+/* Dequeues completion packets from the port of shp until the overlapped
+ * command of psp has completed. Packets of other commands in flight on the
+ * same handle are marked as done in their objects. Waits at most 'msecs'
+ * milliseconds (may be INFINITE). Returns 0 when psp's command is done,
+ * -EAGAIN on timeout, else a negated errno. */
+static int
+win32_ovl_reap(struct sg_pt_handle * shp, struct sg_pt_win32_scsi * psp,
+               DWORD msecs)
+{
+    BOOL ok;
+    DWORD n;
+    ULONG_PTR key;
+    OVERLAPPED * ovp;
+    struct sg_pt_win32_scsi * cpsp;
+
+    while (! psp->ovl_done) {
+        ovp = NULL;
+        ok = GetQueuedCompletionStatus(shp->iocp, &n, &key, &ovp, msecs);
+        if (NULL == ovp) {      /* nothing dequeued */
+            if (WAIT_TIMEOUT == GetLastError())
+                return -EAGAIN;
+            return -EIO;
+        }
+        cpsp = CONTAINING_RECORD(ovp, struct sg_pt_win32_scsi, ovl);
+        cpsp->ovl_err = ok ? 0 : GetLastError();
+        cpsp->ovl_done = true;
+    }
+    return 0;
+}
+
+/* The kernel may still write to psp (and its buffers) when a command is
+ * in flight, so before psp is freed or cleared wait for that to finish. */
+static void
+win32_ovl_drain(struct sg_pt_win32_scsi * psp)
+{
+    struct sg_pt_handle * shp;
+
+    if (! psp->ovl_inflight)
+        return;
+    shp = get_open_pt_handle(NULL, psp->dev_fd, false);
+    if (shp && shp->iocp)
+        win32_ovl_reap(shp, psp, INFINITE);
+    psp->ovl_inflight = false;
+    psp->ovl_done = false;
+}
+
 
 /* Returns >= 0 if successful. If error in Unix returns negated errno. */
 int
@@ -361,6 +454,11 @@ scsi_pt_open_device(const char * device_name, bool read_only, int vb)
  * is optionally and if not given 0 is assumed. Since "PhysicalDrive"
  * is a lot of keystrokes, "PD" is accepted and converted to the longer
  * form.
+ * If the SG3_UTILS_WIN32_OVERLAPPED environment variable is defined then
+ * the handle is opened for overlapped I/O and bound to a completion port
+ * so that do_scsi_pt_submit() can have several SCSI commands in flight.
+ * A device_name starting with SG_PT_NULL_DEV_NAME opens a null device, see
+ * sg_pt_null.h .
  */
 int
 scsi_pt_open_flags(const char * device_name, int flags, int vb)
@@ -368,9 +466,12 @@ scsi_pt_open_flags(const char * device_name, int flags, int vb)
     bool got_scsi_name = false;
     int len, k, adapter_num, bus, target, lun, off, index, num, pd_num;
     int share_mode;
+    DWORD attrs;
     struct sg_pt_handle * shp;
     char buff[8];
 
+    if (sg_pt_null_dev_name(device_name))
+        return sg_pt_null_open(device_name, flags, false, vb);
     share_mode = (O_EXCL & flags) ? 0 : (FILE_SHARE_READ | FILE_SHARE_WRITE);
     /* lock */
     for (k = 0; k < MAX_OPEN_SIMULT; k++)
@@ -452,9 +553,11 @@ scsi_pt_open_flags(const char * device_name, int flags, int vb)
     if (vb > 4)
         pr2ws("%s: CreateFile('%s'), bus=%d, target=%d, lun=%d\n", __func__,
               shp->adapter, bus, target, lun);
+    shp->overlapped = (NULL != getenv("SG3_UTILS_WIN32_OVERLAPPED"));
+    attrs = shp->overlapped ? FILE_FLAG_OVERLAPPED : 0;
 #if 1
     shp->fh = CreateFile(shp->adapter, GENERIC_READ | GENERIC_WRITE,
-                         share_mode, NULL, OPEN_EXISTING, 0, NULL);
+                         share_mode, NULL, OPEN_EXISTING, attrs, NULL);
 #endif
 
 #if 0
@@ -476,6 +579,18 @@ scsi_pt_open_flags(const char * device_name, int flags, int vb)
         shp->in_use = false;
         return -ENODEV;
     }
+    if (shp->overlapped) {
+        /* on failure commands are still issued, but synchronously */
+        shp->iocp = CreateIoCompletionPort(shp->fh, NULL, (ULONG_PTR)shp,
+                                           0);
+        if ((NULL == shp->iocp) && vb) {
+            uint32_t err = (uint32_t)GetLastError();
+            char b[128];
+
+            pr2ws("%s: CreateIoCompletionPort error: %s [%u]\n", __func__,
+                  get_err_str(err, sizeof(b), b), err);
+        }
+    }
     return index + WIN32_FDOFFSET;
 }
 
@@ -487,12 +602,20 @@ scsi_pt_open_flags(const char * device_name, int flags, int vb)
 int
 scsi_pt_close_device(int device_fd)
 {
-    struct sg_pt_handle * shp = get_open_pt_handle(NULL, device_fd, false);
+    struct sg_pt_handle * shp;
 
+    if (sg_pt_null_is_fd(device_fd))
+        return sg_pt_null_close(device_fd);
+    shp = get_open_pt_handle(NULL, device_fd, false);
     if (NULL == shp)
         return -ENODEV;
     if ((! CloseHandle(shp->fh)) && shp->verbose)
         pr2ws("Windows CloseHandle error=%u\n", (unsigned int)GetLastError());
+    if (shp->iocp) {
+        CloseHandle(shp->iocp);
+        shp->iocp = NULL;
+    }
+    shp->overlapped = false;
     shp->bus = 0;
     shp->target = 0;
     shp->lun = 0;
@@ -527,8 +650,8 @@ get_scsi_pdt(struct sg_pt_handle *shp, int vb)
         pr2ws("%s: unable to allocate %d bytes\n", __func__, alloc_sz);
         return -ENOMEM;
     }
-    ok = DeviceIoControl(shp->fh, IOCTL_SCSI_GET_INQUIRY_DATA,
-                         NULL, 0, inqBuf, alloc_sz, &dummy, NULL);
+    ok = win32_ioctl(shp, IOCTL_SCSI_GET_INQUIRY_DATA,
+                     NULL, 0, inqBuf, alloc_sz, &dummy);
     if (ok) {
         PSCSI_ADAPTER_BUS_INFO  ai;
         PSCSI_BUS_DATA pbd;
@@ -589,9 +712,9 @@ get_bus_type(struct sg_pt_handle *shp, const char *dname,
     char b[256];
 
     memset(&sddd, 0, sizeof(sddd));
-    if (! DeviceIoControl(shp->fh, IOCTL_STORAGE_QUERY_PROPERTY,
-                          &query, sizeof(query), &sddd, sizeof(sddd),
-                          &num_out, NULL)) {
+    if (! win32_ioctl(shp, IOCTL_STORAGE_QUERY_PROPERTY,
+                      &query, sizeof(query), &sddd, sizeof(sddd),
+                      &num_out)) {
         if (vb > 2) {
             err = GetLastError();
             pr2ws("%s  IOCTL_STORAGE_QUERY_PROPERTY(Devprop) failed, "
@@ -637,6 +760,8 @@ check_pt_file_handle(int device_fd, const char * device_name, int vb)
 
     if (vb > 3)
         pr2ws("%s: device_name: %s\n", __func__, dnp);
+    if (sg_pt_null_is_fd(device_fd))
+        return 1;
     shp = get_open_pt_handle(NULL, device_fd, vb > 1);
     if (NULL == shp) {
         pr2ws("%s: device_fd (%s) bad or not in_use ??\n", __func__,
@@ -676,7 +801,7 @@ construct_scsi_pt_obj_with_fd(int dev_fd, int vb)
     struct sg_pt_base * vp = NULL;
     struct sg_pt_handle * shp = NULL;
 
-    if (dev_fd >= 0) {
+    if ((dev_fd >= 0) && (! sg_pt_null_is_fd(dev_fd))) {
         shp = get_open_pt_handle(NULL, dev_fd, vb > 1);
         if (NULL == shp) {
             if (vb)
@@ -750,6 +875,9 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
         struct sg_pt_win32_scsi * psp = vp->implp;
 
         if (psp) {
+            win32_ovl_drain(psp);
+            if (psp->free_iov_bp)
+                free(psp->free_iov_bp);
             free(psp);
         }
         free(vp);
@@ -780,6 +908,13 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_han, int vb)
             psp->nvme_nsid = 0;
             return 0;
         }
+        if (sg_pt_null_is_fd(dev_han)) {
+            psp->os_err = 0;
+            psp->dev_fd = dev_han;
+            psp->is_nvme = false;
+            psp->nvme_nsid = 0;
+            return 0;
+        }
         shp = get_open_pt_handle(psp, dev_han, vb > 1);
         if (NULL == shp) {
             if (vb)
@@ -842,6 +977,9 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
         is_nvme = psp->is_nvme;
         nvme_nsid = psp->nvme_nsid;
         dsp = psp->dev_statp;
+        win32_ovl_drain(psp);
+        if (psp->free_iov_bp)
+            free(psp->free_iov_bp);
         memset(psp, 0, sizeof(struct sg_pt_win32_scsi));
         if (spt_direct) {
             psp->swb_d.spt.DataIn = SCSI_IOCTL_DATA_UNSPECIFIED;
@@ -863,6 +1001,36 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
     }
 }
 
+/* Keeps the sense and data buffer bindings; resets the cdb (or NVMe
+ * command) and the results of the previous command. */
+void
+rearm_scsi_pt_obj(struct sg_pt_base * vp)
+{
+    struct sg_pt_win32_scsi * psp = vp->implp;
+
+    if (psp) {
+        if (psp->sensep && (psp->sense_len > psp->sense_resid))
+            memset(psp->sensep, 0, psp->sense_len - psp->sense_resid);
+        if (spt_direct) {
+            psp->swb_d.spt.CdbLength = 0;
+            psp->swb_d.spt.ScsiStatus = 0;
+        } else {
+            psp->swb_i.spt.CdbLength = 0;
+            psp->swb_i.spt.ScsiStatus = 0;
+        }
+        psp->have_nvme_cmd = false;
+        psp->nvme_direct = false;
+        psp->scsi_status = 0;
+        psp->resid = 0;
+        psp->sense_resid = 0;
+        psp->in_err = 0;
+        psp->os_err = 0;
+        psp->transport_err = 0;
+        psp->nvme_result = 0;
+        psp->nvme_status = 0;
+    }
+}
+
 void
 set_scsi_pt_cdb(struct sg_pt_base * vp, const uint8_t * cdb,
                 int cdb_len)
@@ -949,6 +1117,60 @@ set_scsi_pt_data_out(struct sg_pt_base * vp, const uint8_t * dxferp,
     }
 }
 
+/* Neither SPT nor SPTD take a scatter gather list so the data is bounced
+ * through a buffer owned by the object; only one direction can use a
+ * list. */
+static void
+set_scsi_pt_data_iov(struct sg_pt_base * vp, const struct sg_pt_iovec * iovp,
+                     int iov_count, bool is_din)
+{
+    int len = sg_pt_iov_len(iovp, iov_count);
+    uint8_t * bp;
+    struct sg_pt_win32_scsi * psp = vp->implp;
+
+    if (psp->iovp || (len < 0)) {
+        ++psp->in_err;
+        return;
+    }
+    if (len <= 0)
+        return;
+    bp = sg_memalign(len, 0, &psp->free_iov_bp, false);
+    if (NULL == bp) {
+        ++psp->in_err;
+        return;
+    }
+    psp->iovp = iovp;
+    psp->iov_cnt = iov_count;
+    psp->iov_din = is_din;
+    if (is_din)
+        set_scsi_pt_data_in(vp, bp, len);
+    else
+        set_scsi_pt_data_out(vp, bp, len);
+}
+
+void
+set_scsi_pt_data_in_iov(struct sg_pt_base * vp,
+                        const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(vp, iovp, iov_count, true);
+}
+
+void
+set_scsi_pt_data_out_iov(struct sg_pt_base * vp,
+                         const struct sg_pt_iovec * iovp, int iov_count)
+{
+    set_scsi_pt_data_iov(vp, iovp, iov_count, false);
+}
+
+/* This pass-through has no kernel buffer that can be mapped */
+uint8_t *
+set_scsi_pt_data_in_mmap(struct sg_pt_base * vp __attribute__ ((unused)),
+                         int dxfer_ilen __attribute__ ((unused)),
+                         int verbose __attribute__ ((unused)))
+{
+    return NULL;
+}
+
 void
 set_pt_metadata_xfer(struct sg_pt_base * vp, uint8_t * mdxferp,
                      uint32_t mdxfer_len, bool out_true)
@@ -987,6 +1209,16 @@ set_scsi_pt_task_management(struct sg_pt_base * vp,
     ++psp->in_err;
 }
 
+void
+set_scsi_pt_transport_req(struct sg_pt_base * vp,
+                          const uint8_t * reqp __attribute__ ((unused)),
+                          int req_len __attribute__ ((unused)))
+{
+    struct sg_pt_win32_scsi * psp = vp->implp;
+
+    ++psp->in_err;
+}
+
 void
 set_scsi_pt_task_attr(struct sg_pt_base * vp,
                       int attrib __attribute__ ((unused)),
@@ -1005,12 +1237,49 @@ set_scsi_pt_flags(struct sg_pt_base * objp, int flags)
     flags = flags;
 }
 
+/* Processes the response of a command sent with the direct interface.
+ * 'ok' and 'err' are from DeviceIoControl() or, for an overlapped command,
+ * from its completion packet. */
+static int
+scsi_pt_direct_fini(struct sg_pt_win32_scsi * psp, BOOL ok, DWORD err,
+                    int vb)
+{
+    if (! ok) {
+        unsigned int u = (unsigned int)err;
+
+        if (vb) {
+            char b[128];
+
+            pr2ws("%s: DeviceIoControl: %s [%u]\n", __func__,
+                  get_err_str(u, sizeof(b), b), u);
+        }
+        psp->transport_err = (int)u;
+        psp->os_err = EIO;
+        return 0;       /* let app find transport error */
+    }
+
+    psp->scsi_status = psp->swb_d.spt.ScsiStatus;
+    if ((SAM_STAT_CHECK_CONDITION == psp->scsi_status) ||
+        (SAM_STAT_COMMAND_TERMINATED == psp->scsi_status))
+        memcpy(psp->sensep, psp->swb_d.ucSenseBuf, psp->sense_len);
+    else
+        psp->sense_len = 0;
+    psp->sense_resid = 0;
+    if ((psp->dxfer_len > 0) && (psp->swb_d.spt.DataTransferLength > 0))
+        psp->resid = psp->dxfer_len - psp->swb_d.spt.DataTransferLength;
+    else
+        psp->resid = 0;
+
+    return 0;
+}
+
 /* Executes SCSI command (or at least forwards it to lower layers)
  * using direct interface. Clears os_err field prior to active call (whose
- * result may set it again). */
+ * result may set it again). If 'async' is true then the command is issued
+ * on the (overlapped) handle and do_scsi_pt_receive() completes it. */
 static int
 scsi_pt_direct(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
-               int time_secs, int vb)
+               int time_secs, bool async, int vb)
 {
     BOOL status;
     DWORD returned;
@@ -1025,7 +1294,10 @@ scsi_pt_direct(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
     psp->swb_d.spt.PathId = shp->bus;
     psp->swb_d.spt.TargetId = shp->target;
     psp->swb_d.spt.Lun = shp->lun;
-    psp->swb_d.spt.TimeOutValue = time_secs;
+    /* in seconds, round up milliseconds */
+    psp->swb_d.spt.TimeOutValue = (sg_pt_timeout_ms(time_secs,
+                                                    DEF_TIMEOUT * 1000) +
+                                   999) / 1000;
     psp->swb_d.spt.DataTransferLength = psp->dxfer_len;
     if (vb > 4) {
         pr2ws(" spt_direct, adapter: %s  Length=%d ScsiStatus=%d PathId=%d "
@@ -1044,17 +1316,34 @@ scsi_pt_direct(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
               (unsigned int)psp->swb_d.spt.SenseInfoOffset);
     }
     psp->swb_d.spt.DataBuffer = psp->dxferp;
-    status = DeviceIoControl(shp->fh, IOCTL_SCSI_PASS_THROUGH_DIRECT,
-                            &psp->swb_d,
-                            sizeof(psp->swb_d),
-                            &psp->swb_d,
-                            sizeof(psp->swb_d),
-                            &returned,
-                            NULL);
-    if (! status) {
-        unsigned int u;
-
-        u = (unsigned int)GetLastError();
+    if (async) {
+        memset(&psp->ovl, 0, sizeof(psp->ovl));
+        psp->ovl_direct = true;
+        psp->ovl_done = false;
+        status = DeviceIoControl(shp->fh, IOCTL_SCSI_PASS_THROUGH_DIRECT,
+                                 &psp->swb_d, sizeof(psp->swb_d),
+                                 &psp->swb_d, sizeof(psp->swb_d),
+                                 &returned, &psp->ovl);
+        if (status || (ERROR_IO_PENDING == GetLastError())) {
+            psp->ovl_inflight = true;   /* packet will reach the port */
+            return 0;
+        }
+    } else
+        status = win32_ioctl(shp, IOCTL_SCSI_PASS_THROUGH_DIRECT,
+                             &psp->swb_d, sizeof(psp->swb_d),
+                             &psp->swb_d, sizeof(psp->swb_d), &returned);
+    return scsi_pt_direct_fini(psp, status, status ? 0 : GetLastError(), vb);
+}
+
+/* Processes the response of a command sent with the indirect interface.
+ * 'ok' and 'err' are as for scsi_pt_direct_fini(). */
+static int
+scsi_pt_indirect_fini(struct sg_pt_win32_scsi * psp, BOOL ok, DWORD err,
+                      int vb)
+{
+    if (! ok) {
+        uint32_t u = (uint32_t)err;
+
         if (vb) {
             char b[128];
 
@@ -1065,16 +1354,18 @@ scsi_pt_direct(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
         psp->os_err = EIO;
         return 0;       /* let app find transport error */
     }
+    if ((psp->dxfer_len > 0) && (SCSI_IOCTL_DATA_IN == psp->swb_i.spt.DataIn))
+        memcpy(psp->dxferp, psp->swb_i.ucDataBuf, psp->dxfer_len);
 
-    psp->scsi_status = psp->swb_d.spt.ScsiStatus;
+    psp->scsi_status = psp->swb_i.spt.ScsiStatus;
     if ((SAM_STAT_CHECK_CONDITION == psp->scsi_status) ||
         (SAM_STAT_COMMAND_TERMINATED == psp->scsi_status))
-        memcpy(psp->sensep, psp->swb_d.ucSenseBuf, psp->sense_len);
+        memcpy(psp->sensep, psp->swb_i.ucSenseBuf, psp->sense_len);
     else
         psp->sense_len = 0;
     psp->sense_resid = 0;
-    if ((psp->dxfer_len > 0) && (psp->swb_d.spt.DataTransferLength > 0))
-        psp->resid = psp->dxfer_len - psp->swb_d.spt.DataTransferLength;
+    if ((psp->dxfer_len > 0) && (psp->swb_i.spt.DataTransferLength > 0))
+        psp->resid = psp->dxfer_len - psp->swb_i.spt.DataTransferLength;
     else
         psp->resid = 0;
 
@@ -1083,10 +1374,11 @@ scsi_pt_direct(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
 
 /* Executes SCSI command (or at least forwards it to lower layers) using
  * indirect interface. Clears os_err field prior to active call (whose
- * result may set it again). */
+ * result may set it again). If 'async' is true then the command is issued
+ * on the (overlapped) handle and do_scsi_pt_receive() completes it. */
 static int
 scsi_pt_indirect(struct sg_pt_base * vp, struct sg_pt_handle * shp,
-                 int time_secs, int vb)
+                 int time_secs, bool async, int vb)
 {
     BOOL status;
     DWORD returned;
@@ -1124,7 +1416,9 @@ scsi_pt_indirect(struct sg_pt_base * vp, struct sg_pt_handle * shp,
     psp->swb_i.spt.PathId = shp->bus;
     psp->swb_i.spt.TargetId = shp->target;
     psp->swb_i.spt.Lun = shp->lun;
-    psp->swb_i.spt.TimeOutValue = time_secs;
+    psp->swb_i.spt.TimeOutValue = (sg_pt_timeout_ms(time_secs,
+                                                    DEF_TIMEOUT * 1000) +
+                                   999) / 1000;
     psp->swb_i.spt.DataTransferLength = psp->dxfer_len;
     if (vb > 4) {
         pr2ws(" spt_indirect, adapter: %s  Length=%d ScsiStatus=%d PathId=%d "
@@ -1147,51 +1441,68 @@ scsi_pt_indirect(struct sg_pt_base * vp, struct sg_pt_handle * shp,
     if ((psp->dxfer_len > 0) &&
         (SCSI_IOCTL_DATA_OUT == psp->swb_i.spt.DataIn))
         memcpy(psp->swb_i.ucDataBuf, psp->dxferp, psp->dxfer_len);
-    status = DeviceIoControl(shp->fh, IOCTL_SCSI_PASS_THROUGH,
-                            &psp->swb_i,
-                            sizeof(psp->swb_i),
-                            &psp->swb_i,
-                            sizeof(psp->swb_i),
-                            &returned,
-                            NULL);
-    if (! status) {
-        uint32_t u = (uint32_t)GetLastError();
-
-        if (vb) {
-            char b[128];
-
-            pr2ws("%s: DeviceIoControl: %s [%u]\n", __func__,
-                  get_err_str(u, sizeof(b), b), u);
+    if (async) {
+        memset(&psp->ovl, 0, sizeof(psp->ovl));
+        psp->ovl_direct = false;
+        psp->ovl_done = false;
+        status = DeviceIoControl(shp->fh, IOCTL_SCSI_PASS_THROUGH,
+                                 &psp->swb_i, sizeof(psp->swb_i),
+                                 &psp->swb_i, sizeof(psp->swb_i),
+                                 &returned, &psp->ovl);
+        if (status || (ERROR_IO_PENDING == GetLastError())) {
+            psp->ovl_inflight = true;   /* packet will reach the port */
+            return 0;
         }
-        psp->transport_err = (int)u;
-        psp->os_err = EIO;
-        return 0;       /* let app find transport error */
-    }
-    if ((psp->dxfer_len > 0) && (SCSI_IOCTL_DATA_IN == psp->swb_i.spt.DataIn))
-        memcpy(psp->dxferp, psp->swb_i.ucDataBuf, psp->dxfer_len);
+    } else
+        status = win32_ioctl(shp, IOCTL_SCSI_PASS_THROUGH,
+                             &psp->swb_i, sizeof(psp->swb_i),
+                             &psp->swb_i, sizeof(psp->swb_i), &returned);
+    return scsi_pt_indirect_fini(psp, status, status ? 0 : GetLastError(),
+                                 vb);
+}
 
-    psp->scsi_status = psp->swb_i.spt.ScsiStatus;
-    if ((SAM_STAT_CHECK_CONDITION == psp->scsi_status) ||
-        (SAM_STAT_COMMAND_TERMINATED == psp->scsi_status))
-        memcpy(psp->sensep, psp->swb_i.ucSenseBuf, psp->sense_len);
-    else
-        psp->sense_len = 0;
-    psp->sense_resid = 0;
-    if ((psp->dxfer_len > 0) && (psp->swb_i.spt.DataTransferLength > 0))
-        psp->resid = psp->dxfer_len - psp->swb_i.spt.DataTransferLength;
-    else
-        psp->resid = 0;
+/* Hands the command in psp to the null device dev_fd and waits out its
+ * (injected) latency. */
+static int
+sg_pt_win32_null_do(struct sg_pt_win32_scsi * psp, int dev_fd, int vb)
+{
+    int res;
+    struct sg_pt_null_cmd nc;
 
-    return 0;
+    memset(&nc, 0, sizeof(nc));
+    if (spt_direct) {
+        nc.cdbp = (const uint8_t *)psp->swb_d.spt.Cdb;
+        nc.cdb_len = psp->swb_d.spt.CdbLength;
+    } else {
+        nc.cdbp = (const uint8_t *)psp->swb_i.spt.Cdb;
+        nc.cdb_len = psp->swb_i.spt.CdbLength;
+    }
+    if (psp->is_read) {
+        nc.dinp = psp->dxferp;
+        nc.din_len = (int)psp->dxfer_len;
+    } else {
+        nc.doutp = psp->dxferp;
+        nc.dout_len = (int)psp->dxfer_len;
+    }
+    nc.sensep = psp->sensep;
+    nc.max_sense_len = psp->sense_len;
+    res = sg_pt_null_cmd(dev_fd, &nc, vb);
+    if (res) {
+        psp->os_err = -res;
+        return res;
+    }
+    psp->scsi_status = nc.scsi_status;
+    psp->resid = psp->is_read ? nc.din_resid : nc.dout_resid;
+    psp->sense_resid = psp->sense_len - nc.sense_len;
+    return sg_pt_null_wait(nc.done_ns, false);
 }
 
-/* Executes SCSI or NVME command (or at least forwards it to lower layers).
- * Clears os_err field prior to active call (whose result may set it
- * again). Returns 0 on success, positive SCSI_PT_DO_* errors for syntax
- * like errors and negated errnos for OS errors. For Windows its errors
- * are placed in psp->transport_err and a errno is simulated. */
-int
-do_scsi_pt(struct sg_pt_base * vp, int dev_fd, int time_secs, int vb)
+/* Does the work of do_scsi_pt() and do_scsi_pt_submit(). The latter
+ * passes async=true which only takes effect for SCSI commands on handles
+ * bound to a completion port */
+static int
+do_scsi_pt_com(struct sg_pt_base * vp, int dev_fd, int time_secs,
+               bool async, int vb)
 {
     int res;
     struct sg_pt_win32_scsi * psp = vp->implp;
@@ -1202,6 +1513,11 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_fd, int time_secs, int vb)
             pr2ws("%s: NULL 1st argument to this function\n", __func__);
         return SCSI_PT_DO_BAD_PARAMS;
     }
+    if (psp->ovl_inflight) {
+        if (vb)
+            pr2ws("%s: previous command still in flight\n", __func__);
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
     psp->os_err = 0;
     if (dev_fd >= 0) {
         if ((psp->dev_fd >= 0) && (dev_fd != psp->dev_fd)) {
@@ -1217,6 +1533,8 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_fd, int time_secs, int vb)
         return SCSI_PT_DO_BAD_PARAMS;
     } else
         dev_fd = psp->dev_fd;
+    if (sg_pt_null_is_fd(dev_fd))
+        return sg_pt_win32_null_do(psp, dev_fd, vb);
     shp = get_open_pt_handle(psp, dev_fd, vb > 3);
     if (NULL == shp)
         return -psp->os_err;
@@ -1240,10 +1558,140 @@ do_scsi_pt(struct sg_pt_base * vp, int dev_fd, int time_secs, int vb)
 
     if (psp->is_nvme)
         return nvme_pt(psp, shp, time_secs, vb);
-    else if (spt_direct)
-        return scsi_pt_direct(psp, shp, time_secs, vb);
+    async = async && (NULL != shp->iocp);
+    if (spt_direct)
+        return scsi_pt_direct(psp, shp, time_secs, async, vb);
     else
-        return scsi_pt_indirect(vp, shp, time_secs, vb);
+        return scsi_pt_indirect(vp, shp, time_secs, async, vb);
+}
+
+/* Gathers data-out from the iovec array (if any) before the command and
+ * scatters data-in to it after the command has completed. */
+static int
+do_scsi_pt_iov(struct sg_pt_base * vp, int dev_fd, int time_secs,
+               bool async, int vb)
+{
+    int res, n;
+    struct sg_pt_win32_scsi * psp = vp ? vp->implp : NULL;
+
+    if (psp && psp->iovp && (! psp->iov_din) && (! psp->ovl_inflight))
+        sg_pt_iov_gather(psp->iovp, psp->iov_cnt, psp->dxferp);
+    res = do_scsi_pt_com(vp, dev_fd, time_secs, async, vb);
+    psp = vp ? vp->implp : NULL;        /* indirect may have moved it */
+    if (psp && psp->iovp && psp->iov_din && (0 == res) &&
+        (! psp->ovl_inflight)) {
+        n = (int)psp->dxfer_len - psp->resid;
+        if (n > 0)
+            sg_pt_iov_scatter(psp->iovp, psp->iov_cnt, psp->dxferp, n);
+    }
+    return res;
+}
+
+/* Executes SCSI or NVME command (or at least forwards it to lower layers).
+ * Clears os_err field prior to active call (whose result may set it
+ * again). Returns 0 on success, positive SCSI_PT_DO_* errors for syntax
+ * like errors and negated errnos for OS errors. For Windows its errors
+ * are placed in psp->transport_err and a errno is simulated. */
+int
+do_scsi_pt(struct sg_pt_base * vp, int dev_fd, int time_secs, int vb)
+{
+    return do_scsi_pt_iov(vp, dev_fd, time_secs, false, vb);
+}
+
+/* When the handle was opened with SG3_UTILS_WIN32_OVERLAPPED defined, SCSI
+ * commands are issued as overlapped I/O and their completions are queued
+ * to the handle's completion port. Otherwise (and for NVMe) the command is
+ * executed synchronously at submit time. */
+int
+do_scsi_pt_submit(struct sg_pt_base * vp, int dev_fd, int time_secs,
+                  int vb)
+{
+    return do_scsi_pt_iov(vp, dev_fd, time_secs, true, vb);
+}
+
+int
+do_scsi_pt_receive(struct sg_pt_base * vp, bool no_wait, int vb)
+{
+    int res, n;
+    struct sg_pt_win32_scsi * psp = vp ? vp->implp : NULL;
+    struct sg_pt_handle * shp;
+
+    if ((NULL == psp) || (! psp->ovl_inflight))
+        return 0;       /* was done synchronously by do_scsi_pt_submit() */
+    shp = get_open_pt_handle(psp, psp->dev_fd, vb > 3);
+    if (NULL == shp)
+        return -psp->os_err;
+    res = win32_ovl_reap(shp, psp, no_wait ? 0 : INFINITE);
+    if (res) {
+        if ((-EAGAIN != res) && vb) {
+            uint32_t err = (uint32_t)GetLastError();
+            char b[128];
+
+            pr2ws("%s: GetQueuedCompletionStatus: %s [%u]\n", __func__,
+                  get_err_str(err, sizeof(b), b), err);
+        }
+        return res;
+    }
+    psp->ovl_inflight = false;
+    psp->ovl_done = false;
+    if (psp->ovl_direct)
+        res = scsi_pt_direct_fini(psp, 0 == psp->ovl_err, psp->ovl_err, vb);
+    else
+        res = scsi_pt_indirect_fini(psp, 0 == psp->ovl_err, psp->ovl_err,
+                                    vb);
+    if (psp->iovp && psp->iov_din && (0 == res)) {
+        n = (int)psp->dxfer_len - psp->resid;
+        if (n > 0)
+            sg_pt_iov_scatter(psp->iovp, psp->iov_cnt, psp->dxferp, n);
+    }
+    return res;
+}
+
+/* This OS has no batched pass-through mechanism, so the commands are
+ * executed one after the other. */
+int
+do_scsi_pt_batch(struct sg_pt_base * objp_arr[], int num, int time_secs,
+                 int * num_donep, int vb)
+{
+    int k;
+    int res = 0;
+
+    for (k = 0; k < num; ++k) {
+        res = do_scsi_pt(objp_arr[k], -1, time_secs, vb);
+        if (res)
+            break;
+    }
+    if (num_donep)
+        *num_donep = k;
+    return res;
+}
+
+/* This OS has no pass-through mechanism for sharing requests */
+int
+scsi_pt_share_fds(int rd_fd __attribute__ ((unused)),
+                  int wr_fd __attribute__ ((unused)),
+                  int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+scsi_pt_unshare_fds(int fd __attribute__ ((unused)),
+                    int vb __attribute__ ((unused)))
+{
+    return SCSI_PT_DO_NOT_SUPPORTED;
+}
+
+int
+do_scsi_pt_shared_rw(struct sg_pt_base * rd_vp __attribute__ ((unused)),
+                     struct sg_pt_base * wr_vp __attribute__ ((unused)),
+                     int num_bytes __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     bool * wr_issuedp, int vb __attribute__ ((unused)))
+{
+    if (wr_issuedp)
+        *wr_issuedp = false;
+    return SCSI_PT_DO_NOT_SUPPORTED;
 }
 
 int
@@ -1411,6 +1859,15 @@ get_pt_nvme_nsid(const struct sg_pt_base * vp)
     return psp->nvme_nsid;
 }
 
+/* No Identify cache for this pass-through */
+uint32_t
+get_pt_nvme_max_xfer(struct sg_pt_base * vp __attribute__ ((unused)),
+                     int time_secs __attribute__ ((unused)),
+                     int vb __attribute__ ((unused)))
+{
+    return 0;
+}
+
 /* Use the transport_err for Windows errors. */
 char *
 get_scsi_pt_transport_err_str(const struct sg_pt_base * vp, int max_b_len,
@@ -1613,9 +2070,9 @@ nvme_identify(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
     protocolData->ProtocolDataOffset = sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA);
     protocolData->ProtocolDataLength = dlen;
 
-    result = DeviceIoControl(shp->fh, IOCTL_STORAGE_QUERY_PROPERTY,
-                             buffer, bufferLength, buffer, bufferLength,
-                             &returnedLength, (OVERLAPPED*)0);
+    result = win32_ioctl(shp, IOCTL_STORAGE_QUERY_PROPERTY,
+                         buffer, bufferLength, buffer, bufferLength,
+                         &returnedLength);
     if ((! result) || (0 == returnedLength)) {
         n = (uint32_t)GetLastError();
         psp->transport_err = n;
@@ -1701,9 +2158,9 @@ nvme_get_features(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
     protocolData->ProtocolDataOffset = sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA);
     protocolData->ProtocolDataLength = dlen;
 
-    result = DeviceIoControl(shp->fh, IOCTL_STORAGE_QUERY_PROPERTY,
-                             buffer, bufferLength, buffer, bufferLength,
-                             &returnedLength, (OVERLAPPED*)0);
+    result = win32_ioctl(shp, IOCTL_STORAGE_QUERY_PROPERTY,
+                         buffer, bufferLength, buffer, bufferLength,
+                         &returnedLength);
     if ((! result) || (0 == returnedLength)) {
         n = (uint32_t)GetLastError();
         psp->transport_err = n;
@@ -1780,9 +2237,9 @@ nvme_get_log_page(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
     protocolData->ProtocolDataOffset = sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA);
     protocolData->ProtocolDataLength = dlen;
 
-    result = DeviceIoControl(shp->fh, IOCTL_STORAGE_QUERY_PROPERTY,
-                             buffer, bufferLength, buffer, bufferLength,
-                             &returnedLength, (OVERLAPPED*)0);
+    result = win32_ioctl(shp, IOCTL_STORAGE_QUERY_PROPERTY,
+                         buffer, bufferLength, buffer, bufferLength,
+                         &returnedLength);
     if ((! result) || (0 == returnedLength)) {
         n = (uint32_t)GetLastError();
         psp->transport_err = n;
@@ -1879,9 +2336,9 @@ nvme_real_pt(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
         memcpy(bp, dp, dlen);
     }
 
-    ok = DeviceIoControl(shp->fh, IOCTL_STORAGE_PROTOCOL_COMMAND,
-                         buffer, bufferLength, buffer, bufferLength,
-                         &returnLength, (OVERLAPPED*)0);
+    ok = win32_ioctl(shp, IOCTL_STORAGE_PROTOCOL_COMMAND,
+                     buffer, bufferLength, buffer, bufferLength,
+                     &returnLength);
     if (! ok) {
         n = (uint32_t)GetLastError();
         psp->transport_err = n;
@@ -2096,8 +2553,8 @@ do_nvme_admin_cmd(struct sg_pt_win32_scsi * psp, struct sg_pt_handle * shp,
         goto err_out;
     }
 
-    ok = DeviceIoControl(shp->fh, IOCTL_SCSI_MINIPORT, pthru, alloc_len,
-                         pthru, alloc_len, &num_out, (OVERLAPPED*)0);
+    ok = win32_ioctl(shp, IOCTL_SCSI_MINIPORT, pthru, alloc_len,
+                     pthru, alloc_len, &num_out);
     if (! ok) {
         n = (uint32_t)GetLastError();
         psp->transport_err = n;
@@ -0,0 +1,849 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_cmds_basic.h"
+#include "sg_pt.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+/*
+ * This program measures the performance of a SCSI logical unit through
+ * the sg3_utils pass-through (sg_pt) layer, the same path the other
+ * utilities in this package use. One or more threads each keep a given
+ * number of READ, WRITE, VERIFY or WRITE SAME commands in flight with the
+ * asynchronous do_scsi_pt_submit() and do_scsi_pt_receive() functions, at
+ * sequential or random LBAs. At the end the number of commands per second,
+ * the throughput and latency percentiles are reported.
+ */
+
+static const char * version_str = "1.00 20261014";
+
+#define DEF_BLOCK_SIZE 4096
+#define DEF_RUNTIME_SECS 10
+#define DEF_PT_TIMEOUT 60       /* 60 seconds */
+#define MAX_QUEUE_DEPTH 256
+#define MAX_THREADS 64
+#define SENSE_BUFF_LEN 64
+
+#define BENCH_READ 0
+#define BENCH_WRITE 1
+#define BENCH_VERIFY 2
+#define BENCH_WRITE_SAME 3
+
+/* Latency histogram: log-linear with 8 buckets per power of 2 (as used by
+ * the sg_pt_lat_* functions), so percentiles are within about 6% */
+#define LAT_SUB_BITS 3
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+
+static struct option long_options[] = {
+        {"16", no_argument, 0, 'S'},
+        {"bs", required_argument, 0, 'b'},
+        {"cmd", required_argument, 0, 'c'},
+        {"force", no_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {"lba", required_argument, 0, 'l'},
+        {"num", required_argument, 0, 'n'},
+        {"qd", required_argument, 0, 'q'},
+        {"random", no_argument, 0, 'R'},
+        {"range", required_argument, 0, 'r'},
+        {"runtime", required_argument, 0, 't'},
+        {"threads", required_argument, 0, 'T'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {0, 0, 0, 0},
+};
+
+struct bench_cmd_t {
+    int cmd;
+    const char * acron;
+    const char * name;
+    uint8_t opcode10;
+    uint8_t opcode16;
+    bool data_in;
+    bool data_out;
+};
+
+static struct bench_cmd_t bench_cmd_arr[] = {
+    {BENCH_READ, "read", "Read", 0x28, 0x88, true, false},
+    {BENCH_WRITE, "write", "Write", 0x2a, 0x8a, false, true},
+    {BENCH_VERIFY, "verify", "Verify", 0x2f, 0x8f, false, false},
+    {BENCH_WRITE_SAME, "ws", "Write same", 0x41, 0x93, false, true},
+    {-1, NULL, NULL, 0, 0, false, false},
+};
+
+struct opts_t {
+    bool cdb16;
+    bool do_force;
+    bool do_random;
+    int blk_per_io;     /* logical blocks per command */
+    int bs;             /* bytes per command */
+    int lb_sz;          /* logical block size of device */
+    int qd;             /* commands in flight per thread */
+    int num_threads;
+    int runtime_secs;
+    int verbose;
+    int64_t num_cmds;   /* 0 -> no limit */
+    uint64_t lba;       /* start of region */
+    uint64_t range;     /* number of logical blocks in region */
+    uint64_t num_ios;   /* range / blk_per_io */
+    uint64_t end_ns;    /* 0 -> no time limit */
+    const struct bench_cmd_t * bcp;
+    const char * device_name;
+};
+
+struct thr_t {
+    int id;
+    int sg_fd;
+    int first_err;
+    pthread_t tid;
+    uint64_t rng;       /* xorshift64 state for random LBAs */
+    uint64_t cmds;      /* completed without error */
+    uint64_t errs;
+    uint64_t lat_min_ns;
+    uint64_t lat_max_ns;
+    uint64_t lat_sum_ns;
+    uint64_t lat_bucket[LAT_BUCKETS];
+    struct opts_t * op;
+};
+
+struct slot_t {
+    bool busy;
+    uint64_t start_ns;
+    uint8_t * buffp;
+    struct sg_pt_base * ptvp;
+    uint8_t cdb[16];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
+static volatile sig_atomic_t bench_stop;   /* set by SIGINT */
+static uint64_t next_seq_io;               /* shared by threads */
+static int64_t cmds_issued;                /* shared by threads */
+
+
+static void
+usage()
+{
+    pr2serr("Usage: sg_bench [--16] [--bs=BS] [--cmd=CMD] [--force] "
+            "[--help] [--lba=LBA]\n"
+            "                [--num=NUM] [--qd=QD] [--random] "
+            "[--range=RNG]\n"
+            "                [--runtime=SECS] [--threads=THR] [--verbose] "
+            "[--version]\n"
+            "                DEVICE\n"
+            "  where:\n"
+            "    --16|-S            use 16 byte cdbs (def: 10 byte cdbs "
+            "where they fit)\n"
+            "    --bs=BS|-b BS      bytes per command, a multiple of the "
+            "logical\n"
+            "                       block size (def: 4096)\n"
+            "    --cmd=CMD|-c CMD    CMD is one of 'read', 'verify', "
+            "'write' or 'ws'\n"
+            "                       (WRITE SAME) (def: read)\n"
+            "    --force|-f         needed for 'write' and 'ws' which "
+            "overwrite data\n"
+            "    --help|-h          print out usage message then exit\n"
+            "    --lba=LBA|-l LBA    start of region to access (def: 0)\n"
+            "    --num=NUM|-n NUM    stop after NUM commands in total (def: "
+            "0 -> no\n"
+            "                       limit)\n"
+            "    --qd=QD|-q QD      commands in flight per thread (def: 1, "
+            "max: %d)\n"
+            "    --random|-R        random LBAs within region (def: "
+            "sequential)\n"
+            "    --range=RNG|-r RNG    number of logical blocks in region "
+            "(def: from\n"
+            "                          LBA to end of device)\n"
+            "    --runtime=SECS|-t SECS    stop after SECS seconds (def: 10; "
+            "0 -> no\n"
+            "                              limit)\n"
+            "    --threads=THR|-T THR    number of threads (def: 1, max: "
+            "%d)\n"
+            "    --verbose|-v       increase verbosity\n"
+            "    --version|-V       print version string and exit\n\n"
+            "Measures commands per second, throughput and latency of "
+            "DEVICE using\nREAD, WRITE, VERIFY or WRITE SAME commands sent "
+            "through the sg3_utils\npass-through layer.\n", MAX_QUEUE_DEPTH,
+            MAX_THREADS);
+}
+
+static void
+sigint_handler(int sig)
+{
+    if (SIGINT == sig)
+        bench_stop = 1;
+}
+
+static int
+lat_bucket(uint64_t v)
+{
+    int msb;
+
+    if (v < LAT_SUB)
+        return (int)v;
+    msb = 63 - __builtin_clzll(v);
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+           (int)((v >> (msb - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+/* Returns the mid point of the values that map to bucket k */
+static uint64_t
+lat_bucket_mid(int k)
+{
+    int sh;
+    uint64_t lo;
+
+    if (k < LAT_SUB)
+        return k;
+    sh = (k >> LAT_SUB_BITS) - 1;
+    lo = (uint64_t)(LAT_SUB + (k & (LAT_SUB - 1))) << sh;
+    return lo + ((((uint64_t)1 << sh) - 1) >> 1);
+}
+
+/* Chooses the index (in units of blk_per_io) of the next command. Returns
+ * false when the command count limit has been reached. */
+static bool
+next_io(struct thr_t * tp, uint64_t * iop)
+{
+    struct opts_t * op = tp->op;
+    uint64_t x;
+
+    if (op->num_cmds > 0) {
+        if (__atomic_fetch_add(&cmds_issued, 1, __ATOMIC_RELAXED) >=
+            op->num_cmds)
+            return false;
+    }
+    if (op->do_random) {
+        x = tp->rng;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        tp->rng = x;
+        *iop = x % op->num_ios;
+    } else
+        *iop = __atomic_fetch_add(&next_seq_io, 1, __ATOMIC_RELAXED) %
+               op->num_ios;
+    return true;
+}
+
+static void
+build_cdb(const struct opts_t * op, uint64_t lba, uint8_t * cdb, int * lenp)
+{
+    const struct bench_cmd_t * bcp = op->bcp;
+
+    memset(cdb, 0, 16);
+    if (op->cdb16) {
+        cdb[0] = bcp->opcode16;
+        sg_put_unaligned_be64(lba, cdb + 2);
+        sg_put_unaligned_be32((uint32_t)op->blk_per_io, cdb + 10);
+        *lenp = 16;
+    } else {
+        cdb[0] = bcp->opcode10;
+        sg_put_unaligned_be32((uint32_t)lba, cdb + 2);
+        sg_put_unaligned_be16((uint16_t)op->blk_per_io, cdb + 7);
+        *lenp = 10;
+    }
+}
+
+/* Submits command number io on slot sp. The data buffer of sp stays bound
+ * across rearm_scsi_pt_obj() calls. Returns 0 if submitted, else an error
+ * (as do_scsi_pt() ). */
+static int
+submit_io(struct thr_t * tp, struct slot_t * sp, uint64_t io)
+{
+    int cdb_len, res;
+    const struct opts_t * op = tp->op;
+
+    build_cdb(op, op->lba + (io * op->blk_per_io), sp->cdb, &cdb_len);
+    rearm_scsi_pt_obj(sp->ptvp);
+    set_scsi_pt_cdb(sp->ptvp, sp->cdb, cdb_len);
+    sp->start_ns = sg_pt_lat_now_ns();
+    res = do_scsi_pt_submit(sp->ptvp, tp->sg_fd, DEF_PT_TIMEOUT,
+                            op->verbose);
+    if (0 == res)
+        sp->busy = true;
+    return res;
+}
+
+/* Accounts for the completion of the command on slot sp whose
+ * do_scsi_pt_receive() returned pt_res. Returns 0 if the command
+ * succeeded, else an error category (e.g. SG_LIB_CAT_MEDIUM_HARD). */
+static int
+complete_io(struct thr_t * tp, struct slot_t * sp, int pt_res)
+{
+    int res, sense_cat;
+    uint64_t lat;
+    const struct opts_t * op = tp->op;
+    char b[32];
+
+    lat = sg_pt_lat_now_ns() - sp->start_ns;
+    sp->busy = false;
+    snprintf(b, sizeof(b), "%s(%d)", op->bcp->name, op->cdb16 ? 16 : 10);
+    res = sg_cmds_process_resp(sp->ptvp, b, pt_res, (0 == tp->errs),
+                               op->verbose, &sense_cat);
+    if (-1 == res)
+        res = sg_convert_errno(get_scsi_pt_os_err(sp->ptvp));
+    else if (-2 == res) {
+        switch (sense_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            res = 0;
+            break;
+        default:
+            res = sense_cat;
+            break;
+        }
+    } else
+        res = 0;
+    if (res) {
+        if (0 == tp->errs++)
+            tp->first_err = res;
+        return res;
+    }
+    ++tp->cmds;
+    tp->lat_sum_ns += lat;
+    if ((0 == tp->lat_min_ns) || (lat < tp->lat_min_ns))
+        tp->lat_min_ns = lat;
+    if (lat > tp->lat_max_ns)
+        tp->lat_max_ns = lat;
+    ++tp->lat_bucket[lat_bucket(lat)];
+    return 0;
+}
+
+static void *
+bench_thread(void * v_tp)
+{
+    bool stopping = false;
+    int k, n, res, inflight, oldest;
+    uint64_t io;
+    struct thr_t * tp = (struct thr_t *)v_tp;
+    struct opts_t * op = tp->op;
+    struct slot_t * slots;
+    struct slot_t * sp;
+    int buff_len = op->bcp->data_in || (BENCH_WRITE == op->bcp->cmd) ?
+                   op->bs : op->lb_sz;
+
+    slots = (struct slot_t *)calloc(op->qd, sizeof(struct slot_t));
+    if (NULL == slots) {
+        pr2serr("thread %d: out of memory\n", tp->id);
+        tp->first_err = sg_convert_errno(ENOMEM);
+        return NULL;
+    }
+    for (k = 0; k < op->qd; ++k) {
+        sp = slots + k;
+        sp->buffp = sg_memalign(buff_len, 0, NULL, false);
+        sp->ptvp = construct_scsi_pt_obj_with_fd(tp->sg_fd, op->verbose);
+        if ((NULL == sp->buffp) || (NULL == sp->ptvp)) {
+            pr2serr("thread %d: out of memory\n", tp->id);
+            tp->first_err = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        for (n = 0; n < buff_len; ++n)  /* not all zeros for write */
+            sp->buffp[n] = (uint8_t)(n + k + tp->id);
+        set_scsi_pt_sense(sp->ptvp, sp->sense, sizeof(sp->sense));
+        if (op->bcp->data_in)
+            set_scsi_pt_data_in(sp->ptvp, sp->buffp, op->bs);
+        else if (op->bcp->cmd != BENCH_VERIFY)
+            set_scsi_pt_data_out(sp->ptvp, sp->buffp, buff_len);
+        set_scsi_pt_packet_id(sp->ptvp, k + 1);
+    }
+    inflight = 0;
+    while (true) {
+        if (bench_stop ||
+            (op->end_ns && (sg_pt_lat_now_ns() >= op->end_ns)))
+            stopping = true;
+        for (k = 0; (! stopping) && (k < op->qd); ++k) {
+            sp = slots + k;
+            if (sp->busy)
+                continue;
+            if (! next_io(tp, &io)) {
+                stopping = true;
+                break;
+            }
+            res = submit_io(tp, sp, io);
+            if (0 == res)
+                ++inflight;
+            else {
+                if (res > 0) {
+                    pr2serr("thread %d: submit failed, res=%d\n", tp->id,
+                            res);
+                    if (0 == tp->errs++)
+                        tp->first_err = SG_LIB_CAT_OTHER;
+                } else {
+                    pr2serr("thread %d: submit failed: %s\n", tp->id,
+                            safe_strerror(-res));
+                    if (0 == tp->errs++)
+                        tp->first_err = sg_convert_errno(-res);
+                }
+                stopping = true;
+            }
+        }
+        if (0 == inflight)
+            break;
+        /* reap whatever has completed, block on the oldest if nothing */
+        for (k = 0, n = 0, oldest = -1; k < op->qd; ++k) {
+            sp = slots + k;
+            if (! sp->busy)
+                continue;
+            res = do_scsi_pt_receive(sp->ptvp, true, op->verbose);
+            if (-EAGAIN == res) {
+                if ((oldest < 0) || (sp->start_ns < slots[oldest].start_ns))
+                    oldest = k;
+                continue;
+            }
+            --inflight;
+            ++n;
+            if (complete_io(tp, sp, res))
+                stopping = true;
+        }
+        if ((0 == n) && (oldest >= 0)) {
+            sp = slots + oldest;
+            res = do_scsi_pt_receive(sp->ptvp, false, op->verbose);
+            --inflight;
+            if (complete_io(tp, sp, res))
+                stopping = true;
+        }
+    }
+fini:
+    for (k = 0; k < op->qd; ++k) {
+        sp = slots + k;
+        if (sp->ptvp)
+            destruct_scsi_pt_obj(sp->ptvp);
+        if (sp->buffp)
+            free(sp->buffp);
+    }
+    free(slots);
+    return NULL;
+}
+
+/* Fetches the logical block size and capacity of the device. Returns 0 on
+ * success. */
+static int
+get_capacity(int sg_fd, int * lb_szp, uint64_t * num_blksp, int verbose)
+{
+    int res;
+    uint32_t last_lba;
+    uint8_t rc_buff[32];
+
+    memset(rc_buff, 0, sizeof(rc_buff));
+    res = sg_ll_readcap_10(sg_fd, false, 0, rc_buff, 8, true, verbose);
+    if (res)
+        return res;
+    last_lba = sg_get_unaligned_be32(rc_buff + 0);
+    *lb_szp = (int)sg_get_unaligned_be32(rc_buff + 4);
+    *num_blksp = (uint64_t)last_lba + 1;
+    if (0xffffffff == last_lba) {
+        res = sg_ll_readcap_16(sg_fd, false, 0, rc_buff, 32, true, verbose);
+        if (res)
+            return res;
+        *num_blksp = sg_get_unaligned_be64(rc_buff + 0) + 1;
+        *lb_szp = (int)sg_get_unaligned_be32(rc_buff + 8);
+    }
+    return 0;
+}
+
+static void
+report(const struct opts_t * op, struct thr_t * thr_arr, uint64_t el_ns)
+{
+    int j, k;
+    uint64_t cmds = 0;
+    uint64_t errs = 0;
+    uint64_t lat_min = 0;
+    uint64_t lat_max = 0;
+    uint64_t lat_sum = 0;
+    uint64_t cum, v;
+    uint64_t rank[5];
+    uint64_t pct[5];
+    double secs, iops, mbps;
+    struct thr_t * tp;
+    static const int per_10k[5] = {5000, 9000, 9900, 9990, 9999};
+    static const char * pct_str[5] = {"50", "90", "99", "99.9", "99.99"};
+
+    for (j = 0; j < op->num_threads; ++j) {
+        tp = thr_arr + j;
+        cmds += tp->cmds;
+        errs += tp->errs;
+        lat_sum += tp->lat_sum_ns;
+        if (tp->cmds && ((0 == lat_min) || (tp->lat_min_ns < lat_min)))
+            lat_min = tp->lat_min_ns;
+        if (tp->lat_max_ns > lat_max)
+            lat_max = tp->lat_max_ns;
+        if (j > 0) {
+            for (k = 0; k < LAT_BUCKETS; ++k)
+                thr_arr[0].lat_bucket[k] += tp->lat_bucket[k];
+        }
+    }
+    secs = (double)el_ns / 1000000000.0;
+    if (secs <= 0.0)
+        secs = 1e-9;
+    iops = (double)cmds / secs;
+    mbps = ((double)cmds * op->bs) / (secs * 1000000.0);
+    printf("%s(%d): %s, bs=%d, qd=%d, threads=%d\n", op->bcp->name,
+           (op->cdb16 ? 16 : 10), (op->do_random ? "random" : "sequential"),
+           op->bs, op->qd, op->num_threads);
+    printf("  commands=%" PRIu64 ", errors=%" PRIu64 ", elapsed=%.3f "
+           "seconds\n", cmds, errs, secs);
+    printf("  IOPS=%.1f, throughput=%.2f MB/s (%.2f MiB/s)\n", iops, mbps,
+           mbps * 1000000.0 / (1024.0 * 1024.0));
+    if (0 == cmds)
+        return;
+    printf("  latency (usec): min=%.1f, mean=%.1f, max=%.1f\n",
+           (double)lat_min / 1000.0,
+           (double)lat_sum / (1000.0 * (double)cmds),
+           (double)lat_max / 1000.0);
+    for (j = 0; j < 5; ++j) {
+        rank[j] = (cmds * per_10k[j] + 9999) / 10000;
+        pct[j] = 0;
+    }
+    for (k = 0, j = 0, cum = 0; (k < LAT_BUCKETS) && (j < 5); ++k) {
+        cum += thr_arr[0].lat_bucket[k];
+        while ((j < 5) && (cum >= rank[j])) {
+            v = lat_bucket_mid(k);
+            /* bucket mid point may lie outside what was seen */
+            if (v < lat_min)
+                v = lat_min;
+            if (v > lat_max)
+                v = lat_max;
+            pct[j++] = v;
+        }
+    }
+    printf("  latency percentiles (usec):");
+    for (j = 0; j < 5; ++j)
+        printf(" %s%%=%.1f%s", pct_str[j], (double)pct[j] / 1000.0,
+               ((j < 4) ? "," : "\n"));
+}
+
+int
+main(int argc, char * argv[])
+{
+    bool range_given = false;
+    bool verbose_given = false;
+    bool version_given = false;
+    int c, j, k, res;
+    int sg_fd = -1;
+    int ret = 0;
+    int64_t ll;
+    uint64_t num_blks = 0;
+    uint64_t start_ns, el_ns;
+    const char * cmd_str = NULL;
+    struct thr_t * thr_arr = NULL;
+    struct thr_t * tp;
+    struct opts_t opts;
+    struct opts_t * op;
+    struct sigaction sa;
+
+    op = &opts;
+    memset(op, 0, sizeof(opts));
+    op->bs = DEF_BLOCK_SIZE;
+    op->qd = 1;
+    op->num_threads = 1;
+    op->runtime_secs = DEF_RUNTIME_SECS;
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "b:c:fhl:n:q:r:RSt:T:vV", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'b':
+            op->bs = sg_get_num(optarg);
+            if (op->bs < 1) {
+                pr2serr("--bs= expects a positive number of bytes\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'c':
+            cmd_str = optarg;
+            break;
+        case 'f':
+            op->do_force = true;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'l':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("--lba= unable to decode argument\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->lba = (uint64_t)ll;
+            break;
+        case 'n':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("--num= unable to decode argument\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_cmds = ll;
+            break;
+        case 'q':
+            op->qd = sg_get_num(optarg);
+            if ((op->qd < 1) || (op->qd > MAX_QUEUE_DEPTH)) {
+                pr2serr("--qd= expects 1 to %d\n", MAX_QUEUE_DEPTH);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'r':
+            ll = sg_get_llnum(optarg);
+            if (ll < 1) {
+                pr2serr("--range= expects a positive number of blocks\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->range = (uint64_t)ll;
+            range_given = true;
+            break;
+        case 'R':
+            op->do_random = true;
+            break;
+        case 'S':
+            op->cdb16 = true;
+            break;
+        case 't':
+            op->runtime_secs = sg_get_num(optarg);
+            if (op->runtime_secs < 0) {
+                pr2serr("--runtime= expects 0 or more seconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'T':
+            op->num_threads = sg_get_num(optarg);
+            if ((op->num_threads < 1) || (op->num_threads > MAX_THREADS)) {
+                pr2serr("--threads= expects 1 to %d\n", MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            verbose_given = true;
+            ++op->verbose;
+            break;
+        case 'V':
+            version_given = true;
+            break;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        if (NULL == op->device_name) {
+            op->device_name = argv[optind];
+            ++optind;
+        }
+        if (optind < argc) {
+            for (; optind < argc; ++optind)
+                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+
+#ifdef DEBUG
+    pr2serr("In DEBUG mode, ");
+    if (verbose_given && version_given) {
+        pr2serr("but override: '-vV' given, zero verbose and continue\n");
+        verbose_given = false;
+        version_given = false;
+        op->verbose = 0;
+    } else if (! verbose_given) {
+        pr2serr("set '-vv'\n");
+        op->verbose = 2;
+    } else
+        pr2serr("keep verbose=%d\n", op->verbose);
+#else
+    if (verbose_given && version_given)
+        pr2serr("Not in DEBUG mode, so '-vV' has no special action\n");
+#endif
+    if (version_given) {
+        pr2serr("version: %s\n", version_str);
+        return 0;
+    }
+
+    if (NULL == op->device_name) {
+        pr2serr("Missing device name!\n\n");
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    op->bcp = bench_cmd_arr;
+    if (cmd_str) {
+        for ( ; op->bcp->acron; ++op->bcp) {
+            if (0 == strcmp(cmd_str, op->bcp->acron))
+                break;
+        }
+        if (NULL == op->bcp->acron) {
+            pr2serr("--cmd= expects 'read', 'verify', 'write' or 'ws'\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (op->bcp->data_out && (! op->do_force)) {
+        pr2serr("'--cmd=%s' overwrites data on %s; add '--force' to "
+                "proceed\n", op->bcp->acron, op->device_name);
+        return SG_LIB_CONTRADICT;
+    }
+    if ((0 == op->runtime_secs) && (0 == op->num_cmds)) {
+        pr2serr("with --runtime=0 give --num=NUM to limit the run\n");
+        return SG_LIB_CONTRADICT;
+    }
+
+    sg_fd = sg_cmds_open_flags(op->device_name, O_RDWR, op->verbose);
+    if (sg_fd < 0) {
+        pr2serr("open error: %s: %s\n", op->device_name,
+                safe_strerror(-sg_fd));
+        ret = sg_convert_errno(-sg_fd);
+        goto fini;
+    }
+    res = get_capacity(sg_fd, &op->lb_sz, &num_blks, op->verbose);
+    if (res) {
+        char b[80];
+
+        sg_get_category_sense_str(res, sizeof(b), b, op->verbose);
+        pr2serr("Read capacity failed: %s\n", b);
+        ret = res;
+        goto fini;
+    }
+    if ((op->lb_sz < 1) || (op->bs % op->lb_sz)) {
+        pr2serr("--bs=%d is not a multiple of the logical block size (%d)\n",
+                op->bs, op->lb_sz);
+        ret = SG_LIB_SYNTAX_ERROR;
+        goto fini;
+    }
+    op->blk_per_io = op->bs / op->lb_sz;
+    if (op->lba >= num_blks) {
+        pr2serr("--lba=%" PRIu64 " beyond end of device (%" PRIu64
+                " blocks)\n", op->lba, num_blks);
+        ret = SG_LIB_SYNTAX_ERROR;
+        goto fini;
+    }
+    if (! range_given)
+        op->range = num_blks - op->lba;
+    else if (op->range > (num_blks - op->lba))
+        op->range = num_blks - op->lba;
+    op->num_ios = op->range / op->blk_per_io;
+    if (0 == op->num_ios) {
+        pr2serr("region of %" PRIu64 " blocks is smaller than --bs=%d\n",
+                op->range, op->bs);
+        ret = SG_LIB_SYNTAX_ERROR;
+        goto fini;
+    }
+    if ((! op->cdb16) && ((op->blk_per_io > 0xffff) ||
+                          ((op->lba + op->range) > 0xffffffffULL))) {
+        if (op->verbose)
+            pr2serr("using 16 byte cdbs\n");
+        op->cdb16 = true;
+    }
+    if (op->verbose)
+        pr2serr("%s: %" PRIu64 " blocks of %d bytes, region from LBA %"
+                PRIu64 " for %" PRIu64 " blocks\n", op->device_name,
+                num_blks, op->lb_sz, op->lba, op->range);
+
+    thr_arr = (struct thr_t *)calloc(op->num_threads, sizeof(struct thr_t));
+    if (NULL == thr_arr) {
+        pr2serr("out of memory\n");
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    start_ns = sg_pt_lat_now_ns();
+    for (k = 0; k < op->num_threads; ++k) {
+        tp = thr_arr + k;
+        tp->id = k;
+        tp->op = op;
+        tp->rng = (start_ns ^ ((uint64_t)(k + 1) * 0x9e3779b97f4a7c15ULL)) |
+                  1;
+        if (0 == k)
+            tp->sg_fd = sg_fd;
+        else {
+            tp->sg_fd = sg_cmds_open_flags(op->device_name, O_RDWR,
+                                           op->verbose);
+            if (tp->sg_fd < 0) {
+                pr2serr("open error: %s: %s\n", op->device_name,
+                        safe_strerror(-tp->sg_fd));
+                ret = sg_convert_errno(-tp->sg_fd);
+                op->num_threads = k;
+                goto fini;
+            }
+        }
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    start_ns = sg_pt_lat_now_ns();
+    if (op->runtime_secs > 0)
+        op->end_ns = start_ns + (uint64_t)op->runtime_secs * 1000000000ULL;
+    for (k = 0; k < op->num_threads; ++k) {
+        tp = thr_arr + k;
+        res = pthread_create(&tp->tid, NULL, bench_thread, tp);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            ret = sg_convert_errno(res);
+            bench_stop = 1;
+            break;
+        }
+    }
+    for (j = 0; j < k; ++j)
+        pthread_join(thr_arr[j].tid, NULL);
+    el_ns = sg_pt_lat_now_ns() - start_ns;
+    if (k == op->num_threads)
+        report(op, thr_arr, el_ns);
+    for (j = 0; j < op->num_threads; ++j) {
+        if (thr_arr[j].first_err) {
+            if (0 == ret)
+                ret = thr_arr[j].first_err;
+            break;
+        }
+    }
+
+fini:
+    if (thr_arr) {
+        for (k = 1; k < op->num_threads; ++k) {
+            if (thr_arr[k].sg_fd >= 0)
+                sg_cmds_close_device(thr_arr[k].sg_fd);
+        }
+        free(thr_arr);
+    }
+    if (sg_fd >= 0) {
+        res = sg_cmds_close_device(sg_fd);
+        if (res < 0) {
+            pr2serr("close error: %s\n", safe_strerror(-res));
+            if (0 == ret)
+                ret = sg_convert_errno(-res);
+        }
+    }
+    if (0 == op->verbose) {
+        if (! sg_if_can2stderr("sg_bench failed: ", ret))
+            pr2serr("Some error occurred, try again with '-v' "
+                    "or '-vv' for more information\n");
+    }
+    return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+}
@@ -14,6 +14,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
@@ -21,6 +22,13 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifdef SG_LIB_LINUX
+#include <signal.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_pt.h"
@@ -33,21 +41,49 @@
  *
  * This program issues the SCSI BACKGROUND CONTROL command to the given SCSI
  * device. Based on sbc4r10.pdf .
+ *
+ * With --idle=SECS it schedules host initiated background operations on
+ * one or more DEVICEs: they are started once a DEVICE's block device has
+ * been idle for SECS seconds and stopped when its I/O load rises.
  */
 
-static const char * version_str = "1.10 20190113";
+static const char * version_str = "1.11 20261014";
 
 #define BACKGROUND_CONTROL_SA 0x15
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT  60      /* 60 seconds */
+#define DEF_BUSY_IOPS 10        /* more I/Os per second than this is busy */
+#define DEF_POLL_SECS 1
+#define NS_PER_SEC 1000000000ULL
 
 static const char * cmd_name = "Background control";
 
 
+struct bg_dev_t {       /* for each DEVICE with --idle */
+    int sg_fd;
+    int res;            /* non-zero: no longer scheduled */
+    unsigned int maj;   /* of its block device, as in /proc/diskstats */
+    unsigned int min;
+    bool started;       /* host initiated operations started by us */
+    bool seen;          /* in the latest sample of /proc/diskstats */
+    uint64_t ios;       /* reads and writes completed, at previous sample */
+    uint64_t cur;       /* ... and at the latest one */
+    uint64_t idle_ns;   /* start of the current idle window, 0: busy */
+    uint64_t start_ns;  /* when operations were last started */
+    const char * name;
+};
+
+#ifdef SG_LIB_LINUX
+static volatile sig_atomic_t sched_stop;
+#endif
+
 static struct option long_options[] = {
+        {"busy", required_argument, 0, 'b'},
         {"ctl", required_argument, 0, 'c'},
         {"help", no_argument, 0, 'h'},
+        {"idle", required_argument, 0, 'i'},
+        {"poll", required_argument, 0, 'p'},
         {"time", required_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -59,28 +95,43 @@ static void
 usage()
 {
     pr2serr("Usage: "
-            "sg_bg_ctl  [--ctl=CTL] [--help] [--time=TN] [--verbose] "
+            "sg_bg_ctl  [--busy=IOPS] [--ctl=CTL] [--help] [--idle=SECS]\n"
+            "                  [--poll=SECS] [--time=TN] [--verbose] "
             "[--version]\n"
-            "                  DEVICE\n");
+            "                  DEVICE [DEVICE ...]\n");
     pr2serr("  where:\n"
+            "    --busy=IOPS|-b IOPS    with '--idle': more than IOPS I/Os "
+            "per second\n"
+            "                           is busy (def: %d)\n"
             "    --ctl=CTL|-c CTL    CTL is background operation control "
             "value\n"
             "                        default: 0 -> don't change background "
             "operations\n"
             "                        1 -> start; 2 -> stop\n"
             "    --help|-h          print out usage message\n"
+            "    --idle=SECS|-i SECS    start background operations on "
+            "each DEVICE\n"
+            "                           idle for SECS seconds, stop them "
+            "when it is\n"
+            "                           busy; until interrupted (Linux "
+            "only)\n"
+            "    --poll=SECS|-p SECS    with '--idle': seconds between "
+            "samples of\n"
+            "                           /proc/diskstats (def: %d)\n"
             "    --time=TN|-t TN    TN (units 100 ms) is max time to perform "
             "background\n"
             "                       operations (def: 0 -> no limit)\n"
             "    --verbose|-v       increase verbosity\n"
-            "    --version|-V       print version string and exit\n\n"
-            "Performs a SCSI BACKGROUND CONTROL command. It can start or "
+            "    --version|-V       print version string and exit\n\n",
+            DEF_BUSY_IOPS, DEF_POLL_SECS);
+    pr2serr("Performs a SCSI BACKGROUND CONTROL command. It can start or "
             "stop\n'advanced background operations'. Operations started by "
             "this command\n(i.e. when ctl=1) are termed as 'host initiated' "
             "and allow a resource or\nthin provisioned device (disk) to "
             "perform garbage collection type operations.\nThese may "
             "degrade performance while they occur. Hence it is best to\n"
-            "perform this action while the computer is not too busy.\n");
+            "perform this action while the computer is not too busy. "
+            "Several DEVICEs\nmay be given with '--idle'.\n");
 }
 
 /* Invokes a SCSI BACKGROUND CONTROL command (SBC-4).  Return of 0 -> success,
@@ -135,29 +186,272 @@ sg_ll_background_control(int sg_fd, unsigned int bo_ctl, unsigned int bo_time,
     return ret;
 }
 
+static void
+report_bg_ctl_err(const char * leadin, int res, int verbose)
+{
+    char b[80];
+
+    if (SG_LIB_CAT_INVALID_OP == res)
+        pr2serr("%s%s command not supported\n", leadin, cmd_name);
+    else {
+        sg_get_category_sense_str(res, sizeof(b), b, verbose);
+        pr2serr("%s%s command: %s\n", leadin, cmd_name, b);
+    }
+}
+
+#ifdef SG_LIB_LINUX
+
+static void
+sched_sig_handler(int sig)
+{
+    sched_stop = sig;
+}
+
+/* Finds the block device of dvp (the DEVICE itself, or that of a sg or
+ * other char device, through sysfs) and places its numbers in dvp.
+ * Returns true if found. */
+static bool
+bg_blk_dev(struct bg_dev_t * dvp)
+{
+    bool found = false;
+    unsigned int maj, min;
+    struct stat st;
+    DIR * dirp;
+    struct dirent * dep;
+    FILE * fp;
+    char b[64];
+    char c[160];
+
+    if (fstat(dvp->sg_fd, &st) < 0)
+        return false;
+    if (S_ISBLK(st.st_mode)) {
+        dvp->maj = major(st.st_rdev);
+        dvp->min = minor(st.st_rdev);
+        return true;
+    }
+    if (! S_ISCHR(st.st_mode))
+        return false;
+    snprintf(b, sizeof(b), "/sys/dev/char/%u:%u/device/block",
+             major(st.st_rdev), minor(st.st_rdev));
+    if (NULL == (dirp = opendir(b)))
+        return false;
+    while ((! found) && (dep = readdir(dirp))) {
+        if ('.' == dep->d_name[0])
+            continue;
+        snprintf(c, sizeof(c), "%s/%.64s/dev", b, dep->d_name);
+        if (NULL == (fp = fopen(c, "r")))
+            continue;
+        if (2 == fscanf(fp, "%u:%u", &maj, &min)) {
+            dvp->maj = maj;
+            dvp->min = min;
+            found = true;
+        }
+        fclose(fp);
+    }
+    closedir(dirp);
+    return found;
+}
+
+/* Reads /proc/diskstats once for all num DEVICEs in dva, placing their
+ * completed reads plus writes in the 'cur' field. Returns 0 or an errno
+ * value. */
+static int
+bg_sample(struct bg_dev_t * dva, int num)
+{
+    int k;
+    unsigned int maj, min;
+    uint64_t rd, wr;
+    FILE * fp;
+    char b[256];
+
+    if (NULL == (fp = fopen("/proc/diskstats", "r")))
+        return errno;
+    for (k = 0; k < num; ++k)
+        dva[k].seen = false;
+    while (fgets(b, sizeof(b), fp)) {
+        /* major minor name reads_completed 3_fields writes_completed ... */
+        if (4 != sscanf(b, "%u %u %*s %" SCNu64 " %*s %*s %*s %" SCNu64,
+                        &maj, &min, &rd, &wr))
+            continue;
+        for (k = 0; k < num; ++k) {
+            if ((maj == dva[k].maj) && (min == dva[k].min)) {
+                dva[k].cur = rd + wr;
+                dva[k].seen = true;
+            }
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Sends BACKGROUND CONTROL with bo_ctl (1: start, 2: stop) to dvp. On
+ * failure it is reported and dvp is no longer scheduled. Returns 0 or a
+ * SG_LIB_CAT_* value. */
+static int
+bg_sched_ctl(struct bg_dev_t * dvp, unsigned int bo_ctl,
+             unsigned int bo_time, int verbose)
+{
+    int res;
+    char b[96];
+
+    res = sg_ll_background_control(dvp->sg_fd, bo_ctl, bo_time, true,
+                                   verbose);
+    if (res) {
+        snprintf(b, sizeof(b), "%.80s: ", dvp->name);
+        report_bg_ctl_err(b, res, verbose);
+        dvp->res = res;
+    }
+    dvp->started = ((0 == res) && (1 == bo_ctl));
+    return res;
+}
+
+/* The --idle scheduler. Every poll_secs seconds /proc/diskstats is read
+ * (once for all DEVICEs). A DEVICE doing more than busy_iops I/Os per
+ * second is busy: background operations started on it are stopped. Once
+ * it has not been busy for idle_secs they are started, again after the
+ * time_tnth limit (if any) has run out. Runs until interrupted or no
+ * DEVICE is left, then stops what it started. Returns 0 or the first
+ * error. */
+static int
+bg_schedule(struct bg_dev_t * dva, int num, int idle_secs, int busy_iops,
+            int poll_secs, unsigned int time_tnth, int verbose)
+{
+    int k, res, active;
+    int ret = 0;
+    uint64_t now, prev, iops;
+    struct bg_dev_t * dvp;
+    struct sigaction sa;
+
+    res = bg_sample(dva, num);
+    if (res) {
+        pr2serr("unable to read /proc/diskstats: %s\n", safe_strerror(res));
+        return sg_convert_errno(res);
+    }
+    for (k = 0, active = 0; k < num; ++k) {
+        dvp = dva + k;
+        if ((0 == dvp->res) && (! dvp->seen)) {
+            pr2serr("%s: block device %u:%u not in /proc/diskstats\n",
+                    dvp->name, dvp->maj, dvp->min);
+            dvp->res = SG_LIB_FILE_ERROR;
+        }
+        if (dvp->res) {
+            if (0 == ret)
+                ret = dvp->res;
+            continue;
+        }
+        dvp->ios = dvp->cur;
+        ++active;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sched_sig_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    prev = sg_pt_lat_now_ns();
+    while ((0 == sched_stop) && (active > 0)) {
+        sleep(poll_secs);
+        now = sg_pt_lat_now_ns();
+        if (sched_stop || (now <= prev))
+            continue;
+        if ((res = bg_sample(dva, num))) {
+            pr2serr("unable to read /proc/diskstats: %s\n",
+                    safe_strerror(res));
+            if (0 == ret)
+                ret = sg_convert_errno(res);
+            break;
+        }
+        for (k = 0; k < num; ++k) {
+            dvp = dva + k;
+            if (dvp->res || (! dvp->seen))
+                continue;
+            iops = ((dvp->cur - dvp->ios) * NS_PER_SEC) / (now - prev);
+            dvp->ios = dvp->cur;
+            if (verbose > 1)
+                pr2serr("%s: %" PRIu64 " IOPS\n", dvp->name, iops);
+            if (iops > (uint64_t)busy_iops) {
+                dvp->idle_ns = 0;
+                if (dvp->started) {
+                    if (0 == bg_sched_ctl(dvp, 2, 0, verbose))
+                        printf("%s: busy (%" PRIu64 " IOPS), background "
+                               "operations stopped\n", dvp->name, iops);
+                }
+            } else {
+                if (0 == dvp->idle_ns)
+                    dvp->idle_ns = prev;
+                if (dvp->started && time_tnth &&
+                    ((now - dvp->start_ns) >=
+                     (time_tnth * (NS_PER_SEC / 10))))
+                    dvp->started = false;   /* device stopped them */
+                if ((! dvp->started) &&
+                    ((now - dvp->idle_ns) >=
+                     ((uint64_t)idle_secs * NS_PER_SEC))) {
+                    if (0 == bg_sched_ctl(dvp, 1, time_tnth, verbose)) {
+                        dvp->start_ns = now;
+                        printf("%s: idle for %" PRIu64 " seconds, "
+                               "background operations started\n",
+                               dvp->name,
+                               (uint64_t)((now - dvp->idle_ns) /
+                                          NS_PER_SEC));
+                    }
+                }
+            }
+            if (dvp->res) {
+                if (0 == ret)
+                    ret = dvp->res;
+                --active;
+            }
+        }
+        prev = now;
+    }
+    for (k = 0; k < num; ++k) {
+        dvp = dva + k;
+        if (dvp->started && (0 == bg_sched_ctl(dvp, 2, 0, verbose)))
+            printf("%s: background operations stopped\n", dvp->name);
+    }
+    return ret;
+}
+
+#endif  /* SG_LIB_LINUX */
+
 
 int
 main(int argc, char * argv[])
 {
+    bool ctl_given = false;
     bool verbose_given = false;
     bool version_given = false;
     int sg_fd = -1;
     int res, c;
+    int busy_iops = DEF_BUSY_IOPS;
+    int idle_secs = -1;
+    int num_devs = 0;
+    int poll_secs = DEF_POLL_SECS;
     unsigned int ctl = 0;
     unsigned int time_tnth = 0;
     int verbose = 0;
     const char * device_name = NULL;
+    char ** dev_names = NULL;
     int ret = 0;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "c:ht:vV", long_options, &option_index);
+        c = getopt_long(argc, argv, "b:c:hi:p:t:vV", long_options,
+                        &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'b':
+            busy_iops = sg_get_num(optarg);
+            if (busy_iops < 0) {
+                pr2serr("--busy= expects a number of I/Os per second\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'c':
+            ctl_given = true;
             if ((1 != sscanf(optarg, "%4u", &ctl)) || (ctl > 3)) {
                 pr2serr("--ctl= expects a number from 0 to 3\n");
                 return SG_LIB_SYNTAX_ERROR;
@@ -167,6 +461,20 @@ main(int argc, char * argv[])
         case '?':
             usage();
             return 0;
+        case 'i':
+            idle_secs = sg_get_num(optarg);
+            if (idle_secs < 0) {
+                pr2serr("--idle= expects a number of seconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'p':
+            poll_secs = sg_get_num(optarg);
+            if (poll_secs < 1) {
+                pr2serr("--poll= expects a number of seconds, 1 or more\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 't':
             if ((1 != sscanf(optarg, "%4u", &time_tnth)) ||
                 (time_tnth > 255)) {
@@ -188,12 +496,11 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
+        device_name = argv[optind];
+        dev_names = argv + optind;
+        num_devs = argc - optind;
+        if ((num_devs > 1) && (idle_secs < 0)) {
+            for (++optind; optind < argc; ++optind)
                 pr2serr("Unexpected extra argument: %s\n",
                         argv[optind]);
             usage();
@@ -226,6 +533,46 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (idle_secs >= 0) {
+#ifdef SG_LIB_LINUX
+        int k;
+        struct bg_dev_t * dva;
+
+        if (ctl_given) {
+            pr2serr("--ctl= and --idle= contradict\n");
+            return SG_LIB_CONTRADICT;
+        }
+        dva = (struct bg_dev_t *)calloc(num_devs, sizeof(struct bg_dev_t));
+        if (NULL == dva) {
+            pr2serr("out of memory\n");
+            return sg_convert_errno(ENOMEM);
+        }
+        for (k = 0; k < num_devs; ++k) {
+            dva[k].name = dev_names[k];
+            dva[k].sg_fd = sg_cmds_open_device(dva[k].name, false, verbose);
+            if (dva[k].sg_fd < 0) {
+                pr2serr("open error: %s: %s\n", dva[k].name,
+                        safe_strerror(-dva[k].sg_fd));
+                dva[k].res = sg_convert_errno(-dva[k].sg_fd);
+            } else if (! bg_blk_dev(dva + k)) {
+                pr2serr("%s: unable to find its block device\n",
+                        dva[k].name);
+                dva[k].res = SG_LIB_FILE_ERROR;
+            }
+        }
+        ret = bg_schedule(dva, num_devs, idle_secs, busy_iops, poll_secs,
+                          time_tnth, verbose);
+        for (k = 0; k < num_devs; ++k) {
+            if (dva[k].sg_fd >= 0)
+                sg_cmds_close_device(dva[k].sg_fd);
+        }
+        free(dva);
+        return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+#else
+        pr2serr("--idle= is only supported on Linux\n");
+        return SG_LIB_SYNTAX_ERROR;
+#endif
+    }
 
     sg_fd = sg_cmds_open_device(device_name, false, verbose);
     if (sg_fd < 0) {
@@ -238,16 +585,8 @@ main(int argc, char * argv[])
 
     res = sg_ll_background_control(sg_fd, ctl, time_tnth, true, verbose);
     ret = res;
-    if (res) {
-        if (SG_LIB_CAT_INVALID_OP == res)
-            pr2serr("%s command not supported\n", cmd_name);
-        else {
-            char b[80];
-
-            sg_get_category_sense_str(res, sizeof(b), b, verbose);
-            pr2serr("%s command: %s\n", cmd_name, b);
-        }
-    }
+    if (res)
+        report_bg_ctl_err("", res, verbose);
 
 fini:
     if (0 == verbose) {
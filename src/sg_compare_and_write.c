@@ -50,13 +50,17 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.26 20190113";
+static const char * version_str = "1.28 20261014";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_NUM_BLOCKS (1)
@@ -65,12 +69,27 @@ static const char * version_str = "1.26 20190113";
 
 #define COMPARE_AND_WRITE_OPCODE (0x89)
 #define COMPARE_AND_WRITE_CDB_SIZE (16)
+#define READ16_OPCODE (0x88)
+#define READ16_CDB_SIZE (16)
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 
 #define ME "sg_compare_and_write: "
 
+#define PI_DO_GEN 1     /* --pi=gen */
+#define PI_DO_CHK 2     /* --pi=chk */
+
+#define MAX_THREADS 256
+#define MAX_LOCK_RECS 65536
+
+/* --bench latencies are kept in the sg_pt_lat_* histograms of DEVICE's
+ * file descriptor under these keys, beside those of the opcodes */
+#define LAT_KEY_GOOD 0x1089             /* COMPARE AND WRITE that wrote */
+#define LAT_KEY_MISCOMPARE 0x2089       /* ... that miscompared */
+#define LAT_KEY_ACQUIRE 0x3089          /* first try until written */
+
 static struct option long_options[] = {
+        {"bench", required_argument, 0, 'b'},
         {"dpo", no_argument, 0, 'd'},
         {"fua", no_argument, 0, 'f'},
         {"fua_nv", no_argument, 0, 'F'},
@@ -82,8 +101,12 @@ static struct option long_options[] = {
         {"inc", required_argument, 0, 'C'},
         {"inw", required_argument, 0, 'D'},
         {"lba", required_argument, 0, 'l'},
+        {"lbas", required_argument, 0, 'L'},
         {"num", required_argument, 0, 'n'},
+        {"pi", required_argument, 0, 'P'},
         {"quiet", no_argument, 0, 'q'},
+        {"seed", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 'T'},
         {"timeout", required_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -105,7 +128,12 @@ struct opts_t {
         bool verbose_given;
         bool version_given;
         bool wfn_given;
+        int bench_secs;         /* --bench=SECS, 0 for a single command */
+        int num_lbas;           /* --lbas=NL lock records */
+        int num_threads;
+        unsigned int seed;
         int numblocks;
+        int pi_do;              /* --pi=gen (PI_DO_GEN) or chk (PI_DO_CHK) */
         int verbose;
         int timeout;
         int xfer_len;
@@ -125,11 +153,24 @@ usage()
                 "                            --in=IF|--inc=IF [--inw=WF] "
                 "--lba=LBA "
                 "[--num=NUM]\n"
-                "                            [--quiet] [--timeout=TO] "
-                "[--verbose] [--version]\n"
-                "                            [--wrprotect=WP] [--xferlen=LEN] "
-                "DEVICE\n"
+                "                            [--pi=gen|chk] [--quiet] "
+                "[--timeout=TO] [--verbose]\n"
+                "                            [--version] [--wrprotect=WP] "
+                "[--xferlen=LEN] DEVICE\n"
+                "       sg_compare_and_write --bench=SECS [--lbas=NL] "
+                "[--seed=S]\n"
+                "                            [--threads=NT] --lba=LBA "
+                "[--num=NUM] [--xferlen=LEN]\n"
+                "                            [other options] DEVICE\n"
                 "  where:\n"
+                "    --bench=SECS|-b SECS    loop for SECS seconds with "
+                "NT threads\n"
+                "                            contending for NL lock "
+                "records; report\n"
+                "                            rates and latency "
+                "percentiles. OVERWRITES\n"
+                "                            NL*NUM blocks from LBA; IF "
+                "not used\n"
                 "    --dpo|-d            set the dpo bit in cdb (def: "
                 "clear)\n"
                 "    --fua|-f            set the fua bit in cdb (def: "
@@ -149,11 +190,26 @@ usage()
                 "buffer\n"
                 "    --lba=LBA|-l LBA    LBA of the first block to compare "
                 "and write\n"
+                "    --lbas=NL|-L NL     with --bench: number of lock "
+                "records, each\n"
+                "                        NUM blocks, from LBA (def: 1)\n"
                 "    --num=NUM|-n NUM    number of blocks to "
                 "compare/write (def: 1)\n"
+                "    --pi=gen|chk|-P gen|chk    with WP > 0: gen->replace "
+                "the PI after\n"
+                "                        each block in both buffers with "
+                "generated PI,\n"
+                "                        chk->check it before sending\n"
                 "    --quiet|-q          suppress MISCOMPARE report to "
                 "stderr,\n"
                 "                        still sets exit status of 14\n"
+                "    --seed=S|-s S       with --bench: seeds the choice of "
+                "record; hosts\n"
+                "                        using the same S contend for the "
+                "same ones\n"
+                "    --threads=NT|-T NT    with --bench: threads, each "
+                "acting as a host\n"
+                "                          (def: 1)\n"
                 "    --timeout=TO|-t TO    timeout for the command "
                 "(def: 60 secs)\n"
                 "    --verbose|-v        increase verbosity (use '-vv' for "
@@ -165,6 +221,8 @@ usage()
                 "Default is\n"
                 "                            (2 * NUM * 512) or 1024 when "
                 "NUM is 1\n"
+                "                            (520 replaces 512 with --pi= "
+                "and WP > 0)\n"
                 "\n"
                 "Performs a SCSI COMPARE AND WRITE operation. Sends a double "
                 "size\nbuffer, the first half is used to compare what is at "
@@ -186,15 +244,27 @@ parse_args(int argc, char* argv[], struct opts_t * op)
         op->xfer_len = 0;
         op->timeout = DEF_TIMEOUT_SECS;
         op->device_name = NULL;
+        op->num_lbas = 1;
+        op->num_threads = 1;
+        op->seed = (unsigned int)getpid();
         while (1) {
                 int option_index = 0;
 
-                c = getopt_long(argc, argv, "C:dD:fFg:hi:l:n:qt:vVw:x:",
+                c = getopt_long(argc, argv,
+                                "b:C:dD:fFg:hi:l:L:n:P:qs:t:T:vVw:x:",
                                 long_options, &option_index);
                 if (c == -1)
                         break;
 
                 switch (c) {
+                case 'b':
+                        op->bench_secs = sg_get_num(optarg);
+                        if (op->bench_secs < 1) {
+                                pr2serr("bad argument to '--bench=', expect "
+                                        "seconds\n");
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 'C':
                 case 'i':
                         op->ifn = optarg;
@@ -235,6 +305,15 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                         op->lba = (uint64_t)ll;
                         lba_given = true;
                         break;
+                case 'L':
+                        op->num_lbas = sg_get_num(optarg);
+                        if ((op->num_lbas < 1) ||
+                            (op->num_lbas > MAX_LOCK_RECS)) {
+                                pr2serr("bad argument to '--lbas=', expect "
+                                        "1 to %d\n", MAX_LOCK_RECS);
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 'n':
                         op->numblocks = sg_get_num(optarg);
                         if ((op->numblocks < 0) || (op->numblocks > 255))  {
@@ -243,9 +322,37 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                                 goto out_err_no_usage;
                         }
                         break;
+                case 'P':
+                        if (0 == strcmp(optarg, "gen"))
+                                op->pi_do = PI_DO_GEN;
+                        else if (0 == strcmp(optarg, "chk"))
+                                op->pi_do = PI_DO_CHK;
+                        else {
+                                pr2serr("bad argument to '--pi=', expect "
+                                        "'gen' or 'chk'\n");
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 'q':
                         op->quiet = true;
                         break;
+                case 's':
+                        ll = sg_get_llnum(optarg);
+                        if ((ll < 0) || (ll > UINT32_MAX)) {
+                                pr2serr("bad argument to '--seed='\n");
+                                goto out_err_no_usage;
+                        }
+                        op->seed = (unsigned int)ll;
+                        break;
+                case 'T':
+                        op->num_threads = sg_get_num(optarg);
+                        if ((op->num_threads < 1) ||
+                            (op->num_threads > MAX_THREADS)) {
+                                pr2serr("bad argument to '--threads=', "
+                                        "expect 1 to %d\n", MAX_THREADS);
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 't':
                         op->timeout = sg_get_num(optarg);
                         if (op->timeout < 0)  {
@@ -296,7 +403,22 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                 pr2serr("missing device name!\n");
                 goto out_err;
         }
-        if (! if_given) {
+        if (op->bench_secs) {
+                if (if_given || op->wfn_given || op->pi_do ||
+                    op->flags.wrprotect) {
+                        pr2serr("--bench makes its own buffers so --in=, "
+                                "--inw=, --pi= and --wrprotect=\nare not "
+                                "allowed\n");
+                        goto out_err_no_usage;
+                }
+                if (0 == op->numblocks) {
+                        pr2serr("--bench needs NUM to be at least 1\n");
+                        goto out_err_no_usage;
+                }
+        } else if ((op->num_lbas > 1) || (op->num_threads > 1)) {
+                pr2serr("--lbas= and --threads= need --bench=\n");
+                goto out_err_no_usage;
+        } else if (! if_given) {
                 pr2serr("missing input file\n");
                 goto out_err;
         }
@@ -305,7 +427,9 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                 goto out_err;
         }
         if (0 == op->xfer_len)
-            op->xfer_len = 2 * op->numblocks * DEF_BLOCK_SIZE;
+            op->xfer_len = 2 * op->numblocks * (DEF_BLOCK_SIZE +
+                           ((op->pi_do && op->flags.wrprotect) ?
+                            SG_T10_PI_LEN : 0));
         return 0;
 
 out_err:
@@ -425,6 +549,330 @@ sg_ll_compare_and_write(int sg_fd, uint8_t * buff, int blocks,
         return ret;
 }
 
+/* With --pi=gen the PI tuple that follows each logical block in both the
+ * compare and the write halves of the data-out buffer is replaced by one
+ * generated from that block; with --pi=chk each is checked instead. The
+ * size of a block plus its PI is taken from LEN. PI type 1 is assumed, so
+ * reference tags are the lower 32 bits of the LBA. Returns 0 if
+ * successful, else sg3_utils error code. */
+static int
+process_pi(uint8_t * bp, const struct opts_t * op)
+{
+        int k, res, bad, bs;
+
+        bs = (op->numblocks > 0) ? (op->xfer_len / (2 * op->numblocks)) : 0;
+        if ((0 == op->flags.wrprotect) || (bs <= SG_T10_PI_LEN) ||
+            (op->xfer_len != (2 * op->numblocks * bs))) {
+                pr2serr("--pi= needs --wrprotect=WP (WP > 0) and LEN to "
+                        "hold NUM blocks each\nwith 8 bytes of PI, in "
+                        "both halves\n");
+                return SG_LIB_CONTRADICT;
+        }
+        bs -= SG_T10_PI_LEN;
+        for (k = 0; k < 2; ++k, bp += op->xfer_len / 2) {
+                if (PI_DO_GEN == op->pi_do)
+                        sg_t10_pi_gen(bp, bs, op->numblocks, 0,
+                                      (uint32_t)op->lba, 1);
+                else if ((res = sg_t10_pi_chk(bp, bs, op->numblocks,
+                                              (uint32_t)op->lba, 1, &bad))) {
+                        pr2serr("--pi=chk: %s tag check failed in %s buffer "
+                                "for LBA 0x%" PRIx64 "\n", ((1 == res) ?
+                                "guard" : "reference"), (k ? "write" :
+                                "compare"), op->lba + bad);
+                        return SG_LIB_CAT_PROTECTION;
+                }
+        }
+        return 0;
+}
+
+/* --bench: each thread acts as a separate host taking turns at one of NL
+ * lock records, each of NUM blocks, laid end to end from LBA. A record
+ * holds a generation count and the id of the last thread to take it. A
+ * thread keeps the record as it last saw it and uses that as the compare
+ * half, with the next generation as the write half. After a miscompare it
+ * READs the record and tries again; that retry loop is one acquisition. */
+struct caw_bench {
+        bool stop;
+        int sg_fd;
+        int ret;                /* of first error other than miscompare */
+        int blk_sz;             /* logical block size, from xfer_len */
+        uint64_t end_ns;        /* when to stop */
+        uint64_t good;          /* COMPARE AND WRITEs that wrote */
+        uint64_t miscompare;
+        uint64_t reads;
+        const struct opts_t * op;
+#ifndef SG_LIB_WIN32
+        pthread_mutex_t mtx;
+#endif
+};
+
+struct caw_bench_thr {
+        int id;
+        unsigned int seed;
+        struct caw_bench * bp;
+};
+
+static void
+bench_lock(struct caw_bench * bp)
+{
+#ifndef SG_LIB_WIN32
+        pthread_mutex_lock(&bp->mtx);
+#else
+        if (bp) { ; }       /* suppress warning */
+#endif
+}
+
+static void
+bench_unlock(struct caw_bench * bp)
+{
+#ifndef SG_LIB_WIN32
+        pthread_mutex_unlock(&bp->mtx);
+#else
+        if (bp) { ; }       /* suppress warning */
+#endif
+}
+
+/* One READ(16) of a lock record. Returns 0 for success, else SG_LIB_CAT_*
+ * or -1 . */
+static int
+caw_read16(int sg_fd, uint8_t * buff, int blocks, uint64_t lba, int len,
+           int verbose)
+{
+        int res, ret, sense_cat;
+        struct sg_pt_base * ptvp;
+        uint8_t cdb[READ16_CDB_SIZE];
+        uint8_t sense_b[SENSE_BUFF_LEN];
+
+        memset(cdb, 0, sizeof(cdb));
+        cdb[0] = READ16_OPCODE;
+        sg_put_unaligned_be64(lba, cdb + 2);
+        sg_put_unaligned_be32((uint32_t)blocks, cdb + 10);
+        ptvp = construct_scsi_pt_obj();
+        if (NULL == ptvp) {
+                pr2serr("Could not construct scsit_pt_obj, out of memory\n");
+                return -1;
+        }
+        set_scsi_pt_cdb(ptvp, cdb, sizeof(cdb));
+        set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+        set_scsi_pt_data_in(ptvp, buff, len);
+        res = do_scsi_pt(ptvp, sg_fd, DEF_TIMEOUT_SECS, verbose);
+        ret = sg_cmds_process_resp(ptvp, "READ(16)", res, verbose > 0,
+                                   verbose, &sense_cat);
+        if (-1 == ret)
+                ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+        else if (-2 == ret) {
+                switch (sense_cat) {
+                case SG_LIB_CAT_RECOVERED:
+                case SG_LIB_CAT_NO_SENSE:
+                        ret = 0;
+                        break;
+                default:
+                        ret = sense_cat;
+                        break;
+                }
+        } else
+                ret = 0;
+        destruct_scsi_pt_obj(ptvp);
+        return ret;
+}
+
+static void *
+bench_worker(void * v_tp)
+{
+        bool known;
+        int res, half, vb;
+        int rec = 0;
+        uint64_t lba = 0;
+        uint64_t t0, t1, acq_ns;
+        uint64_t good = 0, misc = 0, reads = 0;
+        struct caw_bench_thr * tp = (struct caw_bench_thr *)v_tp;
+        struct caw_bench * bp = tp->bp;
+        const struct opts_t * op = bp->op;
+        uint8_t * bufp;
+        uint8_t * free_bufp = NULL;
+        uint8_t * known_arr;
+
+        vb = (op->verbose > 1) ? op->verbose - 1 : 0;
+        half = op->xfer_len / 2;
+        bufp = (uint8_t *)sg_memalign(op->xfer_len * (1 + op->num_lbas), 0,
+                                      &free_bufp, false);
+        known_arr = (uint8_t *)calloc(op->num_lbas, 1);
+        if ((NULL == bufp) || (NULL == known_arr)) {
+                pr2serr("%s: out of memory\n", __func__);
+                res = sg_convert_errno(ENOMEM);
+                goto fini;
+        }
+        /* bufp: compare then write half; followed by each record as last
+         * seen, using the first half of its slot */
+        res = 0;
+        acq_ns = 0;
+        known = false;
+        while (true) {
+                uint8_t * recp;
+
+                if (0 == acq_ns) {      /* start a new acquisition */
+                        t0 = sg_pt_lat_now_ns();
+                        if (bp->stop || (t0 >= bp->end_ns))
+                                break;
+                        /* same seed, same sequence: hosts given the
+                         * same --seed= contend for the same records */
+                        tp->seed = (tp->seed * 1103515245) + 12345;
+                        rec = (int)((tp->seed >> 16) % op->num_lbas);
+                        lba = op->lba + ((uint64_t)rec * op->numblocks);
+                        acq_ns = t0;
+                }
+                recp = bufp + ((1 + rec) * op->xfer_len);
+                known = !! known_arr[rec];
+                if (! known) {
+                        res = caw_read16(bp->sg_fd, recp, op->numblocks, lba,
+                                         half, vb);
+                        ++reads;
+                        if (res)
+                                break;
+                        known_arr[rec] = 1;
+                }
+                memcpy(bufp, recp, half);
+                memcpy(bufp + half, recp, half);
+                sg_put_unaligned_be64(sg_get_unaligned_be64(recp) + 1,
+                                      bufp + half);
+                sg_put_unaligned_be32((uint32_t)getpid(), bufp + half + 8);
+                sg_put_unaligned_be32((uint32_t)tp->id, bufp + half + 12);
+                t0 = sg_pt_lat_now_ns();
+                res = sg_ll_compare_and_write(bp->sg_fd, bufp, op->numblocks,
+                                              lba, op->xfer_len, op->flags,
+                                              false, vb);
+                t1 = sg_pt_lat_now_ns();
+                if (0 == res) {
+                        ++good;
+                        sg_pt_lat_record(bp->sg_fd, LAT_KEY_GOOD, t1 - t0);
+                        sg_pt_lat_record(bp->sg_fd, LAT_KEY_ACQUIRE,
+                                         t1 - acq_ns);
+                        memcpy(recp, bufp + half, half);
+                        acq_ns = 0;
+                } else if (SG_LIB_CAT_MISCOMPARE == res) {
+                        ++misc;
+                        sg_pt_lat_record(bp->sg_fd, LAT_KEY_MISCOMPARE,
+                                         t1 - t0);
+                        known_arr[rec] = 0;
+                        res = 0;
+                        if (bp->stop || (t1 >= bp->end_ns))
+                                break;  /* give up this acquisition */
+                } else
+                        break;
+        }
+fini:
+        bench_lock(bp);
+        bp->good += good;
+        bp->miscompare += misc;
+        bp->reads += reads;
+        if (res) {
+                if (0 == bp->ret) {
+                        char b[80];
+
+                        bp->ret = res;
+                        sg_get_category_sense_str(res, sizeof(b), b,
+                                                  op->verbose);
+                        pr2serr("thread %d: %s at lba 0x%" PRIx64 "\n",
+                                tp->id, b, lba);
+                }
+                bp->stop = true;
+        }
+        bench_unlock(bp);
+        if (free_bufp)
+                free(free_bufp);
+        if (known_arr)
+                free(known_arr);
+        return NULL;
+}
+
+static void
+bench_lat_line(int sg_fd, int key, const char * name)
+{
+        struct sg_pt_lat_summary ls;
+
+        if (sg_pt_lat_get(sg_fd, key, &ls))
+                return;
+        printf("  %-12s %9" PRIu64 "  min=%.1f p50=%.1f p99=%.1f p99.9=%.1f "
+               "max=%.1f\n", name, ls.count, ls.min_ns / 1000.0,
+               ls.p50_ns / 1000.0, ls.p99_ns / 1000.0, ls.p999_ns / 1000.0,
+               ls.max_ns / 1000.0);
+}
+
+/* Runs --bench for op->bench_secs seconds with op->num_threads threads,
+ * then reports. Returns 0 if no errors (miscompares are expected), else
+ * the first error. */
+static int
+caw_bench_run(int sg_fd, const struct opts_t * op)
+{
+        int k, num_thr;
+        uint64_t start_ns, el_ns, att;
+        double secs;
+        struct caw_bench bench;
+        struct caw_bench * bp = &bench;
+        struct caw_bench_thr thr_arr[MAX_THREADS];
+#ifndef SG_LIB_WIN32
+        int err;
+        pthread_t tids[MAX_THREADS];
+#endif
+
+        memset(bp, 0, sizeof(bench));
+        bp->sg_fd = sg_fd;
+        bp->op = op;
+        sg_pt_lat_enable(true);
+        num_thr = op->num_threads;
+        for (k = 0; k < num_thr; ++k) {
+                thr_arr[k].id = k;
+                thr_arr[k].seed = op->seed + (unsigned int)k;
+                thr_arr[k].bp = bp;
+        }
+        if (op->verbose)
+                pr2serr("Bench: %d thread%s, %d lock record%s of %d "
+                        "block%s from lba 0x%" PRIx64 " for %d seconds\n",
+                        num_thr, (1 == num_thr) ? "" : "s", op->num_lbas,
+                        (1 == op->num_lbas) ? "" : "s", op->numblocks,
+                        (1 == op->numblocks) ? "" : "s", op->lba,
+                        op->bench_secs);
+        start_ns = sg_pt_lat_now_ns();
+        bp->end_ns = start_ns + ((uint64_t)op->bench_secs * 1000000000);
+#ifndef SG_LIB_WIN32
+        pthread_mutex_init(&bp->mtx, NULL);
+        for (k = 1; k < num_thr; ++k) {
+                if ((err = pthread_create(tids + k, NULL, bench_worker,
+                                          thr_arr + k))) {
+                        pr2serr("pthread_create: %s\n", safe_strerror(err));
+                        break;
+                }
+        }
+        num_thr = k;
+        bench_worker(thr_arr + 0);
+        for (k = 1; k < num_thr; ++k)
+                pthread_join(tids[k], NULL);
+        pthread_mutex_destroy(&bp->mtx);
+#else
+        bench_worker(thr_arr + 0);
+#endif
+        el_ns = sg_pt_lat_now_ns() - start_ns;
+        secs = (el_ns > 0) ? (el_ns / 1e9) : 1.0;
+        att = bp->good + bp->miscompare;
+        printf("COMPARE AND WRITE bench: %d thread%s, %d lock record%s, "
+               "%.2f seconds\n", num_thr, (1 == num_thr) ? "" : "s",
+               op->num_lbas, (1 == op->num_lbas) ? "" : "s", secs);
+        printf("  attempts: %" PRIu64 " (%.1f/sec)\n  succeeded: %" PRIu64
+               " (%.1f/sec), miscompares: %" PRIu64 " (%.1f/sec)\n", att,
+               att / secs, bp->good, bp->good / secs, bp->miscompare,
+               bp->miscompare / secs);
+        if (att > 0)
+                printf("  success ratio: %.2f%%, READs after miscompare "
+                       "(and first): %" PRIu64 "\n",
+                       (100.0 * bp->good) / att, bp->reads);
+        printf("Latency (usec):    count\n");
+        bench_lat_line(sg_fd, LAT_KEY_GOOD, "succeeded");
+        bench_lat_line(sg_fd, LAT_KEY_MISCOMPARE, "miscompare");
+        bench_lat_line(sg_fd, LAT_KEY_ACQUIRE, "acquire");
+        bench_lat_line(sg_fd, READ16_OPCODE, "READ(16)");
+        return bp->ret;
+}
+
 static int
 open_if(const char * fn, bool got_stdin)
 {
@@ -462,7 +910,7 @@ open_dev(const char * outf, int verbose)
 int
 main(int argc, char * argv[])
 {
-        bool ifn_stdin;
+        bool ifn_stdin = false;
         int res, half_xlen, vb;
         int infd = -1;
         int wfd = -1;
@@ -504,6 +952,15 @@ main(int argc, char * argv[])
         }
         vb = op->verbose;
 
+        if (op->bench_secs) {
+                devfd = open_dev(op->device_name, vb);
+                if (devfd < 0) {
+                        res = sg_convert_errno(-devfd);
+                        goto out;
+                }
+                res = caw_bench_run(devfd, op);
+                goto out;
+        }
         if (vb) {
                 pr2serr("Running COMPARE AND WRITE command with the "
                         "following options:\n  in=%s ", op->ifn);
@@ -577,6 +1034,8 @@ main(int argc, char * argv[])
                         goto out;
                 }
         }
+        if (op->pi_do && (res = process_pi(wrkBuff, op)))
+                goto out;
         res = sg_ll_compare_and_write(devfd, wrkBuff, op->numblocks, op->lba,
                                       op->xfer_len, op->flags, ! op->quiet,
                                       vb);
@@ -43,12 +43,14 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/sysmacros.h>
 #ifndef major
 #include <sys/types.h>
@@ -63,10 +65,11 @@
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "6.07 20190618";
+static const char * version_str = "6.12 20261014";
 
 
 #define ME "sg_dd: "
@@ -89,31 +92,22 @@ static const char * version_str = "6.07 20190618";
 #define CONTROL_MP 0xa
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
-#define READ_CAP_REPLY_LEN 8
-#define RCAP16_REPLY_LEN 32
 #define READ_LONG_OPCODE 0x3E
 #define READ_LONG_CMD_LEN 10
 #define READ_LONG_DEF_BLK_INC 8
 
 #define DEF_TIMEOUT 60000       /* 60,000 millisecs == 60 seconds */
 
-#ifndef RAW_MAJOR
-#define RAW_MAJOR 255   /*unlikey value */
-#endif
-
 #define SG_LIB_FLOCK_ERR 90
 
-#define FT_OTHER 1              /* filetype is probably normal */
-#define FT_SG 2                 /* filetype is sg char device or supports
-                                   SG_IO ioctl */
-#define FT_RAW 4                /* filetype is raw char device */
-#define FT_DEV_NULL 8           /* either "/dev/null" or "." as filename */
-#define FT_ST 16                /* filetype is st char device (tape) */
-#define FT_BLOCK 32             /* filetype is block device */
-#define FT_FIFO 64              /* filetype is a fifo (name pipe) */
-#define FT_ERROR 128            /* couldn't "stat" file */
-
-#define DEV_NULL_MINOR_NUM 3
+#define FT_OTHER SG_IO_FT_OTHER
+#define FT_SG SG_IO_FT_SG
+#define FT_RAW SG_IO_FT_RAW
+#define FT_DEV_NULL SG_IO_FT_DEV_NULL
+#define FT_ST SG_IO_FT_ST
+#define FT_BLOCK SG_IO_FT_BLOCK
+#define FT_FIFO SG_IO_FT_FIFO
+#define FT_ERROR SG_IO_FT_ERROR
 
 /* If platform does not support O_DIRECT then define it harmlessly */
 #ifndef O_DIRECT
@@ -122,6 +116,22 @@ static const char * version_str = "6.07 20190618";
 
 #define MIN_RESERVED_SIZE 8192
 
+#define MAX_BUFS 64              /* for bufs=N, reads ahead N-1 chunks */
+#define AUTO_BUFS 4             /* bufs=N chosen by engine=auto */
+#define MAX_IN_FDS 16           /* for fds=K, sg IFILE opened K times */
+
+#define ENGINE_DEF 0            /* engine= not given */
+#define ENGINE_AUTO 1
+#define ENGINE_SYNC 2           /* one command (or read/write) at a time */
+#define ENGINE_RDAHEAD 3        /* helper thread reads ahead, like bufs=N */
+
+#define WRITE_SAME16_OP 0x93
+#define WRITE_SAME16_LEN 16
+#define UNMAP_PARAM_LEN 24      /* header plus one block descriptor */
+#define DEALLOC_NONE 0          /* sparse chunk on sg OFILE is bypassed */
+#define DEALLOC_WS16 1          /* ... WRITE SAME(16) with UNMAP bit set */
+#define DEALLOC_UNMAP 2         /* ... UNMAP, LBPRZ set so reads as zeros */
+
 #define MAX_UNIT_ATTENTIONS 10
 #define MAX_ABORTED_CMDS 256
 
@@ -134,8 +144,14 @@ static int in_partial = 0;
 static int64_t out_full = 0;
 static int out_partial = 0;
 static int64_t out_sparse_num = 0;
+static int64_t out_dealloc_num = 0;
+static int64_t resumed_num = 0;         /* blocks bypassed due to resume= */
+static bool rate_active = false;        /* rate= or iops= given */
+static struct sg_pt_rate rate_lim;
+static struct sg_io_progress progress;  /* progress=SEC[,FILE] */
 static int recovered_errs = 0;
 static int unrecovered_errs = 0;
+static bool dio_warned = false;     /* only first incomplete dio noted */
 static int read_longs = 0;
 static int num_retries = 0;
 static int dry_run = 0;
@@ -153,9 +169,19 @@ static struct timeval start_tm;
 
 static uint8_t * zeros_buff = NULL;
 static uint8_t * free_zeros_buff = NULL;
+/* capacity, Block Limits and LBP of a sg IFILE or OFILE, each fetched once */
+static struct sg_dev_sess in_ds;
+static struct sg_dev_sess out_ds;
+static int out_dealloc = DEALLOC_NONE;  /* for oflag=sparse on sg OFILE */
+static uint32_t out_unmap_gran = 0;     /* 0 -> no unmap granularity */
+static uint32_t out_unmap_align = 0;
+static uint32_t out_max_dealloc = 0;    /* 0 -> no limit */
 static int read_long_blk_inc = READ_LONG_DEF_BLK_INC;
-
-static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
+static FILE * badmap_fp = NULL;         /* for badmap=BFILE */
+static int64_t bad_lba = -1;            /* start of current bad range */
+static int64_t bad_num = 0;             /* blocks in current bad range */
+static int64_t bad_blocks = 0;
+static int64_t bad_ranges = 0;
 
 struct flags_t {
     bool append;
@@ -166,19 +192,133 @@ struct flags_t {
     bool excl;
     bool flock;
     bool fua;
+    bool prefetch;      /* iflag=prefetch */
     bool sgio;
     bool sparse;
+    bool tape;          /* tape= given so a st device may be opened */
     int cdbsz;
     int coe;
     int nocache;
     int pdt;
+    int pi_type;        /* from READ CAPACITY(16) when protect>0 */
+    int protect;        /* RDPROTECT (iflag) or WRPROTECT (oflag) */
     int retries;
 };
 
 static struct flags_t iflag;
 static struct flags_t oflag;
 
+/* With bufs=N (N > 1) a helper thread reads ahead up to N-1 chunks while
+ * the main thread writes out the current one. The helper only issues
+ * plain READs (or read()s) and leaves all error handling, and statistics,
+ * to the main thread. With fds=K a sg IFILE is opened K times and there is
+ * a helper per file descriptor, each with its own reserved buffer, so up
+ * to K READs are outstanding at the device (one sg fd only runs one SG_IO
+ * at a time). Slots are still handed out, and taken back, in LBA order. */
+struct rd_ahead_slot {
+    bool done;
+    int blocks;
+    int res;            /* ioctl(SG_IO) or read() result */
+    int err;            /* errno when res < 0 */
+    int64_t lba;
+    uint8_t * bp;
+    struct sg_io_hdr io_hdr;
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
+struct rd_ahead_t {
+    bool active;
+    bool is_sg;
+    bool stop;          /* -\ */
+    int bpt;            /*  | */
+    int head;           /*  | oldest slot, next one the main thread takes */
+    int count;          /*  | slots being read or read */
+    int64_t next_lba;   /*  | */
+    int64_t remaining;  /*  | blocks left to read ahead */
+    pthread_mutex_t mutex;      /*  | */
+    pthread_cond_t cv;          /* -/ */
+    int bs;
+    int num;            /* number of slots */
+    int num_thr;        /* number of helper threads (and fds) */
+    const struct flags_t * ifp;
+    struct rd_ahead_thr {
+        struct rd_ahead_t * rap;
+        int fd;
+        bool started;
+        pthread_t tid;
+    } thr[MAX_IN_FDS];
+    struct rd_ahead_slot slot[MAX_BUFS - 1];
+};
+
+static struct rd_ahead_t rd_ahead;
+
+/* With iflag=prefetch a PRE-FETCH(16) with IMMED set is issued for the
+ * chunks 'dist' ahead of the one being read, so the device can stage them
+ * in its cache while the current chunk is transferred. A read that takes
+ * more than twice the quickest one seen is assumed to have missed the
+ * cache and 'dist' grows; after a run of fast reads it shrinks again. */
+#define PF_MAX_DIST 32
+#define PF_HIT_RUN 32
+
+struct pf_ahead_t {
+    bool active;
+    int dist;           /* chunks to pre-fetch ahead of the current one */
+    int hit_run;        /* consecutive reads that looked like cache hits */
+    int bpt;
+    int64_t next_lba;   /* first block not yet pre-fetched */
+    int64_t end_lba;    /* one past the last block to be read */
+    uint64_t min_ns;    /* quickest read seen */
+    int64_t cmds;
+    int64_t cond_met;   /* will fit in the cache */
+    int64_t good;       /* will not fit in the cache */
+    int64_t errs;
+    int64_t misses;
+};
+
+static struct pf_ahead_t pf_ahead;
+
+/* With tape=MB[,HI,LO] a ring buffer of MB MiB sits between the tape and
+ * the other side of the copy, and a helper thread does all the tape I/O,
+ * one record (of BS*BPT bytes) per command. So the drive is not stopped
+ * and restarted (repositioned) each time the other side is briefly slow,
+ * writing to tape waits until the ring is HI percent full and then carries
+ * on until it drops to LO percent. Reading from tape pauses when the ring
+ * is HI percent full and resumes when it has drained to LO percent. */
+#define TAPE_DEF_HI_PCT 75
+#define TAPE_DEF_LO_PCT 25
+#define TAPE_MAX_MB 4095        /* ring is one sg_hugebuf_get() buffer */
+
+struct tape_ring_t {
+    bool active;
+    bool to_tape;       /* ring drains to tape, else it is filled from tape */
+    bool is_sg;         /* SSC READ(6) and WRITE(6), else read()/write() */
+    bool streaming;     /* -\ tape thread is moving the tape */
+    bool eof;           /*  | no more to write (or no more on the tape) */
+    bool stop;          /*  | main thread has finished with the ring */
+    bool done;          /*  | tape thread has finished */
+    int res;            /*  | 0, else error that stopped the tape thread */
+    int head;           /*  | oldest record in the ring */
+    int count;          /*  | records in the ring */
+    pthread_mutex_t mutex;      /*  | */
+    pthread_cond_t cv;          /* -/ */
+    int fd;
+    int rec_sz;         /* bytes per record, BS*BPT */
+    int num;            /* records the ring can hold */
+    int hi;             /* watermarks, in records */
+    int lo;
+    int64_t starts;     /* times the tape was set moving */
+    int64_t recs;       /* records moved to or from the tape */
+    int64_t bytes;
+    int * len;          /* length of each record in the ring */
+    uint8_t * buf;
+    pthread_t tid;
+};
+
+static struct tape_ring_t tape_ring;
+
 static void calc_duration_throughput(bool contin);
+static void rd_ahead_fini(struct rd_ahead_t * rap);
 
 
 static void
@@ -199,14 +339,15 @@ install_handler(int sig_num, void (*sig_handler) (int sig))
 static void
 print_stats(const char * str)
 {
-    if (0 != dd_count)
-        pr2serr("  remaining block count=%" PRId64 "\n", dd_count);
-    pr2serr("%s%" PRId64 "+%d records in\n", str, in_full - in_partial,
-            in_partial);
-    pr2serr("%s%" PRId64 "+%d records out\n", str, out_full - out_partial,
-            out_partial);
+    sg_io_print_records(str, dd_count, in_full, in_partial, out_full,
+                        out_partial);
     if (oflag.sparse)
         pr2serr("%s%" PRId64 " bypassed records out\n", str, out_sparse_num);
+    if (out_dealloc_num > 0)
+        pr2serr("%s%" PRId64 " of them deallocated\n", str, out_dealloc_num);
+    if (resumed_num > 0)
+        pr2serr("%s%" PRId64 " records bypassed, copied before (resume)\n",
+                str, resumed_num);
     if (recovered_errs > 0)
         pr2serr("%s%d recovered errors\n", str, recovered_errs);
     if (num_retries > 0)
@@ -215,8 +356,43 @@ print_stats(const char * str)
         pr2serr("%s%d unrecovered errors\n", str, unrecovered_errs);
         pr2serr("%s%d read_longs fetched part of unrecovered read errors\n",
                 str, read_longs);
+        if (bad_blocks > 0)
+            pr2serr("%s%" PRId64 " bad blocks in %" PRId64 " ranges\n", str,
+                    bad_blocks, bad_ranges);
     } else if (unrecovered_errs)
         pr2serr("%s%d unrecovered error(s)\n", str, unrecovered_errs);
+    if (rate_active) {
+        pr2serr("%srate limit: %" PRIu64 " waits totalling %.3f seconds",
+                str, rate_lim.waits, rate_lim.wait_ns / 1e9);
+        if (rate_lim.target_ns)
+            pr2serr(", latency backoffs=%" PRIu64 ", smoothed latency=%.1f "
+                    "us", rate_lim.backoffs, rate_lim.ewma_ns / 1000.0);
+        pr2serr("\n");
+    }
+}
+
+/* With progress=SEC[,FILE]: called after each chunk is copied, every SEC
+ * seconds writes one line holding a JSON object to FILE. 'final' is set
+ * for the last line, written when the copy ends. */
+static void
+progress_out(bool final, int infd, int in_type, int outfd, int out_type)
+{
+    struct sg_io_progress_cnt cnt;
+
+    if (NULL == progress.fp)
+        return;
+    if ((! final) && (! sg_io_progress_tick(&progress)))
+        return;
+    cnt.blocks_in = in_full;
+    cnt.blocks_out = out_full;
+    cnt.recovered_errs = recovered_errs;
+    cnt.unrecovered_errs = unrecovered_errs;
+    cnt.retries = num_retries;
+    cnt.rd_fd = (FT_SG & in_type) ? infd : -1;
+    cnt.rd_opcode = sg_rw_opcode(iflag.cdbsz, false);
+    cnt.wr_fd = (FT_SG & out_type) ? outfd : -1;
+    cnt.wr_opcode = sg_rw_opcode(oflag.cdbsz, true);
+    sg_io_progress_out(&progress, final, &cnt);
 }
 
 
@@ -247,108 +423,6 @@ siginfo_handler(int sig)
     print_stats("  ");
 }
 
-static bool bsg_major_checked = false;
-static int bsg_major = 0;
-
-static void
-find_bsg_major(void)
-{
-    int n;
-    char *cp;
-    FILE *fp;
-    const char *proc_devices = "/proc/devices";
-    char a[128];
-    char b[128];
-
-    if (NULL == (fp = fopen(proc_devices, "r"))) {
-        if (verbose)
-            pr2serr("fopen %s failed: %s\n", proc_devices, strerror(errno));
-        return;
-    }
-    while ((cp = fgets(b, sizeof(b), fp))) {
-        if ((1 == sscanf(b, "%126s", a)) &&
-            (0 == memcmp(a, "Character", 9)))
-            break;
-    }
-    while (cp && (cp = fgets(b, sizeof(b), fp))) {
-        if (2 == sscanf(b, "%d %126s", &n, a)) {
-            if (0 == strcmp("bsg", a)) {
-                bsg_major = n;
-                break;
-            }
-        } else
-            break;
-    }
-    if (verbose > 5) {
-        if (cp)
-            pr2serr("found bsg_major=%d\n", bsg_major);
-        else
-            pr2serr("found no bsg char device in %s\n", proc_devices);
-    }
-    fclose(fp);
-}
-
-
-static int
-dd_filetype(const char * filename)
-{
-    size_t len = strlen(filename);
-    struct stat st;
-
-    if ((1 == len) && ('.' == filename[0]))
-        return FT_DEV_NULL;
-    if (stat(filename, &st) < 0)
-        return FT_ERROR;
-    if (S_ISCHR(st.st_mode)) {
-        /* major() and minor() defined in sys/sysmacros.h */
-        if ((MEM_MAJOR == major(st.st_rdev)) &&
-            (DEV_NULL_MINOR_NUM == minor(st.st_rdev)))
-            return FT_DEV_NULL;
-        if (RAW_MAJOR == major(st.st_rdev))
-            return FT_RAW;
-        if (SCSI_GENERIC_MAJOR == major(st.st_rdev))
-            return FT_SG;
-        if (SCSI_TAPE_MAJOR == major(st.st_rdev))
-            return FT_ST;
-        if (! bsg_major_checked) {
-            bsg_major_checked = true;
-            find_bsg_major();
-        }
-        if (bsg_major == (int)major(st.st_rdev))
-            return FT_SG;
-    } else if (S_ISBLK(st.st_mode))
-        return FT_BLOCK;
-    else if (S_ISFIFO(st.st_mode))
-        return FT_FIFO;
-    return FT_OTHER;
-}
-
-
-static char *
-dd_filetype_str(int ft, char * buff)
-{
-    int off = 0;
-
-    if (FT_DEV_NULL & ft)
-        off += sg_scnpr(buff + off, 32, "null device ");
-    if (FT_SG & ft)
-        off += sg_scnpr(buff + off, 32, "SCSI generic (sg) device ");
-    if (FT_BLOCK & ft)
-        off += sg_scnpr(buff + off, 32, "block device ");
-    if (FT_FIFO & ft)
-        off += sg_scnpr(buff + off, 32, "fifo (named pipe) ");
-    if (FT_ST & ft)
-        off += sg_scnpr(buff + off, 32, "SCSI tape device ");
-    if (FT_RAW & ft)
-        off += sg_scnpr(buff + off, 32, "raw device ");
-    if (FT_OTHER & ft)
-        off += sg_scnpr(buff + off, 32, "other (perhaps ordinary file) ");
-    if (FT_ERROR & ft)
-        sg_scnpr(buff + off, 32, "unable to 'stat' file ");
-    return buff;
-}
-
-
 static void
 usage()
 {
@@ -357,17 +431,34 @@ usage()
             "              [obs=BS] [of=OFILE] [oflag=FLAGS] "
             "[seek=SEEK] [skip=SKIP]\n"
             "              [--dry-run] [--help] [--verbose] [--version]\n\n"
-            "              [blk_sgio=0|1] [bpt=BPT] [cdbsz=6|10|12|16] "
-            "[coe=0|1|2|3]\n"
-            "              [coe_limit=CL] [dio=0|1] [odir=0|1] "
-            "[of2=OFILE2] [retries=RETR]\n"
-            "              [sync=0|1] [time=0|1] [verbose=VERB]\n"
+            "              [badmap=BFILE] [blk_sgio=0|1] [bpt=BPT|auto] "
+            "[bufs=N]\n"
+            "              [cdbsz=6|10|12|16] [coe=0|1|2|3] [coe_limit=CL] "
+            "[digest=MFILE]\n"
+            "              [dio=0|1] [engine=auto|sync|rdahead] [fds=K] "
+            "[iops=IOPS]\n"
+            "              [odir=0|1] [of2=OFILE2]\n"
+            "              [progress=SEC[,FILE]] [protect=RDP[,WRP]] "
+            "[rate=BPS]\n"
+            "              [rate_lat=US] [resume=CFILE] [retries=RETR] "
+            "[sync=0|1]\n"
+            "              [tape=MB[,HI,LO]] [time=0|1] [verbose=VERB] "
+            "[verify=0|1]\n"
             "  where:\n"
+            "    badmap      write LBA,NUM of each range of blocks that "
+            "could not be\n"
+            "                read (with coe) to BFILE\n"
             "    blk_sgio    0->block device use normal I/O(def), 1->use "
             "SG_IO\n"
             "    bpt         is blocks_per_transfer (default is 128 or 32 "
             "when BS>=2048)\n"
-            "    bs          logical block size (default is 512)\n");
+            "                'auto' sizes it from the Block Limits VPD "
+            "page(s)\n"
+            "    bs          logical block size (default is 512)\n"
+            "    bufs        number of buffers, when > 1 a helper thread "
+            "reads ahead\n"
+            "                into N-1 of them while writing (def: 1, "
+            "max: %d)\n", MAX_BUFS);
     pr2serr("    cdbsz       size of SCSI READ or WRITE cdb (default is "
             "10)\n"
             "    coe         0->exit on error (def), 1->continue on sg "
@@ -379,20 +470,31 @@ usage()
             "times\n"
             "                when COE>1 (default: 0 which is no limit)\n"
             "    count       number of blocks to copy (def: device size)\n"
+            "    digest      write CRC32C of each chunk copied to MFILE (a "
+            "manifest)\n"
             "    dio         for direct IO, 1->attempt, 0->indirect IO "
             "(def)\n"
+            "    engine      auto->pick bufs= and dio= from the sg driver's "
+            "capabilities,\n"
+            "                sync->one command at a time, rdahead->bufs=4\n"
+            "    fds         open sg IFILE K times, a read ahead thread with "
+            "its own\n"
+            "                reserved buffer on each (def: 1, max: %d)\n"
             "    ibs         input logical block size (if given must be same "
             "as 'bs=')\n"
             "    if          file or device to read from (def: stdin)\n"
             "    iflag       comma separated list from: [coe,dio,direct,"
             "dpo,dsync,excl,\n"
-            "                flock,fua,nocache,null,sgio]\n"
+            "                flock,fua,nocache,null,prefetch,sgio]\n"
+            "    iops        limit the copy to IOPS chunks (of BPT blocks) "
+            "per second\n"
+            "                (def: 0 -> no limit)\n"
             "    obs         output logical block size (if given must be "
             "same as 'bs=')\n"
             "    odir        1->use O_DIRECT when opening block dev, "
             "0->don't(def)\n"
             "    of          file or device to write to (def: stdout), "
-            "OFILE of '.'\n");
+            "OFILE of '.'\n", MAX_IN_FDS);
     pr2serr("                treated as /dev/null\n"
             "    of2         additional output file (def: /dev/null), "
             "OFILE2 should be\n"
@@ -401,15 +503,39 @@ usage()
             "direct,dpo,\n"
             "                dsync,excl,flock,fua,nocache,null,sgio,"
             "sparse]\n"
+            "    progress    every SEC seconds append a JSON line with the "
+            "copy's\n"
+            "                progress to FILE (def: stderr)\n"
+            "    protect     set RDPROTECT to RDP and WRPROTECT to WRP "
+            "(def: 0,0), PI\n"
+            "                is checked on read, added, moved or removed "
+            "as needed\n"
+            "    rate        limit the copy to BPS bytes per second, "
+            "suffixes like\n"
+            "                k and m allowed (def: 0 -> no limit)\n"
+            "    rate_lat    lower rate= and iops= while the smoothed "
+            "latency of sg\n"
+            "                commands is over US microseconds (def: 0 -> "
+            "don't)\n"
+            "    resume      keep a bitmap of the chunks copied in CFILE, "
+            "chunks copied\n"
+            "                by an earlier run with the same operands are "
+            "bypassed\n"
             "    retries     retry sgio errors RETR times (def: 0)\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on "
             "OFILE after copy\n"
+            "    tape        ring buffer of MB MiB for a tape IFILE or OFILE, "
+            "HI and LO\n"
+            "                are watermarks in percent (def: 75,25)\n"
             "    time        0->no timing(def), 1->time plus calculate "
             "throughput\n"
             "    verbose     0->quiet(def), 1->some noise, 2->more noise, "
             "etc\n"
+            "    verify      0->no verify(def), 1->read back OFILE after "
+            "copy and\n"
+            "                compare with CRC32Cs in digest manifest\n"
             "    --dry-run    do preparation but bypass copy (or read)\n"
             "    --help      print out this usage message then exit\n"
             "    --verbose   same as 'verbose=1', can be used multiple "
@@ -422,161 +548,53 @@ usage()
 
 /* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
 static int
-scsi_read_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+scsi_read_capacity(struct sg_dev_sess * dsp, int64_t * num_sect,
+                   int * sect_sz)
 {
-    int res, verb;
-    unsigned int ui;
-    uint8_t rcBuff[RCAP16_REPLY_LEN];
+    int res;
+    const struct sg_ds_cap * cp;
 
-    verb = (verbose ? verbose - 1: 0);
-    res = sg_ll_readcap_10(sg_fd, false, 0, rcBuff, READ_CAP_REPLY_LEN, true,
-                           verb);
+    res = sg_ds_get_cap(dsp, &cp);
     if (0 != res)
         return res;
-
-    if ((0xff == rcBuff[0]) && (0xff == rcBuff[1]) && (0xff == rcBuff[2]) &&
-        (0xff == rcBuff[3])) {
-        int64_t ls;
-
-        res = sg_ll_readcap_16(sg_fd, false, 0, rcBuff, RCAP16_REPLY_LEN,
-                               true, verb);
-        if (0 != res)
-            return res;
-        ls = (int64_t)sg_get_unaligned_be64(rcBuff);
-        *num_sect = ls + 1;
-        *sect_sz = (int)sg_get_unaligned_be32(rcBuff + 8);
-    } else {
-        ui = sg_get_unaligned_be32(rcBuff);
-        /* take care not to sign extend values > 0x7fffffff */
-        *num_sect = (int64_t)ui + 1;
-        *sect_sz = (int)sg_get_unaligned_be32(rcBuff + 4);
-    }
+    *num_sect = (int64_t)cp->num_blocks;
+    *sect_sz = (int)cp->lb_size;
     if (verbose)
         pr2serr("      number of blocks=%" PRId64 " [0x%" PRIx64 "], "
                 "logical block size=%d\n", *num_sect, *num_sect, *sect_sz);
     return 0;
 }
 
-
-/* Return of 0 -> success, -1 -> failure. BLKGETSIZE64, BLKGETSIZE and */
-/* BLKSSZGET macros problematic (from <linux/fs.h> or <sys/mount.h>). */
+/* For protect=: fetches the protection type (1, 2 or 3, or 0 for none)
+ * that the sg device is formatted with. Only one PI tuple per logical
+ * block (P_I_EXPONENT=0) is supported. Return of 0 -> success, see
+ * sg_ll_readcap_16() otherwise */
 static int
-read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+read_pi_type(struct sg_dev_sess * dsp, const char * fn, int * pi_typep)
 {
-#ifdef BLKSSZGET
-    if ((ioctl(sg_fd, BLKSSZGET, sect_sz) < 0) && (*sect_sz > 0)) {
-        perror("BLKSSZGET ioctl error");
-        return -1;
-    } else {
- #ifdef BLKGETSIZE64
-        uint64_t ull;
-
-        if (ioctl(sg_fd, BLKGETSIZE64, &ull) < 0) {
-
-            perror("BLKGETSIZE64 ioctl error");
-            return -1;
-        }
-        *num_sect = ((int64_t)ull / (int64_t)*sect_sz);
-        if (verbose)
-            pr2serr("      [bgs64] number of blocks=%" PRId64 " [0x%" PRIx64
-                    "], logical block size=%d\n", *num_sect, *num_sect,
-                    *sect_sz);
- #else
-        unsigned long ul;
-
-        if (ioctl(sg_fd, BLKGETSIZE, &ul) < 0) {
-            perror("BLKGETSIZE ioctl error");
-            return -1;
-        }
-        *num_sect = (int64_t)ul;
-        if (verbose)
-            pr2serr("      [bgs] number of blocks=%" PRId64 " [0x%" PRIx64
-                    "],  logical block size=%d\n", *num_sect, *num_sect,
-                    *sect_sz);
- #endif
+    int res;
+    const struct sg_ds_cap * cp;
+
+    res = sg_ds_get_cap(dsp, &cp);
+    if (SG_LIB_CAT_UNIT_ATTENTION == res)
+        res = sg_ds_get_cap(dsp, &cp);
+    if ((0 == res) && (! cp->rc16))
+        res = SG_LIB_CAT_INVALID_OP;
+    if (res) {
+        pr2serr("protect=: READ CAPACITY(16) failed on %s\n", fn);
+        return res;
     }
-    return 0;
-#else
-    if (verbose)
-        pr2serr("      BLKSSZGET+BLKGETSIZE ioctl not available\n");
-    *num_sect = 0;
-    *sect_sz = 0;
-    return -1;
-#endif
-}
-
-
-static int
-sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
-                  int64_t start_block, bool write_true, bool fua, bool dpo)
-{
-    int sz_ind;
-    int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
-    int wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
-
-    memset(cdbp, 0, cdb_sz);
-    if (dpo)
-        cdbp[1] |= 0x10;
-    if (fua)
-        cdbp[1] |= 0x8;
-    switch (cdb_sz) {
-    case 6:
-        sz_ind = 0;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
-        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
-        if (blocks > 256) {
-            pr2serr(ME "for 6 byte commands, maximum number of blocks is "
-                    "256\n");
-            return 1;
-        }
-        if ((start_block + blocks - 1) & (~0x1fffff)) {
-            pr2serr(ME "for 6 byte commands, can't address blocks beyond "
-                    "%d\n", 0x1fffff);
-            return 1;
-        }
-        if (dpo || fua) {
-            pr2serr(ME "for 6 byte commands, neither dpo nor fua bits "
-                    "supported\n");
-            return 1;
-        }
-        break;
-    case 10:
-        sz_ind = 1;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32(start_block, cdbp + 2);
-        sg_put_unaligned_be16(blocks, cdbp + 7);
-        if (blocks & (~0xffff)) {
-            pr2serr(ME "for 10 byte commands, maximum number of blocks is "
-                    "%d\n", 0xffff);
-            return 1;
-        }
-        break;
-    case 12:
-        sz_ind = 2;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32(start_block, cdbp + 2);
-        sg_put_unaligned_be32(blocks, cdbp + 6);
-        break;
-    case 16:
-        sz_ind = 3;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be64(start_block, cdbp + 2);
-        sg_put_unaligned_be32(blocks, cdbp + 10);
-        break;
-    default:
-        pr2serr(ME "expected cdb size of 6, 10, 12, or 16 but got %d\n",
-                cdb_sz);
-        return 1;
+    *pi_typep = cp->p_type;
+    if (*pi_typep && cp->p_i_exp) {
+        pr2serr("protect=: %s has more than one PI tuple per block, not "
+                "supported\n", fn);
+        return SG_LIB_CAT_OTHER;
     }
+    if (verbose)
+        pr2serr("      %s: PI type=%d\n", fn, *pi_typep);
     return 0;
 }
 
-
 /* 0 -> successful, SG_LIB_SYNTAX_ERROR -> unable to build cdb,
    SG_LIB_CAT_UNIT_ATTENTION -> try again,
    SG_LIB_CAT_MEDIUM_HARD_WITH_INFO -> 'io_addrp' written to,
@@ -590,18 +608,21 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
             uint64_t * io_addrp)
 {
     bool info_valid;
-    int res, k, slen;
-    const uint8_t * sbp;
+    int res, k, attempt;
+    uint32_t slept_ms;
+    uint64_t lat_start_ns;
     uint8_t rdCmd[MAX_SCSI_CDBSZ];
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
+    struct sg_scsi_sense_info si;       /* sense decoded once */
 
-    if (sg_build_scsi_cdb(rdCmd, ifp->cdbsz, blocks, from_block, false,
-                          ifp->fua, ifp->dpo)) {
+    if (sg_build_rw_cdb(rdCmd, ifp->cdbsz, blocks, from_block, false,
+                        ifp->fua, ifp->dpo, ME)) {
         pr2serr(ME "bad rd cdb build, from_block=%" PRId64 ", blocks=%d\n",
                 from_block, blocks);
         return SG_LIB_SYNTAX_ERROR;
     }
+    rdCmd[1] |= (uint8_t)((ifp->protect & 0x7) << 5);
 
     memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
     io_hdr.interface_id = 'S';
@@ -623,26 +644,36 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
             pr2serr("%02x ", rdCmd[k]);
         pr2serr("\n");
     }
-    while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    lat_start_ns = sg_pt_lat_is_enabled() ? sg_pt_lat_now_ns() : 0;
+    for (attempt = 0, slept_ms = 0; ; ++attempt) {
+        while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        /* transient conditions the library's retry policy covers */
+        if ((res < 0) ||
+            (! sg_retry_wait(sg_retry_classify(io_hdr.status, senseBuff,
+                                               io_hdr.sb_len_wr),
+                             attempt, &slept_ms, verbose)))
+            break;
+    }
     if (res < 0) {
         if (ENOMEM == errno)
             return -2;
         perror("reading (SG_IO) on sg device, error");
         return -1;
     }
+    if (lat_start_ns)
+        sg_pt_lat_record(sg_fd, rdCmd[0], sg_pt_lat_now_ns() - lat_start_ns);
     if (verbose > 2)
         pr2serr("      duration=%u ms\n", io_hdr.duration);
-    res = sg_err_category3(&io_hdr);
-    sbp = io_hdr.sbp;
-    slen = io_hdr.sb_len_wr;
+    res = sg_err_category3_sinfo(&io_hdr, &si);
     switch (res) {
     case SG_LIB_CAT_CLEAN:
         break;
     case SG_LIB_CAT_RECOVERED:
         ++recovered_errs;
-        info_valid = sg_get_sense_info_fld(sbp, slen, io_addrp);
+        info_valid = si.info_valid;
+        *io_addrp = si.info;
         if (info_valid) {
             pr2serr("    lba of last recovered error in this READ=0x%" PRIx64
                     "\n", *io_addrp);
@@ -662,7 +693,8 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         if (verbose > 1)
             sg_chk_n_print3("reading", &io_hdr, verbose > 1);
         ++unrecovered_errs;
-        info_valid = sg_get_sense_info_fld(sbp, slen, io_addrp);
+        info_valid = si.info_valid;
+        *io_addrp = si.info;
         /* MMC devices don't necessarily set VALID bit */
         if (info_valid || ((5 == ifp->pdt) && (*io_addrp > 0)))
             return SG_LIB_CAT_MEDIUM_HARD_WITH_INFO;
@@ -679,16 +711,11 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         return res;
     case SG_LIB_CAT_ILLEGAL_REQ:
         if (5 == ifp->pdt) {    /* MMC READs can go down this path */
-            bool ili;
-            struct sg_scsi_sense_hdr ssh;
-
             if (verbose > 1)
                 sg_chk_n_print3("reading", &io_hdr, verbose > 1);
-            if (sg_scsi_normalize_sense(sbp, slen, &ssh) &&
-                (0x64 == ssh.asc) && (0x0 == ssh.ascq)) {
-                if (sg_get_sense_filemark_eom_ili(sbp, slen, NULL, NULL,
-                                                  &ili) && ili) {
-                    sg_get_sense_info_fld(sbp, slen, io_addrp);
+            if (si.response_code && (0x64 == si.asc) && (0x0 == si.ascq)) {
+                if (si.ili) {
+                    *io_addrp = si.info;
                     if (*io_addrp > 0) {
                         ++unrecovered_errs;
                         return SG_LIB_CAT_MEDIUM_HARD_WITH_INFO;
@@ -712,18 +739,48 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
             sg_chk_n_print3("reading", &io_hdr, verbose > 1);
         return res;
     }
-    if (diop && *diop &&
-        ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+    if (diop && *diop && (! sg_io_dio_done(&io_hdr, ME, &dio_warned)))
         *diop = false;      /* flag that dio not done (completely) */
     sum_of_resids += io_hdr.resid;
     return 0;
 }
 
 
+/* Records that 'num' blocks starting at 'lba' of IFILE could not be read
+ * (with coe). Adjacent runs are merged into one range which is written to
+ * the badmap=BFILE (if any) once the next non-adjacent run (or the end of
+ * the copy, when flush is true) is seen. */
+static void
+badmap_add(int64_t lba, int num, bool flush)
+{
+    if ((num > 0) && (bad_lba >= 0) && (lba == bad_lba + bad_num)) {
+        bad_num += num;
+        bad_blocks += num;
+        num = 0;
+    }
+    if ((num > 0) || flush) {
+        if (badmap_fp && (bad_lba >= 0))
+            fprintf(badmap_fp, "0x%" PRIx64 ",%" PRId64 "\n",
+                    (uint64_t)bad_lba, bad_num);
+        bad_lba = -1;
+        bad_num = 0;
+    }
+    if (num > 0) {
+        bad_lba = lba;
+        bad_num = num;
+        bad_blocks += num;
+        ++bad_ranges;
+    }
+}
+
 /* 0 -> successful, SG_LIB_SYNTAX_ERROR -> unable to build cdb,
    SG_LIB_CAT_UNIT_ATTENTION -> try again, SG_LIB_CAT_NOT_READY,
    SG_LIB_CAT_MEDIUM_HARD, SG_LIB_CAT_ABORTED_COMMAND,
-   -2 -> ENOMEM, -1 other errors */
+   -2 -> ENOMEM, -1 other errors. With coe a medium error that does not
+   yield the LBA of the bad block causes the halves of the failed range
+   to be re-read in turn (recursively) so that the bad blocks are isolated
+   with a number of commands that depends on the number of bad ranges
+   rather than the number of blocks. */
 static int
 sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         int bs, struct flags_t * ifp, bool * diop, int * blks_readp)
@@ -853,6 +910,7 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
                 return res;
             case SG_LIB_CAT_MEDIUM_HARD_WITH_INFO:
             case SG_LIB_CAT_MEDIUM_HARD:
+                may_coe = true;
                 ret = SG_LIB_CAT_MEDIUM_HARD;
                 goto err_out;
             case SG_LIB_SYNTAX_ERROR:
@@ -951,6 +1009,7 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
                     "zeros\n", lba);
             memset(bp, 0, bs);
         }
+        badmap_add(lba, 1, false);
         ++xferred;
         bp += bs;
         ++lba;
@@ -967,12 +1026,29 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
 
 err_out:
     if (ifp->coe) {
+        if (may_coe && (blks > 1)) {
+            int n1 = 0;
+            int n2 = 0;
+            int half = blks / 2;
+
+            /* bisect: bad block(s) somewhere in here, re-read each half */
+            if (verbose > 1)
+                pr2serr("  bisect %d blocks at blk=%" PRId64 "\n", blks, lba);
+            res = sg_read(sg_fd, bp, half, lba, bs, ifp, diop, &n1);
+            if (0 == res)
+                res = sg_read(sg_fd, bp + (half * bs), blks - half,
+                              lba + half, bs, ifp, diop, &n2);
+            if (blks_readp)
+                *blks_readp = xferred + n1 + n2;
+            return res;
+        }
         memset(bp, 0, bs * blks);
         pr2serr(">> unable to read at blk=%" PRId64 " for %d bytes, use "
                 "zeros\n", lba, bs * blks);
         if (blks > 1)
             pr2serr(">>   try reducing bpt to limit number of zeros written "
                     "near bad block(s)\n");
+        badmap_add(lba, blks, false);
         /* fudge success */
         if (blks_readp)
             *blks_readp = xferred + blks;
@@ -995,18 +1071,22 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
          int bs, const struct flags_t * ofp, bool * diop)
 {
     bool info_valid;
-    int res, k;
+    int res, k, attempt;
+    uint32_t slept_ms;
     uint64_t io_addr = 0;
+    uint64_t lat_start_ns;
     uint8_t wrCmd[MAX_SCSI_CDBSZ];
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
+    struct sg_scsi_sense_info si;       /* sense decoded once */
 
-    if (sg_build_scsi_cdb(wrCmd, ofp->cdbsz, blocks, to_block, true, ofp->fua,
-                          ofp->dpo)) {
+    if (sg_build_rw_cdb(wrCmd, ofp->cdbsz, blocks, to_block, true, ofp->fua,
+                        ofp->dpo, ME)) {
         pr2serr(ME "bad wr cdb build, to_block=%" PRId64 ", blocks=%d\n",
                 to_block, blocks);
         return SG_LIB_SYNTAX_ERROR;
     }
+    wrCmd[1] |= (uint8_t)((ofp->protect & 0x7) << 5);
 
     memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
     io_hdr.interface_id = 'S';
@@ -1028,90 +1108,1230 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
             pr2serr("%02x ", wrCmd[k]);
         pr2serr("\n");
     }
-    while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    lat_start_ns = sg_pt_lat_is_enabled() ? sg_pt_lat_now_ns() : 0;
+    for (attempt = 0, slept_ms = 0; ; ++attempt) {
+        while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        /* transient conditions the library's retry policy covers */
+        if ((res < 0) ||
+            (! sg_retry_wait(sg_retry_classify(io_hdr.status, senseBuff,
+                                               io_hdr.sb_len_wr),
+                             attempt, &slept_ms, verbose)))
+            break;
+    }
     if (res < 0) {
         if (ENOMEM == errno)
             return -2;
         perror("writing (SG_IO) on sg device, error");
         return -1;
     }
-
-    if (verbose > 2)
-        pr2serr("      duration=%u ms\n", io_hdr.duration);
-    res = sg_err_category3(&io_hdr);
-    switch (res) {
-    case SG_LIB_CAT_CLEAN:
-        break;
-    case SG_LIB_CAT_RECOVERED:
-        ++recovered_errs;
-        info_valid = sg_get_sense_info_fld(io_hdr.sbp, io_hdr.sb_len_wr,
-                                           &io_addr);
-        if (info_valid) {
-            pr2serr("    lba of last recovered error in this WRITE=0x%" PRIx64
-                    "\n", io_addr);
-            if (verbose > 1)
-                sg_chk_n_print3("writing", &io_hdr, true);
-        } else {
-            pr2serr("Recovered error: [no info] writing to block=0x%" PRIx64
-                    ", num=%d\n", to_block, blocks);
-            sg_chk_n_print3("writing", &io_hdr, verbose > 1);
+    if (lat_start_ns)
+        sg_pt_lat_record(sg_fd, wrCmd[0], sg_pt_lat_now_ns() - lat_start_ns);
+
+    if (verbose > 2)
+        pr2serr("      duration=%u ms\n", io_hdr.duration);
+    res = sg_err_category3_sinfo(&io_hdr, &si);
+    switch (res) {
+    case SG_LIB_CAT_CLEAN:
+        break;
+    case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
+        info_valid = si.info_valid;
+        io_addr = si.info;
+        if (info_valid) {
+            pr2serr("    lba of last recovered error in this WRITE=0x%" PRIx64
+                    "\n", io_addr);
+            if (verbose > 1)
+                sg_chk_n_print3("writing", &io_hdr, true);
+        } else {
+            pr2serr("Recovered error: [no info] writing to block=0x%" PRIx64
+                    ", num=%d\n", to_block, blocks);
+            sg_chk_n_print3("writing", &io_hdr, verbose > 1);
+        }
+        break;
+    case SG_LIB_CAT_ABORTED_COMMAND:
+    case SG_LIB_CAT_UNIT_ATTENTION:
+        sg_chk_n_print3("writing", &io_hdr, verbose > 1);
+        return res;
+    case SG_LIB_CAT_NOT_READY:
+        ++unrecovered_errs;
+        pr2serr("device not ready (w)\n");
+        return res;
+    case SG_LIB_CAT_MEDIUM_HARD:
+    default:
+        sg_chk_n_print3("writing", &io_hdr, verbose > 1);
+        ++unrecovered_errs;
+        if (ofp->coe) {
+            pr2serr(">> ignored errors for out blk=%" PRId64 " for %d "
+                    "bytes\n", to_block, bs * blocks);
+            return 0; /* fudge success */
+        } else
+            return res;
+    }
+    if (diop && *diop && (! sg_io_dio_done(&io_hdr, ME, &dio_warned)))
+        *diop = false;      /* flag that dio not done (completely) */
+    return 0;
+}
+
+/* Checks the Logical Block Provisioning and Block Limits VPD pages of the
+ * sg OFILE to see how (if at all) chunks of zeros can be deallocated rather
+ * than bypassed when oflag=sparse is given. WRITE SAME(16) with the UNMAP
+ * bit is preferred since the device server either deallocates or writes
+ * the zeros; UNMAP is only used when deallocated blocks read as zeros. */
+static void
+probe_out_dealloc(struct sg_dev_sess * dsp)
+{
+    static const struct sg_ds_blk_lim no_lim;
+    const struct sg_ds_lbp * lp;
+    const struct sg_ds_blk_lim * blp;
+
+    out_dealloc = DEALLOC_NONE;
+    if (sg_ds_get_lbp(dsp, &lp)) {
+        if (verbose)
+            pr2serr("oflag=sparse: no Logical Block Provisioning VPD page, "
+                    "will bypass zero chunks\n");
+        return;
+    }
+    if (sg_ds_get_blk_lim(dsp, &blp) || (blp->page_len < 40))
+        blp = &no_lim;                  /* assume no limits */
+    if (lp->lbpws) {
+        out_dealloc = DEALLOC_WS16;
+        out_max_dealloc = (blp->max_ws_len > UINT32_MAX) ? 0 :
+                          (uint32_t)blp->max_ws_len;
+    } else if (lp->lbpu && lp->lbprz) {
+        if ((blp->page_len >= 0x10) && (0 == blp->max_unmap_descs)) {
+            if (verbose)
+                pr2serr("oflag=sparse: max unmap block descriptor count is "
+                        "0, will bypass zero chunks\n");
+            return;
+        }
+        out_dealloc = DEALLOC_UNMAP;
+        out_max_dealloc = (UINT32_MAX == blp->max_unmap_lba) ? 0 :
+                          blp->max_unmap_lba;
+        out_unmap_gran = blp->unmap_gran;
+        if (blp->ugavalid)
+            out_unmap_align = blp->unmap_align;
+    } else if (verbose)
+        pr2serr("oflag=sparse: OFILE lacks LBPWS and LBPU+LBPRZ, will "
+                "bypass zero chunks\n");
+    if (verbose > 1)
+        pr2serr("oflag=sparse: deallocate zero chunks with %s, max blocks "
+                "%u per command\n", (DEALLOC_WS16 == out_dealloc) ?
+                "WRITE SAME(16)" : "UNMAP", out_max_dealloc);
+}
+
+/* Fills *sp for sg_io_auto_bpt() with one side of the copy, a sg device
+ * being asked for its Block Limits VPD page through its session. */
+static void
+auto_bpt_side(struct sg_io_bpt_side * sp, int fd, struct sg_dev_sess * dsp,
+              int ftype, const char * fn)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->fd = fd;
+    sp->ftype = ftype;
+    sp->dsp = dsp;
+    sp->fname = fn;
+}
+
+/* Returns the bpt=auto transfer size (in blocks) for the copy between infd
+ * and outfd, see sg_io_auto_bpt(). Returns def_bpt when neither side is a
+ * device. */
+static int
+auto_bpt(int infd, int in_type, const char * inf, int outfd, int out_type,
+         const char * outf, int def_bpt)
+{
+    struct sg_io_bpt_side in_side, out_side;
+
+    auto_bpt_side(&in_side, infd, &in_ds, in_type, inf);
+    auto_bpt_side(&out_side, outfd, &out_ds, out_type, outf);
+    return sg_io_auto_bpt(&in_side, &out_side, blk_sz, def_bpt, verbose);
+}
+
+/* Issues a WRITE SAME(16) command with the UNMAP bit set and a data-out
+ * buffer of one block of zeros. Returns 0 on success, else -1 or a
+ * SG_LIB_CAT_* value. */
+static int
+sg_write_same16_unmap(int sg_fd, int64_t to_block, uint32_t blocks, int bs)
+{
+    int res, k;
+    uint8_t wsCmd[WRITE_SAME16_LEN];
+    uint8_t senseBuff[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+
+    memset(wsCmd, 0, sizeof(wsCmd));
+    wsCmd[0] = WRITE_SAME16_OP;
+    wsCmd[1] = 0x8;                     /* UNMAP bit */
+    sg_put_unaligned_be64((uint64_t)to_block, wsCmd + 2);
+    sg_put_unaligned_be32(blocks, wsCmd + 10);
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.cmd_len = sizeof(wsCmd);
+    io_hdr.cmdp = wsCmd;
+    io_hdr.dxfer_direction = SG_DXFER_TO_DEV;
+    io_hdr.dxfer_len = bs;
+    io_hdr.dxferp = zeros_buff;
+    io_hdr.mx_sb_len = SENSE_BUFF_LEN;
+    io_hdr.sbp = senseBuff;
+    io_hdr.timeout = DEF_TIMEOUT;
+    io_hdr.pack_id = (int)++glob_pack_id;
+    if (verbose > 2) {
+        pr2serr("    write same(16) cdb: ");
+        for (k = 0; k < WRITE_SAME16_LEN; ++k)
+            pr2serr("%02x ", wsCmd[k]);
+        pr2serr("\n");
+    }
+    while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        perror("write same(16) (SG_IO) on sg device, error");
+        return -1;
+    }
+    res = sg_err_category3(&io_hdr);
+    switch (res) {
+    case SG_LIB_CAT_CLEAN:
+        return 0;
+    case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
+        return 0;
+    default:
+        sg_chk_n_print3("write same(16)", &io_hdr, verbose > 1);
+        return res;
+    }
+}
+
+/* Deallocates 'blocks' blocks of the sg OFILE starting at 'to_block' so
+ * that they read back as zeros. Returns 0 on success. Returns 1 if the
+ * range does not suit UNMAP (e.g. not aligned on the unmap granularity),
+ * otherwise -1 or a SG_LIB_CAT_* value; in all these cases the caller
+ * should write the chunk instead. */
+static int
+sg_dealloc(int sg_fd, int64_t to_block, int blocks, int bs)
+{
+    int res;
+    uint32_t num;
+    uint8_t param[UNMAP_PARAM_LEN];
+
+    if ((DEALLOC_UNMAP == out_dealloc) && (out_unmap_gran > 1) &&
+        (((to_block % out_unmap_gran) != out_unmap_align) ||
+         (blocks % out_unmap_gran)))
+        return 1;
+    while (blocks > 0) {
+        num = blocks;
+        if (out_max_dealloc && (num > out_max_dealloc))
+            num = out_max_dealloc;
+        if (DEALLOC_WS16 == out_dealloc)
+            res = sg_write_same16_unmap(sg_fd, to_block, num, bs);
+        else {
+            memset(param, 0, sizeof(param));
+            sg_put_unaligned_be16(UNMAP_PARAM_LEN - 2, param + 0);
+            sg_put_unaligned_be16(16, param + 2);
+            sg_put_unaligned_be64((uint64_t)to_block, param + 8);
+            sg_put_unaligned_be32(num, param + 16);
+            res = sg_ll_unmap(sg_fd, 0, DEF_TIMEOUT / 1000, param,
+                              UNMAP_PARAM_LEN, verbose > 1, verbose - 1);
+        }
+        if (res)
+            return res;
+        to_block += num;
+        blocks -= num;
+    }
+    return 0;
+}
+
+/* For oflag=sparse: bypasses 'blocks' zero blocks of OFILE starting at
+ * 'to_block'. A sg OFILE has them deallocated (when it allows that) and
+ * other OFILEs have their file position moved past them. Returns 0 when
+ * bypassed, 1 when they must be written after all (deallocation failed),
+ * or SG_LIB_FILE_ERROR. */
+static int
+sparse_bypass(int outfd, int out_type, int64_t to_block, int blocks)
+{
+    int res;
+
+    if (FT_SG & out_type) {
+        if (DEALLOC_NONE != out_dealloc) {
+            res = sg_dealloc(outfd, to_block, blocks, blk_sz);
+            if (res) {
+                if ((1 != res) || (verbose > 2))
+                    pr2serr("sparse could not deallocate: seek blk=%" PRId64
+                            ", blks=%d, so write zeros\n", to_block, blocks);
+                if ((SG_LIB_CAT_INVALID_OP == res) ||
+                    (SG_LIB_CAT_ILLEGAL_REQ == res)) {
+                    pr2serr("oflag=sparse: deallocation refused by OFILE, "
+                            "bypass zero chunks from now on\n");
+                    out_dealloc = DEALLOC_NONE;
+                }
+                return 1;
+            }
+            out_dealloc_num += blocks;
+        }
+        out_sparse_num += blocks;
+        if (verbose > 2)
+            pr2serr("sparse %s sg_write: seek blk=%" PRId64 ", offset "
+                    "blks=%d\n", (DEALLOC_NONE == out_dealloc) ?
+                    "bypassing" : "deallocated instead of", to_block,
+                    blocks);
+    } else if (! (FT_DEV_NULL & out_type)) {
+        off64_t offset = (off64_t)blocks * blk_sz;
+        off64_t off_res;
+
+        if (verbose > 2)
+            pr2serr("sparse bypassing write: seek=%" PRId64 ", rel "
+                    "offset=%" PRId64 "\n", (to_block * blk_sz),
+                    (int64_t)offset);
+        off_res = lseek64(outfd, offset, SEEK_CUR);
+        if (off_res < 0) {
+            pr2serr("sparse tried to bypass write: seek=%" PRId64
+                    ", rel offset=%" PRId64 " but ...\n",
+                    (to_block * blk_sz), (int64_t)offset);
+            perror("lseek64 on output");
+            return SG_LIB_FILE_ERROR;
+        } else if (verbose > 4)
+            pr2serr("oflag=sparse lseek64 result=%" PRId64 "\n",
+                    (int64_t)off_res);
+        out_sparse_num += blocks;
+    }
+    return 0;
+}
+
+/* Does the I/O for one read ahead slot on fd, called by a helper thread.
+ * Returns true when the chunk was fully read without error. */
+static bool
+rd_ahead_io(struct rd_ahead_t * rap, int fd, struct rd_ahead_slot * sp)
+{
+    int len = rap->bs * sp->blocks;
+    uint64_t lat_start_ns;
+    struct sg_io_hdr * hp = &sp->io_hdr;
+
+    if (! rap->is_sg) {
+        sp->res = sg_io_read_retry(fd, sp->bp, len);
+        sp->err = (sp->res < 0) ? errno : 0;
+        return (sp->res == len);
+    }
+    if (sg_build_rw_cdb(sp->cdb, rap->ifp->cdbsz, sp->blocks, sp->lba,
+                        false, rap->ifp->fua, rap->ifp->dpo, ME)) {
+        sp->res = -1;
+        sp->err = EINVAL;
+        return false;
+    }
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = rap->ifp->cdbsz;
+    hp->cmdp = sp->cdb;
+    hp->dxfer_direction = SG_DXFER_FROM_DEV;
+    hp->dxfer_len = len;
+    hp->dxferp = sp->bp;
+    hp->mx_sb_len = SENSE_BUFF_LEN;
+    hp->sbp = sp->sense;
+    hp->timeout = DEF_TIMEOUT;
+    if (rap->ifp->dio)
+        hp->flags |= SG_FLAG_DIRECT_IO;
+    lat_start_ns = sg_pt_lat_is_enabled() ? sg_pt_lat_now_ns() : 0;
+    while (((sp->res = ioctl(fd, SG_IO, hp)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    sp->err = (sp->res < 0) ? errno : 0;
+    if (sp->res < 0)
+        return false;
+    if (lat_start_ns)
+        sg_pt_lat_record(fd, sp->cdb[0],
+                         sg_pt_lat_now_ns() - lat_start_ns);
+    return (SG_LIB_CAT_CLEAN == sg_err_category3(hp)) && (0 == hp->resid);
+}
+
+static void *
+rd_ahead_thread(void * v_thr)
+{
+    bool ok;
+    struct rd_ahead_thr * thrp = (struct rd_ahead_thr *)v_thr;
+    struct rd_ahead_t * rap = thrp->rap;
+    struct rd_ahead_slot * sp;
+
+    pthread_mutex_lock(&rap->mutex);
+    while (1) {
+        while ((! rap->stop) &&
+               ((rap->count >= rap->num) || (rap->remaining <= 0)))
+            pthread_cond_wait(&rap->cv, &rap->mutex);
+        if (rap->stop)
+            break;
+        sp = &rap->slot[(rap->head + rap->count) % rap->num];
+        sp->done = false;
+        sp->lba = rap->next_lba;
+        sp->blocks = (rap->remaining > rap->bpt) ? rap->bpt :
+                                                   (int)rap->remaining;
+        rap->next_lba += sp->blocks;
+        rap->remaining -= sp->blocks;
+        ++rap->count;
+        pthread_mutex_unlock(&rap->mutex);
+
+        ok = rd_ahead_io(rap, thrp->fd, sp);
+
+        pthread_mutex_lock(&rap->mutex);
+        sp->done = true;
+        if (! ok)       /* main thread sorts this out, read no further */
+            rap->remaining = 0;
+        pthread_cond_broadcast(&rap->cv);
+    }
+    pthread_mutex_unlock(&rap->mutex);
+    return NULL;
+}
+
+/* Starts reading ahead from lba for count blocks into num slots, with a
+ * helper thread for each of the num_fds file descriptors in fds. Returns 0
+ * on success. */
+static int
+rd_ahead_start(struct rd_ahead_t * rap, const int * fds, int num_fds,
+               bool is_sg, int64_t lba, int64_t count, int bpt, int num,
+               bool lock)
+{
+    int k, res;
+
+    memset(rap, 0, sizeof(*rap));
+    rap->is_sg = is_sg;
+    rap->bs = blk_sz;
+    rap->bpt = bpt;
+    rap->num = num;
+    rap->ifp = &iflag;
+    rap->next_lba = lba;
+    rap->remaining = count;
+    for (k = 0; k < num; ++k) {
+        rap->slot[k].bp = sg_hugebuf_get(blk_sz * bpt, lock, verbose > 3);
+        if (NULL == rap->slot[k].bp) {
+            pr2serr("sg_hugebuf_get: error, out of memory?\n");
+            return sg_convert_errno(ENOMEM);
+        }
+    }
+    pthread_mutex_init(&rap->mutex, NULL);
+    pthread_cond_init(&rap->cv, NULL);
+    rap->active = true;
+    for (k = 0; k < num_fds; ++k) {
+        rap->thr[k].rap = rap;
+        rap->thr[k].fd = fds[k];
+        res = pthread_create(&rap->thr[k].tid, NULL, rd_ahead_thread,
+                             &rap->thr[k]);
+        if (res) {
+            pr2serr("pthread_create(read ahead): %s\n", safe_strerror(res));
+            rd_ahead_fini(rap);
+            return sg_convert_errno(res);
+        }
+        rap->thr[k].started = true;
+        ++rap->num_thr;
+    }
+    return 0;
+}
+
+/* Waits for the oldest slot to be read. Returns it when it holds the chunk
+ * starting at lba, else NULL (e.g. read ahead has stopped) */
+static struct rd_ahead_slot *
+rd_ahead_get(struct rd_ahead_t * rap, int64_t lba)
+{
+    struct rd_ahead_slot * sp = NULL;
+
+    pthread_mutex_lock(&rap->mutex);
+    while (1) {
+        if (0 == rap->count) {
+            if ((rap->remaining <= 0) || rap->stop)
+                break;
+        } else if (rap->slot[rap->head].done) {
+            if (lba == rap->slot[rap->head].lba) {
+                sp = &rap->slot[rap->head];
+                break;
+            }
+            /* chunk the main thread has already read itself, drop it */
+            rap->head = (rap->head + 1) % rap->num;
+            --rap->count;
+            pthread_cond_broadcast(&rap->cv);
+            continue;
+        }
+        pthread_cond_wait(&rap->cv, &rap->mutex);
+    }
+    pthread_mutex_unlock(&rap->mutex);
+    return sp;
+}
+
+/* Hands back the oldest slot, whose buffer may have been swapped with the
+ * caller's (so it is free to read the next chunk into) */
+static void
+rd_ahead_put(struct rd_ahead_t * rap)
+{
+    pthread_mutex_lock(&rap->mutex);
+    rap->head = (rap->head + 1) % rap->num;
+    --rap->count;
+    pthread_cond_broadcast(&rap->cv);
+    pthread_mutex_unlock(&rap->mutex);
+}
+
+/* After the main thread has read a chunk itself (e.g. to handle an error)
+ * carry on reading ahead after it */
+static void
+rd_ahead_restart(struct rd_ahead_t * rap, int64_t lba, int64_t count,
+                 int bpt)
+{
+    pthread_mutex_lock(&rap->mutex);
+    if (0 == rap->count) {
+        rap->next_lba = lba;
+        rap->remaining = count;
+        rap->bpt = bpt;
+        pthread_cond_broadcast(&rap->cv);
+    }
+    pthread_mutex_unlock(&rap->mutex);
+}
+
+static void
+rd_ahead_fini(struct rd_ahead_t * rap)
+{
+    int k;
+
+    if (rap->active) {
+        pthread_mutex_lock(&rap->mutex);
+        rap->stop = true;
+        pthread_cond_broadcast(&rap->cv);
+        pthread_mutex_unlock(&rap->mutex);
+        for (k = 0; k < rap->num_thr; ++k) {
+            if (rap->thr[k].started)
+                pthread_join(rap->thr[k].tid, NULL);
+        }
+        rap->active = false;
+    }
+    for (k = 0; k < rap->num; ++k) {
+        if (rap->slot[k].bp)
+            sg_hugebuf_put(rap->slot[k].bp);
+        rap->slot[k].bp = NULL;
+    }
+}
+
+static void
+pf_ahead_init(struct pf_ahead_t * pfp, int64_t skip, int64_t count, int bpt)
+{
+    memset(pfp, 0, sizeof(*pfp));
+    pfp->active = true;
+    pfp->dist = 2;
+    pfp->bpt = bpt;
+    pfp->next_lba = skip;
+    pfp->end_lba = skip + count;
+}
+
+/* Called before the chunk of 'blocks' blocks at 'lba' is read. Pre-fetches
+ * whatever has not been asked for yet up to 'dist' chunks after it. Errors
+ * are not fatal to the copy, but if the device does not support PRE-FETCH
+ * it is not tried again. */
+static void
+pf_ahead_issue(struct pf_ahead_t * pfp, int fd, int64_t lba, int blocks)
+{
+    int res, num;
+    int64_t target;
+
+    if (! pfp->active)
+        return;
+    if (pfp->next_lba < lba + blocks)
+        pfp->next_lba = lba + blocks;
+    target = lba + blocks + (int64_t)pfp->dist * pfp->bpt;
+    if (target > pfp->end_lba)
+        target = pfp->end_lba;
+    while (pfp->active && (pfp->next_lba < target)) {
+        num = ((target - pfp->next_lba) > pfp->bpt) ? pfp->bpt :
+              (int)(target - pfp->next_lba);
+        res = sg_ll_pre_fetch_x(fd, false, true, true, pfp->next_lba, num,
+                                0, DEF_TIMEOUT / 1000, false,
+                                (verbose > 1) ? verbose - 1 : 0);
+        ++pfp->cmds;
+        switch (res) {
+        case SG_LIB_CAT_CONDITION_MET:
+            ++pfp->cond_met;
+            break;
+        case 0:         /* device says it will not fit in its cache */
+            ++pfp->good;
+            pfp->hit_run = 0;
+            if (pfp->dist > 1)
+                pfp->dist = (pfp->dist + 1) / 2;
+            break;
+        case SG_LIB_CAT_INVALID_OP:
+        case SG_LIB_CAT_ILLEGAL_REQ:
+            pr2serr("iflag=prefetch: PRE-FETCH(16) not supported, "
+                    "continuing without it\n");
+            pfp->active = false;
+            return;
+        default:
+            ++pfp->errs;
+            if (verbose)
+                pr2serr("iflag=prefetch: PRE-FETCH(16) at lba=0x%" PRIx64
+                        " failed, res=%d\n", pfp->next_lba, res);
+            break;
+        }
+        pfp->next_lba += num;
+    }
+}
+
+/* Adapts the pre-fetch distance to the latency of the last read */
+static void
+pf_ahead_lat(struct pf_ahead_t * pfp, uint64_t lat_ns)
+{
+    if (! pfp->active)
+        return;
+    if ((0 == pfp->min_ns) || (lat_ns < pfp->min_ns))
+        pfp->min_ns = lat_ns;
+    if (lat_ns > 2 * pfp->min_ns) {
+        ++pfp->misses;
+        pfp->hit_run = 0;
+        if (pfp->dist < PF_MAX_DIST)
+            ++pfp->dist;
+    } else if (++pfp->hit_run >= PF_HIT_RUN) {
+        pfp->hit_run = 0;
+        if (pfp->dist > 1)
+            --pfp->dist;
+    }
+}
+
+/* Moves one record of 'len' bytes between bp and the tape, the number of
+ * bytes actually moved is placed in *actp ; 0 when reading means a filemark
+ * or the end of data was reached. Returns 0 on success. */
+static int
+tape_io(const struct tape_ring_t * tp, bool wr, uint8_t * bp, int len,
+        int * actp)
+{
+    int res, sk;
+    uint8_t cdb[6];
+    uint8_t senseBuff[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+    struct sg_scsi_sense_info si;
+
+    *actp = 0;
+    if (! tp->is_sg) {
+        res = wr ? sg_io_write_retry(tp->fd, bp, len) :
+                   sg_io_read_retry(tp->fd, bp, len);
+        if (res < 0) {
+            res = errno;
+            perror(wr ? ME "tape write" : ME "tape read");
+            return sg_convert_errno(res);
+        }
+        if (wr && (res < len)) {
+            pr2serr(ME "tape write of %d bytes only wrote %d, end of "
+                    "medium?\n", len, res);
+            return SG_LIB_CAT_MEDIUM_HARD;
+        }
+        *actp = res;
+        return 0;
+    }
+    memset(cdb, 0, sizeof(cdb));
+    cdb[0] = wr ? 0xa : 0x8;            /* WRITE(6), READ(6); variable */
+    sg_put_unaligned_be24((uint32_t)len, cdb + 2);
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.cmd_len = sizeof(cdb);
+    io_hdr.cmdp = cdb;
+    io_hdr.dxfer_direction = wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
+    io_hdr.dxfer_len = len;
+    io_hdr.dxferp = bp;
+    io_hdr.mx_sb_len = SENSE_BUFF_LEN;
+    io_hdr.sbp = senseBuff;
+    io_hdr.timeout = DEF_TIMEOUT;
+    io_hdr.pack_id = (int)++glob_pack_id;
+    while (((res = ioctl(tp->fd, SG_IO, &io_hdr)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        perror(wr ? ME "tape WRITE(6) (SG_IO) error" :
+                    ME "tape READ(6) (SG_IO) error");
+        return -1;
+    }
+    res = sg_err_category3_sinfo(&io_hdr, &si);
+    if ((SG_LIB_CAT_CLEAN == res) || (SG_LIB_CAT_RECOVERED == res)) {
+        *actp = len - io_hdr.resid;
+        return 0;
+    }
+    if (0 == si.response_code) {        /* no (valid) sense data */
+        sg_chk_n_print3(wr ? "tape WRITE(6)" : "tape READ(6)", &io_hdr,
+                        verbose > 1);
+        return res;
+    }
+    sk = si.sense_key;
+    if (wr && si.eom && (SPC_SK_NO_SENSE == sk)) {
+        /* early warning: written, but the end of the medium is near */
+        pr2serr(ME "tape is approaching end of medium\n");
+        *actp = len;
+        return 0;
+    }
+    if ((! wr) && (si.filemark || (SPC_SK_BLANK_CHECK == sk)))
+        return 0;               /* filemark or end of data */
+    if ((! wr) && si.ili && (SPC_SK_NO_SENSE == sk) && si.info_valid) {
+        if ((int32_t)si.info > 0) {
+            *actp = len - (int32_t)si.info;
+            return 0;
+        }
+        pr2serr(ME "tape record longer than BS*BPT (%d bytes)\n", len);
+        return SG_LIB_CAT_ILLEGAL_REQ;
+    }
+    sg_chk_n_print3(wr ? "tape WRITE(6)" : "tape READ(6)", &io_hdr,
+                    verbose > 1);
+    return res;
+}
+
+/* Writes one filemark with WRITE FILEMARKS(6) at the end of a copy to a sg
+ * tape device (the st driver does that itself on close). Returns 0 on
+ * success. */
+static int
+tape_write_fm(int sg_fd)
+{
+    int res;
+    uint8_t cdb[6] = {0x10, 0, 0, 0, 1, 0};
+    uint8_t senseBuff[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.cmd_len = sizeof(cdb);
+    io_hdr.cmdp = cdb;
+    io_hdr.dxfer_direction = SG_DXFER_NONE;
+    io_hdr.mx_sb_len = SENSE_BUFF_LEN;
+    io_hdr.sbp = senseBuff;
+    io_hdr.timeout = DEF_TIMEOUT;
+    io_hdr.pack_id = (int)++glob_pack_id;
+    while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        perror(ME "WRITE FILEMARKS(6) (SG_IO) error");
+        return -1;
+    }
+    res = sg_err_category3(&io_hdr);
+    if ((SG_LIB_CAT_CLEAN == res) || (SG_LIB_CAT_RECOVERED == res))
+        return 0;
+    sg_chk_n_print3("WRITE FILEMARKS(6)", &io_hdr, verbose > 1);
+    return res;
+}
+
+/* Tape thread when writing to tape: waits for the ring to reach the high
+ * watermark, then writes records until it drops to the low watermark */
+static void *
+tape_out_thread(void * v_tp)
+{
+    int k, n, res, act;
+    struct tape_ring_t * tp = (struct tape_ring_t *)v_tp;
+
+    res = 0;
+    pthread_mutex_lock(&tp->mutex);
+    while (true) {
+        if ((! tp->streaming) && (tp->count > 0) &&
+            ((tp->count >= tp->hi) || tp->eof)) {
+            tp->streaming = true;
+            ++tp->starts;
+        }
+        if (tp->stop || (tp->eof && (0 == tp->count)))
+            break;
+        if ((! tp->streaming) || (0 == tp->count)) {
+            pthread_cond_wait(&tp->cv, &tp->mutex);
+            continue;
+        }
+        k = tp->head;
+        n = tp->len[k];
+        pthread_mutex_unlock(&tp->mutex);
+        res = tape_io(tp, true, tp->buf + (int64_t)k * tp->rec_sz, n, &act);
+        pthread_mutex_lock(&tp->mutex);
+        if (res)
+            break;
+        ++tp->recs;
+        tp->bytes += n;
+        tp->head = (tp->head + 1) % tp->num;
+        --tp->count;
+        if ((! tp->eof) && (tp->count <= tp->lo))
+            tp->streaming = false;
+        pthread_cond_broadcast(&tp->cv);
+    }
+    if ((0 == res) && tp->is_sg && tp->eof && (0 == tp->count)) {
+        pthread_mutex_unlock(&tp->mutex);
+        res = tape_write_fm(tp->fd);
+        pthread_mutex_lock(&tp->mutex);
+    }
+    tp->res = res;
+    tp->done = true;
+    pthread_cond_broadcast(&tp->cv);
+    pthread_mutex_unlock(&tp->mutex);
+    return NULL;
+}
+
+/* Tape thread when reading from tape: reads records until the ring reaches
+ * the high watermark, resumes when it is down to the low watermark */
+static void *
+tape_in_thread(void * v_tp)
+{
+    int k, res, act;
+    struct tape_ring_t * tp = (struct tape_ring_t *)v_tp;
+
+    res = 0;
+    pthread_mutex_lock(&tp->mutex);
+    tp->streaming = true;
+    tp->starts = 1;
+    while (! tp->stop) {
+        if (tp->streaming && (tp->count >= tp->hi))
+            tp->streaming = false;
+        else if ((! tp->streaming) && (tp->count <= tp->lo)) {
+            tp->streaming = true;
+            ++tp->starts;
+        }
+        if ((! tp->streaming) || (tp->count >= tp->num)) {
+            pthread_cond_wait(&tp->cv, &tp->mutex);
+            continue;
+        }
+        k = (tp->head + tp->count) % tp->num;
+        pthread_mutex_unlock(&tp->mutex);
+        res = tape_io(tp, false, tp->buf + (int64_t)k * tp->rec_sz,
+                      tp->rec_sz, &act);
+        pthread_mutex_lock(&tp->mutex);
+        if (res || (0 == act))
+            break;
+        tp->len[k] = act;
+        ++tp->count;
+        ++tp->recs;
+        tp->bytes += act;
+        pthread_cond_broadcast(&tp->cv);
+    }
+    tp->res = res;
+    tp->eof = true;
+    tp->done = true;
+    pthread_cond_broadcast(&tp->cv);
+    pthread_mutex_unlock(&tp->mutex);
+    return NULL;
+}
+
+/* Checks that records of rec_sz bytes are within the limits the drive
+ * reports with READ BLOCK LIMITS. Returns 0 if so (or if the limits are
+ * not available from a st device), else SG_LIB_CONTRADICT . */
+static int
+tape_chk_blk_lim(int fd, bool is_sg, int rec_sz)
+{
+    int res, gran;
+    uint32_t max_bl, min_bl;
+    uint8_t rbl[6];
+
+    if (is_sg && (rec_sz > 0xffffff)) {
+        pr2serr("tape=: BS*BPT (%d bytes) too large for READ(6) and "
+                "WRITE(6)\n", rec_sz);
+        return SG_LIB_CONTRADICT;
+    }
+    res = sg_ll_read_block_limits(fd, rbl, sizeof(rbl), is_sg,
+                                  (verbose > 1) ? verbose - 1 : 0);
+    if (res) {
+        if (is_sg)
+            return res;
+        if (verbose)
+            pr2serr("tape=: READ BLOCK LIMITS failed on st device, block "
+                    "size not checked\n");
+        return 0;
+    }
+    gran = rbl[0] & 0x1f;
+    max_bl = sg_get_unaligned_be24(rbl + 1);
+    min_bl = sg_get_unaligned_be16(rbl + 4);
+    if (verbose)
+        pr2serr("READ BLOCK LIMITS: min=%u, max=%u, granularity=%d\n",
+                min_bl, max_bl, gran);
+    if (((uint32_t)rec_sz < min_bl) || (max_bl && ((uint32_t)rec_sz > max_bl))
+        || (rec_sz & ((1 << gran) - 1))) {
+        pr2serr("tape=: BS*BPT=%d bytes per record is outside the drive's "
+                "block limits:\n  min=%u max=%u bytes, and a multiple of "
+                "%d\n", rec_sz, min_bl, max_bl, 1 << gran);
+        return SG_LIB_CONTRADICT;
+    }
+    return 0;
+}
+
+/* When writing to tape, waits for the ring to drain (unless 'abandon');
+ * then stops the tape thread. Returns the tape thread's error, if any. */
+static int
+tape_ring_fini(struct tape_ring_t * tp, bool abandon)
+{
+    if (tp->active) {
+        pthread_mutex_lock(&tp->mutex);
+        if (tp->to_tape && (! abandon))
+            tp->eof = true;
+        else
+            tp->stop = true;
+        pthread_cond_broadcast(&tp->cv);
+        pthread_mutex_unlock(&tp->mutex);
+        pthread_join(tp->tid, NULL);
+        tp->active = false;
+        if (verbose)
+            pr2serr("tape ring: %" PRId64 " records (%" PRId64 " bytes) %s "
+                    "tape, which was started %" PRId64 " time%s\n",
+                    tp->recs, tp->bytes, tp->to_tape ? "to" : "from",
+                    tp->starts, (1 == tp->starts) ? "" : "s");
+    }
+    if (tp->buf)
+        sg_hugebuf_put(tp->buf);
+    tp->buf = NULL;
+    free(tp->len);
+    tp->len = NULL;
+    return tp->res;
+}
+
+/* Sets up a ring of mb MiB and starts the tape thread. Returns 0 on
+ * success. */
+static int
+tape_ring_start(struct tape_ring_t * tp, int fd, bool is_sg, bool to_tape,
+                int rec_sz, int mb, int hi_pct, int lo_pct)
+{
+    int res;
+
+    tp->fd = fd;
+    tp->is_sg = is_sg;
+    tp->to_tape = to_tape;
+    tp->rec_sz = rec_sz;
+    tp->num = (int)(((int64_t)mb * 1024 * 1024) / rec_sz);
+    if (tp->num < 2) {
+        pr2serr("tape=%d: ring must hold at least 2 records of BS*BPT=%d "
+                "bytes\n", mb, rec_sz);
+        return SG_LIB_CONTRADICT;
+    }
+    tp->hi = (int)(((int64_t)tp->num * hi_pct) / 100);
+    tp->lo = (int)(((int64_t)tp->num * lo_pct) / 100);
+    if (tp->hi < 1)
+        tp->hi = 1;
+    if (tp->lo >= tp->hi)
+        tp->lo = tp->hi - 1;
+    tp->len = (int *)calloc(tp->num, sizeof(int));
+    tp->buf = sg_hugebuf_get((uint32_t)tp->num * rec_sz, false,
+                             verbose > 3);
+    if ((NULL == tp->len) || (NULL == tp->buf)) {
+        pr2serr("tape=%d: unable to allocate ring buffer\n", mb);
+        tape_ring_fini(tp, true);
+        return sg_convert_errno(ENOMEM);
+    }
+    pthread_mutex_init(&tp->mutex, NULL);
+    pthread_cond_init(&tp->cv, NULL);
+    res = pthread_create(&tp->tid, NULL,
+                         to_tape ? tape_out_thread : tape_in_thread, tp);
+    if (res) {
+        pr2serr("tape=: pthread_create: %s\n", safe_strerror(res));
+        tape_ring_fini(tp, true);
+        return sg_convert_errno(res);
+    }
+    tp->active = true;
+    if (verbose)
+        pr2serr("tape ring: %d records of %d bytes, high watermark %d, low "
+                "watermark %d\n", tp->num, rec_sz, tp->hi, tp->lo);
+    return 0;
+}
+
+/* Copies a record of len bytes into the ring, waiting while it is full.
+ * Returns 0 on success, else the error that stopped the tape thread. */
+static int
+tape_ring_put(struct tape_ring_t * tp, const uint8_t * bp, int len)
+{
+    int k;
+
+    pthread_mutex_lock(&tp->mutex);
+    while ((tp->count >= tp->num) && (! tp->done))
+        pthread_cond_wait(&tp->cv, &tp->mutex);
+    if (tp->done) {
+        pthread_mutex_unlock(&tp->mutex);
+        return tp->res ? tp->res : SG_LIB_CAT_OTHER;
+    }
+    k = (tp->head + tp->count) % tp->num;
+    pthread_mutex_unlock(&tp->mutex);
+    /* only this thread adds records so slot k stays free */
+    memcpy(tp->buf + (int64_t)k * tp->rec_sz, bp, len);
+    pthread_mutex_lock(&tp->mutex);
+    tp->len[k] = len;
+    ++tp->count;
+    pthread_cond_broadcast(&tp->cv);
+    pthread_mutex_unlock(&tp->mutex);
+    return 0;
+}
+
+/* Takes the oldest record from the ring (at most mx bytes of it) into bp,
+ * waiting while it is empty. Returns the number of bytes, 0 at the end of
+ * the tape data, or -1 (with the tape thread's error in tp->res). */
+static int
+tape_ring_get(struct tape_ring_t * tp, uint8_t * bp, int mx)
+{
+    int k, n;
+
+    pthread_mutex_lock(&tp->mutex);
+    while ((0 == tp->count) && (! tp->done))
+        pthread_cond_wait(&tp->cv, &tp->mutex);
+    if (0 == tp->count) {
+        pthread_mutex_unlock(&tp->mutex);
+        return tp->res ? -1 : 0;
+    }
+    k = tp->head;
+    n = (tp->len[k] < mx) ? tp->len[k] : mx;
+    pthread_mutex_unlock(&tp->mutex);
+    memcpy(bp, tp->buf + (int64_t)k * tp->rec_sz, n);
+    pthread_mutex_lock(&tp->mutex);
+    tp->head = (tp->head + 1) % tp->num;
+    --tp->count;
+    pthread_cond_broadcast(&tp->cv);
+    pthread_mutex_unlock(&tp->mutex);
+    return n;
+}
+
+/* Reads back 'blocks' blocks starting at 'lba' from the OFILE (open on fd,
+ * its read/write flags used for the cdb) for verify=1. Returns 0 when
+ * successful. */
+static int
+read_back(int fd, int out_type, uint8_t * bp, int blocks, int64_t lba,
+          const struct flags_t * ofp)
+{
+    int res, len;
+    uint8_t rdCmd[MAX_SCSI_CDBSZ];
+    uint8_t senseBuff[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+
+    len = blocks * blk_sz;
+    if (! (FT_SG & out_type)) {
+        while (((res = pread(fd, bp, len, (off_t)lba * blk_sz)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        if (res < 0) {
+            perror(ME "verify read back");
+            return SG_LIB_FILE_ERROR;
+        }
+        if (res < len) {
+            pr2serr(ME "verify: short read back at blk=%" PRId64 ", %d of "
+                    "%d bytes\n", lba, res, len);
+            return SG_LIB_CAT_MISCOMPARE;
+        }
+        return 0;
+    }
+    if (sg_build_rw_cdb(rdCmd, ofp->cdbsz, blocks, lba, false, false,
+                        false, ME)) {
+        pr2serr(ME "bad verify cdb build, from_block=%" PRId64 ", blocks=%d\n",
+                lba, blocks);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.cmd_len = ofp->cdbsz;
+    io_hdr.cmdp = rdCmd;
+    io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
+    io_hdr.dxfer_len = len;
+    io_hdr.dxferp = bp;
+    io_hdr.mx_sb_len = SENSE_BUFF_LEN;
+    io_hdr.sbp = senseBuff;
+    io_hdr.timeout = DEF_TIMEOUT;
+    io_hdr.pack_id = (int)++glob_pack_id;
+    while (((res = ioctl(fd, SG_IO, &io_hdr)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        perror("verify reading (SG_IO) on sg device, error");
+        return -1;
+    }
+    res = sg_err_category3(&io_hdr);
+    if ((SG_LIB_CAT_CLEAN == res) || (SG_LIB_CAT_RECOVERED == res))
+        return 0;
+    sg_chk_n_print3("verify reading", &io_hdr, verbose > 1);
+    return res;
+}
+
+/* resume=CFILE keeps a bit per chunk (of BPT blocks, from SKIP) in CFILE,
+ * set once that chunk has been written to OFILE. CFILE is mmap-ed shared
+ * so the kernel writes it back in the background; a copy that is stopped
+ * (e.g. killed) and started again with the same operands bypasses the
+ * chunks already copied. CFILE starts with a RESUME_HDR_LEN byte header
+ * holding the operands that must match. */
+#define RESUME_MAGIC "SG3RSUM1"
+#define RESUME_HDR_LEN 64
+
+struct resume_t {
+    int fd;
+    size_t len;
+    uint8_t * mp;           /* mapping of CFILE, header then bitmap */
+    int64_t chunks;
+    int64_t done_at_start;  /* chunks already copied when opened */
+};
+
+/* Opens (creating if need be) and maps the checkpoint file 'fn'. Returns 0
+ * if successful, else sg3_utils error code. */
+static int
+resume_open(struct resume_t * rp, const char * fn, int64_t skip,
+            int64_t seek, int64_t count, int bs, int bpt)
+{
+    bool fresh;
+    int err;
+    int64_t k;
+    uint8_t hdr[RESUME_HDR_LEN];
+    struct stat st;
+
+    memset(rp, 0, sizeof(*rp));
+    rp->chunks = (count + bpt - 1) / bpt;
+    rp->len = RESUME_HDR_LEN + (size_t)((rp->chunks + 7) / 8);
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, RESUME_MAGIC, 8);
+    sg_put_unaligned_be64((uint64_t)skip, hdr + 8);
+    sg_put_unaligned_be64((uint64_t)seek, hdr + 16);
+    sg_put_unaligned_be64((uint64_t)count, hdr + 24);
+    sg_put_unaligned_be32((uint32_t)bs, hdr + 32);
+    sg_put_unaligned_be32((uint32_t)bpt, hdr + 36);
+    if ((rp->fd = open(fn, O_RDWR | O_CREAT, 0644)) < 0) {
+        err = errno;
+        pr2serr(ME "resume: could not open %s: %s\n", fn, safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    if (fstat(rp->fd, &st) < 0)
+        goto file_err;
+    fresh = (0 == st.st_size);
+    if (fresh) {
+        if (ftruncate(rp->fd, (off_t)rp->len) < 0)
+            goto file_err;
+    } else if ((size_t)st.st_size != rp->len) {
+        pr2serr(ME "resume: %s is from a different copy (size)\n", fn);
+        close(rp->fd);
+        return SG_LIB_CONTRADICT;
+    }
+    rp->mp = (uint8_t *)mmap(NULL, rp->len, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, rp->fd, 0);
+    if (MAP_FAILED == rp->mp) {
+        rp->mp = NULL;
+        goto file_err;
+    }
+    if (fresh)
+        memcpy(rp->mp, hdr, sizeof(hdr));
+    else if (memcmp(rp->mp, hdr, sizeof(hdr))) {
+        pr2serr(ME "resume: %s is from a different copy (skip, seek, count, "
+                "bs or bpt differ)\n", fn);
+        munmap(rp->mp, rp->len);
+        close(rp->fd);
+        rp->mp = NULL;
+        return SG_LIB_CONTRADICT;
+    }
+    for (k = 0; k < rp->chunks; ++k) {
+        if (rp->mp[RESUME_HDR_LEN + (k / 8)] & (1 << (k % 8)))
+            ++rp->done_at_start;
+    }
+    return 0;
+
+file_err:
+    err = errno;
+    pr2serr(ME "resume: %s: %s\n", fn, safe_strerror(err));
+    close(rp->fd);
+    return sg_convert_errno(err);
+}
+
+static bool
+resume_is_done(const struct resume_t * rp, int64_t chunk)
+{
+    return (chunk < rp->chunks) &&
+           (rp->mp[RESUME_HDR_LEN + (chunk / 8)] & (1 << (chunk % 8)));
+}
+
+static void
+resume_set_done(struct resume_t * rp, int64_t chunk)
+{
+    if (chunk < rp->chunks)
+        rp->mp[RESUME_HDR_LEN + (chunk / 8)] |= (uint8_t)(1 << (chunk % 8));
+}
+
+/* Returns 0 if the bitmap has been written back to CFILE, else -1 */
+static int
+resume_close(struct resume_t * rp)
+{
+    int res = 0;
+
+    if (NULL == rp->mp)
+        return 0;
+    if (msync(rp->mp, rp->len, MS_SYNC) < 0) {
+        perror(ME "resume: msync");
+        res = -1;
+    }
+    munmap(rp->mp, rp->len);
+    close(rp->fd);
+    rp->mp = NULL;
+    return res;
+}
+
+/* Implements verify=1: reads back each chunk of the OFILE listed in the
+ * digest manifest 'mfn' and compares its CRC32C with the one recorded
+ * during the copy. Returns 0 if they all match. */
+static int
+verify_digests(const char * mfn, int fd, int out_type, uint8_t * bp,
+               int max_blocks, const struct flags_t * ofp)
+{
+    int blocks, res;
+    int ret = 0;
+    unsigned int crc;
+    int64_t lba;
+    int64_t chunks = 0;
+    int64_t v_blocks = 0;
+    int64_t mismatches = 0;
+    FILE * fp;
+    char line[128];
+
+    if (NULL == (fp = fopen(mfn, "r"))) {
+        perror(ME "verify: unable to re-open digest manifest");
+        return SG_LIB_FILE_ERROR;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if ('#' == line[0])
+            continue;
+        if ((3 != sscanf(line, "%" SCNd64 " %d %x", &lba, &blocks, &crc)) ||
+            (blocks <= 0) || (blocks > max_blocks)) {
+            pr2serr(ME "verify: bad line in digest manifest: %s", line);
+            ret = SG_LIB_FILE_ERROR;
+            break;
         }
-        break;
-    case SG_LIB_CAT_ABORTED_COMMAND:
-    case SG_LIB_CAT_UNIT_ATTENTION:
-        sg_chk_n_print3("writing", &io_hdr, verbose > 1);
-        return res;
-    case SG_LIB_CAT_NOT_READY:
-        ++unrecovered_errs;
-        pr2serr("device not ready (w)\n");
-        return res;
-    case SG_LIB_CAT_MEDIUM_HARD:
-    default:
-        sg_chk_n_print3("writing", &io_hdr, verbose > 1);
-        ++unrecovered_errs;
-        if (ofp->coe) {
-            pr2serr(">> ignored errors for out blk=%" PRId64 " for %d "
-                    "bytes\n", to_block, bs * blocks);
-            return 0; /* fudge success */
-        } else
-            return res;
+        res = read_back(fd, out_type, bp, blocks, lba, ofp);
+        if ((0 == res) && (sg_crc32c(0, bp, blocks * blk_sz) != crc))
+            res = SG_LIB_CAT_MISCOMPARE;
+        if (SG_LIB_CAT_MISCOMPARE == res) {
+            ++mismatches;
+            if (verbose || (mismatches <= 10))
+                pr2serr(ME "verify: miscompare in %d blocks from blk=%" PRId64
+                        "\n", blocks, lba);
+        } else if (res) {
+            ret = res;
+            break;
+        }
+        ++chunks;
+        v_blocks += blocks;
     }
-    if (diop && *diop &&
-        ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
-        *diop = false;      /* flag that dio not done (completely) */
-    return 0;
+    fclose(fp);
+    pr2serr("Verify: %" PRId64 " chunks (%" PRId64 " blocks) read back, %"
+            PRId64 " miscompared\n", chunks, v_blocks, mismatches);
+    if ((0 == ret) && mismatches)
+        ret = SG_LIB_CAT_MISCOMPARE;
+    return ret;
 }
 
+/* For protect=RDP,WRP: the chunk just read into bp has a PI tuple after
+ * each block when RDP > 0, and these are checked. Then the chunk is put in
+ * the form that OFILE takes: with a PI tuple after each block when WRP > 0
+ * (generated if RDP is 0), otherwise just the user data. Returns 0 or
+ * SG_LIB_CAT_PROTECTION. */
+static int
+pi_process(uint8_t * bp, int blocks, int64_t skip, int64_t seek)
+{
+    int res, bad;
+
+    if (0 == iflag.protect) {
+        sg_t10_pi_expand(bp, blk_sz, blocks);
+        sg_t10_pi_gen(bp, blk_sz, blocks, 0, (uint32_t)seek, oflag.pi_type);
+        return 0;
+    }
+    res = sg_t10_pi_chk(bp, blk_sz, blocks, (uint32_t)skip, iflag.pi_type,
+                        &bad);
+    if (res) {
+        pr2serr("protect: %s tag check failed at IFILE lba=%" PRId64
+                " [0x%" PRIx64 "]\n", ((1 == res) ? "guard" : "reference"),
+                skip + bad, skip + bad);
+        return SG_LIB_CAT_PROTECTION;
+    }
+    if (0 == oflag.protect)
+        sg_t10_pi_strip(bp, blk_sz, blocks);
+    else if ((1 == oflag.pi_type) &&
+             ((skip != seek) || (1 != iflag.pi_type)))
+        sg_t10_pi_set_ref(bp, blk_sz, blocks, (uint32_t)seek, 1);
+    return 0;
+}
 
 static void
 calc_duration_throughput(bool contin)
 {
-    struct timeval end_tm, res_tm;
-    double a, b;
-    int64_t blks;
-
-    if (start_tm_valid && (start_tm.tv_sec || start_tm.tv_usec)) {
-        blks = (in_full > out_full) ? in_full : out_full;
-        gettimeofday(&end_tm, NULL);
-        res_tm.tv_sec = end_tm.tv_sec - start_tm.tv_sec;
-        res_tm.tv_usec = end_tm.tv_usec - start_tm.tv_usec;
-        if (res_tm.tv_usec < 0) {
-            --res_tm.tv_sec;
-            res_tm.tv_usec += 1000000;
-        }
-        a = res_tm.tv_sec;
-        a += (0.000001 * res_tm.tv_usec);
-        b = (double)blk_sz * blks;
-        pr2serr("time to transfer data%s: %d.%06d secs",
-                (contin ? " so far" : ""), (int)res_tm.tv_sec,
-                (int)res_tm.tv_usec);
-        if ((a > 0.00001) && (b > 511))
-            pr2serr(" at %.2f MB/sec\n", b / (a * 1000000.0));
-        else
-            pr2serr("\n");
-    }
+    if (start_tm_valid && (start_tm.tv_sec || start_tm.tv_usec))
+        sg_io_print_throughput(&start_tm,
+                               (in_full > out_full) ? in_full : out_full,
+                               blk_sz, contin);
 }
 
 /* Process arguments given to 'iflag=" or 'oflag=" options. Returns 0
@@ -1156,6 +2376,8 @@ process_flags(const char * arg, struct flags_t * fp)
             ++fp->nocache;
         else if (0 == strcmp(cp, "null"))
             ;
+        else if (0 == strcmp(cp, "prefetch"))
+            fp->prefetch = true;
         else if (0 == strcmp(cp, "sgio"))
             fp->sgio = true;
         else if (0 == strcmp(cp, "sparse"))
@@ -1223,50 +2445,73 @@ process_conv(const char * arg, struct flags_t * ifp, struct flags_t * ofp)
     return 0;
 }
 
+/* Returns the SG_IO_OPEN_* mask for sg_io_open_dd() from iflag= or
+ * oflag= . A sg device is always opened non-blocking. */
+static int
+open_fl_mask(const struct flags_t * fp)
+{
+    int fl_mask = SG_IO_OPEN_NONBLOCK | SG_IO_OPEN_RDONLY_OK;
+
+    if (fp->direct)
+        fl_mask |= SG_IO_OPEN_DIRECT;
+    if (fp->excl)
+        fl_mask |= SG_IO_OPEN_EXCL;
+    if (fp->dsync)
+        fl_mask |= SG_IO_OPEN_DSYNC;
+    if (fp->append)
+        fl_mask |= SG_IO_OPEN_APPEND;
+    return fl_mask;
+}
+
+/* For fds=K opens the sg IFILE once more, with the same flags as
+ * open_if() (apart from excl which would fail), and sizes the reserved
+ * buffer of the new file descriptor. Returns it (>= 0) or -1 if error. */
+static int
+open_if_again(const char * inf, const struct flags_t * ifp, bool is_blk,
+              int * bptp, int vb)
+{
+    int fd;
+
+    fd = sg_io_open_dd(inf, FT_SG, false, open_fl_mask(ifp) &
+                       ~SG_IO_OPEN_EXCL, 0, blk_sz, ME, 0);
+    if (fd < 0)
+        return -1;
+    if (! is_blk)
+        sg_io_reserve(fd, blk_sz, bptp, 1, ! ifp->dio, ME, vb);
+    return fd;
+}
+
 /* Returns open input file descriptor (>= 0) or a negative value
  * (-SG_LIB_FILE_ERROR or -SG_LIB_CAT_OTHER) if error.
  */
 static int
-open_if(const char * inf, int64_t skip, int bpt, struct flags_t * ifp,
+open_if(const char * inf, int64_t skip, struct flags_t * ifp,
         int * in_typep, int vb)
 {
-    int infd, flags, fl, t, res;
+    int infd, t, res;
     char ebuff[EBUFF_SZ];
     struct sg_simple_inquiry_resp sir;
 
-    *in_typep = dd_filetype(inf);
+    *in_typep = sg_io_filetype(inf, SG_IO_FT_WANT_BSG | SG_IO_FT_WANT_FIFO,
+                               vb);
     if (vb)
         pr2serr(" >> Input file type: %s\n",
-                dd_filetype_str(*in_typep, ebuff));
+                sg_io_filetype_str(*in_typep, EBUFF_SZ, ebuff));
     if (FT_ERROR & *in_typep) {
         pr2serr(ME "unable access %s\n", inf);
         goto file_err;
     } else if ((FT_BLOCK & *in_typep) && ifp->sgio)
         *in_typep |= FT_SG;
 
-    if (FT_ST & *in_typep) {
-        pr2serr(ME "unable to use scsi tape device %s\n", inf);
+    if ((FT_ST & *in_typep) && (! ifp->tape)) {
+        pr2serr(ME "unable to use scsi tape device %s without tape=\n",
+                inf);
         goto file_err;
     } else if (FT_SG & *in_typep) {
-        flags = O_NONBLOCK;
-        if (ifp->direct)
-            flags |= O_DIRECT;
-        if (ifp->excl)
-            flags |= O_EXCL;
-        if (ifp->dsync)
-            flags |= O_SYNC;
-        fl = O_RDWR;
-        if ((infd = open(inf, fl | flags)) < 0) {
-            fl = O_RDONLY;
-            if ((infd = open(inf, fl | flags)) < 0) {
-                snprintf(ebuff, EBUFF_SZ,
-                         ME "could not open %s for sg reading", inf);
-                perror(ebuff);
-                goto file_err;
-            }
-        }
-        if (vb)
-            pr2serr("        open input(sg_io), flags=0x%x\n", fl | flags);
+        infd = sg_io_open_dd(inf, *in_typep, false, open_fl_mask(ifp), 0,
+                             blk_sz, ME, vb);
+        if (infd < 0)
+            goto file_err;
         if (sg_simple_inquiry(infd, &sir, false, (vb ? (vb - 1) : 0))) {
             pr2serr("INQUIRY failed on %s\n", inf);
             goto other_err;
@@ -1276,10 +2521,6 @@ open_if(const char * inf, int64_t skip, int bpt, struct flags_t * ifp,
             pr2serr("    %s: %.8s  %.16s  %.4s  [pdt=%d]\n", inf, sir.vendor,
                     sir.product, sir.revision, ifp->pdt);
         if (! (FT_BLOCK & *in_typep)) {
-            t = blk_sz * bpt;
-            res = ioctl(infd, SG_SET_RESERVED_SIZE, &t);
-            if (res < 0)
-                perror(ME "SG_SET_RESERVED_SIZE error");
             res = ioctl(infd, SG_GET_VERSION_NUM, &t);
             if ((res < 0) || (t < 30000)) {
                 if (FT_BLOCK & *in_typep)
@@ -1290,47 +2531,19 @@ open_if(const char * inf, int64_t skip, int bpt, struct flags_t * ifp,
             }
         }
     } else {
-        flags = O_RDONLY;
-        if (ifp->direct)
-            flags |= O_DIRECT;
-        if (ifp->excl)
-            flags |= O_EXCL;
-        if (ifp->dsync)
-            flags |= O_SYNC;
-        infd = open(inf, flags);
-        if (infd < 0) {
-            snprintf(ebuff, EBUFF_SZ,
-                     ME "could not open %s for reading", inf);
-            perror(ebuff);
+        infd = sg_io_open_dd(inf, *in_typep, false, open_fl_mask(ifp), skip,
+                             blk_sz, ME, vb);
+        if (infd < 0)
             goto file_err;
-        } else {
-            if (vb)
-                pr2serr("        open input, flags=0x%x\n", flags);
-            if (skip > 0) {
-                off64_t offset = skip;
-
-                offset *= blk_sz;       /* could exceed 32 bits here! */
-                if (lseek64(infd, offset, SEEK_SET) < 0) {
-                    snprintf(ebuff, EBUFF_SZ, ME "couldn't skip to "
-                             "required position on %s", inf);
-                    perror(ebuff);
-                    goto file_err;
-                }
-                if (vb)
-                    pr2serr("  >> skip: lseek64 SEEK_SET, byte offset=0x%"
-                            PRIx64 "\n", (uint64_t)offset);
-            }
 #ifdef HAVE_POSIX_FADVISE
-            if (ifp->nocache) {
-                int rt;
+        if (ifp->nocache) {
+            int rt;
 
-                rt = posix_fadvise(infd, 0, 0, POSIX_FADV_SEQUENTIAL);
-                if (rt)
-                    pr2serr("open_if: posix_fadvise(SEQUENTIAL), err=%d\n",
-                            rt);
-            }
-#endif
+            rt = posix_fadvise(infd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            if (rt)
+                pr2serr("open_if: posix_fadvise(SEQUENTIAL), err=%d\n", rt);
         }
+#endif
     }
     if (ifp->flock) {
         res = flock(infd, LOCK_EX | LOCK_NB);
@@ -1355,40 +2568,31 @@ other_err:
  * (-SG_LIB_FILE_ERROR or -SG_LIB_CAT_OTHER) if error.
  */
 static int
-open_of(const char * outf, int64_t seek, int bpt, struct flags_t * ofp,
+open_of(const char * outf, int64_t seek, struct flags_t * ofp,
         int * out_typep, int vb)
 {
-    int outfd, flags, t, res;
+    int outfd, t, res;
     char ebuff[EBUFF_SZ];
     struct sg_simple_inquiry_resp sir;
 
-    *out_typep = dd_filetype(outf);
+    *out_typep = sg_io_filetype(outf, SG_IO_FT_WANT_BSG | SG_IO_FT_WANT_FIFO,
+                                vb);
     if (vb)
         pr2serr(" >> Output file type: %s\n",
-                dd_filetype_str(*out_typep, ebuff));
+                sg_io_filetype_str(*out_typep, EBUFF_SZ, ebuff));
 
     if ((FT_BLOCK & *out_typep) && ofp->sgio)
         *out_typep |= FT_SG;
 
-    if (FT_ST & *out_typep) {
-        pr2serr(ME "unable to use scsi tape device %s\n", outf);
+    if ((FT_ST & *out_typep) && (! ofp->tape)) {
+        pr2serr(ME "unable to use scsi tape device %s without tape=\n",
+                outf);
         goto file_err;
     } else if (FT_SG & *out_typep) {
-        flags = O_RDWR | O_NONBLOCK;
-        if (ofp->direct)
-            flags |= O_DIRECT;
-        if (ofp->excl)
-            flags |= O_EXCL;
-        if (ofp->dsync)
-            flags |= O_SYNC;
-        if ((outfd = open(outf, flags)) < 0) {
-            snprintf(ebuff, EBUFF_SZ,
-                     ME "could not open %s for sg writing", outf);
-            perror(ebuff);
+        outfd = sg_io_open_dd(outf, *out_typep, true, open_fl_mask(ofp), 0,
+                              blk_sz, ME, vb);
+        if (outfd < 0)
             goto file_err;
-        }
-        if (vb)
-            pr2serr("        open output(sg_io), flags=0x%x\n", flags);
         if (sg_simple_inquiry(outfd, &sir, false, (vb ? (vb - 1) : 0))) {
             pr2serr("INQUIRY failed on %s\n", outf);
             goto other_err;
@@ -1398,10 +2602,6 @@ open_of(const char * outf, int64_t seek, int bpt, struct flags_t * ofp,
             pr2serr("    %s: %.8s  %.16s  %.4s  [pdt=%d]\n", outf, sir.vendor,
                     sir.product, sir.revision, ofp->pdt);
         if (! (FT_BLOCK & *out_typep)) {
-            t = blk_sz * bpt;
-            res = ioctl(outfd, SG_SET_RESERVED_SIZE, &t);
-            if (res < 0)
-                perror(ME "SG_SET_RESERVED_SIZE error");
             res = ioctl(outfd, SG_GET_VERSION_NUM, &t);
             if ((res < 0) || (t < 30000)) {
                 pr2serr(ME "sg driver prior to 3.x.y\n");
@@ -1411,54 +2611,10 @@ open_of(const char * outf, int64_t seek, int bpt, struct flags_t * ofp,
     } else if (FT_DEV_NULL & *out_typep)
         outfd = -1; /* don't bother opening */
     else {
-        if (! (FT_RAW & *out_typep)) {
-            flags = O_WRONLY | O_CREAT;
-            if (ofp->direct)
-                flags |= O_DIRECT;
-            if (ofp->excl)
-                flags |= O_EXCL;
-            if (ofp->dsync)
-                flags |= O_SYNC;
-            if (ofp->append)
-                flags |= O_APPEND;
-            if ((outfd = open(outf, flags, 0666)) < 0) {
-                snprintf(ebuff, EBUFF_SZ,
-                        ME "could not open %s for writing", outf);
-                perror(ebuff);
-                goto file_err;
-            }
-        } else {
-            flags = O_WRONLY;
-            if (ofp->direct)
-                flags |= O_DIRECT;
-            if (ofp->excl)
-                flags |= O_EXCL;
-            if (ofp->dsync)
-                flags |= O_SYNC;
-            if ((outfd = open(outf, flags)) < 0) {
-                snprintf(ebuff, EBUFF_SZ,
-                        ME "could not open %s for raw writing", outf);
-                perror(ebuff);
-                goto file_err;
-            }
-        }
-        if (vb)
-            pr2serr("        %s output, flags=0x%x\n",
-                    ((O_CREAT & flags) ? "create" : "open"), flags);
-        if (seek > 0) {
-            off64_t offset = seek;
-
-            offset *= blk_sz;       /* could exceed 32 bits here! */
-            if (lseek64(outfd, offset, SEEK_SET) < 0) {
-                snprintf(ebuff, EBUFF_SZ,
-                    ME "couldn't seek to required position on %s", outf);
-                perror(ebuff);
-                goto file_err;
-            }
-            if (vb)
-                pr2serr("   >> seek: lseek64 SEEK_SET, byte offset=0x%" PRIx64
-                        "\n", (uint64_t)offset);
-        }
+        outfd = sg_io_open_dd(outf, *out_typep, true, open_fl_mask(ofp),
+                              seek, blk_sz, ME, vb);
+        if (outfd < 0)
+            goto file_err;
     }
     if (ofp->flock) {
         res = flock(outfd, LOCK_EX | LOCK_NB);
@@ -1478,6 +2634,63 @@ other_err:
     return -SG_LIB_CAT_OTHER;
 }
 
+/* For engine=auto|sync|rdahead, after IFILE and OFILE are open. Probes
+ * the sg driver in front of them and picks between one command at a time
+ * and the read ahead thread of bufs=N, plus direct IO when the driver
+ * allows it. 'no_bufs' is set when other options rule out bufs=N; options
+ * given explicitly are not overridden. Returns 0, or SG_LIB_CONTRADICT . */
+static int
+choose_engine(int engine, int infd, int in_type, int outfd, int out_type,
+              bool bufs_given, bool dio_given, bool no_bufs, int * num_bufsp)
+{
+    bool dio = false;
+    struct sg_io_caps in_caps, out_caps;
+    const struct sg_io_caps * cp;
+    char b[128];
+
+    if (ENGINE_SYNC == engine) {
+        if (*num_bufsp > 1) {
+            pr2serr("engine=sync contradicts bufs=%d\n", *num_bufsp);
+            return SG_LIB_CONTRADICT;
+        }
+        return 0;
+    }
+    if (ENGINE_RDAHEAD == engine) {
+        if (no_bufs) {
+            pr2serr("engine=rdahead does not work with protect=, resume=, "
+                    "tape= nor iflag=prefetch\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (! bufs_given)
+            *num_bufsp = AUTO_BUFS;
+        return 0;
+    }
+    /* engine=auto */
+    sg_io_probe_caps((FT_SG & in_type) ? infd : -1, &in_caps, verbose);
+    sg_io_probe_caps((FT_SG & out_type) ? outfd : -1, &out_caps, verbose);
+    if ((! bufs_given) && (! no_bufs) && (! (FT_DEV_NULL & in_type)))
+        *num_bufsp = AUTO_BUFS;
+    /* the block layer maps user buffers itself, so sg devices only */
+    if ((! dio_given) && in_caps.dio) {
+        if (in_caps.is_sg)
+            iflag.dio = true;
+        if (out_caps.is_sg)
+            oflag.dio = true;
+        dio = iflag.dio || oflag.dio;
+    }
+    cp = (FT_SG & in_type) ? &in_caps : &out_caps;
+    pr2serr("engine=auto: %s; using %s%s\n",
+            sg_io_caps_str(cp, sizeof(b), b),
+            (*num_bufsp > 1) ? "read ahead thread" : "one command at a time",
+            dio ? " with direct IO" : "");
+    if ((*num_bufsp > 1) && verbose)
+        pr2serr("    bufs=%d\n", *num_bufsp);
+    if (cp->v4_share && verbose)
+        pr2serr("    this sg driver also has request sharing, as used by "
+                "sgh_dd\n");
+    return 0;
+}
+
 /* Returns the number of times 'ch' is found in string 's' given the
  * string's length. */
 static int
@@ -1496,27 +2709,44 @@ num_chs_in_str(const char * s, int slen, int ch)
 int
 main(int argc, char * argv[])
 {
+    bool bpt_auto = false;
     bool bpt_given = false;
     bool cdbsz_given = false;
     bool dio_tmp, first;
     bool do_sync = false;
+    bool do_verify = false;
     bool penult_sparse_skip = false;
+    bool rd_ahead_redo;
     bool sparse_skip = false;
     bool verbose_given = false;
     bool version_given = false;
+    bool tape_in = false;
+    bool tape_out = false;
+    bool bufs_given = false;
+    bool dio_given = false;
     int res, k, n, t, buf_sz, blocks_per, infd, outfd, out2fd, keylen;
+    int in_fds[MAX_IN_FDS];
     int retries_tmp, blks_read, bytes_read, bytes_of2, bytes_of;
     int in_sect_sz, out_sect_sz;
     int blocks = 0;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
     int dio_incomplete_count = 0;
+    int num_bufs = 1;
+    int num_in_fds = 1;
+    int progress_sec = 0;
     int ibs = 0;
+    int in_bs, out_bs;          /* bs plus 8 when PI in buffer */
+    int zlead;                  /* leading zero blocks bypassed in chunk */
     int in_type = FT_OTHER;
     int obs = 0;
     int out_type = FT_OTHER;
     int out2_type = FT_OTHER;
     int penult_blocks = 0;
     int ret = 0;
+    int engine = ENGINE_DEF;
+    int tape_mb = 0;
+    int tape_hi = TAPE_DEF_HI_PCT;
+    int tape_lo = TAPE_DEF_LO_PCT;
     int64_t skip = 0;
     int64_t seek = 0;
     int64_t out2_off = 0;
@@ -1524,17 +2754,38 @@ main(int argc, char * argv[])
     int64_t out_num_sect = -1;
     char * key;
     char * buf;
-    uint8_t * wrkBuff;
+    char * cp;
+    char * np;
+    FILE * dgst_fp = NULL;
+    int64_t rsm_skip, rsm_seek, rsm_next;
+    int64_t rate_bps = 0;
+    int64_t rate_iops = 0;
+    int64_t rate_lat_us = 0;
+    uint64_t lat_start;
+    bool lat_table;
+    struct resume_t rsm;
     uint8_t * wrkPos;
+    uint8_t * wrp;              /* first block of chunk to be written */
+    uint8_t * bp;
+    struct rd_ahead_slot * rasp;
     char inf[INOUTF_SZ];
     char outf[INOUTF_SZ];
     char out2f[INOUTF_SZ];
+    char dgst_f[INOUTF_SZ];
+    char bmap_f[INOUTF_SZ];
+    char rsm_f[INOUTF_SZ];
+    char prog_f[INOUTF_SZ];
     char str[STR_SZ];
     char ebuff[EBUFF_SZ];
 
     inf[0] = '\0';
     outf[0] = '\0';
     out2f[0] = '\0';
+    dgst_f[0] = '\0';
+    bmap_f[0] = '\0';
+    rsm_f[0] = '\0';
+    prog_f[0] = '\0';
+    memset(&rsm, 0, sizeof(rsm));
     iflag.cdbsz = DEF_SCSI_CDBSZ;
     oflag.cdbsz = DEF_SCSI_CDBSZ;
 
@@ -1552,16 +2803,33 @@ main(int argc, char * argv[])
         if (0 == strncmp(key, "app", 3)) {
             iflag.append = !! sg_get_num(buf);
             oflag.append = iflag.append;
+        } else if (0 == strcmp(key, "badmap")) {
+            memcpy(bmap_f, buf, INOUTF_SZ - 1);
+            bmap_f[INOUTF_SZ - 1] = '\0';
         } else if (0 == strcmp(key, "blk_sgio")) {
             iflag.sgio = !! sg_get_num(buf);
             oflag.sgio = iflag.sgio;
         } else if (0 == strcmp(key, "bpt")) {
-            bpt = sg_get_num(buf);
+            if (0 == strcmp(buf, "auto")) {
+                bpt_auto = true;
+                bpt = DEF_BLOCKS_PER_TRANSFER;
+            } else {
+                bpt_auto = false;
+                bpt = sg_get_num(buf);
+            }
             if (-1 == bpt) {
                 pr2serr(ME "bad argument to 'bpt='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
             bpt_given = true;
+        } else if (0 == strcmp(key, "bufs")) {
+            num_bufs = sg_get_num(buf);
+            if ((num_bufs < 1) || (num_bufs > MAX_BUFS)) {
+                pr2serr(ME "bad argument to 'bufs=', expect 1 to %d\n",
+                        MAX_BUFS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            bufs_given = true;
         } else if (0 == strcmp(key, "bs")) {
             blk_sz = sg_get_num(buf);
             bpt_given = true;
@@ -1600,6 +2868,26 @@ main(int argc, char * argv[])
         } else if (0 == strcmp(key, "dio")) {
             oflag.dio = !! sg_get_num(buf);
             iflag.dio = oflag.dio;
+            dio_given = true;
+        } else if (0 == strcmp(key, "engine")) {
+            if (0 == strcmp(buf, "auto"))
+                engine = ENGINE_AUTO;
+            else if (0 == strcmp(buf, "sync"))
+                engine = ENGINE_SYNC;
+            else if (0 == strcmp(buf, "rdahead"))
+                engine = ENGINE_RDAHEAD;
+            else {
+                pr2serr(ME "bad argument to 'engine=', expect auto, sync "
+                        "or rdahead\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "fds")) {
+            num_in_fds = sg_get_num(buf);
+            if ((num_in_fds < 1) || (num_in_fds > MAX_IN_FDS)) {
+                pr2serr(ME "bad argument to 'fds=', expect 1 to %d\n",
+                        MAX_IN_FDS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "fua")) {
             t = sg_get_num(buf);
             oflag.fua = !! (t & 1);
@@ -1614,6 +2902,12 @@ main(int argc, char * argv[])
                 memcpy(inf, buf, INOUTF_SZ - 1);
                 inf[INOUTF_SZ - 1] = '\0';
             }
+        } else if (0 == strcmp(key, "iops")) {
+            rate_iops = sg_get_llnum(buf);
+            if (rate_iops < 0) {
+                pr2serr(ME "bad argument to 'iops='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "iflag")) {
             if (process_flags(buf, &iflag)) {
                 pr2serr(ME "bad argument to 'iflag='\n");
@@ -1632,6 +2926,9 @@ main(int argc, char * argv[])
                 memcpy(outf, buf, INOUTF_SZ - 1);
                 outf[INOUTF_SZ - 1] = '\0';
             }
+        } else if (0 == strcmp(key, "digest")) {
+            memcpy(dgst_f, buf, INOUTF_SZ - 1);
+            dgst_f[INOUTF_SZ - 1] = '\0';
         } else if (strcmp(key, "of2") == 0) {
             if ('\0' != out2f[0]) {
                 pr2serr("Second OFILE2 argument??\n");
@@ -1645,6 +2942,35 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'oflag='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "progress")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            progress_sec = sg_get_num(buf);
+            if (progress_sec < 1) {
+                pr2serr(ME "bad argument to 'progress=', expect SEC[,FILE] "
+                        "with SEC > 0\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (cp && *cp) {
+                memcpy(prog_f, cp, INOUTF_SZ - 1);
+                prog_f[INOUTF_SZ - 1] = '\0';
+            }
+        } else if (0 == strcmp(key, "rate")) {
+            rate_bps = sg_get_llnum(buf);
+            if (rate_bps < 0) {
+                pr2serr(ME "bad argument to 'rate='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "rate_lat")) {
+            rate_lat_us = sg_get_llnum(buf);
+            if (rate_lat_us < 0) {
+                pr2serr(ME "bad argument to 'rate_lat='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "resume")) {
+            memcpy(rsm_f, buf, INOUTF_SZ - 1);
+            rsm_f[INOUTF_SZ - 1] = '\0';
         } else if (0 == strcmp(key, "retries")) {
             iflag.retries = sg_get_num(buf);
             oflag.retries = iflag.retries;
@@ -1652,6 +2978,18 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'retries='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "protect")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            iflag.protect = sg_get_num(buf);
+            oflag.protect = cp ? sg_get_num(cp) : 0;
+            if ((iflag.protect < 0) || (iflag.protect > 7) ||
+                (oflag.protect < 0) || (oflag.protect > 7)) {
+                pr2serr(ME "bad argument to 'protect=', expect RDP[,WRP] "
+                        "each 0 to 7\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
@@ -1666,8 +3004,36 @@ main(int argc, char * argv[])
             }
         } else if (0 == strcmp(key, "sync"))
             do_sync = !! sg_get_num(buf);
+        else if (0 == strcmp(key, "tape")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            tape_mb = sg_get_num(buf);
+            if (cp) {
+                np = strchr(cp, ',');
+                if (NULL == np) {
+                    pr2serr(ME "'tape=' expects MB or MB,HI,LO\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                *np++ = '\0';
+                tape_hi = sg_get_num(cp);
+                tape_lo = sg_get_num(np);
+            }
+            if ((tape_mb < 1) || (tape_mb > TAPE_MAX_MB) ||
+                (tape_hi < 1) || (tape_hi > 100) || (tape_lo < 0) ||
+                (tape_lo >= tape_hi)) {
+                pr2serr(ME "bad argument to 'tape=', expect MB[,HI,LO] "
+                        "with MB from 1 to %d and 0 <= LO < HI <= 100\n",
+                        TAPE_MAX_MB);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            iflag.tape = true;
+            oflag.tape = true;
+        }
         else if (0 == strcmp(key, "time"))
             do_time = !! sg_get_num(buf);
+        else if (0 == strcmp(key, "verify"))
+            do_verify = !! sg_get_num(buf);
         else if (0 == strncmp(key, "verb", 4))
             verbose = sg_get_num(buf);
         else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
@@ -1751,6 +3117,12 @@ main(int argc, char * argv[])
         pr2serr("skip and seek cannot be negative\n");
         return SG_LIB_CONTRADICT;
     }
+    if (rsm_f[0] && ((num_bufs > 1) || dgst_f[0] || out2f[0] ||
+                     oflag.append)) {
+        pr2serr("resume= does not work with bufs=, digest=, of2= or "
+                "oflag=append\n");
+        return SG_LIB_CONTRADICT;
+    }
     if (oflag.append && (seek > 0)) {
         pr2serr("Can't use both append and seek switches\n");
         return SG_LIB_CONTRADICT;
@@ -1761,6 +3133,14 @@ main(int argc, char * argv[])
     }
     if (iflag.sparse)
         pr2serr("sparse flag ignored for iflag\n");
+    if ((rate_lat_us > 0) && (0 == rate_bps) && (0 == rate_iops)) {
+        pr2serr(ME "rate_lat= needs rate= or iops=\n");
+        return SG_LIB_CONTRADICT;
+    }
+    rate_active = (rate_bps > 0) || (rate_iops > 0);
+    if (rate_active)
+        sg_pt_rate_init(&rate_lim, (uint64_t)rate_bps, (uint64_t)rate_iops,
+                        (uint64_t)rate_lat_us * 1000);
 
     /* defaulting transfer size to 128*2048 for CD/DVDs is too large
        for the block layer in lk 2.6 and results in an EIO on the
@@ -1781,26 +3161,63 @@ main(int argc, char * argv[])
     iflag.pdt = -1;
     oflag.pdt = -1;
     if (inf[0] && ('-' != inf[0])) {
-        infd = open_if(inf, skip, bpt, &iflag, &in_type, verbose);
+        infd = open_if(inf, skip, &iflag, &in_type, verbose);
         if (infd < 0)
             return -infd;
     }
 
     if (outf[0] && ('-' != outf[0])) {
-        outfd = open_of(outf, seek, bpt, &oflag, &out_type, verbose);
+        outfd = open_of(outf, seek, &oflag, &out_type, verbose);
         if (outfd < -1)
             return -outfd;
     }
-
-    if (out2f[0]) {
-        out2_type = dd_filetype(out2f);
-        if ((out2fd = open(out2f, O_WRONLY | O_CREAT, 0666)) < 0) {
-            res = errno;
-            snprintf(ebuff, EBUFF_SZ,
-                     ME "could not open %s for writing", out2f);
+    /* only the sessions of sg devices are asked for anything */
+    sg_ds_init(&in_ds, infd, (verbose > 0) ? verbose - 1 : 0);
+    sg_ds_init(&out_ds, outfd, (verbose > 0) ? verbose - 1 : 0);
+
+    if (bpt_auto) {
+        bpt = auto_bpt(infd, in_type, inf, outfd, out_type, outf,
+                       (blk_sz >= 2048) ? DEF_BLOCKS_PER_2048TRANSFER :
+                                          DEF_BLOCKS_PER_TRANSFER);
+        if (((FT_SG & in_type) && (6 == iflag.cdbsz)) ||
+            ((FT_SG & out_type) && (6 == oflag.cdbsz)))
+            bpt = (bpt > 256) ? 256 : bpt;
+        if (verbose)
+            pr2serr("bpt=auto: using bpt=%d (%d bytes per transfer)\n",
+                    bpt, bpt * blk_sz);
+    }
+    /* Now bpt is known, size the sg reserved buffers. Unless dio is used
+     * (then the reserved buffer is bypassed) or a tape record size would
+     * change, bpt is reduced to what the driver granted. */
+    if ((FT_SG & in_type) && (! (FT_BLOCK & in_type)))
+        sg_io_reserve(infd, blk_sz, &bpt, 1, ! (iflag.dio || tape_mb), ME,
+                      verbose);
+    if ((FT_SG & out_type) && (! (FT_BLOCK & out_type)))
+        sg_io_reserve(outfd, blk_sz, &bpt, 1, ! (oflag.dio || tape_mb), ME,
+                      verbose);
+
+    if (bmap_f[0]) {
+        if ((! (FT_SG & in_type)) || (0 == iflag.coe)) {
+            pr2serr("badmap= needs IFILE to be a sg device and coe= or "
+                    "iflag=coe\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (NULL == (badmap_fp = fopen(bmap_f, "w"))) {
+            snprintf(ebuff, EBUFF_SZ, ME "could not open %s for bad block "
+                     "map", bmap_f);
             perror(ebuff);
-            return res;
+            return SG_LIB_FILE_ERROR;
         }
+        fprintf(badmap_fp, "# sg_dd bad block map: if=%s bs=%d\n"
+                "# LBA,NUM of each range of blocks that could not be read\n",
+                inf, blk_sz);
+    }
+
+    if (out2f[0]) {
+        out2_type = sg_io_filetype(out2f, SG_IO_FT_WANT_FIFO, verbose);
+        out2fd = sg_io_open_dd(out2f, FT_OTHER, true, 0, 0, blk_sz, ME, 0);
+        if (out2fd < 0)
+            return sg_convert_errno(-out2fd);
     } else
         out2fd = -1;
 
@@ -1814,19 +3231,151 @@ main(int argc, char * argv[])
             pr2serr("oflag=sparse needs seekable output file\n");
             return SG_LIB_CONTRADICT;
         }
+        if (FT_SG & out_type)
+            probe_out_dealloc(&out_ds);
+    }
+    if (do_verify) {
+        if ('\0' == dgst_f[0]) {
+            pr2serr("verify=1 needs digest=MFILE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((STDOUT_FILENO == outfd) ||
+            ((FT_DEV_NULL | FT_FIFO) & out_type)) {
+            pr2serr("verify=1 needs an OFILE that can be read back\n");
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    if (engine &&
+        (res = choose_engine(engine, infd, in_type, outfd, out_type,
+                             bufs_given, dio_given, (rsm_f[0] || tape_mb ||
+                              iflag.protect || oflag.protect ||
+                              iflag.prefetch), &num_bufs)))
+        return res;
+    in_fds[0] = infd;
+    if (num_in_fds > 1) {
+        if ((! (FT_SG & in_type)) || iflag.excl || (ENGINE_SYNC == engine) ||
+            (bufs_given && (1 == num_bufs)) || rsm_f[0]) {
+            pr2serr("fds=%d needs a sg IFILE and does not work with "
+                    "iflag=excl, bufs=1,\nresume= nor engine=sync\n",
+                    num_in_fds);
+            return SG_LIB_CONTRADICT;
+        }
+        /* a slot for each helper to read into, and one being written */
+        if (num_bufs <= num_in_fds) {
+            if (bufs_given)
+                pr2serr("fds=%d: raising bufs=%d to %d\n", num_in_fds,
+                        num_bufs, num_in_fds + 1);
+            num_bufs = num_in_fds + 1;
+        }
+        for (k = 1; k < num_in_fds; ++k) {
+            in_fds[k] = open_if_again(inf, &iflag, !! (FT_BLOCK & in_type),
+                                      &bpt, verbose);
+            if (in_fds[k] < 0) {
+                while (--k > 0)
+                    close(in_fds[k]);
+                return SG_LIB_FILE_ERROR;
+            }
+        }
+        if (verbose)
+            pr2serr("fds=%d: %s opened %d times, a read ahead thread on "
+                    "each\n", num_in_fds, inf, num_in_fds);
+    }
+    tape_in = (FT_ST & in_type) ||
+              ((FT_SG & in_type) && (PDT_TAPE == iflag.pdt));
+    tape_out = (FT_ST & out_type) ||
+               ((FT_SG & out_type) && (PDT_TAPE == oflag.pdt));
+    if (tape_mb) {
+        if (tape_in == tape_out) {
+            pr2serr("tape= needs one (and only one) of IFILE and OFILE to "
+                    "be a tape\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((num_bufs > 1) || oflag.sparse || dgst_f[0] || do_verify ||
+            rsm_f[0] || iflag.prefetch || iflag.protect || oflag.protect ||
+            iflag.coe || do_sync || (tape_in && skip) ||
+            (tape_out && seek)) {
+            pr2serr("tape= does not work with bufs=, digest=, protect=, "
+                    "resume=, sync=,\nverify=, iflag=coe, iflag=prefetch, "
+                    "oflag=sparse, nor with skip= or seek=\non the tape\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((res = tape_chk_blk_lim(tape_in ? infd : outfd,
+                                    (FT_SG & (tape_in ? in_type : out_type)),
+                                    blk_sz * bpt)))
+            return res;
+        if (tape_in && (dd_count < 0))
+            dd_count = INT64_MAX;       /* up to the next filemark */
+    }
+    if (iflag.prefetch) {
+        if (! (FT_SG & in_type)) {
+            pr2serr("iflag=prefetch needs a sg IFILE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (num_bufs > 1) {
+            pr2serr("iflag=prefetch and bufs= are alternatives, use one or "
+                    "the other\n");
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    if (iflag.protect || oflag.protect) {
+        if ((iflag.protect && (! (FT_SG & in_type))) ||
+            (oflag.protect && (! (FT_SG & out_type)))) {
+            pr2serr("protect=RDP,WRP: RDP>0 needs a sg IFILE and WRP>0 a "
+                    "sg OFILE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((num_bufs > 1) || oflag.sparse || dgst_f[0] || iflag.coe) {
+            pr2serr("protect= does not work with bufs=, digest=, "
+                    "iflag=coe or oflag=sparse\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((iflag.protect && (6 == iflag.cdbsz)) ||
+            (oflag.protect && (6 == oflag.cdbsz))) {
+            pr2serr("protect= needs cdbsz=10, 12 or 16\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((iflag.protect &&
+             (res = read_pi_type(&in_ds, inf, &iflag.pi_type))) ||
+            (oflag.protect &&
+             (res = read_pi_type(&out_ds, outf, &oflag.pi_type))))
+            return res;
+        if ((iflag.protect && (0 == iflag.pi_type)) ||
+            (oflag.protect && (0 == oflag.pi_type))) {
+            pr2serr("protect= given but %s not formatted with protection "
+                    "information\n", (iflag.protect &&
+                    (0 == iflag.pi_type)) ? inf : outf);
+            return SG_LIB_CONTRADICT;
+        }
+        if ((2 == iflag.pi_type) || (2 == oflag.pi_type)) {
+            pr2serr("protect=: PI type 2 needs 32 byte cdbs, not "
+                    "supported\n");
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    in_bs = blk_sz + (iflag.protect ? SG_T10_PI_LEN : 0);
+    out_bs = blk_sz + (oflag.protect ? SG_T10_PI_LEN : 0);
+    if (dgst_f[0]) {
+        if (NULL == (dgst_fp = fopen(dgst_f, "w"))) {
+            snprintf(ebuff, EBUFF_SZ, ME "could not open %s for digests",
+                     dgst_f);
+            perror(ebuff);
+            return SG_LIB_FILE_ERROR;
+        }
+        fprintf(dgst_fp, "# sg_dd CRC32C digest manifest: of=%s bs=%d\n"
+                "# OFILE_lba blocks crc32c\n", outf, blk_sz);
     }
 
     if ((dd_count < 0) || ((verbose > 0) && (0 == dd_count))) {
         in_num_sect = -1;
         in_sect_sz = -1;
         if (FT_SG & in_type) {
-            res = scsi_read_capacity(infd, &in_num_sect, &in_sect_sz);
+            res = scsi_read_capacity(&in_ds, &in_num_sect, &in_sect_sz);
             if (SG_LIB_CAT_UNIT_ATTENTION == res) {
                 pr2serr("Unit attention (readcap in), continuing\n");
-                res = scsi_read_capacity(infd, &in_num_sect, &in_sect_sz);
+                res = scsi_read_capacity(&in_ds, &in_num_sect, &in_sect_sz);
             } else if (SG_LIB_CAT_ABORTED_COMMAND == res) {
                 pr2serr("Aborted command (readcap in), continuing\n");
-                res = scsi_read_capacity(infd, &in_num_sect, &in_sect_sz);
+                res = scsi_read_capacity(&in_ds, &in_num_sect, &in_sect_sz);
             }
             if (0 != res) {
                 if (res == SG_LIB_CAT_INVALID_OP)
@@ -1840,7 +3389,8 @@ main(int argc, char * argv[])
                 pr2serr(">> warning: logical block size on %s confusion: "
                         "bs=%d, device claims=%d\n", inf, blk_sz, in_sect_sz);
         } else if (FT_BLOCK & in_type) {
-            if (0 != read_blkdev_capacity(infd, &in_num_sect, &in_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(infd, &in_num_sect, &in_sect_sz,
+                                           verbose)) {
                 pr2serr("Unable to read block capacity on %s\n", inf);
                 in_num_sect = -1;
             }
@@ -1855,14 +3405,14 @@ main(int argc, char * argv[])
 
         out_num_sect = -1;
         out_sect_sz = -1;
-        if (FT_SG & out_type) {
-            res = scsi_read_capacity(outfd, &out_num_sect, &out_sect_sz);
+        if ((FT_SG & out_type) && (! tape_out)) {
+            res = scsi_read_capacity(&out_ds, &out_num_sect, &out_sect_sz);
             if (SG_LIB_CAT_UNIT_ATTENTION == res) {
                 pr2serr("Unit attention (readcap out), continuing\n");
-                res = scsi_read_capacity(outfd, &out_num_sect, &out_sect_sz);
+                res = scsi_read_capacity(&out_ds, &out_num_sect, &out_sect_sz);
             } else if (SG_LIB_CAT_ABORTED_COMMAND == res) {
                 pr2serr("Aborted command (readcap out), continuing\n");
-                res = scsi_read_capacity(outfd, &out_num_sect, &out_sect_sz);
+                res = scsi_read_capacity(&out_ds, &out_num_sect, &out_sect_sz);
             }
             if (0 != res) {
                 if (res == SG_LIB_CAT_INVALID_OP)
@@ -1875,8 +3425,8 @@ main(int argc, char * argv[])
                         "bs=%d, device claims=%d\n", outf, blk_sz,
                         out_sect_sz);
         } else if (FT_BLOCK & out_type) {
-            if (0 != read_blkdev_capacity(outfd, &out_num_sect,
-                                          &out_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(outfd, &out_num_sect,
+                                           &out_sect_sz, verbose)) {
                 pr2serr("Unable to read block capacity on %s\n", outf);
                 out_num_sect = -1;
             } else if (blk_sz != out_sect_sz) {
@@ -1923,20 +3473,15 @@ main(int argc, char * argv[])
         }
     }
 
-    if (iflag.dio || iflag.direct || oflag.direct || (FT_RAW & in_type) ||
-        (FT_RAW & out_type)) {  /* want heap buffer aligned to page_size */
-
-        wrkPos = sg_memalign(blk_sz * bpt, 0, &wrkBuff, false);
-        if (NULL == wrkPos) {
-            pr2serr("sg_memalign: error, out of memory?\n");
-            return sg_convert_errno(ENOMEM);
-        }
-    } else {
-        wrkPos = sg_memalign(blk_sz * bpt, 0, &wrkBuff, false);
-        if (0 == wrkPos) {
-            pr2serr("Not enough user memory\n");
-            return sg_convert_errno(ENOMEM);
-        }
+    /* page aligned, huge pages if large; with dio pin it once up front */
+    wrkPos = sg_hugebuf_get(((iflag.protect || oflag.protect) ?
+                             blk_sz + SG_T10_PI_LEN : blk_sz) * bpt,
+                            iflag.dio || iflag.direct ||
+                            oflag.direct || (FT_RAW & in_type) ||
+                            (FT_RAW & out_type), verbose > 3);
+    if (NULL == wrkPos) {
+        pr2serr("sg_hugebuf_get: error, out of memory?\n");
+        return sg_convert_errno(ENOMEM);
     }
 
     blocks_per = bpt;
@@ -1951,14 +3496,76 @@ main(int argc, char * argv[])
         start_tm_valid = true;
     }
     req_count = dd_count;
+    rsm_skip = skip;
+    rsm_seek = seek;
+    rsm_next = 0;
+    lat_table = sg_pt_lat_is_enabled();
 
     if (dry_run > 0) {
         pr2serr("Since --dry-run option given, bypassing copy\n");
         goto bypass_copy;
     }
+    if (rsm_f[0]) {
+        ret = resume_open(&rsm, rsm_f, skip, seek, dd_count, blk_sz, bpt);
+        if (ret)
+            goto bypass_copy;
+        if (rsm.done_at_start > 0)
+            pr2serr("resume: %" PRId64 " of %" PRId64 " chunks copied "
+                    "before, bypassing them\n", rsm.done_at_start,
+                    rsm.chunks);
+    }
+    if (progress_sec > 0) {
+        ret = sg_io_progress_open(&progress, "sg_dd", progress_sec, prog_f,
+                                  blk_sz, dd_count, ME);
+        if (ret)
+            goto bypass_copy;
+    }
+    if (num_bufs > 1) {
+        ret = rd_ahead_start(&rd_ahead, in_fds, num_in_fds,
+                             !! (FT_SG & in_type), skip,
+                             dd_count, blocks_per, num_bufs - 1,
+                             iflag.dio || iflag.direct || oflag.direct ||
+                             (FT_RAW & in_type) || (FT_RAW & out_type));
+        if (ret)
+            goto bypass_copy;
+    }
+    if (iflag.prefetch)
+        pf_ahead_init(&pf_ahead, skip, dd_count, blocks_per);
+    if (tape_mb) {
+        ret = tape_ring_start(&tape_ring, tape_in ? infd : outfd,
+                              !! (FT_SG & (tape_in ? in_type : out_type)),
+                              tape_out, blk_sz * bpt, tape_mb, tape_hi,
+                              tape_lo);
+        if (ret)
+            goto bypass_copy;
+    }
 
     /* <<< main loop that does the copy >>> */
     while (dd_count > 0) {
+        if (rsm.mp && (0 == ((skip - rsm_skip) % bpt)) &&
+            resume_is_done(&rsm, (skip - rsm_skip) / bpt)) {
+            off64_t offset;
+
+            blocks = (dd_count > bpt) ? bpt : dd_count;
+            offset = (off64_t)blocks * blk_sz;
+            if ((! (FT_SG & in_type)) &&
+                (lseek64(infd, offset, SEEK_CUR) < 0)) {
+                perror(ME "resume: lseek64 on input");
+                ret = SG_LIB_FILE_ERROR;
+                break;
+            }
+            if ((! ((FT_SG | FT_DEV_NULL) & out_type)) &&
+                (lseek64(outfd, offset, SEEK_CUR) < 0)) {
+                perror(ME "resume: lseek64 on output");
+                ret = SG_LIB_FILE_ERROR;
+                break;
+            }
+            resumed_num += blocks;
+            dd_count -= blocks;
+            skip += blocks;
+            seek += blocks;
+            continue;
+        }
         bytes_read = 0;
         bytes_of = 0;
         bytes_of2 = 0;
@@ -1966,9 +3573,38 @@ main(int argc, char * argv[])
         penult_blocks = penult_sparse_skip ? blocks : 0;
         sparse_skip = false;
         blocks = (dd_count > blocks_per) ? blocks_per : dd_count;
-        if (FT_SG & in_type) {
+        if (rate_active)
+            sg_pt_rate_sleep(sg_pt_rate_take(&rate_lim,
+                                             (uint64_t)blocks * blk_sz));
+        if ((FT_SG & in_type) && (! tape_in)) {
             dio_tmp = iflag.dio;
-            res = sg_read(infd, wrkPos, blocks, skip, blk_sz, &iflag,
+            rd_ahead_redo = false;
+            rasp = rd_ahead.active ? rd_ahead_get(&rd_ahead, skip) : NULL;
+            if (rasp && (blocks == rasp->blocks) && (0 == rasp->res) &&
+                (SG_LIB_CAT_CLEAN == sg_err_category3(&rasp->io_hdr)) &&
+                (0 == rasp->io_hdr.resid)) {
+                bp = rasp->bp;          /* swap buffers */
+                rasp->bp = wrkPos;
+                wrkPos = bp;
+                if (dio_tmp &&
+                    (! sg_io_dio_done(&rasp->io_hdr, ME, &dio_warned)))
+                    dio_tmp = false;
+                rd_ahead_put(&rd_ahead);
+                coe_count = 0;
+                blks_read = blocks;
+                res = 0;
+                goto rd_ahead_done;
+            }
+            if (rd_ahead.active) {
+                /* not read ahead or needs error processing, so read it */
+                rd_ahead_redo = true;
+                if (rasp)
+                    rd_ahead_put(&rd_ahead);
+            }
+            pf_ahead_issue(&pf_ahead, infd, skip, blocks);
+            lat_start = (rate_lim.target_ns || pf_ahead.active) ?
+                        sg_pt_lat_now_ns() : 0;
+            res = sg_read(infd, wrkPos, blocks, skip, in_bs, &iflag,
                           &dio_tmp, &blks_read);
             if (-2 == res) {     /* ENOMEM, find what's available+try that */
                 if (ioctl(infd, SG_GET_RESERVED_SIZE, &buf_sz) < 0) {
@@ -1978,15 +3614,23 @@ main(int argc, char * argv[])
                 }
                 if (buf_sz < MIN_RESERVED_SIZE)
                     buf_sz = MIN_RESERVED_SIZE;
-                blocks_per = (buf_sz + blk_sz - 1) / blk_sz;
+                blocks_per = (buf_sz + in_bs - 1) / in_bs;
                 if (blocks_per < blocks) {
                     blocks = blocks_per;
                     pr2serr("Reducing read to %d blocks per loop\n",
                             blocks_per);
-                    res = sg_read(infd, wrkPos, blocks, skip, blk_sz,
+                    res = sg_read(infd, wrkPos, blocks, skip, in_bs,
                                   &iflag, &dio_tmp, &blks_read);
                 }
             }
+            if (lat_start) {
+                uint64_t lat_ns = sg_pt_lat_now_ns() - lat_start;
+
+                if (rate_lim.target_ns)
+                    sg_pt_rate_update(&rate_lim, lat_ns);
+                pf_ahead_lat(&pf_ahead, lat_ns);
+            }
+rd_ahead_done:
             if (res) {
                 pr2serr("sg_read failed,%s at or after lba=%" PRId64 " [0x%"
                         PRIx64 "]\n", ((-2 == res) ?
@@ -2001,11 +3645,30 @@ main(int argc, char * argv[])
                 in_full += blocks;
                 if (iflag.dio && (! dio_tmp))
                     dio_incomplete_count++;
+                if (rd_ahead_redo && (dd_count > blocks))
+                    rd_ahead_restart(&rd_ahead, skip + blocks,
+                                     dd_count - blocks, blocks_per);
             }
         } else {
-            while (((res = read(infd, wrkPos, blocks * blk_sz)) < 0) &&
-                   ((EINTR == errno) || (EAGAIN == errno)))
-                ;
+            rasp = rd_ahead.active ? rd_ahead_get(&rd_ahead, skip) : NULL;
+            if (rasp) {
+                bp = rasp->bp;          /* swap buffers */
+                rasp->bp = wrkPos;
+                wrkPos = bp;
+                res = rasp->res;
+                errno = rasp->err;
+                rd_ahead_put(&rd_ahead);
+            } else if (tape_in) {
+                res = tape_ring_get(&tape_ring, wrkPos, blocks * blk_sz);
+                if (res < 0) {
+                    pr2serr("tape read failed, after %" PRId64 " records\n",
+                            tape_ring.recs);
+                    ret = tape_ring.res;
+                    break;
+                }
+            } else {
+                res = sg_io_read_retry(infd, wrkPos, blocks * blk_sz);
+            }
             if (verbose > 2)
                 pr2serr("read(unix): count=%d, res=%d\n", blocks * blk_sz,
                         res);
@@ -2029,13 +3692,14 @@ main(int argc, char * argv[])
 
         if (0 == blocks)
             break;      /* nothing read so leave loop */
+        if ((iflag.protect || oflag.protect) &&
+            (ret = pi_process(wrkPos, blocks, skip, seek)))
+            break;
 
         if (out2f[0]) {
-            while (((res = write(out2fd, wrkPos, blocks * blk_sz)) < 0) &&
-                   ((EINTR == errno) || (EAGAIN == errno)))
-                ;
+            res = sg_io_write_retry(out2fd, wrkPos, blocks * out_bs);
             if (verbose > 2)
-                pr2serr("write to of2: count=%d, res=%d\n", blocks * blk_sz,
+                pr2serr("write to of2: count=%d, res=%d\n", blocks * out_bs,
                         res);
             if (res < 0) {
                 snprintf(ebuff, EBUFF_SZ, ME "writing to of2, seek=%" PRId64
@@ -2048,8 +3712,8 @@ main(int argc, char * argv[])
             out2_off += res;
         }
 
-        if (oflag.sparse && (dd_count > blocks) &&
-            (! (FT_DEV_NULL & out_type))) {
+        zlead = 0;
+        if (oflag.sparse && (! (FT_DEV_NULL & out_type))) {
             if (NULL == zeros_buff) {
                 zeros_buff = sg_memalign(blocks * blk_sz, 0, &free_zeros_buff,
                                          false);
@@ -2059,45 +3723,56 @@ main(int argc, char * argv[])
                     break;
                 }
             }
-            if (0 == memcmp(wrkPos, zeros_buff, blocks * blk_sz))
-                sparse_skip = true;
+            /* block granular: zero blocks ahead of the first holding data
+             * are bypassed, a chunk of zeros (but not the last) in full */
+            zlead = sg_first_non_zero_blk(wrkPos, out_bs, blocks);
+            if (zlead >= blocks) {
+                if (dd_count > blocks)
+                    sparse_skip = true;
+                zlead = 0;
+            } else if (zlead > 0) {
+                res = sparse_bypass(outfd, out_type, seek, zlead);
+                if (res > 1) {
+                    ret = res;
+                    break;
+                } else if (res)
+                    zlead = 0;  /* so they are written */
+                else {
+                    seek += zlead;
+                    blocks -= zlead;
+                }
+            }
         }
         if (sparse_skip) {
-            if (FT_SG & out_type) {
-                out_sparse_num += blocks;
-                if (verbose > 2)
-                    pr2serr("sparse bypassing sg_write: seek blk=%" PRId64
-                            ", offset blks=%d\n", seek, blocks);
-            } else if (FT_DEV_NULL & out_type)
-                ;
-            else {
-                off64_t offset = blocks * blk_sz;
-                off64_t off_res;
-
-                if (verbose > 2)
-                    pr2serr("sparse bypassing write: seek=%" PRId64 ", rel "
-                            "offset=%" PRId64 "\n", (seek * blk_sz),
-                            (int64_t)offset);
-                off_res = lseek64(outfd, offset, SEEK_CUR);
-                if (off_res < 0) {
-                    pr2serr("sparse tried to bypass write: seek=%" PRId64
-                            ", rel offset=%" PRId64 " but ...\n",
-                            (seek * blk_sz), (int64_t)offset);
-                    perror("lseek64 on output");
-                    ret = SG_LIB_FILE_ERROR;
-                    break;
-                } else if (verbose > 4)
-                    pr2serr("oflag=sparse lseek64 result=%" PRId64 "\n",
-                            (int64_t)off_res);
-                out_sparse_num += blocks;
+            res = sparse_bypass(outfd, out_type, seek, blocks);
+            if (res > 1) {
+                ret = res;
+                break;
+            } else if (res)
+                sparse_skip = false;    /* so chunk of zeros is written */
+        }
+        wrp = wrkPos + (zlead * out_bs);
+        if (sparse_skip)
+            ;   /* bypassed above */
+        else if (tape_out) {
+            ret = tape_ring_put(&tape_ring, wrkPos, blocks * blk_sz);
+            if (ret) {
+                pr2serr("tape write failed, after %" PRId64 " records\n",
+                        tape_ring.recs);
+                break;
             }
+            out_full += blocks;
         } else if (FT_SG & out_type) {
             dio_tmp = oflag.dio;
             retries_tmp = oflag.retries;
             first = true;
             while (1) {
-                ret = sg_write(outfd, wrkPos, blocks, seek, blk_sz,
+                lat_start = rate_lim.target_ns ? sg_pt_lat_now_ns() : 0;
+                ret = sg_write(outfd, wrp, blocks, seek, out_bs,
                                &oflag, &dio_tmp);
+                if (lat_start)
+                    sg_pt_rate_update(&rate_lim,
+                                      sg_pt_lat_now_ns() - lat_start);
                 if (0 == ret)
                     break;
                 if ((SG_LIB_CAT_NOT_READY == ret) ||
@@ -2111,7 +3786,7 @@ main(int argc, char * argv[])
                     }
                     if (buf_sz < MIN_RESERVED_SIZE)
                         buf_sz = MIN_RESERVED_SIZE;
-                    blocks_per = (buf_sz + blk_sz - 1) / blk_sz;
+                    blocks_per = (buf_sz + out_bs - 1) / out_bs;
                     if (blocks_per < blocks) {
                         blocks = blocks_per;
                         pr2serr("Reducing write to %d blocks per loop\n",
@@ -2157,9 +3832,7 @@ main(int argc, char * argv[])
         } else if (FT_DEV_NULL & out_type)
             out_full += blocks; /* act as if written out without error */
         else {
-            while (((res = write(outfd, wrkPos, blocks * blk_sz)) < 0) &&
-                   ((EINTR == errno) || (EAGAIN == errno)))
-                ;
+            res = sg_io_write_retry(outfd, wrp, blocks * blk_sz);
             if (verbose > 2)
                 pr2serr("write(unix): count=%d, res=%d\n", blocks * blk_sz,
                         res);
@@ -2213,11 +3886,32 @@ main(int argc, char * argv[])
             }
         }
 #endif
+        if (dgst_fp)    /* while the chunk is still in the CPU cache */
+            fprintf(dgst_fp, "%" PRId64 " %d 0x%08x\n", seek, blocks,
+                    sg_crc32c(0, wrp, blocks * blk_sz));
         if (dd_count > 0)
-            dd_count -= blocks;
-        skip += blocks;
+            dd_count -= blocks + zlead;
+        skip += blocks + zlead;
         seek += blocks;
+        if (rsm.mp) {   /* mark the chunks now written in full */
+            while ((rsm_next < rsm.chunks) &&
+                   ((((rsm_next + 1) * bpt) <= (seek - rsm_seek)) ||
+                    ((seek - rsm_seek) >= req_count)))
+                resume_set_done(&rsm, rsm_next++);
+        }
+        progress_out(false, infd, in_type, outfd, out_type);
     } /* end of main loop that does the copy ... */
+    rd_ahead_fini(&rd_ahead);
+    if (tape_mb) {
+        res = tape_ring_fini(&tape_ring, 0 != ret);
+        if (res && (0 == ret)) {
+            pr2serr("tape %s failed, after %" PRId64 " records\n",
+                    tape_out ? "write" : "read", tape_ring.recs);
+            ret = res;
+        }
+        if (tape_out)   /* only what reached the tape */
+            out_full = tape_ring.bytes / blk_sz;
+    }
 
     if (ret && penult_sparse_skip && (penult_blocks > 0)) {
         /* if error and skipped last output due to sparse ... */
@@ -2225,9 +3919,8 @@ main(int argc, char * argv[])
             ;
         else {
             /* ... try writing to extend ofile to length prior to error */
-            while (((res = write(outfd, zeros_buff, penult_blocks * blk_sz))
-                    < 0) && ((EINTR == errno) || (EAGAIN == errno)))
-                ;
+            res = sg_io_write_retry(outfd, zeros_buff,
+                                    penult_blocks * blk_sz);
             if (verbose > 2)
                 pr2serr("write(unix, sparse after error): count=%d, res=%d\n",
                         penult_blocks * blk_sz, res);
@@ -2256,12 +3949,47 @@ main(int argc, char * argv[])
 bypass_copy:
     if (do_time)
         calc_duration_throughput(false);
+    if (resume_close(&rsm) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
+    badmap_add(0, 0, true);
+    if (badmap_fp && fclose(badmap_fp)) {
+        perror(ME "closing bad block map");
+        if (0 == ret)
+            ret = SG_LIB_FILE_ERROR;
+    }
+    if (dgst_fp && fclose(dgst_fp)) {
+        perror(ME "closing digest manifest");
+        if (0 == ret)
+            ret = SG_LIB_FILE_ERROR;
+    }
+    if (do_verify && (0 == dry_run) && (0 == ret) && (0 == dd_count)) {
+        int vfd = outfd;
+
+        if (! (FT_SG & out_type)) {
+            /* try to bypass the page cache of block devices */
+            t = (oflag.direct || (FT_BLOCK & out_type)) ? O_DIRECT : 0;
+            if ((vfd = open(outf, O_RDONLY | t)) < 0) {
+                snprintf(ebuff, EBUFF_SZ, ME "could not open %s to verify",
+                         outf);
+                perror(ebuff);
+                ret = SG_LIB_FILE_ERROR;
+            }
+        }
+        if (vfd >= 0) {
+            ret = verify_digests(dgst_f, vfd, out_type, wrkPos, bpt, &oflag);
+            if (vfd != outfd)
+                close(vfd);
+        }
+    }
 
-    free(wrkBuff);
+    sg_hugebuf_put(wrkPos);
+    sg_hugebuf_pool_free();
     if (free_zeros_buff)
         free(free_zeros_buff);
     if (STDIN_FILENO != infd)
         close(infd);
+    for (k = 1; k < num_in_fds; ++k)
+        close(in_fds[k]);
     if (! ((STDOUT_FILENO == outfd) || (FT_DEV_NULL & out_type)))
         close(outfd);
     if (dry_run > 0)
@@ -2273,20 +4001,24 @@ bypass_copy:
             ret = SG_LIB_CAT_OTHER;
     }
     print_stats("");
-    if (dio_incomplete_count) {
-        int fd;
-        char c;
+    progress_out(true, infd, in_type, outfd, out_type);
+    sg_io_progress_close(&progress);
+    if (lat_table) {
+        char b[4096];
 
+        sg_pt_lat_report(sizeof(b), b);
+        pr2serr("%s", b);
+    }
+    if (iflag.prefetch && verbose)
+        pr2serr("iflag=prefetch: %" PRId64 " PRE-FETCH(16)s: %" PRId64
+                " condition met, %" PRId64 " good, %" PRId64 " errors; %"
+                PRId64 " slow reads, final distance %d chunks\n",
+                pf_ahead.cmds, pf_ahead.cond_met, pf_ahead.good,
+                pf_ahead.errs, pf_ahead.misses, pf_ahead.dist);
+    if (dio_incomplete_count) {
         pr2serr(">> Direct IO requested but incomplete %d times\n",
                 dio_incomplete_count);
-        if ((fd = open(proc_allow_dio, O_RDONLY)) >= 0) {
-            if (1 == read(fd, &c, 1)) {
-                if ('0' == c)
-                    pr2serr(">>> %s set to '0' but should be set to '1' for "
-                            "direct IO\n", proc_allow_dio);
-            }
-            close(fd);
-        }
+        sg_io_dio_warn();
     }
     if (sum_of_resids)
         pr2serr(">> Non-zero sum of residual counts=%d\n", sum_of_resids);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2010-2019 Douglas Gilbert.
+ * Copyright (c) 2010-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -30,13 +30,14 @@
 #include "sg_unaligned.h"
 
 
-static const char * version_str = "1.21 20190602";
+static const char * version_str = "1.22 20261014";
 
 #define MAX_SENSE_LEN 1024 /* max descriptor format actually: 255+8 */
 
 static struct option long_options[] = {
     {"binary", required_argument, 0, 'b'},
     {"cdb", no_argument, 0, 'c'},
+    {"count", no_argument, 0, 'C'},
     {"err", required_argument, 0, 'e'},
     {"exit-status", required_argument, 0, 'e'},
     {"exit_status", required_argument, 0, 'e'},
@@ -44,7 +45,9 @@ static struct option long_options[] = {
     {"help", no_argument, 0, 'h'},
     {"hex", no_argument, 0, 'H'},
     {"nospace", no_argument, 0, 'n'},
+    {"reclen", required_argument, 0, 'r'},
     {"status", required_argument, 0, 's'},
+    {"stream", no_argument, 0, 'S'},
     {"verbose", no_argument, 0, 'v'},
     {"version", no_argument, 0, 'V'},
     {"write", required_argument, 0, 'w'},
@@ -54,16 +57,19 @@ static struct option long_options[] = {
 struct opts_t {
     bool do_binary;
     bool do_cdb;
+    bool do_count;
     bool do_help;
     bool do_hex;
     bool no_space;
     bool do_status;
+    bool do_stream;
     bool verbose_given;
     bool version_given;
     bool err_given;
     bool file_given;
     const char * fname;
     int es_val;
+    int rec_len;        /* --stream --binary= fixed record length */
     int sense_len;
     int sstatus;
     int verbose;
@@ -83,6 +89,9 @@ usage()
           "                       [--help] [--hex] [--nospace] [--status=SS] "
           "[--verbose]\n"
           "                       [--version] [--write=WFN] H1 H2 H3 ...\n"
+          "       sg_decode_sense --stream [--binary=BFN] [--count] "
+          "[--file=HFN]\n"
+          "                       [--reclen=RL] [--verbose]\n"
           "  where:\n"
           "    --binary=BFN|-b BFN    BFN is a file name to read sense "
           "data in\n"
@@ -90,6 +99,9 @@ usage()
           "from stdin\n"
           "    --cdb|-c              decode given hex as cdb rather than "
           "sense data\n"
+          "    --count|-C            with --stream: tally records by sense "
+          "key, ASC\n"
+          "                          and ASCQ, print counts at the end\n"
           "    --err=ES|-e ES        ES is Exit Status from utility in this "
           "package\n"
           "    --file=HFN|-f HFN     HFN is a file name from which to read "
@@ -104,7 +116,14 @@ usage()
           "    --nospace|-n          no spaces or other separators between "
           "pairs of\n"
           "                          hex digits (e.g. '3132330A')\n"
+          "    --reclen=RL|-r RL     with --stream --binary=BFN: fixed "
+          "record length\n"
+          "                          (def: from additional sense length)\n"
           "    --status=SS |-s SS    SCSI status value in hex\n"
+          "    --stream|-S           decode many sense buffers from stdin "
+          "(or BFN,\n"
+          "                          HFN), one per line if hex, one line "
+          "out each\n"
           "    --verbose|-v          increase verbosity\n"
           "    --version|-V          print version string then exit\n"
           "    --write=WFN |-w WFN    write sense data in binary to WFN, "
@@ -129,7 +148,8 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
     char *endptr;
 
     while (1) {
-        c = getopt_long(argc, argv, "b:ce:f:hHns:vVw:", long_options, NULL);
+        c = getopt_long(argc, argv, "b:cCe:f:hHnr:s:SvVw:", long_options,
+                        NULL);
         if (c == -1)
             break;
 
@@ -146,6 +166,9 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
         case 'c':
             op->do_cdb = true;
             break;
+        case 'C':
+            op->do_count = true;
+            break;
         case 'e':
             n = sg_get_num(optarg);
             if ((n < 0) || (n > 255)) {
@@ -174,6 +197,14 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
         case 'n':
             op->no_space = true;
             break;
+        case 'r':
+            n = sg_get_num(optarg);
+            if ((n < 8) || (n > MAX_SENSE_LEN)) {
+                pr2serr("--reclen= expects 8 to %d\n", MAX_SENSE_LEN);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->rec_len = n;
+            break;
         case 's':
             if (1 != sscanf(optarg, "%x", &ui)) {
                 pr2serr("'--status=SS' expects a byte value\n");
@@ -186,6 +217,9 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
             op->do_status = true;
             op->sstatus = ui;
             break;
+        case 'S':
+            op->do_stream = true;
+            break;
         case 'v':
             op->verbose_given = true;
             ++op->verbose;
@@ -202,6 +236,23 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
     }
     if (op->err_given)
         goto the_end;
+    if (op->do_stream) {
+        if (optind < argc) {
+            pr2serr("with --stream sense data is read from stdin or a "
+                    "file, not given\nhere: %s\n", argv[optind]);
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->do_cdb || op->wfname || op->no_space) {
+            pr2serr("--stream does not apply to --cdb, --nospace or "
+                    "--write=\n");
+            return SG_LIB_CONTRADICT;
+        }
+        goto the_end;
+    }
+    if (op->do_count || op->rec_len) {
+        pr2serr("--count and --reclen= need --stream\n");
+        return SG_LIB_CONTRADICT;
+    }
 
     while (optind < argc) {
         avp = argv[optind++];
@@ -278,6 +329,271 @@ write2wfn(FILE * fp, struct opts_t * op)
     }
 }
 
+/* Number of sense key, ASC, ASCQ combinations counted by --count */
+#define STREAM_NUM_KEYS (16 * 256 * 256)
+#define STREAM_LINE_LEN 4096
+#define STREAM_BUFF_LEN (1024 * 1024)
+
+struct stream_tally_t {
+    uint32_t key;       /* (sense_key << 16) | (asc << 8) | ascq */
+    uint64_t count;
+};
+
+static int
+hex_val(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Fills sense buffer from an ASCII hex line. Pairs of hex digits may be
+ * separated by spaces, tabs or commas, or run together; a leading "0x" on
+ * each group is ignored and '#' starts a comment. Returns the number of
+ * bytes decoded (0 for a blank line) or -1 if the line is malformed. */
+static int
+stream_hex_line(const char * lp, uint8_t * sense, int max_len)
+{
+    int hi, lo;
+    int len = 0;
+
+    while (true) {
+        while ((' ' == *lp) || ('\t' == *lp) || (',' == *lp))
+            ++lp;
+        if (('\0' == *lp) || ('#' == *lp) || ('\n' == *lp) ||
+            ('\r' == *lp))
+            return len;
+        if (('0' == lp[0]) && (('x' == lp[1]) || ('X' == lp[1])))
+            lp += 2;
+        do {
+            hi = hex_val(lp[0]);
+            lo = (hi < 0) ? -1 : hex_val(lp[1]);
+            if ((lo < 0) || (len >= max_len))
+                return -1;
+            sense[len++] = (uint8_t)((hi << 4) | lo);
+            lp += 2;
+        } while (isxdigit((uint8_t)*lp));
+    }
+}
+
+/* Reads the next binary record with sg_f2hex_next(), so a regular file is
+ * memory mapped rather than copied through stdio. Without --reclen each
+ * record is self delimiting: the additional sense length in byte 7 (or 0
+ * for a response code other than 0x70 to 0x73) plus 8. Returns the record
+ * length, 0 at end of input or -1 for a short or malformed record. On a
+ * read error returns -1 with the error code in *errp. */
+static int
+stream_bin_rec(struct sg_f2hex_strm * fhp, const struct opts_t * op,
+               uint8_t * sense, int * errp)
+{
+    int n, len;
+
+    if (op->rec_len > 0) {
+        if ((*errp = sg_f2hex_next(fhp, sense, op->rec_len, &n)))
+            return -1;
+        if (0 == n)
+            return 0;
+        return (n < op->rec_len) ? -1 : n;
+    }
+    if ((*errp = sg_f2hex_next(fhp, sense, 8, &n)))
+        return -1;
+    if (0 == n)
+        return 0;
+    if ((n < 8) || ((sense[0] & 0x7c) != 0x70))
+        return -1;
+    len = 8 + sense[7];
+    if (len > 8) {
+        if ((*errp = sg_f2hex_next(fhp, sense + 8, len - 8, &n)))
+            return -1;
+        if (n < len - 8)
+            return -1;
+    }
+    return len;
+}
+
+/* Returns the ASC/ASCQ text without its "Additional sense: " prefix */
+static const char *
+stream_asc_str(int asc, int ascq, int blen, char * b)
+{
+    static const char * const pre = "Additional sense: ";
+    static const int pre_len = 18;
+
+    sg_get_asc_ascq_str(asc, ascq, blen, b);
+    return (0 == strncmp(b, pre, pre_len)) ? (b + pre_len) : b;
+}
+
+/* Writes one compact line for the sense buffer that was record number
+ * rec_num, using the fields already decoded into *sip. */
+static void
+stream_line(uint64_t rec_num, const struct sg_scsi_sense_info * sip)
+{
+    char k[48];
+    char a[96];
+
+    sg_get_sense_key_str(sip->sense_key, sizeof(k), k);
+    printf("%" PRIu64 ": rc=%02x sk=%x asc=%02x ascq=%02x", rec_num,
+           sip->response_code, sip->sense_key, sip->asc, sip->ascq);
+    if (sip->info_present && sip->info_valid)
+        printf(" info=0x%" PRIx64, sip->info);
+    if (sip->sksv)
+        printf(" sks=%02x%02x%02x", sip->sks[0], sip->sks[1], sip->sks[2]);
+    if (sip->progress_present)
+        printf(" progress=%d%%", (sip->progress * 100) / 65536);
+    printf(" %s: %s\n", k,
+           stream_asc_str(sip->asc, sip->ascq, sizeof(a), a));
+}
+
+static int
+stream_tally_cmp(const void * l, const void * r)
+{
+    const struct stream_tally_t * lp = (const struct stream_tally_t *)l;
+    const struct stream_tally_t * rp = (const struct stream_tally_t *)r;
+
+    if (lp->count != rp->count)
+        return (lp->count > rp->count) ? -1 : 1;
+    return (lp->key < rp->key) ? -1 : (lp->key > rp->key);
+}
+
+/* Prints the non-zero counts, most frequent first */
+static int
+stream_report(const uint64_t * counts, uint64_t recs, uint64_t bad)
+{
+    int k, n;
+    struct stream_tally_t * tp;
+    char s[48];
+    char a[96];
+
+    for (k = 0, n = 0; k < STREAM_NUM_KEYS; ++k) {
+        if (counts[k])
+            ++n;
+    }
+    tp = (struct stream_tally_t *)calloc(n + 1, sizeof(*tp));
+    if (NULL == tp) {
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, n = 0; k < STREAM_NUM_KEYS; ++k) {
+        if (counts[k]) {
+            tp[n].key = k;
+            tp[n++].count = counts[k];
+        }
+    }
+    qsort(tp, n, sizeof(*tp), stream_tally_cmp);
+    printf("%12s  sk  asc ascq\n", "count");
+    for (k = 0; k < n; ++k) {
+        sg_get_sense_key_str((tp[k].key >> 16) & 0xf, sizeof(s), s);
+        printf("%12" PRIu64 "   %x   %02x   %02x  %s: %s\n", tp[k].count,
+               (tp[k].key >> 16) & 0xf, (tp[k].key >> 8) & 0xff,
+               tp[k].key & 0xff, s,
+               stream_asc_str((tp[k].key >> 8) & 0xff, tp[k].key & 0xff,
+                              sizeof(a), a));
+    }
+    printf("%" PRIu64 " record%s, %d distinct, %" PRIu64 " malformed\n",
+           recs, (1 == recs) ? "" : "s", n, bad);
+    free(tp);
+    return 0;
+}
+
+/* Decodes a stream of sense buffers from stdin or op->fname: ASCII hex,
+ * one record per line, or binary with --binary=BFN. Each record gets a
+ * compact line on stdout, or with --count the records are tallied by
+ * sense key, ASC and ASCQ and only the totals are printed. */
+static int
+stream_sense(const struct opts_t * op)
+{
+    int err, len;
+    int ret = 0;
+    uint64_t recs = 0;
+    uint64_t bad = 0;
+    uint64_t * counts = NULL;
+    FILE * fp = NULL;
+    struct sg_f2hex_strm * fhp = NULL;
+    struct sg_scsi_sense_info si;
+    uint8_t sense[MAX_SENSE_LEN + 4];
+    char line[STREAM_LINE_LEN];
+
+    if (op->do_binary) {
+        fhp = sg_f2hex_open(op->fname ? op->fname : "-", true, false, &err);
+        if (NULL == fhp)
+            return err;
+    } else if ((NULL == op->fname) || (0 == strcmp(op->fname, "-")))
+        fp = stdin;
+    else if (NULL == (fp = fopen(op->fname, "r"))) {
+        err = errno;
+        pr2serr("unable to open file: %s: %s\n", op->fname,
+                safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    if (fp)
+        setvbuf(fp, NULL, _IOFBF, STREAM_BUFF_LEN);
+    if (op->do_count) {
+        counts = (uint64_t *)calloc(STREAM_NUM_KEYS, sizeof(uint64_t));
+        if (NULL == counts) {
+            pr2serr("%s: out of memory\n", __func__);
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    } else
+        setvbuf(stdout, NULL, _IOFBF, STREAM_BUFF_LEN);
+    while (true) {
+        if (op->do_binary) {
+            len = stream_bin_rec(fhp, op, sense, &err);
+            if (0 == len)
+                break;
+            if (err) {
+                ret = err;
+                break;
+            }
+        } else {
+            if (NULL == fgets(line, sizeof(line), fp))
+                break;
+            len = stream_hex_line(line, sense, MAX_SENSE_LEN);
+            if (0 == len)
+                continue;       /* blank or comment line */
+        }
+        ++recs;
+        if ((len < 0) || (! sg_scsi_decode_sense(sense, len, &si))) {
+            ++bad;
+            if (op->verbose)
+                pr2serr("record %" PRIu64 ": malformed\n", recs);
+            if (! op->do_count)
+                printf("%" PRIu64 ": malformed\n", recs);
+            if (op->do_binary && (len < 0))
+                break;          /* lost the record boundaries */
+            continue;
+        }
+        if (counts)
+            ++counts[(si.sense_key << 16) | (si.asc << 8) | si.ascq];
+        else
+            stream_line(recs, &si);
+    }
+    if (fp && ferror(fp)) {
+        err = errno;
+        pr2serr("error reading %s: %s\n", op->fname ? op->fname : "stdin",
+                safe_strerror(err));
+        ret = sg_convert_errno(err);
+    }
+    if (counts) {
+        err = stream_report(counts, recs, bad);
+        if (err)
+            ret = err;
+    }
+    else if (op->verbose)
+        pr2serr("%" PRIu64 " records, %" PRIu64 " malformed\n", recs, bad);
+fini:
+    if (counts)
+        free(counts);
+    if (fhp)
+        sg_f2hex_close(fhp);
+    else if (fp != stdin)
+        fclose(fp);
+    return ret;
+}
+
 
 int
 main(int argc, char *argv[])
@@ -285,7 +601,6 @@ main(int argc, char *argv[])
     int k, err;
     int ret = 0;
     unsigned int ui;
-    size_t s;
     struct opts_t * op;
     FILE * fp = NULL;
     const char * cp;
@@ -338,6 +653,9 @@ main(int argc, char *argv[])
         goto fini;
     }
 
+    if (op->do_stream)
+        return stream_sense(op);
+
     if (op->do_status) {
         sg_get_scsi_status_str(op->sstatus, sizeof(b) - 1, b);
         printf("SCSI status: %s\n", b);
@@ -375,20 +693,19 @@ main(int argc, char *argv[])
     }
 
     if (op->do_binary) {
-        fp = fopen(op->fname, "r");
-        if (NULL == fp) {
-            err = errno;
-            pr2serr("unable to open file: %s: %s\n", op->fname,
-                    safe_strerror(err));
-            return sg_convert_errno(err);
-        }
-        s = fread(op->sense, 1, MAX_SENSE_LEN, fp);
-        fclose(fp);
-        if (0 == s) {
+        struct sg_f2hex_strm * fhp = sg_f2hex_open(op->fname, true, false,
+                                                   &err);
+
+        if (NULL == fhp)
+            return err;
+        ret = sg_f2hex_next(fhp, op->sense, MAX_SENSE_LEN, &op->sense_len);
+        sg_f2hex_close(fhp);
+        if (ret)
+            return ret;
+        if (0 == op->sense_len) {
             pr2serr("read nothing from file: %s\n", op->fname);
             return SG_LIB_SYNTAX_ERROR;
         }
-        op->sense_len = s;
     } else if (op->file_given) {
         ret = sg_f2hex_arr(op->fname, false, op->no_space, op->sense,
                            &op->sense_len, MAX_SENSE_LEN);
@@ -22,6 +22,8 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -31,17 +33,51 @@
 #endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
+#include "sg_cmds_extra.h"
+#include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "0.23 20180219";
+static const char * version_str = "0.24 20261014";
 
 static int debug = 0;
 
 #define TRESPASS_PAGE           0x22
+#define VPD_DEVICE_ID           0x83
+#define DEF_JOBS                16
+#define MAX_JOBS                256
+#define DI_BUFF_LEN             512
+#define RTPG_BUFF_LEN           1024
+#define TPGS_STATE_OPTIMIZED    0x0
+#define TPGS_STATE_TRANSITIONING 0xf
+#define MAX_TRANS_POLLS         10      /* once a second while transitioning */
 
+struct tres_dev_t {     /* for each DEVICE when more than one is given */
+        const char * name;
+        int res;        /* of open or trespass */
+        int vres;       /* of fetching the new state, -1: no ALUA info */
+        int tpg;        /* target port group of this path, -1: unknown */
+        int state;      /* its asymmetric access state, -1: unknown */
+};
+
+struct tres_coll_t {
+        bool hr;
+        bool short_cmd;
+        int num;
+        int next_ind;   /* next element of arr to trespass, atomic */
+        struct tres_dev_t * arr;
+};
+
+static const char * tpgs_state_arr[] = {
+        "active/optimized", "active/non optimized", "standby",
+        "unavailable", "reserved [4]", "reserved [5]", "reserved [6]",
+        "reserved [7]", "reserved [8]", "reserved [9]", "reserved [10]",
+        "reserved [11]", "reserved [12]", "reserved [13]", "offline",
+        "transitioning"};
+
+/* Messages are prefixed by pfx (e.g. the DEVICE name) */
 static int
-do_trespass(int fd, bool hr, bool short_cmd)
+do_trespass(int fd, bool hr, bool short_cmd, const char * pfx)
 {
         uint8_t long_trespass_pg[] =
                 { 0, 0, 0, 0, 0, 0, 0, 0x00,
@@ -79,43 +115,214 @@ do_trespass(int fd, bool hr, bool short_cmd)
         switch (res) {
         case 0:
                 if (debug)
-                        pr2serr("%s trespass successful\n",
+                        pr2serr("%s%s trespass successful\n", pfx,
                                 short_cmd ? "short" : "long");
                 break;
         case SG_LIB_CAT_INVALID_OP:
         case SG_LIB_CAT_ILLEGAL_REQ:
-                pr2serr("%s form trepass page failed, try again %s '-s' "
-                        "option\n", short_cmd ? "short" : "long",
+                pr2serr("%s%s form trepass page failed, try again %s '-s' "
+                        "option\n", pfx, short_cmd ? "short" : "long",
                         short_cmd ? "without" : "with");
                 break;
         case SG_LIB_CAT_NOT_READY:
-                pr2serr("device not ready\n");
+                pr2serr("%sdevice not ready\n", pfx);
                 break;
         case SG_LIB_CAT_UNIT_ATTENTION:
-                pr2serr("unit attention\n");
+                pr2serr("%sunit attention\n", pfx);
                 break;
         default:
                 sg_get_category_sense_str(res, sizeof(b), b, debug);
-                pr2serr("%s trespass failed: %s\n",
+                pr2serr("%s%s trespass failed: %s\n", pfx,
                         (short_cmd ? "short" : "long"), b);
                 break;
         }
         return res;
 }
 
+/* Finds the target port group of the path to fd (from the Device
+ * Identification VPD page) and its asymmetric access state (with REPORT
+ * TARGET PORT GROUPS). Returns 0, -1 if there is no target port group
+ * designator, else a SG_LIB_CAT_* value (e.g. SG_LIB_CAT_INVALID_OP when
+ * the device has no ALUA support). */
+static int
+get_tpg_state(int fd, int * tpgp, int * statep)
+{
+        int res, k, len;
+        int verb = (debug > 1) ? debug - 1 : 0;
+        uint8_t b[DI_BUFF_LEN];
+        uint8_t rb[RTPG_BUFF_LEN];
+        struct sg_vpd_dev_id_idx di;
+
+        *tpgp = -1;
+        *statep = -1;
+        res = sg_ll_inquiry(fd, false, true /* evpd */, VPD_DEVICE_ID, b,
+                            sizeof(b), false, verb);
+        if (res)
+                return res;
+        if (VPD_DEVICE_ID != b[1])
+                return SG_LIB_CAT_MALFORMED;
+        len = sg_get_unaligned_be16(b + 2);
+        if (len > (int)sizeof(b) - 4)
+                len = (int)sizeof(b) - 4;
+        sg_vpd_dev_id_index(b + 4, len, &di);
+        if (di.tpg_id < 0)
+                return -1;
+        *tpgp = di.tpg_id;
+        res = sg_ll_report_tgt_prt_grp2(fd, rb, sizeof(rb), false, false,
+                                        verb);
+        if (res)
+                return res;
+        len = sg_get_unaligned_be32(rb + 0) + 4;
+        if (len > (int)sizeof(rb))
+                len = (int)sizeof(rb);
+        for (k = 4; (k + 8) <= len; k += 8 + (4 * rb[k + 7])) {
+                if (sg_get_unaligned_be16(rb + k + 2) == di.tpg_id) {
+                        *statep = rb[k] & 0xf;
+                        return 0;
+                }
+        }
+        return SG_LIB_CAT_MALFORMED;
+}
+
+/* Takes DEVICEs until none are left: opens, trespasses then fetches the
+ * new asymmetric access state of the path, waiting while that group is
+ * transitioning. */
+static void *
+tres_worker(void * v_tcp)
+{
+        int k, n, fd;
+        struct tres_coll_t * tcp = (struct tres_coll_t *)v_tcp;
+        struct tres_dev_t * tdp;
+        char pfx[128];
+
+        while ((k = __atomic_fetch_add(&tcp->next_ind, 1, __ATOMIC_RELAXED))
+               < tcp->num) {
+                tdp = tcp->arr + k;
+                fd = open(tdp->name, O_RDWR | O_NONBLOCK);
+                if (fd < 0) {
+                        tdp->res = sg_convert_errno(errno);
+                        continue;
+                }
+                snprintf(pfx, sizeof(pfx), "%.100s: ", tdp->name);
+                tdp->res = do_trespass(fd, tcp->hr, tcp->short_cmd, pfx);
+                if (0 == tdp->res) {
+                        for (n = 0; n < MAX_TRANS_POLLS; ++n) {
+                                tdp->vres = get_tpg_state(fd, &tdp->tpg,
+                                                          &tdp->state);
+                                if (tdp->vres || (TPGS_STATE_TRANSITIONING
+                                                  != tdp->state))
+                                        break;
+                                sleep(1);
+                        }
+                }
+                close(fd);
+        }
+        return NULL;
+}
+
+/* Trespasses the num DEVICEs in dev_names from num_thr threads then
+ * outputs a line for each and a summary. Returns 0 if every trespass
+ * worked and no path was found in a state other than active/optimized,
+ * else the first error. */
+static int
+multi_trespass(struct tres_coll_t * tcp, char ** dev_names, int num_thr)
+{
+        int k, err;
+        int num_tres = 0;
+        int num_owned = 0;
+        int ret = 0;
+        struct tres_dev_t * tdp;
+        pthread_t * tids;
+        char b[80];
+
+        tcp->arr = (struct tres_dev_t *)calloc(tcp->num, sizeof(*tcp->arr));
+        tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+        if ((NULL == tcp->arr) || (NULL == tids)) {
+                pr2serr("unable to allocate memory for %d devices\n",
+                        tcp->num);
+                free(tcp->arr);
+                free(tids);
+                return sg_convert_errno(ENOMEM);
+        }
+        for (k = 0; k < tcp->num; ++k)
+                tcp->arr[k].name = dev_names[k];
+        for (k = 0; k < num_thr; ++k) {
+                err = pthread_create(tids + k, NULL, tres_worker, tcp);
+                if (err) {
+                        pr2serr("pthread_create: %s, continue with %d "
+                                "threads\n", safe_strerror(err), k);
+                        break;
+                }
+        }
+        num_thr = k;
+        if (0 == num_thr)
+                tres_worker(tcp);       /* no threads, so do them all here */
+        for (k = 0; k < num_thr; ++k)
+                pthread_join(tids[k], NULL);
+
+        printf("Trespass of %d LUNs using %d threads:\n", tcp->num,
+               num_thr);
+        for (k = 0; k < tcp->num; ++k) {
+                tdp = tcp->arr + k;
+                if (tdp->res) {
+                        sg_get_category_sense_str(tdp->res, sizeof(b), b,
+                                                  debug);
+                        printf("  %s: FAILED: %s\n", tdp->name, b);
+                        if (0 == ret)
+                                ret = tdp->res;
+                        continue;
+                }
+                ++num_tres;
+                if (0 == tdp->vres) {
+                        printf("  %s: target port group %d is %s\n",
+                               tdp->name, tdp->tpg,
+                               tpgs_state_arr[tdp->state]);
+                        if (TPGS_STATE_OPTIMIZED == tdp->state)
+                                ++num_owned;
+                        else if (0 == ret)
+                                ret = SG_LIB_CAT_OTHER;
+                } else if ((-1 == tdp->vres) ||
+                           (SG_LIB_CAT_INVALID_OP == tdp->vres) ||
+                           (SG_LIB_CAT_ILLEGAL_REQ == tdp->vres))
+                        printf("  %s: trespassed, new ownership not "
+                               "reported (no ALUA)\n", tdp->name);
+                else {
+                        sg_get_category_sense_str(tdp->vres, sizeof(b), b,
+                                                  debug);
+                        printf("  %s: trespassed, unable to check new "
+                               "state: %s\n", tdp->name, b);
+                        if (0 == ret)
+                                ret = tdp->vres;
+                }
+        }
+        printf("%d of %d LUNs trespassed, %d verified active/optimized\n",
+               num_tres, tcp->num, num_owned);
+        free(tcp->arr);
+        free(tids);
+        return ret;
+}
+
 void usage ()
 {
-        pr2serr("Usage:  sg_emc_trespass [-d] [-hr] [-s] [-V] DEVICE\n"
+        pr2serr("Usage:  sg_emc_trespass [-d] [-hr] [-j=J] [-s] [-V] DEVICE "
+                "[DEVICE ...]\n"
                 "  Change ownership of a LUN from another SP to this one.\n"
                 "  EMC CLARiiON CX-/AX-family + FC5300/FC4500/FC4700.\n"
                 "    -d : output debug\n"
                 "    -hr: Set Honor Reservation bit\n"
+                "    -j=J: with more than one DEVICE, trespass at most J "
+                "at a time\n"
+                "          (def: %d)\n"
                 "    -s : Send Short Trespass Command page (default: long)\n"
                 "         (for FC series)\n"
                 "    -V: print version string then exit\n"
                 "     DEVICE   sg or block device (latter in lk 2.6 or lk 3 "
                 "series)\n"
-                "        Example: sg_emc_trespass /dev/sda\n");
+                "        Example: sg_emc_trespass /dev/sda\n"
+                "  With more than one DEVICE (one path to each LUN) the new "
+                "state of each\n"
+                "  path is checked with REPORT TARGET PORT GROUPS.\n",
+                DEF_JOBS);
         exit (1);
 }
 
@@ -123,10 +330,14 @@ int main(int argc, char * argv[])
 {
         char **argptr;
         char * file_name = 0;
+        char ** dev_names = NULL;
         int k, fd;
+        int num_devs = 0;
+        int num_jobs = DEF_JOBS;
         bool hr = false;
         bool short_cmd = false;
         int ret = 0;
+        struct tres_coll_t tc;
 
         if (argc < 2)
                 usage ();
@@ -139,6 +350,13 @@ int main(int argc, char * argv[])
                         short_cmd = true;
                 else if (!strcmp (*argptr, "-hr"))
                         hr = true;
+                else if (!strncmp(*argptr, "-j=", 3)) {
+                        num_jobs = sg_get_num(*argptr + 3);
+                        if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                                pr2serr("-j= expects 1 to %d\n", MAX_JOBS);
+                                return SG_LIB_SYNTAX_ERROR;
+                        }
+                }
                 else if (!strcmp (*argptr, "-V")) {
                         printf("Version string: %s\n", version_str);
                         exit(0);
@@ -148,18 +366,33 @@ int main(int argc, char * argv[])
                         file_name = NULL;
                         break;
                 }
-                else if (NULL == file_name)
-                        file_name = argv[k];
                 else {
-                        pr2serr("too many arguments\n");
-                        file_name = NULL;
-                        break;
+                        if (NULL == file_name) {
+                                file_name = argv[k];
+                                dev_names = argv + k;
+                        } else if ((dev_names + num_devs) != (argv + k)) {
+                                pr2serr("options must precede the "
+                                        "DEVICEs\n");
+                                file_name = NULL;
+                                break;
+                        }
+                        ++num_devs;
                 }
         }
         if (NULL == file_name) {
                 usage();
                 return SG_LIB_SYNTAX_ERROR;
         }
+        if (num_devs > 1) {
+                memset(&tc, 0, sizeof(tc));
+                tc.hr = hr;
+                tc.short_cmd = short_cmd;
+                tc.num = num_devs;
+                ret = multi_trespass(&tc, dev_names,
+                                     (num_jobs < num_devs) ? num_jobs :
+                                                             num_devs);
+                return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+        }
 
         fd = open(file_name, O_RDWR | O_NONBLOCK);
         if (fd < 0) {
@@ -169,7 +402,7 @@ int main(int argc, char * argv[])
                 return SG_LIB_FILE_ERROR;
         }
 
-        ret = do_trespass(fd, hr, short_cmd);
+        ret = do_trespass(fd, hr, short_cmd, "");
 
         close (fd);
         return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
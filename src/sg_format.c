@@ -6,7 +6,7 @@
  *
  * Copyright (C) 2003  Grant Grundler    grundler at parisc-linux dot org
  * Copyright (C) 2003  James Bottomley       jejb at parisc-linux dot org
- * Copyright (C) 2005-2019  Douglas Gilbert   dgilbert at interlog dot com
+ * Copyright (C) 2005-2026  Douglas Gilbert   dgilbert at interlog dot com
  *
  *   This program is free software; you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
@@ -40,7 +40,7 @@
 #include "sg_pr2serr.h"
 #include "sg_pt.h"
 
-static const char * version_str = "1.58 20190113";
+static const char * version_str = "1.60 20261014";
 
 
 #define RW_ERROR_RECOVERY_PAGE 1  /* can give alternate with --mode=MP */
@@ -52,8 +52,10 @@ static const char * version_str = "1.58 20190113";
 #define EIGHT_TBYTE     (FOUR_TBYTE * 2)
 #define VLONG_FORMAT_TIMEOUT    (80 * 3600)       /* 3 days, 8 hours */
 
-#define POLL_DURATION_SECS 60
+#define POLL_DURATION_SECS 60    /* longest wait between polls */
 #define POLL_DURATION_FFMT_SECS 10
+#define POLL_MIN_SECS 5         /* shortest, also before the first */
+#define NS_PER_SEC 1000000000ULL
 #define DEF_POLL_TYPE_RS false     /* false -> test unit ready;
                                       true -> request sense */
 #define MAX_BUFF_SZ     252
@@ -80,6 +82,7 @@ struct opts_t {
         bool dry_run;           /* -d */
         bool early;             /* -e */
         bool fwait;             /* -w (negate for immed) */
+        bool multi;             /* more than one DEVICE given */
         bool ip_def;            /* -I */
         bool long_lba;          /* -l */
         bool mode6;             /* -6 */
@@ -105,9 +108,19 @@ struct opts_t {
         int tape;               /* -T <format>, def: -1 */
         int timeout;            /* -m SECS, def: depends on IMMED bit */
         int verbose;            /* -v */
+        int num_devs;           /* DEVICE arguments given */
         int64_t blk_count;      /* -c value */
         int64_t total_byte_count;      /* from READ CAPACITY command */
         const char * device_name;
+        char ** dev_names;      /* num_devs of them, from argv */
+};
+
+struct multi_ctx {              /* for format_multi_cb() */
+        int num;
+        int active;
+        uint64_t last_ns;       /* when the summary was last output */
+        struct sg_progress_dev * pds;
+        const struct opts_t * op;
 };
 
 
@@ -161,7 +174,8 @@ usage()
                "[--security]\n"
                "            [--six] [--size=LB_SZ] [--tape=FM] "
                "[--timeout=SECS] [--verbose]\n"
-               "            [--verify] [--version] [--wait] DEVICE\n"
+               "            [--verify] [--version] [--wait] DEVICE "
+               "[DEVICE...]\n"
                "  where:\n"
                "    --cmplst=0|1\n"
                "      -C 0|1        sets CMPLST bit in format cdb "
@@ -238,7 +252,9 @@ usage()
                "\tExample: sg_format --format /dev/sdc\n\n"
                "This utility formats a SCSI disk [FORMAT UNIT] or resizes "
                "it. Alternatively\nif '--tape=FM' is given formats a tape "
-               "[FORMAT MEDIUM].\n\n");
+               "[FORMAT MEDIUM].\nWith more than one DEVICE, '--format' "
+               "starts a FORMAT UNIT on each then all\nare polled together "
+               "and a status report for each is output at the end.\n\n");
         printf("WARNING: This utility will destroy all the data on "
                "DEVICE when '--format'\n\t or '--tape' is given. Check that "
                "you have specified the correct\n\t DEVICE.\n");
@@ -301,14 +317,58 @@ sg_ll_format_medium(int sg_fd, bool verify, bool immed, int format,
         return ret;
 }
 
+/* Called by sg_progress_run() after each poll of a format in progress */
+static bool
+format_progress_cb(struct sg_progress_dev * dp, void * ctx)
+{
+        int pr, rem;
+
+        if (ctx) { ; }          /* suppress warning */
+        if (SG_PROGRESS_ACTIVE == dp->state) {
+                pr = (dp->progress * 100) / 65536;
+                rem = ((dp->progress * 100) % 65536) / 656;
+                printf("Format in progress, %d.%02d%% done\n", pr, rem);
+        }
+        return true;
+}
+
+/* Polls fd, from every POLL_MIN_SECS up to every max_secs seconds, until
+ * a format started with IMMED set is no longer in progress. Returns 0
+ * unless the sense data then reports that the format failed, or the poll
+ * itself fails with a medium or hardware error. */
+static int
+poll_format(int fd, const struct opts_t * op, int max_secs)
+{
+        int vb = op->verbose;
+        struct sg_progress_dev pd;
+        char b[80];
+
+        sg_progress_init(&pd, fd, op->poll_type, POLL_MIN_SECS * NS_PER_SEC,
+                         max_secs * NS_PER_SEC);
+        sg_progress_run(&pd, 1, format_progress_cb, NULL,
+                        (vb > 1) ? (vb - 1) : 0);
+        if (SG_PROGRESS_FAILED != pd.state)
+                return 0;
+        if (pd.sense_key > 0) {
+                pr2serr("Format failed, Request Sense: %s\n",
+                        sg_get_sense_key_str(pd.sense_key, sizeof(b), b));
+                pr2serr("    %s\n", sg_get_asc_ascq_str(pd.asc, pd.ascq,
+                                                       sizeof(b), b));
+                return pd.res;
+        }
+        pr2serr("polling with %s command failed [res=%d]\n",
+                pd.use_rs ? "Request Sense" : "Test Unit Ready", pd.res);
+        /* medium or hardware error in response to the poll itself */
+        return (SG_LIB_CAT_MEDIUM_HARD == pd.res) ? pd.res : 0;
+}
+
 /* Return 0 on success, else see sg_ll_format_unit_v2() */
 static int
 scsi_format_unit(int fd, const struct opts_t * op)
 {
         bool need_param_lst, longlist, ip_desc;
         bool immed = ! op->fwait;
-        int res, progress, pr, rem, param_sz, off, resp_len, tmout;
-        int poll_wait_secs;
+        int res, param_sz, off, tmout;
         int vb = op->verbose;
         const int SH_FORMAT_HEADER_SZ = 4;
         const int LONG_FORMAT_HEADER_SZ = 8;
@@ -393,6 +453,8 @@ scsi_format_unit(int fd, const struct opts_t * op)
         if (! immed)
                 return 0;
 
+        if (op->multi)
+                return 0;       /* caller polls all DEVICEs together */
         if (! op->dry_run)
                 printf("\nFormat unit has started\n");
 
@@ -408,63 +470,10 @@ scsi_format_unit(int fd, const struct opts_t * op)
                 printf("No point in polling for progress, so exit\n");
                 return 0;
         }
-        poll_wait_secs = op->ffmt ? POLL_DURATION_FFMT_SECS :
-                                    POLL_DURATION_SECS;
-        if (! op->poll_type) {
-                for(;;) {
-                        sleep_for(poll_wait_secs);
-                        progress = -1;
-                        res = sg_ll_test_unit_ready_progress(fd, 0, &progress,
-                                             true, (vb > 1) ? (vb - 1) : 0);
-                        if (progress >= 0) {
-                                pr = (progress * 100) / 65536;
-                                rem = ((progress * 100) % 65536) / 656;
-                                printf("Format in progress, %d.%02d%% done\n",
-                                       pr, rem);
-                        } else
-                                break;
-                }
-        }
-        if (op->poll_type || (SG_LIB_CAT_NOT_READY == res)) {
-                uint8_t * reqSense;
-                uint8_t * free_reqSense = NULL;
-
-                reqSense = sg_memalign(MAX_BUFF_SZ, 0, &free_reqSense, false);
-                if (NULL == reqSense) {
-                        pr2serr("%s: unable to obtain heap for Request "
-                                "Sense\n", __func__);
-                        return sg_convert_errno(ENOMEM);
-                }
-                for(;;) {
-                        sleep_for(poll_wait_secs);
-                        memset(reqSense, 0x0, MAX_BUFF_SZ);
-                        res = sg_ll_request_sense(fd, false, reqSense,
-                                                  MAX_BUFF_SZ, false,
-                                                  (vb > 1) ? (vb - 1) : 0);
-                        if (res) {
-                                pr2serr("polling with Request Sense command "
-                                        "failed [res=%d]\n", res);
-                                break;
-                        }
-                        resp_len = reqSense[7] + 8;
-                        if (vb > 1) {
-                                pr2serr("Parameter data in hex:\n");
-                                hex2stderr(reqSense, resp_len, 1);
-                        }
-                        progress = -1;
-                        sg_get_sense_progress_fld(reqSense, resp_len,
-                                                  &progress);
-                        if (progress >= 0) {
-                                pr = (progress * 100) / 65536;
-                                rem = ((progress * 100) % 65536) / 656;
-                                printf("Format in progress, %d.%02d%% done\n",
-                                       pr, rem);
-                        } else
-                                break;
-                }
-                if (free_reqSense)
-                        free(free_reqSense);
-        }
+        res = poll_format(fd, op, op->ffmt ? POLL_DURATION_FFMT_SECS :
+                                             POLL_DURATION_SECS);
+        if (res)
+                return res;
         printf("FORMAT UNIT Complete\n");
         return 0;
 }
@@ -473,7 +482,7 @@ scsi_format_unit(int fd, const struct opts_t * op)
 static int
 scsi_format_medium(int fd, const struct opts_t * op)
 {
-        int res, progress, pr, rem, resp_len, tmout;
+        int res, tmout;
         int vb = op->verbose;
         bool immed = ! op->fwait;
         char b[80];
@@ -520,122 +529,57 @@ scsi_format_medium(int fd, const struct opts_t * op)
                 printf("No point in polling for progress, so exit\n");
                 return 0;
         }
-        if (! op->poll_type) {
-                for(;;) {
-                        sleep_for(POLL_DURATION_SECS);
-                        progress = -1;
-                        res = sg_ll_test_unit_ready_progress(fd, 0, &progress,
-                                             true, (vb > 1) ? (vb - 1) : 0);
-                        if (progress >= 0) {
-                                pr = (progress * 100) / 65536;
-                                rem = ((progress * 100) % 65536) / 656;
-                                printf("Format in progress, %d.%02d%% done\n",
-                                       pr, rem);
-                        } else
-                                break;
-                }
-        }
-        if (op->poll_type || (SG_LIB_CAT_NOT_READY == res)) {
-                uint8_t * reqSense;
-                uint8_t * free_reqSense = NULL;
-
-                reqSense = sg_memalign(MAX_BUFF_SZ, 0, &free_reqSense, false);
-                if (NULL == reqSense) {
-                        pr2serr("%s: unable to obtain heap for Request "
-                                "Sense\n", __func__);
-                        return sg_convert_errno(ENOMEM);
-                }
-                for(;;) {
-                        sleep_for(POLL_DURATION_SECS);
-                        memset(reqSense, 0x0, MAX_BUFF_SZ);
-                        res = sg_ll_request_sense(fd, false, reqSense,
-                                                  MAX_BUFF_SZ, false,
-                                                  (vb > 1) ? (vb - 1) : 0);
-                        if (res) {
-                                pr2serr("polling with Request Sense command "
-                                        "failed [res=%d]\n", res);
-                                break;
-                        }
-                        resp_len = reqSense[7] + 8;
-                        if (vb > 1) {
-                                pr2serr("Parameter data in hex:\n");
-                                hex2stderr(reqSense, resp_len, 1);
-                        }
-                        progress = -1;
-                        sg_get_sense_progress_fld(reqSense, resp_len,
-                                                  &progress);
-                        if (progress >= 0) {
-                                pr = (progress * 100) / 65536;
-                                rem = ((progress * 100) % 65536) / 656;
-                                printf("Format in progress, %d.%02d%% done\n",
-                                       pr, rem);
-                        } else
-                                break;
-                }
-                if (free_reqSense)
-                        free(free_reqSense);
-        }
+        res = poll_format(fd, op, POLL_DURATION_SECS);
+        if (res)
+                return res;
         printf("FORMAT MEDIUM Complete\n");
         return 0;
 }
 
 #define VPD_DEVICE_ID 0x83
-#define VPD_ASSOC_LU 0
-#define VPD_ASSOC_TPORT 1
 #define TPROTO_ISCSI 5
 
 static char *
 get_lu_name(const uint8_t * bp, int u_len, char * b, int b_len)
 {
-        int len, off, sns_dlen, dlen, k;
-        uint8_t u_sns[512];
+        int off, dlen, k;
+        const uint8_t * dp;
         char * cp;
+        struct sg_vpd_dev_id_idx di;
 
-        len = u_len - 4;
         bp += 4;
-        off = -1;
-        if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_LU,
-                                    8 /* SCSI name string (sns) */,
-                                    3 /* UTF-8 */)) {
-                sns_dlen = bp[off + 3];
-                memcpy(u_sns, bp + off + 4, sns_dlen);
-                /* now want to check if this is iSCSI */
-                off = -1;
-                if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_TPORT,
-                                            8 /* SCSI name string (sns) */,
-                                            3 /* UTF-8 */)) {
-                        if ((0x80 & bp[1]) &&
-                            (TPROTO_ISCSI == (bp[0] >> 4))) {
-                                snprintf(b, b_len, "%.*s", sns_dlen, u_sns);
-                                return b;
-                        }
+        sg_vpd_dev_id_index(bp, u_len - 4, &di);
+        if ((di.lu_sns >= 0) && (di.tport_sns >= 0)) {
+                /* want the SCSI name string if this is iSCSI */
+                dp = bp + di.tport_sns;
+                if ((0x80 & dp[1]) && (TPROTO_ISCSI == (dp[0] >> 4))) {
+                        snprintf(b, b_len, "%.*s", bp[di.lu_sns + 3],
+                                 (const char *)(bp + di.lu_sns + 4));
+                        return b;
                 }
-        } else
-                sns_dlen = 0;
-        if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_LU,
-                                    3 /* NAA */, 1 /* binary */)) {
+        }
+        if (di.lu_naa >= 0) {
+                off = di.lu_naa;
                 dlen = bp[off + 3];
                 if (! ((8 == dlen) || (16 ==dlen)))
                         return b;
-                cp = b;
-                for (k = 0; ((k < dlen) && (b_len > 1)); ++k) {
-                        snprintf(cp, b_len, "%02x", bp[off + 4 + k]);
-                        cp += 2;
-                        b_len -= 2;
-                }
-        } else if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_LU,
-                                           2 /* EUI */, 1 /* binary */)) {
+        } else if (di.lu_eui64 >= 0) {
+                off = di.lu_eui64;
                 dlen = bp[off + 3];
                 if (! ((8 == dlen) || (12 == dlen) || (16 ==dlen)))
                         return b;
-                cp = b;
-                for (k = 0; ((k < dlen) && (b_len > 1)); ++k) {
-                        snprintf(cp, b_len, "%02x", bp[off + 4 + k]);
-                        cp += 2;
-                        b_len -= 2;
-                }
-        } else if (sns_dlen > 0)
-                snprintf(b, b_len, "%.*s", sns_dlen, u_sns);
+        } else {
+                if (di.lu_sns >= 0)
+                        snprintf(b, b_len, "%.*s", bp[di.lu_sns + 3],
+                                 (const char *)(bp + di.lu_sns + 4));
+                return b;
+        }
+        cp = b;
+        for (k = 0; ((k < dlen) && (b_len > 1)); ++k) {
+                snprintf(cp, b_len, "%02x", bp[off + 4 + k]);
+                cp += 2;
+                b_len -= 2;
+        }
         return b;
 }
 
@@ -1207,17 +1151,10 @@ parse_cmd_line(struct opts_t * op, int argc, char **argv)
                 }
         }
         if (optind < argc) {
-                if (NULL == op->device_name) {
-                        op->device_name = argv[optind];
-                        ++optind;
-                }
-        }
-        if (optind < argc) {
-                for (; optind < argc; ++optind)
-                        pr2serr("Unexpected extra argument: %s\n",
-                                argv[optind]);
-                usage();
-                return SG_LIB_SYNTAX_ERROR;
+                op->device_name = argv[optind];
+                op->dev_names = argv + optind;
+                op->num_devs = argc - optind;
+                op->multi = (op->num_devs > 1);
         }
 #ifdef DEBUG
         pr2serr("In DEBUG mode, ");
@@ -1285,11 +1222,220 @@ parse_cmd_line(struct opts_t * op, int argc, char **argv)
                 if (op->rto_req)
                         op->fmtpinfo |= 1;
         }
+        if (op->multi) {
+                /* the MODE SENSE/SELECT and READ CAPACITY steps are per
+                 * DEVICE, so only a plain FORMAT UNIT is supported */
+                if ((0 == op->format) || op->resize || (op->tape >= 0) ||
+                    op->blk_count || op->lblk_sz || op->fwait) {
+                        pr2serr("with more than one DEVICE only '--format' "
+                                "is supported; '--count=',\n'--resize', "
+                                "'--size=', '--tape=' and '--wait' cannot "
+                                "be used\n");
+                        return SG_LIB_CONTRADICT;
+                }
+        }
         if ((op->ffmt > 0) && (! op->cmplst_given))
                 op->cmplst = false; /* SBC-4 silent; FFMT&&CMPLST unlikely */
         return 0;
 }
 
+/* Called by sg_progress_run() after each poll when there is more than one
+ * DEVICE. Reports each DEVICE as it finishes and, every
+ * POLL_DURATION_SECS, how many are still in progress. */
+static bool
+format_multi_cb(struct sg_progress_dev * dp, void * ctx)
+{
+        int k, least;
+        uint64_t now;
+        struct multi_ctx * mcp = (struct multi_ctx *)ctx;
+        const char * name = (const char *)dp->user;
+
+        if (SG_PROGRESS_ACTIVE != dp->state) {
+                --mcp->active;
+                printf("%s: format %s after %" PRIu64 " seconds\n", name,
+                       (SG_PROGRESS_DONE == dp->state) ? "complete" :
+                                                         "FAILED",
+                       (uint64_t)((dp->end_ns - dp->start_ns) / NS_PER_SEC));
+                return true;
+        }
+        if (mcp->op->verbose)
+                printf("%s: format in progress, %d%% done\n", name,
+                       (dp->progress * 100) / 65536);
+        now = sg_pt_lat_now_ns();
+        if ((now - mcp->last_ns) < (POLL_DURATION_SECS * NS_PER_SEC))
+                return true;
+        mcp->last_ns = now;
+        for (k = 0, least = 65536; k < mcp->num; ++k) {
+                if ((SG_PROGRESS_ACTIVE == mcp->pds[k].state) &&
+                    (mcp->pds[k].progress < least))
+                        least = mcp->pds[k].progress;
+        }
+        printf("%d of %d formats in progress, least done: %d%%\n",
+               mcp->active, mcp->num, (least * 100) / 65536);
+        return true;
+}
+
+/* With more than one DEVICE: checks each is a disk, starts FORMAT UNIT
+ * with IMMED set on each of them, then (unless --early) polls them all
+ * from this thread until none are in progress and outputs a status line
+ * for each. Returns 0 if the format succeeded on every DEVICE, else the
+ * error of the first that failed. */
+static int
+multi_format(const struct opts_t * op, uint8_t * inq_resp, int inq_resp_sz)
+{
+        int k, n, fd, pdt;
+        int num_started = 0;
+        int num_failed = 0;
+        int ret = 0;
+        int vb = op->verbose;
+        uint64_t longest = 0;
+        int * fds;
+        int * starts;
+        struct sg_progress_dev * pds;
+        struct multi_ctx mc;
+        char b[80];
+        char c[80];
+
+        n = op->num_devs;
+        fds = (int *)calloc(n, sizeof(int));
+        starts = (int *)calloc(n, sizeof(int));
+        pds = (struct sg_progress_dev *)calloc(n, sizeof(*pds));
+        if ((NULL == fds) || (NULL == starts) || (NULL == pds)) {
+                pr2serr("unable to allocate memory for %d devices\n", n);
+                ret = sg_convert_errno(ENOMEM);
+                goto fini;
+        }
+        for (k = 0; k < n; ++k) {
+                printf("%s:\n", op->dev_names[k]);
+                fd = sg_cmds_open_device(op->dev_names[k], false, vb);
+                if (fd < 0) {
+                        pr2serr("error opening device file: %s: %s\n",
+                                op->dev_names[k], safe_strerror(-fd));
+                        starts[k] = sg_convert_errno(-fd);
+                        fds[k] = -1;
+                        continue;
+                }
+                fds[k] = fd;
+                if (op->format > 2)
+                        continue;
+                starts[k] = print_dev_id(fd, inq_resp, inq_resp_sz, op);
+                if (starts[k])
+                        continue;
+                pdt = 0x1f & inq_resp[0];
+                if ((PDT_DISK != pdt) && (PDT_OPTICAL != pdt) &&
+                    (PDT_RBC != pdt)) {
+                        pr2serr("%s: this format is only defined for disks "
+                                "(using SBC-2 or RBC) and MO media\n",
+                                op->dev_names[k]);
+                        starts[k] = SG_LIB_CAT_MALFORMED;
+                }
+        }
+
+        if (! op->quick) {
+                for (k = 15; k > 0; k -= 5) {
+                        printf("\nA FORMAT UNIT will commence in %d "
+                               "seconds\n", k);
+                        printf("    ALL data on the %d devices above will "
+                               "be DESTROYED\n", n);
+                        printf("        Press control-C to abort\n");
+                        sleep_for(5);
+                }
+        }
+
+        for (k = 0; k < n; ++k) {
+                if (starts[k])
+                        continue;
+                starts[k] = scsi_format_unit(fds[k], op);
+                if (starts[k]) {
+                        pr2serr("%s: FORMAT UNIT failed\n",
+                                op->dev_names[k]);
+                        continue;
+                }
+                sg_progress_init(pds + num_started, fds[k], op->poll_type,
+                                 POLL_MIN_SECS * NS_PER_SEC,
+                                 (op->ffmt ? POLL_DURATION_FFMT_SECS :
+                                             POLL_DURATION_SECS) *
+                                 NS_PER_SEC);
+                pds[num_started].user = (void *)op->dev_names[k];
+                ++num_started;
+        }
+        if (op->early || op->dry_run) {
+                printf("Format unit started on %d of %d devices%s\n",
+                       num_started, n, op->dry_run ? " (dry run)" : "");
+                for (k = 0; k < n; ++k) {
+                        if (starts[k] && (0 == ret))
+                                ret = starts[k];
+                }
+                goto fini;
+        }
+
+        memset(&mc, 0, sizeof(mc));
+        mc.num = num_started;
+        mc.active = num_started;
+        mc.last_ns = sg_pt_lat_now_ns();
+        mc.pds = pds;
+        mc.op = op;
+        sg_progress_run(pds, num_started, format_multi_cb, &mc,
+                        (vb > 1) ? (vb - 1) : 0);
+
+        printf("\nFormat status of %d devices:\n", n);
+        for (k = 0, num_started = 0; k < n; ++k) {
+                struct sg_progress_dev * dp;
+                uint64_t secs;
+
+                if (starts[k]) {
+                        sg_get_category_sense_str(starts[k], sizeof(b), b,
+                                                  vb);
+                        printf("  %s: not started: %s\n", op->dev_names[k],
+                               b);
+                        ++num_failed;
+                        if (0 == ret)
+                                ret = starts[k];
+                        continue;
+                }
+                dp = pds + num_started++;
+                secs = (uint64_t)((dp->end_ns - dp->start_ns) / NS_PER_SEC);
+                if (secs > longest)
+                        longest = secs;
+                if (SG_PROGRESS_DONE == dp->state) {
+                        printf("  %s: complete in %" PRIu64 " seconds\n",
+                               op->dev_names[k], secs);
+                        continue;
+                }
+                ++num_failed;
+                if (0 == ret)
+                        ret = dp->res ? dp->res : SG_LIB_CAT_OTHER;
+                if (dp->sense_key > 0)
+                        printf("  %s: FAILED after %" PRIu64 " seconds: "
+                               "%s, %s\n", op->dev_names[k], secs,
+                               sg_get_sense_key_str(dp->sense_key,
+                                                    sizeof(b), b),
+                               sg_get_asc_ascq_str(dp->asc, dp->ascq,
+                                                   sizeof(c), c));
+                else {
+                        sg_get_category_sense_str(dp->res, sizeof(b), b, vb);
+                        printf("  %s: FAILED after %" PRIu64 " seconds: "
+                               "polling with %s: %s\n", op->dev_names[k],
+                               secs, dp->use_rs ? "Request Sense" :
+                                                  "Test Unit Ready", b);
+                }
+        }
+        printf("%d devices: %d complete, %d failed or not started; longest "
+               "%" PRIu64 " seconds\n", n, n - num_failed, num_failed,
+               longest);
+fini:
+        if (fds) {
+                for (k = 0; k < n; ++k) {
+                        if (fds[k] >= 0)
+                                sg_cmds_close_device(fds[k]);
+                }
+                free(fds);
+        }
+        free(starts);
+        free(pds);
+        return ret;
+}
+
 
 int
 main(int argc, char **argv)
@@ -1322,6 +1468,10 @@ main(int argc, char **argv)
                 goto out;
         }
 
+        if (op->multi) {
+                ret = multi_format(op, inq_resp, inq_resp_sz);
+                goto out;
+        }
         if ((fd = sg_cmds_open_device(op->device_name, false, vb)) < 0) {
                 pr2serr("error opening device file: %s: %s\n",
                         op->device_name, safe_strerror(-fd));
@@ -1,6 +1,5 @@
-PROPS-END
 /*
- * Copyright (c) 2019 Douglas Gilbert.
+ * Copyright (c) 2019-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -17,6 +16,7 @@ PROPS-END
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -35,10 +35,11 @@ PROPS-END
  *
  *
  * This program issues the SCSI GET PHYSICAL ELEMENT STATUS command to the
- * given SCSI device.
+ * given SCSI device. With --all (or several DEVICEs) every descriptor is
+ * fetched, a page at a time, from each DEVICE concurrently.
  */
 
-static const char * version_str = "1.00 20190827";      /* sbc4r15,17 */
+static const char * version_str = "1.01 20261014";      /* sbc4r15,17 */
 
 
 #ifndef UINT32_MAX
@@ -50,6 +51,11 @@ static const char * version_str = "1.00 20190827";      /* sbc4r15,17 */
 #define MAX_GPES_BUFF_LEN ((1024 * 1024) + DEF_GPES_BUFF_LEN)
 #define GPES_DESC_OFFSET 32     /* descriptors starts at this byte offset */
 #define GPES_DESC_LEN 32
+#define DEF_ALL_BUFF_LEN (GPES_DESC_OFFSET + (1024 * GPES_DESC_LEN))
+#define DEF_MAX_JOBS 256
+#define MAX_JOBS 1024
+#define VPD_DEVICE_ID 0x83
+#define VPD_DEVICE_ID_LEN 252
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT  60      /* 60 seconds */
@@ -62,16 +68,43 @@ struct gpes_desc_t {    /* info in returned physical status descriptor */
     uint64_t assoc_cap;   /* number of LBs removed if depopulated */
 };
 
+/* A DEVICE whose element descriptors are all fetched, maybe by a worker
+ * thread, with --all */
+struct gpes_dev_t {
+    const char * dev_name;
+    bool have_wwn;
+    int res;
+    int num_cmds;
+    uint32_t num_desc;          /* descriptors held in descs */
+    uint64_t wwn;               /* NAA logical unit name */
+    uint64_t dur_ns;
+    uint8_t * descs;            /* num_desc raw 32 byte descriptors */
+};
+
+struct gpes_coll_t {
+    bool readonly;
+    uint8_t filter;
+    uint8_t rt;
+    int maxlen;                 /* allocation length of each command */
+    int verbose;
+    int num_devs;
+    int next_ind;
+    uint32_t starting_elem;
+    struct gpes_dev_t * arr;
+};
+
 static uint8_t gpesBuff[DEF_GPES_BUFF_LEN];
 
 
 static struct option long_options[] = {
+        {"all", no_argument, 0, 'a'},
         {"brief", no_argument, 0, 'b'},
         {"filter", required_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
         {"in", required_argument, 0, 'i'},      /* silent, same as --inhex= */
         {"inhex", required_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
         {"maxlen", required_argument, 0, 'm'},
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
@@ -86,14 +119,21 @@ static struct option long_options[] = {
 static void
 usage()
 {
-    pr2serr("Usage: sg_get_elem_status  [--brief] [--filter=FLT] [--help] "
-            "[--hex]\n"
-            "                           [--inhex=FN] [--maxlen=LEN] [--raw] "
-            "[--readonly]\n"
-            "                           [--report-type=RT] [--starting=ELEM] "
-            "[--verbose]\n"
-            "                           [--version] DEVICE\n"
+    pr2serr("Usage: sg_get_elem_status  [--all] [--brief] [--filter=FLT] "
+            "[--help]\n"
+            "                           [--hex] [--inhex=FN] [--jobs=J] "
+            "[--maxlen=LEN]\n"
+            "                           [--raw] [--readonly] "
+            "[--report-type=RT]\n"
+            "                           [--starting=ELEM] [--verbose] "
+            "[--version]\n"
+            "                           DEVICE [DEVICE...]\n"
             "  where:\n"
+            "    --all|-a          fetch all descriptors, a page at a time, "
+            "and output\n"
+            "                      one line per element keyed by WWN (implied "
+            "by more\n"
+            "                      than one DEVICE)\n"
             "    --brief|-b        one descriptor per line\n"
             "    --filter=FLT|-f FLT    FLT is 0 (def) for all physical "
             "elements;\n"
@@ -105,14 +145,20 @@ usage()
             "DEVICE,\n"
             "                      assumed to be ASCII hex or, if --raw, "
             "in binary\n"
+            "    --jobs=J|-j J     DEVICEs fetched concurrently with --all "
+            "(def: all,\n"
+            "                      up to %d)\n"
             "    --maxlen=LEN|-m LEN    max response length (allocation "
             "length in cdb)\n"
-            "                           (def: 0 -> %d bytes)\n",
-            DEF_GPES_BUFF_LEN );
+            "                           (def: 0 -> %d bytes, %d with "
+            "--all)\n",
+            DEF_MAX_JOBS, DEF_GPES_BUFF_LEN, DEF_ALL_BUFF_LEN);
     pr2serr("    --raw|-r          output in binary, unless --inhex=FN is "
             "given in\n"
             "                      in which case the input is assumed to be "
-            "binary\n"
+            "binary;\n"
+            "                      with --all: WWN, count then descriptors "
+            "per DEVICE\n"
             "    --readonly|-R     open DEVICE read-only (def: read-write)\n"
             "    --report-type=RT|-t RT    report type: 0-> physical "
             "elements (def);\n"
@@ -221,11 +267,251 @@ decode_elem_status_desc(const uint8_t * bp, struct gpes_desc_t * pedp)
     pedp->assoc_cap = sg_get_unaligned_be64(bp + 16);
 }
 
+/* Fetches the Device Identification VPD page and yields the first 8 bytes
+ * of the logical unit's NAA designator in *wwnp. Returns true if found. */
+static bool
+get_lu_wwn(int sg_fd, uint64_t * wwnp, int verbose)
+{
+    int len;
+    int off = -1;
+    uint8_t b[VPD_DEVICE_ID_LEN];
+
+    if (sg_ll_inquiry(sg_fd, false, true, VPD_DEVICE_ID, b, sizeof(b),
+                      false, verbose))
+        return false;
+    if (VPD_DEVICE_ID != b[1])
+        return false;
+    len = sg_get_unaligned_be16(b + 2);
+    if (len > (int)(sizeof(b) - 4))
+        len = sizeof(b) - 4;
+    /* association: logical unit (0), designator type: NAA (3), binary */
+    if (sg_vpd_dev_id_iter(b + 4, len, &off, 0, 3, 1))
+        return false;
+    if ((b[4 + off + 3] < 8) || ((4 + off + 4 + 8) > (len + 4)))
+        return false;
+    *wwnp = sg_get_unaligned_be64(b + 4 + off + 4);
+    return true;
+}
+
+/* Fetches every element descriptor (from cp->starting_elem) from sg_fd
+ * with as many GET PHYSICAL ELEMENT STATUS commands of cp->maxlen bytes
+ * as needed, each starting after the last identifier of the one before.
+ * An allocation length the device rejects is halved. Returns 0 if ok. */
+static int
+fetch_all_elems(int sg_fd, struct gpes_dev_t * gdp,
+                const struct gpes_coll_t * cp)
+{
+    int res, resid, got;
+    int alloc = cp->maxlen;
+    int max_desc = 0;
+    uint32_t n, k;
+    uint32_t start = cp->starting_elem;
+    uint8_t * bp;
+    uint8_t * free_bp;
+    uint8_t * ndp;
+
+    bp = (uint8_t *)sg_memalign(alloc, 0, &free_bp, false);
+    if (NULL == bp)
+        return sg_convert_errno(ENOMEM);
+    while (true) {
+        res = sg_ll_get_phy_elem_status(sg_fd, start, cp->filter, cp->rt,
+                                        bp, alloc, &resid, false,
+                                        cp->verbose);
+        ++gdp->num_cmds;
+        if ((SG_LIB_CAT_ILLEGAL_REQ == res) &&
+            (alloc > (GPES_DESC_OFFSET + GPES_DESC_LEN))) {
+            alloc = GPES_DESC_OFFSET + (((alloc - GPES_DESC_OFFSET) /
+                                         GPES_DESC_LEN / 2) * GPES_DESC_LEN);
+            if (alloc < (GPES_DESC_OFFSET + GPES_DESC_LEN))
+                alloc = GPES_DESC_OFFSET + GPES_DESC_LEN;
+            if (cp->verbose)
+                pr2serr("%s: allocation length rejected, try %d\n",
+                        gdp->dev_name, alloc);
+            continue;
+        }
+        if (res)
+            break;
+        got = alloc - resid;
+        if (got < 8) {
+            res = SG_LIB_CAT_MALFORMED;
+            break;
+        }
+        n = sg_get_unaligned_be32(bp + 4);
+        if ((int)(GPES_DESC_OFFSET + (n * GPES_DESC_LEN)) > got)
+            n = (got > GPES_DESC_OFFSET) ?
+                (got - GPES_DESC_OFFSET) / GPES_DESC_LEN : 0;
+        if (0 == n)
+            break;
+        if ((int)(gdp->num_desc + n) > max_desc) {
+            k = (max_desc > 0) ? (2 * max_desc) : 64;
+            if (k < gdp->num_desc + n)
+                k = gdp->num_desc + n;
+            ndp = (uint8_t *)realloc(gdp->descs, k * GPES_DESC_LEN);
+            if (NULL == ndp) {
+                res = sg_convert_errno(ENOMEM);
+                break;
+            }
+            gdp->descs = ndp;
+            max_desc = k;
+        }
+        memcpy(gdp->descs + (gdp->num_desc * GPES_DESC_LEN),
+               bp + GPES_DESC_OFFSET, n * GPES_DESC_LEN);
+        gdp->num_desc += n;
+        /* room for another descriptor, so that was the last of them */
+        if ((GPES_DESC_OFFSET + ((n + 1) * GPES_DESC_LEN)) <= (uint32_t)alloc)
+            break;
+        k = sg_get_unaligned_be32(bp + GPES_DESC_OFFSET +
+                                  ((n - 1) * GPES_DESC_LEN) + 4);
+        if ((UINT32_MAX == k) || (k < start))
+            break;
+        start = k + 1;
+    }
+    free(free_bp);
+    return res;
+}
+
+/* Takes DEVICEs, in order, until none are left and fetches the WWN and
+ * all the element descriptors of each. */
+static void *
+gpes_worker(void * v_cp)
+{
+    int k, sg_fd;
+    uint64_t t0;
+    struct gpes_coll_t * cp = (struct gpes_coll_t *)v_cp;
+    struct gpes_dev_t * gdp;
+
+    while ((k = __atomic_fetch_add(&cp->next_ind, 1, __ATOMIC_RELAXED)) <
+           cp->num_devs) {
+        gdp = cp->arr + k;
+        sg_fd = sg_cmds_open_device(gdp->dev_name, cp->readonly,
+                                    cp->verbose);
+        if (sg_fd < 0) {
+            pr2serr("open error: %s: %s\n", gdp->dev_name,
+                    safe_strerror(-sg_fd));
+            gdp->res = sg_convert_errno(-sg_fd);
+            continue;
+        }
+        t0 = sg_pt_lat_now_ns();
+        gdp->have_wwn = get_lu_wwn(sg_fd, &gdp->wwn, cp->verbose);
+        gdp->res = fetch_all_elems(sg_fd, gdp, cp);
+        gdp->dur_ns = sg_pt_lat_now_ns() - t0;
+        if (gdp->res < 0)
+            gdp->res = SG_LIB_CAT_OTHER;
+        sg_cmds_close_device(sg_fd);
+    }
+    return NULL;
+}
+
+/* Fetches all element descriptors from each DEVICE, num_thr of them at a
+ * time, then outputs them in DEVICE order: one line per element with the
+ * DEVICE's WWN (or, lacking one, its name) first or, if do_raw, in binary:
+ * per DEVICE an 8 byte WWN (zero if none), a 4 byte descriptor count (both
+ * big endian), then the descriptors as returned. Returns 0 if all were
+ * fetched, else the error of the first DEVICE that failed. */
+static int
+gpes_all(struct gpes_coll_t * cp, char ** dev_names, int num_thr,
+         bool do_raw)
+{
+    int k, err, res;
+    int ret = 0;
+    uint32_t j;
+    const uint8_t * bp;
+    struct gpes_dev_t * gdp;
+    struct gpes_desc_t a_ped;
+    pthread_t * tids;
+    uint8_t hdr[12];
+    char key[40];
+    char b[80];
+
+    cp->arr = (struct gpes_dev_t *)calloc(cp->num_devs, sizeof(*cp->arr));
+    tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+    if ((NULL == cp->arr) || (NULL == tids)) {
+        pr2serr("unable to allocate memory for %d devices\n",
+                cp->num_devs);
+        free(cp->arr);
+        free(tids);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < cp->num_devs; ++k)
+        cp->arr[k].dev_name = dev_names[k];
+    if (cp->num_devs > 1) {
+        for (k = 0; k < num_thr; ++k) {
+            err = pthread_create(tids + k, NULL, gpes_worker, cp);
+            if (err) {
+                pr2serr("pthread_create: %s, continue with %d threads\n",
+                        safe_strerror(err), k);
+                break;
+            }
+        }
+        num_thr = k;
+    } else
+        num_thr = 0;
+    if (0 == num_thr)
+        gpes_worker(cp);        /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+
+    if (do_raw) {
+        if (sg_set_binary_mode(STDOUT_FILENO) < 0)
+            perror("sg_set_binary_mode");
+    } else
+        printf("# wwn_or_device  element  type  health  assoc_lbs  "
+               "restore\n");
+    for (k = 0; k < cp->num_devs; ++k) {
+        gdp = cp->arr + k;
+        res = gdp->res;
+        if (res) {
+            sg_get_category_sense_str(res, sizeof(b), b, cp->verbose);
+            pr2serr("%s: Get physical element status: %s\n", gdp->dev_name,
+                    b);
+            if (0 == ret)
+                ret = res;
+            free(gdp->descs);
+            continue;
+        }
+        if (do_raw) {
+            sg_put_unaligned_be64(gdp->have_wwn ? gdp->wwn : 0, hdr + 0);
+            sg_put_unaligned_be32(gdp->num_desc, hdr + 8);
+            fwrite(hdr, 1, sizeof(hdr), stdout);
+            if (gdp->num_desc)
+                fwrite(gdp->descs, GPES_DESC_LEN, gdp->num_desc, stdout);
+        } else {
+            if (gdp->have_wwn)
+                snprintf(key, sizeof(key), "0x%016" PRIx64, gdp->wwn);
+            else
+                snprintf(key, sizeof(key), "%s", gdp->dev_name);
+            for (j = 0, bp = gdp->descs; j < gdp->num_desc;
+                 ++j, bp += GPES_DESC_LEN) {
+                decode_elem_status_desc(bp, &a_ped);
+                printf("%s  0x%06x  0x%x  0x%02x  ", key, a_ped.elem_id,
+                       a_ped.phys_elem_type, a_ped.phys_elem_health);
+                if (sg_all_ffs((const uint8_t *)&a_ped.assoc_cap, 8))
+                    printf("-");
+                else
+                    printf("0x%" PRIx64, a_ped.assoc_cap);
+                printf("  %d\n", (int)a_ped.restore_allowed);
+            }
+        }
+        if ((cp->num_devs > 1) || cp->verbose)
+            pr2serr("%s: %u element%s with %d command%s in %.1f ms\n",
+                    gdp->dev_name, gdp->num_desc,
+                    (1 == gdp->num_desc) ? "" : "s", gdp->num_cmds,
+                    (1 == gdp->num_cmds) ? "" : "s",
+                    (double)gdp->dur_ns / 1000000.0);
+        free(gdp->descs);
+    }
+    free(cp->arr);
+    free(tids);
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
 {
+    bool do_all = false;
     bool do_raw = false;
+    bool maxlen_given = false;
     bool no_final_msg = false;
     bool o_readonly = false;
     bool verbose_given = false;
@@ -234,6 +520,8 @@ main(int argc, char * argv[])
     int sg_fd = -1;
     int do_brief = 0;
     int do_hex = 0;
+    int num_devs = 0;
+    int num_jobs = 0;
     int resid = 0;
     int ret = 0;
     int maxlen = DEF_GPES_BUFF_LEN;
@@ -250,16 +538,20 @@ main(int argc, char * argv[])
     uint8_t * gpesBuffp = gpesBuff;
     uint8_t * free_gpesBuffp = NULL;
     struct gpes_desc_t a_ped;
+    struct gpes_coll_t coll;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "bf:hHi:m:rRs:St:TvV", long_options,
+        c = getopt_long(argc, argv, "abf:hHi:j:m:rRs:St:TvV", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'a':
+            do_all = true;
+            break;
         case 'b':
             ++do_brief;
             break;
@@ -282,6 +574,14 @@ main(int argc, char * argv[])
         case 'i':
             in_fn = optarg;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs=' should be from 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'm':
             maxlen = sg_get_num(optarg);
             if ((maxlen < 0) || (maxlen > MAX_GPES_BUFF_LEN)) {
@@ -291,6 +591,8 @@ main(int argc, char * argv[])
             }
             if (0 == maxlen)
                 maxlen = DEF_GPES_BUFF_LEN;
+            else
+                maxlen_given = true;
             break;
         case 'r':
             do_raw = true;
@@ -328,18 +630,11 @@ main(int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
-    if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
-    }
+    num_devs = argc - optind;
+    if (num_devs > 0)
+        device_name = argv[optind];
+    if (num_devs > 1)
+        do_all = true;
 
 #ifdef DEBUG
     pr2serr("In DEBUG mode, ");
@@ -362,6 +657,37 @@ main(int argc, char * argv[])
         return 0;
     }
 
+    if (do_all) {
+        if (in_fn || do_hex || do_brief) {
+            pr2serr("--inhex=, --hex and --brief can't be used with --all "
+                    "or several DEVICEs\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (NULL == device_name) {
+            pr2serr("missing device name!\n\n");
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (maxlen_given && (maxlen < (GPES_DESC_OFFSET + GPES_DESC_LEN))) {
+            pr2serr("--all needs --maxlen= of at least %d\n",
+                    GPES_DESC_OFFSET + GPES_DESC_LEN);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        memset(&coll, 0, sizeof(coll));
+        coll.readonly = o_readonly;
+        coll.filter = filter;
+        coll.rt = rt;
+        coll.maxlen = maxlen_given ? maxlen : DEF_ALL_BUFF_LEN;
+        coll.verbose = verbose;
+        coll.num_devs = num_devs;
+        coll.starting_elem = starting_elem;
+        if (0 == num_jobs)
+            num_jobs = (num_devs < DEF_MAX_JOBS) ? num_devs : DEF_MAX_JOBS;
+        else if (num_jobs > num_devs)
+            num_jobs = num_devs;
+        ret = gpes_all(&coll, argv + optind, num_jobs, do_raw);
+        goto fini;
+    }
     if (maxlen > DEF_GPES_BUFF_LEN) {
         gpesBuffp = (uint8_t *)sg_memalign(maxlen, 0, &free_gpesBuffp,
                                            verbose > 3);
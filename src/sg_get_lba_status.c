@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2019 Douglas Gilbert.
+ * Copyright (c) 2009-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -22,6 +22,9 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
@@ -32,10 +35,11 @@
  *
  *
  * This program issues the SCSI GET LBA STATUS command to the given SCSI
- * device.
+ * device. With --map=FN it walks the whole LBA space and writes a run
+ * length encoded provisioning map to FN.
  */
 
-static const char * version_str = "1.20 20190822";      /* sbc4r15 */
+static const char * version_str = "1.21 20261014";      /* sbc4r15 */
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -43,6 +47,10 @@ static const char * version_str = "1.20 20190822";      /* sbc4r15 */
 
 #define MAX_GLBAS_BUFF_LEN (1024 * 1024)
 #define DEF_GLBAS_BUFF_LEN 24
+#define MAP_GLBAS_BUFF_LEN (8 + (16 * 256))     /* --map default */
+#define GLBAS_DESC_BATCH 64                     /* decoded at a time */
+#define DEF_JOBS 4
+#define MAX_JOBS 256
 
 static uint8_t glbasFixedBuff[DEF_GLBAS_BUFF_LEN];
 
@@ -57,7 +65,9 @@ static struct option long_options[] = {
         {"hex", no_argument, 0, 'H'},
         {"in", required_argument, 0, 'i'},      /* silent, same as --inhex= */
         {"inhex", required_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
         {"lba", required_argument, 0, 'l'},
+        {"map", required_argument, 0, 'M'},
         {"maxlen", required_argument, 0, 'm'},
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
@@ -76,8 +86,10 @@ usage()
     pr2serr("Usage: sg_get_lba_status  [--16] [--32][--brief] "
             "[--element-id=EI]\n"
             "                          [--help] [--hex] [--inhex=FN] "
-            "[--lba=LBA]\n"
-            "                          [--maxlen=LEN] [--raw] [--readonly]\n"
+            "[--jobs=JOBS]\n"
+            "                          [--lba=LBA] [--map=FN] [--maxlen=LEN] "
+            "[--raw]\n"
+            "                          [--readonly]\n"
             "                          [--report-type=RT] [--scan-len=SL] "
             "[--verbose]\n"
             "                          [--version] DEVICE\n"
@@ -97,12 +109,20 @@ usage()
             "DEVICE,\n"
             "                      assumed to be ASCII hex or, if --raw, "
             "in binary\n"
+            "    --jobs=JOBS|-j JOBS    with --map=FN, number of concurrent "
+            "cursors\n"
+            "                           (def: %d)\n"
             "    --lba=LBA|-l LBA    starting LBA (logical block address) "
             "(def: 0)\n"
+            "    --map=FN|-M FN    walk from LBA to the end of DEVICE and "
+            "write a run\n"
+            "                      length provisioning map to FN ('-' for "
+            "stdout)\n"
             "    --maxlen=LEN|-m LEN    max response length (allocation "
             "length in cdb)\n"
-            "                           (def: 0 -> %d bytes)\n",
-            DEF_GLBAS_BUFF_LEN );
+            "                           (def: 0 -> %d bytes, %d with "
+            "--map=FN)\n",
+            DEF_JOBS, DEF_GLBAS_BUFF_LEN, MAP_GLBAS_BUFF_LEN);
     pr2serr("    --raw|-r          output in binary, unless if --inhex=FN "
             "is given,\n"
             "                      in which case input file is binary\n"
@@ -158,6 +178,355 @@ decode_lba_status_desc(const uint8_t * bp, uint64_t * slbap,
     return bp[12] & 0xf;
 }
 
+/* One extent of the provisioning map: ext_num blocks from ext_lba that
+ * share a provisioning status and additional status. */
+struct glbas_ext {
+    uint64_t lba;
+    uint64_t num;
+    uint8_t p_status;
+    uint8_t add_status;
+};
+
+/* A segment [start_lba, end_lba) of the LBA space walked by one cursor */
+struct glbas_seg {
+    uint64_t start_lba;
+    uint64_t end_lba;           /* one past last LBA of segment */
+    struct glbas_ext * exts;
+    int num_exts;
+    int max_exts;
+    int num_cmds;
+    int ret;
+};
+
+struct glbas_map {
+    bool do_32;
+    int sg_fd;
+    int rt;
+    int maxlen;
+    int vb;
+    uint32_t element_id;
+    uint32_t scan_len;
+    struct glbas_seg * segs;
+    int num_segs;
+    int next_seg;               /* next segment to be walked */
+    int ret;                    /* first error seen, stops other cursors */
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static void
+map_lock(struct glbas_map * mp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&mp->mtx);
+#else
+    if (mp) { ; }  /* suppress warning */
+#endif
+}
+
+static void
+map_unlock(struct glbas_map * mp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&mp->mtx);
+#else
+    if (mp) { ; }  /* suppress warning */
+#endif
+}
+
+/* Appends an extent to segment, merging it into the previous extent when
+ * they are adjacent and have the same status. Returns 0 or ENOMEM. */
+static int
+seg_add_ext(struct glbas_seg * sp, uint64_t lba, uint64_t num, int p_status,
+            int add_status)
+{
+    struct glbas_ext * ep;
+
+    if (sp->num_exts > 0) {
+        ep = sp->exts + sp->num_exts - 1;
+        if (((ep->lba + ep->num) == lba) && (ep->p_status == p_status) &&
+            (ep->add_status == add_status)) {
+            ep->num += num;
+            return 0;
+        }
+    }
+    if (sp->num_exts >= sp->max_exts) {
+        int n = sp->max_exts ? (2 * sp->max_exts) : 64;
+
+        ep = (struct glbas_ext *)realloc(sp->exts, n * sizeof(*ep));
+        if (NULL == ep)
+            return ENOMEM;
+        sp->exts = ep;
+        sp->max_exts = n;
+    }
+    ep = sp->exts + sp->num_exts++;
+    ep->lba = lba;
+    ep->num = num;
+    ep->p_status = (uint8_t)p_status;
+    ep->add_status = (uint8_t)add_status;
+    return 0;
+}
+
+/* Walks the segment with GET LBA STATUS commands, each starting at the
+ * LBA following the end of the last descriptor of the previous response.
+ * The LBA and length fields of up to GLBAS_DESC_BATCH descriptors are
+ * extracted at a time. Returns 0 if the whole segment is mapped, else an
+ * error. */
+static int
+walk_seg(struct glbas_map * mp, struct glbas_seg * sp, uint8_t * buff)
+{
+    int j, k, n, res, rlen, num_descs, p_status;
+    uint8_t add_status;
+    uint64_t d_lba, d_end, prev;
+    uint64_t cur = sp->start_lba;
+    const uint8_t * bp;
+    uint32_t d_blks[GLBAS_DESC_BATCH];
+    uint64_t d_lbas[GLBAS_DESC_BATCH];
+
+    while (cur < sp->end_lba) {
+        if (mp->ret)
+            return 0;   /* another cursor failed, give up quietly */
+        if (mp->do_32)
+            res = sg_ll_get_lba_status32(mp->sg_fd, cur, mp->element_id,
+                                         mp->scan_len, mp->rt, buff,
+                                         mp->maxlen, true, mp->vb);
+        else
+            res = sg_ll_get_lba_status16(mp->sg_fd, cur, mp->rt, buff,
+                                         mp->maxlen, true, mp->vb);
+        if (res)
+            return res;
+        ++sp->num_cmds;
+        rlen = sg_get_unaligned_be32(buff + 0) + 4;
+        if (rlen > mp->maxlen)
+            rlen = mp->maxlen;
+        num_descs = (rlen >= 24) ? ((rlen - 8) / 16) : 0;
+        prev = cur;
+        for (k = 0; (k < num_descs) && (cur < sp->end_lba); k += n) {
+            n = num_descs - k;
+            if (n > GLBAS_DESC_BATCH)
+                n = GLBAS_DESC_BATCH;
+            bp = buff + 8 + (16 * k);
+            sg_get_unaligned_be64_arr(bp + 0, 16, n, d_lbas);
+            sg_get_unaligned_be32_arr(bp + 8, 16, n, d_blks);
+            for (j = 0; j < n; ++j, bp += 16) {
+                d_lba = d_lbas[j];
+                d_end = d_lba + d_blks[j];
+                if (d_end <= cur)
+                    continue;
+                p_status = bp[12] & 0xf;
+                add_status = bp[13];
+                if (d_lba > cur) {
+                    /* hole between descriptors: status is not known */
+                    if (d_lba >= sp->end_lba)
+                        d_lba = sp->end_lba;
+                    if (seg_add_ext(sp, cur, d_lba - cur, 4, 0))
+                        return sg_convert_errno(ENOMEM);
+                    cur = d_lba;
+                    if (cur >= sp->end_lba)
+                        break;
+                }
+                if (d_end > sp->end_lba)
+                    d_end = sp->end_lba;
+                if (seg_add_ext(sp, cur, d_end - cur, p_status, add_status))
+                    return sg_convert_errno(ENOMEM);
+                cur = d_end;
+                if (cur >= sp->end_lba)
+                    break;
+            }
+        }
+        if (cur == prev) {
+            pr2serr("GET LBA STATUS at LBA 0x%" PRIx64 " made no "
+                    "progress\n", cur);
+            return SG_LIB_CAT_MALFORMED;
+        }
+    }
+    return 0;
+}
+
+/* Each cursor takes the next unwalked segment until there are none left */
+static void *
+map_worker(void * v_mp)
+{
+    int k, res;
+    uint8_t * buff;
+    uint8_t * free_buff = NULL;
+    struct glbas_map * mp = (struct glbas_map *)v_mp;
+
+    buff = (uint8_t *)sg_memalign(mp->maxlen, 0, &free_buff, false);
+    if (NULL == buff) {
+        map_lock(mp);
+        if (0 == mp->ret)
+            mp->ret = sg_convert_errno(ENOMEM);
+        map_unlock(mp);
+        return NULL;
+    }
+    while (true) {
+        map_lock(mp);
+        k = (mp->ret) ? mp->num_segs : mp->next_seg++;
+        map_unlock(mp);
+        if (k >= mp->num_segs)
+            break;
+        res = walk_seg(mp, mp->segs + k, buff);
+        if (res) {
+            map_lock(mp);
+            mp->segs[k].ret = res;
+            if (0 == mp->ret)
+                mp->ret = res;
+            map_unlock(mp);
+        }
+    }
+    free(free_buff);
+    return NULL;
+}
+
+/* Walks [start_lba, last_lba] with num_jobs concurrent cursors. Returns 0
+ * if the whole range was mapped, else the first error. */
+static int
+map_run(struct glbas_map * mp, uint64_t start_lba, uint64_t last_lba,
+        int num_jobs)
+{
+    int k;
+    uint64_t n, per;
+    struct glbas_seg * sp;
+#ifndef SG_LIB_WIN32
+    int err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    n = last_lba - start_lba + 1;
+    mp->num_segs = num_jobs;
+    if ((uint64_t)mp->num_segs > n)
+        mp->num_segs = (int)n;
+    mp->segs = (struct glbas_seg *)calloc(mp->num_segs, sizeof(*sp));
+    if (NULL == mp->segs)
+        return sg_convert_errno(ENOMEM);
+    per = n / mp->num_segs;
+    for (k = 0, sp = mp->segs; k < mp->num_segs; ++k, ++sp) {
+        sp->start_lba = start_lba + (k * per);
+        sp->end_lba = (k == (mp->num_segs - 1)) ? (last_lba + 1) :
+                                                  (sp->start_lba + per);
+    }
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&mp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, map_worker, mp))) {
+            if (mp->vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    map_worker(mp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&mp->mtx);
+#else
+    map_worker(mp);
+#endif
+    return mp->ret;
+}
+
+static void
+map_free(struct glbas_map * mp)
+{
+    int k;
+
+    if (mp->segs) {
+        for (k = 0; k < mp->num_segs; ++k)
+            free(mp->segs[k].exts);
+        free(mp->segs);
+        mp->segs = NULL;
+    }
+}
+
+static void
+map_out_ext(FILE * fp, const struct glbas_ext * ep, uint64_t * totals)
+{
+    fprintf(fp, "0x%016" PRIx64 "  0x%" PRIx64 "  %d  %d\n", ep->lba,
+            ep->num, ep->p_status, ep->add_status);
+    totals[ep->p_status & 0xf] += ep->num;
+}
+
+/* Writes the extents of all segments, joining those that continue across
+ * segment boundaries, to map_fn ("-" for stdout) then prints a summary.
+ * Returns 0 or an error. */
+static int
+map_write(struct glbas_map * mp, const char * map_fn,
+          const char * device_name, uint64_t start_lba, uint64_t last_lba)
+{
+    bool to_stdout = (0 == strcmp("-", map_fn));
+    int k, j, num_cmds;
+    uint64_t n;
+    uint64_t num_exts = 0;
+    uint64_t totals[16];
+    struct glbas_ext pend;
+    const struct glbas_ext * ep;
+    FILE * fp;
+    FILE * sum_fp;
+
+    if (to_stdout) {
+        fp = stdout;
+        sum_fp = stderr;
+    } else {
+        fp = fopen(map_fn, "w");
+        if (NULL == fp) {
+            int err = errno;
+
+            pr2serr("unable to open %s: %s\n", map_fn, safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+        sum_fp = stdout;
+    }
+    memset(totals, 0, sizeof(totals));
+    memset(&pend, 0, sizeof(pend));
+    fprintf(fp, "# provisioning map of %s, LBA 0x%" PRIx64 " to 0x%" PRIx64
+            "\n# <lba_hex> <blocks_hex> <p_status> <add_status>\n",
+            device_name, start_lba, last_lba);
+    for (k = 0, num_cmds = 0; k < mp->num_segs; ++k) {
+        num_cmds += mp->segs[k].num_cmds;
+        for (j = 0, ep = mp->segs[k].exts; j < mp->segs[k].num_exts;
+             ++j, ++ep) {
+            if (pend.num && ((pend.lba + pend.num) == ep->lba) &&
+                (pend.p_status == ep->p_status) &&
+                (pend.add_status == ep->add_status)) {
+                pend.num += ep->num;
+                continue;
+            }
+            if (pend.num) {
+                map_out_ext(fp, &pend, totals);
+                ++num_exts;
+            }
+            pend = *ep;
+        }
+    }
+    if (pend.num) {
+        map_out_ext(fp, &pend, totals);
+        ++num_exts;
+    }
+    if (! to_stdout) {
+        if (fclose(fp)) {
+            int err = errno;
+
+            pr2serr("close error on %s: %s\n", map_fn, safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+    }
+    n = last_lba - start_lba + 1;
+    fprintf(sum_fp, "Provisioning map: %" PRIu64 " blocks in %" PRIu64
+            " extents from %d GET LBA STATUS commands\n", n, num_exts,
+            num_cmds);
+    fprintf(sum_fp, "  mapped:       %" PRIu64 " blocks (%.1f%%)\n",
+            totals[0] + totals[3], 100.0 * (totals[0] + totals[3]) / n);
+    fprintf(sum_fp, "  deallocated:  %" PRIu64 " blocks (%.1f%%)\n",
+            totals[1], 100.0 * totals[1] / n);
+    fprintf(sum_fp, "  anchored:     %" PRIu64 " blocks (%.1f%%)\n",
+            totals[2], 100.0 * totals[2] / n);
+    n -= totals[0] + totals[1] + totals[2] + totals[3];
+    if (n)
+        fprintf(sum_fp, "  other:        %" PRIu64 " blocks\n", n);
+    return 0;
+}
 
 int
 main(int argc, char * argv[])
@@ -166,6 +535,7 @@ main(int argc, char * argv[])
     bool do_32 = false;
     bool do_raw = false;
     bool no_final_msg = false;
+    bool maxlen_given = false;
     bool o_readonly = false;
     bool verbose_given = false;
     bool version_given = false;
@@ -175,6 +545,7 @@ main(int argc, char * argv[])
     int do_hex = 0;
     int ret = 0;
     int maxlen = DEF_GLBAS_BUFF_LEN;
+    int num_jobs = DEF_JOBS;
     int rt = 0;
     int verbose = 0;
     uint8_t add_status = 0;     /* keep gcc quiet */
@@ -186,6 +557,7 @@ main(int argc, char * argv[])
     uint64_t lba = 0;
     const char * device_name = NULL;
     const char * in_fn = NULL;
+    const char * map_fn = NULL;
     const uint8_t * bp;
     uint8_t * glbasBuffp = glbasFixedBuff;
     uint8_t * free_glbasBuffp = NULL;
@@ -193,7 +565,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "be:hi:Hl:m:rRs:St:TvV", long_options,
+        c = getopt_long(argc, argv, "be:hi:Hj:l:m:M:rRs:St:TvV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -220,6 +592,14 @@ main(int argc, char * argv[])
         case 'i':
             in_fn = optarg;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs' should be from 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             ll = sg_get_llnum(optarg);
             if (-1 == ll) {
@@ -237,6 +617,11 @@ main(int argc, char * argv[])
             }
             if (0 == maxlen)
                 maxlen = DEF_GLBAS_BUFF_LEN;
+            else
+                maxlen_given = true;
+            break;
+        case 'M':
+            map_fn = optarg;
             break;
         case 'r':
             do_raw = true;
@@ -313,6 +698,24 @@ main(int argc, char * argv[])
         return 0;
     }
 
+    if (map_fn) {
+        if (in_fn) {
+            pr2serr("--map=FN needs DEVICE, it cannot be used with "
+                    "--inhex=FN\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (! maxlen_given)
+            maxlen = MAP_GLBAS_BUFF_LEN;
+        else if (maxlen < 24) {
+            pr2serr("--map=FN needs --maxlen=LEN of 24 or more\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (rt) {
+            pr2serr("--map=FN needs all LBAs reported, ignoring "
+                    "--report-type=%d\n", rt);
+            rt = 0;
+        }
+    }
     if (maxlen > DEF_GLBAS_BUFF_LEN) {
         glbasBuffp = (uint8_t *)sg_memalign(maxlen, 0, &free_glbasBuffp,
                                             verbose > 3);
@@ -386,6 +789,48 @@ main(int argc, char * argv[])
         goto fini;
     }
 
+    if (map_fn) {
+        uint64_t last_lba;
+        const struct sg_ds_cap * cp;
+        struct sg_dev_sess ds;
+        struct glbas_map a_map;
+
+        sg_ds_init(&ds, sg_fd, verbose);
+        ret = sg_ds_get_cap(&ds, &cp);
+        if (SG_LIB_CAT_UNIT_ATTENTION == ret)
+            ret = sg_ds_get_cap(&ds, &cp);
+        if (ret) {
+            if (ret < 0)
+                ret = sg_convert_errno(-ret);
+            pr2serr("Read capacity failed\n");
+            goto fini;
+        }
+        last_lba = cp->num_blocks - 1;
+        if (lba > last_lba) {
+            pr2serr("--lba=0x%" PRIx64 " is past the last LBA (0x%" PRIx64
+                    ")\n", lba, last_lba);
+            ret = SG_LIB_LBA_OUT_OF_RANGE;
+            goto fini;
+        }
+        memset(&a_map, 0, sizeof(a_map));
+        a_map.do_32 = do_32;
+        a_map.sg_fd = sg_fd;
+        a_map.rt = rt;
+        a_map.maxlen = maxlen;
+        a_map.vb = verbose;
+        a_map.element_id = element_id;
+        a_map.scan_len = scan_len;
+        res = map_run(&a_map, lba, last_lba, num_jobs);
+        if (0 == res)
+            ret = map_write(&a_map, map_fn, device_name, lba, last_lba);
+        map_free(&a_map);
+        if (res) {
+            ret = res;
+            goto error;
+        }
+        goto fini;
+    }
+
     res = 0;
     if (do_16)
         res = sg_ll_get_lba_status16(sg_fd, lba, rt, glbasBuffp, maxlen, true,
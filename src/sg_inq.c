@@ -1,5 +1,5 @@
 /* A utility program originally written for the Linux OS SCSI subsystem.
- * Copyright (C) 2000-2019 D. Gilbert
+ * Copyright (C) 2000-2026 D. Gilbert
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2, or (at your option)
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
 #include <ctype.h>
 #include <getopt.h>
@@ -41,17 +42,25 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#define SG_INQ_MULTI 1          /* several DEVICEs, each in a child process */
+#include <glob.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_cmds_basic.h"
 #include "sg_pt.h"
 #include "sg_unaligned.h"
+#include "sg_json.h"
 #include "sg_pr2serr.h"
 #if (HAVE_NVME && (! IGNORE_NVME))
 #include "sg_pt_nvme.h"
 #endif
 
-static const char * version_str = "2.02 20190815";    /* SPC-5 rev 22 */
+static const char * version_str = "2.04 20261014";    /* SPC-5 rev 22 */
 
 /* INQUIRY notes:
  * It is recommended that the initial allocation length given to a
@@ -112,6 +121,7 @@ static const char * version_str = "2.02 20190815";    /* SPC-5 rev 22 */
 #ifndef SG_NVME_VPD_NICR
 #define SG_NVME_VPD_NICR 0xde
 #endif
+#define NVME_ENUM_QD 8          /* Identify namespace commands in flight */
 
 #define VPD_NOPE_WANT_STD_INQ -2        /* request for standard inquiry */
 
@@ -136,6 +146,8 @@ static const char * version_str = "2.02 20190815";    /* SPC-5 rev 22 */
 #define INQUIRY_CMD     0x12
 #define INQUIRY_CMDLEN  6
 #define DEF_PT_TIMEOUT  60       /* 60 seconds */
+#define DEF_JOBS 16             /* when given several DEVICEs */
+#define MAX_JOBS 256
 
 
 static uint8_t * rsp_buff;
@@ -235,6 +247,8 @@ static struct option long_options[] = {
         {"hex", no_argument, 0, 'H'},
         {"id", no_argument, 0, 'i'},
         {"inhex", required_argument, 0, 'I'},
+        {"jobs", required_argument, 0, 'j'},
+        {"json", no_argument, 0, 'J'},
         {"len", required_argument, 0, 'l'},
         {"long", no_argument, 0, 'L'},
         {"maxlen", required_argument, 0, 'm'},
@@ -268,6 +282,7 @@ struct opts_t {
     int do_cmddt;
     int do_help;
     int do_hex;
+    int do_json;        /* twice: pretty printed */
     int do_long;
     int do_raw;
     int do_vendor;
@@ -276,9 +291,13 @@ struct opts_t {
     int page_num;
     int page_pdt;
     int num_pages;
+    int jobs;           /* maximum child processes with several DEVICEs */
+    int num_devs;
     const char * page_arg;
     const char * device_name;
+    const char ** dev_names;    /* num_devs of them, after glob expansion */
     const char * inhex_fn;
+    struct sgj_state * jsp;     /* with --json */
 #ifdef SG_SCSI_STRINGS
     bool opt_new;
 #endif
@@ -294,11 +313,12 @@ usage()
     pr2serr("Usage: sg_inq [--ata] [--block=0|1] [--cmddt] [--descriptors] "
             "[--export]\n"
             "              [--extended] [--help] [--hex] [--id] [--inhex=FN] "
-            "[--len=LEN]\n"
-            "              [--long] [--maxlen=LEN] [--only] [--page=PG] "
-            "[--raw]\n"
-            "              [--vendor] [--verbose] [--version] [--vpd] "
-            "DEVICE\n"
+            "[--jobs=JOBS]\n"
+            "              [--json] [--len=LEN] [--long] [--maxlen=LEN] "
+            "[--only]\n"
+            "              [--page=PG] [--raw] [--vendor] [--verbose] "
+            "[--version] [--vpd]\n"
+            "              DEVICE [DEVICE...]\n"
             "  where:\n"
             "    --ata|-a        treat DEVICE as (directly attached) ATA "
             "device\n");
@@ -306,10 +326,12 @@ usage()
     pr2serr("Usage: sg_inq [--block=0|1] [--cmddt] [--descriptors] "
             "[--export]\n"
             "              [--extended] [--help] [--hex] [--id] [--inhex=FN] "
-            "[--len=LEN]\n"
-            "              [--long] [--maxlen=LEN] [--only] [--page=PG] "
-            "[--raw]\n"
-            "              [--verbose] [--version] [--vpd] DEVICE\n"
+            "[--jobs=JOBS]\n"
+            "              [--json] [--len=LEN] [--long] [--maxlen=LEN] "
+            "[--only]\n"
+            "              [--page=PG] [--raw] [--verbose] [--version] "
+            "[--vpd]\n"
+            "              DEVICE [DEVICE...]\n"
             "  where:\n");
 #endif
     pr2serr("    --block=0|1     0-> open(non-blocking); 1-> "
@@ -337,6 +359,12 @@ usage()
             "DEVICE;\n"
             "                        if used with --raw then read binary "
             "from FN\n"
+            "    --jobs=JOBS|-j JOBS    with several DEVICEs, the most "
+            "queried at\n"
+            "                           once (def: %d)\n"
+            "    --json|-J       output standard INQUIRY response as a "
+            "line of JSON\n"
+            "                    (twice: indented)\n"
             "    --len=LEN|-l LEN    requested response length (def: 0 "
             "-> fetch 36\n"
             "                        bytes first, then fetch again as "
@@ -363,7 +391,10 @@ usage()
             "response\nheld in file FN. If no options given then does a "
             "'standard' INQUIRY.\nCan list VPD pages with '--vpd' or "
             "'--page=PG' option. The sg_vpd\nand sdparm utilities decode "
-            "more VPD pages than this utility.\n");
+            "more VPD pages than this utility. With\nseveral DEVICEs (or "
+            "a pattern like '/dev/sg*') they are queried in\nparallel and "
+            "each output line is prefixed by its DEVICE name\n(not with "
+            "--json).\n", DEF_JOBS);
 }
 
 #ifdef SG_SCSI_STRINGS
@@ -447,6 +478,50 @@ usage_for(const struct opts_t * op)
 
 #endif /* SG_SCSI_STRINGS */
 
+/* Appends name to op->dev_names. If name contains a wildcard (e.g.
+ * '/dev/sg*' quoted from the shell) it is replaced by the matching
+ * pathnames, if any. Returns 0 if ok, else -1 . */
+static int
+add_dev_name(struct opts_t * op, const char * name)
+{
+    int k, n;
+    const char ** npp;
+#ifdef SG_INQ_MULTI
+    glob_t gl;
+
+    memset(&gl, 0, sizeof(gl));
+    if (strpbrk(name, "*?[") && (0 == glob(name, 0, NULL, &gl)))
+        n = gl.gl_pathc;
+    else
+#endif
+        n = 1;
+    npp = (const char **)realloc(op->dev_names,
+                                 (op->num_devs + n) * sizeof(*npp));
+    if (NULL == npp) {
+        pr2serr("%s: out of memory\n", __func__);
+        return -1;
+    }
+    op->dev_names = npp;
+    npp += op->num_devs;
+#ifdef SG_INQ_MULTI
+    if (gl.gl_pathc > 0) {
+        for (k = 0; k < n; ++k) {
+            npp[k] = strdup(gl.gl_pathv[k]);
+            if (NULL == npp[k]) {
+                pr2serr("%s: out of memory\n", __func__);
+                globfree(&gl);
+                return -1;
+            }
+        }
+        globfree(&gl);
+    } else
+#endif
+        for (k = 0; k < n; ++k)
+            npp[k] = name;
+    op->num_devs += n;
+    return 0;
+}
+
 /* Processes command line options according to new option format. Returns
  * 0 is ok, else SG_LIB_SYNTAX_ERROR is returned. */
 static int
@@ -459,18 +534,18 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
 
 #ifdef SG_LIB_LINUX
 #ifdef SG_SCSI_STRINGS
-        c = getopt_long(argc, argv, "aB:cdeEfhHiI:l:Lm:NoOp:rsuvVx",
+        c = getopt_long(argc, argv, "aB:cdeEfhHiI:j:Jl:Lm:NoOp:rsuvVx",
                         long_options, &option_index);
 #else
-        c = getopt_long(argc, argv, "B:cdeEfhHiI:l:Lm:op:rsuvVx",
+        c = getopt_long(argc, argv, "B:cdeEfhHiI:j:Jl:Lm:op:rsuvVx",
                         long_options, &option_index);
 #endif /* SG_SCSI_STRINGS */
 #else  /* SG_LIB_LINUX */
 #ifdef SG_SCSI_STRINGS
-        c = getopt_long(argc, argv, "B:cdeEfhHiI:l:Lm:NoOp:rsuvVx",
+        c = getopt_long(argc, argv, "B:cdeEfhHiI:j:Jl:Lm:NoOp:rsuvVx",
                         long_options, &option_index);
 #else
-        c = getopt_long(argc, argv, "B:cdeEfhHiI:l:Lm:op:rsuvVx",
+        c = getopt_long(argc, argv, "B:cdeEfhHiI:j:Jl:Lm:op:rsuvVx",
                         long_options, &option_index);
 #endif /* SG_SCSI_STRINGS */
 #endif /* SG_LIB_LINUX */
@@ -538,6 +613,19 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'I':
             op->inhex_fn = optarg;
             break;
+        case 'j':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs=', expect 1 to %d\n",
+                        MAX_JOBS);
+                usage_for(op);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->jobs = n;
+            break;
+        case 'J':
+            ++op->do_json;
+            break;
         case 'l':
         case 'm':
             n = sg_get_num(optarg);
@@ -586,18 +674,19 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
-    if (optind < argc) {
-        if (NULL == op->device_name) {
-            op->device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage_for(op);
+    for (; optind < argc; ++optind) {
+        if (add_dev_name(op, argv[optind]))
             return SG_LIB_SYNTAX_ERROR;
-        }
     }
+#ifndef SG_INQ_MULTI
+    if (op->num_devs > 1) {
+        pr2serr("Unexpected extra argument: %s\n", op->dev_names[1]);
+        usage_for(op);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+#endif
+    if ((NULL == op->device_name) && (op->num_devs > 0))
+        op->device_name = op->dev_names[0];
     return 0;
 }
 
@@ -823,13 +912,19 @@ parse_cmd_line(struct opts_t * op, int argc, char * argv[])
 static const struct svpd_values_name_t *
 sdp_find_vpd_by_acron(const char * ap)
 {
-    const struct svpd_values_name_t * vnp;
-
-    for (vnp = vpd_pg; vnp->acron; ++vnp) {
-        if (0 == strcmp(vnp->acron, ap))
-            return vnp;
-    }
-    return NULL;
+    int k;
+    static struct sg_lib_acron_idx acron_idx;
+    static struct sg_lib_acron_ent
+                acron_ent_arr[SG_ARRAY_SIZE(vpd_pg)];
+
+    if (NULL == acron_idx.arr)   /* built on first use */
+        sg_lib_acron_idx_build(&acron_idx, acron_ent_arr, vpd_pg,
+                               SG_ARRAY_SIZE(vpd_pg),
+                               sizeof(vpd_pg[0]),
+                               offsetof(struct svpd_values_name_t, acron),
+                               false);
+    k = sg_lib_acron_idx_find(&acron_idx, ap);
+    return (k < 0) ? NULL : (vpd_pg + acron_ent_arr[k].ind);
 }
 
 static void
@@ -2755,6 +2850,71 @@ get_ansi_version_str(int version, char * buff, int buff_len)
     return buff;
 }
 
+/* Implements --json for a standard INQUIRY response. Field names follow
+ * the acronyms in SPC; the T10 strings have trailing spaces removed. */
+static void
+std_inq_json(const struct opts_t * op, int act_len)
+{
+    int k, vd;
+    const uint8_t * rp = rsp_buff;
+    struct sgj_state * jsp = op->jsp;
+    char b[48];
+
+    sgj_begin_obj(jsp, NULL);
+    if (op->device_name)
+        sgj_add_str(jsp, "device", op->device_name);
+    sgj_add_uint(jsp, "peripheral_qualifier", (rp[0] & 0xe0) >> 5);
+    sgj_add_uint(jsp, "peripheral_device_type", rp[0] & 0x1f);
+    sgj_add_str(jsp, "peripheral_device_type_name",
+                sg_get_pdt_str(rp[0] & 0x1f, sizeof(b), b));
+    if (act_len < 8)
+        goto fini;
+    sgj_add_bool(jsp, "rmb", !!(rp[1] & 0x80));
+    sgj_add_bool(jsp, "lu_cong", !!(rp[1] & 0x40));
+    sgj_add_uint(jsp, "version", rp[2]);
+    sgj_add_bool(jsp, "normaca", !!(rp[3] & 0x20));
+    sgj_add_bool(jsp, "hisup", !!(rp[3] & 0x10));
+    sgj_add_uint(jsp, "response_data_format", rp[3] & 0x0f);
+    sgj_add_uint(jsp, "additional_length", rp[4]);
+    sgj_add_bool(jsp, "sccs", !!(rp[5] & 0x80));
+    sgj_add_bool(jsp, "acc", !!(rp[5] & 0x40));
+    sgj_add_uint(jsp, "tpgs", (rp[5] & 0x30) >> 4);
+    sgj_add_bool(jsp, "3pc", !!(rp[5] & 0x08));
+    sgj_add_bool(jsp, "protect", !!(rp[5] & 0x01));
+    sgj_add_bool(jsp, "encserv", !!(rp[6] & 0x40));
+    sgj_add_bool(jsp, "multip", !!(rp[6] & 0x10));
+    sgj_add_bool(jsp, "cmdque", !!(rp[7] & 0x02));
+    if (act_len > 8)
+        sgj_add_strn(jsp, "t10_vendor_identification", (const char *)rp + 8,
+                     (act_len < 16) ? (act_len - 8) : 8);
+    if (act_len > 16)
+        sgj_add_strn(jsp, "product_identification", (const char *)rp + 16,
+                     (act_len < 32) ? (act_len - 16) : 16);
+    if (act_len > 32)
+        sgj_add_strn(jsp, "product_revision_level", (const char *)rp + 32,
+                     (act_len < 36) ? (act_len - 32) : 4);
+    if (op->do_vendor && (act_len > 36))
+        sgj_add_strn(jsp, "vendor_specific", (const char *)rp + 36,
+                     (act_len < 56) ? (act_len - 36) : 20);
+    if ((0 == op->resp_len) && usn_buff[0])
+        sgj_add_str(jsp, "unit_serial_number", usn_buff);
+    if (op->do_descriptors) {
+        sgj_begin_arr(jsp, "version_descriptors");
+        for (k = 58; (k < 74) && ((k + 1) < act_len); k += 2) {
+            vd = sg_get_unaligned_be16(rp + k);
+            if (0 == vd)
+                break;
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_uint(jsp, "code", vd);
+            sgj_add_str(jsp, "name", find_version_descriptor_str(vd));
+            sgj_end_obj(jsp);
+        }
+        sgj_end_arr(jsp);
+    }
+fini:
+    sgj_end_obj(jsp);
+}
+
 static void
 std_inq_decode(const struct opts_t * op, int act_len)
 {
@@ -2773,6 +2933,9 @@ std_inq_decode(const struct opts_t * op, int act_len)
         /* with -H, print with address, -HH without */
         hex2stdout(rp, act_len, ((1 == op->do_hex) ? 0 : -1));
         return;
+    } else if (op->jsp) {
+        std_inq_json(op, act_len);
+        return;
     }
     pqual = (rp[0] & 0xe0) >> 5;
     if (! op->do_raw && ! op->do_export) {
@@ -4030,7 +4193,33 @@ skip1:
         if (ret)
             goto err_out;
 
-    } else {        /* nsid=0 so char device; loop over all namespaces */
+    } else if (! (op->do_raw || op->do_hex)) {
+        /* nsid=0 so char device; fetch all namespaces with several
+         * Identify commands in flight, the controller is not re-read */
+        struct sg_pt_nvme_enum ns_enum;
+
+        ret = sg_pt_nvme_enum_ns(pt_fd, &ns_enum, NVME_ENUM_QD,
+                                 0 /* timeout (def: 1 min) */, vb);
+        if (ret) {
+            if (vb)
+                pr2serr("%s: namespace enumeration failed [%d], one at a "
+                        "time\n", __func__, ret);
+            sg_pt_nvme_enum_free(&ns_enum);
+            goto one_at_a_time;
+        }
+        for (k = 0; k < (uint32_t)ns_enum.num_ns; ++k) {
+            const struct sg_pt_nvme_ns * np = ns_enum.nsp + k;
+
+            printf("  Namespace %u (of %u):\n", np->nsid, max_nsid);
+            if (np->status)
+                printf("    Identify namespace failed, status=%d\n",
+                       np->status);
+            else
+                show_nvme_id_ns(np->id_nsp, op->do_long);
+        }
+        sg_pt_nvme_enum_free(&ns_enum);
+    } else {
+one_at_a_time:
         for (k = 1; k <= max_nsid; ++k) {
             if ((! op->do_raw) || (op->do_hex < 3))
                 printf("  Namespace %u (of %u):\n", k, max_nsid);
@@ -4050,6 +4239,137 @@ err_out:
 }
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) */
 
+#ifdef SG_INQ_MULTI
+
+struct inq_mdev_t {
+    bool done;
+    pid_t pid;
+    int ret;            /* child's exit status (or SG_LIB_CAT_OTHER) */
+    const char * name;
+    FILE * out_fp;      /* child's stdout */
+    FILE * err_fp;      /* child's stderr */
+};
+
+/* Copies the lines in fp to to_fp, each prefixed with name (unless it is
+ * NULL), then closes fp. */
+static void
+mdev_copy_out(FILE * fp, FILE * to_fp, const char * name)
+{
+    bool bol = true;    /* at the beginning of a line */
+    int len;
+    char b[1024];
+
+    if (NULL == fp)
+        return;
+    rewind(fp);
+    while (fgets(b, sizeof(b), fp)) {
+        len = strlen(b);
+        if (bol && name)
+            fprintf(to_fp, "%s: ", name);
+        fputs(b, to_fp);
+        bol = ((len > 0) && ('\n' == b[len - 1]));
+    }
+    if (! bol)
+        fputc('\n', to_fp);
+    fclose(fp);
+}
+
+/* Runs the rest of this utility for each of op->dev_names in a child
+ * process, with at most op->jobs at a time. Children write to temporary
+ * files which are copied out in DEVICE order as soon as the earlier ones
+ * are done. In each child this function returns with *is_childp set and
+ * op->device_name pointing at its DEVICE. In the parent it returns the
+ * exit status of the first DEVICE (in order) that failed, else 0. */
+static int
+multi_dev_inq(struct opts_t * op, bool * is_childp)
+{
+    int k, status, first, next, running, window;
+    int ret = 0;
+    pid_t pid;
+    struct inq_mdev_t * arr;
+    struct inq_mdev_t * mdp;
+
+    *is_childp = false;
+    arr = (struct inq_mdev_t *)calloc(op->num_devs, sizeof(*arr));
+    if (NULL == arr) {
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    /* bounds the temporary files held waiting for a slow DEVICE */
+    window = 4 * op->jobs;
+    if (op->verbose)
+        pr2serr("querying %d DEVICEs, up to %d at a time\n", op->num_devs,
+                op->jobs);
+    fflush(stdout);
+    fflush(stderr);
+    for (first = 0, next = 0, running = 0; first < op->num_devs; ) {
+        while ((next < op->num_devs) && (running < op->jobs) &&
+               ((next - first) < window)) {
+            mdp = arr + next++;
+            mdp->name = op->dev_names[next - 1];
+            mdp->out_fp = tmpfile();
+            mdp->err_fp = tmpfile();
+            if ((NULL == mdp->out_fp) || (NULL == mdp->err_fp)) {
+                pr2serr("%s: tmpfile: %s\n", mdp->name, safe_strerror(errno));
+                mdp->ret = SG_LIB_FILE_ERROR;
+                mdp->done = true;
+                continue;
+            }
+            pid = fork();
+            if (0 == pid) {     /* child */
+                if ((dup2(fileno(mdp->out_fp), STDOUT_FILENO) < 0) ||
+                    (dup2(fileno(mdp->err_fp), STDERR_FILENO) < 0))
+                    exit(SG_LIB_FILE_ERROR);
+                op->device_name = mdp->name;
+                *is_childp = true;
+                free(arr);
+                return 0;
+            } else if (pid < 0) {
+                pr2serr("%s: fork: %s\n", mdp->name, safe_strerror(errno));
+                mdp->ret = sg_convert_errno(errno);
+                mdp->done = true;
+                continue;
+            }
+            mdp->pid = pid;
+            ++running;
+        }
+        for ( ; (first < next) && arr[first].done; ++first) {
+            mdp = arr + first;
+            /* JSON output from a child already names its DEVICE */
+            mdev_copy_out(mdp->out_fp, stdout,
+                          (op->do_json ? NULL : mdp->name));
+            fflush(stdout);
+            mdev_copy_out(mdp->err_fp, stderr, mdp->name);
+            if ((0 == ret) && mdp->ret)
+                ret = mdp->ret;
+        }
+        if (running < 1)
+            continue;
+        pid = wait(&status);
+        if (pid < 0) {
+            if (EINTR == errno)
+                continue;
+            pr2serr("wait: %s\n", safe_strerror(errno));
+            ret = sg_convert_errno(errno);
+            break;
+        }
+        for (k = first; k < next; ++k) {
+            mdp = arr + k;
+            if ((pid == mdp->pid) && (! mdp->done)) {
+                mdp->ret = WIFEXITED(status) ? WEXITSTATUS(status) :
+                                               SG_LIB_CAT_OTHER;
+                mdp->done = true;
+                --running;
+                break;
+            }
+        }
+    }
+    free(arr);
+    return ret;
+}
+
+#endif          /* SG_INQ_MULTI */
+
 
 int
 main(int argc, char * argv[])
@@ -4061,12 +4381,14 @@ main(int argc, char * argv[])
     const struct svpd_values_name_t * vnp;
     struct opts_t opts;
     struct opts_t * op;
+    struct sgj_state json_st;
 
     op = &opts;
     memset(op, 0, sizeof(opts));
     op->page_num = -1;
     op->page_pdt = -1;
     op->do_block = -1;         /* use default for OS */
+    op->jobs = DEF_JOBS;
     res = parse_cmd_line(op, argc, argv);
     if (res)
         return SG_LIB_SYNTAX_ERROR;
@@ -4304,6 +4626,22 @@ main(int argc, char * argv[])
         ret = SG_LIB_CONTRADICT;
         goto err_out;
     }
+    if (op->do_json) {
+        if (op->do_vpd || op->do_cmddt || op->do_ata || op->do_export ||
+            op->do_hex || op->do_raw) {
+            pr2serr("--json is only for the standard INQUIRY response (see "
+                    "sg_vpd for\nVPD pages) and not with --hex, --raw or "
+                    "--export\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        if (sgj_init(&json_st, STDOUT_FILENO, (op->do_json > 1))) {
+            pr2serr("Unable to allocate JSON output buffer\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto err_out;
+        }
+        op->jsp = &json_st;
+    }
 
     if (op->do_raw) {
         if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
@@ -4333,6 +4671,23 @@ main(int argc, char * argv[])
             goto err_out;
         }
     }
+#ifdef SG_INQ_MULTI
+    if (op->num_devs > 1) {
+        bool is_child;
+
+        if (op->do_raw) {
+            pr2serr("Can't use '--raw' with more than one DEVICE\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        ret = multi_dev_inq(op, &is_child);
+        if (! is_child) {
+            if (free_rsp_buff)
+                free(free_rsp_buff);
+            return ret;
+        }
+    }
+#endif
 
 #if defined(O_NONBLOCK) && defined(O_RDONLY)
     if (op->do_block >= 0) {
@@ -4378,6 +4733,12 @@ main(int argc, char * argv[])
                 op->page_given);
     if ((3 == n) || (4 == n)) {   /* NVMe char or NVMe block */
         op->possible_nvme = true;
+        if (op->jsp) {
+            pr2serr("%s: --json does not support NVMe devices\n",
+                    op->device_name);
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
         if (! op->page_given) {
             ret = do_nvme_identify_ctrl(sg_fd, op);
             goto fini2;
@@ -4432,6 +4793,8 @@ fini3:
 #endif
 
 err_out:
+    if (op->jsp && sgj_fini(op->jsp) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
     if (free_rsp_buff)
         free(free_rsp_buff);
     if ((0 == op->verbose) && (! op->do_export)) {
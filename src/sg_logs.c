@@ -1,5 +1,5 @@
 /* A utility program originally written for the Linux OS SCSI subsystem.
- *  Copyright (C) 2000-2019 D. Gilbert
+ *  Copyright (C) 2000-2026 D. Gilbert
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation; either version 2, or (at your option)
@@ -19,24 +19,32 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 #include <ctype.h>
 #include <getopt.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/time.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #ifdef SG_LIB_WIN32
 #include "sg_pt.h"      /* needed for scsi_pt_win32_direct() */
 #endif
 #include "sg_unaligned.h"
+#include "sg_json.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.77 20190822";    /* spc5r22 + sbc4r17 */
+static const char * version_str = "1.78 20261014";    /* spc5r22 + sbc4r17 */
 
 #define MX_ALLOC_LEN (0xfffc)
 #define SHORT_RESP_LEN 128
@@ -107,8 +115,14 @@ static const char * version_str = "1.77 20190822";    /* spc5r22 + sbc4r17 */
 #define PCB_STR_LEN 128
 
 #define LOG_SENSE_PROBE_ALLOC_LEN 4
+/* --param=PC: page header plus largest single parameter, made even */
+#define LOG_PARAM_ALLOC_LEN (4 + 4 + 256)
 #define LOG_SENSE_DEF_TIMEOUT 64        /* seconds */
 
+#define SNAP_DEV_HDR_LEN 40     /* --collect device record, less name */
+#define DEF_COLLECT_JOBS 16
+#define MAX_COLLECT_JOBS 256
+
 static uint8_t * rsp_buff;
 static uint8_t * free_rsp_buff;
 static const int rsp_buff_sz = MX_ALLOC_LEN + 4;
@@ -118,13 +132,18 @@ static struct option long_options[] = {
         {"All", no_argument, 0, 'A'},   /* equivalent to '-aa' */
         {"all", no_argument, 0, 'a'},
         {"brief", no_argument, 0, 'b'},
+        {"cbor", no_argument, 0, 'y'},
+        {"collect", required_argument, 0, 'C'},
         {"control", required_argument, 0, 'c'},
+        {"delta", required_argument, 0, 'd'},
         {"enumerate", no_argument, 0, 'e'},
         {"filter", required_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
         {"in", required_argument, 0, 'i'},
         {"inhex", required_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
+        {"json", no_argument, 0, 'J'},
         {"list", no_argument, 0, 'l'},
         {"maxlen", required_argument, 0, 'm'},
         {"name", no_argument, 0, 'n'},
@@ -133,6 +152,7 @@ static struct option long_options[] = {
         {"no-inq", no_argument, 0, 'x'},
         {"old", no_argument, 0, 'O'},
         {"page", required_argument, 0, 'p'},
+        {"param", required_argument, 0, 'k'},
         {"paramp", required_argument, 0, 'P'},
         {"pcb", no_argument, 0, 'q'},
         {"ppc", no_argument, 0, 'Q'},
@@ -144,6 +164,7 @@ static struct option long_options[] = {
         {"select", no_argument, 0, 'S'},
         {"temperature", no_argument, 0, 't'},
         {"transport", no_argument, 0, 'T'},
+        {"values", no_argument, 0, 'u'},
         {"vendor", required_argument, 0, 'M'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -151,6 +172,7 @@ static struct option long_options[] = {
 };
 
 struct opts_t {
+    bool do_cbor;       /* --json output as CBOR */
     bool do_name;
     bool do_pcb;
     bool do_ppc;
@@ -160,9 +182,11 @@ struct opts_t {
     bool do_sp;
     bool do_temperature;
     bool do_transport;
+    bool do_values;
     bool filter_given;
     bool o_readonly;
     bool opt_new;
+    bool param_given;   /* --param=PC */
     bool verbose_given;
     bool version_given;
     int do_all;
@@ -170,24 +194,32 @@ struct opts_t {
     int do_enumerate;
     int do_help;
     int do_hex;
+    int do_json;        /* twice: pretty printed */
     int do_list;
     int vend_prod_num;  /* one of the VP_* constants or -1 (def) */
     int deduced_vpn;    /* deduced vendor_prod_num; from INQUIRY, etc */
     int verbose;
+    int jobs;           /* --collect threads (def: 0 -> DEF_COLLECT_JOBS) */
+    int num_devs;       /* of DEVICEs in dev_names */
     int filter;
     int page_control;
     int maxlen;
     int pg_code;
     int subpg_code;
     int paramp;
+    int param_pc;       /* with --param=PC */
     int no_inq;
     int dev_pdt;        /* from device or --pdt=DT */
     int decod_subpg_code;
     const char * device_name;
+    const char ** dev_names;    /* with --collect may be more than one */
+    const char * collect_fn;
+    const char * delta_fn;
     const char * in_fn;
     const char * pg_arg;
     const char * vend_prod;
     const struct log_elem * lep;
+    struct sgj_state * jsp;     /* with --json */
 };
 
 
@@ -314,7 +346,7 @@ static bool show_hgst_misc_page(const uint8_t * resp, int len,
                                 const struct opts_t * op);
 
 /* elements in page_number/subpage_number order */
-static struct log_elem log_arr[] = {
+static const struct log_elem log_arr[] = {
     {SUPP_PAGES_LPAGE, 0, 0, -1, MVP_STD, "Supported log pages", "sp",
      show_supported_pgs_page},          /* 0, 0 */
     {SUPP_PAGES_LPAGE, SUPP_SPGS_SUBPG, 0, -1, MVP_STD, "Supported log pages "
@@ -464,7 +496,7 @@ static struct log_elem log_arr[] = {
 
 /* Supported vendor product codes */
 /* Arrange in alphabetical order by acronym */
-static struct vp_name_t vp_arr[] = {
+static const struct vp_name_t vp_arr[] = {
     {VP_SEAG, "sea", "Seagate", "SEAGATE", NULL},
     {VP_HITA, "hit", "Hitachi", "HGST", NULL},
     {VP_HITA, "wdc", "WDC/Hitachi", "WDC", NULL},
@@ -490,18 +522,20 @@ usage(int hval)
 {
     if (1 == hval) {
         pr2serr(
-           "Usage: sg_logs [-All] [--all] [--brief] [--control=PC] "
-           "[--enumerate]\n"
-           "               [--filter=FL] [--help] [--hex] [--in=FN] "
-           "[--list]\n"
-           "               [--no_inq] [--maxlen=LEN] [--name] [--page=PG]\n"
-           "               [--paramp=PP] [--pcb] [--ppc] [--pdt=DT] "
-           "[--raw]\n"
-           "               [--readonly] [--reset] [--select] [--sp] "
-           "[--temperature]\n"
-           "               [--transport] [--vendor=VP] [--verbose] "
-           "[--version]\n"
-           "               DEVICE\n"
+           "Usage: sg_logs [-All] [--all] [--brief] [--cbor] "
+           "[--collect=SFN]\n"
+           "               [--control=PC] [--delta=OSFN] [--enumerate] "
+           "[--filter=FL]\n"
+           "               [--help] [--hex] [--in=FN] [--jobs=JOBS] "
+           "[--json] [--list]\n"
+           "               [--no_inq] [--maxlen=LEN] [--name] [--page=PG] "
+           "[--param=PC]\n"
+           "               [--paramp=PP] [--pcb] [--ppc] [--pdt=DT] [--raw] "
+           "[--readonly]\n"
+           "               [--reset] [--select] [--sp] [--temperature] "
+           "[--transport]\n"
+           "               [--values] [--vendor=VP] [--verbose] [--version] "
+           "DEVICE...\n"
            "  where the main options are:\n"
            "    --All|-A        fetch and decode all log pages and "
            "subpages\n"
@@ -510,6 +544,19 @@ usage(int hval)
            "                    twice to fetch and decode all log pages "
            "and subpages\n"
            "    --brief|-b      shorten the output of some log pages\n"
+           "    --cbor|-y       as --json but output in CBOR (compact "
+           "binary)\n"
+           "    --collect=SFN|-C SFN    fetch all log pages and subpages "
+           "of each\n"
+           "                            DEVICE (concurrently) and write "
+           "them, not\n"
+           "                            decoded, as a snapshot to file SFN "
+           "('-' for\n"
+           "                            stdout). Use '--in=SFN' to decode "
+           "later\n"
+           "    --delta=OSFN|-d OSFN    with '--in=SFN' output changes (and "
+           "rates) of\n"
+           "                            counters since older snapshot OSFN\n"
            "    --enumerate|-e    enumerate known pages, ignore DEVICE. "
            "Sort order,\n"
            "                      '-e': all by acronym; '-ee': non-vendor "
@@ -528,9 +575,14 @@ usage(int hval)
            "    --in=FN|-i FN    FN is a filename containing a log page "
            "in ASCII hex\n"
            "                     or binary if --raw also given.\n"
+           "    --jobs=JOBS|-j JOBS    number of DEVICEs collected at once "
+           "(def: %d)\n"
+           "    --json|-J       output each log page as a line of JSON "
+           "(twice: indented)\n"
            "    --page=PG|-p PG    PG is either log page acronym, PGN or "
            "PGN,SPGN\n"
-           "                       where (S)PGN is a (sub) page number\n");
+           "                       where (S)PGN is a (sub) page number\n",
+           DEF_COLLECT_JOBS);
         pr2serr(
            "    --raw|-r        either output response in binary to stdout "
            "or, if\n"
@@ -540,6 +592,10 @@ usage(int hval)
            "0x2f)\n"
            "    --transport|-T    decode transport (protocol specific port "
            "0x18) page\n"
+           "    --values|-u     output known numeric fields as "
+           "<page>.<field>=<value>\n"
+           "                    lines (e.g. for scripts), rather than "
+           "decoding\n"
            "    --vendor=VP|-M VP    vendor/product abbreviation [or "
            "number]\n"
            "    --verbose|-v    increase verbosity\n\n"
@@ -567,6 +623,11 @@ usage(int hval)
            "    --no_inq|-x     no initial INQUIRY output (twice: and no "
            "INQUIRY call)\n"
            "    --old|-O        use old interface (use as first option)\n"
+           "    --param=PC|-k PC    fetch and decode only parameter code PC "
+           "of the\n"
+           "                        page; sets parameter pointer to PC with "
+           "a small\n"
+           "                        allocation length\n"
            "    --paramp=PP|-P PP    parameter pointer (decimal) (def: 0)\n"
            "    --pcb|-q        show parameter control bytes in decoded "
            "output\n"
@@ -590,7 +651,8 @@ usage(int hval)
            "will decoded as if\nit were a log page. The contents of FN "
            "generated by either a prior\n'sg_logs -HHH ...' invocation or "
            "by a text editor.\nLog pages defined in SPC are common "
-           "to all device types.\n");
+           "to all device types. Only '--collect=SFN'\naccepts more than "
+           "one DEVICE.\n");
     }
 }
 
@@ -744,15 +806,16 @@ static void
 enumerate_pages(const struct opts_t * op)
 {
     int k, j;
-    struct log_elem * lep;
-    struct log_elem ** lepp;
-    struct log_elem ** lep_arr;
+    const struct log_elem * lep;
+    const struct log_elem ** lepp;
+    const struct log_elem ** lep_arr;
 
     if (op->do_enumerate < 3) { /* -e, -ee: sort by acronym */
         for (k = 0, lep = log_arr; lep->pg_code >=0; ++lep, ++k)
             ;
         ++k;
-        lep_arr = (struct log_elem **)calloc(k, sizeof(struct log_elem *));
+        lep_arr = (const struct log_elem **)calloc(k,
+                                             sizeof(struct log_elem *));
         if (NULL == lep_arr) {
             pr2serr("%s: out of memory\n", __func__);
             return;
@@ -775,13 +838,16 @@ enumerate_pages(const struct opts_t * op)
 static const struct log_elem *
 acron_search(const char * acron)
 {
-    const struct log_elem * lep;
-
-    for (lep = log_arr; lep->pg_code >=0; ++lep) {
-        if (0 == strcmp(acron, lep->acron))
-            return lep;
-    }
-    return NULL;
+    int k;
+    static struct sg_lib_acron_idx acron_idx;
+    static struct sg_lib_acron_ent acron_ent_arr[SG_ARRAY_SIZE(log_arr)];
+
+    if (NULL == acron_idx.arr)   /* built on first use, skip end sentinel */
+        sg_lib_acron_idx_build(&acron_idx, acron_ent_arr, log_arr,
+                               SG_ARRAY_SIZE(log_arr) - 1, sizeof(log_arr[0]),
+                               offsetof(struct log_elem, acron), false);
+    k = sg_lib_acron_idx_find(&acron_idx, acron);
+    return (k < 0) ? NULL : (log_arr + acron_ent_arr[k].ind);
 }
 
 static int
@@ -854,6 +920,39 @@ enumerate_vp(void)
     }
 }
 
+/* log_arr_pg_idx[n] is the index of the first element in log_arr[] whose
+ * pg_code is 'n' or greater. Built on first use. If log_arr[] is not in
+ * ascending pg_code order, log_arr_pg_idx[0] is set to -2 and all searches
+ * start at the beginning of log_arr[]. */
+static int log_arr_pg_idx[0x41] = {-1};
+
+static const struct log_elem *
+log_arr_pg_start(int pg_code)
+{
+    int k, n, prev;
+    const struct log_elem * lep;
+
+    if (-1 == log_arr_pg_idx[0]) {
+        for (k = 0, n = 0, prev = 0, lep = log_arr; lep->pg_code >= 0;
+             ++lep, ++k) {
+            if ((lep->pg_code < prev) || (lep->pg_code > 0x3f)) {
+                log_arr_pg_idx[0] = -2;
+                break;
+            }
+            prev = lep->pg_code;
+            for ( ; n <= lep->pg_code; ++n)
+                log_arr_pg_idx[n] = k;
+        }
+        if (log_arr_pg_idx[0] > -2) {
+            for ( ; n <= 0x40; ++n)
+                log_arr_pg_idx[n] = k;
+        }
+    }
+    if ((log_arr_pg_idx[0] < 0) || (pg_code < 0) || (pg_code > 0x3f))
+        return log_arr;
+    return log_arr + log_arr_pg_idx[pg_code];
+}
+
 static const struct log_elem *
 pg_subpg_pdt_search(int pg_code, int subpg_code, int pdt, int vpn)
 {
@@ -862,7 +961,12 @@ pg_subpg_pdt_search(int pg_code, int subpg_code, int pdt, int vpn)
     int vp_mask = get_vp_mask(vpn);
 
     d_pdt = sg_lib_pdt_decay(pdt);
-    for (lep = log_arr; lep->pg_code >=0; ++lep) {
+    for (lep = log_arr_pg_start(pg_code); lep->pg_code >=0; ++lep) {
+        if (pg_code < lep->pg_code) {
+            if (log_arr_pg_idx[0] >= 0)
+                break;          /* sorted so no more matches */
+            continue;
+        }
         if (pg_code == lep->pg_code) {
             if (subpg_code == lep->subpg_code) {
                 if ((MVP_STD & lep->flags) || (0 == vp_mask) ||
@@ -904,8 +1008,8 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "aAbc:D:ef:hHi:lLm:M:nNOp:P:qQrRsStTvV"
-                        "xX", long_options, &option_index);
+        c = getopt_long(argc, argv, "aAbc:C:d:D:ef:hHi:j:Jk:lLm:M:nNOp:P:"
+                        "qQrRsStTuvVxXy", long_options, &option_index);
         if (c == -1)
             break;
 
@@ -928,6 +1032,12 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
             }
             op->page_control = n;
             break;
+        case 'C':
+            op->collect_fn = optarg;
+            break;
+        case 'd':
+            op->delta_fn = optarg;
+            break;
         case 'D':
             n = sg_get_num(optarg);
             if ((n < 0) || (n > 31)) {
@@ -968,6 +1078,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'i':
             op->in_fn = optarg;
             break;
+        case 'j':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_COLLECT_JOBS)) {
+                pr2serr("bad argument to '--jobs=', expect 1 to %d\n",
+                        MAX_COLLECT_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->jobs = n;
+            break;
         case 'l':
             ++op->do_list;
             break;
@@ -1000,6 +1119,19 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'O':
             op->opt_new = false;
             return 0;
+        case 'J':
+            ++op->do_json;
+            break;
+        case 'k':
+            n = sg_get_num(optarg);
+            if ((n < 0) || (n > 0xffff)) {
+                pr2serr("bad argument to '--param=', expect 0 to 0xffff\n");
+                usage(1);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->param_pc = n;
+            op->param_given = true;
+            break;
         case 'p':
             op->pg_arg = optarg;
             break;
@@ -1037,6 +1169,9 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'T':
             op->do_transport = true;
             break;
+        case 'u':
+            op->do_values = true;
+            break;
         case 'v':
             op->verbose_given = true;
             ++op->verbose;
@@ -1050,6 +1185,9 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'X':
             op->o_readonly = true;
             break;
+        case 'y':
+            op->do_cbor = true;
+            break;
         default:
             pr2serr("unrecognised option code %c [0x%x]\n", c, c);
             if (op->do_help)
@@ -1061,9 +1199,11 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     if (optind < argc) {
         if (NULL == op->device_name) {
             op->device_name = argv[optind];
+            op->dev_names = (const char **)(argv + optind);
+            op->num_devs = argc - optind;
             ++optind;
         }
-        if (optind < argc) {
+        if ((optind < argc) && (NULL == op->collect_fn)) {
             for (; optind < argc; ++optind)
                 pr2serr("Unexpected extra argument: %s\n", argv[optind]);
             usage(1);
@@ -1459,6 +1599,27 @@ resid_err:
     return res;
 }
 
+/* After a LOG SENSE with the parameter pointer set to pc, the response
+ * holds the parameters whose codes are >= pc, in ascending order. Checks
+ * that the first is pc then trims the page length so only that parameter
+ * is decoded. Returns the new page length or -1 if pc is not present. */
+static int
+param_trim(uint8_t * resp, int resp_len, int pc)
+{
+    int pg_len = sg_get_unaligned_be16(resp + 2);
+    int p_len;
+
+    if (pg_len + 4 > resp_len)
+        pg_len = resp_len - 4;
+    if ((pg_len < 4) || (pc != sg_get_unaligned_be16(resp + 4)))
+        return -1;
+    p_len = resp[7] + 4;
+    if (p_len > pg_len)
+        p_len = pg_len;         /* parameter truncated, decode what is here */
+    sg_put_unaligned_be16(p_len, resp + 2);
+    return p_len;
+}
+
 /* DS made obsolete in spc4r03; TMC and ETC made obsolete in spc5r03. */
 static char *
 get_pcb_str(int pcb, char * outp, int maxoutlen)
@@ -1683,15 +1844,319 @@ skip:
     return true;
 }
 
+/* Schema of the numeric fields in the log parameters of some log pages. It
+ * is walked by lp_iter_next() so values can be taken from a page without
+ * decoding it to text. A pc of -1 matches each parameter code of its page
+ * not matched by an entry before it. A width of 0 takes all of the
+ * parameter value (yielding 0 if it is more than 8 bytes long, as
+ * sg_get_unaligned_be() does). Entries for a page are contiguous. */
+struct lp_field_t {
+    int pg_code;
+    int pg_high;        /* when >0 this is high end of page code range */
+    int subpg_code;
+    int subpg_high;     /* when >0 this is high end of subpage range */
+    int pc;             /* parameter code, -1 for any other */
+    int offset;         /* of field from start of log parameter */
+    int width;          /* in bytes, 0 for all of parameter value */
+    int flags;          /* LPF_* */
+    const char * acron;         /* NULL with any other pc */
+    const char * name;
+    const char * unit;          /* NULL for counts */
+};
+
+#define LPF_COUNTER 1   /* a count that only goes up (or is reset) */
+
+static const struct lp_field_t lp_schema[] = {
+    /* WRITE_ERR_LPAGE ... VERIFY_ERR_LPAGE [0x2..0x5] */
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 0, 4, 0, LPF_COUNTER,
+     "corr_wo_delay", "Errors corrected without substantial delay", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 1, 4, 0, LPF_COUNTER,
+     "corr_w_delay", "Errors corrected with possible delays", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 2, 4, 0, LPF_COUNTER,
+     "rewrites_rereads", "Total rewrites or rereads", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 3, 4, 0, LPF_COUNTER,
+     "errors_corr", "Total errors corrected", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 4, 4, 0, LPF_COUNTER,
+     "corr_alg_processed", "Total times correction algorithm processed",
+     NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 5, 4, 0, LPF_COUNTER,
+     "bytes_processed", "Total bytes processed", "bytes"},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 6, 4, 0, LPF_COUNTER,
+     "uncorr_errors", "Total uncorrected errors", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 0x8009, 4, 0, LPF_COUNTER,
+     "track_follow_errors", "Track following errors [Hitachi]", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, 0x8015, 4, 0, LPF_COUNTER,
+     "positioning_errors", "Positioning errors [Hitachi]", NULL},
+    {WRITE_ERR_LPAGE, VERIFY_ERR_LPAGE, 0, 0, -1, 4, 0, LPF_COUNTER,
+     NULL, NULL, NULL},
+    /* NON_MEDIUM_LPAGE [0x6] */
+    {NON_MEDIUM_LPAGE, 0, 0, 0, 0, 4, 0, LPF_COUNTER,
+     "non_medium_errors", "Non-medium error count", NULL},
+    {NON_MEDIUM_LPAGE, 0, 0, 0, -1, 4, 0, LPF_COUNTER, NULL, NULL, NULL},
+    /* TEMPERATURE_LPAGE [0xd]; 0xff when not available */
+    {TEMPERATURE_LPAGE, 0, 0, 0, 0, 5, 1, 0,
+     "current_temp", "Current temperature", "C"},
+    {TEMPERATURE_LPAGE, 0, 0, 0, 1, 5, 1, 0,
+     "reference_temp", "Reference temperature", "C"},
+    /* START_STOP_LPAGE [0xe]; 0xffffffff when not available */
+    {START_STOP_LPAGE, 0, 0, 0, 3, 4, 4, 0, "spec_cycles",
+     "Specified cycle count over device lifetime", NULL},
+    {START_STOP_LPAGE, 0, 0, 0, 4, 4, 4, LPF_COUNTER, "start_stop_cycles",
+     "Accumulated start-stop cycles", NULL},
+    {START_STOP_LPAGE, 0, 0, 0, 5, 4, 4, 0, "spec_load_unloads",
+     "Specified load-unload count over device lifetime", NULL},
+    {START_STOP_LPAGE, 0, 0, 0, 6, 4, 4, LPF_COUNTER, "load_unloads",
+     "Accumulated load-unload cycles", NULL},
+    /* SOLID_STATE_MEDIA_LPAGE [0x11] */
+    {SOLID_STATE_MEDIA_LPAGE, 0, 0, 0, 1, 7, 1, 0, "endurance_used",
+     "Percentage used endurance indicator", "%"},
+    /* BACKGROUND_SCAN_LPAGE [0x15] */
+    {BACKGROUND_SCAN_LPAGE, 0, 0, 0, 0, 4, 4, LPF_COUNTER, "power_on_mins",
+     "Accumulated power on minutes", "minutes"},
+    {BACKGROUND_SCAN_LPAGE, 0, 0, 0, 0, 10, 2, LPF_COUNTER, "bg_scans",
+     "Number of background scans performed", NULL},
+    {BACKGROUND_SCAN_LPAGE, 0, 0, 0, 0, 14, 2, LPF_COUNTER, "bg_medium_scans",
+     "Number of background medium scans performed", NULL},
+    /* STATS_LPAGE [0x19,0x0] */
+    {STATS_LPAGE, 0, 0, 0, 1, 4, 8, LPF_COUNTER, "read_commands",
+     "number of read commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 12, 8, LPF_COUNTER, "write_commands",
+     "number of write commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 20, 8, LPF_COUNTER, "lb_received",
+     "number of logical blocks received", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 28, 8, LPF_COUNTER, "lb_transmitted",
+     "number of logical blocks transmitted", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 36, 8, LPF_COUNTER, "read_proc_intervals",
+     "read command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 44, 8, LPF_COUNTER, "write_proc_intervals",
+     "write command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 52, 8, LPF_COUNTER, "weight_rw_commands",
+     "weighted number of read commands plus write commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 1, 60, 8, LPF_COUNTER, "weight_rw_processing",
+     "weighted read command processing plus write command processing",
+     NULL},
+    {STATS_LPAGE, 0, 0, 0, 2, 4, 8, LPF_COUNTER, "idle_time_intervals",
+     "idle time intervals", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 4, 8, LPF_COUNTER, "read_fua_commands",
+     "number of read FUA commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 12, 8, LPF_COUNTER, "write_fua_commands",
+     "number of write FUA commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 20, 8, LPF_COUNTER, "read_fua_nv_commands",
+     "number of read FUA_NV commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 28, 8, LPF_COUNTER, "write_fua_nv_commands",
+     "number of write FUA_NV commands", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 36, 8, LPF_COUNTER, "read_fua_proc_intervals",
+     "read FUA command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 44, 8, LPF_COUNTER, "write_fua_proc_intervals",
+     "write FUA command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 52, 8, LPF_COUNTER,
+     "read_fua_nv_proc_intervals",
+     "read FUA_NV command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0, 0, 4, 60, 8, LPF_COUNTER,
+     "write_fua_nv_proc_intervals",
+     "write FUA_NV command processing intervals", NULL},
+    /* STATS_LPAGE [0x19,0x1...0x1f] */
+    {STATS_LPAGE, 0, 0x1, 0x1f, 1, 4, 8, LPF_COUNTER, "gn_read_commands",
+     "group n number of read commands", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 1, 12, 8, LPF_COUNTER, "gn_write_commands",
+     "group n number of write commands", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 1, 20, 8, LPF_COUNTER, "gn_lb_received",
+     "group n number of logical blocks received", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 1, 28, 8, LPF_COUNTER, "gn_lb_transmitted",
+     "group n number of logical blocks transmitted", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 1, 36, 8, LPF_COUNTER,
+     "gn_read_proc_intervals", "group n read command processing intervals",
+     NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 1, 44, 8, LPF_COUNTER,
+     "gn_write_proc_intervals",
+     "group n write command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 4, 8, LPF_COUNTER,
+     "gn_read_fua_commands", "group n number of read FUA commands", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 12, 8, LPF_COUNTER,
+     "gn_write_fua_commands", "group n number of write FUA commands", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 20, 8, LPF_COUNTER,
+     "gn_read_fua_nv_commands", "group n number of read FUA_NV commands",
+     NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 28, 8, LPF_COUNTER,
+     "gn_write_fua_nv_commands", "group n number of write FUA_NV commands",
+     NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 36, 8, LPF_COUNTER,
+     "gn_read_fua_proc_intervals",
+     "group n read FUA command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 44, 8, LPF_COUNTER,
+     "gn_write_fua_proc_intervals",
+     "group n write FUA command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 52, 8, LPF_COUNTER,
+     "gn_read_fua_nv_proc_intervals",
+     "group n read FUA_NV command processing intervals", NULL},
+    {STATS_LPAGE, 0, 0x1, 0x1f, 4, 60, 8, LPF_COUNTER,
+     "gn_write_fua_nv_proc_intervals",
+     "group n write FUA_NV command processing intervals", NULL},
+    /* STATS_LPAGE [0x19,0x20] */
+    {STATS_LPAGE, 0, CACHE_STATS_SUBPG, 0, 1, 4, 8, LPF_COUNTER,
+     "read_cache_memory_hits", "read cache memory hits", NULL},
+    {STATS_LPAGE, 0, CACHE_STATS_SUBPG, 0, 2, 4, 8, LPF_COUNTER,
+     "reads_to_cache_memory", "reads to cache memory", NULL},
+    {STATS_LPAGE, 0, CACHE_STATS_SUBPG, 0, 3, 4, 8, LPF_COUNTER,
+     "write_cache_memory_hits", "write cache memory hits", NULL},
+    {STATS_LPAGE, 0, CACHE_STATS_SUBPG, 0, 4, 4, 8, LPF_COUNTER,
+     "writes_from_cache_memory", "writes from cache memory", NULL},
+    /* PCT_LPAGE [0x1a] */
+    {PCT_LPAGE, 0, 0, 0, 1, 4, 0, LPF_COUNTER, "to_active",
+     "Accumulated transitions to active", NULL},
+    {PCT_LPAGE, 0, 0, 0, 2, 4, 0, LPF_COUNTER, "to_idle_a",
+     "Accumulated transitions to idle_a", NULL},
+    {PCT_LPAGE, 0, 0, 0, 3, 4, 0, LPF_COUNTER, "to_idle_b",
+     "Accumulated transitions to idle_b", NULL},
+    {PCT_LPAGE, 0, 0, 0, 4, 4, 0, LPF_COUNTER, "to_idle_c",
+     "Accumulated transitions to idle_c", NULL},
+    {PCT_LPAGE, 0, 0, 0, 8, 4, 0, LPF_COUNTER, "to_standby_z",
+     "Accumulated transitions to standby_z", NULL},
+    {PCT_LPAGE, 0, 0, 0, 9, 4, 0, LPF_COUNTER, "to_standby_y",
+     "Accumulated transitions to standby_y", NULL},
+    {PCT_LPAGE, 0, 0, 0, -1, 4, 0, LPF_COUNTER, NULL, NULL, NULL},
+    /* IE_LPAGE [0x2f]; temperatures 0xff when not available */
+    {IE_LPAGE, 0, 0, 0, 0, 4, 1, 0, "ie_asc", "IE asc", NULL},
+    {IE_LPAGE, 0, 0, 0, 0, 5, 1, 0, "ie_ascq", "IE ascq", NULL},
+    {IE_LPAGE, 0, 0, 0, 0, 6, 1, 0, "current_temp", "Current temperature",
+     "C"},
+    {IE_LPAGE, 0, 0, 0, 0, 7, 1, 0, "threshold_temp",
+     "Threshold temperature", "C"},
+    {-1, 0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL},
+};
+
+/* A numeric field of a log parameter, as yielded by lp_iter_next() */
+struct lp_value_t {
+    int pc;
+    int width;
+    uint64_t val;
+    const uint8_t * paramp;     /* start of log parameter */
+    int param_len;              /* including its 4 byte header */
+    const struct lp_field_t * fp;       /* acron, name and unit */
+};
+
+struct lp_iter_t {
+    const uint8_t * resp;
+    int len;
+    int off;            /* of current log parameter */
+    int pg_code;
+    int subpg_code;
+    bool matched;       /* current log parameter matched by an entry */
+    const struct lp_field_t * first;    /* first entry of page, or NULL */
+    const struct lp_field_t * fp;       /* next entry to try */
+};
+
+static bool
+lp_field_is_for(const struct lp_field_t * fp, int pg_code, int subpg_code)
+{
+    if ((fp->pg_high > 0) ? ((pg_code < fp->pg_code) ||
+                             (pg_code > fp->pg_high)) :
+                            (pg_code != fp->pg_code))
+        return false;
+    if (fp->subpg_high > 0)
+        return ((subpg_code >= fp->subpg_code) &&
+                (subpg_code <= fp->subpg_high));
+    return (subpg_code == fp->subpg_code);
+}
+
+/* Prepares to iterate over the fields of the log page in resp that are
+ * in lp_schema. Returns false if the page has none. */
+static bool
+lp_iter_init(struct lp_iter_t * itp, const uint8_t * resp, int len)
+{
+    const struct lp_field_t * fp;
+
+    memset(itp, 0, sizeof(*itp));
+    if (len < 4)
+        return false;
+    itp->resp = resp;
+    itp->len = len;
+    itp->off = 4;
+    itp->pg_code = resp[0] & 0x3f;
+    itp->subpg_code = (resp[0] & 0x40) ? resp[1] : NOT_SPG_SUBPG;
+    for (fp = lp_schema; fp->pg_code >= 0; ++fp) {
+        if (lp_field_is_for(fp, itp->pg_code, itp->subpg_code)) {
+            itp->first = fp;
+            itp->fp = fp;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Places the next field of the log page in vp. Returns false at the end. */
+static bool
+lp_iter_next(struct lp_iter_t * itp, struct lp_value_t * vp)
+{
+    int pc, pl, width;
+    const uint8_t * bp;
+    const struct lp_field_t * fp;
+
+    if (NULL == itp->first)
+        return false;
+    while ((itp->off + 4) <= itp->len) {
+        bp = itp->resp + itp->off;
+        pc = sg_get_unaligned_be16(bp + 0);
+        pl = bp[3] + 4;
+        if ((itp->off + pl) > itp->len)
+            return false;       /* truncated log parameter */
+        for (fp = itp->fp;
+             (fp->pg_code >= 0) &&
+             lp_field_is_for(fp, itp->pg_code, itp->subpg_code); ++fp) {
+            if (fp->pc >= 0) {
+                if (fp->pc != pc)
+                    continue;
+            } else if (itp->matched)
+                continue;
+            width = fp->width ? fp->width : (pl - fp->offset);
+            if ((width < 0) || ((fp->offset + width) > pl))
+                continue;
+            vp->pc = pc;
+            vp->width = width;
+            vp->val = sg_get_unaligned_be(width, bp + fp->offset);
+            vp->paramp = bp;
+            vp->param_len = pl;
+            vp->fp = fp;
+            itp->matched = true;
+            itp->fp = fp + 1;
+            return true;
+        }
+        itp->off += pl;
+        itp->fp = itp->first;
+        itp->matched = false;
+    }
+    return false;
+}
+
+/* For the show_*_page() functions that walk a page with lp_iter_next(),
+ * applies --filter=FL to the parameter of vp. Returns 1 if it is to be
+ * skipped, 2 if it has been output (--raw or --hex given), else 0 when it
+ * is to be decoded. */
+static int
+show_lp_value_filter(const struct lp_value_t * vp, const struct opts_t * op)
+{
+    if (! op->filter_given)
+        return 0;
+    if (vp->pc != op->filter)
+        return 1;
+    if (op->do_raw)
+        dStrRaw(vp->paramp, vp->param_len);
+    else if (op->do_hex)
+        hex2stdout(vp->paramp, vp->param_len, ((1 == op->do_hex) ? 1 : -1));
+    else
+        return 0;
+    return 2;
+}
+
 /* WRITE_ERR_LPAGE; READ_ERR_LPAGE; READ_REV_ERR_LPAGE; VERIFY_ERR_LPAGE */
 /* [0x2, 0x3, 0x4, 0x5]  introduced: SPC-3 */
 static bool
 show_error_counter_page(const uint8_t * resp, int len,
                         const struct opts_t * op)
 {
-    int num, pl, pc, pg_code;
-    uint64_t val;
-    const uint8_t * bp;
+    int k, pg_code;
+    struct lp_iter_t it;
+    struct lp_value_t v;
     char str[PCB_STR_LEN];
 
     pg_code = resp[0] & 0x3f;
@@ -1716,48 +2181,28 @@ show_error_counter_page(const uint8_t * resp, int len,
             return false;
         }
     }
-    num = len - 4;
-    bp = &resp[0] + 4;
-    while (num > 3) {
-        pc = sg_get_unaligned_be16(bp + 0);
-        pl = bp[3] + 4;
-        if (op->filter_given) {
-            if (pc != op->filter)
-                goto skip;
-            if (op->do_raw) {
-                dStrRaw(bp, pl);
-                break;
-            } else if (op->do_hex) {
-                hex2stdout(bp, pl, ((1 == op->do_hex) ? 1 : -1));
-                break;
-            }
-        }
-        switch (pc) {
-        case 0: printf("  Errors corrected without substantial delay"); break;
-        case 1: printf("  Errors corrected with possible delays"); break;
-        case 2: printf("  Total rewrites or rereads"); break;
-        case 3: printf("  Total errors corrected"); break;
-        case 4: printf("  Total times correction algorithm processed"); break;
-        case 5: printf("  Total bytes processed"); break;
-        case 6: printf("  Total uncorrected errors"); break;
-        case 0x8009: printf("  Track following errors [Hitachi]"); break;
-        case 0x8015: printf("  Positioning errors [Hitachi]"); break;
-        default: printf("  Reserved or vendor specific [0x%x]", pc); break;
-        }
-        val = sg_get_unaligned_be(pl - 4, bp + 4);
-        printf(" = %" PRIu64 "", val);
-        if (val > ((uint64_t)1 << 40))
+    lp_iter_init(&it, resp, len);
+    while (lp_iter_next(&it, &v)) {
+        k = show_lp_value_filter(&v, op);
+        if (1 == k)
+            continue;
+        else if (2 == k)
+            break;
+        if (v.fp->name)
+            printf("  %s", v.fp->name);
+        else
+            printf("  Reserved or vendor specific [0x%x]", v.pc);
+        printf(" = %" PRIu64 "", v.val);
+        if (v.val > ((uint64_t)1 << 40))
             printf(" [%" PRIu64 " TB]\n",
-                   (val / (1000UL * 1000 * 1000 * 1000)));
+                   (v.val / (1000UL * 1000 * 1000 * 1000)));
         else
             printf("\n");
         if (op->do_pcb)
-            printf("        <%s>\n", get_pcb_str(bp[2], str, sizeof(str)));
+            printf("        <%s>\n", get_pcb_str(v.paramp[2], str,
+                                                 sizeof(str)));
         if (op->filter_given)
             break;
-skip:
-        num -= pl;
-        bp += pl;
     }
     return true;
 }
@@ -1767,48 +2212,33 @@ static bool
 show_non_medium_error_page(const uint8_t * resp, int len,
                            const struct opts_t * op)
 {
-    int num, pl, pc;
-    const uint8_t * bp;
+    int k;
+    struct lp_iter_t it;
+    struct lp_value_t v;
     char str[PCB_STR_LEN];
 
     if (op->verbose || ((! op->do_raw) && (0 == op->do_hex)))
         printf("Non-medium error page  [0x6]\n");
-    num = len - 4;
-    bp = &resp[0] + 4;
-    while (num > 3) {
-        pc = sg_get_unaligned_be16(bp + 0);
-        pl = bp[3] + 4;
-        if (op->filter_given) {
-            if (pc != op->filter)
-                goto skip;
-            if (op->do_raw) {
-                dStrRaw(bp, pl);
-                break;
-            } else if (op->do_hex) {
-                hex2stdout(bp, pl, ((1 == op->do_hex) ? 1 : -1));
-                break;
-            }
-        }
-        switch (pc) {
-        case 0:
-            printf("  Non-medium error count");
-            break;
-        default:
-            if (pc <= 0x7fff)
-                printf("  Reserved [0x%x]", pc);
-            else
-                printf("  Vendor specific [0x%x]", pc);
+    lp_iter_init(&it, resp, len);
+    while (lp_iter_next(&it, &v)) {
+        k = show_lp_value_filter(&v, op);
+        if (1 == k)
+            continue;
+        else if (2 == k)
             break;
-        }
-        printf(" = %" PRIu64 "", sg_get_unaligned_be(pl - 4, bp + 4));
+        if (v.fp->name)
+            printf("  %s", v.fp->name);
+        else if (v.pc <= 0x7fff)
+            printf("  Reserved [0x%x]", v.pc);
+        else
+            printf("  Vendor specific [0x%x]", v.pc);
+        printf(" = %" PRIu64 "", v.val);
         printf("\n");
         if (op->do_pcb)
-            printf("        <%s>\n", get_pcb_str(bp[2], str, sizeof(str)));
+            printf("        <%s>\n", get_pcb_str(v.paramp[2], str,
+                                                 sizeof(str)));
         if (op->filter_given)
             break;
-skip:
-        num -= pl;
-        bp += pl;
     }
     return true;
 }
@@ -1818,53 +2248,31 @@ static bool
 show_power_condition_transitions_page(const uint8_t * resp, int len,
                                       const struct opts_t * op)
 {
-    int num, pl, pc;
-    const uint8_t * bp;
+    int k;
+    struct lp_iter_t it;
+    struct lp_value_t v;
     char str[PCB_STR_LEN];
 
     if (op->verbose || ((! op->do_raw) && (0 == op->do_hex)))
         printf("Power condition transitions page  [0x1a]\n");
-    num = len - 4;
-    bp = &resp[0] + 4;
-    while (num > 3) {
-        pc = sg_get_unaligned_be16(bp + 0);
-        pl = bp[3] + 4;
-        if (op->filter_given) {
-            if (pc != op->filter)
-                goto skip;
-            if (op->do_raw) {
-                dStrRaw(bp, pl);
-                break;
-            } else if (op->do_hex) {
-                hex2stdout(bp, pl, ((1 == op->do_hex) ? 1 : -1));
-                break;
-            }
-        }
-        switch (pc) {
-        case 1:
-            printf("  Accumulated transitions to active"); break;
-        case 2:
-            printf("  Accumulated transitions to idle_a"); break;
-        case 3:
-            printf("  Accumulated transitions to idle_b"); break;
-        case 4:
-            printf("  Accumulated transitions to idle_c"); break;
-        case 8:
-            printf("  Accumulated transitions to standby_z"); break;
-        case 9:
-            printf("  Accumulated transitions to standby_y"); break;
-        default:
-            printf("  Reserved [0x%x]", pc);
-        }
-        printf(" = %" PRIu64 "", sg_get_unaligned_be(pl - 4, bp + 4));
+    lp_iter_init(&it, resp, len);
+    while (lp_iter_next(&it, &v)) {
+        k = show_lp_value_filter(&v, op);
+        if (1 == k)
+            continue;
+        else if (2 == k)
+            break;
+        if (v.fp->name)
+            printf("  %s", v.fp->name);
+        else
+            printf("  Reserved [0x%x]", v.pc);
+        printf(" = %" PRIu64 "", v.val);
         printf("\n");
         if (op->do_pcb)
-            printf("        <%s>\n", get_pcb_str(bp[2], str, sizeof(str)));
+            printf("        <%s>\n", get_pcb_str(v.paramp[2], str,
+                                                 sizeof(str)));
         if (op->filter_given)
             break;
-skip:
-        num -= pl;
-        bp += pl;
     }
     return true;
 }
@@ -6570,6 +6978,138 @@ skip:
     return true;
 }
 
+/* Implements --values: outputs one <page>.<field>=<value> line for each
+ * field of the log page in resp that lp_schema knows. Pages without
+ * schema entries output nothing. */
+static void
+show_page_values(const uint8_t * resp, int len, const struct opts_t * op)
+{
+    int pg_code, subpg_code, vpn;
+    const struct log_elem * lep;
+    struct lp_iter_t it;
+    struct lp_value_t v;
+    char pg_b[32];
+    char f_b[32];
+
+    if (! lp_iter_init(&it, resp, len)) {
+        if (op->verbose)
+            pr2serr("%s: no values known for page 0x%x\n", __func__,
+                    resp[0] & 0x3f);
+        return;
+    }
+    pg_code = it.pg_code;
+    subpg_code = it.subpg_code;
+    vpn = (op->vend_prod_num >= 0) ? op->vend_prod_num : op->deduced_vpn;
+    lep = pg_subpg_pdt_search(pg_code, subpg_code, op->dev_pdt, vpn);
+    if (lep && lep->acron) {
+        if (lep->subpg_high > 0)
+            snprintf(pg_b, sizeof(pg_b), "%s_%d", lep->acron, subpg_code);
+        else
+            snprintf(pg_b, sizeof(pg_b), "%s", lep->acron);
+    } else if (subpg_code)
+        snprintf(pg_b, sizeof(pg_b), "pg_0x%x_0x%x", pg_code, subpg_code);
+    else
+        snprintf(pg_b, sizeof(pg_b), "pg_0x%x", pg_code);
+    while (lp_iter_next(&it, &v)) {
+        if (op->filter_given && (v.pc != op->filter))
+            continue;
+        if (v.fp->acron)
+            snprintf(f_b, sizeof(f_b), "%s", v.fp->acron);
+        else
+            snprintf(f_b, sizeof(f_b), "pc_0x%x", v.pc);
+        printf("%s.%s=%" PRIu64 "%s%s\n", pg_b, f_b, v.val,
+               (v.fp->unit ? " " : ""), (v.fp->unit ? v.fp->unit : ""));
+    }
+}
+
+/* Implements --json: one JSON object for the log page in resp, holding
+ * an array with an object for each log parameter. Fields that lp_schema
+ * knows are given by their acronyms (or "value"), otherwise a parameter
+ * value of up to 8 bytes is given as "value" and longer ones as "hex". */
+static void
+show_page_json(const uint8_t * resp, int len, const struct opts_t * op)
+{
+    int pg_code, subpg_code, vpn, k, pc, pl, width, n;
+    struct sgj_state * jsp = op->jsp;
+    const uint8_t * bp;
+    const struct log_elem * lep;
+    const struct lp_field_t * first = NULL;
+    const struct lp_field_t * fp;
+
+    pg_code = resp[0] & 0x3f;
+    subpg_code = (resp[0] & 0x40) ? resp[1] : 0;
+    vpn = (op->vend_prod_num >= 0) ? op->vend_prod_num : op->deduced_vpn;
+    lep = pg_subpg_pdt_search(pg_code, subpg_code, op->dev_pdt, vpn);
+    for (fp = lp_schema; fp->pg_code >= 0; ++fp) {
+        if (lp_field_is_for(fp, pg_code, (resp[0] & 0x40) ? subpg_code :
+                                                           NOT_SPG_SUBPG)) {
+            first = fp;
+            break;
+        }
+    }
+    sgj_begin_obj(jsp, NULL);
+    if (op->device_name)
+        sgj_add_str(jsp, "device", op->device_name);
+    sgj_add_uint(jsp, "page_code", pg_code);
+    sgj_add_uint(jsp, "subpage_code", subpg_code);
+    if (lep) {
+        sgj_add_str(jsp, "name", lep->name);
+        sgj_add_str(jsp, "acronym", lep->acron);
+    }
+    if (SUPP_PAGES_LPAGE == pg_code) {   /* list of page codes, not params */
+        sgj_begin_arr(jsp, "supported_pages");
+        for (k = 4; k < len; k += ((resp[0] & 0x40) ? 2 : 1)) {
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_uint(jsp, "page_code", resp[k] & 0x3f);
+            sgj_add_uint(jsp, "subpage_code", ((resp[0] & 0x40) &&
+                                               (k + 1 < len)) ?
+                                              resp[k + 1] : 0);
+            sgj_end_obj(jsp);
+        }
+        sgj_end_arr(jsp);
+        sgj_end_obj(jsp);
+        return;
+    }
+    sgj_begin_arr(jsp, "parameters");
+    for (k = 4, bp = resp + 4; (k + 4) <= len; k += pl, bp += pl) {
+        pc = sg_get_unaligned_be16(bp + 0);
+        pl = bp[3] + 4;
+        if ((k + pl) > len)
+            break;      /* truncated log parameter */
+        if (op->filter_given && (pc != op->filter))
+            continue;
+        sgj_begin_obj(jsp, NULL);
+        sgj_add_uint(jsp, "parameter_code", pc);
+        sgj_add_uint(jsp, "control", bp[2]);
+        n = 0;
+        for (fp = first; fp && (fp->pg_code >= 0) &&
+             (fp->pg_code == first->pg_code) &&
+             (fp->subpg_code == first->subpg_code); ++fp) {
+            if (fp->pc >= 0) {
+                if (fp->pc != pc)
+                    continue;
+            } else if (n > 0)
+                continue;
+            width = fp->width ? fp->width : (pl - fp->offset);
+            if ((width <= 0) || ((fp->offset + width) > pl))
+                continue;
+            sgj_add_uint(jsp, fp->acron ? fp->acron : "value",
+                         sg_get_unaligned_be(width, bp + fp->offset));
+            ++n;
+        }
+        if (0 == n) {
+            if ((pl > 4) && (pl <= 12))
+                sgj_add_uint(jsp, "value",
+                             sg_get_unaligned_be(pl - 4, bp + 4));
+            else
+                sgj_add_hex(jsp, "hex", bp + 4, pl - 4);
+        }
+        sgj_end_obj(jsp);
+    }
+    sgj_end_arr(jsp);
+    sgj_end_obj(jsp);
+}
+
 static void
 decode_page_contents(const uint8_t * resp, int len, struct opts_t * op)
 {
@@ -6589,6 +7129,14 @@ decode_page_contents(const uint8_t * resp, int len, struct opts_t * op)
     else
         subpg_code = spf ? resp[1] : 0;
     op->decod_subpg_code = subpg_code;
+    if (op->do_json) {
+        show_page_json(resp, len, op);
+        return;
+    }
+    if (op->do_values) {
+        show_page_values(resp, len, op);
+        return;
+    }
     if ((SUPP_SPGS_SUBPG == subpg_code) && (SUPP_PAGES_LPAGE != pg_code)) {
         done = show_supported_pgs_sub_page(resp, len, op);
         if (done)
@@ -6715,6 +7263,649 @@ decode_pg_arg(struct opts_t * op)
     return 0;
 }
 
+/* --collect=SFN writes a binary snapshot: the 8 byte snap_magic, then for
+ * each DEVICE a device record followed by a page record for each log page
+ * (and subpage) fetched from it. A device record is 'D', the peripheral
+ * device type, the length of the device name (be16), the time of the
+ * collection in microseconds since the Epoch (be64), the T10 vendor (8
+ * bytes), product (16) and revision (4) strings from INQUIRY, then the
+ * device name (not NUL terminated). A page record is 'P' followed by the
+ * log page as returned by LOG SENSE, which holds its own length. Such a
+ * file is decoded with --in=SFN (and without DEVICE). */
+static const uint8_t snap_magic[8] = {'S', 'G', 'L', 'S', 'N', 'A', 'P', '1'};
+
+struct snap_dev_t {
+    const char * dev_name;
+    int res;            /* 0 or the error that stopped the collection */
+    int num_pages;
+    int len;
+    int alloc_len;
+    uint8_t * bp;       /* records of this DEVICE */
+};
+
+struct snap_coll_t {
+    int num_devs;
+    int next_dev;       /* claimed atomically by the collecting threads */
+    const struct opts_t * op;
+    struct snap_dev_t * sd_arr;
+};
+
+static bool
+snap_append(struct snap_dev_t * sdp, const uint8_t * bp, int len)
+{
+    int n = sdp->len + len;
+    uint8_t * np;
+
+    if (n > sdp->alloc_len) {
+        n = (n < (2 * sdp->alloc_len)) ? (2 * sdp->alloc_len) : (n + 4096);
+        np = (uint8_t *)realloc(sdp->bp, n);
+        if (NULL == np)
+            return false;
+        sdp->bp = np;
+        sdp->alloc_len = n;
+    }
+    memcpy(sdp->bp + sdp->len, bp, len);
+    sdp->len += len;
+    return true;
+}
+
+static bool
+snap_append_page(struct snap_dev_t * sdp, const uint8_t * resp, int len)
+{
+    static const uint8_t tag = 'P';
+
+    if (! (snap_append(sdp, &tag, 1) && snap_append(sdp, resp, len)))
+        return false;
+    ++sdp->num_pages;
+    return true;
+}
+
+/* Fetches the supported log pages and subpages of one DEVICE, then each of
+ * them, keeping their records in sdp. Nothing is decoded. op is owned by
+ * the calling thread since do_logs() takes the page to fetch from it. */
+static int
+collect_dev(struct snap_dev_t * sdp, struct opts_t * op, uint8_t * resp,
+            uint8_t * parr)
+{
+    bool spf;
+    int sg_fd, k, n, res, resp_len, pg_len, vb;
+    uint64_t usecs;
+    struct timeval tv;
+    struct sg_simple_inquiry_resp inq;
+    uint8_t hdr[SNAP_DEV_HDR_LEN];
+
+    vb = op->verbose;
+    sg_fd = sg_cmds_open_device(sdp->dev_name, true /* ro */, vb);
+    if (sg_fd < 0) {
+        pr2serr("error opening file: %s: %s\n", sdp->dev_name,
+                safe_strerror(-sg_fd));
+        return sg_convert_errno(-sg_fd);
+    }
+    gettimeofday(&tv, NULL);
+    usecs = ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+    memset(&inq, 0, sizeof(inq));
+    if ((res = sg_simple_inquiry(sg_fd, &inq, true, vb))) {
+        pr2serr("%s doesn't respond to a SCSI INQUIRY\n", sdp->dev_name);
+        goto fini;
+    }
+    n = strlen(sdp->dev_name);
+    memset(hdr, 0, sizeof(hdr));
+    hdr[0] = 'D';
+    hdr[1] = inq.peripheral_type;
+    sg_put_unaligned_be16((uint16_t)n, hdr + 2);
+    sg_put_unaligned_be64(usecs, hdr + 4);
+    memcpy(hdr + 12, inq.vendor, 8);
+    memcpy(hdr + 20, inq.product, 16);
+    memcpy(hdr + 36, inq.revision, 4);
+    if (! (snap_append(sdp, hdr, sizeof(hdr)) &&
+           snap_append(sdp, (const uint8_t *)sdp->dev_name, n))) {
+        res = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    resp_len = (op->maxlen > 0) ? op->maxlen : MX_ALLOC_LEN;
+    op->pg_code = SUPP_PAGES_LPAGE;
+    op->subpg_code = SUPP_SPGS_SUBPG;
+    if (do_logs(sg_fd, resp, resp_len, op)) {
+        op->subpg_code = NOT_SPG_SUBPG;    /* fall back to pages only */
+        if ((res = do_logs(sg_fd, resp, resp_len, op)))
+            goto fini;
+    }
+    pg_len = sg_get_unaligned_be16(resp + 2);
+    if ((pg_len + 4) > resp_len)
+        pg_len = resp_len - 4;
+    if (! snap_append_page(sdp, resp, pg_len + 4)) {
+        res = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    spf = !!(resp[0] & 0x40);
+    n = (pg_len > parr_sz) ? parr_sz : pg_len;
+    memcpy(parr, resp + 4, n);
+    for (k = 0; k < n; ++k) {
+        op->pg_code = parr[k] & 0x3f;
+        op->subpg_code = spf ? parr[++k] : NOT_SPG_SUBPG;
+        /* already have the supported pages; skip [pg_code, 0xff] too */
+        if ((SUPP_PAGES_LPAGE == op->pg_code) ||
+            (SUPP_SPGS_SUBPG == op->subpg_code))
+            continue;
+        if ((res = do_logs(sg_fd, resp, resp_len, op))) {
+            if (vb)
+                pr2serr("%s: page=0x%x,0x%x not collected\n", sdp->dev_name,
+                        op->pg_code, op->subpg_code);
+            continue;
+        }
+        pg_len = sg_get_unaligned_be16(resp + 2);
+        if ((pg_len + 4) > resp_len)
+            pg_len = resp_len - 4;
+        if (! snap_append_page(sdp, resp, pg_len + 4)) {
+            res = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    }
+    res = 0;
+fini:
+    sg_cmds_close_device(sg_fd);
+    return res;
+}
+
+static void *
+collect_worker(void * v_scp)
+{
+    int k;
+    uint8_t * resp;
+    uint8_t * free_resp = NULL;
+    uint8_t * parr;
+    struct snap_coll_t * scp = (struct snap_coll_t *)v_scp;
+    struct opts_t opts;
+
+    opts = *scp->op;
+    resp = sg_memalign(rsp_buff_sz, 0, &free_resp, false);
+    parr = (uint8_t *)malloc(parr_sz);
+    while ((k = __atomic_fetch_add(&scp->next_dev, 1, __ATOMIC_RELAXED)) <
+           scp->num_devs) {
+        if (resp && parr)
+            scp->sd_arr[k].res = collect_dev(scp->sd_arr + k, &opts, resp,
+                                             parr);
+        else
+            scp->sd_arr[k].res = sg_convert_errno(ENOMEM);
+    }
+    if (free_resp)
+        free(free_resp);
+    if (parr)
+        free(parr);
+    return NULL;
+}
+
+/* Implements --collect=SFN. The DEVICEs are shared out between up to
+ * --jobs=JOBS threads, then the snapshot is written in DEVICE order.
+ * Returns 0, else the error of the first DEVICE that failed. */
+static int
+collect_logs(const struct opts_t * op)
+{
+    bool to_stdout;
+    int k, n_thr;
+    int ret = 0;
+    FILE * fp;
+    struct snap_dev_t * sdp;
+    struct snap_coll_t sc;
+#ifndef SG_LIB_WIN32
+    int err;
+    pthread_t tids[MAX_COLLECT_JOBS];
+#endif
+
+    memset(&sc, 0, sizeof(sc));
+    sc.op = op;
+    sc.num_devs = (op->num_devs > 0) ? op->num_devs : 1;
+    sc.sd_arr = (struct snap_dev_t *)calloc(sc.num_devs, sizeof(*sdp));
+    if (NULL == sc.sd_arr) {
+        pr2serr("Unable to allocate heap for %d devices\n", sc.num_devs);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < sc.num_devs; ++k)
+        sc.sd_arr[k].dev_name = op->dev_names ? op->dev_names[k] :
+                                                op->device_name;
+    n_thr = (op->jobs > 0) ? op->jobs : DEF_COLLECT_JOBS;
+    if (n_thr > sc.num_devs)
+        n_thr = sc.num_devs;
+#ifndef SG_LIB_WIN32
+    /* this thread is one of the collectors */
+    for (k = 1; k < n_thr; ++k) {
+        if ((err = pthread_create(tids + k, NULL, collect_worker, &sc))) {
+            if (op->verbose)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    n_thr = k;
+    collect_worker(&sc);
+    for (k = 1; k < n_thr; ++k)
+        pthread_join(tids[k], NULL);
+#else
+    collect_worker(&sc);
+#endif
+
+    to_stdout = (0 == strcmp(op->collect_fn, "-"));
+    if (to_stdout) {
+        if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
+            perror("sg_set_binary_mode");
+            ret = SG_LIB_FILE_ERROR;
+            goto fini;
+        }
+        fp = stdout;
+    } else if (NULL == (fp = fopen(op->collect_fn, "wb"))) {
+        ret = sg_convert_errno(errno);
+        pr2serr("unable to open %s: %s\n", op->collect_fn,
+                safe_strerror(errno));
+        goto fini;
+    }
+    if (1 != fwrite(snap_magic, sizeof(snap_magic), 1, fp))
+        ret = SG_LIB_FILE_ERROR;
+    for (k = 0; k < sc.num_devs; ++k) {
+        sdp = sc.sd_arr + k;
+        if ((sdp->len > 0) && (1 != fwrite(sdp->bp, sdp->len, 1, fp)))
+            ret = SG_LIB_FILE_ERROR;
+        if (op->verbose)
+            pr2serr("%s: collected %d log pages\n", sdp->dev_name,
+                    sdp->num_pages);
+        if (sdp->res && (0 == ret))
+            ret = sdp->res;
+    }
+    if (to_stdout)
+        fflush(fp);
+    else if (fclose(fp) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
+    if (SG_LIB_FILE_ERROR == ret)
+        pr2serr("problem writing snapshot to %s\n", op->collect_fn);
+fini:
+    for (k = 0; k < sc.num_devs; ++k)
+        free(sc.sd_arr[k].bp);
+    free(sc.sd_arr);
+    return ret;
+}
+
+/* Returns true if file FN starts with the --collect snapshot magic */
+static bool
+snap_is_file(const char * fn)
+{
+    bool ok;
+    FILE * fp;
+    uint8_t b[sizeof(snap_magic)];
+
+    if ((0 == strcmp(fn, "-")) || (NULL == (fp = fopen(fn, "rb"))))
+        return false;
+    ok = ((1 == fread(b, sizeof(b), 1, fp)) &&
+          (0 == memcmp(b, snap_magic, sizeof(b))));
+    fclose(fp);
+    return ok;
+}
+
+/* Reads all of snapshot file FN into a new heap buffer, which the caller
+ * frees. Returns 0 if ok. */
+static int
+snap_read(const char * fn, uint8_t ** bpp, int * lenp)
+{
+    int ret = 0;
+    long fsz;
+    FILE * fp;
+    uint8_t * bp = NULL;
+
+    if (NULL == (fp = fopen(fn, "rb"))) {
+        pr2serr("unable to open %s: %s\n", fn, safe_strerror(errno));
+        return sg_convert_errno(errno);
+    }
+    if ((fseek(fp, 0, SEEK_END) < 0) || ((fsz = ftell(fp)) < 0) ||
+        (fsz > INT_MAX) || (fseek(fp, 0, SEEK_SET) < 0)) {
+        pr2serr("unable to find size of %s\n", fn);
+        ret = SG_LIB_FILE_ERROR;
+    } else if (NULL == (bp = (uint8_t *)malloc(fsz > 0 ? fsz : 1)))
+        ret = sg_convert_errno(ENOMEM);
+    else if ((fsz > 0) && (1 != fread(bp, fsz, 1, fp))) {
+        pr2serr("unable to read %s\n", fn);
+        ret = SG_LIB_FILE_ERROR;
+    }
+    fclose(fp);
+    if (ret) {
+        free(bp);
+        return ret;
+    }
+    *bpp = bp;
+    *lenp = (int)fsz;
+    return 0;
+}
+
+/* Steps over the snapshot record at *offp, pointing *rpp at it and setting
+ * *rlenp to its length (for a 'P' record, excluding its tag). Returns the
+ * record's tag, 0 at the end of the snapshot or -1 if it is malformed. */
+static int
+snap_next(const uint8_t * bp, int len, int * offp, const uint8_t ** rpp,
+          int * rlenp)
+{
+    int k = *offp;
+    int n;
+
+    if (k >= len)
+        return 0;
+    if ('D' == bp[k]) {
+        if ((k + SNAP_DEV_HDR_LEN) > len)
+            return -1;
+        n = SNAP_DEV_HDR_LEN + sg_get_unaligned_be16(bp + k + 2);
+        if ((k + n) > len)
+            return -1;
+        *rpp = bp + k;
+        *offp = k + n;
+    } else if ('P' == bp[k]) {
+        if ((k + 5) > len)
+            return -1;
+        n = sg_get_unaligned_be16(bp + k + 3) + 4;
+        if ((k + 1 + n) > len)
+            return -1;
+        *rpp = bp + k + 1;
+        *offp = k + 1 + n;
+    } else
+        return -1;
+    *rlenp = n;
+    return bp[k];
+}
+
+/* Takes the peripheral device type and vendor of a snapshot device record,
+ * as the decoders would from INQUIRY */
+static void
+snap_set_dev(const uint8_t * dp, struct opts_t * op)
+{
+    op->dev_pdt = dp[1];
+    memcpy(t10_vendor_str, dp + 12, 8);
+    t10_vendor_str[8] = '\0';
+    memcpy(t10_product_str, dp + 20, 16);
+    t10_product_str[16] = '\0';
+    if (VP_NONE == op->vend_prod_num)
+        op->deduced_vpn = find_vpn_by_inquiry();
+}
+
+/* Decodes the snapshot in file FN, as written by --collect=SFN, with the
+ * same show_*_page() functions used on a DEVICE's responses */
+static int
+snap_decode(const char * fn, struct opts_t * op)
+{
+    int off, tag, rlen, ret, num_devs;
+    int len = 0;
+    time_t t;
+    uint8_t * bp = NULL;
+    const uint8_t * rp;
+    struct tm a_tm;
+    char b[64];
+
+    if ((ret = snap_read(fn, &bp, &len)))
+        return ret;
+    off = sizeof(snap_magic);
+    num_devs = 0;
+    while ((tag = snap_next(bp, len, &off, &rp, &rlen)) > 0) {
+        if ('D' == tag) {
+            snap_set_dev(rp, op);
+            t = (time_t)(sg_get_unaligned_be64(rp + 4) / 1000000);
+            if (localtime_r(&t, &a_tm))
+                strftime(b, sizeof(b), "%Y-%m-%d %H:%M:%S", &a_tm);
+            else
+                snprintf(b, sizeof(b), "%" PRId64, (int64_t)t);
+            printf("%s%.*s:    %.8s  %.16s  %.4s  [collected %s]\n",
+                   ((num_devs && (! op->do_values)) ? "\n" : ""),
+                   rlen - SNAP_DEV_HDR_LEN,
+                   (const char *)(rp + SNAP_DEV_HDR_LEN), rp + 12, rp + 20,
+                   rp + 36, b);
+            ++num_devs;
+        } else {
+            if (! op->do_values)
+                printf("\n");
+            if (op->do_hex)
+                hex2stdout(rp, rlen, (1 == op->do_hex));
+            else
+                decode_page_contents(rp, rlen, op);
+        }
+    }
+    if (tag < 0) {
+        pr2serr("%s: snapshot malformed at offset %d\n", fn, off);
+        ret = SG_LIB_FILE_ERROR;
+    }
+    free(bp);
+    return ret;
+}
+
+/* --delta=OSFN: a counter found in a log page of a snapshot */
+struct snap_ctr_t {
+    uint32_t key;       /* (parameter code << 16) + offset within parameter */
+    int width;          /* in bytes, 1 to 8 */
+    bool du;            /* DU bit: counter stopped at its maximum */
+    bool may_wrap;      /* FORMAT AND LINKING 10b: may be unbounded */
+    uint64_t val;
+    const char * name;  /* NULL: describe from key */
+};
+
+#define SNAP_MAX_CTRS 1024
+
+static const char * const sas_phy_ctr_names[] = {
+    "invalid dword count", "running disparity error count",
+    "loss of dword synchronization count", "phy reset problem count",
+};
+
+static void
+snap_add_ctr(struct snap_ctr_t * arr, int * nump, uint32_t key, int width,
+             const uint8_t * vp, const uint8_t * pp, const char * name)
+{
+    struct snap_ctr_t * cp;
+
+    if (*nump >= SNAP_MAX_CTRS)
+        return;
+    cp = arr + (*nump)++;
+    cp->key = key;
+    cp->width = width;
+    cp->val = sg_get_unaligned_be(width, vp);
+    cp->du = !!(0x80 & pp[2]);
+    cp->may_wrap = (0x2 == (0x3 & pp[2]));
+    cp->name = name;
+}
+
+/* Places the counters of log page resp in arr: those fields that lp_schema
+ * flags with LPF_COUNTER, plus the phy event counters of the SAS protocol
+ * specific port page. Returns the number found, 0 for pages that do not
+ * hold counters. */
+static int
+snap_page_ctrs(const uint8_t * resp, int len, struct snap_ctr_t * arr)
+{
+    int num, pl, pc, j, k, spld_len;
+    int count = 0;
+    const uint8_t * bp;
+    const uint8_t * vcp;
+    struct lp_iter_t it;
+    struct lp_value_t v;
+
+    if ((PROTO_SPECIFIC_LPAGE != (resp[0] & 0x3f)) || (0x40 & resp[0])) {
+        lp_iter_init(&it, resp, len);
+        while (lp_iter_next(&it, &v)) {
+            if ((! (LPF_COUNTER & v.fp->flags)) || (v.width < 1) ||
+                (v.width > 8))
+                continue;
+            snap_add_ctr(arr, &count,
+                         ((uint32_t)v.pc << 16) + v.fp->offset, v.width,
+                         v.paramp + v.fp->offset, v.paramp, v.fp->acron);
+        }
+        return count;
+    }
+    for (num = len - 4, bp = resp + 4; num > 3; num -= pl, bp += pl) {
+        pc = sg_get_unaligned_be16(bp + 0);
+        pl = bp[3] + 4;
+        if (pl > num)
+            break;
+        if ((6 != (0xf & bp[4])) || (pl < 8))
+            continue;       /* only SAS is known */
+        for (j = 0, vcp = bp + 8; j < (pl - 8);
+             vcp += spld_len, j += spld_len) {
+            spld_len = vcp[3];
+            if (spld_len < 44)
+                spld_len = 48;      /* in SAS-1 and SAS-1.1 vcp[3]==0 */
+            else
+                spld_len += 4;
+            if ((j + 48) > (pl - 8))
+                break;
+            for (k = 0; k < 4; ++k)
+                snap_add_ctr(arr, &count,
+                             ((uint32_t)pc << 16) + (vcp[1] << 2) + k,
+                             4, vcp + 32 + (4 * k), bp,
+                             sas_phy_ctr_names[k]);
+        }
+    }
+    return count;
+}
+
+/* Outputs the changes of the counters in the log page np since the same
+ * page op_ was collected, secs seconds before. A counter that went down was
+ * reset, unless it may be unbounded (FORMAT AND LINKING 10b) and was in
+ * the upper half of its range, in which case it wrapped. */
+static void
+snap_delta_page(const uint8_t * np, int nlen, const uint8_t * op_, int olen,
+                double secs, const struct opts_t * op)
+{
+    bool shown = false;
+    int k, j, n_num, o_num, pg_code, subpg_code, vpn;
+    uint64_t d, mx;
+    const char * flag;
+    const struct log_elem * lep;
+    struct snap_ctr_t * nca;
+    struct snap_ctr_t * oca;
+    struct snap_ctr_t * cp;
+    char b[80];
+
+    nca = (struct snap_ctr_t *)calloc(2 * SNAP_MAX_CTRS, sizeof(*nca));
+    if (NULL == nca)
+        return;
+    oca = nca + SNAP_MAX_CTRS;
+    n_num = snap_page_ctrs(np, nlen, nca);
+    o_num = snap_page_ctrs(op_, olen, oca);
+    for (k = 0; k < n_num; ++k) {
+        cp = nca + k;
+        for (j = 0; j < o_num; ++j) {
+            if (oca[j].key == cp->key)
+                break;
+        }
+        if (j >= o_num)
+            continue;   /* parameter not in the older page */
+        flag = "";
+        mx = (cp->width >= 8) ? UINT64_MAX :
+                                (((uint64_t)1 << (8 * cp->width)) - 1);
+        if (cp->val >= oca[j].val)
+            d = cp->val - oca[j].val;
+        else if (cp->may_wrap && (oca[j].val > (mx / 2))) {
+            d = (mx - oca[j].val) + cp->val + 1;
+            flag = "  [wrapped]";
+        } else {
+            d = cp->val;
+            flag = "  [reset]";
+        }
+        if (cp->du)
+            flag = "  [saturated]";
+        if ((0 == d) && op->do_brief && ('\0' == flag[0]))
+            continue;
+        if (! shown) {
+            pg_code = np[0] & 0x3f;
+            subpg_code = (np[0] & 0x40) ? np[1] : NOT_SPG_SUBPG;
+            vpn = (op->vend_prod_num >= 0) ? op->vend_prod_num :
+                                             op->deduced_vpn;
+            lep = pg_subpg_pdt_search(pg_code, subpg_code, op->dev_pdt, vpn);
+            if (subpg_code)
+                printf("  %s  [0x%x,0x%x]\n", (lep ? lep->name : "log page"),
+                       pg_code, subpg_code);
+            else
+                printf("  %s  [0x%x]\n", (lep ? lep->name : "log page"),
+                       pg_code);
+            shown = true;
+        }
+        if (PROTO_SPECIFIC_LPAGE == (np[0] & 0x3f))
+            snprintf(b, sizeof(b), "port %u phy %u: %s", cp->key >> 16,
+                     (0xffff & cp->key) >> 2, cp->name);
+        else if (cp->name)
+            snprintf(b, sizeof(b), "%s", cp->name);
+        else
+            snprintf(b, sizeof(b), "parameter code 0x%x", cp->key >> 16);
+        printf("    %s: %" PRIu64 " -> %" PRIu64 ", delta=%" PRIu64, b,
+               oca[j].val, cp->val, d);
+        if (secs > 0.0)
+            printf(" (%.3f/s)", (double)d / secs);
+        printf("%s\n", flag);
+    }
+    free(nca);
+}
+
+/* Implements --in=SFN --delta=OSFN: for each DEVICE in SFN also in the
+ * older snapshot OSFN, outputs the changes in its counters (see
+ * snap_page_ctrs()) and their rates over the time between the snapshots */
+static int
+snap_delta(const char * fn, const char * old_fn, struct opts_t * op)
+{
+    bool found = false;
+    int off, o_off, o_dev_off, tag, o_tag, len, o_len, rlen, o_rlen, nlen;
+    int ret;
+    int num_devs = 0;
+    double secs = 0.0;
+    uint8_t * bp = NULL;
+    uint8_t * obp = NULL;
+    const uint8_t * rp;
+    const uint8_t * orp;
+
+    len = 0;
+    o_len = 0;
+    o_dev_off = 0;
+    if ((ret = snap_read(fn, &bp, &len)))
+        return ret;
+    if ((ret = snap_read(old_fn, &obp, &o_len)))
+        goto fini;
+    off = sizeof(snap_magic);
+    while ((tag = snap_next(bp, len, &off, &rp, &rlen)) > 0) {
+        if ('D' == tag) {
+            snap_set_dev(rp, op);
+            nlen = rlen - SNAP_DEV_HDR_LEN;
+            o_off = sizeof(snap_magic);
+            found = false;
+            while ((o_tag = snap_next(obp, o_len, &o_off, &orp,
+                                      &o_rlen)) > 0) {
+                if (('D' == o_tag) && (nlen == (o_rlen - SNAP_DEV_HDR_LEN)) &&
+                    (0 == memcmp(rp + SNAP_DEV_HDR_LEN,
+                                 orp + SNAP_DEV_HDR_LEN, nlen))) {
+                    found = true;
+                    o_dev_off = o_off;
+                    secs = ((double)sg_get_unaligned_be64(rp + 4) -
+                            (double)sg_get_unaligned_be64(orp + 4)) / 1e6;
+                    break;
+                }
+            }
+            if (found)
+                printf("%s%.*s:    interval %.3f seconds\n",
+                       (num_devs++ ? "\n" : ""), nlen,
+                       (const char *)(rp + SNAP_DEV_HDR_LEN), secs);
+            else if (op->verbose)
+                pr2serr("%.*s: not in %s\n", nlen,
+                        (const char *)(rp + SNAP_DEV_HDR_LEN), old_fn);
+            continue;
+        }
+        if (! found)
+            continue;
+        /* find the same page in the older snapshot, of the same DEVICE */
+        o_off = o_dev_off;
+        while ((o_tag = snap_next(obp, o_len, &o_off, &orp, &o_rlen)) ==
+               'P') {
+            if ((orp[0] & 0x3f) != (rp[0] & 0x3f))
+                continue;
+            if (((rp[0] & 0x40) ? rp[1] : 0) == ((orp[0] & 0x40) ? orp[1] : 0))
+                break;
+        }
+        if ('P' == o_tag)
+            snap_delta_page(rp, rlen, orp, o_rlen, secs, op);
+    }
+    if (tag < 0) {
+        pr2serr("%s: snapshot malformed at offset %d\n", fn, off);
+        ret = SG_LIB_FILE_ERROR;
+    }
+fini:
+    free(bp);
+    free(obp);
+    return ret;
+}
 
 int
 main(int argc, char * argv[])
@@ -6727,6 +7918,7 @@ main(int argc, char * argv[])
     uint8_t * free_parr = NULL;
     struct sg_simple_inquiry_resp inq_out;
     struct opts_t opts;
+    struct sgj_state json_st;
     struct opts_t * op;
 
     op = &opts;
@@ -6786,6 +7978,47 @@ main(int argc, char * argv[])
         enumerate_pages(op);
         return 0;
     }
+    if (op->delta_fn && (op->device_name || (NULL == op->in_fn))) {
+        pr2serr("--delta=OSFN needs --in=SFN and no DEVICE\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->do_cbor && (0 == op->do_json))
+        op->do_json = 1;
+    if (op->do_json) {
+        if (op->do_raw || op->do_hex || op->do_name || op->do_values ||
+            op->do_select || op->do_temperature || op->collect_fn ||
+            op->delta_fn) {
+            pr2serr("--json and --cbor cannot be used with --hex, --name, "
+                    "--raw,\n--select, --temperature, --values, --collect "
+                    "or --delta\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->do_cbor) {
+            if (sg_set_binary_mode(STDOUT_FILENO) < 0)
+                perror("sg_set_binary_mode");
+            k = sgj_init_cbor(&json_st, STDOUT_FILENO);
+        } else
+            k = sgj_init(&json_st, STDOUT_FILENO, (op->do_json > 1));
+        if (k) {
+            pr2serr("Unable to allocate JSON output buffer\n");
+            return sg_convert_errno(ENOMEM);
+        }
+        op->jsp = &json_st;
+    }
+    if (op->collect_fn) {
+        if (NULL == op->device_name) {
+            pr2serr("--collect=SFN needs at least one DEVICE\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (op->do_select || op->do_temperature || op->do_transport ||
+            op->in_fn) {
+            pr2serr("--collect cannot be used with --select, "
+                    "--temperature, --transport\nor --in\n");
+            return SG_LIB_CONTRADICT;
+        }
+        ret = collect_logs(op);
+        goto err_out;
+    }
     rsp_buff = sg_memalign(rsp_buff_sz, 0 /* page aligned */, &free_rsp_buff,
                            false);
     if (NULL == rsp_buff) {
@@ -6800,6 +8033,21 @@ main(int argc, char * argv[])
             int pg_code, subpg_code, pdt, n;
             uint16_t u;
 
+            if (op->delta_fn) {
+                if (! (snap_is_file(op->in_fn) &&
+                       snap_is_file(op->delta_fn))) {
+                    pr2serr("--delta=OSFN needs both --in=SFN and OSFN to "
+                            "be snapshots from --collect\n");
+                    ret = SG_LIB_SYNTAX_ERROR;
+                    goto err_out;
+                }
+                ret = snap_delta(op->in_fn, op->delta_fn, op);
+                goto err_out;
+            }
+            if (snap_is_file(op->in_fn)) {
+                ret = snap_decode(op->in_fn, op);
+                goto err_out;
+            }
             if ((ret = sg_f2hex_arr(op->in_fn, op->do_raw, false, rsp_buff,
                                     &in_len, rsp_buff_sz)))
                 goto err_out;
@@ -6831,7 +8079,9 @@ main(int argc, char * argv[])
                 pdt = op->dev_pdt;
                 lep = pg_subpg_pdt_search(pg_code, subpg_code, pdt,
                                           op->vend_prod_num);
-                if (lep) {
+                if (op->do_json)
+                    show_page_json(bp, n, op);
+                else if (lep) {
                     if (lep->show_pagep)
                         (*lep->show_pagep)(bp, n, op);
                     else
@@ -6890,6 +8140,31 @@ main(int argc, char * argv[])
             goto err_out;
         }
     }
+    if (op->param_given) {
+        if (op->do_all || op->do_list || op->do_select ||
+            op->do_temperature || op->do_transport) {
+            pr2serr("--param=PC only fetches one parameter of the page "
+                    "given by --page=\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        if (op->paramp && (op->paramp != op->param_pc)) {
+            pr2serr("--param=PC conflicts with --paramp=PP\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        if (op->filter_given && (op->filter != op->param_pc)) {
+            pr2serr("--param=PC conflicts with --filter=FL\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        /* device returns parameters with codes >= PC, only want first */
+        op->paramp = op->param_pc;
+        op->filter = op->param_pc;
+        op->filter_given = true;
+        if (0 == op->maxlen)
+            op->maxlen = LOG_PARAM_ALLOC_LEN;
+    }
     if (op->in_fn) {
         if (! op->do_select) {
             pr2serr("--in=FN can only be used with --select when DEVICE "
@@ -6960,7 +8235,8 @@ main(int argc, char * argv[])
         }
         op->dev_pdt = inq_out.peripheral_type;
         if ((! op->do_raw) && (0 == op->do_hex) && (! op->do_name) &&
-            (0 == op->no_inq) && (0 == op->do_brief))
+            (! op->do_values) && (! op->do_json) && (0 == op->no_inq) &&
+            (0 == op->do_brief))
             printf("    %.8s  %.16s  %.4s\n", inq_out.vendor,
                    inq_out.product, inq_out.revision);
         memcpy(t10_vendor_str, inq_out.vendor, 8);
@@ -6997,7 +8273,15 @@ main(int argc, char * argv[])
     }
     resp_len = (op->maxlen > 0) ? op->maxlen : MX_ALLOC_LEN;
     res = do_logs(sg_fd, rsp_buff, resp_len, op);
-    if (0 == res) {
+    if ((0 == res) && op->param_given) {
+        pg_len = param_trim(rsp_buff, resp_len, op->param_pc);
+        if (pg_len < 0) {
+            pr2serr("parameter code 0x%x not found in log page 0x%x\n",
+                    op->param_pc, op->pg_code);
+            ret = SG_LIB_CAT_OTHER;
+            goto err_out;
+        }
+    } else if (0 == res) {
         pg_len = sg_get_unaligned_be16(rsp_buff + 2);
         if ((pg_len + 4) > resp_len) {
             pr2serr("Only fetched %d bytes of response (available: %d "
@@ -7069,7 +8353,7 @@ main(int argc, char * argv[])
             /* Some devices include [pg_code, 0xff] for all pg_code > 0 */
             if ((op->pg_code > 0) && (SUPP_SPGS_SUBPG == op->subpg_code))
                 continue;       /* skip since no new information */
-            if (! op->do_raw)
+            if ((! op->do_raw) && (! op->do_values) && (! op->do_json))
                 printf("\n");
             res = do_logs(sg_fd, rsp_buff, resp_len, op);
             if (0 == res) {
@@ -7114,6 +8398,8 @@ main(int argc, char * argv[])
         }
     }
 err_out:
+    if (op->jsp && sgj_fini(op->jsp) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
     if (free_rsp_buff)
         free(free_rsp_buff);
     if (free_parr)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2018 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -22,6 +22,15 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifdef SG_LIB_LINUX
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include "sg_linux_inc.h"
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_unaligned.h"
@@ -34,7 +43,7 @@
  * and decodes the response.
  */
 
-static const char * version_str = "1.42 20180626";
+static const char * version_str = "1.43 20261014";
 
 #define MAX_RLUNS_BUFF_LEN (1024 * 1024)
 #define DEF_RLUNS_BUFF_LEN (1024 * 8)
@@ -57,6 +66,9 @@ static struct option long_options[] = {
         {"test", required_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
+#ifdef SG_LIB_LINUX
+        {"walk", no_argument, 0, 'w'},
+#endif
         {0, 0, 0, 0},
 };
 
@@ -70,7 +82,8 @@ usage()
             "                  [--maxlen=LEN] [--quiet] [--raw] "
             "[--readonly]\n"
             "                  [--select=SR] [--verbose] [--version] "
-            "DEVICE\n");
+            "[--walk]\n"
+            "                  DEVICE\n");
 #else
     pr2serr("Usage: sg_luns    [--decode] [--help] [--hex] [--lu_cong] "
             "[--maxlen=LEN]\n"
@@ -115,13 +128,22 @@ usage()
             "options\n"
             "                           and DEVICE (apart from '-H')\n"
             "    --verbose|-v       increase verbosity\n"
-            "    --version|-V       print version string and exit\n\n"
+            "    --version|-V       print version string and exit\n",
+            DEF_RLUNS_BUFF_LEN);
+#ifdef SG_LIB_LINUX
+    pr2serr("    --walk|-w          probe each reported lun (TUR, INQUIRY "
+            "and READ\n"
+            "                       CAPACITY) via its sysfs device node, "
+            "in parallel,\n"
+            "                       and output a line per lun\n");
+#endif
+    pr2serr("\n"
             "Performs a SCSI REPORT LUNS command or decodes the given ALUN. "
             "When SR is\n0x10 or 0x11 DEVICE must be LUN 0 or REPORT LUNS "
             "well known logical unit;\nwhen SR is 0x12 DEVICE must be an "
             "administrative logical unit. When the\n--test=ALUN option is "
             "given, decodes ALUN rather than sending a REPORT\nLUNS "
-            "command.\n", DEF_RLUNS_BUFF_LEN );
+            "command.\n");
 }
 
 /* Decoded according to SAM-5 rev 10. Note that one draft: BCC rev 0,
@@ -343,6 +365,271 @@ t10_2linux_lun(const uint8_t t10_lun[])
         res = (res << 16) + sg_get_unaligned_be16(cp);
     return res;
 }
+
+/* --walk: each LUN that REPORT LUNS yields is probed by one of up to this
+ * many threads, while the rest of the table is collected */
+#define WALK_MAX_THREADS 16
+
+static const char * sysfs_scsi_devs = "/sys/bus/scsi/devices";
+static const char * dev_dir = "/dev";
+
+struct walk_lun_t {
+    uint8_t t10_lun[8];
+    uint64_t lin_lun;
+    int open_res;       /* 0 or errno from opening dev_name */
+    int tur_res;
+    int inq_res;
+    int cap_res;        /* -1 when READ CAPACITY not sent */
+    uint32_t blk_len;
+    uint64_t num_blks;
+    struct sg_simple_inquiry_resp sir;
+    char dev_name[NAME_MAX + 32];       /* empty: sysfs has no node */
+};
+
+struct walk_coll_t {
+    int num_luns;
+    int next_ind;       /* next LUN to probe, claimed atomically */
+    int verbose;
+    struct walk_lun_t * arr;
+};
+
+/* Finds the host, channel and target of the (already open) DEVICE, first
+ * from the name of its SCSI device directory in sysfs, then with the
+ * SG_GET_SCSI_ID ioctl (sg devices only). Returns 0 on success. */
+static int
+walk_get_hct(int sg_fd, int * hp, int * cp, int * tp)
+{
+    unsigned long long ull;
+    struct stat st;
+    struct sg_scsi_id sid;
+    const char * bnp;
+    char b[PATH_MAX];
+    char rp[PATH_MAX];
+
+    if ((0 == fstat(sg_fd, &st)) &&
+        (S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode))) {
+        snprintf(b, sizeof(b), "/sys/dev/%s/%u:%u/device",
+                 (S_ISCHR(st.st_mode) ? "char" : "block"),
+                 major(st.st_rdev), minor(st.st_rdev));
+        if (realpath(b, rp)) {
+            bnp = strrchr(rp, '/');
+            bnp = bnp ? (bnp + 1) : rp;
+            if (4 == sscanf(bnp, "%d:%d:%d:%llu", hp, cp, tp, &ull))
+                return 0;
+        }
+    }
+    memset(&sid, 0, sizeof(sid));
+    if (ioctl(sg_fd, SG_GET_SCSI_ID, &sid) < 0)
+        return -1;
+    *hp = sid.host_no;
+    *cp = sid.channel;
+    *tp = sid.scsi_id;
+    return 0;
+}
+
+/* Places in dnp the name of the sg device node of SCSI device
+ * <h:c:t:lin_lun>, else of its block device node, else an empty string */
+static void
+walk_find_dev(int h, int c, int t, uint64_t lin_lun, char * dnp,
+              int dn_len)
+{
+    static const char * const sub_dirs[] = {"scsi_generic", "block"};
+    int k;
+    DIR * dirp;
+    struct dirent * dep;
+    char b[PATH_MAX];
+
+    dnp[0] = '\0';
+    for (k = 0; k < 2; ++k) {
+        snprintf(b, sizeof(b), "%s/%d:%d:%d:%" PRIu64 "/%s",
+                 sysfs_scsi_devs, h, c, t, lin_lun, sub_dirs[k]);
+        if (NULL == (dirp = opendir(b)))
+            continue;
+        while ((dep = readdir(dirp))) {
+            if ('.' != dep->d_name[0]) {
+                snprintf(dnp, dn_len, "%s/%s", dev_dir, dep->d_name);
+                break;
+            }
+        }
+        closedir(dirp);
+        if (dnp[0])
+            return;
+    }
+}
+
+static bool
+walk_has_capacity(int pdt)
+{
+    switch (pdt) {
+    case PDT_DISK:
+    case PDT_WO:
+    case PDT_MMC:
+    case PDT_OPTICAL:
+    case PDT_RBC:
+    case PDT_ZBC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Sends TEST UNIT READY, INQUIRY and, for "block" devices, READ CAPACITY
+ * to the node found for one LUN. Outcomes are kept in wlp for the table. */
+static void
+walk_probe(struct walk_lun_t * wlp, int verbose)
+{
+    int fd;
+    uint32_t last;
+    uint8_t b[32];
+
+    wlp->cap_res = -1;
+    fd = sg_cmds_open_device(wlp->dev_name, true /* ro */, verbose);
+    if (fd < 0) {
+        wlp->open_res = -fd;
+        return;
+    }
+    wlp->tur_res = sg_ll_test_unit_ready(fd, 0, false, verbose);
+    wlp->inq_res = sg_simple_inquiry(fd, &wlp->sir, false, verbose);
+    if ((0 == wlp->inq_res) &&
+        walk_has_capacity(0x1f & wlp->sir.peripheral_type)) {
+        wlp->cap_res = sg_ll_readcap_10(fd, false, 0, b, 8, false, verbose);
+        if (0 == wlp->cap_res) {
+            last = sg_get_unaligned_be32(b + 0);
+            wlp->blk_len = sg_get_unaligned_be32(b + 4);
+            wlp->num_blks = (uint64_t)last + 1;
+            if (0xffffffff == last) {
+                wlp->cap_res = sg_ll_readcap_16(fd, false, 0, b, 32, false,
+                                                verbose);
+                if (0 == wlp->cap_res) {
+                    wlp->num_blks = sg_get_unaligned_be64(b + 0) + 1;
+                    wlp->blk_len = sg_get_unaligned_be32(b + 8);
+                }
+            }
+        }
+    }
+    sg_cmds_close_device(fd);
+}
+
+static void *
+walk_worker(void * v_wcp)
+{
+    int k;
+    struct walk_coll_t * wcp = (struct walk_coll_t *)v_wcp;
+
+    while ((k = __atomic_fetch_add(&wcp->next_ind, 1, __ATOMIC_RELAXED)) <
+           wcp->num_luns) {
+        if (wcp->arr[k].dev_name[0])
+            walk_probe(wcp->arr + k, wcp->verbose);
+    }
+    return NULL;
+}
+
+/* Short outcome of a probe for the TUR column */
+static const char *
+walk_res_str(const struct walk_lun_t * wlp, char * b, int blen)
+{
+    if (0 == wlp->dev_name[0])
+        return "no device";
+    if (wlp->open_res)
+        snprintf(b, blen, "%s", safe_strerror(wlp->open_res));
+    else if (0 == wlp->tur_res)
+        return "ready";
+    else
+        sg_get_category_sense_str(wlp->tur_res, blen, b, 0);
+    return b;
+}
+
+/* Implements --walk: finds the device node, in sysfs, of each of the luns
+ * entries in the REPORT LUNS response at rlp, probes those found in
+ * parallel then outputs a line per LUN, in response order. */
+static int
+walk_luns(int sg_fd, const uint8_t * rlp, int luns, bool do_linux,
+          int do_hex, int verbose)
+{
+    int k, h, c, t, n_thr, err;
+    double gb;
+    struct walk_lun_t * wlp;
+    struct walk_coll_t wc;
+    pthread_t tids[WALK_MAX_THREADS];
+    char b[80];
+
+    if (walk_get_hct(sg_fd, &h, &c, &t)) {
+        pr2serr("--walk: unable to find host, channel and target of "
+                "DEVICE\n");
+        return SG_LIB_FILE_ERROR;
+    }
+    if (verbose)
+        pr2serr("--walk: DEVICE is at host=%d channel=%d target=%d\n", h, c,
+                t);
+    memset(&wc, 0, sizeof(wc));
+    wc.num_luns = luns;
+    wc.verbose = (verbose > 0) ? verbose - 1 : 0;
+    if (luns > 0) {
+        wc.arr = (struct walk_lun_t *)calloc(luns, sizeof(*wc.arr));
+        if (NULL == wc.arr) {
+            pr2serr("--walk: unable to allocate %d LUN entries\n", luns);
+            return sg_convert_errno(ENOMEM);
+        }
+    }
+    for (k = 0; k < luns; ++k) {
+        wlp = wc.arr + k;
+        memcpy(wlp->t10_lun, rlp + 8 + (8 * k), 8);
+        wlp->lin_lun = t10_2linux_lun(wlp->t10_lun);
+        walk_find_dev(h, c, t, wlp->lin_lun, wlp->dev_name,
+                      sizeof(wlp->dev_name));
+        if (verbose > 1)
+            pr2serr("--walk: lun %" PRIu64 " --> %s\n", wlp->lin_lun,
+                    (wlp->dev_name[0] ? wlp->dev_name : "<none>"));
+    }
+    /* this thread is one of the workers */
+    n_thr = (luns < WALK_MAX_THREADS) ? luns : WALK_MAX_THREADS;
+    for (k = 1; k < n_thr; ++k) {
+        err = pthread_create(tids + k, NULL, walk_worker, &wc);
+        if (err) {
+            if (verbose)
+                pr2serr("--walk: pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    n_thr = k;
+    walk_worker(&wc);
+    for (k = 1; k < n_thr; ++k)
+        pthread_join(tids[k], NULL);
+
+    printf("%-16s  %-*s%-12s  %-14s  %-10s  %-8s  %-16s  %-4s  %s\n",
+           "LUN", (do_linux ? 10 : 0), (do_linux ? "Linux" : ""), "device",
+           "TUR", "type", "vendor", "product", "rev", "capacity");
+    for (k = 0; k < luns; ++k) {
+        wlp = wc.arr + k;
+        printf("%016" PRIx64 "  ", sg_get_unaligned_be64(wlp->t10_lun));
+        if (do_linux) {
+            if (do_hex > 1)
+                snprintf(b, sizeof(b), "0x%" PRIx64, wlp->lin_lun);
+            else
+                snprintf(b, sizeof(b), "%" PRIu64, wlp->lin_lun);
+            printf("%-8s  ", b);
+        }
+        printf("%-12s  %-14.14s", (wlp->dev_name[0] ? wlp->dev_name : "-"),
+               walk_res_str(wlp, b, sizeof(b)));
+        if ((0 == wlp->dev_name[0]) || wlp->open_res || wlp->inq_res) {
+            printf("\n");
+            continue;
+        }
+        printf("  %-10.10s  %-8s  %-16s  %-4s",
+               sg_get_pdt_str(0x1f & wlp->sir.peripheral_type, sizeof(b),
+                              b),
+               wlp->sir.vendor, wlp->sir.product, wlp->sir.revision);
+        if (0 == wlp->cap_res) {
+            gb = ((double)wlp->num_blks * wlp->blk_len) / 1e9;
+            printf("  %" PRIu64 "x%u (%.2f GB)", wlp->num_blks,
+                   wlp->blk_len, gb);
+        } else if (wlp->cap_res > 0)
+            printf("  -");
+        printf("\n");
+    }
+    free(wc.arr);
+    return 0;
+}
 #endif  /* SG_LIB_LINUX */
 
 
@@ -360,6 +647,7 @@ main(int argc, char * argv[])
 {
 #ifdef SG_LIB_LINUX
     bool do_linux = false;
+    bool do_walk = false;
 #endif
     bool do_quiet = false;
     bool do_raw = false;
@@ -393,7 +681,7 @@ main(int argc, char * argv[])
         int option_index = 0;
 
 #ifdef SG_LIB_LINUX
-        c = getopt_long(argc, argv, "dhHlLm:qrRs:t:vV", long_options,
+        c = getopt_long(argc, argv, "dhHlLm:qrRs:t:vVw", long_options,
                         &option_index);
 #else
         c = getopt_long(argc, argv, "dhHLm:qrRs:t:vV", long_options,
@@ -415,7 +703,7 @@ main(int argc, char * argv[])
             break;
 #ifdef SG_LIB_LINUX
         case 'l':
-            do_linux = false;
+            do_linux = true;
             break;
 #endif
         case 'L':
@@ -456,6 +744,11 @@ main(int argc, char * argv[])
         case 'V':
             version_given = true;
             break;
+#ifdef SG_LIB_LINUX
+        case 'w':
+            do_walk = true;
+            break;
+#endif
         default:
             pr2serr("unrecognised option code 0x%x ??\n", c);
             usage();
@@ -589,6 +882,12 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+#ifdef SG_LIB_LINUX
+    if (do_walk && (do_raw || (1 == do_hex))) {
+        pr2serr("--walk cannot be used with --raw or a single --hex\n");
+        return SG_LIB_CONTRADICT;
+    }
+#endif
 
     if (do_raw) {
         if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
@@ -658,6 +957,13 @@ main(int argc, char * argv[])
             pr2serr("\nOutput response in hex\n");
             hex2stderr(reportLunsBuff, (trunc ? maxlen : list_len + 8), 1);
         }
+#ifdef SG_LIB_LINUX
+        if (do_walk) {
+            ret = walk_luns(sg_fd, reportLunsBuff, luns, do_linux, do_hex,
+                            verbose);
+            goto the_end;
+        }
+#endif
         for (k = 0, off = 8; k < luns; ++k, off += 8) {
             if (! do_quiet) {
                 if (0 == k)
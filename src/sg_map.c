@@ -1,6 +1,6 @@
 /*
  * Utility program for the Linux OS SCSI generic ("sg") device driver.
- *     Copyright (C) 2000-2017 D. Gilbert
+ *     Copyright (C) 2000-2026 D. Gilbert
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2, or (at your option)
@@ -35,6 +35,7 @@
 #include <errno.h>
 #include <dirent.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -47,7 +48,7 @@
 #include "sg_io_linux.h"
 
 
-static const char * version_str = "1.12 20171010";
+static const char * version_str = "1.13 20261014";
 
 static const char * devfs_id = "/dev/.devfsd";
 
@@ -58,6 +59,14 @@ static const char * devfs_id = "/dev/.devfsd";
 #define PRESENT_ARRAY_SIZE MAX_SG_DEVS
 
 static const char * sysfs_sg_dir = "/sys/class/scsi_generic";
+static const char * map_cache_fn = "/run/sg_map.cache";
+static const char * map_cache_hdr = "# sg_map cache ";
+
+/* with their mtimes these make up the key of the mapping cache */
+static const char * map_cache_dirs[] = {
+    "/dev", "/sys/class/scsi_generic", "/sys/class/scsi_device",
+    "/sys/block", NULL,
+};
 static char gen_index_arr[PRESENT_ARRAY_SIZE];
 static int has_sysfs_sg = 0;
 
@@ -90,6 +99,9 @@ static my_map_info_t map_arr[MAX_SG_DEVS];
 #define LIN_DEV_TYPE_SCD 4
 #define LIN_DEV_TYPE_OSST 5
 
+#define DEF_MAP_JOBS 16
+#define MAX_MAP_JOBS 256
+
 
 typedef struct my_scsi_idlun {
 /* why can't userland see this structure ??? */
@@ -97,23 +109,51 @@ typedef struct my_scsi_idlun {
     int host_unique_id;
 } My_scsi_idlun;
 
+/* One device node opened, and whose ioctls are issued, by a worker thread
+ * with -p . The results are applied to map_arr[] afterwards, in the same
+ * order as the serial scan would have. */
+typedef struct map_probe {
+    int lin_dev_type;   /* LIN_DEV_TYPE_UNKNOWN for a sg device node */
+    int k;              /* index in the device node name */
+    int err;            /* errno of the failing call, 0 if all succeeded */
+    int failed_at;      /* 0: open(), 1: first ioctl, 2: second ioctl */
+    int host_no;
+    My_scsi_idlun my_idlun;
+    char fname[64];
+} map_probe_t;
+
+typedef struct map_coll {
+    bool do_inquiry;
+    int num_probes;
+    int next_ind;
+    map_probe_t * arr;
+} map_coll_t;
+
 
 #define EBUFF_SZ 256
 static char ebuff[EBUFF_SZ];
 
 static void scan_dev_type(const char * leadin, int max_dev, bool do_numeric,
                           int lin_dev_type, int last_sg_ind);
+static int find_dev_in_sg_arr(My_scsi_idlun * my_idlun, int host_no,
+                              int last_sg_ind);
 
 static void usage()
 {
-    printf("Usage: sg_map [-a] [-h] [-i] [-n] [-sd] [-scd or -sr] [-st] "
-           "[-V] [-x]\n");
+    printf("Usage: sg_map [-a] [-c] [-h] [-i] [-n] [-p[=J]] [-sd] "
+           "[-scd or -sr] [-st]\n"
+           "              [-V] [-x]\n");
     printf("  where:\n");
     printf("    -a      do alphabetic scan (ie sga, sgb, sgc)\n");
+    printf("    -c      use (and refresh) the mapping cached in %s\n"
+           "            while the mtimes of /dev and sysfs are "
+           "unchanged\n", map_cache_fn);
     printf("    -h or -?    show this usage message then exit\n");
     printf("    -i      also show device INQUIRY strings\n");
     printf("    -n      do numeric scan (i.e. sg0, sg1, sg2) "
            "(default)\n");
+    printf("    -p[=J]  open and probe J device nodes at a time "
+           "(def: %d)\n", DEF_MAP_JOBS);
     printf("    -sd     show mapping to disks\n");
     printf("    -scd    show mapping to cdroms (look for /dev/scd<n>\n");
     printf("    -sr     show mapping to cdroms (look for /dev/sr<n>\n");
@@ -187,10 +227,418 @@ static void make_dev_name(char * fname, const char * leadin, int k,
     }
 }
 
+/* Inverse of make_dev_name(): returns k for the given device name suffix
+ * (e.g. "12" or "ab"), or -1 if it is not of that form. */
+static int dev_name_index(const char * suffix, bool do_numeric)
+{
+    int k, n;
+    const char * cp;
+
+    if ('\0' == *suffix)
+        return -1;
+    if (do_numeric) {
+        for (k = 0, cp = suffix; *cp; ++cp) {
+            if ((*cp < '0') || (*cp > '9') || (k > MAX_SD_DEVS))
+                return -1;
+            k = (k * 10) + (*cp - '0');
+        }
+        return k;
+    }
+    for (n = 0, cp = suffix; *cp; ++cp, ++n) {
+        if ((*cp < 'a') || (*cp > 'z') || (n >= 3))
+            return -1;
+    }
+    switch (n) {
+    case 1:
+        return suffix[0] - 'a';
+    case 2:
+        return 26 + (26 * (suffix[0] - 'a')) + (suffix[1] - 'a');
+    default:
+        return (26 + 26*26) + (26*26 * (suffix[0] - 'a')) +
+               (26 * (suffix[1] - 'a')) + (suffix[2] - 'a');
+    }
+}
+
+static int map_probe_cmp(const void * ap, const void * bp)
+{
+    return ((const map_probe_t *)ap)->k - ((const map_probe_t *)bp)->k;
+}
+
+/* Appends a probe to cp->arr for each sg device node that sysfs says is
+ * present then, for each of the num_types leadins, for each node in /dev
+ * with that leadin. So only nodes that exist are opened, rather than every
+ * name up to max_dev. Returns 0 on success. */
+static int build_map_probes(map_coll_t * cp, const char ** leadins,
+                            const int * max_devs, const bool * numerics,
+                            const int * lin_types, int num_types)
+{
+    int k, j, n, ind, start, max_num;
+    size_t len;
+    const char * bname;
+    struct dirent ** namelist = NULL;
+    map_probe_t * mpp;
+
+    n = scandir("/dev", &namelist, NULL, NULL);
+    if (n < 0)
+        return -errno;
+    max_num = PRESENT_ARRAY_SIZE + n;
+    cp->arr = (map_probe_t *)calloc(max_num, sizeof(map_probe_t));
+    if (NULL == cp->arr) {
+        for (k = 0; k < n; ++k)
+            free(namelist[k]);
+        free(namelist);
+        return -ENOMEM;
+    }
+    for (k = 0; k < MAX_SG_DEVS; ++k) {
+        if (0 == gen_index_arr[k])
+            continue;
+        mpp = cp->arr + cp->num_probes++;
+        mpp->lin_dev_type = LIN_DEV_TYPE_UNKNOWN;
+        mpp->k = k;
+        make_dev_name(mpp->fname, "/dev/sg", k, true);
+    }
+    for (j = 0; j < num_types; ++j) {
+        bname = leadins[j] + strlen("/dev/");
+        len = strlen(bname);
+        start = cp->num_probes;
+        for (k = 0; (k < n) && (cp->num_probes < max_num); ++k) {
+            if (strncmp(namelist[k]->d_name, bname, len))
+                continue;
+            ind = dev_name_index(namelist[k]->d_name + len, numerics[j]);
+            if ((ind < 0) || (ind >= max_devs[j]))
+                continue;
+            mpp = cp->arr + cp->num_probes++;
+            mpp->lin_dev_type = lin_types[j];
+            mpp->k = ind;
+            make_dev_name(mpp->fname, leadins[j], ind, numerics[j]);
+        }
+        qsort(cp->arr + start, cp->num_probes - start, sizeof(map_probe_t),
+              map_probe_cmp);
+    }
+    for (k = 0; k < n; ++k)
+        free(namelist[k]);
+    free(namelist);
+    return 0;
+}
+
+/* Takes probes, in order, until none are left. A sg device node has its
+ * SG_GET_SCSI_ID (and INQUIRY, with -i) results placed in map_arr[]
+ * directly since no two probes share an index; other nodes keep their
+ * IDLUN and bus number for map_apply_probes(). */
+static void * map_worker(void * v_cp)
+{
+    int k, fd;
+    map_coll_t * cp = (map_coll_t *)v_cp;
+    map_probe_t * mpp;
+    char buff[INQUIRY_RESP_INITIAL_LEN];
+
+    while ((k = __atomic_fetch_add(&cp->next_ind, 1, __ATOMIC_RELAXED)) <
+           cp->num_probes) {
+        mpp = cp->arr + k;
+        fd = open(mpp->fname, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            mpp->err = errno;
+            continue;
+        }
+        if (LIN_DEV_TYPE_UNKNOWN == mpp->lin_dev_type) {
+            if (ioctl(fd, SG_GET_SCSI_ID, &map_arr[mpp->k].sg_dat) < 0) {
+                mpp->err = errno;
+                mpp->failed_at = 1;
+            } else if (cp->do_inquiry &&
+                       (0 == sg_ll_inquiry(fd, false, false, 0, buff,
+                                           sizeof(buff), true, 0))) {
+                memcpy(map_arr[mpp->k].vendor, &buff[8], 8);
+                memcpy(map_arr[mpp->k].product, &buff[16], 16);
+                memcpy(map_arr[mpp->k].revision, &buff[32], 4);
+            }
+        } else if (ioctl(fd, SCSI_IOCTL_GET_IDLUN, &mpp->my_idlun) < 0) {
+            mpp->err = errno;
+            mpp->failed_at = 1;
+        } else if (ioctl(fd, SCSI_IOCTL_GET_BUS_NUMBER, &mpp->host_no) < 0) {
+            mpp->err = errno;
+            mpp->failed_at = 2;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+/* Applies the results of the sg device node probes, then of each other
+ * device type's, to map_arr[] with the same error reporting and
+ * MAX_ERRORS limits as the serial scan. Returns the last sg index found
+ * (-1 for none) or -2 if there were too many errors. */
+static int map_apply_probes(const map_coll_t * cp)
+{
+    bool eacces_err = false;
+    int k, ind;
+    int num_errors = 0;
+    int num_silent = 0;
+    int last_sg_ind = -1;
+    int lin_dev_type = LIN_DEV_TYPE_UNKNOWN;
+    const map_probe_t * mpp;
+
+    for (k = 0, mpp = cp->arr; k < cp->num_probes; ++k, ++mpp) {
+        if (mpp->lin_dev_type != lin_dev_type) {
+            if (LIN_DEV_TYPE_UNKNOWN == lin_dev_type) {
+                if ((num_errors >= MAX_ERRORS) && (num_silent < num_errors))
+                    break;
+            }
+            lin_dev_type = mpp->lin_dev_type;
+            num_errors = 0;
+            num_silent = 0;
+        }
+        if (num_errors >= MAX_ERRORS)
+            continue;
+        if (LIN_DEV_TYPE_UNKNOWN == mpp->lin_dev_type) {
+            if (0 == mpp->err) {
+                map_arr[mpp->k].active = 1;
+                map_arr[mpp->k].oth_dev_num = -1;
+                last_sg_ind = mpp->k;
+            } else if (mpp->failed_at) {
+                fprintf(stderr, "device %s failed on sg ioctl, skip: %s\n",
+                        mpp->fname, safe_strerror(mpp->err));
+                ++num_errors;
+            } else if (EBUSY == mpp->err)
+                map_arr[mpp->k].active = -2;
+            else if ((ENODEV == mpp->err) || (ENOENT == mpp->err) ||
+                     (ENXIO == mpp->err)) {
+                ++num_errors;
+                ++num_silent;
+                map_arr[mpp->k].active = -1;
+            } else {
+                if (EACCES == mpp->err)
+                    eacces_err = true;
+                fprintf(stderr, "Error opening %s : %s\n", mpp->fname,
+                        safe_strerror(mpp->err));
+                ++num_errors;
+            }
+            continue;
+        }
+        if (0 == mpp->err) {
+            ind = find_dev_in_sg_arr((My_scsi_idlun *)&mpp->my_idlun,
+                                     mpp->host_no, last_sg_ind);
+            if (ind >= 0) {
+                map_arr[ind].oth_dev_num = mpp->k;
+                map_arr[ind].lin_dev_type = mpp->lin_dev_type;
+            } else
+                printf("Strange, could not find device %s mapped to sg "
+                       "device??\n", mpp->fname);
+        } else if (mpp->failed_at) {
+            fprintf(stderr, "device %s failed on scsi ioctl(%s), skip: %s\n",
+                    mpp->fname, (1 == mpp->failed_at) ? "idlun" :
+                    "bus_number", safe_strerror(mpp->err));
+            ++num_errors;
+        } else if (EBUSY == mpp->err) {
+            printf("Device %s is busy\n", mpp->fname);
+            ++num_errors;
+        } else if ((ENODEV == mpp->err) || (ENXIO == mpp->err)) {
+            ++num_errors;
+            ++num_silent;
+        } else if (ENOENT != mpp->err) {
+            fprintf(stderr, "Error opening %s : %s\n", mpp->fname,
+                    safe_strerror(mpp->err));
+            ++num_errors;
+        }
+    }
+    if ((LIN_DEV_TYPE_UNKNOWN == lin_dev_type) &&
+        (num_errors >= MAX_ERRORS) && (num_silent < num_errors)) {
+        printf("Stopping because there are too many error\n");
+        if (eacces_err)
+            printf("    root access may be required\n");
+        return -2;
+    }
+    return last_sg_ind;
+}
+
+/* Probes all device nodes with num_thr threads. Returns as for
+ * map_apply_probes() or -3 if the probes could not be set up. */
+static int map_parallel(bool do_inquiry, int num_thr, const char ** leadins,
+                        const int * max_devs, const bool * numerics,
+                        const int * lin_types, int num_types)
+{
+    int k, err, res;
+    map_coll_t coll;
+    pthread_t tids[MAX_MAP_JOBS];
+
+    memset(&coll, 0, sizeof(coll));
+    coll.do_inquiry = do_inquiry;
+    res = build_map_probes(&coll, leadins, max_devs, numerics, lin_types,
+                           num_types);
+    if (res) {
+        fprintf(stderr, "unable to list /dev: %s\n", safe_strerror(-res));
+        return -3;
+    }
+    if (num_thr > coll.num_probes)
+        num_thr = coll.num_probes;
+    for (k = 0; k < num_thr; ++k) {
+        err = pthread_create(tids + k, NULL, map_worker, &coll);
+        if (err) {
+            fprintf(stderr, "pthread_create: %s, continue with %d "
+                    "threads\n", safe_strerror(err), k);
+            break;
+        }
+    }
+    num_thr = k;
+    if (0 == num_thr)
+        map_worker(&coll);      /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+    res = map_apply_probes(&coll);
+    free(coll.arr);
+    return res;
+}
+
+/* Places the cache key in b: the options that change the output, the
+ * mtime of each of map_cache_dirs[] ("-" if absent) and the sg indexes
+ * present. Returns false if the key does not fit in b. */
+static bool map_cache_key(char * b, int blen, const char * opt_str)
+{
+    int k, n;
+    unsigned int sum = 0;
+    struct stat a_stat;
+
+    n = snprintf(b, blen, "%s", opt_str);
+    for (k = 0; map_cache_dirs[k] && (n < blen); ++k) {
+        if (stat(map_cache_dirs[k], &a_stat) < 0)
+            n += snprintf(b + n, blen - n, " -");
+        else
+            n += snprintf(b + n, blen - n, " %ld.%09ld",
+                          (long)a_stat.st_mtim.tv_sec,
+                          (long)a_stat.st_mtim.tv_nsec);
+    }
+    for (k = 0; k < PRESENT_ARRAY_SIZE; ++k) {
+        if (gen_index_arr[k])
+            sum = (sum * 31) + k + 1;
+    }
+    if (n < blen)
+        n += snprintf(b + n, blen - n, " %d:%x", has_sysfs_sg, sum);
+    return n < blen;
+}
+
+/* If the first line of the cache file matches key then copies the rest of
+ * it to stdout and returns true. */
+static bool map_cache_show(const char * key)
+{
+    bool hit = false;
+    size_t n;
+    FILE * fp;
+    char b[512];
+
+    fp = fopen(map_cache_fn, "r");
+    if (NULL == fp)
+        return false;
+    if (fgets(b, sizeof(b), fp) &&
+        (0 == strncmp(b, map_cache_hdr, strlen(map_cache_hdr))) &&
+        (0 == strncmp(b + strlen(map_cache_hdr), key, strlen(key))) &&
+        ('\n' == b[strlen(map_cache_hdr) + strlen(key)])) {
+        hit = true;
+        while ((n = fread(b, 1, sizeof(b), fp)) > 0)
+            fwrite(b, 1, n, stdout);
+    }
+    fclose(fp);
+    return hit;
+}
+
+static void print_map(FILE * fp, bool do_numeric, bool do_extra,
+                      bool do_inquiry, int last_sg_ind)
+{
+    int k;
+    char fname[64];
+
+    for (k = 0; k <= last_sg_ind; ++k) {
+        if (has_sysfs_sg) {
+           if (0 == gen_index_arr[k]) {
+                continue;
+            }
+            make_dev_name(fname, "/dev/sg", k, true);
+        } else
+            make_dev_name(fname, "/dev/sg", k, do_numeric);
+        fprintf(fp, "%s", fname);
+        switch (map_arr[k].active)
+        {
+        case -2:
+            fprintf(fp, do_extra ? "  -2 -2 -2 -2  -2" : "  busy");
+            break;
+        case -1:
+            fprintf(fp, do_extra ? "  -1 -1 -1 -1  -1" : "  not present");
+            break;
+        case 0:
+            fprintf(fp, do_extra ? "  -3 -3 -3 -3  -3" : "  some error");
+            break;
+        case 1:
+            if (do_extra)
+                fprintf(fp, "  %d %d %d %d  %d", map_arr[k].sg_dat.host_no,
+                        map_arr[k].sg_dat.channel, map_arr[k].sg_dat.scsi_id,
+                        map_arr[k].sg_dat.lun, map_arr[k].sg_dat.scsi_type);
+            switch (map_arr[k].lin_dev_type)
+            {
+            case LIN_DEV_TYPE_SD:
+                make_dev_name(fname, "/dev/sd" , map_arr[k].oth_dev_num, 0);
+                fprintf(fp, "  %s", fname);
+                break;
+            case LIN_DEV_TYPE_ST:
+                make_dev_name(fname, "/dev/nst" , map_arr[k].oth_dev_num, 1);
+                fprintf(fp, "  %s", fname);
+                break;
+            case LIN_DEV_TYPE_OSST:
+                make_dev_name(fname, "/dev/osst" , map_arr[k].oth_dev_num, 1);
+                fprintf(fp, "  %s", fname);
+                break;
+            case LIN_DEV_TYPE_SR:
+                make_dev_name(fname, "/dev/sr" , map_arr[k].oth_dev_num, 1);
+                fprintf(fp, "  %s", fname);
+                break;
+            case LIN_DEV_TYPE_SCD:
+                make_dev_name(fname, "/dev/scd" , map_arr[k].oth_dev_num, 1);
+                fprintf(fp, "  %s", fname);
+                break;
+            default:
+                break;
+            }
+            if (do_inquiry)
+                fprintf(fp, "  %.8s  %.16s  %.4s", map_arr[k].vendor,
+                        map_arr[k].product, map_arr[k].revision);
+            break;
+        default:
+            fprintf(fp, "  bad logic\n");
+            break;
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+/* Writes key then the mapping to a temporary file which is renamed over
+ * the cache file, so readers never see part of it. Failure (e.g. when not
+ * root so /run is not writable) is silently ignored. */
+static void map_cache_save(const char * key, bool do_numeric, bool do_extra,
+                           bool do_inquiry, int last_sg_ind)
+{
+    int fd;
+    FILE * fp;
+    char tmp_fn[64];
+
+    snprintf(tmp_fn, sizeof(tmp_fn), "%s.XXXXXX", map_cache_fn);
+    fd = mkstemp(tmp_fn);
+    if (fd < 0)
+        return;
+    fp = fdopen(fd, "w");
+    if (NULL == fp) {
+        close(fd);
+        unlink(tmp_fn);
+        return;
+    }
+    fchmod(fd, 0644);
+    fprintf(fp, "%s%s\n", map_cache_hdr, key);
+    print_map(fp, do_numeric, do_extra, do_inquiry, last_sg_ind);
+    if ((0 != fclose(fp)) || (rename(tmp_fn, map_cache_fn) < 0))
+        unlink(tmp_fn);
+}
+
 
 int main(int argc, char * argv[])
 {
     bool do_all_s = true;
+    bool do_cache = false;
     bool do_extra = false;
     bool do_inquiry = false;
     bool do_numeric = NUMERIC_SCAN_DEF;
@@ -204,7 +652,15 @@ int main(int argc, char * argv[])
     int num_errors = 0;
     int num_silent = 0;
     int last_sg_ind = -1;
+    int num_jobs = 0;
+    int num_types = 0;
+    bool numerics[5];
+    int max_devs[5];
+    int lin_types[5];
+    const char * leadins[5];
     char fname[64];
+    char opt_str[32];
+    char key[256];
     struct stat a_stat;
 
     for (k = 1; k < argc; ++k) {
@@ -214,6 +670,17 @@ int main(int argc, char * argv[])
             do_numeric = false;
         else if (0 == strcmp("-x", argv[k]))
             do_extra = true;
+        else if (0 == strcmp("-c", argv[k]))
+            do_cache = true;
+        else if (0 == strcmp("-p", argv[k]))
+            num_jobs = DEF_MAP_JOBS;
+        else if (0 == strncmp("-p=", argv[k], 3)) {
+            num_jobs = sg_get_num(argv[k] + 3);
+            if ((num_jobs < 1) || (num_jobs > MAX_MAP_JOBS)) {
+                printf("-p=J expects J from 1 to %d\n", MAX_MAP_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        }
         else if (0 == strcmp("-i", argv[k]))
             do_inquiry = true;
         else if (0 == strcmp("-sd", argv[k])) {
@@ -255,6 +722,60 @@ int main(int argc, char * argv[])
     if (stat(devfs_id, &a_stat) == 0)
         printf("# Note: the devfs pseudo file system is present\n");
 
+    if (do_cache) {
+        snprintf(opt_str, sizeof(opt_str), "%d%d%d%d%d%d%d%d%d",
+                 (int)do_all_s, (int)do_extra, (int)do_inquiry,
+                 (int)do_numeric, (int)do_osst, (int)do_scd, (int)do_sd,
+                 (int)do_sr, (int)do_st);
+        if (! map_cache_key(key, sizeof(key), opt_str))
+            do_cache = false;
+        else if (map_cache_show(key))
+            return 0;
+    }
+
+    if (num_jobs && (has_sysfs_sg > 0)) {
+        if (do_all_s || do_sd) {
+            leadins[num_types] = "/dev/sd";
+            max_devs[num_types] = MAX_SD_DEVS;
+            numerics[num_types] = false;
+            lin_types[num_types++] = LIN_DEV_TYPE_SD;
+        }
+        if (do_all_s || do_sr) {
+            leadins[num_types] = "/dev/sr";
+            max_devs[num_types] = MAX_SR_DEVS;
+            numerics[num_types] = true;
+            lin_types[num_types++] = LIN_DEV_TYPE_SR;
+        }
+        if (do_all_s || do_scd) {
+            leadins[num_types] = "/dev/scd";
+            max_devs[num_types] = MAX_SR_DEVS;
+            numerics[num_types] = true;
+            lin_types[num_types++] = LIN_DEV_TYPE_SCD;
+        }
+        if (do_all_s || do_st) {
+            leadins[num_types] = "/dev/nst";
+            max_devs[num_types] = MAX_ST_DEVS;
+            numerics[num_types] = true;
+            lin_types[num_types++] = LIN_DEV_TYPE_ST;
+        }
+        if (do_all_s || do_osst) {
+            leadins[num_types] = "/dev/osst";
+            max_devs[num_types] = MAX_OSST_DEVS;
+            numerics[num_types] = true;
+            lin_types[num_types++] = LIN_DEV_TYPE_OSST;
+        }
+        last_sg_ind = map_parallel(do_inquiry, num_jobs, leadins, max_devs,
+                                   numerics, lin_types, num_types);
+        if (-2 == last_sg_ind)
+            return SG_LIB_FILE_ERROR;
+        if (last_sg_ind >= -1) {
+            if (last_sg_ind < 0)
+                printf("Stopping because no sg devices found\n");
+            goto fini;
+        }
+        last_sg_ind = -1;       /* fall back to the serial scan */
+    }
+
     for (k = 0, res = 0; (k < MAX_SG_DEVS) && (num_errors < MAX_ERRORS);
          ++k, res = (sg_fd >= 0) ? close(sg_fd) : 0) {
         if (res < 0) {
@@ -339,66 +860,10 @@ int main(int argc, char * argv[])
         scan_dev_type("/dev/osst", MAX_OSST_DEVS, 1, LIN_DEV_TYPE_OSST,
                       last_sg_ind);
 
-    for (k = 0; k <= last_sg_ind; ++k) {
-        if (has_sysfs_sg) {
-           if (0 == gen_index_arr[k]) {
-                continue;
-            }
-            make_dev_name(fname, "/dev/sg", k, true);
-        } else
-            make_dev_name(fname, "/dev/sg", k, do_numeric);
-        printf("%s", fname);
-        switch (map_arr[k].active)
-        {
-        case -2:
-            printf(do_extra ? "  -2 -2 -2 -2  -2" : "  busy");
-            break;
-        case -1:
-            printf(do_extra ? "  -1 -1 -1 -1  -1" : "  not present");
-            break;
-        case 0:
-            printf(do_extra ? "  -3 -3 -3 -3  -3" : "  some error");
-            break;
-        case 1:
-            if (do_extra)
-                printf("  %d %d %d %d  %d", map_arr[k].sg_dat.host_no,
-                       map_arr[k].sg_dat.channel, map_arr[k].sg_dat.scsi_id,
-                       map_arr[k].sg_dat.lun, map_arr[k].sg_dat.scsi_type);
-            switch (map_arr[k].lin_dev_type)
-            {
-            case LIN_DEV_TYPE_SD:
-                make_dev_name(fname, "/dev/sd" , map_arr[k].oth_dev_num, 0);
-                printf("  %s", fname);
-                break;
-            case LIN_DEV_TYPE_ST:
-                make_dev_name(fname, "/dev/nst" , map_arr[k].oth_dev_num, 1);
-                printf("  %s", fname);
-                break;
-            case LIN_DEV_TYPE_OSST:
-                make_dev_name(fname, "/dev/osst" , map_arr[k].oth_dev_num, 1);
-                printf("  %s", fname);
-                break;
-            case LIN_DEV_TYPE_SR:
-                make_dev_name(fname, "/dev/sr" , map_arr[k].oth_dev_num, 1);
-                printf("  %s", fname);
-                break;
-            case LIN_DEV_TYPE_SCD:
-                make_dev_name(fname, "/dev/scd" , map_arr[k].oth_dev_num, 1);
-                printf("  %s", fname);
-                break;
-            default:
-                break;
-            }
-            if (do_inquiry)
-                printf("  %.8s  %.16s  %.4s", map_arr[k].vendor,
-                       map_arr[k].product, map_arr[k].revision);
-            break;
-        default:
-            printf("  bad logic\n");
-            break;
-        }
-        printf("\n");
-    }
+fini:
+    print_map(stdout, do_numeric, do_extra, do_inquiry, last_sg_ind);
+    if (do_cache)
+        map_cache_save(key, do_numeric, do_extra, do_inquiry, last_sg_ind);
     return 0;
 }
 
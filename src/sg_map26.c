@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2005-2018 Douglas Gilbert.
+ * Copyright (c) 2005-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -13,6 +13,12 @@
  * This program maps a primary SCSI device node name to the corresponding
  * SCSI generic device node name (or vice versa). Targets linux
  * kernel 2.6, 3 and 4 series. Sysfs device names can also be mapped.
+ *
+ * The sysfs side of a mapping is found by building paths from the major
+ * and minor numbers, so it is cheap; the expensive part is finding the
+ * device nodes with those numbers, which needs a stat() of each node in
+ * the device directory. With --cache that directory is indexed once and
+ * the index kept in a file (under /run) until the directory changes.
  */
 
 /* #define _XOPEN_SOURCE 500 */
@@ -36,6 +42,7 @@
 #include <libgen.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/sysmacros.h>      /* new location for major + minor */
 #ifndef major
 #include <sys/types.h>
@@ -47,7 +54,7 @@
 #endif
 #include "sg_lib.h"
 
-static const char * version_str = "1.16 20180724";
+static const char * version_str = "1.17 20261014";
 
 #define ME "sg_map26: "
 
@@ -105,9 +112,14 @@ static const char * sys_st_dir = "/sys/class/scsi_tape/";
 static const char * sys_sch_dir = "/sys/class/scsi_changer/";
 static const char * sys_osst_dir = "/sys/class/onstream_tape/";
 static const char * def_dev_dir = "/dev";
+static const char * def_cache_dir = "/run/sg3_utils";
+
+#define DEV_INDEX_MAGIC "sg_map26 index 1"
+#define DEV_INDEX_MAX_DEPS 16
 
 
 static struct option long_options[] = {
+        {"cache", no_argument, 0, 'c'},
         {"dev_dir", required_argument, 0, 'd'},
         {"given_is", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
@@ -154,11 +166,17 @@ pr2serr(const char * fmt, ...)
 static void
 usage()
 {
-        pr2serr("Usage: sg_map26 [--dev_dir=DIR] [--given_is=0...1] [--help] "
-                "[--result=0...3]\n"
-                "                [--symlink] [--verbose] [--version] "
-                "DEVICE\n"
+        pr2serr("Usage: sg_map26 [--cache] [--dev_dir=DIR] [--given_is=0...1] "
+                "[--help]\n"
+                "                [--result=0...3] [--symlink] [--verbose] "
+                "[--version]\n"
+                "                DEVICE\n"
                 "  where:\n"
+                "    --cache | -c      keep an index of the device directory "
+                "in a file\n"
+                "                      under %s, rebuilt when the "
+                "directory\n"
+                "                      changes\n"
                 "    --dev_dir=DIR | -d DIR    search in DIR for "
                 "resulting special\n"
                 "                            (def: directory of DEVICE "
@@ -184,7 +202,7 @@ usage()
                 "    --verbose | -v    increase verbosity of output\n"
                 "    --version | -V    print version string and exit\n\n"
                 "Maps SCSI device node to corresponding generic node (and "
-                "vv)\n"
+                "vv)\n", def_cache_dir
                 );
 }
 
@@ -306,6 +324,396 @@ nt_typ_from_major(int ma)
 }
 
 
+/* An index of the block and char special files (and with --symlink, of
+ * the symlinks to them) in one device directory, each with its major and
+ * minor numbers. The items are sorted for binary search but remember
+ * their directory order ('pos') so output is the same as a scandir().
+ * With --cache it is read from, or written to, a file, that is valid
+ * while the modification times of the directory (and the directories
+ * holding the targets of its symlinks) are unchanged. */
+struct dev_index_item {
+        int ft;                 /* FT_BLOCK or FT_CHAR */
+        int majj;
+        int minn;
+        int pos;
+        char * name;
+};
+
+struct dev_index_dep {
+        struct timespec mtim;
+        char path[NAME_LEN_MAX];
+};
+
+struct dev_index {
+        bool follow_symlink;
+        int num;
+        int max_num;
+        int num_deps;
+        struct dev_index_item * arr;
+        struct dev_index_dep deps[DEV_INDEX_MAX_DEPS];
+        char dir_name[D_NAME_LEN_MAX];
+};
+
+static bool use_cache = false;
+static struct dev_index * dev_idx;      /* for the last directory used */
+
+static int
+dev_index_cmp(const void * ap, const void * bp)
+{
+        const struct dev_index_item * a = (const struct dev_index_item *)ap;
+        const struct dev_index_item * b = (const struct dev_index_item *)bp;
+
+        if (a->ft != b->ft)
+                return (a->ft < b->ft) ? -1 : 1;
+        if (a->majj != b->majj)
+                return (a->majj < b->majj) ? -1 : 1;
+        if (a->minn != b->minn)
+                return (a->minn < b->minn) ? -1 : 1;
+        return (a->pos < b->pos) ? -1 : (a->pos > b->pos);
+}
+
+static void
+dev_index_free(struct dev_index * dip)
+{
+        int k;
+
+        if (NULL == dip)
+                return;
+        for (k = 0; k < dip->num; ++k)
+                free(dip->arr[k].name);
+        free(dip->arr);
+        free(dip);
+}
+
+/* Returns 0 if added, else -ENOMEM */
+static int
+dev_index_add(struct dev_index * dip, int ft, int majj, int minn,
+              const char * name)
+{
+        struct dev_index_item * ip;
+
+        if (dip->num >= dip->max_num) {
+                int n = dip->max_num ? (2 * dip->max_num) : 256;
+
+                ip = (struct dev_index_item *)realloc(dip->arr,
+                                                      n * sizeof(*ip));
+                if (NULL == ip)
+                        return -ENOMEM;
+                dip->arr = ip;
+                dip->max_num = n;
+        }
+        ip = dip->arr + dip->num;
+        ip->name = strdup(name);
+        if (NULL == ip->name)
+                return -ENOMEM;
+        ip->ft = ft;
+        ip->majj = majj;
+        ip->minn = minn;
+        ip->pos = dip->num++;
+        return 0;
+}
+
+/* Adds path to the directories whose modification times are checked */
+static void
+dev_index_add_dep(struct dev_index * dip, const char * path)
+{
+        int k;
+        struct stat st;
+        struct dev_index_dep * dp;
+
+        for (k = 0; k < dip->num_deps; ++k) {
+                if (0 == strcmp(dip->deps[k].path, path))
+                        return;
+        }
+        if ((dip->num_deps >= DEV_INDEX_MAX_DEPS) || (stat(path, &st) < 0))
+                return;
+        dp = dip->deps + dip->num_deps++;
+        snprintf(dp->path, sizeof(dp->path), "%s", path);
+        dp->mtim = st.st_mtim;
+}
+
+/* Returns true if none of the directories the index depends on have been
+ * modified since it was built */
+static bool
+dev_index_fresh(const struct dev_index * dip)
+{
+        int k;
+        struct stat st;
+        const struct dev_index_dep * dp;
+
+        if (dip->num_deps < 1)
+                return false;
+        for (k = 0; k < dip->num_deps; ++k) {
+                dp = dip->deps + k;
+                if ((stat(dp->path, &st) < 0) ||
+                    (st.st_mtim.tv_sec != dp->mtim.tv_sec) ||
+                    (st.st_mtim.tv_nsec != dp->mtim.tv_nsec))
+                        return false;
+        }
+        return true;
+}
+
+/* One pass over dir_name, selecting entries as nd_match_scandir_select()
+ * does. Returns NULL on failure (errno set). */
+static struct dev_index *
+dev_index_build(const char * dir_name, bool follow_symlink)
+{
+        int ft;
+        DIR * dirp;
+        struct dirent * dep;
+        struct dev_index * dip;
+        struct stat st;
+        char name[D_NAME_LEN_MAX];
+        char rpath[PATH_MAX];
+
+        dip = (struct dev_index *)calloc(1, sizeof(*dip));
+        if (NULL == dip)
+                return NULL;
+        snprintf(dip->dir_name, sizeof(dip->dir_name), "%s", dir_name);
+        dip->follow_symlink = follow_symlink;
+        /* before the scan so a change during it makes the index stale */
+        dev_index_add_dep(dip, dir_name);
+        if (NULL == (dirp = opendir(dir_name))) {
+                dev_index_free(dip);
+                return NULL;
+        }
+        while ((dep = readdir(dirp))) {
+                switch (dep->d_type) {
+                case DT_BLK:
+                case DT_CHR:
+                        break;
+                case DT_LNK:
+                        if (follow_symlink)
+                                break;
+                        continue;
+                default:
+                        continue;
+                }
+                snprintf(name, sizeof(name), "%.*s/%.*s", NAME_LEN_MAX,
+                         dir_name, NAME_LEN_MAX, dep->d_name);
+                if (stat(name, &st) < 0)
+                        continue;
+                if (S_ISCHR(st.st_mode))
+                        ft = FT_CHAR;
+                else if (S_ISBLK(st.st_mode))
+                        ft = FT_BLOCK;
+                else
+                        continue;
+                if ((DT_LNK == dep->d_type) && realpath(name, rpath))
+                        dev_index_add_dep(dip, dirname(rpath));
+                if (dev_index_add(dip, ft, major(st.st_rdev),
+                                  minor(st.st_rdev), dep->d_name)) {
+                        closedir(dirp);
+                        dev_index_free(dip);
+                        errno = ENOMEM;
+                        return NULL;
+                }
+        }
+        closedir(dirp);
+        if (dip->num > 1)
+                qsort(dip->arr, dip->num, sizeof(dip->arr[0]), dev_index_cmp);
+        return dip;
+}
+
+/* Cache file name, one per (directory, follow_symlink) pair */
+static void
+dev_index_fname(const char * dir_name, bool follow_symlink, char * b,
+                int blen)
+{
+        int k, n;
+
+        n = snprintf(b, blen, "%s/sg_map26%s_", def_cache_dir,
+                     follow_symlink ? "_s" : "");
+        for (k = 0; dir_name[k] && (n < (blen - 5)); ++k, ++n)
+                b[n] = ('/' == dir_name[k]) ? '_' : dir_name[k];
+        snprintf(b + n, blen - n, ".idx");
+}
+
+/* Returns the index read from its cache file, or NULL if there is none
+ * (or it is stale or for another directory) */
+static struct dev_index *
+dev_index_load(const char * dir_name, bool follow_symlink, int verbose)
+{
+        bool ok = false;
+        int k, ft, majj, minn, n;
+        long long sec;
+        long nsec;
+        FILE * fp;
+        struct dev_index * dip;
+        struct dev_index_dep * dp;
+        char fname[D_NAME_LEN_MAX];
+        char line[D_NAME_LEN_MAX + 64];
+        char name[D_NAME_LEN_MAX];
+
+        dev_index_fname(dir_name, follow_symlink, fname, sizeof(fname));
+        if (NULL == (fp = fopen(fname, "r")))
+                return NULL;
+        dip = (struct dev_index *)calloc(1, sizeof(*dip));
+        if (NULL == dip) {
+                fclose(fp);
+                return NULL;
+        }
+        dip->follow_symlink = follow_symlink;
+        if ((NULL == fgets(line, sizeof(line), fp)) ||
+            strncmp(line, DEV_INDEX_MAGIC, strlen(DEV_INDEX_MAGIC)))
+                goto fini;
+        if ((NULL == fgets(line, sizeof(line), fp)) ||
+            (2 != sscanf(line, "dir %d %d", &dip->num_deps, &n)) ||
+            (dip->num_deps < 1) || (dip->num_deps > DEV_INDEX_MAX_DEPS) ||
+            (n < 0))
+                goto fini;
+        for (k = 0; k < dip->num_deps; ++k) {
+                dp = dip->deps + k;
+                if ((NULL == fgets(line, sizeof(line), fp)) ||
+                    (3 != sscanf(line, "%lld %ld %255[^\n]", &sec, &nsec,
+                                 dp->path)))
+                        goto fini;
+                dp->mtim.tv_sec = sec;
+                dp->mtim.tv_nsec = nsec;
+        }
+        if (strcmp(dip->deps[0].path, dir_name) || (! dev_index_fresh(dip))) {
+                if (verbose)
+                        pr2serr("index in %s is stale\n", fname);
+                goto fini;
+        }
+        snprintf(dip->dir_name, sizeof(dip->dir_name), "%s", dir_name);
+        for (k = 0; k < n; ++k) {
+                if ((NULL == fgets(line, sizeof(line), fp)) ||
+                    (4 != sscanf(line, "%d %d %d %255[^\n]", &ft, &majj,
+                                 &minn, name)) ||
+                    dev_index_add(dip, ft, majj, minn, name))
+                        goto fini;
+        }
+        if (dip->num > 1)
+                qsort(dip->arr, dip->num, sizeof(dip->arr[0]), dev_index_cmp);
+        ok = true;
+        if (verbose)
+                pr2serr("loaded index of %d nodes in %s from %s\n", n,
+                        dir_name, fname);
+fini:
+        fclose(fp);
+        if (ok)
+                return dip;
+        dev_index_free(dip);
+        return NULL;
+}
+
+/* Writes the index to a temporary file then renames it so concurrent
+ * invocations (e.g. from udev rules) only ever see a complete file.
+ * Failure (e.g. not root) only matters to verbose output. */
+static void
+dev_index_save(const struct dev_index * dip, int verbose)
+{
+        int k, fd;
+        FILE * fp;
+        struct dev_index_item ** pa;
+        const struct dev_index_dep * dp;
+        char fname[D_NAME_LEN_MAX];
+        char tname[D_NAME_LEN_MAX + 16];
+
+        if ((mkdir(def_cache_dir, 0755) < 0) && (EEXIST != errno)) {
+                if (verbose)
+                        pr2serr("mkdir: %s %s\n", def_cache_dir,
+                                ssafe_strerror(errno));
+                return;
+        }
+        dev_index_fname(dip->dir_name, dip->follow_symlink, fname,
+                        sizeof(fname));
+        snprintf(tname, sizeof(tname), "%s.XXXXXX", fname);
+        if ((fd = mkstemp(tname)) < 0) {
+                if (verbose)
+                        pr2serr("mkstemp: %s %s\n", tname,
+                                ssafe_strerror(errno));
+                return;
+        }
+        fchmod(fd, 0644);
+        if (NULL == (fp = fdopen(fd, "w"))) {
+                close(fd);
+                unlink(tname);
+                return;
+        }
+        /* items are written back in directory order */
+        pa = (struct dev_index_item **)calloc(dip->num + 1, sizeof(*pa));
+        if (NULL == pa) {
+                fclose(fp);
+                unlink(tname);
+                return;
+        }
+        for (k = 0; k < dip->num; ++k)
+                pa[dip->arr[k].pos] = dip->arr + k;
+        fprintf(fp, "%s\ndir %d %d\n", DEV_INDEX_MAGIC, dip->num_deps,
+                dip->num);
+        for (k = 0; k < dip->num_deps; ++k) {
+                dp = dip->deps + k;
+                fprintf(fp, "%lld %ld %s\n", (long long)dp->mtim.tv_sec,
+                        (long)dp->mtim.tv_nsec, dp->path);
+        }
+        for (k = 0; k < dip->num; ++k)
+                fprintf(fp, "%d %d %d %s\n", pa[k]->ft, pa[k]->majj,
+                        pa[k]->minn, pa[k]->name);
+        free(pa);
+        if (fclose(fp) || rename(tname, fname)) {
+                if (verbose)
+                        pr2serr("unable to write %s: %s\n", fname,
+                                ssafe_strerror(errno));
+                unlink(tname);
+        } else if (verbose)
+                pr2serr("saved index of %d nodes in %s to %s\n", dip->num,
+                        dip->dir_name, fname);
+}
+
+/* Returns the index of dir_name, from the cache file when it is fresh,
+ * otherwise by scanning the directory (then updating the cache file) */
+static struct dev_index *
+dev_index_get(const char * dir_name, bool follow_symlink, int verbose)
+{
+        if (dev_idx && (dev_idx->follow_symlink == follow_symlink) &&
+            (0 == strcmp(dev_idx->dir_name, dir_name)))
+                return dev_idx;
+        dev_index_free(dev_idx);
+        dev_idx = dev_index_load(dir_name, follow_symlink, verbose);
+        if (dev_idx)
+                return dev_idx;
+        dev_idx = dev_index_build(dir_name, follow_symlink);
+        if (dev_idx)
+                dev_index_save(dev_idx, verbose);
+        return dev_idx;
+}
+
+/* As list_matching_nodes() but looks up majj:minn in the index */
+static int
+list_indexed_nodes(const char * dir_name, int file_type, int majj, int minn,
+                   bool follow_symlink, int verbose)
+{
+        int lo, hi, mid;
+        struct dev_index * dip;
+        struct dev_index_item key;
+
+        dip = dev_index_get(dir_name, follow_symlink, verbose);
+        if (NULL == dip) {
+                if (verbose)
+                        pr2serr("index: %s %s\n", dir_name,
+                                ssafe_strerror(errno));
+                return -errno;
+        }
+        key.ft = file_type;
+        key.majj = majj;
+        key.minn = minn;
+        key.pos = -1;           /* sorts before any item with those numbers */
+        for (lo = 0, hi = dip->num; lo < hi; ) {
+                mid = lo + ((hi - lo) / 2);
+                if (dev_index_cmp(dip->arr + mid, &key) < 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        for (hi = lo; (hi < dip->num) && (dip->arr[hi].ft == file_type) &&
+                      (dip->arr[hi].majj == majj) &&
+                      (dip->arr[hi].minn == minn); ++hi)
+                printf("%s/%s\n", dir_name, dip->arr[hi].name);
+        return hi - lo;
+}
+
 struct node_match_item {
         bool follow_symlink;
         int file_type;
@@ -375,6 +783,9 @@ list_matching_nodes(const char * dir_name, int file_type, int majj, int minn,
         struct dirent ** namelist;
         int num, k;
 
+        if (use_cache && (-1 != majj) && (-1 != minn))
+                return list_indexed_nodes(dir_name, file_type, majj, minn,
+                                          follow_symlink, verbose);
         strncpy(nd_match.dir_name, dir_name, D_NAME_LEN_MAX - 1);
         nd_match.file_type = file_type;
         nd_match.majj = majj;
@@ -1060,12 +1471,15 @@ main(int argc, char * argv[])
         while (1) {
                 int option_index = 0;
 
-                c = getopt_long(argc, argv, "d:hg:r:svV", long_options,
+                c = getopt_long(argc, argv, "cd:hg:r:svV", long_options,
                                 &option_index);
                 if (c == -1)
                         break;
 
                 switch (c) {
+                case 'c':
+                        use_cache = true;
+                        break;
                 case 'd':
                         strncpy(device_dir, optarg, sizeof(device_dir) - 1);
                         do_dev_dir = true;
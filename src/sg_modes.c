@@ -1,5 +1,5 @@
 /*
- *  Copyright (C) 2000-2019 D. Gilbert
+ *  Copyright (C) 2000-2026 D. Gilbert
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation; either version 2, or (at your option)
@@ -32,10 +32,11 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.68 20190405";
+static const char * version_str = "1.69 20261014";
 
 #define DEF_ALLOC_LEN (1024 * 4)
 #define DEF_6_ALLOC_LEN 252
+#define ALL_PG_ALLOC_LEN 0xfffc /* for MODE SENSE(10) of all (sub)pages */
 #define UNLIKELY_ABOVE_LEN 512
 #define PG_CODE_ALL 0x3f
 #define PG_CODE_MASK 0x3f
@@ -291,8 +292,9 @@ usage()
            "                       2: (manufacturer's) defaults, 3: saved\n"
            "    --dbd|-d        disable block descriptors (DBD field in cdb)\n"
            "    --dbout|-D      disable block descriptor output\n"
-           "    --examine|-e    examine pages # 0 through to 0x3e, note if "
-           "found\n"
+           "    --examine|-e    list the pages and subpages the device has, "
+           "probe\n"
+           "                    pages 0 through to 0x3e if need be\n"
            "    --flexible|-f    be flexible, cope with MODE SENSE 6/10 "
            "response mixup\n");
     printf("    --help|-h       print usage message then exit\n"
@@ -1020,6 +1022,100 @@ list_page_codes(int scsi_ptype, bool encserv, bool mchngr, int t_proto)
     }
 }
 
+/* Fetches all mode pages and subpages with one MODE SENSE, then lists
+ * those found in its response. If the device doesn't support subpage 0xff
+ * then tries again with subpage 0. Returns 0 for ok, else error value in
+ * which case nothing has been output. */
+static int
+examine_all_pages(int sg_fd, int inq_pdt, bool encserv, bool mchngr,
+                  const struct opts_t * op)
+{
+    bool spf;
+    bool vb = (op->verbose > 0);    /* errors here are not final */
+    int k, res, resid, off, len, pg, spg, rsp_len;
+    const int mx_len = op->do_six ? DEF_6_ALLOC_LEN : ALL_PG_ALLOC_LEN;
+    const char * cp;
+    uint8_t * bp;
+    uint8_t * rbuf;
+    uint8_t * free_rbuf = NULL;
+    char b[80];
+
+    rbuf = sg_memalign(mx_len, 0, &free_rbuf, false);
+    if (NULL == rbuf) {
+        pr2serr("%s: out of heap\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < 2; ++k) {
+        spg = k ? 0 : SPG_CODE_ALL;
+        resid = 0;
+        if (op->do_six)
+            res = sg_ll_mode_sense6(sg_fd, 0, 0, PG_CODE_ALL, spg, rbuf,
+                                    mx_len, vb, op->verbose);
+        else
+            res = sg_ll_mode_sense10_v2(sg_fd, 0, 0, 0, PG_CODE_ALL, spg,
+                                        rbuf, mx_len, 0, &resid, vb,
+                                        op->verbose);
+        if (SG_LIB_CAT_ILLEGAL_REQ != res)
+            break;
+    }
+    if (res)
+        goto out;
+    rsp_len = sg_msense_calc_length(rbuf, mx_len - resid, op->do_six, NULL);
+    if ((rsp_len < 0) || (rsp_len > (mx_len - resid))) {
+        if (op->verbose)
+            pr2serr("%s: all pages response truncated or too short, "
+                    "probe each page\n", __func__);
+        res = SG_LIB_CAT_MALFORMED;
+        goto out;
+    }
+    off = sg_mode_page_offset(rbuf, rsp_len, op->do_six, b, sizeof(b));
+    if (off < 0) {
+        if (op->verbose)
+            pr2serr("%s: %s", __func__, b);
+        res = SG_LIB_CAT_MALFORMED;
+        goto out;
+    }
+    if (op->do_raw) {
+        dStrRaw(rbuf, rsp_len);
+        goto out;
+    }
+    if (op->do_hex > 2) {
+        hex2stdout(rbuf, rsp_len, -1);
+        goto out;
+    }
+    printf("Discovered mode pages:\n");
+    for (bp = rbuf + off; off < rsp_len; off += len, bp += len) {
+        pg = bp[0] & 0x3f;
+        spf = !! (bp[0] & 0x40);
+        if (spf) {
+            if ((off + 4) > rsp_len)
+                break;
+            spg = bp[1];
+            len = sg_get_unaligned_be16(bp + 2) + 4;
+        } else {
+            if ((off + 2) > rsp_len)
+                break;
+            spg = 0;
+            len = bp[1] + 2;
+        }
+        if ((off + len) > rsp_len)
+            len = rsp_len - off;
+        cp = find_page_code_desc(pg, spg, inq_pdt, encserv, mchngr, -1);
+        if (cp)
+            printf("    %s\n", cp);
+        else if (spf)
+            printf("    [0x%x,0x%x]\n", pg, spg);
+        else
+            printf("    [0x%x]\n", pg);
+        if (op->do_hex)
+            hex2stdout(bp, len, 1);
+    }
+out:
+    if (free_rbuf)
+        free(free_rbuf);
+    return res;
+}
+
 /* Returns 0 for ok, else error value */
 static int
 examine_pages(int sg_fd, int inq_pdt, bool encserv, bool mchngr,
@@ -1033,6 +1129,11 @@ examine_pages(int sg_fd, int inq_pdt, bool encserv, bool mchngr,
     uint8_t * rbuf;
     uint8_t * free_rbuf = NULL;
 
+    /* one command for all pages, probe each page only if that fails */
+    if (0 == examine_all_pages(sg_fd, inq_pdt, encserv, mchngr, op))
+        return 0;
+    if (op->verbose)
+        pr2serr("fetching all mode pages failed, probe each page\n");
     rbuf = sg_memalign(mx_len, 0, &free_rbuf, false);
     if (NULL == rbuf) {
         pr2serr("%s: out of heap\n", __func__);
@@ -1104,6 +1205,8 @@ examine_pages(int sg_fd, int inq_pdt, bool encserv, bool mchngr,
                     b);
         }
     }
+    if (SG_LIB_CAT_ILLEGAL_REQ == res)
+        res = 0;        /* the last page probed is not there, expected */
 out:
     if (free_rbuf)
         free(free_rbuf);
@@ -1,5 +1,5 @@
 /* A utility program originally written for the Linux OS SCSI subsystem.
- *  Copyright (C) 2004-2018 D. Gilbert
+ *  Copyright (C) 2004-2026 D. Gilbert
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation; either version 2, or (at your option)
@@ -7,7 +7,9 @@
  *
  * SPDX-License-Identifier: GPL-2.0-or-later
  *
- *  This program issues the SCSI PERSISTENT IN and OUT commands.
+ *  This program issues the SCSI PERSISTENT IN and OUT commands. With
+ *  --batch it issues a sequence of PR Out commands to many devices
+ *  concurrently.
  */
 
 #include <unistd.h>
@@ -21,6 +23,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 
 #include <inttypes.h>
@@ -32,10 +35,11 @@
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "0.66 20180615";
+static const char * version_str = "0.67 20261014";
 
 
 #define PRIN_RKEY_SA     0x0
@@ -54,6 +58,9 @@ static const char * version_str = "0.66 20180615";
 #define MX_ALLOC_LEN 8192
 #define MX_TIDS 32
 #define MX_TID_LEN 256
+#define MX_BATCH_ACTS 8
+#define DEF_MAX_JOBS 256
+#define MX_JOBS 1024
 
 #define ME "sg_persist"
 
@@ -83,15 +90,61 @@ struct opts_t {
     uint8_t transportid_arr[MX_TIDS * MX_TID_LEN];
 };
 
+struct batch_act_t {    /* one PR Out of --batch=ACTS */
+    int sa;
+    int len;            /* of parameter list */
+    uint64_t rk;
+    uint64_t sark;
+    uint8_t * pr_buff;
+    uint8_t * free_pr_buff;
+};
+
+struct batch_lun_t {
+    const char * dev_name;
+    int res;            /* open error or of the first PR Out that failed */
+    int num_done;       /* PR Outs that succeeded */
+    bool opened;
+    uint64_t lat_ns[MX_BATCH_ACTS];
+};
+
+struct batch_coll_t {
+    int num_acts;
+    int num_luns;
+    int next_ind;       /* next element of luns to do, atomic */
+    const struct opts_t * op;
+    struct batch_act_t acts[MX_BATCH_ACTS];
+    struct batch_lun_t * luns;
+};
+
+/* names of PR Out service actions accepted in --batch=ACTS */
+static struct batch_name_t {
+    const char * name;
+    int sa;
+} batch_names[] = {
+    {"register", PROUT_REG_SA},
+    {"register-ignore", PROUT_REG_IGN_SA},
+    {"reserve", PROUT_RES_SA},
+    {"release", PROUT_REL_SA},
+    {"clear", PROUT_CLEAR_SA},
+    {"preempt", PROUT_PREE_SA},
+    {"preempt-abort", PROUT_PREE_AB_SA},
+    {"replace-lost", PROUT_REPL_LOST_SA},
+    {NULL, 0},
+};
+
 
 static struct option long_options[] = {
     {"alloc-length", required_argument, 0, 'l'},
     {"alloc_length", required_argument, 0, 'l'},
+    {"batch", required_argument, 0, 'b'},
     {"clear", no_argument, 0, 'C'},
     {"device", required_argument, 0, 'd'},
     {"help", no_argument, 0, 'h'},
     {"hex", no_argument, 0, 'H'},
     {"in", no_argument, 0, 'i'},
+    {"jobs", required_argument, 0, 'j'},
+    {"lun-list", required_argument, 0, 'F'},
+    {"lun_list", required_argument, 0, 'F'},
     {"maxlen", required_argument, 0, 'm'},
     {"no-inquiry", no_argument, 0, 'n'},
     {"no_inquiry", no_argument, 0, 'n'},
@@ -187,7 +240,14 @@ usage(int help)
 {
     if (help < 2) {
         pr2serr("Usage: sg_persist [OPTIONS] [DEVICE]\n"
+                "       sg_persist --out --batch=ACTS [OPTIONS] "
+                "[--lun-list=LF]\n"
+                "                  [DEVICE...]\n"
                 "  where the main OPTIONS are:\n"
+                "    --batch=ACTS|-b ACTS       PR Out: do the comma "
+                "separated list of\n"
+                "                               actions on each DEVICE, "
+                "concurrently\n"
                 "    --clear|-C                 PR Out: Clear\n"
                 "    --help|-h                  print usage message, "
                 "twice for more\n"
@@ -236,6 +296,12 @@ usage(int help)
                 "                                 an argument\n"
                 "    --hex|-H                   output response in hex (for "
                 "PR In commands)\n"
+                "    --jobs=J|-j J              threads used by --batch "
+                "(def: one per\n"
+                "                               DEVICE, at most 256)\n"
+                "    --lun-list=LF|-F LF        with --batch: read DEVICE "
+                "names from file\n"
+                "                               LF ('-' for stdin)\n"
                 "    --maxlen=LEN|-m LEN        allocation length in "
                 "decimal, by default.\n"
                 "                               like --alloc-len= "
@@ -257,7 +323,12 @@ usage(int help)
                 "    --verbose|-v               output additional debug "
                 "information\n"
                 "    --version|-V               output version string\n\n"
-                "For the main options use '--help' or '-h' once.\n\n\n");
+                "For the main options use '--help' or '-h' once.\n\n"
+                "ACTS is a comma separated list of: register, "
+                "register-ignore, reserve,\nrelease, clear, preempt, "
+                "preempt-abort or replace-lost. Each may be\nfollowed by "
+                ":RK[:SARK] (in hex) to override '--param-rk=' and "
+                "'--param-sark='\nfor that action.\n\n\n");
         pr2serr("PR Out TYPE field value meanings:\n"
                 "  0:    obsolete (was 'read shared' in SPC)\n"
                 "  1:    write exclusive\n"
@@ -475,6 +546,32 @@ compact_transportid_array(struct opts_t * op)
     return compact_len;
 }
 
+/* Builds the PR Out parameter list (other than for 'register and move')
+ * in pr_buff, which is assumed zeroed, from rk, sark and op. t_arr_len is
+ * the length of op->transportid_arr once compacted. Returns the length of
+ * the parameter list. */
+static int
+build_prout_param(const struct opts_t * op, uint64_t rk, uint64_t sark,
+                  int t_arr_len, uint8_t * pr_buff)
+{
+    int len;
+
+    sg_put_unaligned_be64(rk, pr_buff + 0);
+    sg_put_unaligned_be64(sark, pr_buff + 8);
+    if (op->param_alltgpt)
+        pr_buff[20] |= 0x4;
+    if (op->param_aptpl)
+        pr_buff[20] |= 0x1;
+    len = 24;
+    if (t_arr_len > 0) {
+        pr_buff[20] |= 0x8;     /* set SPEC_I_PT bit */
+        memcpy(&pr_buff[28], op->transportid_arr, t_arr_len);
+        len += (t_arr_len + 4);
+        sg_put_unaligned_be32((uint32_t)t_arr_len, pr_buff + 24);
+    }
+    return len;
+}
+
 static int
 prout_work(int sg_fd, struct opts_t * op)
 {
@@ -493,19 +590,8 @@ prout_work(int sg_fd, struct opts_t * op)
                 op->alloc_len);
         return sg_convert_errno(ENOMEM);
     }
-    sg_put_unaligned_be64(op->param_rk, pr_buff + 0);
-    sg_put_unaligned_be64(op->param_sark, pr_buff + 8);
-    if (op->param_alltgpt)
-        pr_buff[20] |= 0x4;
-    if (op->param_aptpl)
-        pr_buff[20] |= 0x1;
-    len = 24;
-    if (t_arr_len > 0) {
-        pr_buff[20] |= 0x8;     /* set SPEC_I_PT bit */
-        memcpy(&pr_buff[28], op->transportid_arr, t_arr_len);
-        len += (t_arr_len + 4);
-        sg_put_unaligned_be32((uint32_t)t_arr_len, pr_buff + 24);
-    }
+    len = build_prout_param(op, op->param_rk, op->param_sark, t_arr_len,
+                            pr_buff);
     res = sg_ll_persistent_reserve_out(sg_fd, op->prout_sa, 0 /* rq_scope */,
                                        op->prout_type, pr_buff, len, true,
                                        op->verbose);
@@ -935,6 +1021,294 @@ my_cont_b:
     return 0;
 }
 
+/* Decodes ACTS, the argument of --batch=, into bcp->acts. Each action's
+ * keys default to '--param-rk=' and '--param-sark=' from op. Returns 0 if
+ * ok, else SG_LIB_SYNTAX_ERROR. */
+static int
+decode_batch_acts(const char * acts, struct batch_coll_t * bcp,
+                  const struct opts_t * op)
+{
+    int k, n, len;
+    const char * cp;
+    const char * ep;
+    const char * colp;
+    struct batch_act_t * bap;
+    char b[64];
+
+    for (cp = acts, n = 0; *cp; cp = ep + (',' == *ep)) {
+        ep = strchr(cp, ',');
+        if (NULL == ep)
+            ep = cp + strlen(cp);
+        len = ep - cp;
+        if ((0 == len) || (len >= (int)sizeof(b))) {
+            pr2serr("--batch: bad action at: %s\n", cp);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (n >= MX_BATCH_ACTS) {
+            pr2serr("--batch: at most %d actions\n", MX_BATCH_ACTS);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        memcpy(b, cp, len);
+        b[len] = '\0';
+        bap = bcp->acts + n;
+        bap->rk = op->param_rk;
+        bap->sark = op->param_sark;
+        colp = strchr(b, ':');
+        if (colp) {
+            b[colp - b] = '\0';
+            ++colp;
+            if ((1 != sscanf(colp, "%" SCNx64, &bap->rk)) ||
+                ((colp = strchr(colp, ':')) &&
+                 (1 != sscanf(colp + 1, "%" SCNx64, &bap->sark)))) {
+                pr2serr("--batch: bad key(s) for action: %s\n", b);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        }
+        for (k = 0; batch_names[k].name; ++k) {
+            if (0 == strcmp(b, batch_names[k].name))
+                break;
+        }
+        if (NULL == batch_names[k].name) {
+            pr2serr("--batch: unknown action: %s\n", b);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        bap->sa = batch_names[k].sa;
+        ++n;
+    }
+    if (0 == n) {
+        pr2serr("--batch: no actions given\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    bcp->num_acts = n;
+    return 0;
+}
+
+/* Reads DEVICE names, separated by whitespace, from the file fnp ('-' for
+ * stdin) and appends them to *namesp which has *nump entries (the array
+ * is realloc-ed). Lines starting with '#' are ignored. The names point
+ * into *bufp which the caller frees. Returns 0 if ok. */
+static int
+read_lun_list(const char * fnp, char *** namesp, int * nump, char ** bufp)
+{
+    int n, len;
+    size_t sz = 0;
+    size_t blen = 4096;
+    char * buf;
+    char * cp;
+    char ** names;
+    FILE * fp;
+
+    if (0 == strcmp(fnp, "-"))
+        fp = stdin;
+    else if (NULL == (fp = fopen(fnp, "r"))) {
+        n = errno;
+        pr2serr("--lun-list: unable to open %s: %s\n", fnp,
+                safe_strerror(n));
+        return sg_convert_errno(n);
+    }
+    buf = (char *)malloc(blen + 1);
+    while (buf && (len = fread(buf + sz, 1, blen - sz, fp)) > 0) {
+        sz += len;
+        if (sz == blen) {
+            blen *= 2;
+            cp = (char *)realloc(buf, blen + 1);
+            if (NULL == cp)
+                free(buf);
+            buf = cp;
+        }
+    }
+    if (stdin != fp)
+        fclose(fp);
+    if (NULL == buf) {
+        pr2serr("--lun-list: out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    buf[sz] = '\0';
+    *bufp = buf;
+    n = *nump;
+    names = *namesp;
+    for (cp = buf; *cp; ) {
+        if ('#' == *cp) {       /* comment to end of line */
+            while (*cp && ('\n' != *cp))
+                ++cp;
+            continue;
+        }
+        if (isspace((uint8_t)*cp)) {
+            *cp++ = '\0';
+            continue;
+        }
+        names = (char **)realloc(names, (n + 1) * sizeof(char *));
+        if (NULL == names) {
+            pr2serr("--lun-list: out of memory\n");
+            return sg_convert_errno(ENOMEM);
+        }
+        names[n++] = cp;
+        while (*cp && (! isspace((uint8_t)*cp)))
+            ++cp;
+    }
+    *namesp = names;
+    *nump = n;
+    return 0;
+}
+
+/* Takes DEVICEs, in order, until none are left. Each is opened then the
+ * actions are done on it in turn, stopping at the first that fails. */
+static void *
+batch_worker(void * v_bcp)
+{
+    int k, j, fd, res;
+    uint64_t t_ns;
+    struct batch_coll_t * bcp = (struct batch_coll_t *)v_bcp;
+    const struct opts_t * op = bcp->op;
+    struct batch_lun_t * blp;
+    const struct batch_act_t * bap;
+
+    while ((k = __atomic_fetch_add(&bcp->next_ind, 1, __ATOMIC_RELAXED)) <
+           bcp->num_luns) {
+        blp = bcp->luns + k;
+        fd = sg_cmds_open_device(blp->dev_name, false /* rw */,
+                                 op->verbose);
+        if (fd < 0) {
+            blp->res = sg_convert_errno(-fd);
+            continue;
+        }
+        blp->opened = true;
+        for (j = 0; j < bcp->num_acts; ++j) {
+            bap = bcp->acts + j;
+            t_ns = sg_pt_lat_now_ns();
+            res = sg_ll_persistent_reserve_out(fd, bap->sa, 0 /* rq_scope */,
+                                               op->prout_type,
+                                               bap->pr_buff, bap->len,
+                                               op->verbose > 0, op->verbose);
+            blp->lat_ns[j] = sg_pt_lat_now_ns() - t_ns;
+            if (res) {
+                blp->res = res;
+                break;
+            }
+            ++blp->num_done;
+        }
+        sg_cmds_close_device(fd);
+    }
+    return NULL;
+}
+
+static const char *
+batch_act_name(int sa)
+{
+    int k;
+
+    for (k = 0; batch_names[k].name; ++k) {
+        if (sa == batch_names[k].sa)
+            return batch_names[k].name;
+    }
+    return "?";
+}
+
+/* Implements --batch: does the actions in bcp on each of the num_luns
+ * DEVICEs in dev_names from num_jobs threads, then outputs a line for each
+ * DEVICE and a summary. Returns 0 if all actions succeeded on all
+ * DEVICEs, else the error of the first DEVICE that failed. */
+static int
+batch_work(struct batch_coll_t * bcp, struct opts_t * op, char ** dev_names,
+           int num_jobs)
+{
+    int k, j, err, t_arr_len;
+    int num_ok = 0;
+    int ret = 0;
+    uint64_t start_ns, t_ns;
+    struct batch_lun_t * blp;
+    pthread_t * tids;
+    char b[80];
+
+    t_arr_len = compact_transportid_array(op);
+    for (j = 0; j < bcp->num_acts; ++j) {
+        struct batch_act_t * bap = bcp->acts + j;
+
+        bap->pr_buff = sg_memalign(op->alloc_len, 0, &bap->free_pr_buff,
+                                   false);
+        if (NULL == bap->pr_buff) {
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        bap->len = build_prout_param(op, bap->rk, bap->sark, t_arr_len,
+                                     bap->pr_buff);
+    }
+    bcp->op = op;
+    bcp->luns = (struct batch_lun_t *)calloc(bcp->num_luns,
+                                             sizeof(*bcp->luns));
+    tids = (pthread_t *)calloc(num_jobs, sizeof(pthread_t));
+    if ((NULL == bcp->luns) || (NULL == tids)) {
+        pr2serr("--batch: unable to allocate memory for %d devices\n",
+                bcp->num_luns);
+        free(tids);
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < bcp->num_luns; ++k)
+        bcp->luns[k].dev_name = dev_names[k];
+
+    start_ns = sg_pt_lat_now_ns();
+    for (k = 0; k < num_jobs; ++k) {
+        err = pthread_create(tids + k, NULL, batch_worker, bcp);
+        if (err) {
+            pr2serr("pthread_create: %s, continue with %d threads\n",
+                    safe_strerror(err), k);
+            break;
+        }
+    }
+    num_jobs = k;
+    if (0 == num_jobs)
+        batch_worker(bcp);
+    for (k = 0; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    t_ns = sg_pt_lat_now_ns() - start_ns;
+    free(tids);
+
+    printf("PR Out batch on %d devices:\n", bcp->num_luns);
+    for (k = 0; k < bcp->num_luns; ++k) {
+        blp = bcp->luns + k;
+        if (! blp->opened) {
+            sg_get_category_sense_str(blp->res, sizeof(b), b, op->verbose);
+            printf("  %s: not opened: %s\n", blp->dev_name, b);
+        } else {
+            printf("  %s: ", blp->dev_name);
+            if (blp->res) {
+                sg_get_category_sense_str(blp->res, sizeof(b), b,
+                                          op->verbose);
+                printf("FAILED at %s: %s",
+                       batch_act_name(bcp->acts[blp->num_done].sa), b);
+            } else
+                printf("ok");
+            for (j = 0; j < bcp->num_acts; ++j) {
+                if (j > blp->num_done)
+                    break;
+                if ((j == blp->num_done) && (0 == blp->res))
+                    break;
+                printf("%s%s %.3f ms", (0 == j) ? " [" : ", ",
+                       batch_act_name(bcp->acts[j].sa),
+                       (double)blp->lat_ns[j] / 1000000.0);
+            }
+            printf("]\n");
+        }
+        if (blp->res) {
+            if (0 == ret)
+                ret = blp->res;
+        } else
+            ++num_ok;
+    }
+    printf("%d devices: %d ok, %d failed; elapsed %.3f ms using %d "
+           "threads\n", bcp->num_luns, num_ok, bcp->num_luns - num_ok,
+           (double)t_ns / 1000000.0, num_jobs);
+fini:
+    for (j = 0; j < bcp->num_acts; ++j) {
+        if (bcp->acts[j].free_pr_buff)
+            free(bcp->acts[j].free_pr_buff);
+    }
+    free(bcp->luns);
+    bcp->luns = NULL;
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -951,8 +1325,15 @@ main(int argc, char * argv[])
     int peri_type = 0;
     int sg_fd = -1;
     int ret = 0;
+    int num_devs = 0;
+    int num_jobs = 0;
     const char * cp;
     const char * device_name = NULL;
+    const char * batch_arg = NULL;
+    const char * lun_list_fn = NULL;
+    char ** dev_names = NULL;
+    char * lun_list_buf = NULL;
+    struct batch_coll_t * bcp = NULL;
     struct opts_t * op;
     char buff[48];
     struct opts_t opts;
@@ -970,7 +1351,7 @@ main(int argc, char * argv[])
         int option_index = 0;
 
         c = getopt_long(argc, argv,
-                        "AcCd:GHhiIkK:l:Lm:MnoPQ:rRsS:T:UvVX:yYzZ",
+                        "Ab:cCd:F:GHhiIj:kK:l:Lm:MnoPQ:rRsS:T:UvVX:yYzZ",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -980,6 +1361,9 @@ main(int argc, char * argv[])
             op->prout_sa = PROUT_PREE_AB_SA;
             ++num_prout_sa;
             break;
+        case 'b':
+            batch_arg = optarg;
+            break;
         case 'c':
             op->prin_sa = PRIN_RCAP_SA;
             ++num_prin_sa;
@@ -991,6 +1375,9 @@ main(int argc, char * argv[])
         case 'd':
             device_name = optarg;
             break;
+        case 'F':
+            lun_list_fn = optarg;
+            break;
         case 'G':
             op->prout_sa = PROUT_REG_SA;
             ++num_prout_sa;
@@ -1008,6 +1395,14 @@ main(int argc, char * argv[])
             op->prout_sa = PROUT_REG_IGN_SA;
             ++num_prout_sa;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MX_JOBS)) {
+                pr2serr("bad argument to '--jobs', expect 1 to %d\n",
+                        MX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'k':
             op->prin_sa = PRIN_RKEY_SA;
             ++num_prin_sa;
@@ -1141,7 +1536,20 @@ main(int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
-    if (optind < argc) {
+    if (batch_arg) {
+        if (device_name && (optind < argc)) {
+            pr2serr("with --batch give DEVICEs as arguments, not with "
+                    "'--device='\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (device_name) {
+            dev_names = (char **)&device_name;
+            num_devs = 1;
+        } else if (optind < argc) {
+            dev_names = argv + optind;
+            num_devs = argc - optind;
+        }
+    } else if (optind < argc) {
         if (NULL == device_name) {
             device_name = argv[optind];
             ++optind;
@@ -1149,6 +1557,7 @@ main(int argc, char * argv[])
         if (optind < argc) {
             for (; optind < argc; ++optind)
                 pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+            pr2serr("more than one DEVICE needs '--batch='\n");
             usage(1);
             return SG_LIB_SYNTAX_ERROR;
         }
@@ -1179,6 +1588,12 @@ main(int argc, char * argv[])
         return 0;
     }
 
+    if (batch_arg)
+        goto batch;
+    if (lun_list_fn || num_jobs) {
+        pr2serr("'--lun-list=' and '--jobs=' need '--batch='\n");
+        return SG_LIB_CONTRADICT;
+    }
     if (NULL == device_name) {
         pr2serr("No device name given\n");
         usage(1);
@@ -1304,8 +1719,63 @@ main(int argc, char * argv[])
         ret = prout_reg_move_work(sg_fd, op);
     else /* PROUT commands other than 'register and move' */
         ret = prout_work(sg_fd, op);
+    goto fini;
+
+batch:
+    if (! want_prout) {
+        pr2serr(">> '--batch=' does Persistent Reserve Out commands so the "
+                "'--out'\n>> option must be given (as a safeguard)\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (num_prin_sa || num_prout_sa || want_prin || op->param_unreg ||
+        op->param_rtp) {
+        pr2serr("with '--batch=' give the service actions in ACTS, "
+                "'--register-move' is\nnot supported\n");
+        return SG_LIB_CONTRADICT;
+    }
+    op->pr_in = false;
+    bcp = (struct batch_coll_t *)calloc(1, sizeof(*bcp));
+    if (NULL == bcp) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    if ((ret = decode_batch_acts(batch_arg, bcp, op)))
+        goto fini;
+    if (lun_list_fn) {
+        char ** names = NULL;
+
+        if (num_devs > 0) {     /* copy, since argv can't be realloc-ed */
+            names = (char **)calloc(num_devs, sizeof(char *));
+            if (NULL == names) {
+                dev_names = NULL;
+                ret = sg_convert_errno(ENOMEM);
+                goto fini;
+            }
+            memcpy(names, dev_names, num_devs * sizeof(char *));
+        }
+        ret = read_lun_list(lun_list_fn, &names, &num_devs, &lun_list_buf);
+        dev_names = names;
+        if (ret)
+            goto fini;
+    }
+    if (0 == num_devs) {
+        pr2serr("--batch: no DEVICEs given\n");
+        ret = SG_LIB_SYNTAX_ERROR;
+        goto fini;
+    }
+    bcp->num_luns = num_devs;
+    if (0 == num_jobs)
+        num_jobs = (num_devs < DEF_MAX_JOBS) ? num_devs : DEF_MAX_JOBS;
+    else if (num_jobs > num_devs)
+        num_jobs = num_devs;
+    ret = batch_work(bcp, op, dev_names, num_jobs);
+    flagged = true;     /* per DEVICE results already output */
 
 fini:
+    if (lun_list_fn)
+        free(dev_names);
+    free(lun_list_buf);
+    free(bcp);
     if (ret && (0 == op->verbose) && (! flagged)) {
         if (! sg_if_can2stderr("sg_persist failed: ", ret))
             pr2serr("Some error occurred [%d]\n", ret);
@@ -39,12 +39,16 @@
 #include "sg_pr2serr.h"
 #include "sg_unaligned.h"
 
-#define SG_RAW_VERSION "0.4.30 (2019-05-16)"
+#define SG_RAW_VERSION "0.4.32 (2026-10-14)"
 
 #define DEFAULT_TIMEOUT 20
 #define MIN_SCSI_CDBSZ 6
 #define MAX_SCSI_CDBSZ 260
 #define MAX_SCSI_DXLEN (64 * 1024)
+#define MAX_CHUNK_LEN (8 * 1024 * 1024)
+#define SENSE_BUFF_LEN 32
+#define MAX_SCRIPT_DEPTH 64
+#define SCRIPT_LINE_LEN 8192
 
 #define NVME_ADDR_DATA_IN  0xfffffffffffffffe
 #define NVME_ADDR_DATA_OUT 0xfffffffffffffffd
@@ -53,16 +57,21 @@
 
 static struct option long_options[] = {
     { "binary",  no_argument,       NULL, 'b' },
+    { "chunk",   required_argument, NULL, 'C' },
     { "cmdfile", required_argument, NULL, 'c' },
+    { "depth",   required_argument, NULL, 'd' },
     { "enumerate", no_argument,     NULL, 'e' },
     { "help",    no_argument,       NULL, 'h' },
     { "infile",  required_argument, NULL, 'i' },
+    { "length-field", required_argument, NULL, 'L' },
     { "skip",    required_argument, NULL, 'k' },
     { "nosense", no_argument,       NULL, 'n' },
+    { "offset-field", required_argument, NULL, 'O' },
     { "outfile", required_argument, NULL, 'o' },
     { "raw",     no_argument,       NULL, 'w' },
     { "request", required_argument, NULL, 'r' },
     { "readonly", no_argument,      NULL, 'R' },
+    { "script",  required_argument, NULL, 'S' },
     { "send",    required_argument, NULL, 's' },
     { "timeout", required_argument, NULL, 't' },
     { "verbose", no_argument,       NULL, 'v' },
@@ -70,6 +79,14 @@ static struct option long_options[] = {
     { 0, 0, 0, 0 }
 };
 
+/* A big endian field in the cdb, holding a byte count in units of 'unit'
+ * bytes; width of 0 when not given */
+struct cdb_field_t {
+    int byte;
+    int width;
+    int unit;
+};
+
 struct opts_t {
     bool cmdfile_given;
     bool do_datain;
@@ -81,17 +98,23 @@ struct opts_t {
     bool verbose_given;
     bool version_given;
     int cdb_length;
+    int chunk_len;      /* --chunk=CLEN, data-in bytes per command */
     int datain_len;
+    int depth;          /* --script= commands kept in flight */
     int dataout_len;
     int timeout;
     int raw;
     int readonly;
     int verbose;
     off_t dataout_offset;
+    int64_t datain_total;       /* --request=RLEN */
+    struct cdb_field_t off_fld; /* --offset-field= */
+    struct cdb_field_t len_fld; /* --length-field= */
     uint8_t cdb[MAX_SCSI_CDBSZ];        /* might be NVMe command (64 byte) */
     const char *cmd_file;
     const char *datain_file;
     const char *dataout_file;
+    const char *script_file;
     char *device_name;
 };
 
@@ -112,13 +135,21 @@ static void
 usage()
 {
     pr2serr("Usage: sg_raw [OPTION]* DEVICE [CDB0 CDB1 ...]\n"
+            "       sg_raw --script=SF [--depth=D] [OPTION]* DEVICE\n"
             "\n"
             "Options:\n"
             "  --binary|-b            Dump data in binary form, even when "
             "writing to\n"
             "                         stdout\n"
+            "  --chunk=CLEN|-C CLEN   receive RLEN bytes in commands of up "
+            "to CLEN\n"
+            "                         bytes at increasing offsets, "
+            "streamed to OFILE\n"
             "  --cmdfile=CF|-c CF     CF is file containing command in hex "
             "bytes\n"
+            "  --depth=D|-d D         with --script= keep up to D commands "
+            "in flight\n"
+            "                         (default: 1, maximum: %d)\n"
             "  --enumerate|-e         Decodes cdb name then exits; requires "
             "DEVICE but\n"
             "                         ignores it\n"
@@ -126,7 +157,17 @@ usage()
             "  --infile=IFILE|-i IFILE    Read data to send from IFILE "
             "(default:\n"
             "                             stdin)\n"
+            "  --length-field=LB,LW[,UN]|-L LB,LW[,UN]    with --chunk=, "
+            "cdb bytes\n"
+            "                         LB to LB+LW-1 set to each chunk's "
+            "length in\n"
+            "                         units of UN bytes (def: 1)\n"
             "  --nosense|-n           Don't display sense information\n"
+            "  --offset-field=OB,OW[,UN]|-O OB,OW[,UN]    with --chunk=, "
+            "cdb bytes\n"
+            "                         OB to OB+OW-1 advanced by each "
+            "chunk's offset\n"
+            "                         in units of UN bytes (def: 1)\n"
             "  --outfile=OFILE|-o OFILE    Write binary data to OFILE (def: "
             "hexdump\n"
             "                              to stdout)\n"
@@ -137,6 +178,10 @@ usage()
             "read-write)\n"
             "  --request=RLEN|-r RLEN    Request up to RLEN bytes of data "
             "(data-in)\n"
+            "  --script=SF|-S SF      Send each command in script file SF "
+            "('-' for\n"
+            "                         stdin), one compact result line "
+            "each\n"
             "  --send=SLEN|-s SLEN    Send SLEN bytes of data (data-out)\n"
             "  --skip=KLEN|-k KLEN    Skip the first KLEN bytes when "
             "reading\n"
@@ -149,7 +194,41 @@ usage()
             "specified\nand will be sent to DEVICE. Lengths RLEN, SLEN and "
             "KLEN are decimal by\ndefault. Bidirectional commands "
             "accepted.\n\nSimple example: Perform INQUIRY on /dev/sg0:\n"
-            "  sg_raw -r 1k /dev/sg0 12 00 00 00 60 00\n");
+            "  sg_raw -r 1k /dev/sg0 12 00 00 00 60 00\n"
+            "Example: 256 MiB of READ BUFFER(10) mode 2 data as 1 MiB "
+            "chunks:\n"
+            "  sg_raw -r 256m -C 1m -O 3,3 -L 6,3 -o dump.bin /dev/sg0 3c 02 "
+            "00 00 00 00\n"
+            "       00 00 00 00\n", MAX_SCRIPT_DEPTH);
+}
+
+/* Decodes OB,OW[,UN] into fldp. Returns 0 if ok. */
+static int
+parse_cdb_field(const char * arg, struct cdb_field_t * fldp,
+                const char * opt_name)
+{
+    int n;
+    const char * cp;
+
+    fldp->byte = sg_get_num(arg);
+    cp = strchr(arg, ',');
+    fldp->width = cp ? sg_get_num(cp + 1) : -1;
+    fldp->unit = 1;
+    if (cp && (cp = strchr(cp + 1, ','))) {
+        n = sg_get_num(cp + 1);
+        if (n < 1) {
+            pr2serr("'--%s=': units must be 1 or more\n", opt_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        fldp->unit = n;
+    }
+    if ((fldp->byte < 0) || (fldp->byte >= MAX_SCSI_CDBSZ) ||
+        (fldp->width < 1) || (fldp->width > 8)) {
+        pr2serr("'--%s=' expects a cdb byte offset then a width of 1 to 8 "
+                "bytes\n", opt_name);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    return 0;
 }
 
 static int
@@ -158,8 +237,10 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
     while (1) {
         int c, n;
 
-        c = getopt_long(argc, argv, "bc:ehi:k:no:r:Rs:t:vVw", long_options,
-                        NULL);
+        int64_t ll;
+
+        c = getopt_long(argc, argv, "bc:C:d:ehi:k:L:nO:o:r:Rs:S:t:vVw",
+                        long_options, NULL);
         if (c == -1)
             break;
 
@@ -171,6 +252,22 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
             op->cmd_file = optarg;
             op->cmdfile_given = true;
             break;
+        case 'C':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_CHUNK_LEN)) {
+                pr2serr("--chunk= expects 1 to %d\n", MAX_CHUNK_LEN);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->chunk_len = n;
+            break;
+        case 'd':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_SCRIPT_DEPTH)) {
+                pr2serr("--depth= expects 1 to %d\n", MAX_SCRIPT_DEPTH);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->depth = n;
+            break;
         case 'e':
             op->do_enumerate = true;
             break;
@@ -193,9 +290,17 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
             }
             op->dataout_offset = n;
             break;
+        case 'L':
+            if (parse_cdb_field(optarg, &op->len_fld, "length-field"))
+                return SG_LIB_SYNTAX_ERROR;
+            break;
         case 'n':
             op->no_sense = true;
             break;
+        case 'O':
+            if (parse_cdb_field(optarg, &op->off_fld, "offset-field"))
+                return SG_LIB_SYNTAX_ERROR;
+            break;
         case 'o':
             if (op->datain_file) {
                 pr2serr("Too many '--outfile=' options\n");
@@ -205,12 +310,12 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
             break;
         case 'r':
             op->do_datain = true;
-            n = sg_get_num(optarg);
-            if (n < 0 || n > MAX_SCSI_DXLEN) {
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
                 pr2serr("Invalid argument to '--request'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
-            op->datain_len = n;
+            op->datain_total = ll;
             break;
         case 'R':
             ++op->readonly;
@@ -224,6 +329,9 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
             }
             op->dataout_len = n;
             break;
+        case 'S':
+            op->script_file = optarg;
+            break;
         case 't':
             n = sg_get_num(optarg);
             if (n < 0) {
@@ -247,6 +355,19 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
         }
     }
 
+    /* only with --chunk= may RLEN exceed one data-in buffer */
+    if (op->do_datain && (0 == op->chunk_len)) {
+        if (op->datain_total > MAX_SCSI_DXLEN) {
+            pr2serr("Invalid argument to '--request'\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        op->datain_len = (int)op->datain_total;
+    }
+    if ((op->off_fld.width || op->len_fld.width) && (0 == op->chunk_len)) {
+        pr2serr("--offset-field= and --length-field= need --chunk=\n");
+        return SG_LIB_CONTRADICT;
+    }
+
     if (optind >= argc) {
         pr2serr("No device specified\n\n");
         return SG_LIB_SYNTAX_ERROR;
@@ -271,14 +392,41 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
         ++op->cdb_length;
     }
 
+    if (op->script_file) {
+        if (op->cdb_length || op->cmdfile_given || op->do_datain ||
+            op->do_dataout || op->datain_file || op->dataout_file ||
+            op->chunk_len) {
+            pr2serr("--script= gives the commands and their data, so not "
+                    "with CDB bytes,\n--chunk=, --cmdfile=, --infile=, "
+                    "--outfile=, --request= or --send=\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (0 == op->depth)
+            op->depth = 1;
+        return 0;
+    } else if (op->depth) {
+        pr2serr("--depth= only applies to --script=\n");
+        return SG_LIB_CONTRADICT;
+    }
+
     if (op->cmdfile_given) {
-        bool ok;
+        int res, n;
+        uint8_t b[1];
+        struct sg_f2hex_strm * fhp;
 
-        ok = sg_f2hex_arr(op->cmd_file, (op->raw > 0) /* as_binary */,
-                          false /* no_space */, op->cdb, &op->cdb_length,
-                          MAX_SCSI_CDBSZ);
-        if (! ok)
-            return SG_LIB_SYNTAX_ERROR;
+        fhp = sg_f2hex_open(op->cmd_file, (op->raw > 0) /* as_binary */,
+                            false /* no_space */, &res);
+        if (NULL == fhp)
+            return res;
+        res = sg_f2hex_next(fhp, op->cdb, MAX_SCSI_CDBSZ, &op->cdb_length);
+        if ((0 == res) && (MAX_SCSI_CDBSZ == op->cdb_length) &&
+            (0 == sg_f2hex_next(fhp, b, 1, &n)) && (n > 0)) {
+            pr2serr("CDB too long (max. %d bytes)\n", MAX_SCSI_CDBSZ);
+            res = SG_LIB_SYNTAX_ERROR;
+        }
+        sg_f2hex_close(fhp);
+        if (res)
+            return res;
         if (op->verbose > 2) {
             pr2serr("Read %d from %s . They are in hex:\n", op->cdb_length,
                     op->cmd_file);
@@ -289,6 +437,44 @@ parse_cmd_line(struct opts_t * op, int argc, char *argv[])
         pr2serr("CDB too short (min. %d bytes)\n", MIN_SCSI_CDBSZ);
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (op->chunk_len) {
+        const struct cdb_field_t * ofp = &op->off_fld;
+        const struct cdb_field_t * lfp = &op->len_fld;
+
+        if ((! op->do_datain) || (0 == op->datain_total) ||
+            op->do_dataout) {
+            pr2serr("--chunk= needs --request=RLEN (the total) and is "
+                    "data-in only\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((NULL == op->datain_file) && (! op->datain_binary)) {
+            pr2serr("--chunk= streams binary data so needs --outfile= or "
+                    "--binary\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (0 == ofp->width) {
+            pr2serr("--chunk= needs --offset-field=\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (! sg_is_scsi_cdb(op->cdb, op->cdb_length)) {
+            pr2serr("--chunk= is only for SCSI commands\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (((ofp->byte + ofp->width) > op->cdb_length) ||
+            ((lfp->byte + lfp->width) > op->cdb_length)) {
+            pr2serr("--offset-field= or --length-field= goes past the end "
+                    "of the cdb\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ((op->chunk_len % ofp->unit) ||
+            (lfp->width && ((op->chunk_len % lfp->unit) ||
+                            (op->datain_total % lfp->unit)))) {
+            pr2serr("--chunk=CLEN (and RLEN if --length-field=) should be "
+                    "a multiple of\nthe field units\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        op->datain_len = op->chunk_len;
+    }
     if (op->do_enumerate || (op->verbose > 1)) {
         bool is_scsi_cdb = sg_is_scsi_cdb(op->cdb, op->cdb_length);
         int sa;
@@ -343,42 +529,28 @@ skip(int fd, off_t offset)
     return 0;
 }
 
+/* Reads the data-out buffer from op->dataout_file (stdin when NULL) with
+ * sg_f2hex_next(), a regular file is memory mapped rather than read().
+ * The first op->dataout_offset bytes are read into the buffer and
+ * discarded. */
 static uint8_t *
 fetch_dataout(struct opts_t * op, uint8_t ** free_buf, int * errp)
 {
     bool ok = false;
-    int fd, len, tot_len, boff, err;
+    int len, n, tot_len, err;
+    off_t remain;
     uint8_t *buf = NULL;
+    struct sg_f2hex_strm * fhp;
 
     *free_buf = NULL;
     if (errp)
         *errp = 0;
-    if (op->dataout_file) {
-        fd = open(op->dataout_file, O_RDONLY);
-        if (fd < 0) {
-            err = errno;
-            if (errp)
-                *errp = sg_convert_errno(err);
-            perror(op->dataout_file);
-            goto bail;
-        }
-    } else
-        fd = STDIN_FILENO;
-    if (sg_set_binary_mode(fd) < 0) {
-        err = errno;
+    fhp = sg_f2hex_open(op->dataout_file ? op->dataout_file : "-",
+                        true /* as_binary */, false, &err);
+    if (NULL == fhp) {
         if (errp)
             *errp = err;
-        perror("sg_set_binary_mode");
-        goto bail;
-    }
-
-    if (op->dataout_offset > 0) {
-        err = skip(fd, op->dataout_offset);
-        if (err != 0) {
-            if (errp)
-                *errp = err;
-            goto bail;
-        }
+        return NULL;
     }
 
     tot_len = op->dataout_len;
@@ -390,26 +562,35 @@ fetch_dataout(struct opts_t * op, uint8_t ** free_buf, int * errp)
         goto bail;
     }
 
-    for (boff = 0; boff < tot_len; boff += len) {
-        len = read(fd, buf + boff , tot_len - boff);
-        if (len < 0) {
-            err = errno;
+    for (remain = op->dataout_offset; remain > 0; remain -= n) {
+        len = (remain < (off_t)tot_len) ? (int)remain : tot_len;
+        err = sg_f2hex_next(fhp, buf, len, &n);
+        if (err) {
             if (errp)
-                *errp = sg_convert_errno(err);
-            perror("Failed to read input data");
+                *errp = err;
             goto bail;
-        } else if (0 == len) {
+        } else if (0 == n) {
             if (errp)
                 *errp = SG_LIB_FILE_ERROR;
-            pr2serr("EOF on input file/stream at buffer offset %d\n", boff);
+            pr2serr("EOF on input file/stream\n");
             goto bail;
         }
     }
+    err = sg_f2hex_next(fhp, buf, tot_len, &n);
+    if (err) {
+        if (errp)
+            *errp = err;
+        goto bail;
+    } else if (n < tot_len) {
+        if (errp)
+            *errp = SG_LIB_FILE_ERROR;
+        pr2serr("EOF on input file/stream at buffer offset %d\n", n);
+        goto bail;
+    }
     ok = true;
 
 bail:
-    if (fd >= 0 && fd != STDIN_FILENO)
-        close(fd);
+    sg_f2hex_close(fhp);
     if (! ok) {
         if (*free_buf) {
             free(*free_buf);
@@ -420,10 +601,11 @@ bail:
     return buf;
 }
 
+/* Opens filename for the data-in, stdout when NULL or "-". Returns a file
+ * descriptor, or -1 with *errp set to an sg3_utils error code. */
 static int
-write_dataout(const char *filename, uint8_t *buf, int len)
+open_datain_file(const char *filename, int * errp)
 {
-    int ret = SG_LIB_FILE_ERROR;
     int fd;
 
     if ((filename == NULL) ||
@@ -432,30 +614,667 @@ write_dataout(const char *filename, uint8_t *buf, int len)
     else {
         fd = creat(filename, 0666);
         if (fd < 0) {
-            ret = sg_convert_errno(errno);
+            *errp = sg_convert_errno(errno);
             perror(filename);
-            goto bail;
+            return -1;
         }
     }
     if (sg_set_binary_mode(fd) < 0) {
+        *errp = SG_LIB_FILE_ERROR;
         perror("sg_set_binary_mode");
-        goto bail;
+        if (fd != STDOUT_FILENO)
+            close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    if (write(fd, buf, len) != len) {
-        ret = sg_convert_errno(errno);
-        perror(filename ? filename : "stdout");
-        goto bail;
+/* Writes all len bytes of buf to fd with as few write() calls as it will
+ * take, so a pipe or socket taking part of a buffer is not an error.
+ * Returns 0 on success. */
+static int
+write_all(int fd, const uint8_t *buf, int len, const char *filename)
+{
+    int n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            n = errno;
+            perror(filename ? filename : "stdout");
+            return sg_convert_errno(n);
+        }
+        buf += n;
+        len -= n;
     }
+    return 0;
+}
 
-    ret = 0;
+static int
+write_dataout(const char *filename, uint8_t *buf, int len)
+{
+    int ret = SG_LIB_FILE_ERROR;
+    int fd;
 
-bail:
-    if (fd >= 0 && fd != STDOUT_FILENO)
+    fd = open_datain_file(filename, &ret);
+    if (fd < 0)
+        return ret;
+    ret = write_all(fd, buf, len, filename);
+    if (fd != STDOUT_FILENO)
         close(fd);
     return ret;
 }
 
+/* Writes v into the big endian cdb field at fldp. Returns false if v does
+ * not fit. */
+static bool
+put_cdb_field(uint8_t * cdb, const struct cdb_field_t * fldp, uint64_t v)
+{
+    int k;
+
+    if ((fldp->width < 8) && (v >> (8 * fldp->width)))
+        return false;
+    for (k = fldp->width - 1; k >= 0; --k, v >>= 8)
+        cdb[fldp->byte + k] = (uint8_t)(v & 0xff);
+    return true;
+}
+
+/* The --chunk= mode: sends the cdb once per chunk of up to CLEN bytes,
+ * adding the chunk's offset (in the field's units) to the starting value
+ * of the --offset-field= and, if given, putting the chunk's length in the
+ * --length-field=. Each chunk is written to OFILE (or stdout) from the one
+ * data-in buffer before the next command is sent, so memory use does not
+ * depend on RLEN. Stops after RLEN bytes, at the first chunk that comes
+ * back short (taken as the end of the data) or at the first error. */
+static int
+chunk_run(struct opts_t * op, int sg_fd)
+{
+    bool short_xfer = false;
+    int res, status, s_len, this_len, n, cat;
+    int ret = 0;
+    int num_cmds = 0;
+    int out_fd = -1;
+    int64_t got = 0;
+    uint64_t off0;
+    const char * out_fn = op->datain_file;
+    uint8_t * dinp;
+    uint8_t * free_din = NULL;
+    struct sg_pt_base * ptvp;
+    uint8_t sense[SENSE_BUFF_LEN];
+    char b[128];
+
+    off0 = sg_get_unaligned_be(op->off_fld.width, op->cdb + op->off_fld.byte);
+    if (out_fn && (0 == strcmp(out_fn, "-")))
+        out_fn = NULL;
+    ptvp = construct_scsi_pt_obj();
+    dinp = sg_memalign(op->chunk_len, 0, &free_din, false);
+    if ((NULL == ptvp) || (NULL == dinp)) {
+        pr2serr("out of memory\n");
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    out_fd = open_datain_file(out_fn, &ret);
+    if (out_fd < 0)
+        goto fini;
+    while (got < op->datain_total) {
+        this_len = ((op->datain_total - got) < op->chunk_len) ?
+                   (int)(op->datain_total - got) : op->chunk_len;
+        if (! put_cdb_field(op->cdb, &op->off_fld,
+                            off0 + (uint64_t)got / op->off_fld.unit)) {
+            pr2serr("offset of byte %" PRId64 " does not fit in "
+                    "--offset-field=\n", got);
+            ret = SG_LIB_SYNTAX_ERROR;
+            break;
+        }
+        if (op->len_fld.width &&
+            (! put_cdb_field(op->cdb, &op->len_fld,
+                             this_len / op->len_fld.unit))) {
+            pr2serr("chunk length %d does not fit in --length-field=\n",
+                    this_len);
+            ret = SG_LIB_SYNTAX_ERROR;
+            break;
+        }
+        if (op->verbose > 1) {
+            pr2serr("    chunk %d cdb: ", num_cmds);
+            hex2stderr(op->cdb, op->cdb_length, -1);
+        }
+        clear_scsi_pt_obj(ptvp);
+        set_scsi_pt_cdb(ptvp, op->cdb, op->cdb_length);
+        set_scsi_pt_sense(ptvp, sense, sizeof(sense));
+        set_scsi_pt_data_in(ptvp, dinp, this_len);
+        res = do_scsi_pt(ptvp, sg_fd, op->timeout, op->verbose);
+        ++num_cmds;
+        if (res < 0)
+            ret = sg_convert_errno(-res);
+        else if (SCSI_PT_DO_TIMEOUT == res)
+            ret = SG_LIB_CAT_TIMEOUT;
+        else if (res > 0)
+            ret = SG_LIB_CAT_OTHER;
+        else if (get_scsi_pt_os_err(ptvp))
+            ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+        else if (get_scsi_pt_transport_err(ptvp))
+            ret = SG_LIB_CAT_OTHER;
+        if (ret)
+            break;
+        status = get_scsi_pt_status_response(ptvp);
+        s_len = get_scsi_pt_sense_len(ptvp);
+        if (SAM_STAT_CHECK_CONDITION == status) {
+            cat = sg_err_category_sense(sense, s_len);
+            if ((SG_LIB_CAT_RECOVERED != cat) &&
+                (SG_LIB_CAT_NO_SENSE != cat))
+                ret = cat;
+            if (ret && (! op->no_sense) && (s_len > 0)) {
+                pr2serr("Sense Information:\n");
+                sg_print_sense(NULL, sense, s_len, (op->verbose > 0));
+            }
+        } else if (SAM_STAT_RESERVATION_CONFLICT == status)
+            ret = SG_LIB_CAT_RES_CONFLICT;
+        else if (SAM_STAT_GOOD != status) {
+            pr2serr("SCSI Status: ");
+            sg_print_scsi_status(status);
+            pr2serr("\n");
+            ret = SG_LIB_CAT_OTHER;
+        }
+        if (ret)
+            break;
+        n = this_len - get_scsi_pt_resid(ptvp);
+        if (n > 0) {
+            ret = write_all(out_fd, dinp, n, out_fn);
+            if (ret)
+                break;
+            got += n;
+        }
+        if (op->verbose)
+            pr2serr("chunk %d: %d bytes at data offset %" PRId64 "\n",
+                    num_cmds - 1, n, got - n);
+        if (n < this_len) {
+            short_xfer = true;
+            break;
+        }
+    }
+    if (ret) {
+        sg_get_category_sense_str(ret, sizeof(b), b, 0);
+        pr2serr("chunk %d (data offset %" PRId64 ") failed: %s\n",
+                num_cmds - 1, got, b);
+    }
+    pr2serr("Wrote %" PRId64 " bytes of data from %d command%s to %s%s\n",
+            got, num_cmds, (1 == num_cmds) ? "" : "s",
+            out_fn ? out_fn : "stdout",
+            short_xfer ? ", last chunk short" : "");
+fini:
+    if ((out_fd >= 0) && (out_fd != STDOUT_FILENO)) {
+        if ((close(out_fd) < 0) && (0 == ret)) {
+            ret = sg_convert_errno(errno);
+            perror(out_fn);
+        }
+    }
+    if (free_din)
+        free(free_din);
+    if (ptvp)
+        destruct_scsi_pt_obj(ptvp);
+    return ret;
+}
+
+/* One command from a --script= file; up to --depth= of these in flight */
+struct script_slot_t {
+    bool busy;
+    int lineno;
+    int cdb_len;
+    int din_len;
+    int dout_len;
+    int exp_status;
+    int exp_sk;         /* -1 -> any sense key */
+    int timeout;
+    uint64_t start_ns;
+    uint8_t * dinp;
+    uint8_t * doutp;
+    uint8_t * free_din;
+    uint8_t * free_dout;
+    char * out_fn;      /* from o=OFILE, else NULL */
+    struct sg_pt_base * ptvp;
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
+struct script_stats_t {
+    int first_err;
+    int cmds;
+    int mismatches;
+    int errs;
+};
+
+/* Reads len bytes of data-out, after skipping the first off bytes, from
+ * file fn ('-' for stdin) into buf. Returns 0 on success. */
+static int
+script_load_dout(const char * fn, off_t off, uint8_t * buf, int len)
+{
+    bool is_stdin = (0 == strcmp(fn, "-"));
+    int fd, n, boff, err;
+    int ret = 0;
+
+    fd = is_stdin ? STDIN_FILENO : open(fn, O_RDONLY);
+    if (fd < 0) {
+        err = errno;
+        perror(fn);
+        return sg_convert_errno(err);
+    }
+    if ((off > 0) && (ret = skip(fd, off)))
+        goto fini;
+    for (boff = 0; boff < len; boff += n) {
+        n = read(fd, buf + boff, len - boff);
+        if (n < 0) {
+            err = errno;
+            perror(fn);
+            ret = sg_convert_errno(err);
+            break;
+        } else if (0 == n) {
+            pr2serr("%s: EOF at buffer offset %d\n", fn, boff);
+            ret = SG_LIB_FILE_ERROR;
+            break;
+        }
+    }
+fini:
+    if (! is_stdin)
+        close(fd);
+    return ret;
+}
+
+/* Decodes a --script= line into the free slot sp. Blank lines and those
+ * starting with '#' leave sp->cdb_len at 0; a line that is only "wait"
+ * sets *is_waitp. Returns 0 on success, else an error category. */
+static int
+script_parse(char * lp, const struct opts_t * op, struct script_slot_t * sp,
+             bool * is_waitp)
+{
+    bool last;
+    bool have_slen = false;
+    int n, slen = 0;
+    unsigned int u;
+    off_t skip_len = 0;
+    char * cp;
+    char * ep;
+    char * xp;
+    const char * in_fn = NULL;
+
+    *is_waitp = false;
+    sp->cdb_len = 0;
+    sp->din_len = 0;
+    sp->dout_len = 0;
+    sp->exp_status = SAM_STAT_GOOD;
+    sp->exp_sk = -1;
+    sp->timeout = op->timeout;
+    if (sp->out_fn) {
+        free(sp->out_fn);
+        sp->out_fn = NULL;
+    }
+    cp = strchr(lp, '#');
+    if (cp)
+        *cp = '\0';
+    for (cp = lp; ; cp = ep + 1) {
+        cp += strspn(cp, " \t\r\n");
+        if ('\0' == *cp)
+            break;
+        ep = cp + strcspn(cp, " \t\r\n");
+        last = ('\0' == *ep);
+        *ep = '\0';
+        if (0 == strcmp(cp, "wait")) {
+            *is_waitp = true;
+        } else if ('=' == cp[1]) {
+            const char * vp = cp + 2;
+
+            switch (cp[0]) {
+            case 'd':           /* inline data-out, in hex */
+                for (sp->dout_len = 0; isxdigit((uint8_t)vp[0]) &&
+                     isxdigit((uint8_t)vp[1]); vp += 2) {
+                    if (sp->dout_len >= MAX_SCSI_DXLEN)
+                        goto bad;
+                    sscanf(vp, "%2x", &u);
+                    sp->doutp[sp->dout_len++] = (uint8_t)u;
+                }
+                if (*vp)
+                    goto bad;
+                break;
+            case 'e':           /* expected status [/sense key], in hex */
+                sp->exp_status = strtol(vp, &xp, 16);
+                if ('/' == *xp)
+                    sp->exp_sk = strtol(xp + 1, &xp, 16);
+                if ((xp == vp) || *xp || (sp->exp_status > 0xff) ||
+                    (sp->exp_sk > 0xf))
+                    goto bad;
+                break;
+            case 'i':
+                in_fn = vp;
+                break;
+            case 'k':
+                skip_len = sg_get_llnum(vp);
+                if (skip_len < 0)
+                    goto bad;
+                break;
+            case 'o':
+                sp->out_fn = strdup(vp);
+                break;
+            case 'r':
+                sp->din_len = sg_get_num(vp);
+                if ((sp->din_len < 0) || (sp->din_len > MAX_SCSI_DXLEN))
+                    goto bad;
+                break;
+            case 's':
+                slen = sg_get_num(vp);
+                if ((slen < 0) || (slen > MAX_SCSI_DXLEN))
+                    goto bad;
+                have_slen = true;
+                break;
+            case 't':
+                sp->timeout = sg_get_num(vp);
+                if (sp->timeout < 0)
+                    goto bad;
+                break;
+            default:
+                goto bad;
+            }
+        } else {
+            n = strtol(cp, &xp, 16);
+            if ((xp == cp) || *xp || (n < 0) || (n > 0xff))
+                goto bad;
+            if (sp->cdb_len >= MAX_SCSI_CDBSZ) {
+                pr2serr("line %d: CDB too long (max. %d bytes)\n",
+                        sp->lineno, MAX_SCSI_CDBSZ);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            sp->cdb[sp->cdb_len++] = (uint8_t)n;
+        }
+        if (last)
+            break;
+    }
+    if (*is_waitp) {
+        if (sp->cdb_len > 0) {
+            pr2serr("line %d: 'wait' should be on a line of its own\n",
+                    sp->lineno);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        return 0;
+    }
+    if (0 == sp->cdb_len)
+        return 0;
+    if (sp->cdb_len < MIN_SCSI_CDBSZ) {
+        pr2serr("line %d: CDB too short (min. %d bytes)\n", sp->lineno,
+                MIN_SCSI_CDBSZ);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (in_fn) {
+        if (sp->dout_len || (! have_slen)) {
+            pr2serr("line %d: i=IFILE needs s=SLEN and no d=HEX\n",
+                    sp->lineno);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ((0 == strcmp(in_fn, "-")) && (0 == strcmp(op->script_file, "-")))
+        {
+            pr2serr("line %d: script is stdin so i=- is ambiguous\n",
+                    sp->lineno);
+            return SG_LIB_CONTRADICT;
+        }
+        sp->dout_len = slen;
+        return script_load_dout(in_fn, skip_len, sp->doutp, slen);
+    }
+    if (have_slen) {
+        if (sp->dout_len > slen) {
+            pr2serr("line %d: more d=HEX bytes than s=SLEN\n", sp->lineno);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        memset(sp->doutp + sp->dout_len, 0, slen - sp->dout_len);
+        sp->dout_len = slen;    /* pad with zeros */
+    }
+    return 0;
+bad:
+    pr2serr("line %d: bad token: %s\n", sp->lineno, cp);
+    return SG_LIB_SYNTAX_ERROR;
+}
+
+/* Submits the command decoded into slot sp. Returns 0 on success. */
+static int
+script_submit(struct script_slot_t * sp, int sg_fd, int verbose)
+{
+    int res;
+
+    clear_scsi_pt_obj(sp->ptvp);
+    set_scsi_pt_cdb(sp->ptvp, sp->cdb, sp->cdb_len);
+    set_scsi_pt_sense(sp->ptvp, sp->sense, sizeof(sp->sense));
+    if (sp->din_len > 0)
+        set_scsi_pt_data_in(sp->ptvp, sp->dinp, sp->din_len);
+    if (sp->dout_len > 0)
+        set_scsi_pt_data_out(sp->ptvp, sp->doutp, sp->dout_len);
+    set_scsi_pt_packet_id(sp->ptvp, sp->lineno);
+    sp->start_ns = sg_pt_lat_now_ns();
+    res = do_scsi_pt_submit(sp->ptvp, sg_fd, sp->timeout, verbose);
+    if (res) {
+        pr2serr("line %d: submit failed: %s\n", sp->lineno,
+                (res < 0) ? safe_strerror(-res) : "bad pass through setup");
+        return (res < 0) ? sg_convert_errno(-res) : SG_LIB_CAT_OTHER;
+    }
+    sp->busy = true;
+    return 0;
+}
+
+/* Writes the compact result record for the command on slot sp whose
+ * do_scsi_pt_receive() returned pt_res, to stdout. Returns 0 if the
+ * command met its expected status, else an error category. */
+static int
+script_complete(struct script_slot_t * sp, int pt_res,
+                const struct opts_t * op, struct script_stats_t * stp)
+{
+    bool ok;
+    int res, status, s_len, resid;
+    uint64_t lat;
+    struct sg_scsi_sense_hdr ssh;
+    char b[80];
+
+    lat = sg_pt_lat_now_ns() - sp->start_ns;
+    sp->busy = false;
+    ++stp->cmds;
+    printf("%d: op=%02x", sp->lineno, sp->cdb[0]);
+    res = 0;
+    if (pt_res < 0)
+        res = sg_convert_errno(-pt_res);
+    else if (SCSI_PT_DO_TIMEOUT == pt_res)
+        res = SG_LIB_CAT_TIMEOUT;
+    else if (pt_res > 0)
+        res = SG_LIB_CAT_OTHER;
+    else if (get_scsi_pt_os_err(sp->ptvp))
+        res = sg_convert_errno(get_scsi_pt_os_err(sp->ptvp));
+    else if (get_scsi_pt_transport_err(sp->ptvp))
+        res = SG_LIB_CAT_OTHER;
+    if (res) {
+        ++stp->errs;
+        sg_get_category_sense_str(res, sizeof(b), b, 0);
+        printf(" error=\"%s\" us=%" PRIu64 " ERROR\n", b, lat / 1000);
+        return res;
+    }
+    status = get_scsi_pt_status_response(sp->ptvp);
+    s_len = get_scsi_pt_sense_len(sp->ptvp);
+    memset(&ssh, 0, sizeof(ssh));
+    if (s_len > 0)
+        sg_scsi_normalize_sense(sp->sense, s_len, &ssh);
+    printf(" st=%02x", status);
+    if (SAM_STAT_CHECK_CONDITION == status)
+        printf(" sk=%x asc=%02x ascq=%02x", ssh.sense_key, ssh.asc,
+               ssh.ascq);
+    resid = (sp->din_len > 0) ? get_scsi_pt_resid(sp->ptvp) : 0;
+    if (sp->din_len > 0)
+        printf(" resid=%d", resid);
+    ok = (status == sp->exp_status) &&
+         ((sp->exp_sk < 0) || (sp->exp_sk == ssh.sense_key));
+    printf(" us=%" PRIu64 " %s\n", lat / 1000, ok ? "ok" : "MISMATCH");
+    if ((SAM_STAT_CHECK_CONDITION == status) && (s_len > 0) &&
+        op->verbose && (! op->no_sense))
+        sg_print_sense(NULL, sp->sense, s_len, (op->verbose > 1));
+    if ((sp->din_len > resid) && (SAM_STAT_GOOD == status)) {
+        if (sp->out_fn)
+            res = write_dataout(sp->out_fn, sp->dinp, sp->din_len - resid);
+        else if (op->verbose > 1)
+            hex2stderr(sp->dinp, sp->din_len - resid, 0);
+        if (res) {
+            ++stp->errs;
+            return res;
+        }
+    }
+    if (ok)
+        return 0;
+    ++stp->mismatches;
+    if (SAM_STAT_CHECK_CONDITION == status)
+        res = sg_err_category_sense(sp->sense, s_len);
+    else if (SAM_STAT_RESERVATION_CONFLICT == status)
+        res = SG_LIB_CAT_RES_CONFLICT;
+    return res ? res : SG_LIB_CAT_OTHER;
+}
+
+/* Completes whichever in flight commands have finished. If none has and
+ * block is true then waits for the oldest. Returns the number completed. */
+static int
+script_reap(struct script_slot_t * slots, bool block,
+            const struct opts_t * op, struct script_stats_t * stp)
+{
+    int k, res, n, oldest;
+    struct script_slot_t * sp;
+
+    for (k = 0, n = 0, oldest = -1; k < op->depth; ++k) {
+        sp = slots + k;
+        if (! sp->busy)
+            continue;
+        res = do_scsi_pt_receive(sp->ptvp, true, op->verbose);
+        if (-EAGAIN == res) {
+            if ((oldest < 0) || (sp->start_ns < slots[oldest].start_ns))
+                oldest = k;
+            continue;
+        }
+        ++n;
+        res = script_complete(sp, res, op, stp);
+        if (res && (0 == stp->first_err))
+            stp->first_err = res;
+    }
+    if ((0 == n) && block && (oldest >= 0)) {
+        sp = slots + oldest;
+        res = do_scsi_pt_receive(sp->ptvp, false, op->verbose);
+        res = script_complete(sp, res, op, stp);
+        if (res && (0 == stp->first_err))
+            stp->first_err = res;
+        n = 1;
+    }
+    return n;
+}
+
+/* Sends the commands in op->script_file to sg_fd, keeping up to op->depth
+ * of them in flight, one pass through object per slot. A "wait" line
+ * drains those in flight before going on. Stops submitting at the first
+ * malformed line. Returns the first failure, in completion order. */
+static int
+script_run(const struct opts_t * op, int sg_fd)
+{
+    bool is_wait;
+    int k, res, inflight, lineno;
+    int ret = 0;
+    FILE * fp;
+    struct script_slot_t * sp;
+    struct script_slot_t * slots;
+    struct script_stats_t stats;
+    char line[SCRIPT_LINE_LEN];
+
+    memset(&stats, 0, sizeof(stats));
+    if (0 == strcmp(op->script_file, "-"))
+        fp = stdin;
+    else if (NULL == (fp = fopen(op->script_file, "r"))) {
+        res = errno;
+        pr2serr("%s: %s\n", op->script_file, safe_strerror(res));
+        return sg_convert_errno(res);
+    }
+    slots = (struct script_slot_t *)calloc(op->depth, sizeof(*slots));
+    if (NULL == slots) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < op->depth; ++k) {
+        sp = slots + k;
+        sp->dinp = sg_memalign(MAX_SCSI_DXLEN, 0, &sp->free_din, false);
+        sp->doutp = sg_memalign(MAX_SCSI_DXLEN, 0, &sp->free_dout, false);
+        sp->ptvp = construct_scsi_pt_obj();
+        if ((NULL == sp->dinp) || (NULL == sp->doutp) ||
+            (NULL == sp->ptvp)) {
+            pr2serr("out of memory\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    }
+    for (lineno = 1, inflight = 0; ; ++lineno) {
+        for (sp = NULL; NULL == sp; ) {
+            for (k = 0; k < op->depth; ++k) {
+                if (! slots[k].busy) {
+                    sp = slots + k;
+                    break;
+                }
+            }
+            if (NULL == sp)
+                inflight -= script_reap(slots, true, op, &stats);
+        }
+        if (NULL == fgets(line, sizeof(line), fp))
+            break;
+        if ((NULL == strchr(line, '\n')) && (! feof(fp))) {
+            pr2serr("line %d: longer than %d characters\n", lineno,
+                    SCRIPT_LINE_LEN - 2);
+            ret = SG_LIB_SYNTAX_ERROR;
+            break;
+        }
+        sp->lineno = lineno;
+        ret = script_parse(line, op, sp, &is_wait);
+        if (ret)
+            break;
+        if (is_wait) {
+            while (inflight > 0)
+                inflight -= script_reap(slots, true, op, &stats);
+            continue;
+        }
+        if (0 == sp->cdb_len)
+            continue;
+        if (op->verbose > 2) {
+            pr2serr("line %d: ", lineno);
+            hex2stderr(sp->cdb, sp->cdb_len, -1);
+        }
+        ret = script_submit(sp, sg_fd, op->verbose);
+        if (ret) {
+            ++stats.errs;
+            break;
+        }
+        ++inflight;
+    }
+    while (inflight > 0)
+        inflight -= script_reap(slots, true, op, &stats);
+    if (ret && (0 == stats.first_err))
+        stats.first_err = ret;
+    ret = stats.first_err;
+    pr2serr("%d command%s completed, %d mismatch%s, %d error%s\n",
+            stats.cmds, (1 == stats.cmds) ? "" : "s", stats.mismatches,
+            (1 == stats.mismatches) ? "" : "es", stats.errs,
+            (1 == stats.errs) ? "" : "s");
+fini:
+    if (slots) {
+        for (k = 0; k < op->depth; ++k) {
+            sp = slots + k;
+            if (sp->ptvp)
+                destruct_scsi_pt_obj(sp->ptvp);
+            if (sp->free_din)
+                free(sp->free_din);
+            if (sp->free_dout)
+                free(sp->free_dout);
+            if (sp->out_fn)
+                free(sp->out_fn);
+        }
+        free(slots);
+    }
+    if (fp != stdin)
+        fclose(fp);
+    return ret;
+}
+
 
 int
 main(int argc, char *argv[])
@@ -511,6 +1330,8 @@ main(int argc, char *argv[])
         goto done;
     } else if (op->do_enumerate)
         goto done;
+    if (op->script_file)
+        is_scsi_cdb = false;    /* script_run() reports on each command */
 
     sg_fd = scsi_pt_open_device(op->device_name, op->readonly,
                                 op->verbose);
@@ -520,6 +1341,14 @@ main(int argc, char *argv[])
         goto done;
     }
 
+    if (op->script_file) {
+        ret = script_run(op, sg_fd);
+        goto done;
+    }
+    if (op->chunk_len) {
+        ret = chunk_run(op, sg_fd);
+        goto done;
+    }
     ptvp = construct_scsi_pt_obj();
     if (ptvp == NULL) {
         pr2serr("out of memory\n");
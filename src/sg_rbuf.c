@@ -1,5 +1,5 @@
 /* A utility program originally written for the Linux OS SCSI subsystem.
- *  Copyright (C) 1999-2018 D. Gilbert
+ *  Copyright (C) 1999-2026 D. Gilbert
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation; either version 2, or (at your option)
@@ -27,6 +27,8 @@
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -40,6 +42,7 @@
 #endif
 #include "sg_lib.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
@@ -52,12 +55,17 @@
 #define RB_OPCODE 0x3C
 #define RB_CMD_LEN 10
 
+#define MAX_PATHS 16
+#define MAX_THREADS 64
+#define MAX_QD 16       /* commands queued per file descriptor (sg v3) */
+
 #ifndef SG_FLAG_MMAP_IO
 #define SG_FLAG_MMAP_IO 4
 #endif
 
 
-static const char * version_str = "5.05 20180627";
+static const char * version_str = "5.07 20261014";
+static bool dio_warned = false;     /* only first incomplete dio noted */
 
 static struct option long_options[] = {
         {"buffer", required_argument, 0, 'b'},
@@ -67,8 +75,10 @@ static struct option long_options[] = {
         {"mmap", no_argument, 0, 'm'},
         {"new", no_argument, 0, 'N'},
         {"old", no_argument, 0, 'O'},
+        {"qd", required_argument, 0, 'Q'},
         {"quick", no_argument, 0, 'q'},
         {"size", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 'T'},
         {"time", no_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -86,36 +96,79 @@ struct opts_t {
     bool opt_new;
     int do_buffer;
     int do_help;
+    int num_devs;       /* more than 1 (paths) only with new interface */
+    int num_thr;        /* threads per DEVICE */
+    int qd;             /* commands in flight per thread */
     int verbose;
     int64_t do_size;
     const char * device_name;
+    const char * dev_names[MAX_PATHS];
+};
+
+/* For the parallel mode, one per DEVICE (e.g. each path to a LUN) */
+struct rb_path {
+    int buf_size;
+    int64_t num_cmds;   /* READ BUFFER commands to issue on this path */
+    int64_t next_cmd;   /* claimed by threads with __atomic_fetch_add() */
+    const char * dev_name;
+};
+
+struct rb_thr {
+    bool dio_incomplete;
+    int fd;             /* each thread has its own */
+    int first_err;
+    int64_t cmds;       /* completed without error */
+    uint64_t end_ns;
+    pthread_t tid;
+    struct rb_path * pp;
+    const struct opts_t * op;
+};
+
+struct rb_slot {
+    bool busy;
+    uint8_t * buffp;
+    uint8_t * free_buffp;
+    struct sg_io_hdr io_hdr;
+    uint8_t cdb[RB_CMD_LEN];
+    uint8_t sense[32];
 };
 
+static volatile int rb_stop;    /* set on the first error in any thread */
+
 
 static void
 usage()
 {
     pr2serr("Usage: sg_rbuf [--buffer=EACH] [--dio] [--echo] "
             "[--help] [--mmap]\n"
-            "               [--quick] [--size=OVERALL] [--time] [--verbose] "
-            "[--version]\n"
-            "               SG_DEVICE\n");
+            "               [--qd=QD] [--quick] [--size=OVERALL] "
+            "[--threads=THR]\n"
+            "               [--time] [--verbose] [--version] SG_DEVICE "
+            "[SG_DEVICE...]\n");
     pr2serr("  where:\n"
             "    --buffer=EACH|-b EACH    buffer size to use (in bytes)\n"
             "    --dio|-d        requests dio ('-q' overrides it)\n"
             "    --echo|-e       use echo buffer (def: use data mode)\n"
             "    --help|-h       print usage message then exit\n"
             "    --mmap|-m       requests mmap-ed IO (overrides -q, -d)\n"
-            "    --quick|-q      quick, don't xfer to user space\n");
+            "    --qd=QD|-Q QD    commands in flight per thread (def: 1, "
+            "max: %d)\n"
+            "    --quick|-q      quick, don't xfer to user space\n", MAX_QD);
     pr2serr("    --size=OVERALL|-s OVERALL    total size to read (in bytes)\n"
-            "                    default: 200 MiB\n"
+            "                    from each SG_DEVICE, default: 200 MiB\n"
+            "    --threads=THR|-T THR    threads per SG_DEVICE, each with "
+            "its own\n"
+            "                    file descriptor (def: 1, max: %d)\n"
             "    --time|-t       time the data transfer\n"
             "    --verbose|-v    increase verbosity (more debug)\n"
             "    --old|-O        use old interface (use as first option)\n"
             "    --version|-V    print version string then exit\n\n"
             "Use SCSI READ BUFFER command (data or echo buffer mode, buffer "
             "id 0)\nrepeatedly. This utility only works with Linux sg "
-            "devices.\n");
+            "devices. With more\nthan one SG_DEVICE (e.g. each a path to "
+            "the same LUN), or QD or THR\ngreater than 1, commands are "
+            "issued concurrently and the bandwidth of\neach SG_DEVICE and "
+            "the aggregate bandwidth are reported.\n", MAX_THREADS);
 }
 
 static void
@@ -159,7 +212,7 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:dehmNOqs:tvV", long_options,
+        c = getopt_long(argc, argv, "b:dehmNOqQ:s:tT:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -195,6 +248,14 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'q':
             op->do_quick = true;
             break;
+        case 'Q':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_QD)) {
+                pr2serr("bad argument to '--qd', expect 1 to %d\n", MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->qd = n;
+            break;
         case 's':
            nn = sg_get_llnum(optarg);
            if (nn < 0) {
@@ -207,6 +268,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 't':
             op->do_time = true;
             break;
+        case 'T':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_THREADS)) {
+                pr2serr("bad argument to '--threads', expect 1 to %d\n",
+                        MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_thr = n;
+            break;
         case 'v':
             op->verbose_given = true;
             ++op->verbose;
@@ -222,17 +292,16 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
-    if (optind < argc) {
-        if (NULL == op->device_name) {
-            op->device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+    for ( ; optind < argc; ++optind) {
+        if (op->num_devs >= MAX_PATHS) {
+            pr2serr("Too many SG_DEVICE arguments, maximum is %d\n",
+                    MAX_PATHS);
             usage_for(op);
             return SG_LIB_SYNTAX_ERROR;
         }
+        if (NULL == op->device_name)
+            op->device_name = argv[optind];
+        op->dev_names[op->num_devs++] = argv[optind];
     }
     return 0;
 }
@@ -352,6 +421,388 @@ parse_cmd_line(struct opts_t * op, int argc, char * argv[])
 }
 
 
+/* Issues a READ BUFFER (descriptor) command on sg_fd and sets *buf_capp
+ * to the (echo) buffer capacity it reports. If dev_name is non-NULL it
+ * prefixes the capacity line. Returns 0 on success. */
+static int
+rb_query(int sg_fd, const struct opts_t * op, const char * dev_name,
+         int * buf_capp)
+{
+    int res;
+    unsigned int k;
+    uint8_t rbBuff[RB_DESC_LEN];
+    uint8_t sense_buffer[32];
+    uint8_t rb_cdb [RB_CMD_LEN];
+    struct sg_io_hdr io_hdr;
+
+    memset(rbBuff, 0, sizeof(rbBuff));
+    memset(rb_cdb, 0, RB_CMD_LEN);
+    rb_cdb[0] = RB_OPCODE;
+    rb_cdb[1] = op->do_echo ? RB_MODE_ECHO_DESC : RB_MODE_DESC;
+    rb_cdb[8] = RB_DESC_LEN;
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.cmd_len = sizeof(rb_cdb);
+    io_hdr.mx_sb_len = sizeof(sense_buffer);
+    io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
+    io_hdr.dxfer_len = RB_DESC_LEN;
+    io_hdr.dxferp = rbBuff;
+    io_hdr.cmdp = rb_cdb;
+    io_hdr.sbp = sense_buffer;
+    io_hdr.timeout = 60000;     /* 60000 millisecs == 60 seconds */
+    if (op->verbose) {
+        pr2serr("    Read buffer (%sdescriptor) cdb: ",
+                (op->do_echo ? "echo " : ""));
+        for (k = 0; k < RB_CMD_LEN; ++k)
+            pr2serr("%02x ", rb_cdb[k]);
+        pr2serr("\n");
+    }
+
+    /* do normal IO to find RB size (not dio or mmap-ed at this stage) */
+    if (ioctl(sg_fd, SG_IO, &io_hdr) < 0) {
+        perror("SG_IO READ BUFFER descriptor error");
+        return SG_LIB_CAT_OTHER;
+    }
+
+    if (op->verbose > 2)
+        pr2serr("      duration=%u ms\n", io_hdr.duration);
+    /* now for the error processing */
+    res = sg_err_category3(&io_hdr);
+    switch (res) {
+    case SG_LIB_CAT_RECOVERED:
+        sg_chk_n_print3("READ BUFFER descriptor, continuing", &io_hdr,
+                        op->verbose > 1);
+#if defined(__GNUC__)
+#if (__GNUC__ >= 7)
+        __attribute__((fallthrough));
+        /* FALL THROUGH */
+#endif
+#endif
+    case SG_LIB_CAT_CLEAN:
+        break;
+    default: /* won't bother decoding other categories */
+        sg_chk_n_print3("READ BUFFER descriptor error", &io_hdr,
+                        op->verbose > 1);
+        return (res >= 0) ? res : SG_LIB_CAT_OTHER;
+    }
+
+    if (dev_name)
+        printf("%s: ", dev_name);
+    if (op->do_echo) {
+        *buf_capp = 0x1fff & sg_get_unaligned_be16(rbBuff + 2);
+        printf("READ BUFFER reports: echo buffer capacity=%d\n",
+               *buf_capp);
+    } else {
+        *buf_capp = sg_get_unaligned_be24(rbBuff + 1);
+        printf("READ BUFFER reports: buffer capacity=%d, offset "
+               "boundary=%d\n", *buf_capp, (int)rbBuff[0]);
+    }
+    return 0;
+}
+
+/* Sends READ BUFFER (data) command number 'cmd' on slot sp of thread tp via
+ * the asynchronous write() interface of the sg driver. Returns 0 if sent,
+ * else an exit status. */
+static int
+rb_submit(struct rb_thr * tp, struct rb_slot * sp, int64_t cmd)
+{
+    int j, res;
+    const struct opts_t * op = tp->op;
+    struct sg_io_hdr * hp = &sp->io_hdr;
+
+    memset(sp->cdb, 0, RB_CMD_LEN);
+    sp->cdb[0] = RB_OPCODE;
+    sp->cdb[1] = op->do_echo ? RB_MODE_ECHO_DATA : RB_MODE_DATA;
+    sg_put_unaligned_be24((uint32_t)tp->pp->buf_size, sp->cdb + 6);
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = RB_CMD_LEN;
+    hp->mx_sb_len = sizeof(sp->sense);
+    hp->dxfer_direction = SG_DXFER_FROM_DEV;
+    hp->dxfer_len = tp->pp->buf_size;
+    hp->dxferp = sp->buffp;
+    hp->cmdp = sp->cdb;
+    hp->sbp = sp->sense;
+    hp->timeout = 20000;     /* 20000 millisecs == 20 seconds */
+    hp->pack_id = (int)cmd;
+    hp->usr_ptr = sp;
+    if (op->do_dio)
+        hp->flags |= SG_FLAG_DIRECT_IO;
+    else if (op->do_quick)
+        hp->flags |= SG_FLAG_NO_DXFER;
+    if (op->verbose > 1) {
+        pr2serr("    Read buffer (%sdata) cdb: ",
+                (op->do_echo ? "echo " : ""));
+        for (j = 0; j < RB_CMD_LEN; ++j)
+            pr2serr("%02x ", sp->cdb[j]);
+        pr2serr("\n");
+    }
+    while (((res = write(tp->fd, hp, sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res < 0) {
+        if (ENOMEM == errno)
+            pr2serr("%s: write() data: out of memory, try a smaller "
+                    "buffer size than %d bytes\n", tp->pp->dev_name,
+                    tp->pp->buf_size);
+        else
+            perror("sg write() of READ BUFFER data error");
+        return SG_LIB_CAT_OTHER;
+    }
+    sp->busy = true;
+    return 0;
+}
+
+/* Each thread keeps up to QD READ BUFFER commands in flight on its own
+ * file descriptor until its path's command count is used up. */
+static void *
+rb_thread(void * v_tp)
+{
+    int k, res, err, inflight;
+    ssize_t n;
+    int64_t cmd;
+    struct rb_thr * tp = (struct rb_thr *)v_tp;
+    struct rb_path * pp = tp->pp;
+    const struct opts_t * op = tp->op;
+    struct rb_slot * slots;
+    struct rb_slot * sp;
+    struct pollfd a_poll;
+    struct sg_io_hdr io_hdr;
+
+    inflight = 0;
+    slots = (struct rb_slot *)calloc(op->qd, sizeof(struct rb_slot));
+    if (NULL == slots)
+        goto nomem;
+    for (k = 0; k < op->qd; ++k) {
+        slots[k].buffp = sg_memalign(pp->buf_size, 0, &slots[k].free_buffp,
+                                     false);
+        if (NULL == slots[k].buffp)
+            goto nomem;
+    }
+    while (true) {
+        for (k = 0; (! rb_stop) && (k < op->qd); ++k) {
+            sp = slots + k;
+            if (sp->busy)
+                continue;
+            cmd = __atomic_fetch_add(&pp->next_cmd, 1, __ATOMIC_RELAXED);
+            if (cmd >= pp->num_cmds)
+                break;
+            res = rb_submit(tp, sp, cmd);
+            if (res) {
+                tp->first_err = res;
+                rb_stop = 1;
+                break;
+            }
+            ++inflight;
+        }
+        if (0 == inflight)
+            break;
+        a_poll.fd = tp->fd;
+        a_poll.events = POLLIN;
+        a_poll.revents = 0;
+        if ((poll(&a_poll, 1, -1) < 0) && (EINTR == errno))
+            continue;
+        memset(&io_hdr, 0, sizeof(io_hdr));
+        io_hdr.interface_id = 'S';
+        io_hdr.pack_id = -1;    /* any, should SG_SET_FORCE_PACK_ID be on */
+        n = read(tp->fd, &io_hdr, sizeof(io_hdr));
+        if (n < 0) {
+            err = errno;
+            if ((EAGAIN == err) || (EINTR == err))
+                continue;
+            perror("sg read() of READ BUFFER data error");
+            tp->first_err = sg_convert_errno(err);
+            rb_stop = 1;
+            break;
+        }
+        sp = (struct rb_slot *)io_hdr.usr_ptr;
+        sp->busy = false;
+        --inflight;
+        if (op->verbose > 2)
+            pr2serr("      duration=%u ms\n", io_hdr.duration);
+        res = sg_err_category3(&io_hdr);
+        switch (res) {
+        case SG_LIB_CAT_CLEAN:
+            break;
+        case SG_LIB_CAT_RECOVERED:
+            sg_chk_n_print3("READ BUFFER data, continuing", &io_hdr,
+                            op->verbose > 1);
+            break;
+        default: /* won't bother decoding other categories */
+            sg_chk_n_print3("READ BUFFER data error", &io_hdr,
+                            op->verbose > 1);
+            if (0 == tp->first_err)
+                tp->first_err = (res >= 0) ? res : SG_LIB_CAT_OTHER;
+            rb_stop = 1;
+            continue;
+        }
+        if (op->do_dio && (! sg_io_dio_done(&io_hdr, "", &dio_warned)))
+            tp->dio_incomplete = true;
+        ++tp->cmds;
+    }
+    tp->end_ns = sg_pt_lat_now_ns();
+    if (0 == inflight) {    /* else buffers may still be in use */
+        for (k = 0; k < op->qd; ++k)
+            free(slots[k].free_buffp);
+        free(slots);
+    }
+    return NULL;
+
+nomem:
+    pr2serr("%s: out of memory (data)\n", pp->dev_name);
+    tp->first_err = SG_LIB_CAT_OTHER;
+    rb_stop = 1;
+    if (slots) {
+        for (k = 0; k < op->qd; ++k)
+            free(slots[k].free_buffp);
+        free(slots);
+    }
+    tp->end_ns = sg_pt_lat_now_ns();
+    return NULL;
+}
+
+/* Prints the amount read and the bandwidth over 'el_ns' nanoseconds */
+static void
+rb_report(const char * leadin, int64_t cmds, int64_t bytes, uint64_t el_ns)
+{
+    double a = el_ns / 1000000000.0;
+
+    printf("%s: read %" PRId64 " MiB (%" PRId64 " bytes) in %.6f secs",
+           leadin, bytes / (1024 * 1024), bytes, a);
+    if (a > 0.00001) {
+        if (bytes > 511)
+            printf(", %.2f MB/sec", bytes / (a * 1000000.0));
+        printf(", %.2f IOPS", cmds / a);
+    }
+    printf("\n");
+}
+
+/* With more than one DEVICE (path) or QD or THR greater than 1: starts THR
+ * threads per path, each keeping QD commands in flight, to read OVERALL
+ * bytes from each path. Then reports the bandwidth of each path and the
+ * aggregate. Returns 0 or the exit status of the first error. */
+static int
+rb_parallel(const struct opts_t * op, int64_t total_size)
+{
+    bool dio_incomplete = false;
+    int j, k, n, res, err, cap, num_thr;
+    int ret = 0;
+    int64_t cmds, bytes, all_cmds, all_bytes;
+    uint64_t start_ns, end_ns, all_end_ns;
+    struct rb_path paths[MAX_PATHS];
+    struct rb_path * pp;
+    struct rb_thr * thr_arr;
+    struct rb_thr * tp;
+    char b[32];
+
+    num_thr = op->num_devs * op->num_thr;
+    thr_arr = (struct rb_thr *)calloc(num_thr, sizeof(struct rb_thr));
+    if (NULL == thr_arr) {
+        printf("out of memory (threads)\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    for (k = 0; k < num_thr; ++k)
+        thr_arr[k].fd = -1;
+    memset(paths, 0, sizeof(paths));
+    /* open all the file descriptors, finding each path's buffer size */
+    for (j = 0; j < op->num_devs; ++j) {
+        pp = paths + j;
+        pp->dev_name = op->dev_names[j];
+        for (k = 0; k < op->num_thr; ++k) {
+            tp = thr_arr + (j * op->num_thr) + k;
+            tp->pp = pp;
+            tp->op = op;
+            tp->fd = open(pp->dev_name, O_RDONLY | O_NONBLOCK);
+            if (tp->fd < 0) {
+                err = errno;
+                pr2serr("%s: device open error: %s\n", pp->dev_name,
+                        safe_strerror(err));
+                ret = sg_convert_errno(err);
+                goto fini;
+            }
+            if (0 == k) {
+                res = rb_query(tp->fd, op, pp->dev_name, &cap);
+                if (res) {
+                    ret = res;
+                    goto fini;
+                }
+                pp->buf_size = (op->do_buffer > 0) ? op->do_buffer : cap;
+                if (pp->buf_size > cap) {
+                    printf("%s: Requested buffer size=%d exceeds reported "
+                           "capacity=%d\n", pp->dev_name, pp->buf_size, cap);
+                    ret = SG_LIB_CAT_MALFORMED;
+                    goto fini;
+                } else if (pp->buf_size <= 0) {
+                    printf("%s: no buffer to read\n", pp->dev_name);
+                    ret = SG_LIB_CAT_MALFORMED;
+                    goto fini;
+                }
+                pp->num_cmds = total_size / pp->buf_size;
+            }
+            if (! op->do_dio) {
+                n = pp->buf_size;
+                sg_io_reserve(tp->fd, 1, &n, 1, false, "", op->verbose);
+            }
+        }
+    }
+
+    start_ns = sg_pt_lat_now_ns();
+    for (k = 0; k < num_thr; ++k) {
+        tp = thr_arr + k;
+        res = pthread_create(&tp->tid, NULL, rb_thread, tp);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            ret = SG_LIB_CAT_OTHER;
+            rb_stop = 1;
+            break;
+        }
+    }
+    for (k = 0; k < num_thr; ++k) {
+        tp = thr_arr + k;
+        if (tp->tid)
+            pthread_join(tp->tid, NULL);
+        if ((0 == ret) && tp->first_err)
+            ret = tp->first_err;
+        if (tp->dio_incomplete)
+            dio_incomplete = true;
+    }
+
+    all_cmds = 0;
+    all_bytes = 0;
+    all_end_ns = start_ns;
+    for (j = 0; j < op->num_devs; ++j) {
+        pp = paths + j;
+        end_ns = start_ns;
+        for (k = 0, cmds = 0; k < op->num_thr; ++k) {
+            tp = thr_arr + (j * op->num_thr) + k;
+            cmds += tp->cmds;
+            if (tp->end_ns > end_ns)
+                end_ns = tp->end_ns;
+        }
+        bytes = cmds * pp->buf_size;
+        rb_report(pp->dev_name, cmds, bytes, end_ns - start_ns);
+        all_cmds += cmds;
+        all_bytes += bytes;
+        if (end_ns > all_end_ns)
+            all_end_ns = end_ns;
+    }
+    snprintf(b, sizeof(b), "aggregate (%d device%s)", op->num_devs,
+             ((op->num_devs > 1) ? "s" : ""));
+    rb_report(b, all_cmds, all_bytes, all_end_ns - start_ns);
+    printf("  with %d thread%s per device, each with up to %d command%s "
+           "in flight\n", op->num_thr, ((op->num_thr > 1) ? "s" : ""),
+           op->qd, ((op->qd > 1) ? "s" : ""));
+    if (dio_incomplete)
+        printf(">> direct IO requested but not done\n");
+fini:
+    for (k = 0; k < num_thr; ++k) {
+        if (thr_arr[k].fd >= 0)
+            close(thr_arr[k].fd);
+    }
+    free(thr_arr);
+    return ret;
+}
+
 int
 main(int argc, char * argv[])
 {
@@ -359,7 +810,7 @@ main(int argc, char * argv[])
     bool clear = true;
 #endif
     bool dio_incomplete = false;
-    int sg_fd, res, j, err;
+    int sg_fd, res, j, n, err;
     int buf_capacity = 0;
     int buf_size = 0;
     size_t psz;
@@ -415,6 +866,24 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
 
+    if (0 == op->num_devs) {    /* old interface takes one SG_DEVICE */
+        op->dev_names[0] = op->device_name;
+        op->num_devs = 1;
+    }
+    if (op->qd < 1)
+        op->qd = 1;
+    if (op->num_thr < 1)
+        op->num_thr = 1;
+    if ((op->num_devs > 1) || (op->qd > 1) || (op->num_thr > 1)) {
+        if (op->do_mmap) {
+            pr2serr("--mmap contradicts --qd, --threads and more than one "
+                    "SG_DEVICE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        return rb_parallel(op, (op->do_size > 0) ? op->do_size :
+                                                   RB_DEF_SIZE);
+    }
+
     if (op->do_buffer > 0)
         buf_size = op->do_buffer;
     if (op->do_size > 0)
@@ -430,95 +899,26 @@ main(int argc, char * argv[])
         op->do_dio = false;
         op->do_quick = false;
     }
-    if (NULL == (rawp = malloc(512))) {
-        printf("out of memory (query)\n");
-        return SG_LIB_CAT_OTHER;
-    }
-    rbBuff = (uint8_t *)rawp;
-
-    memset(rb_cdb, 0, RB_CMD_LEN);
-    rb_cdb[0] = RB_OPCODE;
-    rb_cdb[1] = op->do_echo ? RB_MODE_ECHO_DESC : RB_MODE_DESC;
-    rb_cdb[8] = RB_DESC_LEN;
-    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
-    io_hdr.interface_id = 'S';
-    io_hdr.cmd_len = sizeof(rb_cdb);
-    io_hdr.mx_sb_len = sizeof(sense_buffer);
-    io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
-    io_hdr.dxfer_len = RB_DESC_LEN;
-    io_hdr.dxferp = rbBuff;
-    io_hdr.cmdp = rb_cdb;
-    io_hdr.sbp = sense_buffer;
-    io_hdr.timeout = 60000;     /* 60000 millisecs == 60 seconds */
-    if (op->verbose) {
-        pr2serr("    Read buffer (%sdescriptor) cdb: ",
-                (op->do_echo ? "echo " : ""));
-        for (k = 0; k < RB_CMD_LEN; ++k)
-            pr2serr("%02x ", rb_cdb[k]);
-        pr2serr("\n");
-    }
-
-    /* do normal IO to find RB size (not dio or mmap-ed at this stage) */
-    if (ioctl(sg_fd, SG_IO, &io_hdr) < 0) {
-        perror("SG_IO READ BUFFER descriptor error");
-        if (rawp)
-            free(rawp);
-        return SG_LIB_CAT_OTHER;
-    }
-
-    if (op->verbose > 2)
-        pr2serr("      duration=%u ms\n", io_hdr.duration);
-    /* now for the error processing */
-    res = sg_err_category3(&io_hdr);
-    switch (res) {
-    case SG_LIB_CAT_RECOVERED:
-        sg_chk_n_print3("READ BUFFER descriptor, continuing", &io_hdr,
-                        op->verbose > 1);
-#if defined(__GNUC__)
-#if (__GNUC__ >= 7)
-        __attribute__((fallthrough));
-        /* FALL THROUGH */
-#endif
-#endif
-    case SG_LIB_CAT_CLEAN:
-        break;
-    default: /* won't bother decoding other categories */
-        sg_chk_n_print3("READ BUFFER descriptor error", &io_hdr,
-                        op->verbose > 1);
-        if (rawp) free(rawp);
-        return (res >= 0) ? res : SG_LIB_CAT_OTHER;
-    }
-
-    if (op->do_echo) {
-        buf_capacity = 0x1fff & sg_get_unaligned_be16(rbBuff + 2);
-        printf("READ BUFFER reports: echo buffer capacity=%d\n",
-               buf_capacity);
-    } else {
-        buf_capacity = sg_get_unaligned_be24(rbBuff + 1);
-        printf("READ BUFFER reports: buffer capacity=%d, offset "
-               "boundary=%d\n", buf_capacity, (int)rbBuff[0]);
-    }
+    res = rb_query(sg_fd, op, NULL, &buf_capacity);
+    if (res)
+        return res;
 
     if (0 == buf_size)
         buf_size = buf_capacity;
     else if (buf_size > buf_capacity) {
         printf("Requested buffer size=%d exceeds reported capacity=%d\n",
                buf_size, buf_capacity);
-        if (rawp) free(rawp);
         return SG_LIB_CAT_MALFORMED;
     }
-    if (rawp) {
-        free(rawp);
-        rawp = NULL;
-    }
 
     if (! op->do_dio) {
-        k = buf_size;
-        if (op->do_mmap && (0 != (k % psz)))
-            k = ((k / psz) + 1) * psz;  /* round up to page size */
-        res = ioctl(sg_fd, SG_SET_RESERVED_SIZE, &k);
-        if (res < 0)
-            perror("SG_SET_RESERVED_SIZE error");
+        n = buf_size;
+        res = sg_io_reserve(sg_fd, 1, &n, 1, false, "", op->verbose);
+        /* mmap-ed IO cannot go beyond the reserved buffer */
+        if (op->do_mmap && (res > 0) && (res < buf_size)) {
+            pr2serr("mmap-ed IO: reducing buffer size to %d bytes\n", res);
+            buf_size = res;
+        }
     }
 
     if (op->do_mmap) {
@@ -626,8 +1026,7 @@ main(int argc, char * argv[])
             if (rawp) free(rawp);
             return (res >= 0) ? res : SG_LIB_CAT_OTHER;
         }
-        if (op->do_dio &&
-            ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+        if (op->do_dio && (! sg_io_dio_done(&io_hdr, "", &dio_warned)))
             dio_incomplete = true;  /* flag that dio not done (completely) */
 
 #ifdef DEBUG
@@ -32,7 +32,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.17 20180512";
+static const char * version_str = "1.18 20261014";
 
 uint8_t mode6_hdr[] = {
     0x75, /* Length */
@@ -116,6 +116,8 @@ static void dump_mode_page( uint8_t *page, int len )
 #define RDAC_FAIL_SELECTED_PATHS 0x2
 #define RDAC_FORCE_QUIESCENCE 0x2
 #define RDAC_QUIESCENCE_TIME 10
+#define RDAC_MAX_LUNS 256
+#define RDAC_LUN_OWNED 0x1      /* LUN table entry, shown as 'p' */
 
 static int fail_all_paths(int fd, bool use_6_byte)
 {
@@ -174,9 +176,12 @@ static int fail_all_paths(int fd, bool use_6_byte)
         return res;
 }
 
-static int fail_this_path(int fd, int lun, bool use_6_byte)
+/* Transfers every LUN whose element of lun_map is set (from 0 to
+ * max_lun) with one MODE SELECT */
+static int fail_these_paths(int fd, const bool * lun_map, int max_lun,
+                            bool use_6_byte)
 {
-        int res;
+        int res, lun;
         struct rdac_legacy_page *rdac_page;
         struct rdac_expanded_page *rdac_page_exp;
         struct rdac_page_common *rdac_common = NULL;
@@ -184,12 +189,12 @@ static int fail_this_path(int fd, int lun, bool use_6_byte)
         char b[80];
 
         if (use_6_byte) {
-                if (lun > 31) {
+                if (max_lun > 31) {
                         pr2serr("must use 10 byte cdb to fail luns over 31\n");
                         return -1;
                 }
         } else {        /* 10 byte cdb case */
-                if (lun > 255) {
+                if (max_lun > 255) {
                         pr2serr("lun cannot exceed 255\n");
                         return -1;
                 }
@@ -204,7 +209,10 @@ static int fail_this_path(int fd, int lun, bool use_6_byte)
                 rdac_page->page_length = RDAC_CONTROLLER_PAGE_LEN;
                 rdac_common = &rdac_page->attr;
                 memset(rdac_page->lun_table, 0x0, 32);
-                rdac_page->lun_table[lun] = 0x81;
+                for (lun = 0; lun <= max_lun; ++lun) {
+                        if (lun_map[lun])
+                                rdac_page->lun_table[lun] = 0x81;
+                }
         } else {
                 memcpy(fail_paths_pg, mode10_hdr, 8);
                 rdac_page_exp = (struct rdac_expanded_page *)
@@ -215,7 +223,10 @@ static int fail_this_path(int fd, int lun, bool use_6_byte)
                                       rdac_page_exp->page_length + 0);
                 rdac_common = &rdac_page_exp->attr;
                 memset(rdac_page_exp->lun_table, 0x0, 256);
-                rdac_page_exp->lun_table[lun] = 0x81;
+                for (lun = 0; lun <= max_lun; ++lun) {
+                        if (lun_map[lun])
+                                rdac_page_exp->lun_table[lun] = 0x81;
+                }
         }
 
         rdac_common->current_mode_lsb =  RDAC_FAIL_SELECTED_PATHS;
@@ -239,13 +250,123 @@ static int fail_this_path(int fd, int lun, bool use_6_byte)
                 break;
         default:
                 sg_get_category_sense_str(res, sizeof(b), b, do_verbose);
-                pr2serr("fail paths page (lun=%d) failed: %s\n", lun, b);
+                pr2serr("fail paths page (max lun=%d) failed: %s\n",
+                        max_lun, b);
                 break;
         }
 
         return res;
 }
 
+/* Parses LIST, a comma separated list of LUNs and LUN ranges (e.g.
+ * "3,5,8-15"), into lun_map. Returns the number of LUNs (with the largest
+ * in *max_lunp) or -1 if LIST is bad. */
+static int parse_lun_list(const char * list, bool * lun_map, int * max_lunp)
+{
+        int n = 0;
+        long lo, hi, lun;
+        char * cp;
+
+        memset(lun_map, 0, RDAC_MAX_LUNS * sizeof(bool));
+        *max_lunp = -1;
+        while (*list) {
+                lo = strtol(list, &cp, 0);
+                if ((cp == list) || (lo < 0) || (lo >= RDAC_MAX_LUNS))
+                        return -1;
+                hi = lo;
+                if ('-' == *cp) {
+                        list = cp + 1;
+                        hi = strtol(list, &cp, 0);
+                        if ((cp == list) || (hi < lo) ||
+                            (hi >= RDAC_MAX_LUNS))
+                                return -1;
+                }
+                for (lun = lo; lun <= hi; ++lun) {
+                        if (! lun_map[lun]) {
+                                lun_map[lun] = true;
+                                ++n;
+                        }
+                }
+                if (hi > *max_lunp)
+                        *max_lunp = (int)hi;
+                if (',' == *cp)
+                        ++cp;
+                else if (*cp)
+                        return -1;
+                list = cp;
+        }
+        return n;
+}
+
+static int rdac_mode_sense(int fd, bool use_6_byte, uint8_t * rsp_buff,
+                           int * resid, bool noisy)
+{
+        *resid = 0;
+        if (use_6_byte)
+                return sg_ll_mode_sense6(fd, /* DBD */ false, /* PC */ 0,
+                                         0x2c /* page */, 0 /*subpage */,
+                                         rsp_buff, 252, noisy, do_verbose);
+        return sg_ll_mode_sense10_v2(fd, /* llbaa */ false, /* DBD */ false,
+                                     /* page control */0, 0x2c,
+                                     0x1 /* subpage */, rsp_buff, 308, 0,
+                                     resid, noisy, do_verbose);
+}
+
+/* After transferring the LUNs in lun_map, reads the RDAC page back (once a
+ * second, for about the quiescence time) until the LUN table shows all of
+ * them owned by the controller serving fd. Outputs those that are not.
+ * Returns 0 if all are, else SG_LIB_CAT_OTHER or the MODE SENSE error. */
+static int verify_paths(int fd, const bool * lun_map, int num, int max_lun,
+                        bool use_6_byte)
+{
+        int k, res, resid, lun, owned;
+        const uint8_t * lun_table;
+        uint8_t rsp_buff[MX_ALLOC_LEN];
+
+        for (k = 0, res = 0, owned = 0; k < (RDAC_QUIESCENCE_TIME + 5);
+             ++k) {
+                if (k > 0)
+                        sleep(1);
+                memset(rsp_buff, 0, 308);
+                res = rdac_mode_sense(fd, use_6_byte, rsp_buff, &resid,
+                                      true);
+                if (res)
+                        break;
+                if (use_6_byte)
+                        lun_table = ((const struct rdac_legacy_page *)
+                                     (rsp_buff + 4 + rsp_buff[3]))->lun_table;
+                else
+                        lun_table = ((const struct rdac_expanded_page *)
+                                     (rsp_buff + 8 + rsp_buff[7]))->lun_table;
+                for (lun = 0, owned = 0; lun <= max_lun; ++lun) {
+                        if (lun_map[lun] &&
+                            (RDAC_LUN_OWNED == (lun_table[lun] & 0x3)))
+                                ++owned;
+                }
+                if (owned == num)
+                        break;
+        }
+        if (res) {
+                char b[80];
+
+                sg_get_category_sense_str(res, sizeof(b), b, do_verbose);
+                pr2serr("mode sense after transfer failed: %s\n", b);
+                return res;
+        }
+        printf("%d of %d LUNs now owned by the controller serving this "
+               "DEVICE\n", owned, num);
+        if (owned == num)
+                return 0;
+        printf("  not owned:");
+        for (lun = 0; lun <= max_lun; ++lun) {
+                if (lun_map[lun] &&
+                    (RDAC_LUN_OWNED != (lun_table[lun] & 0x3)))
+                        printf(" %d", lun);
+        }
+        printf("\n");
+        return SG_LIB_CAT_OTHER;
+}
+
 static void print_rdac_mode(uint8_t *ptr, bool exp_subpg)
 {
         int i, k, bd_len, lun_table_len;
@@ -372,13 +493,15 @@ static void print_rdac_mode(uint8_t *ptr, bool exp_subpg)
 
 static void usage()
 {
-    printf("Usage:  sg_rdac [-6] [-a] [-f=LUN] [-v] [-V] DEVICE\n"
+    printf("Usage:  sg_rdac [-6] [-a] [-f=LUN[,LUN...]] [-v] [-V] DEVICE\n"
            "  where:\n"
            "    -6        use 6 byte cdbs for mode sense/select\n"
            "    -a        transfer all devices to the controller\n"
            "              serving DEVICE.\n"
            "    -f=LUN    transfer the device at LUN to the\n"
-           "              controller serving DEVICE\n"
+           "              controller serving DEVICE. LUN may be a list\n"
+           "              with ranges (e.g. '-f=0,4,8-15'): all are\n"
+           "              transferred at once then their owner checked\n"
            "    -v        verbose\n"
            "    -V        print version then exit\n\n"
            " Display/Modify RDAC Redundant Controller Page 0x2c.\n"
@@ -391,10 +514,13 @@ int main(int argc, char * argv[])
         bool fail_all = false;
         bool fail_path = false;
         bool use_6_byte = false;
-        int res, fd, k, resid, len, lun = -1;
+        int res, fd, k, resid, len;
+        int max_lun = -1;
+        int num_luns = 0;
         int ret = 0;
         char **argptr;
         char * file_name = 0;
+        bool lun_map[RDAC_MAX_LUNS];
         uint8_t rsp_buff[MX_ALLOC_LEN];
 
         if (argc < 2) {
@@ -408,7 +534,12 @@ int main(int argc, char * argv[])
                         ++do_verbose;
                 else if (!strncmp(*argptr, "-f=",3)) {
                         fail_path = true;
-                        lun = strtoul(*argptr + 3, NULL, 0);
+                        num_luns = parse_lun_list(*argptr + 3, lun_map,
+                                                  &max_lun);
+                        if (num_luns < 1) {
+                                pr2serr("bad LUN list: %s\n", *argptr + 3);
+                                return SG_LIB_SYNTAX_ERROR;
+                        }
                 }
                 else if (!strcmp(*argptr, "-a")) {
                         fail_all = true;
@@ -449,23 +580,13 @@ int main(int argc, char * argv[])
         if (fail_all) {
                 res = fail_all_paths(fd, use_6_byte);
         } else if (fail_path) {
-                res = fail_this_path(fd, lun, use_6_byte);
+                res = fail_these_paths(fd, lun_map, max_lun, use_6_byte);
+                if ((0 == res) && (num_luns > 1))
+                        res = verify_paths(fd, lun_map, num_luns, max_lun,
+                                           use_6_byte);
         } else {
-                resid = 0;
-                if (use_6_byte)
-                        res = sg_ll_mode_sense6(fd, /* DBD */ false,
-                                                /* PC */ 0,
-                                                0x2c /* page */,
-                                                0 /*subpage */,
-                                                rsp_buff, 252,
-                                                true, do_verbose);
-                else
-                        res = sg_ll_mode_sense10_v2(fd, /* llbaa */ false,
-                                                    /* DBD */ false,
-                                                    /* page control */0,
-                                                    0x2c, 0x1 /* subpage */,
-                                                    rsp_buff, 308, 0, &resid,
-                                                    true, do_verbose);
+                res = rdac_mode_sense(fd, use_6_byte, rsp_buff, &resid,
+                                      true);
 
                 if (! res) {
                         len = sg_msense_calc_length(rsp_buff, 308, use_6_byte,
@@ -36,6 +36,8 @@
 #include <signal.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -54,11 +56,12 @@
 
 #include "sg_lib.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.35 20190501";
+static const char * version_str = "1.37 20261014";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -86,7 +89,11 @@ static const char * version_str = "1.35 20190501";
 
 #define MIN_RESERVED_SIZE 8192
 
+#define MAX_THREADS 64
+#define MAX_QD 16       /* commands queued per file descriptor (sg v3) */
+
 static int sum_of_resids = 0;
+static bool dio_warned = false;     /* only first incomplete dio noted */
 
 static int64_t dd_count = -1;
 static int64_t orig_count = 0;
@@ -175,11 +182,11 @@ usage()
             "[cdbsz=6|10|12|16]\n"
             "                count=COUNT [dio=0|1] [dpo=0|1] [fua=0|1] "
             "if=IFILE\n"
-            "                [mmap=0|1] [no_dfxer=0|1] [odir=0|1] "
-            "[skip=SKIP]\n"
-            "                [time=TI] [verbose=VERB] [--help] "
-            "[--verbose]\n"
-            "                [--version] "
+            "                [interval=SEC] [mmap=0|1] [no_dxfer=0|1] "
+            "[odir=0|1]\n"
+            "                [qd=QD] [skip=SKIP] [thr=THR] [time=TI] "
+            "[verbose=VERB]\n"
+            "                [--help] [--verbose] [--version]\n"
             "  where:\n"
             "    blk_sgio 0->normal IO for block devices, 1->SCSI commands "
             "via SG_IO\n"
@@ -200,13 +207,20 @@ usage()
             "    fua      1-> set force unit access (FUA) in SCSI READs\n"
             "    if       an sg, block or raw device, or a seekable file (not "
             "stdin)\n"
+            "    interval output throughput every SEC seconds (def: 0 "
+            "-> don't)\n"
             "    mmap     1->perform mmaped IO on sg device, 0->indirect IO "
             "(def)\n"
             "    no_dxfer 1->DMA to kernel buffers only, not user space, "
             "0->normal(def)\n"
             "    odir     1->open block device O_DIRECT, 0->don't (def)\n"
+            "    qd       commands in flight per thread, sg devices only "
+            "(def: 1)\n"
             "    skip     each transfer starts at this logical address "
             "(def=0)\n"
+            "    thr      number of reader threads, each with its own "
+            "file\n"
+            "             descriptor of IFILE (def: 1)\n"
             "    time     0->do nothing(def), 1->time from 1st cmd, 2->time "
             "from 2nd, ...\n"
             "    verbose  increase level of verbosity (def: 0)\n"
@@ -217,72 +231,46 @@ usage()
             "block address\n");
 }
 
+
+/* Checks the response of a READ command (in *hp) that was sent to a sg
+ * device, either synchronously or asynchronously. Return values are as for
+ * sg_bread(). */
 static int
-sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
-                  int64_t start_block, bool write_true, bool fua, bool dpo)
+sg_bread_chk(struct sg_io_hdr * hp, int blocks, bool * diop)
 {
-    int sz_ind;
-    int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
-    int wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
-
-    memset(cdbp, 0, cdb_sz);
-    if (dpo)
-        cdbp[1] |= 0x10;
-    if (fua)
-        cdbp[1] |= 0x8;
-    switch (cdb_sz) {
-    case 6:
-        sz_ind = 0;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
-        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
-        if (blocks > 256) {
-            pr2serr(ME "for 6 byte commands, maximum number of blocks is "
-                    "256\n");
-            return 1;
-        }
-        if ((start_block + blocks - 1) & (~0x1fffff)) {
-            pr2serr(ME "for 6 byte commands, can't address blocks beyond "
-                    "%d\n", 0x1fffff);
-            return 1;
-        }
-        if (dpo || fua) {
-            pr2serr(ME "for 6 byte commands, neither dpo nor fua bits "
-                    "supported\n");
-            return 1;
-        }
-        break;
-    case 10:
-        sz_ind = 1;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be16((uint16_t)blocks, cdbp + 7);
-        if (blocks & (~0xffff)) {
-            pr2serr(ME "for 10 byte commands, maximum number of blocks is "
-                    "%d\n", 0xffff);
-            return 1;
-        }
-        break;
-    case 12:
-        sz_ind = 2;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 6);
+    if (verbose > 2)
+        pr2serr( "      duration=%u ms\n", hp->duration);
+    switch (sg_err_category3(hp)) {
+    case SG_LIB_CAT_CLEAN:
         break;
-    case 16:
-        sz_ind = 3;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be64(start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 10);
+    case SG_LIB_CAT_RECOVERED:
+        if (verbose > 1)
+                sg_chk_n_print3("reading, continue", hp, true);
         break;
+    case SG_LIB_CAT_UNIT_ATTENTION:
+        if (verbose)
+            sg_chk_n_print3("reading", hp, (verbose > 1));
+        return 2;
+    case SG_LIB_CAT_ABORTED_COMMAND:
+        if (verbose)
+            sg_chk_n_print3("reading", hp, (verbose > 1));
+        return 3;
+    case SG_LIB_CAT_NOT_READY:
+        if (verbose)
+            sg_chk_n_print3("reading", hp, (verbose > 1));
+        return -2;
+    case SG_LIB_CAT_MEDIUM_HARD:
+        if (verbose)
+            sg_chk_n_print3("reading", hp, (verbose > 1));
+        return -3;
     default:
-        pr2serr(ME "expected cdb size of 6, 10, 12, or 16 but got %d\n",
-                cdb_sz);
-        return 1;
+        sg_chk_n_print3("reading", hp, !! verbose);
+        return -1;
+    }
+    if (blocks > 0) {
+        if (diop && *diop && (! sg_io_dio_done(hp, ME, &dio_warned)))
+            *diop = 0;      /* flag that dio not done (completely) */
+        __atomic_add_fetch(&sum_of_resids, hp->resid, __ATOMIC_RELAXED);
     }
     return 0;
 }
@@ -300,8 +288,8 @@ sg_bread(int sg_fd, uint8_t * buff, int blocks, int64_t from_block, int bs,
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
 
-    if (sg_build_scsi_cdb(rdCmd, cdbsz, blocks, from_block, false, fua,
-                          dpo)) {
+    if (sg_build_rw_cdb(rdCmd, cdbsz, blocks, from_block, false, fua,
+                        dpo, ME)) {
         pr2serr(ME "bad cdb build, from_block=%" PRId64 ", blocks=%d\n",
                 from_block, blocks);
         return -1;
@@ -341,43 +329,31 @@ sg_bread(int sg_fd, uint8_t * buff, int blocks, int64_t from_block, int bs,
         perror("reading (SG_IO) on sg device, error");
         return -1;
     }
+    return sg_bread_chk(&io_hdr, blocks, diop);
+}
 
-    if (verbose > 2)
-        pr2serr( "      duration=%u ms\n", io_hdr.duration);
-    switch (sg_err_category3(&io_hdr)) {
-    case SG_LIB_CAT_CLEAN:
-        break;
-    case SG_LIB_CAT_RECOVERED:
-        if (verbose > 1)
-                sg_chk_n_print3("reading, continue", &io_hdr, true);
-        break;
-    case SG_LIB_CAT_UNIT_ATTENTION:
-        if (verbose)
-            sg_chk_n_print3("reading", &io_hdr, (verbose > 1));
-        return 2;
-    case SG_LIB_CAT_ABORTED_COMMAND:
-        if (verbose)
-            sg_chk_n_print3("reading", &io_hdr, (verbose > 1));
-        return 3;
-    case SG_LIB_CAT_NOT_READY:
-        if (verbose)
-            sg_chk_n_print3("reading", &io_hdr, (verbose > 1));
-        return -2;
-    case SG_LIB_CAT_MEDIUM_HARD:
-        if (verbose)
-            sg_chk_n_print3("reading", &io_hdr, (verbose > 1));
-        return -3;
+/* Reports a failed sg_bread() whose return value was 'res' and returns
+ * the corresponding exit status. */
+static int
+sg_bread_ret(int res)
+{
+    switch (res) {
+    case -3:
+        pr2serr(ME "SCSI READ medium/hardware error\n");
+        return SG_LIB_CAT_MEDIUM_HARD;
+    case -2:
+        pr2serr(ME "device not ready\n");
+        return SG_LIB_CAT_NOT_READY;
+    case 2:
+        pr2serr(ME "SCSI READ unit attention\n");
+        return SG_LIB_CAT_UNIT_ATTENTION;
+    case 3:
+        pr2serr(ME "SCSI READ aborted command\n");
+        return SG_LIB_CAT_ABORTED_COMMAND;
     default:
-        sg_chk_n_print3("reading", &io_hdr, !! verbose);
-        return -1;
+        pr2serr(ME "SCSI READ failed\n");
+        return SG_LIB_CAT_OTHER;
     }
-    if (blocks > 0) {
-        if (diop && *diop &&
-            ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
-            *diop = 0;      /* flag that dio not done (completely) */
-        sum_of_resids += io_hdr.resid;
-    }
-    return 0;
 }
 
 /* Returns the number of times 'ch' is found in string 's' given the
@@ -398,6 +374,481 @@ num_chs_in_str(const char * s, int slen, int ch)
 #define INF_SZ 512
 #define EBUFF_SZ 768
 
+/* State shared by the reader threads used when any of thr=, qd= or
+ * interval= is given. The blocks still to be read are claimed BPT at a
+ * time (or one zero block command at a time) from 'to_claim'. 'mutex'
+ * protects those fields and the global counters (e.g. dd_count). */
+struct rd_coll {
+    bool async;         /* sg char device: qd commands via write()/read() */
+    bool dio;
+    bool dpo;
+    bool fua;
+    bool no_dxfer;
+    bool stop;          /* set on the first error */
+    int bs;
+    int bpt;
+    int cdbsz;
+    int dio_incomplete;
+    int flags;          /* that IFILE was opened with */
+    int in_type;
+    int iters;          /* commands completed without error */
+    int lat_fd;         /* all latencies are recorded against this fd */
+    int num_active;     /* reader threads still running */
+    int opcode;         /* of the SCSI READ commands */
+    int qd;
+    int ret;            /* exit status of the first error */
+    int64_t skip;
+    int64_t to_claim;   /* as dd_count but decremented when claimed */
+    const char * inf;
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;  /* signalled when a reader thread finishes */
+};
+
+struct rd_thr {
+    int id;
+    int fd;             /* each reader thread has its own */
+    pthread_t tid;
+    struct rd_coll * clp;
+};
+
+struct rd_slot {
+    bool busy;
+    bool ua_retried;
+    int blocks;
+    uint64_t start_ns;
+    uint8_t * buffp;
+    uint8_t * free_buffp;
+    struct sg_io_hdr io_hdr;
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
+/* Returns the number of blocks the next command should read (0 for a
+ * zero block SCSI READ) or -1 when there is nothing left to do. */
+static int
+rd_claim(struct rd_coll * clp)
+{
+    int blocks = -1;
+
+    pthread_mutex_lock(&clp->mutex);
+    if (! clp->stop) {
+        if (clp->to_claim < 0) {
+            ++clp->to_claim;
+            blocks = 0;
+        } else if (clp->to_claim > 0) {
+            blocks = (clp->to_claim > clp->bpt) ? clp->bpt :
+                                                  (int)clp->to_claim;
+            clp->to_claim -= blocks;
+        }
+    }
+    pthread_mutex_unlock(&clp->mutex);
+    return blocks;
+}
+
+/* Accounts for a command that read 'blocks' blocks, the last of which is
+ * only partially read if 'partial' is set, in 'lat_ns' nanoseconds. */
+static void
+rd_done(struct rd_coll * clp, int blocks, bool partial, uint64_t lat_ns,
+        bool dio_incomplete)
+{
+    sg_pt_lat_record(clp->lat_fd, clp->opcode, lat_ns);
+    pthread_mutex_lock(&clp->mutex);
+    ++clp->iters;
+    if (dd_count > 0) {
+        dd_count -= blocks;
+        in_full += blocks;
+        if (partial)
+            ++in_partial;
+    } else if (dd_count < 0)
+        ++dd_count;
+    if (dio_incomplete)
+        ++clp->dio_incomplete;
+    pthread_mutex_unlock(&clp->mutex);
+}
+
+/* Stops all reader threads claiming more work. 'ret' is the exit status of
+ * the error that caused this, or 0 when the remaining block count is
+ * enough to flag the problem. */
+static void
+rd_stop(struct rd_coll * clp, int ret)
+{
+    pthread_mutex_lock(&clp->mutex);
+    clp->stop = true;
+    if (0 == clp->ret)
+        clp->ret = ret;
+    pthread_mutex_unlock(&clp->mutex);
+}
+
+static void
+rd_finish(struct rd_coll * clp)
+{
+    pthread_mutex_lock(&clp->mutex);
+    --clp->num_active;
+    pthread_cond_signal(&clp->cv);
+    pthread_mutex_unlock(&clp->mutex);
+}
+
+/* Returns an array of n slots each with a page aligned buffer big enough
+ * for BPT blocks, or NULL. */
+static struct rd_slot *
+rd_slots_alloc(struct rd_coll * clp, int n)
+{
+    int k;
+    struct rd_slot * slots;
+
+    slots = (struct rd_slot *)calloc(n, sizeof(struct rd_slot));
+    if (NULL == slots)
+        return NULL;
+    for (k = 0; k < n; ++k) {
+        slots[k].buffp = sg_memalign(clp->bs * clp->bpt, 0,
+                                     &slots[k].free_buffp, false);
+        if (NULL == slots[k].buffp)
+            break;
+    }
+    if (k < n) {
+        while (--k >= 0)
+            free(slots[k].free_buffp);
+        free(slots);
+        return NULL;
+    }
+    return slots;
+}
+
+static void
+rd_slots_free(struct rd_slot * slots, int n)
+{
+    int k;
+
+    for (k = 0; k < n; ++k)
+        free(slots[k].free_buffp);
+    free(slots);
+}
+
+/* Sends a SCSI READ for 'blocks' blocks on slot sp via the asynchronous
+ * write() interface of the sg driver. Returns 0 on success. */
+static int
+rd_sg_submit(struct rd_thr * tp, struct rd_slot * sp, int blocks)
+{
+    int res;
+    struct rd_coll * clp = tp->clp;
+    struct sg_io_hdr * hp = &sp->io_hdr;
+
+    if (sg_build_rw_cdb(sp->cdb, clp->cdbsz, blocks, clp->skip, false,
+                        clp->fua, clp->dpo, ME)) {
+        pr2serr(ME "bad cdb build, from_block=%" PRId64 ", blocks=%d\n",
+                clp->skip, blocks);
+        return -1;
+    }
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = clp->cdbsz;
+    hp->cmdp = sp->cdb;
+    if (blocks > 0) {
+        hp->dxfer_direction = SG_DXFER_FROM_DEV;
+        hp->dxfer_len = clp->bs * blocks;
+        hp->dxferp = sp->buffp;
+        if (clp->dio)
+            hp->flags |= SG_FLAG_DIRECT_IO;
+        else if (clp->no_dxfer)
+            hp->flags |= SG_FLAG_NO_DXFER;
+    } else
+        hp->dxfer_direction = SG_DXFER_NONE;
+    hp->mx_sb_len = SENSE_BUFF_LEN;
+    hp->sbp = sp->sense;
+    hp->timeout = DEF_TIMEOUT;
+    hp->pack_id = __atomic_fetch_add(&pack_id_count, 1, __ATOMIC_RELAXED);
+    hp->usr_ptr = sp;
+    sp->blocks = blocks;
+    sp->start_ns = sg_pt_lat_now_ns();
+    while (((res = write(tp->fd, hp, sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res < 0) {
+        perror(ME "writing (async) on sg device, error");
+        return -1;
+    }
+    sp->busy = true;
+    return 0;
+}
+
+/* Reader thread for a sg char device: keeps up to QD commands in flight
+ * on its file descriptor and reaps them in whatever order they finish. */
+static void *
+rd_sg_async_thread(void * v_tp)
+{
+    bool dio_tmp;
+    int k, res, blocks, inflight;
+    ssize_t n;
+    uint64_t lat;
+    struct rd_thr * tp = (struct rd_thr *)v_tp;
+    struct rd_coll * clp = tp->clp;
+    struct rd_slot * slots;
+    struct rd_slot * sp;
+    struct sg_io_hdr io_hdr;
+
+    slots = rd_slots_alloc(clp, clp->qd);
+    if (NULL == slots) {
+        pr2serr("Not enough user memory\n");
+        rd_stop(clp, SG_LIB_CAT_OTHER);
+        rd_finish(clp);
+        return NULL;
+    }
+    inflight = 0;
+    while (true) {
+        for (k = 0; k < clp->qd; ++k) {
+            sp = slots + k;
+            if (sp->busy)
+                continue;
+            blocks = rd_claim(clp);
+            if (blocks < 0)
+                break;
+            sp->ua_retried = false;
+            if (rd_sg_submit(tp, sp, blocks)) {
+                rd_stop(clp, SG_LIB_CAT_OTHER);
+                break;
+            }
+            ++inflight;
+        }
+        if (0 == inflight)
+            break;
+        memset(&io_hdr, 0, sizeof(io_hdr));
+        io_hdr.interface_id = 'S';
+        io_hdr.pack_id = -1;    /* any, should SG_SET_FORCE_PACK_ID be on */
+        while (((n = read(tp->fd, &io_hdr, sizeof(io_hdr))) < 0) &&
+               (EINTR == errno))
+            ;
+        if (n < 0) {
+            res = errno;
+            perror(ME "reading (async) on sg device, error");
+            rd_stop(clp, sg_convert_errno(res));
+            break;
+        }
+        sp = (struct rd_slot *)io_hdr.usr_ptr;
+        lat = sg_pt_lat_now_ns() - sp->start_ns;
+        sp->busy = false;
+        --inflight;
+        dio_tmp = clp->dio;
+        res = sg_bread_chk(&io_hdr, sp->blocks, &dio_tmp);
+        if ((2 == res) && (! sp->ua_retried)) {
+            pr2serr("Unit attention, try again (r)\n");
+            sp->ua_retried = true;
+            if (0 == rd_sg_submit(tp, sp, sp->blocks)) {
+                ++inflight;
+                continue;
+            }
+            res = -1;
+        }
+        if (res)
+            rd_stop(clp, sg_bread_ret(res));
+        else
+            rd_done(clp, sp->blocks, false, lat, clp->dio && (! dio_tmp));
+    }
+    if (0 == inflight)  /* else buffers may still be in use */
+        rd_slots_free(slots, clp->qd);
+    rd_finish(clp);
+    return NULL;
+}
+
+/* Reader thread for a block device (with SCSI READs via SG_IO when
+ * blk_sgio=1) or a normal file: one command at a time. */
+static void *
+rd_sync_thread(void * v_tp)
+{
+    bool dio_tmp;
+    int res, blocks, got;
+    ssize_t n;
+    uint64_t start_ns;
+    struct rd_thr * tp = (struct rd_thr *)v_tp;
+    struct rd_coll * clp = tp->clp;
+    struct rd_slot * sp;
+    char ebuff[128];
+
+    sp = rd_slots_alloc(clp, 1);
+    if (NULL == sp) {
+        pr2serr("Not enough user memory\n");
+        rd_stop(clp, SG_LIB_CAT_OTHER);
+        rd_finish(clp);
+        return NULL;
+    }
+    while ((blocks = rd_claim(clp)) >= 0) {
+        start_ns = sg_pt_lat_now_ns();
+        if (FT_SG & clp->in_type) {
+            dio_tmp = clp->dio;
+            res = sg_bread(tp->fd, sp->buffp, blocks, clp->skip, clp->bs,
+                           clp->cdbsz, clp->fua, clp->dpo, &dio_tmp, false,
+                           clp->no_dxfer);
+            if (2 == res) {
+                pr2serr("Unit attention, try again (r)\n");
+                res = sg_bread(tp->fd, sp->buffp, blocks, clp->skip,
+                               clp->bs, clp->cdbsz, clp->fua, clp->dpo,
+                               &dio_tmp, false, clp->no_dxfer);
+            }
+            if (res) {
+                rd_stop(clp, sg_bread_ret(res));
+                break;
+            }
+            rd_done(clp, blocks, false, sg_pt_lat_now_ns() - start_ns,
+                    clp->dio && (! dio_tmp));
+            continue;
+        }
+        while (((n = pread(tp->fd, sp->buffp, blocks * clp->bs,
+                           clp->skip * clp->bs)) < 0) && (EINTR == errno))
+            ;
+        if (n < 0) {
+            snprintf(ebuff, sizeof(ebuff), ME "reading, skip=%" PRId64 " ",
+                     clp->skip);
+            perror(ebuff);
+            rd_stop(clp, 0);
+            break;
+        } else if (n < blocks * clp->bs) {
+            pr2serr(ME "short read: wanted/got=%d/%d bytes, stop\n",
+                    blocks * clp->bs, (int)n);
+            got = n / clp->bs;
+            if ((n % clp->bs) > 0)
+                ++got;
+            rd_done(clp, got, (n % clp->bs) > 0,
+                    sg_pt_lat_now_ns() - start_ns, false);
+            rd_stop(clp, 0);
+            break;
+        }
+        rd_done(clp, blocks, false, sg_pt_lat_now_ns() - start_ns, false);
+    }
+    rd_slots_free(sp, 1);
+    rd_finish(clp);
+    return NULL;
+}
+
+/* Opens another file descriptor on IFILE for a reader thread. Returns it,
+ * or -1 after reporting the error. */
+static int
+rd_open(struct rd_coll * clp)
+{
+    int fd, t;
+    char ebuff[INF_SZ + 64];
+
+    if ((fd = open(clp->inf, clp->flags)) < 0) {
+        snprintf(ebuff, sizeof(ebuff), ME "could not open %s for reading",
+                 clp->inf);
+        perror(ebuff);
+        return -1;
+    }
+    if ((FT_SG & clp->in_type) && (! (FT_BLOCK & clp->in_type))) {
+        t = clp->bpt;   /* main() already fitted bpt to the first fd */
+        sg_io_reserve(fd, clp->bs, &t, 1, false, ME, 0);
+    }
+    return fd;
+}
+
+/* Reads with 'num_thr' threads, each with its own file descriptor of IFILE
+ * (the first uses infd) and, on a sg device, with up to QD commands in
+ * flight. With interval=SEC, a line with the throughput over the last SEC
+ * seconds is output every SEC seconds. Returns 0 or the exit status of the
+ * first error. */
+static int
+rd_parallel(struct rd_coll * clp, int infd, int num_thr, int interval)
+{
+    int k, res, iters, last_iters;
+    int ret = 0;
+    int64_t blks, last_blks;
+    uint64_t now_ns, last_ns, start_ns;
+    double el, iv;
+    struct timespec ts;
+    struct rd_thr * thr_arr;
+    struct rd_thr * tp;
+
+    thr_arr = (struct rd_thr *)calloc(num_thr, sizeof(struct rd_thr));
+    if (NULL == thr_arr) {
+        pr2serr("Not enough user memory\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    for (k = 0; k < num_thr; ++k) {
+        tp = thr_arr + k;
+        tp->id = k;
+        tp->clp = clp;
+        tp->fd = (0 == k) ? infd : rd_open(clp);
+        if (tp->fd < 0) {
+            ret = SG_LIB_FILE_ERROR;
+            num_thr = k;
+            goto fini;
+        }
+    }
+    clp->num_active = num_thr;
+    for (k = 0; k < num_thr; ++k) {
+        tp = thr_arr + k;
+        res = pthread_create(&tp->tid, NULL, (clp->async ?
+                             rd_sg_async_thread : rd_sync_thread), tp);
+        if (res) {
+            pr2serr(ME "pthread_create: %s\n", safe_strerror(res));
+            rd_stop(clp, SG_LIB_CAT_OTHER);
+            pthread_mutex_lock(&clp->mutex);
+            clp->num_active -= (num_thr - k);
+            pthread_mutex_unlock(&clp->mutex);
+            break;
+        }
+    }
+    start_ns = sg_pt_lat_now_ns();
+    last_ns = start_ns;
+    last_blks = 0;
+    last_iters = 0;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    pthread_mutex_lock(&clp->mutex);
+    while (clp->num_active > 0) {
+        if (interval <= 0) {
+            pthread_cond_wait(&clp->cv, &clp->mutex);
+            continue;
+        }
+        ts.tv_sec += interval;
+        while ((clp->num_active > 0) &&
+               (ETIMEDOUT != pthread_cond_timedwait(&clp->cv, &clp->mutex,
+                                                    &ts)))
+            ;
+        if (0 == clp->num_active)
+            break;
+        blks = in_full;
+        iters = clp->iters;
+        pthread_mutex_unlock(&clp->mutex);
+        now_ns = sg_pt_lat_now_ns();
+        el = (now_ns - start_ns) / 1e9;
+        iv = (now_ns - last_ns) / 1e9;
+        if (iv < 0.000001)
+            iv = 0.000001;
+        pr2serr("%.1f secs: %" PRId64 " blocks read, %.2f MB/sec, %.1f "
+                "commands/sec\n", el, blks,
+                ((blks - last_blks) * (double)clp->bs) / (iv * 1000000.0),
+                (iters - last_iters) / iv);
+        last_ns = now_ns;
+        last_blks = blks;
+        last_iters = iters;
+        pthread_mutex_lock(&clp->mutex);
+    }
+    pthread_mutex_unlock(&clp->mutex);
+    for (k = 0; k < num_thr; ++k) {
+        if (thr_arr[k].tid)
+            pthread_join(thr_arr[k].tid, NULL);
+    }
+    ret = clp->ret;
+fini:
+    for (k = 1; k < num_thr; ++k)
+        close(thr_arr[k].fd);
+    free(thr_arr);
+    return ret;
+}
+
+/* Outputs the latency percentiles of the commands rd_parallel() issued */
+static void
+rd_lat_report(const struct rd_coll * clp, const char * read_str)
+{
+    struct sg_pt_lat_summary ls;
+
+    if (sg_pt_lat_get(clp->lat_fd, clp->opcode, &ls))
+        return;
+    pr2serr("Latency of %" PRIu64 " %s commands (usec): min=%.1f, "
+            "mean=%.1f, max=%.1f\n", ls.count, read_str, ls.min_ns / 1000.0,
+            ls.mean_ns / 1000.0, ls.max_ns / 1000.0);
+    pr2serr("  percentiles: 50%%=%.1f, 99%%=%.1f, 99.9%%=%.1f\n",
+            ls.p50_ns / 1000.0, ls.p99_ns / 1000.0, ls.p999_ns / 1000.0);
+}
+
 
 int
 main(int argc, char * argv[])
@@ -411,6 +862,7 @@ main(int argc, char * argv[])
     bool dpo = false;
     bool fua = false;
     bool no_dxfer = false;
+    bool par = false;
     bool verbose_given = false;
     bool version_given = false;
     int bs = 0;
@@ -418,6 +870,9 @@ main(int argc, char * argv[])
     int dio_incomplete = 0;
     int do_time = 0;
     int in_type = FT_OTHER;
+    int interval = 0;
+    int num_thr = 1;
+    int qd = 1;
     int ret = 0;
     int scsi_cdbsz = DEF_SCSI_CDBSZ;
     int res, k, t, buf_sz, iters, infd, blocks, flags, blocks_per, err;
@@ -434,6 +889,7 @@ main(int argc, char * argv[])
     char ebuff[EBUFF_SZ];
     const char * read_str;
     struct timeval start_tm, end_tm;
+    struct rd_coll coll;
 
 #if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
     psz = sysconf(_SC_PAGESIZE); /* POSIX.1 (was getpagesize()) */
@@ -494,6 +950,12 @@ main(int argc, char * argv[])
         else if (strcmp(key,"if") == 0) {
             memcpy(inf, buf, INF_SZ - 1);
             inf[INF_SZ - 1] = '\0';
+        } else if (0 == strcmp(key,"interval")) {
+            interval = sg_get_num(buf);
+            if (interval < 0) {
+                pr2serr( ME "bad argument to 'interval'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"mmap"))
             do_mmap = !! sg_get_num(buf);
         else if (0 == strcmp(key,"no_dxfer"))
@@ -509,6 +971,20 @@ main(int argc, char * argv[])
                 pr2serr( ME "bad argument to 'skip'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key,"qd")) {
+            qd = sg_get_num(buf);
+            if ((qd < 1) || (qd > MAX_QD)) {
+                pr2serr( ME "bad argument to 'qd', expect 1 to %d\n",
+                         MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"thr")) {
+            num_thr = sg_get_num(buf);
+            if ((num_thr < 1) || (num_thr > MAX_THREADS)) {
+                pr2serr( ME "bad argument to 'thr', expect 1 to %d\n",
+                         MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"time"))
             do_time = sg_get_num(buf);
         else if (0 == strncmp(key, "verb", 4)) {
@@ -602,6 +1078,11 @@ main(int argc, char * argv[])
         pr2serr("cannot select no_dxfer with dio or mmap\n");
         return SG_LIB_CONTRADICT;
     }
+    par = (num_thr > 1) || (qd > 1) || (interval > 0);
+    if (par && do_mmap) {
+        pr2serr("cannot select mmap with thr, qd or interval\n");
+        return SG_LIB_CONTRADICT;
+    }
 
     install_handler (SIGINT, interrupt_handler);
     install_handler (SIGQUIT, interrupt_handler);
@@ -625,6 +1106,11 @@ main(int argc, char * argv[])
     } else if ((FT_BLOCK & in_type) && do_blk_sgio)
         in_type |= FT_SG;
 
+    if ((qd > 1) && (! (FT_SG & in_type) || (FT_BLOCK & in_type))) {
+        pr2serr("qd greater than 1 needs a sg device\n");
+        return SG_LIB_CONTRADICT;
+    }
+
     if (FT_SG & in_type) {
         if ((dd_count < 0) && (6 == scsi_cdbsz)) {
             pr2serr(ME "SCSI READ (6) can't do zero block reads\n");
@@ -652,12 +1138,11 @@ main(int argc, char * argv[])
                 if (ioctl(infd, SG_GET_RESERVED_SIZE, &t) >= 0)
                     pr2serr("  SG_GET_RESERVED_SIZE yields: %d\n", t);
             }
-            t = bs * bpt;
-            if ((do_mmap) && (0 != (t % psz)))
-                t = ((t / psz) + 1) * psz;    /* round up to next pagesize */
-            res = ioctl(infd, SG_SET_RESERVED_SIZE, &t);
-            if (res < 0)
-                perror(ME "SG_SET_RESERVED_SIZE error");
+            /* mmap-ed IO is limited to the reserved buffer (which the
+             * driver rounds up to a page size) so fit bpt to it; so too
+             * for indirect IO to avoid ENOMEM retries. Not needed by dio. */
+            sg_io_reserve(infd, bs, &bpt, 1, (do_mmap || (! do_dio)), ME,
+                          verbose);
             res = ioctl(infd, SG_GET_VERSION_NUM, &t);
             if ((res < 0) || (t < 30000)) {
                 pr2serr(ME "sg driver prior to 3.x.y\n");
@@ -742,8 +1227,41 @@ main(int argc, char * argv[])
         pr2serr("About to issue %" PRId64 " zero block SCSI READs\n",
                 0 - dd_count);
 
-    /* main loop */
-    for (iters = 0; dd_count != 0; ++iters) {
+    if (par) {
+        memset(&coll, 0, sizeof(coll));
+        coll.async = (FT_SG & in_type) && (! (FT_BLOCK & in_type));
+        coll.dio = do_dio;
+        coll.dpo = dpo;
+        coll.fua = fua;
+        coll.no_dxfer = no_dxfer;
+        coll.bs = bs;
+        coll.bpt = blocks_per;
+        coll.cdbsz = scsi_cdbsz;
+        coll.flags = flags;
+        coll.in_type = in_type;
+        coll.lat_fd = infd;
+        coll.opcode = (6 == scsi_cdbsz) ? 0x8 : ((12 == scsi_cdbsz) ? 0xa8 :
+                      ((16 == scsi_cdbsz) ? 0x88 : 0x28));
+        coll.qd = qd;
+        coll.skip = skip;
+        coll.to_claim = dd_count;
+        coll.inf = inf;
+        pthread_mutex_init(&coll.mutex, NULL);
+        pthread_cond_init(&coll.cv, NULL);
+        sg_pt_lat_enable(true);
+        if (do_time > 1) {
+            pr2serr("With thr, qd or interval, time is from the first "
+                    "command\n");
+            do_time = 1;
+        }
+        if (do_time > 0)
+            gettimeofday(&start_tm, NULL);
+        ret = rd_parallel(&coll, infd, num_thr, interval);
+        dio_incomplete = coll.dio_incomplete;
+    }
+
+    /* main loop, one command at a time, unless rd_parallel() was used */
+    for (iters = 0; (! par) && (dd_count != 0); ++iters) {
         if ((do_time > 0) && (iters == (do_time - 1)))
             gettimeofday(&start_tm, NULL);
         if (dd_count < 0)
@@ -772,28 +1290,7 @@ main(int argc, char * argv[])
                                fua, dpo, &dio_tmp, do_mmap, no_dxfer);
             }
             if (0 != res) {
-                switch (res) {
-                case -3:
-                    ret = SG_LIB_CAT_MEDIUM_HARD;
-                    pr2serr(ME "SCSI READ medium/hardware error\n");
-                    break;
-                case -2:
-                    ret = SG_LIB_CAT_NOT_READY;
-                    pr2serr(ME "device not ready\n");
-                    break;
-                case 2:
-                    ret = SG_LIB_CAT_UNIT_ATTENTION;
-                    pr2serr(ME "SCSI READ unit attention\n");
-                    break;
-                case 3:
-                    ret = SG_LIB_CAT_ABORTED_COMMAND;
-                    pr2serr(ME "SCSI READ aborted command\n");
-                    break;
-                default:
-                    ret = SG_LIB_CAT_OTHER;
-                    pr2serr(ME "SCSI READ failed\n");
-                    break;
-                }
+                ret = sg_bread_ret(res);
                 break;
             } else {
                 in_full += blocks;
@@ -837,6 +1334,8 @@ main(int argc, char * argv[])
         else if (dd_count < 0)
             ++dd_count;
     }
+    if (par)
+        iters = coll.iters;
     read_str = (FT_SG & in_type) ? "SCSI READ" : "read";
     if (do_time > 0) {
         gettimeofday(&end_tm, NULL);
@@ -892,6 +1391,8 @@ main(int argc, char * argv[])
                         read_str, (double)iters / a);
         }
     }
+    if (par)
+        rd_lat_report(&coll, read_str);
 
     if (wrkBuff)
         free(wrkBuff);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2019 Douglas Gilbert.
+ * Copyright (c) 2016-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <ctype.h>
 #include <getopt.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <errno.h>
@@ -39,10 +40,14 @@
  * and decodes the response. Based on spc5r08.pdf
  */
 
-static const char * version_str = "1.12 20190113";
+static const char * version_str = "1.13 20261014";
 
 #define MAX_RATTR_BUFF_LEN (1024 * 1024)
 #define DEF_RATTR_BUFF_LEN (1024 * 8)
+#define DEF_RATTR_ID_LEN 512    /* for attribute ids of unknown length */
+#define MAX_RATTR_IDS 256
+#define DEF_MAX_JOBS 256
+#define MAX_JOBS 1024
 
 #define SG_READ_ATTRIBUTE_CMD 0x8c
 #define SG_READ_ATTRIBUTE_CMDLEN 16
@@ -81,6 +86,26 @@ struct opts_t {
     int quiet;
     int sa;
     int verbose;
+    int num_ids;                /* > 0 when --ids=IDL given */
+    int ids[MAX_RATTR_IDS];     /* ascending, no duplicates */
+};
+
+/* The attribute values read from one DEVICE, maybe by a worker thread,
+ * when several DEVICEs or --ids=IDL are given */
+struct rattr_dev_t {
+    const char * dev_name;
+    int res;
+    int num_cmds;
+    int alen;                   /* bytes of attribute descriptors in ap */
+    uint64_t dur_ns;
+    uint8_t * ap;               /* attribute descriptors, ascending ids */
+};
+
+struct rattr_coll_t {
+    const struct opts_t * op;
+    int num_devs;
+    int next_ind;
+    struct rattr_dev_t * arr;
 };
 
 struct acron_nv_t {
@@ -106,7 +131,9 @@ static struct option long_options[] = {
     {"first", required_argument, 0, 'F'},
     {"help", no_argument, 0, 'h'},
     {"hex", no_argument, 0, 'H'},
+    {"ids", required_argument, 0, 'I'},
     {"in", required_argument, 0, 'i'},
+    {"jobs", required_argument, 0, 'j'},
     {"lvn", required_argument, 0, 'l'},
     {"maxlen", required_argument, 0, 'm'},
     {"partition", required_argument, 0, 'p'},
@@ -195,13 +222,13 @@ usage()
 {
     pr2serr("Usage: sg_read_attr [--cache] [--element=EA] [--enumerate] "
             "[--filter=FL]\n"
-            "                    [--first=FAI] [--help] [--hex] [--in=FN] "
-            "[--lvn=LVN]\n"
-            "                    [--maxlen=LEN] [--partition=PN] [--quiet] "
-            "[--raw]\n"
-            "                    [--readonly] [--sa=SA] [--verbose] "
-            "[--version]\n"
-            "                    DEVICE\n");
+            "                    [--first=FAI] [--help] [--hex] [--ids=IDL] "
+            "[--in=FN]\n"
+            "                    [--jobs=J] [--lvn=LVN] [--maxlen=LEN] "
+            "[--partition=PN]\n"
+            "                    [--quiet] [--raw] [--readonly] [--sa=SA] "
+            "[--verbose]\n"
+            "                    [--version] DEVICE [DEVICE...]\n");
     pr2serr("  where:\n"
             "    --cache|-c         set CACHE bit in cdn (def: clear)\n"
             "    --enumerate|-e     enumerate known attributes and service "
@@ -218,10 +245,18 @@ usage()
             "    --hex|-H           output response in hexadecimal; used "
             "twice\n"
             "                       shows decoded values in hex\n"
+            "    --ids=IDL|-I IDL    IDL is a comma separated list of "
+            "attribute ids;\n"
+            "                        only those are fetched, one command "
+            "each\n"
             "    --in=FN|-i FN      FN is a filename containing attribute "
             "values in\n"
             "                       ASCII hex or binary if --raw also "
             "given\n"
+            "    --jobs=J|-j J      with several DEVICEs, fetch from J of "
+            "them at a\n"
+            "                       time (def: number of DEVICEs, at most "
+            "%d)\n"
             "    --lvn=LVN|-l LVN    logical volume number (LVN) (def:0)\n"
             "    --maxlen=LEN|-m LEN    max response length (allocation "
             "length in cdb)\n"
@@ -236,7 +271,9 @@ usage()
             "    --version|-V       print version string and exit\n\n"
             "Performs a SCSI READ ATTRIBUTE command. Even though it is "
             "defined in\nSPC-3 and later it is typically used on tape "
-            "systems.\n");
+            "systems.\nWhen several DEVICEs or --ids=IDL are given, "
+            "the attribute values of\neach DEVICE are output on one line, "
+            "in DEVICE order.\n", DEF_MAX_JOBS);
 }
 
 /* Invokes a SCSI READ ATTRIBUTE command (SPC+SMC).  Return of 0 -> success,
@@ -729,12 +766,310 @@ decode_all_sa_s(const uint8_t * rabp, int len, const struct opts_t * op)
     }
 }
 
+/* Parses a comma separated list of attribute ids into op->ids[] which is
+ * left in ascending order without duplicates. Returns 0 on success. */
+static int
+build_id_list(const char * inp, struct opts_t * op)
+{
+    int k, j, n, id;
+    const char * cp;
+
+    for (k = 0, cp = inp; cp && *cp; ++k) {
+        if (k >= MAX_RATTR_IDS) {
+            pr2serr("--ids=IDL: at most %d attribute ids\n", MAX_RATTR_IDS);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        id = sg_get_num_nomult(cp);
+        if ((id < 0) || (id > 65535)) {
+            pr2serr("--ids=IDL: bad attribute id at: %s\n", cp);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        for (j = 0; (j < op->num_ids) && (op->ids[j] < id); ++j)
+            ;
+        if ((j >= op->num_ids) || (op->ids[j] != id)) {
+            for (n = op->num_ids; n > j; --n)
+                op->ids[n] = op->ids[n - 1];
+            op->ids[j] = id;
+            ++op->num_ids;
+        }
+        cp = strchr(cp, ',');
+        if (cp)
+            ++cp;
+    }
+    if (0 == op->num_ids) {
+        pr2serr("--ids=IDL: empty list\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    return 0;
+}
+
+/* Appends n bytes at bp to the attribute descriptors held for rdp.
+ * Returns 0 on success, else -1 */
+static int
+rattr_append(struct rattr_dev_t * rdp, const uint8_t * bp, int n)
+{
+    uint8_t * ap = (uint8_t *)realloc(rdp->ap, rdp->alen + n);
+
+    if (NULL == ap)
+        return -1;
+    memcpy(ap + rdp->alen, bp, n);
+    rdp->ap = ap;
+    rdp->alen += n;
+    return 0;
+}
+
+/* Fetches the attribute values of one DEVICE. Without --ids=IDL a single
+ * READ ATTRIBUTE command with an allocation length of LEN is used. With it,
+ * each listed id goes in its own cdb's FIRST ATTRIBUTE IDENTIFIER field
+ * with an allocation length just big enough for that attribute, so little
+ * more than the wanted values cross the transport. An id that is absent
+ * yields the next higher one which is discarded. Returns 0 on success. */
+static int
+fetch_attr_vals(int sg_fd, uint8_t * rabp, struct rattr_dev_t * rdp,
+                const struct opts_t * op)
+{
+    int k, res, resid, rlen, alen, id;
+    const struct attr_name_info_t * anip;
+    struct opts_t a_opts;
+    char b[160];
+
+    a_opts = *op;
+    if (0 == op->num_ids) {
+        ++rdp->num_cmds;
+        res = sg_ll_read_attr(sg_fd, rabp, &resid, op->verbose > 0,
+                              &a_opts);
+        if (res)
+            return res;
+        rlen = op->maxlen - resid;
+        if (rlen < 4)
+            return SG_LIB_CAT_MALFORMED;
+        alen = sg_get_unaligned_be32(rabp + 0);
+        if (alen > (rlen - 4))
+            alen = rlen - 4;
+        return (alen < 1) ? 0 : rattr_append(rdp, rabp + 4, alen);
+    }
+    for (k = 0; k < op->num_ids; ++k) {
+        id = op->ids[k];
+        attr_id_lookup(id, &anip, sizeof(b), b);
+        a_opts.fai = id;
+        a_opts.maxlen = 4 + 5 + ((anip && (anip->len > 0)) ? anip->len :
+                                                      DEF_RATTR_ID_LEN);
+        if (a_opts.maxlen > op->maxlen)
+            a_opts.maxlen = op->maxlen;
+again:
+        ++rdp->num_cmds;
+        res = sg_ll_read_attr(sg_fd, rabp, &resid, op->verbose > 0,
+                              &a_opts);
+        if (res)
+            return res;
+        rlen = a_opts.maxlen - resid;
+        if ((rlen < 9) || (sg_get_unaligned_be32(rabp + 0) < 5) ||
+            (id != sg_get_unaligned_be16(rabp + 4)))
+            continue;           /* id not available on this medium */
+        alen = 5 + sg_get_unaligned_be16(rabp + 7);
+        if ((alen > (rlen - 4)) && (a_opts.maxlen < op->maxlen)) {
+            a_opts.maxlen = (4 + alen < op->maxlen) ? 4 + alen : op->maxlen;
+            goto again;         /* longer than expected, so fetch again */
+        }
+        if (alen > (rlen - 4))
+            alen = rlen - 4;
+        if (rattr_append(rdp, rabp + 4, alen))
+            return -1;
+    }
+    return 0;
+}
+
+/* Takes DEVICEs, in order, until none are left and fetches the attribute
+ * values of each. */
+static void *
+rattr_worker(void * v_cp)
+{
+    int k, sg_fd;
+    uint64_t t0;
+    uint8_t * rabp;
+    uint8_t * free_rabp = NULL;
+    struct rattr_coll_t * cp = (struct rattr_coll_t *)v_cp;
+    const struct opts_t * op = cp->op;
+    struct rattr_dev_t * rdp;
+
+    rabp = (uint8_t *)sg_memalign(op->maxlen, 0, &free_rabp, false);
+    while ((k = __atomic_fetch_add(&cp->next_ind, 1, __ATOMIC_RELAXED)) <
+           cp->num_devs) {
+        rdp = cp->arr + k;
+        if (NULL == rabp) {
+            rdp->res = sg_convert_errno(ENOMEM);
+            continue;
+        }
+        sg_fd = sg_cmds_open_device(rdp->dev_name, op->o_readonly,
+                                    op->verbose);
+        if (sg_fd < 0) {
+            pr2serr("open error: %s: %s\n", rdp->dev_name,
+                    safe_strerror(-sg_fd));
+            rdp->res = sg_convert_errno(-sg_fd);
+            continue;
+        }
+        t0 = sg_pt_lat_now_ns();
+        rdp->res = fetch_attr_vals(sg_fd, rabp, rdp, op);
+        rdp->dur_ns = sg_pt_lat_now_ns() - t0;
+        if (rdp->res < 0)
+            rdp->res = SG_LIB_CAT_OTHER;
+        sg_cmds_close_device(sg_fd);
+    }
+    if (free_rabp)
+        free(free_rabp);
+    return NULL;
+}
+
+/* Outputs the value of the attribute descriptor at alp (whose length,
+ * including its 5 byte header, is len) as a single token: integers in
+ * decimal (or hex if T10 prefers), strings with trailing spaces trimmed
+ * (double quoted if they contain spaces or are empty) and anything else
+ * as a hex string. */
+static void
+pr_attr_token(const uint8_t * alp, int len)
+{
+    int k, alen;
+    const uint8_t * bp = alp + 5;
+    const struct attr_name_info_t * anip;
+    char b[160];
+
+    alen = len - 5;
+    attr_id_lookup(sg_get_unaligned_be16(alp + 0), &anip, sizeof(b), b);
+    if (anip && (RA_FMT_BINARY == anip->format) && (alen > 0) &&
+        (alen <= 8) && (anip->process < 2)) {
+        if (0 == anip->process)
+            printf("%" PRIu64, sg_get_unaligned_be(alen, bp));
+        else
+            printf("0x%" PRIx64, sg_get_unaligned_be(alen, bp));
+    } else if (anip && ((RA_FMT_ASCII == anip->format) ||
+                        (RA_FMT_TEXT == anip->format))) {
+        while ((alen > 0) && ((' ' == bp[alen - 1]) || (0 == bp[alen - 1])))
+            --alen;
+        if ((0 == alen) || memchr(bp, ' ', alen))
+            printf("\"%.*s\"", alen, bp);
+        else
+            printf("%.*s", alen, bp);
+    } else if (alen > 0) {
+        printf("0x");
+        for (k = 0; k < alen; ++k)
+            printf("%02x", bp[k]);
+    } else
+        printf("-");
+}
+
+/* Outputs the attribute values of rdp on one line, after its DEVICE name,
+ * as id=value pairs. With --ids=IDL every listed id appears, those not
+ * available having a value of "-". */
+static void
+pr_attr_record(const struct rattr_dev_t * rdp, const struct opts_t * op)
+{
+    int k, id, len, bump;
+    const uint8_t * alp;
+
+    printf("%s", rdp->dev_name);
+    for (alp = rdp->ap, len = rdp->alen, k = 0; len > 4;
+         alp += bump, len -= bump) {
+        id = sg_get_unaligned_be16(alp + 0);
+        bump = sg_get_unaligned_be16(alp + 3) + 5;
+        if (bump > len)
+            bump = len;
+        if ((op->filter >= 0) && (op->filter != id))
+            continue;
+        for ( ; (k < op->num_ids) && (op->ids[k] < id); ++k)
+            printf("  0x%04x=-", op->ids[k]);
+        if (k < op->num_ids)
+            ++k;
+        printf("  0x%04x=", id);
+        pr_attr_token(alp, bump);
+    }
+    for ( ; k < op->num_ids; ++k)
+        printf("  0x%04x=-", op->ids[k]);
+    printf("\n");
+}
+
+/* Fetches the attribute values from each DEVICE, num_thr of them at a
+ * time, then outputs them in DEVICE order: one line per DEVICE (so per
+ * loaded cartridge) or, when op->verbose > 1, as decoded by
+ * decode_attr_vals(). Returns 0 if all were fetched, else the error of the
+ * first DEVICE that failed. */
+static int
+rattr_all(struct rattr_coll_t * cp, char ** dev_names, int num_thr)
+{
+    int k, err, res;
+    int ret = 0;
+    const struct opts_t * op = cp->op;
+    struct rattr_dev_t * rdp;
+    pthread_t * tids;
+    char b[80];
+
+    cp->arr = (struct rattr_dev_t *)calloc(cp->num_devs, sizeof(*cp->arr));
+    tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+    if ((NULL == cp->arr) || (NULL == tids)) {
+        pr2serr("unable to allocate memory for %d devices\n",
+                cp->num_devs);
+        free(cp->arr);
+        free(tids);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < cp->num_devs; ++k)
+        cp->arr[k].dev_name = dev_names[k];
+    if (cp->num_devs > 1) {
+        for (k = 0; k < num_thr; ++k) {
+            err = pthread_create(tids + k, NULL, rattr_worker, cp);
+            if (err) {
+                pr2serr("pthread_create: %s, continue with %d threads\n",
+                        safe_strerror(err), k);
+                break;
+            }
+        }
+        num_thr = k;
+    } else
+        num_thr = 0;
+    if (0 == num_thr)
+        rattr_worker(cp);       /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+
+    for (k = 0; k < cp->num_devs; ++k) {
+        rdp = cp->arr + k;
+        res = rdp->res;
+        if (res) {
+            if (SG_LIB_CAT_INVALID_OP == res)
+                pr2serr("%s: Read attribute command not supported\n",
+                        rdp->dev_name);
+            else {
+                sg_get_category_sense_str(res, sizeof(b), b, op->verbose);
+                pr2serr("%s: Read attribute command: %s\n", rdp->dev_name,
+                        b);
+            }
+            if (0 == ret)
+                ret = res;
+        } else if (op->verbose > 1) {
+            printf("%s:\n", rdp->dev_name);
+            decode_attr_vals(rdp->ap, rdp->alen, op);
+        } else
+            pr_attr_record(rdp, op);
+        if ((cp->num_devs > 1) || op->verbose)
+            pr2serr("%s: %d byte%s of attributes with %d command%s in "
+                    "%.1f ms\n", rdp->dev_name, rdp->alen,
+                    (1 == rdp->alen) ? "" : "s", rdp->num_cmds,
+                    (1 == rdp->num_cmds) ? "" : "s",
+                    (double)rdp->dur_ns / 1000000.0);
+        free(rdp->ap);
+    }
+    free(cp->arr);
+    free(tids);
+    return ret;
+}
+
 int
 main(int argc, char * argv[])
 {
     int sg_fd, res, c, len, resid, rlen;
     unsigned int ra_len;
     int in_len = 0;
+    int num_devs = 0;
+    int num_jobs = 0;
     int ret = 0;
     const char * device_name = NULL;
     const char * fname = NULL;
@@ -742,6 +1077,7 @@ main(int argc, char * argv[])
     uint8_t * free_rabp = NULL;
     struct opts_t opts;
     struct opts_t * op;
+    struct rattr_coll_t coll;
     char b[80];
 
     op = &opts;
@@ -750,7 +1086,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "ceE:f:F:hHi:l:m:p:qrRs:vV",
+        c = getopt_long(argc, argv, "ceE:f:F:hHi:I:j:l:m:p:qrRs:vV",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -794,6 +1130,18 @@ main(int argc, char * argv[])
         case 'i':
             fname = optarg;
             break;
+        case 'I':
+            if ((ret = build_id_list(optarg, op)))
+                return ret;
+            break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs=J', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
            op->lvn = sg_get_num(optarg);
            if ((op->lvn < 0) || (op->lvn > 255)) {
@@ -855,16 +1203,8 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        num_devs = argc - optind;
+        device_name = argv[optind];
     }
 #ifdef DEBUG
     pr2serr("In DEBUG mode, ");
@@ -897,10 +1237,36 @@ main(int argc, char * argv[])
     if (fname && device_name) {
         pr2serr("since '--in=FN' given, ignoring DEVICE\n");
         device_name = NULL;
+        num_devs = 0;
     }
 
     if (0 == op->maxlen)
         op->maxlen = DEF_RATTR_BUFF_LEN;
+    if ((num_devs > 1) || (op->num_ids && device_name)) {
+        if (RA_ATTR_VAL_SA != op->sa) {
+            pr2serr("several DEVICEs or --ids=IDL only fetch attribute "
+                    "values (SA=0)\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->do_hex || op->do_raw) {
+            pr2serr("several DEVICEs or --ids=IDL clash with --hex and "
+                    "--raw\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->fai && op->num_ids) {
+            pr2serr("--ids=IDL overrides --first=FAI\n");
+            op->fai = 0;
+        }
+        memset(&coll, 0, sizeof(coll));
+        coll.op = op;
+        coll.num_devs = num_devs;
+        if (0 == num_jobs)
+            num_jobs = (num_devs < DEF_MAX_JOBS) ? num_devs : DEF_MAX_JOBS;
+        else if (num_jobs > num_devs)
+            num_jobs = num_devs;
+        ret = rattr_all(&coll, argv + optind, num_jobs);
+        goto clean_up;
+    }
     rabp = (uint8_t *)sg_memalign(op->maxlen, 0, &free_rabp, op->verbose > 3);
     if (NULL == rabp) {
         pr2serr("unable to sg_memalign %d bytes\n", op->maxlen);
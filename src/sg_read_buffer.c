@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006-2019 Luben Tuikov and Douglas Gilbert.
+ * Copyright (c) 2006-2026 Luben Tuikov and Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -39,7 +39,7 @@
  * device.
  */
 
-static const char * version_str = "1.29 20190516";      /* spc5r22 */
+static const char * version_str = "1.30 20261014";      /* spc5r22 */
 
 
 #ifndef SG_READ_BUFFER_10_CMD
@@ -58,6 +58,8 @@ static const char * version_str = "1.29 20190516";      /* spc5r22 */
 
 static struct option long_options[] = {
         {"16", no_argument, 0, 'L'},
+        {"all", no_argument, 0, 'a'},
+        {"chunk", required_argument, 0, 'c'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
         {"id", required_argument, 0, 'i'},
@@ -66,6 +68,7 @@ static struct option long_options[] = {
         {"long", no_argument, 0, 'L'},
         {"mode", required_argument, 0, 'm'},
         {"offset", required_argument, 0, 'o'},
+        {"outfile", required_argument, 0, 'O'},
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
         {"specific", required_argument, 0, 'S'},
@@ -85,8 +88,17 @@ usage()
             "                      [--raw] [--readonly] [--specific=MS] "
             "[--verbose]\n"
             "                      [--version] DEVICE\n"
+            "       sg_read_buffer --all [--16] [--chunk=CS] [--id=ID] "
+            "[--length=LEN]\n"
+            "                      [--mode=MO] [--offset=OFF] "
+            "[--outfile=OF]\n"
+            "                      [--specific=MS] [--verbose] DEVICE\n"
             "  where:\n"
             "    --16|-L             issue READ BUFFER(16) (def: 10)\n"
+            "    --all|-a            read the whole buffer, in chunks, "
+            "to OF or stdout\n"
+            "    --chunk=CS|-c CS    with --all: bytes per command (def: "
+            "1 MiB)\n"
             "    --help|-h           print out usage message\n"
             "    --hex|-H            print output in hex\n"
             "    --id=ID|-i ID       buffer identifier (0 (default) to 255)\n"
@@ -99,6 +111,9 @@ usage()
             "    --mode=MO|-m MO     read buffer mode, MO is number or "
             "acronym (def: 0)\n"
             "    --offset=OFF|-o OFF    buffer offset (unit: bytes, def: 0)\n"
+            "    --outfile=OF|-O OF    with --all: write buffer to file OF "
+            "(def:\n"
+            "                          stdout)\n"
             "    --raw|-r            output response in binary to stdout\n"
             "    --readonly|-R       open DEVICE read-only (def: read-write)\n"
             "    --specific=MS|-S MS    mode specific value; 3 bit field (0 "
@@ -391,6 +406,394 @@ decode_microcode_status(uint8_t * resp, int rb_len)
     }
 }
 
+/* State of a chunked download (--all) of a whole buffer to a file */
+struct rb_dl_t {
+    bool do_long;
+    int mode;
+    int mode_sp;
+    int id;
+    int align;          /* offsets must be multiples of this, 0 -> only 0 */
+    int chunk;          /* bytes per READ BUFFER command */
+    int out_fd;
+    int verbose;
+    int cmds;           /* READ BUFFER commands that completed */
+    uint64_t total;     /* bytes written to out_fd */
+};
+
+/* One READ BUFFER command in flight */
+struct rb_slot_t {
+    bool busy;
+    int len;
+    int os_err;
+    uint64_t offset;
+    struct sg_pt_base * ptvp;
+    uint8_t * buf;
+    uint8_t * free_buf;
+    uint8_t cdb[SG_READ_BUFFER_16_CMDLEN];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
+#define RB_DEF_CHUNK (1024 * 1024)
+#define RB_MIN_CHUNK 4096
+#define RB_DL_DEPTH 2   /* one read in flight while the other is written */
+
+/* Finds the size of the buffer that --all should read from offset 0.
+ * For error history (mode 0x1c) it is taken from the error history
+ * directory, otherwise from the READ BUFFER descriptor of the same buffer
+ * id which also gives the offset alignment. Returns 0 on success. */
+static int
+rb_buffer_size(int sg_fd, struct rb_dl_t * dlp, uint64_t * sizep)
+{
+    int k, res, n, resid, ob;
+    uint8_t * bp;
+    uint8_t * free_bp;
+    const int dir_len = 4096;
+
+    *sizep = 0;
+    bp = (uint8_t *)sg_memalign(dir_len, 0, &free_bp, false);
+    if (NULL == bp)
+        return sg_convert_errno(ENOMEM);
+    resid = 0;
+    if (MODE_ERR_HISTORY == dlp->mode) {
+        /* buffer id 0 is the directory: 32 byte header then 8 byte
+         * descriptors each with a buffer id and its maximum length */
+        res = sg_ll_read_buffer_10(sg_fd, MODE_ERR_HISTORY, dlp->mode_sp, 0,
+                                   0, bp, dir_len, &resid, true,
+                                   dlp->verbose);
+        if (res)
+            goto fini;
+        n = dir_len - resid;
+        if (n < 32) {
+            res = SG_LIB_CAT_MALFORMED;
+            goto fini;
+        }
+        if (0 == dlp->id) {
+            *sizep = 32 + sg_get_unaligned_be16(bp + 30);
+            goto fini;
+        }
+        if (n > (32 + sg_get_unaligned_be16(bp + 30)))
+            n = 32 + sg_get_unaligned_be16(bp + 30);
+        for (k = 32; (k + 8) <= n; k += 8) {
+            if (bp[k] == dlp->id) {
+                *sizep = sg_get_unaligned_be32(bp + k + 4);
+                break;
+            }
+        }
+        if (0 == *sizep)
+            pr2serr("buffer id 0x%x not in error history directory\n",
+                    dlp->id);
+    } else {
+        res = sg_ll_read_buffer_10(sg_fd, MODE_DESCRIPTOR, dlp->mode_sp,
+                                   dlp->id, 0, bp, 4, &resid, true,
+                                   dlp->verbose);
+        if (res)
+            goto fini;
+        if (resid > 0) {
+            res = SG_LIB_CAT_MALFORMED;
+            goto fini;
+        }
+        ob = bp[0];
+        dlp->align = (0xff == ob) ? 0 : ((ob < 24) ? (1 << ob) : 0);
+        *sizep = sg_get_unaligned_be24(bp + 1);
+    }
+    if ((0 == res) && (0 == *sizep)) {
+        pr2serr("unable to find the buffer's size, try giving "
+                "--length=\n");
+        res = SG_LIB_CAT_MALFORMED;
+    }
+fini:
+    free(free_bp);
+    return res;
+}
+
+/* Submits a READ BUFFER for len bytes at offset on slot sp */
+static int
+rb_submit(struct rb_slot_t * sp, int sg_fd, const struct rb_dl_t * dlp,
+          uint64_t offset, int len, int pack_id)
+{
+    int res;
+    int cdb_len = dlp->do_long ? SG_READ_BUFFER_16_CMDLEN :
+                                 SG_READ_BUFFER_10_CMDLEN;
+
+    memset(sp->cdb, 0, sizeof(sp->cdb));
+    sp->cdb[0] = dlp->do_long ? SG_READ_BUFFER_16_CMD : SG_READ_BUFFER_10_CMD;
+    sp->cdb[1] = (uint8_t)((dlp->mode & 0x1f) | ((dlp->mode_sp & 0x7) << 5));
+    if (dlp->do_long) {
+        sg_put_unaligned_be64(offset, sp->cdb + 2);
+        sg_put_unaligned_be24(len, sp->cdb + 11);
+        sp->cdb[14] = (uint8_t)dlp->id;
+    } else {
+        sp->cdb[2] = (uint8_t)dlp->id;
+        sg_put_unaligned_be24((uint32_t)offset, sp->cdb + 3);
+        sg_put_unaligned_be24(len, sp->cdb + 6);
+    }
+    if (dlp->verbose > 1) {
+        pr2serr("    Read buffer(%d) cdb: ", cdb_len);
+        hex2stderr(sp->cdb, cdb_len, -1);
+    }
+    clear_scsi_pt_obj(sp->ptvp);
+    set_scsi_pt_cdb(sp->ptvp, sp->cdb, cdb_len);
+    set_scsi_pt_sense(sp->ptvp, sp->sense, sizeof(sp->sense));
+    set_scsi_pt_data_in(sp->ptvp, sp->buf, len);
+    set_scsi_pt_packet_id(sp->ptvp, pack_id);
+    sp->offset = offset;
+    sp->len = len;
+    res = do_scsi_pt_submit(sp->ptvp, sg_fd, DEF_PT_TIMEOUT, dlp->verbose);
+    if (res) {
+        pr2serr("Read buffer: submit failed: %s\n", (res < 0) ?
+                safe_strerror(-res) : "bad pass through setup");
+        return (res < 0) ? sg_convert_errno(-res) : SG_LIB_CAT_OTHER;
+    }
+    sp->busy = true;
+    return 0;
+}
+
+/* Waits for the command on slot sp. Returns 0 and sets *gotp to the
+ * number of bytes received, else an error category. */
+static int
+rb_complete(struct rb_slot_t * sp, const struct rb_dl_t * dlp, bool noisy,
+            int * gotp)
+{
+    int res, ret, sense_cat;
+
+    res = do_scsi_pt_receive(sp->ptvp, false, dlp->verbose);
+    sp->busy = false;
+    sp->os_err = get_scsi_pt_os_err(sp->ptvp);
+    ret = sg_cmds_process_resp(sp->ptvp, "Read buffer", res, noisy,
+                               dlp->verbose, &sense_cat);
+    if (-1 == ret)
+        return sg_convert_errno(sp->os_err ? sp->os_err : EIO);
+    else if (-2 == ret) {
+        if ((SG_LIB_CAT_RECOVERED != sense_cat) &&
+            (SG_LIB_CAT_NO_SENSE != sense_cat))
+            return sense_cat;
+    }
+    *gotp = sp->len - get_scsi_pt_resid(sp->ptvp);
+    return 0;
+}
+
+/* Writes len bytes from bp to fd. Returns 0 on success. */
+static int
+rb_write_all(int fd, const uint8_t * bp, int len)
+{
+    int n, err;
+
+    while (len > 0) {
+        n = write(fd, bp, len);
+        if (n < 0) {
+            err = errno;
+            if (EINTR == err)
+                continue;
+            perror("write");
+            return sg_convert_errno(err);
+        }
+        bp += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Reads length bytes from offset start of the buffer into dlp->out_fd
+ * with up to RB_DL_DEPTH READ BUFFER commands in flight, each of up to
+ * dlp->chunk bytes, writing each chunk as soon as it arrives. If the
+ * device or HBA rejects a chunk as too large it is halved and the read
+ * is retried. A short read ends the download. Returns 0 on success. */
+static int
+rb_download(int sg_fd, struct rb_dl_t * dlp, uint64_t start,
+            uint64_t length)
+{
+    bool retry;
+    int k, n, res, got, head, inflight;
+    int pack_id = 0;
+    int ret = 0;
+    uint64_t next, end;
+    struct rb_slot_t * sp;
+    struct rb_slot_t slots[RB_DL_DEPTH];
+
+    memset(slots, 0, sizeof(slots));
+    for (k = 0; k < RB_DL_DEPTH; ++k) {
+        sp = slots + k;
+        sp->buf = (uint8_t *)sg_memalign(dlp->chunk, 0, &sp->free_buf,
+                                         false);
+        sp->ptvp = construct_scsi_pt_obj();
+        if ((NULL == sp->buf) || (NULL == sp->ptvp)) {
+            pr2serr("unable to allocate %d byte chunk\n", dlp->chunk);
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    }
+    next = start;
+    end = start + length;
+    head = 0;
+    inflight = 0;
+    while ((next < end) || (inflight > 0)) {
+        /* keep the slots after head, in order, busy */
+        while ((next < end) && (inflight < RB_DL_DEPTH)) {
+            sp = slots + ((head + inflight) % RB_DL_DEPTH);
+            n = ((end - next) < (uint64_t)dlp->chunk) ? (int)(end - next) :
+                                                       dlp->chunk;
+            ret = rb_submit(sp, sg_fd, dlp, next, n, ++pack_id);
+            if (ret)
+                break;
+            next += n;
+            ++inflight;
+        }
+        if (ret || (0 == inflight))
+            break;
+        sp = slots + head;
+        head = (head + 1) % RB_DL_DEPTH;
+        --inflight;
+        res = rb_complete(sp, dlp, false, &got);
+        if (res) {
+            retry = ((SG_LIB_CAT_ILLEGAL_REQ == res) ||
+                     (EINVAL == sp->os_err) || (ENOMEM == sp->os_err) ||
+                     (EOVERFLOW == sp->os_err)) &&
+                    ((dlp->chunk / 2) >= RB_MIN_CHUNK) &&
+                    ((0 == dlp->align) ||
+                     (0 == ((dlp->chunk / 2) % dlp->align)));
+            /* discard what was submitted after the failed command */
+            for ( ; inflight > 0; --inflight) {
+                rb_complete(slots + head, dlp, false, &got);
+                head = (head + 1) % RB_DL_DEPTH;
+            }
+            if (! retry) {
+                char b[80];
+
+                sg_get_category_sense_str(res, sizeof(b), b, dlp->verbose);
+                pr2serr("Read buffer at offset 0x%" PRIx64 " failed: %s\n",
+                        sp->offset, b);
+                ret = res;
+                break;
+            }
+            dlp->chunk /= 2;
+            if (dlp->verbose)
+                pr2serr("chunk at offset 0x%" PRIx64 " rejected, retry "
+                        "with %d bytes\n", sp->offset, dlp->chunk);
+            next = sp->offset;
+            continue;
+        }
+        ++dlp->cmds;
+        ret = rb_write_all(dlp->out_fd, sp->buf, got);
+        if (ret)
+            break;
+        dlp->total += got;
+        if (got < sp->len) {    /* device had less data */
+            if (dlp->verbose)
+                pr2serr("short read at offset 0x%" PRIx64 ", stop\n",
+                        sp->offset + got);
+            end = next;         /* submit nothing more */
+            for ( ; inflight > 0; --inflight) {
+                rb_complete(slots + head, dlp, false, &got);
+                head = (head + 1) % RB_DL_DEPTH;
+            }
+        }
+    }
+    for (k = 0; k < RB_DL_DEPTH; ++k) {     /* after an error */
+        if (slots[k].busy)
+            rb_complete(slots + k, dlp, false, &got);
+    }
+fini:
+    for (k = 0; k < RB_DL_DEPTH; ++k) {
+        if (slots[k].ptvp)
+            destruct_scsi_pt_obj(slots[k].ptvp);
+        if (slots[k].free_buf)
+            free(slots[k].free_buf);
+    }
+    return ret;
+}
+
+/* Implements --all: reads the buffer from offset rb_offset to its end
+ * (or for length bytes if that is not negative) and writes it to the file
+ * out_fn, or to stdout. The transfer size starts at chunk bytes (or
+ * RB_DEF_CHUNK) adjusted to the buffer's offset boundary. */
+static int
+read_all(int sg_fd, bool do_long, int rb_mode, int rb_mode_sp, int rb_id,
+         uint64_t rb_offset, int64_t length, int chunk, const char * out_fn,
+         int verbose)
+{
+    int ret, err;
+    uint64_t size, t0, dur_ns;
+    struct rb_dl_t dl;
+
+    memset(&dl, 0, sizeof(dl));
+    dl.do_long = do_long;
+    dl.mode = rb_mode;
+    dl.mode_sp = rb_mode_sp;
+    dl.id = rb_id;
+    dl.align = 1;
+    dl.verbose = verbose;
+    dl.chunk = chunk ? chunk : RB_DEF_CHUNK;
+    if (length < 0) {
+        ret = rb_buffer_size(sg_fd, &dl, &size);
+        if (ret)
+            return ret;
+        if (rb_offset >= size) {
+            pr2serr("--offset=0x%" PRIx64 " is beyond the buffer size of "
+                    "0x%" PRIx64 " bytes\n", rb_offset, size);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        size -= rb_offset;
+        if (verbose)
+            pr2serr("buffer id 0x%x: %" PRIu64 " bytes to read, offset "
+                    "alignment %d\n", rb_id, size, dl.align);
+    } else
+        size = length;
+    if (0 == dl.align) {        /* only offset 0 allowed: one command */
+        if (rb_offset || (size > 0xffffff)) {
+            pr2serr("buffer can only be read in one command from offset "
+                    "0\n");
+            return SG_LIB_CAT_ILLEGAL_REQ;
+        }
+        dl.chunk = (int)size;
+    } else if (dl.align > 1) {
+        if (rb_offset % dl.align) {
+            pr2serr("--offset= must be a multiple of %d\n", dl.align);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        dl.chunk -= dl.chunk % dl.align;
+        if (0 == dl.chunk)
+            dl.chunk = dl.align;
+    }
+    if ((! do_long) && ((rb_offset + size) > 0x1000000)) {
+        pr2serr("buffer offsets are too large for READ BUFFER(10), try "
+                "--16\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((uint64_t)dl.chunk > size)
+        dl.chunk = (int)size;
+    if (0 == size)
+        return 0;
+
+    if (out_fn && strcmp(out_fn, "-")) {
+        dl.out_fd = open(out_fn, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (dl.out_fd < 0) {
+            err = errno;
+            pr2serr("unable to open %s: %s\n", out_fn, safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+    } else {
+        out_fn = NULL;
+        dl.out_fd = STDOUT_FILENO;
+        if (sg_set_binary_mode(STDOUT_FILENO) < 0)
+            perror("sg_set_binary_mode");
+    }
+    t0 = sg_pt_lat_now_ns();
+    ret = rb_download(sg_fd, &dl, rb_offset, size);
+    dur_ns = sg_pt_lat_now_ns() - t0;
+    if (out_fn && close(dl.out_fd) && (0 == ret)) {
+        err = errno;
+        pr2serr("close of %s failed: %s\n", out_fn, safe_strerror(err));
+        ret = sg_convert_errno(err);
+    }
+    if (out_fn || verbose)
+        pr2serr("Read %" PRIu64 " bytes with %d command%s of up to %d "
+                "bytes in %.1f ms (%.1f MB/s)\n", dl.total, dl.cmds,
+                (1 == dl.cmds) ? "" : "s", dl.chunk,
+                (double)dur_ns / 1000000.0,
+                dur_ns ? ((double)dl.total * 1000.0 / (double)dur_ns) : 0.0);
+    return ret;
+}
+
 static void
 dStrRaw(const uint8_t * str, int len)
 {
@@ -403,12 +806,15 @@ dStrRaw(const uint8_t * str, int len)
 int
 main(int argc, char * argv[])
 {
+    bool do_all = false;
     bool do_long = false;
+    bool length_given = false;
     bool o_readonly = false;
     bool do_raw = false;
     bool verbose_given = false;
     bool version_given = false;
     int res, c, len, k, inhex_len;
+    int chunk = 0;
     int sg_fd = -1;
     int do_help = 0;
     int do_hex = 0;
@@ -423,6 +829,7 @@ main(int argc, char * argv[])
     uint64_t rb_offset = 0;
     const char * device_name = NULL;
     const char * fname = NULL;
+    const char * out_fn = NULL;
     uint8_t * resp = NULL;
     uint8_t * free_resp = NULL;
     const struct mode_s * mp;
@@ -430,12 +837,22 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hHi:I:l:Lm:o:rRS:vV", long_options,
+        c = getopt_long(argc, argv, "ac:hHi:I:l:Lm:o:O:rRS:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'a':
+            do_all = true;
+            break;
+        case 'c':
+            chunk = sg_get_num(optarg);
+            if ((chunk < 1) || (chunk > 0xffffff)) {
+                pr2serr("argument to '--chunk' should be 1 to 0xffffff\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'h':
         case '?':
             ++do_help;
@@ -469,6 +886,7 @@ main(int argc, char * argv[])
                 pr2serr("argument to '--length' must be <= 0xffffff\n");
                 return SG_LIB_SYNTAX_ERROR;
              }
+             length_given = true;
              break;
         case 'L':
             do_long = true;
@@ -503,6 +921,9 @@ main(int argc, char * argv[])
             }
             rb_offset = ll;
             break;
+        case 'O':
+            out_fn = optarg;
+            break;
         case 'r':
             do_raw = true;
             break;
@@ -572,8 +993,15 @@ main(int argc, char * argv[])
         return 0;
     }
 
-    rb_len = 0;
     inhex_len = 0;
+    if (do_all && (fname || do_hex)) {
+        pr2serr("--all reads from DEVICE to a file in binary so not with "
+                "--inhex= or\n--hex\n");
+        return SG_LIB_CONTRADICT;
+    } else if ((! do_all) && (chunk || out_fn)) {
+        pr2serr("--chunk= and --outfile= need --all\n");
+        return SG_LIB_CONTRADICT;
+    }
     if (device_name && fname) {
         pr2serr("Confused: both DEVICE (%s) and --inhex= option given. One "
                 "only please\n", device_name);
@@ -628,6 +1056,13 @@ main(int argc, char * argv[])
         goto fini;
     }
 
+    if (do_all) {
+        ret = read_all(sg_fd, do_long, rb_mode, rb_mode_sp, rb_id,
+                       rb_offset, (length_given ? rb_len : -1), chunk,
+                       out_fn, verbose);
+        goto fini;
+    }
+
     if (do_long)
         res = sg_ll_read_buffer_16(sg_fd, rb_mode, rb_mode_sp, rb_id,
                                    rb_offset, resp, rb_len, &resid, true,
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2005-2018 Douglas Gilbert.
+ * Copyright (c) 2005-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -19,14 +19,20 @@
 #include <limits.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
+#include <errno.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
@@ -37,13 +43,28 @@
  * a disk) to a new physical location. The previous contents is
  * recoverable then it is written to the remapped lba otherwise
  * vendor specific data is written.
+ *
+ * With --file=LF the logical block addresses (e.g. from a scrub) are read
+ * from a file, optionally checked with READ LONG, then reassigned with as
+ * few REASSIGN BLOCKS commands as the parameter list length allows.
  */
 
-static const char * version_str = "1.26 20180523";
+static const char * version_str = "1.28 20261014";
 
 #define DEF_DEFECT_LIST_FORMAT 4        /* bytes from index */
 
-#define MAX_NUM_ADDR 1024
+#define MAX_FILE_ADDR (1 << 24)         /* LBAs taken from --file=LF */
+#define MAX_SHORT_LIST_LEN 0xffff       /* 2 byte parameter list length */
+#define MAX_LONG_LIST_ADDR 65536        /* LBAs per command with LONGLIST */
+#define DEF_RL_XFER_LEN 520             /* as in sg_read_long */
+#define DEF_CHECK_JOBS 8
+#define MAX_CHECK_JOBS 64
+
+#define REASSIGN_BLKS_CMD 0x7
+#define REASSIGN_BLKS_CMDLEN 6
+#define REASSIGN_TIMEOUT 3600   /* a long list may take a while */
+#define PARAM_LIST_LEN_ERR_ASC 0x1a
+#define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -52,15 +73,20 @@ static const char * version_str = "1.26 20180523";
 
 static struct option long_options[] = {
         {"address", required_argument, 0, 'a'},
+        {"batch", required_argument, 0, 'b'},
+        {"check", no_argument, 0, 'c'},
         {"dummy", no_argument, 0, 'd'},
         {"eight", required_argument, 0, 'e'},
+        {"file", required_argument, 0, 'f'},
         {"grown", no_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
+        {"jobs", required_argument, 0, 'j'},
         {"longlist", required_argument, 0, 'l'},
         {"primary", no_argument, 0, 'p'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
+        {"xfer_len", required_argument, 0, 'x'},
         {0, 0, 0, 0},
 };
 
@@ -72,6 +98,11 @@ usage()
             "                   [--help] [--hex] [--longlist=0|1] "
             "[--primary] [--verbose]\n"
             "                   [--version] DEVICE\n"
+            "       sg_reassign --file=LF [--batch=B] [--check] [--dummy] "
+            "[--eight=0|1]\n"
+            "                   [--jobs=J] [--longlist=0|1] [--verbose] "
+            "[--xfer_len=BTL]\n"
+            "                   DEVICE\n"
             "  where:\n"
             "    --address=A,A...|-a A,A...    comma separated logical block "
             "addresses\n"
@@ -79,18 +110,33 @@ usage()
             "decimal\n"
             "    --address=-|-a -    read stdin for logical block "
             "addresses\n"
+            "    --batch=B|-b B      at most B LBAs in each REASSIGN BLOCKS "
+            "(def: as\n"
+            "                        many as the parameter list length "
+            "allows)\n"
+            "    --check|-c          READ LONG (with CORRCT) each LBA from "
+            "LF first and\n"
+            "                        only reassign those with medium "
+            "errors\n"
             "    --dummy|-d          prepare but do not execute REASSIGN "
             "BLOCKS command\n"
             "    --eight=0|1\n"
             "      -e 0|1            force eight byte (64 bit) lbas "
             "when 1,\n"
             "                        four byte (32 bit) lbas when 0 "
-            "(def)\n"
+            "(def, but 1\n"
+            "                        with '--file=')\n"
+            "    --file=LF|-f LF     read LBAs from file LF ('-' for "
+            "stdin), one\n"
+            "                        LBA[,NUM] per line (as written by "
+            "'sg_verify --bad=')\n"
             "    --grown|-g          fetch grown defect list length, "
             "don't reassign\n"
             "    --help|-h           print out usage message\n"
             "    --hex|-H            print response in hex (for '-g' or "
             "'-p')\n"
+            "    --jobs=J|-j J       READ LONG checks in flight (def: %d, "
+            "max: %d)\n"
             "    --longlist=0|1\n"
             "       -l 0|1           use 4 byte list length when 1, safe to "
             "ignore\n"
@@ -98,128 +144,370 @@ usage()
             "    --primary|-p        fetch primary defect list length, "
             "don't reassign\n"
             "    --verbose|-v        increase verbosity\n"
-            "    --version|-V        print version string and exit\n\n"
-            "Perform a SCSI REASSIGN BLOCKS command (or READ DEFECT LIST)\n");
+            "    --version|-V        print version string and exit\n"
+            "    --xfer_len=BTL|-x BTL    READ LONG transfer length (def: "
+            "%d, corrected\n"
+            "                             from the device's response)\n\n"
+            "Perform a SCSI REASSIGN BLOCKS command (or READ DEFECT LIST)\n",
+            DEF_CHECK_JOBS, MAX_CHECK_JOBS, DEF_RL_XFER_LEN);
 }
 
-/* Read numbers (up to 64 bits in size) from command line (comma (or
- * (single) space) separated list) or from stdin (one per line, comma
- * separated list or space separated list). Assumed decimal unless prefixed
- * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or error code. */
+/* Places the LBAs of the set, sorted and without duplicates (neighbouring
+ * extents are coalesced), in a heap array (written to *arrpp, free()-ed by
+ * the caller). SBC wants the LBAs of a REASSIGN BLOCKS parameter list in
+ * ascending order. Returns 0 if ok. */
 static int
-build_lba_arr(const char * inp, uint64_t * lba_arr,
-              int * lba_arr_len, int max_arr_len)
+lba_set_to_arr(struct sg_lba_set * lsp, const char * src, int max_num,
+               uint64_t ** arrpp, int * arr_lenp, int vb)
 {
-    int in_len, k, j, m;
-    const char * lcp;
-    int64_t ll;
-    char * cp;
-    char * c2p;
-
-    if ((NULL == inp) || (NULL == lba_arr) ||
-        (NULL == lba_arr_len))
-        return SG_LIB_LOGIC_ERROR;
-    lcp = inp;
-    in_len = strlen(inp);
-    if (0 == in_len)
-        *lba_arr_len = 0;
-    if ('-' == inp[0]) {        /* read from stdin */
-        char line[1024];
-        int off = 0;
-
-        for (j = 0; j < 512; ++j) {
-            if (NULL == fgets(line, sizeof(line), stdin))
-                break;
-            // could improve with carry_over logic if sizeof(line) too small
-            in_len = strlen(line);
-            if (in_len > 0) {
-                if ('\n' == line[in_len - 1]) {
-                    --in_len;
-                    line[in_len] = '\0';
-                }
+    int k, n;
+    uint64_t j, dup, tot;
+    uint64_t * arr;
+    const struct sg_lba_extent * ep;
+
+    dup = sg_lba_set_coalesce(lsp);
+    if (vb && (dup > 0))
+        pr2serr("%" PRIu64 " duplicate LBAs in %s ignored\n", dup, src);
+    tot = sg_lba_set_blocks(lsp);
+    if (tot > (uint64_t)max_num) {
+        pr2serr("more than %d LBAs in %s\n", max_num, src);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    *arr_lenp = 0;
+    if (0 == tot)
+        return 0;
+    arr = (uint64_t *)malloc(tot * sizeof(uint64_t));
+    if (NULL == arr) {
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, n = 0, ep = lsp->ext; k < lsp->num; ++k, ++ep) {
+        for (j = 0; j < ep->num; ++j)
+            arr[n++] = ep->lba + j;
+    }
+    *arrpp = arr;
+    *arr_lenp = n;
+    return 0;
+}
+
+struct rl_check {
+    int sg_fd;
+    int xfer_len;
+    int num;
+    int vb;
+    int next_ind;               /* next LBA to check, claimed atomically */
+    const uint64_t * arr;
+    int * res_arr;              /* READ LONG result for each LBA */
+};
+
+static int
+read_long_lba(int sg_fd, uint64_t lba, uint8_t * bp, int xfer_len,
+              int * offsetp, int vb)
+{
+    if (lba > UINT32_MAX)
+        return sg_ll_read_long16(sg_fd, false, true, lba, bp, xfer_len,
+                                 offsetp, false, vb);
+    return sg_ll_read_long10(sg_fd, false, true, (unsigned int)lba, bp,
+                             xfer_len, offsetp, false, vb);
+}
+
+static void *
+check_worker(void * v_clp)
+{
+    struct rl_check * clp = (struct rl_check *)v_clp;
+    int k;
+    uint8_t * bp;
+
+    if (NULL == (bp = (uint8_t *)malloc(clp->xfer_len)))
+        return NULL;
+    while ((k = __atomic_fetch_add(&clp->next_ind, 1, __ATOMIC_RELAXED)) <
+           clp->num)
+        clp->res_arr[k] = read_long_lba(clp->sg_fd, clp->arr[k], bp,
+                                        clp->xfer_len, NULL, clp->vb);
+    free(bp);
+    return NULL;
+}
+
+/* Issues READ LONG, with the CORRCT bit set so that the device applies
+ * its ECC, to each of the num LBAs in arr with up to num_jobs commands in
+ * flight. LBAs that read back are removed from arr, leaving those with an
+ * unrecoverable (or other) error; *nump is updated. If xfer_len was not
+ * given it is corrected from the ILI response to the first command.
+ * Returns 0 if ok. */
+static int
+check_lbas(int sg_fd, uint64_t * arr, int * nump, int xfer_len,
+           bool xfer_len_given, int num_jobs, int vb)
+{
+    int k, j, res, offset;
+    int num = *nump;
+    int n_good = 0;
+    int n_med = 0;
+    int n_other = 0;
+    int ret = 0;
+    int * res_arr;
+    uint8_t * bp;
+    uint64_t start_ns;
+    struct rl_check ck;
+    char b[80];
+#ifndef SG_LIB_WIN32
+    int err;
+    pthread_t tids[MAX_CHECK_JOBS];
+#endif
+
+    if (NULL == (res_arr = (int *)calloc(num, sizeof(int))))
+        return sg_convert_errno(ENOMEM);
+    if (NULL == (bp = (uint8_t *)malloc(0xffff))) {
+        free(res_arr);
+        return sg_convert_errno(ENOMEM);
+    }
+    /* first LBA alone, to find the transfer length the device wants */
+    res = read_long_lba(sg_fd, arr[0], bp, xfer_len, &offset, vb);
+    if ((SG_LIB_CAT_ILLEGAL_REQ_WITH_INFO == res) && (! xfer_len_given) &&
+        ((xfer_len - offset) > 0) && ((xfer_len - offset) <= 0xffff)) {
+        xfer_len -= offset;
+        if (vb)
+            pr2serr("READ LONG transfer length corrected to %d\n",
+                    xfer_len);
+        res = read_long_lba(sg_fd, arr[0], bp, xfer_len, &offset, vb);
+    }
+    free(bp);
+    switch (res) {
+    case 0:
+    case SG_LIB_CAT_MEDIUM_HARD:
+        break;
+    case SG_LIB_CAT_ILLEGAL_REQ_WITH_INFO:
+        pr2serr("READ LONG: device indicates 'xfer_len' should be %d\n",
+                xfer_len - offset);
+        ret = res;
+        goto fini;
+    default:
+        sg_get_category_sense_str(res, sizeof(b), b, vb);
+        pr2serr("READ LONG of lba 0x%" PRIx64 ": %s\n", arr[0], b);
+        ret = res;
+        goto fini;
+    }
+    res_arr[0] = res;
+    ck.sg_fd = sg_fd;
+    ck.xfer_len = xfer_len;
+    ck.num = num;
+    ck.vb = (vb > 1) ? vb - 1 : 0;
+    ck.next_ind = 1;
+    ck.arr = arr;
+    ck.res_arr = res_arr;
+    if (num_jobs > (num - 1))
+        num_jobs = (num > 1) ? (num - 1) : 1;
+    start_ns = sg_pt_lat_now_ns();
+#ifndef SG_LIB_WIN32
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, check_worker, &ck))) {
+            if (vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    check_worker(&ck);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+#else
+    num_jobs = 1;
+    check_worker(&ck);
+#endif
+    if (ck.next_ind < num) {    /* worker could not get its buffer */
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0, j = 0; k < num; ++k) {
+        res = res_arr[k];
+        if (0 == res) {
+            ++n_good;
+            if (vb > 1)
+                pr2serr("  lba 0x%" PRIx64 " readable, skipped\n", arr[k]);
+            continue;
+        }
+        if (SG_LIB_CAT_MEDIUM_HARD == res)
+            ++n_med;
+        else {
+            ++n_other;
+            if (vb) {
+                sg_get_category_sense_str(res, sizeof(b), b, vb);
+                pr2serr("  lba 0x%" PRIx64 ": READ LONG: %s\n", arr[k], b);
             }
-            if (in_len < 1)
-                continue;
-            lcp = line;
-            m = strspn(lcp, " \t");
-            if (m == in_len)
-                continue;
-            lcp += m;
-            in_len -= m;
-            if ('#' == *lcp)
+        }
+        arr[j++] = arr[k];
+    }
+    *nump = j;
+    printf("READ LONG checked %d LBAs with %d job%s in %" PRIu64 " ms: %d "
+           "unrecoverable, %d readable (skipped), %d other error%s\n", num,
+           num_jobs, (1 == num_jobs) ? "" : "s",
+           (sg_pt_lat_now_ns() - start_ns) / 1000000, n_med, n_good,
+           n_other, (1 == n_other) ? "" : "s");
+fini:
+    free(res_arr);
+    return ret;
+}
+
+/* Like sg_ll_reassign_blocks() but with a longer timeout; on a sense
+ * error the additional sense code and the COMMAND-SPECIFIC INFORMATION
+ * field (the first LBA not reassigned) are written to *ascp and *csip (the
+ * latter left alone if not present). Returns 0 -> success, various
+ * SG_LIB_CAT_* positive values or -1 -> other errors */
+static int
+reassign_pt(int sg_fd, bool longlba, bool longlist, uint8_t * paramp,
+            int param_len, int * ascp, uint64_t * csip, int vb)
+{
+    int k, ret, res, sense_cat, slen;
+    uint8_t reass_cdb[REASSIGN_BLKS_CMDLEN] =
+        {REASSIGN_BLKS_CMD, 0, 0, 0, 0, 0};
+    uint8_t sense_b[SENSE_BUFF_LEN];
+    struct sg_pt_base * ptvp;
+    struct sg_scsi_sense_hdr ssh;
+
+    if (longlba)
+        reass_cdb[1] = 0x2;
+    if (longlist)
+        reass_cdb[1] |= 0x1;
+    if (vb) {
+        pr2serr("    Reassign blocks cdb: ");
+        for (k = 0; k < REASSIGN_BLKS_CMDLEN; ++k)
+            pr2serr("%02x ", reass_cdb[k]);
+        pr2serr("\n");
+    }
+    if (vb > 2) {
+        pr2serr("    Reassign blocks parameter list\n");
+        hex2stderr(paramp, param_len, -1);
+    }
+    ptvp = construct_scsi_pt_obj();
+    if (NULL == ptvp) {
+        pr2serr("%s: out of memory\n", __func__);
+        return -1;
+    }
+    *ascp = 0;
+    set_scsi_pt_cdb(ptvp, reass_cdb, sizeof(reass_cdb));
+    set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+    set_scsi_pt_data_out(ptvp, paramp, param_len);
+    res = do_scsi_pt(ptvp, sg_fd, REASSIGN_TIMEOUT, vb);
+    ret = sg_cmds_process_resp(ptvp, "Reassign blocks", res, true, vb,
+                               &sense_cat);
+    if (-1 == ret)
+        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == ret) {
+        switch (sense_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            ret = 0;
+            break;
+        default:
+            ret = sense_cat;
+            slen = get_scsi_pt_sense_len(ptvp);
+            if (sg_scsi_normalize_sense(sense_b, slen, &ssh))
+                *ascp = ssh.asc;
+            sg_get_sense_cmd_spec_fld(sense_b, slen, csip);
+            break;
+        }
+    } else
+        ret = 0;
+    destruct_scsi_pt_obj(ptvp);
+    return ret;
+}
+
+/* Reassigns the num (sorted) LBAs in arr with REASSIGN BLOCKS commands of
+ * up to batch LBAs each. If the device rejects a parameter list as too
+ * long then batch is halved and that list sent again. Returns 0 if all
+ * were reassigned, else the error of the command that failed; later LBAs
+ * are not tried. */
+static int
+reassign_batch(int sg_fd, const uint64_t * arr, int num, bool eight,
+               bool longlist, int batch, bool dummy, int vb)
+{
+    int k, j, n, per, plen, asc;
+    int done = 0;
+    int num_cmds = 0;
+    int res = 0;
+    uint64_t csi;
+    uint8_t * pbp;
+    char b[80];
+
+    per = eight ? 8 : 4;
+    if (NULL == (pbp = (uint8_t *)calloc(1, 4 + (batch * per)))) {
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    while (done < num) {
+        n = ((num - done) < batch) ? (num - done) : batch;
+        for (j = 0, k = 4; j < n; ++j, k += per) {
+            if (eight)
+                sg_put_unaligned_be64(arr[done + j], pbp + k);
+            else
+                sg_put_unaligned_be32((uint32_t)arr[done + j], pbp + k);
+        }
+        plen = k;
+        if (longlist)
+            sg_put_unaligned_be32((uint32_t)(plen - 4), pbp + 0);
+        else {
+            sg_put_unaligned_be16(0, pbp + 0);
+            sg_put_unaligned_be16((uint16_t)(plen - 4), pbp + 2);
+        }
+        if (dummy) {
+            printf("would reassign %d LBAs: 0x%" PRIx64 " to 0x%" PRIx64
+                   "\n", n, arr[done], arr[done + n - 1]);
+            if (vb) {
+                for (j = 0; j < n; ++j)
+                    printf("    0x%" PRIx64 "\n", arr[done + j]);
+            }
+        } else {
+            csi = UINT64_MAX;
+            res = reassign_pt(sg_fd, eight, longlist, pbp, plen, &asc, &csi,
+                              vb);
+            if ((SG_LIB_CAT_ILLEGAL_REQ == res) &&
+                (PARAM_LIST_LEN_ERR_ASC == asc) && (n > 1)) {
+                batch = (n + 1) / 2;
+                if (vb)
+                    pr2serr("REASSIGN BLOCKS of %d LBAs rejected, trying "
+                            "%d\n", n, batch);
                 continue;
-            k = strspn(lcp, "0123456789aAbBcCdDeEfFhHxX ,\t");
-            if ((k < in_len) && ('#' != lcp[k])) {
-                pr2serr("%s: syntax error at line %d, pos %d\n", __func__,
-                        j + 1, m + k + 1);
-                return SG_LIB_SYNTAX_ERROR;
             }
-            for (k = 0; k < 1024; ++k) {
-                ll = sg_get_llnum_nomult(lcp);
-                if (-1 != ll) {
-                    if ((off + k) >= max_arr_len) {
-                        pr2serr("%s: array length exceeded\n", __func__);
-                        return SG_LIB_SYNTAX_ERROR;
-                    }
-                    lba_arr[off + k] = (uint64_t)ll;
-                    lcp = strpbrk(lcp, " ,\t");
-                    if (NULL == lcp)
-                        break;
-                    lcp += strspn(lcp, " ,\t");
-                    if ('\0' == *lcp)
-                        break;
-                } else {
-                    if ('#' == *lcp) {
-                        --k;
+            if (res) {
+                sg_get_category_sense_str(res, sizeof(b), b, vb);
+                pr2serr("REASSIGN BLOCKS of %d LBAs (0x%" PRIx64 " to 0x%"
+                        PRIx64 "): %s\n", n, arr[done], arr[done + n - 1],
+                        b);
+                /* LBAs before the first one not reassigned are done */
+                for (j = 0; j < n; ++j) {
+                    if (arr[done + j] == csi)
                         break;
-                    }
-                    pr2serr("%s: error in line %d, at pos %d\n", __func__,
-                            j + 1, (int)(lcp - line + 1));
-                    return SG_LIB_SYNTAX_ERROR;
                 }
+                if (j < n) {
+                    pr2serr("first LBA not reassigned: 0x%" PRIx64 "\n",
+                            csi);
+                    pr2serr("%d LBAs reassigned, %d not\n", done + j,
+                            num - done - j);
+                } else
+                    pr2serr("%d LBAs reassigned, up to %d of the failed "
+                            "command, %d not attempted\n", done, n,
+                            num - done - n);
+                break;
             }
-            off += (k + 1);
-        }
-        *lba_arr_len = off;
-    } else {        /* list of numbers (default decimal) on command line */
-        k = strspn(inp, "0123456789aAbBcCdDeEfFhHxX, ");
-        if (in_len != k) {
-            pr2serr("%s: error at pos %d\n", __func__, k + 1);
-            return SG_LIB_SYNTAX_ERROR;
-        }
-        for (k = 0; k < max_arr_len; ++k) {
-            ll = sg_get_llnum_nomult(lcp);
-            if (-1 != ll) {
-                lba_arr[k] = (uint64_t)ll;
-                cp = (char *)strchr(lcp, ',');
-                c2p = (char *)strchr(lcp, ' ');
-                if (NULL == cp)
-                    cp = c2p;
-                if (NULL == cp)
-                    break;
-                if (c2p && (c2p < cp))
-                    cp = c2p;
-                lcp = cp + 1;
-            } else {
-                pr2serr("%s: error at pos %d\n", __func__,
-                        (int)(lcp - inp + 1));
-                return SG_LIB_SYNTAX_ERROR;
-            }
-        }
-        *lba_arr_len = k + 1;
-        if (k == max_arr_len) {
-            pr2serr("%s: array length exceeded\n", __func__);
-            return SG_LIB_SYNTAX_ERROR;
+            if (vb)
+                pr2serr("reassigned %d LBAs: 0x%" PRIx64 " to 0x%" PRIx64
+                        "\n", n, arr[done], arr[done + n - 1]);
         }
+        ++num_cmds;
+        done += n;
     }
-    return 0;
+    if (0 == res)
+        printf("%s %d LBAs with %d REASSIGN BLOCKS command%s\n",
+               dummy ? ">>> dummy: would have reassigned" : "Reassigned",
+               num, num_cmds, (1 == num_cmds) ? "" : "s");
+    free(pbp);
+    return res;
 }
 
 
 int
 main(int argc, char * argv[])
 {
+    bool check = false;
     bool dummy = false;
     bool eight = false;
     bool eight_given = false;
@@ -229,36 +517,66 @@ main(int argc, char * argv[])
     bool grown = false;
     bool verbose_given = false;
     bool version_given = false;
+    bool xfer_len_given = false;
     int res, c, num, k, j;
     int sg_fd = -1;
     int addr_arr_len = 0;
+    int batch = 0;
     int do_hex = 0;
+    int file_arr_len = 0;
+    int num_jobs = DEF_CHECK_JOBS;
     int verbose = 0;
+    int xfer_len = DEF_RL_XFER_LEN;
     const char * device_name = NULL;
-    uint64_t addr_arr[MAX_NUM_ADDR];
-    uint8_t param_arr[4 + (MAX_NUM_ADDR * 8)];
+    const char * file_fn = NULL;
+    uint64_t * addr_arr = NULL;
+    uint64_t * file_arr = NULL;
+    uint8_t * param_arr = NULL;
+    struct sg_lba_set addr_set;
+    struct sg_lba_set file_set;
+    uint8_t dl_hdr[4];
     char b[80];
     int param_len = 4;
     int ret = 0;
 
+    sg_lba_set_init(&addr_set);
+    sg_lba_set_init(&file_set);
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "a:de:ghHl:pvV", long_options,
+        c = getopt_long(argc, argv, "a:b:cde:f:ghHj:l:pvVx:", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
         case 'a':
-            memset(addr_arr, 0, sizeof(addr_arr));
-            if ((res = build_lba_arr(optarg, addr_arr, &addr_arr_len,
-                                     MAX_NUM_ADDR))) {
+            sg_lba_set_free(&addr_set);     /* last --address= wins */
+            if (('-' == optarg[0]) && ('\0' == optarg[1]))
+                res = sg_lba_set_read_file(&addr_set, optarg,
+                                           SG_LBA_SET_LBAS |
+                                           SG_LBA_SET_NOMULT);
+            else
+                res = sg_lba_set_parse(&addr_set, optarg, NULL,
+                                       SG_LBA_SET_NOMULT);
+            if (res) {
                 pr2serr("bad argument to '--address'\n");
+                sg_lba_set_free(&addr_set);
                 return res;
             }
             got_addr = true;
             break;
+        case 'b':
+            batch = sg_get_num(optarg);
+            if ((batch < 1) || (batch > MAX_LONG_LIST_ADDR)) {
+                pr2serr("argument to '--batch=' should be from 1 to %d\n",
+                        MAX_LONG_LIST_ADDR);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'c':
+            check = true;
+            break;
         case 'd':
             dummy = true;
             break;
@@ -272,6 +590,9 @@ main(int argc, char * argv[])
             }
             eight_given = true;
             break;
+        case 'f':
+            file_fn = optarg;
+            break;
         case 'g':
             grown = true;
             break;
@@ -282,6 +603,14 @@ main(int argc, char * argv[])
         case 'H':
             ++do_hex;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_CHECK_JOBS)) {
+                pr2serr("argument to '--jobs=' should be from 1 to %d\n",
+                        MAX_CHECK_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             num = sscanf(optarg, "%d", &res);
             if ((1 == num) && ((0 == res) || (1 == res)))
@@ -301,6 +630,15 @@ main(int argc, char * argv[])
         case 'V':
             version_given = true;
             break;
+        case 'x':
+            xfer_len = sg_get_num(optarg);
+            if ((xfer_len < 1) || (xfer_len > 0xffff)) {
+                pr2serr("argument to '--xfer_len=' should be from 1 to "
+                        "65535\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            xfer_len_given = true;
+            break;
         default:
             pr2serr("unrecognised option code 0x%x ??\n", c);
             usage();
@@ -345,7 +683,54 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
-    if (grown || primary) {
+    if (got_addr) {
+        res = lba_set_to_arr(&addr_set, "--address=", MAX_LONG_LIST_ADDR,
+                             &addr_arr, &addr_arr_len, verbose);
+        sg_lba_set_free(&addr_set);
+        if (res)
+            return res;
+    }
+    if (file_fn) {
+        if (got_addr || grown || primary) {
+            pr2serr("can't have '--file=' with '--address=', '--grown' or "
+                    "'--primary'\n");
+            usage();
+            return SG_LIB_CONTRADICT;
+        }
+        res = sg_lba_set_read_file(&file_set, file_fn, SG_LBA_SET_NOMULT);
+        if (0 == res)
+            res = lba_set_to_arr(&file_set, file_fn, MAX_FILE_ADDR,
+                                 &file_arr, &file_arr_len, verbose);
+        sg_lba_set_free(&file_set);
+        if (res)
+            return res;
+        if (file_arr_len < 1) {
+            pr2serr("no LBAs found in %s\n", file_fn);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (! eight_given)
+            eight = true;       /* long LBA format */
+        else if ((! eight) && (file_arr[file_arr_len - 1] >= UINT32_MAX)) {
+            pr2serr("lba 0x%" PRIx64 " exceeds 32 bits so '--eight=0' "
+                    "invalid\n", file_arr[file_arr_len - 1]);
+            free(file_arr);
+            return SG_LIB_CONTRADICT;
+        }
+        k = longlist ? MAX_LONG_LIST_ADDR :
+                       ((MAX_SHORT_LIST_LEN / (eight ? 8 : 4)));
+        if (0 == batch)
+            batch = k;
+        else if (batch > k) {
+            pr2serr("'--batch=' exceeds %d, the most LBAs the parameter "
+                    "list can hold\n", k);
+            free(file_arr);
+            return SG_LIB_CONTRADICT;
+        }
+    } else if (check || batch) {
+        pr2serr("'--check' and '--batch=' need '--file='\n");
+        usage();
+        return SG_LIB_CONTRADICT;
+    } else if (grown || primary) {
         if (got_addr) {
             pr2serr("can't have '--address=' with '--grown' or '--primary'\n");
             usage();
@@ -357,21 +742,29 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
     if (got_addr) {
-        for (k = 0; k < addr_arr_len; ++k) {
-            if (addr_arr[k] >= UINT32_MAX) {
-                if (! eight_given) {
-                    eight = true;
-                    break;
-                } else if (! eight) {
-                    pr2serr("address number %d exceeds 32 bits so "
-                            "'--eight=0' invalid\n", k + 1);
-                    return SG_LIB_CONTRADICT;
-                }
+        /* sorted so the last address is the largest */
+        if (addr_arr[addr_arr_len - 1] >= UINT32_MAX) {
+            if (! eight_given)
+                eight = true;
+            else if (! eight) {
+                pr2serr("address 0x%" PRIx64 " exceeds 32 bits so "
+                        "'--eight=0' invalid\n", addr_arr[addr_arr_len - 1]);
+                return SG_LIB_CONTRADICT;
             }
-        }
-        if (! eight_given)
+        } else if (! eight_given)
             eight = false;
-
+        k = longlist ? MAX_LONG_LIST_ADDR :
+                       ((MAX_SHORT_LIST_LEN / (eight ? 8 : 4)));
+        if (addr_arr_len > k) {
+            pr2serr("%d addresses exceed the %d that fit in the parameter "
+                    "list, try '--file='\n", addr_arr_len, k);
+            return SG_LIB_CONTRADICT;
+        }
+        param_arr = (uint8_t *)calloc(1, 4 + (addr_arr_len * 8));
+        if (NULL == param_arr) {
+            pr2serr("out of memory\n");
+            return sg_convert_errno(ENOMEM);
+        }
         k = 4;
         for (j = 0; j < addr_arr_len; ++j) {
             if (eight) {
@@ -399,7 +792,20 @@ main(int argc, char * argv[])
         goto err_out;
     }
 
-    if (got_addr) {
+    if (file_fn) {
+        if (check) {
+            ret = check_lbas(sg_fd, file_arr, &file_arr_len, xfer_len,
+                             xfer_len_given, num_jobs, verbose);
+            if (ret)
+                goto err_out;
+            if (0 == file_arr_len) {
+                printf("No LBAs need reassigning\n");
+                goto err_out;
+            }
+        }
+        ret = reassign_batch(sg_fd, file_arr, file_arr_len, eight, longlist,
+                             batch, dummy, verbose);
+    } else if (got_addr) {
         if (dummy) {
             pr2serr(">>> dummy: REASSIGN BLOCKS not executed\n");
             if (verbose) {
@@ -425,9 +831,9 @@ main(int argc, char * argv[])
         const char * lstp;
 
         param_len = 4;
-        memset(param_arr, 0, param_len);
+        memset(dl_hdr, 0, param_len);
         res = sg_ll_read_defect10(sg_fd, primary, grown, dl_format,
-                                  param_arr, param_len, false, verbose);
+                                  dl_hdr, param_len, false, verbose);
         ret = res;
         if (res) {
             sg_get_category_sense_str(res, sizeof(b), b, verbose);
@@ -435,11 +841,11 @@ main(int argc, char * argv[])
             goto err_out;
         }
         if (do_hex) {
-            hex2stdout(param_arr, param_len, 1);
+            hex2stdout(dl_hdr, param_len, 1);
             goto err_out;       /* ret is zero */
         }
-        got_grown = !!(param_arr[1] & 0x8);
-        got_primary = !!(param_arr[1] & 0x10);
+        got_grown = !!(dl_hdr[1] & 0x8);
+        got_primary = !!(dl_hdr[1] & 0x10);
         if (got_grown && got_primary)
             lstp = "grown and primary defect lists";
         else if (got_grown)
@@ -452,8 +858,8 @@ main(int argc, char * argv[])
         }
         if (verbose)
             pr2serr("asked for defect list format %d, got %d\n", dl_format,
-                    (param_arr[1] & 0x7));
-        dl_format = (param_arr[1] & 0x7);
+                    (dl_hdr[1] & 0x7));
+        dl_format = (dl_hdr[1] & 0x7);
         switch (dl_format) {    /* Defect list formats: */
             case 0:     /* short block */
                 div = 4;
@@ -473,7 +879,7 @@ main(int argc, char * argv[])
                 pr2serr("defect list format %d unknown\n", dl_format);
                 break;
         }
-        dl_len = sg_get_unaligned_be16(param_arr + 2);
+        dl_len = sg_get_unaligned_be16(dl_hdr + 2);
         if (0 == dl_len)
             printf(">> Elements in %s: 0\n", lstp);
         else {
@@ -487,6 +893,9 @@ main(int argc, char * argv[])
     }
 
 err_out:
+    free(addr_arr);
+    free(file_arr);
+    free(param_arr);
     if (sg_fd >= 0) {
         res = sg_cmds_close_device(sg_fd);
         if (res < 0) {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2019 Douglas Gilbert.
+ * Copyright (c) 2014-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -23,6 +23,9 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
 
 #include "sg_lib.h"
 #include "sg_lib_data.h"
@@ -30,15 +33,17 @@
 #include "sg_cmds_basic.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
+#include "sg_json.h"
 
 /* A utility program originally written for the Linux OS SCSI subsystem.
  *
  *
  * This program issues the SCSI REPORT ZONES command to the given SCSI device
  * and decodes the response. Based on zbc-r02.pdf
+ * With --all it builds an index of all the zones on the device.
  */
 
-static const char * version_str = "1.17 20190113";
+static const char * version_str = "1.18 20261014";
 
 #define MAX_RZONES_BUFF_LEN (1024 * 1024)
 #define DEF_RZONES_BUFF_LEN (1024 * 8)
@@ -50,10 +55,25 @@ static const char * version_str = "1.17 20190113";
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT  60      /* 60 seconds */
 
+#define DEF_JOBS 4
+#define MAX_JOBS 256
+
+#define ZI_MAGIC "SGZI"         /* start of binary zone index file */
+#define ZI_VERSION 1
+#define ZI_HDR_LEN 32
+#define ZI_IO_BATCH 512         /* array elements per fread() or fwrite() */
+
 
 static struct option long_options[] = {
+        {"all", no_argument, 0, 'a'},
+        {"bin", required_argument, 0, 'b'},
+        {"csv", required_argument, 0, 'c'},
+        {"find", required_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
+        {"jobs", required_argument, 0, 'j'},
+        {"json", no_argument, 0, 'J'},
+        {"load", required_argument, 0, 'l'},
         {"maxlen", required_argument, 0, 'm'},
         {"partial", no_argument, 0, 'p'},
         {"raw", no_argument, 0, 'r'},
@@ -71,19 +91,45 @@ usage(int h)
 {
     if (h > 1) goto h_twoormore;
     pr2serr("Usage: "
-            "sg_rep_zones  [--help] [--hex] [--maxlen=LEN] [--partial]\n"
-            "                     [--raw] [--readonly] [--report=OPT] "
-            "[--start=LBA]\n"
-            "                     [--verbose] [--version] DEVICE\n");
+            "sg_rep_zones  [--all] [--bin=FN] [--csv=FN] [--find=LBA] "
+            "[--help]\n"
+            "                     [--hex] [--jobs=JOBS] [--json] "
+            "[--load=FN]\n"
+            "                     [--maxlen=LEN] [--partial] [--raw] "
+            "[--readonly]\n"
+            "                     [--report=OPT] [--start=LBA] [--verbose] "
+            "[--version]\n"
+            "                     DEVICE\n");
     pr2serr("  where:\n"
+            "    --all|-a           page through all zones from LBA building "
+            "a zone\n"
+            "                       index, then output a summary of it\n"
+            "    --bin=FN|-b FN     write zone index to FN in binary ('-' "
+            "for stdout)\n"
+            "    --csv=FN|-c FN     write zone index to FN as CSV ('-' for "
+            "stdout)\n"
+            "    --find=LBA|-f LBA    output the zone in the index that "
+            "contains LBA\n"
             "    --help|-h          print out usage message, use twice for "
             "more help\n"
             "    --hex|-H           output response in hexadecimal; used "
             "twice\n"
             "                       shows decoded values in hex\n"
+            "    --jobs=JOBS|-j JOBS    number of concurrent cursors "
+            "building the\n"
+            "                           zone index (def: %d)\n"
+            "    --json|-J          output zones as JSON; use twice to "
+            "pretty print\n"
+            "    --load=FN|-l FN    zone index read from binary file FN "
+            "rather than\n"
+            "                       built from DEVICE\n"
             "    --maxlen=LEN|-m LEN    max response length (allocation "
             "length in cdb)\n"
-            "                           (def: 0 -> 8192 bytes)\n"
+            "                           (def: 0 -> 8192 bytes, %d when "
+            "building\n"
+            "                           zone index)\n", DEF_JOBS,
+            MAX_RZONES_BUFF_LEN);
+    pr2serr(
             "    --partial|-p       sets PARTIAL bit in cdb (def: 0 -> "
             "zone list\n"
             "                       length not altered by allocation length "
@@ -272,40 +318,669 @@ static const char * same_desc_arr[16] = {
     "Reserved [0xc]", "Reserved [0xd]", "Reserved [0xe]", "Reserved [0xf]",
 };
 
+/* Zone index held as a struct of arrays: for a drive with 100k zones this
+ * is about 2.6 MB rather than the 6.4 MB of the zone descriptors. Zones
+ * are in ascending zone start LBA order. */
+struct zone_idx {
+    uint64_t * start;
+    uint64_t * len;
+    uint64_t * wp;
+    uint8_t * type;
+    uint8_t * cond;
+    int64_t num;
+    int64_t max;
+    uint64_t max_lba;
+};
+
+/* Part of the LBA space paged through by one cursor. Only zones that
+ * start in [start_lba, end_lba) are placed in its index. */
+struct rz_seg {
+    uint64_t start_lba;
+    uint64_t end_lba;
+    struct zone_idx zi;
+    int num_cmds;
+};
+
+struct rz_walk {
+    bool do_partial;
+    int sg_fd;
+    int rep_opts;
+    int maxlen;
+    int vb;
+    struct rz_seg * segs;
+    int num_segs;
+    int next_seg;
+    int ret;                    /* first error, stops other cursors */
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static void
+walk_lock(struct rz_walk * wp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&wp->mtx);
+#else
+    if (wp) { ; }  /* suppress warning */
+#endif
+}
+
+static void
+walk_unlock(struct rz_walk * wp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&wp->mtx);
+#else
+    if (wp) { ; }  /* suppress warning */
+#endif
+}
+
+static void
+zi_free(struct zone_idx * zp)
+{
+    free(zp->start);
+    free(zp->len);
+    free(zp->wp);
+    free(zp->type);
+    free(zp->cond);
+    memset(zp, 0, sizeof(*zp));
+}
+
+/* Makes room for at least n zones. Returns 0 or ENOMEM. */
+static int
+zi_reserve(struct zone_idx * zp, int64_t n)
+{
+    void * p;
+
+    if (n <= zp->max)
+        return 0;
+    if (NULL == (p = realloc(zp->start, n * sizeof(uint64_t))))
+        return ENOMEM;
+    zp->start = (uint64_t *)p;
+    if (NULL == (p = realloc(zp->len, n * sizeof(uint64_t))))
+        return ENOMEM;
+    zp->len = (uint64_t *)p;
+    if (NULL == (p = realloc(zp->wp, n * sizeof(uint64_t))))
+        return ENOMEM;
+    zp->wp = (uint64_t *)p;
+    if (NULL == (p = realloc(zp->type, n)))
+        return ENOMEM;
+    zp->type = (uint8_t *)p;
+    if (NULL == (p = realloc(zp->cond, n)))
+        return ENOMEM;
+    zp->cond = (uint8_t *)p;
+    zp->max = n;
+    return 0;
+}
+
+/* Appends the zones described by the 'n' 64 byte zone descriptors at bp,
+ * each field is extracted for all of them in one pass */
+static int
+zi_add_descs(struct zone_idx * zp, const uint8_t * bp, int n)
+{
+    int j;
+    int64_t k = zp->num;
+    int64_t want = zp->max ? (2 * zp->max) : 1024;
+
+    if ((k + n) > zp->max) {
+        if (want < (k + n))
+            want = k + n;
+        if (zi_reserve(zp, want))
+            return ENOMEM;
+    }
+    sg_get_unaligned_be64_arr(bp + 8, 64, n, zp->len + k);
+    sg_get_unaligned_be64_arr(bp + 16, 64, n, zp->start + k);
+    sg_get_unaligned_be64_arr(bp + 24, 64, n, zp->wp + k);
+    for (j = 0; j < n; ++j, bp += 64) {
+        zp->type[k + j] = bp[0] & 0xf;
+        zp->cond[k + j] = (bp[1] >> 4) & 0xf;
+    }
+    zp->num = k + n;
+    return 0;
+}
+
+/* Removes the 'n' zones from index k onwards */
+static void
+zi_cut(struct zone_idx * zp, int64_t k, int64_t n)
+{
+    int64_t rest = zp->num - (k + n);
+
+    memmove(zp->start + k, zp->start + k + n, rest * sizeof(uint64_t));
+    memmove(zp->len + k, zp->len + k + n, rest * sizeof(uint64_t));
+    memmove(zp->wp + k, zp->wp + k + n, rest * sizeof(uint64_t));
+    memmove(zp->type + k, zp->type + k + n, rest);
+    memmove(zp->cond + k, zp->cond + k + n, rest);
+    zp->num -= n;
+}
+
+/* Returns index of zone containing lba, or -1 if there is none */
+static int64_t
+zi_find(const struct zone_idx * zp, uint64_t lba)
+{
+    int64_t lo = 0;
+    int64_t hi = zp->num - 1;
+    int64_t mid;
+
+    while (lo <= hi) {
+        mid = lo + ((hi - lo) / 2);
+        if (lba < zp->start[mid])
+            hi = mid - 1;
+        else if (lba >= (zp->start[mid] + zp->len[mid]))
+            lo = mid + 1;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+/* Pages through the segment with REPORT ZONES commands, each starting at
+ * the end of the last zone in the previous response. */
+static int
+walk_seg(struct rz_walk * wp, struct rz_seg * sp, uint8_t * buff)
+{
+    int k, res, resid, rlen, zones;
+    int64_t j, first;
+    uint64_t prev;
+    uint64_t cur = sp->start_lba;
+    struct zone_idx * zp = &sp->zi;
+
+    while (cur < sp->end_lba) {
+        if (wp->ret)
+            return 0;   /* another cursor failed */
+        res = sg_ll_report_zones(wp->sg_fd, cur, wp->do_partial,
+                                 wp->rep_opts, buff, wp->maxlen, &resid,
+                                 true, wp->vb);
+        if (res)
+            return res;
+        ++sp->num_cmds;
+        rlen = wp->maxlen - resid;
+        if (rlen < 64)
+            return SG_LIB_CAT_MALFORMED;
+        k = sg_get_unaligned_be32(buff + 0) + 64;
+        if (k < rlen)
+            rlen = k;
+        zones = (rlen - 64) / 64;
+        if (0 == zones)
+            break;      /* no (more) zones match the reporting options */
+        prev = cur;
+        first = zp->num;
+        if (zi_add_descs(zp, buff + 64, zones))
+            return sg_convert_errno(ENOMEM);
+        for (j = first; j < zp->num; ++j) {
+            if (zp->start[j] >= sp->end_lba) {
+                cur = sp->end_lba;
+                break;
+            }
+            cur = zp->start[j] + zp->len[j];
+        }
+        zp->num = j;    /* those from end_lba belong to the next segment */
+        for (j = first; (j < zp->num) && (zp->start[j] < sp->start_lba); ++j)
+            ;
+        if (j > first)  /* and those before start_lba to the previous one */
+            zi_cut(zp, first, j - first);
+        if (cur <= prev) {
+            pr2serr("REPORT ZONES from LBA 0x%" PRIx64 " made no "
+                    "progress\n", prev);
+            return SG_LIB_CAT_MALFORMED;
+        }
+    }
+    return 0;
+}
+
+static void *
+walk_worker(void * v_wp)
+{
+    int k, res;
+    uint8_t * buff;
+    uint8_t * free_buff = NULL;
+    struct rz_walk * wp = (struct rz_walk *)v_wp;
+
+    buff = (uint8_t *)sg_memalign(wp->maxlen, 0, &free_buff, false);
+    if (NULL == buff) {
+        walk_lock(wp);
+        if (0 == wp->ret)
+            wp->ret = sg_convert_errno(ENOMEM);
+        walk_unlock(wp);
+        return NULL;
+    }
+    while (true) {
+        walk_lock(wp);
+        k = (wp->ret) ? wp->num_segs : wp->next_seg++;
+        walk_unlock(wp);
+        if (k >= wp->num_segs)
+            break;
+        res = walk_seg(wp, wp->segs + k, buff);
+        if (res) {
+            walk_lock(wp);
+            if (0 == wp->ret)
+                wp->ret = res;
+            walk_unlock(wp);
+        }
+    }
+    free(free_buff);
+    return NULL;
+}
+
+/* Builds the index of all zones from the one containing st_lba to the end
+ * of DEVICE, splitting the LBA range across num_jobs concurrent cursors.
+ * Returns 0 or an error. */
+static int
+build_zone_idx(struct rz_walk * wp, uint64_t st_lba, int num_jobs,
+               struct zone_idx * zp)
+{
+    int k, res, resid;
+    int num_cmds = 0;
+    int64_t n;
+    uint64_t first, per;
+    uint8_t probe[128];
+    struct rz_seg * sp;
+#ifndef SG_LIB_WIN32
+    int err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    /* one zone (of any kind) to find the maximum LBA and where the zone
+     * containing st_lba starts */
+    res = sg_ll_report_zones(wp->sg_fd, st_lba, false, 0, probe,
+                             sizeof(probe), &resid, true, wp->vb);
+    if (res)
+        return res;
+    if ((int)sizeof(probe) - resid < 128) {
+        pr2serr("No zone found at LBA 0x%" PRIx64 "\n", st_lba);
+        return SG_LIB_CAT_MALFORMED;
+    }
+    zp->max_lba = sg_get_unaligned_be64(probe + 8);
+    first = sg_get_unaligned_be64(probe + 64 + 16);
+    if (first > st_lba)
+        first = st_lba;
+    if (first > zp->max_lba)
+        return 0;
+    n = (int64_t)(zp->max_lba - first + 1);
+    wp->num_segs = (n < num_jobs) ? (int)n : num_jobs;
+    wp->segs = (struct rz_seg *)calloc(wp->num_segs, sizeof(*sp));
+    if (NULL == wp->segs)
+        return sg_convert_errno(ENOMEM);
+    per = (uint64_t)n / wp->num_segs;
+    for (k = 0, sp = wp->segs; k < wp->num_segs; ++k, ++sp) {
+        sp->start_lba = first + (k * per);
+        sp->end_lba = (k == (wp->num_segs - 1)) ? (zp->max_lba + 1) :
+                                                  (sp->start_lba + per);
+    }
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&wp->mtx, NULL);
+    for (k = 1; k < wp->num_segs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, walk_worker, wp))) {
+            if (wp->vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    walk_worker(wp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&wp->mtx);
+#else
+    walk_worker(wp);
+#endif
+    if (0 == wp->ret) {
+        /* segments are in LBA order so concatenate their indexes */
+        for (k = 0, n = 0; k < wp->num_segs; ++k)
+            n += wp->segs[k].zi.num;
+        if (zi_reserve(zp, n ? n : 1))
+            wp->ret = sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, sp = wp->segs; k < wp->num_segs; ++k, ++sp) {
+        if (0 == wp->ret) {
+            n = sp->zi.num;
+            memcpy(zp->start + zp->num, sp->zi.start, n * sizeof(uint64_t));
+            memcpy(zp->len + zp->num, sp->zi.len, n * sizeof(uint64_t));
+            memcpy(zp->wp + zp->num, sp->zi.wp, n * sizeof(uint64_t));
+            memcpy(zp->type + zp->num, sp->zi.type, n);
+            memcpy(zp->cond + zp->num, sp->zi.cond, n);
+            zp->num += n;
+        }
+        num_cmds += sp->num_cmds;
+        zi_free(&sp->zi);
+    }
+    if (wp->vb)
+        pr2serr("%d REPORT ZONES commands from %d cursors\n", num_cmds,
+                wp->num_segs);
+    free(wp->segs);
+    wp->segs = NULL;
+    return wp->ret;
+}
+
+/* Binary zone index file: a 32 byte header (ZI_MAGIC, big endian format
+ * version, number of zones and maximum LBA) followed by the start, length
+ * and write pointer arrays (each element 8 bytes, big endian) then the
+ * type and condition arrays (each element 1 byte). */
+static int
+zi_write_bin(const struct zone_idx * zp, const char * fn)
+{
+    int k, n, err = 0;
+    int64_t j;
+    uint8_t hdr[ZI_HDR_LEN];
+    uint8_t b8[8 * ZI_IO_BATCH];
+    const uint64_t * arrs[3];
+    FILE * fp;
+
+    fp = (0 == strcmp("-", fn)) ? stdout : fopen(fn, "wb");
+    if (NULL == fp) {
+        err = errno;
+        pr2serr("unable to open %s: %s\n", fn, safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, ZI_MAGIC, 4);
+    sg_put_unaligned_be32(ZI_VERSION, hdr + 4);
+    sg_put_unaligned_be64((uint64_t)zp->num, hdr + 8);
+    sg_put_unaligned_be64(zp->max_lba, hdr + 16);
+    if (1 != fwrite(hdr, sizeof(hdr), 1, fp))
+        err = errno;
+    arrs[0] = zp->start;
+    arrs[1] = zp->len;
+    arrs[2] = zp->wp;
+    for (k = 0; (0 == err) && (k < 3); ++k) {
+        for (j = 0; j < zp->num; j += n) {
+            n = ((zp->num - j) > ZI_IO_BATCH) ? ZI_IO_BATCH :
+                                                (int)(zp->num - j);
+            sg_put_unaligned_be64_arr(arrs[k] + j, n, b8);
+            if (1 != fwrite(b8, 8 * n, 1, fp)) {
+                err = errno;
+                break;
+            }
+        }
+    }
+    if (zp->num && (0 == err)) {
+        if ((1 != fwrite(zp->type, zp->num, 1, fp)) ||
+            (1 != fwrite(zp->cond, zp->num, 1, fp)))
+            err = errno;
+    }
+    if ((stdout != fp) && fclose(fp) && (0 == err))
+        err = errno;
+    if (err) {
+        pr2serr("write error on %s: %s\n", fn, safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    return 0;
+}
+
+/* Reads a binary zone index file written by zi_write_bin() */
+static int
+zi_read_bin(struct zone_idx * zp, const char * fn)
+{
+    int k, m, ret = 0;
+    int64_t j, n;
+    uint8_t hdr[ZI_HDR_LEN];
+    uint8_t b8[8 * ZI_IO_BATCH];
+    uint64_t * arrs[3];
+    FILE * fp;
+
+    fp = fopen(fn, "rb");
+    if (NULL == fp) {
+        ret = errno;
+        pr2serr("unable to open %s: %s\n", fn, safe_strerror(ret));
+        return sg_convert_errno(ret);
+    }
+    if ((1 != fread(hdr, sizeof(hdr), 1, fp)) ||
+        memcmp(hdr, ZI_MAGIC, 4) ||
+        (ZI_VERSION != sg_get_unaligned_be32(hdr + 4))) {
+        pr2serr("%s is not a zone index file\n", fn);
+        ret = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    n = (int64_t)sg_get_unaligned_be64(hdr + 8);
+    zp->max_lba = sg_get_unaligned_be64(hdr + 16);
+    if ((n < 0) || zi_reserve(zp, n ? n : 1)) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    arrs[0] = zp->start;
+    arrs[1] = zp->len;
+    arrs[2] = zp->wp;
+    for (k = 0; k < 3; ++k) {
+        for (j = 0; j < n; j += m) {
+            m = ((n - j) > ZI_IO_BATCH) ? ZI_IO_BATCH : (int)(n - j);
+            if (1 != fread(b8, 8 * m, 1, fp))
+                goto short_file;
+            sg_get_unaligned_be64_arr(b8, 8, m, arrs[k] + j);
+        }
+    }
+    if (n && ((1 != fread(zp->type, n, 1, fp)) ||
+              (1 != fread(zp->cond, n, 1, fp))))
+        goto short_file;
+    zp->num = n;
+    goto fini;
+short_file:
+    pr2serr("%s: zone index file is truncated\n", fn);
+    ret = SG_LIB_FILE_ERROR;
+fini:
+    fclose(fp);
+    return ret;
+}
+
+static int
+zi_write_csv(const struct zone_idx * zp, const char * fn)
+{
+    int err = 0;
+    int64_t j;
+    FILE * fp;
+
+    fp = (0 == strcmp("-", fn)) ? stdout : fopen(fn, "w");
+    if (NULL == fp) {
+        err = errno;
+        pr2serr("unable to open %s: %s\n", fn, safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    fprintf(fp, "start_lba,length,write_pointer,type,condition\n");
+    for (j = 0; j < zp->num; ++j) {
+        if (fprintf(fp, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%u,%u\n",
+                    zp->start[j], zp->len[j], zp->wp[j], zp->type[j],
+                    zp->cond[j]) < 0) {
+            err = errno;
+            break;
+        }
+    }
+    if ((stdout != fp) && fclose(fp) && (0 == err))
+        err = errno;
+    if (err) {
+        pr2serr("write error on %s: %s\n", fn, safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    return 0;
+}
+
+/* Counts of zones by type and by condition */
+static void
+zi_summary(const struct zone_idx * zp, FILE * fp, int vb)
+{
+    int k;
+    int64_t j;
+    int64_t by_type[16];
+    int64_t by_cond[16];
+    char b[80];
+
+    memset(by_type, 0, sizeof(by_type));
+    memset(by_cond, 0, sizeof(by_cond));
+    for (j = 0; j < zp->num; ++j) {
+        ++by_type[zp->type[j]];
+        ++by_cond[zp->cond[j]];
+    }
+    fprintf(fp, "Zone index: %" PRId64 " zones, maximum LBA: 0x%" PRIx64
+            "\n", zp->num, zp->max_lba);
+    for (k = 0; k < 16; ++k) {
+        if (by_type[k])
+            fprintf(fp, "  %s: %" PRId64 "\n",
+                    zone_type_str(k, b, sizeof(b), vb), by_type[k]);
+    }
+    for (k = 0; k < 16; ++k) {
+        if (by_cond[k])
+            fprintf(fp, "  Condition %s: %" PRId64 "\n",
+                    zone_condition_str(k, b, sizeof(b), vb), by_cond[k]);
+    }
+}
+
+
+/* One zone as a JSON object. The index does not keep the Non_seq and
+ * Reset bits, so they are only output when flags is not -1. */
+static void
+zone_json(struct sgj_state * jsp, int64_t k, int zt, int zc, int flags,
+          uint64_t len, uint64_t start, uint64_t wp, int vb)
+{
+    char b[80];
+
+    sgj_begin_obj(jsp, NULL);
+    sgj_add_int(jsp, "zone_index", k);
+    sgj_add_uint(jsp, "zone_type", zt);
+    sgj_add_str(jsp, "zone_type_name", zone_type_str(zt, b, sizeof(b), vb));
+    sgj_add_uint(jsp, "zone_condition", zc);
+    sgj_add_str(jsp, "zone_condition_name",
+                zone_condition_str(zc, b, sizeof(b), vb));
+    if (flags >= 0) {
+        sgj_add_bool(jsp, "non_seq", flags & 0x2);
+        sgj_add_bool(jsp, "reset", flags & 0x1);
+    }
+    sgj_add_uint(jsp, "zone_length", len);
+    sgj_add_uint(jsp, "zone_start_lba", start);
+    sgj_add_uint(jsp, "write_pointer_lba", wp);
+    sgj_end_obj(jsp);
+}
+
+/* The index modes: --all, --bin=, --csv=, --find= and --load= */
+static int
+zone_idx_mode(const char * device_name, const char * load_fn,
+              const char * bin_fn, const char * csv_fn, bool find_given,
+              uint64_t find_lba, struct rz_walk * wp, uint64_t st_lba,
+              int num_jobs, struct sgj_state * jsp)
+{
+    int ret;
+    int64_t k;
+    struct zone_idx a_zi;
+    char b[80];
+
+    memset(&a_zi, 0, sizeof(a_zi));
+    if (load_fn)
+        ret = zi_read_bin(&a_zi, load_fn);
+    else
+        ret = build_zone_idx(wp, st_lba, num_jobs, &a_zi);
+    if (ret) {
+        if ((NULL == load_fn) && (SG_LIB_CAT_INVALID_OP != ret)) {
+            sg_get_category_sense_str(ret, sizeof(b), b, wp->vb);
+            pr2serr("Building zone index of %s: %s\n", device_name, b);
+        } else if (SG_LIB_CAT_INVALID_OP == ret)
+            pr2serr("Report zones command not supported\n");
+        goto fini;
+    }
+    if (bin_fn && (ret = zi_write_bin(&a_zi, bin_fn)))
+        goto fini;
+    if (csv_fn && (ret = zi_write_csv(&a_zi, csv_fn)))
+        goto fini;
+    if (find_given) {
+        k = zi_find(&a_zi, find_lba);
+        if (k < 0) {
+            pr2serr("LBA 0x%" PRIx64 " is not in any zone of the index\n",
+                    find_lba);
+            ret = SG_LIB_LBA_OUT_OF_RANGE;
+            goto fini;
+        }
+        if (jsp) {
+            zone_json(jsp, k, a_zi.type[k], a_zi.cond[k], -1, a_zi.len[k],
+                      a_zi.start[k], a_zi.wp[k], wp->vb);
+            goto fini;
+        }
+        printf(" Zone index: %" PRId64 "\n", k);
+        printf("   Zone type: %s\n", zone_type_str(a_zi.type[k], b,
+               sizeof(b), wp->vb));
+        printf("   Zone condition: %s\n", zone_condition_str(a_zi.cond[k],
+               b, sizeof(b), wp->vb));
+        printf("   Zone Length: 0x%" PRIx64 "\n", a_zi.len[k]);
+        printf("   Zone start LBA: 0x%" PRIx64 "\n", a_zi.start[k]);
+        printf("   Write pointer LBA: 0x%" PRIx64 "\n", a_zi.wp[k]);
+    } else if (jsp) {
+        sgj_begin_obj(jsp, NULL);
+        sgj_add_str(jsp, "device", device_name);
+        sgj_add_uint(jsp, "maximum_lba", a_zi.max_lba);
+        sgj_add_int(jsp, "number_of_zones", a_zi.num);
+        sgj_begin_arr(jsp, "zones");
+        for (k = 0; k < a_zi.num; ++k)
+            zone_json(jsp, k, a_zi.type[k], a_zi.cond[k], -1, a_zi.len[k],
+                      a_zi.start[k], a_zi.wp[k], wp->vb);
+        sgj_end_arr(jsp);
+        sgj_end_obj(jsp);
+    } else if ((NULL == bin_fn) && (NULL == csv_fn))
+        zi_summary(&a_zi, stdout, wp->vb);
+    else if (wp->vb)
+        zi_summary(&a_zi, stderr, wp->vb);
+fini:
+    zi_free(&a_zi);
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
 {
+    bool do_all = false;
     bool do_partial = false;
     bool do_raw = false;
     bool o_readonly = false;
     bool verbose_given = false;
     bool version_given = false;
+    bool find_given = false;
     int k, res, c, zl_len, len, zones, resid, rlen, zt, zc, same;
     int sg_fd = -1;
     int do_help = 0;
     int do_hex = 0;
+    int do_json = 0;
     int maxlen = 0;
+    int num_jobs = DEF_JOBS;
     int reporting_opt = 0;
     int ret = 0;
     int verbose = 0;
     uint64_t st_lba = 0;
+    uint64_t find_lba = 0;
     int64_t ll;
     const char * device_name = NULL;
+    const char * bin_fn = NULL;
+    const char * csv_fn = NULL;
+    const char * load_fn = NULL;
     uint8_t * reportZonesBuff = NULL;
     uint8_t * free_rzbp = NULL;
     uint8_t * bp;
+    struct rz_walk a_walk;
+    struct sgj_state json_st;
+    struct sgj_state * jsp = NULL;
     char b[80];
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hHm:o:prRs:vV", long_options,
+        c = getopt_long(argc, argv, "ab:c:f:hHj:Jl:m:o:prRs:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'a':
+            do_all = true;
+            break;
+        case 'b':
+            bin_fn = optarg;
+            break;
+        case 'c':
+            csv_fn = optarg;
+            break;
+        case 'f':
+            ll = sg_get_llnum(optarg);
+            if (-1 == ll) {
+                pr2serr("bad argument to '--find=LBA'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            find_lba = (uint64_t)ll;
+            find_given = true;
+            break;
         case 'h':
         case '?':
             ++do_help;
@@ -313,6 +988,20 @@ main(int argc, char * argv[])
         case 'H':
             ++do_hex;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs' should be from 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'J':
+            ++do_json;
+            break;
+        case 'l':
+            load_fn = optarg;
+            break;
         case 'm':
             maxlen = sg_get_num(optarg);
             if ((maxlen < 0) || (maxlen > MAX_RZONES_BUFF_LEN)) {
@@ -396,10 +1085,41 @@ main(int argc, char * argv[])
         usage(do_help);
         return 0;
     }
+    if (do_json) {
+        if (bin_fn || csv_fn || do_hex || do_raw) {
+            pr2serr("--json cannot be used with --bin=, --csv=, --hex or "
+                    "--raw\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if ((ret = sgj_init(&json_st, STDOUT_FILENO, do_json > 1)))
+            return sg_convert_errno(ret);
+        jsp = &json_st;
+    }
+    if (bin_fn || csv_fn || find_given || load_fn)
+        do_all = true;
+    memset(&a_walk, 0, sizeof(a_walk));
+    a_walk.vb = verbose;
+    if (load_fn) {
+        if (device_name) {
+            pr2serr("ignoring DEVICE, best to give DEVICE or --load=FN, "
+                    "but not both\n");
+            device_name = NULL;
+        }
+        if (bin_fn && (0 != strcmp("-", bin_fn)) &&
+            (0 == strcmp(load_fn, bin_fn))) {
+            pr2serr("--load=FN and --bin=FN cannot be the same file\n");
+            ret = SG_LIB_CONTRADICT;
+            goto the_end;
+        }
+        ret = zone_idx_mode(load_fn, load_fn, bin_fn, csv_fn, find_given,
+                            find_lba, &a_walk, 0, 0, jsp);
+        goto the_end;
+    }
     if (NULL == device_name) {
         pr2serr("missing device name!\n");
         usage(1);
-        return SG_LIB_SYNTAX_ERROR;
+        ret = SG_LIB_SYNTAX_ERROR;
+        goto the_end;
     }
 
     if (do_raw) {
@@ -418,13 +1138,30 @@ main(int argc, char * argv[])
         goto the_end;
     }
 
+    if (do_all) {
+        a_walk.do_partial = do_partial;
+        a_walk.sg_fd = sg_fd;
+        a_walk.rep_opts = reporting_opt;
+        a_walk.maxlen = maxlen ? maxlen : MAX_RZONES_BUFF_LEN;
+        if (a_walk.maxlen < 128) {
+            pr2serr("--maxlen=LEN needs to be at least 128 to build a zone "
+                    "index\n");
+            ret = SG_LIB_SYNTAX_ERROR;
+            goto the_end;
+        }
+        ret = zone_idx_mode(device_name, NULL, bin_fn, csv_fn,
+                            find_given, find_lba, &a_walk, st_lba, num_jobs,
+                            jsp);
+        goto the_end;
+    }
     if (0 == maxlen)
         maxlen = DEF_RZONES_BUFF_LEN;
     reportZonesBuff = (uint8_t *)sg_memalign(maxlen, 0, &free_rzbp,
                                              verbose > 3);
     if (NULL == reportZonesBuff) {
         pr2serr("unable to sg_memalign %d bytes\n", maxlen);
-        return sg_convert_errno(ENOMEM);
+        ret = sg_convert_errno(ENOMEM);
+        goto the_end;
     }
 
     res = sg_ll_report_zones(sg_fd, st_lba, do_partial, reporting_opt,
@@ -454,7 +1191,6 @@ main(int argc, char * argv[])
                     ((1 == do_hex) ? 1 : -1));
             goto the_end;
         }
-        printf("Report zones response:\n");
         if (len < 64) {
             pr2serr("Zone length [%d] too short (perhaps after truncation\n)",
                     len);
@@ -462,10 +1198,29 @@ main(int argc, char * argv[])
             goto the_end;
         }
         same = reportZonesBuff[4] & 0xf;
+        zones = (len - 64) / 64;
+        if (jsp) {
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_str(jsp, "device", device_name);
+            sgj_add_uint(jsp, "same", same);
+            sgj_add_str(jsp, "same_name", same_desc_arr[same]);
+            sgj_add_uint(jsp, "maximum_lba",
+                         sg_get_unaligned_be64(reportZonesBuff + 8));
+            sgj_add_bool(jsp, "truncated", (64 + (64 * zones)) < zl_len);
+            sgj_begin_arr(jsp, "zones");
+            for (k = 0, bp = reportZonesBuff + 64; k < zones; ++k, bp += 64)
+                zone_json(jsp, k, bp[0] & 0xf, (bp[1] >> 4) & 0xf,
+                          bp[1] & 0x3, sg_get_unaligned_be64(bp + 8),
+                          sg_get_unaligned_be64(bp + 16),
+                          sg_get_unaligned_be64(bp + 24), verbose);
+            sgj_end_arr(jsp);
+            sgj_end_obj(jsp);
+            goto the_end;
+        }
+        printf("Report zones response:\n");
         printf("  Same=%d: %s\n\n", same, same_desc_arr[same]);
         printf("  Maximum LBA: 0x%" PRIx64 "\n",
                sg_get_unaligned_be64(reportZonesBuff + 8));
-        zones = (len - 64) / 64;
         for (k = 0, bp = reportZonesBuff + 64; k < zones; ++k, bp += 64) {
             printf(" Zone descriptor: %d\n", k);
             if (do_hex) {
@@ -498,6 +1253,8 @@ main(int argc, char * argv[])
     }
 
 the_end:
+    if (jsp && sgj_fini(jsp) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
     if (free_rzbp)
         free(free_rzbp);
     if (sg_fd >= 0) {
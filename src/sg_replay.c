@@ -0,0 +1,792 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_cmds_basic.h"
+#include "sg_pt.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+/*
+ * This program replays a trace of pass-through commands, as captured by
+ * the sg3_utils library when the SG3_UTILS_PT_TRACE environment variable
+ * names a trace file, against a device. Each command is resubmitted with
+ * its original cdb and data lengths, either keeping the original timing
+ * between commands or as fast as possible, with up to a given number of
+ * commands in flight. The SCSI status and sense key of each command are
+ * compared with those recorded and a latency summary is output. The trace
+ * can also be decoded to text.
+ */
+
+static const char * version_str = "1.00 20261014";
+
+#define DEF_PT_TIMEOUT 60       /* 60 seconds */
+#define DEF_QUEUE_DEPTH 16
+#define MAX_QUEUE_DEPTH 256
+#define SENSE_BUFF_LEN 64
+#define RDR_BUFF_LEN (64 * 1024)
+#define TIMED_POLL_NS 50000     /* poll completions this often while timing */
+
+
+static struct option long_options[] = {
+        {"asap", no_argument, 0, 'a'},
+        {"count", required_argument, 0, 'c'},
+        {"dev", required_argument, 0, 'D'},
+        {"dump", no_argument, 0, 'd'},
+        {"force", no_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {"in", required_argument, 0, 'i'},
+        {"qd", required_argument, 0, 'q'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {0, 0, 0, 0},
+};
+
+struct opts_t {
+    bool asap;
+    bool do_dump;
+    bool do_force;
+    int dev_fd;         /* -1 -> all records, else only those with dev_fd */
+    int qd;
+    int verbose;
+    int64_t count;      /* 0 -> no limit */
+    const char * in_fn;
+    const char * device_name;
+};
+
+/* Sequential reader of a trace file */
+struct rdr_t {
+    FILE * fp;
+    int len;            /* valid bytes in buf */
+    int off;            /* next record starts at buf + off */
+    uint8_t buf[RDR_BUFF_LEN];
+};
+
+/* What a pass over the trace found */
+struct scan_t {
+    uint64_t recs;      /* matching the --dev= filter, up to --count= */
+    uint64_t writes;    /* of those, with data-out */
+    uint64_t nvme;      /* of those, NVMe commands */
+    uint64_t first_ns;
+    uint64_t last_ns;   /* end of last command */
+};
+
+struct slot_t {
+    bool busy;
+    uint32_t buff_len;
+    uint64_t start_ns;
+    uint8_t * buffp;
+    struct sg_pt_base * ptvp;
+    struct sg_pt_trace_rec rec;
+    uint8_t sense[SENSE_BUFF_LEN];
+};
+
+struct stats_t {
+    int first_err;
+    uint64_t cmds;      /* completed, whatever their status */
+    uint64_t errs;      /* not completed by the device */
+    uint64_t skipped;
+    uint64_t mismatches;
+    uint64_t lat_min_ns;
+    uint64_t lat_max_ns;
+    uint64_t lat_sum_ns;
+    uint64_t rec_lat_max_ns;
+    uint64_t rec_lat_sum_ns;
+};
+
+static volatile sig_atomic_t replay_stop;       /* set by SIGINT */
+
+
+static void
+usage()
+{
+    pr2serr("Usage: sg_replay [--asap] [--count=CNT] [--dev=FD] [--dump] "
+            "[--force]\n"
+            "                 [--help] --in=TF [--qd=QD] [--verbose] "
+            "[--version]\n"
+            "                 [DEVICE]\n"
+            "  where:\n"
+            "    --asap|-a          submit commands as fast as possible "
+            "(def: keep\n"
+            "                       the timing recorded in the trace)\n"
+            "    --count=CNT|-c CNT    replay (or dump) at most CNT "
+            "commands (def: 0\n"
+            "                          -> all)\n"
+            "    --dev=FD|-D FD     only commands recorded on file "
+            "descriptor FD (def:\n"
+            "                       all)\n"
+            "    --dump|-d          decode the trace to stdout, DEVICE not "
+            "needed\n"
+            "    --force|-f         needed when the trace holds commands "
+            "with data-out\n"
+            "                       (e.g. WRITE) which would overwrite "
+            "data\n"
+            "    --help|-h          print out usage message then exit\n"
+            "    --in=TF|-i TF      TF is the trace file (made with "
+            "SG3_UTILS_PT_TRACE)\n"
+            "    --qd=QD|-q QD      maximum commands in flight (def: %d, "
+            "max: %d)\n"
+            "    --verbose|-v       increase verbosity\n"
+            "    --version|-V       print version string and exit\n\n"
+            "Replays the commands in trace file TF against DEVICE, then "
+            "reports status\nmismatches against the trace and latency. "
+            "Data-out is sent as zeros.\n", DEF_QUEUE_DEPTH, MAX_QUEUE_DEPTH);
+}
+
+static void
+sigint_handler(int sig)
+{
+    if (SIGINT == sig)
+        replay_stop = 1;
+}
+
+/* Opens the trace file and checks its header. Returns 0 on success. */
+static int
+rdr_open(struct rdr_t * rp, const char * fname)
+{
+    rp->len = 0;
+    rp->off = 0;
+    rp->fp = fopen(fname, "rb");
+    if (NULL == rp->fp) {
+        pr2serr("unable to open %s: %s\n", fname, safe_strerror(errno));
+        return sg_convert_errno(errno);
+    }
+    rp->len = fread(rp->buf, 1, SG_PT_TRACE_HDR_LEN, rp->fp);
+    if (sg_pt_trace_check_hdr(rp->buf, rp->len)) {
+        pr2serr("%s is not a sg3_utils pass-through trace file\n", fname);
+        fclose(rp->fp);
+        rp->fp = NULL;
+        return SG_LIB_FILE_ERROR;
+    }
+    rp->len = 0;
+    return 0;
+}
+
+/* Back to the first record */
+static void
+rdr_rewind(struct rdr_t * rp)
+{
+    fseek(rp->fp, SG_PT_TRACE_HDR_LEN, SEEK_SET);
+    rp->len = 0;
+    rp->off = 0;
+}
+
+/* Returns 1 with the next record in *trp, 0 at the end of the trace, or
+ * -1 if the trace is malformed (or truncated mid record). */
+static int
+rdr_next(struct rdr_t * rp, struct sg_pt_trace_rec * trp)
+{
+    int n;
+    size_t got;
+
+    while (true) {
+        n = sg_pt_trace_decode(rp->buf + rp->off, rp->len - rp->off, trp);
+        if (n > 0) {
+            rp->off += n;
+            return 1;
+        } else if (n < 0)
+            return -1;
+        if (rp->off > 0) {
+            memmove(rp->buf, rp->buf + rp->off, rp->len - rp->off);
+            rp->len -= rp->off;
+            rp->off = 0;
+        }
+        got = fread(rp->buf + rp->len, 1, RDR_BUFF_LEN - rp->len, rp->fp);
+        if (0 == got)
+            return (0 == rp->len) ? 0 : -1;
+        rp->len += got;
+    }
+}
+
+/* Returns 1, 0 or -1 as for rdr_next() but skips records not selected by
+ * the --dev= option. */
+static int
+next_rec(struct rdr_t * rp, const struct opts_t * op,
+         struct sg_pt_trace_rec * trp)
+{
+    int res;
+
+    while (true) {
+        res = rdr_next(rp, trp);
+        if ((res <= 0) || (op->dev_fd < 0) || (op->dev_fd == trp->dev_fd))
+            return res;
+    }
+}
+
+static int
+scan_trace(struct rdr_t * rp, const struct opts_t * op, struct scan_t * scp)
+{
+    int res;
+    uint64_t end_ns;
+    struct sg_pt_trace_rec rec;
+
+    memset(scp, 0, sizeof(*scp));
+    while ((0 == op->count) || ((int64_t)scp->recs < op->count)) {
+        res = next_rec(rp, op, &rec);
+        if (res <= 0) {
+            if (res < 0) {
+                pr2serr("%s: malformed record after %" PRIu64 " records\n",
+                        op->in_fn, scp->recs);
+                return SG_LIB_FILE_ERROR;
+            }
+            break;
+        }
+        if (0 == scp->recs++)
+            scp->first_ns = rec.start_ns;
+        if (rec.dout_len > 0)
+            ++scp->writes;
+        if (rec.flags & SG_PT_TRACE_F_NVME)
+            ++scp->nvme;
+        end_ns = rec.start_ns + rec.dur_ns;
+        if (end_ns > scp->last_ns)
+            scp->last_ns = end_ns;
+    }
+    rdr_rewind(rp);
+    return 0;
+}
+
+static void
+rec_name(const struct sg_pt_trace_rec * trp, int blen, char * b)
+{
+    if (trp->flags & SG_PT_TRACE_F_NVME)
+        snprintf(b, blen, "NVMe opcode=0x%x", trp->cdb[0]);
+    else
+        sg_get_command_name(trp->cdb, 0, blen, b);
+}
+
+/* Outputs one line per record (plus the cdb in hex when verbose) */
+static int
+dump_trace(struct rdr_t * rp, const struct opts_t * op)
+{
+    int k, res;
+    uint64_t n;
+    struct sg_pt_trace_rec rec;
+    char b[80];
+    char e[80];
+
+    printf("       #   start(sec)   dur(usec)  dev_fd   din_len  dout_len  "
+           "status  command\n");
+    for (n = 0; (0 == op->count) || ((int64_t)n < op->count); ++n) {
+        res = next_rec(rp, op, &rec);
+        if (res <= 0) {
+            if (res < 0) {
+                pr2serr("%s: malformed record after %" PRIu64 " records\n",
+                        op->in_fn, n);
+                return SG_LIB_FILE_ERROR;
+            }
+            break;
+        }
+        rec_name(&rec, sizeof(b), b);
+        printf("%8" PRIu64 " %12.6f %11.1f  %6d  %8d  %8d    0x%02x  %s\n",
+               n, rec.start_ns / 1000000000.0, rec.dur_ns / 1000.0,
+               rec.dev_fd, rec.din_len, rec.dout_len, rec.status, b);
+        if ((! (rec.flags & SG_PT_TRACE_F_NVME)) && rec.sense_key) {
+            sg_get_sense_key_str(rec.sense_key, sizeof(b), b);
+            sg_get_asc_ascq_str(rec.asc, rec.ascq, sizeof(e), e);
+            printf("%10s sense: %s; %s\n", "", b, e);
+        }
+        if (op->verbose) {
+            printf("%10s cdb:", "");
+            for (k = 0; k < rec.cdb_len; ++k)
+                printf(" %02x", rec.cdb[k]);
+            printf("\n");
+        }
+    }
+    return 0;
+}
+
+static void
+sleep_ns(uint64_t ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    nanosleep(&ts, NULL);
+}
+
+/* Submits the command in trp on slot sp. Returns 0 on success, else the
+ * value from do_scsi_pt_submit() or a negated errno. */
+static int
+submit_rec(struct slot_t * sp, const struct sg_pt_trace_rec * trp, int sg_fd,
+           int pack_id, int verbose)
+{
+    int need = (trp->din_len > trp->dout_len) ? trp->din_len : trp->dout_len;
+    int res;
+
+    if ((trp->din_len < 0) || (trp->dout_len < 0))
+        return -EINVAL;
+    if ((uint32_t)need > sp->buff_len) {
+        if (sp->buffp)
+            free(sp->buffp);
+        sp->buff_len = 0;
+        sp->buffp = sg_memalign(need, 0, NULL, false);
+        if (NULL == sp->buffp)
+            return -ENOMEM;
+        sp->buff_len = need;
+    }
+    sp->rec = *trp;
+    clear_scsi_pt_obj(sp->ptvp);
+    set_scsi_pt_cdb(sp->ptvp, sp->rec.cdb, sp->rec.cdb_len);
+    set_scsi_pt_sense(sp->ptvp, sp->sense, sizeof(sp->sense));
+    if (trp->din_len > 0)
+        set_scsi_pt_data_in(sp->ptvp, sp->buffp, trp->din_len);
+    if (trp->dout_len > 0) {
+        if (trp->din_len > 0)   /* bidi: zero data-out after data-in */
+            memset(sp->buffp, 0, trp->dout_len);
+        set_scsi_pt_data_out(sp->ptvp, sp->buffp, trp->dout_len);
+    }
+    set_scsi_pt_packet_id(sp->ptvp, pack_id);
+    sp->start_ns = sg_pt_lat_now_ns();
+    res = do_scsi_pt_submit(sp->ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    if (0 == res)
+        sp->busy = true;
+    return res;
+}
+
+/* Accounts for the completion of the command on slot sp whose
+ * do_scsi_pt_receive() returned pt_res. Returns 0 if the device completed
+ * the command (whether or not its status matched the trace), else an error
+ * category. */
+static int
+complete_rec(struct stats_t * stp, struct slot_t * sp, int pt_res,
+             int verbose)
+{
+    int res, status, slen;
+    int sense_key = 0;
+    uint64_t lat;
+    const struct sg_pt_trace_rec * trp = &sp->rec;
+    struct sg_scsi_sense_hdr ssh;
+    char b[80];
+
+    lat = sg_pt_lat_now_ns() - sp->start_ns;
+    sp->busy = false;
+    res = 0;
+    if (pt_res < 0)
+        res = sg_convert_errno(-pt_res);
+    else if ((pt_res > 0) && (SCSI_PT_DO_NVME_STATUS != pt_res))
+        res = SG_LIB_CAT_OTHER;
+    else if (get_scsi_pt_os_err(sp->ptvp))
+        res = sg_convert_errno(get_scsi_pt_os_err(sp->ptvp));
+    else if (get_scsi_pt_transport_err(sp->ptvp))
+        res = SG_LIB_CAT_OTHER;
+    if (res) {
+        if ((0 == stp->errs++) || verbose) {
+            rec_name(trp, sizeof(b), b);
+            pr2serr("%s not completed by device, pt_res=%d\n", b, pt_res);
+        }
+        if (0 == stp->first_err)
+            stp->first_err = res;
+        return res;
+    }
+    ++stp->cmds;
+    status = get_scsi_pt_status_response(sp->ptvp);
+    slen = get_scsi_pt_sense_len(sp->ptvp);
+    if ((slen > 0) && sg_scsi_normalize_sense(sp->sense, slen, &ssh))
+        sense_key = ssh.sense_key;
+    if ((status != trp->status) ||
+        ((SAM_STAT_CHECK_CONDITION == status) &&
+         (sense_key != trp->sense_key))) {
+        if (verbose) {
+            rec_name(trp, sizeof(b), b);
+            pr2serr("%s: status=0x%x, sense key=0x%x; trace had status="
+                    "0x%x, sense key=0x%x\n", b, status, sense_key,
+                    trp->status, trp->sense_key);
+        }
+        ++stp->mismatches;
+    }
+    stp->lat_sum_ns += lat;
+    if ((0 == stp->lat_min_ns) || (lat < stp->lat_min_ns))
+        stp->lat_min_ns = lat;
+    if (lat > stp->lat_max_ns)
+        stp->lat_max_ns = lat;
+    stp->rec_lat_sum_ns += trp->dur_ns;
+    if (trp->dur_ns > stp->rec_lat_max_ns)
+        stp->rec_lat_max_ns = trp->dur_ns;
+    return 0;
+}
+
+/* Keeps up to op->qd commands from the trace in flight on sg_fd until the
+ * trace (or --count=) is exhausted, an error occurs or SIGINT. In timed
+ * mode a command is not submitted before its offset in the trace from the
+ * first command has passed. */
+static void
+replay(struct rdr_t * rp, const struct opts_t * op, int sg_fd,
+       struct slot_t * slots, struct stats_t * stp)
+{
+    bool have, stopping;
+    int k, n, res, inflight, oldest;
+    uint64_t now, due, base_ns, t0;
+    uint64_t submitted = 0;
+    struct slot_t * sp;
+    struct sg_pt_trace_rec rec;
+
+    inflight = 0;
+    base_ns = 0;
+    t0 = sg_pt_lat_now_ns();
+    res = next_rec(rp, op, &rec);
+    have = (res > 0);
+    if (have)
+        base_ns = rec.start_ns;
+    stopping = false;
+    while (true) {
+        due = 0;
+        for (k = 0; have && (! stopping) && (k < op->qd); ++k) {
+            if (replay_stop) {
+                stopping = true;
+                break;
+            }
+            sp = slots + k;
+            if (sp->busy)
+                continue;
+            if (! op->asap) {
+                due = t0 + (rec.start_ns - base_ns);
+                if (sg_pt_lat_now_ns() < due)
+                    break;
+                due = 0;
+            }
+            if (rec.flags & SG_PT_TRACE_F_NVME)
+                ++stp->skipped;     /* would need a NVMe DEVICE, skip */
+            else {
+                res = submit_rec(sp, &rec, sg_fd, k + 1, op->verbose);
+                if (res) {
+                    if (res > 0)
+                        pr2serr("submit failed, res=%d\n", res);
+                    else
+                        pr2serr("submit failed: %s\n", safe_strerror(-res));
+                    if (0 == stp->errs++)
+                        stp->first_err = (res > 0) ? SG_LIB_CAT_OTHER :
+                                                     sg_convert_errno(-res);
+                    stopping = true;
+                    break;
+                }
+                ++inflight;
+            }
+            if (op->count && ((int64_t)++submitted >= op->count))
+                have = false;
+            else {
+                res = next_rec(rp, op, &rec);
+                if (res < 0)
+                    pr2serr("%s: malformed record, stopping\n", op->in_fn);
+                have = (res > 0);
+            }
+            k = -1;     /* rescan slots from the start for a free one */
+        }
+        if (stopping)
+            have = false;
+        if ((! have) && (0 == inflight))
+            break;
+        /* reap whatever has completed */
+        for (k = 0, n = 0, oldest = -1; k < op->qd; ++k) {
+            sp = slots + k;
+            if (! sp->busy)
+                continue;
+            res = do_scsi_pt_receive(sp->ptvp, true, op->verbose);
+            if (-EAGAIN == res) {
+                if ((oldest < 0) || (sp->start_ns < slots[oldest].start_ns))
+                    oldest = k;
+                continue;
+            }
+            --inflight;
+            ++n;
+            if (complete_rec(stp, sp, res, op->verbose))
+                stopping = true;
+        }
+        if (n > 0)
+            continue;
+        if (due > 0) {          /* waiting for the next command's time */
+            now = sg_pt_lat_now_ns();
+            if (due > now) {
+                due -= now;
+                if ((inflight > 0) && (due > TIMED_POLL_NS))
+                    due = TIMED_POLL_NS;
+                sleep_ns(due);
+            }
+        } else if (oldest >= 0) {       /* full or draining: block */
+            sp = slots + oldest;
+            res = do_scsi_pt_receive(sp->ptvp, false, op->verbose);
+            --inflight;
+            if (complete_rec(stp, sp, res, op->verbose))
+                stopping = true;
+        }
+    }
+}
+
+static void
+report(const struct opts_t * op, const struct scan_t * scp,
+       const struct stats_t * stp, uint64_t el_ns)
+{
+    double el_secs = el_ns / 1000000000.0;
+    double span_secs = (scp->last_ns - scp->first_ns) / 1000000000.0;
+
+    printf("Replay of %s on %s: %s, qd=%d\n", op->in_fn, op->device_name,
+           op->asap ? "as fast as possible" : "original timing", op->qd);
+    printf("  commands=%" PRIu64 ", errors=%" PRIu64 ", skipped=%" PRIu64
+           ", status mismatches=%" PRIu64 "\n", stp->cmds, stp->errs,
+           stp->skipped, stp->mismatches);
+    printf("  elapsed=%.3f seconds (trace span %.3f seconds)", el_secs,
+           span_secs);
+    if (el_secs > 0.0)
+        printf(", IOPS=%.1f", stp->cmds / el_secs);
+    printf("\n");
+    if (stp->cmds > 0) {
+        printf("  latency (usec): min=%.1f, mean=%.1f, max=%.1f\n",
+               stp->lat_min_ns / 1000.0,
+               (stp->lat_sum_ns / stp->cmds) / 1000.0,
+               stp->lat_max_ns / 1000.0);
+        printf("  recorded latency (usec): mean=%.1f, max=%.1f\n",
+               (stp->rec_lat_sum_ns / stp->cmds) / 1000.0,
+               stp->rec_lat_max_ns / 1000.0);
+    }
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    bool verbose_given = false;
+    bool version_given = false;
+    int c, k, res;
+    int sg_fd = -1;
+    int ret = 0;
+    int64_t ll;
+    uint64_t start_ns, el_ns;
+    const char * cp;
+    struct slot_t * slots = NULL;
+    struct rdr_t * rp = NULL;
+    struct opts_t opts;
+    struct opts_t * op;
+    struct scan_t scan;
+    struct stats_t stats;
+    struct sigaction sa;
+
+    op = &opts;
+    memset(op, 0, sizeof(opts));
+    memset(&stats, 0, sizeof(stats));
+    op->dev_fd = -1;
+    op->qd = DEF_QUEUE_DEPTH;
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "ac:dD:fhi:q:vV", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'a':
+            op->asap = true;
+            break;
+        case 'c':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("--count= expects a number of commands\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->count = ll;
+            break;
+        case 'd':
+            op->do_dump = true;
+            break;
+        case 'D':
+            op->dev_fd = sg_get_num(optarg);
+            if (op->dev_fd < 0) {
+                pr2serr("--dev= expects a file descriptor number\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'f':
+            op->do_force = true;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'i':
+            op->in_fn = optarg;
+            break;
+        case 'q':
+            op->qd = sg_get_num(optarg);
+            if ((op->qd < 1) || (op->qd > MAX_QUEUE_DEPTH)) {
+                pr2serr("--qd= expects 1 to %d\n", MAX_QUEUE_DEPTH);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            verbose_given = true;
+            ++op->verbose;
+            break;
+        case 'V':
+            version_given = true;
+            break;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        if (NULL == op->device_name) {
+            op->device_name = argv[optind];
+            ++optind;
+        }
+        if (optind < argc) {
+            for (; optind < argc; ++optind)
+                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+
+#ifdef DEBUG
+    pr2serr("In DEBUG mode, ");
+    if (verbose_given && version_given) {
+        pr2serr("but override: '-vV' given, zero verbose and continue\n");
+        verbose_given = false;
+        version_given = false;
+        op->verbose = 0;
+    } else if (! verbose_given) {
+        pr2serr("set '-vv'\n");
+        op->verbose = 2;
+    } else
+        pr2serr("keep verbose=%d\n", op->verbose);
+#else
+    if (verbose_given && version_given)
+        pr2serr("Not in DEBUG mode, so '-vV' has no special action\n");
+#endif
+    if (version_given) {
+        pr2serr("version: %s\n", version_str);
+        return 0;
+    }
+
+    if (NULL == op->in_fn) {
+        pr2serr("Missing trace file, give --in=TF\n\n");
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((! op->do_dump) && (NULL == op->device_name)) {
+        pr2serr("Missing device name!\n\n");
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    cp = getenv("SG3_UTILS_PT_TRACE");
+    if (cp && (0 == strcmp(cp, op->in_fn))) {
+        pr2serr("SG3_UTILS_PT_TRACE would overwrite %s\n", op->in_fn);
+        return SG_LIB_CONTRADICT;
+    }
+    rp = (struct rdr_t *)malloc(sizeof(*rp));
+    if (NULL == rp) {
+        pr2serr("out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    ret = rdr_open(rp, op->in_fn);
+    if (ret)
+        goto fini;
+    if (op->do_dump) {
+        ret = dump_trace(rp, op);
+        goto fini;
+    }
+    ret = scan_trace(rp, op, &scan);
+    if (ret)
+        goto fini;
+    if (op->verbose)
+        pr2serr("%s: %" PRIu64 " commands, %" PRIu64 " with data-out, %"
+                PRIu64 " NVMe\n", op->in_fn, scan.recs, scan.writes,
+                scan.nvme);
+    if (scan.writes && (! op->do_force)) {
+        pr2serr("%s holds %" PRIu64 " commands with data-out which would "
+                "overwrite data on\n%s; add '--force' to proceed\n",
+                op->in_fn, scan.writes, op->device_name);
+        ret = SG_LIB_CONTRADICT;
+        goto fini;
+    }
+
+    sg_fd = sg_cmds_open_flags(op->device_name, O_RDWR, op->verbose);
+    if (sg_fd < 0) {
+        pr2serr("open error: %s: %s\n", op->device_name,
+                safe_strerror(-sg_fd));
+        ret = sg_convert_errno(-sg_fd);
+        goto fini;
+    }
+    slots = (struct slot_t *)calloc(op->qd, sizeof(struct slot_t));
+    if (NULL == slots) {
+        pr2serr("out of memory\n");
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < op->qd; ++k) {
+        slots[k].ptvp = construct_scsi_pt_obj_with_fd(sg_fd, op->verbose);
+        if (NULL == slots[k].ptvp) {
+            pr2serr("out of memory\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    start_ns = sg_pt_lat_now_ns();
+    replay(rp, op, sg_fd, slots, &stats);
+    el_ns = sg_pt_lat_now_ns() - start_ns;
+    report(op, &scan, &stats, el_ns);
+    if (stats.first_err)
+        ret = stats.first_err;
+    else if (stats.mismatches)
+        ret = SG_LIB_CAT_MISCOMPARE;
+
+fini:
+    if (slots) {
+        for (k = 0; k < op->qd; ++k) {
+            if (slots[k].ptvp)
+                destruct_scsi_pt_obj(slots[k].ptvp);
+            if (slots[k].buffp)
+                free(slots[k].buffp);
+        }
+        free(slots);
+    }
+    if (rp) {
+        if (rp->fp)
+            fclose(rp->fp);
+        free(rp);
+    }
+    if (sg_fd >= 0) {
+        res = sg_cmds_close_device(sg_fd);
+        if (res < 0) {
+            pr2serr("close error: %s\n", safe_strerror(-res));
+            if (0 == ret)
+                ret = sg_convert_errno(-res);
+        }
+    }
+    if (0 == op->verbose) {
+        if (! sg_if_can2stderr("sg_replay failed: ", ret))
+            pr2serr("Some error occurred, try again with '-v' "
+                    "or '-vv' for more information\n");
+    }
+    return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+}
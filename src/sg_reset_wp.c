@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2019 Douglas Gilbert.
+ * Copyright (c) 2014-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <ctype.h>
 #include <getopt.h>
 #define __STDC_FORMAT_MACROS 1
@@ -22,6 +23,9 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
 
 #include "sg_lib.h"
 #include "sg_lib_data.h"
@@ -34,10 +38,11 @@
  *
  *
  * This program issues the SCSI RESET WRITE POINTER command to the given SCSI
- * device. Based on zbc-r04c.pdf .
+ * device. Based on zbc-r04c.pdf . Given a list or range of zones it issues
+ * one command per zone, several at a time.
  */
 
-static const char * version_str = "1.13 20190113";
+static const char * version_str = "1.14 20261014";
 
 #define SG_ZONING_OUT_CMDLEN 16
 #define RESET_WRITE_POINTER_SA 0x4
@@ -45,11 +50,26 @@ static const char * version_str = "1.13 20190113";
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT  60      /* 60 seconds */
 
+#define SG_ZONING_IN_CMDLEN 16
+#define REPORT_ZONES_SA 0x0
+#define ZB_RZONES_BUFF_LEN (1024 * 64)
+
+#define DEF_JOBS 4
+#define MAX_JOBS 256
+
+#define ZI_MAGIC "SGZI"         /* zone index file from sg_rep_zones */
+#define ZI_VERSION 1
+#define ZI_HDR_LEN 32
+
 
 static struct option long_options[] = {
         {"all", no_argument, 0, 'a'},
+        {"cond", required_argument, 0, 'k'},
         {"count", required_argument, 0, 'C'},
         {"help", no_argument, 0, 'h'},
+        {"jobs", required_argument, 0, 'j'},
+        {"load", required_argument, 0, 'l'},
+        {"range", required_argument, 0, 'r'},
         {"reset-all", no_argument, 0, 'R'},
         {"reset_all", no_argument, 0, 'R'},
         {"verbose", no_argument, 0, 'v'},
@@ -63,20 +83,43 @@ static void
 usage()
 {
     pr2serr("Usage: "
-            "sg_reset_wp  [--all] [--count=ZC] [--help] [--verbose]\n"
-            "                    [--version] [--zone=ID] DEVICE\n");
+            "sg_reset_wp  [--all] [--cond=CO] [--count=ZC] [--help] "
+            "[--jobs=JOBS]\n"
+            "                    [--load=FN] [--range=ST[,LA]] [--verbose] "
+            "[--version]\n"
+            "                    [--zone=ID[,ID...]] DEVICE\n");
     pr2serr("  where:\n"
             "    --all|-a           sets the ALL flag in the cdb\n"
+            "    --cond=CO|-k CO    reset zones in range with a condition "
+            "in CO, a\n"
+            "                       comma separated list of: empty, iopen, "
+            "eopen,\n"
+            "                       open, closed, full, ro, offline or a "
+            "number\n"
+            "                       (def: open,closed,full)\n"
             "    --count=ZC|-C ZC    set zone count field (def: 0)\n"
             "    --help|-h          print out usage message\n"
+            "    --jobs=JOBS|-j JOBS    number of commands outstanding at "
+            "once when\n"
+            "                           more than one zone (def: %d)\n"
+            "    --load=FN|-l FN    find zones in range from zone index FN "
+            "(from\n"
+            "                       'sg_rep_zones --bin=FN') rather than "
+            "DEVICE\n"
+            "    --range=ST[,LA]|-r ST[,LA]    zones from the one containing "
+            "LBA ST\n"
+            "                                  to LBA LA (def: last)\n"
             "    --verbose|-v       increase verbosity\n"
             "    --version|-V       print version string and exit\n"
             "    --zone=ID|-z ID    ID is the starting LBA of the zone "
             "whose\n"
-            "                       write pointer is to be reset\n\n"
+            "                       write pointer is to be reset; may be "
+            "a comma\n"
+            "                       separated list\n\n"
             "Performs a SCSI RESET WRITE POINTER command. ID is decimal by "
             "default,\nfor hex use a leading '0x' or a trailing 'h'. "
-            "Either the --zone=ID\nor --all option needs to be given.\n");
+            "Either the --zone=ID,\n--range=ST[,LA], --cond=CO, --load=FN "
+            "or --all option needs to be\ngiven.\n", DEF_JOBS);
 }
 
 /* Invokes a SCSI RESET WRITE POINTER command (ZBC).  Return of 0 -> success,
@@ -130,6 +173,412 @@ sg_ll_reset_write_pointer(int sg_fd, uint64_t zid, uint16_t zc, bool all,
     return ret;
 }
 
+/* Invokes a SCSI REPORT ZONES command (ZBC) with reporting option 0 (all
+ * zones).  Return of 0 -> success, various SG_LIB_CAT_* positive values or
+ * -1 -> other errors */
+static int
+sg_ll_report_zones(int sg_fd, uint64_t zs_lba, void * resp, int mx_resp_len,
+                   int * residp, bool noisy, int verbose)
+{
+    int k, ret, res, sense_cat;
+    uint8_t rz_cdb[SG_ZONING_IN_CMDLEN] =
+          {SG_ZONING_IN, REPORT_ZONES_SA, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0,
+           0, 0, 0, 0};
+    uint8_t sense_b[SENSE_BUFF_LEN];
+    struct sg_pt_base * ptvp;
+
+    sg_put_unaligned_be64(zs_lba, rz_cdb + 2);
+    sg_put_unaligned_be32((uint32_t)mx_resp_len, rz_cdb + 10);
+    if (verbose > 1) {
+        pr2serr("    Report zones cdb: ");
+        for (k = 0; k < SG_ZONING_IN_CMDLEN; ++k)
+            pr2serr("%02x ", rz_cdb[k]);
+        pr2serr("\n");
+    }
+
+    ptvp = construct_scsi_pt_obj();
+    if (NULL == ptvp) {
+        pr2serr("%s: out of memory\n", __func__);
+        return -1;
+    }
+    set_scsi_pt_cdb(ptvp, rz_cdb, sizeof(rz_cdb));
+    set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+    set_scsi_pt_data_in(ptvp, (uint8_t *)resp, mx_resp_len);
+    res = do_scsi_pt(ptvp, sg_fd, DEF_PT_TIMEOUT, verbose);
+    ret = sg_cmds_process_resp(ptvp, "report zones", res, noisy, verbose,
+                               &sense_cat);
+    if (-1 == ret)
+        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == ret) {
+        switch (sense_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            ret = 0;
+            break;
+        default:
+            ret = sense_cat;
+            break;
+        }
+    } else
+        ret = 0;
+    if (residp)
+        *residp = get_scsi_pt_resid(ptvp);
+    destruct_scsi_pt_obj(ptvp);
+    return ret;
+}
+
+struct cond_name_t {
+    const char * name;
+    uint16_t mask;      /* bit n set for zone condition n */
+};
+
+static struct cond_name_t cond_names[] = {
+    {"nwp", 1 << 0},            /* not write pointer */
+    {"empty", 1 << 1},
+    {"iopen", 1 << 2},          /* implicitly opened */
+    {"eopen", 1 << 3},          /* explicitly opened */
+    {"open", (1 << 2) | (1 << 3)},
+    {"closed", 1 << 4},
+    {"ro", 1 << 0xd},           /* read only */
+    {"full", 1 << 0xe},
+    {"offline", 1 << 0xf},
+    {NULL, 0},
+};
+
+/* Parses a comma separated list of zone condition names (or numbers) into
+ * a mask. Returns -1 if there is an unknown name. */
+static int
+parse_cond_list(const char * arg)
+{
+    int n, len;
+    int mask = 0;
+    const char * cp;
+    const struct cond_name_t * cnp;
+
+    for (cp = arg; *cp; cp += len + (',' == cp[len])) {
+        len = strcspn(cp, ",");
+        for (cnp = cond_names; cnp->name; ++cnp) {
+            if (((int)strlen(cnp->name) == len) &&
+                (0 == strncmp(cnp->name, cp, len)))
+                break;
+        }
+        if (cnp->name)
+            mask |= cnp->mask;
+        else if (isdigit((uint8_t)*cp) &&
+                 ((n = sg_get_num_nomult(cp)) >= 0) && (n < 16))
+            mask |= 1 << n;
+        else {
+            pr2serr("unknown zone condition: %.*s\n", len, cp);
+            return -1;
+        }
+    }
+    return mask;
+}
+
+/* Parses ST[,LA] where LA defaults to the last LBA */
+static int
+parse_range(const char * arg, uint64_t * stp, uint64_t * lap)
+{
+    int64_t ll;
+    const char * cp = strchr(arg, ',');
+    char b[32];
+
+    if (cp && ((cp - arg) < (int)sizeof(b))) {
+        memcpy(b, arg, cp - arg);
+        b[cp - arg] = '\0';
+        ll = sg_get_llnum(b);
+    } else
+        ll = cp ? -1 : sg_get_llnum(arg);
+    if (-1 == ll)
+        return SG_LIB_SYNTAX_ERROR;
+    *stp = (uint64_t)ll;
+    *lap = UINT64_MAX;
+    if (cp) {
+        ll = sg_get_llnum(cp + 1);
+        if ((-1 == ll) || ((uint64_t)ll < *stp))
+            return SG_LIB_SYNTAX_ERROR;
+        *lap = (uint64_t)ll;
+    }
+    return 0;
+}
+
+/* Zones to be acted on and the command to use */
+struct zb_batch {
+    int sg_fd;
+    int sa;                     /* zone out service action */
+    int vb;
+    uint16_t zc;                /* zone count for each command */
+    int ret;                    /* first error, stops the other jobs */
+    uint64_t * zids;
+    int64_t num;
+    int64_t max;
+    int64_t next;               /* next zone to be issued */
+    int64_t done;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static int
+zb_add(struct zb_batch * bp, uint64_t zid)
+{
+    if (bp->num >= bp->max) {
+        int64_t n = bp->max ? (2 * bp->max) : 256;
+        uint64_t * p = (uint64_t *)realloc(bp->zids, n * sizeof(uint64_t));
+
+        if (NULL == p)
+            return sg_convert_errno(ENOMEM);
+        bp->zids = p;
+        bp->max = n;
+    }
+    bp->zids[bp->num++] = zid;
+    return 0;
+}
+
+/* Adds each zone ID in the comma separated list arg */
+static int
+zb_from_list(struct zb_batch * bp, const char * arg)
+{
+    int len, res;
+    int64_t ll;
+    const char * cp;
+    char b[32];
+
+    for (cp = arg; *cp; cp += len + (',' == cp[len])) {
+        len = strcspn(cp, ",");
+        if ((len < 1) || (len >= (int)sizeof(b)))
+            ll = -1;
+        else {
+            memcpy(b, cp, len);
+            b[len] = '\0';
+            ll = sg_get_llnum(b);
+        }
+        if (-1 == ll) {
+            pr2serr("bad zone ID in '--zone=%s'\n", arg);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ((res = zb_add(bp, (uint64_t)ll)))
+            return res;
+    }
+    return 0;
+}
+
+/* Adds the write pointer zones with a condition in cond_mask whose zone
+ * start is from the zone containing st_lba up to la_lba, as reported by
+ * REPORT ZONES. */
+static int
+zb_from_device(struct zb_batch * bp, uint64_t st_lba, uint64_t la_lba,
+               int cond_mask)
+{
+    int k, res, resid, rlen, zones;
+    uint64_t zs, prev, max_lba;
+    uint64_t cur = st_lba;
+    uint8_t * buff;
+    uint8_t * free_buff = NULL;
+    const uint8_t * dp;
+
+    buff = (uint8_t *)sg_memalign(ZB_RZONES_BUFF_LEN, 0, &free_buff, false);
+    if (NULL == buff)
+        return sg_convert_errno(ENOMEM);
+    res = 0;
+    while (cur <= la_lba) {
+        res = sg_ll_report_zones(bp->sg_fd, cur, buff, ZB_RZONES_BUFF_LEN,
+                                 &resid, true, bp->vb);
+        if (res) {
+            if (SG_LIB_LBA_OUT_OF_RANGE == res)
+                res = 0;        /* past the last zone */
+            break;
+        }
+        rlen = ZB_RZONES_BUFF_LEN - resid;
+        if (rlen >= 64) {
+            k = sg_get_unaligned_be32(buff + 0) + 64;
+            if (k < rlen)
+                rlen = k;
+        }
+        zones = (rlen >= 64) ? ((rlen - 64) / 64) : 0;
+        if (0 == zones)
+            break;
+        max_lba = sg_get_unaligned_be64(buff + 8);
+        prev = cur;
+        for (k = 0, dp = buff + 64; k < zones; ++k, dp += 64) {
+            zs = sg_get_unaligned_be64(dp + 16);
+            if (zs > la_lba) {
+                cur = la_lba + 1;
+                break;
+            }
+            if ((1 != (dp[0] & 0xf)) &&         /* not conventional */
+                ((1 << ((dp[1] >> 4) & 0xf)) & cond_mask)) {
+                if ((res = zb_add(bp, zs)))
+                    goto fini;
+            }
+            cur = zs + sg_get_unaligned_be64(dp + 8);
+        }
+        if (cur <= prev) {
+            pr2serr("REPORT ZONES from LBA 0x%" PRIx64 " made no "
+                    "progress\n", prev);
+            res = SG_LIB_CAT_MALFORMED;
+            break;
+        }
+        if (cur > max_lba)
+            break;
+    }
+fini:
+    free(free_buff);
+    return res;
+}
+
+/* As zb_from_device() but from a zone index file written by
+ * 'sg_rep_zones --bin=FN'. */
+static int
+zb_from_index(struct zb_batch * bp, const char * fn, uint64_t st_lba,
+              uint64_t la_lba, int cond_mask)
+{
+    int ret = 0;
+    int64_t j, n;
+    uint64_t * start = NULL;
+    uint64_t * len = NULL;
+    uint8_t * tc = NULL;
+    uint8_t hdr[ZI_HDR_LEN];
+    uint8_t b8[8];
+    FILE * fp;
+
+    fp = fopen(fn, "rb");
+    if (NULL == fp) {
+        ret = errno;
+        pr2serr("unable to open %s: %s\n", fn, safe_strerror(ret));
+        return sg_convert_errno(ret);
+    }
+    if ((1 != fread(hdr, sizeof(hdr), 1, fp)) || memcmp(hdr, ZI_MAGIC, 4) ||
+        (ZI_VERSION != sg_get_unaligned_be32(hdr + 4))) {
+        pr2serr("%s is not a zone index file\n", fn);
+        ret = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    n = (int64_t)sg_get_unaligned_be64(hdr + 8);
+    if (n <= 0)
+        goto fini;
+    start = (uint64_t *)malloc(n * sizeof(uint64_t));
+    len = (uint64_t *)malloc(n * sizeof(uint64_t));
+    tc = (uint8_t *)malloc(2 * n);      /* types then conditions */
+    if ((NULL == start) || (NULL == len) || (NULL == tc)) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (j = 0; j < 2 * n; ++j) {
+        if (1 != fread(b8, sizeof(b8), 1, fp))
+            goto short_file;
+        if (j < n)
+            start[j] = sg_get_unaligned_be64(b8);
+        else
+            len[j - n] = sg_get_unaligned_be64(b8);
+    }
+    /* skip the write pointers */
+    if (fseek(fp, ZI_HDR_LEN + (24 * n), SEEK_SET) ||
+        (1 != fread(tc, 2 * n, 1, fp)))
+        goto short_file;
+    for (j = 0; j < n; ++j) {
+        if ((start[j] + len[j]) <= st_lba)
+            continue;
+        if (start[j] > la_lba)
+            break;
+        if ((1 != tc[j]) && ((1 << (tc[n + j] & 0xf)) & cond_mask)) {
+            if ((ret = zb_add(bp, start[j])))
+                goto fini;
+        }
+    }
+    goto fini;
+short_file:
+    pr2serr("%s: zone index file is truncated\n", fn);
+    ret = SG_LIB_FILE_ERROR;
+fini:
+    free(start);
+    free(len);
+    free(tc);
+    fclose(fp);
+    return ret;
+}
+
+static int zb_issue(struct zb_batch * bp, uint64_t zid);
+
+static void *
+zb_worker(void * v_bp)
+{
+    int res;
+    int64_t k;
+    struct zb_batch * bp = (struct zb_batch *)v_bp;
+
+    while (true) {
+#ifndef SG_LIB_WIN32
+        pthread_mutex_lock(&bp->mtx);
+#endif
+        k = bp->ret ? bp->num : bp->next++;
+#ifndef SG_LIB_WIN32
+        pthread_mutex_unlock(&bp->mtx);
+#endif
+        if (k >= bp->num)
+            break;
+        res = zb_issue(bp, bp->zids[k]);
+#ifndef SG_LIB_WIN32
+        pthread_mutex_lock(&bp->mtx);
+#endif
+        if (res) {
+            if (0 == bp->ret)
+                bp->ret = res;
+        } else
+            ++bp->done;
+#ifndef SG_LIB_WIN32
+        pthread_mutex_unlock(&bp->mtx);
+#endif
+    }
+    return NULL;
+}
+
+/* Issues the command for each zone in the batch, with up to num_jobs of
+ * them outstanding. Returns 0 or the error of the first that failed. */
+static int
+zb_run(struct zb_batch * bp, int num_jobs)
+{
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+
+    if (num_jobs > bp->num)
+        num_jobs = (bp->num > 0) ? (int)bp->num : 1;
+    pthread_mutex_init(&bp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, zb_worker, bp))) {
+            if (bp->vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    zb_worker(bp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&bp->mtx);
+#else
+    if (num_jobs) { ; }  /* suppress warning */
+    zb_worker(bp);
+#endif
+    return bp->ret;
+}
+
+static int
+zb_issue(struct zb_batch * bp, uint64_t zid)
+{
+    int res;
+    char b[80];
+
+    res = sg_ll_reset_write_pointer(bp->sg_fd, zid, bp->zc, false, true,
+                                    bp->vb);
+    if (res) {
+        sg_get_category_sense_str(res, sizeof(b), b, bp->vb);
+        pr2serr("Reset write pointer of zone 0x%" PRIx64 ": %s\n", zid, b);
+    }
+    return res;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -138,19 +587,28 @@ main(int argc, char * argv[])
     bool verbose_given = false;
     bool version_given = false;
     bool zid_given = false;
+    bool range_given = false;
+    bool do_batch = false;
     int res, c, n;
+    int cond_mask = -1;
+    int num_jobs = DEF_JOBS;
     int sg_fd = -1;
     int ret = 0;
     int verbose = 0;
     uint16_t zc = 0;
     uint64_t zid = 0;
+    uint64_t st_lba = 0;
+    uint64_t la_lba = UINT64_MAX;
     int64_t ll;
     const char * device_name = NULL;
+    const char * zone_arg = NULL;
+    const char * load_fn = NULL;
+    struct zb_batch a_batch;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "aC:hRvVz:", long_options,
+        c = getopt_long(argc, argv, "aC:hj:k:l:r:RvVz:", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -173,6 +631,29 @@ main(int argc, char * argv[])
         case '?':
             usage();
             return 0;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs' should be from 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'k':
+            cond_mask = parse_cond_list(optarg);
+            if (cond_mask < 0)
+                return SG_LIB_SYNTAX_ERROR;
+            break;
+        case 'l':
+            load_fn = optarg;
+            break;
+        case 'r':
+            if (parse_range(optarg, &st_lba, &la_lba)) {
+                pr2serr("bad argument to '--range=ST[,LA]'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            range_given = true;
+            break;
         case 'v':
             verbose_given = true;
             ++verbose;
@@ -181,13 +662,16 @@ main(int argc, char * argv[])
             version_given = true;
             break;
         case 'z':
+            zone_arg = optarg;
+            zid_given = true;
+            if (strchr(optarg, ','))
+                break;          /* list of zone IDs */
             ll = sg_get_llnum(optarg);
             if (-1 == ll) {
                 pr2serr("bad argument to '--zone=ID'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
             zid = (uint64_t)ll;
-            zid_given = true;
             break;
         default:
             pr2serr("unrecognised option code 0x%x ??\n", c);
@@ -230,7 +714,21 @@ main(int argc, char * argv[])
         return 0;
     }
 
-    if ((! zid_given) && (! all)) {
+    memset(&a_batch, 0, sizeof(a_batch));
+    if ((zone_arg && strchr(zone_arg, ',')) || range_given || load_fn ||
+        (cond_mask >= 0))
+        do_batch = true;        /* one command per zone */
+    if (do_batch && all) {
+        pr2serr("--all cannot be used with a list or range of zones\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (do_batch && zid_given &&
+        (range_given || load_fn || (cond_mask >= 0))) {
+        pr2serr("--zone=ID cannot be used with --range=, --cond= or "
+                "--load=\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if ((! zid_given) && (! all) && (! do_batch)) {
         pr2serr("either the --zone=ID or --all option is required\n\n");
         usage();
         return SG_LIB_CONTRADICT;
@@ -252,6 +750,27 @@ main(int argc, char * argv[])
         goto fini;
     }
 
+    if (do_batch) {
+        a_batch.sg_fd = sg_fd;
+        a_batch.vb = verbose;
+        a_batch.zc = zc;
+        if (cond_mask < 0)
+            cond_mask = (1 << 2) | (1 << 3) | (1 << 4) | (1 << 0xe);
+        if (zid_given)
+            ret = zb_from_list(&a_batch, zone_arg);
+        else if (load_fn)
+            ret = zb_from_index(&a_batch, load_fn, st_lba, la_lba,
+                                cond_mask);
+        else
+            ret = zb_from_device(&a_batch, st_lba, la_lba, cond_mask);
+        if (0 == ret)
+            ret = zb_run(&a_batch, num_jobs);
+        if (ret || verbose)
+            pr2serr("Reset write pointer: %" PRId64 " of %" PRId64 " zones "
+                    "done\n", a_batch.done, a_batch.num);
+        free(a_batch.zids);
+        goto fini;
+    }
     res = sg_ll_reset_write_pointer(sg_fd, zid, zc, all, true, verbose);
     ret = res;
     if (res) {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2018 Christophe Varoqui and Douglas Gilbert.
+ * Copyright (c) 2004-2026 Christophe Varoqui and Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,7 +14,11 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -23,6 +27,7 @@
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
@@ -30,10 +35,11 @@
  *
  *
  * This program issues the SCSI command REPORT TARGET PORT GROUPS
- * to the given SCSI device.
+ * to the given SCSI device. With --monitor it polls one or more devices
+ * concurrently and reports changes in their ALUA state.
  */
 
-static const char * version_str = "1.27 20180628";
+static const char * version_str = "1.28 20261014";
 
 #define REPORT_TGT_GRP_BUFF_LEN 1024
 
@@ -49,11 +55,64 @@ static const char * version_str = "1.27 20180628";
 #define STATUS_CODE_CHANGED_BY_SET 0x1
 #define STATUS_CODE_CHANGED_BY_IMPLICIT 0x2
 
+#define AO_SUP_MASK 0x1         /* in byte 1 of target port group desc */
+#define DEF_MON_INTERVAL_MS 1000
+#define MON_MAX_TPGS 32
+#define MON_MAX_THREADS 256
+
+struct mon_tpg_t {
+    int id;
+    uint8_t state;      /* asymmetric access state */
+    uint8_t sup;        /* T_SUP ... AO_SUP bits */
+    uint8_t status;
+    bool pref;
+};
+
+struct mon_dev_t {
+    const char * dev_name;
+    int fd;
+    int num_tpg;
+    int itt;            /* implicit transition time (seconds) */
+    int last_res;       /* of previous RTPG */
+    bool extended;      /* cleared if extended header rejected */
+    bool armed;         /* may failover when no tpg is active/optimized */
+    int polls;
+    int changes;
+    int failovers;
+    int errors;
+    uint64_t lat_sum_ns;
+    uint64_t lat_max_ns;
+    uint64_t trans_ns;  /* when a tpg was first seen transitioning */
+    struct mon_tpg_t tpg[MON_MAX_TPGS];
+};
+
+struct mon_coll_t {
+    bool failover;      /* issue STPG if no tpg active/optimized */
+    int count;          /* polls per DEVICE, 0 -> until interrupted */
+    int interval_ms;
+    int num_devs;
+    int num_thr;
+    int verbose;
+    uint64_t start_ns;
+    struct mon_dev_t * arr;
+    pthread_mutex_t out_mtx;    /* so each report is output together */
+};
+
+struct mon_thr_t {
+    struct mon_coll_t * mcp;
+    int first;          /* index of first DEVICE this thread polls */
+    pthread_t tid;
+};
+
 static struct option long_options[] = {
+        {"count", required_argument, 0, 'c'},
         {"decode", no_argument, 0, 'd'},
         {"extended", no_argument, 0, 'e'},
+        {"failover", no_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
+        {"interval", required_argument, 0, 'i'},
+        {"monitor", no_argument, 0, 'm'},
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
         {"verbose", no_argument, 0, 'v'},
@@ -68,12 +127,27 @@ usage()
     pr2serr("Usage: sg_rtpg   [--decode] [--extended] [--help] [--hex] "
             "[--raw] [--readonly]\n"
             "                 [--verbose] [--version] DEVICE\n"
+            "       sg_rtpg   --monitor [--count=N] [--failover] "
+            "[--interval=MS]\n"
+            "                 [--readonly] [--verbose] DEVICE [DEVICE...]\n"
             "  where:\n"
+            "    --count=N|-c N     with --monitor: polls of each DEVICE "
+            "(def: 0 ->\n"
+            "                       until interrupted)\n"
             "    --decode|-d        decode status and asym. access state\n"
             "    --extended|-e      use extended header parameter data "
             "format\n"
+            "    --failover|-f      with --monitor: when no target port "
+            "group is\n"
+            "                       active/optimized, SET one to it (from "
+            "cached state)\n"
             "    --help|-h          print out usage message\n"
             "    --hex|-H           print out response in hex\n"
+            "    --interval=MS|-i MS    with --monitor: poll every MS "
+            "milliseconds\n"
+            "                           (def: 1000)\n"
+            "    --monitor|-m       poll all DEVICEs concurrently and report "
+            "changes\n"
             "    --raw|-r           output response in binary to stdout\n"
             "    --readonly|-R      open DEVICE read-only (def: read-write)\n"
             "    --verbose|-v       increase verbosity\n"
@@ -112,35 +186,387 @@ decode_status(const int st)
     }
 }
 
-static void
-decode_tpgs_state(const int st)
+static const char *
+tpgs_state_str(const int st)
 {
     switch (st) {
     case TPGS_STATE_OPTIMIZED:
-        printf(" (active/optimized)");
-        break;
+        return "active/optimized";
     case TPGS_STATE_NONOPTIMIZED:
-        printf(" (active/non optimized)");
-        break;
+        return "active/non optimized";
     case TPGS_STATE_STANDBY:
-        printf(" (standby)");
-        break;
+        return "standby";
     case TPGS_STATE_UNAVAILABLE:
-        printf(" (unavailable)");
-        break;
+        return "unavailable";
     case TPGS_STATE_LB_DEPENDENT:
-        printf(" (logical block dependent)");
-        break;
+        return "logical block dependent";
     case TPGS_STATE_OFFLINE:
-        printf(" (offline)");
-        break;
+        return "offline";
     case TPGS_STATE_TRANSITIONING:
-        printf(" (transitioning between states)");
-        break;
+        return "transitioning between states";
     default:
-        printf(" (unknown)");
-        break;
+        return "unknown";
+    }
+}
+
+static void
+decode_tpgs_state(const int st)
+{
+    printf(" (%s)", tpgs_state_str(st));
+}
+
+static const char *
+mon_status_str(const int st)
+{
+    switch (st) {
+    case STATUS_CODE_NOSTATUS:
+        return "no status";
+    case STATUS_CODE_CHANGED_BY_SET:
+        return "changed by SET TARGET PORT GROUPS";
+    case STATUS_CODE_CHANGED_BY_IMPLICIT:
+        return "changed by implicit lu behaviour";
+    default:
+        return "unknown status code";
+    }
+}
+
+/* Seconds, with millisecond resolution, since the monitor started */
+static double
+mon_elapsed(const struct mon_coll_t * mcp)
+{
+    return (double)(sg_pt_lat_now_ns() - mcp->start_ns) / 1000000000.0;
+}
+
+/* Decodes the REPORT TARGET PORT GROUPS response in bp (of length len)
+ * into tgp, at most max_tpg entries. Sets *ittp to the implicit transition
+ * time when extended, else to 0. Returns the number of target port group
+ * descriptors found or -1 if the response is malformed. */
+static int
+mon_decode_rtpg(const uint8_t * bp, int len, bool extended,
+                struct mon_tpg_t * tgp, int max_tpg, int * ittp)
+{
+    int k, n;
+
+    *ittp = 0;
+    if (len < 4)
+        return -1;
+    if (sg_get_unaligned_be32(bp + 0) + 4 < (uint32_t)len)
+        len = sg_get_unaligned_be32(bp + 0) + 4;
+    k = 4;
+    if (extended) {
+        if ((len < 8) || (0x10 != (bp[4] & 0x70)))
+            return -1;
+        *ittp = bp[5];
+        k = 8;
+    }
+    for (n = 0; (k + 8 <= len) && (n < max_tpg); ++n) {
+        tgp[n].pref = !! (bp[k] & 0x80);
+        tgp[n].state = bp[k] & 0x0f;
+        tgp[n].sup = bp[k + 1];
+        tgp[n].id = sg_get_unaligned_be16(bp + k + 2);
+        tgp[n].status = bp[k + 5];
+        k += 8 + (4 * bp[k + 7]);
+    }
+    return n;
+}
+
+/* When no target port group of mdp is active/optimized, picks the one to
+ * make so from the cached state: one that supports it, the preferred one
+ * first, active/non optimized before standby. Returns its index in
+ * mdp->tpg or -1 if there is none. */
+static int
+mon_pick_failover(const struct mon_dev_t * mdp)
+{
+    int k, pick, score, best;
+
+    for (k = 0, pick = -1, best = 0; k < mdp->num_tpg; ++k) {
+        const struct mon_tpg_t * tp = mdp->tpg + k;
+
+        if (! (tp->sup & AO_SUP_MASK))
+            continue;
+        if (TPGS_STATE_NONOPTIMIZED == tp->state)
+            score = 2;
+        else if (TPGS_STATE_STANDBY == tp->state)
+            score = 1;
+        else
+            continue;
+        if (tp->pref)
+            score += 2;
+        if (score > best) {
+            best = score;
+            pick = k;
+        }
+    }
+    return pick;
+}
+
+/* Sends SET TARGET PORT GROUPS with a single descriptor asking that the
+ * target port group at index pick becomes active/optimized. Called with
+ * no REPORT TARGET PORT GROUPS round trip since the state is cached. */
+static void
+mon_failover(struct mon_coll_t * mcp, struct mon_dev_t * mdp, int pick)
+{
+    int res;
+    uint64_t t_ns;
+    uint8_t param[8];
+    char b[80];
+
+    memset(param, 0, sizeof(param));
+    param[4] = TPGS_STATE_OPTIMIZED;
+    sg_put_unaligned_be16((uint16_t)mdp->tpg[pick].id, param + 6);
+    t_ns = sg_pt_lat_now_ns();
+    res = sg_ll_set_tgt_prt_grp(mdp->fd, param, sizeof(param),
+                                mcp->verbose > 0, mcp->verbose);
+    t_ns = sg_pt_lat_now_ns() - t_ns;
+    mdp->armed = false;
+    ++mdp->failovers;
+    pthread_mutex_lock(&mcp->out_mtx);
+    if (res) {
+        sg_get_category_sense_str(res, sizeof(b), b, mcp->verbose);
+        printf("[%10.3f] %s: SET tpg 0x%x to active/optimized failed: %s\n",
+               mon_elapsed(mcp), mdp->dev_name, mdp->tpg[pick].id, b);
+    } else
+        printf("[%10.3f] %s: SET tpg 0x%x to active/optimized, took %.3f "
+               "ms\n", mon_elapsed(mcp), mdp->dev_name, mdp->tpg[pick].id,
+               (double)t_ns / 1000000.0);
+    fflush(stdout);
+    pthread_mutex_unlock(&mcp->out_mtx);
+}
+
+/* One REPORT TARGET PORT GROUPS poll of mdp: outputs any change from the
+ * previous poll, then checks whether a failover is needed */
+static void
+mon_poll(struct mon_coll_t * mcp, struct mon_dev_t * mdp)
+{
+    int k, j, n, res, itt, pick;
+    bool have_opt, have_trans;
+    uint64_t now, lat_ns;
+    struct mon_tpg_t tpg[MON_MAX_TPGS];
+    uint8_t buff[REPORT_TGT_GRP_BUFF_LEN];
+    char b[80];
+
+    memset(buff, 0, sizeof(buff));
+    now = sg_pt_lat_now_ns();
+    res = sg_ll_report_tgt_prt_grp2(mdp->fd, buff, sizeof(buff),
+                                    mdp->extended, mcp->verbose > 1,
+                                    mcp->verbose > 1 ? mcp->verbose - 1 : 0);
+    if ((SG_LIB_CAT_ILLEGAL_REQ == res) && mdp->extended) {
+        mdp->extended = false;  /* retry without extended header */
+        res = sg_ll_report_tgt_prt_grp2(mdp->fd, buff, sizeof(buff), false,
+                                        mcp->verbose > 1, mcp->verbose > 1 ?
+                                        mcp->verbose - 1 : 0);
+    }
+    lat_ns = sg_pt_lat_now_ns() - now;
+    ++mdp->polls;
+    n = 0;
+    itt = 0;
+    if (0 == res) {
+        mdp->lat_sum_ns += lat_ns;
+        if (lat_ns > mdp->lat_max_ns)
+            mdp->lat_max_ns = lat_ns;
+        n = mon_decode_rtpg(buff, sizeof(buff), mdp->extended, tpg,
+                            MON_MAX_TPGS, &itt);
+        if (n < 0)
+            res = SG_LIB_CAT_MALFORMED;
+    }
+    if (res) {
+        ++mdp->errors;
+        if (res != mdp->last_res) {
+            sg_get_category_sense_str(res, sizeof(b), b, mcp->verbose);
+            pthread_mutex_lock(&mcp->out_mtx);
+            printf("[%10.3f] %s: Report Target Port Groups: %s\n",
+                   mon_elapsed(mcp), mdp->dev_name, b);
+            fflush(stdout);
+            pthread_mutex_unlock(&mcp->out_mtx);
+        }
+        mdp->last_res = res;
+        return;
+    }
+
+    pthread_mutex_lock(&mcp->out_mtx);
+    if ((1 == mdp->polls) || mdp->last_res) {
+        printf("[%10.3f] %s: %d target port groups", mon_elapsed(mcp),
+               mdp->dev_name, n);
+        if (mdp->extended)
+            printf(", implicit transition time: %d seconds", itt);
+        printf("\n");
+        for (k = 0; k < n; ++k)
+            printf("             tpg 0x%x%s: %s\n", tpg[k].id,
+                   tpg[k].pref ? " (preferred)" : "",
+                   tpgs_state_str(tpg[k].state));
+    } else {
+        for (k = 0; k < n; ++k) {
+            for (j = 0; j < mdp->num_tpg; ++j) {
+                if (mdp->tpg[j].id == tpg[k].id)
+                    break;
+            }
+            if ((j < mdp->num_tpg) && (mdp->tpg[j].state == tpg[k].state))
+                continue;
+            ++mdp->changes;
+            printf("[%10.3f] %s: tpg 0x%x: %s -> %s (%s)\n",
+                   mon_elapsed(mcp), mdp->dev_name, tpg[k].id,
+                   (j < mdp->num_tpg) ? tpgs_state_str(mdp->tpg[j].state) :
+                                        "not present",
+                   tpgs_state_str(tpg[k].state),
+                   mon_status_str(tpg[k].status));
+        }
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&mcp->out_mtx);
+    mdp->last_res = 0;
+    mdp->num_tpg = n;
+    mdp->itt = itt;
+    memcpy(mdp->tpg, tpg, n * sizeof(tpg[0]));
+
+    for (k = 0, have_opt = false, have_trans = false; k < n; ++k) {
+        if (TPGS_STATE_OPTIMIZED == tpg[k].state)
+            have_opt = true;
+        else if (TPGS_STATE_TRANSITIONING == tpg[k].state)
+            have_trans = true;
+    }
+    if (have_opt) {
+        mdp->armed = true;
+        mdp->trans_ns = 0;
+        return;
+    }
+    if (! (mcp->failover && mdp->armed))
+        return;
+    if (have_trans) {
+        /* give the device its implicit transition time to finish */
+        if (0 == mdp->trans_ns)
+            mdp->trans_ns = now;
+        if ((now - mdp->trans_ns) < ((uint64_t)mdp->itt * 1000000000))
+            return;
+    }
+    pick = mon_pick_failover(mdp);
+    if (pick >= 0)
+        mon_failover(mcp, mdp, pick);
+}
+
+/* Worker k polls DEVICEs k, k + num_thr, ... each interval_ms until count
+ * polls each have been done */
+static void *
+mon_worker(void * v_mtp)
+{
+    int k, poll;
+    uint64_t due, now;
+    struct mon_thr_t * mtp = (struct mon_thr_t *)v_mtp;
+    struct mon_coll_t * mcp = mtp->mcp;
+
+    for (poll = 0; (0 == mcp->count) || (poll < mcp->count); ++poll) {
+        for (k = mtp->first; k < mcp->num_devs; k += mcp->num_thr)
+            mon_poll(mcp, mcp->arr + k);
+        due = mcp->start_ns +
+              ((uint64_t)(poll + 1) * mcp->interval_ms * 1000000);
+        now = sg_pt_lat_now_ns();
+        if (due > now)
+            sg_pt_rate_sleep(due - now);
+    }
+    return NULL;
+}
+
+/* Implements --monitor: opens each DEVICE, polls them all concurrently
+ * from up to MON_MAX_THREADS threads, then (when --count given) outputs
+ * a summary line for each. Returns 0 unless a DEVICE could not be
+ * opened or its last poll failed. */
+static int
+monitor(struct mon_coll_t * mcp, char ** dev_names, bool o_readonly)
+{
+    int k, err, num_open;
+    int ret = 0;
+    struct mon_dev_t * mdp;
+    struct mon_thr_t * thr;
+    char b[80];
+
+    mcp->arr = (struct mon_dev_t *)calloc(mcp->num_devs, sizeof(*mcp->arr));
+    mcp->num_thr = (mcp->num_devs < MON_MAX_THREADS) ? mcp->num_devs :
+                                                       MON_MAX_THREADS;
+    thr = (struct mon_thr_t *)calloc(mcp->num_thr, sizeof(*thr));
+    if ((NULL == mcp->arr) || (NULL == thr)) {
+        pr2serr("unable to allocate memory for %d devices\n",
+                mcp->num_devs);
+        free(mcp->arr);
+        free(thr);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, num_open = 0; k < mcp->num_devs; ++k) {
+        mdp = mcp->arr + k;
+        mdp->dev_name = dev_names[k];
+        mdp->extended = true;
+        mdp->fd = sg_cmds_open_device(mdp->dev_name, o_readonly,
+                                      mcp->verbose);
+        if (mdp->fd < 0) {
+            pr2serr("open error: %s: %s\n", mdp->dev_name,
+                    safe_strerror(-mdp->fd));
+            if (0 == ret)
+                ret = sg_convert_errno(-mdp->fd);
+        } else
+            ++num_open;
+    }
+    if (0 == num_open)
+        goto fini;
+    /* compact so workers only see opened DEVICEs */
+    for (k = 0, num_open = 0; k < mcp->num_devs; ++k) {
+        if (mcp->arr[k].fd >= 0)
+            mcp->arr[num_open++] = mcp->arr[k];
+    }
+    mcp->num_devs = num_open;
+    if (mcp->num_thr > num_open)
+        mcp->num_thr = num_open;
+    pthread_mutex_init(&mcp->out_mtx, NULL);
+    mcp->start_ns = sg_pt_lat_now_ns();
+    for (k = 0; k < mcp->num_thr; ++k) {
+        thr[k].mcp = mcp;
+        thr[k].first = k;
     }
+    /* this thread polls DEVICE 0 (and every num_thr-th after it) */
+    for (k = 1; k < mcp->num_thr; ++k) {
+        err = pthread_create(&thr[k].tid, NULL, mon_worker, thr + k);
+        if (err) {
+            pr2serr("pthread_create: %s\n", safe_strerror(err));
+            mcp->count = 1;     /* stop the others after one poll */
+            break;
+        }
+    }
+    if (k < mcp->num_thr) {
+        for (--k; k > 0; --k)
+            pthread_join(thr[k].tid, NULL);
+        ret = sg_convert_errno(EAGAIN);
+        goto fini;
+    }
+    mon_worker(thr + 0);
+    for (k = 1; k < mcp->num_thr; ++k)
+        pthread_join(thr[k].tid, NULL);
+    pthread_mutex_destroy(&mcp->out_mtx);
+
+    printf("\nMonitor summary, %d devices over %.3f seconds:\n",
+           mcp->num_devs, mon_elapsed(mcp));
+    for (k = 0; k < mcp->num_devs; ++k) {
+        mdp = mcp->arr + k;
+        printf("  %s: %d polls, %d state changes, %d failovers, %d errors",
+               mdp->dev_name, mdp->polls, mdp->changes, mdp->failovers,
+               mdp->errors);
+        if (mdp->polls > mdp->errors)
+            printf("; latency (ms): avg=%.3f max=%.3f",
+                   (double)mdp->lat_sum_ns / (mdp->polls - mdp->errors) /
+                   1000000.0, (double)mdp->lat_max_ns / 1000000.0);
+        printf("\n");
+        if (mdp->last_res) {
+            sg_get_category_sense_str(mdp->last_res, sizeof(b), b,
+                                      mcp->verbose);
+            printf("    last poll failed: %s\n", b);
+            if (0 == ret)
+                ret = mdp->last_res;
+        }
+    }
+fini:
+    for (k = 0; k < mcp->num_devs; ++k) {
+        if (mcp->arr[k].fd >= 0)
+            sg_cmds_close_device(mcp->arr[k].fd);
+    }
+    free(mcp->arr);
+    free(thr);
+    return ret;
 }
 
 int
@@ -151,31 +577,59 @@ main(int argc, char * argv[])
     bool raw = false;
     bool o_readonly = false;
     bool extended = false;
+    bool do_monitor = false;
     bool verbose_given = false;
     bool version_given = false;
     int k, j, off, res, c, report_len, tgt_port_count;
     int sg_fd = -1;
     int ret = 0;
     int verbose = 0;
+    int num_devs = 0;
     uint8_t reportTgtGrpBuff[REPORT_TGT_GRP_BUFF_LEN];
     uint8_t * bp;
     const char * device_name = NULL;
+    char ** dev_names = NULL;
+    struct mon_coll_t mc;
+
+    memset(&mc, 0, sizeof(mc));
+    mc.interval_ms = DEF_MON_INTERVAL_MS;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "dehHrRvV", long_options,
+        c = getopt_long(argc, argv, "c:defhHi:mrRvV", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'c':
+            mc.count = sg_get_num(optarg);
+            if (mc.count < 0) {
+                pr2serr("bad argument to '--count'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'd':
             decode = true;
             break;
         case 'e':
              extended = true;
              break;
+        case 'f':
+            mc.failover = true;
+            break;
+        case 'i':
+            mc.interval_ms = sg_get_num(optarg);
+            if (mc.interval_ms < 1) {
+                pr2serr("bad argument to '--interval', expect 1 or more "
+                        "milliseconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'm':
+            do_monitor = true;
+            break;
         case 'h':
         case '?':
             usage();
@@ -203,13 +657,13 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
+        device_name = argv[optind];
+        dev_names = argv + optind;
+        num_devs = argc - optind;
+        if ((num_devs > 1) && (! do_monitor)) {
+            for (++optind; optind < argc; ++optind)
                 pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+            pr2serr("more than one DEVICE needs '--monitor'\n");
             usage();
             return SG_LIB_SYNTAX_ERROR;
         }
@@ -239,6 +693,19 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (do_monitor) {
+        if (raw || hex) {
+            pr2serr("'--monitor' cannot be used with '--hex' or '--raw'\n");
+            return SG_LIB_CONTRADICT;
+        }
+        mc.num_devs = num_devs;
+        mc.verbose = verbose;
+        ret = monitor(&mc, dev_names, o_readonly);
+        goto err_out;
+    } else if (mc.failover || mc.count) {
+        pr2serr("'--count=' and '--failover' need '--monitor'\n");
+        return SG_LIB_CONTRADICT;
+    }
     if (raw) {
         if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
             perror("sg_set_binary_mode");
@@ -16,7 +16,11 @@
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <time.h>
 #include <getopt.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -34,7 +38,7 @@
  *  to the 'SCSI Accessed Fault-Tolerant Enclosures' (SAF-TE) spec.
  */
 
-static const char * version_str = "0.33 20180628";
+static const char * version_str = "0.34 20261014";
 
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
@@ -125,6 +129,83 @@ print_safte_configuration(void)
     return 0;
 }
 
+static const char *
+fan_status_str(int v)
+{
+    switch (v) {
+    case 0:
+        return "operational";
+    case 1:
+        return "malfunctioning";
+    case 2:
+        return "not installed";
+    case 80:
+        return "not reportable";
+    default:
+        return "unknown";
+    }
+}
+
+static const char *
+psupply_status_str(int v)
+{
+    switch (v) {
+    case 0:
+        return "operational / on";
+    case 1:
+        return "operational / off";
+    case 0x10:
+        return "malfunctioning / on";
+    case 0x11:
+        return "malfunctioning / off";
+    case 0x20:
+        return "not present";
+    case 0x21:
+        return "present";
+    case 0x80:
+        return "not reportable";
+    default:
+        return "unknown";
+    }
+}
+
+/* Returns NULL for values not defined */
+static const char *
+door_lock_str(int v)
+{
+    switch (v) {
+    case 0x0:
+        return "locked";
+    case 0x01:
+        return "unlocked";
+    case 0x80:
+        return "not reportable";
+    default:
+        return NULL;
+    }
+}
+
+/* Returns NULL for values not defined */
+static const char *
+speaker_str(int v)
+{
+    switch (v) {
+    case 0x0:
+        return "off";
+    case 0x01:
+        return "on";
+    default:
+        return NULL;
+    }
+}
+
+static unsigned int
+encl_status_len(void)
+{
+    return safte_cfg.fans + safte_cfg.psupplies + safte_cfg.slots +
+           safte_cfg.temps + 5 + safte_cfg.vendor_specific;
+}
+
 /* Buffer ID 0x01: Read Enclosure Status (mandatory) */
 static int
 do_safte_encl_status(int sg_fd, int do_hex, int do_raw, int verbose)
@@ -133,8 +214,7 @@ do_safte_encl_status(int sg_fd, int do_hex, int do_raw, int verbose)
     unsigned int rb_len;
     uint8_t *rb_buff;
 
-    rb_len = safte_cfg.fans + safte_cfg.psupplies + safte_cfg.slots +
-        safte_cfg.temps + 5 + safte_cfg.vendor_specific;
+    rb_len = encl_status_len();
     rb_buff = (uint8_t *)malloc(rb_len);
 
 
@@ -156,57 +236,13 @@ do_safte_encl_status(int sg_fd, int do_hex, int do_raw, int verbose)
     }
     printf("Enclosure Status:\n");
     offset = 0;
-    for (i = 0; i < safte_cfg.fans; i++) {
-        printf("\tFan %d status: ", i);
-        switch(rb_buff[i]) {
-            case 0:
-                printf("operational\n");
-                break;
-            case 1:
-                printf("malfunctioning\n");
-                break;
-            case 2:
-                printf("not installed\n");
-                break;
-            case 80:
-                printf("not reportable\n");
-                break;
-            default:
-                printf("unknown\n");
-                break;
-        }
-    }
+    for (i = 0; i < safte_cfg.fans; i++)
+        printf("\tFan %d status: %s\n", i, fan_status_str(rb_buff[i]));
 
     offset += safte_cfg.fans;
-    for (i = 0; i < safte_cfg.psupplies; i++) {
-        printf("\tPower supply %d status: ", i);
-        switch(rb_buff[i + offset]) {
-            case 0:
-                printf("operational / on\n");
-                break;
-            case 1:
-                printf("operational / off\n");
-                break;
-            case 0x10:
-                printf("malfunctioning / on\n");
-                break;
-            case 0x11:
-                printf("malfunctioning / off\n");
-                break;
-            case 0x20:
-                printf("not present\n");
-                break;
-            case 0x21:
-                printf("present\n");
-                break;
-            case 0x80:
-                printf("not reportable\n");
-                break;
-            default:
-                printf("unknown\n");
-                break;
-        }
-    }
+    for (i = 0; i < safte_cfg.psupplies; i++)
+        printf("\tPower supply %d status: %s\n", i,
+               psupply_status_str(rb_buff[i + offset]));
 
     offset += safte_cfg.psupplies;
     for (i = 0; i < safte_cfg.slots; i++) {
@@ -215,17 +251,9 @@ do_safte_encl_status(int sg_fd, int do_hex, int do_raw, int verbose)
 
     offset += safte_cfg.slots;
     if (safte_cfg.flags & SAFTE_CFG_FLAG_DOORLOCK) {
-        switch(rb_buff[offset]) {
-            case 0x0:
-                printf("\tDoor lock status: locked\n");
-                break;
-            case 0x01:
-                printf("\tDoor lock status: unlocked\n");
-                break;
-            case 0x80:
-                printf("\tDoor lock status: not reportable\n");
-                break;
-        }
+        if (door_lock_str(rb_buff[offset]))
+            printf("\tDoor lock status: %s\n",
+                   door_lock_str(rb_buff[offset]));
     } else {
         printf("\tDoor lock status: not installed\n");
     }
@@ -233,16 +261,8 @@ do_safte_encl_status(int sg_fd, int do_hex, int do_raw, int verbose)
     offset++;
     if (!(safte_cfg.flags & SAFTE_CFG_FLAG_ALARM)) {
         printf("\tSpeaker status: not installed\n");
-    } else {
-        switch(rb_buff[offset]) {
-            case 0x0:
-                printf("\tSpeaker status: off\n");
-                break;
-            case 0x01:
-                printf("\tSpeaker status: on\n");
-                break;
-        }
-    }
+    } else if (speaker_str(rb_buff[offset]))
+        printf("\tSpeaker status: %s\n", speaker_str(rb_buff[offset]));
 
     offset++;
     for (i = 0; i < safte_cfg.temps; i++) {
@@ -471,6 +491,131 @@ do_safte_global_flags(int sg_fd, int do_hex, int do_raw, int verbose)
     return 0;
 }
 
+/* Outputs, prefixed by 'when', the fields of the Read Enclosure Status
+ * response 'cur' that differ from those in 'prev'. Temperature readings
+ * are only output when verbose since they drift; the thermostat alert
+ * status is always compared. Returns the number of lines output. */
+static int
+watch_show(const uint8_t * prev, const uint8_t * cur, const char * when,
+           int verbose)
+{
+    int i, off, n;
+    int is_celsius = !!(safte_cfg.flags & SAFTE_CFG_FLAG_CELSIUS);
+
+    n = 0;
+    off = 0;
+    for (i = 0; i < safte_cfg.fans; ++i, ++off) {
+        if (prev[off] != cur[off]) {
+            printf("%s  Fan %d status: %s -> %s\n", when, i,
+                   fan_status_str(prev[off]), fan_status_str(cur[off]));
+            ++n;
+        }
+    }
+    for (i = 0; i < safte_cfg.psupplies; ++i, ++off) {
+        if (prev[off] != cur[off]) {
+            printf("%s  Power supply %d status: %s -> %s\n", when, i,
+                   psupply_status_str(prev[off]),
+                   psupply_status_str(cur[off]));
+            ++n;
+        }
+    }
+    for (i = 0; i < safte_cfg.slots; ++i, ++off) {
+        if (prev[off] != cur[off]) {
+            printf("%s  Device Slot %d: SCSI ID %d -> %d\n", when, i,
+                   prev[off], cur[off]);
+            ++n;
+        }
+    }
+    if ((safte_cfg.flags & SAFTE_CFG_FLAG_DOORLOCK) &&
+        (prev[off] != cur[off])) {
+        printf("%s  Door lock status: %s -> %s\n", when,
+               door_lock_str(prev[off]) ? door_lock_str(prev[off]) :
+                                          "unknown",
+               door_lock_str(cur[off]) ? door_lock_str(cur[off]) :
+                                         "unknown");
+        ++n;
+    }
+    ++off;
+    if ((safte_cfg.flags & SAFTE_CFG_FLAG_ALARM) &&
+        (prev[off] != cur[off])) {
+        printf("%s  Speaker status: %s -> %s\n", when,
+               speaker_str(prev[off]) ? speaker_str(prev[off]) : "unknown",
+               speaker_str(cur[off]) ? speaker_str(cur[off]) : "unknown");
+        ++n;
+    }
+    ++off;
+    for (i = 0; i < safte_cfg.temps; ++i, ++off) {
+        if (verbose && (prev[off] != cur[off])) {
+            printf("%s  Temperature sensor %d: %d -> %d deg %c\n", when, i,
+                   prev[off] - (is_celsius ? 0 : 10),
+                   cur[off] - (is_celsius ? 0 : 10), is_celsius ? 'C' : 'F');
+            ++n;
+        }
+    }
+    if (safte_cfg.thermostats && ((prev[off] ^ cur[off]) & 0x80)) {
+        printf("%s  Enclosure Temperature alert status: %s -> %s\n", when,
+               (prev[off] & 0x80) ? "abnormal" : "normal",
+               (cur[off] & 0x80) ? "abnormal" : "normal");
+        ++n;
+    }
+    return n;
+}
+
+/* Implements --watch=SEC: the enclosure configuration has already been
+ * read, so each poll is a single READ BUFFER of buffer ID 1 (enclosure
+ * status) whose response is compared to the previous one. Runs until
+ * killed or a command fails. */
+static int
+do_safte_watch(int sg_fd, int watch_secs, int verbose)
+{
+    int res;
+    unsigned int rb_len;
+    time_t t;
+    uint8_t * prev;
+    uint8_t * cur;
+    uint8_t * bp;
+    struct tm a_tm;
+    char when[32];
+
+    rb_len = encl_status_len();
+    prev = (uint8_t *)calloc(2, rb_len);
+    if (NULL == prev) {
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    cur = prev + rb_len;
+    res = sg_ll_read_buffer(sg_fd, RWB_MODE_VENDOR, 1, 0, prev, rb_len,
+                            false, verbose);
+    if (res && (res != SG_LIB_CAT_RECOVERED))
+        goto fini;
+    printf("watching enclosure status every %d seconds: %d fans, %d power "
+           "supplies, %d slots\n", watch_secs, safte_cfg.fans,
+           safte_cfg.psupplies, safte_cfg.slots);
+    fflush(stdout);
+    while (true) {
+        sleep(watch_secs);
+        res = sg_ll_read_buffer(sg_fd, RWB_MODE_VENDOR, 1, 0, cur, rb_len,
+                                false, verbose);
+        if (res && (res != SG_LIB_CAT_RECOVERED))
+            break;
+        if (memcmp(prev, cur, rb_len)) {
+            t = time(NULL);
+            if (localtime_r(&t, &a_tm))
+                strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &a_tm);
+            else
+                snprintf(when, sizeof(when), "%" PRId64, (int64_t)t);
+            if (watch_show(prev, cur, when, verbose))
+                fflush(stdout);
+            bp = prev;
+            prev = cur;
+            cur = bp;
+        }
+    }
+fini:
+    free((prev < cur) ? prev : cur);
+    return res;
+}
+
 static void
 usage()
 {
@@ -478,7 +623,7 @@ usage()
             "[--flags] [--help]\n"
             "                 [--hex] [--insertions] [--raw] [--usage] "
             "[--verbose]\n"
-            "                 [--version] DEVICE\n"
+            "                 [--version] [--watch=SEC] DEVICE\n"
             "  where:\n"
             "    --config|-c         output enclosure configuration\n"
             "    --devstatus|-d      output device slot status\n"
@@ -492,7 +637,10 @@ usage()
             "to stdout\n"
             "    --usage|-u          output usage statistics\n"
             "    --verbose|-v        increase verbosity\n"
-            "    --version|-v        output version then exit\n\n"
+            "    --version|-v        output version then exit\n"
+            "    --watch=SEC|-w SEC  poll enclosure status every SEC "
+            "seconds and\n"
+            "                        output what changed (until killed)\n\n"
             "Queries a SAF-TE processor device\n");
 }
 
@@ -508,6 +656,7 @@ static struct option long_options[] = {
     {"usage", 0, 0, 'u'},
     {"verbose", 0, 0, 'v'},
     {"version", 0, 0, 'V'},
+    {"watch", required_argument, 0, 'w'},
     {0, 0, 0, 0},
 };
 
@@ -532,6 +681,7 @@ main(int argc, char * argv[])
     int do_hex = 0;
     int do_raw = 0;
     int verbose = 0;
+    int watch_secs = 0;
     const char * cp;
     char buff[48];
     char b[80];
@@ -541,7 +691,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "cdfhHirsuvV?", long_options,
+        c = getopt_long(argc, argv, "cdfhHirsuvVw:?", long_options,
                         &option_index);
 
         if (c == -1)
@@ -583,6 +733,14 @@ main(int argc, char * argv[])
             case 'V':
                 version_given = true;
                 break;
+            case 'w':
+                watch_secs = sg_get_num_nomult(optarg);
+                if (watch_secs < 1) {
+                    pr2serr("bad argument to '--watch=SEC', expect 1 or "
+                            "more seconds\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                break;
             default:
                 pr2serr("unrecognised option code 0x%x ??\n", c);
                 usage();
@@ -628,6 +786,10 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    if ((watch_secs > 0) && (do_hex || do_raw)) {
+        pr2serr("--watch= cannot be used with --hex or --raw\n");
+        return SG_LIB_CONTRADICT;
+    }
     if (do_raw) {
         if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
             perror("sg_set_binary_mode");
@@ -744,6 +906,11 @@ main(int argc, char * argv[])
                 goto err_out;
         }
     }
+
+    if (watch_secs > 0) {
+        res = do_safte_watch(sg_fd, watch_secs, verbose);
+        goto err_out;
+    }
 finish:
     res = 0;
 
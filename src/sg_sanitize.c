@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011-2019 Douglas Gilbert.
+ * Copyright (c) 2011-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -33,7 +33,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.12 20190113";
+static const char * version_str = "1.14 20261014";
 
 /* Not all environments support the Unix sleep() */
 #if defined(MSC_VER) || defined(__MINGW32__)
@@ -55,7 +55,6 @@ static const char * version_str = "1.12 20190113";
 #define SANITIZE_SA_BLOCK_ERASE 0x2
 #define SANITIZE_SA_CRYPTO_ERASE 0x3
 #define SANITIZE_SA_EXIT_FAIL_MODE 0x1f
-#define DEF_REQS_RESP_LEN 252
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define MAX_XFER_LEN 65535
 #define EBUFF_SZ 256
@@ -63,7 +62,9 @@ static const char * version_str = "1.12 20190113";
 #define SHORT_TIMEOUT 20   /* 20 seconds unless immed=0 ... */
 #define LONG_TIMEOUT (15 * 3600)       /* 15 hours ! */
                 /* Seagate ST32000444SS 2TB disk takes 9.5 hours to format */
-#define POLL_DURATION_SECS 60
+#define POLL_DURATION_SECS 60    /* longest wait between polls */
+#define POLL_MIN_SECS 5         /* shortest, also before the first */
+#define NS_PER_SEC 1000000000ULL
 
 
 static struct option long_options[] = {
@@ -112,7 +113,17 @@ struct opts_t {
     int timeout;        /* in seconds */
     int verbose;
     int zero;
+    int num_devs;               /* DEVICE arguments given */
     const char * pattern_fn;
+    char ** dev_names;          /* num_devs of them, from argv */
+};
+
+struct multi_ctx {      /* for progress_multi_cb() */
+    int num;
+    int active;
+    uint64_t last_ns;           /* when the summary was last output */
+    struct sg_progress_dev * pds;
+    const struct opts_t * op;
 };
 
 
@@ -127,7 +138,7 @@ usage()
           "[--test=TE]\n"
           "                   [--timeout=SECS] [--verbose] [--version] "
           "[--wait]\n"
-          "                   [--zero] [--znr] DEVICE\n"
+          "                   [--zero] [--znr] DEVICE [DEVICE...]\n"
           "  where:\n"
           "    --ause|-A            set AUSE bit in cdb\n"
           "    --block|-B           do BLOCK ERASE sanitize\n"
@@ -171,9 +182,11 @@ usage()
           "Performs a SCSI SANITIZE command.\n    <<<WARNING>>>: all data "
           "on DEVICE will be lost.\nDefault action is to give user time to "
           "reconsider; then execute SANITIZE\ncommand with IMMED bit set; "
-          "then use REQUEST SENSE command every 60\nseconds to poll for a "
-          "progress indication; then exit when there is no\nmore progress "
-          "indication.\n"
+          "then use REQUEST SENSE command (at most\nevery 60 seconds) to "
+          "poll for a progress indication; then exit when there\nis no "
+          "more progress indication. With more than one DEVICE, SANITIZE "
+          "is\nstarted on each then all are polled together and a status "
+          "report for each\nis output at the end.\n"
           );
 }
 
@@ -278,61 +291,49 @@ do_sanitize(int sg_fd, const struct opts_t * op, const void * param_lstp,
 }
 
 #define VPD_DEVICE_ID 0x83
-#define VPD_ASSOC_LU 0
-#define VPD_ASSOC_TPORT 1
 #define TPROTO_ISCSI 5
 
 static char *
 get_lu_name(const uint8_t * bp, int u_len, char * b, int b_len)
 {
-    int len, off, sns_dlen, dlen, k;
-    uint8_t u_sns[512];
+    int off, dlen, k;
+    const uint8_t * dp;
     char * cp;
+    struct sg_vpd_dev_id_idx di;
 
-    len = u_len - 4;
     bp += 4;
-    off = -1;
-    if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_LU,
-                                8 /* SCSI name string (sns) */,
-                                3 /* UTF-8 */)) {
-        sns_dlen = bp[off + 3];
-        memcpy(u_sns, bp + off + 4, sns_dlen);
-        /* now want to check if this is iSCSI */
-        off = -1;
-        if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_TPORT,
-                                    8 /* SCSI name string (sns) */,
-                                    3 /* UTF-8 */)) {
-            if ((0x80 & bp[1]) && (TPROTO_ISCSI == (bp[0] >> 4))) {
-                snprintf(b, b_len, "%.*s", sns_dlen, u_sns);
-                return b;
-            }
+    sg_vpd_dev_id_index(bp, u_len - 4, &di);
+    if ((di.lu_sns >= 0) && (di.tport_sns >= 0)) {
+        /* want the SCSI name string if this is iSCSI */
+        dp = bp + di.tport_sns;
+        if ((0x80 & dp[1]) && (TPROTO_ISCSI == (dp[0] >> 4))) {
+            snprintf(b, b_len, "%.*s", bp[di.lu_sns + 3],
+                     (const char *)(bp + di.lu_sns + 4));
+            return b;
         }
-    } else
-        sns_dlen = 0;
-    if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_LU,
-                                3 /* NAA */, 1 /* binary */)) {
+    }
+    if (di.lu_naa >= 0) {
+        off = di.lu_naa;
         dlen = bp[off + 3];
         if (! ((8 == dlen) || (16 ==dlen)))
             return b;
-        cp = b;
-        for (k = 0; ((k < dlen) && (b_len > 1)); ++k) {
-            snprintf(cp, b_len, "%02x", bp[off + 4 + k]);
-            cp += 2;
-            b_len -= 2;
-        }
-    } else if (0 == sg_vpd_dev_id_iter(bp, len, &off, VPD_ASSOC_LU,
-                                       2 /* EUI */, 1 /* binary */)) {
+    } else if (di.lu_eui64 >= 0) {
+        off = di.lu_eui64;
         dlen = bp[off + 3];
         if (! ((8 == dlen) || (12 == dlen) || (16 ==dlen)))
             return b;
-        cp = b;
-        for (k = 0; ((k < dlen) && (b_len > 1)); ++k) {
-            snprintf(cp, b_len, "%02x", bp[off + 4 + k]);
-            cp += 2;
-            b_len -= 2;
-        }
-    } else if (sns_dlen > 0)
-        snprintf(b, b_len, "%.*s", sns_dlen, u_sns);
+    } else {
+        if (di.lu_sns >= 0)
+            snprintf(b, b_len, "%.*s", bp[di.lu_sns + 3],
+                     (const char *)(bp + di.lu_sns + 4));
+        return b;
+    }
+    cp = b;
+    for (k = 0; ((k < dlen) && (b_len > 1)); ++k) {
+        snprintf(cp, b_len, "%02x", bp[off + 4 + k]);
+        cp += 2;
+        b_len -= 2;
+    }
     return b;
 }
 
@@ -443,18 +444,209 @@ print_dev_id(int fd, uint8_t * sinq_resp, int max_rlen, int verbose)
 }
 
 
+/* Called by sg_progress_run() after each REQUEST SENSE poll */
+static bool
+progress_cb(struct sg_progress_dev * dp, void * ctx)
+{
+    const struct opts_t * op = (const struct opts_t *)ctx;
+
+    if (SG_PROGRESS_ACTIVE == dp->state)
+        printf("Progress indication: %d%% done\n",
+               (dp->progress * 100) / 65536);
+    if (op->dry_run && (SG_PROGRESS_ACTIVE == dp->state)) {
+        pr2serr("Due to --dry-run option, leave poll loop\n");
+        return false;
+    }
+    return true;
+}
+
+/* Called by sg_progress_run() after each poll when there is more than one
+ * DEVICE. Reports each device as it finishes and, every
+ * POLL_DURATION_SECS, how many are still in progress. */
+static bool
+progress_multi_cb(struct sg_progress_dev * dp, void * ctx)
+{
+    int k, least;
+    uint64_t now;
+    struct multi_ctx * mcp = (struct multi_ctx *)ctx;
+    const char * name = (const char *)dp->user;
+
+    if (SG_PROGRESS_ACTIVE != dp->state) {
+        --mcp->active;
+        printf("%s: sanitize %s after %" PRIu64 " seconds\n", name,
+               (SG_PROGRESS_DONE == dp->state) ? "complete" : "FAILED",
+               (uint64_t)((dp->end_ns - dp->start_ns) / NS_PER_SEC));
+        return true;
+    }
+    if (mcp->op->verbose)
+        printf("%s: progress indication: %d%% done\n", name,
+               (dp->progress * 100) / 65536);
+    now = sg_pt_lat_now_ns();
+    if ((now - mcp->last_ns) < (POLL_DURATION_SECS * NS_PER_SEC))
+        return true;
+    mcp->last_ns = now;
+    for (k = 0, least = 65536; k < mcp->num; ++k) {
+        if ((SG_PROGRESS_ACTIVE == mcp->pds[k].state) &&
+            (mcp->pds[k].progress < least))
+            least = mcp->pds[k].progress;
+    }
+    printf("%d of %d sanitizes in progress, least done: %d%%\n",
+           mcp->active, mcp->num, (least < 0) ? 0 : (least * 100) / 65536);
+    return true;
+}
+
+/* With more than one DEVICE: starts SANITIZE with IMMED set on each of
+ * them, then (unless --early) polls them all from this thread until none
+ * are in progress and outputs a status line for each. Returns 0 if the
+ * sanitize succeeded on every DEVICE, else the error of the first that
+ * failed. */
+static int
+multi_sanitize(const struct opts_t * op, const void * param_lstp,
+               int param_lst_len)
+{
+    int k, n, fd;
+    int num_started = 0;
+    int num_failed = 0;
+    int ret = 0;
+    int vb = op->verbose;
+    uint64_t longest = 0;
+    int * fds;
+    int * starts;
+    struct sg_progress_dev * pds;
+    struct multi_ctx mc;
+    char b[80];
+    char c[80];
+    uint8_t inq_resp[SAFE_STD_INQ_RESP_LEN];
+
+    n = op->num_devs;
+    fds = (int *)calloc(n, sizeof(int));
+    starts = (int *)calloc(n, sizeof(int));
+    pds = (struct sg_progress_dev *)calloc(n, sizeof(*pds));
+    if ((NULL == fds) || (NULL == starts) || (NULL == pds)) {
+        pr2serr("unable to allocate memory for %d devices\n", n);
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < n; ++k) {
+        printf("%s:\n", op->dev_names[k]);
+        fd = sg_cmds_open_device(op->dev_names[k], false /* rw */, vb);
+        if (fd < 0) {
+            pr2serr(ME "open error: %s: %s\n", op->dev_names[k],
+                    safe_strerror(-fd));
+            starts[k] = sg_convert_errno(-fd);
+            fds[k] = -1;
+            continue;
+        }
+        fds[k] = fd;
+        starts[k] = print_dev_id(fd, inq_resp, sizeof(inq_resp), vb);
+    }
+
+    if ((! op->quick) && (! op->fail)) {
+        for (k = 15; k > 0; k -= 5) {
+            printf("\nA SANITIZE will commence in %d seconds\n", k);
+            printf("    ALL data on the %d devices above will be "
+                   "DESTROYED\n", n);
+            printf("        Press control-C to abort\n");
+            sleep_for(5);
+        }
+    }
+
+    for (k = 0; k < n; ++k) {
+        if (starts[k])
+            continue;
+        starts[k] = do_sanitize(fds[k], op, param_lstp, param_lst_len);
+        if (starts[k]) {
+            sg_get_category_sense_str(starts[k], sizeof(b), b, vb);
+            pr2serr("%s: sanitize failed: %s\n", op->dev_names[k], b);
+            continue;
+        }
+        sg_progress_init(pds + num_started, fds[k], true,
+                         POLL_MIN_SECS * NS_PER_SEC,
+                         POLL_DURATION_SECS * NS_PER_SEC);
+        pds[num_started].desc = op->desc;
+        pds[num_started].user = (void *)op->dev_names[k];
+        ++num_started;
+    }
+    if (op->early || op->dry_run) {
+        printf("Sanitize started on %d of %d devices%s\n", num_started, n,
+               op->dry_run ? " (dry run)" : "");
+        for (k = 0; k < n; ++k) {
+            if (starts[k] && (0 == ret))
+                ret = starts[k];
+        }
+        goto fini;
+    }
+
+    memset(&mc, 0, sizeof(mc));
+    mc.num = num_started;
+    mc.active = num_started;
+    mc.last_ns = sg_pt_lat_now_ns();
+    mc.pds = pds;
+    mc.op = op;
+    sg_progress_run(pds, num_started, progress_multi_cb, &mc, vb);
+
+    printf("\nSanitize status of %d devices:\n", n);
+    for (k = 0, num_started = 0; k < n; ++k) {
+        struct sg_progress_dev * dp;
+        uint64_t secs;
+
+        if (starts[k]) {
+            sg_get_category_sense_str(starts[k], sizeof(b), b, vb);
+            printf("  %s: not started: %s\n", op->dev_names[k], b);
+            ++num_failed;
+            if (0 == ret)
+                ret = starts[k];
+            continue;
+        }
+        dp = pds + num_started++;
+        secs = (uint64_t)((dp->end_ns - dp->start_ns) / NS_PER_SEC);
+        if (secs > longest)
+            longest = secs;
+        if (SG_PROGRESS_DONE == dp->state) {
+            printf("  %s: complete in %" PRIu64 " seconds\n",
+                   op->dev_names[k], secs);
+            continue;
+        }
+        ++num_failed;
+        if (0 == ret)
+            ret = dp->res ? dp->res : SG_LIB_CAT_OTHER;
+        if (dp->sense_key > 0)
+            printf("  %s: FAILED after %" PRIu64 " seconds: %s, %s\n",
+                   op->dev_names[k], secs,
+                   sg_get_sense_key_str(dp->sense_key, sizeof(b), b),
+                   sg_get_asc_ascq_str(dp->asc, dp->ascq, sizeof(c), c));
+        else {
+            sg_get_category_sense_str(dp->res, sizeof(b), b, vb);
+            printf("  %s: FAILED after %" PRIu64 " seconds: Request Sense: "
+                   "%s\n", op->dev_names[k], secs, b);
+        }
+    }
+    printf("%d devices: %d complete, %d failed or not started; longest "
+           "%" PRIu64 " seconds\n", n, n - num_failed, num_failed, longest);
+fini:
+    if (fds) {
+        for (k = 0; k < n; ++k) {
+            if (fds[k] >= 0)
+                sg_cmds_close_device(fds[k]);
+        }
+        free(fds);
+    }
+    free(starts);
+    free(pds);
+    return ret;
+}
+
 int
 main(int argc, char * argv[])
 {
     bool got_stdin = false;
-    int k, res, c, infd, progress, vb, n, resp_len, err;
+    int res, c, infd, vb, n, err;
     int sg_fd = -1;
     int param_lst_len = 0;
     int ret = -1;
     const char * device_name = NULL;
     char ebuff[EBUFF_SZ];
     char b[80];
-    uint8_t rsBuff[DEF_REQS_RESP_LEN];
     uint8_t * wBuff = NULL;
     uint8_t * free_wBuff = NULL;
     struct opts_t opts;
@@ -562,16 +754,9 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        device_name = argv[optind];
+        op->dev_names = argv + optind;
+        op->num_devs = argc - optind;
     }
 #ifdef DEBUG
     pr2serr("In DEBUG mode, ");
@@ -600,6 +785,10 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
     vb = op->verbose;
+    if ((op->num_devs > 1) && op->wait) {
+        pr2serr("with more than one DEVICE '--wait' cannot be used\n");
+        return SG_LIB_CONTRADICT;
+    }
     n = (int)op->block + (int)op->crypto + (int)op->fail + (int)op->overwrite;
     if (1 != n) {
         pr2serr("one and only one of '--block', '--crypto', '--fail' or "
@@ -647,19 +836,6 @@ main(int argc, char * argv[])
         }
     }
 
-    sg_fd = sg_cmds_open_device(device_name, false /* rw */, vb);
-    if (sg_fd < 0) {
-        if (op->verbose)
-            pr2serr(ME "open error: %s: %s\n", device_name,
-                    safe_strerror(-sg_fd));
-        ret = sg_convert_errno(-sg_fd);
-        goto err_out;
-    }
-
-    ret = print_dev_id(sg_fd, inq_resp, sizeof(inq_resp), op->verbose);
-    if (ret)
-        goto err_out;
-
     if (op->overwrite) {
         param_lst_len = op->ipl + 4;
         wBuff = (uint8_t*)sg_memalign(op->ipl + 4, 0, &free_wBuff, false);
@@ -717,6 +893,23 @@ main(int argc, char * argv[])
         sg_put_unaligned_be16((uint16_t)op->ipl, wBuff + 2);
     }
 
+    if (op->num_devs > 1) {
+        ret = multi_sanitize(op, wBuff, param_lst_len);
+        goto err_out;
+    }
+    sg_fd = sg_cmds_open_device(device_name, false /* rw */, vb);
+    if (sg_fd < 0) {
+        if (op->verbose)
+            pr2serr(ME "open error: %s: %s\n", device_name,
+                    safe_strerror(-sg_fd));
+        ret = sg_convert_errno(-sg_fd);
+        goto err_out;
+    }
+
+    ret = print_dev_id(sg_fd, inq_resp, sizeof(inq_resp), op->verbose);
+    if (ret)
+        goto err_out;
+
     if ((! op->quick) && (! op->fail)) {
         printf("\nA SANITIZE will commence in 15 seconds\n");
         printf("    ALL data on %s will be DESTROYED\n", device_name);
@@ -739,55 +932,31 @@ main(int argc, char * argv[])
     }
 
     if ((0 == ret) && (! op->early) && (! op->wait)) {
-        for (k = 0; ;++k) {     /* unbounded, exits via break */
-            if (op->dry_run && (k > 0)) {
-                pr2serr("Due to --dry-run option, leave poll loop\n");
-                break;
-            }
-            sleep_for(POLL_DURATION_SECS);
-            memset(rsBuff, 0x0, sizeof(rsBuff));
-            res = sg_ll_request_sense(sg_fd, op->desc, rsBuff, sizeof(rsBuff),
-                                      1, vb);
-            if (res) {
-                ret = res;
-                if (SG_LIB_CAT_INVALID_OP == res)
-                    pr2serr("Request Sense command not supported\n");
-                else if (SG_LIB_CAT_ILLEGAL_REQ == res) {
-                    pr2serr("bad field in Request Sense cdb\n");
-                    if (op->desc) {
-                        pr2serr("Descriptor type sense may not be supported, "
-                                "try again with fixed type\n");
-                        op->desc = false;
-                        continue;
-                    }
-                } else {
-                    sg_get_category_sense_str(res, sizeof(b), b, vb);
-                    pr2serr("Request Sense: %s\n", b);
-                    if (0 == vb)
-                        pr2serr("    try the '-v' option for more "
-                                "information\n");
-                }
-                break;
-            }
-            /* "Additional sense length" same in descriptor and fixed */
-            resp_len = rsBuff[7] + 8;
-            if (vb > 2) {
-                pr2serr("Parameter data in hex\n");
-                hex2stderr(rsBuff, resp_len, -1);
+        struct sg_progress_dev pd;
+
+        sg_progress_init(&pd, sg_fd, true, POLL_MIN_SECS * NS_PER_SEC,
+                         POLL_DURATION_SECS * NS_PER_SEC);
+        pd.desc = op->desc;
+        sg_progress_run(&pd, 1, progress_cb, op, vb);
+        if (SG_PROGRESS_FAILED == pd.state) {
+            ret = pd.res;
+            if (SG_LIB_CAT_INVALID_OP == ret)
+                pr2serr("Request Sense command not supported\n");
+            else if (pd.sense_key > 0) {
+                pr2serr("Sanitize failed, Request Sense: %s\n",
+                        sg_get_sense_key_str(pd.sense_key, sizeof(b), b));
+                pr2serr("    %s\n", sg_get_asc_ascq_str(pd.asc, pd.ascq,
+                                                       sizeof(ebuff), ebuff));
+            } else {
+                sg_get_category_sense_str(ret, sizeof(b), b, vb);
+                pr2serr("Request Sense: %s\n", b);
+                if (0 == vb)
+                    pr2serr("    try the '-v' option for more "
+                            "information\n");
             }
-            progress = -1;
-            sg_get_sense_progress_fld(rsBuff, resp_len, &progress);
-            if (progress < 0) {
-                ret = res;
-                if (vb > 1)
-                     pr2serr("No progress indication found, iteration %d\n",
-                             k + 1);
-                /* N.B. exits first time there isn't a progress indication */
-                break;
-            } else
-                printf("Progress indication: %d%% done\n",
-                       (progress * 100) / 65536);
-        }
+        } else if ((vb > 1) && (SG_PROGRESS_DONE == pd.state))
+            pr2serr("No progress indication found, iteration %d\n",
+                    pd.polls);
     }
 
 err_out:
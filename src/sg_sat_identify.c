@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006-2018 Douglas Gilbert.
+ * Copyright (c) 2006-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,7 +14,9 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -53,8 +55,31 @@
 #define DEF_TIMEOUT 20
 
 #define EBUFF_SZ 256
+#define DEF_JOBS 16
+#define MAX_JOBS 256
 
-static const char * version_str = "1.17 20180515";
+static const char * version_str = "1.18 20261014";
+
+struct ident_dev_t {    /* for each DEVICE when more than one is given */
+    const char * name;
+    int res;            /* of open or IDENTIFY (PACKET) DEVICE */
+    bool ok;            /* response decoded into ai */
+    struct sg_ata_ident_t ai;
+};
+
+struct ident_coll_t {   /* shared by the workers */
+    bool do_packet;
+    bool ck_cond;
+    bool extend;
+    bool o_readonly;
+    int cdb_len;
+    int verbose;
+    int num;            /* number of DEVICEs */
+    int next_ind;       /* next DEVICE to take, atomic */
+    int next_buf;       /* next response buffer to take, atomic */
+    uint8_t * bufs;     /* one ID_RESPONSE_LEN buffer per worker */
+    struct ident_dev_t * arr;
+};
 
 static struct option long_options[] = {
         {"ck-cond", no_argument, 0, 'c'},
@@ -62,11 +87,13 @@ static struct option long_options[] = {
         {"extend", no_argument, 0, 'e'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
-        {"len", required_argument, 0, 'l'},
         {"ident", no_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
+        {"len", required_argument, 0, 'l'},
         {"packet", no_argument, 0, 'p'},
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
+        {"summary", no_argument, 0, 's'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
         {0, 0, 0, 0},
@@ -78,9 +105,11 @@ usage()
 {
     pr2serr("Usage: sg_sat_identify [--ck_cond] [--extend] [--help] [--hex] "
             "[--ident]\n"
-            "                       [--len=CLEN] [--packet] [--raw] "
-            "[--readonly]\n"
-            "                       [--verbose] [--version] DEVICE\n"
+            "                       [--jobs=J] [--len=CLEN] [--packet] "
+            "[--raw]\n"
+            "                       [--readonly] [--summary] [--verbose] "
+            "[--version]\n"
+            "                       DEVICE [DEVICE...]\n"
             "  where:\n"
             "    --ck_cond|-c     sets ck_cond bit in cdb (def: 0)\n"
             "    --extend|-e      sets extend bit in cdb (def: 0)\n"
@@ -89,6 +118,9 @@ usage()
             "    --ident|-i       output WWN prefixed by 0x, if not "
             "available output\n"
             "                     0x0000000000000000\n"
+            "    --jobs=J|-j J    number of threads used when more than one "
+            "DEVICE\n"
+            "                     is given (def: %d)\n"
             "    --len=CLEN| -l CLEN    CLEN is cdb length: 12, 16 or 32 "
             "bytes\n"
             "                           (default: 16)\n"
@@ -97,12 +129,19 @@ usage()
             "                     command\n"
             "    --raw|-r         output response in binary to stdout\n"
             "    --readonly|-R    open DEVICE read-only (def: read-write)\n"
+            "    --summary|-s     output a decoded summary line (model, "
+            "capacity,\n"
+            "                     features...) for each DEVICE; the default "
+            "when\n"
+            "                     more than one DEVICE is given\n"
             "    --verbose|-v     increase verbosity\n"
             "    --version|-V     print version string and exit\n\n"
             "Performs a ATA IDENTIFY (PACKET) DEVICE command via a SAT "
             "layer using\na SCSI ATA PASS-THROUGH(12), (16) or (32) command. "
             "Only SAT layers\ncompliant with SAT-4 revision 5 or later will "
-            "support the SCSI ATA\nPASS-THROUGH(32) command.\n");
+            "support the SCSI ATA\nPASS-THROUGH(32) command. When more than one "
+            "DEVICE is given they\nare identified concurrently.\n",
+            DEF_JOBS);
 }
 
 static void
@@ -114,10 +153,12 @@ dStrRaw(const uint8_t * str, int len)
         printf("%c", str[k]);
 }
 
+/* Issues the IDENTIFY (PACKET) DEVICE command, placing the response in
+ * inBuff which must be at least ID_RESPONSE_LEN bytes long. Returns 0 or
+ * a SG_LIB_CAT_* value; *okp is set when the response is available. */
 static int
 do_identify_dev(int sg_fd, bool do_packet, int cdb_len, bool ck_cond,
-                bool extend, bool do_ident, int do_hex, bool do_raw,
-                int verbose)
+                bool extend, uint8_t * inBuff, bool * okp, int verbose)
 {
     bool t_type = false;/* false -> 512 byte blocks,
                            true -> device's LB size */
@@ -127,15 +168,13 @@ do_identify_dev(int sg_fd, bool do_packet, int cdb_len, bool ck_cond,
     bool got_ard = false;         /* got ATA result descriptor */
     bool got_fixsense = false;    /* got ATA result in fixed format sense */
     bool ok;
-    int j, res, ret, sb_sz;
+    int res, ret, sb_sz;
     /* Following for ATA READ/WRITE MULTIPLE (EXT) cmds, normally 0 */
     int multiple_count = 0;
     int protocol = 4;   /* PIO data-in */
     int t_length = 2;   /* 0 -> no data transferred, 2 -> sector count */
     int resid = 0;
-    uint64_t ull;
     struct sg_scsi_sense_hdr ssh;
-    uint8_t inBuff[ID_RESPONSE_LEN];
     uint8_t sense_buffer[64];
     uint8_t ata_return_desc[16];
     uint8_t apt_cdb[SAT_ATA_PASS_THROUGH16_LEN] =
@@ -145,8 +184,8 @@ do_identify_dev(int sg_fd, bool do_packet, int cdb_len, bool ck_cond,
                 {SAT_ATA_PASS_THROUGH12, 0, 0, 0, 0, 0, 0, 0,
                  0, 0, 0, 0};
     uint8_t apt32_cdb[SAT_ATA_PASS_THROUGH32_LEN];
-    const unsigned short * usp;
 
+    *okp = false;
     sb_sz = sizeof(sense_buffer);
     memset(sense_buffer, 0, sb_sz);
     memset(apt32_cdb, 0, sizeof(apt32_cdb));
@@ -357,38 +396,192 @@ do_identify_dev(int sg_fd, bool do_packet, int cdb_len, bool ck_cond,
         }
         ok = true;
     }
+    *okp = ok;
+    return 0;
+}
 
-    if (ok) { /* output result if it is available */
-        if (do_raw)
-            dStrRaw(inBuff, 512);
-        else if (0 == do_hex) {
-            if (do_ident) {
-                usp = (const unsigned short *)inBuff;
-                ull = 0;
-                for (j = 0; j < 4; ++j) {
-                    if (j > 0)
-                        ull <<= 16;
-                    ull |= usp[108 + j];
-                }
-                printf("0x%016" PRIx64 "\n", ull);
-            } else {
-                printf("Response for IDENTIFY %sDEVICE ATA command:\n",
-                       (do_packet ? "PACKET " : ""));
-                dWordHex((const unsigned short *)inBuff, 256, 0,
-                         sg_is_big_endian());
+static void
+show_identify(const uint8_t * inBuff, bool do_packet, bool do_ident,
+              int do_hex, bool do_raw)
+{
+    int j;
+    uint64_t ull;
+    const unsigned short * usp;
+
+    if (do_raw)
+        dStrRaw(inBuff, 512);
+    else if (0 == do_hex) {
+        if (do_ident) {
+            usp = (const unsigned short *)inBuff;
+            ull = 0;
+            for (j = 0; j < 4; ++j) {
+                if (j > 0)
+                    ull <<= 16;
+                ull |= usp[108 + j];
             }
-        } else if (1 == do_hex)
-            hex2stdout(inBuff, 512, 0);
-        else if (2 == do_hex)
+            printf("0x%016" PRIx64 "\n", ull);
+        } else {
+            printf("Response for IDENTIFY %sDEVICE ATA command:\n",
+                   (do_packet ? "PACKET " : ""));
             dWordHex((const unsigned short *)inBuff, 256, 0,
                      sg_is_big_endian());
-        else if (3 == do_hex) /* '-HHH' suitable for "hdparm --Istdin" */
-            dWordHex((const unsigned short *)inBuff, 256, -2,
-                     sg_is_big_endian());
-        else     /* '-HHHH' hex bytes only */
-            hex2stdout(inBuff, 512, -1);
+        }
+    } else if (1 == do_hex)
+        hex2stdout(inBuff, 512, 0);
+    else if (2 == do_hex)
+        dWordHex((const unsigned short *)inBuff, 256, 0,
+                 sg_is_big_endian());
+    else if (3 == do_hex) /* '-HHH' suitable for "hdparm --Istdin" */
+        dWordHex((const unsigned short *)inBuff, 256, -2,
+                 sg_is_big_endian());
+    else     /* '-HHHH' hex bytes only */
+        hex2stdout(inBuff, 512, -1);
+}
+
+/* Outputs one line for a decoded IDENTIFY (PACKET) DEVICE response,
+ * prefixed by 'leadin'. */
+static void
+show_summary(const char * leadin, const struct sg_ata_ident_t * aip)
+{
+    uint64_t cap;
+    static const char * gen_arr[] = {"", ", SATA 1.5 Gbps", ", SATA 3 Gbps",
+                                     ", SATA 6 Gbps"};
+
+    printf("%s%s  %s  %s", leadin, (aip->model[0] ? aip->model : "-"),
+           (aip->serial[0] ? aip->serial : "-"),
+           (aip->fw_rev[0] ? aip->fw_rev : "-"));
+    if (aip->atapi) {
+        printf(", ATAPI\n");
+        return;
     }
-    return 0;
+    cap = aip->num_lbs * aip->lb_sz;
+    printf(", %" PRIu64 " x %u", aip->num_lbs, aip->lb_sz);
+    if (aip->pb_sz != aip->lb_sz)
+        printf(" (%u phys)", aip->pb_sz);
+    printf(" [%.1f GB]", (double)cap / 1000000000.0);
+    if (aip->wwn)
+        printf(", wwn 0x%016" PRIx64, aip->wwn);
+    if (1 == aip->rotation)
+        printf(", ssd");
+    else if (aip->rotation)
+        printf(", %d rpm", aip->rotation);
+    printf("%s", gen_arr[aip->sata_gen]);
+    printf(",%s%s%s%s%s%s\n", (aip->lba48 ? " lba48" : ""),
+           (aip->ncq ? " ncq" : ""), (aip->smart ? " smart" : ""),
+           (aip->trim ? " trim" : ""), (aip->security ? " security" : ""),
+           (aip->sanitize ? " sanitize" : ""));
+}
+
+/* Takes DEVICEs until none are left: opens, identifies then decodes into
+ * the DEVICE's entry. Each worker reuses the one response buffer. */
+static void *
+ident_worker(void * v_icp)
+{
+    int k, fd;
+    struct ident_coll_t * icp = (struct ident_coll_t *)v_icp;
+    struct ident_dev_t * idp;
+    uint8_t * bp;
+
+    k = __atomic_fetch_add(&icp->next_buf, 1, __ATOMIC_RELAXED);
+    bp = icp->bufs + (k * ID_RESPONSE_LEN);
+    while ((k = __atomic_fetch_add(&icp->next_ind, 1, __ATOMIC_RELAXED))
+           < icp->num) {
+        idp = icp->arr + k;
+        fd = sg_cmds_open_device(idp->name, icp->o_readonly, icp->verbose);
+        if (fd < 0) {
+            idp->res = sg_convert_errno(-fd);
+            continue;
+        }
+        idp->res = do_identify_dev(fd, icp->do_packet, icp->cdb_len,
+                                   icp->ck_cond, icp->extend, bp, &idp->ok,
+                                   icp->verbose);
+        if (idp->res < 0)
+            idp->res = SG_LIB_CAT_OTHER;
+        else if ((0 == idp->res) && idp->ok)
+            sg_ata_ident_decode(bp, ID_RESPONSE_LEN, &idp->ai);
+        sg_cmds_close_device(fd);
+    }
+    return NULL;
+}
+
+/* Identifies the num DEVICEs in dev_names from num_thr threads then
+ * outputs, in the given order, a summary line (or the WWN when do_ident)
+ * for each. Returns 0 if all were identified, else the first error. */
+static int
+multi_identify(struct ident_coll_t * icp, char ** dev_names, int num_thr,
+               bool do_ident)
+{
+    int k, err;
+    int num_ok = 0;
+    int ret = 0;
+    struct ident_dev_t * idp;
+    pthread_t * tids;
+    uint8_t * free_bufs = NULL;
+    char b[80];
+
+    icp->arr = (struct ident_dev_t *)calloc(icp->num, sizeof(*icp->arr));
+    tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+    /* one page aligned allocation holds the response buffers of all the
+     * workers (and of the main thread if no thread starts) */
+    icp->bufs = sg_memalign(num_thr * ID_RESPONSE_LEN, 0, &free_bufs,
+                            false);
+    if ((NULL == icp->arr) || (NULL == tids) || (NULL == icp->bufs)) {
+        pr2serr("unable to allocate memory for %d devices\n", icp->num);
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < icp->num; ++k)
+        icp->arr[k].name = dev_names[k];
+    for (k = 0; k < num_thr; ++k) {
+        err = pthread_create(tids + k, NULL, ident_worker, icp);
+        if (err) {
+            pr2serr("pthread_create: %s, continue with %d threads\n",
+                    safe_strerror(err), k);
+            break;
+        }
+    }
+    num_thr = k;
+    if (0 == num_thr)
+        ident_worker(icp);      /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+
+    if (! do_ident)
+        printf("IDENTIFY %sDEVICE of %d devices using %d threads:\n",
+               (icp->do_packet ? "PACKET " : ""), icp->num, num_thr);
+    for (k = 0; k < icp->num; ++k) {
+        idp = icp->arr + k;
+        if (idp->res) {
+            sg_get_category_sense_str(idp->res, sizeof(b), b, icp->verbose);
+            printf("%s%s: FAILED: %s\n", (do_ident ? "" : "  "), idp->name,
+                   b);
+            if (0 == ret)
+                ret = idp->res;
+            continue;
+        }
+        if (! idp->ok) {
+            printf("%s%s: no response\n", (do_ident ? "" : "  "),
+                   idp->name);
+            continue;
+        }
+        ++num_ok;
+        if (do_ident)
+            printf("%s 0x%016" PRIx64 "\n", idp->name, idp->ai.wwn);
+        else {
+            snprintf(b, sizeof(b), "  %.60s: ", idp->name);
+            show_summary(b, &idp->ai);
+        }
+    }
+    if (! do_ident)
+        printf("%d of %d devices identified\n", num_ok, icp->num);
+fini:
+    free(icp->arr);
+    icp->arr = NULL;
+    free(tids);
+    if (free_bufs)
+        free(free_bufs);
+    icp->bufs = NULL;
+    return ret;
 }
 
 int
@@ -398,22 +591,30 @@ main(int argc, char * argv[])
     bool do_ident = false;
     bool do_raw = false;
     bool o_readonly = false;
+    bool do_summary = false;
     bool ck_cond = false;    /* set to true to read register(s) back */
     bool extend = false;    /* set to true to send 48 bit LBA with command */
     bool verbose_given = false;
     bool version_given = false;
+    bool ok;
     int c, res;
     int sg_fd = -1;
+    int num_devs = 0;
+    int num_jobs = DEF_JOBS;
     int cdb_len = SAT_ATA_PASS_THROUGH16_LEN;
     int do_hex = 0;
     int verbose = 0;
     int ret = 0;
     const char * device_name = NULL;
+    char ** dev_names = NULL;
+    uint8_t inBuff[ID_RESPONSE_LEN];
+    struct sg_ata_ident_t ai;
+    struct ident_coll_t ic;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "cehHil:prRvV", long_options,
+        c = getopt_long(argc, argv, "cehHij:l:prRsvV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -435,6 +636,14 @@ main(int argc, char * argv[])
         case 'i':
             do_ident = true;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             cdb_len = sg_get_num(optarg);
             switch (cdb_len) {
@@ -456,6 +665,9 @@ main(int argc, char * argv[])
         case 'R':
             o_readonly = true;
             break;
+        case 's':
+            do_summary = true;
+            break;
         case 'v':
             verbose_given = true;
             ++verbose;
@@ -470,16 +682,9 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        device_name = argv[optind];
+        dev_names = argv + optind;
+        num_devs = argc - optind;
     }
 #ifdef DEBUG
     pr2serr("In DEBUG mode, ");
@@ -507,6 +712,24 @@ main(int argc, char * argv[])
         usage();
         return 1;
     }
+    if (num_devs > 1) {
+        if (do_hex || do_raw) {
+            pr2serr("--hex and --raw need a single DEVICE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        memset(&ic, 0, sizeof(ic));
+        ic.do_packet = do_packet;
+        ic.ck_cond = ck_cond;
+        ic.extend = extend;
+        ic.o_readonly = o_readonly;
+        ic.cdb_len = cdb_len;
+        ic.verbose = verbose;
+        ic.num = num_devs;
+        ret = multi_identify(&ic, dev_names,
+                             (num_jobs < num_devs) ? num_jobs : num_devs,
+                             do_ident);
+        goto fini;
+    }
     if (do_raw) {
         if (sg_set_binary_mode(STDOUT_FILENO) < 0) {
             perror("sg_set_binary_mode");
@@ -523,7 +746,14 @@ main(int argc, char * argv[])
     }
 
     ret = do_identify_dev(sg_fd, do_packet, cdb_len, ck_cond, extend,
-                          do_ident, do_hex, do_raw, verbose);
+                          inBuff, &ok, verbose);
+    if ((0 == ret) && ok) { /* output result if it is available */
+        if (do_summary && (0 == do_hex) && (! do_raw) && (! do_ident)) {
+            sg_ata_ident_decode(inBuff, ID_RESPONSE_LEN, &ai);
+            show_summary("", &ai);
+        } else
+            show_identify(inBuff, do_packet, do_ident, do_hex, do_raw);
+    }
 
 fini:
     if (sg_fd >= 0) {
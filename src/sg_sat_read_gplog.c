@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2018 Hannes Reinecke, SUSE Linux GmbH.
+ * Copyright (c) 2014-2026 Hannes Reinecke, SUSE Linux GmbH.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -15,7 +15,11 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
 #include <getopt.h>
+#include <pthread.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -24,6 +28,7 @@
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
@@ -53,30 +58,78 @@
 #define ATA_READ_LOG_DMA_EXT 0x47
 
 #define DEF_TIMEOUT 20
+#define DEF_CHUNK 128   /* log pages (512 bytes each) per command */
+#define DEF_MAX_JOBS 256
+#define MAX_JOBS 1024
 
-static const char * version_str = "1.20 20180628";
+static const char * version_str = "1.21 20261014";
 
 struct opts_t {
+    bool all;           /* read every page of the log address */
+    bool binary;
     bool ck_cond;
     bool rdonly;
+    int ata_cmd;
     int cdb_len;
+    int chunk;          /* pages per command with --all */
     int count;
     int hex;
     int la;             /* log address */
     int pn;             /* page number within log address */
     int verbose;
     const char * device_name;
+    const char * out_fn;
+};
+
+/* Logs with more than one page that are commonly read with --all */
+struct log_name_t {
+    const char * name;
+    int la;
+    const char * desc;
+};
+
+static struct log_name_t log_names[] = {
+    {"dir", 0x0, "Log directory"},
+    {"devstat", 0x4, "Device Statistics"},
+    {"ncq", 0x10, "NCQ Command Error"},
+    {"phy", 0x11, "SATA Phy Event Counters"},
+    {"cdis", 0x24, "Current Device Internal Status"},
+    {"sdis", 0x25, "Saved Device Internal Status"},
+    {"identify", 0x30, "IDENTIFY DEVICE data"},
+    {NULL, 0, NULL},
+};
+
+/* A DEVICE whose log is read, maybe by a worker thread, with --all */
+struct gplog_dev_t {
+    const char * dev_name;
+    int res;
+    int num_pages;
+    uint64_t dur_ns;
+    uint8_t * buf;
+    uint8_t * free_buf;
+};
+
+struct gplog_coll_t {
+    const struct opts_t * op;
+    int num_devs;
+    int next_ind;
+    struct gplog_dev_t * arr;
 };
 
 static struct option long_options[] = {
+    {"all", no_argument, 0, 'a'},
+    {"binary", no_argument, 0, 'b'},
+    {"chunk", required_argument, 0, 'k'},
     {"count", required_argument, 0, 'c'},
     {"ck_cond", no_argument, 0, 'C'},
     {"ck-cond", no_argument, 0, 'C'},
     {"dma", no_argument, 0, 'd'},
     {"help", no_argument, 0, 'h'},
     {"hex", no_argument, 0, 'H'},
+    {"jobs", required_argument, 0, 'j'},
     {"len", required_argument, 0, 'l'},
     {"log", required_argument, 0, 'L'},
+    {"out", required_argument, 0, 'o'},
     {"page", required_argument, 0, 'p'},
     {"readonly", no_argument, 0, 'r'},
     {"verbose", no_argument, 0, 'v'},
@@ -94,7 +147,19 @@ usage()
           "[--page=PN]\n"
           "                         [--readonly] [--verbose] [--version] "
           "DEVICE\n"
+          "       sg_sat_read_gplog --all [--binary] [--chunk=CH] "
+          "[--dma] [--hex]\n"
+          "                         [--jobs=J] [--log=LA] [--out=OF] "
+          "[--readonly]\n"
+          "                         [--verbose] DEVICE [DEVICE...]\n"
           "  where:\n"
+          "    --all | -a              read every page of log LA, in "
+          "chunks\n"
+          "    --binary | -b           with --all: output log in binary "
+          "(to stdout\n"
+          "                            unless --out=OF given)\n"
+          "    --chunk=CH | -k CH      with --all: pages per command "
+          "(def: %d)\n"
           "    --ck_cond | -C          set ck_cond field in pass-through "
           "(def: 0)\n"
           "    --count=CO | -c CO      block count (def: 1)\n"
@@ -105,9 +170,19 @@ usage()
           "yields hex\n"
           "                            words + ASCII (def), -HHH hex words "
           "only\n"
+          "    --jobs=J | -j J         with --all: threads for several "
+          "DEVICEs (def:\n"
+          "                            one per DEVICE, up to %d)\n"
           "    --len=16|12 | -l 16|12    cdb length: 16 or 12 bytes "
           "(def: 16)\n"
-          "    --log=LA | -L LA        Log address to be read (def: 0)\n"
+          "    --log=LA | -L LA        Log address to be read (def: 0), "
+          "or a name:\n"
+          "                            dir, devstat, ncq, phy, cdis, sdis "
+          "or identify\n"
+          "    --out=OF | -o OF        with --all --binary: write log to "
+          "OF (with\n"
+          "                            several DEVICEs to OF.<DEVICE "
+          "basename>)\n"
           "    --page=PN|-p PN         Log page number within address (def: "
           "0)\n"
           "    --readonly | -r         open DEVICE read-only (def: "
@@ -120,11 +195,14 @@ usage()
           "page is accessed\nvia a log address and then a page number "
           "within that address: LA,PN .\n"
           "By default the output is the response in hex (16 bit) words.\n"
-           );
+          "With --all the log directory gives the number of pages to "
+          "read.\n", DEF_CHUNK, DEF_MAX_JOBS);
 }
 
+/* Reads count pages of log address la starting at page pn into inbuff.
+ * Returns 0 on success, else an error category. */
 static int
-do_read_gplog(int sg_fd, int ata_cmd, uint8_t *inbuff,
+do_read_gplog(int sg_fd, int la, int pn, int count, uint8_t *inbuff,
               const struct opts_t * op)
 {
     const bool extend = true;
@@ -151,7 +229,7 @@ do_read_gplog(int sg_fd, int ata_cmd, uint8_t *inbuff,
 
     snprintf(cmd_name, sizeof(cmd_name), "ATA PASS-THROUGH (%d)",
              op->cdb_len);
-    if (ata_cmd == ATA_READ_LOG_DMA_EXT) {
+    if (op->ata_cmd == ATA_READ_LOG_DMA_EXT) {
         protocol = 6; /* DMA */
     } else {
         protocol = 4; /* PIO Data-In */
@@ -159,17 +237,17 @@ do_read_gplog(int sg_fd, int ata_cmd, uint8_t *inbuff,
     sb_sz = sizeof(sense_buffer);
     memset(sense_buffer, 0, sb_sz);
     memset(ata_return_desc, 0, sizeof(ata_return_desc));
-    memset(inbuff, 0, op->count * 512);
+    memset(inbuff, 0, count * 512);
     if (op->verbose > 1)
         pr2serr("Building ATA READ LOG%s EXT command; la=0x%x, pn=0x%x\n",
-                ((ata_cmd == ATA_READ_LOG_DMA_EXT) ? " DMA" : ""), op->la,
-                op->pn);
+                ((op->ata_cmd == ATA_READ_LOG_DMA_EXT) ? " DMA" : ""), la,
+                pn);
     if (op->cdb_len == 16) {
         /* Prepare ATA PASS-THROUGH COMMAND (16) command */
-        apt_cdb[14] = ata_cmd;
-        sg_put_unaligned_be16((uint16_t)op->count, apt_cdb + 5);
-        apt_cdb[8] = op->la;
-        sg_put_unaligned_be16((uint16_t)op->pn, apt_cdb + 9);
+        apt_cdb[14] = op->ata_cmd;
+        sg_put_unaligned_be16((uint16_t)count, apt_cdb + 5);
+        apt_cdb[8] = la;
+        sg_put_unaligned_be16((uint16_t)pn, apt_cdb + 9);
         apt_cdb[1] = (protocol << 1) | extend;
         if (extend)
             apt_cdb[1] |= 0x1;
@@ -183,17 +261,17 @@ do_read_gplog(int sg_fd, int ata_cmd, uint8_t *inbuff,
         if (byte_block)
             apt_cdb[2] |= 0x4;
         res = sg_ll_ata_pt(sg_fd, apt_cdb, op->cdb_len, DEF_TIMEOUT, inbuff,
-                           NULL, op->count * 512, sense_buffer,
+                           NULL, count * 512, sense_buffer,
                            sb_sz, ata_return_desc,
                            sizeof(ata_return_desc), &resid, op->verbose);
     } else {
         /* Prepare ATA PASS-THROUGH COMMAND (12) command */
         /* Cannot map upper 8 bits of the pn since no LBA (39:32) field */
-        apt12_cdb[9] = ata_cmd;
-        apt12_cdb[4] = op->count;
-        apt12_cdb[5] = op->la;
-        apt12_cdb[6] = op->pn & 0xff;
-        /* apt12_cdb[7] = (op->pn >> 8) & 0xff; */
+        apt12_cdb[9] = op->ata_cmd;
+        apt12_cdb[4] = count;
+        apt12_cdb[5] = la;
+        apt12_cdb[6] = pn & 0xff;
+        /* apt12_cdb[7] = (pn >> 8) & 0xff; */
         apt12_cdb[1] = (protocol << 1);
         apt12_cdb[2] = t_length;
         if (op->ck_cond)
@@ -205,23 +283,13 @@ do_read_gplog(int sg_fd, int ata_cmd, uint8_t *inbuff,
         if (byte_block)
             apt12_cdb[2] |= 0x4;
         res = sg_ll_ata_pt(sg_fd, apt12_cdb, op->cdb_len, DEF_TIMEOUT,
-                           inbuff, NULL, op->count * 512, sense_buffer,
+                           inbuff, NULL, count * 512, sense_buffer,
                            sb_sz, ata_return_desc,
                            sizeof(ata_return_desc), &resid, op->verbose);
     }
     if (0 == res) {
         if (op->verbose > 2)
             pr2serr("command completed with SCSI GOOD status\n");
-        if ((0 == op->hex) || (2 == op->hex))
-            dWordHex((const unsigned short *)inbuff, op->count * 256, 0,
-                     sg_is_big_endian());
-        else if (1 == op->hex)
-            hex2stdout(inbuff, 512, 0);
-        else if (3 == op->hex)  /* '-HHH' suitable for "hdparm --Istdin" */
-            dWordHex((const unsigned short *)inbuff, 256, -2,
-                     sg_is_big_endian());
-        else    /* '-HHHH' hex bytes only */
-            hex2stdout(inbuff, 512, -1);
     } else if ((res > 0) && (res & SAM_STAT_CHECK_CONDITION)) {
         if (op->verbose > 1) {
             pr2serr("ATA pass through:\n");
@@ -327,15 +395,220 @@ do_read_gplog(int sg_fd, int ata_cmd, uint8_t *inbuff,
     return 0;
 }
 
+/* Outputs num_pages pages of log data in inbuff as selected by --hex */
+static void
+out_gplog(const uint8_t * inbuff, int num_pages, const struct opts_t * op)
+{
+    if ((0 == op->hex) || (2 == op->hex))
+        dWordHex((const unsigned short *)inbuff, num_pages * 256, 0,
+                 sg_is_big_endian());
+    else if (1 == op->hex)
+        hex2stdout(inbuff, num_pages * 512, 0);
+    else if (3 == op->hex)  /* '-HHH' suitable for "hdparm --Istdin" */
+        dWordHex((const unsigned short *)inbuff, num_pages * 256, -2,
+                 sg_is_big_endian());
+    else    /* '-HHHH' hex bytes only */
+        hex2stdout(inbuff, num_pages * 512, -1);
+}
+
+/* Reads the log directory to learn how many pages log address op->la
+ * has, then reads all of them, up to op->chunk pages per command, into
+ * gdp->buf which is allocated here. */
+static int
+read_whole_log(int sg_fd, struct gplog_dev_t * gdp, const struct opts_t * op)
+{
+    int res, pn, n, cnt;
+
+    gdp->buf = sg_memalign(512, 0, &gdp->free_buf, false);
+    if (NULL == gdp->buf)
+        return sg_convert_errno(ENOMEM);
+    res = do_read_gplog(sg_fd, 0, 0, 1, gdp->buf, op);
+    if (res)
+        return res;
+    if (0 == op->la) {
+        gdp->num_pages = 1;
+        return 0;
+    }
+    n = sg_get_unaligned_le16(gdp->buf + (2 * op->la));
+    if (0 == n) {
+        pr2serr("%s: log address 0x%x not supported\n", gdp->dev_name,
+                op->la);
+        return SG_LIB_CAT_ILLEGAL_REQ;
+    }
+    free(gdp->free_buf);
+    gdp->buf = sg_memalign(n * 512, 0, &gdp->free_buf, false);
+    if (NULL == gdp->buf)
+        return sg_convert_errno(ENOMEM);
+    for (pn = 0; pn < n; pn += cnt) {
+        cnt = ((n - pn) < op->chunk) ? (n - pn) : op->chunk;
+        res = do_read_gplog(sg_fd, op->la, pn, cnt, gdp->buf + (pn * 512),
+                            op);
+        if (res)
+            return res;
+    }
+    gdp->num_pages = n;
+    return 0;
+}
+
+/* Takes DEVICEs, in order, until none are left and reads the whole log
+ * from each. */
+static void *
+gplog_worker(void * v_gcp)
+{
+    int k, sg_fd;
+    uint64_t t0;
+    struct gplog_coll_t * gcp = (struct gplog_coll_t *)v_gcp;
+    const struct opts_t * op = gcp->op;
+    struct gplog_dev_t * gdp;
+
+    while ((k = __atomic_fetch_add(&gcp->next_ind, 1, __ATOMIC_RELAXED)) <
+           gcp->num_devs) {
+        gdp = gcp->arr + k;
+        sg_fd = sg_cmds_open_device(gdp->dev_name, op->rdonly, op->verbose);
+        if (sg_fd < 0) {
+            pr2serr("error opening file: %s: %s\n", gdp->dev_name,
+                    safe_strerror(-sg_fd));
+            gdp->res = sg_convert_errno(-sg_fd);
+            continue;
+        }
+        t0 = sg_pt_lat_now_ns();
+        gdp->res = read_whole_log(sg_fd, gdp, op);
+        gdp->dur_ns = sg_pt_lat_now_ns() - t0;
+        if (gdp->res < 0)
+            gdp->res = SG_LIB_CAT_OTHER;
+        sg_cmds_close_device(sg_fd);
+    }
+    return NULL;
+}
+
+/* Writes len bytes from buf to file fn, or to stdout if fn is NULL */
+static int
+write_bin(const char * fn, const uint8_t * buf, int len)
+{
+    int err;
+    FILE * fp = stdout;
+
+    if (fn) {
+        fp = fopen(fn, "wb");
+        if (NULL == fp) {
+            err = errno;
+            pr2serr("unable to open %s: %s\n", fn, safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+    } else if (sg_set_binary_mode(STDOUT_FILENO) < 0)
+        perror("sg_set_binary_mode");
+    if ((int)fwrite(buf, 1, len, fp) != len) {
+        err = errno;
+        pr2serr("write to %s failed: %s\n", fn ? fn : "stdout",
+                safe_strerror(err));
+        if (fn)
+            fclose(fp);
+        return sg_convert_errno(err);
+    }
+    if (fn && fclose(fp)) {
+        err = errno;
+        pr2serr("close of %s failed: %s\n", fn, safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    return 0;
+}
+
+/* Reads every page of log address op->la from each DEVICE, num_thr of
+ * them at a time, then outputs the logs in DEVICE order. With several
+ * DEVICEs each hex log is preceded by its DEVICE name and a timing line
+ * per DEVICE goes to stderr. Returns 0 if all logs were read, else the
+ * error of the first DEVICE that failed. */
+static int
+gplog_all(const struct opts_t * op, char ** dev_names, int num_devs,
+          int num_thr)
+{
+    bool multi = (num_devs > 1);
+    int k, err, res;
+    int ret = 0;
+    struct gplog_dev_t * gdp;
+    struct gplog_coll_t coll;
+    pthread_t * tids;
+    const char * cp;
+    char fn[512];
+    char b[80];
+
+    memset(&coll, 0, sizeof(coll));
+    coll.op = op;
+    coll.num_devs = num_devs;
+    coll.arr = (struct gplog_dev_t *)calloc(num_devs, sizeof(*coll.arr));
+    tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+    if ((NULL == coll.arr) || (NULL == tids)) {
+        pr2serr("unable to allocate memory for %d devices\n", num_devs);
+        free(coll.arr);
+        free(tids);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < num_devs; ++k)
+        coll.arr[k].dev_name = dev_names[k];
+    if (multi) {
+        for (k = 0; k < num_thr; ++k) {
+            err = pthread_create(tids + k, NULL, gplog_worker, &coll);
+            if (err) {
+                pr2serr("pthread_create: %s, continue with %d threads\n",
+                        safe_strerror(err), k);
+                break;
+            }
+        }
+        num_thr = k;
+    } else
+        num_thr = 0;
+    if (0 == num_thr)
+        gplog_worker(&coll);    /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+
+    for (k = 0; k < num_devs; ++k) {
+        gdp = coll.arr + k;
+        if (0 == gdp->res) {
+            if (op->binary) {
+                cp = op->out_fn;
+                if (multi) {
+                    cp = strrchr(gdp->dev_name, '/');
+                    snprintf(fn, sizeof(fn), "%s.%s", op->out_fn,
+                             cp ? cp + 1 : gdp->dev_name);
+                    cp = fn;
+                }
+                gdp->res = write_bin(cp, gdp->buf, gdp->num_pages * 512);
+            } else {
+                if (multi)
+                    printf("%s:\n", gdp->dev_name);
+                out_gplog(gdp->buf, gdp->num_pages, op);
+            }
+        }
+        res = gdp->res;
+        if (res) {
+            sg_get_category_sense_str(res, sizeof(b), b, op->verbose);
+            pr2serr("%s: %s\n", gdp->dev_name, b);
+            if (0 == ret)
+                ret = res;
+        } else if (multi || op->verbose)
+            pr2serr("%s: log 0x%x, %d page%s in %.1f ms\n", gdp->dev_name,
+                    op->la, gdp->num_pages, (1 == gdp->num_pages) ? "" : "s",
+                    (double)gdp->dur_ns / 1000000.0);
+        if (gdp->free_buf)
+            free(gdp->free_buf);
+    }
+    free(coll.arr);
+    free(tids);
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
 {
     bool verbose_given = false;
     bool version_given = false;
-    int c, ret, res, n;
+    bool count_given = false;
+    bool page_given = false;
+    int c, k, ret, res, n, num_devs;
+    int num_jobs = 0;
     int sg_fd = -1;
-    int ata_cmd = ATA_READ_LOG_EXT;
     uint8_t *inbuff = NULL;
     uint8_t *free_inbuff = NULL;
     struct opts_t opts;
@@ -345,16 +618,25 @@ main(int argc, char * argv[])
     memset(op, 0, sizeof(opts));
     op->cdb_len = SAT_ATA_PASS_THROUGH16_LEN;
     op->count = 1;
+    op->chunk = DEF_CHUNK;
+    op->ata_cmd = ATA_READ_LOG_EXT;
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "c:CdhHl:L:p:rvV", long_options,
+        c = getopt_long(argc, argv, "abc:Cdhj:Hk:l:L:o:p:rvV", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'a':
+            op->all = true;
+            break;
+        case 'b':
+            op->binary = true;
+            break;
         case 'c':
+            count_given = true;
             op->count = sg_get_num(optarg);
             if ((op->count < 1) || (op->count > 0xffff)) {
                 pr2serr("bad argument for '--count'\n");
@@ -365,7 +647,7 @@ main(int argc, char * argv[])
             op->ck_cond = true;
             break;
         case 'd':
-            ata_cmd = ATA_READ_LOG_DMA_EXT;
+            op->ata_cmd = ATA_READ_LOG_DMA_EXT;
             break;
         case 'h':
         case '?':
@@ -374,6 +656,21 @@ main(int argc, char * argv[])
         case 'H':
             ++op->hex;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'k':
+            op->chunk = sg_get_num(optarg);
+            if ((op->chunk < 1) || (op->chunk > 0xffff)) {
+                pr2serr("bad argument for '--chunk'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
            op->cdb_len = sg_get_num(optarg);
            if (! ((op->cdb_len == 12) || (op->cdb_len == 16))) {
@@ -382,13 +679,35 @@ main(int argc, char * argv[])
             }
             break;
         case 'L':
+            if (isalpha((uint8_t)optarg[0])) {
+                const struct log_name_t * lnp;
+
+                for (lnp = log_names; lnp->name; ++lnp) {
+                    if (0 == strcmp(optarg, lnp->name))
+                        break;
+                }
+                if (NULL == lnp->name) {
+                    pr2serr("unknown log name '%s', known names:\n",
+                            optarg);
+                    for (lnp = log_names; lnp->name; ++lnp)
+                        pr2serr("    %-9s 0x%02x  %s\n", lnp->name,
+                                lnp->la, lnp->desc);
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                op->la = lnp->la;
+                break;
+            }
             op->la = sg_get_num(optarg);
             if (op->la < 0 || op->la > 0xff) {
                 pr2serr("bad argument for '--log'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
             break;
+        case 'o':
+            op->out_fn = optarg;
+            break;
         case 'p':
+            page_given = true;
             op->pn = sg_get_num(optarg);
             if ((op->pn < 0) || (op->pn > 0xffff)) {
                 pr2serr("bad argument for '--page'\n");
@@ -411,18 +730,14 @@ main(int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
-    if (optind < argc) {
-        if (NULL == op->device_name) {
-            op->device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n",
-                        argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+    num_devs = argc - optind;
+    if (num_devs > 0)
+        op->device_name = argv[optind];
+    if ((num_devs > 1) && (! op->all)) {
+        for (k = optind + 1; k < argc; ++k)
+            pr2serr("Unexpected extra argument: %s\n", argv[k]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
     }
 
 #ifdef DEBUG
@@ -452,6 +767,38 @@ main(int argc, char * argv[])
         return 1;
     }
 
+    if (op->all) {
+        if (count_given || page_given) {
+            pr2serr("--all reads every page so --count= and --page= do "
+                    "not apply\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->binary && (num_devs > 1) && (NULL == op->out_fn)) {
+            pr2serr("with several DEVICEs, --binary needs --out=OF\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->out_fn && (! op->binary)) {
+            pr2serr("--out=OF needs --binary\n");
+            return SG_LIB_CONTRADICT;
+        }
+        op->cdb_len = 16;       /* page numbers and counts exceed 0xff */
+        if (0 == num_jobs)
+            num_jobs = (num_devs < DEF_MAX_JOBS) ? num_devs : DEF_MAX_JOBS;
+        else if (num_jobs > num_devs)
+            num_jobs = num_devs;
+        ret = gplog_all(op, argv + optind, num_devs, num_jobs);
+        if (0 == op->verbose) {
+            if (! sg_if_can2stderr("sg_sat_read_gplog failed: ", ret))
+                pr2serr("Some error occurred, try again with '-v' "
+                        "or '-vv' for more information\n");
+        }
+        return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+    } else if (op->binary || op->out_fn || num_jobs ||
+               (DEF_CHUNK != op->chunk)) {
+        pr2serr("--binary, --chunk=, --jobs= and --out= need --all\n");
+        return SG_LIB_CONTRADICT;
+    }
+
     if ((op->count > 0xff) && (12 == op->cdb_len)) {
         op->cdb_len = 16;
         if (op->verbose)
@@ -475,7 +822,9 @@ main(int argc, char * argv[])
         goto fini;
     }
 
-    ret = do_read_gplog(sg_fd, ata_cmd, inbuff, op);
+    ret = do_read_gplog(sg_fd, op->la, op->pn, op->count, inbuff, op);
+    if (0 == ret)
+        out_gplog(inbuff, op->count, op);
 
 fini:
     if (sg_fd >= 0) {
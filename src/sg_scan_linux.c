@@ -1,5 +1,5 @@
 /* A utility program originally written for the Linux OS SCSI subsystem.
- *  Copyright (C) 1999 - 2018 D. Gilbert
+ *  Copyright (C) 1999 - 2026 D. Gilbert
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation; either version 2, or (at your option)
@@ -12,13 +12,20 @@
  * to scan (in place of the sg devices).
  * Options: -a   alpha scan: scan /dev/sga,b,c, ....
  *          -i   do SCSI inquiry on device (implies -w)
+ *          -j=JOBS  probe up to JOBS devices at once (def: 16)
  *          -n   numeric scan: scan /dev/sg0,1,2, ....
+ *          -t=SECS  INQUIRY timeout per device (def: 20 seconds)
  *          -V   output version string and exit
  *          -w   open writable (new driver opens readable unless -i)
  *          -x   extra information output
  *
  * By default this program will look for /dev/sg0 first (i.e. numeric scan)
  *
+ * When the devices are known beforehand (from sysfs or the command line)
+ * they are probed by a pool of threads, each device's results being held
+ * until it can be output in device order. So an unresponsive device only
+ * delays the output, not the probing of the others.
+ *
  * Note: This program is written to work under both the original and
  * the new sg driver.
  *
@@ -43,6 +50,7 @@
 #include <errno.h>
 #include <dirent.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -53,7 +61,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "4.17 20180219";
+static const char * version_str = "4.18 20261014";
 
 #define ME "sg_scan: "
 
@@ -62,6 +70,10 @@ static const char * version_str = "4.17 20180219";
 #define INQ_REPLY_LEN 36
 #define INQ_CMD_LEN 6
 #define MAX_ERRORS 4
+#define DEF_JOBS 16
+#define MAX_JOBS 256
+#define DEF_INQ_TIMEOUT_SECS 20
+#define ATA_IDENT_WORDS 256
 
 #define EBUFF_SZ 256
 #define FNAME_SZ 64
@@ -88,22 +100,81 @@ typedef struct my_sg_scsi_id {
     int unused2;        /* ditto */
 } My_sg_scsi_id;
 
-int sg3_inq(int sg_fd, uint8_t * inqBuff, bool do_extra);
+/* How far scan_probe() got with a device, the stage named failed unless
+ * it is SD_DONE (or SD_ATA_DONE) */
+enum sd_stage_e {
+    SD_OPEN = 0,
+    SD_IDLUN,           /* both SCSI_IOCTL_GET_IDLUN and ATA IDENTIFY */
+    SD_BUS,
+    SD_SCSI_ID,
+    SD_ATA_DONE,
+    SD_DONE,
+};
+
+/* One per device to be scanned. Filled by scan_probe() (maybe in a worker
+ * thread) and output by scan_report() in device order. */
+struct scan_dev_t {
+    bool done;          /* set by worker under scan_mutex */
+    bool inq_tried;
+    bool inq_sg_io;     /* INQUIRY response from SG_IO */
+    int stage;          /* enum sd_stage_e */
+    int err;            /* errno of failed stage */
+    int close_err;
+    int host_no;
+    int emul;
+    int inq_err;        /* 0, -errno or SCSI_IOCTL_SEND_COMMAND result */
+    const char * file_namep;
+    My_scsi_idlun my_idlun;
+    My_sg_scsi_id m_id;
+    struct sg_io_hdr io_hdr;
+    uint8_t sense_buffer[32];
+    uint8_t inqBuff[INQ_REPLY_LEN];
+    unsigned short ata_ident[ATA_IDENT_WORDS];
+    char fname[FNAME_SZ];
+};
+
+/* Shared by the probing threads */
+struct scan_coll_t {
+    bool do_extra;
+    bool do_inquiry;
+    bool has_file_args;
+    bool stop;
+    int flags;          /* for open(2) */
+    int num_devs;
+    int next_dev;       /* claimed with __atomic_fetch_add() */
+    int inq_timeout_ms;
+    int verbose;
+    struct scan_dev_t * dev_arr;
+};
+
+static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;
+
+void sg3_inq(struct scan_dev_t * sdp, int sg_fd, int timeout_ms);
+int sg3_inq_report(struct scan_dev_t * sdp, bool do_extra);
 int scsi_inq(int sg_fd, uint8_t * inqBuff);
-int try_ata_identity(const char * file_namep, int ata_fd, bool do_inq);
+int ata_command_interface(int device, char *data);
+void print_ata_identity(const char * file_namep,
+                        const unsigned short * ata_ident, bool do_inq);
 
-static uint8_t inq_cdb[INQ_CMD_LEN] =
+static const uint8_t inq_cdb[INQ_CMD_LEN] =
                                 {0x12, 0, 0, 0, INQ_REPLY_LEN, 0};
 
 
 void usage()
 {
-    printf("Usage: sg_scan [-a] [-i] [-n] [-v] [-V] [-w] [-x] "
-           "[DEVICE]*\n");
+    printf("Usage: sg_scan [-a] [-i] [-j=JOBS] [-n] [-t=SECS] [-v] [-V] "
+           "[-w] [-x]\n"
+           "               [DEVICE]*\n");
     printf("  where:\n");
     printf("    -a    do alpha scan (ie sga, sgb, sgc)\n");
     printf("    -i    do SCSI INQUIRY, output results\n");
+    printf("    -j=JOBS    number of devices probed at once (def: %d, "
+           "1 -> one\n"
+           "               after the other)\n", DEF_JOBS);
     printf("    -n    do numeric scan (ie sg0, sg1...) [default]\n");
+    printf("    -t=SECS    INQUIRY timeout for each device (def: %d "
+           "seconds)\n", DEF_INQ_TIMEOUT_SECS);
     printf("    -v    increase verbosity\n");
     printf("    -V    output version string then exit\n");
     printf("    -w    force open with read/write flag\n");
@@ -170,34 +241,235 @@ void make_dev_name(char * fname, int k, bool do_numeric)
 }
 
 
+/* Like perror(3) but for an errno value saved earlier */
+static void
+perror_err(const char * leadin, int err)
+{
+    pr2serr("%s: %s\n", leadin, safe_strerror(err));
+}
+
+/* Issues the ioctls (and maybe INQUIRY) for one device, saving the results
+ * in *sdp without outputting anything. */
+static void
+scan_probe(struct scan_dev_t * sdp, const struct scan_coll_t * scp)
+{
+    int sg_fd, f;
+
+    sdp->stage = SD_OPEN;
+    sdp->emul = -1;
+    sg_fd = open(sdp->file_namep, scp->flags);
+    if (sg_fd < 0) {
+        sdp->err = errno;
+        return;
+    }
+    if (ioctl(sg_fd, SCSI_IOCTL_GET_IDLUN, &sdp->my_idlun) < 0) {
+        sdp->stage = SD_IDLUN;
+        if (0 == ata_command_interface(sg_fd, (char *)sdp->ata_ident))
+            sdp->stage = SD_ATA_DONE;
+        else
+            sdp->err = errno;
+        goto fini;
+    }
+    sdp->stage = SD_BUS;
+    if (ioctl(sg_fd, SCSI_IOCTL_GET_BUS_NUMBER, &sdp->host_no) < 0) {
+        sdp->err = errno;
+        goto fini;
+    }
+    if (ioctl(sg_fd, SG_EMULATED_HOST, &sdp->emul) < 0)
+        sdp->emul = -1;
+    if (! scp->has_file_args) {
+        sdp->stage = SD_SCSI_ID;
+        /* My_sg_scsi_id is compatible with sg_scsi_id_t in sg.h */
+        if (ioctl(sg_fd, SG_GET_SCSI_ID, &sdp->m_id) < 0) {
+            sdp->err = errno;
+            goto fini;
+        }
+    }
+    sdp->stage = SD_DONE;
+    if (scp->do_inquiry && (ioctl(sg_fd, SG_GET_VERSION_NUM, &f) >= 0) &&
+        (f >= 30000)) {
+        sdp->inq_tried = true;
+        sg3_inq(sdp, sg_fd, scp->inq_timeout_ms);
+    }
+fini:
+    if (close(sg_fd) < 0)
+        sdp->close_err = errno;
+}
+
+/* Outputs what scan_probe() found for one device and adds to the error
+ * counts. Returns 0, or SG_LIB_FILE_ERROR if the scan should stop. */
+static int
+scan_report(struct scan_dev_t * sdp, const struct scan_coll_t * scp,
+            int * num_errorsp, int * num_silentp, bool * eacces_errp)
+{
+    const char * file_namep = sdp->file_namep;
+    char ebuff[EBUFF_SZ];
+
+    switch (sdp->stage) {
+    case SD_OPEN:
+        if (EBUSY == sdp->err)
+            printf("%s: device busy (O_EXCL lock), skipping\n",
+                   file_namep);
+        else if ((ENODEV == sdp->err) || (ENOENT == sdp->err) ||
+                 (ENXIO == sdp->err)) {
+            if (scp->verbose)
+                pr2serr("Unable to open: %s, errno=%d\n", file_namep,
+                        sdp->err);
+            ++*num_errorsp;
+            ++*num_silentp;
+        } else {
+            if (EACCES == sdp->err)
+                *eacces_errp = true;
+            snprintf(ebuff, EBUFF_SZ, ME "Error opening %s ", file_namep);
+            perror_err(ebuff, sdp->err);
+            ++*num_errorsp;
+        }
+        return 0;       /* nothing to close */
+    case SD_IDLUN:
+        snprintf(ebuff, EBUFF_SZ, ME "device %s failed on scsi+ata "
+                 "ioctl, skip", file_namep);
+        perror_err(ebuff, sdp->err);
+        ++*num_errorsp;
+        break;
+    case SD_ATA_DONE:
+        print_ata_identity(file_namep, sdp->ata_ident, scp->do_inquiry);
+        break;
+    case SD_BUS:
+        snprintf(ebuff, EBUFF_SZ, ME "device %s failed on scsi "
+                 "ioctl(2), skip", file_namep);
+        perror_err(ebuff, sdp->err);
+        ++*num_errorsp;
+        break;
+    default:    /* SD_SCSI_ID or SD_DONE */
+        printf("%s: scsi%d channel=%d id=%d lun=%d", file_namep,
+               sdp->host_no, (sdp->my_idlun.dev_id >> 16) & 0xff,
+               sdp->my_idlun.dev_id & 0xff,
+               (sdp->my_idlun.dev_id >> 8) & 0xff);
+        if (1 == sdp->emul)
+            printf(" [em]");
+#if 0
+        printf(", huid=%d", sdp->my_idlun.host_unique_id);
+#endif
+        if (SD_SCSI_ID == sdp->stage) {
+            snprintf(ebuff, EBUFF_SZ, ME "device %s failed "
+                     "SG_GET_SCSI_ID ioctl(4), skip", file_namep);
+            perror_err(ebuff, sdp->err);
+            ++*num_errorsp;
+            break;
+        }
+        if (! scp->has_file_args) {
+            /* printf("  type=%d", sdp->m_id.scsi_type); */
+            if (scp->do_extra)
+                printf("  cmd_per_lun=%hd queue_depth=%hd\n",
+                       sdp->m_id.h_cmd_per_lun, sdp->m_id.d_queue_depth);
+            else
+                printf("\n");
+        }
+        else
+            printf("\n");
+        if (sdp->inq_tried && sg3_inq_report(sdp, scp->do_extra))
+            ++*num_errorsp;
+        break;
+    }
+    if (sdp->close_err) {
+        snprintf(ebuff, EBUFF_SZ, ME "Error closing %s ", file_namep);
+        perror_err(ebuff, sdp->close_err);
+        return SG_LIB_FILE_ERROR;
+    }
+    return 0;
+}
+
+/* Probes devices, in the order they are claimed, until none remain */
+static void *
+scan_worker(void * v_scp)
+{
+    int k;
+    struct scan_coll_t * scp = (struct scan_coll_t *)v_scp;
+
+    while (! __atomic_load_n(&scp->stop, __ATOMIC_RELAXED)) {
+        k = __atomic_fetch_add(&scp->next_dev, 1, __ATOMIC_RELAXED);
+        if (k >= scp->num_devs)
+            break;
+        scan_probe(scp->dev_arr + k, scp);
+        pthread_mutex_lock(&scan_mutex);
+        scp->dev_arr[k].done = true;
+        pthread_cond_broadcast(&scan_cond);
+        pthread_mutex_unlock(&scan_mutex);
+    }
+    return NULL;
+}
+
+/* Probes the devices in scp->dev_arr with num_jobs threads (or this one
+ * when num_jobs is 1) and reports them in order as each becomes ready.
+ * Returns 0 or SG_LIB_FILE_ERROR. */
+static int
+scan_devices(struct scan_coll_t * scp, int num_jobs, int * num_errorsp,
+             int * num_silentp, bool * eacces_errp)
+{
+    int k, res;
+    int ret = 0;
+    int num_thr = 0;
+    struct scan_dev_t * sdp;
+    pthread_t * tid_arr = NULL;
+
+    if (num_jobs > scp->num_devs)
+        num_jobs = scp->num_devs;
+    if (num_jobs > 1) {
+        tid_arr = (pthread_t *)calloc(num_jobs, sizeof(pthread_t));
+        for (k = 0; tid_arr && (k < num_jobs); ++k, ++num_thr) {
+            res = pthread_create(tid_arr + k, NULL, scan_worker, scp);
+            if (res) {
+                if (scp->verbose)
+                    pr2serr("pthread_create: %s\n", safe_strerror(res));
+                break;
+            }
+        }
+    }
+    for (k = 0; k < scp->num_devs; ++k) {
+        if ((! scp->has_file_args) && (*num_errorsp >= MAX_ERRORS))
+            break;
+        sdp = scp->dev_arr + k;
+        if (num_thr > 0) {
+            pthread_mutex_lock(&scan_mutex);
+            while (! sdp->done)
+                pthread_cond_wait(&scan_cond, &scan_mutex);
+            pthread_mutex_unlock(&scan_mutex);
+        } else
+            scan_probe(sdp, scp);
+        ret = scan_report(sdp, scp, num_errorsp, num_silentp, eacces_errp);
+        if (ret)
+            break;
+    }
+    __atomic_store_n(&scp->stop, true, __ATOMIC_RELAXED);
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tid_arr[k], NULL);
+    if (tid_arr)
+        free(tid_arr);
+    return ret;
+}
+
+
 int main(int argc, char * argv[])
 {
-    bool do_extra = false;
-    bool do_inquiry = false;
     bool do_numeric = NUMERIC_SCAN_DEF;
     bool eacces_err = false;
-    bool has_file_args = false;
     bool has_sysfs_sg = false;
     bool jmp_out;
-    bool sg_ver3 = false;
-    bool sg_ver3_set = false;
     bool writeable = false;
-    int sg_fd, res, k, j, f, plen;
-    int emul = -1;
-    int flags;
-    int host_no;
+    int res, k, j, n, plen;
     const int max_file_args = PRESENT_ARRAY_SIZE;
     int num_errors = 0;
+    int num_jobs = DEF_JOBS;
     int num_silent = 0;
-    int verbose = 0;
-    char * file_namep;
+    int ret = 0;
     const char * cp;
-    char fname[FNAME_SZ];
-    char ebuff[EBUFF_SZ];
-    uint8_t inqBuff[INQ_REPLY_LEN];
-    My_scsi_idlun my_idlun;
     struct stat a_stat;
+    struct scan_coll_t coll;
+    struct scan_coll_t * scp = &coll;
+    struct scan_dev_t * sdp;
 
+    memset(scp, 0, sizeof(coll));
+    scp->inq_timeout_ms = DEF_INQ_TIMEOUT_SECS * 1000;
     if (NULL == (gen_index_arr =
                  (int *)calloc(max_file_args + 1, sizeof(int)))) {
         printf(ME "Out of memory\n");
@@ -222,13 +494,13 @@ int main(int argc, char * argv[])
                     usage();
                     return 0;
                 case 'i':
-                    do_inquiry = true;
+                    scp->do_inquiry = true;
                     break;
                 case 'n':
                     do_numeric = true;
                     break;
                 case 'v':
-                    ++verbose;
+                    ++scp->verbose;
                     break;
                 case 'V':
                     pr2serr("Version string: %s\n", version_str);
@@ -237,7 +509,7 @@ int main(int argc, char * argv[])
                     writeable = true;
                     break;
                 case 'x':
-                    do_extra = true;
+                    scp->do_extra = true;
                     break;
                 default:
                     jmp_out = true;
@@ -248,14 +520,29 @@ int main(int argc, char * argv[])
             }
             if (plen <= 0)
                 continue;
-            if (jmp_out) {
+            if (0 == strncmp("j=", cp, 2)) {
+                num_jobs = sg_get_num(cp + 2);
+                if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                    pr2serr("bad argument to '-j=', expect 1 to %d\n",
+                            MAX_JOBS);
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+            } else if (0 == strncmp("t=", cp, 2)) {
+                n = sg_get_num(cp + 2);
+                if ((n < 1) || (n > 3600)) {
+                    pr2serr("bad argument to '-t=', expect 1 to 3600 "
+                            "(seconds)\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                scp->inq_timeout_ms = n * 1000;
+            } else if (jmp_out) {
                 pr2serr("Unrecognized option: %s\n", cp);
                 usage();
                 return SG_LIB_SYNTAX_ERROR;
             }
         } else {
             if (j < max_file_args) {
-                has_file_args = true;
+                scp->has_file_args = true;
                 gen_index_arr[j++] = k;
             } else {
                 printf("Too many command line arguments\n");
@@ -264,129 +551,65 @@ int main(int argc, char * argv[])
         }
     }
 
-    if ((! has_file_args) && (stat(sysfs_sg_dir, &a_stat) >= 0) &&
+    if ((! scp->has_file_args) && (stat(sysfs_sg_dir, &a_stat) >= 0) &&
         (S_ISDIR(a_stat.st_mode)))
         has_sysfs_sg = !! sysfs_sg_scan(sysfs_sg_dir);
 
-    flags = O_NONBLOCK | (writeable ? O_RDWR : O_RDONLY);
+    scp->flags = O_NONBLOCK | (writeable ? O_RDWR : O_RDONLY);
 
-    for (k = 0, res = 0, j = 0, sg_fd = -1;
-         (k < max_file_args)  && (has_file_args || (num_errors < MAX_ERRORS));
-         ++k, res = ((sg_fd >= 0) ? close(sg_fd) : 0)) {
-        if (res < 0) {
-            snprintf(ebuff, EBUFF_SZ, ME "Error closing %s ", fname);
-            perror(ebuff);
-            return SG_LIB_FILE_ERROR;
-        }
-        if (has_file_args) {
-            if (gen_index_arr[j])
-                file_namep = argv[gen_index_arr[j++]];
-            else
+    if (scp->has_file_args || has_sysfs_sg) {
+        /* the devices are known so can be probed in parallel */
+        for (k = 0, n = 0; k < max_file_args; ++k) {
+            if (gen_index_arr[k])
+                ++n;
+            else if (scp->has_file_args)
                 break;
-        } else if (has_sysfs_sg) {
-            if (0 == gen_index_arr[k]) {
-                sg_fd = -1;
-                continue;
-            }
-            make_dev_name(fname, k, 1);
-            file_namep = fname;
-        } else {
-            make_dev_name(fname, k, do_numeric);
-            file_namep = fname;
         }
-
-        sg_fd = open(file_namep, flags);
-        if (sg_fd < 0) {
-            if (EBUSY == errno) {
-                printf("%s: device busy (O_EXCL lock), skipping\n",
-                       file_namep);
-                continue;
-            }
-            else if ((ENODEV == errno) || (ENOENT == errno) ||
-                     (ENXIO == errno)) {
-                if (verbose)
-                    pr2serr("Unable to open: %s, errno=%d\n", file_namep,
-                            errno);
-                ++num_errors;
-                ++num_silent;
-                continue;
-            }
-            else {
-                if (EACCES == errno)
-                    eacces_err = true;
-                snprintf(ebuff, EBUFF_SZ, ME "Error opening %s ", file_namep);
-                perror(ebuff);
-                ++num_errors;
-                continue;
-            }
+        scp->dev_arr = (struct scan_dev_t *)calloc(n + 1,
+                                                   sizeof(struct scan_dev_t));
+        if (NULL == scp->dev_arr) {
+            printf(ME "Out of memory\n");
+            return SG_LIB_CAT_OTHER;
         }
-        res = ioctl(sg_fd, SCSI_IOCTL_GET_IDLUN, &my_idlun);
-        if (res < 0) {
-            res = try_ata_identity(file_namep, sg_fd, do_inquiry);
-            if (res == 0)
+        for (k = 0, j = 0; (k < max_file_args) && (j < n); ++k) {
+            sdp = scp->dev_arr + j;
+            if (scp->has_file_args)
+                sdp->file_namep = argv[gen_index_arr[j]];
+            else if (gen_index_arr[k]) {
+                make_dev_name(sdp->fname, k, 1);
+                sdp->file_namep = sdp->fname;
+            } else
                 continue;
-            snprintf(ebuff, EBUFF_SZ, ME "device %s failed on scsi+ata "
-                     "ioctl, skip", file_namep);
-            perror(ebuff);
-            ++num_errors;
-            continue;
+            ++j;
         }
-        res = ioctl(sg_fd, SCSI_IOCTL_GET_BUS_NUMBER, &host_no);
-        if (res < 0) {
-            snprintf(ebuff, EBUFF_SZ, ME "device %s failed on scsi "
-                     "ioctl(2), skip", file_namep);
-            perror(ebuff);
-            ++num_errors;
-            continue;
-        }
-        res = ioctl(sg_fd, SG_EMULATED_HOST, &emul);
-        if (res < 0)
-            emul = -1;
-        printf("%s: scsi%d channel=%d id=%d lun=%d", file_namep, host_no,
-               (my_idlun.dev_id >> 16) & 0xff, my_idlun.dev_id & 0xff,
-               (my_idlun.dev_id >> 8) & 0xff);
-        if (1 == emul)
-            printf(" [em]");
-#if 0
-        printf(", huid=%d", my_idlun.host_unique_id);
-#endif
-        if (! has_file_args) {
-            My_sg_scsi_id m_id; /* compatible with sg_scsi_id_t in sg.h */
-
-            res = ioctl(sg_fd, SG_GET_SCSI_ID, &m_id);
-            if (res < 0) {
-                snprintf(ebuff, EBUFF_SZ, ME "device %s failed "
-                         "SG_GET_SCSI_ID ioctl(4), skip", file_namep);
-                perror(ebuff);
-                ++num_errors;
-                continue;
-            }
-            /* printf("  type=%d", m_id.scsi_type); */
-            if (do_extra)
-                printf("  cmd_per_lun=%hd queue_depth=%hd\n",
-                       m_id.h_cmd_per_lun, m_id.d_queue_depth);
-            else
-                printf("\n");
+        scp->num_devs = n;
+        ret = scan_devices(scp, num_jobs, &num_errors, &num_silent,
+                           &eacces_err);
+        free(scp->dev_arr);
+    } else {
+        /* probe /dev/sg0, /dev/sg1 ... until there are too many errors */
+        scp->dev_arr = (struct scan_dev_t *)malloc(sizeof(struct scan_dev_t));
+        if (NULL == scp->dev_arr) {
+            printf(ME "Out of memory\n");
+            return SG_LIB_CAT_OTHER;
         }
-        else
-            printf("\n");
-        if (do_inquiry) {
-            if (! sg_ver3_set) {
-                sg_ver3 = false;
-                sg_ver3_set = true;
-                if ((ioctl(sg_fd, SG_GET_VERSION_NUM, &f) >= 0) &&
-                    (f >= 30000))
-                    sg_ver3 = true;
-            }
-            if (sg_ver3) {
-                res = sg3_inq(sg_fd, inqBuff, do_extra);
-                if (res)
-                    ++num_errors;
+        scp->num_devs = 1;
+        for (k = 0; (k < max_file_args) && (num_errors < MAX_ERRORS); ++k) {
+            memset(scp->dev_arr, 0, sizeof(struct scan_dev_t));
+            make_dev_name(scp->dev_arr->fname, k, do_numeric);
+            scp->dev_arr->file_namep = scp->dev_arr->fname;
+            res = scan_devices(scp, 1, &num_errors, &num_silent, &eacces_err);
+            if (res) {
+                ret = res;
+                break;
             }
         }
+        free(scp->dev_arr);
     }
+    if (ret)
+        return ret;
     if ((num_errors >= MAX_ERRORS) && (num_silent < num_errors) &&
-        (! has_file_args)) {
+        (! scp->has_file_args)) {
         printf("Stopping because there are too many error\n");
         if (eacces_err)
             printf("    root access may be required\n");
@@ -394,42 +617,56 @@ int main(int argc, char * argv[])
     return 0;
 }
 
-int sg3_inq(int sg_fd, uint8_t * inqBuff, bool do_extra)
+/* Issues an INQUIRY, saving the response (or error) in *sdp for output by
+ * sg3_inq_report() */
+void sg3_inq(struct scan_dev_t * sdp, int sg_fd, int timeout_ms)
 {
-    bool ok;
-    int err, sg_io;
-    uint8_t sense_buffer[32];
-    struct sg_io_hdr io_hdr;
+    struct sg_io_hdr * hp = &sdp->io_hdr;
+
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    memset(sdp->inqBuff, 0, INQ_REPLY_LEN);
+    sdp->inqBuff[0] = 0x7f;
+    hp->interface_id = 'S';
+    hp->cmd_len = sizeof(inq_cdb);
+    hp->mx_sb_len = sizeof(sdp->sense_buffer);
+    hp->dxfer_direction = SG_DXFER_FROM_DEV;
+    hp->dxfer_len = INQ_REPLY_LEN;
+    hp->dxferp = sdp->inqBuff;
+    hp->cmdp = (uint8_t *)inq_cdb;
+    hp->sbp = sdp->sense_buffer;
+    hp->timeout = timeout_ms;
+
+    sdp->inq_sg_io = false;
+    if (ioctl(sg_fd, SG_IO, hp) < 0) {
+        sdp->inq_err = scsi_inq(sg_fd, sdp->inqBuff);
+        if (sdp->inq_err < 0)
+            sdp->inq_err = -errno;
+    } else
+        sdp->inq_sg_io = true;
+}
 
-    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
-    memset(inqBuff, 0, INQ_REPLY_LEN);
-    inqBuff[0] = 0x7f;
-    io_hdr.interface_id = 'S';
-    io_hdr.cmd_len = sizeof(inq_cdb);
-    io_hdr.mx_sb_len = sizeof(sense_buffer);
-    io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
-    io_hdr.dxfer_len = INQ_REPLY_LEN;
-    io_hdr.dxferp = inqBuff;
-    io_hdr.cmdp = inq_cdb;
-    io_hdr.sbp = sense_buffer;
-    io_hdr.timeout = 20000;     /* 20000 millisecs == 20 seconds */
+/* Returns 1 if the INQUIRY could not be sent, else 0 */
+int sg3_inq_report(struct scan_dev_t * sdp, bool do_extra)
+{
+    bool ok;
+    struct sg_io_hdr * hp = &sdp->io_hdr;
 
     ok = true;
-    sg_io = 0;
-    if (ioctl(sg_fd, SG_IO, &io_hdr) < 0) {
-        if ((err = scsi_inq(sg_fd, inqBuff)) < 0) {
-            perror(ME "Inquiry SG_IO + SCSI_IOCTL_SEND_COMMAND ioctl error");
+    if (! sdp->inq_sg_io) {
+        if (sdp->inq_err < 0) {
+            perror_err(ME "Inquiry SG_IO + SCSI_IOCTL_SEND_COMMAND ioctl "
+                       "error", -sdp->inq_err);
             return 1;
-        } else if (err) {
-            printf(ME "SCSI_IOCTL_SEND_COMMAND ioctl error=0x%x\n", err);
+        } else if (sdp->inq_err) {
+            printf(ME "SCSI_IOCTL_SEND_COMMAND ioctl error=0x%x\n",
+                   sdp->inq_err);
             return 1;
         }
     } else {
-        sg_io = 1;
         /* now for the error processing */
-        switch (sg_err_category3(&io_hdr)) {
+        switch (sg_err_category3(hp)) {
         case SG_LIB_CAT_RECOVERED:
-            sg_chk_n_print3("Inquiry, continuing", &io_hdr, true);
+            sg_chk_n_print3("Inquiry, continuing", hp, true);
 #if defined(__GNUC__)
 #if (__GNUC__ >= 7)
             __attribute__((fallthrough));
@@ -440,20 +677,20 @@ int sg3_inq(int sg_fd, uint8_t * inqBuff, bool do_extra)
             break;
         default: /* won't bother decoding other categories */
             ok = false;
-            sg_chk_n_print3("INQUIRY command error", &io_hdr, true);
+            sg_chk_n_print3("INQUIRY command error", hp, true);
             break;
         }
     }
 
     if (ok) { /* output result if it is available */
-        char * p = (char *)inqBuff;
+        char * p = (char *)sdp->inqBuff;
 
         printf("    %.8s  %.16s  %.4s ", p + 8, p + 16, p + 32);
         printf("[rmb=%d cmdq=%d pqual=%d pdev=0x%x] ",
                !!(p[1] & 0x80), !!(p[7] & 2), (p[0] & 0xe0) >> 5,
                (p[0] & 0x1f));
-        if (do_extra && sg_io)
-            printf("dur=%ums\n", io_hdr.duration);
+        if (do_extra && sdp->inq_sg_io)
+            printf("dur=%ums\n", hp->duration);
         else
             printf("\n");
     }
@@ -606,24 +843,21 @@ int ata_command_interface(int device, char *data)
     return 0;
 }
 
-int try_ata_identity(const char * file_namep, int ata_fd, bool do_inq)
+void print_ata_identity(const char * file_namep,
+                        const unsigned short * ata_ident, bool do_inq)
 {
-    struct ata_identify_device ata_ident;
+    const struct ata_identify_device * aidp =
+                        (const struct ata_identify_device *)ata_ident;
     char model[64];
     char serial[64];
     char firm[64];
-    int res;
 
-    res = ata_command_interface(ata_fd, (char *)&ata_ident);
-    if (res)
-        return res;
     printf("%s: ATA device\n", file_namep);
     if (do_inq) {
         printf("    ");
-        printswap(model, (char *)ata_ident.model, 40);
-        printswap(serial, (char *)ata_ident.serial_no, 20);
-        printswap(firm, (char *)ata_ident.fw_rev, 8);
+        printswap(model, (char *)aidp->model, 40);
+        printswap(serial, (char *)aidp->serial_no, 20);
+        printswap(firm, (char *)aidp->fw_rev, 8);
         printf("\n");
     }
-    return res;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006-2018 Douglas Gilbert.
+ * Copyright (c) 2006-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -43,7 +43,7 @@
 
 #include "sg_pt_win32.h"
 
-static const char * version_str = "1.22 (win32) 20181110";
+static const char * version_str = "1.23 (win32) 20261014";
 
 #define MAX_SCSI_ELEMS 4096
 #define MAX_ADAPTER_NUM 256
@@ -52,6 +52,17 @@ static const char * version_str = "1.22 (win32) 20181110";
 #define MAX_TAPE_NUM 512
 #define MAX_HOLE_COUNT 16
 #define MAX_GET_INQUIRY_DATA_SZ (32 * 1024)
+#define DEF_SCAN_JOBS 16
+#define MAX_SCAN_JOBS MAXIMUM_WAIT_OBJECTS      /* 64 */
+#define DEF_SCAN_TMO_MS 5000    /* per IOCTL_STORAGE_QUERY_PROPERTY */
+#define DOS_NAMES_INIT_SZ (64 * 1024)
+#define DOS_NAMES_MAX_SZ (16 * 1024 * 1024)
+
+/* kind of a scan_job_t, also the order in which they are output */
+#define SJ_PD 0
+#define SJ_CDROM 1
+#define SJ_TAPE 2
+#define SJ_VOLUME 3
 
 
 union STORAGE_DEVICE_DESCRIPTOR_DATA {
@@ -73,6 +84,25 @@ struct storage_elem {
     union STORAGE_DEVICE_UID_DATA qp_uid;
 };
 
+/* One DOS device name found by QueryDosDevice() that a worker thread
+ * opens and queries */
+struct scan_job_t {
+    int kind;                   /* SJ_PD, SJ_CDROM, SJ_TAPE or SJ_VOLUME */
+    int num;                    /* <n> of PhysicalDrive<n>, or the letter */
+    bool opened;
+    bool timed_out;
+    DWORD err;                  /* of CreateFile() when ! opened */
+    char path[64];
+    struct storage_elem se;
+};
+
+struct scan_coll_t {
+    DWORD tmo_ms;               /* 0 --> synchronous DeviceIoControl() */
+    int num_jobs;
+    volatile LONG next_ind;
+    struct scan_job_t * arr;
+};
+
 
 static struct storage_elem * storage_arr;
 static uint8_t * free_storage_arr;
@@ -82,9 +112,11 @@ static int verbose = 0;
 static struct option long_options[] = {
         {"bus", no_argument, 0, 'b'},
         {"help", no_argument, 0, 'h'},
+        {"jobs", required_argument, 0, 'j'},
         {"letter", required_argument, 0, 'l'},
         {"verbose", no_argument, 0, 'v'},
         {"scsi", no_argument, 0, 's'},
+        {"timeout", required_argument, 0, 't'},
         {"version", no_argument, 0, 'V'},
         {0, 0, 0, 0},
 };
@@ -93,10 +125,15 @@ static struct option long_options[] = {
 static void
 usage()
 {
-    pr2serr("Usage: sg_scan  [--bus] [--help] [--letter=VL] [--scsi] "
-            "[--verbose] [--version]\n");
+    pr2serr("Usage: sg_scan  [--bus] [--help] [--jobs=J] [--letter=VL] "
+            "[--scsi]\n"
+            "                [--timeout=MS] [--verbose] [--version]\n");
     pr2serr("       --bus|-b        output bus type\n"
             "       --help|-h       output this usage message then exit\n"
+            "       --jobs=J|-j J    query J devices at a time (def: %d, "
+            "max: %d)\n"
+            "                        1 --> probe names serially as in "
+            "the past\n"
             "       --letter=VL|-l VL    volume letter (e.g. 'F' for F:) "
             "to match\n"
             "       --scsi|-s       used once: show SCSI adapters (tuple) "
@@ -104,9 +141,14 @@ usage()
             "                       device scan; default: show no "
             "adapters;\n"
             "                       used twice: show only adapaters\n"
+            "       --timeout=MS|-t MS    give up on a device query after "
+            "MS\n"
+            "                             milliseconds (def: %d; 0 --> "
+            "wait)\n"
             "       --verbose|-v    increase verbosity\n"
             "       --version|-V    print version string and exit\n\n"
-            "Scan for storage and related device names\n");
+            "Scan for storage and related device names\n", DEF_SCAN_JOBS,
+            MAX_SCAN_JOBS, DEF_SCAN_TMO_MS);
 }
 
 static char *
@@ -202,9 +244,51 @@ get_bus_type(int bt)
     }
 }
 
+/* DeviceIoControl() that gives up after tmo_ms milliseconds, in which case
+ * the last error is set to WAIT_TIMEOUT. hdevice must have been opened with
+ * FILE_FLAG_OVERLAPPED unless tmo_ms is 0, when it simply waits. */
+static BOOL
+ioctl_tmo(HANDLE hdevice, DWORD code, void * inp, DWORD in_len, void * outp,
+          DWORD out_len, DWORD * num_outp, DWORD tmo_ms)
+{
+    BOOL ok;
+    OVERLAPPED * ovp;
+
+    if (0 == tmo_ms)
+        return DeviceIoControl(hdevice, code, inp, in_len, outp, out_len,
+                               num_outp, NULL);
+    ovp = (OVERLAPPED *)calloc(1, sizeof(*ovp));
+    if (NULL == ovp)
+        return FALSE;
+    ovp->hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (NULL == ovp->hEvent) {
+        free(ovp);
+        return FALSE;
+    }
+    ok = DeviceIoControl(hdevice, code, inp, in_len, outp, out_len, num_outp,
+                         ovp);
+    if ((! ok) && (ERROR_IO_PENDING == GetLastError())) {
+        if (WAIT_OBJECT_0 == WaitForSingleObject(ovp->hEvent, tmo_ms))
+            ok = GetOverlappedResult(hdevice, ovp, num_outp, FALSE);
+        else {
+            CancelIoEx(hdevice, ovp);
+            if (WAIT_OBJECT_0 != WaitForSingleObject(ovp->hEvent, tmo_ms)) {
+                /* driver ignores cancel; leak rather than free in use */
+                SetLastError(WAIT_TIMEOUT);
+                return FALSE;
+            }
+            SetLastError(WAIT_TIMEOUT);
+            ok = FALSE;
+        }
+    }
+    CloseHandle(ovp->hEvent);
+    free(ovp);
+    return ok;
+}
+
 static int
 query_dev_property(HANDLE hdevice,
-                   union STORAGE_DEVICE_DESCRIPTOR_DATA * data)
+                   union STORAGE_DEVICE_DESCRIPTOR_DATA * data, DWORD tmo_ms)
 {
     DWORD num_out, err;
     char b[256];
@@ -212,16 +296,14 @@ query_dev_property(HANDLE hdevice,
                                     PropertyStandardQuery, {0} };
 
     memset(data, 0, sizeof(*data));
-    if (! DeviceIoControl(hdevice, IOCTL_STORAGE_QUERY_PROPERTY,
-                          &query, sizeof(query), data, sizeof(*data),
-                          &num_out, NULL)) {
-        if (verbose > 2) {
-            err = GetLastError();
+    if (! ioctl_tmo(hdevice, IOCTL_STORAGE_QUERY_PROPERTY, &query,
+                    sizeof(query), data, sizeof(*data), &num_out, tmo_ms)) {
+        err = GetLastError();
+        if (verbose > 2)
             pr2serr("  IOCTL_STORAGE_QUERY_PROPERTY(Devprop) failed, "
                     "Error=%u %s\n", (unsigned int)err,
                     get_err_str(err, sizeof(b), b));
-        }
-        return -ENOSYS;
+        return (WAIT_TIMEOUT == err) ? -ETIMEDOUT : -ENOSYS;
     }
 
     if (verbose > 3)
@@ -231,7 +313,8 @@ query_dev_property(HANDLE hdevice,
 }
 
 static int
-query_dev_uid(HANDLE hdevice, union STORAGE_DEVICE_UID_DATA * data)
+query_dev_uid(HANDLE hdevice, union STORAGE_DEVICE_UID_DATA * data,
+              DWORD tmo_ms)
 {
     DWORD num_out, err;
     char b[256];
@@ -241,31 +324,30 @@ query_dev_uid(HANDLE hdevice, union STORAGE_DEVICE_UID_DATA * data)
     memset(data, 0, sizeof(*data));
     num_out = 0;
     query.QueryType = PropertyExistsQuery;
-    if (! DeviceIoControl(hdevice, IOCTL_STORAGE_QUERY_PROPERTY,
-                          &query, sizeof(query), NULL, 0, &num_out, NULL)) {
-        if (verbose > 2) {
-            err = GetLastError();
+    if (! ioctl_tmo(hdevice, IOCTL_STORAGE_QUERY_PROPERTY, &query,
+                    sizeof(query), NULL, 0, &num_out, tmo_ms)) {
+        err = GetLastError();
+        if (verbose > 2)
             pr2serr("  IOCTL_STORAGE_QUERY_PROPERTY(DevUid(exists)) failed, "
                     "Error=%u %s\n", (unsigned int)err,
                     get_err_str(err, sizeof(b), b));
-        }
         if (verbose > 3)
             pr2serr("      num_out=%u\n", (unsigned int)num_out);
-        /* interpret any error to mean this property doesn't exist */
+        if (WAIT_TIMEOUT == err)
+            return -ETIMEDOUT;
+        /* interpret any other error to mean this property doesn't exist */
         return 0;
     }
 
     query.QueryType = PropertyStandardQuery;
-    if (! DeviceIoControl(hdevice, IOCTL_STORAGE_QUERY_PROPERTY,
-                          &query, sizeof(query), data, sizeof(*data),
-                          &num_out, NULL)) {
-        if (verbose > 2) {
-            err = GetLastError();
+    if (! ioctl_tmo(hdevice, IOCTL_STORAGE_QUERY_PROPERTY, &query,
+                    sizeof(query), data, sizeof(*data), &num_out, tmo_ms)) {
+        err = GetLastError();
+        if (verbose > 2)
             pr2serr("  IOCTL_STORAGE_QUERY_PROPERTY(DevUid) failed, Error=%u "
                     "%s\n", (unsigned int)err,
                     get_err_str(err, sizeof(b), b));
-        }
-        return -ENOSYS;
+        return (WAIT_TIMEOUT == err) ? -ETIMEDOUT : -ENOSYS;
     }
     if (verbose > 3)
         pr2serr("  IOCTL_STORAGE_QUERY_PROPERTY(DevUid) num_out=%u\n",
@@ -419,11 +501,11 @@ enum_volumes(char letter)
                         FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
                         OPEN_EXISTING, 0, NULL);
         if (fh != INVALID_HANDLE_VALUE) {
-            if (query_dev_property(fh, &tmp_se.qp_descriptor) < 0)
+            if (query_dev_property(fh, &tmp_se.qp_descriptor, 0) < 0)
                 pr2serr("%s: query_dev_property failed\n", __FUNCTION__ );
             else
                 tmp_se.qp_descriptor_valid = true;
-            if (query_dev_uid(fh, &tmp_se.qp_uid) < 0) {
+            if (query_dev_uid(fh, &tmp_se.qp_uid, 0) < 0) {
                 if (verbose > 2)
                     pr2serr("%s: query_dev_uid failed\n", __FUNCTION__ );
             } else
@@ -458,11 +540,11 @@ enum_pds(void)
                         FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
                         OPEN_EXISTING, 0, NULL);
         if (fh != INVALID_HANDLE_VALUE) {
-            if (query_dev_property(fh, &tmp_se.qp_descriptor) < 0)
+            if (query_dev_property(fh, &tmp_se.qp_descriptor, 0) < 0)
                 pr2serr("%s: query_dev_property failed\n", __FUNCTION__ );
             else
                 tmp_se.qp_descriptor_valid = true;
-            if (query_dev_uid(fh, &tmp_se.qp_uid) < 0) {
+            if (query_dev_uid(fh, &tmp_se.qp_uid, 0) < 0) {
                 if (verbose > 2)
                     pr2serr("%s: query_dev_uid failed\n", __FUNCTION__ );
             } else
@@ -509,11 +591,11 @@ enum_cdroms(void)
                         FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
                         OPEN_EXISTING, 0, NULL);
         if (fh != INVALID_HANDLE_VALUE) {
-            if (query_dev_property(fh, &tmp_se.qp_descriptor) < 0)
+            if (query_dev_property(fh, &tmp_se.qp_descriptor, 0) < 0)
                 pr2serr("%s: query_dev_property failed\n", __FUNCTION__ );
             else
                 tmp_se.qp_descriptor_valid = true;
-            if (query_dev_uid(fh, &tmp_se.qp_uid) < 0) {
+            if (query_dev_uid(fh, &tmp_se.qp_uid, 0) < 0) {
                 if (verbose > 2)
                     pr2serr("%s: query_dev_uid failed\n", __FUNCTION__ );
             } else
@@ -557,11 +639,11 @@ enum_tapes(void)
                         FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
                         OPEN_EXISTING, 0, NULL);
         if (fh != INVALID_HANDLE_VALUE) {
-            if (query_dev_property(fh, &tmp_se.qp_descriptor) < 0)
+            if (query_dev_property(fh, &tmp_se.qp_descriptor, 0) < 0)
                 pr2serr("%s: query_dev_property failed\n", __FUNCTION__ );
             else
                 tmp_se.qp_descriptor_valid = true;
-            if (query_dev_uid(fh, &tmp_se.qp_uid) < 0) {
+            if (query_dev_uid(fh, &tmp_se.qp_uid, 0) < 0) {
                 if (verbose > 2)
                     pr2serr("%s: query_dev_uid failed\n", __FUNCTION__ );
             } else
@@ -584,25 +666,260 @@ enum_tapes(void)
     return 0;
 }
 
+/* If name (case insensitive) is prefix followed by a decimal number then
+ * returns that number; otherwise returns -1 . */
 static int
-sg_do_wscan(char letter, bool show_bt, int scsi_scan)
+dos_name_num(const char * name, const char * prefix)
+{
+    int n;
+
+    for ( ; *prefix; ++name, ++prefix) {
+        if (toupper((int)*name) != toupper((int)*prefix))
+            return -1;
+    }
+    if (! isdigit((int)*name))
+        return -1;
+    for (n = 0; isdigit((int)*name); ++name)
+        n = (n * 10) + (*name - '0');
+    return ('\0' == *name) ? n : -1;
+}
+
+static int
+scan_job_cmp(const void * ap, const void * bp)
+{
+    const struct scan_job_t * a = (const struct scan_job_t *)ap;
+    const struct scan_job_t * b = (const struct scan_job_t *)bp;
+
+    if (a->kind != b->kind)
+        return a->kind - b->kind;
+    return a->num - b->num;
+}
+
+/* Fetches all MS-DOS device names with a single QueryDosDevice() call and
+ * builds, in output order, a job for each PhysicalDrive<n>, CdRom<n>,
+ * Tape<n> and volume letter found. This replaces probing every possible
+ * name (and stopping after MAX_HOLE_COUNT holes). Returns the number of
+ * jobs placed in *arrp (caller frees), or -1 if QueryDosDevice() failed. */
+static int
+build_scan_jobs(struct scan_job_t ** arrp)
+{
+    int n, num, kind;
+    int num_jobs = 0;
+    DWORD sz = DOS_NAMES_INIT_SZ;
+    DWORD res;
+    char * names = NULL;
+    char * cp;
+    struct scan_job_t * arr;
+    struct scan_job_t * sjp;
+
+    while (true) {
+        free(names);
+        names = (char *)malloc(sz);
+        if (NULL == names)
+            return -1;
+        res = QueryDosDevice(NULL, names, sz);
+        if (res > 0)
+            break;
+        if ((ERROR_INSUFFICIENT_BUFFER != GetLastError()) ||
+            (sz >= DOS_NAMES_MAX_SZ)) {
+            free(names);
+            return -1;
+        }
+        sz *= 4;
+    }
+    for (n = 0, cp = names; *cp; cp += strlen(cp) + 1)
+        ++n;
+    arr = (struct scan_job_t *)calloc(n > 0 ? n : 1, sizeof(*arr));
+    if (NULL == arr) {
+        free(names);
+        return -1;
+    }
+    for (cp = names; *cp; cp += strlen(cp) + 1) {
+        if ((num = dos_name_num(cp, "PhysicalDrive")) >= 0)
+            kind = SJ_PD;
+        else if ((num = dos_name_num(cp, "CdRom")) >= 0)
+            kind = SJ_CDROM;
+        else if ((num = dos_name_num(cp, "Tape")) >= 0)
+            kind = SJ_TAPE;
+        else if ((toupper((int)cp[0]) >= 'C') &&
+                 (toupper((int)cp[0]) <= 'Z') && (':' == cp[1]) &&
+                 ('\0' == cp[2])) {
+            kind = SJ_VOLUME;
+            num = toupper((int)cp[0]);
+        } else
+            continue;
+        sjp = arr + num_jobs++;
+        sjp->kind = kind;
+        sjp->num = num;
+        switch (kind) {
+        case SJ_PD:
+            snprintf(sjp->path, sizeof(sjp->path),
+                     "\\\\.\\PhysicalDrive%d", num);
+            snprintf(sjp->se.name, sizeof(sjp->se.name), "PD%d", num);
+            break;
+        case SJ_CDROM:
+            snprintf(sjp->path, sizeof(sjp->path), "\\\\.\\CDROM%d",
+                     num);
+            snprintf(sjp->se.name, sizeof(sjp->se.name), "CDROM%d", num);
+            break;
+        case SJ_TAPE:
+            snprintf(sjp->path, sizeof(sjp->path), "\\\\.\\TAPE%d",
+                     num);
+            snprintf(sjp->se.name, sizeof(sjp->se.name), "TAPE%d", num);
+            break;
+        default:
+            snprintf(sjp->path, sizeof(sjp->path), "\\\\.\\%c:", num);
+            sjp->se.name[0] = (char)num;
+            break;
+        }
+    }
+    free(names);
+    qsort(arr, num_jobs, sizeof(*arr), scan_job_cmp);
+    *arrp = arr;
+    return num_jobs;
+}
+
+/* Worker thread: takes jobs, in order, until none are left and opens then
+ * queries each. A device that is slow to answer only holds up this worker
+ * and, when cp->tmo_ms is non-zero, only for that long per query. */
+static DWORD WINAPI
+scan_worker(LPVOID v_cp)
+{
+    int k, res;
+    HANDLE fh;
+    struct scan_coll_t * cp = (struct scan_coll_t *)v_cp;
+    struct scan_job_t * sjp;
+
+    while ((k = (int)InterlockedIncrement(&cp->next_ind) - 1) <
+           cp->num_jobs) {
+        sjp = cp->arr + k;
+        fh = CreateFile(sjp->path, GENERIC_READ | GENERIC_WRITE,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                        OPEN_EXISTING,
+                        (cp->tmo_ms ? FILE_FLAG_OVERLAPPED : 0), NULL);
+        if (fh == INVALID_HANDLE_VALUE) {
+            sjp->err = GetLastError();
+            continue;
+        }
+        sjp->opened = true;
+        res = query_dev_property(fh, &sjp->se.qp_descriptor, cp->tmo_ms);
+        if (0 == res)
+            sjp->se.qp_descriptor_valid = true;
+        else if (-ETIMEDOUT == res)
+            sjp->timed_out = true;
+        if (! sjp->timed_out) {
+            res = query_dev_uid(fh, &sjp->se.qp_uid, cp->tmo_ms);
+            if (0 == res)
+                sjp->se.qp_uid_valid = true;
+            else if (-ETIMEDOUT == res)
+                sjp->timed_out = true;
+        }
+        CloseHandle(fh);
+    }
+    return 0;
+}
+
+/* Queries the devices found by build_scan_jobs() with up to num_thr worker
+ * threads then, in the order the serial enum_*() functions would have, adds
+ * them to storage_arr and merges in the volumes. Returns 0 on success, -1 if
+ * the DOS device names could not be fetched (so the caller should fall back
+ * to probing them serially), else an error. */
+static int
+enum_all_parallel(char letter, int num_thr, DWORD tmo_ms)
+{
+    int k, num_jobs;
+    HANDLE tids[MAX_SCAN_JOBS];
+    struct scan_coll_t coll;
+    struct scan_job_t * sjp;
+    char b[256];
+
+    memset(&coll, 0, sizeof(coll));
+    num_jobs = build_scan_jobs(&coll.arr);
+    if (num_jobs < 0)
+        return -1;
+    coll.num_jobs = num_jobs;
+    coll.tmo_ms = tmo_ms;
+    if (verbose > 2)
+        pr2serr("%s: %d DOS device names to query with %d threads\n",
+                __FUNCTION__, num_jobs, num_thr);
+    if (num_thr > num_jobs)
+        num_thr = num_jobs;
+    for (k = 0; k < num_thr; ++k) {
+        tids[k] = CreateThread(NULL, 0, scan_worker, &coll, 0, NULL);
+        if (NULL == tids[k]) {
+            pr2serr("CreateThread failed, continue with %d threads\n", k);
+            break;
+        }
+    }
+    num_thr = k;
+    if (0 == num_thr)
+        scan_worker(&coll);     /* no threads, so do them all here */
+    else {
+        WaitForMultipleObjects(num_thr, tids, TRUE, INFINITE);
+        for (k = 0; k < num_thr; ++k)
+            CloseHandle(tids[k]);
+    }
+
+    for (k = 0, sjp = coll.arr; k < num_jobs; ++k, ++sjp) {
+        if (sjp->timed_out)
+            pr2serr("%s: no response within %u ms\n", sjp->path,
+                    (unsigned int)tmo_ms);
+        if (! sjp->opened) {
+            if ((SJ_PD == sjp->kind) && (ERROR_ACCESS_DENIED == sjp->err))
+                pr2serr("Access denied on %s, may need Administrator\n",
+                        sjp->path);
+            else if (ERROR_SHARING_VIOLATION == sjp->err)
+                pr2serr("%s: in use by other process (sharing violation "
+                        "[34])\n", sjp->path);
+            else if (verbose > 3)
+                pr2serr("%s: CreateFile failed err=%u\n\t%s", sjp->path,
+                        (unsigned int)sjp->err,
+                        get_err_str(sjp->err, sizeof(b), b));
+            continue;
+        }
+        if (SJ_VOLUME == sjp->kind) {
+            if (('\0' == letter) || (letter == sjp->se.name[0]))
+                check_devices(&sjp->se);
+        } else if (next_unused_elem < MAX_SCSI_ELEMS) {
+            if ((! sjp->se.qp_descriptor_valid) && (! sjp->timed_out))
+                pr2serr("%s: query_dev_property failed\n", sjp->path);
+            memcpy(&storage_arr[next_unused_elem++], &sjp->se,
+                   sizeof(sjp->se));
+        }
+    }
+    free(coll.arr);
+    return 0;
+}
+
+static int
+sg_do_wscan(char letter, bool show_bt, int scsi_scan, int num_jobs,
+            DWORD tmo_ms)
 {
     int k, j, n;
     struct storage_elem * sp;
 
     if (scsi_scan < 2) {
-        k = enum_pds();
-        if (k)
-            return k;
-        k = enum_cdroms();
-        if (k)
-            return k;
-        k = enum_tapes();
-        if (k)
-            return k;
-        k = enum_volumes(letter);
-        if (k)
+        k = (num_jobs > 1) ? enum_all_parallel(letter, num_jobs, tmo_ms) :
+                             -1;
+        if (k > 0)
             return k;
+        if (k < 0) {
+            if ((num_jobs > 1) && verbose)
+                pr2serr("QueryDosDevice failed, probe device names "
+                        "serially\n");
+            k = enum_pds();
+            if (k)
+                return k;
+            k = enum_cdroms();
+            if (k)
+                return k;
+            k = enum_tapes();
+            if (k)
+                return k;
+            k = enum_volumes(letter);
+            if (k)
+                return k;
+        }
 
         for (k = 0; k < next_unused_elem; ++k) {
             sp = storage_arr + k;
@@ -667,11 +984,13 @@ main(int argc, char * argv[])
     int c, ret;
     int vol_letter = 0;
     int scsi_scan = 0;
+    int num_jobs = DEF_SCAN_JOBS;
+    int tmo_ms = DEF_SCAN_TMO_MS;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "bhHl:svV", long_options,
+        c = getopt_long(argc, argv, "bhHj:l:st:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -684,6 +1003,13 @@ main(int argc, char * argv[])
         case '?':
             usage();
             return 0;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_SCAN_JOBS)) {
+                pr2serr("'--jobs=' expects 1 to %d\n", MAX_SCAN_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             vol_letter = toupper(optarg[0]);
             if ((vol_letter < 'C') || (vol_letter > 'Z')) {
@@ -696,6 +1022,13 @@ main(int argc, char * argv[])
         case 's':
             ++scsi_scan;
             break;
+        case 't':
+            tmo_ms = sg_get_num(optarg);
+            if (tmo_ms < 0) {
+                pr2serr("'--timeout=' expects a number of milliseconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'v':
             ++verbose;
             break;
@@ -721,7 +1054,8 @@ main(int argc, char * argv[])
                   sg_memalign(sizeof(struct storage_elem) * MAX_SCSI_ELEMS, 0,
                               &free_storage_arr, false);
     if (storage_arr) {
-        ret = sg_do_wscan(vol_letter, show_bt, scsi_scan);
+        ret = sg_do_wscan(vol_letter, show_bt, scsi_scan, num_jobs,
+                          (DWORD)tmo_ms);
         if (free_storage_arr)
             free(free_storage_arr);
     } else {
@@ -23,6 +23,14 @@
 #include "config.h"
 #endif
 
+#ifdef SG_LIB_LINUX
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+
 #if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
 #include <time.h>
 #elif defined(HAVE_GETTIMEOFDAY)
@@ -35,6 +43,7 @@
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
 #include "sg_unaligned.h"
+#include "sg_pt.h"
 #include "sg_pr2serr.h"
 
 /*
@@ -49,24 +58,66 @@
  * to that LBA ...
  */
 
-static const char * version_str = "1.07 20180911";
+static const char * version_str = "1.08 20261014";
 
 #define BACKGROUND_CONTROL_SA 0x15
 
 #define CMD_ABORT_TIMEOUT  60      /* 60 seconds */
 
+#define PRE_FETCH16_CMD 0x90
+#define PRE_FETCH16_CMDLEN 16
+#define DEF_PT_TIMEOUT 60       /* 60 seconds */
+#define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
+#define MAX_QD 64               /* --qd= upper limit */
+#define DEF_EXT_QD 8            /* PRE-FETCHes in flight with extents */
+#define DEF_EXT_CHUNK 2048      /* most blocks per PRE-FETCH of an extent */
+#define FIEMAP_NUM_EXT 256      /* extents fetched per FS_IOC_FIEMAP */
+
+/* A range of logical blocks from --extents= or --fiemap= */
+struct pf_ext {
+    uint64_t lba;
+    uint64_t num;
+};
+
+/* The extents to pre-fetch and what happened to them */
+struct pf_coll {
+    bool keep_going;            /* --keep-going: past cache full and errors */
+    bool stop;
+    int grpnum;
+    int vb;
+    int ext_num;
+    int ext_max;
+    int ext_ind;                /* next extent to pre-fetch ... */
+    uint64_t ext_off;           /* ... from this block into it */
+    uint32_t chunk;             /* most blocks per PRE-FETCH */
+    struct pf_ext * ext;
+    uint32_t num_cmds;
+    uint32_t num_cond_met;
+    uint32_t num_good;          /* each means the cache was full */
+    uint32_t num_err;
+    int first_err;
+    int last_err;
+    uint64_t blks_cond_met;     /* blocks the device said fitted its cache */
+    uint64_t full_lba;          /* first LBA of the first GOOD PRE-FETCH */
+};
+
 
 static struct option long_options[] = {
         {"10", no_argument, 0, 'T'},
         {"count", required_argument, 0, 'c'},
+        {"extents", required_argument, 0, 'e'},
+        {"fiemap", required_argument, 0, 'f'},
         {"grpnum", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"immed", no_argument, 0, 'i'},
+        {"keep-going", no_argument, 0, 'k'},
+        {"keep_going", no_argument, 0, 'k'},
         {"lba", required_argument, 0, 'l'},
         {"num-blocks", required_argument, 0, 'n'},
         {"num_blocks", required_argument, 0, 'n'},
         {"pre-fetch", no_argument, 0, 'p'},
         {"pre_fetch", no_argument, 0, 'p'},
+        {"qd", required_argument, 0, 'q'},
         {"readonly", no_argument, 0, 'r'},
         {"skip", required_argument, 0, 's'},
         {"time", required_argument, 0, 't'},
@@ -82,8 +133,10 @@ static void
 usage()
 {
     pr2serr("Usage: "
-            "sg_seek  [--10] [--count=NC] [--grpnum=GN] [--help] [--immed]\n"
-            "                [--lba=LBA] [--num-blocks=NUM] [--pre-fetch] "
+            "sg_seek  [--10] [--count=NC] [--extents=EF] [--fiemap=FILE]\n"
+            "                [--grpnum=GN] [--help] [--immed] [--keep-going] "
+            "[--lba=LBA]\n"
+            "                [--num-blocks=NUM] [--pre-fetch] [--qd=QD] "
             "[--readonly]\n"
             "                [--skip=SB] [--time] [--verbose] [--version]\n"
             "                [--wrap-offset=WO] DEVICE\n");
@@ -94,20 +147,35 @@ usage()
             "given)\n"
             "    --count=NC|-c NC    NC is number of commands to execute "
             "(def: 1)\n"
+            "    --extents=EF|-e EF    PRE-FETCH(16) the LBA,NUM pairs, one "
+            "per line,\n"
+            "                          in file EF ('-' for stdin)\n"
+            "    --fiemap=FILE|-f FILE    PRE-FETCH(16) the extents of FILE, "
+            "held on\n"
+            "                             DEVICE, found with FS_IOC_FIEMAP\n"
             "    --grpnum=GN|-g GN    GN is group number to place in "
             "PRE-FETCH\n"
             "                         cdb; 0 to 63 (def: 0)\n"
             "    --help|-h           print out usage message\n"
-            "    --immed|-i          set IMMED bit in PRE-FETCH command\n"
+            "    --immed|-i          set IMMED bit in PRE-FETCH command "
+            "(always with\n"
+            "                        EF or FILE)\n"
+            "    --keep-going|-k     with EF or FILE don't stop when the "
+            "cache is full\n"
+            "                        (GOOD status) or at an error\n"
             "    --lba=LBA|-l LBA    starting Logical Block Address (LBA) "
             "(def: 0)\n"
             "    --num-blocks=NUM|-n NUM    number of blocks to cache (for "
             "PRE-FETCH)\n"
             "                               (def: 1). Ignored by "
-            "SEEK(10)\n");
+            "SEEK(10). With\n"
+            "                               EF or FILE most blocks per "
+            "command (def: %d)\n", DEF_EXT_CHUNK);
     pr2serr("    --pre-fetch|-p     do PRE-FETCH command, 16 byte variant if "
             "--10 not\n"
             "                       given (def: do SEEK(10))\n"
+            "    --qd=QD|-q QD      with EF or FILE keep QD commands in "
+            "flight (def: %d)\n"
             "    --readonly|-r      open DEVICE read-only (if supported)\n"
             "    --skip=SB|-s SB    when NC>1 skip SB blocks to next LBA "
             "(def: 1)\n"
@@ -124,10 +192,334 @@ usage()
             "with an LBA of 0 . If NC>1\nthen a tally is kept of successes, "
             "'condition-met's and errors that is\nprinted on completion. "
             "'condition-met' is from PRE-FETCH when NUM blocks\nfit in "
-            "the DEVICE's cache.\n"
+            "the DEVICE's cache. With EF or FILE each extent is\n"
+            "pre-fetched, QD commands at a time, stopping once one returns "
+            "GOOD as\nthe cache is then full.\n", DEF_EXT_QD
            );
 }
 
+/* Appends the extent of 'num' blocks from 'lba' to those in cp. Returns 0,
+ * else 1 if out of memory. */
+static int
+add_extent(struct pf_coll * cp, uint64_t lba, uint64_t num)
+{
+    struct pf_ext * ep;
+
+    if (0 == num)
+        return 0;
+    if (cp->ext_num >= cp->ext_max) {
+        cp->ext_max = cp->ext_max ? (2 * cp->ext_max) : 64;
+        ep = (struct pf_ext *)realloc(cp->ext,
+                                      cp->ext_max * sizeof(struct pf_ext));
+        if (NULL == ep) {
+            pr2serr("%s: out of memory\n", __func__);
+            return 1;
+        }
+        cp->ext = ep;
+    }
+    cp->ext[cp->ext_num].lba = lba;
+    cp->ext[cp->ext_num].num = num;
+    ++cp->ext_num;
+    return 0;
+}
+
+/* Reads the extents in file_name (or stdin when "-"): one LBA,NUM pair
+ * (comma or whitespace separated) per line. Blank lines and those starting
+ * with '#' are ignored. Returns 0 if ok, else a SG_LIB_* exit status. */
+static int
+read_extents(const char * file_name, struct pf_coll * cp)
+{
+    bool have_stdin = (0 == strcmp("-", file_name));
+    int j, ret = 0;
+    int64_t lba, num;
+    char * lcp;
+    char * ncp;
+    FILE * fp;
+    char line[1024];
+
+    if (have_stdin)
+        fp = stdin;
+    else if (NULL == (fp = fopen(file_name, "r"))) {
+        ret = errno;
+        pr2serr("%s: unable to open %s: %s\n", __func__, file_name,
+                safe_strerror(ret));
+        return sg_convert_errno(ret);
+    }
+    for (j = 1; fgets(line, sizeof(line), fp); ++j) {
+        lcp = line + strspn(line, " \t");
+        if (('#' == *lcp) || ('\n' == *lcp) || ('\0' == *lcp))
+            continue;
+        lcp[strcspn(lcp, "#\r\n")] = '\0';
+        num = -1;
+        if ((ncp = strpbrk(lcp, " ,\t"))) {
+            *ncp++ = '\0';
+            ncp += strspn(ncp, " ,\t");
+            ncp[strcspn(ncp, " \t")] = '\0';
+            num = sg_get_llnum(ncp);
+        }
+        lba = sg_get_llnum(lcp);
+        if ((lba < 0) || (num < 0)) {
+            pr2serr("%s: expect LBA,NUM at line %d of %s\n", __func__, j,
+                    have_stdin ? "stdin" : file_name);
+            ret = SG_LIB_SYNTAX_ERROR;
+            break;
+        }
+        if (add_extent(cp, (uint64_t)lba, (uint64_t)num)) {
+            ret = sg_convert_errno(ENOMEM);
+            break;
+        }
+    }
+    if (! have_stdin)
+        fclose(fp);
+    return ret;
+}
+
+#ifdef SG_LIB_LINUX
+
+/* Finds the extents of file_name with the FS_IOC_FIEMAP ioctl and turns
+ * their physical byte offsets into LBAs of 'lbs' byte logical blocks. Those
+ * offsets are from the start of the block device holding the file system,
+ * so when that is a partition its start is added. Extents that are not yet
+ * allocated, unwritten (preallocated) or not block aligned are skipped.
+ * Returns 0 if ok, else a SG_LIB_* exit status. */
+static int
+fiemap_extents(const char * file_name, uint32_t lbs, struct pf_coll * cp)
+{
+    bool last = false;
+    int fd, k, err;
+    int ret = 0;
+    uint32_t skip_fl = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC |
+                       FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_INLINE |
+                       FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_UNWRITTEN;
+    uint64_t part_start = 0;
+    uint64_t first, end;
+    struct stat st;
+    struct fiemap * fmp;
+    const struct fiemap_extent * fep;
+    FILE * fp;
+    char b[128];
+
+    if ((fd = open(file_name, O_RDONLY)) < 0) {
+        err = errno;
+        pr2serr("%s: unable to open %s: %s\n", __func__, file_name,
+                safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    if (0 == fstat(fd, &st)) {
+        snprintf(b, sizeof(b), "/sys/dev/block/%u:%u/start",
+                 major(st.st_dev), minor(st.st_dev));
+        if ((fp = fopen(b, "r"))) {     /* only partitions have 'start' */
+            if (1 != fscanf(fp, "%" SCNu64, &part_start))
+                part_start = 0;
+            fclose(fp);
+            part_start *= 512;          /* sysfs counts 512 byte sectors */
+        }
+        if (cp->vb)
+            pr2serr("%s is on block device %u:%u, partition starts at byte "
+                    "%" PRIu64 "\n", file_name, major(st.st_dev),
+                    minor(st.st_dev), part_start);
+    }
+    fmp = (struct fiemap *)calloc(1, sizeof(struct fiemap) +
+                                  (FIEMAP_NUM_EXT *
+                                   sizeof(struct fiemap_extent)));
+    if (NULL == fmp) {
+        close(fd);
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    while (! last) {
+        fmp->fm_length = FIEMAP_MAX_OFFSET - fmp->fm_start;
+        fmp->fm_flags = FIEMAP_FLAG_SYNC;
+        fmp->fm_extent_count = FIEMAP_NUM_EXT;
+        fmp->fm_mapped_extents = 0;
+        if (ioctl(fd, FS_IOC_FIEMAP, fmp) < 0) {
+            err = errno;
+            pr2serr("%s: FS_IOC_FIEMAP on %s: %s\n", __func__, file_name,
+                    safe_strerror(err));
+            ret = sg_convert_errno(err);
+            break;
+        }
+        if (0 == fmp->fm_mapped_extents)
+            break;
+        for (k = 0; k < (int)fmp->fm_mapped_extents; ++k) {
+            fep = fmp->fm_extents + k;
+            if (fep->fe_flags & FIEMAP_EXTENT_LAST)
+                last = true;
+            if (fep->fe_flags & skip_fl)
+                continue;
+            first = (part_start + fep->fe_physical) / lbs;
+            end = (part_start + fep->fe_physical + fep->fe_length + lbs - 1) /
+                  lbs;
+            if (cp->vb > 1)
+                pr2serr("  file offset %" PRIu64 ": %" PRIu64 " bytes at LBA "
+                        "%" PRIu64 "\n", (uint64_t)fep->fe_logical,
+                        (uint64_t)fep->fe_length, first);
+            if (add_extent(cp, first, end - first)) {
+                ret = sg_convert_errno(ENOMEM);
+                last = true;
+                break;
+            }
+        }
+        fep = fmp->fm_extents + fmp->fm_mapped_extents - 1;
+        fmp->fm_start = fep->fe_logical + fep->fe_length;
+    }
+    free(fmp);
+    close(fd);
+    return ret;
+}
+
+#else
+
+static int
+fiemap_extents(const char * file_name, uint32_t lbs, struct pf_coll * cp)
+{
+    if (cp->vb)
+        pr2serr("%s: %s, lbs=%u\n", __func__, file_name, lbs);
+    pr2serr("--fiemap= is only supported in Linux\n");
+    return SG_LIB_SYNTAX_ERROR;
+}
+
+#endif
+
+/* Sets the cdb at cdbp to a PRE-FETCH(16) with IMMED of the next piece (up
+ * to cp->chunk blocks) of the extents. Returns false when there is none. */
+static bool
+next_prefetch(struct pf_coll * cp, uint8_t * cdbp)
+{
+    uint64_t n;
+    const struct pf_ext * ep;
+
+    if (cp->stop || (cp->ext_ind >= cp->ext_num))
+        return false;
+    ep = cp->ext + cp->ext_ind;
+    n = ep->num - cp->ext_off;
+    if (n > cp->chunk)
+        n = cp->chunk;
+    memset(cdbp, 0, PRE_FETCH16_CMDLEN);
+    cdbp[0] = PRE_FETCH16_CMD;
+    cdbp[1] = 0x2;              /* IMMED */
+    sg_put_unaligned_be64(ep->lba + cp->ext_off, cdbp + 2);
+    sg_put_unaligned_be32((uint32_t)n, cdbp + 10);
+    cdbp[14] = 0x3f & cp->grpnum;
+    cp->ext_off += n;
+    if (cp->ext_off >= ep->num) {
+        ++cp->ext_ind;
+        cp->ext_off = 0;
+    }
+    return true;
+}
+
+/* Tallies the outcome of the PRE-FETCH(16) in ptvp, whose do_scsi_pt_*()
+ * call returned pt_res. A GOOD status (rather than CONDITION MET) means
+ * the device had no room left in its cache for those blocks, so unless
+ * --keep-going is given no more are sent. */
+static void
+prefetch_done(struct pf_coll * cp, struct sg_pt_base * ptvp,
+              const uint8_t * cdbp, int pt_res)
+{
+    int ret, s_cat;
+    static const char * const cdb_s = "Pre-fetch(16)";
+
+    ++cp->num_cmds;
+    ret = sg_cmds_process_resp(ptvp, cdb_s, pt_res, true, cp->vb, &s_cat);
+    if (-1 == ret)
+        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == ret)
+        ret = ((SG_LIB_CAT_RECOVERED == s_cat) ||
+               (SG_LIB_CAT_NO_SENSE == s_cat)) ? 0 : s_cat;
+    else
+        ret = 0;
+    if (SG_LIB_CAT_CONDITION_MET == ret) {
+        ++cp->num_cond_met;
+        cp->blks_cond_met += sg_get_unaligned_be32(cdbp + 10);
+        return;
+    } else if (0 == ret) {
+        if (0 == cp->num_good)
+            cp->full_lba = sg_get_unaligned_be64(cdbp + 2);
+        ++cp->num_good;
+    } else {
+        ++cp->num_err;
+        if (0 == cp->first_err)
+            cp->first_err = ret;
+        cp->last_err = ret;
+    }
+    if (! cp->keep_going)
+        cp->stop = true;
+}
+
+/* Submits the next PRE-FETCH(16) of the extents on ptvp, tallying any that
+ * fail to be submitted. Returns true if one is in flight. */
+static bool
+prefetch_start(struct pf_coll * cp, struct sg_pt_base * ptvp,
+               uint8_t * cdbp, int pack_id)
+{
+    int rs;
+
+    while (next_prefetch(cp, cdbp)) {
+        set_scsi_pt_cdb(ptvp, cdbp, PRE_FETCH16_CMDLEN);
+        set_scsi_pt_packet_id(ptvp, pack_id);
+        rs = do_scsi_pt_submit(ptvp, -1, DEF_PT_TIMEOUT, cp->vb);
+        if (0 == rs)
+            return true;
+        prefetch_done(cp, ptvp, cdbp, rs);
+        rearm_scsi_pt_obj(ptvp);
+    }
+    return false;
+}
+
+/* Pre-fetches the extents in cp keeping up to qd commands in flight on
+ * sg_fd, each with its own pt object. Completions are reaped in
+ * submission order and each slot is refilled while blocks remain. Returns
+ * 0, else a SG_LIB_* exit status if the pt objects could not be made. */
+static int
+prefetch_extents(int sg_fd, struct pf_coll * cp, int qd)
+{
+    int k, rs;
+    int ret = 0;
+    int inflight = 0;
+    int pack_id = 0;
+    bool busy[MAX_QD];
+    struct sg_pt_base * ptv_arr[MAX_QD];
+    uint8_t cdb_arr[MAX_QD][PRE_FETCH16_CMDLEN];
+    uint8_t sense_arr[MAX_QD][SENSE_BUFF_LEN];
+
+    memset(ptv_arr, 0, sizeof(ptv_arr));
+    memset(busy, 0, sizeof(busy));
+    for (k = 0; k < qd; ++k) {
+        ptv_arr[k] = construct_scsi_pt_obj_with_fd(sg_fd, cp->vb);
+        if ((NULL == ptv_arr[k]) || get_scsi_pt_os_err(ptv_arr[k])) {
+            pr2serr("%s: unable to construct pt object\n", __func__);
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        set_scsi_pt_sense(ptv_arr[k], sense_arr[k], sizeof(sense_arr[k]));
+    }
+    for (k = 0; k < qd; ++k) {
+        if (! prefetch_start(cp, ptv_arr[k], cdb_arr[k], ++pack_id))
+            break;
+        busy[k] = true;
+        ++inflight;
+    }
+    for (k = 0; inflight > 0; k = (k + 1) % qd) {
+        if (! busy[k])
+            continue;
+        rs = do_scsi_pt_receive(ptv_arr[k], false, cp->vb);
+        busy[k] = false;
+        --inflight;
+        prefetch_done(cp, ptv_arr[k], cdb_arr[k], rs);
+        rearm_scsi_pt_obj(ptv_arr[k]);  /* keeps sense buffer binding */
+        if (prefetch_start(cp, ptv_arr[k], cdb_arr[k], ++pack_id)) {
+            busy[k] = true;
+            ++inflight;
+        }
+    }
+fini:
+    for (k = 0; k < qd; ++k) {
+        if (ptv_arr[k])
+            destruct_scsi_pt_obj(ptv_arr[k]);
+    }
+    return ret;
+}
 
 int
 main(int argc, char * argv[])
@@ -136,6 +528,7 @@ main(int argc, char * argv[])
     bool count_given = false;
     bool do_time = false;
     bool immed = false;
+    bool num_given = false;
     bool prefetch = false;
     bool readonly = false;
     bool start_tm_valid = false;
@@ -147,6 +540,7 @@ main(int argc, char * argv[])
     int last_err = 0;
     int ret = 0;
     int verbose = 0;
+    int qd = 0;
     uint32_t count = 1;
     int32_t l;
     uint32_t grpnum = 0;
@@ -163,6 +557,9 @@ main(int argc, char * argv[])
     uint64_t lba_n;
     const char * device_name = NULL;
     const char * cdb_name = NULL;
+    const char * ext_fn = NULL;
+    const char * fiemap_fn = NULL;
+    struct pf_coll pfc;
     char b[64];
 #if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
     struct timespec start_tm, end_tm;
@@ -170,11 +567,12 @@ main(int argc, char * argv[])
     struct timeval start_tm, end_tm;
 #endif
 
+    memset(&pfc, 0, sizeof(pfc));
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "c:g:hil:n:prs:tTvVw:", long_options,
-                        &option_index);
+        c = getopt_long(argc, argv, "c:e:f:g:hikl:n:pq:rs:tTvVw:",
+                        long_options, &option_index);
         if (c == -1)
             break;
 
@@ -189,6 +587,12 @@ main(int argc, char * argv[])
             count = (uint32_t)l;
             count_given = true;
             break;
+        case 'e':
+            ext_fn = optarg;
+            break;
+        case 'f':
+            fiemap_fn = optarg;
+            break;
         case 'g':
             l = sg_get_num(optarg);
             if ((l > 63) || (l < 0)) {
@@ -204,6 +608,9 @@ main(int argc, char * argv[])
         case 'i':
             immed = true;
             break;
+        case 'k':
+            pfc.keep_going = true;
+            break;
         case 'l':
             ll = sg_get_llnum(optarg);
             if (-1 == ll) {
@@ -219,10 +626,18 @@ main(int argc, char * argv[])
                 return SG_LIB_SYNTAX_ERROR;
             }
             numblocks = (uint32_t)l;
+            num_given = true;
             break;
         case 'p':
             prefetch = true;
             break;
+        case 'q':
+            qd = sg_get_num(optarg);
+            if ((qd < 1) || (qd > MAX_QD)) {
+                pr2serr("--qd= expect argument in range 1 to %d\n", MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'r':
             readonly = true;
             break;
@@ -302,6 +717,32 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
 
+    if (ext_fn || fiemap_fn) {
+        if (ext_fn && fiemap_fn) {
+            pr2serr("--extents= and --fiemap= contradict\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (cdb10 || count_given) {
+            pr2serr("--10 and --count= contradict --extents= and "
+                    "--fiemap=\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (num_given && (0 == numblocks)) {
+            pr2serr("--num-blocks= must be greater than 0 with extents\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        prefetch = true;
+        pfc.chunk = num_given ? numblocks : DEF_EXT_CHUNK;
+        pfc.grpnum = grpnum;
+        pfc.vb = verbose;
+        if (0 == qd)
+            qd = DEF_EXT_QD;
+        if (ext_fn && (ret = read_extents(ext_fn, &pfc)))
+            goto fini;
+    } else if (qd > 0) {
+        pr2serr("--qd= needs --extents= or --fiemap=\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
     if (prefetch) {
         if (cdb10)
             cdb_name = "Pre-fetch(10)";
@@ -318,6 +759,27 @@ main(int argc, char * argv[])
         ret = sg_convert_errno(-sg_fd);
         goto fini;
     }
+    if (fiemap_fn) {
+        uint8_t rc_b[32];
+
+        /* FIEMAP gives byte offsets, so need the logical block size */
+        memset(rc_b, 0, sizeof(rc_b));
+        res = sg_ll_readcap_16(sg_fd, false, 0, rc_b, sizeof(rc_b), true,
+                               verbose);
+        if (0 == res)
+            l = sg_get_unaligned_be32(rc_b + 8);
+        else if (0 == (res = sg_ll_readcap_10(sg_fd, false, 0, rc_b, 8, true,
+                                              verbose)))
+            l = sg_get_unaligned_be32(rc_b + 4);
+        if (res || (l <= 0)) {
+            pr2serr("unable to find the logical block size of %s\n",
+                    device_name);
+            ret = res ? res : SG_LIB_CAT_OTHER;
+            goto fini;
+        }
+        if ((ret = fiemap_extents(fiemap_fn, (uint32_t)l, &pfc)))
+            goto fini;
+    }
 #if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
     if (do_time) {
         start_tm.tv_sec = 0;
@@ -338,21 +800,34 @@ main(int argc, char * argv[])
     start_tm_valid = false;
 #endif
 
-    for (k = 0, lba_n = lba; k < count; ++k, lba_n += skip) {
-        if (wrap_offs && (lba_n > lba) && ((lba_n - lba) > wrap_offs))
-            lba_n = lba;
-        res = sg_ll_pre_fetch_x(sg_fd, ! prefetch, ! cdb10, immed, lba_n,
-                                numblocks, grpnum, 0, (verbose > 0), verbose);
-        ret = res;      /* last command executed sets exit status */
-        if (SG_LIB_CAT_CONDITION_MET == res)
-            ++num_cond_met;
-        else if (res) {
-            ++num_err;
-            if (0 == first_err)
-                first_err = res;
-            last_err = res;
-        } else
-            ++num_good;
+    if (ext_fn || fiemap_fn) {
+        ret = prefetch_extents(sg_fd, &pfc, qd);
+        count = pfc.num_cmds;
+        num_cond_met = pfc.num_cond_met;
+        num_good = pfc.num_good;
+        num_err = pfc.num_err;
+        first_err = pfc.first_err;
+        last_err = pfc.last_err;
+        if ((0 == ret) && first_err)
+            ret = first_err;
+    } else {
+        for (k = 0, lba_n = lba; k < count; ++k, lba_n += skip) {
+            if (wrap_offs && (lba_n > lba) && ((lba_n - lba) > wrap_offs))
+                lba_n = lba;
+            res = sg_ll_pre_fetch_x(sg_fd, ! prefetch, ! cdb10, immed,
+                                    lba_n, numblocks, grpnum, 0,
+                                    (verbose > 0), verbose);
+            ret = res;      /* last command executed sets exit status */
+            if (SG_LIB_CAT_CONDITION_MET == res)
+                ++num_cond_met;
+            else if (res) {
+                ++num_err;
+                if (0 == first_err)
+                    first_err = res;
+                last_err = res;
+            } else
+                ++num_good;
+        }
     }
 
 #if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
@@ -393,6 +868,14 @@ main(int argc, char * argv[])
     if (count_given && verbose_given)
         printf("Command count=%u, number of condition_mets=%u, number of "
                "goods=%u\n", count, num_cond_met, num_good);
+    if (ext_fn || fiemap_fn) {
+        printf("Pre-fetched %u commands from %d extents: %u condition_mets "
+               "(%" PRIu64 " blocks), %u goods\n", count, pfc.ext_num,
+               num_cond_met, pfc.blks_cond_met, num_good);
+        if (num_good)
+            printf("    cache full from LBA 0x%" PRIx64 "%s\n", pfc.full_lba,
+                   pfc.keep_going ? "" : ", stopped");
+    }
     if (first_err) {
         bool printed;
 
@@ -409,6 +892,7 @@ main(int argc, char * argv[])
         }
     }
 fini:
+    free(pfc.ext);
     if (sg_fd >= 0) {
         res = sg_cmds_close_device(sg_fd);
         if (res < 0) {
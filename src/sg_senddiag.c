@@ -18,7 +18,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -27,19 +30,25 @@
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
-#if SG_LIB_WIN32
-#include "sg_pt.h"      /* needed for scsi_pt_win32_direct() */
-#endif
+#include "sg_pt.h"      /* for sg_pt_lat_now_ns(), scsi_pt_win32_direct() */
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "0.63 20180628";
+static const char * version_str = "0.64 20261014";
 
 #define ME "sg_senddiag: "
 
 #define DEF_ALLOC_LEN (1024 * 4)
 
+#define ST_RES_LPAGE 0x10       /* Self-Test Results log page */
+#define ST_RES_PARAM_LEN 20     /* each of its (up to 20) parameters */
+#define ST_RES_LPAGE_LEN (4 + (20 * ST_RES_PARAM_LEN))
+#define ST_RES_IN_PROGRESS 0xf
+#define POLL_MIN_SECS 5         /* shortest, also before the first */
+#define POLL_MAX_SECS 60        /* longest wait between polls */
+#define NS_PER_SEC 1000000000ULL
+
 static struct option long_options[] = {
         {"doff", no_argument, 0, 'd'},
         {"extdur", no_argument, 0, 'e'},
@@ -58,6 +67,7 @@ static struct option long_options[] = {
         {"uoff", no_argument, 0, 'u'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
+        {"wait", no_argument, 0, 'w'},
         {0, 0, 0, 0},
 };
 
@@ -69,20 +79,52 @@ struct opts_t {
     bool do_pf;
     bool do_raw;
     bool do_uoff;
+    bool do_wait;
     bool opt_new;
     bool verbose_given;
     bool version_given;
     int do_help;
     int do_hex;
     int maxlen;
+    int num_devs;               /* DEVICE arguments given */
     int page_code;
     int do_selftest;
     int timeout;
     int verbose;
     const char * device_name;
     const char * raw_arg;
+    char ** dev_names;          /* num_devs of them, from argv */
+};
+
+struct st_dev_t {       /* for each DEVICE with --wait */
+    int sg_fd;
+    int res;            /* of opening and SEND DIAGNOSTIC */
+    int lres;           /* of LOG SENSE for the Self-Test Results page */
+    const char * name;
+    uint8_t lp[ST_RES_PARAM_LEN];       /* most recent result */
 };
 
+struct fleet_ctx {      /* for st_progress_cb() */
+    int num;
+    int active;
+    uint64_t last_ns;           /* when the summary was last output */
+    struct sg_progress_dev * pds;
+    const struct opts_t * op;
+};
+
+static const char * st_result_arr[] = {
+    "completed without error",
+    "aborted by SEND DIAGNOSTIC",
+    "aborted other than by SEND DIAGNOSTIC",
+    "unknown error, unable to complete",
+    "failed in an unknown segment",
+    "failed in first segment",
+    "failed in second segment",
+    "failed in another segment",
+    "reserved [8]", "reserved [9]", "reserved [10]", "reserved [11]",
+    "reserved [12]", "reserved [13]", "reserved [14]",
+    "in progress"};
+
 
 static void
 usage()
@@ -93,7 +135,8 @@ usage()
            "[--raw=H,H...]\n"
            "                   [--selftest=ST] [--test] [--timeout=SECS] "
            "[--uoff]\n"
-           "                   [--verbose] [--version] [DEVICE]\n"
+           "                   [--verbose] [--version] [--wait] "
+           "[DEVICE ...]\n"
            "  where:\n"
            "    --doff|-d       device online (def: 0, only with '--test')\n"
            "    --extdur|-e     duration of an extended self-test (from mode "
@@ -126,7 +169,13 @@ usage()
            "    --uoff|-u       unit offline (def: 0, only with '--test')\n"
            "    --verbose|-v    increase verbosity\n"
            "    --old|-O        use old interface (use as first option)\n"
-           "    --version|-V    output version string then exit\n\n"
+           "    --version|-V    output version string then exit\n"
+           "    --wait|-w       with '-s 1' or '-s 2' poll until the "
+           "self-test is done\n"
+           "                    then output its Self-Test Results log "
+           "entry. Implied\n"
+           "                    by more than one DEVICE: the self-tests "
+           "run together\n\n"
            "Performs a SCSI SEND DIAGNOSTIC (and/or a RECEIVE DIAGNOSTIC "
            "RESULTS) command\n"
         );
@@ -174,7 +223,7 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "dehHlm:NOpP:r:s:tT:uvV", long_options,
+        c = getopt_long(argc, argv, "dehHlm:NOpP:r:s:tT:uvVw", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -256,6 +305,9 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'V':
             op->version_given = true;
             break;
+        case 'w':
+            op->do_wait = true;
+            break;
         default:
             pr2serr("unrecognised option code %c [0x%x]\n", c, c);
             if (op->do_help)
@@ -267,9 +319,9 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     if (optind < argc) {
         if (NULL == op->device_name) {
             op->device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
+            op->dev_names = argv + optind;
+            op->num_devs = argc - optind;
+        } else {
             for (; optind < argc; ++optind)
                 pr2serr("Unexpected extra argument: %s\n", argv[optind]);
             usage();
@@ -435,6 +487,225 @@ do_senddiag(int sg_fd, int sf_code, bool pf_bit, bool sf_bit,
                            outgoing_len, noisy, verbose);
 }
 
+/* Fetches the most recent parameter (parameter code 1) of the Self-Test
+ * Results log page into pp (ST_RES_PARAM_LEN bytes). Returns 0 or a
+ * SG_LIB_CAT_* value. */
+static int
+fetch_st_result(int sg_fd, uint8_t * pp, int verbose)
+{
+    int res, n;
+    int resid = 0;
+    uint8_t b[ST_RES_LPAGE_LEN];
+
+    memset(b, 0, sizeof(b));
+    res = sg_ll_log_sense_v2(sg_fd, false, false, 1 /* cumulative */,
+                             ST_RES_LPAGE, 0, 1 /* paramp */, b, sizeof(b),
+                             0, &resid, false, verbose);
+    if (res)
+        return res;
+    n = (int)sizeof(b) - resid;
+    if ((n < (4 + ST_RES_PARAM_LEN)) || (ST_RES_LPAGE != (b[0] & 0x3f)) ||
+        (sg_get_unaligned_be16(b + 2) < ST_RES_PARAM_LEN) ||
+        (1 != sg_get_unaligned_be16(b + 4))) {
+        if (verbose)
+            pr2serr("%s: bad Self-Test Results log page\n", __func__);
+        return SG_LIB_CAT_MALFORMED;
+    }
+    memcpy(pp, b + 4, ST_RES_PARAM_LEN);
+    return 0;
+}
+
+/* Outputs one line about the self-test on *sdp after secs seconds.
+ * Returns 0 if it completed without error, else a SG_LIB_CAT_* value. */
+static int
+print_st_result(const struct st_dev_t * sdp, const struct sg_progress_dev * dp,
+                uint64_t secs, int verbose)
+{
+    int res, sk;
+    const uint8_t * pp = sdp->lp;
+    char b[80];
+    char c[80];
+
+    if (sdp->lres) {
+        sg_get_category_sense_str(sdp->lres, sizeof(b), b, verbose);
+        printf("  %s: after %" PRIu64 " seconds, %s, unable to fetch "
+               "Self-Test Results: %s\n", sdp->name, secs,
+               (SG_PROGRESS_DONE == dp->state) ? "done" : "poll failed", b);
+        return (SG_PROGRESS_DONE == dp->state) ? sdp->lres :
+               (dp->res ? dp->res : SG_LIB_CAT_OTHER);
+    }
+    res = pp[4] & 0xf;
+    printf("  %s: %s self-test %s after %" PRIu64 " seconds, power-on "
+           "hours: %u\n", sdp->name,
+           (2 == ((pp[4] >> 5) & 0x7)) ? "extended" : "short",
+           st_result_arr[res], secs,
+           (unsigned int)sg_get_unaligned_be16(pp + 6));
+    if (0 == res)
+        return 0;
+    if (pp[5])
+        printf("      segment number: %d\n", pp[5]);
+    if ((res > 3) && (! sg_all_ffs(pp + 8, 8)))
+        printf("      address of first failure: 0x%" PRIx64 "\n",
+               sg_get_unaligned_be64(pp + 8));
+    sk = pp[16] & 0xf;
+    if (sk)
+        printf("      %s, %s\n", sg_get_sense_key_str(sk, sizeof(b), b),
+               sg_get_asc_ascq_str(pp[17], pp[18], sizeof(c), c));
+    return SG_LIB_CAT_OTHER;
+}
+
+/* Called by sg_progress_run() after each poll with --wait. Once the poller
+ * sees no more progress indication the Self-Test Results log page is
+ * fetched: some devices only report a background self-test there, so
+ * when it is still in progress polling resumes, at the longest interval. */
+static bool
+st_progress_cb(struct sg_progress_dev * dp, void * ctx)
+{
+    int k, least;
+    uint64_t now;
+    struct fleet_ctx * fcp = (struct fleet_ctx *)ctx;
+    struct st_dev_t * sdp = (struct st_dev_t *)dp->user;
+
+    now = sg_pt_lat_now_ns();
+    if (SG_PROGRESS_ACTIVE != dp->state) {
+        sdp->lres = fetch_st_result(dp->sg_fd, sdp->lp, fcp->op->verbose);
+        if ((SG_PROGRESS_DONE == dp->state) && (0 == sdp->lres) &&
+            (ST_RES_IN_PROGRESS == (sdp->lp[4] & 0xf))) {
+            dp->state = SG_PROGRESS_ACTIVE;
+            dp->interval_ns = dp->max_ns;
+            dp->next_ns = now + dp->max_ns;
+            return true;
+        }
+        --fcp->active;
+        if (fcp->num > 1)
+            printf("%s: self-test %s after %" PRIu64 " seconds\n",
+                   sdp->name, ((SG_PROGRESS_DONE == dp->state) &&
+                   (0 == sdp->lres) && (0 == (sdp->lp[4] & 0xf))) ?
+                   "passed" : "FAILED",
+                   (uint64_t)((dp->end_ns - dp->start_ns) / NS_PER_SEC));
+        return true;
+    }
+    if (fcp->op->verbose)
+        printf("%s: progress indication: %d%% done\n", sdp->name,
+               (dp->progress < 0) ? 0 : (dp->progress * 100) / 65536);
+    if ((now - fcp->last_ns) < (POLL_MAX_SECS * NS_PER_SEC))
+        return true;
+    fcp->last_ns = now;
+    for (k = 0, least = 65536; k < fcp->num; ++k) {
+        if ((SG_PROGRESS_ACTIVE == fcp->pds[k].state) &&
+            (fcp->pds[k].progress < least))
+            least = fcp->pds[k].progress;
+    }
+    printf("%d of %d self-tests in progress, least done: %d%%\n",
+           fcp->active, fcp->num, (least < 0) ? 0 : (least * 100) / 65536);
+    return true;
+}
+
+/* For --wait, implied by more than one DEVICE: starts a background
+ * self-test (op->do_selftest is 1 or 2) on each DEVICE, polls them all
+ * from this thread with REQUEST SENSE until none are in progress, then
+ * outputs the most recent entry of each Self-Test Results log page.
+ * Returns 0 if all self-tests completed without error, else the error of
+ * the first DEVICE that failed. */
+static int
+fleet_selftest(const struct opts_t * op)
+{
+    int k, n, fd, res;
+    int num_started = 0;
+    int num_failed = 0;
+    int ret = 0;
+    int vb = op->verbose;
+    uint64_t secs;
+    uint64_t longest = 0;
+    struct st_dev_t * sds;
+    struct sg_progress_dev * pds;
+    struct fleet_ctx fc;
+    char b[80];
+
+    n = op->num_devs;
+    sds = (struct st_dev_t *)calloc(n, sizeof(*sds));
+    pds = (struct sg_progress_dev *)calloc(n, sizeof(*pds));
+    if ((NULL == sds) || (NULL == pds)) {
+        pr2serr("unable to allocate memory for %d devices\n", n);
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < n; ++k) {
+        sds[k].name = op->dev_names[k];
+        fd = sg_cmds_open_device(sds[k].name, false /* rw */, vb);
+        if (fd < 0) {
+            pr2serr(ME "error opening file: %s: %s\n", sds[k].name,
+                    safe_strerror(-fd));
+            sds[k].res = sg_convert_errno(-fd);
+            sds[k].sg_fd = -1;
+            continue;
+        }
+        sds[k].sg_fd = fd;
+        sds[k].res = do_senddiag(fd, op->do_selftest, op->do_pf, false,
+                                 false, false, NULL, 0, op->timeout, true,
+                                 vb);
+        if (sds[k].res) {
+            sg_get_category_sense_str(sds[k].res, sizeof(b), b, vb);
+            pr2serr("%s: SEND DIAGNOSTIC failed: %s\n", sds[k].name, b);
+            continue;
+        }
+        sg_progress_init(pds + num_started, fd, true,
+                         POLL_MIN_SECS * NS_PER_SEC,
+                         POLL_MAX_SECS * NS_PER_SEC);
+        pds[num_started].user = sds + k;
+        ++num_started;
+    }
+    printf("Background %s self-test started on %d of %d device%s\n",
+           (2 == op->do_selftest) ? "extended" : "short", num_started, n,
+           (n > 1) ? "s" : "");
+
+    memset(&fc, 0, sizeof(fc));
+    fc.num = num_started;
+    fc.active = num_started;
+    fc.last_ns = sg_pt_lat_now_ns();
+    fc.pds = pds;
+    fc.op = op;
+    sg_progress_run(pds, num_started, st_progress_cb, &fc, vb);
+
+    printf("\nSelf-test results of %d device%s:\n", n, (n > 1) ? "s" : "");
+    for (k = 0, num_started = 0; k < n; ++k) {
+        struct sg_progress_dev * dp;
+
+        if (sds[k].res) {
+            sg_get_category_sense_str(sds[k].res, sizeof(b), b, vb);
+            printf("  %s: not started: %s\n", sds[k].name, b);
+            ++num_failed;
+            if (0 == ret)
+                ret = sds[k].res;
+            continue;
+        }
+        dp = pds + num_started++;
+        secs = (uint64_t)((dp->end_ns - dp->start_ns) / NS_PER_SEC);
+        if (secs > longest)
+            longest = secs;
+        res = print_st_result(sds + k, dp, secs, vb);
+        if (res) {
+            ++num_failed;
+            if (0 == ret)
+                ret = res;
+        }
+    }
+    if (n > 1)
+        printf("%d devices: %d passed, %d failed or not started; longest "
+               "%" PRIu64 " seconds\n", n, n - num_failed, num_failed,
+               longest);
+fini:
+    if (sds) {
+        for (k = 0; k < n; ++k) {
+            if (sds[k].sg_fd >= 0)
+                sg_cmds_close_device(sds[k].sg_fd);
+        }
+        free(sds);
+    }
+    free(pds);
+    return ret;
+}
+
 /* Get expected extended self-test time from mode page 0xa (for '-e') */
 static int
 do_modes_0a(int sg_fd, void * resp, int mx_resp_len, bool mode6, bool noisy,
@@ -779,6 +1050,20 @@ main(int argc, char * argv[])
         ret = SG_LIB_CONTRADICT;
         goto fini;
     }
+    if (op->do_wait || (op->num_devs > 1)) {
+        if (((1 != op->do_selftest) && (2 != op->do_selftest)) ||
+            op->do_raw || op->do_extdur || op->do_list ||
+            (op->page_code >= 0)) {
+            printf("'--wait', and more than one DEVICE, need "
+                   "'--selftest=1' or '--selftest=2'\nand cannot be used "
+                   "with '--raw=', '--page=', '-e' or '-l'\n");
+            usage();
+            ret = SG_LIB_CONTRADICT;
+            goto fini;
+        }
+        ret = fleet_selftest(op);
+        goto fini;
+    }
     if (op->do_raw) {
         if ((op->do_selftest > 0) || op->do_deftest || op->do_extdur ||
             op->do_list) {
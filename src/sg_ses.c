@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2019 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,11 +14,14 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 #include <ctype.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <getopt.h>
+#include <limits.h>
+#include <time.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -32,13 +35,14 @@
 #include "sg_unaligned.h"
 #include "sg_pt.h"
 #include "sg_pr2serr.h"
+#include "sg_json.h"
 
 /*
  * This program issues SCSI SEND DIAGNOSTIC and RECEIVE DIAGNOSTIC RESULTS
  * commands tailored for SES (enclosure) devices.
  */
 
-static const char * version_str = "2.46 20190826";    /* ses4r03 */
+static const char * version_str = "2.47 20261014";    /* ses4r03 */
 
 #define MX_ALLOC_LEN ((64 * 1024) - 4)  /* max allowable for big enclosures */
 #define MX_ELEM_HDR 1024
@@ -47,12 +51,8 @@ static const char * version_str = "2.46 20190826";    /* ses4r03 */
 #define MIN_DATA_IN_SZ 8192     /* use max(MIN_DATA_IN_SZ, op->maxlen) for
                                  * the size of data_arr */
 #define MX_DATA_IN_LINES (16 * 1024)
-#define MX_JOIN_ROWS 520        /* element index fields in dpages are only 8
-                                 * bit, and index 0xff (255) is sometimes used
-                                 * for 'not applicable'. However this limit
-                                 * can bypassed with sub-enclosure numbers.
-                                 * So try higher figure. */
 #define MX_DATA_IN_DESCS 32
+#define VPD_DEVICE_ID 0x83
 #define NUM_ACTIVE_ET_AESP_ARR 32
 
 #define TEMPERAT_OFF 20         /* 8 bits represents -19 C to +235 C */
@@ -136,6 +136,7 @@ struct cgs_cl_t {
 
 struct opts_t {
     bool byte1_given;   /* true if -b B1 or --byte1=B1 given */
+    bool do_cbor;       /* --json output as CBOR */
     bool do_control;    /* want to write to DEVICE */
     bool do_data;       /* flag if --data= option has been used */
     bool do_list;
@@ -161,6 +162,7 @@ struct opts_t {
     int do_join;        /* relational join of Enclosure status, Element
                            descriptor and Additional element status dpages.
                            Use twice to add Threshold in dpage to join. */
+    int do_json;        /* --json, use twice to pretty print */
     int do_raw;
     int enumerate;
     int ind_th;    /* type header index, set by build_type_desc_hdr_arr() */
@@ -171,16 +173,20 @@ struct opts_t {
     int seid;
     int page_code;      /* recognised abbreviations converted to dpage num */
     int verbose;
+    int watch_secs;     /* --watch=SEC, 0 for no watch */
     int num_cgs;        /* number of --clear-, --get= and --set= options */
     int mx_arr_len;     /* allocated size of data_arr */
     int arr_len;        /* valid bytes in data_arr */
     uint8_t * data_arr;
     uint8_t * free_data_arr;
+    const char * batch_fn;      /* --batch=FN */
+    const char * cache_fn;      /* --cache=CFN */
     const char * desc_name;
     const char * dev_name;
     const struct element_type_t * ind_etp;
     const char * index_str;
     const char * nickname_str;
+    struct sgj_state * jsp;     /* non-NULL when --json given */
     struct cgs_cl_t cgs_cl_arr[CGS_CL_ARR_MAX_SZ];
     uint8_t sas_addr[8];  /* Big endian byte sequence */
 };
@@ -212,7 +218,7 @@ struct type_desc_hdr_t {
  * page. Note that the array of these struct instances is built such that
  * the array index is equal to the 'ei_ioe' (element index that includes
  * overall elements). */
-struct join_row_t {  /* this struct is 72 bytes long on Intel "64" bit arch */
+struct join_row_t {  /* this struct is 56 bytes long on Intel "64" bit arch */
     int th_i;           /* type header index (origin 0) */
     int indiv_i;        /* individual (element) index, -1 for overall
                          * instance, otherwise origin 0 */
@@ -233,8 +239,8 @@ struct join_row_t {  /* this struct is 72 bytes long on Intel "64" bit arch */
     uint8_t * enc_statp;  /* NULL indicates past last */
     uint8_t * thresh_inp;
     const uint8_t * ae_statp;
-    int dev_slot_num;           /* if not available, set to -1 */
-    uint8_t sas_addr[8];  /* big endian, if not available, set to 0 */
+    /* the device slot number and SAS address of each row are held apart,
+     * in join_dsn_col[] and join_saddr_col[] */
 };
 
 enum fj_select_t {FJ_IOE, FJ_EOE, FJ_AESS, FJ_SAS_CON};
@@ -337,8 +343,16 @@ struct data_in_desc_t {
  *
  *
  */
-static struct join_row_t join_arr[MX_JOIN_ROWS];
-static struct join_row_t * join_arr_lastp = join_arr + MX_JOIN_ROWS - 1;
+/* The join is sized for the enclosure at hand by join_rows_alloc(): a row
+ * for each overall and individual element then an all zeros row. Passes
+ * over the join only touch join_arr[]; the device slot number and SAS
+ * address of each row, only needed when selecting by or showing them, are
+ * in parallel columns indexed by the same row (i.e. 'jrp - join_arr'). */
+static struct join_row_t * join_arr;
+static int * join_dsn_col;              /* if not available, set to -1 */
+static uint8_t (* join_saddr_col)[8];   /* big endian, if not available 0 */
+static int join_arr_sz;                 /* rows allocated, including last */
+static int join_num_rows;               /* rows in use, excluding last */
 static bool join_done = false;
 
 static struct type_desc_hdr_t type_desc_hdr_arr[MX_ELEM_HDR];
@@ -740,7 +754,10 @@ static bool active_et_aesp_arr[NUM_ACTIVE_ET_AESP_ARR] = {
 
 /* Command line long option names with corresponding short letter. */
 static struct option long_options[] = {
+    {"batch", required_argument, 0, 'B'},
     {"byte1", required_argument, 0, 'b'},
+    {"cache", required_argument, 0, 'k'},
+    {"cbor", no_argument, 0, 'y'},
     {"clear", required_argument, 0, 'C'},
     {"control", no_argument, 0, 'c'},
     {"data", required_argument, 0, 'd'},
@@ -759,6 +776,7 @@ static struct option long_options[] = {
     {"inner-hex", no_argument, 0, 'i'},
     {"inner_hex", no_argument, 0, 'i'},
     {"join", no_argument, 0, 'j'},
+    {"json", no_argument, 0, 'J'},
     {"list", no_argument, 0, 'l'},
     {"nickid", required_argument, 0, 'N'},
     {"nickname", required_argument, 0, 'n'},
@@ -775,6 +793,7 @@ static struct option long_options[] = {
     {"verbose", no_argument, 0, 'v'},
     {"version", no_argument, 0, 'V'},
     {"warn", no_argument, 0, 'w'},
+    {"watch", required_argument, 0, 'W'},
     {0, 0, 0, 0},
 };
 
@@ -826,13 +845,15 @@ usage(int help_num)
         pr2serr(
             "Usage: sg_ses [--descriptor=DES] [--dev-slot-num=SN] "
             "[--eiioe=A_F]\n"
-            "              [--filter] [--get=STR] [--hex] "
-            "[--index=IIA | =TIA,II]\n"
-            "              [--inner-hex] [--join] [--maxlen=LEN] "
-            "[--page=PG] [--quiet]\n"
-            "              [--raw] [--readonly] [--sas-addr=SA] [--status] "
-            "[--verbose]\n"
-            "              [--warn] DEVICE\n\n"
+            "              [--cache=CFN] [--cbor] [--filter] [--get=STR] "
+            "[--hex]\n"
+            "              [--index=IIA | =TIA,II] [--inner-hex] [--join] "
+            "[--json]\n"
+            "              [--maxlen=LEN] [--page=PG] [--quiet] [--raw] "
+            "[--readonly]\n"
+            "              [--sas-addr=SA] [--status] [--verbose] [--warn] "
+            "[--watch=SEC]\n"
+            "              DEVICE\n\n"
             "       sg_ses --control [--byte1=B1] [--clear=STR] "
             "[--data=H,H...]\n"
             "              [--descriptor=DES] [--dev-slot-num=SN] "
@@ -842,6 +863,9 @@ usage(int help_num)
             "              [--nickname=SEN] [--page=PG] [--sas-addr=SA] "
             "[--set=STR]\n"
             "              [--verbose] DEVICE\n\n"
+            "       sg_ses --batch=FN [--byte1=B1] [--mask] [--maxlen=LEN] "
+            "[--quiet]\n"
+            "              [--verbose] DEVICE\n\n"
             "       sg_ses --data=@FN --status [-rr] [<most options from "
             "first form>]\n"
             "       sg_ses --inhex=FN --status [-rr] [<most options from "
@@ -851,15 +875,17 @@ usage(int help_num)
                );
         if ((help_num < 1) || (help_num > 2)) {
             pr2serr("Or the corresponding short option usage: \n"
-                    "  sg_ses [-D DES] [-x SN] [-E A_F] [-f] [-G STR] [-H] "
-                    "[-I IIA|TIA,II] [-i]\n"
-                    "         [-j] [-m LEN] [-p PG] [-q] [-r] [-R] [-A SA] "
-                    "[-s] [-v] [-w] DEVICE\n\n"
+                    "  sg_ses [-D DES] [-x SN] [-E A_F] [-k CFN] [-y] [-f] "
+                    "[-G STR] [-H]\n"
+                    "         [-I IIA|TIA,II] [-i] [-j] [-J] [-m LEN] [-p PG] "
+                    "[-q] [-r] [-R]\n"
+                    "         [-A SA] [-s] [-v] [-w] [-W SEC] DEVICE\n\n"
                     "  sg_ses [-b B1] [-C STR] [-c] [-d H,H...] [-D DES] "
                     "[-x SN] [-I IIA|TIA,II]\n"
                     "         [-M] [-m LEN] [-N SEID] [-n SEN] [-p PG] "
                     "[-A SA] [-S STR]\n"
                     "         [-v] DEVICE\n\n"
+                    "  sg_ses -B FN [-b B1] [-M] [-m LEN] [-q] [-v] DEVICE\n\n"
                     "  sg_ses -d @FN -s [-rr] [<most options from first "
                     "form>]\n"
                     "  sg_ses -X FN -s [-rr] [<most options from first "
@@ -904,6 +930,11 @@ usage(int help_num)
             "                        and Additional Element Status pages. "
             "Use twice\n"
             "                        to add Threshold In page\n"
+            "    --cbor|-y           as --json but output in CBOR (compact "
+            "binary)\n"
+            "    --json|-J           decode status dpages as JSON; use "
+            "twice to\n"
+            "                        pretty print\n"
             "    --page=PG|-p PG     diagnostic page code (abbreviation "
             "or number)\n"
             "                        (def: 'ssp' [0x0] (supported diagnostic "
@@ -921,8 +952,20 @@ usage(int help_num)
     } else {    /* for '-hh' or '--help --help' */
         pr2serr(
             "  where the remaining sg_ses options are:\n"
+            "    --batch=FN|-B FN    each line of FN (or stdin if '-') "
+            "selects elements\n"
+            "                        then does --clear=, --get= or --set= "
+            "on them;\n"
+            "                        all changes sent in one control "
+            "page\n"
             "    --byte1=B1|-b B1    byte 1 (2nd byte) of control page set "
             "to B1\n"
+            "    --cache=CFN|-k CFN    keep Configuration and Element "
+            "Descriptor pages\n"
+            "                          in file CFN between invocations, "
+            "only re-read\n"
+            "                          when generation code changes (used "
+            "by joins)\n"
             "    --data=H,H...|-d H,H...    string of ASCII hex bytes to "
             "send as a\n"
             "                               control page or decode as a "
@@ -964,7 +1007,10 @@ usage(int help_num)
             "read-write)\n"
             "    --verbose|-v        increase verbosity\n"
             "    --version|-V        print version string and exit\n"
-            "    --warn|-w           warn about join (and other) issues\n\n"
+            "    --warn|-w           warn about join (and other) issues\n"
+            "    --watch=SEC|-W SEC    poll every SEC seconds, output "
+            "elements whose\n"
+            "                          status changed (until killed)\n\n"
             "If no options are given then DEVICE's supported diagnostic "
             "pages are\nlisted. STR can be '<start_byte>:<start_bit>"
             "[:<num_bits>][=<val>]'\nor '<acronym>[=val]'. Element type "
@@ -1142,8 +1188,8 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "A:b:cC:d:D:eE:fG:hHiI:jln:N:m:Mp:qrRs"
-                        "S:vVwx:", long_options, &option_index);
+        c = getopt_long(argc, argv, "A:b:B:cC:d:D:eE:fG:hHiI:jJk:ln:N:m:M"
+                        "p:qrRsS:vVwW:x:y", long_options, &option_index);
         if (c == -1)
             break;
 
@@ -1171,6 +1217,9 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
             }
             op->byte1_given = true;
             break;
+        case 'B':
+            op->batch_fn = optarg;
+            break;
         case 'c':
             op->do_control = true;
             break;
@@ -1249,6 +1298,12 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
         case 'j':
             ++op->do_join;
             break;
+        case 'J':
+            ++op->do_json;
+            break;
+        case 'k':
+            op->cache_fn = optarg;
+            break;
         case 'l':
             op->do_list = true;
             break;
@@ -1345,6 +1400,15 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
         case 'w':
             op->warn = true;
             break;
+        case 'W':
+            n = sg_get_num_nomult(optarg);
+            if (n < 1) {
+                pr2serr("bad argument to '--watch=SEC', expect 1 or more "
+                        "seconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->watch_secs = n;
+            break;
         case 'x':
             op->dev_slot_num = sg_get_num_nomult(optarg);
             if ((op->dev_slot_num < 0) || (op->dev_slot_num > 255)) {
@@ -1357,6 +1421,9 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
             inhex_arg = optarg;
             op->do_data = true;
             break;
+        case 'y':
+            op->do_cbor = true;
+            break;
         default:
             pr2serr("unrecognised option code 0x%x ??\n", c);
             goto err_help;
@@ -1453,6 +1520,48 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[])
         pr2serr("cannot have '--join' and '--control'\n");
         goto err_help;
     }
+    if (op->watch_secs > 0) {
+        if (op->do_control || op->num_cgs || op->nickname_str ||
+            data_arg) {
+            pr2serr("--watch= only fetches status so cannot be used with "
+                    "--control,\n--clear=, --get=, --set=, --nickname=, "
+                    "--data= or --inhex=\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (NULL == op->dev_name) {
+            pr2serr("--watch= needs a DEVICE\n");
+            goto err_help;
+        }
+    }
+    if (op->batch_fn) {
+        if (op->do_control || op->num_cgs || op->nickname_str ||
+            data_arg || (op->watch_secs > 0) || op->do_join ||
+            op->index_str || op->desc_name || (op->dev_slot_num >= 0) ||
+            saddr_non_zero(op->sas_addr)) {
+            pr2serr("--batch= takes its selectors and --clear=, --get= and "
+                    "--set= from FN\nso cannot be used with them, nor with "
+                    "--control, --data=, --inhex=,\n--join, --nickname= or "
+                    "--watch=\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (NULL == op->dev_name) {
+            pr2serr("--batch= needs a DEVICE\n");
+            goto err_help;
+        }
+    }
+    if (op->do_cbor && (0 == op->do_json))
+        op->do_json = 1;
+    if (op->do_json) {
+        if (op->do_control || op->num_cgs || op->nickname_str ||
+            op->batch_fn || (op->watch_secs > 0) || op->do_join ||
+            op->do_hex || op->do_raw || op->inner_hex) {
+            pr2serr("--json and --cbor decode status dpages so cannot be "
+                    "used with\n--batch=, --control, --clear=, --get=, "
+                    "--set=, --hex, --inner-hex,\n--join, --nickname=, "
+                    "--raw or --watch=\n");
+            return SG_LIB_CONTRADICT;
+        }
+    }
     if (op->index_str) {
         ret = parse_index(op);
         if (ret) {
@@ -4101,6 +4210,123 @@ err_with_fp:
     return 1;
 }
 
+/* Output for --json: the Enclosure Status dpage is decoded to one object
+ * per element (overall elements have "element_index" -1) with the sensor
+ * readings in integer units; other dpages are given in hex. */
+static int
+ses_json_dpage(struct sg_pt_base * ptvp, int page_code, const uint8_t * resp,
+               int resp_len, struct opts_t * op)
+{
+    int j, k, num_ths;
+    uint32_t ref_gen_code;
+    const uint8_t * bp;
+    const uint8_t * last_bp;
+    const struct type_desc_hdr_t * tdhp;
+    struct sgj_state * jsp = op->jsp;
+    struct enclosure_info primary_info;
+    char b[64];
+
+    sgj_begin_obj(jsp, NULL);
+    sgj_add_str(jsp, "device", op->dev_name);
+    sgj_add_uint(jsp, "page_code", page_code);
+    sgj_add_str(jsp, "name", find_in_diag_page_desc(page_code));
+    if ((SUPPORTED_DPC == page_code) || (SUPPORTED_SES_DPC == page_code)) {
+        sgj_begin_arr(jsp, "supported_pages");
+        for (k = 4, j = 0; k < resp_len; ++k) {
+            if (resp[k] < j)
+                break;      /* assume to be padding at end */
+            j = resp[k];
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_uint(jsp, "page_code", j);
+            sgj_add_str(jsp, "name", find_in_diag_page_desc(j));
+            sgj_end_obj(jsp);
+        }
+        sgj_end_arr(jsp);
+        goto fini;
+    }
+    if ((ENC_STATUS_DPC != page_code) || (resp_len < 8)) {
+        sgj_add_hex(jsp, "hex", resp, resp_len);
+        goto fini;
+    }
+    memset(&primary_info, 0, sizeof(primary_info));
+    num_ths = build_type_desc_hdr_arr(ptvp, type_desc_hdr_arr, MX_ELEM_HDR,
+                                      &ref_gen_code, &primary_info, op);
+    if (num_ths < 0) {
+        sgj_end_obj(jsp);
+        return num_ths;
+    }
+    if ((1 == type_desc_hdr_count) && primary_info.have_info)
+        sgj_add_hex(jsp, "primary_enclosure_logical_identifier",
+                    primary_info.enc_log_id, 8);
+    sgj_add_bool(jsp, "invop", resp[1] & 0x10);
+    sgj_add_bool(jsp, "info", resp[1] & 0x8);
+    sgj_add_bool(jsp, "non_crit", resp[1] & 0x4);
+    sgj_add_bool(jsp, "crit", resp[1] & 0x2);
+    sgj_add_bool(jsp, "unrecov", resp[1] & 0x1);
+    sgj_add_uint(jsp, "generation_code", sg_get_unaligned_be32(resp + 4));
+    if (ref_gen_code != sg_get_unaligned_be32(resp + 4)) {
+        pr2serr("  <<state of enclosure changed, please try again>>\n");
+        goto fini;
+    }
+    sgj_begin_arr(jsp, "elements");
+    last_bp = resp + resp_len - 1;
+    bp = resp + 8;
+    for (k = 0, tdhp = type_desc_hdr_arr; k < num_ths; ++k, ++tdhp) {
+        for (j = -1; j < tdhp->num_elements; ++j, bp += 4) {
+            if ((bp + 3) > last_bp) {
+                pr2serr("    <<<enc: response too short>>>\n");
+                goto elems_fini;
+            }
+            if (op->ind_given && ((k != op->ind_th) ||
+                                  ((-1 == op->ind_indiv) ? (j >= 0) :
+                                   ((j < 0) || (! match_ind_indiv(j, op))))))
+                continue;
+            if ((2 == op->do_filter) && (0x1 != (bp[0] & 0xf)))
+                continue;       /* status=okay entries only */
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_uint(jsp, "type_header_index", k);
+            sgj_add_int(jsp, "element_index", j);
+            sgj_add_uint(jsp, "element_type", tdhp->etype);
+            sgj_add_str(jsp, "element_type_name",
+                        etype_str(tdhp->etype, b, sizeof(b)));
+            sgj_add_uint(jsp, "subenclosure_id", tdhp->se_id);
+            sgj_add_bool(jsp, "prdfail", bp[0] & 0x40);
+            sgj_add_bool(jsp, "disabled", bp[0] & 0x20);
+            sgj_add_bool(jsp, "swap", bp[0] & 0x10);
+            sgj_add_uint(jsp, "status_code", bp[0] & 0xf);
+            sgj_add_str(jsp, "status", elem_status_code_desc[bp[0] & 0xf]);
+            switch (tdhp->etype) {
+            case COOLING_ETC:
+                sgj_add_uint(jsp, "actual_speed_rpm",
+                             (((0x7 & bp[1]) << 8) + bp[2]) * 10);
+                break;
+            case TEMPERATURE_ETC:
+                if (bp[2])
+                    sgj_add_int(jsp, "temperature_c",
+                                (int)bp[2] - TEMPERAT_OFF);
+                break;
+            case VOLT_SENSOR_ETC:   /* in units of 10 millivolts */
+                sgj_add_int(jsp, "voltage_mv",
+                            10 * (int)(short)sg_get_unaligned_be16(bp + 2));
+                break;
+            case CURR_SENSOR_ETC:   /* in units of 10 milliamps */
+                sgj_add_int(jsp, "current_ma",
+                            10 * (int)(short)sg_get_unaligned_be16(bp + 2));
+                break;
+            default:
+                break;
+            }
+            sgj_add_hex(jsp, "status_hex", bp, 4);
+            sgj_end_obj(jsp);
+        }
+    }
+elems_fini:
+    sgj_end_arr(jsp);
+fini:
+    sgj_end_obj(jsp);
+    return sgj_flush(jsp) ? SG_LIB_FILE_ERROR : 0;
+}
+
 static int
 process_status_dpage(struct sg_pt_base * ptvp, int page_code, uint8_t * resp,
                      int resp_len, struct opts_t * op)
@@ -4144,6 +4370,9 @@ process_status_dpage(struct sg_pt_base * ptvp, int page_code, uint8_t * resp,
             hex2stdout(resp, resp_len, (2 == op->do_hex));
         }
         goto fini;
+    } else if (op->jsp) {
+        ret = ses_json_dpage(ptvp, page_code, resp, resp_len, op);
+        goto fini;
     }
 
     memset(&primary_info, 0, sizeof(primary_info));
@@ -4363,30 +4592,65 @@ fini:
     return ret;
 }
 
+/* Sizes the join for the 'num_ths' type headers at 'tdhp' then clears the
+ * rows that will be used and the all zeros row past them. Allocations only
+ * grow so that repeated joins (e.g. --watch=SEC) reuse them. Returns the
+ * number of rows (excluding that last), or -1 if out of memory. */
+static int
+join_rows_alloc(const struct type_desc_hdr_t * tdhp, int num_ths)
+{
+    int k, n;
+    void * vp;
+
+    for (k = 0, n = 0; k < num_ths; ++k, ++tdhp)
+        n += tdhp->num_elements + 1;    /* overall plus individual elements */
+    if (n + 1 > join_arr_sz) {
+        /* each column keeps its old size until all have grown */
+        vp = realloc(join_arr, (n + 1) * sizeof(join_arr[0]));
+        if (NULL == vp)
+            return -1;
+        join_arr = (struct join_row_t *)vp;
+        vp = realloc(join_dsn_col, (n + 1) * sizeof(join_dsn_col[0]));
+        if (NULL == vp)
+            return -1;
+        join_dsn_col = (int *)vp;
+        vp = realloc(join_saddr_col, (n + 1) * sizeof(join_saddr_col[0]));
+        if (NULL == vp)
+            return -1;
+        join_saddr_col = (uint8_t (*)[8])vp;
+        join_arr_sz = n + 1;
+    }
+    memset(join_arr, 0, (n + 1) * sizeof(join_arr[0]));
+    memset(join_saddr_col, 0, (n + 1) * sizeof(join_saddr_col[0]));
+    for (k = 0; k <= n; ++k)
+        join_dsn_col[k] = -1;
+    join_num_rows = 0;
+    return n;
+}
+
 static void
 devslotnum_and_sasaddr(struct join_row_t * jrp, const uint8_t * ae_bp)
 {
-    int m;
+    int row;
 
     if ((NULL == jrp) || (NULL == ae_bp) || (0 == (0x10 & ae_bp[0])))
         return; /* sanity and expect EIP=1 */
+    row = jrp - join_arr;
     switch (0xf & ae_bp[0]) {
     case TPROTO_FCP:
-        jrp->dev_slot_num = ae_bp[7];
+        join_dsn_col[row] = ae_bp[7];
         break;
     case TPROTO_SAS:
         if (0 == (0xc0 & ae_bp[5])) {
             /* only for device slot and array device slot elements */
-            jrp->dev_slot_num = ae_bp[7];
-            if (ae_bp[4] > 0) {        /* number of phys */
+            join_dsn_col[row] = ae_bp[7];
+            if (ae_bp[4] > 0)          /* number of phys */
                 /* Use the first phy's "SAS ADDRESS" field */
-                for (m = 0; m < 8; ++m)
-                    jrp->sas_addr[m] = ae_bp[(4 + 4 + 12) + m];
-            }
+                memcpy(join_saddr_col[row], ae_bp + (4 + 4 + 12), 8);
         }
         break;
     case TPROTO_PCIE:
-        jrp->dev_slot_num = ae_bp[7];
+        join_dsn_col[row] = ae_bp[7];
         break;
     default:
         ;
@@ -4604,8 +4868,8 @@ join_array_display(struct th_es_t * tesp, struct opts_t * op)
     need_aes = (op->page_code_given &&
                 (ADD_ELEM_STATUS_DPC == op->page_code));
     dn_len = op->desc_name ? (int)strlen(op->desc_name) : 0;
-    for (k = 0, jrp = tesp->j_base, got1 = false;
-         ((k < MX_JOIN_ROWS) && jrp->enc_statp); ++k, ++jrp) {
+    for (k = 0, jrp = tesp->j_base, got1 = false; k < tesp->num_j_rows;
+         ++k, ++jrp) {
         if (op->ind_given) {
             if (op->ind_th != jrp->th_i)
                 continue;
@@ -4629,14 +4893,10 @@ join_array_display(struct th_es_t * tesp, struct opts_t * op)
                              desc_len))
                 continue;
         } else if (op->dev_slot_num >= 0) {
-            if (op->dev_slot_num != jrp->dev_slot_num)
+            if (op->dev_slot_num != join_dsn_col[k])
                 continue;
         } else if (saddr_non_zero(op->sas_addr)) {
-            for (j = 0; j < 8; ++j) {
-                if (op->sas_addr[j] != jrp->sas_addr[j])
-                    break;
-            }
-            if (j < 8)
+            if (memcmp(op->sas_addr, join_saddr_col[k], 8))
                 continue;
         }
         got1 = true;
@@ -4708,19 +4968,19 @@ join_array_dump(struct th_es_t * tesp, int broken_ei, struct opts_t * op)
     pr2serr("[<element_type>: <type_hdr_index>,<elem_ind_within>]\n");
     pr2serr("'-1' indicates overall element or not applicable.\n");
     jrp = tesp->j_base;
-    for (k = 0; ((k < MX_JOIN_ROWS) && jrp->enc_statp); ++k, ++jrp) {
+    for (k = 0; k < tesp->num_j_rows; ++k, ++jrp) {
         pr2serr("[0x%x: %d,%d] ", jrp->etype, jrp->th_i, jrp->indiv_i);
         if (jrp->se_id > 0)
             pr2serr("se_id=%d ", jrp->se_id);
         pr2serr("ei_ioe,_eoe,_aess=%s", offset_str(k, hex, b, blen));
         pr2serr(",%s", offset_str(jrp->ei_eoe, hex, b, blen));
         pr2serr(",%s", offset_str(jrp->ei_aess, hex, b, blen));
-        pr2serr(" dsn=%s", offset_str(jrp->dev_slot_num, hex, b, blen));
+        pr2serr(" dsn=%s", offset_str(join_dsn_col[k], hex, b, blen));
         if (op->do_join > 2) {
             pr2serr(" sa=0x");
-            if (saddr_non_zero(jrp->sas_addr)) {
+            if (saddr_non_zero(join_saddr_col[k])) {
                 for (j = 0; j < 8; ++j)
-                    pr2serr("%02x", jrp->sas_addr[j]);
+                    pr2serr("%02x", join_saddr_col[k][j]);
             } else
                 pr2serr("0");
         }
@@ -4782,14 +5042,10 @@ join_juggle_aes(struct th_es_t * tesp, uint8_t * es_bp, const uint8_t * ed_bp,
             ed_bp += sg_get_unaligned_be16(ed_bp + 2) + 4;
         jrp->ae_statp = NULL;
         jrp->thresh_inp = t_bp;
-        jrp->dev_slot_num = -1;
-        /* assume sas_addr[8] zeroed since it's static file scope */
         if (t_bp)
             t_bp += 4;
         ++jrp;
         for (j = 0; j < tdhp->num_elements; ++j, ++jrp) {
-            if (jrp >= join_arr_lastp)
-                break;
             jrp->th_i = k;
             jrp->indiv_i = j;
             jrp->ei_eoe = eoe++;
@@ -4805,21 +5061,365 @@ join_juggle_aes(struct th_es_t * tesp, uint8_t * es_bp, const uint8_t * ed_bp,
             if (ed_bp)
                 ed_bp += sg_get_unaligned_be16(ed_bp + 2) + 4;
             jrp->thresh_inp = t_bp;
-            jrp->dev_slot_num = -1;
-            /* assume sas_addr[8] zeroed since it's static file scope */
             if (t_bp)
                 t_bp += 4;
             jrp->ae_statp = NULL;
             ++tesp->num_j_eoe;
         }
-        if (jrp >= join_arr_lastp) {
-            ++k;
-            break;      /* leave last row all zeros */
-        }
     }
     tesp->num_j_rows = jrp - tesp->j_base;
 }
 
+/* --cache=CFN holds the Configuration and Element Descriptor dpages, which
+ * only change when the generation code does, so that a join (e.g. '--join'
+ * polled by a script) need only fetch the status dpages. The file is
+ * binary: SES_CACHE_MAGIC, then three records (a be32 length then that many
+ * bytes): the first logical unit designator of the Device Identification
+ * VPD page (to tell enclosures apart), the Configuration dpage and the
+ * Element Descriptor dpage (length 0 if not available). */
+#define SES_CACHE_MAGIC "SGSESCF1"
+#define SES_CACHE_MX_ID 256
+
+static uint8_t ses_cache_id[SES_CACHE_MX_ID];
+static int ses_cache_id_len = -1;       /* -1: not yet fetched */
+
+/* Places the first designator with LU association of DEVICE's Device
+ * Identification VPD page in ses_cache_id[]. Returns true if found. */
+static bool
+ses_cache_get_id(struct sg_pt_base * ptvp, struct opts_t * op)
+{
+    int res, len, off;
+    int resid = 0;
+    uint8_t b[SES_CACHE_MX_ID];
+
+    if (ses_cache_id_len >= 0)
+        return (ses_cache_id_len > 0);
+    ses_cache_id_len = 0;
+    res = sg_ll_inquiry_pt(ptvp, true, VPD_DEVICE_ID, b, sizeof(b), 0,
+                           &resid, false, op->verbose);
+    clear_scsi_pt_obj(ptvp);
+    len = (int)sizeof(b) - resid;
+    if (res || (len < 4) || (VPD_DEVICE_ID != b[1])) {
+        if (op->verbose)
+            pr2serr("%s: no Device Identification VPD page, so no "
+                    "cache\n", __func__);
+        return false;
+    }
+    if (len > (sg_get_unaligned_be16(b + 2) + 4))
+        len = sg_get_unaligned_be16(b + 2) + 4;
+    off = -1;
+    if (0 != sg_vpd_dev_id_iter(b + 4, len - 4, &off, 0, -1, -1))
+        return false;
+    if ((4 + off + 4 + b[4 + off + 3]) > len)
+        return false;
+    ses_cache_id_len = 4 + b[4 + off + 3];
+    memcpy(ses_cache_id, b + 4 + off, ses_cache_id_len);
+    return true;
+}
+
+static bool
+ses_cache_read_rec(FILE * fp, uint8_t * bp, int mx_len, int * lenp)
+{
+    int len;
+    uint8_t b[4];
+
+    if (1 != fread(b, sizeof(b), 1, fp))
+        return false;
+    len = (int)sg_get_unaligned_be32(b);
+    if ((len < 0) || (len > mx_len))
+        return false;
+    if ((len > 0) && (1 != fread(bp, len, 1, fp)))
+        return false;
+    *lenp = len;
+    return true;
+}
+
+static bool
+ses_cache_write_rec(FILE * fp, const uint8_t * bp, int len)
+{
+    uint8_t b[4];
+
+    sg_put_unaligned_be32((uint32_t)len, b);
+    if (1 != fwrite(b, sizeof(b), 1, fp))
+        return false;
+    return ((0 == len) || (1 == fwrite(bp, len, 1, fp)));
+}
+
+/* Loads the Configuration dpage from op->cache_fn into config_dp_resp (as
+ * build_type_desc_hdr_arr() would have fetched it) and the Element
+ * Descriptor dpage into elem_desc_rsp. Returns true if the cache is for
+ * DEVICE. Whether it is current is checked later against the generation
+ * code of the Enclosure Status dpage. */
+static bool
+ses_cache_load(struct sg_pt_base * ptvp, struct opts_t * op)
+{
+    bool ok = false;
+    int id_len, c_len, ed_len, mlen;
+    FILE * fp;
+    uint8_t magic[sizeof(SES_CACHE_MAGIC) - 1];
+    uint8_t id[SES_CACHE_MX_ID];
+
+    if (! ses_cache_get_id(ptvp, op))
+        return false;
+    if (NULL == (fp = fopen(op->cache_fn, "rb"))) {
+        if (op->verbose > 1)
+            pr2serr("%s: unable to open %s, will create it\n", __func__,
+                    op->cache_fn);
+        return false;
+    }
+    if ((1 != fread(magic, sizeof(magic), 1, fp)) ||
+        memcmp(magic, SES_CACHE_MAGIC, sizeof(magic)))
+        goto fini;
+    if ((! ses_cache_read_rec(fp, id, sizeof(id), &id_len)) ||
+        (id_len != ses_cache_id_len) || memcmp(id, ses_cache_id, id_len)) {
+        if (op->verbose)
+            pr2serr("%s: %s is for another enclosure\n", __func__,
+                    op->cache_fn);
+        goto fini;
+    }
+    config_dp_resp = sg_memalign(op->maxlen, 0, &free_config_dp_resp,
+                                 false);
+    if (NULL == config_dp_resp)
+        goto fini;
+    mlen = elem_desc_rsp_sz;
+    if (mlen > op->maxlen)
+        mlen = op->maxlen;
+    if ((! ses_cache_read_rec(fp, config_dp_resp, op->maxlen, &c_len)) ||
+        (c_len < 8) ||
+        (! ses_cache_read_rec(fp, elem_desc_rsp, mlen, &ed_len)) ||
+        ((ed_len > 0) && (ed_len < 8))) {
+        if (op->verbose)
+            pr2serr("%s: %s is malformed, ignore\n", __func__, op->cache_fn);
+        free(free_config_dp_resp);
+        free_config_dp_resp = NULL;
+        config_dp_resp = NULL;
+        memset(elem_desc_rsp, 0, elem_desc_rsp_sz);
+        goto fini;
+    }
+    config_dp_resp_len = c_len;
+    elem_desc_rsp_len = ed_len;
+    ok = true;
+    if (op->verbose > 1)
+        pr2serr("%s: using %s, generation code: 0x%" PRIx32 "\n", __func__,
+                op->cache_fn, sg_get_unaligned_be32(config_dp_resp + 4));
+fini:
+    fclose(fp);
+    return ok;
+}
+
+/* Writes config_dp_resp and elem_desc_rsp to op->cache_fn, via a temporary
+ * file so that a concurrent reader never sees it half written. */
+static void
+ses_cache_save(struct sg_pt_base * ptvp, struct opts_t * op)
+{
+    bool ok;
+    FILE * fp;
+    char b[PATH_MAX];
+
+    if ((NULL == config_dp_resp) || (! ses_cache_get_id(ptvp, op)))
+        return;
+    if (snprintf(b, sizeof(b), "%s.%d", op->cache_fn, (int)getpid()) >=
+        (int)sizeof(b))
+        return;
+    if (NULL == (fp = fopen(b, "wb"))) {
+        pr2serr("%s: unable to create %s: %s\n", __func__, b,
+                safe_strerror(errno));
+        return;
+    }
+    ok = (1 == fwrite(SES_CACHE_MAGIC, sizeof(SES_CACHE_MAGIC) - 1, 1,
+                      fp)) &&
+         ses_cache_write_rec(fp, ses_cache_id, ses_cache_id_len) &&
+         ses_cache_write_rec(fp, config_dp_resp, config_dp_resp_len) &&
+         ses_cache_write_rec(fp, elem_desc_rsp, elem_desc_rsp_len);
+    if (fclose(fp))
+        ok = false;
+    if (ok && (0 == rename(b, op->cache_fn))) {
+        if (op->verbose > 1)
+            pr2serr("%s: wrote %s\n", __func__, op->cache_fn);
+        return;
+    }
+    pr2serr("%s: unable to write %s\n", __func__, op->cache_fn);
+    unlink(b);
+}
+
+/* Returns the length the Enclosure Status dpage should have, given the
+ * type descriptor headers from the Configuration dpage. */
+static int
+ses_es_expected_len(const struct type_desc_hdr_t * tdhp, int num_ths)
+{
+    int k;
+    int len = 8;
+
+    for (k = 0; k < num_ths; ++k)
+        len += 4 * (tdhp[k].num_elements + 1);
+    return len;
+}
+
+/* Lookup structures over join_arr[], built by join_lookup_build() at the
+ * end of each join, so that finding the elements selected by --index,
+ * --dev-slot-num and --sas-addr (for each --clear=, --get= and --set=, or
+ * each line of --batch=FN) does not scan the whole join: the row of each
+ * type header's overall element (its individual elements follow it), the
+ * row of each device slot number and the rows sorted by SAS address. */
+struct join_sas_row_t {
+    uint8_t sas_addr[8];
+    int row;
+};
+
+static int join_lk_num_rows;
+static int join_lk_num_ths;
+static int join_th_row[MX_ELEM_HDR];
+static int join_dsn_row[256];           /* -1 if no such device slot */
+static int join_sas_num;
+static int join_sas_sz;                 /* rows allocated */
+static struct join_sas_row_t * join_sas_arr;
+
+static int
+join_sas_cmp(const void * ap, const void * bp)
+{
+    const struct join_sas_row_t * a = (const struct join_sas_row_t *)ap;
+    const struct join_sas_row_t * b = (const struct join_sas_row_t *)bp;
+    int res = memcmp(a->sas_addr, b->sas_addr, 8);
+
+    return res ? res : (a->row - b->row);
+}
+
+static int
+join_sas_key_cmp(const void * keyp, const void * bp)
+{
+    return memcmp(keyp, ((const struct join_sas_row_t *)bp)->sas_addr, 8);
+}
+
+static void
+join_lookup_build(void)
+{
+    int k, dsn;
+    const struct join_row_t * jrp;
+    struct join_sas_row_t * sp;
+
+    for (k = 0; k < MX_ELEM_HDR; ++k)
+        join_th_row[k] = -1;
+    for (k = 0; k < 256; ++k)
+        join_dsn_row[k] = -1;
+    join_lk_num_ths = 0;
+    join_sas_num = 0;
+    join_lk_num_rows = 0;
+    if (join_sas_sz < join_num_rows) {
+        sp = (struct join_sas_row_t *)realloc(join_sas_arr, join_num_rows *
+                                              sizeof(join_sas_arr[0]));
+        if (NULL == sp) {
+            pr2serr("%s: unable to allocate %d rows\n", __func__,
+                    join_num_rows);
+            return;     /* leave lookups empty: nothing will be found */
+        }
+        join_sas_arr = sp;
+        join_sas_sz = join_num_rows;
+    }
+    for (k = 0, jrp = join_arr; k < join_num_rows; ++k, ++jrp) {
+        if ((jrp->indiv_i < 0) && (jrp->th_i >= 0) &&
+            (jrp->th_i < MX_ELEM_HDR)) {
+            join_th_row[jrp->th_i] = k;
+            if (jrp->th_i >= join_lk_num_ths)
+                join_lk_num_ths = jrp->th_i + 1;
+        }
+        dsn = join_dsn_col[k];
+        if ((dsn >= 0) && (dsn < 256) && (join_dsn_row[dsn] < 0))
+            join_dsn_row[dsn] = k;
+        if (saddr_non_zero(join_saddr_col[k])) {
+            memcpy(join_sas_arr[join_sas_num].sas_addr, join_saddr_col[k], 8);
+            join_sas_arr[join_sas_num++].row = k;
+        }
+    }
+    join_lk_num_rows = k;
+    if (join_sas_num > 1)
+        qsort(join_sas_arr, join_sas_num, sizeof(join_sas_arr[0]),
+              join_sas_cmp);
+}
+
+/* Returns the type header index of the instance 'inst' (origin 0) of
+ * element type 'etype' in the join, or -1 if there is no such instance. */
+static int
+join_th_by_etype(int etype, int inst)
+{
+    int k, j;
+
+    for (k = 0; k < join_lk_num_ths; ++k) {
+        j = join_th_row[k];
+        if ((j >= 0) && (etype == join_arr[j].etype)) {
+            if (0 == inst)
+                return k;
+            --inst;
+        }
+    }
+    return -1;
+}
+
+/* Returns the first row of join_arr[], at or after row 'k', of an element
+ * selected by --index, --descriptor, --dev-slot-num or --sas-addr in 'op'
+ * (any row when none of them is given). Returns -1 when there are no
+ * more. Descriptor names are matched by a scan of the join. */
+static int
+join_select(const struct opts_t * op, int k)
+{
+    int j, desc_len, dn_len;
+    const uint8_t * ed_bp;
+    const struct join_sas_row_t * sp;
+    const struct join_sas_row_t * s_endp;
+
+    if (op->ind_given) {
+        if ((op->ind_th < 0) || (op->ind_th >= join_lk_num_ths) ||
+            ((j = join_th_row[op->ind_th]) < 0))
+            return -1;
+        if (j < k)
+            j = k;
+        for ( ; (j < join_lk_num_rows) && (op->ind_th == join_arr[j].th_i);
+             ++j) {
+            if (match_ind_indiv(join_arr[j].indiv_i, op))
+                return j;
+        }
+        return -1;
+    } else if (op->desc_name) {
+        dn_len = (int)strlen(op->desc_name);
+        for (j = k; j < join_lk_num_rows; ++j) {
+            ed_bp = join_arr[j].elem_descp;
+            if (NULL == ed_bp)
+                continue;
+            desc_len = sg_get_unaligned_be16(ed_bp + 2);
+            /* some element descriptor strings have trailing NULLs and
+             * count them; adjust */
+            while (desc_len && ('\0' == ed_bp[4 + desc_len - 1]))
+                --desc_len;
+            if ((desc_len == dn_len) &&
+                (0 == strncmp(op->desc_name, (const char *)(ed_bp + 4),
+                              desc_len)))
+                return j;
+        }
+        return -1;
+    } else if (op->dev_slot_num >= 0) {
+        if (op->dev_slot_num > 255)
+            return -1;
+        j = join_dsn_row[op->dev_slot_num];
+        return (j >= k) ? j : -1;
+    } else if (saddr_non_zero(op->sas_addr)) {
+        sp = (const struct join_sas_row_t *)bsearch(op->sas_addr,
+                        join_sas_arr, join_sas_num, sizeof(join_sas_arr[0]),
+                        join_sas_key_cmp);
+        if (NULL == sp)
+            return -1;
+        while ((sp > join_sas_arr) &&
+               (0 == memcmp((sp - 1)->sas_addr, op->sas_addr, 8)))
+            --sp;       /* to the earliest row with that SAS address */
+        s_endp = join_sas_arr + join_sas_num;
+        for ( ; (sp < s_endp) && (0 == memcmp(sp->sas_addr, op->sas_addr, 8));
+             ++sp) {
+            if (sp->row >= k)
+                return sp->row;
+        }
+        return -1;
+    }
+    return (k < join_lk_num_rows) ? k : -1;
+}
+
 /* Fetch Configuration, Enclosure Status, Element Descriptor, Additional
  * Element Status and optionally Threshold In pages, place in static arrays.
  * Collate (join) overall and individual elements into the static join_arr[].
@@ -4831,6 +5431,7 @@ static int
 join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
 {
     bool broken_ei;
+    bool cached = false;
     int j, res, num_ths, mlen;
     uint32_t ref_gen_code, gen_code;
     const uint8_t * ae_bp;
@@ -4844,6 +5445,9 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
     struct enclosure_info primary_info;
     struct th_es_t tes;
 
+    if (op->cache_fn && ptvp && (NULL == config_dp_resp))
+        cached = ses_cache_load(ptvp, op);
+again:
     memset(&primary_info, 0, sizeof(primary_info));
     num_ths = build_type_desc_hdr_arr(ptvp, type_desc_hdr_arr, MX_ELEM_HDR,
                                       &ref_gen_code, &primary_info, op);
@@ -4871,6 +5475,20 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
         return -1;
     }
     gen_code = sg_get_unaligned_be32(enc_stat_rsp + 4);
+    if (cached && ((ref_gen_code != gen_code) ||
+                   (enc_stat_rsp_len !=
+                    ses_es_expected_len(type_desc_hdr_arr, num_ths)))) {
+        /* configuration changed since cached: fetch it and start again */
+        if (op->verbose)
+            pr2serr("  generation code now 0x%" PRIx32 " (cached: 0x%"
+                    PRIx32 "), refreshing %s\n", gen_code, ref_gen_code,
+                    op->cache_fn);
+        free(free_config_dp_resp);
+        free_config_dp_resp = NULL;
+        config_dp_resp = NULL;
+        cached = false;
+        goto again;
+    }
     if (ref_gen_code != gen_code) {
         pr2serr("%s", enc_state_changed);
         return -1;
@@ -4881,8 +5499,11 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
     mlen = elem_desc_rsp_sz;
     if (mlen > op->maxlen)
         mlen = op->maxlen;
-    res = do_rec_diag(ptvp, ELEM_DESC_DPC, elem_desc_rsp, mlen, op,
-                      &elem_desc_rsp_len);
+    if (cached)         /* Element Descriptor dpage from op->cache_fn */
+        res = elem_desc_rsp_len ? 0 : SG_LIB_CAT_ILLEGAL_REQ;
+    else
+        res = do_rec_diag(ptvp, ELEM_DESC_DPC, elem_desc_rsp, mlen, op,
+                          &elem_desc_rsp_len);
     if (0 == res) {
         if (elem_desc_rsp_len < 8) {
             pr2serr("Element Descriptor response too short\n");
@@ -4902,10 +5523,13 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
         if (op->verbose)
             pr2serr("  Element Descriptor page not available\n");
     }
+    if (op->cache_fn && ptvp && (! cached))
+        ses_cache_save(ptvp, op);
 
     /* check if we want to add the AES page to the join */
     if (display || (ADD_ELEM_STATUS_DPC == op->page_code) ||
-        (op->dev_slot_num >= 0) || saddr_non_zero(op->sas_addr)) {
+        (op->dev_slot_num >= 0) || saddr_non_zero(op->sas_addr) ||
+        (op->watch_secs > 0) || op->batch_fn) {
         mlen = add_elem_rsp_sz;
         if (mlen > op->maxlen)
             mlen = op->maxlen;
@@ -4974,8 +5598,13 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
     }
 
 
+    if (join_rows_alloc(tesp->th_base, tesp->num_ths) < 0) {
+        pr2serr("%s: unable to allocate join\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
     tesp->j_base = join_arr;
     join_juggle_aes(tesp, es_bp, ed_bp, t_bp);
+    join_num_rows = tesp->num_j_rows;
 
     broken_ei = false;
     if (ae_bp)
@@ -4985,6 +5614,7 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
         join_array_dump(tesp, broken_ei, op);
 
     join_done = true;
+    join_lookup_build();
     if (display)      /* probably wanted join_arr[] built only */
         join_array_display(tesp, op);
 
@@ -4992,6 +5622,248 @@ join_work(struct sg_pt_base * ptvp, struct opts_t * op, bool display)
 
 }
 
+/* --watch=SEC copy of each element's status, to find what changed */
+static uint8_t (* watch_prev)[4];
+static int watch_prev_sz;               /* rows allocated */
+
+/* Status bits that --watch=SEC ignores: the measured values of cooling,
+ * temperature, voltage and current elements, which vary between polls.
+ * The parts they are summarized in (e.g. the fan's speed code and the
+ * over temperature warning bit) are not ignored. */
+static void
+watch_ign_mask(int etype, uint8_t * maskp)
+{
+    memset(maskp, 0, 4);
+    maskp[0] = 0x80;            /* SELECT in control, reserved in status */
+    switch (etype) {
+    case COOLING_ETC:
+        maskp[1] = 0x7;         /* actual fan speed */
+        maskp[2] = 0xff;
+        break;
+    case TEMPERATURE_ETC:
+        maskp[2] = 0xff;        /* temperature */
+        break;
+    case VOLT_SENSOR_ETC:
+    case CURR_SENSOR_ETC:
+        maskp[2] = 0xff;        /* voltage or current */
+        maskp[3] = 0xff;
+        break;
+    default:
+        break;
+    }
+}
+
+static int
+watch_num_rows(void)
+{
+    return join_num_rows;
+}
+
+/* Returns 0 if ok, else an errno. */
+static int
+watch_save(void)
+{
+    int k;
+    int n = watch_num_rows();
+
+    if (watch_prev_sz < n) {
+        uint8_t (* pp)[4] = (uint8_t (*)[4])realloc(watch_prev, n * 4);
+
+        if (NULL == pp)
+            return ENOMEM;
+        watch_prev = pp;
+        watch_prev_sz = n;
+    }
+    for (k = 0; k < n; ++k)
+        memcpy(watch_prev[k], join_arr[k].enc_statp, 4);
+    return 0;
+}
+
+static bool
+watch_changed(int row)
+{
+    int j;
+    const uint8_t * sp = join_arr[row].enc_statp;
+    uint8_t mask[4];
+
+    watch_ign_mask(join_arr[row].etype, mask);
+    for (j = 0; j < 4; ++j) {
+        if ((sp[j] & ~mask[j]) != (watch_prev[row][j] & ~mask[j]))
+            return true;
+    }
+    return false;
+}
+
+/* Outputs a line for the element in join_arr[row] that has changed since
+ * watch_prev[row], then an indented line for each field (by the acronyms
+ * of --get=STR) that differs. */
+static void
+watch_show(int row, const char * when)
+{
+    int j, desc_len;
+    uint64_t o_val, n_val;
+    const uint8_t * sp;
+    const uint8_t * op_;
+    const struct join_row_t * jrp = join_arr + row;
+    const struct acronym2tuple * ap;
+    const struct acronym2tuple * a2p;
+    uint8_t mask[4];
+    uint8_t o_st[4];
+    uint8_t n_st[4];
+    char b[64];
+
+    sp = jrp->enc_statp;
+    op_ = watch_prev[row];
+    printf("%s  ", when);
+    if (jrp->elem_descp &&
+        ((desc_len = sg_get_unaligned_be16(jrp->elem_descp + 2)) > 0))
+        printf("%.*s ", desc_len, (const char *)(jrp->elem_descp + 4));
+    printf("[%d,%d]  %s", jrp->th_i, jrp->indiv_i,
+           etype_str(jrp->etype, b, sizeof(b)));
+    if ((op_[0] & 0xf) != (sp[0] & 0xf))
+        printf(": status %s -> %s", elem_status_code_desc[op_[0] & 0xf],
+               elem_status_code_desc[sp[0] & 0xf]);
+    else
+        printf(": status %s", elem_status_code_desc[sp[0] & 0xf]);
+    if (((DEVICE_ETC == jrp->etype) || (ARRAY_DEV_ETC == jrp->etype)) &&
+        saddr_non_zero(join_saddr_col[row])) {
+        printf(", SAS address: 0x");
+        for (j = 0; j < 8; ++j)
+            printf("%02x", join_saddr_col[row][j]);
+    }
+    printf("\n");
+    watch_ign_mask(jrp->etype, mask);
+    for (j = 0; j < 4; ++j) {
+        o_st[j] = op_[j] & ~mask[j];
+        n_st[j] = sp[j] & ~mask[j];
+    }
+    for (ap = ecs_a2t_arr; ap->acron; ++ap) {
+        if ((ap->etype >= 0) && (ap->etype != jrp->etype))
+            continue;
+        if (ap->start_byte > 3)
+            continue;
+        for (a2p = ecs_a2t_arr; a2p < ap; ++a2p) {    /* skip aliases */
+            if (((a2p->etype < 0) || (a2p->etype == jrp->etype)) &&
+                (a2p->start_byte == ap->start_byte) &&
+                (a2p->start_bit == ap->start_bit) &&
+                (a2p->num_bits == ap->num_bits))
+                break;
+        }
+        if (a2p < ap)
+            continue;
+        o_val = sg_get_big_endian(o_st + ap->start_byte, ap->start_bit,
+                                  ap->num_bits);
+        n_val = sg_get_big_endian(n_st + ap->start_byte, ap->start_bit,
+                                  ap->num_bits);
+        if (o_val != n_val)
+            printf("    %s: %" PRIu64 " -> %" PRIu64 "\n", ap->acron, o_val,
+                   n_val);
+    }
+    if (COOLING_ETC == jrp->etype)
+        printf("    actual speed now %d rpm\n",
+               (((0x7 & sp[1]) << 8) + sp[2]) * 10);
+    else if ((TEMPERATURE_ETC == jrp->etype) && sp[2])
+        printf("    temperature now %d C\n", (int)sp[2] - TEMPERAT_OFF);
+}
+
+/* Implements --watch=SEC: builds the join once then, every SEC seconds,
+ * fetches the Enclosure Status dpage into the buffer the join refers to
+ * and outputs the elements whose status changed. Only when the status of
+ * a device slot changes (e.g. a disk is inserted or removed), or the
+ * generation code does, is the join built again (so fetching the
+ * Additional Element Status dpage for the attached device's SAS address).
+ * Runs until killed or a command fails. */
+static int
+watch_work(struct sg_pt_base * ptvp, struct opts_t * op)
+{
+    bool rejoin;
+    int k, n, res, mlen;
+    uint32_t ref_gen_code, gen_code;
+    time_t t;
+    struct tm a_tm;
+    char when[32];
+
+    res = join_work(ptvp, op, false);
+    if (res)
+        return res;
+    res = watch_save();
+    if (res)
+        return sg_convert_errno(res);
+    ref_gen_code = sg_get_unaligned_be32(enc_stat_rsp + 4);
+    n = watch_num_rows();
+    if (! op->quiet)
+        printf("watching %d elements every %d seconds, generation code: "
+               "0x%" PRIx32 "\n", n, op->watch_secs, ref_gen_code);
+    fflush(stdout);
+    mlen = enc_stat_rsp_sz;
+    if (mlen > op->maxlen)
+        mlen = op->maxlen;
+    while (true) {
+        sleep(op->watch_secs);
+        t = time(NULL);
+        if (localtime_r(&t, &a_tm))
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &a_tm);
+        else
+            snprintf(when, sizeof(when), "%" PRId64, (int64_t)t);
+        res = do_rec_diag(ptvp, ENC_STATUS_DPC, enc_stat_rsp, mlen, op,
+                          &enc_stat_rsp_len);
+        if (res)
+            return res;
+        if (enc_stat_rsp_len < 8) {
+            pr2serr("Enclosure Status response too short\n");
+            return -1;
+        }
+        gen_code = sg_get_unaligned_be32(enc_stat_rsp + 4);
+        if (gen_code != ref_gen_code) {
+            printf("%s  configuration changed, generation code: 0x%" PRIx32
+                   " -> 0x%" PRIx32 "\n", when, ref_gen_code, gen_code);
+            if (config_dp_resp) {
+                free(free_config_dp_resp);
+                free_config_dp_resp = NULL;
+                config_dp_resp = NULL;
+            }
+            res = join_work(ptvp, op, false);
+            if (res)
+                return res;
+            res = watch_save();
+            if (res)
+                return sg_convert_errno(res);
+            ref_gen_code = sg_get_unaligned_be32(enc_stat_rsp + 4);
+            n = watch_num_rows();
+            fflush(stdout);
+            continue;
+        }
+        rejoin = false;
+        for (k = 0; k < n; ++k) {
+            if (((DEVICE_ETC == join_arr[k].etype) ||
+                 (ARRAY_DEV_ETC == join_arr[k].etype)) &&
+                ((watch_prev[k][0] & 0xf) !=
+                 (join_arr[k].enc_statp[0] & 0xf))) {
+                rejoin = true;
+                break;
+            }
+        }
+        if (rejoin) {   /* fresh AES dpage for the SAS addresses */
+            res = join_work(ptvp, op, false);
+            if (res < 0)
+                continue;       /* changed again, catch it next time */
+            else if (res)
+                return res;
+            if (watch_num_rows() != n)
+                continue;       /* generation code check will catch it */
+        }
+        for (k = 0; k < n; ++k) {
+            if (watch_changed(k))
+                watch_show(k, when);
+        }
+        res = watch_save();
+        if (res)
+            return sg_convert_errno(res);
+        fflush(stdout);
+    }
+    return 0;
+}
+
 /* Returns 1 if strings equal (same length, characters same or only differ
  * by case), else returns 0. Assumes 7 bit ASCII (English alphabet). */
 static int
@@ -5016,16 +5888,43 @@ strcase_eq(const char * s1p, const char * s2p)
     return 1;
 }
 
-static bool
-is_acronym_in_status_ctl(const struct tuple_acronym_val * tavp)
+/* Returns the first element of ecs_a2t_arr (in table order) with acronym
+ * acron that applies to element type etype (to any when etype is -1), or
+ * NULL. The acronym index is built on first use. If other_etp is given it
+ * is set when acron is only found for other element types. */
+static const struct acronym2tuple *
+find_ecs_acron(const char * acron, int etype, bool * other_etp)
 {
+    int k;
     const struct acronym2tuple * ap;
-
-    for (ap = ecs_a2t_arr; ap->acron; ++ ap) {
-        if (strcase_eq(tavp->acron, ap->acron))
-            break;
+    static struct sg_lib_acron_idx acron_idx;
+    static struct sg_lib_acron_ent acron_ent_arr[SG_ARRAY_SIZE(ecs_a2t_arr)];
+
+    if (NULL == acron_idx.arr)
+        sg_lib_acron_idx_build(&acron_idx, acron_ent_arr, ecs_a2t_arr,
+                               SG_ARRAY_SIZE(ecs_a2t_arr),
+                               sizeof(ecs_a2t_arr[0]),
+                               offsetof(struct acronym2tuple, acron), true);
+    if (other_etp)
+        *other_etp = false;
+    k = sg_lib_acron_idx_find(&acron_idx, acron);
+    if (k < 0)
+        return NULL;
+    for ( ; (k < acron_idx.num) && strcase_eq(acron_idx.arr[k].acron, acron);
+         ++k) {
+        ap = ecs_a2t_arr + acron_idx.arr[k].ind;
+        if ((-1 == etype) || (etype == ap->etype) || (-1 == ap->etype))
+            return ap;
     }
-    return ap->acron;
+    if (other_etp)
+        *other_etp = true;
+    return NULL;
+}
+
+static bool
+is_acronym_in_status_ctl(const struct tuple_acronym_val * tavp)
+{
+    return find_ecs_acron(tavp->acron, -1, NULL);
 }
 
 static bool
@@ -5060,6 +5959,7 @@ cgs_enc_ctl_stat(struct sg_pt_base * ptvp, struct join_row_t * jrp,
                  const struct tuple_acronym_val * tavp,
                  const struct opts_t * op, bool last)
 {
+    bool other_et;
     int ret, len, s_byte, s_bit, n_bits, k;
     uint64_t ui;
     const struct acronym2tuple * ap;
@@ -5070,25 +5970,15 @@ cgs_enc_ctl_stat(struct sg_pt_base * ptvp, struct join_row_t * jrp,
         n_bits = tavp->num_bits;
     }
     if (tavp->acron) {
-        for (ap = ecs_a2t_arr; ap->acron; ++ ap) {
-            if (((jrp->etype == ap->etype) || (-1 == ap->etype)) &&
-                strcase_eq(tavp->acron, ap->acron))
-                break;
-        }
-        if (ap->acron) {
+        ap = find_ecs_acron(tavp->acron, jrp->etype, &other_et);
+        if (ap) {
             s_byte = ap->start_byte;
             s_bit = ap->start_bit;
             n_bits = ap->num_bits;
         } else {
-            if (-1 != ap->etype) {
-                for (ap = ecs_a2t_arr; ap->acron; ++ap) {
-                    if (0 == strcase_eq(tavp->acron, ap->acron)) {
-                        pr2serr(">>> Found %s acronym but not for element "
-                                "type %d\n", tavp->acron, jrp->etype);
-                        break;
-                    }
-                }
-            }
+            if (other_et)
+                pr2serr(">>> Found %s acronym but not for element type "
+                        "%d\n", tavp->acron, jrp->etype);
             return -2;
         }
     }
@@ -5240,10 +6130,9 @@ static int
 ses_cgs(struct sg_pt_base * ptvp, const struct tuple_acronym_val * tavp,
         struct opts_t * op, bool last)
 {
-    int ret, k, j, desc_len, dn_len;
+    int ret, k, next, got;
     bool found;
     struct join_row_t * jrp;
-    const uint8_t * ed_bp;
     char b[64];
 
     if ((NULL == ptvp) && (GET_OPT != tavp->cgs_sel)) {
@@ -5287,43 +6176,17 @@ ses_cgs(struct sg_pt_base * ptvp, const struct tuple_acronym_val * tavp,
         if (ret)
             return ret;
     }
-    dn_len = op->desc_name ? (int)strlen(op->desc_name) : 0;
-    for (k = 0, jrp = join_arr; ((k < MX_JOIN_ROWS) && jrp->enc_statp);
-         ++k, ++jrp) {
-        if (op->ind_given) {
-            if (op->ind_th != jrp->th_i)
-                continue;
-            if (! match_ind_indiv(jrp->indiv_i, op))
-                continue;
-        } else if (op->desc_name) {
-            ed_bp = jrp->elem_descp;
-            if (NULL == ed_bp)
-                continue;
-            desc_len = sg_get_unaligned_be16(ed_bp + 2);
-            /* some element descriptor strings have trailing NULLs and
-             * count them; adjust */
-            while (desc_len && ('\0' == ed_bp[4 + desc_len - 1]))
-                --desc_len;
-            if (desc_len != dn_len)
-                continue;
-            if (0 != strncmp(op->desc_name, (const char *)(ed_bp + 4),
-                             desc_len))
-                continue;
-        } else if (op->dev_slot_num >= 0) {
-            if (op->dev_slot_num != jrp->dev_slot_num)
-                continue;
-        } else if (saddr_non_zero(op->sas_addr)) {
-            for (j = 0; j < 8; ++j) {
-                if (op->sas_addr[j] != jrp->sas_addr[j])
-                    break;
-            }
-            if (j < 8)
-                continue;
-        }
+    /* with a range of individual indexes, only send after the last */
+    for (got = 0, k = join_select(op, 0); k >= 0; k = next, ++got) {
+        jrp = join_arr + k;
+        if (op->ind_indiv_last <= op->ind_indiv)
+            next = -1;
+        else
+            next = join_select(op, k + 1);
         if (ENC_CONTROL_DPC == op->page_code)
-            ret = cgs_enc_ctl_stat(ptvp, jrp, tavp, op, last);
+            ret = cgs_enc_ctl_stat(ptvp, jrp, tavp, op, last && (next < 0));
         else if (THRESHOLD_DPC == op->page_code)
-            ret = cgs_threshold(ptvp, jrp, tavp, op, last);
+            ret = cgs_threshold(ptvp, jrp, tavp, op, last && (next < 0));
         else if (ADD_ELEM_STATUS_DPC == op->page_code)
             ret = cgs_additional_el(jrp, tavp, op);
         else {
@@ -5333,10 +6196,8 @@ ses_cgs(struct sg_pt_base * ptvp, const struct tuple_acronym_val * tavp,
         }
         if (ret)
             return ret;
-        if (op->ind_indiv_last <= op->ind_indiv)
-            break;
-    }   /* end of loop over join array */
-    if ((NULL == jrp->enc_statp) || (k >= MX_JOIN_ROWS)) {
+    }   /* end of loop over selected rows of join array */
+    if (0 == got) {
         if (op->desc_name)
             pr2serr("descriptor name: %s not found (check the 'ed' page "
                     "[0x7])\n", op->desc_name);
@@ -5361,6 +6222,325 @@ inconsistent:
     return -1;
 }
 
+/* Decodes the STR argument of a --clear=, --get= or --set= option into
+ * *tavp. Returns 0 for success else SG_LIB_SYNTAX_ERROR. */
+static int
+cgs_cl_to_tav(struct cgs_cl_t * cgs_clp, struct tuple_acronym_val * tavp)
+{
+    if (parse_cgs_str(cgs_clp->cgs_str, tavp)) {
+        pr2serr("unable to decode STR argument to: %s\n", cgs_clp->cgs_str);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((GET_OPT == cgs_clp->cgs_sel) && tavp->val_str)
+        pr2serr("--get option ignoring =<val> at the end of STR "
+                "argument\n");
+    if (NULL == tavp->val_str) {
+        if (CLEAR_OPT == cgs_clp->cgs_sel)
+            tavp->val = DEF_CLEAR_VAL;
+        if (SET_OPT == cgs_clp->cgs_sel)
+            tavp->val = DEF_SET_VAL;
+    }
+    tavp->cgs_sel = cgs_clp->cgs_sel;
+    return 0;
+}
+
+/* A line of --batch=FN: a copy of the command line options with the
+ * line's selector and its --clear=, --get= and --set= operations */
+struct batch_op_t {
+    int lineno;
+    int etype;          /* element type of --index=ETA..., else -1 */
+    struct opts_t o;
+};
+
+#define BATCH_MX_LINE 512
+
+/* Decodes a line of --batch=FN into *bop, which starts as a copy of the
+ * command line options. The line is tokens separated by whitespace, each
+ * in the long option form '--<name>=<value>' and double quotes may
+ * surround whitespace in a <value> (e.g. --descriptor="Slot 1"). There must
+ * be one selector (--index=, --descriptor=, --dev-slot-num= (or --dsn=) or
+ * --sas-addr=) and at least one --clear=, --get= or --set= . Returns 0 for
+ * success, else an error. */
+static int
+batch_parse_line(const char * lp, int lineno, const struct opts_t * op,
+                 struct batch_op_t * bop)
+{
+    bool in_quote;
+    int n, ret, num_sel;
+    uint64_t saddr;
+    const char * vp;
+    const char * cp;
+    char * tp;
+    struct opts_t * bo = &bop->o;
+    struct cgs_cl_t * cgs_clp;
+    struct tuple_acronym_val tav;
+    struct cgs_cl_t cgs_cl;
+    char tok[BATCH_MX_LINE];
+
+    bop->lineno = lineno;
+    bop->etype = -1;
+    *bo = *op;
+    bo->index_str = NULL;
+    bo->desc_name = NULL;
+    bo->num_cgs = 0;
+    num_sel = 0;
+    for (cp = lp; ; ) {
+        while (isspace((uint8_t)*cp))
+            ++cp;
+        if (('\0' == *cp) || ('#' == *cp))
+            break;
+        for (tp = tok, in_quote = false;
+             *cp && (in_quote || (! isspace((uint8_t)*cp))); ++cp) {
+            if ('"' == *cp)
+                in_quote = ! in_quote;
+            else
+                *tp++ = *cp;
+        }
+        *tp = '\0';
+        if (in_quote) {
+            pr2serr("%s:%d: unbalanced double quote\n", op->batch_fn,
+                    lineno);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ((0 != strncmp(tok, "--", 2)) ||
+            (NULL == (tp = strchr(tok, '=')))) {
+            pr2serr("%s:%d: expected '--<name>=<value>', got: %s\n",
+                    op->batch_fn, lineno, tok);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        *tp = '\0';
+        vp = tp + 1;
+        tp = tok + 2;
+        if ((0 == strcmp(tp, "clear")) || (0 == strcmp(tp, "get")) ||
+            (0 == strcmp(tp, "set"))) {
+            if (strlen(vp) >= CGS_STR_MAX_SZ) {
+                pr2serr("%s:%d: --%s= argument too long (max %d "
+                        "characters)\n", op->batch_fn, lineno, tp,
+                        CGS_STR_MAX_SZ);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (bo->num_cgs >= CGS_CL_ARR_MAX_SZ) {
+                pr2serr("%s:%d: too many --clear=, --get= and --set= "
+                        "(max: %d)\n", op->batch_fn, lineno,
+                        CGS_CL_ARR_MAX_SZ);
+                return SG_LIB_CONTRADICT;
+            }
+            cgs_clp = bo->cgs_cl_arr + bo->num_cgs++;
+            cgs_clp->cgs_sel = ('c' == tp[0]) ? CLEAR_OPT :
+                               (('g' == tp[0]) ? GET_OPT : SET_OPT);
+            cgs_clp->last_cs = false;
+            strcpy(cgs_clp->cgs_str, vp);
+            /* check now, parse_cgs_str() writes into a copy here */
+            cgs_cl = *cgs_clp;
+            if (cgs_cl_to_tav(&cgs_cl, &tav)) {
+                pr2serr("%s:%d: bad --%s=\n", op->batch_fn, lineno, tp);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (tav.acron && (! is_acronym_in_status_ctl(&tav)) &&
+                (! is_acronym_in_threshold(&tav)) &&
+                (! is_acronym_in_additional(&tav))) {
+                pr2serr("%s:%d: acronym %s not found (try '-ee' option)\n",
+                        op->batch_fn, lineno, tav.acron);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            continue;
+        }
+        ++num_sel;
+        if (0 == strcmp(tp, "index")) {
+            n = strlen(vp) + 1;
+            if (NULL == (tp = (char *)malloc(n)))
+                return sg_convert_errno(ENOMEM);
+            memcpy(tp, vp, n);
+            bo->index_str = tp;
+            ret = parse_index(bo);
+            if (ret) {
+                pr2serr("%s:%d: bad --index=%s\n", op->batch_fn, lineno, vp);
+                return ret;
+            }
+            if (bo->ind_etp) {  /* ind_th found after the join */
+                bop->etype = bo->ind_etp->elem_type_code;
+                bo->ind_etp = NULL;
+            }
+        } else if (0 == strcmp(tp, "descriptor")) {
+            n = strlen(vp) + 1;
+            if (NULL == (tp = (char *)malloc(n)))
+                return sg_convert_errno(ENOMEM);
+            memcpy(tp, vp, n);
+            bo->desc_name = tp;
+        } else if ((0 == strcmp(tp, "dev-slot-num")) ||
+                   (0 == strcmp(tp, "dev_slot_num")) ||
+                   (0 == strcmp(tp, "dsn"))) {
+            bo->dev_slot_num = sg_get_num_nomult(vp);
+            if ((bo->dev_slot_num < 0) || (bo->dev_slot_num > 255)) {
+                pr2serr("%s:%d: bad argument to '--%s' (0 to 255 "
+                        "inclusive)\n", op->batch_fn, lineno, tp);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if ((0 == strcmp(tp, "sas-addr")) ||
+                   (0 == strcmp(tp, "sas_addr"))) {
+            if ((strlen(vp) > 2) && ('X' == toupper((uint8_t)vp[1])))
+                vp += 2;
+            if (1 != sscanf(vp, "%" SCNx64 "", &saddr))
+                saddr = 0;
+            sg_put_unaligned_be64(saddr, bo->sas_addr + 0);
+            if ((0 == saddr) || sg_all_ffs(bo->sas_addr, 8)) {
+                pr2serr("%s:%d: bad argument to '--%s=SA'\n", op->batch_fn,
+                        lineno, tp);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else {
+            pr2serr("%s:%d: --%s= not supported in a batch line\n",
+                    op->batch_fn, lineno, tp);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (1 != num_sel) {
+        pr2serr("%s:%d: need one of --index=, --descriptor=, "
+                "--dev-slot-num= or\n--sas-addr=\n", op->batch_fn, lineno);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (0 == bo->num_cgs) {
+        pr2serr("%s:%d: need at least one --clear=, --get= or --set=\n",
+                op->batch_fn, lineno);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    return 0;
+}
+
+/* Called when '--batch=FN' given. Decodes every line of FN (stdin when FN
+ * is '-') before doing anything, then does one join (adding the Threshold
+ * In dpage if any line needs it), then each --get= and, in the join's
+ * copies of the dpages, each --clear= and --set=. Lastly sends the
+ * Enclosure Control dpage and/or the Threshold Out dpage, once each,
+ * holding all the changes. Returns 0 for success, any other return value
+ * is an error. */
+static int
+ses_batch(struct sg_pt_base * ptvp, struct opts_t * op)
+{
+    bool to_stdin = (0 == strcmp("-", op->batch_fn));
+    bool ctl_changed = false;
+    bool th_changed = false;
+    bool need_th = false;
+    int k, j, len, lineno, num, mx_num;
+    int ret = 0;
+    FILE * fp;
+    struct batch_op_t * barr = NULL;
+    struct batch_op_t * bop;
+    struct cgs_cl_t * cgs_clp;
+    void * vp;
+    struct tuple_acronym_val tav;
+    struct cgs_cl_t cgs_cl;
+    char line[BATCH_MX_LINE];
+
+    if (to_stdin)
+        fp = stdin;
+    else if (NULL == (fp = fopen(op->batch_fn, "r"))) {
+        ret = sg_convert_errno(errno);
+        pr2serr("unable to open %s: %s\n", op->batch_fn,
+                safe_strerror(errno));
+        return ret;
+    }
+    for (num = 0, mx_num = 0, lineno = 1; fgets(line, sizeof(line), fp);
+         ++lineno) {
+        len = strlen(line);
+        if ((len > 0) && ('\n' != line[len - 1]) && (! feof(fp))) {
+            pr2serr("%s:%d: line too long (max %d characters)\n",
+                    op->batch_fn, lineno, BATCH_MX_LINE - 2);
+            ret = SG_LIB_SYNTAX_ERROR;
+            goto fini;
+        }
+        for (k = 0; isspace((uint8_t)line[k]); ++k)
+            ;
+        if (('\0' == line[k]) || ('#' == line[k]))
+            continue;
+        if (num >= mx_num) {
+            mx_num = mx_num ? (2 * mx_num) : 16;
+            vp = realloc(barr, mx_num * sizeof(barr[0]));
+            if (NULL == vp) {
+                ret = sg_convert_errno(ENOMEM);
+                goto fini;
+            }
+            barr = (struct batch_op_t *)vp;
+        }
+        bop = barr + num;
+        ret = batch_parse_line(line, lineno, op, bop);
+        ++num;          /* so its strings are freed */
+        if (ret)
+            goto fini;
+        for (j = 0; j < bop->o.num_cgs; ++j) {
+            cgs_cl = bop->o.cgs_cl_arr[j];
+            if ((0 == cgs_cl_to_tav(&cgs_cl, &tav)) && tav.acron &&
+                (! is_acronym_in_status_ctl(&tav)) &&
+                is_acronym_in_threshold(&tav))
+                need_th = true;
+        }
+    }
+    if (0 == num) {
+        pr2serr("no elements selected in %s\n", op->batch_fn);
+        ret = SG_LIB_SYNTAX_ERROR;
+        goto fini;
+    }
+    if (op->verbose)
+        pr2serr("%s: %d lines to do\n", op->batch_fn, num);
+
+    op->do_join = need_th ? 2 : 1;
+    ret = join_work(ptvp, op, false);
+    if (ret)
+        goto fini;
+    for (k = 0, bop = barr; k < num; ++k, ++bop) {
+        if (bop->etype >= 0) {
+            bop->o.ind_th = join_th_by_etype(bop->etype, bop->o.ind_et_inst);
+            if (bop->o.ind_th < 0) {
+                pr2serr("%s:%d: unable to find element type of --index=%s\n",
+                        op->batch_fn, bop->lineno, bop->o.index_str);
+                ret = SG_LIB_SYNTAX_ERROR;
+                goto fini;
+            }
+        }
+        for (j = 0, cgs_clp = bop->o.cgs_cl_arr; j < bop->o.num_cgs;
+             ++j, ++cgs_clp) {
+            if ((ret = cgs_cl_to_tav(cgs_clp, &tav)))
+                goto fini;
+            ret = ses_cgs(ptvp, &tav, &bop->o, false);
+            if (ret) {
+                pr2serr("%s:%d: failed, nothing sent\n", op->batch_fn,
+                        bop->lineno);
+                goto fini;
+            }
+            if (GET_OPT == tav.cgs_sel)
+                continue;
+            if (ENC_CONTROL_DPC == bop->o.page_code)
+                ctl_changed = true;
+            else if (THRESHOLD_DPC == bop->o.page_code)
+                th_changed = true;
+        }
+    }
+    if (ctl_changed) {
+        len = sg_get_unaligned_be16(enc_stat_rsp + 2) + 4;
+        ret = do_senddiag(ptvp, enc_stat_rsp, len, ! op->quiet, op->verbose);
+        if (ret) {
+            pr2serr("couldn't send Enclosure Control page\n");
+            goto fini;
+        }
+    }
+    if (th_changed) {
+        len = sg_get_unaligned_be16(threshold_rsp + 2) + 4;
+        ret = do_senddiag(ptvp, threshold_rsp, len, ! op->quiet,
+                          op->verbose);
+        if (ret)
+            pr2serr("couldn't send Threshold Out page\n");
+    }
+fini:
+    for (k = 0; k < num; ++k) {
+        free((void *)barr[k].o.index_str);
+        free((void *)barr[k].o.desc_name);
+    }
+    free(barr);
+    if (! to_stdin)
+        fclose(fp);
+    return ret;
+}
+
 /* Called when '--nickname=SEN' given. First calls status page to fetch
  * the generation code. Returns 0 for success, any other return value is
  * an error. */
@@ -5524,6 +6704,7 @@ main(int argc, char * argv[])
     uint8_t * free_threshold_rsp = NULL;
     struct sg_pt_base * ptvp = NULL;
     struct tuple_acronym_val tav_arr[CGS_CL_ARR_MAX_SZ];
+    struct sgj_state json_st;
     char buff[128];
     char b[128];
 
@@ -5568,6 +6749,19 @@ main(int argc, char * argv[])
         enumerate_work(op);
         goto early_out;
     }
+    if (op->do_json) {
+        if (op->do_cbor) {
+            if (sg_set_binary_mode(STDOUT_FILENO) < 0)
+                perror("sg_set_binary_mode");
+            ret = sgj_init_cbor(&json_st, STDOUT_FILENO);
+        } else
+            ret = sgj_init(&json_st, STDOUT_FILENO, op->do_json > 1);
+        if (ret) {
+            ret = sg_convert_errno(ret);
+            goto early_out;
+        }
+        op->jsp = &json_st;
+    }
     enc_stat_rsp = sg_memalign(op->maxlen, 0, &free_enc_stat_rsp, false);
     if (NULL == enc_stat_rsp) {
         pr2serr("Unable to get heap for enc_stat_rsp\n");
@@ -5614,22 +6808,8 @@ main(int argc, char * argv[])
         }
         for (k = 0, cgs_clp = op->cgs_cl_arr, tavp = tav_arr; k < op->num_cgs;
              ++k, ++cgs_clp, ++tavp) {
-            if (parse_cgs_str(cgs_clp->cgs_str, tavp)) {
-                pr2serr("unable to decode STR argument to: %s\n",
-                        cgs_clp->cgs_str);
-                ret = SG_LIB_SYNTAX_ERROR;
+            if ((ret = cgs_cl_to_tav(cgs_clp, tavp)))
                 goto err_out;
-            }
-            if ((GET_OPT == cgs_clp->cgs_sel) && tavp->val_str)
-                pr2serr("--get option ignoring =<val> at the end of STR "
-                        "argument\n");
-            if (NULL == tavp->val_str) {
-                if (CLEAR_OPT == cgs_clp->cgs_sel)
-                    tavp->val = DEF_CLEAR_VAL;
-                if (SET_OPT == cgs_clp->cgs_sel)
-                    tavp->val = DEF_SET_VAL;
-            }
-            tavp->cgs_sel = cgs_clp->cgs_sel;
         }
         /* keep this descending for loop directly after ascending for loop */
         for (--k, --cgs_clp; k >= 0; --k, --cgs_clp) {
@@ -5680,7 +6860,7 @@ main(int argc, char * argv[])
             ret = sg_convert_errno(ENOMEM);
             goto err_out;
         }
-        if (! (op->do_raw || have_cgs || (op->do_hex > 2))) {
+        if (! (op->do_raw || have_cgs || (op->do_hex > 2) || op->jsp)) {
             if ((ret = sg_ll_inquiry_pt(ptvp, false, 0, enc_stat_rsp, 36,
                                         0, &resid, ! op->quiet, vb))) {
                 pr2serr("%s doesn't respond to a SCSI INQUIRY\n",
@@ -5785,6 +6965,8 @@ main(int argc, char * argv[])
 
     if (op->nickname_str)
         ret = ses_set_nickname(ptvp, op);
+    else if (op->batch_fn)
+        ret = ses_batch(ptvp, op);
     else if (have_cgs) {
         for (k = 0, tavp = tav_arr, cgs_clp = op->cgs_cl_arr;
              k < op->num_cgs; ++k, ++tavp, ++cgs_clp) {
@@ -5792,7 +6974,9 @@ main(int argc, char * argv[])
             if (ret)
                 break;
         }
-    } else if (op->do_join)
+    } else if (op->watch_secs > 0)
+        ret = watch_work(ptvp, op);
+    else if (op->do_join)
         ret = join_work(ptvp, op, true);
     else if (op->do_status)
         ret = process_status_page_s(ptvp, op);
@@ -5890,6 +7074,11 @@ err_out:
         free(free_add_elem_rsp);
     if (free_threshold_rsp)
         free(free_threshold_rsp);
+    free(join_arr);
+    free(join_dsn_col);
+    free(join_saddr_col);
+    free(join_sas_arr);
+    free(watch_prev);
 
 early_out:
     if (sg_fd >= 0) {
@@ -5902,6 +7091,8 @@ early_out:
     }
     if (ptvp)
         destruct_scsi_pt_obj(ptvp);
+    if (op->jsp && sgj_fini(op->jsp) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
     if ((0 == vb) && (! op->quiet)) {
         if (! sg_if_can2stderr("sg_ses failed: ", ret))
             pr2serr("Some error occurred, try again with '-v' or '-vv' for "
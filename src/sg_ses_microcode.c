@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2019 Douglas Gilbert.
+ * Copyright (c) 2014-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -27,6 +27,18 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <sys/mman.h>
+#include <pthread.h>
+#endif
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+#include <time.h>
+#elif defined(HAVE_GETTIMEOFDAY)
+#include <time.h>
+#include <sys/time.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_cmds_basic.h"
@@ -45,13 +57,15 @@
  * RESULTS commands in order to send microcode to the given SES device.
  */
 
-static const char * version_str = "1.18 20190513";    /* ses4r02 */
+static const char * version_str = "1.19 20261014";    /* ses4r02 */
 
 #define ME "sg_ses_microcode: "
 #define MAX_XFER_LEN (128 * 1024 * 1024)
 #define DEF_XFER_LEN (8 * 1024 * 1024)
 #define DEF_DIN_LEN (8 * 1024)
 #define EBUFF_SZ 256
+#define DEF_JOBS 16             /* DEVICEs downloading at once */
+#define MAX_JOBS 256
 
 #define DPC_DOWNLOAD_MICROCODE 0xe
 
@@ -80,6 +94,7 @@ static struct option long_options[] = {
     {"help", no_argument, 0, 'h'},
     {"id", required_argument, 0, 'i'},
     {"in", required_argument, 0, 'I'},
+    {"jobs", required_argument, 0, 'j'},
     {"length", required_argument, 0, 'l'},
     {"mode", required_argument, 0, 'm'},
     {"non", no_argument, 0, 'N'},
@@ -147,12 +162,14 @@ struct dout_buff_t {
     uint8_t * doutp;
     uint8_t * free_doutp;
     int dout_len;
+    const char * pfx;           /* DEVICE name prefix, may be "" */
+    uint8_t * rd_dummyp;        /* this DEVICE's copy of dummy_rd_resp */
 };
 
 /* This dummy response is used when --dry-run skips the RECEIVE DIAGNOSTICS
  * RESULTS command. Say maximum download MC size is 4 MB. Set generation
- * code to 0 . */
-uint8_t dummy_rd_resp[] = {
+ * code to 0 . Each DEVICE updates its own copy (dout_buff_t::rd_dummyp). */
+static const uint8_t dummy_rd_resp[] = {
     0xe,  3,  0, 68,  0, 0, 0, 0,
     0,  0,  0,  0,  0x0, 0x40, 0x0, 0x0,  0, 0, 0,  0,  0x0, 0x0, 0x0, 0x0,
     0,  1,  0,  0,  0x0, 0x40, 0x0, 0x0,  0, 0, 0,  0,  0x0, 0x0, 0x0, 0x0,
@@ -167,13 +184,13 @@ usage()
     pr2serr("Usage: "
             "sg_ses_microcode [--bpw=CS] [--dry-run] [--ealsd] [--help] "
             "[--id=ID]\n"
-            "                        [--in=FILE] [--length=LEN] [--mode=MO] "
-            "[--non]\n"
-            "                        [--offset=OFF] [--skip=SKIP] "
+            "                        [--in=FILE] [--jobs=JOBS] [--length=LEN] "
+            "[--mode=MO]\n"
+            "                        [--non] [--offset=OFF] [--skip=SKIP] "
             "[--subenc=SEID]\n"
             "                        [--tlength=TLEN] [--verbose] "
             "[--version]\n"
-            "                        DEVICE\n"
+            "                        DEVICE [DEVICE...]\n"
             "  where:\n"
             "    --bpw=CS|-b CS         CS is chunk size: bytes per send "
             "diagnostic\n"
@@ -190,6 +207,9 @@ usage()
             "255)\n"
             "    --in=FILE|-I FILE      read from FILE ('-I -' read "
             "from stdin)\n"
+            "    --jobs=JOBS|-j JOBS    with more than one DEVICE, how many "
+            "download\n"
+            "                           at once (def: %d)\n"
             "    --length=LEN|-l LEN    length in bytes to send (def: "
             "deduced from\n"
             "                           FILE taking SKIP into account)\n"
@@ -216,8 +236,10 @@ usage()
             "Does one or more SCSI SEND DIAGNOSTIC followed by RECEIVE "
             "DIAGNOSTIC\nRESULTS command sequences in order to download "
             "microcode. Use '-m xxx'\nto list available modes. With only "
-            "DEVICE given, the Download Microcode\nStatus dpage is output.\n"
-          );
+            "DEVICE given, the Download Microcode\nStatus dpage is output. "
+            "Each DEVICE given is sent the same microcode;\nwith ',act' "
+            "they are only activated once all downloads have succeeded.\n",
+            DEF_JOBS);
 }
 
 static void
@@ -324,8 +346,8 @@ send_then_receive(int sg_fd, uint32_t gen_code, int off_off,
         return SG_LIB_SYNTAX_ERROR;
     }
     if (do_len > wp->dout_len) {
-        if (wp->doutp)
-            free(wp->doutp);
+        if (wp->free_doutp)
+            free(wp->free_doutp);
         wp->doutp = sg_memalign(do_len, 0, &wp->free_doutp, op->verbose > 3);
         if (! wp->doutp) {
             pr2serr("%s: unable to alloc %d bytes\n", __func__, do_len);
@@ -360,15 +382,15 @@ send_then_receive(int sg_fd, uint32_t gen_code, int off_off,
             int s = op->mc_offset + off_off + dmp_len;
 
             n = 8 + (op->mc_subenc * 16);
-            dummy_rd_resp[n + 11] = op->mc_id;
+            wp->rd_dummyp[n + 11] = op->mc_id;
             sg_put_unaligned_be32(((send_data && (! last)) ? s : 0),
-                                  dummy_rd_resp + n + 12);
+                                  wp->rd_dummyp + n + 12);
             if (MODE_ABORT_MC == op->mc_mode)
-                dummy_rd_resp[n + 2] = 0x80;
+                wp->rd_dummyp[n + 2] = 0x80;
             else if (MODE_ACTIVATE_MC == op->mc_mode)
-                dummy_rd_resp[n + 2] = 0x0;     /* done */
+                wp->rd_dummyp[n + 2] = 0x0;     /* done */
             else
-                dummy_rd_resp[n + 2] = (s >= op->mc_tlen) ? 0x13 : 0x1;
+                wp->rd_dummyp[n + 2] = (s >= op->mc_tlen) ? 0x13 : 0x1;
         }
         res = 0;
     } else
@@ -415,7 +437,7 @@ send_then_receive(int sg_fd, uint32_t gen_code, int off_off,
     if (op->dry_run) {
         n = sizeof(dummy_rd_resp);
         n = (n < din_len) ? n : din_len;
-        memcpy(dip, dummy_rd_resp, n);
+        memcpy(dip, wp->rd_dummyp, n);
         resid = din_len - n;
         res = 0;
     } else
@@ -450,8 +472,9 @@ send_then_receive(int sg_fd, uint32_t gen_code, int off_off,
                 sg_get_unaligned_be32(dip + n + 12));
     }
     if (rec_gen_code != gen_code)
-        pr2serr("gen_code changed from %" PRIu32 " to %" PRIu32
-                ", continuing but may fail\n", gen_code, rec_gen_code);
+        pr2serr("%sgen_code changed from %" PRIu32 " to %" PRIu32
+                ", continuing but may fail\n", wp->pfx, gen_code,
+                rec_gen_code);
     num = (rsp_len - 8) / 16;
     if ((rsp_len - 8) % 16)
         pr2serr("Found %d Download microcode status descriptors, but there "
@@ -462,7 +485,8 @@ send_then_receive(int sg_fd, uint32_t gen_code, int off_off,
             mc_status = bp[2];
             cp = get_mc_status_str(mc_status);
             if ((mc_status >= 0x80) || op->verbose)
-                pr2serr("mc offset=%u: status: %s [0x%x, additional=0x%x]\n",
+                pr2serr("%smc offset=%u: status: %s [0x%x, "
+                        "additional=0x%x]\n", wp->pfx,
                         sg_get_unaligned_be32(bp + 12), cp, mc_status, bp[3]);
             if (op->verbose > 1)
                 pr2serr("  subenc_id=%d, expected_buffer_id=%d, "
@@ -475,41 +499,364 @@ send_then_receive(int sg_fd, uint32_t gen_code, int off_off,
     return ret;
 }
 
+/* Progress of one DEVICE */
+struct mc_dev_t {
+    const char * dev_name;
+    char pfx[64];       /* prefixes messages when more than one DEVICE */
+    int sg_fd;
+    int res;            /* of download, then of activate */
+    int rsp_len;        /* of initial Download microcode status dpage */
+    int num_cmds;       /* SEND DIAGNOSTIC commands in download */
+    uint32_t gen_code;
+    int64_t dl_us;      /* duration of download */
+    int64_t max_us;     /* slowest command sequence of download */
+    uint8_t * dip;
+    uint8_t * free_dip;
+    struct dout_buff_t dout;
+};
+
+/* Shared by the threads downloading to (or activating) many DEVICEs */
+struct mc_multi_t {
+    bool activate;
+    bool want_file;
+    int next_dev;       /* DEVICEs taken from d_arr (atomically) */
+    int num_devs;
+    const uint8_t * dmp;
+    const struct opts_t * op;
+    struct mc_dev_t * d_arr;
+};
+
+static int64_t
+mc_now_us(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return (int64_t)ts.tv_sec * 1000000 + (ts.tv_nsec / 1000);
+    return 0;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+/* Allocates the DEVICE's buffers then fetches its Download microcode
+ * status dpage for the generation code. Returns 0 for success. */
+static int
+mc_prepare(struct mc_dev_t * dp, const struct opts_t * op)
+{
+    int res, resid, act_len, n;
+    int din_len = DEF_DIN_LEN;
+    int verb = (op->verbose > 1) ? op->verbose - 1 : 0;
+    uint8_t * dip;
+
+    dip = sg_memalign(din_len, 0, &dp->free_dip, op->verbose > 3);
+    dp->dout.rd_dummyp = (uint8_t *)malloc(sizeof(dummy_rd_resp));
+    if ((NULL == dip) || (NULL == dp->dout.rd_dummyp)) {
+        pr2serr(ME "out of memory (data-in buffer)\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    dp->dip = dip;
+    dp->dout.pfx = dp->pfx;
+    memcpy(dp->dout.rd_dummyp, dummy_rd_resp, sizeof(dummy_rd_resp));
+    if (op->dry_run) {
+        n = sizeof(dummy_rd_resp);
+        n = (n < din_len) ? n : din_len;
+        memcpy(dip, dp->dout.rd_dummyp, n);
+        resid = din_len - n;
+        res = 0;
+    } else
+        res = sg_ll_receive_diag_v2(dp->sg_fd, true /* pcv */,
+                                    DPC_DOWNLOAD_MICROCODE, dip, din_len,
+                                    0 /*default timeout */, &resid, true,
+                                    verb);
+    if (res)
+        return res;
+    dp->rsp_len = sg_get_unaligned_be16(dip + 2) + 4;
+    act_len = din_len - resid;
+    if (dp->rsp_len > din_len) {
+        pr2serr("<<< warning response buffer too small [%d but need "
+                "%d]>>>\n", din_len, dp->rsp_len);
+        dp->rsp_len = din_len;
+    }
+    if (dp->rsp_len > act_len) {
+        pr2serr("<<< warning response too short [actually got %d but "
+                "need %d]>>>\n", act_len, dp->rsp_len);
+        dp->rsp_len = act_len;
+    }
+    if (dp->rsp_len < 8) {
+        pr2serr("%sDownload microcode status dpage too short\n", dp->pfx);
+        return SG_LIB_CAT_OTHER;
+    }
+    if ((op->verbose > 2) || (op->dry_run && op->verbose))
+        pr2serr("%srec diag(ini): rsp_len=%d, num_sub-enc=%u "
+                "rec_gen_code=%u\n", dp->pfx, dp->rsp_len, dip[1],
+                sg_get_unaligned_be32(dip + 4));
+    dp->gen_code = sg_get_unaligned_be32(dip + 4);
+    return 0;
+}
+
+/* Sends op->mc_len bytes at dmp to the DEVICE, in chunks of op->bpw bytes
+ * when that is > 0. Returns 0 for success else the first error. */
+static int
+mc_download(struct mc_dev_t * dp, const struct opts_t * op,
+            const uint8_t * dmp)
+{
+    bool last;
+    int k, n;
+    int res = 0;
+    int64_t start_us, cmd_us, t_us;
+
+    start_us = mc_now_us();
+    if (op->bpw > 0) {
+        for (k = 0, last = false; k < op->mc_len; k += n) {
+            n = op->mc_len - k;
+            if (n > op->bpw)
+                n = op->bpw;
+            else
+                last = true;
+            if (op->verbose)
+                pr2serr("%sbpw loop: mode=0x%x, id=%d, off_off=%d, len=%d, "
+                        "last=%d\n", dp->pfx, op->mc_mode, op->mc_id, k, n,
+                        last);
+            cmd_us = mc_now_us();
+            res = send_then_receive(dp->sg_fd, dp->gen_code, k, dmp + k, n,
+                                    &dp->dout, dp->dip, DEF_DIN_LEN, last,
+                                    op);
+            ++dp->num_cmds;
+            t_us = mc_now_us() - cmd_us;
+            if (t_us > dp->max_us)
+                dp->max_us = t_us;
+            if (res)
+                break;
+        }
+    } else {
+        if (op->verbose)
+            pr2serr("%ssingle: mode=0x%x, id=%d, offset=%d, len=%d\n",
+                    dp->pfx, op->mc_mode, op->mc_id, op->mc_offset,
+                    op->mc_len);
+        res = send_then_receive(dp->sg_fd, dp->gen_code, 0, dmp, op->mc_len,
+                                &dp->dout, dp->dip, DEF_DIN_LEN, true, op);
+        ++dp->num_cmds;
+        dp->max_us = mc_now_us() - start_us;
+    }
+    dp->dl_us = mc_now_us() - start_us;
+    return res;
+}
+
+/* Activates deferred microcode previously downloaded to the DEVICE.
+ * Returns 0 for success. */
+static int
+mc_activate(struct mc_dev_t * dp, const struct opts_t * op)
+{
+    struct opts_t opts = *op;
+
+    opts.mc_mode = MODE_ACTIVATE_MC;
+    if (op->verbose)
+        pr2serr("%ssending Activate deferred microcode [0xf]\n", dp->pfx);
+    return send_then_receive(dp->sg_fd, dp->gen_code, 0, NULL, 0, &dp->dout,
+                             dp->dip, DEF_DIN_LEN, true, &opts);
+}
+
+static void
+mc_dev_free(struct mc_dev_t * dp)
+{
+    if (dp->dout.free_doutp)
+        free(dp->dout.free_doutp);
+    if (dp->dout.rd_dummyp)
+        free(dp->dout.rd_dummyp);
+    if (dp->free_dip)
+        free(dp->free_dip);
+}
+
+static void *
+mc_worker(void * v_mp)
+{
+    int k;
+    struct mc_multi_t * mp = (struct mc_multi_t *)v_mp;
+    const struct opts_t * op = mp->op;
+    struct mc_dev_t * dp;
+
+    while ((k = __atomic_fetch_add(&mp->next_dev, 1, __ATOMIC_RELAXED)) <
+           mp->num_devs) {
+        dp = mp->d_arr + k;
+        if (mp->activate) {
+            dp->res = mc_activate(dp, op);
+            continue;
+        }
+        dp->sg_fd = sg_cmds_open_device(dp->dev_name, false /* rw */,
+                                        op->verbose);
+        if (dp->sg_fd < 0) {
+            pr2serr("%sopen error: %s\n", dp->pfx,
+                    safe_strerror(-dp->sg_fd));
+            dp->res = sg_convert_errno(-dp->sg_fd);
+            continue;
+        }
+        if ((dp->res = mc_prepare(dp, op)))
+            continue;
+        if (MODE_DNLD_STATUS == op->mc_mode) {
+            printf("%s:\n", dp->dev_name);      /* only one thread */
+            show_download_mc_sdg(dp->dip, dp->rsp_len, dp->gen_code);
+        } else if (! mp->want_file) {   /* ACTIVATE and ABORT */
+            dp->res = send_then_receive(dp->sg_fd, dp->gen_code, 0, NULL, 0,
+                                        &dp->dout, dp->dip, DEF_DIN_LEN,
+                                        true, op);
+            ++dp->num_cmds;
+        } else
+            dp->res = mc_download(dp, op, mp->dmp);
+    }
+    return NULL;
+}
+
+/* Has up to num_thr threads (this one included) doing mc_worker() */
+static void
+mc_run_workers(struct mc_multi_t * mp, int num_thr)
+{
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+
+    mp->next_dev = 0;
+    if (num_thr > mp->num_devs)
+        num_thr = mp->num_devs;
+    for (k = 1; k < num_thr; ++k) {
+        if ((err = pthread_create(tids + k, NULL, mc_worker, mp))) {
+            if (mp->op->verbose)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_thr = k;
+    mc_worker(mp);
+    for (k = 1; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+#else
+    if (num_thr) { }    /* suppress warning */
+    mp->next_dev = 0;
+    mc_worker(mp);
+#endif
+}
+
+/* Sends the same microcode to many DEVICEs, up to num_jobs at a time, each
+ * DEVICE's chunks following one another as fast as that DEVICE takes them.
+ * With '--bpw=CS,act' activation is held back until every download has
+ * succeeded, then all DEVICEs are activated together; if any download
+ * failed, none is activated. Outputs a line per DEVICE. Returns 0, else
+ * the error of the first DEVICE that failed. */
+static int
+mc_multi(const char ** dev_names, int num_devs, int num_jobs,
+         bool want_file, const uint8_t * dmp, const struct opts_t * op)
+{
+    int k, res, num_bad;
+    int ret = 0;
+    struct mc_dev_t * dp;
+    struct mc_multi_t m;
+    char b[80];
+
+    memset(&m, 0, sizeof(m));
+    m.want_file = want_file;
+    m.num_devs = num_devs;
+    m.dmp = dmp;
+    m.op = op;
+    m.d_arr = (struct mc_dev_t *)calloc(num_devs, sizeof(*dp));
+    if (NULL == m.d_arr) {
+        pr2serr(ME "out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        dp->dev_name = dev_names[k];
+        dp->sg_fd = -1;
+        snprintf(dp->pfx, sizeof(dp->pfx), "%s: ", dp->dev_name);
+    }
+    /* status dpages are output by the worker, so one at a time */
+    mc_run_workers(&m, (MODE_DNLD_STATUS == op->mc_mode) ? 1 : num_jobs);
+    for (k = 0, num_bad = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        if (dp->res) {
+            ++num_bad;
+            if (0 == ret)
+                ret = dp->res;
+            sg_get_category_sense_str(dp->res, sizeof(b), b, op->verbose);
+            printf("%s: failed: %s\n", dp->dev_name, b);
+        } else if (MODE_DNLD_STATUS != op->mc_mode)
+            printf("%s: %d SEND DIAGNOSTIC command%s, %.3f seconds (slowest "
+                   "command %.3f)\n", dp->dev_name, dp->num_cmds,
+                   (1 == dp->num_cmds) ? "" : "s",
+                   (double)dp->dl_us / 1000000.0,
+                   (double)dp->max_us / 1000000.0);
+    }
+    if (want_file && (op->bpw > 0) && op->bpw_then_activate) {
+        if (num_bad)
+            printf("%d of %d DEVICEs failed, so none activated\n", num_bad,
+                   num_devs);
+        else {
+            m.activate = true;
+            mc_run_workers(&m, num_jobs);
+            for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+                if (dp->res) {
+                    if (0 == ret)
+                        ret = dp->res;
+                    sg_get_category_sense_str(dp->res, sizeof(b), b,
+                                              op->verbose);
+                    printf("%s: activate failed: %s\n", dp->dev_name, b);
+                } else
+                    printf("%s: activated\n", dp->dev_name);
+            }
+        }
+    }
+    for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        mc_dev_free(dp);
+        if (dp->sg_fd >= 0) {
+            res = sg_cmds_close_device(dp->sg_fd);
+            if ((res < 0) && (0 == ret))
+                ret = sg_convert_errno(-res);
+        }
+    }
+    free(m.d_arr);
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
 {
-    bool last, got_stdin, is_reg;
+    bool got_stdin = false;
+    bool is_reg = false;
     bool want_file = false;
     bool verbose_given = false;
     bool version_given = false;
-    int res, c, len, k, n, rsp_len, resid, act_len, din_len, verb;
-    int sg_fd = -1;
+    int res, c, len;
     int infd = -1;
     int do_help = 0;
+    int num_devs = 0;
+    int num_jobs = DEF_JOBS;
     int ret = 0;
-    uint32_t gen_code = 0;
-    const char * device_name = NULL;
+    size_t mmap_len = 0;
+    const char ** dev_names = NULL;
     const char * file_name = NULL;
-    uint8_t * dmp = NULL;
-    uint8_t * dip = NULL;
-    uint8_t * free_dip = NULL;
+    const uint8_t * dmp = NULL;
+    uint8_t * free_dmp = NULL;
+    uint8_t * mmap_p = NULL;
     char * cp;
     char ebuff[EBUFF_SZ];
     struct stat a_stat;
-    struct dout_buff_t dout;
+    struct mc_dev_t dev;
     struct opts_t opts;
     struct opts_t * op;
     const struct mode_s * mp;
 
     op = &opts;
     memset(op, 0, sizeof(opts));
-    memset(&dout, 0, sizeof(dout));
-    din_len = DEF_DIN_LEN;
+    memset(&dev, 0, sizeof(dev));
+    dev.sg_fd = -1;
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:dehi:I:l:m:No:s:S:t:vV", long_options,
+        c = getopt_long(argc, argv, "b:dehi:I:j:l:m:No:s:S:t:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -548,6 +895,14 @@ main(int argc, char * argv[])
         case 'I':
             file_name = optarg;
             break;
+        case 'j':
+            num_jobs = sg_get_num_nomult(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs' should be in the range 1 to "
+                        "%d\n", MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             op->mc_len = sg_get_num(optarg);
             if (op->mc_len < 0) {
@@ -636,16 +991,8 @@ main(int argc, char * argv[])
         return 0;
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        dev_names = (const char **)(argv + optind);
+        num_devs = argc - optind;
     }
 
 #ifdef DEBUG
@@ -669,7 +1016,7 @@ main(int argc, char * argv[])
         return 0;
     }
 
-    if (NULL == device_name) {
+    if (0 == num_devs) {
         pr2serr("missing device name!\n\n");
         usage();
         return SG_LIB_SYNTAX_ERROR;
@@ -710,15 +1057,7 @@ main(int argc, char * argv[])
 #endif
 #endif
 
-    sg_fd = sg_cmds_open_device(device_name, false /* rw */, op->verbose);
-    if (sg_fd < 0) {
-        if (op->verbose)
-            pr2serr(ME "open error: %s: %s\n", device_name,
-                    safe_strerror(-sg_fd));
-        ret = sg_convert_errno(-sg_fd);
-        goto fini;
-    }
-
+    /* the microcode is loaded once, before any DEVICE is opened */
     if (file_name && (! want_file))
         pr2serr("ignoring --in=FILE option\n");
     else if (file_name) {
@@ -758,56 +1097,81 @@ main(int argc, char * argv[])
             ret = SG_LIB_FILE_ERROR;
             goto fini;
         }
-        if (NULL == (dmp = (uint8_t *)malloc(op->mc_len))) {
-            pr2serr(ME "out of memory to hold microcode read from FILE\n");
-            ret = SG_LIB_CAT_OTHER;
-            goto fini;
+#ifndef SG_LIB_WIN32
+        /* map a regular FILE that holds all of LEN, rather than copy it */
+        if (is_reg && ((int64_t)op->mc_skip + op->mc_len <=
+                       (int64_t)a_stat.st_size)) {
+            mmap_len = op->mc_skip + op->mc_len;
+            mmap_p = (uint8_t *)mmap(NULL, mmap_len, PROT_READ, MAP_PRIVATE,
+                                     infd, 0);
+            if (MAP_FAILED == mmap_p) {
+                mmap_p = NULL;
+                if (op->verbose)
+                    perror(ME "mmap() failed, will read()");
+            } else {
+                dmp = mmap_p + op->mc_skip;
+                if (op->verbose > 1)
+                    pr2serr("mapped %d bytes of %s at offset %d\n",
+                            op->mc_len, file_name, op->mc_skip);
+            }
         }
-        /* Don't remember why this is preset to 0xff, from write_buffer */
-        memset(dmp, 0xff, op->mc_len);
-        if (op->mc_skip > 0) {
-            if (! is_reg) {
-                if (got_stdin)
-                    pr2serr("Can't skip on stdin\n");
-                else
-                    pr2serr(ME "not a 'regular' file so can't apply skip\n");
-                ret = SG_LIB_FILE_ERROR;
+#endif
+        if (NULL == dmp) {
+            if (NULL == (free_dmp = (uint8_t *)malloc(op->mc_len))) {
+                pr2serr(ME "out of memory to hold microcode read from "
+                        "FILE\n");
+                ret = SG_LIB_CAT_OTHER;
                 goto fini;
             }
-            if (lseek(infd, op->mc_skip, SEEK_SET) < 0) {
+            /* Don't remember why this is preset to 0xff, from
+             * write_buffer */
+            memset(free_dmp, 0xff, op->mc_len);
+            if (op->mc_skip > 0) {
+                if (! is_reg) {
+                    if (got_stdin)
+                        pr2serr("Can't skip on stdin\n");
+                    else
+                        pr2serr(ME "not a 'regular' file so can't apply "
+                                "skip\n");
+                    ret = SG_LIB_FILE_ERROR;
+                    goto fini;
+                }
+                if (lseek(infd, op->mc_skip, SEEK_SET) < 0) {
+                    ret = sg_convert_errno(errno);
+                    snprintf(ebuff,  EBUFF_SZ, ME "couldn't skip to "
+                             "required position on %s", file_name);
+                    perror(ebuff);
+                    goto fini;
+                }
+            }
+            res = read(infd, free_dmp, op->mc_len);
+            if (res < 0) {
                 ret = sg_convert_errno(errno);
-                snprintf(ebuff,  EBUFF_SZ, ME "couldn't skip to "
-                         "required position on %s", file_name);
+                snprintf(ebuff, EBUFF_SZ, ME "couldn't read from %s",
+                         file_name);
                 perror(ebuff);
                 goto fini;
             }
-        }
-        res = read(infd, dmp, op->mc_len);
-        if (res < 0) {
-            ret = sg_convert_errno(errno);
-            snprintf(ebuff, EBUFF_SZ, ME "couldn't read from %s",
-                     file_name);
-            perror(ebuff);
-            goto fini;
-        }
-        if (res < op->mc_len) {
-            if (op->mc_len_given) {
-                pr2serr("tried to read %d bytes from %s, got %d bytes\n",
-                        op->mc_len, file_name, res);
-                pr2serr("pad with 0xff bytes and continue\n");
-            } else {
-                if (op->verbose) {
-                    pr2serr("tried to read %d bytes from %s, got %d "
-                            "bytes\n", op->mc_len, file_name, res);
-                    pr2serr("will send %d bytes", res);
-                    if ((op->bpw > 0) && (op->bpw < op->mc_len))
-                        pr2serr(", %d bytes per WRITE BUFFER command\n",
-                                op->bpw);
-                    else
-                        pr2serr("\n");
+            if (res < op->mc_len) {
+                if (op->mc_len_given) {
+                    pr2serr("tried to read %d bytes from %s, got %d bytes\n",
+                            op->mc_len, file_name, res);
+                    pr2serr("pad with 0xff bytes and continue\n");
+                } else {
+                    if (op->verbose) {
+                        pr2serr("tried to read %d bytes from %s, got %d "
+                                "bytes\n", op->mc_len, file_name, res);
+                        pr2serr("will send %d bytes", res);
+                        if ((op->bpw > 0) && (op->bpw < op->mc_len))
+                            pr2serr(", %d bytes per WRITE BUFFER command\n",
+                                    op->bpw);
+                        else
+                            pr2serr("\n");
+                    }
+                    op->mc_len = res;
                 }
-                op->mc_len = res;
             }
+            dmp = free_dmp;
         }
         if (! got_stdin)
             close(infd);
@@ -824,108 +1188,51 @@ main(int argc, char * argv[])
                 "microcode status\ndpage might be dangerous\n");
         goto fini;
     }
+    if (num_devs > 1) {
+        ret = mc_multi(dev_names, num_devs, num_jobs, want_file, dmp, op);
+        goto fini;
+    }
 
-    dip = sg_memalign(din_len, 0, &free_dip, op->verbose > 3);
-    if (NULL == dip) {
-        pr2serr(ME "out of memory (data-in buffer)\n");
-        ret = SG_LIB_CAT_OTHER;
+    dev.dev_name = dev_names[0];
+    dev.sg_fd = sg_cmds_open_device(dev.dev_name, false /* rw */,
+                                    op->verbose);
+    if (dev.sg_fd < 0) {
+        if (op->verbose)
+            pr2serr(ME "open error: %s: %s\n", dev.dev_name,
+                    safe_strerror(-dev.sg_fd));
+        ret = sg_convert_errno(-dev.sg_fd);
         goto fini;
     }
-    verb = (op->verbose > 1) ? op->verbose - 1 : 0;
     /* Fetch Download microcode status dpage for generation code ++ */
-    if (op->dry_run) {
-        n = sizeof(dummy_rd_resp);
-        n = (n < din_len) ? n : din_len;
-        memcpy(dip, dummy_rd_resp, n);
-        resid = din_len - n;
-        res = 0;
-    } else
-        res = sg_ll_receive_diag_v2(sg_fd, true /* pcv */,
-                                    DPC_DOWNLOAD_MICROCODE, dip, din_len,
-                                    0 /*default timeout */, &resid, true,
-                                    verb);
-    if (0 == res) {
-        rsp_len = sg_get_unaligned_be16(dip + 2) + 4;
-        act_len = din_len - resid;
-        if (rsp_len > din_len) {
-            pr2serr("<<< warning response buffer too small [%d but need "
-                    "%d]>>>\n", din_len, rsp_len);
-            rsp_len = din_len;
-        }
-        if (rsp_len > act_len) {
-            pr2serr("<<< warning response too short [actually got %d but "
-                    "need %d]>>>\n", act_len, rsp_len);
-            rsp_len = act_len;
-        }
-        if (rsp_len < 8) {
-            pr2serr("Download microcode status dpage too short\n");
-            ret = SG_LIB_CAT_OTHER;
-            goto fini;
-        }
-        if ((op->verbose > 2) || (op->dry_run && op->verbose))
-            pr2serr("rec diag(ini): rsp_len=%d, num_sub-enc=%u "
-                    "rec_gen_code=%u\n", rsp_len, dip[1],
-                    sg_get_unaligned_be32(dip + 4));
-    } else {
-        ret = res;
+    if ((ret = mc_prepare(&dev, op)))
         goto fini;
-    }
-    gen_code = sg_get_unaligned_be32(dip + 4);
 
     if (MODE_DNLD_STATUS == op->mc_mode) {
-        show_download_mc_sdg(dip, rsp_len, gen_code);
+        show_download_mc_sdg(dev.dip, dev.rsp_len, dev.gen_code);
         goto fini;
     } else if (! want_file) {   /* ACTIVATE and ABORT */
-        res = send_then_receive(sg_fd, gen_code, 0, NULL, 0, &dout, dip,
-                                din_len, true, op);
-        ret = res;
+        ret = send_then_receive(dev.sg_fd, dev.gen_code, 0, NULL, 0,
+                                &dev.dout, dev.dip, DEF_DIN_LEN, true, op);
         goto fini;
     }
-
-    res = 0;
-    if (op->bpw > 0) {
-        for (k = 0, last = false; k < op->mc_len; k += n) {
-            n = op->mc_len - k;
-            if (n > op->bpw)
-                n = op->bpw;
-            else
-                last = true;
-            if (op->verbose)
-                pr2serr("bpw loop: mode=0x%x, id=%d, off_off=%d, len=%d, "
-                        "last=%d\n", op->mc_mode, op->mc_id, k, n, last);
-            res = send_then_receive(sg_fd, gen_code, k, dmp + k, n, &dout,
-                                    dip, din_len, last, op);
-            if (res)
-                break;
-        }
-        if (op->bpw_then_activate && (0 == res)) {
-            op->mc_mode = MODE_ACTIVATE_MC;
-            if (op->verbose)
-                pr2serr("sending Activate deferred microcode [0xf]\n");
-            res = send_then_receive(sg_fd, gen_code, 0, NULL, 0, &dout,
-                                    dip, din_len, true, op);
-        }
-    } else {
-        if (op->verbose)
-            pr2serr("single: mode=0x%x, id=%d, offset=%d, len=%d\n",
-                    op->mc_mode, op->mc_id, op->mc_offset, op->mc_len);
-        res = send_then_receive(sg_fd, gen_code, 0, dmp, op->mc_len, &dout,
-                                dip, din_len, true, op);
-    }
+    res = mc_download(&dev, op, dmp);
+    if ((op->bpw > 0) && op->bpw_then_activate && (0 == res))
+        res = mc_activate(&dev, op);
     if (res)
         ret = res;
 
 fini:
     if ((infd >= 0) && (! got_stdin))
         close(infd);
-    if (dmp)
-        free(dmp);
-    if (dout.free_doutp)
-        free(dout.free_doutp);
-    if (free_dip)
-        free(free_dip);
-    if (sg_fd >= 0) {
-        res = sg_cmds_close_device(sg_fd);
+    if (free_dmp)
+        free(free_dmp);
+#ifndef SG_LIB_WIN32
+    if (mmap_p)
+        munmap(mmap_p, mmap_len);
+#endif
+    mc_dev_free(&dev);
+    if (dev.sg_fd >= 0) {
+        res = sg_cmds_close_device(dev.sg_fd);
         if (res < 0) {
             pr2serr("close error: %s\n", safe_strerror(-res));
             if (0 == ret)
@@ -0,0 +1,691 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * This daemon keeps SCSI (and NVMe) devices open on behalf of short lived
+ * clients and executes their commands. A client (any utility in this
+ * package run with the SG3_UTILS_BROKER environment variable set to the
+ * name of this daemon's socket) then avoids opening and probing the device
+ * on each invocation. Linux only.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1           /* for struct ucred */
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_pt.h"
+#include "sg_pt_linux.h"
+#include "sg_pr2serr.h"
+
+static const char * version_str = "1.01 20261014";
+
+#define DEF_SOCKET_NAME "/run/sg_srvd.sock"
+#define MAX_CLIENTS 256
+#define MAX_DEVICES 256
+#define DEF_PT_TIMEOUT 60       /* 60 seconds */
+#define DEF_REQ_TIMEOUT 30      /* for a client to send a request, or to
+                                 * take its response, in seconds */
+
+
+/* An open file descriptor of a device. Each command holds a reference
+ * while it runs, so when one client finds the device gone its fd stays
+ * open until the commands of other clients on it have finished. */
+struct srvd_fd {
+    int fd;
+    int refs;                   /* one for the device, one per command */
+    uint64_t id;                /* unique, for re-binding pt objects */
+};
+
+struct srvd_dev {
+    char * name;
+    int oflags;
+    struct srvd_fd * hp;        /* NULL when device needs re-opening */
+    uint64_t cmds;
+};
+
+/* Each client is served by its own thread with its own pass-through
+ * object and transfer buffer, so a slow device or a stalled client does
+ * not hold up the others. */
+struct srvd_client {
+    int sfd;
+    int dev_idx;                /* -1 until an OPEN succeeds */
+    int slot;                   /* in clients[] */
+    uint64_t pt_id;             /* srvd_fd::id that ptp is bound to */
+    uint64_t deadline_ns;       /* of the request being transferred */
+    struct sg_pt_base * ptp;
+    uint8_t * xfer_bp;          /* used for both data-out and data-in */
+    uint32_t xfer_len;
+};
+
+static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"socket", required_argument, 0, 's'},
+        {"timeout", required_argument, 0, 't'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {0, 0, 0, 0},
+};
+
+/* srvd_mtx protects devs[], num_devs, the srvd_fd objects, clients[] and
+ * num_clients */
+static pthread_mutex_t srvd_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clients_cv = PTHREAD_COND_INITIALIZER;
+static struct srvd_dev devs[MAX_DEVICES];
+static int num_devs;
+static struct srvd_client * clients[MAX_CLIENTS];
+static int num_clients;
+static uint64_t next_fd_id = 1;
+static int req_timeout = DEF_REQ_TIMEOUT;
+static volatile sig_atomic_t stop_req;
+static int verbose;
+
+
+static void
+usage()
+{
+    pr2serr("Usage: sg_srvd [--help] [--socket=SOCK] [--timeout=SECS] "
+            "[--verbose]\n"
+            "               [--version]\n"
+            "  where:\n"
+            "    --help|-h          print usage message then exit\n"
+            "    --socket=SOCK|-s SOCK    name of Unix socket to listen "
+            "on (def:\n"
+            "                       SG3_UTILS_BROKER if set, else %s)\n"
+            "    --timeout=SECS|-t SECS    seconds a client has to send "
+            "a request,\n"
+            "                              or take its response (def: "
+            "%d)\n"
+            "    --verbose|-v       increase verbosity\n"
+            "    --version|-V       print version string then exit\n\n"
+            "Device handle broker: keeps devices open for utilities run "
+            "with the\nSG3_UTILS_BROKER environment variable set to SOCK "
+            "and executes their\ncommands. Runs until SIGINT or SIGTERM.\n",
+            DEF_SOCKET_NAME, DEF_REQ_TIMEOUT);
+}
+
+static void
+stop_handler(int sig)
+{
+    (void)sig;
+    stop_req = 1;
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Returns index into devs[] or a negated errno. Call with srvd_mtx held */
+static int
+dev_get(const char * name, int oflags)
+{
+    bool created = false;
+    int k, fd;
+    struct srvd_dev * dp;
+    struct srvd_fd * hp;
+
+    for (k = 0; k < num_devs; ++k) {
+        dp = devs + k;
+        if ((oflags == dp->oflags) && (0 == strcmp(name, dp->name)))
+            break;
+    }
+    if (k >= num_devs) {
+        if (num_devs >= MAX_DEVICES)
+            return -EMFILE;
+        dp = devs + k;
+        dp->name = strdup(name);
+        if (NULL == dp->name)
+            return -ENOMEM;
+        dp->oflags = oflags;
+        dp->hp = NULL;
+        dp->cmds = 0;
+        ++num_devs;
+        created = true;
+    }
+    if (NULL == dp->hp) {
+        hp = (struct srvd_fd *)calloc(1, sizeof(*hp));
+        fd = hp ? scsi_pt_open_flags(dp->name, dp->oflags, verbose) :
+                  -ENOMEM;
+        if (fd < 0) {
+            free(hp);
+            if (created) {      /* don't remember names that fail */
+                free(dp->name);
+                --num_devs;
+            }
+            return fd;
+        }
+        hp->fd = fd;
+        hp->refs = 1;
+        hp->id = next_fd_id++;
+        dp->hp = hp;
+        if (verbose)
+            pr2serr("opened %s, fd=%d\n", dp->name, fd);
+    }
+    return k;
+}
+
+/* Call with srvd_mtx held */
+static void
+fd_put(struct srvd_fd * hp)
+{
+    if (--hp->refs > 0)
+        return;
+    scsi_pt_close_device(hp->fd);
+    free(hp);
+}
+
+/* The device has gone away (or been replaced); re-open on next use. Call
+ * with srvd_mtx held */
+static void
+dev_drop(struct srvd_dev * dp)
+{
+    if (NULL == dp->hp)
+        return;
+    if (verbose)
+        pr2serr("closing %s after %" PRIu64 " commands\n", dp->name,
+                dp->cmds);
+    fd_put(dp->hp);
+    dp->hp = NULL;
+}
+
+static int
+xfer_buff_ensure(struct srvd_client * cp, uint32_t len)
+{
+    if (len <= cp->xfer_len)
+        return 0;
+    free(cp->xfer_bp);
+    cp->xfer_bp = (uint8_t *)malloc(len);
+    if (NULL == cp->xfer_bp) {
+        cp->xfer_len = 0;
+        return -ENOMEM;
+    }
+    cp->xfer_len = len;
+    return 0;
+}
+
+/* As sg_broker_xfer() but fails with -ETIMEDOUT when cp->deadline_ns
+ * passes, so a client that stalls part way through a request (or does not
+ * take its response) is dropped after req_timeout seconds. */
+static int
+client_xfer(struct srvd_client * cp, void * bp, uint32_t len, bool out)
+{
+    int res;
+    int64_t ms;
+    ssize_t n;
+    uint8_t * p = (uint8_t *)bp;
+    struct pollfd pfd;
+
+    pfd.fd = cp->sfd;
+    pfd.events = out ? POLLOUT : POLLIN;
+    while (len > 0) {
+        ms = ((int64_t)cp->deadline_ns - (int64_t)now_ns()) / 1000000;
+        if (ms <= 0)
+            return -ETIMEDOUT;
+        res = poll(&pfd, 1, (int)ms);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            return -errno;
+        } else if (0 == res)
+            return -ETIMEDOUT;
+        n = out ? send(cp->sfd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT) :
+                  recv(cp->sfd, p, len, MSG_DONTWAIT);
+        if (n < 0) {
+            if ((EINTR == errno) || (EAGAIN == errno) ||
+                (EWOULDBLOCK == errno))
+                continue;
+            return -errno;
+        } else if (0 == n)
+            return -EPIPE;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int
+do_open(struct srvd_client * cp, const struct sg_broker_req * reqp)
+{
+    int res;
+    char name[PATH_MAX];
+    struct sg_broker_rsp rsp;
+
+    if ((0 == reqp->len1) || (reqp->len1 >= sizeof(name)))
+        return -EPROTO;
+    res = client_xfer(cp, name, reqp->len1, false);
+    if (res)
+        return res;
+    name[reqp->len1] = '\0';
+    pthread_mutex_lock(&srvd_mtx);
+    res = dev_get(name, (int)reqp->flags);
+    pthread_mutex_unlock(&srvd_mtx);
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.magic = SG_BROKER_MAGIC;
+    if (res < 0) {
+        rsp.res = res;
+        if (verbose)
+            pr2serr("open(%s) failed: %s\n", name, safe_strerror(-res));
+    } else
+        cp->dev_idx = res;
+    return client_xfer(cp, &rsp, sizeof(rsp), true);
+}
+
+static int
+do_cmd(struct srvd_client * cp, const struct sg_broker_req * reqp)
+{
+    int res, k;
+    uint32_t len;
+    struct srvd_dev * dp;
+    struct srvd_fd * hp;
+    struct sg_pt_base * ptp;
+    struct sg_pt_linux_scsi * lsp;
+    struct sg_broker_rsp rsp;
+    uint8_t cdb[SG_BROKER_MAX_CDB];
+    uint8_t sense[SG_BROKER_MAX_SENSE];
+
+    if ((0 == reqp->len1) || (reqp->len1 > SG_BROKER_MAX_CDB) ||
+        (reqp->dout_len > SG_BROKER_MAX_XFER) ||
+        (reqp->din_len > SG_BROKER_MAX_XFER) ||
+        (reqp->dout_len && reqp->din_len))
+        return -EPROTO;
+    len = (reqp->dout_len > reqp->din_len) ? reqp->dout_len : reqp->din_len;
+    res = xfer_buff_ensure(cp, len);
+    if (res)
+        return res;
+    res = client_xfer(cp, cdb, reqp->len1, false);
+    if ((0 == res) && reqp->dout_len)
+        res = client_xfer(cp, cp->xfer_bp, reqp->dout_len, false);
+    if (res)
+        return res;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.magic = SG_BROKER_MAGIC;
+    if (cp->dev_idx < 0) {
+        rsp.res = SCSI_PT_DO_BAD_PARAMS;
+        return client_xfer(cp, &rsp, sizeof(rsp), true);
+    }
+    pthread_mutex_lock(&srvd_mtx);
+    dp = devs + cp->dev_idx;
+    k = dev_get(dp->name, dp->oflags);  /* re-opens if dropped */
+    hp = dp->hp;
+    if (k >= 0) {
+        ++hp->refs;
+        ++dp->cmds;
+    }
+    pthread_mutex_unlock(&srvd_mtx);
+    if (k < 0) {
+        rsp.res = k;
+        rsp.os_err = -k;
+        return client_xfer(cp, &rsp, sizeof(rsp), true);
+    }
+    if (NULL == cp->ptp) {
+        cp->ptp = construct_scsi_pt_obj_with_fd(hp->fd, verbose);
+        if (cp->ptp)
+            cp->pt_id = hp->id;
+    } else if (cp->pt_id != hp->id) {
+        set_pt_file_handle(cp->ptp, hp->fd, verbose);
+        cp->pt_id = hp->id;
+    }
+    ptp = cp->ptp;
+    if (NULL == ptp) {
+        pthread_mutex_lock(&srvd_mtx);
+        fd_put(hp);
+        pthread_mutex_unlock(&srvd_mtx);
+        return -ENOMEM;
+    }
+    clear_scsi_pt_obj(ptp);
+    set_scsi_pt_cdb(ptp, cdb, reqp->len1);
+    len = (reqp->max_sense_len > sizeof(sense)) ? sizeof(sense) :
+                                                  reqp->max_sense_len;
+    if (len > 0)
+        set_scsi_pt_sense(ptp, sense, len);
+    if (reqp->dout_len)
+        set_scsi_pt_data_out(ptp, cp->xfer_bp, reqp->dout_len);
+    else if (reqp->din_len)
+        set_scsi_pt_data_in(ptp, cp->xfer_bp, reqp->din_len);
+    res = do_scsi_pt(ptp, -1, ((reqp->timeout_secs > 0) ?
+                               reqp->timeout_secs : DEF_PT_TIMEOUT), verbose);
+    lsp = &ptp->impl;
+    rsp.res = res;
+    rsp.os_err = get_scsi_pt_os_err(ptp);
+    rsp.device_status = lsp->io_hdr.device_status;
+    rsp.transport_status = lsp->io_hdr.transport_status;
+    rsp.driver_status = lsp->io_hdr.driver_status;
+    rsp.din_resid = lsp->io_hdr.din_resid;
+    rsp.dout_resid = lsp->io_hdr.dout_resid;
+    rsp.duration = lsp->io_hdr.duration;
+    rsp.nvme_result = lsp->nvme_result;
+    rsp.nvme_status = lsp->nvme_status;
+    rsp.nvme_direct = lsp->nvme_direct;
+    rsp.sense_len = (len > 0) ? get_scsi_pt_sense_len(ptp) : 0;
+    if (rsp.sense_len > len)
+        rsp.sense_len = len;
+    if (reqp->din_len && ((0 == res) || (SCSI_PT_DO_NVME_STATUS == res))) {
+        k = reqp->din_len - get_scsi_pt_resid(ptp);
+        rsp.din_len = ((k < 0) || (k > (int)reqp->din_len)) ?
+                      reqp->din_len : (uint32_t)k;
+    }
+    pthread_mutex_lock(&srvd_mtx);
+    if (((-ENODEV == res) || (-ENXIO == res) || (ENODEV == rsp.os_err) ||
+         (ENXIO == rsp.os_err)) && (dp->hp == hp))
+        dev_drop(dp);
+    fd_put(hp);
+    pthread_mutex_unlock(&srvd_mtx);
+    /* the device may have been slow; the response gets its own time */
+    cp->deadline_ns = now_ns() + (uint64_t)req_timeout * 1000000000;
+    res = client_xfer(cp, &rsp, sizeof(rsp), true);
+    if ((0 == res) && rsp.sense_len)
+        res = client_xfer(cp, sense, rsp.sense_len, true);
+    if ((0 == res) && rsp.din_len)
+        res = client_xfer(cp, cp->xfer_bp, rsp.din_len, true);
+    return res;
+}
+
+/* Waits, without a time limit, for the next request then serves it.
+ * Returns 0 to keep the client connected, else its connection is closed */
+static int
+serve_client(struct srvd_client * cp)
+{
+    int res;
+    struct pollfd pfd;
+    struct sg_broker_req req;
+
+    pfd.fd = cp->sfd;
+    pfd.events = POLLIN;
+    while ((res = poll(&pfd, 1, -1)) < 0) {
+        if (EINTR != errno)
+            return -errno;
+    }
+    cp->deadline_ns = now_ns() + (uint64_t)req_timeout * 1000000000;
+    res = client_xfer(cp, &req, sizeof(req), false);
+    if (res)
+        return res;
+    if (SG_BROKER_MAGIC != req.magic)
+        return -EPROTO;
+    switch (req.op) {
+    case SG_BROKER_OP_OPEN:
+        return do_open(cp, &req);
+    case SG_BROKER_OP_CMD:
+        return do_cmd(cp, &req);
+    default:
+        return -EPROTO;
+    }
+}
+
+static void *
+client_thread(void * v_cp)
+{
+    int res;
+    struct srvd_client * cp = (struct srvd_client *)v_cp;
+
+    while (0 == (res = serve_client(cp)))
+        ;
+    if (verbose && (-EPIPE != res))
+        pr2serr("dropping client on fd=%d: %s\n", cp->sfd,
+                safe_strerror(-res));
+    if (cp->ptp)
+        destruct_scsi_pt_obj(cp->ptp);
+    free(cp->xfer_bp);
+    close(cp->sfd);
+    pthread_mutex_lock(&srvd_mtx);
+    clients[cp->slot] = clients[--num_clients];
+    clients[cp->slot]->slot = cp->slot;
+    pthread_cond_signal(&clients_cv);
+    pthread_mutex_unlock(&srvd_mtx);
+    free(cp);
+    return NULL;
+}
+
+/* Only the user running the daemon (and root) may have it issue
+ * pass-through commands. The socket's permissions say the same, this
+ * also covers a socket placed in a directory others can reach. */
+static bool
+peer_allowed(int sfd)
+{
+    struct ucred uc;
+    socklen_t len = sizeof(uc);
+
+    if (getsockopt(sfd, SOL_SOCKET, SO_PEERCRED, &uc, &len) < 0) {
+        if (verbose)
+            perror("getsockopt(SO_PEERCRED)");
+        return false;
+    }
+    if ((0 == uc.uid) || (geteuid() == uc.uid))
+        return true;
+    if (verbose)
+        pr2serr("refused client pid=%d uid=%u\n", (int)uc.pid,
+                (unsigned int)uc.uid);
+    return false;
+}
+
+/* Starts a thread for the client connected on sfd, or closes sfd */
+static void
+client_add(int sfd, const sigset_t * blockp)
+{
+    int err;
+    pthread_t tid;
+    pthread_attr_t attr;
+    sigset_t old_set;
+    struct srvd_client * cp;
+
+    if (! peer_allowed(sfd)) {
+        close(sfd);
+        return;
+    }
+    cp = (struct srvd_client *)calloc(1, sizeof(*cp));
+    if (NULL == cp) {
+        close(sfd);
+        return;
+    }
+    cp->sfd = sfd;
+    cp->dev_idx = -1;
+    pthread_mutex_lock(&srvd_mtx);
+    if (num_clients >= MAX_CLIENTS) {
+        pthread_mutex_unlock(&srvd_mtx);
+        if (verbose)
+            pr2serr("too many clients\n");
+        free(cp);
+        close(sfd);
+        return;
+    }
+    cp->slot = num_clients;
+    clients[num_clients++] = cp;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    /* SIGINT and SIGTERM are for the main thread, new thread inherits */
+    pthread_sigmask(SIG_BLOCK, blockp, &old_set);
+    err = pthread_create(&tid, &attr, client_thread, cp);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        clients[cp->slot] = clients[--num_clients];
+        clients[cp->slot]->slot = cp->slot;
+        pthread_mutex_unlock(&srvd_mtx);
+        pr2serr("pthread_create: %s\n", safe_strerror(err));
+        free(cp);
+        close(sfd);
+        return;
+    }
+    pthread_mutex_unlock(&srvd_mtx);
+}
+
+static int
+listen_on(const char * sock_name)
+{
+    int sfd;
+    mode_t old_mask;
+    struct sockaddr_un sa;
+
+    if (strlen(sock_name) >= sizeof(sa.sun_path)) {
+        pr2serr("socket name too long: %s\n", sock_name);
+        return -1;
+    }
+    sfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sfd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, sock_name);
+    unlink(sock_name);
+    old_mask = umask(0077);     /* only this user may send commands */
+    if (bind(sfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        perror("bind");
+        umask(old_mask);
+        close(sfd);
+        return -1;
+    }
+    umask(old_mask);
+    if (listen(sfd, 64) < 0) {
+        perror("listen");
+        close(sfd);
+        unlink(sock_name);
+        return -1;
+    }
+    return sfd;
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    bool version_given = false;
+    int c, k, n, lfd, sfd;
+    const char * sock_name = NULL;
+    struct sigaction sa;
+    sigset_t stop_set;
+    struct pollfd pfd;
+
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "hs:t:vV", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 's':
+            sock_name = optarg;
+            break;
+        case 't':
+            req_timeout = sg_get_num(optarg);
+            if (req_timeout < 1) {
+                pr2serr("bad argument to '--timeout='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            ++verbose;
+            break;
+        case 'V':
+            version_given = true;
+            break;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (version_given) {
+        pr2serr("version: %s\n", version_str);
+        return 0;
+    }
+    if (NULL == sock_name) {
+        sock_name = getenv("SG3_UTILS_BROKER");
+        if ((NULL == sock_name) || ('\0' == *sock_name))
+            sock_name = DEF_SOCKET_NAME;
+    }
+    /* this daemon opens the devices itself */
+    unsetenv("SG3_UTILS_BROKER");
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    lfd = listen_on(sock_name);
+    if (lfd < 0)
+        return SG_LIB_FILE_ERROR;
+    if (verbose)
+        pr2serr("listening on %s\n", sock_name);
+
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    while (! stop_req) {
+        pfd.fd = lfd;
+        pfd.events = POLLIN;
+        n = poll(&pfd, 1, -1);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            perror("poll");
+            break;
+        }
+        if (pfd.revents & POLLIN) {
+            sfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+            if (sfd >= 0)
+                client_add(sfd, &stop_set);
+        }
+    }
+    /* wake the client threads, then wait for their commands to finish */
+    pthread_mutex_lock(&srvd_mtx);
+    for (k = 0; k < num_clients; ++k)
+        shutdown(clients[k]->sfd, SHUT_RDWR);
+    while (num_clients > 0)
+        pthread_cond_wait(&clients_cv, &srvd_mtx);
+    pthread_mutex_unlock(&srvd_mtx);
+    for (k = 0; k < num_devs; ++k) {
+        dev_drop(devs + k);
+        free(devs[k].name);
+    }
+    close(lfd);
+    unlink(sock_name);
+    return 0;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2019 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -15,7 +15,9 @@
 #include <stdbool.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -34,15 +36,45 @@
  *
  * This program issues the SCSI command SYNCHRONIZE CACHE(10 or 16) to the
  * given device. This command is defined for SCSI "direct access" devices
- * (e.g. disks).
+ * (e.g. disks). When more than one device is given, the command is sent to
+ * all of them at about the same time from a pool of threads.
  */
 
-static const char * version_str = "1.24 20190113";
+static const char * version_str = "1.25 20261014";
 
 #define SYNCHRONIZE_CACHE16_CMD     0x91
 #define SYNCHRONIZE_CACHE16_CMDLEN  16
 #define SENSE_BUFF_LEN  64
 #define DEF_PT_TIMEOUT  60       /* 60 seconds */
+#define DEF_MAX_JOBS    256
+#define MAX_JOBS        1024
+
+struct sync_dev_t {
+    const char * dev_name;
+    int fd;
+    int res;            /* open error (as sg_convert_errno()) or command */
+    bool opened;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+struct sync_coll_t {
+    bool do_16;
+    bool immed;
+    bool sync_nv;
+    bool go;            /* set, under mtx, once all workers are ready */
+    int group;
+    int to_secs;
+    int verbose;
+    int num_devs;
+    int num_ready;
+    int next_ind;       /* next element of arr to sync, atomic */
+    unsigned int num_lb;
+    int64_t lba;
+    struct sync_dev_t * arr;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+};
 
 
 static struct option long_options[] = {
@@ -51,6 +83,7 @@ static struct option long_options[] = {
         {"group", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"immed", no_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
         {"lba", required_argument, 0, 'l'},
         {"sync-nv", no_argument, 0, 's'},
         {"timeout", required_argument, 0, 't'},
@@ -63,9 +96,9 @@ static void usage()
 {
     pr2serr("Usage: sg_sync    [--16] [--count=COUNT] [--group=GN] [--help] "
             "[--immed]\n"
-            "                  [--lba=LBA] [--sync-nv] [--timeout=SECS] "
-            "[--verbose]\n"
-            "                  [--version] DEVICE\n"
+            "                  [--jobs=J] [--lba=LBA] [--sync-nv] "
+            "[--timeout=SECS]\n"
+            "                  [--verbose] [--version] DEVICE [DEVICE...]\n"
             "  where:\n"
             "    --16|-S             calls SYNCHRONIZE CACHE(16) (def: is "
             "10 byte\n"
@@ -78,6 +111,9 @@ static void usage()
             "    --immed|-i          command returns immediately when set "
             "else wait\n"
             "                        for 'sync' to complete\n"
+            "    --jobs=J|-j J       number of threads used when more than "
+            "one DEVICE\n"
+            "                        (def: one per DEVICE, at most 256)\n"
             "    --lba=LBA|-l LBA    logical block address to start sync "
             "operation\n"
             "                        from (def: 0)\n"
@@ -89,7 +125,10 @@ static void usage()
             "                              if '--16' given (def: 60 seconds)\n"
             "    --verbose|-v        increase verbosity\n"
             "    --version|-V        print version string and exit\n\n"
-            "Performs a SCSI SYNCHRONIZE CACHE(10 or 16) command\n");
+            "Performs a SCSI SYNCHRONIZE CACHE(10 or 16) command. When "
+            "more than one\nDEVICE is given, sends it to all of them "
+            "concurrently then reports each\nlatency and the barrier time "
+            "(first start to last completion).\n");
 }
 
 static int
@@ -147,6 +186,163 @@ sg_ll_sync_cache_16(int sg_fd, bool sync_nv, bool immed, int group,
     return ret;
 }
 
+static int
+do_sync(int sg_fd, const struct sync_coll_t * scp, bool noisy, int verbose)
+{
+    if (scp->do_16)
+        return sg_ll_sync_cache_16(sg_fd, scp->sync_nv, scp->immed,
+                                   scp->group, scp->lba, scp->num_lb,
+                                   scp->to_secs, noisy, verbose);
+    return sg_ll_sync_cache_10(sg_fd, scp->sync_nv, scp->immed, scp->group,
+                               (unsigned int)scp->lba, scp->num_lb, noisy,
+                               verbose);
+}
+
+/* Waits until all workers are ready then takes DEVICEs, in order, until
+ * none are left. Each is timed from just before its command is issued. */
+static void *
+sync_worker(void * v_scp)
+{
+    int k;
+    struct sync_coll_t * scp = (struct sync_coll_t *)v_scp;
+    struct sync_dev_t * sdp;
+
+    pthread_mutex_lock(&scp->mtx);
+    ++scp->num_ready;
+    pthread_cond_broadcast(&scp->cv);
+    while (! scp->go)
+        pthread_cond_wait(&scp->cv, &scp->mtx);
+    pthread_mutex_unlock(&scp->mtx);
+
+    while ((k = __atomic_fetch_add(&scp->next_ind, 1, __ATOMIC_RELAXED)) <
+           scp->num_devs) {
+        sdp = scp->arr + k;
+        if (! sdp->opened)
+            continue;
+        sdp->start_ns = sg_pt_lat_now_ns();
+        sdp->res = do_sync(sdp->fd, scp, scp->verbose > 0, scp->verbose);
+        sdp->end_ns = sg_pt_lat_now_ns();
+    }
+    return NULL;
+}
+
+/* With more than one DEVICE: opens them all, starts num_thr workers that
+ * wait at a common start gate, releases them together then outputs the
+ * latency of each DEVICE followed by a summary. Returns 0 if all synced,
+ * else the error of the first DEVICE that failed. */
+static int
+multi_sync(struct sync_coll_t * scp, char ** dev_names, int num_thr)
+{
+    int k, err;
+    int n = scp->num_devs;
+    int num_ok = 0;
+    int ret = 0;
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+    uint64_t last_start_ns = 0;
+    uint64_t lat, min_lat = 0, max_lat = 0, sum_lat = 0;
+    struct sync_dev_t * sdp;
+    pthread_t * tids;
+    char b[80];
+
+    scp->arr = (struct sync_dev_t *)calloc(n, sizeof(*scp->arr));
+    tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+    if ((NULL == scp->arr) || (NULL == tids)) {
+        pr2serr("unable to allocate memory for %d devices\n", n);
+        free(scp->arr);
+        free(tids);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < n; ++k) {
+        sdp = scp->arr + k;
+        sdp->dev_name = dev_names[k];
+        sdp->fd = sg_cmds_open_device(sdp->dev_name, false /* rw */,
+                                      scp->verbose);
+        if (sdp->fd < 0) {
+            pr2serr("open error: %s: %s\n", sdp->dev_name,
+                    safe_strerror(-sdp->fd));
+            sdp->res = sg_convert_errno(-sdp->fd);
+        } else
+            sdp->opened = true;
+    }
+    pthread_mutex_init(&scp->mtx, NULL);
+    pthread_cond_init(&scp->cv, NULL);
+    for (k = 0; k < num_thr; ++k) {
+        err = pthread_create(tids + k, NULL, sync_worker, scp);
+        if (err) {
+            pr2serr("pthread_create: %s, continue with %d threads\n",
+                    safe_strerror(err), k);
+            break;
+        }
+    }
+    num_thr = k;
+    pthread_mutex_lock(&scp->mtx);
+    while (scp->num_ready < num_thr)
+        pthread_cond_wait(&scp->cv, &scp->mtx);
+    scp->go = true;
+    pthread_cond_broadcast(&scp->cv);
+    pthread_mutex_unlock(&scp->mtx);
+    if (0 == num_thr)
+        sync_worker(scp);       /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_cond_destroy(&scp->cv);
+    pthread_mutex_destroy(&scp->mtx);
+
+    printf("Synchronize cache on %d devices using %d threads:\n", n,
+           num_thr);
+    for (k = 0; k < n; ++k) {
+        sdp = scp->arr + k;
+        if (sdp->opened) {
+            lat = sdp->end_ns - sdp->start_ns;
+            if ((0 == first_ns) || (sdp->start_ns < first_ns))
+                first_ns = sdp->start_ns;
+            if (sdp->start_ns > last_start_ns)
+                last_start_ns = sdp->start_ns;
+            if (sdp->end_ns > last_ns)
+                last_ns = sdp->end_ns;
+        } else
+            lat = 0;
+        if (sdp->res) {
+            sg_get_category_sense_str(sdp->res, sizeof(b), b, scp->verbose);
+            if (sdp->opened)
+                printf("  %s: FAILED after %.3f ms: %s\n", sdp->dev_name,
+                       (double)lat / 1000000.0, b);
+            else
+                printf("  %s: not opened: %s\n", sdp->dev_name, b);
+            if (0 == ret)
+                ret = sdp->res;
+            continue;
+        }
+        printf("  %s: %.3f ms\n", sdp->dev_name, (double)lat / 1000000.0);
+        if ((0 == num_ok) || (lat < min_lat))
+            min_lat = lat;
+        if (lat > max_lat)
+            max_lat = lat;
+        sum_lat += lat;
+        ++num_ok;
+    }
+    printf("%d of %d devices synced", num_ok, n);
+    if (num_ok > 0)
+        printf("; latency (ms): min=%.3f avg=%.3f max=%.3f", (double)min_lat
+               / 1000000.0, (double)sum_lat / num_ok / 1000000.0,
+               (double)max_lat / 1000000.0);
+    printf("\n");
+    if (first_ns > 0)
+        printf("barrier time: %.3f ms (first start to last completion), "
+               "start skew: %.3f ms\n", (double)(last_ns - first_ns) /
+               1000000.0, (double)(last_start_ns - first_ns) / 1000000.0);
+
+    for (k = 0; k < n; ++k) {
+        if (scp->arr[k].opened)
+            sg_cmds_close_device(scp->arr[k].fd);
+    }
+    free(scp->arr);
+    scp->arr = NULL;
+    free(tids);
+    return ret;
+}
+
 
 int main(int argc, char * argv[])
 {
@@ -159,17 +355,21 @@ int main(int argc, char * argv[])
     int sg_fd = -1;
     int group = 0;
     int ret = 0;
+    int num_devs = 0;
+    int num_jobs = 0;
     int to_secs = DEF_PT_TIMEOUT;
     int verbose = 0;
     unsigned int num_lb = 0;
     int64_t count = 0;
     int64_t lba = 0;
     const char * device_name = NULL;
+    char ** dev_names = NULL;
+    struct sync_coll_t sc;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "c:g:hil:sSt:vV", long_options,
+        c = getopt_long(argc, argv, "c:g:hij:l:sSt:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -197,6 +397,14 @@ int main(int argc, char * argv[])
         case 'i':
             immed = true;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             lba = sg_get_llnum(optarg);
             if (lba < 0) {
@@ -231,16 +439,9 @@ int main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        device_name = argv[optind];
+        dev_names = argv + optind;
+        num_devs = argc - optind;
     }
 
 #ifdef DEBUG
@@ -269,6 +470,24 @@ int main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    memset(&sc, 0, sizeof(sc));
+    sc.do_16 = do_16;
+    sc.immed = immed;
+    sc.sync_nv = sync_nv;
+    sc.group = group;
+    sc.to_secs = to_secs;
+    sc.verbose = verbose;
+    sc.num_devs = num_devs;
+    sc.num_lb = num_lb;
+    sc.lba = lba;
+    if (num_devs > 1) {
+        if (0 == num_jobs)
+            num_jobs = (num_devs < DEF_MAX_JOBS) ? num_devs : DEF_MAX_JOBS;
+        else if (num_jobs > num_devs)
+            num_jobs = num_devs;
+        ret = multi_sync(&sc, dev_names, num_jobs);
+        goto fini;
+    }
     sg_fd = sg_cmds_open_device(device_name, false /* rw */, verbose);
     if (sg_fd < 0) {
         if (verbose)
@@ -278,12 +497,7 @@ int main(int argc, char * argv[])
         goto fini;
     }
 
-    if (do_16)
-        res = sg_ll_sync_cache_16(sg_fd, sync_nv, immed, group, lba, num_lb,
-                                  to_secs, true, verbose);
-    else
-        res = sg_ll_sync_cache_10(sg_fd, sync_nv, immed, group,
-                                  (unsigned int)lba, num_lb, true, verbose);
+    res = do_sync(sg_fd, &sc, true, verbose);
     ret = res;
     if (res) {
         char b[80];
@@ -1,7 +1,7 @@
 /*
  * (c) 2000 Kurt Garloff <garloff at suse dot de>
  * heavily based on Douglas Gilbert's sg_rbuf program.
- * (c) 1999-2018 Douglas Gilbert
+ * (c) 1999-2026 Douglas Gilbert
  *
  * Program to test the SCSI host adapter by issuing
  * write and read operations on a device's buffer
@@ -30,9 +30,13 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <time.h>
@@ -47,7 +51,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.18 20180628";
+static const char * version_str = "1.19 20261014";
 
 #define BPI (signed)(sizeof(int))
 
@@ -55,6 +59,8 @@ static const char * version_str = "1.18 20180628";
 #define RWB_MODE_DATA 2
 #define RB_DESC_LEN 4
 
+#define RWB_SUM 0x12345678      /* of a buffer's words plus its base */
+
 /*  The microcode in a SCSI device is _not_ modified by doing a WRITE BUFFER
  *  with mode set to "data" (0x2) as done by this utility. Therefore this
  *  utility is safe in that respect. [Mode values 0x4, 0x5, 0x6 and 0x7 are
@@ -63,12 +69,34 @@ static const char * version_str = "1.18 20180628";
 
 #define ME "sg_test_rwbuf: "
 
-static int base = 0x12345678;
-static int buf_capacity = 0;
-static int buf_granul = 255;
-static uint8_t *cmpbuf = NULL;
-static uint8_t *free_cmpbuf = NULL;
-
+/* With GCC and clang the pattern generation and the checksum use vectors
+ * of four 32 bit words (e.g. SSE2 on x86_64 or NEON on aarch64), four
+ * vectors per step. */
+#if defined(__GNUC__) && (! defined(SG_TEST_RWBUF_NO_VEC))
+#define RWB_VEC 1
+typedef uint32_t rwb_v4u32 __attribute__((vector_size(16), may_alias));
+#endif
+#define RWB_STEP 64             /* bytes per vector step */
+
+/* One per DEVICE, each run by its own thread when several are given */
+struct rwb_dev {
+        int sg_fd;
+        int buf_capacity;
+        int buf_granul;
+        int first_err;
+        uint32_t base;          /* chosen so the checksum is RWB_SUM */
+        int64_t cycles;         /* write then read back without error */
+        int64_t cmd_errs;
+        int64_t miscompares;
+        uint8_t * wbuf;         /* pattern stays here until next write */
+        uint8_t * free_wbuf;
+        uint8_t * rbuf;
+        uint8_t * free_rbuf;
+        uint32_t rng[RWB_STEP / 4];     /* xorshift32 state, one per lane */
+        pthread_t tid;
+        const char * device_name;
+        char pfx[64];           /* "DEVICE: " when several, else "" */
+};
 
 /* Options */
 static int size = -1;
@@ -76,12 +104,18 @@ static bool do_quick = false;
 static int addwrite  = 0;
 static int addread   = 0;
 static int verbose   = 0;
+static int times     = 1;       /* 0 -> no limit (only with --soak) */
+static int soak_secs = -1;      /* -1 -> not soak mode, 0 -> until SIGINT */
+
+static time_t soak_end;
+static volatile sig_atomic_t soak_stop = 0;
 
 static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"quick", no_argument, 0, 'q'},
         {"addrd", required_argument, 0, 'r'},
         {"size", required_argument, 0, 's'},
+        {"soak", required_argument, 0, 'S'},
         {"times", required_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -89,14 +123,22 @@ static struct option long_options[] = {
         {0, 0, 0, 0},
 };
 
+static void
+soak_sigint(int sig)
+{
+        if (sig) { ; }      /* unused, dummy to suppress warning */
+        soak_stop = 1;
+}
+
 static int
-find_out_about_buffer(int sg_fd)
+find_out_about_buffer(struct rwb_dev * dp)
 {
         uint8_t rb_cdb[] = {READ_BUFFER, 0, 0, 0, 0, 0, 0, 0, 0, 0};
         uint8_t rbBuff[RB_DESC_LEN];
         uint8_t sense_buffer[32];
         struct sg_io_hdr io_hdr;
         int k, res;
+        char b[128];
 
         rb_cdb[1] = RB_MODE_DESC;
         rb_cdb[8] = RB_DESC_LEN;
@@ -112,21 +154,24 @@ find_out_about_buffer(int sg_fd)
         io_hdr.timeout = 60000;     /* 60000 millisecs == 60 seconds */
 
         if (verbose) {
-                pr2serr("    read buffer [mode desc] cdb: ");
+                pr2serr("    %sread buffer [mode desc] cdb: ", dp->pfx);
                 for (k = 0; k < (int)sizeof(rb_cdb); ++k)
                         pr2serr("%02x ", rb_cdb[k]);
                 pr2serr("\n");
         }
-        if (ioctl(sg_fd, SG_IO, &io_hdr) < 0) {
-                perror(ME "SG_IO READ BUFFER descriptor error");
+        if (ioctl(dp->sg_fd, SG_IO, &io_hdr) < 0) {
+                snprintf(b, sizeof(b), ME "%sSG_IO READ BUFFER descriptor "
+                         "error", dp->pfx);
+                perror(b);
                 return -1;
         }
         /* now for the error processing */
         res = sg_err_category3(&io_hdr);
         switch (res) {
         case SG_LIB_CAT_RECOVERED:
-                sg_chk_n_print3("READ BUFFER descriptor, continuing",
-                                &io_hdr, true);
+                snprintf(b, sizeof(b), "%sREAD BUFFER descriptor, "
+                         "continuing", dp->pfx);
+                sg_chk_n_print3(b, &io_hdr, true);
 #if defined(__GNUC__)
 #if (__GNUC__ >= 7)
                 __attribute__((fallthrough));
@@ -136,20 +181,22 @@ find_out_about_buffer(int sg_fd)
         case SG_LIB_CAT_CLEAN:
                 break;
         default: /* won't bother decoding other categories */
-                sg_chk_n_print3("READ BUFFER descriptor error", &io_hdr,
-                                true);
+                snprintf(b, sizeof(b), "%sREAD BUFFER descriptor error",
+                         dp->pfx);
+                sg_chk_n_print3(b, &io_hdr, true);
                 return res;
         }
 
-        buf_capacity = sg_get_unaligned_be24(rbBuff + 1);
-        buf_granul = (uint8_t)rbBuff[0];
+        dp->buf_capacity = sg_get_unaligned_be24(rbBuff + 1);
+        dp->buf_granul = (uint8_t)rbBuff[0];
 #if 0
         printf("READ BUFFER reports: %02x %02x %02x %02x\n",
                rbBuff[0], rbBuff[1], rbBuff[2], rbBuff[3]);
 #endif
         if (verbose)
-                printf("READ BUFFER reports: buffer capacity=%d, offset "
-                       "boundary=%d\n", buf_capacity, buf_granul);
+                printf("%sREAD BUFFER reports: buffer capacity=%d, offset "
+                       "boundary=%d\n", dp->pfx, dp->buf_capacity,
+                       dp->buf_granul);
         return 0;
 }
 
@@ -162,85 +209,119 @@ mymemcmp (uint8_t *bf1, uint8_t *bf2, int len)
         return 0;
 }
 
+/* Returns the (wrapping) sum of the 32 bit words in buf, then of any
+ * trailing bytes. buf must be 16 byte aligned. */
+static uint32_t
+sum_buffer(const uint8_t * buf, int len)
+{
+        int i = 0;
+        uint32_t sum = 0;
+        uint32_t w;
+#ifdef RWB_VEC
+        int k;
+        int nv = len / RWB_STEP;
+        const rwb_v4u32 * vp = (const rwb_v4u32 *)buf;
+        rwb_v4u32 a0 = {0, 0, 0, 0};
+        rwb_v4u32 a1 = a0;
+        rwb_v4u32 a2 = a0;
+        rwb_v4u32 a3 = a0;
+
+        for (k = 0; k < nv; ++k, vp += 4) {
+                a0 += vp[0];
+                a1 += vp[1];
+                a2 += vp[2];
+                a3 += vp[3];
+        }
+        a0 += a1 + a2 + a3;
+        sum = a0[0] + a0[1] + a0[2] + a0[3];
+        i = nv * RWB_STEP;
+#endif
+        for ( ; i + BPI <= len; i += BPI) {
+                memcpy(&w, buf + i, sizeof(w));
+                sum += w;
+        }
+        for ( ; i < len; ++i)
+                sum += buf[i];
+        return sum;
+}
+
 /* return 0 if good, else 2222 */
 static int
-do_checksum(int *buf, int len, bool quiet)
+do_checksum(struct rwb_dev * dp, const uint8_t * buf, int len, bool quiet)
 {
-        int sum = base;
-        int i; int rln = len;
-        for (i = 0; i < len/BPI; i++)
-                sum += buf[i];
-        while (rln%BPI) sum += ((char*)buf)[--rln];
-        if (sum != 0x12345678) {
-                if (!quiet) printf ("sg_test_rwbuf: Checksum error (sz=%i):"
-                                    " %08x\n", len, sum);
-                if (cmpbuf && !quiet) {
-                        int diff = mymemcmp (cmpbuf, (uint8_t*)buf,
-                                             len);
-                        printf ("Differ at pos %i/%i:\n", diff, len);
-                        for (i = 0; i < 24 && i+diff < len; i++)
-                                printf (" %02x", cmpbuf[i+diff]);
-                        printf ("\n");
-                        for (i = 0; i < 24 && i+diff < len; i++)
-                                printf (" %02x",
-                                        ((uint8_t*)buf)[i+diff]);
-                        printf ("\n");
-                }
+        int i, diff;
+        uint32_t sum = dp->base + sum_buffer(buf, len);
+
+        if (sum != RWB_SUM) {
+                if (quiet)
+                        return 2222;
+                printf ("%ssg_test_rwbuf: Checksum error (sz=%i): %08x\n",
+                        dp->pfx, len, sum);
+                diff = mymemcmp (dp->wbuf, (uint8_t *)buf, len);
+                printf ("%sDiffer at pos %i/%i:\n", dp->pfx, diff, len);
+                for (i = 0; i < 24 && i+diff < len; i++)
+                        printf (" %02x", dp->wbuf[i+diff]);
+                printf ("\n");
+                for (i = 0; i < 24 && i+diff < len; i++)
+                        printf (" %02x", buf[i+diff]);
+                printf ("\n");
                 return 2222;
         }
         else {
                 if (verbose > 1)
-                        printf("Checksum value: 0x%x\n", sum);
+                        printf("%sChecksum value: 0x%x\n", dp->pfx, sum);
                 return 0;
         }
 }
 
-void do_fill_buffer (int *buf, int len)
+/* Fills buf with a pseudo random pattern from lanes of xorshift32
+ * generators, then picks the base that makes its checksum RWB_SUM. */
+static void
+do_fill_buffer (struct rwb_dev * dp, uint8_t * buf, int len)
 {
-        int sum;
-        int i; int rln = len;
-        srand (time (0));
-    retry:
-        if (len >= BPI)
-                base = 0x12345678 + rand ();
-        else
-                base = 0x12345678 + (char) rand ();
-        sum = base;
-        for (i = 0; i < len/BPI - 1; i++)
-        {
-                /* we rely on rand() giving full range of int */
-                buf[i] = rand ();
-                sum += buf[i];
-        }
-        while (rln%BPI)
-        {
-                ((char*)buf)[--rln] = rand ();
-                sum += ((char*)buf)[rln];
+        int i = 0;
+        uint32_t x;
+#ifdef RWB_VEC
+        int j, k;
+        int nv = len / RWB_STEP;
+        rwb_v4u32 st[4];
+        rwb_v4u32 * vp = (rwb_v4u32 *)buf;
+
+        memcpy(st, dp->rng, sizeof(st));
+        for (k = 0; k < nv; ++k, vp += 4) {
+                for (j = 0; j < 4; ++j) {
+                        st[j] ^= st[j] << 13;
+                        st[j] ^= st[j] >> 17;
+                        st[j] ^= st[j] << 5;
+                        vp[j] = st[j];
+                }
         }
-        if (len >= BPI) buf[len/BPI - 1] = 0x12345678 - sum;
-        else ((char*)buf)[0] = 0x12345678 + ((char*)buf)[0] - sum;
-        if (do_checksum(buf, len, true)) {
-                if (len < BPI) goto retry;
-                printf ("sg_test_rwbuf: Memory corruption?\n");
-                exit (1);
+        memcpy(dp->rng, st, sizeof(st));
+        i = nv * RWB_STEP;
+#endif
+        x = dp->rng[0];
+        for ( ; i < len; i += BPI) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                memcpy(buf + i, &x, ((len - i) < BPI) ? (len - i) : BPI);
         }
-        if (cmpbuf) memcpy (cmpbuf, (char*)buf, len);
+        dp->rng[0] = x;
+        dp->base = RWB_SUM - sum_buffer(buf, len);
 }
 
 
-int read_buffer (int sg_fd, unsigned ssize)
+static int
+read_buffer (struct rwb_dev * dp, unsigned ssize)
 {
         int res, k;
         uint8_t rb_cdb[] = {READ_BUFFER, 0, 0, 0, 0, 0, 0, 0, 0, 0};
         int bufSize = ssize + addread;
-        uint8_t * free_rbBuff = NULL;
-        uint8_t * rbBuff = (uint8_t *)sg_memalign(bufSize, 0, &free_rbBuff,
-                                                  false);
+        uint8_t * rbBuff = dp->rbuf;
         uint8_t sense_buffer[32];
         struct sg_io_hdr io_hdr;
+        char b[128];
 
-        if (NULL == rbBuff)
-                return -1;
         rb_cdb[1] = RWB_MODE_DATA;
         sg_put_unaligned_be24((uint32_t)bufSize, rb_cdb + 6);
         memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
@@ -255,22 +336,25 @@ int read_buffer (int sg_fd, unsigned ssize)
         io_hdr.pack_id = 2;
         io_hdr.timeout = 60000;     /* 60000 millisecs == 60 seconds */
         if (verbose) {
-                pr2serr("    read buffer [mode data] cdb: ");
+                pr2serr("    %sread buffer [mode data] cdb: ", dp->pfx);
                 for (k = 0; k < (int)sizeof(rb_cdb); ++k)
                         pr2serr("%02x ", rb_cdb[k]);
                 pr2serr("\n");
         }
 
-        if (ioctl(sg_fd, SG_IO, &io_hdr) < 0) {
-                perror(ME "SG_IO READ BUFFER data error");
-                free(rbBuff);
+        if (ioctl(dp->sg_fd, SG_IO, &io_hdr) < 0) {
+                snprintf(b, sizeof(b), ME "%sSG_IO READ BUFFER data error",
+                         dp->pfx);
+                perror(b);
                 return -1;
         }
         /* now for the error processing */
         res = sg_err_category3(&io_hdr);
         switch (res) {
         case SG_LIB_CAT_RECOVERED:
-            sg_chk_n_print3("READ BUFFER data, continuing", &io_hdr, true);
+            snprintf(b, sizeof(b), "%sREAD BUFFER data, continuing",
+                     dp->pfx);
+            sg_chk_n_print3(b, &io_hdr, true);
 #if defined(__GNUC__)
 #if (__GNUC__ >= 7)
             __attribute__((fallthrough));
@@ -280,32 +364,29 @@ int read_buffer (int sg_fd, unsigned ssize)
         case SG_LIB_CAT_CLEAN:
                 break;
         default: /* won't bother decoding other categories */
-                sg_chk_n_print3("READ BUFFER data error", &io_hdr, true);
-                free(rbBuff);
+                snprintf(b, sizeof(b), "%sREAD BUFFER data error", dp->pfx);
+                sg_chk_n_print3(b, &io_hdr, true);
                 return res;
         }
 
-        res = do_checksum((int*)rbBuff, ssize, false);
-        if (free_rbBuff)
-                free(free_rbBuff);
-        return res;
+        /* in soak mode only show the first miscompare, unless verbose */
+        return do_checksum(dp, rbBuff, ssize,
+                           (dp->miscompares > 0) && (0 == verbose));
 }
 
-int write_buffer (int sg_fd, unsigned ssize)
+static int
+write_buffer (struct rwb_dev * dp, unsigned ssize)
 {
         uint8_t wb_cdb[] = {WRITE_BUFFER, 0, 0, 0, 0, 0, 0, 0, 0, 0};
         int bufSize = ssize + addwrite;
-        uint8_t * free_wbBuff = NULL;
-        uint8_t * wbBuff = (uint8_t *)sg_memalign(bufSize, 0, &free_wbBuff,
-                                                  false);
+        uint8_t * wbBuff = dp->wbuf;
         uint8_t sense_buffer[32];
         struct sg_io_hdr io_hdr;
         int k, res;
+        char b[128];
 
-        if (NULL == wbBuff)
-                return -1;
-        memset(wbBuff, 0, bufSize);
-        do_fill_buffer ((int*)wbBuff, ssize);
+        /* any additional (addwrite) bytes stay zero */
+        do_fill_buffer (dp, wbBuff, ssize);
         wb_cdb[1] = RWB_MODE_DATA;
         sg_put_unaligned_be24((uint32_t)bufSize, wb_cdb + 6);
         memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
@@ -320,22 +401,25 @@ int write_buffer (int sg_fd, unsigned ssize)
         io_hdr.pack_id = 1;
         io_hdr.timeout = 60000;     /* 60000 millisecs == 60 seconds */
         if (verbose) {
-                pr2serr("    write buffer [mode data] cdb: ");
+                pr2serr("    %swrite buffer [mode data] cdb: ", dp->pfx);
                 for (k = 0; k < (int)sizeof(wb_cdb); ++k)
                         pr2serr("%02x ", wb_cdb[k]);
                 pr2serr("\n");
         }
 
-        if (ioctl(sg_fd, SG_IO, &io_hdr) < 0) {
-                perror(ME "SG_IO WRITE BUFFER data error");
-                free(wbBuff);
+        if (ioctl(dp->sg_fd, SG_IO, &io_hdr) < 0) {
+                snprintf(b, sizeof(b), ME "%sSG_IO WRITE BUFFER data error",
+                         dp->pfx);
+                perror(b);
                 return -1;
         }
         /* now for the error processing */
         res = sg_err_category3(&io_hdr);
         switch (res) {
         case SG_LIB_CAT_RECOVERED:
-            sg_chk_n_print3("WRITE BUFFER data, continuing", &io_hdr, true);
+            snprintf(b, sizeof(b), "%sWRITE BUFFER data, continuing",
+                     dp->pfx);
+            sg_chk_n_print3(b, &io_hdr, true);
 #if defined(__GNUC__)
 #if (__GNUC__ >= 7)
             __attribute__((fallthrough));
@@ -345,22 +429,55 @@ int write_buffer (int sg_fd, unsigned ssize)
         case SG_LIB_CAT_CLEAN:
                 break;
         default: /* won't bother decoding other categories */
-                sg_chk_n_print3("WRITE BUFFER data error", &io_hdr, true);
-                free(wbBuff);
+                snprintf(b, sizeof(b), "%sWRITE BUFFER data error",
+                         dp->pfx);
+                sg_chk_n_print3(b, &io_hdr, true);
                 return res;
         }
-        if (free_wbBuff)
-                free(free_wbBuff);
         return res;
 }
 
+/* Does the write then read back cycles on one DEVICE. Without --soak
+ * stops at the first error, otherwise counts errors and carries on until
+ * the soak time is up (or SIGINT), unless the device itself can no longer
+ * be reached. */
+static void *
+run_device(void * v_dp)
+{
+        struct rwb_dev * dp = (struct rwb_dev *)v_dp;
+        int k, res;
+
+        for (k = 0; (0 == times) || (k < times); ++k) {
+                if ((soak_secs >= 0) && (soak_stop ||
+                    ((soak_secs > 0) && (time(NULL) >= soak_end))))
+                        break;
+                res = write_buffer (dp, size);
+                if (0 == res)
+                        res = read_buffer (dp, size);
+                if (0 == res) {
+                        ++dp->cycles;
+                        continue;
+                }
+                if (2222 == res) {
+                        ++dp->miscompares;
+                        res = SG_LIB_CAT_MISCOMPARE;
+                } else
+                        ++dp->cmd_errs;
+                if (0 == dp->first_err)
+                        dp->first_err = (res > 0) ? res : SG_LIB_CAT_OTHER;
+                if ((soak_secs < 0) || (-1 == res))
+                        break;
+        }
+        return NULL;
+}
+
 void usage ()
 {
         printf ("Usage: sg_test_rwbuf [--addrd=AR] [--addwr=AW] [--help] "
                 "[--quick]\n");
-        printf ("                     --size=SZ [--times=NUM] [--verbose] "
-                "[--version]\n"
-                "                     DEVICE\n"
+        printf ("                     --size=SZ [--soak=SECS] [--times=NUM] "
+                "[--verbose]\n"
+                "                     [--version] DEVICE [DEVICE...]\n"
                 " or\n"
                 "       sg_test_rwbuf DEVICE SZ [AW] [AR]\n");
         printf ("  where:\n"
@@ -371,10 +488,17 @@ void usage ()
                 "    --quick|-q       output read buffer size then exit\n"
                 "    --size=SZ|-s     size of buffer (in bytes) to write "
                 "then read back\n"
+                "    --soak=SECS|-S   keep going for SECS seconds (0 -> "
+                "until interrupted),\n"
+                "                     counting errors rather than stopping "
+                "at the first\n"
                 "    --times=NUM|-t   number of times to run test "
-                "(default 1)\n"
+                "(default 1, with\n"
+                "                     --soak no limit)\n"
                 "    --verbose|-v     increase verbosity of output\n"
                 "    --version|-V     output version then exit\n");
+        printf ("\nWith more than one DEVICE, each is tested at the same "
+                "time by its own\nthread.\n");
         printf ("\nWARNING: If you access the device at the same time, e.g. "
                 "because it's a\n");
         printf (" mounted hard disk, the device's buffer may be used by the "
@@ -382,26 +506,28 @@ void usage ()
         printf (" for other data at the same time, and overwriting it may or "
                 "may not\n");
         printf (" cause data corruption!\n");
-        printf ("(c) Douglas Gilbert, Kurt Garloff, 2000-2007, GNU GPL\n");
+        printf ("(c) Douglas Gilbert, Kurt Garloff, 2000-2026, GNU GPL\n");
 }
 
 
 int main (int argc, char * argv[])
 {
-        bool verbose_given = true;
-        bool version_given = true;
-        int sg_fd, res;
+        bool verbose_given = false;
+        bool version_given = false;
+        bool times_given = false;
+        int res, j, num_devs, num_bad, dev_ind;
         const char * device_name = NULL;
-        int times = 1;
         int ret = 0;
-        int k = 0;
         int err;
+        struct rwb_dev * devs = NULL;
+        struct rwb_dev * dp;
+        struct sigaction sa;
 
         while (1) {
                 int option_index = 0;
                 int c;
 
-                c = getopt_long(argc, argv, "hqr:s:t:w:vV",
+                c = getopt_long(argc, argv, "hqr:s:S:t:w:vV",
                                 long_options, &option_index);
                 if (c == -1)
                         break;
@@ -427,12 +553,20 @@ int main (int argc, char * argv[])
                                 return SG_LIB_SYNTAX_ERROR;
                         }
                         break;
+                case 'S':
+                        soak_secs = sg_get_num(optarg);
+                        if (-1 == soak_secs) {
+                                pr2serr("bad argument to '--soak'\n");
+                                return SG_LIB_SYNTAX_ERROR;
+                        }
+                        break;
                 case 't':
                         times = sg_get_num(optarg);
                         if (-1 == times) {
                                 pr2serr("bad argument to '--times'\n");
                                 return SG_LIB_SYNTAX_ERROR;
                         }
+                        times_given = true;
                         break;
                 case 'v':
                         verbose_given = true;
@@ -453,37 +587,41 @@ int main (int argc, char * argv[])
                         return SG_LIB_SYNTAX_ERROR;
                 }
         }
-        if (optind < argc) {
-                if (NULL == device_name) {
+        num_devs = 0;
+        dev_ind = optind;
+        if ((size > 0) || do_quick) {
+                /* then all the remaining arguments are DEVICEs */
+                num_devs = argc - optind;
+                if (num_devs > 0)
                         device_name = argv[optind];
-                        ++optind;
-                }
+        } else if (optind < argc) {
+                device_name = argv[optind];
+                num_devs = 1;
+                ++optind;
         }
-        if (optind < argc) {
+        if ((1 == num_devs) && (optind < argc) && (-1 == size)) {
+                size = sg_get_num(argv[optind]);
                 if (-1 == size) {
-                        size = sg_get_num(argv[optind]);
-                        if (-1 == size) {
-                                pr2serr("bad <sz>\n");
+                        pr2serr("bad <sz>\n");
+                        usage();
+                        return SG_LIB_SYNTAX_ERROR;
+                }
+                if (++optind < argc) {
+                        addwrite = sg_get_num(argv[optind]);
+                        if (-1 == addwrite) {
+                                pr2serr("bad [addwr]\n");
                                 usage();
                                 return SG_LIB_SYNTAX_ERROR;
                         }
                         if (++optind < argc) {
-                                addwrite = sg_get_num(argv[optind]);
-                                if (-1 == addwrite) {
-                                        pr2serr("bad [addwr]\n");
+                                addread = sg_get_num(argv[optind]);
+                                if (-1 == addread) {
+                                        pr2serr("bad [addrd]\n");
                                         usage();
                                         return SG_LIB_SYNTAX_ERROR;
                                 }
-                                if (++optind < argc) {
-                                        addread = sg_get_num(argv[optind]);
-                                        if (-1 == addread) {
-                                                pr2serr("bad [addrd]\n");
-                                                usage();
-                                                return SG_LIB_SYNTAX_ERROR;
-                                        }
-                                }
+                                ++optind;
                         }
-
                 }
                 if (optind < argc) {
                         for (; optind < argc; ++optind)
@@ -527,54 +665,128 @@ int main (int argc, char * argv[])
                 usage();
                 return SG_LIB_SYNTAX_ERROR;
         }
+        if ((soak_secs >= 0) && (! times_given))
+                times = 0;
 
-        sg_fd = open(device_name, O_RDWR | O_NONBLOCK);
-        if (sg_fd < 0) {
-                err = errno;
-                perror("sg_test_rwbuf: open error");
-                return sg_convert_errno(err);
+        devs = (struct rwb_dev *)calloc(num_devs, sizeof(struct rwb_dev));
+        if (NULL == devs) {
+                pr2serr(ME "out of memory\n");
+                return sg_convert_errno(ENOMEM);
         }
-        ret = find_out_about_buffer(sg_fd);
-        if (ret)
-                goto err_out;
-        if (do_quick) {
-                printf ("READ BUFFER read descriptor reports a buffer "
-                        "of %d bytes [%d KiB]\n", buf_capacity,
-                        buf_capacity / 1024);
-                goto err_out;
+        for (j = 0; j < num_devs; ++j)
+                devs[j].sg_fd = -1;
+        srand (time (0));
+        for (j = 0; j < num_devs; ++j) {
+                dp = devs + j;
+                dp->device_name = argv[dev_ind + j];
+                if (num_devs > 1)
+                        snprintf(dp->pfx, sizeof(dp->pfx), "%.56s: ",
+                                 dp->device_name);
+                dp->sg_fd = open(dp->device_name, O_RDWR | O_NONBLOCK);
+                if (dp->sg_fd < 0) {
+                        err = errno;
+                        pr2serr("sg_test_rwbuf: %sopen error: %s\n",
+                                dp->pfx, safe_strerror(err));
+                        ret = sg_convert_errno(err);
+                        goto err_out;
+                }
+                ret = find_out_about_buffer(dp);
+                if (ret)
+                        goto err_out;
+                if (do_quick) {
+                        printf ("%sREAD BUFFER read descriptor reports a "
+                                "buffer of %d bytes [%d KiB]\n", dp->pfx,
+                                dp->buf_capacity, dp->buf_capacity / 1024);
+                        continue;
+                }
+                if (size > dp->buf_capacity) {
+                        pr2serr (ME "%ssz=%i > buf_capacity=%i\n", dp->pfx,
+                                 size, dp->buf_capacity);
+                        ret = SG_LIB_CAT_OTHER;
+                        goto err_out;
+                }
+                dp->wbuf = sg_memalign(size + addwrite, 0, &dp->free_wbuf,
+                                       false);
+                dp->rbuf = sg_memalign(size + addread, 0, &dp->free_rbuf,
+                                       false);
+                if ((NULL == dp->wbuf) || (NULL == dp->rbuf)) {
+                        pr2serr(ME "out of memory\n");
+                        ret = sg_convert_errno(ENOMEM);
+                        goto err_out;
+                }
+                for (res = 0; res < (int)(RWB_STEP / 4); ++res)
+                        dp->rng[res] = ((uint32_t)rand() << 1) | 1;
         }
-        if (size > buf_capacity) {
-                pr2serr (ME "sz=%i > buf_capacity=%i\n", size, buf_capacity);
-                ret = SG_LIB_CAT_OTHER;
+        if (do_quick)
                 goto err_out;
-        }
 
-        cmpbuf = (uint8_t *)sg_memalign(size, 0, &free_cmpbuf, false);
-        for (k = 0; k < times; ++k) {
-                ret = write_buffer (sg_fd, size);
-                if (ret) {
-                        goto err_out;
+        if (soak_secs >= 0) {
+                soak_end = time(NULL) + soak_secs;
+                memset(&sa, 0, sizeof(sa));
+                sa.sa_handler = soak_sigint;
+                sa.sa_flags = SA_RESETHAND;     /* a second one kills */
+                sigemptyset(&sa.sa_mask);
+                sigaction(SIGINT, &sa, NULL);
+        }
+        if (1 == num_devs)
+                run_device(devs);
+        else {
+                for (j = 0; j < num_devs; ++j) {
+                        res = pthread_create(&devs[j].tid, NULL, run_device,
+                                             devs + j);
+                        if (res) {
+                                pr2serr(ME "pthread_create: %s\n",
+                                        safe_strerror(res));
+                                devs[j].first_err = SG_LIB_CAT_OTHER;
+                                soak_stop = 1;
+                                times = -1;     /* others stop after one */
+                                break;
+                        }
                 }
-                ret = read_buffer (sg_fd, size);
-                if (ret) {
-                        if (2222 == ret)
-                                ret = SG_LIB_CAT_MALFORMED;
-                        goto err_out;
+                for (j = 0; j < num_devs; ++j) {
+                        if (devs[j].tid)
+                                pthread_join(devs[j].tid, NULL);
+                }
+        }
+        for (j = 0, num_bad = 0; j < num_devs; ++j) {
+                dp = devs + j;
+                if (dp->first_err) {
+                        ++num_bad;
+                        if (0 == ret)
+                                ret = dp->first_err;
                 }
+                if ((soak_secs >= 0) || (num_devs > 1))
+                        printf ("%s%" PRId64 " good cycles (%.1f MB written "
+                                "and read back), %" PRId64 " command errors, "
+                                "%" PRId64 " miscompares\n",
+                                (num_devs > 1) ? dp->pfx : "", dp->cycles,
+                                (2.0 * size * dp->cycles) / 1000000.0,
+                                dp->cmd_errs, dp->miscompares);
+                else if (dp->first_err && (times > 1))
+                        printf ("Failed after %d successful cycles\n",
+                                (int)dp->cycles);
         }
+        if (num_bad && (num_devs > 1))
+                printf ("Failed on %d of %d devices\n", num_bad, num_devs);
 
 err_out:
-        if (free_cmpbuf)
-                free(free_cmpbuf);
-        res = close(sg_fd);
-        if (res < 0) {
-                perror(ME "close error");
-                if (0 == ret)
-                        ret = sg_convert_errno(errno);
+        for (j = 0; j < num_devs; ++j) {
+                dp = devs + j;
+                if (dp->free_wbuf)
+                        free(dp->free_wbuf);
+                if (dp->free_rbuf)
+                        free(dp->free_rbuf);
+                if (dp->sg_fd < 0)
+                        continue;
+                res = close(dp->sg_fd);
+                if (res < 0) {
+                        perror(ME "close error");
+                        if (0 == ret)
+                                ret = sg_convert_errno(errno);
+                }
         }
+        free(devs);
         if ((0 == ret) && (! do_quick))
                 printf ("Success\n");
-        else if (times > 1)
-                printf ("Failed after %d successful cycles\n", k);
         return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015-2019 Douglas Gilbert.
+ * Copyright (c) 2015-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <getopt.h>
+#include <errno.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -23,6 +24,16 @@
 #include "config.h"
 #endif
 
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_REALTIME)
+#include <time.h>
+#elif defined(HAVE_GETTIMEOFDAY)
+#include <time.h>
+#include <sys/time.h>
+#else
+#include <time.h>
+#endif
+#include <pthread.h>
+
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_pt.h"
@@ -35,9 +46,12 @@
  *
  * This program issues a SCSI REPORT TIMESTAMP and SET TIMESTAMP commands
  * to the given SCSI device. Based on spc5r07.pdf .
+ *
+ * Given several DEVICEs (or --now or --skew=MS) it sets and/or reports
+ * their timestamps concurrently, comparing each with the host's clock.
  */
 
-static const char * version_str = "1.13 20180113";
+static const char * version_str = "1.14 20261014";
 
 #define REP_TIMESTAMP_CMDLEN 12
 #define SET_TIMESTAMP_CMDLEN 12
@@ -46,6 +60,8 @@ static const char * version_str = "1.13 20180113";
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT  60      /* 60 seconds */
+#define DEF_MAX_JOBS 256
+#define MAX_JOBS 1024
 
 uint8_t d_buff[256];
 
@@ -53,18 +69,48 @@ uint8_t d_buff[256];
 /* uint8_t test[12] = {0, 0xa, 2, 0, 0x1, 0x51, 0x5b, 0xe2, 0xc1, 0x30,
  *                     0, 0}; */
 
+/* A DEVICE whose timestamp is set and/or reported, maybe by a worker
+ * thread, when several DEVICEs are given */
+struct ts_dev_t {
+    const char * dev_name;
+    const char * cmd_name;      /* of the command that failed */
+    bool reported;
+    int res;
+    int origin;                 /* TIMESTAMP ORIGIN field */
+    uint64_t set_ms;            /* value sent by SET TIMESTAMP */
+    uint64_t dev_ms;            /* value from REPORT TIMESTAMP */
+    uint64_t set_lat_ns;
+    uint64_t rep_lat_ns;
+    int64_t skew_us;            /* dev_ms less host time mid command */
+};
+
+struct ts_coll_t {
+    bool readonly;
+    bool do_set;
+    bool now;                   /* set to host time when issued */
+    bool do_rep;
+    int verbose;
+    int num_devs;
+    int next_ind;
+    uint64_t set_ms;            /* when do_set and not now */
+    struct ts_dev_t * arr;
+};
+
 
 static struct option long_options[] = {
         {"elapsed", no_argument, 0, 'e'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
+        {"jobs", required_argument, 0, 'j'},
         {"milliseconds", required_argument, 0, 'm'},
         {"no_timestamp", no_argument, 0, 'N'},
         {"no-timestamp", no_argument, 0, 'N'},
+        {"now", no_argument, 0, 'n'},
         {"origin", no_argument, 0, 'o'},
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
         {"seconds", required_argument, 0, 's'},
+        {"skew", required_argument, 0, 'k'},
         {"srep", no_argument, 0, 'S'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -91,12 +137,13 @@ usage(int num)
         goto page2;
 
     pr2serr("Usage: "
-            "sg_timestamp  [--elapsed] [--help] [--hex] [--milliseconds=MS]\n"
-            "                     [--no-timestamp] [--origin] [--raw] "
-            "[--readonly]\n"
-            "                     [--seconds=SECS] [--srep] [--verbose] "
-            "[--version]\n"
-            "                     DEVICE\n"
+            "sg_timestamp  [--elapsed] [--help] [--hex] [--jobs=J]\n"
+            "                     [--milliseconds=MS] [--no-timestamp] "
+            "[--now] [--origin]\n"
+            "                     [--raw] [--readonly] [--seconds=SECS] "
+            "[--skew=MS] [--srep]\n"
+            "                     [--verbose] [--version] DEVICE "
+            "[DEVICE...]\n"
            );
     pr2serr("  where:\n"
             "    --elapsed|-e       show time as '<n> days hh:mm:ss.xxx' "
@@ -108,10 +155,15 @@ usage(int num)
             "    --help|-h          print out usage message, use twice for "
             "examples\n"
             "    --hex|-H           output response in ASCII hexadecimal\n"
+            "    --jobs=J|-j J      DEVICEs worked on concurrently (def: "
+            "all, up to %d)\n"
             "    --milliseconds=MS|-m MS    set timestamp to MS "
             "milliseconds since\n"
             "                               1970-01-01 00:00:00 UTC\n"
             "    --no-timestamp|-N    suppress output of timestamp\n"
+            "    --now|-n           set timestamp to the host's time as "
+            "each SET\n"
+            "                       TIMESTAMP command is issued\n"
             "    --origin|-o        show Report timestamp origin "
             "(def: don't)\n"
             "                       used twice outputs value of field\n"
@@ -125,19 +177,25 @@ usage(int num)
             "    --seconds=SECS|-s SECS    set timestamp to SECS "
             "seconds since\n"
             "                            1970-01-01 00:00:00 UTC\n"
+            "    --skew=MS|-k MS    report each timestamp (after any set) "
+            "and flag\n"
+            "                       those more than MS milliseconds from "
+            "host time\n"
             "    --srep|-S          output Report timestamp in seconds "
             "(def:\n"
             "                       milliseconds)\n"
             "    --verbose|-v       increase verbosity\n"
-            "    --version|-V       print version string and exit\n\n"
-          );
+            "    --version|-V       print version string and exit\n\n",
+            DEF_MAX_JOBS);
     pr2serr("Performs a SCSI REPORT TIMESTAMP or SET TIMESTAMP command. "
             "The timestamp\nis SET if either the --milliseconds=MS or "
             "--seconds=SECS option is given,\notherwise the existing "
             "timestamp is reported in milliseconds. The\nDEVICE stores "
             "the timestamp as the number of milliseconds since power up\n"
             "(or reset) or since 1970-01-01 00:00:00 UTC which also "
-            "happens to\nbe the time 'epoch'of Unix machines.\n\n"
+            "happens to\nbe the time 'epoch'of Unix machines. With more "
+            "than one DEVICE, or\n--now or --skew=MS, the DEVICEs are done "
+            "concurrently with one line of\noutput each.\n\n"
             "Use '-hh' (the '-h' option twice) for examples.\n"
 #if 0
  "The 'date +%%s' command in "
@@ -184,7 +242,10 @@ page2:
             "That is over 48 years worth of days. Lets try again as a "
             "data-time\nstamp in UTC:\n\n"
             " $ date -u -R --date=@`sg_timestamp -S /dev/sg1`\n"
-            "Tue, 01 May 2018 20:56:38 +0000\n"
+            "Tue, 01 May 2018 20:56:38 +0000\n\n"
+            "Set the clocks of many disks to host time then check they are "
+            "within\n5 milliseconds of it:\n\n"
+            " $ sg_timestamp --now --skew=5 /dev/sg*\n"
            );
 }
 
@@ -309,6 +370,233 @@ dStrRaw(const uint8_t * str, int len)
         printf("%c", str[k]);
 }
 
+/* Writes msecs to b as milliseconds, seconds (if do_srep) or, if elapsed,
+ * as '<n> days hh:mm:ss.xxx'. Returns b. */
+static char *
+ts2str(uint64_t msecs, int elapsed, bool do_srep, char * b, int blen)
+{
+    int n = 0;
+
+    if (elapsed) {
+        int days = (int)(msecs / 1000 / 60 / 60 / 24);
+        int hours = (int)(msecs / 1000 / 60 / 60 % 24);
+        int mins = (int)(msecs / 1000 / 60 % 60);
+        int secs_in_min =(int)( msecs / 1000 % 60);
+        int rem_msecs = (int)(msecs % 1000);
+
+        if ((elapsed > 1) || (days > 0))
+            n = sg_scnpr(b, blen, "%d day%s ", days,
+                         ((1 == days) ? "" : "s"));
+        sg_scnpr(b + n, blen - n, "%02d:%02d:%02d.%03d", hours, mins,
+                 secs_in_min, rem_msecs);
+    } else
+        snprintf(b, blen, "%" PRIu64, do_srep ? (msecs / 1000) : msecs);
+    return b;
+}
+
+/* Microseconds since 1970-01-01 00:00:00 UTC by the host's clock */
+static uint64_t
+host_now_us(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_REALTIME)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_REALTIME, &ts) < 0)
+        return 0;
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0)
+        return 0;
+    return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+#else
+    return (uint64_t)time(NULL) * 1000000;
+#endif
+}
+
+/* Takes DEVICEs, in order, until none are left. Each is set (to the
+ * host's time at that moment if tcp->now) and then, if tcp->do_rep,
+ * reported. The host's time halfway through the REPORT TIMESTAMP is
+ * compared with the timestamp returned. */
+static void *
+ts_worker(void * v_tcp)
+{
+    int k, sg_fd, resid;
+    uint64_t t0, h0;
+    struct ts_coll_t * tcp = (struct ts_coll_t *)v_tcp;
+    struct ts_dev_t * tdp;
+    uint8_t b[12];
+
+    while ((k = __atomic_fetch_add(&tcp->next_ind, 1, __ATOMIC_RELAXED)) <
+           tcp->num_devs) {
+        tdp = tcp->arr + k;
+        sg_fd = sg_cmds_open_device(tdp->dev_name, tcp->readonly,
+                                    tcp->verbose);
+        if (sg_fd < 0) {
+            pr2serr("error opening file: %s: %s\n", tdp->dev_name,
+                    safe_strerror(-sg_fd));
+            tdp->res = sg_convert_errno(-sg_fd);
+            continue;
+        }
+        if (tcp->do_set) {
+            memset(b, 0, sizeof(b));
+            t0 = sg_pt_lat_now_ns();
+            tdp->set_ms = tcp->now ? (host_now_us() / 1000) : tcp->set_ms;
+            sg_put_unaligned_be48(tdp->set_ms, b + 4);
+            tdp->res = sg_ll_set_timestamp(sg_fd, b, sizeof(b), false,
+                                           tcp->verbose);
+            tdp->set_lat_ns = sg_pt_lat_now_ns() - t0;
+            if (tdp->res)
+                tdp->cmd_name = "Set timestamp";
+        }
+        if ((0 == tdp->res) && tcp->do_rep) {
+            memset(b, 0, sizeof(b));
+            h0 = host_now_us();
+            t0 = sg_pt_lat_now_ns();
+            tdp->res = sg_ll_rep_timestamp(sg_fd, b, sizeof(b), &resid,
+                                           false, tcp->verbose);
+            tdp->rep_lat_ns = sg_pt_lat_now_ns() - t0;
+            if (tdp->res)
+                tdp->cmd_name = "Report timestamp";
+            else {
+                if ((sizeof(b) - resid) < 10) {
+                    pr2serr("%s: REPORT TIMESTAMP response too short\n",
+                            tdp->dev_name);
+                    tdp->res = SG_LIB_CAT_MALFORMED;
+                    tdp->cmd_name = "Report timestamp";
+                } else {
+                    tdp->reported = true;
+                    tdp->origin = 0x7 & b[2];
+                    tdp->dev_ms = sg_get_unaligned_be48(b + 4);
+                    tdp->skew_us = (int64_t)(tdp->dev_ms * 1000) -
+                        (int64_t)(h0 + (tdp->rep_lat_ns / 2000));
+                }
+            }
+        }
+        if (tdp->res < 0)
+            tdp->res = SG_LIB_CAT_OTHER;
+        sg_cmds_close_device(sg_fd);
+    }
+    return NULL;
+}
+
+/* Sets and/or reports the timestamps of num_devs DEVICEs, num_thr at a
+ * time, then outputs one line per DEVICE in the order given. A timestamp
+ * that is a date (i.e. its origin is SET TIMESTAMP or other method) is
+ * shown with its skew from the host's clock; if skew_ms is not negative
+ * those out by more than that are flagged. Returns 0 if all is well,
+ * else the error of the first DEVICE that failed, else
+ * SG_LIB_CAT_MISCOMPARE if any DEVICE was beyond skew_ms. */
+static int
+ts_all(struct ts_coll_t * tcp, char ** dev_names, int num_thr,
+       int elapsed, bool do_srep, int64_t skew_ms)
+{
+    bool first = true;
+    int k, err, res, n;
+    int num_fail = 0;
+    int num_beyond = 0;
+    int ret = 0;
+    int64_t lo = 0;
+    int64_t hi = 0;
+    uint64_t t0;
+    struct ts_dev_t * tdp;
+    pthread_t * tids;
+    char b[80];
+    char c[160];
+
+    tcp->arr = (struct ts_dev_t *)calloc(tcp->num_devs, sizeof(*tcp->arr));
+    tids = (pthread_t *)calloc(num_thr, sizeof(pthread_t));
+    if ((NULL == tcp->arr) || (NULL == tids)) {
+        pr2serr("unable to allocate memory for %d devices\n",
+                tcp->num_devs);
+        free(tcp->arr);
+        free(tids);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < tcp->num_devs; ++k)
+        tcp->arr[k].dev_name = dev_names[k];
+    t0 = sg_pt_lat_now_ns();
+    if (tcp->num_devs > 1) {
+        for (k = 0; k < num_thr; ++k) {
+            err = pthread_create(tids + k, NULL, ts_worker, tcp);
+            if (err) {
+                pr2serr("pthread_create: %s, continue with %d threads\n",
+                        safe_strerror(err), k);
+                break;
+            }
+        }
+        num_thr = k;
+    } else
+        num_thr = 0;
+    if (0 == num_thr)
+        ts_worker(tcp);         /* no threads, so do them all here */
+    for (k = 0; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+    t0 = sg_pt_lat_now_ns() - t0;
+
+    for (k = 0; k < tcp->num_devs; ++k) {
+        tdp = tcp->arr + k;
+        res = tdp->res;
+        if (res) {
+            sg_get_category_sense_str(res, sizeof(b), b, tcp->verbose);
+            pr2serr("%s: %s: %s\n", tdp->dev_name,
+                    tdp->cmd_name ? tdp->cmd_name : "open", b);
+            ++num_fail;
+            if (0 == ret)
+                ret = res;
+            continue;
+        }
+        n = sg_scnpr(c, sizeof(c), "%s:", tdp->dev_name);
+        if (tcp->do_set)
+            n += sg_scnpr(c + n, sizeof(c) - n, " set %" PRIu64 " "
+                          "lat_us=%" PRIu64, tdp->set_ms,
+                          tdp->set_lat_ns / 1000);
+        if (tdp->reported) {
+            n += sg_scnpr(c + n, sizeof(c) - n, " %s origin=%d "
+                          "lat_us=%" PRIu64, ts2str(tdp->dev_ms, elapsed,
+                          do_srep, b, sizeof(b)), tdp->origin,
+                          tdp->rep_lat_ns / 1000);
+            if (tdp->origin >= 2) {     /* timestamp is a date */
+                n += sg_scnpr(c + n, sizeof(c) - n, " skew_ms=%+.1f",
+                              (double)tdp->skew_us / 1000.0);
+                if (first || (tdp->skew_us < lo))
+                    lo = tdp->skew_us;
+                if (first || (tdp->skew_us > hi))
+                    hi = tdp->skew_us;
+                first = false;
+                if ((skew_ms >= 0) &&
+                    ((tdp->skew_us > (skew_ms * 1000)) ||
+                     (tdp->skew_us < -(skew_ms * 1000)))) {
+                    sg_scnpr(c + n, sizeof(c) - n, " SKEW");
+                    ++num_beyond;
+                }
+            } else if (skew_ms >= 0) {
+                sg_scnpr(c + n, sizeof(c) - n, " [not a date]");
+                ++num_beyond;
+            }
+        }
+        printf("%s\n", c);
+    }
+    n = sg_scnpr(c, sizeof(c), "%d DEVICE%s in %.1f ms", tcp->num_devs,
+                 (1 == tcp->num_devs) ? "" : "s", (double)t0 / 1000000.0);
+    if (num_fail)
+        n += sg_scnpr(c + n, sizeof(c) - n, ", %d failed", num_fail);
+    if (! first)
+        n += sg_scnpr(c + n, sizeof(c) - n, ", skew %+.1f to %+.1f ms",
+                      (double)lo / 1000.0, (double)hi / 1000.0);
+    if (skew_ms >= 0)
+        sg_scnpr(c + n, sizeof(c) - n, ", %d beyond %" PRId64 " ms",
+                 num_beyond, skew_ms);
+    if ((tcp->num_devs > 1) || tcp->verbose)
+        pr2serr("%s\n", c);
+    free(tcp->arr);
+    free(tids);
+    if ((0 == ret) && num_beyond)
+        ret = SG_LIB_CAT_MISCOMPARE;
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -317,10 +605,12 @@ main(int argc, char * argv[])
     bool do_raw = false;
     bool no_timestamp = false;
     bool readonly = false;
+    bool now = false;
     bool secs_given = false;
     bool verbose_given = false;
     bool version_given = false;
-    int res, c;
+    int res, c, num_devs;
+    int num_jobs = 0;
     int sg_fd = 1;
     int elapsed = 0;
     int do_origin = 0;
@@ -332,13 +622,15 @@ main(int argc, char * argv[])
     uint64_t secs = 0;
     uint64_t msecs = 0;
     int64_t ll;
+    int64_t skew_ms = -1;
     const char * device_name = NULL;
     const char * cmd_name;
+    struct ts_coll_t coll;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "ehHm:NorRs:SvV", long_options,
+        c = getopt_long(argc, argv, "ehHj:k:m:nNorRs:SvV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -354,6 +646,21 @@ main(int argc, char * argv[])
         case 'H':
             ++do_hex;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs=' should be from 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'k':
+            skew_ms = sg_get_llnum(optarg);
+            if (skew_ms < 0) {
+                pr2serr("bad argument to '--skew=MS'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'm':
             ll = sg_get_llnum(optarg);
             if (-1 == ll) {
@@ -363,6 +670,10 @@ main(int argc, char * argv[])
             msecs = (uint64_t)ll;
             ++do_set;
             break;
+        case 'n':
+            now = true;
+            ++do_set;
+            break;
         case 'N':
             no_timestamp = true;
             break;
@@ -401,18 +712,9 @@ main(int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
-    if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage(1);
-            return SG_LIB_SYNTAX_ERROR;
-        }
-    }
+    num_devs = argc - optind;
+    if (num_devs > 0)
+        device_name = argv[optind];
     if (do_help) {
         usage(do_help);
         return 0;
@@ -440,8 +742,8 @@ main(int argc, char * argv[])
     }
 
     if (do_set > 1) {
-        pr2serr("either --milliseconds=MS or --seconds=SECS may be given, "
-                "not both\n");
+        pr2serr("only one of --milliseconds=MS, --now and --seconds=SECS "
+                "may be given\n");
         usage(1);
         return SG_LIB_CONTRADICT;
     }
@@ -451,6 +753,29 @@ main(int argc, char * argv[])
         usage(1);
         return SG_LIB_SYNTAX_ERROR;
     }
+    if ((num_devs > 1) || now || (skew_ms >= 0) || num_jobs) {
+        if (do_raw || do_hex || no_timestamp) {
+            pr2serr("--raw, --hex and --no-timestamp are for a single "
+                    "DEVICE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        memset(&coll, 0, sizeof(coll));
+        coll.readonly = readonly;
+        coll.do_set = !! do_set;
+        coll.now = now;
+        coll.do_rep = (! do_set) || (skew_ms >= 0);
+        coll.verbose = verbose;
+        coll.num_devs = num_devs;
+        coll.set_ms = secs_given ? (secs * 1000) : msecs;
+        if (0 == num_jobs)
+            num_jobs = (num_devs < DEF_MAX_JOBS) ? num_devs : DEF_MAX_JOBS;
+        else if (num_jobs > num_devs)
+            num_jobs = num_devs;
+        ret = ts_all(&coll, argv + optind, num_jobs, elapsed, do_srep,
+                     skew_ms);
+        sg_fd = -1;
+        goto fini;
+    }
 
     sg_fd = sg_cmds_open_device(device_name, readonly, verbose);
     if (sg_fd < 0) {
@@ -491,22 +816,11 @@ main(int argc, char * argv[])
                             printf("TIMESTAMP_ORIGIN=%d\n", 0x7 & d_buff[2]);
                     }
                     if (! no_timestamp) {
+                        char b[80];
+
                         msecs = sg_get_unaligned_be48(d_buff + 4);
-                        if (elapsed) {
-                            int days = (int)(msecs / 1000 / 60 / 60 / 24);
-                            int hours = (int)(msecs / 1000 / 60 / 60 % 24);
-                            int mins = (int)(msecs / 1000 / 60 % 60);
-                            int secs_in_min =(int)( msecs / 1000 % 60);
-                            int rem_msecs = (int)(msecs % 1000);
-
-                            if ((elapsed > 1) || (days > 0))
-                                printf("%d day%s ", days,
-                                       ((1 == days) ? "" : "s"));
-                            printf("%02d:%02d:%02d.%03d\n", hours, mins,
-                                   secs_in_min, rem_msecs);
-                        } else
-                            printf("%" PRIu64 "\n", do_srep ?
-                                                    (msecs / 1000) : msecs);
+                        printf("%s\n", ts2str(msecs, elapsed, do_srep, b,
+                                              sizeof(b)));
                     }
                 }
             }
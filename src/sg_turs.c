@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2000-2019 D. Gilbert
+ * Copyright (C) 2000-2026 D. Gilbert
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2, or (at your option)
@@ -12,7 +12,9 @@
  * This program sends a user specified number of TEST UNIT READY ("tur")
  * commands to the given sg device. Since TUR is a simple command involing
  * no data transfer (and no REQUEST SENSE command iff the unit is ready)
- * then this can be used for timing per SCSI command overheads.
+ * then this can be used for timing per SCSI command overheads. With
+ * several threads and/or a queue depth above 1 it floods the device with
+ * TURs and reports the latency distribution (e.g. its tail).
  */
 
 #include <unistd.h>
@@ -21,9 +23,13 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -42,7 +48,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "3.46 20190618";
+static const char * version_str = "3.47 20261014";
 
 #if defined(MSC_VER) || defined(__MINGW32__)
 #define HAVE_MS_SLEEP
@@ -56,10 +62,16 @@ static const char * version_str = "3.46 20190618";
 #endif
 
 #define DEF_PT_TIMEOUT  60       /* 60 seconds */
+#define MAX_QD 16               /* commands a sg v3 file descriptor queues */
+#define MAX_THREADS 64
+#define TUR_OPCODE 0
 
 
 static struct option long_options[] = {
+        {"deadline", required_argument, 0, 'D'},
         {"help", no_argument, 0, 'h'},
+        {"hipri", no_argument, 0, 'H'},
+        {"hist", no_argument, 0, 'g'},
         {"low", no_argument, 0, 'l'},
         {"new", no_argument, 0, 'N'},
         {"number", required_argument, 0, 'n'},
@@ -67,6 +79,8 @@ static struct option long_options[] = {
                                 * v1.43) for sg_requests compatibility */
         {"old", no_argument, 0, 'O'},
         {"progress", no_argument, 0, 'p'},
+        {"qd", required_argument, 0, 'Q'},
+        {"threads", required_argument, 0, 'T'},
         {"time", no_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -74,14 +88,19 @@ static struct option long_options[] = {
 };
 
 struct opts_t {
+    bool do_hipri;
+    bool do_hist;
     bool do_low;
     bool do_progress;
     bool do_time;
     bool opts_new;
     bool verbose_given;
     bool version_given;
+    int deadline_ms;
     int do_help;
     int do_number;
+    int num_thr;
+    int qd;
     int verbose;
     const char * device_name;
 };
@@ -92,15 +111,42 @@ struct loop_res_t {
     int ret;
 };
 
+/* Shared by the threads of a TUR flood */
+struct flood_coll_t {
+    bool stop;          /* set after an OS or transport error */
+    int next_cmd;       /* claimed by threads with __atomic_fetch_add() */
+    int sg_fd;          /* main's, used by the first thread */
+    struct opts_t * op;
+    struct loop_res_t * resp;
+};
+
+struct flood_thr_t {
+    int id;             /* 0 for the first thread */
+    int num_done;
+    pthread_t tid;
+    struct flood_coll_t * fcp;
+};
+
 
 static void
 usage()
 {
-    printf("Usage: sg_turs [--help] [--low] [--number=NUM] [--num=NUM] "
-           "[--progress]\n"
-           "               [--time] [--verbose] [--version] DEVICE\n"
+    printf("Usage: sg_turs [--deadline=MS] [--help] [--hipri] [--hist] "
+           "[--low]\n"
+           "               [--number=NUM] [--num=NUM] [--progress] "
+           "[--qd=QD]\n"
+           "               [--threads=THR] [--time] [--verbose] "
+           "[--version] DEVICE\n"
            "  where:\n"
+           "    --deadline=MS|-D MS    give up after MS milliseconds, "
+           "aborting a TUR\n"
+           "                           still in flight (def: 0 -> no "
+           "deadline)\n"
            "    --help|-h        print usage message then exit\n"
+           "    --hipri|-H       request polled completion (implies "
+           "--low)\n"
+           "    --hist|-g        output latency percentiles and "
+           "histogram\n"
            "    --low|-l         use low level (sg_pt) interface for "
            "speed\n"
            "    --number=NUM|-n NUM    number of test_unit_ready commands "
@@ -109,11 +155,19 @@ usage()
            "    --old|-O         use old interface (use as first option)\n"
            "    --progress|-p    outputs progress indication (percentage) "
            "if available\n"
+           "    --qd=QD|-Q QD    queue depth, TURs in flight per thread "
+           "(def: 1,\n"
+           "                     max: %d)\n"
+           "    --threads=THR|-T THR    number of threads, each with its "
+           "own file\n"
+           "                            descriptor (def: 1, max: %d)\n"
            "    --time|-t        outputs total duration and commands per "
            "second\n"
            "    --verbose|-v     increase verbosity\n"
            "    --version|-V     print version string then exit\n\n"
-           "Performs a SCSI TEST UNIT READY command (or many of them).\n");
+           "Performs a SCSI TEST UNIT READY command (or many of them). With "
+           "THR or QD\ngreater than 1, NUM TURs are sent concurrently and "
+           "latency percentiles\nare output.\n", MAX_QD, MAX_THREADS);
 }
 
 static void
@@ -152,16 +206,31 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hln:NOptvV", long_options,
+        c = getopt_long(argc, argv, "D:ghHln:NOpQ:tT:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'D':
+            n = sg_get_num(optarg);
+            if (n < 0) {
+                pr2serr("bad argument to '--deadline='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->deadline_ms = n;
+            break;
         case 'h':
         case '?':
             ++op->do_help;
             break;
+        case 'g':
+            op->do_hist = true;
+            break;
+        case 'H':
+            op->do_hipri = true;
+            op->do_low = true;
+            break;
         case 'l':
             op->do_low = true;
             break;
@@ -182,9 +251,27 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'p':
             op->do_progress = true;
             break;
+        case 'Q':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_QD)) {
+                pr2serr("bad argument to '--qd=', expect 1 to %d\n",
+                        MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->qd = n;
+            break;
         case 't':
             op->do_time = true;
             break;
+        case 'T':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_THREADS)) {
+                pr2serr("bad argument to '--threads=', expect 1 to %d\n",
+                        MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_thr = n;
+            break;
         case 'v':
             op->verbose_given = true;
             ++op->verbose;
@@ -325,13 +412,21 @@ loop_turs(struct sg_pt_base * ptvp, struct loop_res_t * resp,
         uint8_t cdb[6];
         uint8_t sense_b[32];
 
+        memset(cdb, 0, sizeof(cdb));    /* TUR's cdb is 6 zeros */
+        set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+        if (op->do_hipri)
+            set_scsi_pt_flags(ptvp, SCSI_PT_FLAGS_HIPRI);
         for (k = 0; k < op->do_number; ++k) {
             /* Might get Unit Attention on first invocation */
-            memset(cdb, 0, sizeof(cdb));    /* TUR's cdb is 6 zeros */
             set_scsi_pt_cdb(ptvp, cdb, sizeof(cdb));
-            set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
             set_scsi_pt_packet_id(ptvp, ++packet_id);
-            rs = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, vb);
+            if (op->do_hipri) {     /* receive polls for the completion */
+                rs = do_scsi_pt_submit(ptvp, -1, DEF_PT_TIMEOUT, vb);
+                if (0 == rs)
+                    rs = do_scsi_pt_receive(ptvp, false, vb);
+            } else
+                rs = sg_cmds_do_pt(ptvp, cdb, sizeof(cdb), -1,
+                                   DEF_PT_TIMEOUT, vb);
             n = sg_cmds_process_resp(ptvp, "Test unit ready", rs, (0 == k),
                                      vb, &sense_cat);
             if (-1 == n) {
@@ -369,7 +464,7 @@ loop_turs(struct sg_pt_base * ptvp, struct loop_res_t * resp,
                     break;
                 }
             }
-            clear_scsi_pt_obj(ptvp);
+            rearm_scsi_pt_obj(ptvp);  /* keeps sense buffer binding */
         }
         return k;
     } else {
@@ -395,11 +490,229 @@ loop_turs(struct sg_pt_base * ptvp, struct loop_res_t * resp,
     }
 }
 
+/* Returns true when the next TUR of the flood may be sent */
+static bool
+flood_claim(struct flood_coll_t * fcp)
+{
+    if (__atomic_load_n(&fcp->stop, __ATOMIC_RELAXED))
+        return false;
+    return __atomic_fetch_add(&fcp->next_cmd, 1, __ATOMIC_RELAXED) <
+           fcp->op->do_number;
+}
+
+/* Checks the outcome of one flood TUR. Returns true if the flood should
+ * stop, which is after an OS or transport error; sense data (e.g. not
+ * ready) is only counted. */
+static bool
+flood_check(struct flood_coll_t * fcp, struct sg_pt_base * ptvp, int rs,
+            bool noisy)
+{
+    int n, err, ret, expect;
+    int sense_cat = 0;
+    int vb = fcp->op->verbose;
+
+    n = sg_cmds_process_resp(ptvp, "Test unit ready", rs, noisy, vb,
+                             &sense_cat);
+    if (-1 == n) {
+        err = get_scsi_pt_os_err(ptvp);
+        ret = err ? sg_convert_errno(err) : SG_LIB_CAT_OTHER;
+        expect = 0;
+        __atomic_compare_exchange_n(&fcp->resp->ret, &expect, ret, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&fcp->resp->num_errs, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&fcp->stop, true, __ATOMIC_RELAXED);
+        return true;
+    } else if (-2 == n) {
+        switch (sense_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            break;
+        case SG_LIB_CAT_UNIT_ATTENTION:
+            if (vb)
+                pr2serr("Ignoring Unit attention (sense key)\n");
+#if defined(__GNUC__)
+#if (__GNUC__ >= 7)
+            __attribute__((fallthrough));
+            /* FALL THROUGH */
+#endif
+#endif
+        default:
+            __atomic_add_fetch(&fcp->resp->num_errs, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    return false;
+}
+
+/* Records the first error of the flood (as an exit status) and stops it */
+static void
+flood_set_ret(struct flood_coll_t * fcp, int ret)
+{
+    int expect = 0;
+
+    __atomic_compare_exchange_n(&fcp->resp->ret, &expect, ret, false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    __atomic_store_n(&fcp->stop, true, __ATOMIC_RELAXED);
+}
+
+/* Submits one flood TUR on ptvp. Returns 0 if it is in flight. */
+static int
+flood_submit(struct flood_coll_t * fcp, struct sg_pt_base * ptvp,
+             uint8_t * cdbp, int pack_id)
+{
+    int rs;
+
+    set_scsi_pt_cdb(ptvp, cdbp, 6);
+    set_scsi_pt_packet_id(ptvp, pack_id);
+    if (fcp->op->do_hipri)
+        set_scsi_pt_flags(ptvp, SCSI_PT_FLAGS_HIPRI);
+    rs = do_scsi_pt_submit(ptvp, -1, DEF_PT_TIMEOUT, fcp->op->verbose);
+    if (rs)
+        flood_check(fcp, ptvp, rs, true);
+    return rs;
+}
+
+/* Each flood thread has its own file descriptor with up to QD TURs in
+ * flight on it, each in its own pt object. Completions are reaped in
+ * submission order and each slot is refilled while TURs remain. */
+static void *
+flood_thread(void * v_ftp)
+{
+    bool noisy;
+    int k, rs, fd;
+    int inflight = 0;
+    int pack_id = 0;
+    struct flood_thr_t * ftp = (struct flood_thr_t *)v_ftp;
+    struct flood_coll_t * fcp = ftp->fcp;
+    struct opts_t * op = fcp->op;
+    int vb = op->verbose;
+    int qd = op->qd;
+    bool busy[MAX_QD];
+    struct sg_pt_base * ptv_arr[MAX_QD];
+    uint8_t cdb_arr[MAX_QD][6];
+    uint8_t sense_arr[MAX_QD][32];
+
+    memset(ptv_arr, 0, sizeof(ptv_arr));
+    memset(busy, 0, sizeof(busy));
+    memset(cdb_arr, 0, sizeof(cdb_arr));   /* TUR's cdb is 6 zeros */
+    if (0 == ftp->id)
+        fd = fcp->sg_fd;
+    else {
+        fd = sg_cmds_open_device(op->device_name, true /* ro */, vb);
+        if (fd < 0) {
+            pr2serr("thread %d: error opening file: %s: %s\n", ftp->id,
+                    op->device_name, safe_strerror(-fd));
+            flood_set_ret(fcp, sg_convert_errno(-fd));
+            return NULL;
+        }
+    }
+    for (k = 0; k < qd; ++k) {
+        ptv_arr[k] = construct_scsi_pt_obj_with_fd(fd, vb);
+        if ((NULL == ptv_arr[k]) || get_scsi_pt_os_err(ptv_arr[k])) {
+            pr2serr("thread %d: unable to construct pt object\n", ftp->id);
+            flood_set_ret(fcp, sg_convert_errno(ENOMEM));
+            goto fini;
+        }
+        set_scsi_pt_sense(ptv_arr[k], sense_arr[k], sizeof(sense_arr[k]));
+    }
+    for (k = 0; (k < qd) && flood_claim(fcp); ++k) {
+        if (flood_submit(fcp, ptv_arr[k], cdb_arr[k], ++pack_id))
+            break;
+        busy[k] = true;
+        ++inflight;
+    }
+    for (k = 0; inflight > 0; k = (k + 1) % qd) {
+        if (! busy[k])
+            continue;
+        rs = do_scsi_pt_receive(ptv_arr[k], false, vb);
+        busy[k] = false;
+        --inflight;
+        noisy = (0 == ftp->id) && (0 == ftp->num_done);
+        flood_check(fcp, ptv_arr[k], rs, noisy);
+        ++ftp->num_done;
+        rearm_scsi_pt_obj(ptv_arr[k]);  /* keeps sense buffer binding */
+        if (flood_claim(fcp) &&
+            (0 == flood_submit(fcp, ptv_arr[k], cdb_arr[k], ++pack_id))) {
+            busy[k] = true;
+            ++inflight;
+        }
+    }
+fini:
+    for (k = 0; k < qd; ++k) {
+        if (ptv_arr[k])
+            destruct_scsi_pt_obj(ptv_arr[k]);
+    }
+    if (ftp->id > 0)
+        sg_cmds_close_device(fd);
+    return NULL;
+}
+
+/* Sends NUM TURs from THR threads, each keeping QD of them in flight.
+ * Returns the number of TURs completed. */
+static int
+flood_turs(int sg_fd, struct loop_res_t * resp, struct opts_t * op)
+{
+    int k, res;
+    int num_done = 0;
+    struct flood_coll_t fc;
+    struct flood_thr_t * thr_arr;
+
+    memset(&fc, 0, sizeof(fc));
+    fc.sg_fd = sg_fd;
+    fc.op = op;
+    fc.resp = resp;
+    thr_arr = (struct flood_thr_t *)calloc(op->num_thr, sizeof(*thr_arr));
+    if (NULL == thr_arr) {
+        pr2serr("%s: out of memory\n", __func__);
+        resp->ret = sg_convert_errno(ENOMEM);
+        return 0;
+    }
+    for (k = 0; k < op->num_thr; ++k) {
+        thr_arr[k].id = k;
+        thr_arr[k].fcp = &fc;
+        res = pthread_create(&thr_arr[k].tid, NULL, flood_thread,
+                             thr_arr + k);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            flood_set_ret(&fc, sg_convert_errno(res));
+            break;
+        }
+    }
+    op->num_thr = k;    /* those started */
+    for (k = 0; k < op->num_thr; ++k) {
+        pthread_join(thr_arr[k].tid, NULL);
+        num_done += thr_arr[k].num_done;
+    }
+    free(thr_arr);
+    return num_done;
+}
+
+/* Outputs the percentiles of the TURs' latencies, across all file
+ * descriptors, and with --hist their histogram. */
+static void
+lat_output(const struct opts_t * op)
+{
+    struct sg_pt_lat_summary ls;
+    char b[8192];
+
+    if (sg_pt_lat_get(-1, TUR_OPCODE, &ls)) {
+        if (op->verbose)
+            pr2serr("No latencies recorded\n");
+        return;
+    }
+    printf("Latency of %" PRIu64 " TURs (microseconds): min=%.1f p50=%.1f "
+           "p99=%.1f\n    p99.9=%.1f max=%.1f mean=%.1f\n", ls.count,
+           ls.min_ns / 1000.0, ls.p50_ns / 1000.0, ls.p99_ns / 1000.0,
+           ls.p999_ns / 1000.0, ls.max_ns / 1000.0, ls.mean_ns / 1000.0);
+    if (op->do_hist && (sg_pt_lat_hist_str(-1, TUR_OPCODE, sizeof(b), b) > 0))
+        printf("%s", b);
+}
 
 int
 main(int argc, char * argv[])
 {
     bool start_tm_valid = false;
+    bool flood, lat_env;
     int k, res, progress, pr, rem, num_done;
     int err = 0;
     int ret = 0;
@@ -420,6 +733,8 @@ main(int argc, char * argv[])
     memset(op, 0, sizeof(opts));
     memset(resp, 0, sizeof(loop_res));
     op->do_number = 1;
+    op->num_thr = 1;
+    op->qd = 1;
     res = parse_cmd_line(op, argc, argv);
     if (res)
         return res;
@@ -453,6 +768,20 @@ main(int argc, char * argv[])
         usage_for(op);
         return SG_LIB_SYNTAX_ERROR;
     }
+    flood = (op->num_thr > 1) || (op->qd > 1);
+    if (flood && op->do_progress) {
+        pr2serr("--progress contradicts --threads= and --qd=\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (flood && op->deadline_ms) {
+        pr2serr("--deadline= contradicts --threads= and --qd=\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (op->deadline_ms)
+        sg_cmds_deadline_set(op->deadline_ms);
+    lat_env = sg_pt_lat_is_enabled();
+    if (flood || op->do_hist)
+        sg_pt_lat_enable(true);
 
     if ((sg_fd = sg_cmds_open_device(op->device_name, true /* ro */,
                                      op->verbose)) < 0) {
@@ -507,7 +836,10 @@ main(int argc, char * argv[])
         start_tm_valid = false;
 #endif
 
-        num_done = loop_turs(ptvp, resp, op);
+        if (flood)
+            num_done = flood_turs(sg_fd, resp, op);
+        else
+            num_done = loop_turs(ptvp, resp, op);
 
         if (op->do_time && start_tm_valid) {
 #if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
@@ -543,12 +875,29 @@ main(int argc, char * argv[])
             } else
                 printf("Recorded 0 or less elapsed microseconds ??\n");
         }
-        if (((op->do_number > 1) || (resp->num_errs > 0)) &&
-            (! resp->reported))
+        if (lat_env) {
+            char b[1024];
+
+            sg_pt_lat_report(sizeof(b), b);
+            printf("%s", b);
+        }
+        if (flood || op->do_hist)
+            lat_output(op);
+        if (flood)
+            printf("Completed %d Test Unit Ready commands with %d errors "
+                   "using %d threads, queue depth %d\n", num_done,
+                   resp->num_errs, op->num_thr, op->qd);
+        else if (((op->do_number > 1) || (resp->num_errs > 0)) &&
+                 (! resp->reported))
             printf("Completed %d Test Unit Ready commands with %d errors\n",
                    op->do_number, resp->num_errs);
-        if (1 == op->do_number)
+        if ((1 == op->do_number) || flood)
             ret = resp->ret;
+        if (op->deadline_ms && (0 == sg_cmds_deadline_left_ms()) &&
+            ((num_done < op->do_number) || resp->num_errs)) {
+            pr2serr("deadline of %d ms passed\n", op->deadline_ms);
+            ret = SG_LIB_CAT_TIMEOUT;
+        }
     }
 fini:
     if (ptvp)
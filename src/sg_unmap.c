@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2018 Douglas Gilbert.
+ * Copyright (c) 2009-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,7 +14,9 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <ctype.h>
+#include <time.h>
 #include <getopt.h>
 #include <limits.h>
 #define __STDC_FORMAT_MACROS 1
@@ -23,6 +25,13 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
+#if (! defined(HAVE_CLOCK_GETTIME)) && defined(HAVE_GETTIMEOFDAY)
+#include <sys/time.h>
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
@@ -46,13 +55,14 @@
  * logical blocks. Note that DATA MAY BE LOST.
  */
 
-static const char * version_str = "1.17 20180628";
+static const char * version_str = "1.19 20261014";
 
 
 #define DEF_TIMEOUT_SECS 60
-#define MAX_NUM_ADDR 128
-#define RCAP10_RESP_LEN 8
-#define RCAP16_RESP_LEN 32
+#define DEF_PLAN_LBAS 65536     /* per UNMAP without Block Limits or RN */
+#define MAX_PLAN_DESCS 4095     /* parameter list length is 16 bits */
+#define DEF_JOBS 4              /* UNMAP commands in flight with --plan */
+#define MAX_JOBS 256
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -68,8 +78,11 @@ static struct option long_options[] = {
         {"grpnum", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"in", required_argument, 0, 'I'},
+        {"jobs", required_argument, 0, 'j'},
         {"lba", required_argument, 0, 'l'},
         {"num", required_argument, 0, 'n'},
+        {"plan", no_argument, 0, 'P'},
+        {"rate", required_argument, 0, 'r'},
         {"timeout", required_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -83,10 +96,10 @@ usage()
     pr2serr("Usage: "
           "sg_unmap [--all=ST,RN[,LA]] [--anchor] [--dry-run] [--force]\n"
           "                [--grpnum=GN] [--help] [--in=FILE] "
-          "[--lba=LBA,LBA...]\n"
-          "                [--num=NUM,NUM...] [--timeout=TO] [--verbose] "
-          "[--version]\n"
-          "                DEVICE\n"
+          "[--jobs=JOBS]\n"
+          "                [--lba=LBA,LBA...] [--num=NUM,NUM...] [--plan] "
+          "[--rate=BPS]\n"
+          "                [--timeout=TO] [--verbose] [--version] DEVICE\n"
           "  where:\n"
           "    --all=ST,RN[,LA]|-A ST,RN[,LA]    start unmaps at LBA ST, "
           "RN blocks\n"
@@ -102,6 +115,9 @@ usage()
           "    --in=FILE|-I FILE    read LBA, NUM pairs from FILE (if "
           "FILE is '-'\n"
           "                         then stdin is read)\n"
+          "    --jobs=JOBS|-j JOBS    with --plan, UNMAP commands in flight "
+          "at once\n"
+          "                           (def: 4)\n"
           "    --lba=LBA,LBA...|-l LBA,LBA...    LBA is the logical block "
           "address\n"
           "                                      to start NUM unmaps\n"
@@ -109,6 +125,14 @@ usage()
           "blocks to\n"
           "                                      unmap starting at "
           "corresponding LBA\n"
+          "    --plan|-P            merge, align and split ranges to the "
+          "Block Limits\n"
+          "                         VPD page, many block descriptors per "
+          "UNMAP; --in=\n"
+          "                         then has no limit, --all=ST,0 means "
+          "largest RN\n"
+          "    --rate=BPS|-r BPS    with --plan, unmap at most BPS blocks "
+          "per second\n"
           "    --timeout=TO|-t TO    command timeout (unit: seconds) "
           "(def: 60)\n"
           "    --verbose|-v         increase verbosity\n"
@@ -120,257 +144,485 @@ usage()
           "    sg_unmap --lba=0x12345 --num=1 /dev/sdb\n"
           "Example to unmap starting at LBA 0x12345, 256 blocks per command:"
           "\n    sg_unmap --all=0x12345,256 /dev/sg2\n"
-          "until the end if /dev/sg2 (assumed to be a storage device)\n\n"
+          "until the end if /dev/sg2 (assumed to be a storage device)\n"
+          "Example to unmap all of /dev/sg2, 8 UNMAP commands at a time:\n"
+          "    sg_unmap --plan --all=0,0 --jobs=8 /dev/sg2\n\n"
           );
     pr2serr("WARNING: This utility will destroy data on DEVICE in the given "
             "range(s)\nthat will be unmapped. Unmap is also known as 'trim' "
             "and is irreversible.\n");
 }
 
-/* Read numbers (up to 64 bits in size) from command line (comma (or
- * (single) space) separated list). Assumed decimal unless prefixed
- * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or 1 if error. */
+/* The UNMAP commands of a --plan and the progress through them, shared by
+ * the threads issuing them */
+struct um_plan {
+    bool anchor;
+    bool stop;                  /* set by first failed UNMAP */
+    int grpnum;
+    int timeout;
+    int vb;
+    int sg_fd;
+    struct sg_dev_sess * dsp;   /* of sg_fd */
+    int ret;                    /* of first failed UNMAP */
+    int num_cmds;               /* UNMAP commands completed */
+    uint32_t max_lbas;          /* in one UNMAP command */
+    uint32_t max_descs;         /* block descriptors in one UNMAP command */
+    uint32_t gran;              /* unmap granularity, 1 if not given */
+    uint32_t gran_align;        /* LBA of first granule (modulo gran) */
+    struct sg_lba_set rset;     /* ranges, plan_normalize() merges them */
+    int next_r;                 /* range the next UNMAP starts in */
+    uint64_t next_off;          /* blocks of next_r already taken */
+    uint64_t rate;              /* blocks per second, 0 for no limit */
+    int64_t next_us;            /* when rate allows next UNMAP to start */
+    uint64_t blks_done;         /* by the completed UNMAP commands */
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static void
+plan_lock(struct um_plan * pp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&pp->mtx);
+#else
+    if (pp) { ; }       /* suppress warning */
+#endif
+}
+
+static void
+plan_unlock(struct um_plan * pp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&pp->mtx);
+#else
+    if (pp) { ; }       /* suppress warning */
+#endif
+}
+
+static int64_t
+plan_now_us(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return (int64_t)ts.tv_sec * 1000000 + (ts.tv_nsec / 1000);
+    return 0;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+static void
+plan_sleep_us(int64_t us)
+{
+#ifdef HAVE_MS_SLEEP
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/* Sets the UNMAP limits of the plan from the Block Limits VPD page, or to
+ * the behaviour without --plan (one descriptor per command) if the device
+ * does not have one. rn, when > 0, further limits the blocks in each
+ * command. Returns 0 if ok. */
 static int
-build_lba_arr(const char * inp, uint64_t * lba_arr, int * lba_arr_len,
-              int max_arr_len)
+plan_get_limits(struct um_plan * pp, uint32_t rn)
 {
-    int in_len, k;
-    int64_t ll;
-    const char * lcp;
-    char * cp;
-    char * c2p;
-
-    if ((NULL == inp) || (NULL == lba_arr) ||
-        (NULL == lba_arr_len))
-        return 1;
-    lcp = inp;
-    in_len = strlen(inp);
-    if (0 == in_len)
-        *lba_arr_len = 0;
-    if ('-' == inp[0]) {        /* read from stdin */
-        pr2serr("'--lba' cannot be read from stdin\n");
-        return 1;
-    } else {        /* list of numbers (default decimal) on command line */
-        k = strspn(inp, "0123456789aAbBcCdDeEfFhHxXiIkKmMgGtTpP, ");
-        if (in_len != k) {
-            pr2serr("build_lba_arr: error at pos %d\n", k + 1);
-            return 1;
-        }
-        for (k = 0; k < max_arr_len; ++k) {
-            ll = sg_get_llnum(lcp);
-            if (-1 != ll) {
-                lba_arr[k] = (uint64_t)ll;
-                cp = (char *)strchr(lcp, ',');
-                c2p = (char *)strchr(lcp, ' ');
-                if (NULL == cp)
-                    cp = c2p;
-                if (NULL == cp)
-                    break;
-                if (c2p && (c2p < cp))
-                    cp = c2p;
-                lcp = cp + 1;
-            } else {
-                pr2serr("build_lba_arr: error at pos %d\n",
-                        (int)(lcp - inp + 1));
-                return 1;
-            }
-        }
-        *lba_arr_len = k + 1;
-        if (k == max_arr_len) {
-            pr2serr("build_lba_arr: array length exceeded\n");
-            return 1;
-        }
+    int vb = pp->vb;
+    uint32_t u;
+    const struct sg_ds_blk_lim * blp;
+
+    pp->max_lbas = rn ? rn : DEF_PLAN_LBAS;
+    pp->max_descs = 1;
+    pp->gran = 1;
+    pp->gran_align = 0;
+    if (sg_ds_get_blk_lim(pp->dsp, &blp) || (blp->page_len < 0x20)) {
+        if (vb)
+            pr2serr("No usable Block Limits VPD page, so one block "
+                    "descriptor of %u blocks per UNMAP\n", pp->max_lbas);
+        return 0;
+    }
+    u = blp->max_unmap_lba;
+    if (0 == u) {
+        pr2serr("Block Limits VPD page: maximum unmap LBA count is 0, so "
+                "UNMAP not supported\n");
+        return SG_LIB_CAT_INVALID_OP;
+    }
+    pp->max_lbas = (rn && (rn < u)) ? rn : u;
+    u = blp->max_unmap_descs;
+    if (0 == u)
+        u = 1;
+    pp->max_descs = (u > MAX_PLAN_DESCS) ? MAX_PLAN_DESCS : u;
+    u = blp->unmap_gran;
+    pp->gran = u ? u : 1;
+    if ((pp->gran > 1) && blp->ugavalid)
+        pp->gran_align = blp->unmap_align % pp->gran;
+    if (pp->max_lbas < pp->gran) {
+        if (vb)
+            pr2serr("maximum unmap LBA count (%u) less than granularity "
+                    "(%u), won't align\n", pp->max_lbas, pp->gran);
+        pp->gran = 1;
+        pp->gran_align = 0;
     }
+    if (vb)
+        pr2serr("Block limits: maximum unmap LBA count: %u, block "
+                "descriptors: %u,\n    granularity: %u, alignment: %u\n",
+                pp->max_lbas, pp->max_descs, pp->gran, pp->gran_align);
     return 0;
 }
 
-/* Read numbers (up to 32 bits in size) from command line (comma (or
- * (single) space) separated list). Assumed decimal unless prefixed
- * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or 1 if error. */
+/* Sorts the ranges, merges those that overlap or touch, then trims each to
+ * whole unmap granules (the device need not unmap part of a granule).
+ * Ranges reaching beyond last_lba are an error. Returns 0 if ok. */
 static int
-build_num_arr(const char * inp, uint32_t * num_arr, int * num_arr_len,
-              int max_arr_len)
+plan_normalize(struct um_plan * pp, uint64_t last_lba, uint64_t * dropp)
 {
-    int in_len, k;
-    const char * lcp;
-    int64_t ll;
-    char * cp;
-    char * c2p;
-
-    if ((NULL == inp) || (NULL == num_arr) ||
-        (NULL == num_arr_len))
-        return 1;
-    lcp = inp;
-    in_len = strlen(inp);
-    if (0 == in_len)
-        *num_arr_len = 0;
-    if ('-' == inp[0]) {        /* read from stdin */
-        pr2serr("'--len' cannot be read from stdin\n");
-        return 1;
-    } else {        /* list of numbers (default decimal) on command line */
-        k = strspn(inp, "0123456789aAbBcCdDeEfFhHxXiIkKmMgGtTpP, ");
-        if (in_len != k) {
-            pr2serr("build_num_arr: error at pos %d\n", k + 1);
-            return 1;
-        }
-        for (k = 0; k < max_arr_len; ++k) {
-            ll = sg_get_llnum(lcp);
-            if (-1 != ll) {
-                if (ll > UINT32_MAX) {
-                    pr2serr("build_num_arr: number exceeds 32 bits at pos "
-                            "%d\n", (int)(lcp - inp + 1));
-                    return 1;
-                }
-                num_arr[k] = (uint32_t)ll;
-                cp = (char *)strchr(lcp, ',');
-                c2p = (char *)strchr(lcp, ' ');
-                if (NULL == cp)
-                    cp = c2p;
-                if (NULL == cp)
-                    break;
-                if (c2p && (c2p < cp))
-                    cp = c2p;
-                lcp = cp + 1;
-            } else {
-                pr2serr("build_num_arr: error at pos %d\n",
-                        (int)(lcp - inp + 1));
-                return 1;
-            }
-        }
-        *num_arr_len = k + 1;
-        if (k == max_arr_len) {
-            pr2serr("build_num_arr: array length exceeded\n");
-            return 1;
-        }
+    int k, n;
+    uint64_t s, e, g, a;
+    struct sg_lba_extent * rp;
+
+    *dropp = 0;
+    sg_lba_set_coalesce(&pp->rset);
+    if (pp->rset.num < 1)
+        return 0;
+    rp = pp->rset.ext + pp->rset.num - 1;
+    if ((rp->lba + rp->num - 1) > last_lba) {
+        pr2serr("range from LBA 0x%" PRIx64 " for %" PRIu64 " blocks goes "
+                "past last LBA (0x%" PRIx64 ")\n", rp->lba, rp->num,
+                last_lba);
+        return SG_LIB_LBA_OUT_OF_RANGE;
     }
+    if (pp->gran < 2)
+        return 0;
+    g = pp->gran;
+    a = pp->gran_align;
+    for (k = 0, n = 0, rp = pp->rset.ext; k < pp->rset.num; ++k, ++rp) {
+        s = rp->lba;
+        e = rp->lba + rp->num;          /* one past */
+        if (s > a)
+            s = a + (((s - a) + g - 1) / g) * g;
+        else
+            s = a;
+        e = (e > a) ? (a + ((e - a) / g) * g) : 0;
+        if (e > s) {
+            *dropp += rp->num - (e - s);
+            pp->rset.ext[n].lba = s;
+            pp->rset.ext[n].num = e - s;
+            ++n;
+        } else
+            *dropp += rp->num;
+    }
+    pp->rset.num = n;
     return 0;
 }
 
-
-/* Read numbers from filename (or stdin) line by line (comma (or
- * (single) space) separated list). Assumed decimal unless prefixed
- * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or 1 if error. */
+/* Builds, in param_arr, the parameter list of the next UNMAP command of the
+ * plan. Returns its number of block descriptors (0 when the plan is
+ * finished) and its number of blocks in *nblksp. Call with lock held. */
 static int
-build_joint_arr(const char * file_name, uint64_t * lba_arr, uint32_t * num_arr,
-                int * arr_len, int max_arr_len)
+plan_next_cmd(struct um_plan * pp, uint8_t * param_arr, uint64_t * nblksp)
 {
-    bool have_stdin;
-    int off = 0;
-    int in_len, k, j, m, ind, bit0;
-    int64_t ll;
-    char line[1024];
-    char * lcp;
-    FILE * fp;
+    int nd = 0;
+    uint64_t room = pp->max_lbas;
+    uint64_t n, left;
+    uint8_t * dp = param_arr + 8;
+    const struct sg_lba_extent * rp;
 
-    have_stdin = ((1 == strlen(file_name)) && ('-' == file_name[0]));
-    if (have_stdin)
-        fp = stdin;
-    else {
-        fp = fopen(file_name, "r");
-        if (NULL == fp) {
-            pr2serr("%s: unable to open %s\n", __func__, file_name);
-            return 1;
+    *nblksp = 0;
+    while ((pp->next_r < pp->rset.num) && (nd < (int)pp->max_descs) &&
+           (room > 0)) {
+        rp = pp->rset.ext + pp->next_r;
+        left = rp->num - pp->next_off;
+        n = (left < room) ? left : room;
+        if (n > UINT32_MAX)
+            n = UINT32_MAX;
+        if ((n < left) && (pp->gran > 1)) {     /* keep next piece aligned */
+            n -= n % pp->gran;
+            if (0 == n)
+                break;
         }
+        sg_put_unaligned_be64(rp->lba + pp->next_off, dp + 0);
+        sg_put_unaligned_be32((uint32_t)n, dp + 8);
+        sg_put_unaligned_be32(0, dp + 12);
+        dp += 16;
+        ++nd;
+        room -= n;
+        *nblksp += n;
+        pp->next_off += n;
+        if (pp->next_off >= rp->num) {
+            ++pp->next_r;
+            pp->next_off = 0;
+        }
+    }
+    if (nd > 0) {
+        sg_put_unaligned_be16((uint16_t)(6 + (16 * nd)), param_arr + 0);
+        sg_put_unaligned_be16((uint16_t)(16 * nd), param_arr + 2);
+        sg_put_unaligned_be32(0, param_arr + 4);
     }
+    return nd;
+}
 
-    for (j = 0; j < 512; ++j) {
-        if (NULL == fgets(line, sizeof(line), fp))
-            break;
-        // could improve with carry_over logic if sizeof(line) too small
-        in_len = strlen(line);
-        if (in_len > 0) {
-            if ('\n' == line[in_len - 1]) {
-                --in_len;
-                line[in_len] = '\0';
-            }
+static void *
+plan_worker(void * v_pp)
+{
+    int nd, res;
+    int64_t start_us, now_us;
+    uint64_t nblks;
+    struct um_plan * pp = (struct um_plan *)v_pp;
+    uint8_t * param_arr;
+
+    param_arr = (uint8_t *)malloc(8 + (16 * pp->max_descs));
+    if (NULL == param_arr) {
+        pr2serr("%s: out of memory\n", __func__);
+        plan_lock(pp);
+        if (0 == pp->ret)
+            pp->ret = sg_convert_errno(ENOMEM);
+        pp->stop = true;
+        plan_unlock(pp);
+        return NULL;
+    }
+    while (true) {
+        plan_lock(pp);
+        nd = pp->stop ? 0 : plan_next_cmd(pp, param_arr, &nblks);
+        start_us = 0;
+        if ((nd > 0) && (pp->rate > 0)) {
+            /* each command takes its share of the rate, in turn */
+            now_us = plan_now_us();
+            start_us = (pp->next_us > now_us) ? pp->next_us : now_us;
+            pp->next_us = start_us + (int64_t)((nblks * 1000000) / pp->rate);
+            start_us -= now_us;
         }
-        if (in_len < 1)
-            continue;
-        lcp = line;
-        m = strspn(lcp, " \t");
-        if (m == in_len)
-            continue;
-        lcp += m;
-        in_len -= m;
-        if ('#' == *lcp)
-            continue;
-        k = strspn(lcp, "0123456789aAbBcCdDeEfFhHxXiIkKmMgGtTpP ,\t");
-        if ((k < in_len) && ('#' != lcp[k])) {
-            pr2serr("%s: syntax error at line %d, pos %d\n", __func__, j + 1,
-                    m + k + 1);
-            goto bad_exit;
+        plan_unlock(pp);
+        if (0 == nd)
+            break;
+        if (start_us > 0)
+            plan_sleep_us(start_us);
+        if (pp->vb > 1)
+            pr2serr("UNMAP from LBA 0x%" PRIx64 ": %d block descriptor%s, "
+                    "%" PRIu64 " blocks\n",
+                    sg_get_unaligned_be64(param_arr + 8), nd,
+                    (1 == nd) ? "" : "s", nblks);
+        res = sg_ll_unmap_v2(pp->sg_fd, pp->anchor, pp->grpnum, pp->timeout,
+                             param_arr, 8 + (16 * nd), true,
+                             (pp->vb > 2 ? pp->vb - 2 : 0));
+        plan_lock(pp);
+        if (res) {
+            if (0 == pp->ret)
+                pp->ret = res;
+            pp->stop = true;
+        } else {
+            ++pp->num_cmds;
+            pp->blks_done += nblks;
         }
-        for (k = 0; k < 1024; ++k) {
-            ll = sg_get_llnum(lcp);
-            if (-1 != ll) {
-                ind = ((off + k) >> 1);
-                bit0 = 0x1 & (off + k);
-                if (ind >= max_arr_len) {
-                    pr2serr("%s: array length exceeded\n", __func__);
-                    goto bad_exit;
-                }
-                if (bit0) {
-                    if (ll > UINT32_MAX) {
-                        pr2serr("%s: number exceeds 32 bits in line %d, at "
-                                "pos %d\n", __func__, j + 1,
-                                (int)(lcp - line + 1));
-                        goto bad_exit;
-                    }
-                    num_arr[ind] = (uint32_t)ll;
-                } else
-                   lba_arr[ind] = (uint64_t)ll;
-                lcp = strpbrk(lcp, " ,\t");
-                if (NULL == lcp)
-                    break;
-                lcp += strspn(lcp, " ,\t");
-                if ('\0' == *lcp)
-                    break;
-            } else {
-                if ('#' == *lcp) {
-                    --k;
-                    break;
-                }
-                pr2serr("%s: error on line %d, at pos %d\n", __func__, j + 1,
-                        (int)(lcp - line + 1));
-                goto bad_exit;
-            }
+        plan_unlock(pp);
+    }
+    free(param_arr);
+    return NULL;
+}
+
+/* Issues the UNMAP commands of the plan, up to num_jobs at a time. Returns
+ * 0 if all succeeded, else the error of the first that failed. */
+static int
+plan_run(struct um_plan * pp, int num_jobs)
+{
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+
+    pthread_mutex_init(&pp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, plan_worker, pp))) {
+            if (pp->vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
         }
-        off += (k + 1);
     }
-    if (0x1 & off) {
-        pr2serr("%s: expect LBA,NUM pairs but decoded odd number\n  from "
-                "%s\n", __func__, have_stdin ? "stdin" : file_name);
-        goto bad_exit;
+    num_jobs = k;
+    plan_worker(pp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&pp->mtx);
+#else
+    if (num_jobs) { ; }  /* suppress warning */
+    plan_worker(pp);
+#endif
+    return pp->ret;
+}
+
+/* Number of UNMAP commands the plan will take; also rewinds it */
+static int
+plan_count_cmds(struct um_plan * pp, uint8_t * param_arr)
+{
+    int n;
+    uint64_t nblks;
+
+    for (n = 0; plan_next_cmd(pp, param_arr, &nblks) > 0; ++n)
+        ;
+    pp->next_r = 0;
+    pp->next_off = 0;
+    return n;
+}
+
+/* Places the LBA of the last block on the device of the session in
+ * *last_lbap. Returns 0 if ok, else an error. */
+static int
+get_last_lba(struct sg_dev_sess * dsp, uint64_t * last_lbap)
+{
+    int res;
+    const struct sg_ds_cap * cp;
+
+    res = sg_ds_get_cap(dsp, &cp);
+    if (SG_LIB_CAT_UNIT_ATTENTION == res) {
+        pr2serr("Read capacity unit attention, try again\n");
+        res = sg_ds_get_cap(dsp, &cp);
+    }
+    if (res) {
+        if (res < 0)
+            res = sg_convert_errno(-res);
+        pr2serr("Read capacity failed\n");
+        return res;
     }
-    *arr_len = off >> 1;
-    if (fp && (stdin != fp))
-        fclose(fp);
+    *last_lbap = cp->num_blocks - 1;
     return 0;
+}
 
-bad_exit:
-    if (fp && (stdin != fp))
-        fclose(fp);
-    return 1;
+/* Gives the user 15 seconds to abort (with control-C) before data, as
+ * described by lost_str, is lost */
+static void
+countdown(const char * device_name,
+          const struct sg_simple_inquiry_resp * inq_rp, const char * lost_str)
+{
+    printf("%s is:  %.8s  %.16s  %.4s\n", device_name,
+           inq_rp->vendor, inq_rp->product, inq_rp->revision);
+    sleep_for(3);
+    printf("\nAn UNMAP (a.k.a. trim) will commence in 15 seconds\n");
+    printf("    %s\n", lost_str);
+    printf("        Press control-C to abort\n");
+    sleep_for(5);
+    printf("\nAn UNMAP will commence in 10 seconds\n");
+    printf("    %s\n", lost_str);
+    printf("        Press control-C to abort\n");
+    sleep_for(5);
+    printf("\nAn UNMAP (a.k.a. trim) will commence in 5 seconds\n");
+    printf("    %s\n", lost_str);
+    printf("        Press control-C to abort\n");
+    sleep_for(7);
+}
+
+/* The --plan path: adds the --all= range (if given), fits the ranges to
+ * the Block Limits VPD page then issues the UNMAP commands. Returns 0 if
+ * ok, else an error. */
+static int
+plan_unmap(struct um_plan * pp, const char * device_name,
+           const struct sg_simple_inquiry_resp * inq_rp, bool all_given,
+           uint64_t all_start, uint64_t all_last, uint32_t all_rn,
+           bool do_force, bool dry_run, int num_jobs)
+{
+    int k, res, num_cmds;
+    int vb = pp->vb;
+    int64_t start_us;
+    uint64_t last_lba, dropped, total;
+    uint8_t * param_arr;
+    char b[160];
+
+    res = get_last_lba(pp->dsp, &last_lba);
+    if (res)
+        return res;
+    if (all_given) {
+        if (0 == all_last)
+            all_last = last_lba;
+        if (all_start > all_last) {
+            pr2serr("start address (0x%" PRIx64 ") exceeds last address (0x%"
+                    PRIx64 ")\n", all_start, all_last);
+            return SG_LIB_CONTRADICT;
+        }
+        res = sg_lba_set_add(&pp->rset, all_start,
+                             all_last + 1 - all_start);
+        if (res)
+            return res;
+    }
+    res = plan_get_limits(pp, all_rn);
+    if (res)
+        return res;
+    res = plan_normalize(pp, last_lba, &dropped);
+    if (res)
+        return res;
+    param_arr = (uint8_t *)malloc(8 + (16 * pp->max_descs));
+    if (NULL == param_arr) {
+        pr2serr("%s: out of memory\n", __func__);
+        return sg_convert_errno(ENOMEM);
+    }
+    num_cmds = plan_count_cmds(pp, param_arr);
+    free(param_arr);
+    total = sg_lba_set_blocks(&pp->rset);
+    if (dry_run || vb) {
+        pr2serr("%s: %d range%s, %" PRIu64 " blocks in %d UNMAP command%s\n",
+                (dry_run ? "Doing dry-run, plan" : "Plan"), pp->rset.num,
+                (1 == pp->rset.num) ? "" : "s", total, num_cmds,
+                (1 == num_cmds) ? "" : "s");
+        if (dropped)
+            pr2serr("    skipping %" PRIu64 " blocks not in whole unmap "
+                    "granules\n", dropped);
+    }
+    if ((dry_run && (vb > 1)) || (vb > 3)) {
+        for (k = 0; k < pp->rset.num; ++k)
+            pr2serr("    0x%" PRIx64 ", %" PRIu64 "\n",
+                    pp->rset.ext[k].lba, pp->rset.ext[k].num);
+    }
+    if (0 == num_cmds)
+        return 0;
+    if (! do_force) {
+        snprintf(b, sizeof(b), "%" PRIu64 " blocks in %d range%s on %s "
+                 "will be LOST", total, pp->rset.num,
+                 (1 == pp->rset.num) ? "" : "s", device_name);
+        countdown(device_name, inq_rp, b);
+    }
+    if (dry_run)
+        return 0;
+    if (num_jobs > num_cmds)
+        num_jobs = num_cmds;
+    start_us = plan_now_us();
+    res = plan_run(pp, num_jobs);
+    if (res)
+        pr2serr("UNMAP failed after %d command%s (%" PRIu64 " blocks)\n",
+                pp->num_cmds, (1 == pp->num_cmds) ? "" : "s",
+                pp->blks_done);
+    else if (vb)
+        pr2serr("Completed %d UNMAP commands, %" PRIu64 " blocks in %.3f "
+                "seconds\n", pp->num_cmds, pp->blks_done,
+                (double)(plan_now_us() - start_us) / 1000000.0);
+    return res;
 }
 
 
 int
 main(int argc, char * argv[])
 {
+    bool all_given = false;
     bool anchor = false;
     bool do_force = false;
     bool dry_run = false;
     bool err_printed = false;
+    bool plan = false;
     bool verbose_given = false;
     bool version_given = false;
     int res, c, num, k, j;
     int sg_fd = -1;
     int grpnum = 0;
-    int addr_arr_len = 0;
-    int num_arr_len = 0;
+    int num_descs = 0;
+    int num_jobs = DEF_JOBS;
     int param_len = 4;
     int ret = 0;
     int timeout = DEF_TIMEOUT_SECS;
@@ -378,6 +630,8 @@ main(int argc, char * argv[])
     uint32_t all_rn = 0;        /* Repetition Number, 0 for inactive */
     uint64_t all_start = 0;
     uint64_t all_last = 0;
+    uint64_t rate = 0;
+    uint64_t dup_blks;
     int64_t ll;
     const char * lba_op = NULL;
     const char * num_op = NULL;
@@ -386,14 +640,19 @@ main(int argc, char * argv[])
     char * first_comma = NULL;
     char * second_comma = NULL;
     struct sg_simple_inquiry_resp inq_resp;
-    uint64_t addr_arr[MAX_NUM_ADDR];
-    uint32_t num_arr[MAX_NUM_ADDR];
-    uint8_t param_arr[8 + (MAX_NUM_ADDR * 16)];
+    struct sg_dev_sess ds;
+    struct um_plan a_plan;
+    struct sg_lba_set um_set;
+    struct sg_lba_set * lsp;
+    uint8_t * param_arr = NULL;
 
+    memset(&a_plan, 0, sizeof(a_plan));
+    sg_lba_set_init(&a_plan.rset);
+    sg_lba_set_init(&um_set);
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "aA:dfg:hI:Hl:n:t:vV", long_options,
+        c = getopt_long(argc, argv, "aA:dfg:hI:Hj:l:n:Pr:t:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -421,9 +680,7 @@ main(int argc, char * argv[])
                 return SG_LIB_SYNTAX_ERROR;
             }
             all_rn = (uint32_t)ll;
-            if (0 == ll)
-                pr2serr("warning: --all=ST,RN... being ignored because RN "
-                        "is 0\n");
+            all_given = true;
             second_comma = strchr(first_comma + 1, ',');
             if (second_comma) {
                 ll = sg_get_llnum(second_comma + 1);
@@ -456,12 +713,31 @@ main(int argc, char * argv[])
         case 'I':
             in_op = optarg;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs=' should be 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             lba_op = optarg;
             break;
         case 'n':
             num_op = optarg;
             break;
+        case 'P':
+            plan = true;
+            break;
+        case 'r':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("bad argument to '--rate='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            rate = (uint64_t)ll;
+            break;
         case 't':
             timeout = sg_get_num(optarg);
             if (timeout < 0)  {
@@ -523,7 +799,11 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
 
-    if (all_rn > 0) {
+    if (all_given && (0 == all_rn) && (! plan)) {
+        pr2serr("warning: --all=ST,RN... being ignored because RN is 0\n");
+        all_given = false;
+    }
+    if (all_given) {
         if (lba_op || num_op || in_op) {
             pr2serr("Can't have --all= together with --lba=, --num= or "
                     "--in=\n\n");
@@ -548,60 +828,68 @@ main(int argc, char * argv[])
         return SG_LIB_CONTRADICT;
     }
 
-    if (all_rn > 0) {
+    if (all_given) {
         if ((all_last > 0) && (all_start > all_last)) {
             pr2serr("in --all=ST,RN,LA start address (ST) exceeds last "
                     "address (LA)\n");
             return SG_LIB_CONTRADICT;
         }
     } else {
-        memset(addr_arr, 0, sizeof(addr_arr));
-        memset(num_arr, 0, sizeof(num_arr));
-        addr_arr_len = 0;
+        lsp = plan ? &a_plan.rset : &um_set;
         if (lba_op && num_op) {
-            if (0 != build_lba_arr(lba_op, addr_arr, &addr_arr_len,
-                                   MAX_NUM_ADDR)) {
-                pr2serr("bad argument to '--lba'\n");
-                return SG_LIB_SYNTAX_ERROR;
+            res = sg_lba_set_parse(lsp, lba_op, num_op, 0);
+            if (res) {
+                pr2serr("bad argument to '--lba=' or '--num='\n");
+                return res;
             }
-            if (0 != build_num_arr(num_op, num_arr, &num_arr_len,
-                                   MAX_NUM_ADDR)) {
-                pr2serr("bad argument to '--num'\n");
-                return SG_LIB_SYNTAX_ERROR;
-            }
-            if ((addr_arr_len != num_arr_len) || (num_arr_len <= 0)) {
-                pr2serr("need same number of arguments to '--lba=' "
-                        "and '--num=' options\n");
-                return SG_LIB_CONTRADICT;
-            }
-        }
-        if (in_op) {
-            if (0 != build_joint_arr(in_op, addr_arr, num_arr, &addr_arr_len,
-                                     MAX_NUM_ADDR)) {
+        } else if (in_op) {
+            res = sg_lba_set_read_file(lsp, in_op, SG_LBA_SET_PAIRS);
+            if (res) {
                 pr2serr("bad argument to '--in'\n");
-                return SG_LIB_SYNTAX_ERROR;
+                return res;
             }
-            if (addr_arr_len <= 0) {
+            if (lsp->num <= 0) {
                 pr2serr("no addresses found in '--in=' argument, file: %s\n",
                         in_op);
                 return SG_LIB_SYNTAX_ERROR;
             }
         }
-        param_len = 8 + (16 * addr_arr_len);
-        memset(param_arr, 0, param_len);
-        k = 8;
-        for (j = 0; j < addr_arr_len; ++j) {
-            sg_put_unaligned_be64(addr_arr[j], param_arr + k);
-            k += 8;
-            sg_put_unaligned_be32(num_arr[j], param_arr + k);
-            k += 4 + 4;
+        if (! plan) {
+            /* one parameter list in ascending LBA order, neighbours merged
+             * and extents over 32 bits split across block descriptors */
+            dup_blks = sg_lba_set_coalesce(lsp);
+            if (dup_blks && vb)
+                pr2serr("%" PRIu64 " blocks in more than one range, "
+                        "merged\n", dup_blks);
+            for (j = 0; j < lsp->num; ++j)
+                num_descs += (int)((lsp->ext[j].num + UINT32_MAX - 1) /
+                                   UINT32_MAX);
+            if (num_descs > MAX_PLAN_DESCS) {
+                pr2serr("%d block descriptors won't fit in one UNMAP "
+                        "command, try '--plan'\n", num_descs);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            param_len = 8 + (16 * num_descs);
+            param_arr = (uint8_t *)calloc(param_len, 1);
+            if (NULL == param_arr) {
+                pr2serr("out of memory\n");
+                return sg_convert_errno(ENOMEM);
+            }
+            k = 8;
+            for (j = 0; j < lsp->num; ++j) {
+                uint64_t lba = lsp->ext[j].lba;
+                uint64_t left = lsp->ext[j].num;
+                uint32_t n;
+
+                for ( ; left > 0; left -= n, lba += n, k += 16) {
+                    n = (left > UINT32_MAX) ? UINT32_MAX : (uint32_t)left;
+                    sg_put_unaligned_be64(lba, param_arr + k);
+                    sg_put_unaligned_be32(n, param_arr + k + 8);
+                }
+            }
+            sg_put_unaligned_be16((uint16_t)(param_len - 2), param_arr + 0);
+            sg_put_unaligned_be16((uint16_t)(param_len - 8), param_arr + 2);
         }
-        k = 0;
-        num = param_len - 2;
-        sg_put_unaligned_be16((uint16_t)num, param_arr + k);
-        k += 2;
-        num = param_len - 8;
-        sg_put_unaligned_be16((uint16_t)num, param_arr + k);
     }
 
     sg_fd = sg_cmds_open_device(device_name, false /* rw */, vb);
@@ -610,55 +898,30 @@ main(int argc, char * argv[])
         pr2serr("open error: %s: %s\n", device_name, safe_strerror(-sg_fd));
         goto err_out;
     }
+    sg_ds_init(&ds, sg_fd, (vb > 1) ? vb - 1 : 0);
     ret = sg_simple_inquiry(sg_fd, &inq_resp, true, vb);
 
-    if (all_rn > 0) {
+    if (plan) {
+        a_plan.anchor = anchor;
+        a_plan.grpnum = grpnum;
+        a_plan.timeout = timeout;
+        a_plan.vb = vb;
+        a_plan.sg_fd = sg_fd;
+        a_plan.dsp = &ds;
+        a_plan.rate = rate;
+        ret = plan_unmap(&a_plan, device_name, &inq_resp, all_given,
+                         all_start, all_last, all_rn, do_force, dry_run,
+                         num_jobs);
+        goto err_out;
+    } else if (all_given) {
         bool last_retry;
         bool to_end_of_device = false;
         uint64_t ull;
         uint32_t bump;
 
         if (0 == all_last) {    /* READ CAPACITY(10 or 16) to find last */
-            uint8_t resp_buff[RCAP16_RESP_LEN];
-
-            res = sg_ll_readcap_16(sg_fd, false /* pmi */, 0 /* llba */,
-                                   resp_buff, RCAP16_RESP_LEN, true, vb);
-            if (SG_LIB_CAT_UNIT_ATTENTION == res) {
-                pr2serr("Read capacity(16) unit attention, try again\n");
-                res = sg_ll_readcap_16(sg_fd, false, 0, resp_buff,
-                                       RCAP16_RESP_LEN, true, vb);
-            }
-            if (0 == res) {
-                if (vb > 3) {
-                    pr2serr("Read capacity(16) response:\n");
-                    hex2stderr(resp_buff, RCAP16_RESP_LEN, 1);
-                }
-                all_last = sg_get_unaligned_be64(resp_buff + 0);
-            } else if ((SG_LIB_CAT_INVALID_OP == res) ||
-                       (SG_LIB_CAT_ILLEGAL_REQ == res)) {
-                if (vb)
-                    pr2serr("Read capacity(16) not supported, try Read "
-                            "capacity(10)\n");
-                res = sg_ll_readcap_10(sg_fd, false /* pmi */, 0 /* lba */,
-                                       resp_buff, RCAP10_RESP_LEN, true,
-                                       vb);
-                if (0 == res) {
-                    if (vb > 3) {
-                        pr2serr("Read capacity(10) response:\n");
-                        hex2stderr(resp_buff, RCAP10_RESP_LEN, 1);
-                    }
-                    all_last = (uint64_t)sg_get_unaligned_be32(resp_buff + 0);
-                } else {
-                    if (res < 0)
-                        res = sg_convert_errno(-res);
-                    pr2serr("Read capacity(10) failed\n");
-                    ret = res;
-                    goto err_out;
-                }
-            } else {
-                if (res < 0)
-                    res = sg_convert_errno(-res);
-                pr2serr("Read capacity(16) failed\n");
+            res = get_last_lba(&ds, &all_last);
+            if (res) {
                 ret = res;
                 goto err_out;
             }
@@ -672,29 +935,17 @@ main(int argc, char * argv[])
             to_end_of_device = true;
         }
         if (! do_force) {
-            char b[120];
+            char b[160];
 
-            printf("%s is:  %.8s  %.16s  %.4s\n", device_name,
-                   inq_resp.vendor, inq_resp.product, inq_resp.revision);
-            sleep_for(3);
             if (to_end_of_device)
-                snprintf(b, sizeof(b), "LBA 0x%" PRIx64 " to end of %s "
-                         "(0x%" PRIx64 ")", all_start, device_name, all_last);
+                snprintf(b, sizeof(b), "ALL data from LBA 0x%" PRIx64 " to "
+                         "end of %s (0x%" PRIx64 ") will be LOST", all_start,
+                         device_name, all_last);
             else
-                snprintf(b, sizeof(b), "LBA 0x%" PRIx64 " to 0x%" PRIx64
-                         " on %s", all_start, all_last, device_name);
-            printf("\nAn UNMAP (a.k.a. trim) will commence in 15 seconds\n");
-            printf("    ALL data from %s will be LOST\n", b);
-            printf("        Press control-C to abort\n");
-            sleep_for(5);
-            printf("\nAn UNMAP will commence in 10 seconds\n");
-            printf("    ALL data from %s will be LOST\n", b);
-            printf("        Press control-C to abort\n");
-            sleep_for(5);
-            printf("\nAn UNMAP (a.k.a. trim) will commence in 5 seconds\n");
-            printf("    ALL data from %s will be LOST\n", b);
-            printf("        Press control-C to abort\n");
-            sleep_for(7);
+                snprintf(b, sizeof(b), "ALL data from LBA 0x%" PRIx64 " to "
+                         "0x%" PRIx64 " on %s will be LOST", all_start,
+                         all_last, device_name);
+            countdown(device_name, &inq_resp, b);
         }
         if (dry_run) {
             pr2serr("Doing dry-run, would have unmapped from LBA 0x%" PRIx64
@@ -704,6 +955,12 @@ main(int argc, char * argv[])
         }
         last_retry = false;
         param_len = 8 + (16 * 1);
+        param_arr = (uint8_t *)malloc(param_len);
+        if (NULL == param_arr) {
+            pr2serr("out of memory\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto err_out;
+        }
         for (ull = all_start, j = 0; ull <= all_last; ull += bump, ++j) {
             if ((all_last - ull) < all_rn)
                 bump = (uint32_t)(all_last + 1 - ull);
@@ -746,31 +1003,16 @@ retry:
             pr2serr("Doing dry-run so here is 'LBA, number_of_blocks' list "
                     "of candidates\n");
             k = 8;
-            for (j = 0; j < addr_arr_len; ++j) {
-                printf("    0x%" PRIx64 ", 0x%u\n",
+            for (j = 0; j < num_descs; ++j) {
+                printf("    0x%" PRIx64 ", 0x%x\n",
                       sg_get_unaligned_be64(param_arr + k),
                       sg_get_unaligned_be32(param_arr + k + 8));
                 k += (8 + 4 + 4);
             }
             goto err_out;
         }
-        if (! do_force) {
-            printf("%s is:  %.8s  %.16s  %.4s\n", device_name,
-                   inq_resp.vendor, inq_resp.product, inq_resp.revision);
-            sleep_for(3);
-            printf("\nAn UNMAP (a.k.a. trim) will commence in 15 seconds\n");
-            printf("    Some data will be LOST\n");
-            printf("        Press control-C to abort\n");
-            sleep_for(5);
-            printf("\nAn UNMAP will commence in 10 seconds\n");
-            printf("    Some data will be LOST\n");
-            printf("        Press control-C to abort\n");
-            sleep_for(5);
-            printf("\nAn UNMAP (a.k.a. trim) will commence in 5 seconds\n");
-            printf("    Some data will be LOST\n");
-            printf("        Press control-C to abort\n");
-            sleep_for(7);
-        }
+        if (! do_force)
+            countdown(device_name, &inq_resp, "Some data will be LOST");
         res = sg_ll_unmap_v2(sg_fd, anchor, grpnum, timeout, param_arr,
                              param_len, true, vb);
         ret = res;
@@ -798,6 +1040,9 @@ retry:
     }
 
 err_out:
+    free(param_arr);
+    sg_lba_set_free(&um_set);
+    sg_lba_set_free(&a_plan.rset);
     if (sg_fd >= 0) {
         res = sg_cmds_close_device(sg_fd);
         if (res < 0) {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2018 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -16,15 +16,22 @@
 #include <errno.h>
 #include <string.h>
 #include <getopt.h>
+#include <limits.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
+#include "sg_pt.h"
+#include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 /* A utility program for the Linux OS SCSI subsystem.
@@ -39,15 +46,20 @@
  * the possibility of protection data (DIF).
  */
 
-static const char * version_str = "1.25 20180628";    /* sbc4r15 */
+static const char * version_str = "1.27 20261014";    /* sbc4r15 */
 
 #define ME "sg_verify: "
 
 #define EBUFF_SZ 256
+#define DEF_SCRUB_BPC 2048      /* when no Block Limits transfer length */
+#define DEF_JOBS 4
+#define MAX_JOBS 256
+#define CHECKPOINT_SECS 2
 
 
 static struct option long_options[] = {
         {"16", no_argument, 0, 'S'},
+        {"bad", required_argument, 0, 'e'},
         {"bpc", required_argument, 0, 'b'},
         {"bytchk", required_argument, 0, 'B'},  /* 4 backward compatibility */
         {"count", required_argument, 0, 'c'},
@@ -56,11 +68,18 @@ static struct option long_options[] = {
         {"group", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"in", required_argument, 0, 'i'},
+        {"iops", required_argument, 0, 'I'},
+        {"jobs", required_argument, 0, 'j'},
         {"lba", required_argument, 0, 'l'},
         {"nbo", required_argument, 0, 'n'},     /* misspelling, legacy */
         {"ndo", required_argument, 0, 'n'},
         {"quiet", no_argument, 0, 'q'},
+        {"rate", required_argument, 0, 'R'},
+        {"rate-lat", required_argument, 0, 'L'},
+        {"rate_lat", required_argument, 0, 'L'},
         {"readonly", no_argument, 0, 'r'},
+        {"resume", required_argument, 0, 'u'},
+        {"scrub", no_argument, 0, 's'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
         {"vrprotect", required_argument, 0, 'P'},
@@ -70,20 +89,30 @@ static struct option long_options[] = {
 static void
 usage()
 {
-    pr2serr("Usage: sg_verify [--16] [--bpc=BPC] [--count=COUNT] [--dpo] "
-            "[--ebytchk=BCH]\n"
-            "                 [--group=GN] [--help] [--in=IF] "
-            "[--lba=LBA] [--ndo=NDO]\n"
-            "                 [--quiet] [--readonly] [--verbose] "
+    pr2serr("Usage: sg_verify [--16] [--bad=BF] [--bpc=BPC] [--count=COUNT] "
+            "[--dpo]\n"
+            "                 [--ebytchk=BCH] [--group=GN] [--help] "
+            "[--in=IF]\n"
+            "                 [--iops=IOPS] [--jobs=JOBS] [--lba=LBA] "
+            "[--ndo=NDO]\n"
+            "                 [--quiet] [--rate=BPS] [--rate-lat=US] "
+            "[--readonly]\n"
+            "                 [--resume=RF] [--scrub] [--verbose] "
             "[--version]\n"
             "                 [--vrprotect=VRP] DEVICE\n"
             "  where:\n"
             "    --16|-S             use VERIFY(16) (def: use "
             "VERIFY(10) )\n"
+            "    --bad=BF|-e BF      with --scrub: append bad extents, one "
+            "LBA,NUM\n"
+            "                        per line, to file BF\n"
             "    --bpc=BPC|-b BPC    max blocks per verify command "
-            "(def: 128)\n"
+            "(def: 128; with\n"
+            "                        --scrub from Block Limits VPD page)\n"
             "    --count=COUNT|-c COUNT    count of blocks to verify "
             "(def: 1).\n"
+            "                              With --scrub 0 (def) is to the "
+            "end\n"
             "                              If BCH=3 then COUNT must "
             "be 1 .\n"
             "    --dpo|-d            disable page out (cache retention "
@@ -101,6 +130,12 @@ usage()
             "    --in=IF|-i IF       input from file called IF (def: "
             "stdin)\n"
             "                        only active if --ebytchk=BCH given\n"
+            "    --iops=IOPS|-I IOPS    limit to IOPS VERIFY commands per "
+            "second\n"
+            "                           (def: 0 -> no limit)\n"
+            "    --jobs=JOBS|-j JOBS    with --scrub: VERIFY commands in "
+            "flight\n"
+            "                           (def: 4)\n"
             "    --lba=LBA|-l LBA    logical block address to start "
             "verify (def: 0)\n"
             "    --ndo=NDO|-n NDO    NDO is number of bytes placed in "
@@ -114,8 +149,22 @@ usage()
             "    --quiet|-q          suppress miscompare report to stderr, "
             "still\n"
             "                        causes an exit status of 14\n"
+            "    --rate=BPS|-R BPS    limit to BPS bytes (of blocks "
+            "verified) per\n"
+            "                         second (def: 0 -> no limit)\n"
+            "    --rate-lat=US|-L US    lower --rate and --iops while the "
+            "smoothed\n"
+            "                           VERIFY latency is over US "
+            "microseconds\n"
             "    --readonly|-r       open DEVICE read-only (def: open it "
             "read-write)\n"
+            "    --resume=RF|-u RF    with --scrub: checkpoint progress in "
+            "file RF\n"
+            "                         and, if RF exists, carry on from it\n"
+            "    --scrub|-s          scrub media: parallel VERIFY(16) over "
+            "the range,\n"
+            "                        bad blocks found by bisection, "
+            "continue past them\n"
             "    --verbose|-v        increase verbosity\n"
             "    --version|-V        print version string and exit\n"
             "    --vrprotect=VRP|-P VRP    set vrprotect field to VRP "
@@ -125,6 +174,452 @@ usage()
             "(it was a single bit).\n");
 }
 
+/* Returns the logical block size of DEVICE, needed to convert --rate=BPS
+ * to blocks, from the capacity of its session. Assumes 512 if that fails. */
+static int
+get_lb_size(struct sg_dev_sess * dsp)
+{
+    const struct sg_ds_cap * cp;
+
+    if (0 == sg_ds_get_cap(dsp, &cp))
+        return (int)cp->lb_size;
+    pr2serr("READ CAPACITY failed, assume a logical block size of 512 for "
+            "--rate\n");
+    return 512;
+}
+
+/* The --scrub engine. DEVICE is cut into chunks that JOBS threads take in
+ * ascending LBA order and check with VERIFY(16). A chunk that fails with a
+ * medium error is bisected down to the bad blocks which are appended, as
+ * extents, to the --bad= file. Progress is checkpointed to the --resume=
+ * file so an interrupted scrub can carry on from where it left off. */
+struct vscrub {
+    bool stop;                  /* set by first non-medium error */
+    bool quiet;
+    bool dpo;
+    int sg_fd;
+    struct sg_dev_sess * dsp;   /* of sg_fd */
+    int ret;                    /* of first non-medium error */
+    int vrprotect;
+    int group;
+    int lb_size;
+    int vb;
+    int num_ids;                /* worker slots handed out */
+    uint32_t chunk;             /* blocks in one VERIFY, at most */
+    uint64_t next_lba;          /* where the next chunk starts */
+    uint64_t end_lba;           /* one past the last block to verify */
+    uint64_t blks_done;
+    uint64_t num_cmds;
+    uint64_t bad_blks;
+    uint64_t bad_exts;
+    uint64_t ck_ns;             /* when last checkpointed */
+    uint64_t inflight[MAX_JOBS];        /* chunk start, or UINT64_MAX */
+    int64_t rate_lat_us;
+    struct sg_pt_rate * rlp;
+    FILE * bad_fp;
+    const char * resume_fn;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+struct vscrub_job {
+    int id;
+    uint32_t run_num;           /* bad blocks in run, 0 for none */
+    uint64_t run_lba;           /* first bad block of run */
+    struct vscrub * sp;
+};
+
+static void
+scrub_lock(struct vscrub * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+static void
+scrub_unlock(struct vscrub * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+/* Blocks below the returned LBA have all been verified. Call with lock
+ * held. */
+static uint64_t
+scrub_low_water(const struct vscrub * sp)
+{
+    int k;
+    uint64_t low = sp->next_lba;
+
+    for (k = 0; k < sp->num_ids; ++k) {
+        if (sp->inflight[k] < low)
+            low = sp->inflight[k];
+    }
+    return low;
+}
+
+/* Writes "next=LBA end=LBA" to the resume file, via a temporary file that
+ * is then renamed over it. Call with lock held. */
+static void
+scrub_checkpoint(struct vscrub * sp)
+{
+    FILE * fp;
+    char b[PATH_MAX + 8];
+
+    if (NULL == sp->resume_fn)
+        return;
+    snprintf(b, sizeof(b), "%s.tmp", sp->resume_fn);
+    if (NULL == (fp = fopen(b, "w"))) {
+        pr2serr("unable to write %s: %s\n", b, safe_strerror(errno));
+        return;
+    }
+    fprintf(fp, "next=0x%" PRIx64 " end=0x%" PRIx64 "\n",
+            scrub_low_water(sp), sp->end_lba);
+    if ((0 != fclose(fp)) || (0 != rename(b, sp->resume_fn)))
+        pr2serr("unable to update %s: %s\n", sp->resume_fn,
+                safe_strerror(errno));
+}
+
+/* Reads the resume file, if present. Returns 0 and places the LBA to carry
+ * on from in *lbap (unchanged if there is no file), else an error. */
+static int
+scrub_read_resume(const char * fn, uint64_t lba, uint64_t end_lba,
+                  uint64_t * lbap)
+{
+    int n;
+    uint64_t nxt, end;
+    FILE * fp;
+
+    if (NULL == (fp = fopen(fn, "r"))) {
+        if (ENOENT == errno)
+            return 0;
+        pr2serr("unable to open %s: %s\n", fn, safe_strerror(errno));
+        return sg_convert_errno(errno);
+    }
+    n = fscanf(fp, "next=%" SCNx64 " end=%" SCNx64, &nxt, &end);
+    fclose(fp);
+    if (2 != n) {
+        pr2serr("resume file %s is not understood\n", fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    if ((end != end_lba) || (nxt < lba) || (nxt > end)) {
+        pr2serr("resume file %s is for a different range (next=0x%" PRIx64
+                " end=0x%" PRIx64 "), remove it to start again\n", fn, nxt,
+                end);
+        return SG_LIB_CONTRADICT;
+    }
+    *lbap = nxt;
+    return 0;
+}
+
+/* Reports the run of bad blocks held by jp, if any. */
+static void
+scrub_flush_run(struct vscrub_job * jp)
+{
+    struct vscrub * sp = jp->sp;
+
+    if (0 == jp->run_num)
+        return;
+    scrub_lock(sp);
+    sp->bad_blks += jp->run_num;
+    ++sp->bad_exts;
+    if (sp->bad_fp) {
+        fprintf(sp->bad_fp, "0x%" PRIx64 ",%u\n", jp->run_lba, jp->run_num);
+        fflush(sp->bad_fp);
+    }
+    scrub_unlock(sp);
+    if (! sp->quiet)
+        pr2serr("bad extent: lba=0x%" PRIx64 ", %u block%s\n", jp->run_lba,
+                jp->run_num, (1 == jp->run_num) ? "" : "s");
+    jp->run_num = 0;
+}
+
+static void
+scrub_bad_blk(struct vscrub_job * jp, uint64_t lba)
+{
+    if (jp->run_num && (lba == (jp->run_lba + jp->run_num)) &&
+        (jp->run_num < UINT32_MAX))
+        ++jp->run_num;
+    else {
+        scrub_flush_run(jp);
+        jp->run_lba = lba;
+        jp->run_num = 1;
+    }
+}
+
+/* One rate limited VERIFY(16). Returns its result; *infop is the reported
+ * lba if SG_LIB_CAT_MEDIUM_HARD_WITH_INFO is returned. */
+static int
+scrub_verify(struct vscrub * sp, uint64_t lba, uint32_t num,
+             uint64_t * infop)
+{
+    int res;
+    uint64_t wait_ns, lat_start;
+
+    scrub_lock(sp);
+    wait_ns = sg_pt_rate_take(sp->rlp, (uint64_t)num * sp->lb_size);
+    scrub_unlock(sp);
+    sg_pt_rate_sleep(wait_ns);
+    lat_start = sp->rate_lat_us ? sg_pt_lat_now_ns() : 0;
+    if (sp->vb > 2)
+        pr2serr("VERIFY(16) lba=0x%" PRIx64 ", %u blocks\n", lba, num);
+    res = sg_ll_verify16(sp->sg_fd, sp->vrprotect, sp->dpo, 0, lba, num,
+                         sp->group, NULL, 0, infop, sp->vb > 1,
+                         (sp->vb > 2) ? sp->vb - 2 : 0);
+    scrub_lock(sp);
+    if (lat_start)
+        sg_pt_rate_update(sp->rlp, sg_pt_lat_now_ns() - lat_start);
+    ++sp->num_cmds;
+    scrub_unlock(sp);
+    return res;
+}
+
+/* Finds the bad blocks in num blocks from lba. When known_bad is true the
+ * range as a whole is already known to fail. Uses the reported lba when
+ * the device gives one, else bisects. Returns 0 unless a non-medium error
+ * occurs; *nbadp is increased by the bad blocks found. */
+static int
+scrub_bisect(struct vscrub_job * jp, uint64_t lba, uint32_t num,
+             bool known_bad, uint64_t * nbadp)
+{
+    int res;
+    uint32_t half;
+    uint64_t info, nbad;
+    struct vscrub * sp = jp->sp;
+
+    while (num > 0) {
+        if (! known_bad) {
+            info = 0;
+            res = scrub_verify(sp, lba, num, &info);
+            if (0 == res)
+                return 0;
+            if (SG_LIB_CAT_MEDIUM_HARD_WITH_INFO == res) {
+                if ((info >= lba) && (info < (lba + num))) {
+                    /* blocks before the reported one are good */
+                    scrub_bad_blk(jp, info);
+                    ++*nbadp;
+                    num -= (uint32_t)(info + 1 - lba);
+                    lba = info + 1;
+                    continue;
+                }
+            } else if (SG_LIB_CAT_MEDIUM_HARD != res)
+                return res;
+        }
+        if (1 == num) {
+            scrub_bad_blk(jp, lba);
+            ++*nbadp;
+            return 0;
+        }
+        half = num / 2;
+        nbad = 0;
+        res = scrub_bisect(jp, lba, half, false, &nbad);
+        if (res)
+            return res;
+        *nbadp += nbad;
+        /* if the first half was clean then the second half must fail */
+        known_bad = (0 == nbad);
+        lba += half;
+        num -= half;
+    }
+    return 0;
+}
+
+static void *
+scrub_worker(void * v_sp)
+{
+    int res;
+    uint32_t num;
+    uint64_t lba, nbad, now;
+    struct vscrub * sp = (struct vscrub *)v_sp;
+    struct vscrub_job job;
+
+    memset(&job, 0, sizeof(job));
+    job.sp = sp;
+    scrub_lock(sp);
+    job.id = sp->num_ids++;
+    sp->inflight[job.id] = UINT64_MAX;
+    scrub_unlock(sp);
+    while (true) {
+        scrub_lock(sp);
+        if (sp->stop || (sp->next_lba >= sp->end_lba)) {
+            scrub_unlock(sp);
+            break;
+        }
+        lba = sp->next_lba;
+        num = (sp->end_lba - lba > sp->chunk) ? sp->chunk :
+              (uint32_t)(sp->end_lba - lba);
+        sp->next_lba += num;
+        sp->inflight[job.id] = lba;
+        scrub_unlock(sp);
+
+        nbad = 0;
+        res = scrub_bisect(&job, lba, num, false, &nbad);
+        scrub_flush_run(&job);
+        scrub_lock(sp);
+        if (res) {
+            if (0 == sp->ret) {
+                sp->ret = res;
+                pr2serr("VERIFY(16) failed in chunk at lba=0x%" PRIx64 ", "
+                        "stopping\n", lba);
+            }
+            sp->stop = true;    /* chunk stays in flight for checkpoint */
+        } else {
+            sp->blks_done += num;
+            sp->inflight[job.id] = UINT64_MAX;
+            now = sg_pt_lat_now_ns();
+            if (now >= sp->ck_ns + (uint64_t)CHECKPOINT_SECS * 1000000000) {
+                sp->ck_ns = now;
+                scrub_checkpoint(sp);
+                if (sp->vb)
+                    pr2serr("scrub: checkpoint at lba 0x%" PRIx64 ", %" PRIu64
+                            " bad blocks so far\n", scrub_low_water(sp),
+                            sp->bad_blks);
+            }
+        }
+        scrub_unlock(sp);
+    }
+    return NULL;
+}
+
+/* Chunk size for --scrub when --bpc= is not given: the Block Limits
+ * optimal transfer length, else its maximum transfer length, else
+ * DEF_SCRUB_BPC. A given bpc is reduced to the maximum transfer length. */
+static uint32_t
+scrub_get_chunk(struct sg_dev_sess * dsp, int bpc, bool bpc_given,
+                int verbose)
+{
+    uint32_t max_tl, opt_tl, chunk;
+    const struct sg_ds_blk_lim * blp;
+
+    chunk = bpc_given ? (uint32_t)bpc : DEF_SCRUB_BPC;
+    if (sg_ds_get_blk_lim(dsp, &blp)) {
+        if (verbose)
+            pr2serr("No usable Block Limits VPD page, so %u blocks per "
+                    "VERIFY\n", chunk);
+        return chunk;
+    }
+    max_tl = blp->max_xfer_len;
+    opt_tl = blp->opt_xfer_len;
+    if (! bpc_given) {
+        if (opt_tl)
+            chunk = opt_tl;
+        else if (max_tl)
+            chunk = max_tl;
+    }
+    if (max_tl && (chunk > max_tl)) {
+        if (bpc_given)
+            pr2serr("--bpc=%u exceeds maximum transfer length, reduced to "
+                    "%u\n", chunk, max_tl);
+        chunk = max_tl;
+    }
+    if (verbose)
+        pr2serr("Block limits: maximum transfer length: %u, optimal: %u, so "
+                "%u blocks per VERIFY\n", max_tl, opt_tl, chunk);
+    return chunk;
+}
+
+/* Scrubs count blocks from lba (to the end of DEVICE when count is 0) with
+ * up to num_jobs VERIFY(16) commands outstanding. Returns 0 if all good,
+ * SG_LIB_CAT_MEDIUM_HARD if bad blocks were found, else the first
+ * non-medium error. */
+static int
+scrub_run(struct vscrub * sp, uint64_t lba, uint64_t count, int bpc,
+          bool bpc_given, int num_jobs, const char * bad_fn)
+{
+    int res;
+    uint64_t last_lba;
+    uint64_t start_ns, el_ns;
+    const struct sg_ds_cap * cp;
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    res = sg_ds_get_cap(sp->dsp, &cp);
+    if (res) {
+        pr2serr("READ CAPACITY failed, needed by --scrub\n");
+        return (res < 0) ? sg_convert_errno(-res) : res;
+    }
+    last_lba = cp->num_blocks - 1;
+    if ((lba > last_lba) || (count > (last_lba + 1 - lba))) {
+        pr2serr("lba 0x%" PRIx64 " and count %" PRIu64 " go past the last "
+                "lba (0x%" PRIx64 ")\n", lba, count, last_lba);
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    }
+    sp->end_lba = count ? (lba + count) : (last_lba + 1);
+    sp->next_lba = lba;
+    if (sp->resume_fn) {
+        res = scrub_read_resume(sp->resume_fn, lba, sp->end_lba,
+                                &sp->next_lba);
+        if (res)
+            return res;
+        if (sp->next_lba > lba)
+            pr2serr("Resuming scrub at lba 0x%" PRIx64 "\n", sp->next_lba);
+    }
+    sp->chunk = scrub_get_chunk(sp->dsp, bpc, bpc_given, sp->vb);
+    if (bad_fn) {
+        if (NULL == (sp->bad_fp = fopen(bad_fn, "a"))) {
+            pr2serr("unable to open %s: %s\n", bad_fn, safe_strerror(errno));
+            return sg_convert_errno(errno);
+        }
+    }
+    if (sp->vb)
+        pr2serr("Scrub from lba 0x%" PRIx64 " to 0x%" PRIx64 " with %d "
+                "job%s\n", sp->next_lba, sp->end_lba - 1, num_jobs,
+                (1 == num_jobs) ? "" : "s");
+    start_ns = sg_pt_lat_now_ns();
+    sp->ck_ns = start_ns;
+    lba = sp->next_lba;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&sp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, scrub_worker, sp))) {
+            if (sp->vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    scrub_worker(sp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&sp->mtx);
+#else
+    if (num_jobs) { ; }  /* suppress warning */
+    scrub_worker(sp);
+#endif
+    el_ns = sg_pt_lat_now_ns() - start_ns;
+    if (sp->bad_fp)
+        fclose(sp->bad_fp);
+    if (sp->resume_fn) {
+        if (sp->ret)
+            scrub_checkpoint(sp);
+        else if ((0 != remove(sp->resume_fn)) && (ENOENT != errno))
+            pr2serr("unable to remove %s: %s\n", sp->resume_fn,
+                    safe_strerror(errno));
+    }
+    if ((! sp->quiet) || sp->vb) {
+        pr2serr("Scrubbed %" PRIu64 " blocks from lba 0x%" PRIx64 " with %"
+                PRIu64 " VERIFY(16) commands", sp->blks_done, lba,
+                sp->num_cmds);
+        if (el_ns > 0)
+            pr2serr(", %.1f MB/sec",
+                    ((double)sp->blks_done * sp->lb_size) / (el_ns / 1000.0));
+        pr2serr("\n    bad blocks: %" PRIu64 " in %" PRIu64 " extent%s\n",
+                sp->bad_blks, sp->bad_exts, (1 == sp->bad_exts) ? "" : "s");
+    }
+    if (sp->ret)
+        return sp->ret;
+    return sp->bad_blks ? SG_LIB_CAT_MEDIUM_HARD : 0;
+}
+
 int
 main(int argc, char * argv[])
 {
@@ -133,6 +628,8 @@ main(int argc, char * argv[])
     bool got_stdin = false;
     bool quiet = false;
     bool readonly = false;
+    bool count_given = false;
+    bool scrub = false;
     bool verbose_given = false;
     bool verify16 = false;
     bool version_given = false;
@@ -145,9 +642,15 @@ main(int argc, char * argv[])
     int verbose = 0;
     int ret = 0;
     int vrprotect = 0;
+    int lb_size = 512;
+    int num_jobs = 0;
     unsigned int info = 0;
     int64_t count = 1;
     int64_t ll;
+    int64_t rate_bps = 0;
+    int64_t rate_iops = 0;
+    int64_t rate_lat_us = 0;
+    uint64_t lat_start;
     int64_t orig_count;
     uint64_t info64 = 0;
     uint64_t lba = 0;
@@ -156,14 +659,19 @@ main(int argc, char * argv[])
     uint8_t * free_ref_data = NULL;
     const char * device_name = NULL;
     const char * file_name = NULL;
+    const char * bad_fn = NULL;
+    const char * resume_fn = NULL;
     const char * vc;
     char ebuff[EBUFF_SZ];
+    struct sg_pt_rate rate_lim;
+    struct sg_dev_sess ds;
+    struct vscrub scrub_st;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:B:c:dE:g:hi:l:n:P:qrSvV", long_options,
-                        &option_index);
+        c = getopt_long(argc, argv, "b:B:c:de:E:g:hi:I:j:l:L:n:P:qrR:sSu:vV",
+                        long_options, &option_index);
         if (c == -1)
             break;
 
@@ -182,10 +690,14 @@ main(int argc, char * argv[])
                 pr2serr("bad argument to '--count'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+            count_given = true;
             break;
         case 'd':
             dpo = true;
             break;
+        case 'e':
+            bad_fn = optarg;
+            break;
         case 'E':
             bytchk = sg_get_num(optarg);
             if ((bytchk < 1) || (bytchk > 3)) {
@@ -207,6 +719,21 @@ main(int argc, char * argv[])
         case 'i':
             file_name = optarg;
             break;
+        case 'I':
+            rate_iops = sg_get_llnum(optarg);
+            if (rate_iops < 0) {
+                pr2serr("bad argument to '--iops'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             ll = sg_get_llnum(optarg);
             if (-1 == ll) {
@@ -215,6 +742,13 @@ main(int argc, char * argv[])
             }
             lba = (uint64_t)ll;
             break;
+        case 'L':
+            rate_lat_us = sg_get_llnum(optarg);
+            if (rate_lat_us < 0) {
+                pr2serr("bad argument to '--rate-lat'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'n':       /* number of bytes in data-out buffer */
         case 'B':       /* undocumented, old --bytchk=NDO option */
             ndo = sg_get_num(optarg);
@@ -241,9 +775,22 @@ main(int argc, char * argv[])
         case 'r':
             readonly = true;
             break;
+        case 'R':
+            rate_bps = sg_get_llnum(optarg);
+            if (rate_bps < 0) {
+                pr2serr("bad argument to '--rate'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 's':
+            scrub = true;
+            break;
         case 'S':
             verify16 = false;
             break;
+        case 'u':
+            resume_fn = optarg;
+            break;
         case 'v':
             verbose_given = true;
             ++verbose;
@@ -290,6 +837,22 @@ main(int argc, char * argv[])
         return 0;
     }
 
+    if (scrub) {
+        if (ndo > 0) {
+            pr2serr("--scrub does not compare data so --ndo= is not "
+                    "allowed\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (! count_given)
+            count = 0;          /* to the end of DEVICE */
+        if (0 == num_jobs)
+            num_jobs = DEF_JOBS;
+        verify16 = true;
+    } else if (num_jobs || bad_fn || resume_fn) {
+        pr2serr("--jobs=, --bad= and --resume= need --scrub\n");
+        return SG_LIB_CONTRADICT;
+    }
+
     if (ndo > 0) {
         if (0 == bytchk)
             bytchk = 1;
@@ -311,6 +874,11 @@ main(int argc, char * argv[])
         return SG_LIB_CONTRADICT;
     }
 
+    if ((rate_lat_us > 0) && (0 == rate_bps) && (0 == rate_iops)) {
+        pr2serr("--rate-lat= needs --rate= or --iops=\n");
+        return SG_LIB_CONTRADICT;
+    }
+
     if ((bpc > 0xffff) && (! verify16)) {
         pr2serr("'%s' exceeds 65535, so use VERIFY(16)\n",
                 (ndo > 0) ? "count" : "bpc");
@@ -379,9 +947,36 @@ main(int argc, char * argv[])
         goto err_out;
     }
 
+    sg_ds_init(&ds, sg_fd, (verbose > 1) ? verbose - 1 : 0);
+    if (scrub || (rate_bps > 0))
+        lb_size = get_lb_size(&ds);
+    sg_pt_rate_init(&rate_lim, (uint64_t)rate_bps, (uint64_t)rate_iops,
+                    (uint64_t)rate_lat_us * 1000);
+
+    if (scrub) {
+        memset(&scrub_st, 0, sizeof(scrub_st));
+        scrub_st.quiet = quiet;
+        scrub_st.dpo = dpo;
+        scrub_st.sg_fd = sg_fd;
+        scrub_st.dsp = &ds;
+        scrub_st.vrprotect = vrprotect;
+        scrub_st.group = group;
+        scrub_st.lb_size = lb_size;
+        scrub_st.vb = verbose;
+        scrub_st.rate_lat_us = rate_lat_us;
+        scrub_st.rlp = &rate_lim;
+        scrub_st.resume_fn = resume_fn;
+        ret = scrub_run(&scrub_st, lba, (uint64_t)count, bpc, bpc_given,
+                        num_jobs, bad_fn);
+        goto err_out;
+    }
+
     vc = verify16 ? "VERIFY(16)" : "VERIFY(10)";
     for (; count > 0; count -= bpc, lba += bpc) {
         num = (count > bpc) ? bpc : count;
+        sg_pt_rate_sleep(sg_pt_rate_take(&rate_lim,
+                                         (uint64_t)num * lb_size));
+        lat_start = rate_lat_us ? sg_pt_lat_now_ns() : 0;
         if (verify16)
             res = sg_ll_verify16(sg_fd, vrprotect, dpo, bytchk,
                                  lba, num, group, ref_data,
@@ -390,6 +985,8 @@ main(int argc, char * argv[])
             res = sg_ll_verify10(sg_fd, vrprotect, dpo, bytchk,
                                  (unsigned int)lba, num, ref_data,
                                  ndo, &info, !quiet, verbose);
+        if (lat_start)
+            sg_pt_rate_update(&rate_lim, sg_pt_lat_now_ns() - lat_start);
         if (0 != res) {
             char b[80];
 
@@ -426,6 +1023,14 @@ main(int argc, char * argv[])
         }
     }
 
+    if (verbose && (rate_bps || rate_iops)) {
+        pr2serr("rate limit: %" PRIu64 " waits totalling %.3f seconds",
+                rate_lim.waits, rate_lim.wait_ns / 1e9);
+        if (rate_lat_us)
+            pr2serr(", latency backoffs=%" PRIu64 ", smoothed latency=%.1f "
+                    "us", rate_lim.backoffs, rate_lim.ewma_ns / 1000.0);
+        pr2serr("\n");
+    }
     if (verbose && (0 == ret) && (orig_count > 1))
         pr2serr("Verified %" PRId64 " [0x%" PRIx64 "] blocks from lba %" PRIu64
                 " [0x%" PRIx64 "]\n    without error\n", orig_count,
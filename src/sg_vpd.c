@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006-2019 Douglas Gilbert.
+ * Copyright (c) 2006-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 #include <ctype.h>
 #include <getopt.h>
 #define __STDC_FORMAT_MACROS 1
@@ -28,7 +29,9 @@
 
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
+#include "sg_json.h"
 #include "sg_pr2serr.h"
 
 /* This utility program was originally written for the Linux OS SCSI subsystem.
@@ -40,7 +43,7 @@
 
 */
 
-static const char * version_str = "1.54 20190516";  /* spc5r22 + sbc4r17 */
+static const char * version_str = "1.55 20261014";  /* spc5r22 + sbc4r17 */
 
 /* standard VPD pages, in ascending page number order */
 #define VPD_SUPPORTED_VPDS 0x0
@@ -106,6 +109,8 @@ static const char * version_str = "1.54 20190516";  /* spc5r22 + sbc4r17 */
  * sg_vpd_vendor.c . Take care that both are the same. */
 struct opts_t {
     bool do_all;
+    bool do_batch;
+    bool do_cbor;       /* --json output as CBOR */
     bool do_enum;
     bool do_force;
     bool do_long;
@@ -124,6 +129,8 @@ struct opts_t {
     const char * page_str;
     const char * inhex_fn;
     const char * vend_prod;
+    int do_json;        /* twice: pretty printed */
+    struct sgj_state * jsp;     /* with --json */
 };
 
 struct svpd_values_name_t {
@@ -164,6 +171,8 @@ static uint8_t * free_rsp_buff;
 
 static struct option long_options[] = {
         {"all", no_argument, 0, 'a'},
+        {"batch", no_argument, 0, 'b'},
+        {"cbor", no_argument, 0, 'y'},
         {"enumerate", no_argument, 0, 'e'},
         {"examine", no_argument, 0, 'E'},
         {"force", no_argument, 0, 'f'},
@@ -171,6 +180,7 @@ static struct option long_options[] = {
         {"hex", no_argument, 0, 'H'},
         {"ident", no_argument, 0, 'i'},
         {"inhex", required_argument, 0, 'I'},
+        {"json", no_argument, 0, 'J'},
         {"long", no_argument, 0, 'l'},
         {"maxlen", required_argument, 0, 'm'},
         {"page", required_argument, 0, 'p'},
@@ -248,17 +258,23 @@ static struct svpd_values_name_t standard_vpd_pg[] = {
 static void
 usage()
 {
-    pr2serr("Usage: sg_vpd  [--all] [--enumerate] [--examine] [--force] "
-            "[--help] [--hex]\n"
-            "               [--ident] [--inhex=FN] [--long] [--maxlen=LEN] "
-            "[--page=PG]\n"
-            "               [--quiet] [--raw] [--vendor=VP] [--verbose] "
-            "[--version]\n"
-            "               DEVICE\n");
+    pr2serr("Usage: sg_vpd  [--all] [--batch] [--cbor] [--enumerate] "
+            "[--examine]\n"
+            "               [--force] [--help] [--hex] [--ident] [--inhex=FN] "
+            "[--json]\n"
+            "               [--long] [--maxlen=LEN] [--page=PG] [--quiet] "
+            "[--raw]\n"
+            "               [--vendor=VP] [--verbose] [--version] DEVICE\n");
     pr2serr("  where:\n"
             "    --all|-a        output all pages listed in the supported "
             "pages VPD\n"
             "                    page\n"
+            "    --batch|-b      with --all: fetch all those pages together, "
+            "each with\n"
+            "                    a maximum length allocation, then decode "
+            "them\n"
+            "    --cbor|-y       as --json but output in CBOR (compact "
+            "binary)\n"
             "    --enumerate|-e    enumerate known VPD pages names (ignore "
             "DEVICE),\n"
             "                      can be used with --page=num to search\n"
@@ -275,6 +291,8 @@ usage()
             "DEVICE;\n"
             "                        if used with --raw then read binary "
             "from FN\n"
+            "    --json|-J       output each VPD page as a line of JSON "
+            "(twice: indented)\n"
             "    --long|-l       perform extra decoding\n"
             "    --maxlen=LEN|-m LEN    max response length (allocation "
             "length in cdb)\n"
@@ -401,13 +419,19 @@ sdp_get_vpd_detail(int page_num, int subvalue, int pdt)
 static const struct svpd_values_name_t *
 sdp_find_vpd_by_acron(const char * ap)
 {
-    const struct svpd_values_name_t * vnp;
-
-    for (vnp = standard_vpd_pg; vnp->acron; ++vnp) {
-        if (0 == strcmp(vnp->acron, ap))
-            return vnp;
-    }
-    return NULL;
+    int k;
+    static struct sg_lib_acron_idx acron_idx;
+    static struct sg_lib_acron_ent
+                acron_ent_arr[SG_ARRAY_SIZE(standard_vpd_pg)];
+
+    if (NULL == acron_idx.arr)   /* built on first use */
+        sg_lib_acron_idx_build(&acron_idx, acron_ent_arr, standard_vpd_pg,
+                               SG_ARRAY_SIZE(standard_vpd_pg),
+                               sizeof(standard_vpd_pg[0]),
+                               offsetof(struct svpd_values_name_t, acron),
+                               false);
+    k = sg_lib_acron_idx_find(&acron_idx, ap);
+    return (k < 0) ? NULL : (standard_vpd_pg + acron_ent_arr[k].ind);
 }
 
 static void
@@ -2661,6 +2685,163 @@ svpd_unable_to_decode(int sg_fd, struct opts_t * op, int subvalue, int off)
     return res;
 }
 
+/* Implements --json: fetches (unless already in rp) VPD page pn and
+ * outputs it as one JSON object. Some pages are decoded into named fields,
+ * the others are output as "hex". Returns 0 if successful. */
+static int
+svpd_json_page(int sg_fd, struct opts_t * op, int pn, uint8_t * rp)
+{
+    int res, len, k, n, pdt, off, c_set, d_len;
+    struct sgj_state * jsp = op->jsp;
+    const uint8_t * bp;
+    const struct svpd_values_name_t * vnp;
+    char b[64];
+
+    n = op->maxlen;
+    if ((VPD_ATA_INFO == pn) && (0 == n))
+        n = VPD_ATA_INFO_LEN;
+    res = vpd_fetch_page(sg_fd, rp, pn, n, op->do_quiet, op->verbose, &len);
+    if (res)
+        return res;
+    pdt = rp[0] & 0x1f;
+    vnp = sdp_get_vpd_detail(pn, -1, pdt);
+    if ((NULL == vnp) && (op->vend_prod_num >= 0))
+        vnp = svpd_find_vendor_by_num(pn, op->vend_prod_num);
+    sgj_begin_obj(jsp, NULL);
+    if (op->device_name)
+        sgj_add_str(jsp, "device", op->device_name);
+    sgj_add_uint(jsp, "page_code", pn);
+    if (vnp) {
+        sgj_add_str(jsp, "name", vnp->name);
+        sgj_add_str(jsp, "acronym", vnp->acron);
+    }
+    sgj_add_uint(jsp, "peripheral_qualifier", (rp[0] & 0xe0) >> 5);
+    sgj_add_uint(jsp, "peripheral_device_type", pdt);
+    bp = rp + 4;
+    n = len - 4;
+    switch (pn) {
+    case VPD_SUPPORTED_VPDS:
+        if (n > rp[3])
+            n = rp[3];
+        sgj_begin_arr(jsp, "supported_pages");
+        for (k = 0; k < n; ++k) {
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_uint(jsp, "page_code", bp[k]);
+            vnp = sdp_get_vpd_detail(bp[k], -1, pdt);
+            if (vnp)
+                sgj_add_str(jsp, "acronym", vnp->acron);
+            sgj_end_obj(jsp);
+        }
+        sgj_end_arr(jsp);
+        break;
+    case VPD_UNIT_SERIAL_NUM:
+        for (k = 0; (k < n) && (' ' == bp[k]); ++k)
+            ;   /* serial numbers are often right aligned */
+        sgj_add_strn(jsp, "unit_serial_number", (const char *)bp + k,
+                     n - k);
+        break;
+    case VPD_DEVICE_ID:
+        sgj_begin_arr(jsp, "designation_descriptors");
+        for (off = -1; 0 == sg_vpd_dev_id_iter(bp, n, &off, -1, -1, -1); ) {
+            const uint8_t * dp = bp + off;
+
+            c_set = dp[0] & 0xf;
+            d_len = dp[3];
+            sgj_begin_obj(jsp, NULL);
+            sgj_add_uint(jsp, "association", (dp[1] >> 4) & 0x3);
+            sgj_add_str(jsp, "association_name",
+                        sg_get_desig_assoc_str((dp[1] >> 4) & 0x3));
+            sgj_add_uint(jsp, "designator_type", dp[1] & 0xf);
+            sgj_add_str(jsp, "designator_type_name",
+                        sg_get_desig_type_str(dp[1] & 0xf));
+            sgj_add_uint(jsp, "code_set", c_set);
+            if (dp[1] & 0x80) {         /* PIV */
+                sgj_add_uint(jsp, "protocol_identifier", dp[0] >> 4);
+                sgj_add_str(jsp, "protocol_identifier_name",
+                             sg_get_trans_proto_str(dp[0] >> 4, sizeof(b),
+                                                    b));
+            }
+            if ((2 == c_set) || (3 == c_set))   /* ASCII or UTF-8 */
+                sgj_add_strn(jsp, "designator", (const char *)dp + 4,
+                             d_len);
+            else
+                sgj_add_hex(jsp, "designator", dp + 4, d_len);
+            sgj_end_obj(jsp);
+        }
+        sgj_end_arr(jsp);
+        break;
+    case VPD_BLOCK_LIMITS:
+        if ((len < 16) || ((PDT_DISK != pdt) && (PDT_ZBC != pdt)))
+            goto as_hex;
+        sgj_add_bool(jsp, "wsnz", !!(rp[4] & 0x1));
+        sgj_add_uint(jsp, "maximum_compare_and_write_length", rp[5]);
+        sgj_add_uint(jsp, "optimal_transfer_length_granularity",
+                     sg_get_unaligned_be16(rp + 6));
+        sgj_add_uint(jsp, "maximum_transfer_length",
+                     sg_get_unaligned_be32(rp + 8));
+        sgj_add_uint(jsp, "optimal_transfer_length",
+                     sg_get_unaligned_be32(rp + 12));
+        if (len < 20)
+            break;
+        sgj_add_uint(jsp, "maximum_prefetch_length",
+                     sg_get_unaligned_be32(rp + 16));
+        if (len < 36)
+            break;
+        sgj_add_uint(jsp, "maximum_unmap_lba_count",
+                     sg_get_unaligned_be32(rp + 20));
+        sgj_add_uint(jsp, "maximum_unmap_block_descriptor_count",
+                     sg_get_unaligned_be32(rp + 24));
+        sgj_add_uint(jsp, "optimal_unmap_granularity",
+                     sg_get_unaligned_be32(rp + 28));
+        sgj_add_bool(jsp, "ugavalid", !!(rp[32] & 0x80));
+        sgj_add_uint(jsp, "unmap_granularity_alignment",
+                     0x7fffffff & sg_get_unaligned_be32(rp + 32));
+        if (len < 44)
+            break;
+        sgj_add_uint(jsp, "maximum_write_same_length",
+                     sg_get_unaligned_be64(rp + 36));
+        break;
+    case VPD_BLOCK_DEV_CHARS:
+        if ((len < 64) || ((PDT_DISK != pdt) && (PDT_ZBC != pdt)))
+            goto as_hex;
+        sgj_add_uint(jsp, "medium_rotation_rate",
+                     sg_get_unaligned_be16(rp + 4));
+        sgj_add_uint(jsp, "product_type", rp[6]);
+        sgj_add_uint(jsp, "wabereq", (rp[7] >> 6) & 0x3);
+        sgj_add_uint(jsp, "wacereq", (rp[7] >> 4) & 0x3);
+        sgj_add_uint(jsp, "nominal_form_factor", rp[7] & 0xf);
+        sgj_add_uint(jsp, "zoned", (rp[8] >> 4) & 0x3);
+        sgj_add_bool(jsp, "rbwz", !!(rp[8] & 0x8));
+        sgj_add_bool(jsp, "bocs", !!(rp[8] & 0x4));
+        sgj_add_bool(jsp, "fuab", !!(rp[8] & 0x2));
+        sgj_add_bool(jsp, "vbuls", !!(rp[8] & 0x1));
+        sgj_add_uint(jsp, "depopulation_time",
+                     sg_get_unaligned_be32(rp + 12));
+        break;
+    case VPD_LB_PROVISIONING:
+        if ((len < 8) || ((PDT_DISK != pdt) && (PDT_ZBC != pdt)))
+            goto as_hex;
+        sgj_add_uint(jsp, "threshold_exponent", rp[4]);
+        sgj_add_bool(jsp, "lbpu", !!(rp[5] & 0x80));
+        sgj_add_bool(jsp, "lbpws", !!(rp[5] & 0x40));
+        sgj_add_bool(jsp, "lbpws10", !!(rp[5] & 0x20));
+        sgj_add_uint(jsp, "lbprz", 0x7 & (rp[5] >> 2));
+        sgj_add_bool(jsp, "anc_sup", !!(rp[5] & 0x2));
+        sgj_add_bool(jsp, "dp", !!(rp[5] & 0x1));
+        sgj_add_uint(jsp, "minimum_percentage", 0x1f & (rp[6] >> 3));
+        sgj_add_uint(jsp, "provisioning_type", rp[6] & 0x7);
+        sgj_add_str(jsp, "provisioning_type_name", prov_type_arr[rp[6] & 0x7]);
+        sgj_add_uint(jsp, "threshold_percentage", rp[7]);
+        break;
+    default:
+as_hex:
+        sgj_add_hex(jsp, "hex", bp, n);
+        break;
+    }
+    sgj_end_obj(jsp);
+    return 0;
+}
+
 /* Returns 0 if successful. If don't know how to decode, returns
  * SG_LIB_CAT_OTHER else see sg_ll_inquiry(). */
 static int
@@ -2718,6 +2899,8 @@ svpd_decode_t10(int sg_fd, struct opts_t * op, int subvalue, int off,
             return sg_convert_errno(EDOM);
         }
     }
+    if (op->jsp)
+        return svpd_json_page(sg_fd, op, pn, rp);
     switch(pn) {
     case VPD_NOPE_WANT_STD_INQ:    /* -2 (want standard inquiry response) */
         if (sg_fd >= 0) {
@@ -3406,6 +3589,183 @@ svpd_decode_t10(int sg_fd, struct opts_t * op, int subvalue, int off,
     return res;
 }
 
+/* Fetches the 'num' VPD pages in pn_arr[] in one batch of INQUIRY
+ * commands (sent together where the pass-through allows), each with an
+ * allocation length big enough to avoid a second, full length, fetch.
+ * Pages that are fetched intact are appended to *bufp (whose length is
+ * returned) and their offsets are placed in off_arr[]; other pages have
+ * -1 placed there. Returns -1 if the batch could not be set up (e.g. out
+ * of memory), else the (possibly 0) number of bytes in *bufp. */
+static int
+vpd_fetch_batch(int sg_fd, const int * pn_arr, int num, struct opts_t * op,
+                uint8_t ** bufp, int * off_arr)
+{
+    int k, ret, len, rlen, sense_cat, n_done;
+    int alloc_len = (op->maxlen > 0) ? op->maxlen : MX_ALLOC_LEN;
+    int total = 0;
+    int vb = op->verbose;
+    uint8_t * rp;
+    uint8_t * bp;
+    uint8_t * cdb_arr;
+    uint8_t * sense_arr;
+    struct sg_pt_base ** ptp_arr;
+
+    *bufp = NULL;
+    bp = (uint8_t *)calloc(num, alloc_len);
+    cdb_arr = (uint8_t *)calloc(num, INQUIRY_CMDLEN);
+    sense_arr = (uint8_t *)calloc(num, SENSE_BUFF_LEN);
+    ptp_arr = (struct sg_pt_base **)calloc(num, sizeof(*ptp_arr));
+    if ((NULL == bp) || (NULL == cdb_arr) || (NULL == sense_arr) ||
+        (NULL == ptp_arr)) {
+        pr2serr("%s: out of memory\n", __func__);
+        ret = -1;
+        goto fini;
+    }
+    for (k = 0; k < num; ++k) {
+        ptp_arr[k] = construct_scsi_pt_obj_with_fd(sg_fd, vb);
+        if (NULL == ptp_arr[k]) {
+            pr2serr("%s: out of memory\n", __func__);
+            ret = -1;
+            goto fini;
+        }
+        rp = cdb_arr + (k * INQUIRY_CMDLEN);
+        rp[0] = INQUIRY_CMD;
+        rp[1] = 0x1;    /* EVPD */
+        rp[2] = (uint8_t)pn_arr[k];
+        sg_put_unaligned_be16((uint16_t)alloc_len, rp + 3);
+        set_scsi_pt_cdb(ptp_arr[k], rp, INQUIRY_CMDLEN);
+        set_scsi_pt_sense(ptp_arr[k], sense_arr + (k * SENSE_BUFF_LEN),
+                          SENSE_BUFF_LEN);
+        set_scsi_pt_data_in(ptp_arr[k], bp + (k * alloc_len), alloc_len);
+        set_scsi_pt_packet_id(ptp_arr[k], k + 1);
+    }
+    n_done = 0;
+    ret = do_scsi_pt_batch(ptp_arr, num, DEF_PT_TIMEOUT, &n_done, vb);
+    if (ret && vb)
+        pr2serr("%s: only %d of %d INQUIRYs issued\n", __func__, n_done,
+                num);
+    if (vb > 1)
+        pr2serr("%s: %d VPD pages fetched in one batch\n", __func__, n_done);
+    /* pack the good responses toward the front of bp, in order */
+    for (k = 0; k < num; ++k) {
+        off_arr[k] = -1;
+        if (k >= n_done)
+            continue;
+        rp = bp + (k * alloc_len);
+        rlen = sg_cmds_process_resp(ptp_arr[k], "inquiry", 0, false, vb,
+                                    &sense_cat);
+        if ((-2 == rlen) && ((SG_LIB_CAT_RECOVERED == sense_cat) ||
+                             (SG_LIB_CAT_NO_SENSE == sense_cat)))
+            rlen = alloc_len - get_scsi_pt_resid(ptp_arr[k]);
+        if ((rlen < 4) || (pn_arr[k] != rp[1]))
+            continue;   /* failed or malformed: fetched again alone */
+        if ((0x80 == pn_arr[k]) && (0x2 == rp[2]) && (0x2 == rp[3]))
+            continue;   /* probably standard INQUIRY response */
+        len = sg_get_unaligned_be16(rp + 2) + 4;
+        if (len > rlen) {
+            if (0 == op->maxlen)
+                continue;       /* longer than MX_ALLOC_LEN */
+            len = rlen;
+        }
+        if (total != (k * alloc_len))
+            memmove(bp + total, rp, len);
+        off_arr[k] = total;
+        total += len;
+    }
+    ret = total;
+    *bufp = bp;
+    bp = NULL;
+fini:
+    if (ptp_arr) {
+        for (k = 0; k < num; ++k) {
+            if (ptp_arr[k])
+                destruct_scsi_pt_obj(ptp_arr[k]);
+        }
+        free(ptp_arr);
+    }
+    free(sense_arr);
+    free(cdb_arr);
+    free(bp);
+    return ret;
+}
+
+/* Decodes the pages listed in the Supported VPD pages page (vpd0p) as
+ * svpd_decode_all() does, but having fetched them with vpd_fetch_batch().
+ * Those are decoded as if they had come from --inhex=FN ; any that could
+ * not be fetched that way are fetched (and reported) one at a time. */
+static int
+svpd_decode_all_batch(int sg_fd, struct opts_t * op, const uint8_t * vpd0p,
+                      int n, int max_pn)
+{
+    int k, j, res, num, blen;
+    int any_err = 0;
+    int maxlen = op->maxlen;
+    int pn_arr[256];
+    int off_arr[256];
+    uint8_t * bp = NULL;
+    uint8_t * sv_rsp_buff = rsp_buff;
+
+    for (k = 0, num = 0; k < n; ++k) {
+        if ((vpd0p[4 + k] <= max_pn) && (vpd0p[4 + k] > VPD_SUPPORTED_VPDS))
+            pn_arr[num++] = vpd0p[4 + k];
+    }
+    blen = (num > 0) ? vpd_fetch_batch(sg_fd, pn_arr, num, op, &bp,
+                                       off_arr) : 0;
+    if (blen < 0)
+        return sg_convert_errno(ENOMEM);
+    for (k = 0, j = 0; k < n; ++k) {
+        op->vpd_pn = vpd0p[4 + k];
+        if (op->vpd_pn > max_pn)
+            continue;
+        if ((k > 0) && (! op->jsp))
+            printf("\n");
+        if (op->do_long)
+            printf("[0x%x] ", op->vpd_pn);
+        if (VPD_SUPPORTED_VPDS == op->vpd_pn) {
+            /* the page already fetched is decoded from a copy */
+            rsp_buff = (uint8_t *)vpd0p;
+            op->maxlen = n + 4;
+            res = svpd_decode_t10(-1, op, 0, 0, NULL);
+        } else if ((j < num) && (op->vpd_pn == pn_arr[j]) &&
+                   (off_arr[j] >= 0)) {
+            /* decoders take their response from rsp_buff + off */
+            rsp_buff = bp;
+            op->maxlen = blen;
+            res = svpd_decode_t10(-1, op, 0, off_arr[j], NULL);
+            if (SG_LIB_CAT_OTHER == res) {
+                res = svpd_decode_vendor(-1, op, off_arr[j]);
+                if (SG_LIB_CAT_OTHER == res)
+                    res = svpd_unable_to_decode(-1, op, 0, off_arr[j]);
+            }
+        } else {
+            res = svpd_decode_t10(sg_fd, op, 0, 0, NULL);
+            if (SG_LIB_CAT_OTHER == res) {
+                res = svpd_decode_vendor(sg_fd, op, 0);
+                if (SG_LIB_CAT_OTHER == res)
+                    res = svpd_unable_to_decode(sg_fd, op, 0, 0);
+            }
+        }
+        if ((j < num) && (op->vpd_pn == pn_arr[j]))
+            ++j;
+        rsp_buff = sv_rsp_buff;
+        op->maxlen = maxlen;
+        if (! op->do_quiet) {
+            if (SG_LIB_CAT_ABORTED_COMMAND == res)
+                pr2serr("fetching VPD page failed, aborted command\n");
+            else if (res) {
+                char b[80];
+
+                sg_get_category_sense_str(res, sizeof(b), b, op->verbose);
+                pr2serr("fetching VPD page failed: %s\n", b);
+            }
+        }
+        if (res)
+            any_err = res;
+    }
+    free(bp);
+    return any_err;
+}
+
 static int
 svpd_decode_all(int sg_fd, struct opts_t * op)
 {
@@ -3441,12 +3801,14 @@ svpd_decode_all(int sg_fd, struct opts_t * op)
                         n + 4);
             n = (rlen - 4);
         }
+        if (op->do_batch)
+            return svpd_decode_all_batch(sg_fd, op, rp, n, max_pn);
         for (k = 0; k < n; ++k) {
             pn = rp[4 + k];
             if (pn > max_pn)
                 continue;
             op->vpd_pn = pn;
-            if (k > 0)
+            if ((k > 0) && (! op->jsp))
                 printf("\n");
             if (op->do_long)
                 printf("[0x%x] ", pn);
@@ -3574,6 +3936,7 @@ main(int argc, char * argv[])
     struct opts_t * op;
     const struct svpd_values_name_t * vnp;
     struct opts_t opts;
+    struct sgj_state json_st;
 
     op = &opts;
     memset(&opts, 0, sizeof(opts));
@@ -3582,7 +3945,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "aeEfhHiI:lm:M:p:qrvV", long_options,
+        c = getopt_long(argc, argv, "abeEfhHiI:Jlm:M:p:qrvVy", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -3591,6 +3954,9 @@ main(int argc, char * argv[])
         case 'a':
             op->do_all = true;
             break;
+        case 'b':
+            op->do_batch = true;
+            break;
         case 'e':
             op->do_enum = true;
             break;
@@ -3618,6 +3984,9 @@ main(int argc, char * argv[])
             } else
                 op->inhex_fn = optarg;
             break;
+        case 'J':
+            ++op->do_json;
+            break;
         case 'l':
             op->do_long = true;
             break;
@@ -3658,6 +4027,9 @@ main(int argc, char * argv[])
         case 'V':
             op->version_given = true;
             break;
+        case 'y':
+            op->do_cbor = true;
+            break;
         default:
             pr2serr("unrecognised option code 0x%x ??\n", c);
             usage();
@@ -3898,6 +4270,30 @@ main(int argc, char * argv[])
             goto err_out;
         }
     }
+    if (op->do_cbor && (0 == op->do_json))
+        op->do_json = 1;
+    if (op->do_json) {
+        if (op->do_hex || op->do_raw || op->do_long || op->examine ||
+            (VPD_NOPE_WANT_STD_INQ == op->vpd_pn)) {
+            pr2serr("--json and --cbor cannot be used with --hex, --raw, "
+                    "--long,\n--examine or the standard INQUIRY response "
+                    "(see sg_inq --json)\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        if (op->do_cbor) {
+            if (sg_set_binary_mode(STDOUT_FILENO) < 0)
+                perror("sg_set_binary_mode");
+            res = sgj_init_cbor(&json_st, STDOUT_FILENO);
+        } else
+            res = sgj_init(&json_st, STDOUT_FILENO, (op->do_json > 1));
+        if (res) {
+            pr2serr("Unable to allocate JSON output buffer\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto err_out;
+        }
+        op->jsp = &json_st;
+    }
 
     if (op->inhex_fn) {
         if ((0 == op->maxlen) || (inhex_len < op->maxlen))
@@ -3953,6 +4349,8 @@ main(int argc, char * argv[])
         ret = res;
     }
 err_out:
+    if (op->jsp && sgj_fini(op->jsp) && (0 == ret))
+        ret = SG_LIB_FILE_ERROR;
     if (free_rsp_buff)
         free(free_rsp_buff);
     if ((0 == op->verbose) && (! op->do_quiet)) {
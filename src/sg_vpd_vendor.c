@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -102,21 +103,28 @@
 
 struct opts_t {
     bool do_all;
+    bool do_batch;
+    bool do_cbor;       /* --json output as CBOR */
     bool do_enum;
     bool do_force;
     bool do_long;
     bool do_quiet;
+    bool verbose_given;
+    bool version_given;
     int do_hex;
-    int vpd_pn;
     int do_ident;
-    int maxlen;
     int do_raw;
+    int examine;
+    int maxlen;
     int vend_prod_num;
     int verbose;
+    int vpd_pn;
     const char * device_name;
     const char * page_str;
     const char * inhex_fn;
     const char * vend_prod;
+    int do_json;
+    struct sgj_state * jsp;
 };
 
 struct svpd_values_name_t {
@@ -145,7 +153,7 @@ struct svpd_vp_name_t {
 
 /* Supported vendor specific VPD pages */
 /* Arrange in alphabetical order by acronym */
-static struct svpd_vp_name_t vp_arr[] = {
+static const struct svpd_vp_name_t vp_arr[] = {
     {VPD_VP_DDS, "dds", "DDS tape family from IBM"},
     {VPD_VP_EMC, "emc", "EMC (company)"},
     {VPD_VP_WDC_HITACHI, "hit", "WDC/Hitachi disk"},
@@ -163,7 +171,7 @@ static struct svpd_vp_name_t vp_arr[] = {
 /* Supported vendor specific VPD pages */
 /* 'subvalue' holds vendor/product number to disambiguate */
 /* Arrange in alphabetical order by acronym */
-static struct svpd_values_name_t vendor_vpd_pg[] = {
+static const struct svpd_values_name_t vendor_vpd_pg[] = {
     {VPD_V_ACI_LTO, VPD_VP_HP_LTO, 1, "aci", "ACI revision level (HP LTO)"},
     {VPD_V_DATC_SEA, VPD_VP_SEAGATE, 0, "datc", "Date code (Seagate)"},
     {VPD_V_DCRL_LTO, VPD_VP_IBM_LTO, 1, "dcrl", "Drive component revision "
@@ -314,13 +322,19 @@ svpd_find_vp_num_by_acron(const char * vp_ap)
 const struct svpd_values_name_t *
 svpd_find_vendor_by_acron(const char * ap)
 {
-    const struct svpd_values_name_t * vnp;
-
-    for (vnp = vendor_vpd_pg; vnp->acron; ++vnp) {
-        if (0 == strcmp(vnp->acron, ap))
-            return vnp;
-    }
-    return NULL;
+    int k;
+    static struct sg_lib_acron_idx acron_idx;
+    static struct sg_lib_acron_ent
+                acron_ent_arr[SG_ARRAY_SIZE(vendor_vpd_pg)];
+
+    if (NULL == acron_idx.arr)   /* built on first use */
+        sg_lib_acron_idx_build(&acron_idx, acron_ent_arr, vendor_vpd_pg,
+                               SG_ARRAY_SIZE(vendor_vpd_pg),
+                               sizeof(vendor_vpd_pg[0]),
+                               offsetof(struct svpd_values_name_t, acron),
+                               false);
+    k = sg_lib_acron_idx_find(&acron_idx, ap);
+    return (k < 0) ? NULL : (vendor_vpd_pg + acron_ent_arr[k].ind);
 }
 
 /* if vend_prod_num < -1 then list vendor_product ids + vendor pages, =-1
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2018 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
 #include <ctype.h>
 
@@ -21,6 +22,10 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_unaligned.h"
@@ -32,7 +37,7 @@
  * mode page on the given device.
  */
 
-static const char * version_str = "1.26 20180628";
+static const char * version_str = "1.27 20261014";
 
 #define ME "sg_wr_mode: "
 
@@ -41,12 +46,20 @@ static const char * version_str = "1.26 20180628";
 
 #define EBUFF_SZ 256
 
+#define MX_PAGE_LEN 1024        /* of a mode page in a --batch= spec */
+#define MX_SPEC_LEN 4096        /* of a --batch= spec (or line of BF) */
+#define MX_BATCH_ITEMS 64
+#define DEF_JOBS 16             /* DEVICEs worked on at once */
+#define MAX_JOBS 256
+
 
 static struct option long_options[] = {
+        {"batch", required_argument, 0, 'b'},
         {"contents", required_argument, 0, 'c'},
         {"dbd", no_argument, 0, 'd'},
         {"force", no_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
+        {"jobs", required_argument, 0, 'j'},
         {"len", required_argument, 0, 'l'},
         {"mask", required_argument, 0, 'm'},
         {"page", required_argument, 0, 'p'},
@@ -62,14 +75,23 @@ static struct option long_options[] = {
 static void
 usage()
 {
-    pr2serr("Usage: sg_wr_mode [--contents=H,H...] [--dbd] [--force] "
-            "[--help]\n"
-            "                  [--len=10|6] [--mask=M,M...] "
-            "[--page=PG_H[,SPG_H]]\n"
-            "                  [--rtd] [--save] [--six] [--verbose] "
-            "[--version]\n"
-            "                  DEVICE\n"
+    pr2serr("Usage: sg_wr_mode [--batch=BS] [--contents=H,H...] [--dbd] "
+            "[--force]\n"
+            "                  [--help] [--jobs=JOBS] [--len=10|6] "
+            "[--mask=M,M...]\n"
+            "                  [--page=PG_H[,SPG_H]] [--rtd] [--save] "
+            "[--six]\n"
+            "                  [--verbose] [--version] DEVICE [DEVICE...]\n"
             "  where:\n"
+            "    --batch=BS | -b BS    BS is PG_H[,SPG_H]:H,H...[:M,M...] "
+            "(mode page,\n"
+            "                          its contents then optional mask) or "
+            "@BF where\n"
+            "                          file BF has one such spec per line; "
+            "may be\n"
+            "                          given more than once. All pages are "
+            "sent in\n"
+            "                          one MODE SELECT to each DEVICE\n"
             "    --contents=H,H... | -c H,H...    comma separated string "
             "of hex numbers\n"
             "                                     that is mode page contents "
@@ -80,6 +102,9 @@ usage()
             " in cdb)\n"
             "    --force | -f          force the contents to be written\n"
             "    --help | -h           print out usage message\n"
+            "    --jobs=JOBS | -j JOBS    with --batch=, how many DEVICEs at "
+            "once\n"
+            "                             (def: %d)\n"
             "    --len=10|6 | -l 10|6    use 10 byte (def) or 6 byte "
             "variants of\n"
             "                            SCSI MODE SENSE/SELECT commands\n"
@@ -101,7 +126,7 @@ usage()
             "    --verbose | -v        increase verbosity\n"
             "    --version | -V        print version string and exit\n\n"
             "writes given mode page with SCSI MODE SELECT (10 or 6) "
-            "command\n");
+            "command\n", DEF_JOBS);
 }
 
 
@@ -316,6 +341,420 @@ build_mask(const char * inp, uint8_t * mask_arr, int * mask_arr_len,
     return 0;
 }
 
+/* One --batch= spec: new contents (and optional mask) for a mode page */
+struct wm_item_t {
+    int pg_code;
+    int sub_pg_code;
+    int c_len;          /* bytes in contents */
+    int m_len;          /* bytes in mask, it is 0xff after that */
+    char src[80];       /* spec's source, for messages */
+    uint8_t contents[MX_PAGE_LEN];
+    uint8_t mask[MX_PAGE_LEN];
+};
+
+/* What is done to each DEVICE */
+struct wm_job_t {
+    bool force;
+    bool mode_6;
+    bool save;
+    int num_items;
+    int verbose;
+    const struct wm_item_t * items;
+};
+
+/* Progress of one DEVICE */
+struct wm_dev_t {
+    const char * dev_name;
+    char pfx[64];       /* prefixes messages when more than one DEVICE */
+    int res;
+    int num_pages;      /* mode pages in the MODE SELECT */
+    int pl_len;         /* parameter list length */
+};
+
+/* Shared by the threads working on many DEVICEs */
+struct wm_multi_t {
+    int next_dev;       /* DEVICEs taken from d_arr (atomically) */
+    int num_devs;
+    const struct wm_job_t * jp;
+    struct wm_dev_t * d_arr;
+};
+
+static struct wm_item_t wm_items[MX_BATCH_ITEMS];
+
+/* Parses a --batch= spec: PG_H[,SPG_H]:H,H...[:M,M...] . Returns 0 if ok,
+ * else a sg3_utils error code. */
+static int
+wm_parse_spec(const char * spec, const char * src, struct wm_item_t * ip)
+{
+    int n, res;
+    unsigned u, uu;
+    const char * cp;
+    const char * mp;
+    char b[MX_SPEC_LEN];
+
+    memset(ip, 0, sizeof(*ip));
+    snprintf(ip->src, sizeof(ip->src), "%s", src);
+    cp = strchr(spec, ':');
+    if ((NULL == cp) || ((cp - spec) >= (int)sizeof(b))) {
+        pr2serr("%s: expected PG_H[,SPG_H]:H,H... but got '%s'\n", src,
+                spec);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    memcpy(b, spec, cp - spec);
+    b[cp - spec] = '\0';
+    n = sscanf(b, "%x,%x", &u, &uu);
+    if ((n < 1) || (u > 62) || ((2 == n) && (uu > 254))) {
+        pr2serr("%s: bad hex page code [, subpage code]: '%s'\n", src, b);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    ip->pg_code = u;
+    ip->sub_pg_code = (2 == n) ? (int)uu : 0;
+    ++cp;
+    mp = strchr(cp, ':');
+    n = mp ? (int)(mp - cp) : (int)strlen(cp);
+    if ((0 == n) || (n >= (int)sizeof(b)) || ('-' == *cp)) {
+        pr2serr("%s: bad or missing contents\n", src);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    memcpy(b, cp, n);
+    b[n] = '\0';
+    if ((res = build_mode_page(b, ip->contents, &ip->c_len, MX_PAGE_LEN))) {
+        pr2serr("%s: bad contents\n", src);
+        return res;
+    }
+    memset(ip->mask, 0xff, sizeof(ip->mask));
+    if (mp) {
+        if (build_mask(mp + 1, ip->mask, &ip->m_len, MX_PAGE_LEN)) {
+            pr2serr("%s: bad mask\n", src);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    return 0;
+}
+
+/* Reads specs, one per line, from file fn ('-' for stdin) appending them
+ * to wm_items[]. Blank lines and those starting with '#' are ignored.
+ * Returns 0 if ok, else a sg3_utils error code. */
+static int
+wm_read_batch(const char * fn, int * num_itemsp)
+{
+    bool got_stdin = (0 == strcmp("-", fn));
+    int k, n, m;
+    int res = 0;
+    FILE * fp;
+    char * cp;
+    char line[MX_SPEC_LEN];
+    char src[80];
+
+    fp = got_stdin ? stdin : fopen(fn, "r");
+    if (NULL == fp) {
+        res = sg_convert_errno(errno);
+        pr2serr("unable to open batch file %s: %s\n", fn,
+                safe_strerror(errno));
+        return res;
+    }
+    for (k = 1; fgets(line, sizeof(line), fp); ++k) {
+        n = strlen(line);
+        if ((n > 0) && ('\n' != line[n - 1]) && (! feof(fp))) {
+            pr2serr("%s:%d: line too long\n", fn, k);
+            res = SG_LIB_SYNTAX_ERROR;
+            break;
+        }
+        if ((cp = strchr(line, '#')))
+            *cp = '\0';
+        for (n = strlen(line); (n > 0) && isspace((uint8_t)line[n - 1]);
+             --n)
+            line[n - 1] = '\0';
+        m = strspn(line, " \t");
+        if ('\0' == line[m])
+            continue;
+        if (*num_itemsp >= MX_BATCH_ITEMS) {
+            pr2serr("%s:%d: too many specs, maximum is %d\n", fn, k,
+                    MX_BATCH_ITEMS);
+            res = SG_LIB_SYNTAX_ERROR;
+            break;
+        }
+        snprintf(src, sizeof(src), "%s:%d", fn, k);
+        if ((res = wm_parse_spec(line + m, src, wm_items + *num_itemsp)))
+            break;
+        ++*num_itemsp;
+    }
+    if (! got_stdin)
+        fclose(fp);
+    return res;
+}
+
+/* Applies item ip to the current mode page in cur (of pg_len bytes),
+ * checking that only changeable bits (in chg) are altered unless forced.
+ * The (sub)page header is always kept; with a mask the contents may be
+ * shorter than the mode page. Returns 0 if ok. */
+static int
+wm_apply_item(const struct wm_item_t * ip, uint8_t * cur,
+              const uint8_t * chg, int pg_len, const struct wm_job_t * jp,
+              const char * pfx)
+{
+    bool spf = !! (cur[0] & 0x40);
+    int k;
+    int hdr = spf ? 4 : 2;      /* page code, subpage code, page length */
+    uint8_t nb;
+
+    if (! jp->force) {
+        if (ip->m_len > 0) {    /* (sub)page header taken from device */
+            if (ip->c_len > pg_len) {
+                pr2serr("%s%s: contents length=%d exceeds mode page "
+                        "length=%d\n", pfx, ip->src, ip->c_len, pg_len);
+                return SG_LIB_CAT_OTHER;
+            }
+        } else if (ip->c_len != pg_len) {
+            pr2serr("%s%s: contents length=%d but mode page length=%d\n",
+                    pfx, ip->src, ip->c_len, pg_len);
+            return SG_LIB_CAT_OTHER;
+        } else if ((ip->contents[0] & 0x3f) != ip->pg_code) {
+            pr2serr("%s%s: contents page_code=0x%x but page_code=0x%x\n",
+                    pfx, ip->src, ip->contents[0] & 0x3f, ip->pg_code);
+            return SG_LIB_CAT_OTHER;
+        } else if ((ip->contents[0] & 0x40) != (cur[0] & 0x40)) {
+            pr2serr("%s%s: contents flags subpage but mode page does not "
+                    "(or vice versa)\n", pfx, ip->src);
+            return SG_LIB_CAT_OTHER;
+        } else if (spf && (ip->contents[1] != ip->sub_pg_code)) {
+            pr2serr("%s%s: contents subpage_code=0x%x but sub_page_code="
+                    "0x%x\n", pfx, ip->src, ip->contents[1], ip->sub_pg_code);
+            return SG_LIB_CAT_OTHER;
+        }
+        if (jp->save && (! (cur[0] & 0x80))) {
+            pr2serr("%s%s: PS bit in existing mode page indicates that it "
+                    "is not saveable\n", pfx, ip->src);
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    for (k = hdr; k < pg_len; ++k) {
+        if (k >= ip->c_len)
+            break;      /* rest of page stays as it is */
+        nb = (cur[k] & ~ip->mask[k]) | (ip->contents[k] & ip->mask[k]);
+        if ((! jp->force) && ((nb ^ cur[k]) & ~chg[k])) {
+            pr2serr("%s%s: byte %d of mode page 0x%x would change bits "
+                    "(0x%x) that are not changeable\n", pfx, ip->src, k,
+                    ip->pg_code, (nb ^ cur[k]) & ~chg[k]);
+            return SG_LIB_CAT_OTHER;
+        }
+        cur[k] = nb;
+    }
+    cur[0] &= 0x7f;     /* PS bit is reserved in MODE SELECT */
+    return 0;
+}
+
+/* Builds one MODE SELECT parameter list holding every mode page named in
+ * the --batch= specs (once each, specs naming the same page applied in
+ * order) with the changes made, then sends it. Returns 0 if ok. */
+static int
+wm_device(int sg_fd, struct wm_dev_t * dp, const struct wm_job_t * jp)
+{
+    int k, j, res, pg_len, hdr_len, smask, rep_len;
+    int vb = jp->verbose;
+    int pl_len = 0;
+    int pl_mx = jp->mode_6 ? SHORT_ALLOC_LEN : 0xffff;
+    uint8_t * plp = NULL;
+    uint8_t * cur;
+    uint8_t chg[MX_PAGE_LEN];
+    void * pc_arr[4];
+    struct sg_simple_inquiry_resp inq_data;
+    char b[80];
+
+    /* room for one more (fetched) page past pl_mx */
+    plp = (uint8_t *)calloc(1, pl_mx + MX_PAGE_LEN);
+    if (NULL == plp) {
+        pr2serr("%sout of memory\n", dp->pfx);
+        return sg_convert_errno(ENOMEM);
+    }
+    /* first page's MODE SENSE header (without block descriptors) leads
+     * the parameter list */
+    hdr_len = jp->mode_6 ? 4 : 8;
+    if (jp->mode_6)
+        res = sg_ll_mode_sense6(sg_fd, true /* dbd */, 0 /* current */,
+                                jp->items[0].pg_code,
+                                jp->items[0].sub_pg_code, plp, hdr_len, true,
+                                vb);
+    else
+        res = sg_ll_mode_sense10(sg_fd, false /* llbaa */, true /* dbd */,
+                                 0 /* current */, jp->items[0].pg_code,
+                                 jp->items[0].sub_pg_code, plp, hdr_len,
+                                 true, vb);
+    if (res)
+        goto fini;
+    if (jp->mode_6) {
+        plp[0] = 0;     /* mode data length reserved for mode select */
+        plp[3] = 0;     /* no block descriptors */
+    } else {
+        memset(plp, 0, 2);
+        plp[4] = 0;     /* LONGLBA */
+        memset(plp + 6, 0, 2);
+    }
+    if ((0 == sg_simple_inquiry(sg_fd, &inq_data, false, vb)) &&
+        (0 == inq_data.peripheral_type))
+        plp[jp->mode_6 ? 2 : 3] &= 0xef;    /* for disks mask DPOFUA bit */
+    pl_len = hdr_len;
+
+    for (k = 0; k < jp->num_items; ++k) {
+        const struct wm_item_t * ip = jp->items + k;
+
+        for (j = 0; j < k; ++j) {       /* done with an earlier spec? */
+            if ((jp->items[j].pg_code == ip->pg_code) &&
+                (jp->items[j].sub_pg_code == ip->sub_pg_code))
+                break;
+        }
+        if (j < k)
+            continue;
+        cur = plp + pl_len;
+        memset(pc_arr, 0, sizeof(pc_arr));
+        pc_arr[0] = cur;
+        pc_arr[1] = chg;
+        res = sg_get_mode_page_controls(sg_fd, jp->mode_6, ip->pg_code,
+                                        ip->sub_pg_code, true /* dbd */,
+                                        false, MX_PAGE_LEN, &smask, pc_arr,
+                                        &rep_len, vb);
+        if (res) {
+            sg_get_category_sense_str(res, sizeof(b), b, vb);
+            pr2serr("%s%s: fetching mode page 0x%x,0x%x: %s\n", dp->pfx,
+                    ip->src, ip->pg_code, ip->sub_pg_code, b);
+            goto fini;
+        }
+        if (0x40 & cur[0])
+            pg_len = sg_get_unaligned_be16(cur + 2) + 4;
+        else
+            pg_len = cur[1] + 2;
+        if (pg_len > MX_PAGE_LEN) {
+            pr2serr("%smode page 0x%x,0x%x too long (%d bytes)\n", dp->pfx,
+                    ip->pg_code, ip->sub_pg_code, pg_len);
+            res = SG_LIB_CAT_MALFORMED;
+            goto fini;
+        }
+        if ((pl_len + pg_len) > pl_mx) {
+            pr2serr("%sparameter list would be too long for MODE "
+                    "SELECT(%d)\n", dp->pfx, jp->mode_6 ? 6 : 10);
+            res = SG_LIB_CAT_OTHER;
+            goto fini;
+        }
+        for (j = k; j < jp->num_items; ++j) {
+            if ((jp->items[j].pg_code != ip->pg_code) ||
+                (jp->items[j].sub_pg_code != ip->sub_pg_code))
+                continue;
+            if ((res = wm_apply_item(jp->items + j, cur, chg, pg_len, jp,
+                                     dp->pfx)))
+                goto fini;
+        }
+        pl_len += pg_len;
+        ++dp->num_pages;
+    }
+    dp->pl_len = pl_len;
+    if (vb > 1) {
+        pr2serr("%sMODE SELECT(%d) parameter list:\n", dp->pfx,
+                jp->mode_6 ? 6 : 10);
+        hex2stderr(plp, pl_len, -1);
+    }
+    if (jp->mode_6)
+        res = sg_ll_mode_select6_v2(sg_fd, true /* PF */, false /* rtd */,
+                                    jp->save, plp, pl_len, true, vb);
+    else
+        res = sg_ll_mode_select10_v2(sg_fd, true /* PF */, false /* rtd */,
+                                     jp->save, plp, pl_len, true, vb);
+fini:
+    free(plp);
+    return res;
+}
+
+static void *
+wm_worker(void * v_mp)
+{
+    int k, sg_fd, res;
+    struct wm_multi_t * mp = (struct wm_multi_t *)v_mp;
+    struct wm_dev_t * dp;
+
+    while ((k = __atomic_fetch_add(&mp->next_dev, 1, __ATOMIC_RELAXED)) <
+           mp->num_devs) {
+        dp = mp->d_arr + k;
+        sg_fd = sg_cmds_open_device(dp->dev_name, false /* rw */,
+                                    mp->jp->verbose);
+        if (sg_fd < 0) {
+            pr2serr("%sopen error: %s\n", dp->pfx, safe_strerror(-sg_fd));
+            dp->res = sg_convert_errno(-sg_fd);
+            continue;
+        }
+        dp->res = wm_device(sg_fd, dp, mp->jp);
+        res = sg_cmds_close_device(sg_fd);
+        if ((res < 0) && (0 == dp->res))
+            dp->res = sg_convert_errno(-res);
+    }
+    return NULL;
+}
+
+/* Makes the --batch= changes on each DEVICE, up to num_jobs of them at
+ * once. With more than one DEVICE outputs a line for each. Returns 0,
+ * else the error of the first DEVICE that failed. */
+static int
+wm_batch(const char ** dev_names, int num_devs, int num_jobs,
+         const struct wm_job_t * jp)
+{
+    int k;
+    int ret = 0;
+    struct wm_dev_t * dp;
+    struct wm_multi_t m;
+    char b[80];
+#ifndef SG_LIB_WIN32
+    int err, num_thr;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    memset(&m, 0, sizeof(m));
+    m.jp = jp;
+    m.num_devs = num_devs;
+    m.d_arr = (struct wm_dev_t *)calloc(num_devs, sizeof(*dp));
+    if (NULL == m.d_arr) {
+        pr2serr(ME "out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        dp->dev_name = dev_names[k];
+        if (num_devs > 1)
+            snprintf(dp->pfx, sizeof(dp->pfx), "%s: ", dp->dev_name);
+    }
+#ifndef SG_LIB_WIN32
+    num_thr = (num_jobs < num_devs) ? num_jobs : num_devs;
+    for (k = 1; k < num_thr; ++k) {
+        if ((err = pthread_create(tids + k, NULL, wm_worker, &m))) {
+            if (jp->verbose)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_thr = k;
+    wm_worker(&m);      /* this thread is one of the workers */
+    for (k = 1; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+#else
+    if (num_jobs) { }   /* suppress warning */
+    wm_worker(&m);
+#endif
+    for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        if (dp->res && (0 == ret))
+            ret = dp->res;
+        if (num_devs < 2) {
+            if ((0 == dp->res) && jp->verbose)
+                pr2serr("%d mode page%s in one MODE SELECT(%d), %d bytes\n",
+                        dp->num_pages, (1 == dp->num_pages) ? "" : "s",
+                        jp->mode_6 ? 6 : 10, dp->pl_len);
+        } else if (dp->res) {
+            sg_get_category_sense_str(dp->res, sizeof(b), b, jp->verbose);
+            printf("%s: failed: %s\n", dp->dev_name, b);
+        } else
+            printf("%s: %d mode page%s in one MODE SELECT(%d)\n",
+                   dp->dev_name, dp->num_pages,
+                   (1 == dp->num_pages) ? "" : "s", jp->mode_6 ? 6 : 10);
+    }
+    free(m.d_arr);
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -331,6 +770,9 @@ main(int argc, char * argv[])
     bool version_given = false;
     int res, c, num, alloc_len, off, pdt, k, md_len, hdr_len, bd_len;
     int mask_in_len;
+    int num_devs = 0;
+    int num_items = 0;
+    int num_jobs = DEF_JOBS;
     int sg_fd = -1;
     int pg_code = -1;
     int sub_pg_code = 0;
@@ -339,6 +781,7 @@ main(int argc, char * argv[])
     int ret = 0;
     unsigned u, uu;
     const char * device_name = NULL;
+    const char ** dev_names = NULL;
     uint8_t read_in[MX_ALLOC_LEN];
     uint8_t mask_in[MX_ALLOC_LEN];
     uint8_t ref_md[MX_ALLOC_LEN];
@@ -346,11 +789,12 @@ main(int argc, char * argv[])
     char errStr[128];
     char b[80];
     struct sg_simple_inquiry_resp inq_data;
+    struct wm_job_t job;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "6c:dfhl:m:p:RsvV", long_options,
+        c = getopt_long(argc, argv, "6b:c:dfhj:l:m:p:RsvV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -359,6 +803,19 @@ main(int argc, char * argv[])
         case '6':
             mode_6 = true;
             break;
+        case 'b':
+            if ('@' == optarg[0])
+                ret = wm_read_batch(optarg + 1, &num_items);
+            else if (num_items >= MX_BATCH_ITEMS) {
+                pr2serr("too many --batch= specs, maximum is %d\n",
+                        MX_BATCH_ITEMS);
+                ret = SG_LIB_SYNTAX_ERROR;
+            } else if (0 == (ret = wm_parse_spec(optarg, "--batch",
+                                                 wm_items + num_items)))
+                ++num_items;
+            if (ret)
+                return ret;
+            break;
         case 'c':
             memset(read_in, 0, sizeof(read_in));
             if ((ret = build_mode_page(optarg, read_in, &read_in_len,
@@ -378,6 +835,14 @@ main(int argc, char * argv[])
         case '?':
             usage();
             return 0;
+        case 'j':
+            num_jobs = sg_get_num_nomult(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs' should be in the range 1 to "
+                        "%d\n", MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             num = sscanf(optarg, "%d", &res);
             if ((1 == num) && ((6 == res) || (10 == res)))
@@ -439,13 +904,13 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
+        dev_names = (const char **)(argv + optind);
+        num_devs = argc - optind;
+        device_name = dev_names[0];
+        if ((num_devs > 1) && (0 == num_items)) {
+            for (++optind; optind < argc; ++optind)
                 pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+            pr2serr("more than one DEVICE needs --batch=\n");
             usage();
             return SG_LIB_SYNTAX_ERROR;
         }
@@ -477,6 +942,22 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (num_items > 0) {
+        if (got_contents || got_mask || rtd || (pg_code >= 0)) {
+            pr2serr("--batch= cannot be used with --contents=, --mask=, "
+                    "--page= or --rtd\n");
+            return SG_LIB_CONTRADICT;
+        }
+        memset(&job, 0, sizeof(job));
+        job.force = force;
+        job.mode_6 = mode_6;
+        job.save = save;
+        job.num_items = num_items;
+        job.verbose = verbose;
+        job.items = wm_items;
+        ret = wm_batch(dev_names, num_devs, num_jobs, &job);
+        goto fini;
+    }
     if ((pg_code < 0) && (! rtd)) {
         pr2serr("need page code (see '--page=')\n\n");
         usage();
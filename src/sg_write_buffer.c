@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2006-2018 Luben Tuikov and Douglas Gilbert.
+ * Copyright (c) 2006-2026 Luben Tuikov and Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -18,12 +18,26 @@
 #include <errno.h>
 #include <string.h>
 #include <getopt.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#ifndef SG_LIB_WIN32
+#include <sys/mman.h>
+#include <pthread.h>
+#endif
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+#include <time.h>
+#elif defined(HAVE_GETTIMEOFDAY)
+#include <time.h>
+#include <sys/time.h>
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
@@ -40,7 +54,7 @@
  * This utility issues the SCSI WRITE BUFFER command to the given device.
  */
 
-static const char * version_str = "1.29 20181112";    /* spc5r19 */
+static const char * version_str = "1.30 20261014";    /* spc5r19 */
 
 #define ME "sg_write_buffer: "
 #define DEF_XFER_LEN (8 * 1024 * 1024)
@@ -50,6 +64,8 @@ static const char * version_str = "1.29 20181112";    /* spc5r19 */
 #define WRITE_BUFFER_CMDLEN 10
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT 300      /* 300 seconds, 5 minutes */
+#define DEF_JOBS 16             /* DEVICEs downloading at once */
+#define MAX_JOBS 256
 
 static struct option long_options[] = {
         {"bpw", required_argument, 0, 'b'},
@@ -58,6 +74,7 @@ static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"id", required_argument, 0, 'i'},
         {"in", required_argument, 0, 'I'},
+        {"jobs", required_argument, 0, 'j'},
         {"length", required_argument, 0, 'l'},
         {"mode", required_argument, 0, 'm'},
         {"offset", required_argument, 0, 'o'},
@@ -79,12 +96,13 @@ usage()
     pr2serr("Usage: "
             "sg_write_buffer [--bpw=CS] [--dry-run] [--help] [--id=ID] "
             "[--in=FILE]\n"
-            "                       [--length=LEN] [--mode=MO] "
-            "[--offset=OFF]\n"
-            "                       [--read-stdin] [--skip=SKIP] "
-            "[--specific=MS]\n"
-            "                       [--timeout=TO] [--verbose] [--version] "
-            "DEVICE\n"
+            "                       [--jobs=JOBS] [--length=LEN] "
+            "[--mode=MO]\n"
+            "                       [--offset=OFF] [--read-stdin] "
+            "[--skip=SKIP]\n"
+            "                       [--specific=MS] [--timeout=TO] "
+            "[--verbose]\n"
+            "                       [--version] DEVICE [DEVICE...]\n"
             "  where:\n"
             "    --bpw=CS|-b CS         CS is chunk size: bytes per write "
             "buffer\n"
@@ -97,6 +115,8 @@ usage()
             "255)\n"
             "    --in=FILE|-I FILE      read from FILE ('-I -' read "
             "from stdin)\n"
+            "    --jobs=JOBS|-j JOBS    number of DEVICEs sent to at once "
+            "(def: %d)\n"
             "    --length=LEN|-l LEN    length in bytes to write; may be "
             "deduced from\n"
             "                           FILE\n"
@@ -118,6 +138,9 @@ usage()
             "to list\navailable modes. A chunk size of 4 KB ('--bpw=4k') "
             "seems to work well.\nExample: sg_write_buffer -b 4k -I xxx.lod "
             "-m 7 /dev/sg3\n"
+            "Given more than one DEVICE, each is sent the data independently "
+            "and with\n'--bpw=CS,act' none is activated unless every "
+            "download succeeds.\n", DEF_JOBS
           );
 
 }
@@ -188,6 +211,268 @@ print_modes(void)
             "dmc_offs_ev_defer mode downloads.\n");
 }
 
+/* What is sent to each DEVICE */
+struct wb_job_t {
+    bool dry_run;
+    int bpw;
+    int verbose;
+    int wb_id;
+    int wb_len;
+    int wb_mode;
+    int wb_mspec;
+    int wb_offset;
+    int wb_timeout;
+    const uint8_t * dop;
+};
+
+/* Progress of one DEVICE */
+struct wb_dev_t {
+    const char * dev_name;
+    char pfx[64];       /* prefixes messages when more than one DEVICE */
+    int sg_fd;
+    int res;            /* of download, then of activate */
+    int num_cmds;       /* WRITE BUFFER commands in download */
+    int64_t dl_us;      /* duration of download */
+    int64_t max_us;     /* slowest WRITE BUFFER command of download */
+};
+
+/* Shared by the threads downloading to (or activating) many DEVICEs */
+struct wb_multi_t {
+    bool activate;
+    int next_dev;       /* DEVICEs taken from d_arr (atomically) */
+    int num_devs;
+    const struct wb_job_t * jp;
+    struct wb_dev_t * d_arr;
+};
+
+static int64_t
+wb_now_us(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return (int64_t)ts.tv_sec * 1000000 + (ts.tv_nsec / 1000);
+    return 0;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+/* Sends jp->wb_len bytes at jp->dop to the DEVICE, in chunks of jp->bpw
+ * bytes when that is > 0. Returns 0 for success else the first error. */
+static int
+wb_download(struct wb_dev_t * dp, const struct wb_job_t * jp)
+{
+    int k, n, res;
+    int vb = jp->verbose;
+    int64_t start_us, cmd_us, t_us;
+
+    res = 0;
+    start_us = wb_now_us();
+    if (jp->bpw > 0) {
+        for (k = 0; k < jp->wb_len; k += n) {
+            n = jp->wb_len - k;
+            if (n > jp->bpw)
+                n = jp->bpw;
+            if (vb)
+                pr2serr("%ssending write buffer, mode=0x%x, mspec=%d, id=%d, "
+                        " offset=%d, len=%d\n", dp->pfx, jp->wb_mode,
+                        jp->wb_mspec, jp->wb_id, jp->wb_offset + k, n);
+            cmd_us = wb_now_us();
+            if (jp->dry_run) {
+                if (vb)
+                    pr2serr("%sskipping WRITE BUFFER command due to "
+                            "--dry-run\n", dp->pfx);
+                res = 0;
+            } else
+                res = sg_ll_write_buffer_v2(dp->sg_fd, jp->wb_mode,
+                                            jp->wb_mspec, jp->wb_id,
+                                            jp->wb_offset + k,
+                                            (void *)(jp->dop + k), n,
+                                            jp->wb_timeout, true, vb);
+            ++dp->num_cmds;
+            t_us = wb_now_us() - cmd_us;
+            if (t_us > dp->max_us)
+                dp->max_us = t_us;
+            if (res)
+                break;
+        }
+    } else {
+        if (vb)
+            pr2serr("%ssending single write buffer, mode=0x%x, mpsec=%d, "
+                    "id=%d, offset=%d, len=%d\n", dp->pfx, jp->wb_mode,
+                    jp->wb_mspec, jp->wb_id, jp->wb_offset, jp->wb_len);
+        if (jp->dry_run) {
+            if (vb)
+                pr2serr("%sskipping WRITE BUFFER(all in one) command due to "
+                        "--dry-run\n", dp->pfx);
+            res = 0;
+        } else
+            res = sg_ll_write_buffer_v2(dp->sg_fd, jp->wb_mode, jp->wb_mspec,
+                                        jp->wb_id, jp->wb_offset,
+                                        (void *)jp->dop, jp->wb_len,
+                                        jp->wb_timeout, true, vb);
+        ++dp->num_cmds;
+        dp->max_us = wb_now_us() - start_us;
+    }
+    dp->dl_us = wb_now_us() - start_us;
+    return res;
+}
+
+/* Activates deferred microcode (mode 0xf) previously downloaded to the
+ * DEVICE. Returns 0 for success. */
+static int
+wb_activate(struct wb_dev_t * dp, const struct wb_job_t * jp)
+{
+    if (jp->verbose)
+        pr2serr("%ssending Activate deferred microcode [0xf]\n", dp->pfx);
+    if (jp->dry_run) {
+        if (jp->verbose)
+            pr2serr("%sskipping WRITE BUFFER(ACTIVATE) command due to "
+                    "--dry-run\n", dp->pfx);
+        return 0;
+    }
+    return sg_ll_write_buffer_v2(dp->sg_fd, MODE_ACTIVATE_MC,
+                                 0 /* buffer_id */, 0 /* buffer_offset */, 0,
+                                 NULL, 0, jp->wb_timeout, true, jp->verbose);
+}
+
+static void *
+wb_worker(void * v_mp)
+{
+    int k;
+    struct wb_multi_t * mp = (struct wb_multi_t *)v_mp;
+    struct wb_dev_t * dp;
+
+    while ((k = __atomic_fetch_add(&mp->next_dev, 1, __ATOMIC_RELAXED)) <
+           mp->num_devs) {
+        dp = mp->d_arr + k;
+        if (mp->activate) {
+            dp->res = wb_activate(dp, mp->jp);
+            continue;
+        }
+        dp->sg_fd = sg_cmds_open_device(dp->dev_name, false /* rw */,
+                                        mp->jp->verbose);
+        if (dp->sg_fd < 0) {
+            pr2serr("%sopen error: %s\n", dp->pfx,
+                    safe_strerror(-dp->sg_fd));
+            dp->res = sg_convert_errno(-dp->sg_fd);
+            continue;
+        }
+        dp->res = wb_download(dp, mp->jp);
+    }
+    return NULL;
+}
+
+/* Has up to num_thr threads (this one included) doing wb_worker() */
+static void
+wb_run_workers(struct wb_multi_t * mp, int num_thr)
+{
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+
+    mp->next_dev = 0;
+    if (num_thr > mp->num_devs)
+        num_thr = mp->num_devs;
+    for (k = 1; k < num_thr; ++k) {
+        if ((err = pthread_create(tids + k, NULL, wb_worker, mp))) {
+            if (mp->jp->verbose)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_thr = k;
+    wb_worker(mp);
+    for (k = 1; k < num_thr; ++k)
+        pthread_join(tids[k], NULL);
+#else
+    if (num_thr) { ; }  /* suppress warning */
+    mp->next_dev = 0;
+    wb_worker(mp);
+#endif
+}
+
+/* Sends the same data to many DEVICEs, up to num_jobs at a time, each
+ * DEVICE's chunks following one another as fast as that DEVICE takes them.
+ * When 'activate' is true, activation is held back until every download
+ * has succeeded, then all DEVICEs are activated together; if any download
+ * failed, none is activated. Outputs a line per DEVICE. Returns 0, else
+ * the error of the first DEVICE that failed. */
+static int
+wb_multi(const char ** dev_names, int num_devs, int num_jobs, bool activate,
+         const struct wb_job_t * jp)
+{
+    int k, res, num_bad;
+    int ret = 0;
+    struct wb_dev_t * dp;
+    struct wb_multi_t m;
+    char b[80];
+
+    memset(&m, 0, sizeof(m));
+    m.jp = jp;
+    m.num_devs = num_devs;
+    m.d_arr = (struct wb_dev_t *)calloc(num_devs, sizeof(*dp));
+    if (NULL == m.d_arr) {
+        pr2serr(ME "out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        dp->dev_name = dev_names[k];
+        dp->sg_fd = -1;
+        snprintf(dp->pfx, sizeof(dp->pfx), "%s: ", dp->dev_name);
+    }
+    wb_run_workers(&m, num_jobs);
+    for (k = 0, num_bad = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        if (dp->res) {
+            ++num_bad;
+            if (0 == ret)
+                ret = dp->res;
+            sg_get_category_sense_str(dp->res, sizeof(b), b, jp->verbose);
+            printf("%s: failed: %s\n", dp->dev_name, b);
+        } else
+            printf("%s: %d WRITE BUFFER command%s, %.3f seconds (slowest "
+                   "command %.3f)\n", dp->dev_name, dp->num_cmds,
+                   (1 == dp->num_cmds) ? "" : "s",
+                   (double)dp->dl_us / 1000000.0,
+                   (double)dp->max_us / 1000000.0);
+    }
+    if (activate) {
+        if (num_bad)
+            printf("%d of %d DEVICEs failed, so none activated\n", num_bad,
+                   num_devs);
+        else {
+            m.activate = true;
+            wb_run_workers(&m, num_jobs);
+            for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+                if (dp->res) {
+                    if (0 == ret)
+                        ret = dp->res;
+                    sg_get_category_sense_str(dp->res, sizeof(b), b,
+                                              jp->verbose);
+                    printf("%s: activate failed: %s\n", dp->dev_name, b);
+                } else
+                    printf("%s: activated\n", dp->dev_name);
+            }
+        }
+    }
+    for (k = 0, dp = m.d_arr; k < num_devs; ++k, ++dp) {
+        if (dp->sg_fd >= 0) {
+            res = sg_cmds_close_device(dp->sg_fd);
+            if ((res < 0) && (0 == ret))
+                ret = sg_convert_errno(-res);
+        }
+    }
+    free(m.d_arr);
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -198,10 +483,12 @@ main(int argc, char * argv[])
     bool verbose_given = false;
     bool version_given = false;
     bool wb_len_given = false;
-    int infd, res, c, len, k, n;
+    int infd, res, c, k, len;
     int sg_fd = -1;
     int bpw = 0;
     int do_help = 0;
+    int num_devs = 0;
+    int num_jobs = DEF_JOBS;
     int ret = 0;
     int verbose = 0;
     int wb_id = 0;
@@ -211,19 +498,26 @@ main(int argc, char * argv[])
     int wb_skip = 0;
     int wb_timeout = DEF_PT_TIMEOUT;
     int wb_mspec = 0;
+    size_t mmap_len = 0;
     const char * device_name = NULL;
     const char * file_name = NULL;
+    const char ** dev_names = NULL;
     uint8_t * dop = NULL;
     uint8_t * read_buf = NULL;
     uint8_t * free_dop = NULL;
+    uint8_t * mmap_p = NULL;
     char * cp;
     const struct mode_s * mp;
+    struct stat a_stat;
+    struct sg_f2hex_strm * fhp = NULL;
+    struct wb_job_t job;
+    struct wb_dev_t dev;
     char ebuff[EBUFF_SZ];
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:dhi:I:l:m:o:rs:S:t:vV", long_options,
+        c = getopt_long(argc, argv, "b:dhi:I:j:l:m:o:rs:S:t:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -259,6 +553,14 @@ main(int argc, char * argv[])
         case 'I':
             file_name = optarg;
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             wb_len = sg_get_num(optarg);
             if (wb_len < 0) {
@@ -343,16 +645,9 @@ main(int argc, char * argv[])
         return 0;
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        device_name = argv[optind];
+        dev_names = (const char **)(argv + optind);
+        num_devs = argc - optind;
     }
 
 #ifdef DEBUG
@@ -396,15 +691,39 @@ main(int argc, char * argv[])
 #endif
 #endif
 
-    sg_fd = sg_cmds_open_device(device_name, false /* rw */, verbose);
-    if (sg_fd < 0) {
-        if (verbose)
-            pr2serr(ME "open error: %s: %s\n", device_name,
-                    safe_strerror(-sg_fd));
-        ret = sg_convert_errno(-sg_fd);
-        goto err_out;
+#ifndef SG_LIB_WIN32
+    /* map a regular file holding all the data, rather than read it in */
+    if (file_name && strcmp(file_name, "-") &&
+        ((infd = open(file_name, O_RDONLY)) >= 0)) {
+        if ((0 == fstat(infd, &a_stat)) && S_ISREG(a_stat.st_mode) &&
+            (a_stat.st_size > wb_skip)) {
+            if (! wb_len_given) {
+                wb_len = DEF_XFER_LEN;
+                if ((a_stat.st_size - wb_skip) < wb_len)
+                    wb_len = (int)(a_stat.st_size - wb_skip);
+            }
+            if ((wb_len > 0) && ((wb_skip + wb_len) <= a_stat.st_size)) {
+                mmap_len = wb_skip + wb_len;
+                mmap_p = (uint8_t *)mmap(NULL, mmap_len, PROT_READ,
+                                         MAP_PRIVATE, infd, 0);
+                if (MAP_FAILED == mmap_p) {
+                    mmap_p = NULL;
+                    if (verbose)
+                        perror(ME "mmap() failed, will read()");
+                } else {
+                    dop = mmap_p + wb_skip;
+                    if (verbose > 1)
+                        pr2serr("mapped %d bytes of %s at offset %d\n",
+                                wb_len, file_name, wb_skip);
+                }
+            }
+            if ((NULL == mmap_p) && (! wb_len_given))
+                wb_len = 0;
+        }
+        close(infd);
     }
-    if (file_name || (wb_len > 0)) {
+#endif
+    if ((NULL == dop) && (file_name || (wb_len > 0))) {
         if (0 == wb_len)
             wb_len = DEF_XFER_LEN;
         dop = sg_memalign(wb_len, 0, &free_dop, false);
@@ -424,26 +743,26 @@ main(int argc, char * argv[])
                 }
                 infd = STDIN_FILENO;
             } else {
-                if ((infd = open(file_name, O_RDONLY)) < 0) {
-                    ret = sg_convert_errno(errno);
-                    snprintf(ebuff, EBUFF_SZ,
-                             ME "could not open %s for reading", file_name);
-                    perror(ebuff);
+                fhp = sg_f2hex_open(file_name, true /* as_binary */, false,
+                                    &ret);
+                if (NULL == fhp)
                     goto err_out;
-                } else if (sg_set_binary_mode(infd) < 0)
-                    perror("sg_set_binary_mode");
-                if (wb_skip > 0) {
-                    if (lseek(infd, wb_skip, SEEK_SET) < 0) {
-                        ret = sg_convert_errno(errno);
-                        snprintf(ebuff,  EBUFF_SZ, ME "couldn't skip to "
-                                 "required position on %s", file_name);
-                        perror(ebuff);
-                        close(infd);
+                /* discard the leading wb_skip bytes via the data-out
+                 * buffer, sg_f2hex_next() maps a regular file */
+                for (k = wb_skip; k > 0; k -= res) {
+                    ret = sg_f2hex_next(fhp, dop, (k < wb_len) ? k : wb_len,
+                                        &res);
+                    if (ret)
+                        goto err_out;
+                    if (0 == res) {
+                        pr2serr(ME "couldn't skip to required position on "
+                                "%s\n", file_name);
+                        ret = SG_LIB_FILE_ERROR;
                         goto err_out;
                     }
                 }
             }
-            if (infd == STDIN_FILENO) {
+            if (got_stdin) {
                 if (NULL == (read_buf = (uint8_t *)malloc(DEF_XFER_LEN))) {
                     pr2serr(ME "out of memory\n");
                     ret = SG_LIB_SYNTAX_ERROR;
@@ -480,16 +799,9 @@ main(int argc, char * argv[])
                     pch = strtok(NULL, ",. \n\t");
                 }
             } else {
-                res = read(infd, dop, wb_len);
-                if (res < 0) {
-                    ret = sg_convert_errno(errno);
-                    snprintf(ebuff, EBUFF_SZ, ME "couldn't read from %s",
-                             file_name);
-                    perror(ebuff);
-                    if (! got_stdin)
-                        close(infd);
+                ret = sg_f2hex_next(fhp, dop, wb_len, &res);
+                if (ret)
                     goto err_out;
-                }
             }
             if (res < wb_len) {
                 if (wb_len_given) {
@@ -510,63 +822,42 @@ main(int argc, char * argv[])
                     wb_len = res;
                 }
             }
-            if (! got_stdin)
-                close(infd);
+            sg_f2hex_close(fhp);
+            fhp = NULL;
         }
     }
 
-    res = 0;
-    if (bpw > 0) {
-        for (k = 0; k < wb_len; k += n) {
-            n = wb_len - k;
-            if (n > bpw)
-                n = bpw;
-            if (verbose)
-                pr2serr("sending write buffer, mode=0x%x, mspec=%d, id=%d, "
-                        " offset=%d, len=%d\n", wb_mode, wb_mspec, wb_id,
-                        wb_offset + k, n);
-            if (dry_run) {
-                if (verbose)
-                    pr2serr("skipping WRITE BUFFER command due to "
-                            "--dry-run\n");
-                res = 0;
-            } else
-                res = sg_ll_write_buffer_v2(sg_fd, wb_mode, wb_mspec, wb_id,
-                                            wb_offset + k, dop + k, n,
-                                            wb_timeout, true, verbose);
-            if (res)
-                break;
-        }
-        if (bpw_then_activate) {
-            if (verbose)
-                pr2serr("sending Activate deferred microcode [0xf]\n");
-            if (dry_run) {
-                if (verbose)
-                    pr2serr("skipping WRITE BUFFER(ACTIVATE) command due to "
-                            "--dry-run\n");
-                res = 0;
-            } else
-                res = sg_ll_write_buffer_v2(sg_fd, MODE_ACTIVATE_MC,
-                                            0 /* buffer_id */,
-                                            0 /* buffer_offset */, 0,
-                                            NULL, 0, wb_timeout, true,
-                                            verbose);
-        }
-    } else {
+    memset(&job, 0, sizeof(job));
+    job.dry_run = dry_run;
+    job.bpw = bpw;
+    job.verbose = verbose;
+    job.wb_id = wb_id;
+    job.wb_len = wb_len;
+    job.wb_mode = wb_mode;
+    job.wb_mspec = wb_mspec;
+    job.wb_offset = wb_offset;
+    job.wb_timeout = wb_timeout;
+    job.dop = dop;
+    if (num_devs > 1) {
+        ret = wb_multi(dev_names, num_devs, num_jobs,
+                       (bpw > 0) && bpw_then_activate, &job);
+        goto err_out;
+    }
+
+    sg_fd = sg_cmds_open_device(device_name, false /* rw */, verbose);
+    if (sg_fd < 0) {
         if (verbose)
-            pr2serr("sending single write buffer, mode=0x%x, mpsec=%d, "
-                    "id=%d, offset=%d, len=%d\n", wb_mode, wb_mspec, wb_id,
-                    wb_offset, wb_len);
-        if (dry_run) {
-            if (verbose)
-                pr2serr("skipping WRITE BUFFER(all in one) command due to "
-                        "--dry-run\n");
-            res = 0;
-        } else
-            res = sg_ll_write_buffer_v2(sg_fd, wb_mode, wb_mspec, wb_id,
-                                        wb_offset, dop, wb_len, wb_timeout,
-                                        true, verbose);
+            pr2serr(ME "open error: %s: %s\n", device_name,
+                    safe_strerror(-sg_fd));
+        ret = sg_convert_errno(-sg_fd);
+        goto err_out;
     }
+    memset(&dev, 0, sizeof(dev));
+    dev.dev_name = device_name;
+    dev.sg_fd = sg_fd;
+    res = wb_download(&dev, &job);
+    if ((bpw > 0) && bpw_then_activate && (0 == res))
+        res = wb_activate(&dev, &job);
     if (0 != res) {
         char b[80];
 
@@ -576,10 +867,16 @@ main(int argc, char * argv[])
     }
 
 err_out:
+#ifndef SG_LIB_WIN32
+    if (mmap_p)
+        munmap(mmap_p, mmap_len);
+#endif
     if (free_dop)
         free(free_dop);
     if (read_buf)
         free(read_buf);
+    if (fhp)
+        sg_f2hex_close(fhp);
     if (sg_fd >= 0) {
         res = sg_cmds_close_device(sg_fd);
         if (res < 0) {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2019 Douglas Gilbert.
+ * Copyright (c) 2009-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <getopt.h>
@@ -26,6 +27,17 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
+#if (! defined(HAVE_CLOCK_GETTIME)) && defined(HAVE_GETTIMEOFDAY)
+#include <sys/time.h>
+#endif
+#if defined(MSC_VER) || defined(__MINGW32__)
+#define HAVE_MS_SLEEP
+#include <windows.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_cmds_basic.h"
@@ -33,7 +45,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.28 20190124";
+static const char * version_str = "1.29 20261014";
 
 
 #define ME "sg_write_same: "
@@ -46,14 +58,16 @@ static const char * version_str = "1.28 20190124";
 #define WRITE_SAME10_LEN 10
 #define WRITE_SAME16_LEN 16
 #define WRITE_SAME32_LEN 32
-#define RCAP10_RESP_LEN 8
-#define RCAP16_RESP_LEN 32
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_TIMEOUT_SECS 60
 #define DEF_WS_CDB_SIZE WRITE_SAME10_LEN
 #define DEF_WS_NUMBLOCKS 1
 #define MAX_XFER_LEN (64 * 1024)
 #define EBUFF_SZ 512
+#define DEF_SPLIT_BLKS 65535    /* per WRITE SAME without Block Limits */
+#define DEF_JOBS 4              /* WRITE SAME commands in flight, --split */
+#define MAX_JOBS 256
+#define PROGRESS_SECS 2         /* between --progress lines */
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -64,14 +78,19 @@ static struct option long_options[] = {
     {"16", no_argument, 0, 'S'},
     {"32", no_argument, 0, 'T'},
     {"anchor", no_argument, 0, 'a'},
+    {"chunk", required_argument, 0, 'c'},
     {"grpnum", required_argument, 0, 'g'},
     {"help", no_argument, 0, 'h'},
     {"in", required_argument, 0, 'i'},
+    {"jobs", required_argument, 0, 'j'},
     {"lba", required_argument, 0, 'l'},
     {"lbdata", no_argument, 0, 'L'},
     {"ndob", no_argument, 0, 'N'},
     {"num", required_argument, 0, 'n'},
     {"pbdata", no_argument, 0, 'P'},
+    {"progress", no_argument, 0, 'p'},
+    {"rate", required_argument, 0, 'r'},
+    {"split", no_argument, 0, 's'},
     {"timeout", required_argument, 0, 't'},
     {"unmap", no_argument, 0, 'U'},
     {"verbose", no_argument, 0, 'v'},
@@ -86,18 +105,24 @@ struct opts_t {
     bool ndob;
     bool lbdata;
     bool pbdata;
+    bool progress;
+    bool split;
     bool unmap;
     bool verbose_given;
     bool version_given;
     bool want_ws10;
     int grpnum;
+    int num_jobs;
     int numblocks;
     int timeout;
     int verbose;
     int wrprotect;
     int xfer_len;
     int pref_cdb_size;
+    uint32_t chunk;             /* --chunk=CB, 0 -> from Block Limits */
     uint64_t lba;
+    uint64_t num_blks;          /* --num=NUM, over 32 bits with --split */
+    uint64_t rate;              /* blocks per second, 0 for no limit */
     char ifilename[256];
 };
 
@@ -106,14 +131,16 @@ static void
 usage()
 {
     pr2serr("Usage: sg_write_same [--10] [--16] [--32] [--anchor] "
-            "[--grpnum=GN] [--help]\n"
-            "                     [--in=IF] [--lba=LBA] [--lbdata] "
-            "[--ndob] [--num=NUM]\n"
-            "                     [--pbdata] [--timeout=TO] [--unmap] "
-            "[--verbose]\n"
-            "                     [--version] [--wrprotect=WRP] "
-            "[xferlen=LEN]\n"
-            "                     DEVICE\n"
+            "[--chunk=CB]\n"
+            "                     [--grpnum=GN] [--help] [--in=IF] "
+            "[--jobs=JOBS]\n"
+            "                     [--lba=LBA] [--lbdata] [--ndob] "
+            "[--num=NUM] [--pbdata]\n"
+            "                     [--progress] [--rate=BPS] [--split] "
+            "[--timeout=TO]\n"
+            "                     [--unmap] [--verbose] [--version] "
+            "[--wrprotect=WRP]\n"
+            "                     [xferlen=LEN] DEVICE\n"
             "  where:\n"
             "    --10|-R              send WRITE SAME(10) (even if '--unmap' "
             "is given)\n"
@@ -123,12 +150,19 @@ usage()
             "then def 16)\n"
             "    --32|-T              send WRITE SAME(32) (def: 10 or 16)\n"
             "    --anchor|-a          set ANCHOR field in cdb\n"
+            "    --chunk=CB|-c CB     with --split, at most CB blocks per "
+            "command (def:\n"
+            "                         maximum write same length from Block "
+            "Limits)\n"
             "    --grpnum=GN|-g GN    GN is group number field (def: 0)\n"
             "    --help|-h            print out usage message\n"
             "    --in=IF|-i IF        IF is file to fetch one block of data "
             "from (use LEN\n"
             "                         bytes or whole file). Block written to "
             "DEVICE\n"
+            "    --jobs=JOBS|-j JOBS    with --split, WRITE SAME commands in "
+            "flight at\n"
+            "                           once (def: 4)\n"
             "    --lba=LBA|-l LBA     LBA is the logical block address to "
             "start (def: 0)\n"
             "    --lbdata|-L          set LBDATA bit (obsolete)\n"
@@ -139,6 +173,15 @@ usage()
             "                         [Beware NUM==0 may mean: 'rest of "
             "device']\n"
             "    --pbdata|-P          set PBDATA bit (obsolete)\n"
+            "    --progress|-p        with --split, report progress every "
+            "2 seconds\n"
+            "    --rate=BPS|-r BPS    with --split, write at most BPS blocks "
+            "per second\n"
+            "    --split|-s           split NUM blocks (0 -> to the end) "
+            "into commands\n"
+            "                         fitted to the Block Limits VPD page, "
+            "issued in\n"
+            "                         parallel\n"
             "    --timeout=TO|-t TO    command timeout (unit: seconds) (def: "
             "60)\n"
             "    --unmap|-U           set UNMAP bit\n"
@@ -160,8 +203,8 @@ usage()
 }
 
 static int
-do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
-              int * act_cdb_lenp)
+do_write_same(int sg_fd, const struct opts_t * op, uint64_t lba, uint32_t num,
+              const void * dataoutp, int * act_cdb_lenp)
 {
     int k, ret, res, sense_cat, cdb_len;
     uint64_t llba;
@@ -171,15 +214,15 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
 
     cdb_len = op->pref_cdb_size;
     if (WRITE_SAME10_LEN == cdb_len) {
-        llba = op->lba + op->numblocks;
-        if ((op->numblocks > 0xffff) || (llba > UINT32_MAX) ||
+        llba = lba + num;
+        if ((num > 0xffff) || (llba > UINT32_MAX) ||
             op->ndob || (op->unmap && (! op->want_ws10))) {
             cdb_len = WRITE_SAME16_LEN;
-            if (op->verbose) {
+            if (op->verbose > (op->split ? 1 : 0)) {
                 const char * cp = "use WRITE SAME(16) instead of 10 byte "
                                   "cdb";
 
-                if (op->numblocks > 0xffff)
+                if (num > 0xffff)
                     pr2serr("%s since blocks exceed 65535\n", cp);
                 else if (llba > UINT32_MAX)
                     pr2serr("%s since LBA may exceed 32 bits\n", cp);
@@ -205,9 +248,9 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
             ws_cdb[1] |= 0x4;
         if (op->lbdata)
             ws_cdb[1] |= 0x2;
-        sg_put_unaligned_be32((uint32_t)op->lba, ws_cdb + 2);
+        sg_put_unaligned_be32((uint32_t)lba, ws_cdb + 2);
         ws_cdb[6] = (op->grpnum & 0x1f);
-        sg_put_unaligned_be16((uint16_t)op->numblocks, ws_cdb + 7);
+        sg_put_unaligned_be16((uint16_t)num, ws_cdb + 7);
         break;
     case WRITE_SAME16_LEN:
         ws_cdb[0] = WRITE_SAME16_OP;
@@ -222,8 +265,8 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
             ws_cdb[1] |= 0x2;
         if (op->ndob)
             ws_cdb[1] |= 0x1;
-        sg_put_unaligned_be64(op->lba, ws_cdb + 2);
-        sg_put_unaligned_be32((uint32_t)op->numblocks, ws_cdb + 10);
+        sg_put_unaligned_be64(lba, ws_cdb + 2);
+        sg_put_unaligned_be32(num, ws_cdb + 10);
         ws_cdb[14] = (op->grpnum & 0x1f);
         break;
     case WRITE_SAME32_LEN:
@@ -242,8 +285,8 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
             ws_cdb[10] |= 0x2;
         if (op->ndob)
             ws_cdb[10] |= 0x1;
-        sg_put_unaligned_be64(op->lba, ws_cdb + 12);
-        sg_put_unaligned_be32((uint32_t)op->numblocks, ws_cdb + 28);
+        sg_put_unaligned_be64(lba, ws_cdb + 12);
+        sg_put_unaligned_be32(num, ws_cdb + 28);
         break;
     default:
         pr2serr("do_write_same: bad cdb length %d\n", cdb_len);
@@ -305,6 +348,340 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
     return ret;
 }
 
+/* The WRITE SAME commands of --split and the progress through them, shared
+ * by the threads issuing them */
+struct ws_split {
+    bool stop;                  /* set by first failed WRITE SAME */
+    int sg_fd;
+    int ret;                    /* of first failed WRITE SAME */
+    int cdb_len;                /* of the last WRITE SAME issued */
+    int num_cmds;               /* WRITE SAME commands completed */
+    uint32_t chunk;             /* blocks in one WRITE SAME, at most */
+    uint32_t gran;              /* commands end on these boundaries ... */
+    uint32_t gran_align;        /* ... offset by this, when gran > 1 */
+    uint64_t next_lba;          /* where the next WRITE SAME starts */
+    uint64_t end_lba;           /* one past the last block to write */
+    uint64_t total;             /* blocks to write */
+    uint64_t blks_done;         /* by the completed WRITE SAME commands */
+    uint64_t fail_lba;          /* start of the first that failed */
+    int64_t next_us;            /* when rate allows next one to start */
+    int64_t start_us;
+    int64_t prog_us;            /* when progress was last reported */
+    const struct opts_t * op;
+    const void * dataoutp;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static void
+split_lock(struct ws_split * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+static void
+split_unlock(struct ws_split * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+static int64_t
+split_now_us(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return (int64_t)ts.tv_sec * 1000000 + (ts.tv_nsec / 1000);
+    return 0;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+static void
+split_sleep_us(int64_t us)
+{
+#ifdef HAVE_MS_SLEEP
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/* Sets the most blocks in one WRITE SAME from --chunk=CB and the maximum
+ * write same length in the Block Limits VPD page, and the boundaries the
+ * commands should end on: the optimal unmap granularity with --unmap,
+ * else the optimal transfer length granularity. */
+static void
+split_get_limits(struct ws_split * sp, struct sg_dev_sess * dsp)
+{
+    int vb = sp->op->verbose;
+    uint32_t chunk = sp->op->chunk;
+    uint64_t mwsl;
+    const struct sg_ds_blk_lim * blp;
+
+    sp->chunk = chunk ? chunk : DEF_SPLIT_BLKS;
+    if (sp->op->want_ws10 && (sp->chunk > 0xffff))
+        sp->chunk = 0xffff;     /* fits WRITE SAME(10) */
+    sp->gran = 1;
+    sp->gran_align = 0;
+    if (sg_ds_get_blk_lim(dsp, &blp) || (blp->page_len < 0x28)) {
+        if (vb)
+            pr2serr("No usable Block Limits VPD page, so at most %u blocks "
+                    "per WRITE SAME\n", sp->chunk);
+        return;
+    }
+    mwsl = blp->max_ws_len;
+    if (mwsl > UINT32_MAX)
+        mwsl = UINT32_MAX;
+    if (0 == chunk)
+        sp->chunk = mwsl ? (uint32_t)mwsl : DEF_SPLIT_BLKS;
+    else if (mwsl && (chunk > mwsl)) {
+        pr2serr("--chunk=%u exceeds maximum write same length, reduced to "
+                "%u\n", chunk, (uint32_t)mwsl);
+        sp->chunk = (uint32_t)mwsl;
+    }
+    if (sp->op->want_ws10 && (sp->chunk > 0xffff))
+        sp->chunk = 0xffff;     /* fits WRITE SAME(10) */
+    if (sp->op->unmap) {
+        sp->gran = blp->unmap_gran;
+        sp->gran_align = blp->unmap_align;     /* 0 unless UGAVALID */
+    } else
+        sp->gran = blp->opt_xfer_gran;
+    if ((sp->gran > 1) && (sp->chunk >= sp->gran)) {
+        sp->chunk -= sp->chunk % sp->gran;
+        sp->gran_align %= sp->gran;
+    } else {
+        sp->gran = 1;
+        sp->gran_align = 0;
+    }
+    if (vb)
+        pr2serr("Block limits: maximum write same length: %" PRIu64 ", "
+                "%s granularity: %u,\n    so at most %u blocks per WRITE "
+                "SAME\n", mwsl, (sp->op->unmap ? "unmap" :
+                "optimal transfer length"), sp->gran, sp->chunk);
+}
+
+/* Takes the next WRITE SAME of --split, placing its start in *lbap and its
+ * number of blocks in *nump. Returns false when there are no more. Call
+ * with lock held. */
+static bool
+split_next_cmd(struct ws_split * sp, uint64_t * lbap, uint32_t * nump)
+{
+    uint64_t lba = sp->next_lba;
+    uint64_t n, r;
+
+    if (sp->stop || (lba >= sp->end_lba))
+        return false;
+    n = sp->end_lba - lba;
+    if (n > sp->chunk)
+        n = sp->chunk;
+    if (((lba + n) < sp->end_lba) && (sp->gran > 1)) {
+        /* end on a boundary so the commands after this one are aligned */
+        r = (lba + n + sp->gran - sp->gran_align) % sp->gran;
+        if (r < n)
+            n -= r;
+    }
+    *lbap = lba;
+    *nump = (uint32_t)n;
+    sp->next_lba += n;
+    return true;
+}
+
+/* Reports progress to stderr. Call with lock held. */
+static void
+split_progress(const struct ws_split * sp, int64_t now_us)
+{
+    double secs = (double)(now_us - sp->start_us) / 1000000.0;
+    double bps = (secs > 0.0) ? ((double)sp->blks_done / secs) : 0.0;
+
+    pr2serr("%5.1f%% done: %" PRIu64 " of %" PRIu64 " blocks, %.0f "
+            "blocks/s", (100.0 * (double)sp->blks_done) / (double)sp->total,
+            sp->blks_done, sp->total, bps);
+    if ((bps > 0.0) && (sp->blks_done < sp->total))
+        pr2serr(", about %.0f seconds left",
+                (double)(sp->total - sp->blks_done) / bps);
+    pr2serr("\n");
+}
+
+static void *
+split_worker(void * v_sp)
+{
+    bool more;
+    int res, cdb_len;
+    int64_t start_us, now_us;
+    uint32_t num;
+    uint64_t lba;
+    struct ws_split * sp = (struct ws_split *)v_sp;
+    const struct opts_t * op = sp->op;
+
+    while (true) {
+        split_lock(sp);
+        more = split_next_cmd(sp, &lba, &num);
+        start_us = 0;
+        if (more && (op->rate > 0)) {
+            /* each command takes its share of the rate, in turn */
+            now_us = split_now_us();
+            start_us = (sp->next_us > now_us) ? sp->next_us : now_us;
+            sp->next_us = start_us +
+                          (int64_t)(((uint64_t)num * 1000000) / op->rate);
+            start_us -= now_us;
+        }
+        split_unlock(sp);
+        if (! more)
+            break;
+        if (start_us > 0)
+            split_sleep_us(start_us);
+        cdb_len = op->pref_cdb_size;
+        res = do_write_same(sp->sg_fd, op, lba, num, sp->dataoutp, &cdb_len);
+        split_lock(sp);
+        sp->cdb_len = cdb_len;
+        if (res) {
+            if (0 == sp->ret) {
+                sp->ret = res;
+                sp->fail_lba = lba;
+            }
+            sp->stop = true;
+        } else {
+            ++sp->num_cmds;
+            sp->blks_done += num;
+            if (op->progress) {
+                now_us = split_now_us();
+                if ((now_us - sp->prog_us) >= (PROGRESS_SECS * 1000000)) {
+                    sp->prog_us = now_us;
+                    split_progress(sp, now_us);
+                }
+            }
+        }
+        split_unlock(sp);
+    }
+    return NULL;
+}
+
+/* Places the LBA of the last block on the device of the session in
+ * *last_lbap. Returns 0 if ok, else an error. */
+static int
+get_last_lba(struct sg_dev_sess * dsp, uint64_t * last_lbap)
+{
+    int res;
+    const struct sg_ds_cap * cp;
+
+    res = sg_ds_get_cap(dsp, &cp);
+    if (SG_LIB_CAT_UNIT_ATTENTION == res) {
+        pr2serr("Read capacity unit attention, try again\n");
+        res = sg_ds_get_cap(dsp, &cp);
+    }
+    if (0 == res)
+        *last_lbap = cp->num_blocks - 1;
+    else
+        pr2serr("Read capacity failed\n");
+    if (res < 0)
+        res = sg_convert_errno(-res);
+    return res;
+}
+
+/* The --split path: NUM blocks from LBA (to the end of DEVICE when NUM is
+ * 0) are written with WRITE SAME commands fitted to the Block Limits VPD
+ * page, up to JOBS at a time. Returns 0 if ok, else the error of the first
+ * that failed. */
+static int
+split_write_same(struct sg_dev_sess * dsp, const struct opts_t * op,
+                 const void * dataoutp, int * act_cdb_lenp)
+{
+    int res;
+    int num_jobs = op->num_jobs;
+    int vb = op->verbose;
+    uint64_t num_cmds;
+    uint64_t last_lba = 0;
+    struct ws_split a_split;
+    struct ws_split * sp = &a_split;
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    memset(sp, 0, sizeof(*sp));
+    sp->sg_fd = dsp->sg_fd;
+    sp->op = op;
+    sp->dataoutp = dataoutp;
+    sp->cdb_len = op->pref_cdb_size;
+    if (act_cdb_lenp)
+        *act_cdb_lenp = sp->cdb_len;
+    res = get_last_lba(dsp, &last_lba);
+    if (res)
+        return res;
+    if ((op->lba > last_lba) ||
+        (op->num_blks && (op->num_blks > (last_lba + 1 - op->lba)))) {
+        pr2serr("LBA 0x%" PRIx64 " and NUM %" PRIu64 " go past the last "
+                "LBA (0x%" PRIx64 ")\n", op->lba, op->num_blks, last_lba);
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    }
+    sp->next_lba = op->lba;
+    sp->end_lba = op->num_blks ? (op->lba + op->num_blks) : (last_lba + 1);
+    sp->total = sp->end_lba - sp->next_lba;
+    split_get_limits(sp, dsp);
+    num_cmds = (sp->total + sp->chunk - 1) / sp->chunk;
+    if ((uint64_t)num_jobs > num_cmds)
+        num_jobs = (int)num_cmds;
+    if (vb)
+        pr2serr("Split %" PRIu64 " blocks from LBA 0x%" PRIx64 " into about %"
+                PRIu64 " WRITE SAME commands, up to %d at a time\n",
+                sp->total, op->lba, num_cmds, num_jobs);
+    sp->start_us = split_now_us();
+    sp->prog_us = sp->start_us;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&sp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, split_worker, sp))) {
+            if (vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    split_worker(sp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&sp->mtx);
+#else
+    split_worker(sp);
+#endif
+    if (act_cdb_lenp)
+        *act_cdb_lenp = sp->cdb_len;
+    if (sp->ret)
+        pr2serr("WRITE SAME from LBA 0x%" PRIx64 " failed, %d command%s (%"
+                PRIu64 " blocks) had completed\n", sp->fail_lba,
+                sp->num_cmds, (1 == sp->num_cmds) ? "" : "s",
+                sp->blks_done);
+    else if (vb || op->progress) {
+        if (op->progress)
+            split_progress(sp, split_now_us());
+        pr2serr("Completed %d WRITE SAME commands, %" PRIu64 " blocks in "
+                "%.3f seconds\n", sp->num_cmds, sp->blks_done,
+                (double)(split_now_us() - sp->start_us) / 1000000.0);
+    }
+    return sp->ret;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -313,6 +690,7 @@ main(int argc, char * argv[])
     bool if_given = false;
     bool lba_given = false;
     bool num_given = false;
+    bool jobs_given = false;
     bool prot_en;
     int res, c, infd, act_cdb_len, vb, err;
     int sg_fd = -1;
@@ -325,19 +703,20 @@ main(int argc, char * argv[])
     uint8_t * free_wBuff = NULL;
     char ebuff[EBUFF_SZ];
     char b[80];
-    uint8_t resp_buff[RCAP16_RESP_LEN];
+    struct sg_dev_sess ds;
     struct opts_t opts;
     struct stat a_stat;
 
     op = &opts;
     memset(op, 0, sizeof(opts));
-    op->numblocks = DEF_WS_NUMBLOCKS;
+    op->num_blks = DEF_WS_NUMBLOCKS;
+    op->num_jobs = DEF_JOBS;
     op->pref_cdb_size = DEF_WS_CDB_SIZE;
     op->timeout = DEF_TIMEOUT_SECS;
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "ag:hi:l:Ln:NPRSt:TUvVw:x:",
+        c = getopt_long(argc, argv, "ac:g:hi:j:l:Ln:NpPr:RsSt:TUvVw:x:",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -346,6 +725,14 @@ main(int argc, char * argv[])
         case 'a':
             op->anchor = true;
             break;
+        case 'c':
+            ll = sg_get_llnum(optarg);
+            if ((ll < 1) || (ll > UINT32_MAX)) {
+                pr2serr("bad argument to '--chunk'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->chunk = (uint32_t)ll;
+            break;
         case 'g':
             op->grpnum = sg_get_num(optarg);
             if ((op->grpnum < 0) || (op->grpnum > 63))  {
@@ -362,6 +749,15 @@ main(int argc, char * argv[])
             op->ifilename[sizeof(op->ifilename) - 1] = '\0';
             if_given = true;
             break;
+        case 'j':
+            op->num_jobs = sg_get_num(optarg);
+            if ((op->num_jobs < 1) || (op->num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs=' should be 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            jobs_given = true;
+            break;
         case 'l':
             ll = sg_get_llnum(optarg);
             if (-1 == ll) {
@@ -375,22 +771,37 @@ main(int argc, char * argv[])
             op->lbdata = true;
             break;
         case 'n':
-            op->numblocks = sg_get_num(optarg);
-            if (op->numblocks < 0)  {
+            ll = sg_get_llnum(optarg);
+            if (ll < 0)  {
                 pr2serr("bad argument to '--num'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+            op->num_blks = (uint64_t)ll;
             num_given = true;
             break;
         case 'N':
             op->ndob = true;
             break;
+        case 'p':
+            op->progress = true;
+            break;
         case 'P':
             op->pbdata = true;
             break;
+        case 'r':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("bad argument to '--rate='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->rate = (uint64_t)ll;
+            break;
         case 'R':
             op->want_ws10 = true;
             break;
+        case 's':
+            op->split = true;
+            break;
         case 'S':
             if (DEF_WS_CDB_SIZE != op->pref_cdb_size) {
                 pr2serr("only one '--10', '--16' or '--32' please\n");
@@ -458,6 +869,18 @@ main(int argc, char * argv[])
         pr2serr("only one '--10', '--16' or '--32' please\n");
         return SG_LIB_CONTRADICT;
     }
+    if (op->split)
+        ;
+    else if (op->chunk || jobs_given || op->progress || op->rate) {
+        pr2serr("--chunk=, --jobs=, --progress and --rate= need "
+                "--split\n");
+        return SG_LIB_CONTRADICT;
+    } else if (op->num_blks > INT_MAX) {
+        pr2serr("bad argument to '--num', at most %d without --split\n",
+                INT_MAX);
+        return SG_LIB_SYNTAX_ERROR;
+    } else
+        op->numblocks = (int)op->num_blks;
 
 #ifdef DEBUG
     pr2serr("In DEBUG mode, ");
@@ -527,48 +950,27 @@ main(int argc, char * argv[])
         ret = sg_convert_errno(-sg_fd);
         goto err_out;
     }
+    sg_ds_init(&ds, sg_fd, (vb > 1) ? vb - 1 : 0);
 
     if (! op->ndob) {
         prot_en = false;
         if (0 == op->xfer_len) {
-            res = sg_ll_readcap_16(sg_fd, false /* pmi */, 0 /* llba */,
-                                   resp_buff, RCAP16_RESP_LEN, true,
-                                   (vb ? (vb - 1): 0));
+            const struct sg_ds_cap * cp;
+
+            res = sg_ds_get_cap(&ds, &cp);
             if (SG_LIB_CAT_UNIT_ATTENTION == res) {
-                pr2serr("Read capacity(16) unit attention, try again\n");
-                res = sg_ll_readcap_16(sg_fd, false, 0, resp_buff,
-                                       RCAP16_RESP_LEN, true,
-                                       (vb ? (vb - 1): 0));
+                pr2serr("Read capacity unit attention, try again\n");
+                res = sg_ds_get_cap(&ds, &cp);
             }
             if (0 == res) {
-                if (vb > 3)
-                    hex2stderr(resp_buff, RCAP16_RESP_LEN, 1);
-                block_size = sg_get_unaligned_be32(resp_buff + 8);
-                prot_en = !!(resp_buff[12] & 0x1);
+                block_size = cp->lb_size;
+                prot_en = cp->prot_en;
                 op->xfer_len = block_size;
                 if (prot_en && (op->wrprotect > 0))
                     op->xfer_len += 8;
-            } else if ((SG_LIB_CAT_INVALID_OP == res) ||
-                       (SG_LIB_CAT_ILLEGAL_REQ == res)) {
-                if (vb)
-                    pr2serr("Read capacity(16) not supported, try Read "
-                            "capacity(10)\n");
-                res = sg_ll_readcap_10(sg_fd, false /* pmi */, 0 /* lba */,
-                                       resp_buff, RCAP10_RESP_LEN, true,
-                                       (vb ? (vb - 1): 0));
-                if (0 == res) {
-                    if (vb > 3)
-                        hex2stderr(resp_buff, RCAP10_RESP_LEN, 1);
-                    block_size = sg_get_unaligned_be32(resp_buff + 4);
-                    op->xfer_len = block_size;
-                } else {
-                    sg_get_category_sense_str(res, sizeof(b), b, vb);
-                    pr2serr("Read capacity(10): %s\n", b);
-                    pr2serr("Unable to calculate block size\n");
-                }
-            } else if (vb) {
+            } else {
                 sg_get_category_sense_str(res, sizeof(b), b, vb);
-                pr2serr("Read capacity(16): %s\n", b);
+                pr2serr("Read capacity: %s\n", b);
                 pr2serr("Unable to calculate block size\n");
             }
         }
@@ -637,7 +1039,11 @@ main(int argc, char * argv[])
         }
     }
 
-    ret = do_write_same(sg_fd, op, wBuff, &act_cdb_len);
+    if (op->split)
+        ret = split_write_same(&ds, op, wBuff, &act_cdb_len);
+    else
+        ret = do_write_same(sg_fd, op, op->lba, (uint32_t)op->numblocks,
+                            wBuff, &act_cdb_len);
     if (ret) {
         sg_get_category_sense_str(ret, sizeof(b), b, vb);
         pr2serr("Write same(%d): %s\n", act_cdb_len, b);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2019 Douglas Gilbert
+ * Copyright (c) 2014-2026 Douglas Gilbert
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -10,7 +10,8 @@
  * device. It sends the command with the logical block address passed as the
  * LBA argument, for the given number of blocks. The number of bytes sent is
  * supplied separately, either by the size of the given file (IF) or
- * explicitly with ILEN.
+ * explicitly with ILEN. With --stream a large range is covered by many
+ * commands, several in flight at once, with generated data.
  *
  * This code was contributed by Bruno Goncalves
  */
@@ -34,13 +35,18 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_cmds_basic.h"
+#include "sg_cmds_extra.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.16 20190113";
+static const char * version_str = "1.17 20261014";
 
 
 #define ME "sg_write_verify: "
@@ -56,19 +62,34 @@ static const char * version_str = "1.16 20190113";
 #define WRPROTECT_SHIFT (5)
 
 #define DEF_TIMEOUT_SECS 60
+#define DEF_STREAM_BLKS 2048    /* per command without Block Limits */
+#define DEF_JOBS 4              /* commands in flight, --stream */
+#define MAX_JOBS 256
+#define PROGRESS_SECS 2         /* between --progress lines */
+
+enum wv_pattern {
+    PAT_BYTE = 0,       /* every byte the same, def: 0xff */
+    PAT_LBA,            /* each block filled with its LBA (8 bytes, BE) */
+    PAT_RANDOM,         /* pseudo random, seeded by each block's LBA */
+};
 
 
 static struct option long_options[] = {
     {"16", no_argument, 0, 'S'},
     {"bytchk", required_argument, 0, 'b'},
+    {"chunk", required_argument, 0, 'c'},
     {"dpo", no_argument, 0, 'd'},
     {"group", required_argument, 0, 'g'},
     {"help", no_argument, 0, 'h'},
     {"ilen", required_argument, 0, 'I'},
     {"in", required_argument, 0, 'i'},
+    {"jobs", required_argument, 0, 'j'},
     {"lba", required_argument, 0, 'l'},
     {"num", required_argument, 0, 'n'},
+    {"pattern", required_argument, 0, 'p'},
+    {"progress", no_argument, 0, 'P'},
     {"repeat", no_argument, 0, 'R'},
+    {"stream", no_argument, 0, 's'},
     {"timeout", required_argument, 0, 't'},
     {"verbose", no_argument, 0, 'v'},
     {"version", no_argument, 0, 'V'},
@@ -80,16 +101,21 @@ static struct option long_options[] = {
 static void
 usage()
 {
-    pr2serr("Usage: sg_write_verify [--16] [--bytchk=BC] [--dpo] [--group=GN] "
-            "[--help]\n"
-            "                       [--ilen=IL] [--in=IF] --lba=LBA "
-            "[--num=NUM]\n"
-            "                       [--repeat] [--timeout=TO] [--verbose] "
-            "[--version]\n"
-            "                       [--wrprotect=WPR] DEVICE\n"
+    pr2serr("Usage: sg_write_verify [--16] [--bytchk=BC] [--chunk=CB] [--dpo] "
+            "[--group=GN]\n"
+            "                       [--help] [--ilen=IL] [--in=IF] "
+            "[--jobs=JOBS]\n"
+            "                       --lba=LBA [--num=NUM] [--pattern=PAT] "
+            "[--progress]\n"
+            "                       [--repeat] [--stream] [--timeout=TO] "
+            "[--verbose]\n"
+            "                       [--version] [--wrprotect=WPR] DEVICE\n"
             "  where:\n"
             "    --16|-S              do WRITE AND VERIFY(16) (default: 10)\n"
             "    --bytchk=BC|-b BC    set BYTCHK field (default: 0)\n"
+            "    --chunk=CB|-c CB     with --stream, at most CB blocks per "
+            "command (def:\n"
+            "                         from Block Limits, else 2048)\n"
             "    --dpo|-d             set DPO bit (default: 0)\n"
             "    --group=GN|-g GN     GN is group number (default: 0)\n"
             "    --help|-h            print out usage message\n"
@@ -99,15 +125,28 @@ usage()
             "size)\n"
             "    --in=IF|-i IF        IF is a file containing the data to "
             "be written\n"
+            "    --jobs=JOBS|-j JOBS    with --stream, commands in flight at "
+            "once (def: 4)\n"
             "    --lba=LBA|-l LBA     LBA of the first block to write "
             "and verify;\n"
             "                         no default, must be given\n"
             "    --num=NUM|-n NUM     logical blocks to write and verify "
             "(def: 1)\n"
+            "                         with --stream NUM==0 means to the end\n"
+            "    --pattern=PAT|-p PAT    data written when no IF: a byte "
+            "value (def:\n"
+            "                            0xff), 'lba' or 'random'\n"
+            "    --progress|-P        with --stream, report progress every "
+            "2 seconds\n"
             "    --repeat|-R          while IF still has data to read, send "
             "another\n"
             "                         command, bumping LBA with up to NUM "
             "blocks again\n"
+            "    --stream|-s          write and verify NUM blocks from LBA "
+            "in commands of\n"
+            "                         up to CB blocks, JOBS in flight, then "
+            "report\n"
+            "                         throughput\n"
             "    --timeout=TO|-t TO   command timeout in seconds (def: 60)\n"
             "    --verbose|-v         increase verbosity\n"
             "    --version|-V         print version string then exit\n"
@@ -115,8 +154,9 @@ usage()
             "(def: 0)\n\n"
             "Performs a SCSI WRITE AND VERIFY (10 or 16) command on DEVICE, "
             "startings\nat LBA for NUM logical blocks. More commands "
-            "performed only if '--repeat'\noption given. Data to be written "
-            "is fetched from the IF file.\n"
+            "performed only if '--repeat'\nor '--stream' option given. Data "
+            "to be written is fetched from the IF\nfile or generated from "
+            "PAT.\n"
          );
 }
 
@@ -266,6 +306,376 @@ open_if(const char * fn, int got_stdin)
     return fd;
 }
 
+/* Fills num_lb blocks of b_p_lb bytes at bp, the first of which is lba,
+ * with the pattern. Only the first lb_sz bytes of each block are user data;
+ * any remaining (protection information) bytes are set to 0xff so that
+ * the DEVICE does not check them. */
+static void
+fill_pattern(uint8_t * bp, enum wv_pattern pat, int pat_byte, uint64_t lba,
+             int num_lb, int b_p_lb, int lb_sz)
+{
+    int k, j;
+    uint64_t x;
+
+    if (PAT_BYTE == pat) {
+        if (b_p_lb == lb_sz) {
+            memset(bp, pat_byte, (size_t)num_lb * b_p_lb);
+            return;
+        }
+    }
+    for (k = 0; k < num_lb; ++k, ++lba, bp += b_p_lb) {
+        switch (pat) {
+        case PAT_LBA:
+            for (j = 0; (j + 8) <= lb_sz; j += 8)
+                sg_put_unaligned_be64(lba, bp + j);
+            if (j < lb_sz)
+                memset(bp + j, 0, lb_sz - j);
+            break;
+        case PAT_RANDOM:
+            /* xorshift64, the same blocks get the same data each run */
+            x = (lba + 1) * 0x9e3779b97f4a7c15ULL;
+            for (j = 0; (j + 8) <= lb_sz; j += 8) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                sg_put_unaligned_le64(x, bp + j);
+            }
+            if (j < lb_sz)
+                memset(bp + j, (int)(x & 0xff), lb_sz - j);
+            break;
+        case PAT_BYTE:
+        default:
+            memset(bp, pat_byte, lb_sz);
+            break;
+        }
+        if (b_p_lb > lb_sz)
+            memset(bp + lb_sz, 0xff, b_p_lb - lb_sz);
+    }
+}
+
+/* Parameters of --stream and the progress through its commands, shared by
+ * the threads issuing them */
+struct wv_stream {
+    bool stop;                  /* set by first failed command */
+    bool do_16;
+    bool dpo;
+    bool progress;
+    enum wv_pattern pat;
+    int sg_fd;
+    struct sg_dev_sess ds;      /* of sg_fd */
+    int ret;                    /* of first failed command */
+    int bytchk;
+    int group;
+    int wrprotect;
+    int timeout;
+    int verbose;
+    int pat_byte;
+    int lb_sz;                  /* logical block size, user data */
+    int b_p_lb;                 /* bytes in data-out for each block */
+    uint32_t chunk;             /* blocks in one command, at most */
+    uint32_t gran;              /* optimal transfer length granularity */
+    uint64_t num_cmds;          /* commands completed */
+    uint64_t next_lba;          /* where the next command starts */
+    uint64_t end_lba;           /* one past the last block */
+    uint64_t total;             /* blocks to write and verify */
+    uint64_t blks_done;         /* by the completed commands */
+    uint64_t fail_lba;          /* start of the first that failed */
+    uint32_t fail_num;
+    uint64_t start_ns;
+    uint64_t prog_ns;           /* when progress was last reported */
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static void
+stream_lock(struct wv_stream * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+static void
+stream_unlock(struct wv_stream * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+/* Sets the logical block size and the bytes per block in the data-out
+ * buffer (more when protection information is sent), and places the last
+ * LBA in *last_lbap. Returns 0 if ok, else an error. */
+static int
+stream_get_capacity(struct wv_stream * sp, uint64_t * last_lbap)
+{
+    int res;
+    const struct sg_ds_cap * cp;
+
+    res = sg_ds_get_cap(&sp->ds, &cp);
+    if (SG_LIB_CAT_UNIT_ATTENTION == res) {
+        pr2serr("Read capacity unit attention, try again\n");
+        res = sg_ds_get_cap(&sp->ds, &cp);
+    }
+    if (0 == res) {
+        *last_lbap = cp->num_blocks - 1;
+        sp->lb_sz = (int)cp->lb_size;
+        sp->b_p_lb = sp->lb_sz;
+        if (cp->prot_en && (sp->wrprotect > 0))
+            sp->b_p_lb += 8;
+    } else
+        pr2serr("Read capacity failed\n");
+    if (res < 0)
+        res = sg_convert_errno(-res);
+    else if ((0 == res) && (sp->lb_sz < 1)) {
+        pr2serr("logical block size of %d unusable\n", sp->lb_sz);
+        res = SG_LIB_CAT_MALFORMED;
+    }
+    return res;
+}
+
+/* Sets the most blocks in one command from --chunk=CB and the Block Limits
+ * VPD page: the optimal transfer length when CB is not given, capped by the
+ * maximum transfer length. Commands end on optimal transfer length
+ * granularity boundaries. */
+static void
+stream_get_limits(struct wv_stream * sp, uint32_t chunk)
+{
+    int vb = sp->verbose;
+    uint32_t mtl, otl;
+    const struct sg_ds_blk_lim * blp;
+
+    sp->chunk = chunk ? chunk : DEF_STREAM_BLKS;
+    sp->gran = 1;
+    if (sg_ds_get_blk_lim(&sp->ds, &blp) || (blp->page_len < 0xc)) {
+        if (vb)
+            pr2serr("No usable Block Limits VPD page, so at most %u blocks "
+                    "per command\n", sp->chunk);
+    } else {
+        mtl = blp->max_xfer_len;
+        otl = blp->opt_xfer_len;
+        if ((0 == chunk) && otl)
+            sp->chunk = otl;
+        if (mtl && (sp->chunk > mtl)) {
+            if (chunk)
+                pr2serr("--chunk=%u exceeds maximum transfer length, reduced "
+                        "to %u\n", chunk, mtl);
+            sp->chunk = mtl;
+        }
+        sp->gran = blp->opt_xfer_gran;
+        if ((sp->gran > 1) && (sp->chunk >= sp->gran))
+            sp->chunk -= sp->chunk % sp->gran;
+        else
+            sp->gran = 1;
+        if (vb)
+            pr2serr("Block limits: maximum transfer length: %u, optimal: %u, "
+                    "granularity: %u,\n    so at most %u blocks per command\n",
+                    mtl, otl, sp->gran, sp->chunk);
+    }
+    if ((! sp->do_16) && (sp->chunk > 0xffff))
+        sp->do_16 = true;
+}
+
+/* Takes the next command of --stream, placing its start in *lbap and its
+ * number of blocks in *nump. Returns false when there are no more. Call
+ * with lock held. */
+static bool
+stream_next_cmd(struct wv_stream * sp, uint64_t * lbap, uint32_t * nump)
+{
+    uint64_t lba = sp->next_lba;
+    uint64_t n, r;
+
+    if (sp->stop || (lba >= sp->end_lba))
+        return false;
+    n = sp->end_lba - lba;
+    if (n > sp->chunk)
+        n = sp->chunk;
+    if (((lba + n) < sp->end_lba) && (sp->gran > 1)) {
+        /* end on a boundary so the commands after this one are aligned */
+        r = (lba + n) % sp->gran;
+        if (r < n)
+            n -= r;
+    }
+    *lbap = lba;
+    *nump = (uint32_t)n;
+    sp->next_lba += n;
+    return true;
+}
+
+/* Reports progress to stderr. Call with lock held. */
+static void
+stream_progress(const struct wv_stream * sp, uint64_t now_ns)
+{
+    double secs = (double)(now_ns - sp->start_ns) / 1e9;
+    double bps = (secs > 0.0) ? ((double)sp->blks_done / secs) : 0.0;
+
+    pr2serr("%5.1f%% done: %" PRIu64 " of %" PRIu64 " blocks, %.1f MB/s",
+            (100.0 * (double)sp->blks_done) / (double)sp->total,
+            sp->blks_done, sp->total, (bps * sp->lb_sz) / 1e6);
+    if ((bps > 0.0) && (sp->blks_done < sp->total))
+        pr2serr(", about %.0f seconds left",
+                (double)(sp->total - sp->blks_done) / bps);
+    pr2serr("\n");
+}
+
+static void *
+stream_worker(void * v_sp)
+{
+    bool more;
+    int res;
+    uint32_t num;
+    uint64_t lba, now_ns;
+    struct wv_stream * sp = (struct wv_stream *)v_sp;
+    int vb = (sp->verbose > 1) ? sp->verbose - 1 : 0;
+    uint8_t * bp;
+    uint8_t * free_bp = NULL;
+
+    /* each thread has its own data-out buffer */
+    bp = (uint8_t *)sg_memalign((uint32_t)sp->chunk * sp->b_p_lb, 0,
+                                &free_bp, false);
+    if (NULL == bp) {
+        pr2serr(ME "out of memory\n");
+        stream_lock(sp);
+        if (0 == sp->ret)
+            sp->ret = sg_convert_errno(ENOMEM);
+        sp->stop = true;
+        stream_unlock(sp);
+        return NULL;
+    }
+    if (PAT_BYTE == sp->pat)
+        fill_pattern(bp, sp->pat, sp->pat_byte, 0, sp->chunk, sp->b_p_lb,
+                     sp->lb_sz);
+    while (true) {
+        stream_lock(sp);
+        more = stream_next_cmd(sp, &lba, &num);
+        stream_unlock(sp);
+        if (! more)
+            break;
+        if (PAT_BYTE != sp->pat)
+            fill_pattern(bp, sp->pat, sp->pat_byte, lba, num, sp->b_p_lb,
+                         sp->lb_sz);
+        if (sp->do_16)
+            res = sg_ll_write_verify16(sp->sg_fd, sp->wrprotect, sp->dpo,
+                                       sp->bytchk, lba, num, sp->group, bp,
+                                       num * sp->b_p_lb, sp->timeout,
+                                       sp->verbose > 0, vb);
+        else
+            res = sg_ll_write_verify10(sp->sg_fd, sp->wrprotect, sp->dpo,
+                                       sp->bytchk, (unsigned int)lba, num,
+                                       sp->group, bp, num * sp->b_p_lb,
+                                       sp->timeout, sp->verbose > 0, vb);
+        stream_lock(sp);
+        if (res) {
+            if (0 == sp->ret) {
+                sp->ret = (res > 0) ? res : SG_LIB_CAT_OTHER;
+                sp->fail_lba = lba;
+                sp->fail_num = num;
+            }
+            sp->stop = true;
+        } else {
+            ++sp->num_cmds;
+            sp->blks_done += num;
+            if (sp->progress) {
+                now_ns = sg_pt_lat_now_ns();
+                if ((now_ns - sp->prog_ns) >=
+                    ((uint64_t)PROGRESS_SECS * 1000000000)) {
+                    sp->prog_ns = now_ns;
+                    stream_progress(sp, now_ns);
+                }
+            }
+        }
+        stream_unlock(sp);
+    }
+    free(free_bp);
+    return NULL;
+}
+
+/* The --stream path: num_blks blocks starting at lba (to the end of DEVICE
+ * when num_blks is 0) are written and verified with commands of up to
+ * chunk blocks, num_jobs of them at a time. The throughput is reported to
+ * stdout. Returns 0 if ok, else the error of the first that failed. */
+static int
+stream_write_verify(struct wv_stream * sp, uint64_t lba, uint64_t num_blks,
+                    uint32_t chunk, int num_jobs)
+{
+    int res;
+    uint64_t n_cmds, el_ns;
+    uint64_t last_lba = 0;
+    double secs, mb;
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    res = stream_get_capacity(sp, &last_lba);
+    if (res)
+        return res;
+    if ((lba > last_lba) ||
+        (num_blks && (num_blks > (last_lba + 1 - lba)))) {
+        pr2serr("LBA 0x%" PRIx64 " and NUM %" PRIu64 " go past the last "
+                "LBA (0x%" PRIx64 ")\n", lba, num_blks, last_lba);
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    }
+    sp->next_lba = lba;
+    sp->end_lba = num_blks ? (lba + num_blks) : (last_lba + 1);
+    sp->total = sp->end_lba - sp->next_lba;
+    if ((! sp->do_16) && ((sp->end_lba - 1) > UINT_MAX))
+        sp->do_16 = true;
+    stream_get_limits(sp, chunk);
+    n_cmds = (sp->total + sp->chunk - 1) / sp->chunk;
+    if ((uint64_t)num_jobs > n_cmds)
+        num_jobs = (int)n_cmds;
+    if (sp->verbose)
+        pr2serr("Stream %" PRIu64 " blocks from LBA 0x%" PRIx64 " as about %"
+                PRIu64 " Write and verify(%d) commands, up to %d at a "
+                "time\n", sp->total, lba, n_cmds, (sp->do_16 ? 16 : 10),
+                num_jobs);
+    sp->start_ns = sg_pt_lat_now_ns();
+    sp->prog_ns = sp->start_ns;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&sp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, stream_worker, sp))) {
+            if (sp->verbose)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    stream_worker(sp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&sp->mtx);
+#else
+    num_jobs = 1;
+    stream_worker(sp);
+#endif
+    el_ns = sg_pt_lat_now_ns() - sp->start_ns;
+    secs = (el_ns > 0) ? (el_ns / 1e9) : 1.0;
+    if (sp->progress && (0 == sp->ret))
+        stream_progress(sp, sp->start_ns + el_ns);
+    if (sp->ret) {
+        char b[80];
+
+        sg_get_category_sense_str(sp->ret, sizeof(b), b, sp->verbose);
+        pr2serr("Write and verify of %u blocks from LBA 0x%" PRIx64
+                " failed: %s\n", sp->fail_num, sp->fail_lba, b);
+    }
+    mb = ((double)sp->blks_done * sp->lb_sz) / 1e6;
+    printf("Write and verify(%d): %" PRIu64 " blocks (%.1f MB) in %" PRIu64
+           " commands, %.3f seconds\n", (sp->do_16 ? 16 : 10),
+           sp->blks_done, mb, sp->num_cmds, secs);
+    printf("  %.2f MB/sec, %.1f commands/sec, %d job%s, up to %u blocks "
+           "per command\n", mb / secs, sp->num_cmds / secs, num_jobs,
+           (1 == num_jobs) ? "" : "s", sp->chunk);
+    return sp->ret;
+}
+
 int
 main(int argc, char * argv[])
 {
@@ -275,7 +685,10 @@ main(int argc, char * argv[])
     bool given_do_16 = false;
     bool has_filename = false;
     bool lba_given = false;
+    bool pat_given = false;
+    bool progress = false;
     bool repeat = false;
+    bool stream = false;
     bool verbose_given = false;
     bool version_given = false;
     int sg_fd, res, c, n;
@@ -283,28 +696,33 @@ main(int argc, char * argv[])
     int group = 0;
     int ilen = -1;
     int ifd = -1;
+    int num_jobs = 0;
+    int pat_byte = 0xff;
     int b_p_lb = 512;
     int ret = 1;
     int timeout = DEF_TIMEOUT_SECS;
     int tnum_lb_wr = 0;
     int verbose = 0;
     int wrprotect = 0;
+    uint32_t chunk = 0;
     uint32_t num_lb = 1;
     uint32_t snum_lb = 1;
     uint64_t llba = 0;
+    uint64_t num_blks = 1;
     int64_t ll;
     uint8_t * wvb = NULL;
     uint8_t * wrkBuff = NULL;
     uint8_t * free_wrkBuff = NULL;
     const char * device_name = NULL;
     const char * ifnp;
+    enum wv_pattern pat = PAT_BYTE;
     char cmd_name[32];
 
     ifnp = "";          /* keep MinGW quiet */
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:dg:hi:I:l:n:RSt:w:vV", long_options,
+        c = getopt_long(argc, argv, "b:c:dg:hi:I:j:l:n:p:PRsSt:w:vV", long_options,
                        &option_index);
         if (c == -1)
             break;
@@ -319,6 +737,14 @@ main(int argc, char * argv[])
                 return SG_LIB_SYNTAX_ERROR;
             }
             break;
+        case 'c':
+            ll = sg_get_llnum(optarg);
+            if ((ll < 1) || (ll > UINT_MAX)) {
+                pr2serr("bad argument to '--chunk'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            chunk = (uint32_t)ll;
+            break;
         case 'd':
             dpo = true;
             break;
@@ -344,6 +770,14 @@ main(int argc, char * argv[])
                 return SG_LIB_SYNTAX_ERROR;
             }
             break;
+        case 'j':
+            num_jobs = sg_get_num(optarg);
+            if ((num_jobs < 1) || (num_jobs > MAX_JOBS)) {
+                pr2serr("argument to '--jobs=' should be 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             if (lba_given) {
                 pr2serr("must have one and only one '--lba'\n");
@@ -358,16 +792,38 @@ main(int argc, char * argv[])
             lba_given = true;
             break;
         case 'n':
-            n = sg_get_num(optarg);
-            if (-1 == n) {
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
                 pr2serr("bad argument to '--num'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
-            num_lb = (uint32_t)n;
+            num_blks = (uint64_t)ll;
+            break;
+        case 'p':
+            if (0 == strcmp(optarg, "lba"))
+                pat = PAT_LBA;
+            else if (0 == strcmp(optarg, "random"))
+                pat = PAT_RANDOM;
+            else {
+                pat_byte = sg_get_num(optarg);
+                if ((pat_byte < 0) || (pat_byte > 255)) {
+                    pr2serr("argument to '--pattern=' should be a byte "
+                            "value, 'lba' or 'random'\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                pat = PAT_BYTE;
+            }
+            pat_given = true;
+            break;
+        case 'P':
+            progress = true;
             break;
         case 'R':
             repeat = true;
             break;
+        case 's':
+            stream = true;
+            break;
         case 'S':
             do_16 = true;
             given_do_16 = true;
@@ -445,6 +901,26 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (stream) {
+        if (has_filename || repeat || (ilen > 0)) {
+            pr2serr("--stream generates its data so cannot be used with "
+                    "--in=, --ilen= or --repeat\n");
+            usage();
+            return SG_LIB_CONTRADICT;
+        }
+    } else if (chunk || num_jobs || progress) {
+        pr2serr("--chunk=, --jobs= and --progress need --stream\n");
+        return SG_LIB_CONTRADICT;
+    } else if (num_blks > UINT_MAX) {
+        pr2serr("bad argument to '--num', at most %u without --stream\n",
+                UINT_MAX);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (has_filename && pat_given) {
+        pr2serr("--pattern= is for when there is no --in=IF\n");
+        return SG_LIB_CONTRADICT;
+    }
+    num_lb = (uint32_t)num_blks;
     if (repeat) {
         if (! has_filename) {
             pr2serr("with '--repeat' need '--in=IF' option\n");
@@ -473,6 +949,26 @@ main(int argc, char * argv[])
         goto err_out;
     }
 
+    if (stream) {
+        struct wv_stream a_stream;
+
+        memset(&a_stream, 0, sizeof(a_stream));
+        a_stream.sg_fd = sg_fd;
+        sg_ds_init(&a_stream.ds, sg_fd, (verbose > 1) ? verbose - 1 : 0);
+        a_stream.do_16 = do_16;
+        a_stream.dpo = dpo;
+        a_stream.progress = progress;
+        a_stream.pat = pat;
+        a_stream.pat_byte = pat_byte;
+        a_stream.bytchk = bytchk;
+        a_stream.group = group;
+        a_stream.wrprotect = wrprotect;
+        a_stream.timeout = timeout;
+        a_stream.verbose = verbose;
+        ret = stream_write_verify(&a_stream, llba, num_blks, chunk,
+                                  (num_jobs > 0) ? num_jobs : DEF_JOBS);
+        goto err_out;
+    }
     if ((! do_16) && (llba > UINT_MAX))
         do_16 = true;
     if ((! do_16) && (num_lb > 0xffff))
@@ -561,8 +1057,17 @@ main(int argc, char * argv[])
                     goto err_out;
                 }
                 wvb = (uint8_t *)wrkBuff;
-                /* Not sure about this: default contents to 0xff bytes */
-                memset(wrkBuff, 0xff, ilen);
+                /* default contents: 0xff bytes unless --pattern= given */
+                if ((PAT_BYTE == pat) || (0 == num_lb) ||
+                    (ilen < (int)num_lb))
+                    memset(wrkBuff, pat_byte, ilen);
+                else {
+                    n = ilen / num_lb;
+                    fill_pattern(wrkBuff, pat, pat_byte, llba, num_lb, n, n);
+                    if (ilen > (int)(n * num_lb))
+                        memset(wrkBuff + (n * num_lb), 0xff,
+                               ilen - (n * num_lb));
+                }
             }
             first_time = false;
             snum_lb = num_lb;
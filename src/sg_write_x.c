@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2019 Douglas Gilbert.
+ * Copyright (c) 2017-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -31,6 +31,11 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#ifndef SG_LIB_WIN32
+#include <sys/mman.h>
+#include <pthread.h>
+#endif
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_cmds_basic.h"
@@ -38,7 +43,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.20 20190113";
+static const char * version_str = "1.24 20261014";
 
 /* Protection Information refers to 8 bytes of extra information usually
  * associated with each logical block and is often abbreviated to PI while
@@ -75,9 +80,22 @@ static const char * version_str = "1.20 20190113";
 #define DEF_RT 0xffffffff
 #define DEF_AT 0xffff
 #define DEF_TM 0xffff
+#define PI_DO_GEN 1     /* --pi=gen */
+#define PI_DO_CHK 2     /* --pi=chk */
 #define EBUFF_SZ 256
 
-#define MAX_NUM_ADDR 128
+#define MAX_JOBS 256
+#define BLOCK_LIMITS_EXT_VPD 0xb7
+#define BLOCK_LIMITS_EXT_VPD_LEN 32
+#define DEF_STREAM_LBARD 128    /* when VPD page doesn't report a maximum */
+#define DEF_STREAM_BLKS 2048    /* when VPD page doesn't report a maximum */
+#define MAX_STREAM_BYTES (8 * 1024 * 1024)   /* of data per command */
+#define BLOCK_LIMITS_VPD 0xb0
+#define BLOCK_LIMITS_VPD_LEN 64
+#define DEF_RANGE_BLKS 128      /* --jobs=JOBS, blocks per command */
+/* --jobs=JOBS latencies (other than WRITE SCATTERED) are kept in the
+ * sg_pt_lat_* histograms of DEVICE's file descriptor under this key */
+#define LAT_KEY_RANGE 0x1000
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -94,6 +112,7 @@ static struct option long_options[] = {
     {"atomic", required_argument, 0, 'A'},
     {"bmop", required_argument, 0, 'B'},
     {"bs", required_argument, 0, 'b'},
+    {"chunk", required_argument, 0, 'C'},
     {"combined", required_argument, 0, 'c'},
     {"dld", required_argument, 0, 'D'},
     {"dpo", no_argument, 0, 'd'},
@@ -104,11 +123,13 @@ static struct option long_options[] = {
     {"generation", required_argument, 0, 'G'},
     {"help", no_argument, 0, 'h'},
     {"in", required_argument, 0, 'i'},
+    {"jobs", required_argument, 0, 'j'},
     {"lba", required_argument, 0, 'l'},
     {"normal", no_argument, 0, 'N'},
     {"num", required_argument, 0, 'n'},
     {"offset", required_argument, 0, 'o'},
     {"or", no_argument, 0, 'O'},
+    {"pi", required_argument, 0, 'P'},
     {"quiet", no_argument, 0, 'Q'},
     {"ref-tag", required_argument, 0, 'r'},
     {"ref_tag", required_argument, 0, 'r'},
@@ -162,6 +183,8 @@ struct opts_t {
     int dry_run;        /* temporary write when used more than once */
     int grpnum;         /* "Group Number", 0 to 0x3f */
     int help;
+    int num_jobs;       /* --jobs=JOBS, streamed WRITE SCATTERED when > 0 */
+    int pi_do;          /* --pi=gen (PI_DO_GEN) or chk (PI_DO_CHK) */
     int pi_type;        /* -1: unknown: 0: type 0 (none): 1: type 1 */
     int strict;         /* > 0, report then exit on questionable meta data */
     int timeout;        /* timeout (in seconds) to abort SCSI commands */
@@ -180,6 +203,7 @@ struct opts_t {
                          * CAPACITY(10 or 16) to determine */
     uint32_t bs_pi_do;  /* logical block size plus PI, if any. This value is
                          * used as the actual block size */
+    uint32_t chunk;     /* --chunk=CB, blocks per command with --jobs=JOBS */
     uint32_t if_dlen;   /* bytes to read after .if_offset from .if_name,
                          * if 0 given, read rest of .if_name */
     uint32_t numblocks; /* defaults to 0, number of blocks (of user data) to
@@ -211,31 +235,36 @@ usage(int do_help)
         pr2serr("Usage:\n"
             "sg_write_x [--16] [--32] [--app-tag=AT] [--atomic=AB] "
             "[--bmop=OP,PGP]\n"
-            "           [--bs=BS] [--combined=DOF] [--dld=DLD] [--dpo] "
-            "[--dry-run]\n"
-            "           [--fua] [--generation=EOG,NOG] [--grpnum=GN] "
-            "[--help] --in=IF\n"
-            "           [--lba=LBA,LBA...] [--normal] [--num=NUM,NUM...]\n"
-            "           [--offset=OFF[,DLEN]] [--or] [--quiet] "
-            "[--ref-tag=RT]\n"
-            "           [--same=NDOB] [--scat-file=SF] [--scat-raw] "
-            "[--scattered=RD]\n"
-            "           [--stream=ID] [--strict] [--tag-mask=TM] "
-            "[--timeout=TO]\n"
-            "           [--unmap=U_A] [--verbose] [--version] "
-            "[--wrprotect=WRP]\n"
-            "           DEVICE\n");
+            "           [--bs=BS] [--chunk=CB] [--combined=DOF] [--dld=DLD] "
+            "[--dpo]\n"
+            "           [--dry-run]"
+            " [--fua] [--generation=EOG,NOG] [--grpnum=GN] "
+            "[--help]\n"
+            "           --in=IF"
+            " [--jobs=JOBS] [--lba=LBA,LBA...] [--normal]\n"
+            "           [--num=NUM,NUM...] [--offset=OFF[,DLEN]] [--or] "
+            "[--pi=gen|chk]\n"
+            "           [--quiet]"
+            " [--ref-tag=RT] [--same=NDOB] [--scat-file=SF] "
+            "[--scat-raw]\n"
+            "           [--scattered=RD] [--stream=ID] [--strict] "
+            "[--tag-mask=TM]\n"
+            "           [--timeout=TO] [--unmap=U_A] [--verbose] "
+            "[--version]\n"
+            "           [--wrprotect=WRP] DEVICE\n");
         if (1 != do_help) {
             pr2serr("\nOr the corresponding short option usage:\n"
                 "sg_write_x [-6] [-3] [-a AT] [-A AB] [-B OP,PGP] [-b BS] "
-                "[-c DOF] [-D DLD]\n"
-                "           [-d] [-x] [-f] [-G EOG,NOG] [-g GN] [-h] -i IF "
-                "[-l LBA,LBA...]\n"
-                "           [-N] [-n NUM,NUM...] [-o OFF[,DLEN]] [-O] [-Q] "
-                "[-r RT] [-M NDOB]\n"
-                "           [-q SF] [-R] [-S RD] [-T ID] [-s] [-t TM] [-I TO] "
-                "[-u U_A] [-v]\n"
-                "           [-V] [-w WPR] DEVICE\n"
+                "[-C CB] [-c DOF]\n"
+                "           [-D DLD]"
+                " [-d] [-x] [-f] [-G EOG,NOG] [-g GN] [-h] -i IF "
+                "[-j JOBS]\n"
+                "           [-l LBA,LBA...]"
+                " [-N] [-n NUM,NUM...] [-o OFF[,DLEN]] [-O]\n"
+                "           [-P gen|chk] [-Q]"
+                " [-r RT] [-M NDOB] [-q SF] [-R] [-S RD] [-T ID]\n"
+                "           [-s] [-t TM]"
+                " [-I TO] [-u U_A] [-v] [-V] [-w WPR] DEVICE\n"
                    );
             pr2serr("\nUse '-h' or '--help' for more help\n");
             return;
@@ -258,6 +287,10 @@ usage(int do_help)
             "if power of\n"
             "                       2: logical block size, otherwise: "
             "actual block size\n"
+            "    --chunk=CB|-C CB    with --jobs=JOBS: at most CB blocks per "
+            "command\n"
+            "                        (def: from Block Limits VPD page, else "
+            "128)\n"
             "    --combined=DOF|-c DOF    scatter list and data combined "
             "for WRITE\n"
             "                             SCATTERED, data starting at "
@@ -287,6 +320,14 @@ usage(int do_help)
             "                       Blocks written to DEVICE. 1 or no "
             "blocks read\n"
             "                       in the case of WRITE SAME\n"
+            "    --jobs=JOBS|-j JOBS    stream SF into as many WRITE "
+            "SCATTERED commands\n"
+            "                           as needed, JOBS of them in flight "
+            "at once.\n"
+            "                           Other commands: write NUM blocks "
+            "from LBA, in\n"
+            "                           pieces, JOBS at once; report IOPS "
+            "and latency\n"
             "    --lba=LBA,LBA...     list of LBAs (Logical Block Addresses) "
             "to start\n"
             "        |-l LBA,LBA...   writes (def: --lba=0). Alternative is "
@@ -303,6 +344,12 @@ usage(int do_help)
             "        |-o OFF[,DLEN]     (def: 0), then read DLEN bytes(def: "
             "rest of IF)\n"
             "    --or|-O            send ORWRITE command\n"
+            "    --pi=gen|chk|-P gen|chk    with WRP > 0: gen->replace "
+            "the PI after\n"
+            "                               each block from IF with "
+            "generated PI,\n"
+            "                               chk->check it before "
+            "sending\n"
             "    --quiet|-Q         suppress some informational messages\n"
             "    --ref-tag=RT|-r RT     expected reference tag field (def: "
             "0xffffffff)\n"
@@ -404,17 +451,19 @@ usage(int do_help)
             "  sg_write_x --scattered --in=IF --32 [--app-tag=AT] "
             "[--bs=BS]\n"
             "             [--combined=DOF] [--dpo] [--fua] [--grpnum=GN]\n"
-            "             [--lba=LBA,LBA...] [--num=NUM,NUM...] "
-            "[--offset=OFF[,DLEN]]\n"
-            "             [--ref-tag=RT] [--scat-file=SF] [--scat-raw] "
-            "[--strict]\n"
-            "             [--tag-mask=TM] [--timeout=TO] [--wrprotect=WRP] "
-            "DEVICE\n"
+            "             [--jobs=JOBS] [--lba=LBA,LBA...] "
+            "[--num=NUM,NUM...]\n"
+            "             [--offset=OFF[,DLEN]] [--ref-tag=RT] "
+            "[--scat-file=SF] [--scat-raw]\n"
+            "             [--strict]"
+            " [--tag-mask=TM] [--timeout=TO] [--wrprotect=WRP]\n"
+            "             DEVICE\n"
             "\n"
             "WRITE SCATTERED (16) applicable options:\n"
             "  sg_write_x --scattered --in=IF [--bs=BS] [--combined=DOF] "
             "[--dld=DLD]\n"
-            "             [--dpo] [--fua] [--grpnum=GN] [--lba=LBA,LBA...]\n"
+            "             [--dpo] [--fua] [--grpnum=GN] [--jobs=JOBS] "
+            "[--lba=LBA,LBA...]\n"
             "             [--num=NUM,NUM...] [--offset=OFF[,DLEN]] "
             "[--scat-raw]\n"
             "             [--scat-file=SF] [--strict] [--timeout=TO] "
@@ -477,6 +526,11 @@ usage(int do_help)
             " - when '--num=NUM,NUM...' is used on commands other than "
             "WRITE SCATTERED\n"
             "   then only the first NUM value is used.\n"
+            " - with --jobs=JOBS, commands other than WRITE SCATTERED "
+            "write NUM blocks\n"
+            "   from LBA with commands of up to CB blocks (see --chunk=CB), "
+            "JOBS of\n"
+            "   them in flight, then report IOPS, throughput and latency\n"
             " - whenever '--lba=LBA,LBA...' is used then "
             "'--num=NUM,NUM...' should\n"
             "   also be used. Also they should have the same number of "
@@ -527,127 +581,6 @@ all_ascii_f_s(const char * cp, int num_of_f_chars)
     return true;
 }
 
-/* Read numbers (up to 64 bits in size) from command line (comma (or
- * (single) space) separated list). Assumed decimal unless prefixed
- * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or 1 if error. */
-static int
-build_lba_arr(const char * inp, uint64_t * lba_arr, uint32_t * lba_arr_len,
-              int max_arr_len)
-{
-    int in_len, k;
-    int64_t ll;
-    const char * lcp;
-    char * cp;
-    char * c2p;
-
-    if ((NULL == inp) || (NULL == lba_arr) ||
-        (NULL == lba_arr_len))
-        return 1;
-    lcp = inp;
-    in_len = strlen(inp);
-    if (0 == in_len)
-        *lba_arr_len = 0;
-    if ('-' == inp[0]) {        /* read from stdin */
-        pr2serr("'--lba' cannot be read from stdin\n");
-        return 1;
-    } else {        /* list of numbers (default decimal) on command line */
-        k = strspn(inp, "0123456789aAbBcCdDeEfFhHxXiIkKmMgGtTpP, ");
-        if (in_len != k) {
-            pr2serr("build_lba_arr: error at pos %d\n", k + 1);
-            return 1;
-        }
-        for (k = 0; k < max_arr_len; ++k) {
-            ll = sg_get_llnum(lcp);
-            if (-1 != ll) {
-                lba_arr[k] = (uint64_t)ll;
-                cp = (char *)strchr(lcp, ',');
-                c2p = (char *)strchr(lcp, ' ');
-                if (NULL == cp)
-                    cp = c2p;
-                if (NULL == cp)
-                    break;
-                if (c2p && (c2p < cp))
-                    cp = c2p;
-                lcp = cp + 1;
-            } else {
-                pr2serr("build_lba_arr: error at pos %d\n",
-                        (int)(lcp - inp + 1));
-                return 1;
-            }
-        }
-        *lba_arr_len = (uint32_t)(k + 1);
-        if (k == max_arr_len) {
-            pr2serr("build_lba_arr: array length exceeded\n");
-            return 1;
-        }
-    }
-    return 0;
-}
-
-/* Read numbers (up to 32 bits in size) from command line (comma (or
- * (single) space) separated list). Assumed decimal unless prefixed
- * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, else a sg3_utils error code is returned. */
-static int
-build_num_arr(const char * inp, uint32_t * num_arr, uint32_t * num_arr_len,
-              int max_arr_len)
-{
-    int in_len, k;
-    const char * lcp;
-    int64_t ll;
-    char * cp;
-    char * c2p;
-
-    if ((NULL == inp) || (NULL == num_arr) ||
-        (NULL == num_arr_len))
-        return SG_LIB_LOGIC_ERROR;
-    lcp = inp;
-    in_len = strlen(inp);
-    if (0 == in_len)
-        *num_arr_len = 0;
-    if ('-' == inp[0]) {        /* read from stdin */
-        pr2serr("'--len' cannot be read from stdin\n");
-        return SG_LIB_SYNTAX_ERROR;
-    } else {        /* list of numbers (default decimal) on command line */
-        k = strspn(inp, "0123456789aAbBcCdDeEfFhHxXiIkKmMgGtTpP, ");
-        if (in_len != k) {
-            pr2serr("%s: error at pos %d\n", __func__, k + 1);
-            return SG_LIB_SYNTAX_ERROR;
-        }
-        for (k = 0; k < max_arr_len; ++k) {
-            ll = sg_get_llnum(lcp);
-            if (-1 != ll) {
-                if (ll > UINT32_MAX) {
-                    pr2serr("%s: number exceeds 32 bits at pos %d\n",
-                            __func__, (int)(lcp - inp + 1));
-                    return SG_LIB_SYNTAX_ERROR;
-                }
-                num_arr[k] = (uint32_t)ll;
-                cp = (char *)strchr(lcp, ',');
-                c2p = (char *)strchr(lcp, ' ');
-                if (NULL == cp)
-                    cp = c2p;
-                if (NULL == cp)
-                    break;
-                if (c2p && (c2p < cp))
-                    cp = c2p;
-                lcp = cp + 1;
-            } else {
-                pr2serr("%s: error at pos %d\n", __func__,
-                        (int)(lcp - inp + 1));
-                return SG_LIB_SYNTAX_ERROR;
-            }
-        }
-        *num_arr_len = (uint32_t)(k + 1);
-        if (k == max_arr_len) {
-            pr2serr("%s: array length exceeded\n", __func__);
-            return SG_LIB_SYNTAX_ERROR;
-        }
-    }
-    return 0;
-}
-
 /* Tries to parse LBA,NUM[,RT,AP,TM] on one line, comma separated. Returns
  * 0 if parsed ok, else 999 if nothing parsed, else error (currently always
  * SG_LIB_SYNTAX_ERROR). If protection information fields not given, then
@@ -1050,6 +983,75 @@ sum_num_lbards(const uint8_t * up, int num_lbards)
     return sum;
 }
 
+/* With --pi=gen the PI tuple that follows each logical block in the
+ * data-out buffer is replaced by one generated from that block; with
+ * --pi=chk each is checked instead. The reference tag for PI type 1 is the
+ * lower 32 bits of the block's LBA, for type 2 it starts from RT in the cdb
+ * (or in the LBA range descriptor when scattered). Returns 0 if
+ * successful, else sg3_utils error code. */
+static int
+process_pi(uint8_t * up, int dout_len, const struct opts_t * op)
+{
+    int res, bad;
+    int pi_type = op->pi_type;
+    uint16_t app_tag = (DEF_AT == op->app_tag) ? 0 : op->app_tag;
+    uint32_t num, rt, ref_tag;
+    uint32_t done = 0;
+    uint64_t lba = op->lba;
+    uint8_t * bp = up;
+    const uint8_t * rdp = up + lbard_sz;    /* first LBA range descriptor */
+
+    if ((NULL == up) || (0 == op->wrprotect) ||
+        (op->bs_pi_do != (op->bs + SG_T10_PI_LEN))) {
+        pr2serr("--pi= needs --wrprotect=WRP (WRP > 0), a data-out buffer "
+                "and one\n"
+                "8 byte PI tuple after each block\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (pi_type < 1)                /* unknown, guess from cdb length */
+        pi_type = op->do_32 ? 2 : 1;
+    if (op->do_scattered)
+        bp = up + (op->scat_lbdof * op->bs_pi_do);
+    num = op->do_same ? 1 : op->numblocks;
+    rt = op->ref_tag;
+    while (done < op->numblocks) {
+        if (op->do_scattered) {
+            if ((rdp + lbard_sz) > (up + (op->scat_lbdof * op->bs_pi_do)))
+                break;
+            lba = sg_get_unaligned_be64(rdp + 0);
+            num = sg_get_unaligned_be32(rdp + 8);
+            rt = op->do_32 ? sg_get_unaligned_be32(rdp + 12) : DEF_RT;
+            rdp += lbard_sz;
+        }
+        if ((bp + (num * op->bs_pi_do)) > (up + dout_len))
+            num = (up + dout_len - bp) / op->bs_pi_do;
+        if (0 == num)
+            break;
+        if (1 == pi_type)
+            ref_tag = (uint32_t)lba;
+        else if (2 == pi_type)
+            ref_tag = rt;
+        else
+            ref_tag = (DEF_RT == rt) ? (uint32_t)lba : rt;
+        if (PI_DO_GEN == op->pi_do)
+            sg_t10_pi_gen(bp, op->bs, num, app_tag, ref_tag, pi_type);
+        else if ((res = sg_t10_pi_chk(bp, op->bs, num, ref_tag, pi_type,
+                                      &bad))) {
+            pr2serr("--pi=chk: %s tag check failed for LBA 0x%" PRIx64 "\n",
+                    ((1 == res) ? "guard" : "reference"), lba + bad);
+            return SG_LIB_CAT_PROTECTION;
+        }
+        bp += num * op->bs_pi_do;
+        done += num;
+        if (op->do_same || (! op->do_scattered))
+            break;
+    }
+    if (op->verbose > 1)
+        pr2serr("    %s PI of %u blocks\n", (PI_DO_GEN == op->pi_do) ?
+                "generated" : "checked", done);
+    return 0;
+}
+
 /* Returns 0 if successful, else sg3_utils error code. */
 static int
 do_write_x(int sg_fd, const void * dataoutp, int dout_len,
@@ -1494,7 +1496,7 @@ do_read_capacity(int sg_fd, struct opts_t *op)
 
 #define WANT_ZERO_EXIT 9999
 static const char * const opt_long_ctl_str =
-    "36a:A:b:B:c:dD:Efg:G:hi:I:l:M:n:No:Oq:Qr:RsS:t:T:u:vVw:x";
+    "36a:A:b:B:c:C:dD:Efg:G:hi:I:j:l:M:n:No:OP:q:Qr:RsS:t:T:u:vVw:x";
 
 /* command line processing, options and arguments. Returns 0 if ok,
  * returns WANT_ZERO_EXIT so upper level yields an exist status of zero.
@@ -1610,6 +1612,15 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[],
         case 'd':
             op->dpo = true;
             break;
+        case 'C':
+            ll = sg_get_llnum(optarg);
+            if ((ll < 1) || (ll > UINT32_MAX)) {
+                pr2serr("bad argument to '--chunk=', expect 1 to "
+                        "0xffffffff\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->chunk = (uint32_t)ll;
+            break;
         case 'D':
             op->dld = sg_get_num(optarg);
             if ((op->dld < 0) || (op->dld > 7))  {
@@ -1665,6 +1676,14 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[],
                 return SG_LIB_SYNTAX_ERROR;
             }
             break;
+        case 'j':
+            op->num_jobs = sg_get_num(optarg);
+            if ((op->num_jobs < 1) || (op->num_jobs > MAX_JOBS)) {
+                pr2serr("bad argument to '--jobs=', expect 1 to %d\n",
+                        MAX_JOBS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'l':
             if (*lba_opp) {
                 pr2serr("only expect '--lba=' option once\n");
@@ -1786,6 +1805,16 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[],
         case 'V':
             op->version_given = true;
             break;
+        case 'P':
+            if (0 == strcmp(optarg, "gen"))
+                op->pi_do = PI_DO_GEN;
+            else if (0 == strcmp(optarg, "chk"))
+                op->pi_do = PI_DO_CHK;
+            else {
+                pr2serr("bad argument to '--pi=', expect 'gen' or 'chk'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'w':       /* WRPROTECT field (or ORPROTECT for ORWRITE) */
             op->wrprotect = sg_get_num(optarg);
             if ((op->wrprotect < 0) || (op->wrprotect > 7))  {
@@ -1822,8 +1851,7 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[],
 
 static int
 process_scattered(int sg_fd, int infd, uint32_t if_len, uint32_t if_rlen,
-                  int sfr_fd, uint32_t sf_len, uint64_t * addr_arr,
-                  uint32_t addr_arr_len, uint32_t * num_arr,
+                  int sfr_fd, uint32_t sf_len, struct sg_lba_set * lsp,
                   uint16_t num_lbard, uint32_t sum_num, struct opts_t * op)
 {
     int k, n, ret;
@@ -1938,8 +1966,8 @@ process_scattered(int sg_fd, int infd, uint32_t if_len, uint32_t if_rlen,
     }
 
     /* other than do_combined, so --scat-file= or --lba= */
-    if (addr_arr_len > 0)
-        num_lbard = addr_arr_len;
+    if (lsp->num > 0)
+        num_lbard = lsp->num;
 
     if (op->scat_filename && (! op->do_scat_raw)) {
         d = lbard_sz * (num_lbard + 1);
@@ -2090,19 +2118,42 @@ process_scattered(int sg_fd, int infd, uint32_t if_len, uint32_t if_rlen,
         do_len = (num_lbard + sum_num) * op->bs_pi_do;
         op->numblocks = sum_num;
         op->xfer_bytes = sum_num * op->bs_pi_do;
-    } else if (addr_arr_len > 0) {  /* build RDs for --lba= --num= */
-        if ((op->scat_num_lbard > 0) && (op->scat_num_lbard > addr_arr_len)) {
+    } else if (lsp->num > 0) {  /* build RDs for --lba= --num= */
+        uint64_t ull;
+        struct sg_lba_extent first = lsp->ext[0];
+
+        if ((op->scat_num_lbard > 0) &&
+            (op->scat_num_lbard > (uint32_t)lsp->num)) {
             pr2serr("%s: number given to --scattered= (%u) exceeds number of "
-                    "--lba= elements (%u)\n", __func__, op->scat_num_lbard,
-                    addr_arr_len);
+                    "--lba= elements (%d)\n", __func__, op->scat_num_lbard,
+                    lsp->num);
             return SG_LIB_CONTRADICT;
         }
+        /* RDs in ascending LBA order with overlapping and adjacent ranges
+         * merged; keep one RD if they were all of zero blocks */
+        ull = sg_lba_set_coalesce(lsp);
+        if (ull && vb)
+            pr2serr("%" PRIu64 " blocks in more than one --lba= range, "
+                    "merged\n", ull);
+        if (0 == lsp->num)
+            sg_lba_set_add(lsp, first.lba, 0);
+        if (vb && (lsp->num < (int)num_lbard))
+            pr2serr("%s: %u LBA ranges coalesced into %d RDs\n", __func__,
+                    num_lbard, lsp->num);
+        num_lbard = lsp->num;
+        if (op->scat_num_lbard > num_lbard)
+            op->scat_num_lbard = num_lbard;
+        ull = sg_lba_set_blocks(lsp);
+        if (ull > UINT32_MAX) {
+            pr2serr("%s: sum of --num= (%" PRIu64 ") exceeds 32 bits\n",
+                    __func__, ull);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        sum_num = (uint32_t)ull;
         d = lbard_sz * (num_lbard + 1);
         op->scat_lbdof = d / op->bs_pi_do;
         if (0 != (d % op->bs_pi_do))  /* if not multiple, round up */
             op->scat_lbdof += 1;
-        for (sum_num = 0, k = 0; k < (int)addr_arr_len; ++k)
-            sum_num += num_arr[k];
         do_len = ((op->scat_lbdof + sum_num) * op->bs_pi_do);
         up = sg_memalign(do_len, 0, &free_up, false);
         if (NULL == up) {
@@ -2111,10 +2162,9 @@ process_scattered(int sg_fd, int infd, uint32_t if_len, uint32_t if_rlen,
             ret = sg_convert_errno(ENOMEM);
             goto finii;
         }
-        for (n = lbard_sz, k = 0; k < (int)addr_arr_len; ++k,
-             n += lbard_sz) {
-            sg_put_unaligned_be64(addr_arr[k], up + n + 0);
-            sg_put_unaligned_be32(num_arr[k], up + n + 8);
+        for (n = lbard_sz, k = 0; k < lsp->num; ++k, n += lbard_sz) {
+            sg_put_unaligned_be64(lsp->ext[k].lba, up + n + 0);
+            sg_put_unaligned_be32((uint32_t)lsp->ext[k].num, up + n + 8);
             if (op->do_32) {
                 if (0 == k) {
                     sg_put_unaligned_be32(op->ref_tag, up + n + 12);
@@ -2133,6 +2183,8 @@ process_scattered(int sg_fd, int infd, uint32_t if_len, uint32_t if_rlen,
         goto syntax_err_outt;
     }
 do_io:
+    if (op->pi_do && (ret = process_pi(up, do_len, op)))
+        goto finii;
     ret = do_write_x(sg_fd, up, do_len, op);
     if (ret) {
         strcpy(b,"OS error");
@@ -2153,6 +2205,884 @@ finii:
     return ret;
 }
 
+/* One LBA range descriptor as parsed from an ASCII SF */
+struct scat_rd {
+    uint64_t lba;
+    uint32_t num;
+    uint32_t rt;
+    uint16_t at;
+    uint16_t tm;
+};
+
+/* State shared by the --jobs=JOBS workers. The parse position in SF, the
+ * carried over part of a split LBA range descriptor, the next LBA (when
+ * not WRITE SCATTERED) and the offset in IF are only changed with the lock
+ * held. */
+struct scat_stream {
+    bool stop;                  /* set after the first error */
+    bool cmd_failed;            /* .fail_lba is valid */
+    bool eof;                   /* all of SF has been parsed */
+    bool have_carry;            /* .carry holds the rest of a split RD */
+    bool if_pread;              /* IF is a regular file, use pread() */
+    int sg_fd;
+    int infd;
+    int ret;                    /* error of the first that failed */
+    uint16_t max_lbard;         /* most LBA range descriptors per command */
+    uint32_t max_blks;          /* most blocks in one WRITE SCATTERED */
+    uint32_t max_rd_blks;       /* most blocks per descriptor, 0: no limit */
+    uint32_t lineno;            /* of SF, at .sf_pos */
+    uint64_t num_cmds;          /* WRITE SCATTERED commands completed */
+    uint64_t num_rds;           /* by the completed commands */
+    uint64_t blks_done;         /* by the completed commands */
+    uint64_t fail_lba;          /* of first descriptor of the one failed */
+    uint64_t if_pos;            /* next data byte in IF, relative to OFF */
+    uint64_t if_end;            /* zeros are sent beyond this in IF */
+    uint32_t chunk;             /* most blocks per command, for a range */
+    uint64_t next_lba;          /* where the next command of a range starts */
+    uint64_t end_lba;           /* one past the last block of a range */
+    const uint8_t * same_bp;    /* the block each WRITE SAME sends */
+    size_t sf_pos;
+    size_t sf_len;
+    const char * sfp;           /* SF contents, mmap()-ed when possible */
+    const struct opts_t * op;
+    struct scat_rd carry;
+#ifndef SG_LIB_WIN32
+    pthread_mutex_t mtx;
+#endif
+};
+
+static void
+stream_lock(struct scat_stream * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_lock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+static void
+stream_unlock(struct scat_stream * sp)
+{
+#ifndef SG_LIB_WIN32
+    pthread_mutex_unlock(&sp->mtx);
+#else
+    if (sp) { ; }       /* suppress warning */
+#endif
+}
+
+static bool
+is_sf_delim(char c)
+{
+    return ((' ' == c) || (',' == c) || ('\t' == c) || ('\n' == c) ||
+            ('\r' == c) || ('#' == c));
+}
+
+/* Parses the number starting at sfp[*posp], which ends at the next
+ * delimiter, then moves *posp to that delimiter. Decimal unless prefixed
+ * by '0x' or '0X' or with a trailing 'h' or 'H' (hex). This is the common
+ * case done inline, anything else (e.g. a multiplier suffix) is passed to
+ * sg_get_llnum(). Returns true when a number is placed in *ullp. */
+static bool
+stream_get_num(const char * sfp, size_t len, size_t * posp, uint64_t * ullp)
+{
+    bool hex = false;
+    int digits = 0;
+    int d;
+    int64_t ll;
+    size_t start = *posp;
+    size_t k = start;
+    size_t end, e;
+    uint64_t v = 0;
+    char b[64];
+
+    for (end = start; (end < len) && (! is_sf_delim(sfp[end])); ++end)
+        ;
+    *posp = end;
+    e = end;
+    if (((e - k) > 2) && ('0' == sfp[k]) && ('x' == (sfp[k + 1] | 0x20))) {
+        hex = true;
+        k += 2;
+    } else if (((e - k) > 1) && ('h' == (sfp[e - 1] | 0x20))) {
+        hex = true;
+        --e;
+    }
+    for ( ; k < e; ++k, ++digits) {
+        d = sfp[k];
+        if ((d >= '0') && (d <= '9'))
+            d -= '0';
+        else if (hex && ((d | 0x20) >= 'a') && ((d | 0x20) <= 'f'))
+            d = (d | 0x20) - 'a' + 10;
+        else
+            break;
+        if (hex) {
+            if (digits >= 16)
+                break;
+            v = (v << 4) | (uint64_t)d;
+        } else {
+            if (v > ((UINT64_MAX - (uint64_t)d) / 10))
+                break;
+            v = (v * 10) + (uint64_t)d;
+        }
+    }
+    if ((k == e) && (digits > 0)) {
+        *ullp = v;
+        return true;
+    }
+    if ((end - start) >= sizeof(b))
+        return false;
+    memcpy(b, sfp + start, end - start);
+    b[end - start] = '\0';
+    ll = sg_get_llnum(b);
+    if (-1 == ll)
+        return false;
+    *ullp = (uint64_t)ll;
+    return true;
+}
+
+/* Parses the next LBA range descriptor from SF into *rdp. For 16 byte cdbs
+ * LBA,NUM pairs are expected (which may span lines, as with
+ * build_t10_scat() ). Otherwise each line holds LBA,NUM[,RT,AT,TM] with
+ * missing or empty RT,AT,TM given their defaults. Returns 0 if one is
+ * found, 999 at the end of SF, else SG_LIB_SYNTAX_ERROR. Call with lock
+ * held. */
+static int
+stream_next_rd(struct scat_stream * sp, struct scat_rd * rdp)
+{
+    bool do_16 = sp->op->do_16;
+    bool after_comma = false;
+    int k = 0;
+    int max_k = do_16 ? 2 : 5;
+    size_t len = sp->sf_len;
+    size_t pos = sp->sf_pos;
+    uint32_t lineno = sp->lineno;
+    const char * sfp = sp->sfp;
+    bool given[5];
+    uint64_t v[5];
+    char c;
+
+    memset(given, 0, sizeof(given));
+    while (pos < len) {
+        c = sfp[pos];
+        if ('\n' == c) {
+            if ((! do_16) && (k > 0))
+                break;          /* line done, leave '\n' for next call */
+            ++pos;
+            ++lineno;
+            after_comma = false;
+        } else if ((' ' == c) || ('\t' == c) || ('\r' == c))
+            ++pos;
+        else if (',' == c) {
+            ++pos;
+            if (after_comma && (! do_16)) {
+                if (k >= max_k)
+                    goto too_many;
+                ++k;            /* empty field, take the default */
+            }
+            after_comma = true;
+        } else if ('#' == c) {  /* comment, skip to end of line */
+            for ( ; (pos < len) && ('\n' != sfp[pos]); ++pos)
+                ;
+        } else {
+            if (k >= max_k)
+                goto too_many;
+            if (! stream_get_num(sfp, len, &pos, v + k)) {
+                pr2serr("%s: bad number at line %u of %s\n", __func__,
+                        lineno, sp->op->scat_filename);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            given[k++] = true;
+            after_comma = false;
+            if (do_16 && (2 == k))
+                break;
+        }
+    }
+    sp->sf_pos = pos;
+    sp->lineno = lineno;
+    if (0 == k)
+        return 999;
+    if ((k < 2) || (! given[0]) || (! given[1])) {
+        if (do_16)
+            pr2serr("%s: expect LBA,NUM pairs but decoded odd number from "
+                    "%s\n", __func__, sp->op->scat_filename);
+        else
+            pr2serr("%s: expect LBA,NUM[,RT,AT,TM] at line %u of %s\n",
+                    __func__, lineno, sp->op->scat_filename);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((v[1] > UINT32_MAX) || (given[2] && (v[2] > UINT32_MAX)) ||
+        (given[3] && (v[3] > UINT16_MAX)) ||
+        (given[4] && (v[4] > UINT16_MAX))) {
+        pr2serr("%s: number too large at line %u of %s\n", __func__, lineno,
+                sp->op->scat_filename);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    rdp->lba = v[0];
+    rdp->num = (uint32_t)v[1];
+    rdp->rt = given[2] ? (uint32_t)v[2] : (uint32_t)DEF_RT;
+    rdp->at = given[3] ? (uint16_t)v[3] : (uint16_t)DEF_AT;
+    rdp->tm = given[4] ? (uint16_t)v[4] : (uint16_t)DEF_TM;
+    return 0;
+too_many:
+    pr2serr("%s: too many items at line %u of %s\n", __func__, lineno,
+            sp->op->scat_filename);
+    return SG_LIB_SYNTAX_ERROR;
+}
+
+/* Packs the next LBA range descriptors from SF into the parameter list at
+ * up, splitting those that exceed the limits (the rest is carried over to
+ * the next command). Returns the number packed with the sum of their
+ * blocks in *sum_nump, 0 at the end of SF, or -1 after an error. Call with
+ * lock held. */
+static int
+stream_next_cmd(struct scat_stream * sp, uint8_t * up, uint32_t * sum_nump)
+{
+    bool do_32 = sp->op->do_32;
+    int n, res;
+    uint32_t num;
+    uint32_t sum = 0;
+    uint8_t * rp;
+    struct scat_rd rd;
+
+    for (n = 0; (n < (int)sp->max_lbard) && (sum < sp->max_blks); ++n) {
+        if (sp->have_carry) {
+            rd = sp->carry;
+            sp->have_carry = false;
+        } else {
+            if (sp->eof)
+                break;
+            res = stream_next_rd(sp, &rd);
+            if (999 == res) {
+                sp->eof = true;
+                break;
+            } else if (res) {
+                sp->ret = res;
+                sp->stop = true;
+                return -1;
+            }
+        }
+        num = rd.num;
+        if (sp->max_rd_blks && (num > sp->max_rd_blks))
+            num = sp->max_rd_blks;
+        if (num > (sp->max_blks - sum))
+            num = sp->max_blks - sum;
+        if (num < rd.num) {
+            sp->carry = rd;
+            sp->carry.lba += num;
+            sp->carry.num -= num;
+            if (DEF_RT != rd.rt)
+                sp->carry.rt += num;
+            sp->have_carry = true;
+        }
+        rp = up + (lbard_sz * (n + 1));
+        sg_put_unaligned_be64(rd.lba, rp + 0);
+        sg_put_unaligned_be32(num, rp + 8);
+        if (do_32) {
+            sg_put_unaligned_be32(rd.rt, rp + 12);
+            sg_put_unaligned_be16(rd.at, rp + 16);
+            sg_put_unaligned_be16(rd.tm, rp + 18);
+        }
+        sum += num;
+    }
+    *sum_nump = sum;
+    return n;
+}
+
+/* Reads len bytes from IF, starting pos bytes after OFF, into bp. What lies
+ * beyond the data available in IF is zero filled. Returns 0 if ok, else
+ * an error. Call with lock held unless .if_pread is set. */
+static int
+stream_read_if(struct scat_stream * sp, uint8_t * bp, uint32_t len,
+               uint64_t pos)
+{
+    int err;
+    uint32_t got = 0;
+    uint32_t want = 0;
+    ssize_t res;
+
+    if (pos < sp->if_end)
+        want = ((sp->if_end - pos) < len) ? (uint32_t)(sp->if_end - pos) :
+                                            len;
+    while (got < want) {
+#ifndef SG_LIB_WIN32
+        if (sp->if_pread)
+            res = pread(sp->infd, bp + got, want - got,
+                        (off_t)(sp->op->if_offset + pos + got));
+        else
+#endif
+            res = read(sp->infd, bp + got, want - got);
+        if (res < 0) {
+            err = errno;
+            if (EINTR == err)
+                continue;
+            pr2serr("%s: reading %s: %s\n", __func__, sp->op->if_name,
+                    safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+        if (0 == res)
+            break;
+        got += (uint32_t)res;
+    }
+    if (got < len) {
+        if (sp->op->strict) {
+            pr2serr("%s: %s has less data than the scatter list NUMs "
+                    "imply\n", __func__, sp->op->if_name);
+            return SG_LIB_FILE_ERROR;
+        }
+        memset(bp + got, 0, len - got);
+    }
+    return 0;
+}
+
+static void *
+stream_worker(void * v_sp)
+{
+    int n, res;
+    uint32_t sum, lbdof, do_len;
+    uint32_t hdr_len;
+    uint64_t if_pos;
+    uint8_t * up;
+    uint8_t * free_up = NULL;
+    struct scat_stream * sp = (struct scat_stream *)v_sp;
+    const struct opts_t * op = sp->op;
+    uint32_t bs = op->bs_pi_do;
+    struct opts_t opts;
+
+    opts = *op;         /* each command has its own RD, DOF and NUM */
+    hdr_len = ((((sp->max_lbard + 1) * lbard_sz) + bs - 1) / bs) * bs;
+    up = sg_memalign(hdr_len + (sp->max_blks * bs), 0, &free_up, false);
+    if (NULL == up) {
+        pr2serr("unable to allocate aligned memory for scatterlist+data\n");
+        stream_lock(sp);
+        if (0 == sp->ret)
+            sp->ret = sg_convert_errno(ENOMEM);
+        sp->stop = true;
+        stream_unlock(sp);
+        return NULL;
+    }
+    while (true) {
+        memset(up, 0, hdr_len);
+        res = 0;
+        stream_lock(sp);
+        n = sp->stop ? 0 : stream_next_cmd(sp, up, &sum);
+        if (n > 0) {
+            lbdof = (((n + 1) * lbard_sz) + bs - 1) / bs;
+            if_pos = sp->if_pos;
+            sp->if_pos += (uint64_t)sum * bs;
+            if (! sp->if_pread)     /* stdin or pipe, read it in order */
+                res = stream_read_if(sp, up + (lbdof * bs), sum * bs,
+                                     if_pos);
+        }
+        stream_unlock(sp);
+        if (n <= 0)
+            break;
+        if ((0 == res) && sp->if_pread)
+            res = stream_read_if(sp, up + (lbdof * bs), sum * bs, if_pos);
+        do_len = (lbdof + sum) * bs;
+        opts.scat_lbdof = (uint16_t)lbdof;
+        opts.scat_num_lbard = (uint16_t)n;
+        opts.numblocks = sum;
+        opts.xfer_bytes = sum * bs;
+        if ((0 == res) && op->pi_do)
+            res = process_pi(up, do_len, &opts);
+        if (0 == res)
+            res = do_write_x(sp->sg_fd, up, do_len, &opts);
+        stream_lock(sp);
+        if (res) {
+            if (0 == sp->ret) {
+                sp->ret = res;
+                sp->cmd_failed = true;
+                sp->fail_lba = sg_get_unaligned_be64(up + lbard_sz);
+            }
+            sp->stop = true;
+        } else {
+            ++sp->num_cmds;
+            sp->num_rds += n;
+            sp->blks_done += sum;
+        }
+        stream_unlock(sp);
+    }
+    free(free_up);
+    return NULL;
+}
+
+/* Sets the most LBA range descriptors and blocks in one WRITE SCATTERED
+ * from RD and the Block Limits Extension VPD page. */
+static void
+stream_get_limits(struct scat_stream * sp)
+{
+    int res, resid;
+    const struct opts_t * op = sp->op;
+    int vb = op->verbose;
+    uint32_t max_rds = 0;
+    uint32_t max_blks = 0;
+    uint8_t b[BLOCK_LIMITS_EXT_VPD_LEN];
+
+    res = sg_ll_inquiry_v2(sp->sg_fd, true, BLOCK_LIMITS_EXT_VPD, b,
+                           sizeof(b), 0, &resid, false,
+                           (vb > 1) ? vb - 1 : 0);
+    if ((0 == res) && (resid >= 0) && (((int)sizeof(b) - resid) >= 28) &&
+        (BLOCK_LIMITS_EXT_VPD == b[1]) && (sg_get_unaligned_be16(b + 2) >=
+                                           24)) {
+        sp->max_rd_blks = sg_get_unaligned_be32(b + 16);
+        max_rds = sg_get_unaligned_be16(b + 22);
+        max_blks = sg_get_unaligned_be32(b + 24);
+    } else if (vb)
+        pr2serr("No usable Block Limits Extension VPD page, using "
+                "defaults\n");
+    if (op->scat_num_lbard > 0) {
+        sp->max_lbard = op->scat_num_lbard;
+        if (max_rds && (sp->max_lbard > max_rds)) {
+            pr2serr("--scattered=%u exceeds maximum scattered %s count, "
+                    "reduced to %u\n", sp->max_lbard, lbard_str, max_rds);
+            sp->max_lbard = (uint16_t)max_rds;
+        }
+    } else
+        sp->max_lbard = max_rds ? (uint16_t)max_rds : DEF_STREAM_LBARD;
+    sp->max_blks = max_blks ? max_blks : DEF_STREAM_BLKS;
+    if (sp->max_blks > (MAX_STREAM_BYTES / op->bs_pi_do))
+        sp->max_blks = MAX_STREAM_BYTES / op->bs_pi_do;
+    if (0 == sp->max_blks)
+        sp->max_blks = 1;
+    if (vb)
+        pr2serr("Block limits extension: maximum scattered %s count: %u, "
+                "transfer\n    length: %u blocks, LBA range transfer "
+                "length: %u; so at most %u\n    %ss and %u blocks per WRITE "
+                "SCATTERED\n", lbard_str, max_rds, max_blks,
+                sp->max_rd_blks, sp->max_lbard, lbard_str, sp->max_blks);
+}
+
+/* Makes the contents of SF available at .sfp (and .sf_len), mmap()-ed when
+ * possible else read into *free_sfpp . Returns 0 if ok, else an error. */
+static int
+stream_load_sf(struct scat_stream * sp, char ** free_sfpp)
+{
+    int fd, err;
+    int vb = sp->op->verbose;
+    ssize_t res;
+    size_t got;
+    char * p;
+    const char * fname = sp->op->scat_filename;
+    struct stat a_stat;
+
+    *free_sfpp = NULL;
+    if ((fd = open(fname, O_RDONLY)) < 0) {
+        err = errno;
+        pr2serr("%s: unable to open %s: %s\n", __func__, fname,
+                safe_strerror(err));
+        return sg_convert_errno(err);
+    }
+    if (fstat(fd, &a_stat) < 0) {
+        err = errno;
+        pr2serr("%s: unable to fstat %s: %s\n", __func__, fname,
+                safe_strerror(err));
+        close(fd);
+        return sg_convert_errno(err);
+    }
+    if ((! S_ISREG(a_stat.st_mode)) || (0 == a_stat.st_size)) {
+        pr2serr("%s: expect SF to be a regular file and not empty\n",
+                __func__);
+        close(fd);
+        return SG_LIB_FILE_ERROR;
+    }
+    sp->sf_len = (size_t)a_stat.st_size;
+#ifndef SG_LIB_WIN32
+    p = (char *)mmap(NULL, sp->sf_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED != p) {
+#ifdef MADV_SEQUENTIAL
+        madvise(p, sp->sf_len, MADV_SEQUENTIAL);
+#endif
+        if (vb > 1)
+            pr2serr("mapped %" PRIu64 " bytes of %s\n",
+                    (uint64_t)sp->sf_len, fname);
+        sp->sfp = p;
+        close(fd);
+        return 0;
+    }
+    if (vb)
+        perror("mmap() of SF failed, will read()");
+#endif
+    p = (char *)malloc(sp->sf_len);
+    if (NULL == p) {
+        close(fd);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (got = 0; got < sp->sf_len; got += (size_t)res) {
+        res = read(fd, p + got, sp->sf_len - got);
+        if (res <= 0) {
+            err = (res < 0) ? errno : EIO;
+            if (EINTR == err) {
+                res = 0;
+                continue;
+            }
+            pr2serr("%s: reading %s: %s\n", __func__, fname,
+                    safe_strerror(err));
+            free(p);
+            close(fd);
+            return sg_convert_errno(err);
+        }
+    }
+    close(fd);
+    sp->sfp = p;
+    *free_sfpp = p;
+    return 0;
+}
+
+/* The --jobs=JOBS path: the LBA range descriptors in an ASCII SF of any
+ * length are parsed as needed and packed into WRITE SCATTERED commands
+ * fitted to the Block Limits Extension VPD page, with the data for each
+ * taken in turn from IF. Up to JOBS of those commands are in flight at
+ * once. Returns 0 if ok, else the error of the first that failed. */
+static int
+stream_scattered(int sg_fd, int infd, bool if_reg_file,
+                 const struct opts_t * op)
+{
+    int res;
+    int num_jobs = op->num_jobs;
+    int vb = op->verbose;
+    uint64_t start_ns;
+    char * free_sfp = NULL;
+    struct scat_stream a_stream;
+    struct scat_stream * sp = &a_stream;
+    struct stat a_stat;
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    memset(sp, 0, sizeof(*sp));
+    sp->sg_fd = sg_fd;
+    sp->infd = infd;
+    sp->op = op;
+    sp->lineno = 1;
+    sp->if_end = UINT64_MAX;
+    if (if_reg_file && (0 == fstat(infd, &a_stat))) {
+#ifndef SG_LIB_WIN32
+        sp->if_pread = true;
+#endif
+        sp->if_end = ((uint64_t)a_stat.st_size > op->if_offset) ?
+                     ((uint64_t)a_stat.st_size - op->if_offset) : 0;
+    }
+    if ((op->if_dlen > 0) && (op->if_dlen < sp->if_end))
+        sp->if_end = op->if_dlen;
+    res = stream_load_sf(sp, &free_sfp);
+    if (res)
+        return res;
+    stream_get_limits(sp);
+    if (vb)
+        pr2serr("Streaming %s into %s commands, up to %d at a time\n",
+                op->scat_filename, op->cdb_name, num_jobs);
+    start_ns = sg_pt_lat_now_ns();
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&sp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, stream_worker, sp))) {
+            if (vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    stream_worker(sp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&sp->mtx);
+#else
+    stream_worker(sp);
+#endif
+    if (sp->ret) {
+        if (sp->cmd_failed)
+            pr2serr("%s with first %s LBA 0x%" PRIx64 " failed, %" PRIu64
+                    " command%s (%" PRIu64 " blocks) had completed\n",
+                    op->cdb_name, lbard_str, sp->fail_lba, sp->num_cmds,
+                    (1 == sp->num_cmds) ? "" : "s", sp->blks_done);
+    } else if (0 == sp->num_cmds) {
+        pr2serr("No %ss found in %s\n", lbard_str, op->scat_filename);
+        sp->ret = SG_LIB_FILE_ERROR;
+    } else if (vb)
+        pr2serr("Completed %" PRIu64 " %s commands, %" PRIu64 " %ss, %"
+                PRIu64 " blocks in %.3f seconds\n", sp->num_cmds,
+                op->cdb_name, sp->num_rds, lbard_str, sp->blks_done,
+                (double)(sg_pt_lat_now_ns() - start_ns) / 1000000000.0);
+#ifndef SG_LIB_WIN32
+    if (NULL == free_sfp)
+        munmap((void *)sp->sfp, sp->sf_len);
+#endif
+    if (free_sfp)
+        free(free_sfp);
+    return sp->ret;
+}
+
+
+static void *
+range_worker(void * v_sp)
+{
+    bool more;
+    int res;
+    uint32_t num, dlen;
+    uint64_t lba, if_pos, t0, t1;
+    uint8_t * up = NULL;
+    uint8_t * free_up = NULL;
+    struct scat_stream * sp = (struct scat_stream *)v_sp;
+    const struct opts_t * op = sp->op;
+    uint32_t bs = op->bs_pi_do;
+    struct opts_t opts;
+
+    opts = *op;         /* each command has its own LBA and NUM */
+    if (! op->do_same) {
+        up = sg_memalign(sp->chunk * bs, 0, &free_up, false);
+        if (NULL == up) {
+            pr2serr("unable to allocate aligned memory for data-out\n");
+            stream_lock(sp);
+            if (0 == sp->ret)
+                sp->ret = sg_convert_errno(ENOMEM);
+            sp->stop = true;
+            stream_unlock(sp);
+            return NULL;
+        }
+    }
+    while (true) {
+        res = 0;
+        stream_lock(sp);
+        more = (! sp->stop) && (sp->next_lba < sp->end_lba);
+        if (more) {
+            lba = sp->next_lba;
+            num = ((sp->end_lba - lba) < sp->chunk) ?
+                  (uint32_t)(sp->end_lba - lba) : sp->chunk;
+            sp->next_lba += num;
+            dlen = op->do_same ? (op->ndob ? 0 : bs) : (num * bs);
+            if_pos = sp->if_pos;
+            if (up) {
+                sp->if_pos += dlen;
+                if (! sp->if_pread)     /* stdin or pipe, read in order */
+                    res = stream_read_if(sp, up, dlen, if_pos);
+            }
+        }
+        stream_unlock(sp);
+        if (! more)
+            break;
+        if ((0 == res) && up && sp->if_pread)
+            res = stream_read_if(sp, up, dlen, if_pos);
+        opts.lba = lba;
+        opts.numblocks = num;
+        opts.xfer_bytes = dlen;
+        if ((0 == res) && op->pi_do && up)
+            res = process_pi(up, dlen, &opts);
+        t0 = sg_pt_lat_now_ns();
+        if (0 == res)
+            res = do_write_x(sp->sg_fd, (up ? up : sp->same_bp), dlen,
+                             &opts);
+        t1 = sg_pt_lat_now_ns();
+        if (0 == res)
+            sg_pt_lat_record(sp->sg_fd, LAT_KEY_RANGE, t1 - t0);
+        stream_lock(sp);
+        if (res) {
+            if (0 == sp->ret) {
+                sp->ret = res;
+                sp->cmd_failed = true;
+                sp->fail_lba = lba;
+            }
+            sp->stop = true;
+        } else {
+            ++sp->num_cmds;
+            sp->blks_done += num;
+        }
+        stream_unlock(sp);
+    }
+    if (free_up)
+        free(free_up);
+    return NULL;
+}
+
+/* Sets the most blocks per command of a --jobs=JOBS range from --chunk=CB
+ * and the Block Limits VPD page: the maximum atomic transfer length (and
+ * its granularity) for WRITE ATOMIC, the maximum write same length for
+ * WRITE SAME, else the optimal transfer length. Returns 0 if ok, else
+ * SG_LIB_CONTRADICT when --chunk=CB exceeds a maximum. */
+static int
+range_get_chunk(struct scat_stream * sp)
+{
+    bool have_bl = false;
+    int res, resid, plen;
+    const struct opts_t * op = sp->op;
+    int vb = op->verbose;
+    uint32_t mx = 0;            /* maximum for this command, 0: none */
+    uint32_t want = 0;          /* preferred for this command, 0: unknown */
+    uint32_t gran = 0;
+    uint64_t ull;
+    uint8_t b[BLOCK_LIMITS_VPD_LEN];
+    const char * cp = "maximum transfer length";
+
+    res = sg_ll_inquiry_v2(sp->sg_fd, true, BLOCK_LIMITS_VPD, b, sizeof(b),
+                           0, &resid, false, (vb > 1) ? vb - 1 : 0);
+    plen = (0 == res) && (resid >= 0) && (BLOCK_LIMITS_VPD == b[1]) ?
+           (sg_get_unaligned_be16(b + 2) + 4) : 0;
+    if (plen > ((int)sizeof(b) - resid))
+        plen = (int)sizeof(b) - resid;
+    if (plen >= 16) {
+        have_bl = true;
+        if (op->do_atomic && (plen >= 56)) {
+            mx = sg_get_unaligned_be32(b + 44);
+            gran = sg_get_unaligned_be32(b + 52);
+            want = mx;
+            cp = "maximum atomic transfer length";
+        } else if (op->do_same && (plen >= 44)) {
+            ull = sg_get_unaligned_be64(b + 36);
+            mx = (ull > UINT32_MAX) ? UINT32_MAX : (uint32_t)ull;
+            want = mx;
+            cp = "maximum write same length";
+        } else if (! (op->do_atomic || op->do_same)) {
+            mx = sg_get_unaligned_be32(b + 8);
+            want = sg_get_unaligned_be32(b + 12);
+        }
+    } else if (vb)
+        pr2serr("No usable Block Limits VPD page\n");
+    if (op->chunk) {
+        if (mx && (op->chunk > mx)) {
+            pr2serr("--chunk=%u exceeds %s (%u)\n", op->chunk, cp, mx);
+            return SG_LIB_CONTRADICT;
+        }
+        sp->chunk = op->chunk;
+    } else
+        sp->chunk = want ? want : DEF_RANGE_BLKS;
+    if (mx && (sp->chunk > mx))
+        sp->chunk = mx;
+    if ((gran > 1) && (sp->chunk >= gran))
+        sp->chunk -= (sp->chunk % gran);
+    if (op->do_16 && (op->do_atomic || op->do_stream) &&
+        (sp->chunk > UINT16_MAX))
+        sp->chunk = UINT16_MAX;         /* 16 bit field in 16 byte cdb */
+    if ((! op->do_same) && (sp->chunk > (MAX_STREAM_BYTES / op->bs_pi_do))) {
+        sp->chunk = MAX_STREAM_BYTES / op->bs_pi_do;
+        if (0 == sp->chunk)
+            sp->chunk = 1;
+    }
+    if (vb)
+        pr2serr("%s%s: %u, so at most %u blocks per %s\n",
+                (have_bl ? "Block limits " : "No "), cp, mx, sp->chunk,
+                op->cdb_name);
+    return 0;
+}
+
+/* The --jobs=JOBS path for other than WRITE SCATTERED: NUM blocks from LBA
+ * are written by op->cdb_name commands of at most CB blocks, with JOBS of
+ * them in flight, each one's data taken in turn from IF (WRITE SAME sends
+ * the first block of IF each time). Then the IOPS, throughput and latency
+ * are reported. Returns 0 if ok, else the error of the first that failed. */
+static int
+range_write_x(int sg_fd, int infd, bool if_reg_file,
+              const struct opts_t * op)
+{
+    int res;
+    int num_jobs = op->num_jobs;
+    int vb = op->verbose;
+    uint64_t start_ns, el_ns;
+    double secs;
+    uint8_t * free_same_bp = NULL;
+    uint8_t * same_bp;
+    struct scat_stream a_stream;
+    struct scat_stream * sp = &a_stream;
+    struct stat a_stat;
+    struct sg_pt_lat_summary ls;
+#ifndef SG_LIB_WIN32
+    int k, err;
+    pthread_t tids[MAX_JOBS];
+#endif
+
+    if (0 == op->numblocks) {
+        pr2serr("--jobs=JOBS needs --num=NUM greater than 0\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->tot_lbs && ((op->lba > op->tot_lbs) ||
+                        (op->numblocks > (op->tot_lbs - op->lba)))) {
+        pr2serr("LBA 0x%" PRIx64 " and NUM %u go past the end of DEVICE (%"
+                PRIu64 " blocks)\n", op->lba, op->numblocks, op->tot_lbs);
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    }
+    memset(sp, 0, sizeof(*sp));
+    sp->sg_fd = sg_fd;
+    sp->infd = infd;
+    sp->op = op;
+    sp->if_end = UINT64_MAX;
+    if ((infd >= 0) && if_reg_file && (0 == fstat(infd, &a_stat))) {
+#ifndef SG_LIB_WIN32
+        sp->if_pread = true;
+#endif
+        sp->if_end = ((uint64_t)a_stat.st_size > op->if_offset) ?
+                     ((uint64_t)a_stat.st_size - op->if_offset) : 0;
+    }
+    if ((op->if_dlen > 0) && (op->if_dlen < sp->if_end))
+        sp->if_end = op->if_dlen;
+    res = range_get_chunk(sp);
+    if (res)
+        return res;
+    if (op->do_same && (! op->ndob)) {
+        same_bp = sg_memalign(op->bs_pi_do, 0, &free_same_bp, false);
+        if (NULL == same_bp) {
+            pr2serr("unable to allocate aligned memory for data-out\n");
+            return sg_convert_errno(ENOMEM);
+        }
+        res = stream_read_if(sp, same_bp, op->bs_pi_do, 0);
+        if (res)
+            goto fini;
+        if (op->pi_do) {
+            struct opts_t opts = *op;
+
+            opts.numblocks = 1;
+            if ((res = process_pi(same_bp, op->bs_pi_do, &opts)))
+                goto fini;
+        }
+        sp->same_bp = same_bp;
+    }
+    sp->next_lba = op->lba;
+    sp->end_lba = op->lba + op->numblocks;
+    sg_pt_lat_enable(true);
+    if (vb)
+        pr2serr("Writing %u blocks from LBA 0x%" PRIx64 " with %s commands "
+                "of up to %u blocks, %d at a time\n", op->numblocks, op->lba,
+                op->cdb_name, sp->chunk, num_jobs);
+    start_ns = sg_pt_lat_now_ns();
+#ifndef SG_LIB_WIN32
+    pthread_mutex_init(&sp->mtx, NULL);
+    for (k = 1; k < num_jobs; ++k) {
+        if ((err = pthread_create(tids + k, NULL, range_worker, sp))) {
+            if (vb)
+                pr2serr("pthread_create: %s\n", safe_strerror(err));
+            break;
+        }
+    }
+    num_jobs = k;
+    range_worker(sp);
+    for (k = 1; k < num_jobs; ++k)
+        pthread_join(tids[k], NULL);
+    pthread_mutex_destroy(&sp->mtx);
+#else
+    range_worker(sp);
+#endif
+    el_ns = sg_pt_lat_now_ns() - start_ns;
+    secs = (el_ns > 0) ? (el_ns / 1e9) : 1.0;
+    if (sp->ret && sp->cmd_failed)
+        pr2serr("%s at LBA 0x%" PRIx64 " failed, %" PRIu64 " command%s (%"
+                PRIu64 " blocks) had completed\n", op->cdb_name,
+                sp->fail_lba, sp->num_cmds, (1 == sp->num_cmds) ? "" : "s",
+                sp->blks_done);
+    printf("%s: %" PRIu64 " commands, %" PRIu64 " blocks in %.3f seconds, "
+           "%d job%s\n", op->cdb_name, sp->num_cmds, sp->blks_done, secs,
+           num_jobs, (1 == num_jobs) ? "" : "s");
+    printf("  IOPS: %.1f, throughput: %.2f MB/s\n", sp->num_cmds / secs,
+           (((double)sp->blks_done * op->bs) / secs) / 1000000.0);
+    if (0 == sg_pt_lat_get(sg_fd, LAT_KEY_RANGE, &ls))
+        printf("  latency (usec): min=%.1f mean=%.1f p50=%.1f p99=%.1f "
+               "p99.9=%.1f max=%.1f\n", ls.min_ns / 1000.0,
+               ls.mean_ns / 1000.0, ls.p50_ns / 1000.0, ls.p99_ns / 1000.0,
+               ls.p999_ns / 1000.0, ls.max_ns / 1000.0);
+    res = sp->ret;
+fini:
+    if (free_same_bp)
+        free(free_same_bp);
+    return res;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -2165,7 +3095,7 @@ main(int argc, char * argv[])
     int sg_fd = -1;
     int sfr_fd = -1;
     int ret = -1;
-    uint32_t nn, addr_arr_len, num_arr_len;     /* --lba= */
+    uint32_t nn;
     uint32_t do_len = 0;
     uint16_t num_lbard = 0;
     uint32_t if_len = 0;    /* after accounting for OFF,DLEN and moving file
@@ -2182,8 +3112,7 @@ main(int argc, char * argv[])
     uint8_t * free_up = NULL;
     char ebuff[EBUFF_SZ];
     char b[80];
-    uint64_t addr_arr[MAX_NUM_ADDR];
-    uint32_t num_arr[MAX_NUM_ADDR];
+    struct sg_lba_set lba_set;  /* --lba= and --num= */
     struct stat if_stat, sf_stat;
     struct opts_t opts;
 
@@ -2191,6 +3120,7 @@ main(int argc, char * argv[])
     memset(op, 0, sizeof(opts));
     memset(&if_stat, 0, sizeof(if_stat));
     memset(&sf_stat, 0, sizeof(sf_stat));
+    sg_lba_set_init(&lba_set);
     op->numblocks = DEF_WR_NUMBLOCKS;
     op->pi_type = -1;           /* Protection information type unknown */
     op->ref_tag = DEF_RT;       /* first 4 bytes of 8 byte protection info */
@@ -2284,6 +3214,17 @@ main(int argc, char * argv[])
             return SG_LIB_CONTRADICT;
         }
     }
+    if ((op->num_jobs > 0) && op->do_scattered &&
+        ((NULL == op->scat_filename) || op->do_scat_raw)) {
+        pr2serr("--jobs=JOBS with --scattered=RD needs an ASCII "
+                "--scat-file=SF\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (op->chunk && ((0 == op->num_jobs) || op->do_scattered)) {
+        pr2serr("--chunk=CB needs --jobs=JOBS and is not used by WRITE "
+                "SCATTERED\n");
+        return SG_LIB_CONTRADICT;
+    }
     if ((NULL == op->scat_filename) && op->do_scat_raw) {
         pr2serr("--scat-raw only applies to the --scat-file=SF option\n"
                 "--scat-raw without the --scat-file=SF option is an "
@@ -2440,40 +3381,50 @@ main(int argc, char * argv[])
     }
 
     /* decode --lba= and --num= options */
-    memset(addr_arr, 0, sizeof(addr_arr));
-    memset(num_arr, 0, sizeof(num_arr));
-    addr_arr_len = 0;
-    num_arr_len = 0;
     if (lba_op) {
-        if (0 != build_lba_arr(lba_op, addr_arr, &addr_arr_len,
-                               MAX_NUM_ADDR)) {
-            pr2serr("bad argument to '--lba'\n");
-            goto syntax_err_out;
-        }
-    }
-    if (num_op) {
-        if (0 != build_num_arr(num_op, num_arr, &num_arr_len,
-                               MAX_NUM_ADDR)) {
-            pr2serr("bad argument to '--num'\n");
+        /* with num_op the lists must be the same length, else each has
+         * its own error */
+        ret = sg_lba_set_parse(&lba_set, lba_op, num_op, 0);
+        if (ret) {
+            pr2serr("bad argument to '--lba=' or '--num='\n");
             goto err_out;
         }
-    }
-    if (((addr_arr_len > 1) && (addr_arr_len != num_arr_len)) ||
-        ((0 == addr_arr_len) && (num_arr_len > 1))) {
-        /* allow all combinations of 0 or 1 element --lba= with 0 or 1
-         * element --num=, otherwise this error ... */
-        pr2serr("need same number of arguments to '--lba=' and '--num=' "
+        if (NULL == num_op) {
+            if (lba_set.num > 1) {
+                pr2serr("need same number of arguments to '--lba=' and "
+                        "'--num=' options\n");
+                ret = SG_LIB_CONTRADICT;
+                goto err_out;
+            }
+            if (lba_set.num > 0)
+                lba_set.ext[0].num = 0;
+        }
+        for (n = 0; n < lba_set.num; ++n) {
+            if (lba_set.ext[n].num > UINT32_MAX) {
+                pr2serr("--num= element %d exceeds 32 bits\n", n + 1);
+                goto syntax_err_out;
+            }
+        }
+    } else if (num_op) {
+        if (strchr(num_op, ',') || strchr(num_op, ' ')) {
+            pr2serr("need same number of arguments to '--lba=' and '--num=' "
                     "options\n");
-        ret = SG_LIB_CONTRADICT;
-        goto err_out;
-    }
-    if ((0 == addr_arr_len) && (1 == num_arr_len)) {
-        if (num_arr[0] > 0) {
-            pr2serr("won't write %u blocks without an explicit --lba= "
-                    "option\n", num_arr[0]);
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+        if (0 != sg_get_llnum(num_op)) {
+            pr2serr("won't write %s blocks without an explicit --lba= "
+                    "option\n", num_op);
             goto syntax_err_out;
         }
-        addr_arr_len = 1;  /* allow --num=0 without --lba= since it is safe */
+        /* allow --num=0 without --lba= since it is safe */
+        ret = sg_lba_set_add(&lba_set, 0, 0);
+        if (ret)
+            goto err_out;
+    }
+    if (op->do_scattered && (op->num_jobs > 0)) {   /* streamed */
+        ret = stream_scattered(sg_fd, infd, if_reg_file, op);
+        goto fini;
     }
     /* Everything can use a SF, except --same=1 (when op->ndob==true) */
     if (op->scat_filename) {
@@ -2529,18 +3480,17 @@ main(int argc, char * argv[])
 
     if (op->do_scattered) {
         ret = process_scattered(sg_fd, infd, if_len, if_readable_len, sfr_fd,
-                                sf_len, addr_arr, addr_arr_len, num_arr,
-                                num_lbard, sum_num, op);
+                                sf_len, &lba_set, num_lbard, sum_num, op);
         goto fini;
     }
 
     /* other than scattered */
-    if (addr_arr_len > 0) {
-        op->lba = addr_arr[0];
-        op->numblocks = num_arr[0];
-        if (vb && (addr_arr_len > 1))
+    if (lba_set.num > 0) {     /* in the order given, not coalesced */
+        op->lba = lba_set.ext[0].lba;
+        op->numblocks = (uint32_t)lba_set.ext[0].num;
+        if (vb && (lba_set.num > 1))
             pr2serr("warning: %d LBA,number_of_blocks pairs found, only "
-                    "taking first\n", addr_arr_len);
+                    "taking first\n", lba_set.num);
     } else if (op->scat_filename && (! op->do_scat_raw)) {
         uint8_t upp[96];
 
@@ -2594,6 +3544,10 @@ main(int argc, char * argv[])
                 "--num=\n");
         goto syntax_err_out;
     }
+    if (op->num_jobs > 0) {     /* sustained, NUM blocks from LBA */
+        ret = range_write_x(sg_fd, infd, if_reg_file, op);
+        goto fini;
+    }
     if (op->do_same)
         op->xfer_bytes = op->ndob ? 0 : op->bs_pi_do;
     else    /* WRITE, ORWRITE, WRITE ATOMIC or WRITE STREAM */
@@ -2615,6 +3569,8 @@ main(int argc, char * argv[])
     } else
         up = NULL;
 
+    if (op->pi_do && (ret = process_pi(up, do_len, op)))
+        goto fini;
     ret = do_write_x(sg_fd, up, do_len, op);
     if (ret && (! op->do_quiet)) {
         strcpy(b,"OS error");
@@ -2633,6 +3589,7 @@ err_out:
 fini:
     if (free_up)
         free(free_up);
+    sg_lba_set_free(&lba_set);
     if (sg_fd >= 0) {
         res = sg_cmds_close_device(sg_fd);
         if (res < 0) {
@@ -43,15 +43,18 @@
 #include <stdarg.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/file.h>
+#include <sys/wait.h>
 #include <sys/sysmacros.h>
 #ifndef major
 #include <sys/types.h>
@@ -66,10 +69,11 @@
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "0.70 20190501";
+static const char * version_str = "0.72 20261014";
 
 #define ME "sg_xcopy: "
 
@@ -162,6 +166,30 @@ static const char * version_str = "0.70 20190501";
 #define MAX_UNIT_ATTENTIONS 10
 #define MAX_ABORTED_CMDS 256
 
+#define MAX_XCOPY_CONC 16       /* EXTENDED COPY commands in flight */
+#define MAX_XCOPY_SEGS 64       /* segment descriptors per command */
+#define SEG_DESC_B2B_LEN 28     /* block to block segment descriptor */
+#define XCOPY_PARAM_LEN (16 + 256 + 256 + \
+                         (MAX_XCOPY_SEGS * SEG_DESC_B2B_LEN))
+
+/* token=1: POPULATE TOKEN and WRITE USING TOKEN in place of XCOPY(LID1) */
+#define DEF_TOKEN_CONC 4        /* tokens in flight */
+#define DEF_TOKEN_BLOCKS 32768  /* when IFILE reports no transfer counts */
+#define ROD_TOKEN_LEN 512
+#define RANGE_DESC_LEN 16       /* block device range descriptor */
+#define WUT_RANGE_OFF 536       /* of those in WRITE USING TOKEN params */
+#define RRTI_RESP_LEN (32 + 256 + 6 + ROD_TOKEN_LEN)
+
+/* Token copy states of a slot, named for the command in flight */
+#define TOK_POPULATE 1          /* POPULATE TOKEN, to IFILE */
+#define TOK_RRTI 2              /* RECEIVE ROD TOKEN INFORMATION, to IFILE */
+#define TOK_WRITE 3             /* WRITE USING TOKEN, to OFILE */
+#define TOK_WR_RRTI 4           /* immed=1: RRTI polling WRITE USING TOKEN */
+
+#define DEF_TOKEN_POLL_MS 10    /* immed=1: if no estimated update delay */
+#define MAX_TOKEN_POLL_MS 1000
+#define TOKEN_NAP_NS 1000000    /* immed=1: between checks while polling */
+
 static int64_t dd_count = -1;
 static int64_t in_full = 0;
 static int in_partial = 0;
@@ -169,6 +197,8 @@ static int64_t out_full = 0;
 static int out_partial = 0;
 
 static bool do_time = false;
+static bool do_token = false;
+static bool tok_immed = false;
 static bool start_tm_valid = false;
 static bool xcopy_flag_cat = false;
 static bool xcopy_flag_dc = false;
@@ -179,6 +209,15 @@ static int priority = 1;
 static int verbose = 0;
 static struct timeval start_tm;
 
+static FILE * progress_fp = NULL;       /* progress=SEC[,FILE] */
+static int progress_sec = 0;
+static int64_t progress_count = 0;
+static int64_t progress_xcopies = 0;
+static int64_t progress_last_xcopies = 0;
+static int64_t progress_last_blks = 0;
+static uint64_t progress_start_ns;
+static uint64_t progress_last_ns;
+
 
 struct xcopy_fp_t {
     bool append;
@@ -192,13 +231,39 @@ struct xcopy_fp_t {
     dev_t devno;
     uint32_t min_bytes;
     uint32_t max_bytes;
+    uint32_t max_desc_len;  /* of target plus segment descriptors */
+    int max_segs;           /* segment descriptors per command */
+    int max_conc;           /* concurrent copies, 0 if not reported */
     int64_t num_sect;
     char fname[INOUTF_SZ];
 };
 
+/* One EXTENDED COPY(LID1) or, with token=1, one token copy, maybe in
+ * flight */
+struct xcopy_slot_t {
+    bool busy;
+    bool waiting;           /* immed=1: to poll again at due_ns */
+    uint32_t list_id;       /* distinct among those in flight */
+    int blocks;             /* copied by all its segment descriptors */
+    int param_len;
+    int state;              /* token copy: TOK_* */
+    uint64_t seq;           /* submission order */
+    uint64_t due_ns;
+    uint64_t src_lba;       /* token copy: first block read ... */
+    uint64_t dst_lba;       /* ... and written */
+    struct sg_pt_base * ptvp;
+    struct sg_pt_base * optvp;  /* token copy: for WRITE USING TOKEN */
+    uint8_t cdb[16];
+    uint8_t sense[SENSE_BUFF_LEN];
+    uint8_t param[XCOPY_PARAM_LEN];
+    uint8_t token[ROD_TOKEN_LEN];
+};
+
 static struct xcopy_fp_t ixcf;
 static struct xcopy_fp_t oxcf;
 
+static struct xcopy_slot_t xcopy_slots[MAX_XCOPY_CONC];
+
 static const char * read_cap_str = "Read capacity";
 static const char * rec_copy_op_params_str = "Receive copy operating "
                                              "parameters";
@@ -514,23 +579,35 @@ usage(int n_help)
 
 primary_help:
     pr2serr("Usage: "
-            "sg_xcopy [app=0|1] [bpt=BPT] [bs=BS] [cat=0|1] [conv=CONV]\n"
-            "                [count=COUNT] [dc=0|1] [ibs=BS]\n"
+            "sg_xcopy [app=0|1] [bpt=BPT] [bs=BS] [cat=0|1] [conc=CONC]\n"
+            "                [conv=CONV] [count=COUNT] [dc=0|1] [ibs=BS]\n"
             "                [id_usage=hold|discard|disable] [if=IFILE] "
             "[iflag=FLAGS]\n"
-            "                [list_id=ID] [obs=BS] [of=OFILE] "
-            "[oflag=FLAGS] [prio=PRIO]\n"
-            "                [seek=SEEK] [skip=SKIP] [time=0|1] "
+            "                [immed=0|1]"
+            " [list_id=ID] [obs=BS] [of=OFILE] [oflag=FLAGS]\n"
+            "                [prio=PRIO]"
+            " [progress=SEC[,FILE]] [seek=SEEK] [segs=SEGS]\n"
+            "                [skip=SKIP] [time=0|1] [token=0|1] "
             "[verbose=VERB]\n"
             "                [--help] [--on_dst|--on_src] [--verbose] "
-            "[--version]\n\n"
+            "[--version]\n"
+            "       sg_xcopy job=JFILE [array_conc=AC] [workers=W] "
+            "[OPERANDS...]\n\n"
             "  where:\n"
             "    app         if argument is 1 then open OFILE in append "
             "mode\n"
-            "    bpt         is blocks_per_transfer (default: 128)\n"
+            "    array_conc  with job=, concurrent copies on each array "
+            "(def:\n"
+            "                maximum concurrent copies it reports)\n"
+            "    bpt         is blocks_per_transfer (def: from maximum "
+            "segment length)\n"
             "    bs          block size (default is 512)\n");
     pr2serr("    cat         xcopy segment descriptor CAT bit (default: "
             "0)\n"
+            "    conc        EXTENDED COPY commands in flight, each with "
+            "its own\n"
+            "                list_id (def: maximum concurrent copies, up to "
+            "16)\n"
             "    conv        ignored\n"
             "    count       number of blocks to copy (def: device size)\n"
             "    dc          xcopy segment descriptor DC bit (default: 0)\n"
@@ -543,6 +620,12 @@ primary_help:
             "    if          file or device to read from (def: stdin)\n"
             "    iflag       comma separated list of flags applying to "
             "IFILE\n"
+            "    immed       with token=1, 1->set IMMED and poll with "
+            "RECEIVE ROD\n"
+            "                TOKEN INFORMATION (def: 0)\n"
+            "    job         run the copies in JFILE, one per line of "
+            "operands ('-'\n"
+            "                for stdin), those given here apply to each\n"
             "    list_id     sets list_id field to ID (default: 1 or 0)\n"
             "    obs         output block size (if given must be same as "
             "'bs=')\n"
@@ -552,12 +635,22 @@ primary_help:
             "    oflag       comma separated list of flags applying to "
             "OFILE\n"
             "    prio        set xcopy priority field to PRIO (def: 1)\n"
+            "    progress    every SEC seconds append a JSON line with the "
+            "copy's\n"
+            "                progress to FILE (def: stderr)\n"
             "    seek        block position to start writing to OFILE\n"
+            "    segs        segment descriptors (each of up to BPT blocks) "
+            "per\n"
+            "                command (def: maximum reported, up to 64)\n"
             "    skip        block position to start reading from IFILE\n"
             "    time        0->no timing(def), 1->time plus calculate "
             "throughput\n"
+            "    token       1->copy with POPULATE TOKEN to IFILE then WRITE "
+            "USING\n"
+            "                TOKEN to OFILE (def: 0 -> XCOPY(LID1))\n"
             "    verbose     0->quiet(def), 1->some noise, 2->more noise, "
             "etc\n"
+            "    workers     with job=, copies running at once (def: 4)\n"
             "    --help|-h   print out this usage message then exit\n"
             "    --on_dst    send XCOPY command to OFILE\n"
             "    --on_src    send XCOPY command to IFILE\n"
@@ -613,38 +706,113 @@ scsi_encode_seg_desc(uint8_t *seg_desc, int seg_desc_type,
     return seg_desc_len + 4;
 }
 
-static int
-scsi_extended_copy(int sg_fd, uint8_t list_id,
-                   uint8_t *src_desc, int src_desc_len,
-                   uint8_t *dst_desc, int dst_desc_len,
-                   int seg_desc_type, int64_t num_blk,
-                   uint64_t src_lba, uint64_t dst_lba)
+/* Builds the parameter list of an EXTENDED COPY(LID1) command in the
+ * slot, copying num_blk blocks from src_lba to dst_lba with as many
+ * segment descriptors (each of up to seg_blks blocks) as needed. */
+static void
+xcopy_build(struct xcopy_slot_t * sp, uint8_t *src_desc, int src_desc_len,
+            uint8_t *dst_desc, int dst_desc_len, int seg_desc_type,
+            int seg_blks, int64_t num_blk, uint64_t src_lba,
+            uint64_t dst_lba)
 {
-    uint8_t xcopyBuff[256];
+    uint8_t * xcopyBuff = sp->param;
     int desc_offset = 16;
-    int seg_desc_len;
-    int verb, res;
-    char b[80];
+    int seg_off, n;
 
-    verb = (verbose > 1) ? (verbose - 2) : 0;
-    memset(xcopyBuff, 0, 256);
-    xcopyBuff[0] = list_id;
+    memset(xcopyBuff, 0, 16);
+    xcopyBuff[0] = (uint8_t)sp->list_id;
     xcopyBuff[1] = (list_id_usage << 3) | priority;
-    xcopyBuff[2] = 0;
-    xcopyBuff[3] = src_desc_len + dst_desc_len; /* Two target descriptors */
+    /* Two target descriptors */
+    sg_put_unaligned_be16(src_desc_len + dst_desc_len, xcopyBuff + 2);
     memcpy(xcopyBuff + desc_offset, src_desc, src_desc_len);
     desc_offset += src_desc_len;
     memcpy(xcopyBuff + desc_offset, dst_desc, dst_desc_len);
     desc_offset += dst_desc_len;
-    seg_desc_len = scsi_encode_seg_desc(xcopyBuff + desc_offset,
-                                        seg_desc_type, num_blk,
-                                        src_lba, dst_lba);
-    xcopyBuff[11] = seg_desc_len; /* One segment descriptor */
-    desc_offset += seg_desc_len;
+    seg_off = desc_offset;
+    sp->blocks = (int)num_blk;
+    while (num_blk > 0) {
+        n = (num_blk > seg_blks) ? seg_blks : (int)num_blk;
+        desc_offset += scsi_encode_seg_desc(xcopyBuff + desc_offset,
+                                            seg_desc_type, n, src_lba,
+                                            dst_lba);
+        src_lba += n;
+        dst_lba += n;
+        num_blk -= n;
+    }
+    sg_put_unaligned_be32(desc_offset - seg_off, xcopyBuff + 8);
+    sp->param_len = desc_offset;
+}
+
+/* Submits the EXTENDED COPY(LID1) command built in the slot without
+ * waiting for it to complete. Returns 0 if submitted. */
+static int
+xcopy_submit(int sg_fd, struct xcopy_slot_t * sp, uint64_t seq)
+{
+    int k, res, verb;
+
+    verb = (verbose > 1) ? (verbose - 2) : 0;
+    memset(sp->cdb, 0, sizeof(sp->cdb));
+    sp->cdb[0] = THIRD_PARTY_COPY_OUT_CMD;
+    sp->cdb[1] = SA_XCOPY_LID1;
+    sg_put_unaligned_be32((uint32_t)sp->param_len, sp->cdb + 10);
+    if (verb) {
+        pr2serr("    Extended copy(LID1) cdb: ");
+        for (k = 0; k < (int)sizeof(sp->cdb); ++k)
+            pr2serr("%02x ", sp->cdb[k]);
+        pr2serr("\n");
+        if (verb > 1) {
+            pr2serr("    Extended copy(LID1) parameter list:\n");
+            hex2stderr(sp->param, sp->param_len, -1);
+        }
+    }
+    /* the parameter list length varies so rebind it, and the sense */
+    clear_scsi_pt_obj(sp->ptvp);
+    set_scsi_pt_cdb(sp->ptvp, sp->cdb, sizeof(sp->cdb));
+    set_scsi_pt_sense(sp->ptvp, sp->sense, sizeof(sp->sense));
+    set_scsi_pt_data_out(sp->ptvp, sp->param, sp->param_len);
+    set_scsi_pt_packet_id(sp->ptvp, (int)seq);
+    res = do_scsi_pt_submit(sp->ptvp, sg_fd, DEF_3PC_OUT_TIMEOUT, verb);
+    if (res) {
+        pr2serr("Xcopy(LID1): submit failed: %s\n",
+                (res < 0) ? safe_strerror(-res) : "bad parameters");
+        return (res < 0) ? sg_convert_errno(-res) : SG_LIB_CAT_OTHER;
+    }
+    sp->busy = true;
+    sp->seq = seq;
+    return 0;
+}
+
+/* Waits (unless no_wait) for the EXTENDED COPY(LID1) in the slot and
+ * checks its outcome. Returns 0 on success, -EAGAIN when no_wait and not
+ * yet complete, else an error category. */
+static int
+xcopy_reap(struct xcopy_slot_t * sp, bool no_wait)
+{
+    int res, s_cat, verb;
+    char b[80];
+
+    verb = (verbose > 1) ? (verbose - 2) : 0;
+    res = do_scsi_pt_receive(sp->ptvp, no_wait, verb);
+    if (-EAGAIN == res)
+        return res;
+    sp->busy = false;
     /* set noisy so if a UA happens it will be printed to stderr */
-    res = sg_ll_3party_copy_out(sg_fd, SA_XCOPY_LID1, list_id,
-                                DEF_GROUP_NUM, DEF_3PC_OUT_TIMEOUT,
-                                xcopyBuff, desc_offset, true, verb);
+    res = sg_cmds_process_resp(sp->ptvp, "Extended copy(LID1)", res, true,
+                               verb, &s_cat);
+    if (-1 == res)
+        res = sg_convert_errno(get_scsi_pt_os_err(sp->ptvp));
+    else if (-2 == res) {
+        switch (s_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            res = 0;
+            break;
+        default:
+            res = s_cat;
+            break;
+        }
+    } else
+        res = 0;
     if (res) {
         sg_get_category_sense_str(res, sizeof(b), b, verb);
         pr2serr("Xcopy(LID1): %s\n", b);
@@ -652,6 +820,264 @@ scsi_extended_copy(int sg_fd, uint8_t list_id,
     return res;
 }
 
+/* Encodes block device range descriptors, each of up to seg_blks blocks,
+ * for num_blk blocks starting at lba. Returns the number of bytes. */
+static int
+tok_encode_ranges(uint8_t * bp, int seg_blks, int num_blk, uint64_t lba)
+{
+    int n, off;
+
+    for (off = 0; num_blk > 0; off += RANGE_DESC_LEN) {
+        n = (num_blk > seg_blks) ? seg_blks : num_blk;
+        memset(bp + off, 0, RANGE_DESC_LEN);
+        sg_put_unaligned_be64(lba, bp + off);
+        sg_put_unaligned_be32((uint32_t)n, bp + off + 8);
+        lba += n;
+        num_blk -= n;
+    }
+    return off;
+}
+
+static const char *
+tok_cmd_str(int state)
+{
+    switch (state) {
+    case TOK_POPULATE:
+        return "Populate token";
+    case TOK_RRTI:
+    case TOK_WR_RRTI:
+        return "Receive ROD token information";
+    default:
+        return "Write using token";
+    }
+}
+
+/* Submits the command of the slot's token copy given by sp->state without
+ * waiting for it: POPULATE TOKEN and RECEIVE ROD TOKEN INFORMATION about it
+ * go to IFILE, WRITE USING TOKEN and RECEIVE ROD TOKEN INFORMATION about it
+ * go to OFILE. The slot's blocks are covered by range descriptors of up to
+ * seg_blks blocks. Returns 0 if submitted. */
+static int
+tok_submit(int infd, int outfd, struct xcopy_slot_t * sp, int seg_blks,
+           uint64_t seq)
+{
+    bool rrti = ((TOK_RRTI == sp->state) || (TOK_WR_RRTI == sp->state));
+    bool to_out = ((TOK_WRITE == sp->state) || (TOK_WR_RRTI == sp->state));
+    int k, n, res, verb;
+    uint8_t * bp = sp->param;
+    struct sg_pt_base * ptvp = to_out ? sp->optvp : sp->ptvp;
+    const char * cmd_s = tok_cmd_str(sp->state);
+
+    verb = (verbose > 1) ? (verbose - 2) : 0;
+    memset(sp->cdb, 0, sizeof(sp->cdb));
+    sp->cdb[0] = THIRD_PARTY_COPY_OUT_CMD;
+    switch (sp->state) {
+    case TOK_POPULATE:
+        /* RTV clear; default inactivity timeout and ROD type */
+        memset(bp, 0, 16);
+        if (tok_immed)
+            bp[2] = 0x1;
+        n = tok_encode_ranges(bp + 16, seg_blks, sp->blocks, sp->src_lba);
+        sg_put_unaligned_be16((uint16_t)n, bp + 14);
+        sp->param_len = 16 + n;
+        sp->cdb[1] = SA_POP_TOK;
+        break;
+    case TOK_RRTI:
+    case TOK_WR_RRTI:
+        sp->cdb[0] = THIRD_PARTY_COPY_IN_CMD;
+        sp->cdb[1] = SA_ROD_TOK_INFO;
+        sg_put_unaligned_be32(sp->list_id, sp->cdb + 2);
+        sg_put_unaligned_be32(RRTI_RESP_LEN, sp->cdb + 10);
+        sp->param_len = RRTI_RESP_LEN;
+        break;
+    default:
+        /* DEL_TKN set as the token is not used again; offset into ROD 0 */
+        memset(bp, 0, WUT_RANGE_OFF);
+        bp[2] = tok_immed ? 0x3 : 0x2;
+        memcpy(bp + 16, sp->token, ROD_TOKEN_LEN);
+        n = tok_encode_ranges(bp + WUT_RANGE_OFF, seg_blks, sp->blocks,
+                              sp->dst_lba);
+        sg_put_unaligned_be16((uint16_t)n, bp + WUT_RANGE_OFF - 2);
+        sp->param_len = WUT_RANGE_OFF + n;
+        sp->cdb[1] = SA_WR_USING_TOK;
+        break;
+    }
+    if (! rrti) {
+        sg_put_unaligned_be16((uint16_t)(sp->param_len - 2), bp + 0);
+        sg_put_unaligned_be32(sp->list_id, sp->cdb + 6);
+        sg_put_unaligned_be32((uint32_t)sp->param_len, sp->cdb + 10);
+        sp->cdb[14] = DEF_GROUP_NUM;
+    }
+    if (verb) {
+        pr2serr("    %s cdb: ", cmd_s);
+        for (k = 0; k < (int)sizeof(sp->cdb); ++k)
+            pr2serr("%02x ", sp->cdb[k]);
+        pr2serr("\n");
+        if ((verb > 1) && (! rrti)) {
+            pr2serr("    %s parameter list:\n", cmd_s);
+            hex2stderr(bp, sp->param_len, -1);
+        }
+    }
+    clear_scsi_pt_obj(ptvp);
+    set_scsi_pt_cdb(ptvp, sp->cdb, sizeof(sp->cdb));
+    set_scsi_pt_sense(ptvp, sp->sense, sizeof(sp->sense));
+    if (rrti)
+        set_scsi_pt_data_in(ptvp, bp, sp->param_len);
+    else
+        set_scsi_pt_data_out(ptvp, bp, sp->param_len);
+    set_scsi_pt_packet_id(ptvp, (int)seq);
+    res = do_scsi_pt_submit(ptvp, (to_out ? outfd : infd),
+                            DEF_3PC_OUT_TIMEOUT, verb);
+    if (res) {
+        pr2serr("%s: submit failed: %s\n", cmd_s,
+                (res < 0) ? safe_strerror(-res) : "bad parameters");
+        return (res < 0) ? sg_convert_errno(-res) : SG_LIB_CAT_OTHER;
+    }
+    sp->busy = true;
+    sp->seq = seq;
+    return 0;
+}
+
+/* Waits (unless no_wait) for the command of the slot's token copy and
+ * checks its outcome. After RECEIVE ROD TOKEN INFORMATION about POPULATE
+ * TOKEN the ROD token is kept in the slot for the WRITE USING TOKEN.
+ * Returns 0 on success, -EAGAIN when no_wait and not yet complete,
+ * -EINPROGRESS when RECEIVE ROD TOKEN INFORMATION reports the copy (sent
+ * with immed=1) still in progress, with sp->due_ns set for the next poll,
+ * else an error category. */
+static int
+tok_reap(struct xcopy_slot_t * sp, bool no_wait)
+{
+    int res, s_cat, verb, len, sd_len, cop_stat, sa;
+    uint32_t ms;
+    uint8_t * bp = sp->param;
+    struct sg_pt_base * ptvp;
+    const char * cmd_s = tok_cmd_str(sp->state);
+    char b[80];
+
+    verb = (verbose > 1) ? (verbose - 2) : 0;
+    if ((TOK_WRITE == sp->state) || (TOK_WR_RRTI == sp->state))
+        ptvp = sp->optvp;
+    else
+        ptvp = sp->ptvp;
+    res = do_scsi_pt_receive(ptvp, no_wait, verb);
+    if (-EAGAIN == res)
+        return res;
+    sp->busy = false;
+    res = sg_cmds_process_resp(ptvp, cmd_s, res, true, verb, &s_cat);
+    if (-1 == res)
+        res = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == res) {
+        switch (s_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            res = 0;
+            break;
+        default:
+            res = s_cat;
+            break;
+        }
+    } else
+        res = 0;
+    if (res) {
+        sg_get_category_sense_str(res, sizeof(b), b, verb);
+        pr2serr("%s: %s\n", cmd_s, b);
+        return res;
+    }
+    if ((TOK_RRTI != sp->state) && (TOK_WR_RRTI != sp->state))
+        return 0;
+    len = sp->param_len - get_scsi_pt_resid(ptvp);
+    if (verb > 1) {
+        pr2serr("    %s response:\n", cmd_s);
+        hex2stderr(bp, len, -1);
+    }
+    sa = (TOK_RRTI == sp->state) ? SA_POP_TOK : SA_WR_USING_TOK;
+    if ((len < 32) || (sa != (bp[4] & 0x1f))) {
+        pr2serr("%s: not a response to %s\n", cmd_s,
+                (SA_POP_TOK == sa) ? "populate token" : "write using token");
+        return SG_LIB_CAT_MALFORMED;
+    }
+    cop_stat = bp[5] & 0x7f;
+    if ((0x10 == cop_stat) || (0x11 == cop_stat)) {
+        /* in progress in the foreground or background; poll again after
+         * the estimated status update delay */
+        ms = sg_get_unaligned_be32(bp + 8);
+        if (0 == ms)
+            ms = DEF_TOKEN_POLL_MS;
+        else if (ms > MAX_TOKEN_POLL_MS)
+            ms = MAX_TOKEN_POLL_MS;
+        sp->due_ns = sg_pt_lat_now_ns() + (uint64_t)ms * 1000000;
+        if (verbose > 2)
+            pr2serr("    list_id=%" PRIu32 ": %" PRIu64 " of %d blocks, "
+                    "poll again in %" PRIu32 " ms\n", sp->list_id,
+                    sg_get_unaligned_be64(bp + 16), sp->blocks, ms);
+        return -EINPROGRESS;
+    }
+    if (0x1 != cop_stat) {      /* 0x1: completed without errors */
+        pr2serr("%s: copy operation status 0x%x, transfer count %" PRIu64
+                " for %d blocks\n", cmd_s, cop_stat,
+                sg_get_unaligned_be64(bp + 16), sp->blocks);
+        return SG_LIB_CAT_OTHER;
+    }
+    if (TOK_WR_RRTI == sp->state)
+        return 0;
+    sd_len = bp[13];            /* followed by ROD token descriptors */
+    if ((32 + sd_len + 6 + ROD_TOKEN_LEN > len) ||
+        (sg_get_unaligned_be32(bp + 32 + sd_len) < 2 + ROD_TOKEN_LEN)) {
+        pr2serr("%s: no ROD token in response\n", cmd_s);
+        return SG_LIB_CAT_MALFORMED;
+    }
+    memcpy(sp->token, bp + 32 + sd_len + 6, ROD_TOKEN_LEN);
+    return 0;
+}
+
+/* Fetches the Block Device ROD Token Limits descriptor from the Third
+ * Party Copy VPD page. Returns 0 with the maximum number of range
+ * descriptors, maximum token transfer size and optimal transfer count
+ * (in blocks, 0 if not reported) set, else -1. */
+static int
+tok_limits(int sg_fd, int * max_rdp, uint64_t * mttsp, uint64_t * otcp)
+{
+    int res, k, len, bump, verb;
+    uint8_t rcBuff[1024];
+    const uint8_t * bp;
+
+    verb = (verbose ? verbose - 1: 0);
+    res = sg_ll_inquiry(sg_fd, false, true /* evpd */, VPD_3PARTY_COPY,
+                        rcBuff, 4, false, verb);
+    if ((0 != res) || (VPD_3PARTY_COPY != rcBuff[1]))
+        return -1;
+    len = sg_get_unaligned_be16(rcBuff + 2) + 4;
+    if (len > (int)sizeof(rcBuff))
+        len = sizeof(rcBuff);
+    res = sg_ll_inquiry(sg_fd, false, true, VPD_3PARTY_COPY, rcBuff, len,
+                        false, verb);
+    if ((0 != res) || (VPD_3PARTY_COPY != rcBuff[1]))
+        return -1;
+    for (k = 4; k + 4 <= len; k += bump) {
+        bp = rcBuff + k;
+        bump = 4 + sg_get_unaligned_be16(bp + 2);
+        if ((0 != sg_get_unaligned_be16(bp)) || (bump < 36) ||
+            (k + bump > len))
+            continue;
+        *max_rdp = sg_get_unaligned_be16(bp + 10);
+        *mttsp = sg_get_unaligned_be64(bp + 20);
+        *otcp = sg_get_unaligned_be64(bp + 28);
+        return 0;
+    }
+    return -1;
+}
+
+static void
+sleep_ns(uint64_t ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    nanosleep(&ts, NULL);
+}
+
 /* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
 static int
 scsi_read_capacity(struct xcopy_fp_t *xfp)
@@ -740,6 +1166,9 @@ scsi_operating_parameter(struct xcopy_fp_t *xfp, int is_target)
     max_desc_len = sg_get_unaligned_be32(rcBuff + 12);
     max_segment_len = sg_get_unaligned_be32(rcBuff + 16);
     xfp->max_bytes = max_segment_len ? max_segment_len : UINT32_MAX;
+    xfp->max_segs = max_segment_num;
+    xfp->max_desc_len = max_desc_len;
+    xfp->max_conc = rcBuff[36];
     max_inline_data = sg_get_unaligned_be32(rcBuff + 20);
     if (verbose) {
         pr2serr(" >> %s response:\n", rec_copy_op_params_str);
@@ -1156,6 +1585,55 @@ calc_duration_throughput(int contin)
 
 /* Process arguments given to 'iflag=" or 'oflag=" options. Returns 0
  * on success, 1 on error. */
+/* With progress=SEC[,FILE]: called after each EXTENDED COPY command, every
+ * SEC seconds writes one line holding a JSON object to FILE. 'final' is set
+ * for the last line, written when the copy ends; 'res' is the result of the
+ * last command. The device does the copy so only its EXTENDED COPY
+ * commands are timed (xcopy_lat_us member). */
+static void
+progress_out(bool final, int xcopy_fd, int res)
+{
+    double el, iv;
+    uint64_t now;
+    struct timeval tv;
+    struct sg_pt_lat_summary ls;
+
+    if (NULL == progress_fp)
+        return;
+    if (! final)
+        ++progress_xcopies;
+    now = sg_pt_lat_now_ns();
+    if ((! final) && ((now - progress_last_ns) <
+                      ((uint64_t)progress_sec * 1000000000)))
+        return;
+    el = (now - progress_start_ns) / 1e9;
+    iv = (now - progress_last_ns) / 1e9;
+    if (iv < 0.000001)
+        iv = 0.000001;
+    gettimeofday(&tv, NULL);
+    fprintf(progress_fp, "{\"tool\":\"sg_xcopy\",\"pid\":%d,\"time\":"
+            "%ld.%03d,\"final\":%s,\"elapsed_s\":%.3f,\"count\":%" PRId64
+            ",\"blocks_in\":%" PRId64 ",\"blocks_out\":%" PRId64 ",\"bs\":"
+            "%d,\"mb_s\":%.2f,\"avg_mb_s\":%.2f,\"iops\":%.1f,"
+            "\"recovered_errs\":0,\"unrecovered_errs\":%d,\"retries\":0",
+            (int)getpid(), (long)tv.tv_sec, (int)(tv.tv_usec / 1000),
+            final ? "true" : "false", el, progress_count, in_full, in_full,
+            blk_sz, ((in_full - progress_last_blks) * (double)blk_sz) /
+            (iv * 1000000.0), (el > 0.000001) ?
+            (in_full * (double)blk_sz) / (el * 1000000.0) : 0.0,
+            (progress_xcopies - progress_last_xcopies) / iv, res ? 1 : 0);
+    if (0 == sg_pt_lat_get(xcopy_fd, THIRD_PARTY_COPY_OUT_CMD, &ls))
+        fprintf(progress_fp, ",\"xcopy_lat_us\":{\"count\":%" PRIu64
+                ",\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+                ls.count, ls.p50_ns / 1000.0, ls.p99_ns / 1000.0,
+                ls.p999_ns / 1000.0, ls.max_ns / 1000.0);
+    fprintf(progress_fp, "}\n");
+    fflush(progress_fp);
+    progress_last_ns = now;
+    progress_last_blks = in_full;
+    progress_last_xcopies = progress_xcopies;
+}
+
 static int
 process_flags(const char * arg, struct xcopy_fp_t * fp)
 {
@@ -1302,9 +1780,654 @@ num_chs_in_str(const char * s, int slen, int ch)
     return res;
 }
 
+static int do_xcopy(int argc, char * argv[]);
+
+/* job=JFILE: each line of JFILE holds the operands of one copy. Up to
+ * workers=W copies run at once, each in a child process running
+ * do_xcopy() with the operands given on the command line followed by
+ * those of its line. A copy counts its conc= (in job mode 1 unless given)
+ * against the array it is on; an array keeps to array_conc= or else to
+ * the "Maximum concurrent copies" its copy manager reports. */
+#define DEF_JOB_WORKERS 4
+#define MAX_JOB_WORKERS 256
+#define MAX_JOB_ARGS 64         /* operands on one line of JFILE */
+#define JOB_LINE_SZ 4096
+#define JOB_LID_LANES 15        /* list_id=1+16*LANE fits in a byte */
+
+#define JOB_PENDING 0
+#define JOB_RUNNING 1
+#define JOB_DONE 2
+
+struct xcopy_job_t {
+    bool list_id_given;
+    int line;               /* in JFILE */
+    int argc;
+    int array;              /* index in job_arrs[] */
+    int weight;             /* its conc= */
+    int state;              /* JOB_* */
+    int lane;               /* -1 or list_id lane it holds on its array */
+    int rfd;                /* read end of the pipe job_report() writes */
+    int res;                /* exit status once done */
+    int blk_sz;
+    int rlen;
+    pid_t pid;
+    int64_t count;          /* -1 until the copy reports it */
+    int64_t blocks;         /* copied so far */
+    char ** argv;
+    char rbuf[128];
+    char conc_arg[32];
+    char lid_arg[32];
+};
+
+struct xcopy_arr_t {
+    int limit;              /* concurrent copies, 0 for no limit */
+    int in_use;             /* summed weight of its running jobs */
+    uint32_t lanes;         /* list_id lanes held, a bit per lane */
+    char name[INOUTF_SZ];
+    char dev[INOUTF_SZ];    /* receives the XCOPY commands of a job on it */
+};
+
+static int job_report_fd = -1; /* in a job: write end of pipe to scheduler */
+
+static struct xcopy_job_t * jobs;
+static int num_jobs;
+static struct xcopy_arr_t * job_arrs;
+static int num_job_arrs;
+
+/* In a copy started by job=JFILE: tells the scheduler the size of the
+ * copy, then the blocks copied so far as each command completes. */
+static void
+job_report(bool start)
+{
+    int n;
+    char b[64];
+
+    if (job_report_fd < 0)
+        return;
+    if (start)
+        n = snprintf(b, sizeof(b), "c %" PRId64 " %d\n", dd_count,
+                     (blk_sz > 0) ? blk_sz : ixcf.sect_sz);
+    else
+        n = snprintf(b, sizeof(b), "b %" PRId64 "\n", in_full);
+    if (write(job_report_fd, b, n) < 0)
+        job_report_fd = -1;     /* scheduler gone, the copy goes on */
+}
+
+/* Returns the value of the last 'key=' operand in argv, else NULL */
+static const char *
+job_arg_val(const struct xcopy_job_t * jp, const char * key)
+{
+    int k;
+    int klen = strlen(key);
+    const char * res = NULL;
+
+    for (k = 1; k < jp->argc; ++k) {
+        if ((0 == strncmp(jp->argv[k], key, klen)) &&
+            ('=' == jp->argv[k][klen]))
+            res = jp->argv[k] + klen + 1;
+    }
+    return res;
+}
+
+/* Name of the device the copy's XCOPY commands go to, found as do_xcopy()
+ * does (WRITE USING TOKEN goes to OFILE with token=1) */
+static const char *
+job_xcopy_dev(const struct xcopy_job_t * jp)
+{
+    bool on_src = false;
+    bool given = false;
+    bool ix, ox;
+    int k;
+    const char * cp;
+    const char * ifp = job_arg_val(jp, "if");
+    const char * ofp = job_arg_val(jp, "of");
+
+    for (k = 1; k < jp->argc; ++k) {
+        if (0 == strncmp(jp->argv[k], "--on_src", 8))
+            on_src = given = true;
+        else if (0 == strncmp(jp->argv[k], "--on_dst", 8)) {
+            on_src = false;
+            given = true;
+        }
+    }
+    cp = job_arg_val(jp, "token");
+    if (cp && (1 == sg_get_num(cp)))
+        on_src = false;
+    else if (! given) {
+        cp = job_arg_val(jp, "iflag");
+        ix = cp && strstr(cp, "xcopy");
+        cp = job_arg_val(jp, "oflag");
+        ox = cp && strstr(cp, "xcopy");
+        if (ix != ox)
+            on_src = ix;
+        else if ((!! getenv(XCOPY_TO_SRC)) != (!! getenv(XCOPY_TO_DST)))
+            on_src = !! getenv(XCOPY_TO_SRC);
+        else
+            on_src = (0 == DEF_XCOPY_SRC0_DST1);
+    }
+    cp = on_src ? ifp : ofp;
+    return cp ? cp : "";
+}
+
+/* Returns the index of the array called 'name', adding it if need be */
+static int
+job_find_arr(const char * name, const char * dev)
+{
+    int k;
+    struct xcopy_arr_t * ap;
+
+    for (k = 0; k < num_job_arrs; ++k) {
+        if (0 == strcmp(job_arrs[k].name, name))
+            return k;
+    }
+    ap = (struct xcopy_arr_t *)realloc(job_arrs,
+                                       (num_job_arrs + 1) * sizeof(*ap));
+    if (NULL == ap)
+        return -1;
+    job_arrs = ap;
+    ap += num_job_arrs;
+    memset(ap, 0, sizeof(*ap));
+    ap->limit = -1;
+    snprintf(ap->name, sizeof(ap->name), "%s", name);
+    snprintf(ap->dev, sizeof(ap->dev), "%s", dev);
+    return num_job_arrs++;
+}
+
+/* Reads the jobs in JFILE, one per line, each given the leading operands
+ * preset[0..num_preset-1] before those of the line. Blank lines and those
+ * starting with '#' are skipped. Returns 0 on success. */
+static int
+job_read_file(const char * jfile, char ** preset, int num_preset)
+{
+    bool lid_given;
+    int k, n, line, argc, weight;
+    char * cp;
+    char * save;
+    const char * arr;
+    const char * dev;
+    FILE * fp;
+    struct xcopy_job_t * jp;
+    char * toks[MAX_JOB_ARGS];
+    char b[JOB_LINE_SZ];
+
+    if (('-' == jfile[0]) && ('\0' == jfile[1]))
+        fp = stdin;
+    else if (NULL == (fp = fopen(jfile, "r"))) {
+        n = errno;
+        pr2serr(ME "unable to open job file %s: %s\n", jfile,
+                safe_strerror(n));
+        return sg_convert_errno(n);
+    }
+    for (line = 1; fgets(b, sizeof(b), fp); ++line) {
+        for (n = 0, cp = strtok_r(b, " \t\r\n", &save); cp;
+             cp = strtok_r(NULL, " \t\r\n", &save)) {
+            if ('#' == cp[0])
+                break;
+            if (n >= MAX_JOB_ARGS) {
+                pr2serr(ME "job file line %d: more than %d operands\n", line,
+                        MAX_JOB_ARGS);
+                goto syntax_err;
+            }
+            toks[n++] = cp;
+        }
+        if (0 == n)
+            continue;
+        jp = (struct xcopy_job_t *)realloc(jobs,
+                                           (num_jobs + 1) * sizeof(*jp));
+        if (NULL == jp)
+            goto nomem;
+        jobs = jp;
+        jp += num_jobs;
+        memset(jp, 0, sizeof(*jp));
+        /* room for argv[0], conc= and list_id= plus the NULL */
+        jp->argv = (char **)calloc(num_preset + n + 4, sizeof(char *));
+        if (NULL == jp->argv)
+            goto nomem;
+        ++num_jobs;
+        jp->line = line;
+        jp->lane = -1;
+        jp->rfd = -1;
+        jp->count = -1;
+        argc = 0;
+        jp->argv[argc++] = (char *)"sg_xcopy";
+        for (k = 0; k < num_preset; ++k)
+            jp->argv[argc++] = preset[k];
+        for (k = 0, arr = NULL; k < n; ++k) {
+            if ((0 == strncmp(toks[k], "job=", 4)) ||
+                (0 == strncmp(toks[k], "workers=", 8)) ||
+                (0 == strncmp(toks[k], "array_conc=", 11))) {
+                pr2serr(ME "job file line %d: '%s' only allowed on the "
+                        "command line\n", line, toks[k]);
+                goto syntax_err;
+            }
+            if (NULL == (cp = strdup(toks[k])))
+                goto nomem;
+            if (0 == strncmp(cp, "array=", 6))
+                arr = cp + 6;   /* the scheduler's, not passed on */
+            else
+                jp->argv[argc++] = cp;
+        }
+        jp->argc = argc;
+        cp = (char *)job_arg_val(jp, "conc");
+        weight = cp ? sg_get_num(cp) : 1;
+        if ((weight < 1) || (weight > MAX_XCOPY_CONC)) {
+            pr2serr(ME "job file line %d: bad argument to 'conc='\n", line);
+            goto syntax_err;
+        }
+        if (NULL == cp) {
+            /* spread an array's concurrent copies over its jobs */
+            snprintf(jp->conc_arg, sizeof(jp->conc_arg), "conc=1");
+            jp->argv[jp->argc++] = jp->conc_arg;
+        }
+        jp->weight = weight;
+        lid_given = !! job_arg_val(jp, "list_id");
+        cp = (char *)job_arg_val(jp, "id_usage");
+        if (cp && (0 == strncmp(cp, "disable", 7)))
+            lid_given = true;   /* list IDs are zero, no lane */
+        jp->list_id_given = lid_given;
+        dev = job_xcopy_dev(jp);
+        jp->array = job_find_arr((arr && *arr) ? arr : dev, dev);
+        if (jp->array < 0)
+            goto nomem;
+    }
+    if (stdin != fp)
+        fclose(fp);
+    if (0 == num_jobs) {
+        pr2serr(ME "no jobs in job file %s\n", jfile);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    return 0;
+
+nomem:
+    pr2serr(ME "out of memory reading job file\n");
+    if (stdin != fp)
+        fclose(fp);
+    return sg_convert_errno(ENOMEM);
+syntax_err:
+    if (stdin != fp)
+        fclose(fp);
+    return SG_LIB_SYNTAX_ERROR;
+}
+
+/* Sets the limit of each array not given by array_conc= to the "Maximum
+ * concurrent copies" its copy manager reports (0 if it reports none or
+ * cannot be asked). With SG3_UTILS_INQ_CACHE the response is cached. */
+static void
+job_arr_limits(int arr_conc, int vb)
+{
+    int k, fd, res;
+    struct xcopy_arr_t * ap;
+    uint8_t rcBuff[256];
+
+    for (k = 0; k < num_job_arrs; ++k) {
+        ap = job_arrs + k;
+        if (arr_conc >= 0) {
+            ap->limit = arr_conc;
+            continue;
+        }
+        ap->limit = 0;
+        if ('\0' == ap->dev[0])
+            continue;
+        fd = sg_cmds_open_device(ap->dev, true /* ro */, vb);
+        if (fd < 0) {
+            if (vb)
+                pr2serr(ME "array %s: unable to open %s, no limit\n",
+                        ap->name, ap->dev);
+            continue;
+        }
+        res = sg_ll_receive_copy_results(fd, SA_COPY_OP_PARAMS, 0, rcBuff,
+                                         sizeof(rcBuff), false, vb);
+        if (0 == res)
+            ap->limit = rcBuff[36];
+        else if (vb)
+            pr2serr(ME "array %s: %s failed, no limit\n", ap->name,
+                    rec_copy_op_params_str);
+        sg_cmds_close_device(fd);
+        if (vb)
+            pr2serr(ME "array %s: %d concurrent copies (0 is no limit)\n",
+                    ap->name, ap->limit);
+    }
+}
+
+/* Starts the job in a child process. Returns 0 on success. */
+static int
+job_start(struct xcopy_job_t * jp, int vb)
+{
+    int k, lane;
+    int pfd[2];
+    pid_t pid;
+    struct xcopy_arr_t * ap = job_arrs + jp->array;
+
+    if (! jp->list_id_given) {
+        for (lane = 0; lane < JOB_LID_LANES; ++lane) {
+            if (0 == (ap->lanes & (1 << lane)))
+                break;
+        }
+        jp->lane = lane;
+        ap->lanes |= (1 << lane);
+        snprintf(jp->lid_arg, sizeof(jp->lid_arg), "list_id=%d",
+                 1 + (lane * MAX_XCOPY_CONC));
+        jp->argv[jp->argc++] = jp->lid_arg;
+    }
+    if (pipe(pfd) < 0) {
+        k = errno;
+        perror(ME "pipe");
+        return sg_convert_errno(k);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+        k = errno;
+        perror(ME "fork");
+        close(pfd[0]);
+        close(pfd[1]);
+        return sg_convert_errno(k);
+    }
+    if (0 == pid) {     /* the child does the copy */
+        for (k = 0; k < num_jobs; ++k) {
+            if (jobs[k].rfd >= 0)
+                close(jobs[k].rfd);
+        }
+        close(pfd[0]);
+        job_report_fd = pfd[1];
+        exit(do_xcopy(jp->argc, jp->argv));
+    }
+    close(pfd[1]);
+    jp->pid = pid;
+    jp->rfd = pfd[0];
+    jp->state = JOB_RUNNING;
+    ap->in_use += jp->weight;
+    if (vb) {
+        pr2serr(ME "job on line %d started, pid %d:", jp->line, (int)pid);
+        for (k = 1; k < jp->argc; ++k)
+            pr2serr(" %s", jp->argv[k]);
+        pr2serr("\n");
+    }
+    return 0;
+}
+
+/* A job may start when its array has room for its weight (or is idle, so
+ * a job heavier than the limit still runs, on its own) and a list ID lane
+ * if it needs one. */
+static bool
+job_may_start(const struct xcopy_job_t * jp)
+{
+    const struct xcopy_arr_t * ap = job_arrs + jp->array;
+
+    if ((ap->limit > 0) && (ap->in_use > 0) &&
+        ((ap->in_use + jp->weight) > ap->limit))
+        return false;
+    if ((! jp->list_id_given) &&
+        (ap->lanes == ((1U << JOB_LID_LANES) - 1)))
+        return false;
+    return true;
+}
+
+/* Takes the reports of the job's copy; on end of file reaps it */
+static void
+job_read_report(struct xcopy_job_t * jp, int vb)
+{
+    int n, st;
+    char * cp;
+    char * ep;
+    struct xcopy_arr_t * ap;
+
+    n = read(jp->rfd, jp->rbuf + jp->rlen, sizeof(jp->rbuf) - 1 - jp->rlen);
+    if ((n < 0) && ((EINTR == errno) || (EAGAIN == errno)))
+        return;
+    if (n > 0) {
+        jp->rlen += n;
+        jp->rbuf[jp->rlen] = '\0';
+        for (cp = jp->rbuf; (ep = strchr(cp, '\n')); cp = ep + 1) {
+            *ep = '\0';
+            if ('c' == cp[0])
+                sscanf(cp + 1, "%" SCNd64 " %d", &jp->count, &jp->blk_sz);
+            else if ('b' == cp[0])
+                sscanf(cp + 1, "%" SCNd64, &jp->blocks);
+        }
+        jp->rlen = strlen(cp);
+        memmove(jp->rbuf, cp, jp->rlen);
+        return;
+    }
+    close(jp->rfd);
+    jp->rfd = -1;
+    while ((waitpid(jp->pid, &st, 0) < 0) && (EINTR == errno))
+        ;
+    if (WIFEXITED(st))
+        jp->res = WEXITSTATUS(st);
+    else {
+        pr2serr(ME "job on line %d killed by signal %d\n", jp->line,
+                WIFSIGNALED(st) ? WTERMSIG(st) : 0);
+        jp->res = SG_LIB_CAT_OTHER;
+    }
+    jp->state = JOB_DONE;
+    ap = job_arrs + jp->array;
+    ap->in_use -= jp->weight;
+    if (jp->lane >= 0)
+        ap->lanes &= ~(1U << jp->lane);
+    if (vb || jp->res)
+        pr2serr(ME "job on line %d: %" PRId64 " blocks, exit status %d\n",
+                jp->line, jp->blocks, jp->res);
+}
+
+/* With progress=SEC[,FILE] in job mode: one JSON line every SEC seconds
+ * summing the copies of all jobs that have started. */
+static void
+job_progress_out(FILE * fp, bool final, uint64_t start_ns, uint64_t * last_ns,
+                 int64_t * last_bytes)
+{
+    int k, running, done, failed;
+    int64_t count, blocks, bytes;
+    double el, iv;
+    uint64_t now = sg_pt_lat_now_ns();
+    struct timeval tv;
+    const struct xcopy_job_t * jp;
+
+    for (k = 0, running = 0, done = 0, failed = 0, count = 0, blocks = 0,
+         bytes = 0; k < num_jobs; ++k) {
+        jp = jobs + k;
+        if (JOB_RUNNING == jp->state)
+            ++running;
+        else if (JOB_DONE == jp->state) {
+            ++done;
+            if (jp->res)
+                ++failed;
+        }
+        if (jp->count > 0)
+            count += jp->count;
+        blocks += jp->blocks;
+        bytes += jp->blocks * jp->blk_sz;
+    }
+    el = (now - start_ns) / 1e9;
+    iv = (now - *last_ns) / 1e9;
+    if (iv < 0.000001)
+        iv = 0.000001;
+    gettimeofday(&tv, NULL);
+    fprintf(fp, "{\"tool\":\"sg_xcopy\",\"pid\":%d,\"time\":%ld.%03d,"
+            "\"final\":%s,\"elapsed_s\":%.3f,\"jobs\":%d,\"jobs_running\":"
+            "%d,\"jobs_done\":%d,\"jobs_failed\":%d,\"count\":%" PRId64
+            ",\"blocks_in\":%" PRId64 ",\"blocks_out\":%" PRId64 ",\"bytes\":"
+            "%" PRId64 ",\"mb_s\":%.2f,\"avg_mb_s\":%.2f}\n", (int)getpid(),
+            (long)tv.tv_sec, (int)(tv.tv_usec / 1000),
+            final ? "true" : "false", el, num_jobs, running, done, failed,
+            count, blocks, blocks, bytes,
+            (bytes - *last_bytes) / (iv * 1000000.0),
+            (el > 0.000001) ? bytes / (el * 1000000.0) : 0.0);
+    fflush(fp);
+    *last_ns = now;
+    *last_bytes = bytes;
+}
+
+/* job=JFILE given: runs its jobs with up to workers=W at once. Returns the
+ * exit status of the first job (in JFILE order) that failed, else 0. */
+static int
+run_jobs(int argc, char * argv[])
+{
+    int k, n, res, running, timeout_ms, vb;
+    int arr_conc = -1;
+    int num_preset = 0;
+    int prog_sec = 0;
+    int workers = DEF_JOB_WORKERS;
+    int64_t blocks, last_bytes = 0;
+    uint64_t start_ns, last_ns, now;
+    const char * jfile = NULL;
+    char * cp;
+    FILE * prog_fp = NULL;
+    struct pollfd * pfds;
+    struct xcopy_job_t * jp;
+    char ** preset;
+
+    preset = (char **)calloc(argc, sizeof(char *));
+    if (NULL == preset) {
+        pr2serr(ME "out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 1, vb = 0; k < argc; ++k) {
+        cp = argv[k];
+        if (0 == strncmp(cp, "job=", 4))
+            jfile = cp + 4;
+        else if (0 == strncmp(cp, "workers=", 8)) {
+            workers = sg_get_num(cp + 8);
+            if ((workers < 1) || (workers > MAX_JOB_WORKERS)) {
+                pr2serr(ME "bad argument to 'workers=', expect 1 to %d\n",
+                        MAX_JOB_WORKERS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strncmp(cp, "array_conc=", 11)) {
+            arr_conc = sg_get_num(cp + 11);
+            if (arr_conc < 0) {
+                pr2serr(ME "bad argument to 'array_conc='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strncmp(cp, "progress=", 9)) {
+            /* aggregated over the jobs, not passed on to each */
+            prog_sec = sg_get_num(cp + 9);
+            if (prog_sec < 1) {
+                pr2serr(ME "bad argument to 'progress=', expect SEC[,FILE] "
+                        "with SEC > 0\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            cp = strchr(cp, ',');
+            if (cp && cp[1]) {
+                if (NULL == (prog_fp = fopen(cp + 1, "a"))) {
+                    perror(ME "could not open progress file");
+                    return SG_LIB_FILE_ERROR;
+                }
+            } else
+                prog_fp = stderr;
+        } else {
+            if (0 == strncmp(cp, "verbose=", 8))
+                vb = sg_get_num(cp + 8);
+            else if (0 == strncmp(cp, "--verb", 6))
+                ++vb;
+            else if (('-' == cp[0]) && ('-' != cp[1]))
+                vb += num_chs_in_str(cp + 1, strlen(cp + 1), 'v');
+            preset[num_preset++] = cp;
+        }
+    }
+    if ((NULL == jfile) || ('\0' == *jfile)) {
+        pr2serr(ME "'job=' needs a file name (or '-' for stdin)\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    res = job_read_file(jfile, preset, num_preset);
+    if (res)
+        return res;
+    job_arr_limits(arr_conc, vb);
+    if (vb)
+        pr2serr(ME "%d jobs on %d arrays, %d workers\n", num_jobs,
+                num_job_arrs, workers);
+    pfds = (struct pollfd *)calloc(workers, sizeof(*pfds));
+    if (NULL == pfds) {
+        pr2serr(ME "out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    start_ns = sg_pt_lat_now_ns();
+    last_ns = start_ns;
+    for (running = 0, res = 0; ; ) {
+        /* the first pending jobs with room on their arrays, so a busy
+         * array does not hold up the others */
+        for (k = 0; (k < num_jobs) && (running < workers) && (0 == res);
+             ++k) {
+            jp = jobs + k;
+            if ((JOB_PENDING != jp->state) || (! job_may_start(jp)))
+                continue;
+            res = job_start(jp, vb);
+            if (0 == res)
+                ++running;
+        }
+        if (0 == running)
+            break;
+        for (k = 0, n = 0; k < num_jobs; ++k) {
+            if (JOB_RUNNING != jobs[k].state)
+                continue;
+            pfds[n].fd = jobs[k].rfd;
+            pfds[n].events = POLLIN;
+            pfds[n].revents = 0;
+            ++n;
+        }
+        timeout_ms = -1;
+        if (prog_fp) {
+            now = sg_pt_lat_now_ns();
+            timeout_ms = ((last_ns + (uint64_t)prog_sec * 1000000000) > now) ?
+                ((last_ns + (uint64_t)prog_sec * 1000000000) - now) /
+                1000000 + 1 : 0;
+        }
+        if ((poll(pfds, n, timeout_ms) < 0) && (EINTR != errno)) {
+            perror(ME "poll");
+            res = SG_LIB_CAT_OTHER;
+            break;
+        }
+        for (k = 0, n = 0; k < num_jobs; ++k) {
+            jp = jobs + k;
+            if (JOB_RUNNING != jp->state)
+                continue;
+            if (pfds[n++].revents & (POLLIN | POLLHUP | POLLERR)) {
+                job_read_report(jp, vb);
+                if (JOB_DONE == jp->state)
+                    --running;
+            }
+        }
+        if (prog_fp && ((sg_pt_lat_now_ns() - last_ns) >=
+                        (uint64_t)prog_sec * 1000000000))
+            job_progress_out(prog_fp, false, start_ns, &last_ns,
+                             &last_bytes);
+    }
+    if (prog_fp) {
+        job_progress_out(prog_fp, true, start_ns, &last_ns, &last_bytes);
+        if (stderr != prog_fp)
+            fclose(prog_fp);
+    }
+    /* when a job could not be started (res set) no more were, those
+     * running were waited for */
+    for (k = 0, n = 0, running = 0, blocks = 0; k < num_jobs; ++k) {
+        jp = jobs + k;
+        blocks += jp->blocks;
+        if (JOB_DONE != jp->state)
+            ++running;          /* now counts those not started */
+        else if (jp->res && (0 == n++))
+            res = jp->res;
+    }
+    pr2serr(ME "%d jobs, %d failed, %d not started, %" PRId64 " blocks\n",
+            num_jobs, n, running, blocks);
+    return res;
+}
 
 int
 main(int argc, char * argv[])
+{
+    int k;
+
+    for (k = 1; k < argc; ++k) {
+        if (0 == strncmp(argv[k], "job=", 4))
+            return run_jobs(argc, argv);
+    }
+    return do_xcopy(argc, argv);
+}
+
+/* One copy, from the command line or a line of job=JFILE */
+static int
+do_xcopy(int argc, char * argv[])
 {
     bool bpt_given = false;
     bool list_id_given = false;
@@ -1315,25 +2438,37 @@ main(int argc, char * argv[])
     int res, k, n, keylen, infd, outfd, xcopy_fd;
     int blocks = 0;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
-    int dst_desc_len;
+    int conc = 0;
+    int dst_desc_len = 0;
+    int inflight = 0;
+    int waiting = 0;
+    int oldest;
     int ibs = 0;
     int num_help = 0;
     int num_xcopy = 0;
     int obs = 0;
     int ret = 0;
-    int seg_desc_type;
-    int src_desc_len;
+    int seg_desc_type = 0;
+    int segs = 0;
+    int src_desc_len = 0;
     int64_t skip = 0;
+    int64_t total;
+    uint64_t seq = 0;
+    uint64_t due_ns;
     int64_t seek = 0;
     uint8_t list_id = 1;
     char * key;
     char * buf;
+    char * cp;
     char str[STR_SZ];
+    char prog_f[INOUTF_SZ];
     uint8_t src_desc[256];
     uint8_t dst_desc[256];
+    const struct xcopy_fp_t * xfp;
 
     ixcf.fname[0] = '\0';
     oxcf.fname[0] = '\0';
+    prog_f[0] = '\0';
     ixcf.num_sect = -1;
     oxcf.num_sect = -1;
 
@@ -1370,6 +2505,13 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'bs='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "conc")) {
+            conc = sg_get_num(buf);
+            if ((conc < 1) || (conc > MAX_XCOPY_CONC)) {
+                pr2serr(ME "bad argument to 'conc=', expect 1 to %d\n",
+                        MAX_XCOPY_CONC);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "list_id")) {
             ret = sg_get_num(buf);
             if (-1 == ret || ret > 0xff) {
@@ -1452,12 +2594,33 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'oflag='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "progress")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            progress_sec = sg_get_num(buf);
+            if (progress_sec < 1) {
+                pr2serr(ME "bad argument to 'progress=', expect SEC[,FILE] "
+                        "with SEC > 0\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (cp && *cp) {
+                memcpy(prog_f, cp, INOUTF_SZ - 1);
+                prog_f[INOUTF_SZ - 1] = '\0';
+            }
         } else if (0 == strcmp(key, "seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
                 pr2serr(ME "bad argument to 'seek='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "segs")) {
+            segs = sg_get_num(buf);
+            if ((segs < 1) || (segs > MAX_XCOPY_SEGS)) {
+                pr2serr(ME "bad argument to 'segs=', expect 1 to %d\n",
+                        MAX_XCOPY_SEGS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "skip")) {
             skip = sg_get_llnum(buf);
             if (-1LL == skip) {
@@ -1466,6 +2629,21 @@ main(int argc, char * argv[])
             }
         } else if (0 == strcmp(key, "time"))
             do_time = !! sg_get_num(buf);
+        else if (0 == strcmp(key, "immed")) {
+            n = sg_get_num(buf);
+            if (n < 0 || n > 1) {
+                pr2serr(ME "bad argument to 'immed='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            tok_immed = !! n;
+        } else if (0 == strcmp(key, "token")) {
+            n = sg_get_num(buf);
+            if (n < 0 || n > 1) {
+                pr2serr(ME "bad argument to 'token='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            do_token = !! n;
+        }
         else if (0 == strncmp(key, "verb", 4))
             verbose = sg_get_num(buf);
         /* look for long options that start with '--' */
@@ -1577,7 +2755,7 @@ main(int argc, char * argv[])
         else
             on_src = false;
     }
-    if (verbose > 1)
+    if ((verbose > 1) && (! do_token))
         pr2serr(" >>> Extended Copy(LID1) command will be sent to %s device "
                 "[%s]\n", (on_src ? "src" : "dst"),
                 (on_src ? ixcf.fname : oxcf.fname));
@@ -1754,6 +2932,60 @@ main(int argc, char * argv[])
         }
     }
 
+    if (tok_immed && (! do_token)) {
+        pr2serr("immed=1 needs token=1, EXTENDED COPY(LID1) has no IMMED "
+                "bit\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (do_token) {
+        int max_rd = 0;
+        uint64_t mtts = 0;
+        uint64_t otc = 0;
+        uint64_t want;
+
+        if (outfd < 0) {
+            pr2serr("token=1 needs a SCSI device as OFILE\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (3 == list_id_usage) {
+            pr2serr("token=1 needs list_id, so id_usage=disable is not "
+                    "permitted\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (dd_count < 0) {
+            pr2serr("Couldn't calculate count, please give one\n");
+            return SG_LIB_CAT_OTHER;
+        }
+        /* IFILE's copy manager creates the tokens so has the limits */
+        if (tok_limits(infd, &max_rd, &mtts, &otc) && verbose)
+            pr2serr("  >> no Block Device ROD Token Limits from %s\n",
+                    ixcf.fname);
+        n = ((max_rd < 1) || (max_rd > MAX_XCOPY_SEGS)) ? MAX_XCOPY_SEGS :
+                                                          max_rd;
+        want = (otc > 0) ? otc : DEF_TOKEN_BLOCKS;
+        if ((mtts > 0) && (want > mtts))
+            want = mtts;
+        if (! bpt_given)
+            bpt = (want > MAX_BLOCKS_PER_TRANSFER) ?
+                  MAX_BLOCKS_PER_TRANSFER : (int)want;
+        if (segs > n) {
+            pr2serr("segs=%d too large (max %d range descriptors per "
+                    "token)\n", segs, n);
+            return SG_LIB_SYNTAX_ERROR;
+        } else if (0 == segs) {
+            k = (int)(want / (uint64_t)bpt);
+            segs = (k < 1) ? 1 : ((k > n) ? n : k);
+        }
+        if ((mtts > 0) && ((uint64_t)bpt * segs > mtts)) {
+            pr2serr("bpt=%d with segs=%d too large (max %" PRIu64 " blocks "
+                    "per token)\n", bpt, segs, mtts);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (0 == conc)
+            conc = DEF_TOKEN_CONC;
+        goto start_copy;
+    }
+
     res = scsi_operating_parameter(&ixcf, 0);
     if (res < 0) {
         if (SG_LIB_CAT_UNIT_ATTENTION == -res) {
@@ -1854,33 +3086,63 @@ main(int argc, char * argv[])
         return SG_LIB_CAT_OTHER;
     }
 
+    /* the device receiving the EXTENDED COPY commands sets the limits */
+    xfp = on_src ? &ixcf : &oxcf;
+    /* segment descriptors count blocks of OFILE if DC is set, else IFILE */
+    k = xcopy_flag_dc ? oxcf.sect_sz : ixcf.sect_sz;
     if (bpt_given) {
-        if (xcopy_flag_dc) {
-            if ((uint32_t)(bpt * oxcf.sect_sz) > oxcf.max_bytes) {
-                pr2serr("bpt too large (max %" PRIu32 " blocks)\n",
-                        oxcf.max_bytes / (uint32_t)oxcf.sect_sz);
-                return SG_LIB_SYNTAX_ERROR;
-            }
-        } else {
-            if ((uint32_t)(bpt * ixcf.sect_sz) > ixcf.max_bytes) {
-                pr2serr("bpt too large (max %" PRIu32 " blocks)\n",
-                        ixcf.max_bytes / (uint32_t)ixcf.sect_sz);
-                return SG_LIB_SYNTAX_ERROR;
-            }
+        if ((uint32_t)(bpt * k) > xfp->max_bytes) {
+            pr2serr("bpt too large (max %" PRIu32 " blocks)\n",
+                    xfp->max_bytes / (uint32_t)k);
+            return SG_LIB_SYNTAX_ERROR;
         }
     } else {
-        uint32_t r;
-
-        if (xcopy_flag_dc)
-            r = oxcf.max_bytes / (uint32_t)oxcf.sect_sz;
-        else
-            r = ixcf.max_bytes / (uint32_t)ixcf.sect_sz;
-        bpt = (r > MAX_BLOCKS_PER_TRANSFER) ? MAX_BLOCKS_PER_TRANSFER : r;
+        uint32_t r, g;
+
+        /* the longest segment, a multiple of the granularity if possible */
+        r = xfp->max_bytes / (uint32_t)k;
+        if (r > MAX_BLOCKS_PER_TRANSFER)
+            r = MAX_BLOCKS_PER_TRANSFER;
+        g = xfp->min_bytes / (uint32_t)k;
+        if ((g > 1) && (r >= g))
+            r -= r % g;
+        if (0 == r) {
+            pr2serr("maximum segment length of %s (%" PRIu32 " bytes) is "
+                    "less than a block\n", xfp->fname, xfp->max_bytes);
+            return SG_LIB_CAT_OTHER;
+        }
+        bpt = (int)r;
     }
 
     seg_desc_type = seg_desc_from_dd_type(simplified_ft(&ixcf), 0,
                                           simplified_ft(&oxcf), 0);
 
+    n = xfp->max_segs;
+    if (xfp->max_desc_len > 0) {
+        k = ((int)xfp->max_desc_len - src_desc_len - dst_desc_len) /
+            SEG_DESC_B2B_LEN;
+        if ((0 == n) || (k < n))
+            n = k;
+    }
+    if (segs > 0) {
+        if ((n > 0) && (segs > n)) {
+            pr2serr("segs=%d too large (max %d segment descriptors per "
+                    "command)\n", segs, n);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    } else
+        segs = (n < 1) ? 1 : ((n > MAX_XCOPY_SEGS) ? MAX_XCOPY_SEGS : n);
+    n = xfp->max_conc;
+    if (conc > 0) {
+        if ((n > 0) && (conc > n)) {
+            pr2serr("conc=%d too large (max %d concurrent copies)\n", conc,
+                    n);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    } else
+        conc = (n < 1) ? 1 : ((n > MAX_XCOPY_CONC) ? MAX_XCOPY_CONC : n);
+
+start_copy:
     if (do_time) {
         start_tm.tv_sec = 0;
         start_tm.tv_usec = 0;
@@ -1889,36 +3151,168 @@ main(int argc, char * argv[])
     }
 
     if (verbose)
-        pr2serr("Start of loop, count=%" PRId64 ", bpt=%d, lba_in=%" PRId64
-                ", lba_out=%" PRId64 "\n", dd_count, bpt, skip, seek);
-
-    xcopy_fd = (on_src) ? infd : outfd;
-
-    while (dd_count > 0) {
-        if (dd_count > bpt)
-            blocks = bpt;
-        else
-            blocks = dd_count;
-        res = scsi_extended_copy(xcopy_fd, list_id, src_desc, src_desc_len,
-                                 dst_desc, dst_desc_len, seg_desc_type,
-                                 blocks, skip, seek);
-        if (res != 0)
+        pr2serr("Start of loop, count=%" PRId64 ", bpt=%d, segs=%d, conc=%d, "
+                "lba_in=%" PRId64 ", lba_out=%" PRId64 "\n", dd_count, bpt,
+                segs, conc, skip, seek);
+    total = dd_count;
+
+    /* latencies (e.g. for progress=) are of the commands doing the copy */
+    if (do_token)
+        xcopy_fd = outfd;
+    else
+        xcopy_fd = (on_src) ? infd : outfd;
+    if (progress_sec > 0) {
+        if ('\0' == prog_f[0])
+            progress_fp = stderr;
+        else if (NULL == (progress_fp = fopen(prog_f, "a"))) {
+            perror(ME "could not open progress file");
+            return SG_LIB_FILE_ERROR;
+        }
+        sg_pt_lat_enable(true);         /* for the latency percentiles */
+        progress_count = dd_count;
+        progress_start_ns = sg_pt_lat_now_ns();
+        progress_last_ns = progress_start_ns;
+    }
+    job_report(true);
+
+    res = 0;
+    for (k = 0; k < conc; ++k) {
+        struct xcopy_slot_t * sp = xcopy_slots + k;
+
+        /* with list IDs disabled the field must be zero */
+        sp->list_id = (3 == list_id_usage) ? 0 : (uint32_t)(list_id + k);
+        if (do_token) {
+            sp->ptvp = construct_scsi_pt_obj_with_fd(infd, verbose);
+            sp->optvp = construct_scsi_pt_obj_with_fd(outfd, verbose);
+        } else
+            sp->ptvp = construct_scsi_pt_obj_with_fd(xcopy_fd, verbose);
+        if ((NULL == sp->ptvp) || (do_token && (NULL == sp->optvp))) {
+            pr2serr(ME "out of memory\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    }
+    /* keep up to conc commands, each of up to segs segment descriptors,
+     * in flight and take their responses as they complete. A token copy
+     * keeps its slot through its three commands, each after the other */
+    while (((dd_count > 0) && (0 == res)) || (inflight > 0)) {
+        struct xcopy_slot_t * sp;
+
+        /* immed=1: poll those copies still in progress that are due */
+        for (k = 0, due_ns = 0; (k < conc) && (waiting > 0); ++k) {
+            sp = xcopy_slots + k;
+            if (! sp->waiting)
+                continue;
+            if (0 == due_ns)
+                due_ns = sg_pt_lat_now_ns();
+            if (sp->due_ns > due_ns)
+                continue;
+            sp->waiting = false;
+            --waiting;
+            ret = tok_submit(infd, outfd, sp, bpt, ++seq);
+            if (ret) {
+                --inflight;
+                if (0 == res)
+                    res = ret;
+            }
+        }
+        for (k = 0; (k < conc) && (dd_count > 0) && (0 == res); ++k) {
+            sp = xcopy_slots + k;
+            if (sp->busy || sp->waiting)
+                continue;
+            blocks = (dd_count > ((int64_t)bpt * segs)) ? (bpt * segs) :
+                                                          (int)dd_count;
+            if (do_token) {
+                sp->blocks = blocks;
+                sp->src_lba = skip;
+                sp->dst_lba = seek;
+                sp->state = TOK_POPULATE;
+                res = tok_submit(infd, outfd, sp, bpt, ++seq);
+            } else {
+                xcopy_build(sp, src_desc, src_desc_len, dst_desc,
+                            dst_desc_len, seg_desc_type, bpt, blocks, skip,
+                            seek);
+                res = xcopy_submit(xcopy_fd, sp, ++seq);
+            }
+            if (res)
+                break;
+            ++inflight;
+            skip += blocks;
+            seek += blocks;
+            dd_count -= blocks;
+        }
+        if (0 == inflight)
             break;
-        in_full += blocks;
-        skip += blocks;
-        seek += blocks;
-        dd_count -= blocks;
-        num_xcopy++;
+        /* take the responses that are ready, else wait on the oldest */
+        for (k = 0, n = 0, oldest = -1; k <= conc; ++k) {
+            if (k == conc) {
+                if (n > 0)
+                    break;
+                if (waiting > 0) {
+                    /* don't sleep past a poll that falls due: nap then
+                     * check again */
+                    sleep_ns(TOKEN_NAP_NS);
+                    break;
+                }
+                if (oldest < 0)
+                    break;
+                sp = xcopy_slots + oldest;
+                ret = do_token ? tok_reap(sp, false) : xcopy_reap(sp, false);
+            } else {
+                sp = xcopy_slots + k;
+                if (! sp->busy)
+                    continue;
+                ret = do_token ? tok_reap(sp, true) : xcopy_reap(sp, true);
+                if (-EAGAIN == ret) {
+                    if ((oldest < 0) || (sp->seq < xcopy_slots[oldest].seq))
+                        oldest = k;
+                    continue;
+                }
+            }
+            ++n;
+            if (-EINPROGRESS == ret) {
+                sp->waiting = true;     /* still one of those in flight */
+                ++waiting;
+                continue;
+            }
+            if ((0 == ret) && do_token &&
+                (sp->state < (tok_immed ? TOK_WR_RRTI : TOK_WRITE))) {
+                /* on to this token copy's next command, keeps the slot */
+                ++sp->state;
+                ret = tok_submit(infd, outfd, sp, bpt, ++seq);
+                if (0 == ret)
+                    continue;
+            }
+            --inflight;
+            if (ret) {
+                if (0 == res)
+                    res = ret;  /* submit no more, drain those in flight */
+                continue;
+            }
+            in_full += sp->blocks;
+            num_xcopy++;
+            progress_out(false, xcopy_fd, 0);
+            job_report(false);
+        }
+    }
+    for (k = 0; k < conc; ++k) {
+        destruct_scsi_pt_obj(xcopy_slots[k].ptvp);
+        if (xcopy_slots[k].optvp)
+            destruct_scsi_pt_obj(xcopy_slots[k].optvp);
     }
+    progress_out(true, xcopy_fd, res);
+    if (progress_fp && (stderr != progress_fp))
+        fclose(progress_fp);
 
     if (do_time)
         calc_duration_throughput(0);
     if (res)
         pr2serr("sg_xcopy: failed with error %d (%" PRId64 " blocks left)\n",
-                res, dd_count);
+                res, total - in_full);
     else
-        pr2serr("sg_xcopy: %" PRId64 " blocks, %d command%s\n", in_full,
-                num_xcopy, ((num_xcopy > 1) ? "s" : ""));
+        pr2serr("sg_xcopy: %" PRId64 " blocks, %d %s%s\n", in_full,
+                num_xcopy, (do_token ? "token" : "command"),
+                ((num_xcopy > 1) ? "s" : ""));
     ret = res;
 
 fini:
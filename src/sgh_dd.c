@@ -1,7 +1,7 @@
 /* A utility program for copying files. Specialised for "files" that
  * represent devices that understand the SCSI command set.
  *
- * Copyright (C) 2018-2019 D. Gilbert
+ * Copyright (C) 2018-2026 D. Gilbert
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2, or (at your option)
@@ -22,17 +22,17 @@
  * in this case) are transferred to or from the sg device in a single SCSI
  * command.
  *
- * This version is designed for the linux kernel 2.4, 2.6, 3 and 4 series.
- *
  * sgp_dd is a Posix threads specialization of the sg_dd utility. Both
  * sgp_dd and sg_dd only perform special tasks when one or both of the given
  * devices belong to the Linux sg driver.
  *
- * sgh_dd further extends sgp_dd to use the experimental kernel buffer
- * sharing feature added in 3.9.02 .
+ * sgh_dd further extends sgp_dd to use the sg v4 interface and the kernel
+ * buffer sharing of the sg driver version 4, where a WRITE on OFILE uses
+ * the data its READ on IFILE left in a kernel buffer. With an older sg
+ * driver it falls back to the v3 interface copying via user space.
  * N.B. This utility was previously called sgs_dd but there was already an
  * archived version of a dd variant called sgs_dd so this utility name was
- * renamed [20181221]
+ * renamed [20181221]. It was in the testing directory until 20261014.
  */
 
 #define _XOPEN_SOURCE 600
@@ -71,34 +71,17 @@
 #include "config.h"
 #endif
 
-#ifndef HAVE_LINUX_SG_V4_HDR
-/* Kernel uapi header contain __user decorations on user space pointers
- * to indicate they are unsafe in the kernel space. However glibc takes
- * all those __user decorations out from headers in /usr/include/linux .
- * So to stop compile errors when directly importing include/uapi/scsi/sg.h
- * undef __user before doing that include. */
-#define __user
-
-/* Want to block the original sg.h header from also being included. That
- * causes lots of multiple definition errors. This will only work if this
- * header is included _before_ the original sg.h header.  */
-#define _SCSI_GENERIC_H         /* original kernel header guard */
-#define _SCSI_SG_H              /* glibc header guard */
-
-#include "uapi_sg.h"    /* local copy of include/uapi/scsi/sg.h */
-
-#else
-#define __user
-#endif  /* end of: ifndef HAVE_LINUX_SG_V4_HDR */
+#include <linux/bsg.h>          /* for struct sg_io_v4 */
 
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
+#include "sg_cmds_extra.h"
 #include "sg_io_linux.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.20 20190212";
+static const char * version_str = "1.22 20261014";
 
 #ifdef __GNUC__
 #ifndef  __clang__
@@ -106,8 +89,72 @@ static const char * version_str = "1.20 20190212";
 #endif
 #endif
 
-/* <<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>   xxxxxxxxxx   beware next line */
-#define SGH_DD_READ_COMPLET_AFTER 1
+/* The sg v4 driver additions, the <scsi/sg.h> header found at build time
+ * may only describe the v3 driver */
+#ifndef SG_SET_GET_EXTENDED
+
+/* If both sei_wr_mask and sei_rd_mask are 0, this ioctl does nothing */
+struct sg_extended_info {
+    uint32_t   sei_wr_mask;    /* OR-ed SG_SEIM_* user->driver values */
+    uint32_t   sei_rd_mask;    /* OR-ed SG_SEIM_* driver->user values */
+    uint32_t   ctl_flags_wr_mask;      /* OR-ed SG_CTL_FLAGM_* values */
+    uint32_t   ctl_flags_rd_mask;      /* OR-ed SG_CTL_FLAGM_* values */
+    uint32_t   ctl_flags;      /* bit values OR-ed, see SG_CTL_FLAGM_* */
+    uint32_t   read_value;     /* write SG_SEIRV_*, read back related */
+
+    uint32_t   reserved_sz;    /* data/sgl size of pre-allocated request */
+    uint32_t   tot_fd_thresh;  /* total data/sgat for this fd, 0: no limit */
+    uint32_t   minor_index;    /* rd: kernel's sg device minor number */
+    uint32_t   share_fd;       /* SHARE_FD and CHG_SHARE_FD use this */
+    uint32_t   sgat_elem_sz;   /* sgat element size (must be power of 2) */
+    uint8_t    pad_to_96[52];  /* pad so struct is 96 bytes long */
+};
+
+#define SG_SET_GET_EXTENDED _IOWR(0x22, 0x51, struct sg_extended_info)
+
+#endif
+
+#ifndef SG_FLAG_MMAP_IO
+#define SG_FLAG_MMAP_IO 4
+#endif
+#ifndef SG_SEIM_CTL_FLAGS
+#define SG_SEIM_CTL_FLAGS       0x1
+#endif
+#ifndef SG_SEIM_SHARE_FD
+#define SG_SEIM_SHARE_FD        0x20
+#endif
+#ifndef SG_SEIM_CHG_SHARE_FD
+#define SG_SEIM_CHG_SHARE_FD    0x40
+#endif
+#ifndef SG_SEIM_SGAT_ELEM_SZ
+#define SG_SEIM_SGAT_ELEM_SZ    0x80
+#endif
+#ifndef SG_CTL_FLAGM_MASTER_FINI
+#define SG_CTL_FLAGM_MASTER_FINI 0x100
+#endif
+#ifndef SGV4_FLAG_SHARE
+#define SGV4_FLAG_SHARE 0x2000
+#endif
+#ifndef SGV4_FLAG_NO_DXFER
+#define SGV4_FLAG_NO_DXFER SG_FLAG_NO_DXFER
+#endif
+#ifndef SG_INFO_DEVICE_DETACHING
+#define SG_INFO_DEVICE_DETACHING 0x8
+#endif
+#ifndef SG_INFO_ABORTED
+#define SG_INFO_ABORTED 0x10
+#endif
+#ifndef SG_IOSUBMIT
+#define SG_IOSUBMIT _IOWR(0x22, 0x41, struct sg_io_v4)
+#endif
+#ifndef SG_IORECEIVE
+#define SG_IORECEIVE _IOWR(0x22, 0x42, struct sg_io_v4)
+#endif
+#ifndef SG_IOABORT
+#define SG_IOABORT _IOW(0x22, 0x43, struct sg_io_v4)
+#endif
+
+#define SG_V4_DRIVER_NUM 40000  /* SG_GET_VERSION_NUM of sg driver 4.0.00 */
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -125,21 +172,16 @@ static const char * version_str = "1.20 20190212";
 #define SGP_READ10 0x28
 #define SGP_WRITE10 0x2a
 #define DEF_NUM_THREADS 4
+#define DEF_RETRIES 3           /* of UNIT ATTENTION and ABORTED COMMAND */
 #define MAX_NUM_THREADS SG_MAX_QUEUE
 
-#ifndef RAW_MAJOR
-#define RAW_MAJOR 255   /*unlikely value */
-#endif
-
-#define FT_OTHER 1              /* filetype other than one of the following */
-#define FT_SG 2                 /* filetype is sg char device */
-#define FT_RAW 4                /* filetype is raw char device */
-#define FT_DEV_NULL 8           /* either "/dev/null" or "." as filename */
-#define FT_ST 16                /* filetype is st char device (tape) */
-#define FT_BLOCK 32             /* filetype is a block device */
-#define FT_ERROR 64             /* couldn't "stat" file */
-
-#define DEV_NULL_MINOR_NUM 3
+#define FT_OTHER SG_IO_FT_OTHER
+#define FT_SG SG_IO_FT_SG
+#define FT_RAW SG_IO_FT_RAW
+#define FT_DEV_NULL SG_IO_FT_DEV_NULL
+#define FT_ST SG_IO_FT_ST
+#define FT_BLOCK SG_IO_FT_BLOCK
+#define FT_ERROR SG_IO_FT_ERROR
 
 #define EBUFF_SZ 768
 
@@ -201,11 +243,15 @@ typedef struct global_collection
     int sum_of_resids;          /* -/ */
     int debug;          /* both -v and deb=VERB bump this field */
     int dry_run;
+    int retries;        /* each READ and WRITE, from retries=RETR */
+    bool v3_drv;        /* an sg file is on a driver prior to 4.0 */
     bool ofile_given;
     bool ofile2_given;
     const char * infp;
     const char * outfp;
     const char * out2fp;
+    struct sg_dev_sess in_ds;   /* READ CAPACITY of IFILE when sg device */
+    struct sg_dev_sess out_ds;  /* and of OFILE */
 } Gbl_coll;
 
 typedef struct request_element
@@ -251,12 +297,13 @@ typedef struct thread_info
 
 static atomic_int mono_pack_id = 0;
 static atomic_long pos_index = 0;
+static atomic_int num_retries = 0;
+static atomic_int recovered_errs = 0;
+static atomic_int unrecovered_errs = 0;
 
 static sigset_t signal_set;
 static pthread_t sig_listen_thread_id;
 
-static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
-
 static void sg_in_rd_cmd(Gbl_coll * clp, Rq_elem * rep);
 static void sg_out_wr_cmd(Gbl_coll * clp, Rq_elem * rep, bool is_wr2);
 static bool normal_in_rd(Gbl_coll * clp, Rq_elem * rep, int blocks);
@@ -361,43 +408,22 @@ lk_chk_n_print4(const char * leadin, struct sg_io_v4 * h4p, bool raw_sinfo)
 static void
 calc_duration_throughput(int contin)
 {
-    struct timeval end_tm, res_tm;
-    double a, b;
-
-    gettimeofday(&end_tm, NULL);
-    res_tm.tv_sec = end_tm.tv_sec - start_tm.tv_sec;
-    res_tm.tv_usec = end_tm.tv_usec - start_tm.tv_usec;
-    if (res_tm.tv_usec < 0) {
-        --res_tm.tv_sec;
-        res_tm.tv_usec += 1000000;
-    }
-    a = res_tm.tv_sec;
-    a += (0.000001 * res_tm.tv_usec);
-    b = (double)gcoll.bs * (dd_count - gcoll.out_rem_count);
-    pr2serr("time to transfer data %s %d.%06d secs",
-            (contin ? "so far" : "was"), (int)res_tm.tv_sec,
-            (int)res_tm.tv_usec);
-    if ((a > 0.00001) && (b > 511))
-        pr2serr(", %.2f MB/sec\n", b / (a * 1000000.0));
-    else
-        pr2serr("\n");
+    sg_io_print_throughput(&start_tm, dd_count - gcoll.out_rem_count,
+                           gcoll.bs, !! contin);
 }
 
 static void
 print_stats(const char * str)
 {
-    int64_t infull, outfull;
-
-    if (0 != gcoll.out_rem_count)
-        pr2serr("  remaining block count=%" PRId64 "\n",
-                gcoll.out_rem_count);
-    infull = dd_count - gcoll.in_rem_count;
-    pr2serr("%s%" PRId64 "+%d records in\n", str,
-            infull - gcoll.in_partial, gcoll.in_partial);
-
-    outfull = dd_count - gcoll.out_rem_count;
-    pr2serr("%s%" PRId64 "+%d records out\n", str,
-            outfull - gcoll.out_partial, gcoll.out_partial);
+    sg_io_print_records(str, gcoll.out_rem_count,
+                        dd_count - gcoll.in_rem_count, gcoll.in_partial,
+                        dd_count - gcoll.out_rem_count, gcoll.out_partial);
+    if (recovered_errs > 0)
+        pr2serr("%s%d recovered errors\n", str, (int)recovered_errs);
+    if (num_retries > 0)
+        pr2serr("%s%d retries attempted\n", str, (int)num_retries);
+    if (gcoll.in_flags.coe || gcoll.out_flags.coe || (unrecovered_errs > 0))
+        pr2serr("%s%d unrecovered errors\n", str, (int)unrecovered_errs);
 }
 
 static void
@@ -470,10 +496,8 @@ tsafe_strerror(int code, char * ebp)
 
     pthread_mutex_lock(&strerr_mut);
     cp = safe_strerror(code);
-    strncpy(ebp, cp, STRERR_BUFF_LEN);
+    snprintf(ebp, STRERR_BUFF_LEN, "%s", cp);
     pthread_mutex_unlock(&strerr_mut);
-
-    ebp[STRERR_BUFF_LEN - 1] = '\0';
     return ebp;
 }
 
@@ -489,31 +513,6 @@ tsafe_strerror(int code, char * ebp)
     } while (0)
 
 
-static int
-dd_filetype(const char * filename)
-{
-    struct stat st;
-    size_t len = strlen(filename);
-
-    if ((1 == len) && ('.' == filename[0]))
-        return FT_DEV_NULL;
-    if (stat(filename, &st) < 0)
-        return FT_ERROR;
-    if (S_ISCHR(st.st_mode)) {
-        if ((MEM_MAJOR == major(st.st_rdev)) &&
-            (DEV_NULL_MINOR_NUM == minor(st.st_rdev)))
-            return FT_DEV_NULL;
-        if (RAW_MAJOR == major(st.st_rdev))
-            return FT_RAW;
-        if (SCSI_GENERIC_MAJOR == major(st.st_rdev))
-            return FT_SG;
-        if (SCSI_TAPE_MAJOR == major(st.st_rdev))
-            return FT_ST;
-    } else if (S_ISBLK(st.st_mode))
-        return FT_BLOCK;
-    return FT_OTHER;
-}
-
 static void
 usage(int pg_num)
 {
@@ -531,8 +530,9 @@ usage(int pg_num)
             "[deb=VERB]\n"
             "               [dio=0|1] [elemsz_kb=ESK] [fua=0|1|2|3] "
             "[of2=OFILE2]\n"
-            "               [ofreg=OFREG] [sync=0|1] [thr=THR] [time=0|1] "
-            "[verbose=VERB]\n"
+            "               [ofreg=OFREG] [retries=RETR] [sync=0|1] "
+            "[thr=THR] [time=0|1]\n"
+            "               [verbose=VERB]\n"
             "               [--dry-run] [--verbose]\n\n"
             "  where the main options (shown in first group above) are:\n"
             "    bs          must be device logical block size (default "
@@ -561,16 +561,13 @@ usage(int pg_num)
             "specialized for\nSCSI devices and uses multiple POSIX threads. "
             "It expects one or both IFILE\nand OFILE to be sg devices. It "
             "is Linux specific and uses the v4 sg driver\n'share' capability "
-            "if available. Use '-hh' or '-hhh' for more information.\n"
-#ifdef SGH_DD_READ_COMPLET_AFTER
-	    "\nIn this version oflag=swait does read completion _after_ "
-	    "write completion\n"
-#endif
+            "if available, otherwise the v3 interface without\nsharing. "
+            "Use '-hh' or '-hhh' for more information.\n"
            );
     return;
 page2:
     pr2serr("Syntax:  sgh_dd [operands] [options]\n\n"
-            "  where: operands have the form name=value and are pecular to "
+            "  where: operands have the form name=value and are peculiar to "
             "'dd'\n         style commands, and options start with one or "
             "two hyphens\n\n"
             "  where the less used options (not shown on first help page) "
@@ -592,6 +589,9 @@ page2:
             "    ofreg       OFREG is regular file or pipe to send what is "
             "read from\n"
             "                IFILE in the first half of each shared element\n"
+            "    retries     retries of each READ and WRITE after a unit "
+            "attention or\n"
+            "                aborted command (def: 3)\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
             "after copy\n"
             "    thr         is number of threads, must be > 0, default 4, "
@@ -609,7 +609,7 @@ page3:
             "  where: iflag=' and 'oflag=' arguments are listed below:\n"
             "    append      append output to OFILE (assumes OFILE is "
             "regular file)\n"
-            "    coe         continue of error (reading, fills with zeros)\n"
+            "    coe         continue on error (reading, fills with zeros)\n"
             "    defres      keep default reserve buffer size (else its "
             "bs*bpt)\n"
             "    dio         sets the SG_FLAG_DIRECT_IO in sg requests\n"
@@ -628,7 +628,7 @@ page3:
             "    same_fds    each thread use the same IFILE and OFILE(2) "
             "file\n"
             "                descriptors (def: each threads has own file "
-            "desciptors)\n"
+            "descriptors)\n"
             "    swait       slave wait: issue WRITE on OFILE before READ "
             "is finished;\n"
             "                [oflag only] and IFILE and OFILE must be sg "
@@ -670,71 +670,6 @@ guarded_stop_both(Gbl_coll * clp)
     guarded_stop_out(clp);
 }
 
-/* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
-static int
-scsi_read_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
-{
-    int res;
-    uint8_t rcBuff[RCAP16_REPLY_LEN];
-
-    res = sg_ll_readcap_10(sg_fd, 0, 0, rcBuff, READ_CAP_REPLY_LEN, false, 0);
-    if (0 != res)
-        return res;
-
-    if ((0xff == rcBuff[0]) && (0xff == rcBuff[1]) && (0xff == rcBuff[2]) &&
-        (0xff == rcBuff[3])) {
-
-        res = sg_ll_readcap_16(sg_fd, 0, 0, rcBuff, RCAP16_REPLY_LEN, false,
-                               0);
-        if (0 != res)
-            return res;
-        *num_sect = sg_get_unaligned_be64(rcBuff + 0) + 1;
-        *sect_sz = sg_get_unaligned_be32(rcBuff + 8);
-    } else {
-        /* take care not to sign extend values > 0x7fffffff */
-        *num_sect = (int64_t)sg_get_unaligned_be32(rcBuff + 0) + 1;
-        *sect_sz = sg_get_unaligned_be32(rcBuff + 4);
-    }
-    return 0;
-}
-
-/* Return of 0 -> success, -1 -> failure. BLKGETSIZE64, BLKGETSIZE and */
-/* BLKSSZGET macros problematic (from <linux/fs.h> or <sys/mount.h>). */
-static int
-read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
-{
-#ifdef BLKSSZGET
-    if ((ioctl(sg_fd, BLKSSZGET, sect_sz) < 0) && (*sect_sz > 0)) {
-        perror("BLKSSZGET ioctl error");
-        return -1;
-    } else {
- #ifdef BLKGETSIZE64
-        uint64_t ull;
-
-        if (ioctl(sg_fd, BLKGETSIZE64, &ull) < 0) {
-
-            perror("BLKGETSIZE64 ioctl error");
-            return -1;
-        }
-        *num_sect = ((int64_t)ull / (int64_t)*sect_sz);
- #else
-        unsigned long ul;
-
-        if (ioctl(sg_fd, BLKGETSIZE, &ul) < 0) {
-            perror("BLKGETSIZE ioctl error");
-            return -1;
-        }
-        *num_sect = (int64_t)ul;
- #endif
-    }
-    return 0;
-#else
-    *num_sect = 0;
-    *sect_sz = 0;
-    return -1;
-#endif
-}
-
 static void *
 sig_listen_thread(void * v_clp)
 {
@@ -766,9 +701,10 @@ sg_share_prepare(int slave_wr_fd, int master_rd_fd, int id, bool vb_b)
     seip->sei_rd_mask |= SG_SEIM_SHARE_FD;
     seip->share_fd = master_rd_fd;
     if (ioctl(slave_wr_fd, SG_SET_GET_EXTENDED, seip) < 0) {
-        pr2serr_lk("tid=%d: ioctl(EXTENDED(shared_fd=%d), failed "
-                   "errno=%d %s\n", id, master_rd_fd, errno,
-                   strerror(errno));
+        if (vb_b)
+            pr2serr_lk("tid=%d: ioctl(EXTENDED(shared_fd=%d), failed "
+                       "errno=%d %s, copy via user space\n", id,
+                       master_rd_fd, errno, strerror(errno));
         return false;
     }
     if (vb_b)
@@ -915,10 +851,19 @@ read_write_thread(void * v_tip)
                        rep->id);
     } else if ((FT_SG == clp->in_type) && (FT_SG == clp->out_type))
         rep->has_share = sg_share_prepare(rep->outfd, rep->infd, rep->id,
-                                          rep->debug > 9);
+                                          vb > 1);
     if (vb > 9)
         pr2serr_lk("tid=%d, has_share=%s\n", rep->id,
                    (rep->has_share ? "true" : "false"));
+    if (rep->swait && (! rep->has_share)) {
+        /* without sharing the WRITE would go out before the READ's data */
+        rep->swait = false;
+        if (vb && (! swait_reported)) {
+            swait_reported = true;
+            pr2serr_lk("oflag=swait ignored since IFILE and OFILE are not "
+                       "sharing\n");
+        }
+    }
     share_and_ofreg = (rep->has_share && (rep->outregfd >= 0));
 
     /* vvvvvvvvvvvvvv  Main segment copy loop  vvvvvvvvvvvvvvvvvvvvvvv */
@@ -1068,7 +1013,7 @@ fini:
     if (rep->mmap_len > 0) {
         if (munmap(rep->buffp, rep->mmap_len) < 0) {
             int err = errno;
-            char bb[64];
+            char bb[STRERR_BUFF_LEN];
 
             pr2serr_lk("thread=%d: munmap() failed: %s\n", rep->id,
                        tsafe_strerror(err, bb));
@@ -1106,9 +1051,7 @@ normal_in_rd(Gbl_coll * clp, Rq_elem * rep, int blocks)
         }
     }
     /* enters holding in_mutex */
-    while (((res = read(clp->infd, rep->buffp, blocks * clp->bs)) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        sched_yield();  /* another thread may be able to progress */
+    res = sg_io_read_retry(clp->infd, rep->buffp, blocks * clp->bs);
     if (res < 0) {
         if (clp->in_flags.coe) {
             memset(rep->buffp, 0, rep->num_blks * rep->bs);
@@ -1152,9 +1095,8 @@ normal_out_wr(Gbl_coll * clp, Rq_elem * rep, int blocks)
     char strerr_buff[STRERR_BUFF_LEN];
 
     /* enters holding out_mutex */
-    while (((res = write(clp->outfd, rep->buffp, rep->num_blks * clp->bs))
-            < 0) && ((EINTR == errno) || (EAGAIN == errno)))
-        sched_yield();  /* another thread may be able to progress */
+    res = sg_io_write_retry(clp->outfd, rep->buffp,
+                            rep->num_blks * clp->bs);
     if (res < 0) {
         if (clp->out_flags.coe) {
             pr2serr_lk("tid=%d: >> ignored error for out blk=%" PRId64
@@ -1182,75 +1124,6 @@ normal_out_wr(Gbl_coll * clp, Rq_elem * rep, int blocks)
     clp->out_rem_count -= blocks;
 }
 
-static int
-sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
-                  int64_t start_block, bool write_true, bool fua, bool dpo)
-{
-    int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
-    int wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
-    int sz_ind;
-
-    memset(cdbp, 0, cdb_sz);
-    if (dpo)
-        cdbp[1] |= 0x10;
-    if (fua)
-        cdbp[1] |= 0x8;
-    switch (cdb_sz) {
-    case 6:
-        sz_ind = 0;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
-        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
-        if (blocks > 256) {
-            pr2serr_lk("%sfor 6 byte commands, maximum number of blocks is "
-                       "256\n", my_name);
-            return 1;
-        }
-        if ((start_block + blocks - 1) & (~0x1fffff)) {
-            pr2serr_lk("%sfor 6 byte commands, can't address blocks beyond "
-                       "%d\n", my_name, 0x1fffff);
-            return 1;
-        }
-        if (dpo || fua) {
-            pr2serr_lk("%sfor 6 byte commands, neither dpo nor fua bits "
-                       "supported\n", my_name);
-            return 1;
-        }
-        break;
-    case 10:
-        sz_ind = 1;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be16((uint16_t)blocks, cdbp + 7);
-        if (blocks & (~0xffff)) {
-            pr2serr_lk("%sfor 10 byte commands, maximum number of blocks is "
-                       "%d\n", my_name, 0xffff);
-            return 1;
-        }
-        break;
-    case 12:
-        sz_ind = 2;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 6);
-        break;
-    case 16:
-        sz_ind = 3;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be64((uint64_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 10);
-        break;
-    default:
-        pr2serr_lk("%sexpected cdb size of 6, 10, 12, or 16 but got %d\n",
-                   my_name, cdb_sz);
-        return 1;
-    }
-    return 0;
-}
 
 /* Enters this function holding in_mutex */
 static void
@@ -1258,6 +1131,7 @@ sg_in_rd_cmd(Gbl_coll * clp, Rq_elem * rep)
 {
     int res;
     int status;
+    int retries_tmp = clp->retries;
 
     while (1) {
         res = sg_start_io(rep, false);
@@ -1279,13 +1153,25 @@ sg_in_rd_cmd(Gbl_coll * clp, Rq_elem * rep)
         switch (res) {
         case SG_LIB_CAT_ABORTED_COMMAND:
         case SG_LIB_CAT_UNIT_ATTENTION:
-            /* try again with same addr, count info */
-            /* now re-acquire in mutex for balance */
-            /* N.B. This re-read could now be out of read sequence */
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            break;      /* will loop again */
+            if (retries_tmp > 0) {
+                /* try again with same addr, count info */
+                /* now re-acquire in mutex for balance */
+                /* N.B. This re-read could now be out of read sequence */
+                --retries_tmp;
+                ++num_retries;
+                status = pthread_mutex_lock(&clp->in_mutex);
+                if (0 != status) err_exit(status, "lock in_mutex");
+                break;      /* will loop again */
+            }
+            pr2serr_lk("tid=%d: error finishing sg in command, no retries "
+                       "left (%d)\n", rep->id, res);
+            ++unrecovered_errs;
+            if (exit_status <= 0)
+                exit_status = res;
+            guarded_stop_both(clp);
+            return;
         case SG_LIB_CAT_MEDIUM_HARD:
+            ++unrecovered_errs;
             if (0 == clp->in_flags.coe) {
                 pr2serr_lk("error finishing sg in command (medium)\n");
                 if (exit_status <= 0)
@@ -1318,6 +1204,7 @@ sg_in_rd_cmd(Gbl_coll * clp, Rq_elem * rep)
         default:
             pr2serr_lk("tid=%d: error finishing sg in command (%d)\n",
                        rep->id, res);
+            ++unrecovered_errs;
             if (exit_status <= 0)
                 exit_status = res;
             guarded_stop_both(clp);
@@ -1378,6 +1265,7 @@ sg_out_wr_cmd(Gbl_coll * clp, Rq_elem * rep, bool is_wr2)
 {
     int res;
     int status;
+    int retries_tmp = clp->retries;
     pthread_mutex_t * mutexp = is_wr2 ? &clp->out2_mutex : &clp->out_mutex;
 
     if (rep->has_share && is_wr2)
@@ -1403,13 +1291,25 @@ sg_out_wr_cmd(Gbl_coll * clp, Rq_elem * rep, bool is_wr2)
         switch (res) {
         case SG_LIB_CAT_ABORTED_COMMAND:
         case SG_LIB_CAT_UNIT_ATTENTION:
-            /* try again with same addr, count info */
-            /* now re-acquire out mutex for balance */
-            /* N.B. This re-write could now be out of write sequence */
-            status = pthread_mutex_lock(mutexp);
-            if (0 != status) err_exit(status, "lock out_mutex");
-            break;      /* loops around */
+            if (retries_tmp > 0) {
+                /* try again with same addr, count info */
+                /* now re-acquire out mutex for balance */
+                /* N.B. This re-write could now be out of write sequence */
+                --retries_tmp;
+                ++num_retries;
+                status = pthread_mutex_lock(mutexp);
+                if (0 != status) err_exit(status, "lock out_mutex");
+                break;      /* loops around */
+            }
+            pr2serr_lk("error finishing sg out command, no retries left "
+                       "(%d)\n", res);
+            ++unrecovered_errs;
+            if (exit_status <= 0)
+                exit_status = res;
+            guarded_stop_both(clp);
+            goto fini;
         case SG_LIB_CAT_MEDIUM_HARD:
+            ++unrecovered_errs;
             if (0 == clp->out_flags.coe) {
                 pr2serr_lk("error finishing sg out command (medium)\n");
                 if (exit_status <= 0)
@@ -1440,6 +1340,7 @@ sg_out_wr_cmd(Gbl_coll * clp, Rq_elem * rep, bool is_wr2)
             goto fini;
         default:
             pr2serr_lk("error finishing sg out command (%d)\n", res);
+            ++unrecovered_errs;
             if (exit_status <= 0)
                 exit_status = res;
             guarded_stop_both(clp);
@@ -1480,8 +1381,8 @@ sg_start_io(Rq_elem * rep, bool is_wr2)
         fd = rep->infd;
         crwp = "reading";
     }
-    if (sg_build_scsi_cdb(rep->cmd, cdbsz, rep->num_blks, blk, wr, fua,
-                          dpo)) {
+    if (sg_build_rw_cdb(rep->cmd, cdbsz, rep->num_blks, blk, wr, fua,
+                        dpo, my_name)) {
         pr2serr_lk("%sbad cdb build, start_blk=%" PRId64 ", blocks=%d\n",
                    my_name, blk, rep->num_blks);
         return -1;
@@ -1530,9 +1431,7 @@ sg_start_io(Rq_elem * rep, bool is_wr2)
     hp->pack_id = rep->rq_id;
     hp->flags = flags;
 
-    while (((res = write(fd, hp, sizeof(struct sg_io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        sched_yield();  /* another thread may be able to progress */
+    res = sg_io_write_retry(fd, hp, sizeof(struct sg_io_hdr));
     err = errno;
     if (res < 0) {
         if (ENOMEM == err)
@@ -1609,9 +1508,6 @@ sg_finish_io(bool wr, Rq_elem * rep, bool is_wr2)
     struct sg_io_hdr * hp;
     struct sg_io_v4 * h4p;
     const char *cp;
-#if 0
-    static int testing = 0;     /* thread dubious! */
-#endif
 
     if (wr) {
         fd = is_wr2 ? rep->out2fd : rep->outfd;
@@ -1628,9 +1524,7 @@ sg_finish_io(bool wr, Rq_elem * rep, bool is_wr2)
     io_hdr.dxfer_direction = wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
     io_hdr.pack_id = rep->rq_id;
 
-    while (((res = read(fd, &io_hdr, sizeof(struct sg_io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        sched_yield();  /* another thread may be able to progress */
+    res = sg_io_read_retry(fd, &io_hdr, sizeof(struct sg_io_hdr));
     if (res < 0) {
         perror("finishing io [read(2)] on sg device, error");
         return -1;
@@ -1645,6 +1539,7 @@ sg_finish_io(bool wr, Rq_elem * rep, bool is_wr2)
     case SG_LIB_CAT_CLEAN:
         break;
     case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
         lk_chk_n_print3(cp, hp, false);
         break;
     case SG_LIB_CAT_ABORTED_COMMAND:
@@ -1662,9 +1557,6 @@ sg_finish_io(bool wr, Rq_elem * rep, bool is_wr2)
             return res;
         }
     }
-#if 0
-    if (0 == (++testing % 100)) return -1;
-#endif
     if ((wr ? rep->out_flags.dio : rep->in_flags.dio) &&
         ((hp->info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
         rep->dio_incomplete_count = 1; /* count dios done as indirect IO */
@@ -1694,6 +1586,7 @@ do_v4:
     case SG_LIB_CAT_CLEAN:
         break;
     case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
         lk_chk_n_print4(cp, h4p, false);
         break;
     case SG_LIB_CAT_ABORTED_COMMAND:
@@ -1710,19 +1603,15 @@ do_v4:
                      rep->rq_id, blk);
             lk_chk_n_print4(ebuff, h4p, false);
             if ((rep->debug > 4) && h4p->info)
-                pr2serr_lk(" info=0x%x sg_info_check=%d another_waiting=%d "
-                           "direct=%d detaching=%d aborted=%d\n", h4p->info,
+                pr2serr_lk(" info=0x%x sg_info_check=%d direct=%d "
+                           "detaching=%d aborted=%d\n", h4p->info,
                            !!(h4p->info & SG_INFO_CHECK),
-                           !!(h4p->info & SG_INFO_ANOTHER_WAITING),
                            !!(h4p->info & SG_INFO_DIRECT_IO),
                            !!(h4p->info & SG_INFO_DEVICE_DETACHING),
                            !!(h4p->info & SG_INFO_ABORTED));
             return res;
         }
     }
-#if 0
-    if (0 == (++testing % 100)) return -1;
-#endif
     if ((wr ? rep->out_flags.dio : rep->in_flags.dio) &&
         (h4p->info & SG_INFO_DIRECT_IO))
         rep->dio_incomplete_count = 1; /* count dios done as indirect IO */
@@ -1733,10 +1622,9 @@ do_v4:
         pr2serr_lk("%s: tid,rq_id=%d,%d: completed %s\n", __func__, rep->id,
                    rep->rq_id, cp);
         if ((rep->debug > 4) && h4p->info)
-            pr2serr_lk(" info=0x%x sg_info_check=%d another_waiting=%d "
-                       "direct=%d detaching=%d aborted=%d\n", h4p->info,
+            pr2serr_lk(" info=0x%x sg_info_check=%d direct=%d "
+                       "detaching=%d aborted=%d\n", h4p->info,
                        !!(h4p->info & SG_INFO_CHECK),
-                       !!(h4p->info & SG_INFO_ANOTHER_WAITING),
                        !!(h4p->info & SG_INFO_DIRECT_IO),
                        !!(h4p->info & SG_INFO_DEVICE_DETACHING),
                        !!(h4p->info & SG_INFO_ABORTED));
@@ -1744,15 +1632,60 @@ do_v4:
     return 0;
 }
 
-/* Enter holding in_mutex, exits holding nothing */
+/* Checks the outcome of one half of an interleaved READ/WRITE pair. Returns
+ * 0 if it is good (or a medium error is being continued over), 1 if it
+ * should be retried (unit attention or aborted command) else -1 . */
+static int
+interleave_chk(Gbl_coll * clp, Rq_elem * rep, int res, bool is_wr)
+{
+    switch (res) {
+    case 0:
+        return 0;
+    case SG_LIB_CAT_ABORTED_COMMAND:
+    case SG_LIB_CAT_UNIT_ATTENTION:
+        return 1;
+    case SG_LIB_CAT_MEDIUM_HARD:
+        ++unrecovered_errs;
+        if (0 == (is_wr ? clp->out_flags.coe : clp->in_flags.coe)) {
+            pr2serr_lk("%s: tid=%d: finishing %s (medium)\n", __func__,
+                       rep->id, (is_wr ? "out" : "in"));
+            break;
+        }
+        if (is_wr)
+            pr2serr_lk(">> ignored error for out blk=%" PRId64 " for %d "
+                       "bytes\n", rep->oblk, rep->num_blks * rep->bs);
+        else {
+            memset(rep->buffp, 0, rep->num_blks * rep->bs);
+            pr2serr_lk("tid=%d: >> substituted zeros for in blk=%" PRId64
+                       " for %d bytes\n", rep->id, rep->iblk,
+                       rep->num_blks * rep->bs);
+        }
+        return 0;
+    default:
+        ++unrecovered_errs;
+        pr2serr_lk("%s: tid=%d: error finishing %s (%d)\n", __func__,
+                   rep->id, (is_wr ? "out" : "in"), res);
+        break;
+    }
+    if (exit_status <= 0)
+        exit_status = res;
+    return -1;
+}
+
+/* Enter holding in_mutex, exits holding nothing. The READ and the WRITE
+ * are both submitted before either is waited on; with the v4 driver's
+ * request sharing the WRITE takes its data from the READ's buffer. If
+ * either half needs a retry, the pair is re-issued. */
 static void
 sg_in_out_interleave(Gbl_coll *clp, Rq_elem * rep)
 {
-    int res, pid_read, pid_write;
+    int res, rd_res, rd_chk, wr_chk, pid_read, pid_write;
     int status;
+    int retries_tmp = clp->retries;
 
     while (1) {
         /* start READ */
+        rep->wr = false;
         res = sg_start_io(rep, false);
         pid_read = rep->rq_id;
         if (1 == res)
@@ -1777,6 +1710,10 @@ sg_in_out_interleave(Gbl_coll *clp, Rq_elem * rep)
                        rep->id, rep->oblk);
             status = pthread_mutex_unlock(&clp->in_mutex);
             if (0 != status) err_exit(status, "unlock in_mutex");
+            /* reap the READ already started */
+            rep->rq_id = pid_read;
+            rep->wr = false;
+            sg_finish_io(rep->wr, rep, false);
             guarded_stop_both(clp);
             return;
         }
@@ -1784,141 +1721,68 @@ sg_in_out_interleave(Gbl_coll *clp, Rq_elem * rep)
         status = pthread_mutex_unlock(&clp->in_mutex);
         if (0 != status) err_exit(status, "unlock in_mutex");
 
-#ifdef SGH_DD_READ_COMPLET_AFTER
-#warning "SGH_DD_READ_COMPLET_AFTER is set (testing)"
-	goto write_complet;
-read_complet:
-#endif
-
-        /* finish READ */
+        /* finish READ then WRITE, no lock held */
         rep->rq_id = pid_read;
         rep->wr = false;
-        res = sg_finish_io(rep->wr, rep, false);
-        switch (res) {
-        case SG_LIB_CAT_ABORTED_COMMAND:
-        case SG_LIB_CAT_UNIT_ATTENTION:
-            /* try again with same addr, count info */
-            /* now re-acquire in mutex for balance */
-            /* N.B. This re-read could now be out of read sequence */
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            break;      /* will loop again */
-        case SG_LIB_CAT_MEDIUM_HARD:
-            if (0 == clp->in_flags.coe) {
-                pr2serr_lk("%s: finishing in (medium)\n", __func__);
-                if (exit_status <= 0)
-                    exit_status = res;
-                guarded_stop_both(clp);
-                // return;
-                break;
-            } else {
-                memset(rep->buffp, 0, rep->num_blks * rep->bs);
-                pr2serr_lk("tid=%d: >> substituted zeros for in blk=%" PRId64
-                           " for %d bytes\n", rep->id, rep->iblk,
-                           rep->num_blks * rep->bs);
-            }
-#if defined(__GNUC__)
-#if (__GNUC__ >= 7)
-            __attribute__((fallthrough));
-            /* FALL THROUGH */
-#endif
-#endif
-        case 0:
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            if (rep->dio_incomplete_count || rep->resid) {
-                clp->dio_incomplete_count += rep->dio_incomplete_count;
-                clp->sum_of_resids += rep->resid;
-            }
-            clp->in_rem_count -= rep->num_blks;
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
-            // return;
-            break;
-        default:
-            pr2serr_lk("%s: tid=%d: error finishing in (%d)\n", __func__,
-                       rep->id, res);
-            if (exit_status <= 0)
-                exit_status = res;
-            guarded_stop_both(clp);
-            // return;
-            break;
-        }
-
-
-#ifdef SGH_DD_READ_COMPLET_AFTER
-	return;
-
-write_complet:
-#endif
-        /* finish WRITE, no lock held */
+        rd_res = sg_finish_io(rep->wr, rep, false);
+        rd_chk = interleave_chk(clp, rep, rd_res, false);
         rep->rq_id = pid_write;
         rep->wr = true;
         res = sg_finish_io(rep->wr, rep, false);
-        switch (res) {
-        case SG_LIB_CAT_ABORTED_COMMAND:
-        case SG_LIB_CAT_UNIT_ATTENTION:
-            /* try again with same addr, count info */
-            /* now re-acquire in mutex for balance */
-            /* N.B. This re-write could now be out of write sequence */
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            break;      /* loops around */
-        case SG_LIB_CAT_MEDIUM_HARD:
-            if (0 == clp->out_flags.coe) {
-                pr2serr_lk("error finishing sg out command (medium)\n");
-                if (exit_status <= 0)
-                    exit_status = res;
-                guarded_stop_both(clp);
-                return;
-            } else
-                pr2serr_lk(">> ignored error for out blk=%" PRId64 " for %d "
-                           "bytes\n", rep->oblk, rep->num_blks * rep->bs);
-#if defined(__GNUC__)
-#if (__GNUC__ >= 7)
-            __attribute__((fallthrough));
-            /* FALL THROUGH */
-#endif
-#endif
-        case 0:
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            if (rep->dio_incomplete_count || rep->resid) {
-                clp->dio_incomplete_count += rep->dio_incomplete_count;
-                clp->sum_of_resids += rep->resid;
-            }
-            clp->out_rem_count -= rep->num_blks;
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
+        wr_chk = interleave_chk(clp, rep, res, true);
 
-#ifdef SGH_DD_READ_COMPLET_AFTER
-	goto read_complet;
-#endif
+        if ((rd_chk < 0) || (wr_chk < 0)) {
+            guarded_stop_both(clp);
             return;
-        default:
-            pr2serr_lk("error finishing sg out command (%d)\n", res);
+        }
+        if ((rd_chk > 0) || (wr_chk > 0)) {
+            if (retries_tmp > 0) {
+                /* try again with same addr, count info */
+                /* N.B. This re-read could now be out of read sequence */
+                --retries_tmp;
+                ++num_retries;
+                status = pthread_mutex_lock(&clp->in_mutex);
+                if (0 != status) err_exit(status, "lock in_mutex");
+                continue;
+            }
+            pr2serr_lk("%s: tid=%d: no retries left (in=%d, out=%d)\n",
+                       __func__, rep->id, rd_res, res);
+            ++unrecovered_errs;
             if (exit_status <= 0)
-                exit_status = res;
+                exit_status = (rd_chk > 0) ? rd_res : res;
             guarded_stop_both(clp);
             return;
         }
+        status = pthread_mutex_lock(&clp->in_mutex);
+        if (0 != status) err_exit(status, "lock in_mutex");
+        if (rep->dio_incomplete_count || rep->resid) {
+            clp->dio_incomplete_count += rep->dio_incomplete_count;
+            clp->sum_of_resids += rep->resid;
+        }
+        clp->in_rem_count -= rep->num_blks;
+        clp->out_rem_count -= rep->num_blks;
+        status = pthread_mutex_unlock(&clp->in_mutex);
+        if (0 != status) err_exit(status, "unlock in_mutex");
+        return;
     }           /* end of while (1) loop */
 }
 
-/* Returns reserved_buffer_size/mmap_size if success, else 0 for failure */
+/* Returns reserved_buffer_size/mmap_size if success, else 0 for failure.
+ * The sg driver version number is written to *drv_verp . */
 static int
 sg_prepare_resbuf(int fd, int bs, int bpt, bool def_res, int elem_sz,
-                  uint8_t **mmpp)
+                  uint8_t **mmpp, int * drv_verp)
 {
     int res, t, num;
     uint8_t *mmp;
 
     res = ioctl(fd, SG_GET_VERSION_NUM, &t);
-    if ((res < 0) || (t < 40000)) {
-        pr2serr_lk("%ssg driver prior to 4.0.00\n", my_name);
+    if (res < 0) {
+        perror("sgh_dd: SG_GET_VERSION_NUM error");
         return 0;
     }
-    if (elem_sz >= 4096) {
+    *drv_verp = t;
+    if ((elem_sz >= 4096) && (t >= SG_V4_DRIVER_NUM)) {
         struct sg_extended_info sei;
         struct sg_extended_info * seip;
 
@@ -1939,7 +1803,13 @@ sg_prepare_resbuf(int fd, int bs, int bpt, bool def_res, int elem_sz,
                            "wr error: %s\n", __func__, strerror(errno));
         }
     }
-    if (! def_res) {
+    if (def_res) {
+        res = ioctl(fd, SG_GET_RESERVED_SIZE, &num);
+        if (res < 0) {
+            perror("sgh_dd: SG_GET_RESERVED_SIZE error");
+            return 0;
+        }
+    } else {
         num = bs * bpt;
         res = ioctl(fd, SG_SET_RESERVED_SIZE, &num);
         if (res < 0)
@@ -2036,31 +1906,39 @@ num_chs_in_str(const char * s, int slen, int ch)
     return res;
 }
 
+/* Returns the SG_IO_OPEN_* mask for sg_io_open_dd() from iflag= or
+ * oflag= . */
 static int
-sg_in_open(Gbl_coll *clp, const char *inf, uint8_t **mmpp, int * mmap_lenp)
+open_fl_mask(const struct flags_t * fp)
 {
-    int fd, err, n;
-    int flags = O_RDWR;
-    char ebuff[EBUFF_SZ];
+    int fl_mask = 0;
+
+    if (fp->direct)
+        fl_mask |= SG_IO_OPEN_DIRECT;
+    if (fp->excl)
+        fl_mask |= SG_IO_OPEN_EXCL;
+    if (fp->dsync)
+        fl_mask |= SG_IO_OPEN_DSYNC;
+    if (fp->append)
+        fl_mask |= SG_IO_OPEN_APPEND;
+    return fl_mask;
+}
 
-    if (clp->in_flags.direct)
-        flags |= O_DIRECT;
-    if (clp->in_flags.excl)
-        flags |= O_EXCL;
-    if (clp->in_flags.dsync)
-        flags |= O_SYNC;
+static int
+sg_in_open(Gbl_coll *clp, const char *inf, uint8_t **mmpp, int * mmap_lenp)
+{
+    int fd, n, drv_ver;
 
-    if ((fd = open(inf, flags)) < 0) {
-        err = errno;
-        snprintf(ebuff, EBUFF_SZ, "%s: could not open %s for sg reading",
-                 __func__, inf);
-        perror(ebuff);
-        return -sg_convert_errno(err);
-    }
+    fd = sg_io_open_dd(inf, FT_SG, false, open_fl_mask(&clp->in_flags), 0,
+                       clp->bs, my_name, 0);
+    if (fd < 0)
+        return -sg_convert_errno(-fd);
     n = sg_prepare_resbuf(fd, clp->bs, clp->bpt, clp->in_flags.defres,
-                         clp->elem_sz,  mmpp);
+                          clp->elem_sz, mmpp, &drv_ver);
     if (n <= 0)
         return -SG_LIB_FILE_ERROR;
+    if (drv_ver < SG_V4_DRIVER_NUM)
+        clp->v3_drv = true;
     if (mmap_lenp)
         *mmap_lenp = n;
     return fd;
@@ -2069,28 +1947,18 @@ sg_in_open(Gbl_coll *clp, const char *inf, uint8_t **mmpp, int * mmap_lenp)
 static int
 sg_out_open(Gbl_coll *clp, const char *outf, uint8_t **mmpp, int * mmap_lenp)
 {
-    int fd, err, n;
-    int flags = O_RDWR;
-    char ebuff[EBUFF_SZ];
-
-    if (clp->out_flags.direct)
-        flags |= O_DIRECT;
-    if (clp->out_flags.excl)
-        flags |= O_EXCL;
-    if (clp->out_flags.dsync)
-        flags |= O_SYNC;
+    int fd, n, drv_ver;
 
-    if ((fd = open(outf, flags)) < 0) {
-        err = errno;
-        snprintf(ebuff,  EBUFF_SZ, "%s: could not open %s for sg writing",
-                 __func__, outf);
-        perror(ebuff);
-        return -sg_convert_errno(err);
-    }
+    fd = sg_io_open_dd(outf, FT_SG, true, open_fl_mask(&clp->out_flags), 0,
+                       clp->bs, my_name, 0);
+    if (fd < 0)
+        return -sg_convert_errno(-fd);
     n = sg_prepare_resbuf(fd, clp->bs, clp->bpt, clp->out_flags.defres,
-                          clp->elem_sz, mmpp);
+                          clp->elem_sz, mmpp, &drv_ver);
     if (n <= 0)
         return -SG_LIB_FILE_ERROR;
+    if (drv_ver < SG_V4_DRIVER_NUM)
+        clp->v3_drv = true;
     if (mmap_lenp)
         *mmap_lenp = n;
     return fd;
@@ -2120,7 +1988,7 @@ main(int argc, char * argv[])
     int res, k, err, keylen;
     int64_t in_num_sect = 0;
     int64_t out_num_sect = 0;
-    int in_sect_sz, out_sect_sz, status, n, flags;
+    int in_sect_sz, out_sect_sz, status, n;
     void * vp;
     Gbl_coll * clp = &gcoll;
     Thread_info thread_arr[MAX_NUM_THREADS];
@@ -2138,6 +2006,7 @@ main(int argc, char * argv[])
     memset(clp, 0, sizeof(*clp));
     memset(thread_arr, 0, sizeof(thread_arr));
     clp->bpt = DEF_BLOCKS_PER_TRANSFER;
+    clp->retries = DEF_RETRIES;
     clp->in_type = FT_OTHER;
     /* change dd's default: if of=OFILE not given, assume /dev/null */
     clp->out_type = FT_DEV_NULL;
@@ -2243,13 +2112,13 @@ main(int argc, char * argv[])
                 pr2serr("Second OFILE2 argument??\n");
                 return SG_LIB_CONTRADICT;
             } else
-                strncpy(out2f, buf, INOUTF_SZ - 1);
+                snprintf(out2f, INOUTF_SZ, "%s", buf);
         } else if (strcmp(key, "ofreg") == 0) {
             if ('\0' != outregf[0]) {
                 pr2serr("Second OFREG argument??\n");
                 return SG_LIB_CONTRADICT;
             } else
-                strncpy(outregf, buf, INOUTF_SZ - 1);
+                snprintf(outregf, INOUTF_SZ, "%s", buf);
         } else if (strcmp(key, "of") == 0) {
             if ('\0' != outf[0]) {
                 pr2serr("Second 'of=' argument??\n");
@@ -2261,6 +2130,12 @@ main(int argc, char * argv[])
                 pr2serr("%sbad argument to 'oflag='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "retries")) {
+            clp->retries = sg_get_num(buf);
+            if (clp->retries < 0) {
+                pr2serr("%sbad argument to 'retries='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
@@ -2376,7 +2251,7 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
     if ((clp->in_flags.mmap || clp->out_flags.mmap) &&
-        (clp->in_flags.same_fds || clp->in_flags.same_fds)) {
+        (clp->in_flags.same_fds || clp->out_flags.same_fds)) {
         pr2serr("can't have both 'mmap' and 'same_fds' flags\n");
         return SG_LIB_SYNTAX_ERROR;
     }
@@ -2410,7 +2285,7 @@ main(int argc, char * argv[])
     clp->infd = STDIN_FILENO;
     clp->outfd = STDOUT_FILENO;
     if (inf[0] && ('-' != inf[0])) {
-        clp->in_type = dd_filetype(inf);
+        clp->in_type = sg_io_filetype(inf, 0, clp->debug);
 
         if (FT_ERROR == clp->in_type) {
             pr2serr("%sunable to access %s\n", my_name, inf);
@@ -2422,33 +2297,14 @@ main(int argc, char * argv[])
             clp->infd = sg_in_open(clp, inf, NULL, NULL);
             if (clp->infd < 0)
                 return -clp->infd;
+            sg_ds_init(&clp->in_ds, clp->infd,
+                       (clp->debug > 1) ? clp->debug - 1 : 0);
         } else {
-            flags = O_RDONLY;
-            if (clp->in_flags.direct)
-                flags |= O_DIRECT;
-            if (clp->in_flags.excl)
-                flags |= O_EXCL;
-            if (clp->in_flags.dsync)
-                flags |= O_SYNC;
-
-            if ((clp->infd = open(inf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff, EBUFF_SZ, "%scould not open %s for reading",
-                         my_name, inf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            } else if (skip > 0) {
-                off64_t offset = skip;
-
-                offset *= clp->bs;       /* could exceed 32 here! */
-                if (lseek64(clp->infd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scouldn't skip to required "
-                             "position on %s", my_name, inf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
+            clp->infd = sg_io_open_dd(inf, clp->in_type, false,
+                                      open_fl_mask(&clp->in_flags), skip,
+                                      clp->bs, my_name, 0);
+            if (clp->infd < 0)
+                return sg_convert_errno(-clp->infd);
         }
         clp->infp = inf;
         if ((clp->in_flags.v3 || clp->in_flags.v4) &&
@@ -2462,7 +2318,7 @@ main(int argc, char * argv[])
     if (outf[0])
         clp->ofile_given = true;
     if (outf[0] && ('-' != outf[0])) {
-        clp->out_type = dd_filetype(outf);
+        clp->out_type = sg_io_filetype(outf, 0, clp->debug);
 
         if (FT_ST == clp->out_type) {
             pr2serr("%sunable to use scsi tape device %s\n", my_name, outf);
@@ -2472,50 +2328,17 @@ main(int argc, char * argv[])
             clp->outfd = sg_out_open(clp, outf, NULL, NULL);
             if (clp->outfd < 0)
                 return -clp->outfd;
+            sg_ds_init(&clp->out_ds, clp->outfd,
+                       (clp->debug > 1) ? clp->debug - 1 : 0);
         }
         else if (FT_DEV_NULL == clp->out_type)
             clp->outfd = -1; /* don't bother opening */
         else {
-            if (FT_RAW != clp->out_type) {
-                flags = O_WRONLY | O_CREAT;
-                if (clp->out_flags.direct)
-                    flags |= O_DIRECT;
-                if (clp->out_flags.excl)
-                    flags |= O_EXCL;
-                if (clp->out_flags.dsync)
-                    flags |= O_SYNC;
-                if (clp->out_flags.append)
-                    flags |= O_APPEND;
-
-                if ((clp->outfd = open(outf, flags, 0666)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for "
-                             "writing", my_name, outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            else {      /* raw output file */
-                if ((clp->outfd = open(outf, O_WRONLY)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for raw "
-                             "writing", my_name, outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            if (seek > 0) {
-                off64_t offset = seek;
-
-                offset *= clp->bs;       /* could exceed 32 bits here! */
-                if (lseek64(clp->outfd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scouldn't seek to required "
-                             "position on %s", my_name, outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
+            clp->outfd = sg_io_open_dd(outf, clp->out_type, true,
+                                       open_fl_mask(&clp->out_flags), seek,
+                                       clp->bs, my_name, 0);
+            if (clp->outfd < 0)
+                return sg_convert_errno(-clp->outfd);
         }
         clp->outfp = outf;
         if ((clp->out_flags.v3 || clp->out_flags.v4) &&
@@ -2530,7 +2353,7 @@ main(int argc, char * argv[])
     if (out2f[0])
         clp->ofile2_given = true;
     if (out2f[0] && ('-' != out2f[0])) {
-        clp->out2_type = dd_filetype(out2f);
+        clp->out2_type = sg_io_filetype(out2f, 0, clp->debug);
 
         if (FT_ST == clp->out2_type) {
             pr2serr("%sunable to use scsi tape device %s\n", my_name, out2f);
@@ -2544,49 +2367,34 @@ main(int argc, char * argv[])
         else if (FT_DEV_NULL == clp->out2_type)
             clp->out2fd = -1; /* don't bother opening */
         else {
-            if (FT_RAW != clp->out2_type) {
-                flags = O_WRONLY | O_CREAT;
-                if (clp->out_flags.direct)
-                    flags |= O_DIRECT;
-                if (clp->out_flags.excl)
-                    flags |= O_EXCL;
-                if (clp->out_flags.dsync)
-                    flags |= O_SYNC;
-                if (clp->out_flags.append)
-                    flags |= O_APPEND;
-
-                if ((clp->out2fd = open(out2f, flags, 0666)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for "
-                             "writing", my_name, out2f);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            else {      /* raw output file */
-                if ((clp->out2fd = open(out2f, O_WRONLY)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for raw "
-                             "writing", my_name, out2f);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            if (seek > 0) {
-                off64_t offset = seek;
-
-                offset *= clp->bs;       /* could exceed 32 bits here! */
-                if (lseek64(clp->out2fd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scouldn't seek to required "
-                             "position on %s", my_name, out2f);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
+            clp->out2fd = sg_io_open_dd(out2f, clp->out2_type, true,
+                                        open_fl_mask(&clp->out_flags), seek,
+                                        clp->bs, my_name, 0);
+            if (clp->out2fd < 0)
+                return sg_convert_errno(-clp->out2fd);
         }
         clp->out2fp = out2f;
     }
+    if (clp->v3_drv) {
+        /* sg driver prior to 4.0: no v4 interface, no sharing */
+        if (clp->in_flags.v4 || clp->out_flags.v4) {
+            pr2serr("sg driver prior to 4.0, v4 flag ignored, using v3 "
+                    "interface\n");
+            clp->in_flags.v4 = false;
+            clp->out_flags.v4 = false;
+        }
+        if (clp->debug &&
+            (! (clp->in_flags.noshare || clp->out_flags.noshare)))
+            pr2serr("sg driver prior to 4.0, so no sharing; copy via user "
+                    "space\n");
+        clp->in_flags.noshare = true;
+        clp->out_flags.noshare = true;
+        if (clp->out_flags.swait) {
+            if (clp->debug)
+                pr2serr("oflag=swait ignored since sg driver prior to 4.0\n");
+            clp->out_flags.swait = false;
+        }
+    }
     if ((FT_SG == clp->in_type ) && (FT_SG == clp->out_type)) {
         if (clp->in_flags.v4 && (! clp->out_flags.v3)) {
             if (! clp->out_flags.v4) {
@@ -2606,7 +2414,7 @@ main(int argc, char * argv[])
         }
     }
     if (outregf[0]) {
-        int ftyp = dd_filetype(outregf);
+        int ftyp = sg_io_filetype(outregf, 0, clp->debug);
 
         clp->outreg_type = ftyp;
         if (! ((FT_OTHER == ftyp) || (FT_ERROR == ftyp) ||
@@ -2638,11 +2446,12 @@ main(int argc, char * argv[])
     if (dd_count < 0) {
         in_num_sect = -1;
         if (FT_SG == clp->in_type) {
-            res = scsi_read_capacity(clp->infd, &in_num_sect, &in_sect_sz);
+            res = sg_io_read_capacity(&clp->in_ds, &in_num_sect,
+                                      &in_sect_sz, 0);
             if (2 == res) {
                 pr2serr("Unit attention, media changed(in), continuing\n");
-                res = scsi_read_capacity(clp->infd, &in_num_sect,
-                                         &in_sect_sz);
+                res = sg_io_read_capacity(&clp->in_ds, &in_num_sect,
+                                          &in_sect_sz, 0);
             }
             if (0 != res) {
                 if (res == SG_LIB_CAT_INVALID_OP)
@@ -2654,8 +2463,8 @@ main(int argc, char * argv[])
                 in_num_sect = -1;
             }
         } else if (FT_BLOCK == clp->in_type) {
-            if (0 != read_blkdev_capacity(clp->infd, &in_num_sect,
-                                          &in_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(clp->infd, &in_num_sect,
+                                           &in_sect_sz, 0)) {
                 pr2serr("Unable to read block capacity on %s\n", inf);
                 in_num_sect = -1;
             }
@@ -2670,11 +2479,12 @@ main(int argc, char * argv[])
 
         out_num_sect = -1;
         if (FT_SG == clp->out_type) {
-            res = scsi_read_capacity(clp->outfd, &out_num_sect, &out_sect_sz);
+            res = sg_io_read_capacity(&clp->out_ds, &out_num_sect,
+                                      &out_sect_sz, 0);
             if (2 == res) {
                 pr2serr("Unit attention, media changed(out), continuing\n");
-                res = scsi_read_capacity(clp->outfd, &out_num_sect,
-                                         &out_sect_sz);
+                res = sg_io_read_capacity(&clp->out_ds, &out_num_sect,
+                                          &out_sect_sz, 0);
             }
             if (0 != res) {
                 if (res == SG_LIB_CAT_INVALID_OP)
@@ -2686,8 +2496,8 @@ main(int argc, char * argv[])
                 out_num_sect = -1;
             }
         } else if (FT_BLOCK == clp->out_type) {
-            if (0 != read_blkdev_capacity(clp->outfd, &out_num_sect,
-                                          &out_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(clp->outfd, &out_num_sect,
+                                           &out_sect_sz, 0)) {
                 pr2serr("Unable to read block capacity on %s\n", outf);
                 out_num_sect = -1;
             }
@@ -2869,19 +2679,9 @@ fini:
     }
     print_stats("");
     if (clp->dio_incomplete_count) {
-        int fd;
-        char c;
-
         pr2serr(">> Direct IO requested but incomplete %d times\n",
                 clp->dio_incomplete_count);
-        if ((fd = open(proc_allow_dio, O_RDONLY)) >= 0) {
-            if (1 == read(fd, &c, 1)) {
-                if ('0' == c)
-                    pr2serr(">>> %s set to '0' but should be set to '1' for "
-                            "direct IO\n", proc_allow_dio);
-            }
-            close(fd);
-        }
+        sg_io_dio_warn();
     }
     if (clp->sum_of_resids)
         pr2serr(">> Non-zero sum of residual counts=%d\n",
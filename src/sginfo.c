@@ -124,7 +124,7 @@
 #define _GNU_SOURCE 1
 #endif
 
-static const char * version_str = "2.42 [20180811]";
+static const char * version_str = "2.43 [20261014]";
 
 #include <stdio.h>
 #include <string.h>
@@ -179,6 +179,13 @@ static char single_fetch = 0;
 
 static char mode6byte = 0;      /* defaults to 10 byte mode sense + select */
 static char trace_cmd = 0;
+static char probe_quiet = 0;    /* when probing pages one at a time */
+
+/* While the pages of an all pages (0x3f) response are being decoded, each
+ * page is served from that response rather than fetched again */
+static const uint8_t * msense_all_resp = NULL;
+static int msense_all_len = 0;
+static int msense_all_pc = 0;
 
 struct mpage_info {
     int page;
@@ -812,6 +819,9 @@ get_mode_page6(struct mpage_info * mpi, int dbd, uint8_t * resp,
     struct scsi_cmnd_io sci;
     int initial_len = (sngl_fetch ? MAX_RESP6_SIZE : 4);
 
+    if (MP_LIST_PAGES == mpi->page)
+        initial_len = MAX_RESP6_SIZE;   /* all pages fit, so one command */
+
     memset(resp, 0, 4);
     cmd[0] = SMODE_SENSE;       /* MODE SENSE (6) */
     cmd[1] = 0x00 | (dbd ? 0x8 : 0); /* disable block descriptors bit */
@@ -827,7 +837,9 @@ get_mode_page6(struct mpage_info * mpi, int dbd, uint8_t * resp,
     sci.dxferp = resp;
     status = do_scsi_io(&sci);
     if (status) {
-        if (mpi->subpage)
+        if (probe_quiet)
+            ;
+        else if (mpi->subpage)
             fprintf(stdout, ">>> Unable to read %s mode page 0x%x, subpage "
                     "0x%x [mode_sense_6]\n", get_page_name(mpi), mpi->page,
                     mpi->subpage);
@@ -837,7 +849,9 @@ get_mode_page6(struct mpage_info * mpi, int dbd, uint8_t * resp,
         return status;
     }
     mpi->resp_len = resp[0] + 1;
-    if (sngl_fetch) {
+    if (sngl_fetch || (MAX_RESP6_SIZE == initial_len)) {
+        if (mpi->resp_len > initial_len)
+            mpi->resp_len = initial_len;
         if (trace_cmd > 1) {
             off = modePageOffset(resp, mpi->resp_len, 1);
             if (off >= 0) {
@@ -883,6 +897,9 @@ get_mode_page10(struct mpage_info * mpi, int llbaa, int dbd,
     struct scsi_cmnd_io sci;
     int initial_len = (sngl_fetch ? MAX_RESP10_SIZE : 4);
 
+    if (MP_LIST_PAGES == mpi->page)
+        initial_len = SIZEOF_BUFFER1;   /* all pages in one command */
+
     memset(resp, 0, 4);
     cmd[0] = SMODE_SENSE_10;     /* MODE SENSE (10) */
     cmd[1] = 0x00 | (llbaa ? 0x10 : 0) | (dbd ? 0x8 : 0);
@@ -902,6 +919,8 @@ get_mode_page10(struct mpage_info * mpi, int llbaa, int dbd,
     sci.dxferp = resp;
     status = do_scsi_io(&sci);
     if (status) {
+        if (probe_quiet)
+            return status;
         if (mpi->subpage)
             fprintf(stdout, ">>> Unable to read %s mode page 0x%x, subpage "
                     "0x%x [mode_sense_10]\n", get_page_name(mpi), mpi->page,
@@ -913,7 +932,12 @@ get_mode_page10(struct mpage_info * mpi, int llbaa, int dbd,
         }
     }
     mpi->resp_len = (resp[0] << 8) + resp[1] + 2;
-    if (sngl_fetch) {
+    if (sngl_fetch || (SIZEOF_BUFFER1 == initial_len)) {
+        if (mpi->resp_len > initial_len) {
+            fprintf(stdout, ">>> mode sense response truncated to %d "
+                    "bytes\n", initial_len);
+            mpi->resp_len = initial_len;
+        }
         if (trace_cmd > 1) {
             off = modePageOffset(resp, mpi->resp_len, 0);
             if (off >= 0) {
@@ -950,15 +974,67 @@ get_mode_page10(struct mpage_info * mpi, int llbaa, int dbd,
     return status;
 }
 
+/* If the (sub)page asked for by mpi is in the all pages response being
+ * decoded, builds a response holding only it (after the same header and
+ * block descriptors) in resp. Returns 1 if done, else 0. */
+static int
+get_mode_page_cached(struct mpage_info * mpi, uint8_t * resp)
+{
+    int off, len, pg, spg, hdr_len;
+    const uint8_t * bp = msense_all_resp;
+
+    if ((NULL == bp) || (0 == mpi->page) ||
+        (MP_LIST_PAGES == mpi->page) || (MP_LIST_SUBPAGES == mpi->subpage) ||
+        (mpi->page_control != msense_all_pc))
+        return 0;
+    hdr_len = modePageOffset(bp, msense_all_len, mode6byte);
+    if (hdr_len < 0)
+        return 0;
+    for (off = hdr_len; (off + 2) <= msense_all_len; off += len) {
+        pg = bp[off] & 0x3f;
+        if (0x40 & bp[off]) {
+            if ((off + 4) > msense_all_len)
+                break;
+            spg = bp[off + 1];
+            len = (bp[off + 2] << 8) + bp[off + 3] + 4;
+        } else {
+            spg = 0;
+            len = bp[off + 1] + 2;
+        }
+        if ((off + len) > msense_all_len)
+            break;
+        if ((pg != mpi->page) || (spg != mpi->subpage))
+            continue;
+        memcpy(resp, bp, hdr_len);
+        memcpy(resp + hdr_len, bp + off, len);
+        mpi->resp_len = hdr_len + len;
+        if (mode6byte)
+            resp[0] = mpi->resp_len - 1;
+        else {
+            resp[0] = ((mpi->resp_len - 2) >> 8) & 0xff;
+            resp[1] = (mpi->resp_len - 2) & 0xff;
+        }
+        if (trace_cmd)
+            printf("  mode page 0x%x,0x%x taken from all pages response\n",
+                   pg, spg);
+        return 1;
+    }
+    return 0;
+}
+
 static int
 get_mode_page(struct mpage_info * mpi, int dbd, uint8_t * resp)
 {
     int res;
 
+    if ((0 == dbd) && get_mode_page_cached(mpi, resp))
+        return 0;
     if (mode6byte)
         res = get_mode_page6(mpi, dbd, resp, single_fetch);
     else
         res = get_mode_page10(mpi, 0, dbd, resp, single_fetch);
+    if (probe_quiet)
+        return res;
     if (UNKNOWN_OPCODE == res)
         fprintf(stdout, ">>>>> Try command again with%s '-6' "
                 "argument\n", (mode6byte ? "out the" : " a"));
@@ -3059,8 +3135,11 @@ print_hex_page(struct mpage_info * mpi, const char * prefix,
     printf("\n");
 }
 
+/* Decodes the mode page(s) in the response, held in cbuffer2, to a MODE
+ * SENSE for mpi's (sub)page. When 'multiple' each page in the response is
+ * decoded in turn. */
 static int
-do_user_page(struct mpage_info * mpi, int decode_in_hex)
+decode_user_pages(struct mpage_info * mpi, int decode_in_hex, int multiple)
 {
     int status = 0;
     int len, off, res, done;
@@ -3069,27 +3148,15 @@ do_user_page(struct mpage_info * mpi, int decode_in_hex)
     char prefix[96];
     struct mpage_info local_mp_i;
     struct mpage_name_func * mpf;
-    int multiple = ((MP_LIST_PAGES == mpi->page) ||
-                    (MP_LIST_SUBPAGES == mpi->subpage));
 
-    if (replace && multiple) {
-        printf("Can't list all (sub)pages and use replace (-R) together\n");
-        return 1;
-    }
-    status = get_mode_page(mpi, 0, cbuffer2);
-    if (status) {
-        printf("\n");
-        return status;
-    } else {
-        offset = modePageOffset(cbuffer2, mpi->resp_len, mode6byte);
-        if (offset < 0) {
-            fprintf(stdout, "mode page=0x%x has bad page format\n",
-                    mpi->page);
-            fprintf(stdout, "   perhaps '-z' switch may help\n");
-            return -1;
-        }
-        pagestart = cbuffer2 + offset;
+    offset = modePageOffset(cbuffer2, mpi->resp_len, mode6byte);
+    if (offset < 0) {
+        fprintf(stdout, "mode page=0x%x has bad page format\n",
+                mpi->page);
+        fprintf(stdout, "   perhaps '-z' switch may help\n");
+        return -1;
     }
+    pagestart = cbuffer2 + offset;
 
     memset(&local_mp_i, 0, sizeof(local_mp_i));
     local_mp_i.page_control = mpi->page_control;
@@ -3152,6 +3219,86 @@ do_user_page(struct mpage_info * mpi, int decode_in_hex)
     return status;
 }
 
+/* Used when the device rejects mode page 0x3f: fetches the pages 0x1 to
+ * 0x3e one at a time, decoding those that the device has */
+static int
+probe_user_pages(struct mpage_info * mpi, int decode_in_hex)
+{
+    int k, res;
+    int status = 0;
+    struct mpage_info probe_mp_i;
+
+    probe_mp_i = *mpi;
+    probe_mp_i.subpage = 0;
+    for (k = 1; k < MP_LIST_PAGES; ++k) {
+        probe_mp_i.page = k;
+        probe_quiet = 1;
+        res = get_mode_page(&probe_mp_i, 0, cbuffer2);
+        probe_quiet = 0;
+        if (res) {
+            if ((BAD_CDB_FIELD == res) || (UNSUPPORTED_PARAM == res))
+                continue;
+            return get_mode_page(&probe_mp_i, 0, cbuffer2);  /* report it */
+        }
+        msense_all_resp = cbuffer2;
+        msense_all_len = probe_mp_i.resp_len;
+        msense_all_pc = probe_mp_i.page_control;
+        status |= decode_user_pages(&probe_mp_i, decode_in_hex, 0);
+        msense_all_resp = NULL;
+    }
+    return status;
+}
+
+static int
+do_user_page(struct mpage_info * mpi, int decode_in_hex)
+{
+    int status;
+    int multiple = ((MP_LIST_PAGES == mpi->page) ||
+                    (MP_LIST_SUBPAGES == mpi->subpage));
+
+    if (replace && multiple) {
+        printf("Can't list all (sub)pages and use replace (-R) together\n");
+        return 1;
+    }
+    /* One MODE SENSE for all the (sub)pages, each then decoded from it. If
+     * the device rejects subpage 0xff, try without subpages; if it rejects
+     * page 0x3f then probe the pages one at a time. */
+    if (multiple) {
+        probe_quiet = 1;
+        status = get_mode_page(mpi, 0, cbuffer2);
+        if ((BAD_CDB_FIELD == status) && (MP_LIST_PAGES == mpi->page) &&
+            (MP_LIST_SUBPAGES == mpi->subpage)) {
+            if (trace_cmd > 0)
+                printf("  subpage 0xff rejected, try subpage 0\n");
+            mpi->subpage = 0;
+            status = get_mode_page(mpi, 0, cbuffer2);
+        }
+        probe_quiet = 0;
+        if ((BAD_CDB_FIELD == status) && (MP_LIST_PAGES == mpi->page)) {
+            if (trace_cmd > 0)
+                printf("  mode page 0x3f rejected, probe each page\n");
+            return probe_user_pages(mpi, decode_in_hex);
+        }
+        if (status)     /* again, to report the error */
+            status = get_mode_page(mpi, 0, cbuffer2);
+    } else
+        status = get_mode_page(mpi, 0, cbuffer2);
+    if (status) {
+        printf("\n");
+        return status;
+    }
+    if (replace)
+        return decode_user_pages(mpi, decode_in_hex, 0);
+    /* decoders then take their (sub)page from this response */
+    msense_all_resp = cbuffer2;
+    msense_all_len = mpi->resp_len;
+    msense_all_pc = mpi->page_control;
+    status = decode_user_pages(mpi, decode_in_hex, multiple);
+    msense_all_resp = NULL;
+    msense_all_len = 0;
+    return status;
+}
+
 static void
 inqfieldname(uint8_t *deststr, const uint8_t *srcbuf, int maxlen)
 {
@@ -23,8 +23,10 @@
    command.
 
    This version uses memory-mapped transfers (i.e. mmap() call from the user
-   space) to speed transfers. If both sides of copy are sg devices
-   then only the read side will be mmap-ed, while the write side will
+   space) to speed transfers. If both sides of copy are sg devices and the
+   sg v4 driver lets them share requests then each WRITE takes its data from
+   the kernel buffer its READ filled, so no data passes through user space.
+   Otherwise only the read side will be mmap-ed, while the write side will
    use normal IO.
 
    This version is designed for the linux kernel 2.4, 2.6, 3 and 4 series.
@@ -64,12 +66,13 @@
 #endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
+#include "sg_cmds_extra.h"
 #include "sg_io_linux.h"
-#include "sg_unaligned.h"
+#include "sg_pt.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.63 20190618";
+static const char * version_str = "1.65 20261014";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -85,26 +88,18 @@ static const char * version_str = "1.63 20190618";
 #endif
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
-#define READ_CAP_REPLY_LEN 8
-#define RCAP16_REPLY_LEN 32
 
 #define DEF_TIMEOUT 60000       /* 60,000 millisecs == 60 seconds */
 
-#ifndef RAW_MAJOR
-#define RAW_MAJOR 255   /*unlikey value */
-#endif
-
-#define FT_OTHER 1              /* filetype other than one of following */
-#define FT_SG 2                 /* filetype is sg char device */
-#define FT_RAW 4                /* filetype is raw char device */
-#define FT_DEV_NULL 8           /* either "/dev/null" or "." as filename */
-#define FT_ST 16                /* filetype is st char device (tape) */
-#define FT_BLOCK 32             /* filetype is a block device */
-#define FT_ERROR 64             /* couldn't "stat" file */
-
-#define DEV_NULL_MINOR_NUM 3
+#define FT_OTHER SG_IO_FT_OTHER
+#define FT_SG SG_IO_FT_SG
+#define FT_RAW SG_IO_FT_RAW
+#define FT_DEV_NULL SG_IO_FT_DEV_NULL
+#define FT_ST SG_IO_FT_ST
+#define FT_BLOCK SG_IO_FT_BLOCK
+#define FT_ERROR SG_IO_FT_ERROR
 
-#define MIN_RESERVED_SIZE 8192
+#define MAX_IN_FDS 16           /* for fds=K */
 
 static int sum_of_resids = 0;
 
@@ -122,8 +117,35 @@ static bool start_tm_valid = false;
 static struct timeval start_tm;
 static int blk_sz = 0;
 static uint32_t glob_pack_id = 0;       /* pre-increment */
+/* capacity of a sg IFILE or OFILE, fetched once */
+static struct sg_dev_sess in_ds;
+static struct sg_dev_sess out_ds;
+
+/* With fds=K a sg IFILE is opened K times and each file descriptor has
+ * its own reserved buffer mmap-ed. One READ at a time is queued (with
+ * write(2)) on each of them, ahead of the chunk being written out, and
+ * they are reaped (with read(2)) in the same order. So up to K READs are
+ * outstanding at the device while chunks are still written in order. */
+struct in_fd_t {
+    int fd;
+    int blocks;         /* of the READ queued on fd, 0 when none is */
+    int mmap_len;
+    int64_t lba;
+    uint64_t lat_start;
+    uint8_t * mmap_bp;
+    struct sg_io_hdr io_hdr;
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+};
 
-static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
+static struct in_fd_t in_fds[MAX_IN_FDS];
+static int num_in_fds = 1;
+static int recovered_errs = 0;
+static int unrecovered_errs = 0;
+static bool dio_warned = false;     /* only first incomplete dio noted */
+static int num_retries = 0;
+
+static struct sg_io_progress progress;  /* progress=SEC[,FILE] */
 
 struct flags_t {
     bool append;
@@ -133,6 +155,7 @@ struct flags_t {
     bool dsync;
     bool excl;
     bool fua;
+    bool noshare;
 };
 
 
@@ -153,38 +176,41 @@ install_handler(int sig_num, void (*sig_handler) (int sig))
 static void
 print_stats()
 {
-    if (0 != dd_count)
-        pr2serr("  remaining block count=%" PRId64 "\n", dd_count);
-    pr2serr("%" PRId64 "+%d records in\n", in_full - in_partial, in_partial);
-    pr2serr("%" PRId64 "+%d records out\n", out_full - out_partial,
-            out_partial);
+    sg_io_print_records(NULL, dd_count, in_full, in_partial, out_full,
+                        out_partial);
 }
 
 static void
 calc_duration_throughput(bool contin)
 {
-    double a, b;
-    struct timeval end_tm, res_tm;
-
-    if (start_tm_valid && (start_tm.tv_sec || start_tm.tv_usec)) {
-        gettimeofday(&end_tm, NULL);
-        res_tm.tv_sec = end_tm.tv_sec - start_tm.tv_sec;
-        res_tm.tv_usec = end_tm.tv_usec - start_tm.tv_usec;
-        if (res_tm.tv_usec < 0) {
-            --res_tm.tv_sec;
-            res_tm.tv_usec += 1000000;
-        }
-        a = res_tm.tv_sec;
-        a += (0.000001 * res_tm.tv_usec);
-        b = (double)blk_sz * (req_count - dd_count);
-        pr2serr("time to transfer data%s: %d.%06d secs",
-                (contin ? " so far" : ""), (int)res_tm.tv_sec,
-                (int)res_tm.tv_usec);
-        if ((a > 0.00001) && (b > 511))
-            pr2serr(" at %.2f MB/sec\n", b / (a * 1000000.0));
-        else
-            pr2serr("\n");
-    }
+    if (start_tm_valid && (start_tm.tv_sec || start_tm.tv_usec))
+        sg_io_print_throughput(&start_tm, req_count - dd_count, blk_sz,
+                               contin);
+}
+
+/* With progress=SEC[,FILE]: called after each chunk is copied, every SEC
+ * seconds writes one line holding a JSON object to FILE. 'final' is set
+ * for the last line, written when the copy ends. The read_lat_us and
+ * write_lat_us members are only present for sg devices. */
+static void
+progress_out(bool final, int infd, int cdbsz_in, int outfd, int cdbsz_out)
+{
+    struct sg_io_progress_cnt cnt;
+
+    if (NULL == progress.fp)
+        return;
+    if ((! final) && (! sg_io_progress_tick(&progress)))
+        return;
+    cnt.blocks_in = in_full;
+    cnt.blocks_out = out_full;
+    cnt.recovered_errs = recovered_errs;
+    cnt.unrecovered_errs = unrecovered_errs;
+    cnt.retries = num_retries;
+    cnt.rd_fd = infd;
+    cnt.rd_opcode = sg_rw_opcode(cdbsz_in, false);
+    cnt.wr_fd = outfd;
+    cnt.wr_opcode = sg_rw_opcode(cdbsz_out, true);
+    sg_io_progress_out(&progress, final, &cnt);
 }
 
 static void
@@ -213,53 +239,6 @@ siginfo_handler(int sig)
         calc_duration_throughput(true);
 }
 
-static int
-dd_filetype(const char * filename)
-{
-    size_t len = strlen(filename);
-    struct stat st;
-
-    if ((1 == len) && ('.' == filename[0]))
-        return FT_DEV_NULL;
-    if (stat(filename, &st) < 0)
-        return FT_ERROR;
-    if (S_ISCHR(st.st_mode)) {
-        if ((MEM_MAJOR == major(st.st_rdev)) &&
-            (DEV_NULL_MINOR_NUM == minor(st.st_rdev)))
-            return FT_DEV_NULL;
-        if (RAW_MAJOR == major(st.st_rdev))
-            return FT_RAW;
-        if (SCSI_GENERIC_MAJOR == major(st.st_rdev))
-            return FT_SG;
-        if (SCSI_TAPE_MAJOR == major(st.st_rdev))
-            return FT_ST;
-    } else if (S_ISBLK(st.st_mode))
-        return FT_BLOCK;
-    return FT_OTHER;
-}
-
-static char *
-dd_filetype_str(int ft, char * buff)
-{
-    int off = 0;
-
-    if (FT_DEV_NULL & ft)
-        off += sg_scnpr(buff + off, 32, "null device ");
-    if (FT_SG & ft)
-        off += sg_scnpr(buff + off, 32, "SCSI generic (sg) device ");
-    if (FT_BLOCK & ft)
-        off += sg_scnpr(buff + off, 32, "block device ");
-    if (FT_ST & ft)
-        off += sg_scnpr(buff + off, 32, "SCSI tape device ");
-    if (FT_RAW & ft)
-        off += sg_scnpr(buff + off, 32, "raw device ");
-    if (FT_OTHER & ft)
-        off += sg_scnpr(buff + off, 32, "other (perhaps ordinary file) ");
-    if (FT_ERROR & ft)
-        sg_scnpr(buff + off, 32, "unable to 'stat' file ");
-    return buff;
-}
-
 static void
 usage()
 {
@@ -268,31 +247,41 @@ usage()
             "               [obs=BS] [of=OFILE] [oflag=FLAGS] "
             "[seek=SEEK] [skip=SKIP]\n"
             "               [--help] [--version]\n\n");
-    pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [dio=0|1] "
-            "[fua=0|1|2|3]\n"
-            "               [sync=0|1] [time=0|1] [verbose=VERB] "
-            "[--dry-run] [--verbose]\n\n"
+    pr2serr("               [bpt=BPT|auto] [cdbsz=6|10|12|16] [dio=0|1] "
+            "[fds=K]\n"
+            "               [fua=0|1|2|3] [progress=SEC[,FILE]] [sync=0|1] "
+            "[time=0|1]\n"
+            "               [verbose=VERB] [--dry-run] [--verbose]\n\n"
             "  where:\n"
-            "    bpt         is blocks_per_transfer (default is 128)\n"
+            "    bpt         is blocks_per_transfer (default is 128), "
+            "'auto' sizes\n"
+            "                it from the Block Limits VPD page(s)\n"
             "    bs          must be device logical block size (default "
             "512)\n"
             "    cdbsz       size of SCSI READ or WRITE cdb (default is 10)\n"
             "    count       number of blocks to copy (def: device size)\n"
             "    dio         0->indirect IO on write, 1->direct IO on write\n"
             "                (only when read side is sg device (using mmap))\n"
+            "    fds         open sg IFILE K times, each mmap-ed, and keep a "
+            "READ\n"
+            "                queued on each (def: 1, max: %d)\n"
             "    fua         force unit access: 0->don't(def), 1->OFILE, "
             "2->IFILE,\n"
             "                3->OFILE+IFILE\n"
-            "    if          file or device to read from (def: stdin)\n");
+            "    if          file or device to read from (def: stdin)\n",
+            MAX_IN_FDS);
     pr2serr("    iflag       comma separated list from: [direct,dpo,dsync,"
             "excl,fua,\n"
-            "                null]\n"
+            "                noshare,null]\n"
             "    of          file or device to write to (def: stdout), "
             "OFILE of '.'\n"
             "                treated as /dev/null\n"
             "    oflag       comma separated list from: [append,dio,direct,"
             "dpo,dsync,\n"
-            "                excl,fua,null]\n"
+            "                excl,fua,noshare,null]\n"
+            "    progress    every SEC seconds append a JSON line with the "
+            "copy's\n"
+            "                progress to FILE (def: stderr)\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
@@ -309,155 +298,37 @@ usage()
             "specialized for SCSI devices for which mmap-ed IO attempted\n");
 }
 
-/* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
+/* Checks a completed READ. Returns 0 -> successful, else a SG_LIB_CAT_*
+ * positive value */
 static int
-scsi_read_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+sg_read_chk(struct sg_io_hdr * hp)
 {
-    int res, verb;
-    unsigned int ui;
-    uint8_t rcBuff[RCAP16_REPLY_LEN];
-
-    verb = (verbose ? verbose - 1: 0);
-    res = sg_ll_readcap_10(sg_fd, 0, 0, rcBuff, READ_CAP_REPLY_LEN, false,
-                           verb);
-    if (0 != res)
-        return res;
-
-    if ((0xff == rcBuff[0]) && (0xff == rcBuff[1]) && (0xff == rcBuff[2]) &&
-        (0xff == rcBuff[3])) {
-
-        res = sg_ll_readcap_16(sg_fd, 0, 0, rcBuff, RCAP16_REPLY_LEN, false,
-                               verb);
-        if (0 != res)
-            return res;
-        *num_sect = sg_get_unaligned_be64(rcBuff + 0) + 1;
-        *sect_sz = sg_get_unaligned_be32(rcBuff + 8);
-    } else {
-        ui = sg_get_unaligned_be32(rcBuff + 0);
-        /* take care not to sign extend values > 0x7fffffff */
-        *num_sect = (int64_t)ui + 1;
-        *sect_sz = sg_get_unaligned_be32(rcBuff + 4);
-    }
-    if (verbose)
-        pr2serr("      number of blocks=%" PRId64 " [0x%" PRIx64 "], block "
-                "size=%d\n", *num_sect, *num_sect, *sect_sz);
-    return 0;
-}
-
-/* Return of 0 -> success, -1 -> failure. BLKGETSIZE64, BLKGETSIZE and */
-/* BLKSSZGET macros problematic (from <linux/fs.h> or <sys/mount.h>). */
-static int
-read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
-{
-#ifdef BLKSSZGET
-    if ((ioctl(sg_fd, BLKSSZGET, sect_sz) < 0) && (*sect_sz > 0)) {
-        perror("BLKSSZGET ioctl error");
-        return -1;
-    } else {
- #ifdef BLKGETSIZE64
-        uint64_t ull;
-
-        if (ioctl(sg_fd, BLKGETSIZE64, &ull) < 0) {
-
-            perror("BLKGETSIZE64 ioctl error");
-            return -1;
-        }
-        *num_sect = ((int64_t)ull / (int64_t)*sect_sz);
-        if (verbose)
-            pr2serr("      [bgs64] number of blocks=%" PRId64 " [0x%" PRIx64
-                    "], logical block size=%d\n", *num_sect, *num_sect,
-                    *sect_sz);
- #else
-        unsigned long ul;
-
-        if (ioctl(sg_fd, BLKGETSIZE, &ul) < 0) {
-            perror("BLKGETSIZE ioctl error");
-            return -1;
-        }
-        *num_sect = (int64_t)ul;
-        if (verbose)
-            pr2serr("      [bgs] number of blocks=%" PRId64 " [0x%" PRIx64
-                    "], logical block size=%d\n", *num_sect, *num_sect,
-                    *sect_sz);
- #endif
-    }
-    return 0;
-#else
-    if (verbose)
-        pr2serr("      BLKSSZGET+BLKGETSIZE ioctl not available\n");
-    *num_sect = 0;
-    *sect_sz = 0;
-    return -1;
-#endif
-}
+    int res;
 
-static int
-sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
-                  int64_t start_block, bool write_true, bool fua, bool dpo)
-{
-    int sz_ind;
-    int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
-    int wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
-
-    memset(cdbp, 0, cdb_sz);
-    if (dpo)
-        cdbp[1] |= 0x10;
-    if (fua)
-        cdbp[1] |= 0x8;
-    switch (cdb_sz) {
-    case 6:
-        sz_ind = 0;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
-        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
-        if (blocks > 256) {
-            pr2serr(ME "for 6 byte commands, maximum number of blocks is "
-                    "256\n");
-            return 1;
-        }
-        if ((start_block + blocks - 1) & (~0x1fffff)) {
-            pr2serr(ME "for 6 byte commands, can't address blocks beyond "
-                    "%d\n", 0x1fffff);
-            return 1;
-        }
-        if (dpo || fua) {
-            pr2serr(ME "for 6 byte commands, neither dpo nor fua bits "
-                    "supported\n");
-            return 1;
-        }
-        break;
-    case 10:
-        sz_ind = 1;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be16((uint16_t)blocks, cdbp + 7);
-        if (blocks & (~0xffff)) {
-            pr2serr(ME "for 10 byte commands, maximum number of blocks is "
-                    "%d\n", 0xffff);
-            return 1;
-        }
-        break;
-    case 12:
-        sz_ind = 2;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 6);
+    if (verbose > 2)
+        pr2serr("      duration=%u ms\n", hp->duration);
+    res =  sg_err_category3(hp);
+    switch (res) {
+    case SG_LIB_CAT_CLEAN:
         break;
-    case 16:
-        sz_ind = 3;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be64((uint64_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 10);
+    case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
+        sg_chk_n_print3("Reading, continuing", hp, verbose > 1);
         break;
+    case SG_LIB_CAT_NOT_READY:
+    case SG_LIB_CAT_MEDIUM_HARD:
+        return res;
+    case SG_LIB_CAT_ABORTED_COMMAND:
+    case SG_LIB_CAT_UNIT_ATTENTION:
+    case SG_LIB_CAT_ILLEGAL_REQ:
     default:
-        pr2serr(ME "expected cdb size of 6, 10, 12, or 16 but got %d\n",
-                cdb_sz);
-        return 1;
+        sg_chk_n_print3("reading", hp, verbose > 1);
+        return res;
     }
+    sum_of_resids += hp->resid;
+#ifdef DEBUG
+    pr2serr("duration=%u ms\n", hp->duration);
+#endif
     return 0;
 }
 
@@ -471,9 +342,10 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
     uint8_t rdCmd[MAX_SCSI_CDBSZ];
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
+    uint64_t lat_start;
 
-    if (sg_build_scsi_cdb(rdCmd, cdbsz, blocks, from_block, false, fua,
-                          dpo)) {
+    if (sg_build_rw_cdb(rdCmd, cdbsz, blocks, from_block, false, fua,
+                        dpo, ME)) {
         pr2serr(ME "bad rd cdb build, from_block=%" PRId64 ", blocks=%d\n",
                 from_block, blocks);
         return SG_LIB_SYNTAX_ERROR;
@@ -500,6 +372,7 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
     }
 
 #if 1
+    lat_start = sg_pt_lat_is_enabled() ? sg_pt_lat_now_ns() : 0;
     while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
            ((EINTR == errno) || (EAGAIN == errno)))
         sleep(1);
@@ -507,10 +380,10 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         perror(ME "SG_IO error (sg_read)");
         return -1;
     }
+    if (lat_start)
+        sg_pt_lat_record(sg_fd, rdCmd[0], sg_pt_lat_now_ns() - lat_start);
 #else
-    while (((res = write(sg_fd, &io_hdr, sizeof(io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    res = sg_io_write_retry(sg_fd, &io_hdr, sizeof(io_hdr));
     if (res < 0) {
         if (ENOMEM == errno)
             return -2;
@@ -518,40 +391,92 @@ sg_read(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
         return -1;
     }
 
-    while (((res = read(sg_fd, &io_hdr, sizeof(io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    res = sg_io_read_retry(sg_fd, &io_hdr, sizeof(io_hdr));
     if (res < 0) {
         perror("reading (rd) on sg device, error");
         return -1;
     }
 #endif
-    if (verbose > 2)
-        pr2serr("      duration=%u ms\n", io_hdr.duration);
-    res =  sg_err_category3(&io_hdr);
-    switch (res) {
-    case SG_LIB_CAT_CLEAN:
-        break;
-    case SG_LIB_CAT_RECOVERED:
-        sg_chk_n_print3("Reading, continuing", &io_hdr, verbose > 1);
-        break;
-    case SG_LIB_CAT_NOT_READY:
-    case SG_LIB_CAT_MEDIUM_HARD:
-        return res;
-    case SG_LIB_CAT_ABORTED_COMMAND:
-    case SG_LIB_CAT_UNIT_ATTENTION:
-    case SG_LIB_CAT_ILLEGAL_REQ:
-    default:
-        sg_chk_n_print3("reading", &io_hdr, verbose > 1);
-        return res;
+    return sg_read_chk(&io_hdr);
+}
+
+/* For fds=K, queues a READ of blocks from from_block on ifdp->fd, into the
+ * reserved buffer mmap-ed at ifdp->mmap_bp. Returns 0 -> queued, -2 ->
+ * recoverable (ENOMEM), -1 -> unrecoverable error, else a SG_LIB_CAT_*
+ * value. */
+static int
+sg_read_submit(struct in_fd_t * ifdp, int blocks, int64_t from_block,
+               int bs, int cdbsz, bool fua, bool dpo)
+{
+    int res;
+    struct sg_io_hdr * hp = &ifdp->io_hdr;
+
+    if (sg_build_rw_cdb(ifdp->cdb, cdbsz, blocks, from_block, false, fua,
+                        dpo, ME)) {
+        pr2serr(ME "bad rd cdb build, from_block=%" PRId64 ", blocks=%d\n",
+                from_block, blocks);
+        return SG_LIB_SYNTAX_ERROR;
     }
-    sum_of_resids += io_hdr.resid;
-#ifdef DEBUG
-    pr2serr("duration=%u ms\n", io_hdr.duration);
-#endif
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = cdbsz;
+    hp->cmdp = ifdp->cdb;
+    hp->dxfer_direction = SG_DXFER_FROM_DEV;
+    hp->dxfer_len = bs * blocks;
+    hp->mx_sb_len = SENSE_BUFF_LEN;
+    hp->sbp = ifdp->sense;
+    hp->timeout = DEF_TIMEOUT;
+    hp->pack_id = (int)++glob_pack_id;
+    hp->flags |= SG_FLAG_MMAP_IO;
+    ifdp->lat_start = sg_pt_lat_is_enabled() ? sg_pt_lat_now_ns() : 0;
+    res = sg_io_write_retry(ifdp->fd, hp, sizeof(struct sg_io_hdr));
+    if (res < 0) {
+        if (ENOMEM == errno)
+            return -2;
+        perror(ME "queuing READ (write) on sg device, error");
+        return -1;
+    }
+    ifdp->blocks = blocks;
+    ifdp->lba = from_block;
     return 0;
 }
 
+/* Waits for the READ queued on ifdp->fd by sg_read_submit() to complete.
+ * Returns as sg_read() does. */
+static int
+sg_read_reap(struct in_fd_t * ifdp)
+{
+    int res;
+    struct sg_io_hdr * hp = &ifdp->io_hdr;
+
+    ifdp->blocks = 0;
+    res = sg_io_read_retry(ifdp->fd, hp, sizeof(struct sg_io_hdr));
+    if (res < 0) {
+        perror(ME "reaping READ (read) on sg device, error");
+        return -1;
+    }
+    if (ifdp->lat_start)
+        sg_pt_lat_record(ifdp->fd, ifdp->cdb[0],
+                         sg_pt_lat_now_ns() - ifdp->lat_start);
+    return sg_read_chk(hp);
+}
+
+/* Reaps, and drops, READs still queued by sg_read_submit(), e.g. after
+ * an error */
+static void
+sg_read_drain(void)
+{
+    int k;
+    struct sg_io_hdr io_hdr;
+
+    for (k = 0; k < num_in_fds; ++k) {
+        if (in_fds[k].blocks > 0) {
+            sg_io_read_retry(in_fds[k].fd, &io_hdr, sizeof(io_hdr));
+            in_fds[k].blocks = 0;
+        }
+    }
+}
+
 /* Returns 0 -> successful, various SG_LIB_CAT_* positive values,
  * -2 -> recoverable (ENOMEM), -1 -> unrecoverable error */
 static int
@@ -562,8 +487,9 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
     uint8_t wrCmd[MAX_SCSI_CDBSZ];
     uint8_t senseBuff[SENSE_BUFF_LEN];
     struct sg_io_hdr io_hdr;
+    uint64_t lat_start;
 
-    if (sg_build_scsi_cdb(wrCmd, cdbsz, blocks, to_block, true, fua, dpo)) {
+    if (sg_build_rw_cdb(wrCmd, cdbsz, blocks, to_block, true, fua, dpo, ME)) {
         pr2serr(ME "bad wr cdb build, to_block=%" PRId64 ", blocks=%d\n",
                 to_block, blocks);
         return SG_LIB_SYNTAX_ERROR;
@@ -593,6 +519,7 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
     }
 
 #if 1
+    lat_start = sg_pt_lat_is_enabled() ? sg_pt_lat_now_ns() : 0;
     while (((res = ioctl(sg_fd, SG_IO, &io_hdr)) < 0) &&
            ((EINTR == errno) || (EAGAIN == errno)))
         sleep(1);
@@ -600,10 +527,10 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
         perror(ME "SG_IO error (sg_write)");
         return -1;
     }
+    if (lat_start)
+        sg_pt_lat_record(sg_fd, wrCmd[0], sg_pt_lat_now_ns() - lat_start);
 #else
-    while (((res = write(sg_fd, &io_hdr, sizeof(io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    res = sg_io_write_retry(sg_fd, &io_hdr, sizeof(io_hdr));
     if (res < 0) {
         if (ENOMEM == errno)
             return -2;
@@ -611,9 +538,7 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
         return -1;
     }
 
-    while (((res = read(sg_fd, &io_hdr, sizeof(io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    res = sg_io_read_retry(sg_fd, &io_hdr, sizeof(io_hdr));
     if (res < 0) {
         perror("writing (rd) on sg device, error");
         return -1;
@@ -626,6 +551,7 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
     case SG_LIB_CAT_CLEAN:
         break;
     case SG_LIB_CAT_RECOVERED:
+        ++recovered_errs;
         sg_chk_n_print3("Writing, continuing", &io_hdr, verbose > 1);
         break;
     case SG_LIB_CAT_NOT_READY:
@@ -638,12 +564,103 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
         sg_chk_n_print3("writing", &io_hdr, verbose > 1);
         return res;
     }
-    if (diop && *diop &&
-        ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+    if (diop && *diop && (! sg_io_dio_done(&io_hdr, ME, &dio_warned)))
         *diop = false;      /* flag that dio not done (completely) */
     return 0;
 }
 
+/* Checks the outcome of one side of a shared copy. Returns 0 -> successful,
+ * various SG_LIB_CAT_* positive values, -1 -> unrecoverable error */
+static int
+shared_outcome(struct sg_pt_base * ptvp, const char * leadin, int pt_res)
+{
+    int res, s_cat;
+
+    res = sg_cmds_process_resp(ptvp, leadin, pt_res, true /* noisy */,
+                               (verbose > 1) ? verbose - 1 : 0, &s_cat);
+    if (-1 == res)
+        return -1;
+    else if (-2 == res) {
+        switch (s_cat) {
+        case SG_LIB_CAT_RECOVERED:
+            ++recovered_errs;
+            /* fall through */
+        case SG_LIB_CAT_NO_SENSE:
+            return 0;
+        default:
+            return s_cat;
+        }
+    }
+    return 0;
+}
+
+/* Reads blocks from IFILE at from_block then writes them to OFILE at
+ * to_block from the kernel buffer the READ filled: the file descriptors of
+ * both must share requests (see scsi_pt_share_fds() ). *wr_errp is set to
+ * whether it was the WRITE that failed. Returns 0 -> successful, various
+ * SG_LIB_CAT_* positive values, -1 -> unrecoverable error */
+static int
+sg_shared_rw(struct sg_pt_base * rd_ptvp, struct sg_pt_base * wr_ptvp,
+             int blocks, int64_t from_block, int64_t to_block, int bs,
+             int cdbsz_in, int cdbsz_out, const struct flags_t * ifp,
+             const struct flags_t * ofp, bool * wr_errp)
+{
+    bool wr_issued;
+    int k, res;
+    uint8_t rdCmd[MAX_SCSI_CDBSZ];
+    uint8_t wrCmd[MAX_SCSI_CDBSZ];
+    uint8_t rdSense[SENSE_BUFF_LEN];
+    uint8_t wrSense[SENSE_BUFF_LEN];
+
+    *wr_errp = false;
+    if (sg_build_rw_cdb(rdCmd, cdbsz_in, blocks, from_block, false,
+                        ifp->fua, ifp->dpo, ME) ||
+        sg_build_rw_cdb(wrCmd, cdbsz_out, blocks, to_block, true,
+                        ofp->fua, ofp->dpo, ME)) {
+        pr2serr(ME "bad cdb build, from_block=%" PRId64 ", to_block=%"
+                PRId64 ", blocks=%d\n", from_block, to_block, blocks);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (verbose > 2) {
+        pr2serr("    read cdb: ");
+        for (k = 0; k < cdbsz_in; ++k)
+            pr2serr("%02x ", rdCmd[k]);
+        pr2serr("\n    write cdb (shared): ");
+        for (k = 0; k < cdbsz_out; ++k)
+            pr2serr("%02x ", wrCmd[k]);
+        pr2serr("\n");
+    }
+    clear_scsi_pt_obj(rd_ptvp);
+    clear_scsi_pt_obj(wr_ptvp);
+    set_scsi_pt_cdb(rd_ptvp, rdCmd, cdbsz_in);
+    set_scsi_pt_sense(rd_ptvp, rdSense, sizeof(rdSense));
+    set_scsi_pt_packet_id(rd_ptvp, (int)++glob_pack_id);
+    set_scsi_pt_cdb(wr_ptvp, wrCmd, cdbsz_out);
+    set_scsi_pt_sense(wr_ptvp, wrSense, sizeof(wrSense));
+    set_scsi_pt_packet_id(wr_ptvp, (int)++glob_pack_id);
+    res = do_scsi_pt_shared_rw(rd_ptvp, wr_ptvp, bs * blocks,
+                               DEF_TIMEOUT / 1000, &wr_issued,
+                               (verbose > 1) ? verbose - 1 : 0);
+    if (res > 0) {
+        pr2serr(ME "shared copy refused (bad parameters or not "
+                "supported)\n");
+        return -1;
+    }
+    k = shared_outcome(rd_ptvp, "reading", wr_issued ? 0 : res);
+    if (k)
+        return k;
+    if (! wr_issued) {
+        pr2serr(ME "short read (resid=%d) so nothing written\n",
+                get_scsi_pt_resid(rd_ptvp));
+        return -1;
+    }
+    sum_of_resids += get_scsi_pt_resid(rd_ptvp);
+    k = shared_outcome(wr_ptvp, "writing", res);
+    if (k)
+        *wr_errp = true;
+    return k;
+}
+
 static int
 process_flags(const char * arg, struct flags_t * fp)
 {
@@ -676,6 +693,8 @@ process_flags(const char * arg, struct flags_t * fp)
             fp->excl = true;
         else if (0 == strcmp(cp, "fua"))
             fp->fua = true;
+        else if (0 == strcmp(cp, "noshare"))
+            fp->noshare = true;
         else if (0 == strcmp(cp, "null"))
             ;
         else {
@@ -701,21 +720,117 @@ num_chs_in_str(const char * s, int slen, int ch)
     return res;
 }
 
+/* For bpt=auto fills *sp for sg_io_auto_bpt() with the sg or block device
+ * fn opened. Since the mmap-ed reserved buffer is sized before both files
+ * are open, fn is opened here (and closed by the caller). Returns the file
+ * descriptor, or -1 when fn is not a device. */
+static int
+auto_bpt_open(const char * fn, struct sg_io_bpt_side * sp)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->fd = -1;
+    sp->fname = fn;
+    if (('\0' == fn[0]) || ('-' == fn[0]))
+        return -1;
+    sp->ftype = sg_io_filetype(fn, 0, verbose);
+    if ((FT_SG | FT_BLOCK) & sp->ftype)
+        sp->fd = open(fn, O_RDONLY | O_NONBLOCK);
+    return sp->fd;
+}
+
+/* Returns the bpt=auto transfer size (in blocks) for the copy from inf to
+ * outf, see sg_io_auto_bpt(). Returns def_bpt when neither side is a
+ * device. */
+static int
+auto_bpt(const char * inf, const char * outf, int def_bpt)
+{
+    int bpt;
+    struct sg_io_bpt_side in_side, out_side;
+
+    auto_bpt_open(inf, &in_side);
+    auto_bpt_open(outf, &out_side);
+    bpt = sg_io_auto_bpt(&in_side, &out_side, blk_sz, def_bpt, verbose);
+    if (in_side.fd >= 0)
+        close(in_side.fd);
+    if (out_side.fd >= 0)
+        close(out_side.fd);
+    return bpt;
+}
+
 
 #define STR_SZ 1024
 #define INOUTF_SZ 512
 #define EBUFF_SZ 768
 
+/* Returns the SG_IO_OPEN_* mask for sg_io_open_dd() from iflag= or
+ * oflag= . A sg device is always opened non-blocking. */
+static int
+open_fl_mask(const struct flags_t * fp)
+{
+    int fl_mask = SG_IO_OPEN_NONBLOCK;
+
+    if (fp->direct)
+        fl_mask |= SG_IO_OPEN_DIRECT;
+    if (fp->excl)
+        fl_mask |= SG_IO_OPEN_EXCL;
+    if (fp->dsync)
+        fl_mask |= SG_IO_OPEN_DSYNC;
+    if (fp->append)
+        fl_mask |= SG_IO_OPEN_APPEND;
+    return fl_mask;
+}
+
+/* For fds=K opens the sg IFILE once more (with fl_mask), sizes the reserved
+ * buffer of the new file descriptor and mmap()s it. Returns 0 when *ifdp
+ * is ready, else a sg3_utils exit status. */
+static int
+open_in_again(const char * inf, int fl_mask, int * bptp, size_t psz,
+              struct in_fd_t * ifdp)
+{
+    int fd, t, len, err;
+    uint8_t * bp;
+    char ebuff[EBUFF_SZ];
+
+    fd = sg_io_open_dd(inf, FT_SG, false, fl_mask, 0, blk_sz, ME, 0);
+    if (fd < 0)
+        return sg_convert_errno(-fd);
+    t = sg_io_reserve(fd, blk_sz, bptp, 1, true, ME, verbose);
+    if (t < 0) {
+        close(fd);
+        return sg_convert_errno(-t);
+    }
+    len = blk_sz * (*bptp);
+    if (0 != (len % psz))       /* round up to next page */
+        len = ((len / psz) + 1) * psz;
+    if (len > t)
+        len = t;
+    bp = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                         0);
+    if (MAP_FAILED == bp) {
+        err = errno;
+        snprintf(ebuff, EBUFF_SZ, ME "error using mmap() on file: %s", inf);
+        perror(ebuff);
+        close(fd);
+        return sg_convert_errno(err);
+    }
+    ifdp->fd = fd;
+    ifdp->mmap_bp = bp;
+    ifdp->mmap_len = len;
+    return 0;
+}
+
 int
 main(int argc, char * argv[])
 {
+    bool bpt_auto = false;
     bool bpt_given = false;
     bool cdbsz_given = false;
     bool do_coe = false;     /* dummy, just accept + ignore */
     bool do_sync = false;
+    bool shared = false;
     bool verbose_given = false;
     bool version_given = false;
-    int res, k, t, infd, outfd, blocks, n, flags, blocks_per, err, keylen;
+    int res, k, t, infd, outfd, blocks, n, blocks_per, err, keylen;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
     int ibs = 0;
     int in_res_sz = 0;
@@ -725,7 +840,10 @@ main(int argc, char * argv[])
     int out_res_sz = 0;
     int out_sect_sz;
     int out_type = FT_OTHER;
+    int progress_sec = 0;
     int num_dio_not_done = 0;
+    int q_head = 0;             /* for fds=K, oldest queued READ */
+    int q_num = 0;              /* READs queued */
     int ret = 0;
     int scsi_cdbsz_in = DEF_SCSI_CDBSZ;
     int scsi_cdbsz_out = DEF_SCSI_CDBSZ;
@@ -734,14 +852,20 @@ main(int argc, char * argv[])
     int64_t out_num_sect = -1;
     int64_t skip = 0;
     int64_t seek = 0;
+    int64_t q_lba = 0;          /* next block to queue a READ for */
+    int64_t q_left = 0;
     char * buf;
+    char * cp;
     char * key;
     uint8_t * wrkPos;
     uint8_t * wrkBuff = NULL;
     uint8_t * wrkMmap = NULL;
+    struct sg_pt_base * rd_ptvp = NULL;
+    struct sg_pt_base * wr_ptvp = NULL;
     char inf[INOUTF_SZ];
     char str[STR_SZ];
     char outf[INOUTF_SZ];
+    char prog_f[INOUTF_SZ];
     char ebuff[EBUFF_SZ];
     char b[80];
     struct flags_t in_flags;
@@ -754,6 +878,7 @@ main(int argc, char * argv[])
 #endif
     inf[0] = '\0';
     outf[0] = '\0';
+    prog_f[0] = '\0';
     memset(&in_flags, 0, sizeof(in_flags));
     memset(&out_flags, 0, sizeof(out_flags));
 
@@ -768,7 +893,8 @@ main(int argc, char * argv[])
             *buf++ = '\0';
         keylen = strlen(key);
         if (0 == strcmp(key,"bpt")) {
-            bpt = sg_get_num(buf);
+            bpt_auto = (0 == strcmp(buf, "auto"));
+            bpt = bpt_auto ? DEF_BLOCKS_PER_TRANSFER : sg_get_num(buf);
             if (-1 == bpt) {
                 pr2serr(ME "bad argument to 'bpt'\n");
                 return SG_LIB_SYNTAX_ERROR;
@@ -797,7 +923,14 @@ main(int argc, char * argv[])
             }   /* treat 'count=-1' as calculate count (same as not given) */
         } else if (0 == strcmp(key,"dio"))
             out_flags.dio = !! sg_get_num(buf);
-        else if (0 == strcmp(key,"fua")) {
+        else if (0 == strcmp(key,"fds")) {
+            num_in_fds = sg_get_num(buf);
+            if ((num_in_fds < 1) || (num_in_fds > MAX_IN_FDS)) {
+                pr2serr(ME "bad argument to 'fds', expect 1 to %d\n",
+                        MAX_IN_FDS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"fua")) {
             n = sg_get_num(buf);
             if (n & 1)
                 out_flags.fua = true;
@@ -841,6 +974,20 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'obs'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "progress")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            progress_sec = sg_get_num(buf);
+            if (progress_sec < 1) {
+                pr2serr(ME "bad argument to 'progress=', expect SEC[,FILE] "
+                        "with SEC > 0\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (cp && *cp) {
+                memcpy(prog_f, cp, INOUTF_SZ - 1);
+                prog_f[INOUTF_SZ - 1] = '\0';
+            }
         } else if (0 == strcmp(key,"seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
@@ -946,6 +1093,15 @@ main(int argc, char * argv[])
        SG_IO ioctl. So reduce it in that case. */
     if ((blk_sz >= 2048) && (! bpt_given))
         bpt = DEF_BLOCKS_PER_2048TRANSFER;
+    if (bpt_auto) {
+        bpt = auto_bpt(inf, outf, (blk_sz >= 2048) ?
+                       DEF_BLOCKS_PER_2048TRANSFER : DEF_BLOCKS_PER_TRANSFER);
+        if ((6 == scsi_cdbsz_in) || (6 == scsi_cdbsz_out))
+            bpt = (bpt > 256) ? 256 : bpt;
+        if (verbose)
+            pr2serr("bpt=auto: using bpt=%d (%d bytes per transfer)\n",
+                    bpt, bpt * blk_sz);
+    }
 
 #ifdef DEBUG
     pr2serr(ME "if=%s skip=%" PRId64 " of=%s seek=%" PRId64 " count=%" PRId64
@@ -959,10 +1115,10 @@ main(int argc, char * argv[])
     infd = STDIN_FILENO;
     outfd = STDOUT_FILENO;
     if (inf[0] && ('-' != inf[0])) {
-        in_type = dd_filetype(inf);
+        in_type = sg_io_filetype(inf, 0, verbose);
         if (verbose)
             pr2serr(" >> Input file type: %s\n",
-                    dd_filetype_str(in_type, ebuff));
+                    sg_io_filetype_str(in_type, EBUFF_SZ, ebuff));
 
         if (FT_ERROR == in_type) {
             pr2serr(ME "unable to access %s\n", inf);
@@ -971,42 +1127,24 @@ main(int argc, char * argv[])
             pr2serr(ME "unable to use scsi tape device %s\n", inf);
             return SG_LIB_FILE_ERROR;
         } else if (FT_SG == in_type) {
-            flags = O_RDWR | O_NONBLOCK;
-            if (in_flags.direct)
-                flags |= O_DIRECT;
-            if (in_flags.excl)
-                flags |= O_EXCL;
-            if (in_flags.dsync)
-                flags |= O_SYNC;
-            if ((infd = open(inf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff, EBUFF_SZ,
-                         ME "could not open %s for sg reading", inf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            }
+            infd = sg_io_open_dd(inf, in_type, false, open_fl_mask(&in_flags),
+                                 0, blk_sz, ME, verbose);
+            if (infd < 0)
+                return sg_convert_errno(-infd);
             res = ioctl(infd, SG_GET_VERSION_NUM, &t);
             if ((res < 0) || (t < 30122)) {
                 pr2serr(ME "sg driver prior to 3.1.22\n");
                 return SG_LIB_FILE_ERROR;
             }
+            /* mmap-ed IO cannot go beyond the reserved buffer */
+            t = sg_io_reserve(infd, blk_sz, &bpt, 1, true, ME, verbose);
+            if (t < 0)
+                return sg_convert_errno(-t);
             in_res_sz = blk_sz * bpt;
             if (0 != (in_res_sz % psz)) /* round up to next page */
                 in_res_sz = ((in_res_sz / psz) + 1) * psz;
-            if (ioctl(infd, SG_GET_RESERVED_SIZE, &t) < 0) {
-                err = errno;
-                perror(ME "SG_GET_RESERVED_SIZE error");
-                return sg_convert_errno(err);
-            }
-            if (t < MIN_RESERVED_SIZE)
-                t = MIN_RESERVED_SIZE;
-            if (in_res_sz > t) {
-                if (ioctl(infd, SG_SET_RESERVED_SIZE, &in_res_sz) < 0) {
-                    err = errno;
-                    perror(ME "SG_SET_RESERVED_SIZE error");
-                    return sg_convert_errno(err);
-                }
-            }
+            if (in_res_sz > t)
+                in_res_sz = t;
             wrkMmap = (uint8_t *)mmap(NULL, in_res_sz,
                                  PROT_READ | PROT_WRITE, MAP_SHARED, infd, 0);
             if (MAP_FAILED == wrkMmap) {
@@ -1016,84 +1154,52 @@ main(int argc, char * argv[])
                 perror(ebuff);
                 return sg_convert_errno(err);
             }
-        } else {
-            flags = O_RDONLY;
-            if (in_flags.direct)
-                flags |= O_DIRECT;
-            if (in_flags.excl)
-                flags |= O_EXCL;
-            if (in_flags.dsync)
-                flags |= O_SYNC;
-            if ((infd = open(inf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff, EBUFF_SZ,
-                         ME "could not open %s for reading", inf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            }
-            else if (skip > 0) {
-                off64_t offset = skip;
-
-                offset *= blk_sz;       /* could exceed 32 bits here! */
-                if (lseek64(infd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, ME "couldn't skip to "
-                             "required position on %s", inf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-                if (verbose)
-                    pr2serr("  >> skip: lseek64 SEEK_SET, byte offset=0x%"
-                            PRIx64 "\n", (uint64_t)offset);
+            in_fds[0].fd = infd;
+            in_fds[0].mmap_bp = wrkMmap;
+            in_fds[0].mmap_len = in_res_sz;
+            for (k = 1; k < num_in_fds; ++k) {
+                res = open_in_again(inf, open_fl_mask(&in_flags) &
+                                    ~SG_IO_OPEN_EXCL, &bpt, psz, in_fds + k);
+                if (res)
+                    return res;
             }
+        } else {
+            infd = sg_io_open_dd(inf, in_type, false, open_fl_mask(&in_flags),
+                                 skip, blk_sz, ME, verbose);
+            if (infd < 0)
+                return sg_convert_errno(-infd);
         }
     }
 
     if (outf[0] && ('-' != outf[0])) {
-        out_type = dd_filetype(outf);
+        out_type = sg_io_filetype(outf, 0, verbose);
         if (verbose)
             pr2serr(" >> Output file type: %s\n",
-                    dd_filetype_str(out_type, ebuff));
+                    sg_io_filetype_str(out_type, EBUFF_SZ, ebuff));
 
         if (FT_ST == out_type) {
             pr2serr(ME "unable to use scsi tape device %s\n", outf);
             return SG_LIB_FILE_ERROR;
         }
         else if (FT_SG == out_type) {
-            flags = O_RDWR | O_NONBLOCK;
-            if (out_flags.direct)
-                flags |= O_DIRECT;
-            if (out_flags.excl)
-                flags |= O_EXCL;
-            if (out_flags.dsync)
-                flags |= O_SYNC;
-            if ((outfd = open(outf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff, EBUFF_SZ, ME "could not open %s for "
-                         "sg writing", outf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            }
+            outfd = sg_io_open_dd(outf, out_type, true,
+                                  open_fl_mask(&out_flags), 0, blk_sz, ME,
+                                  verbose);
+            if (outfd < 0)
+                return sg_convert_errno(-outfd);
             res = ioctl(outfd, SG_GET_VERSION_NUM, &t);
             if ((res < 0) || (t < 30122)) {
                 pr2serr(ME "sg driver prior to 3.1.22\n");
                 return SG_LIB_FILE_ERROR;
             }
-            if (ioctl(outfd, SG_GET_RESERVED_SIZE, &t) < 0) {
-                err = errno;
-                perror(ME "SG_GET_RESERVED_SIZE error");
-                return sg_convert_errno(err);
-            }
-           if (t < MIN_RESERVED_SIZE)
-                t = MIN_RESERVED_SIZE;
+            t = sg_io_reserve(outfd, blk_sz, &bpt, 1, true, ME, verbose);
+            if (t < 0)
+                return sg_convert_errno(-t);
             out_res_sz = blk_sz * bpt;
-            if (out_res_sz > t) {
-                if (ioctl(outfd, SG_SET_RESERVED_SIZE, &out_res_sz) < 0) {
-                    err = errno;
-                    perror(ME "SG_SET_RESERVED_SIZE error");
-                    return sg_convert_errno(err);
-                }
-            }
+            if (0 != (out_res_sz % psz)) /* round up to next page */
+                out_res_sz = ((out_res_sz / psz) + 1) * psz;
+            if (out_res_sz > t)
+                out_res_sz = t;
             if (NULL == wrkMmap) {
                 wrkMmap = (uint8_t *)mmap(NULL, out_res_sz,
                                 PROT_READ | PROT_WRITE, MAP_SHARED, outfd, 0);
@@ -1109,48 +1215,11 @@ main(int argc, char * argv[])
         else if (FT_DEV_NULL == out_type)
             outfd = -1; /* don't bother opening */
         else {
-            if (FT_RAW != out_type) {
-                flags = O_WRONLY | O_CREAT;
-                if (out_flags.direct)
-                    flags |= O_DIRECT;
-                if (out_flags.excl)
-                    flags |= O_EXCL;
-                if (out_flags.dsync)
-                    flags |= O_SYNC;
-                if (out_flags.append)
-                    flags |= O_APPEND;
-                if ((outfd = open(outf, flags, 0666)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ,
-                             ME "could not open %s for writing", outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            else {
-                if ((outfd = open(outf, O_WRONLY)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, ME "could not open %s "
-                             "for raw writing", outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            if (seek > 0) {
-                off64_t offset = seek;
-
-                offset *= blk_sz;       /* could exceed 32 bits here! */
-                if (lseek64(outfd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, ME "couldn't seek to "
-                             "required position on %s", outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-                if (verbose)
-                    pr2serr("   >> seek: lseek64 SEEK_SET, byte offset=0x%"
-                            PRIx64 "\n", (uint64_t)offset);
-            }
+            outfd = sg_io_open_dd(outf, out_type, true,
+                                  open_fl_mask(&out_flags), seek, blk_sz, ME,
+                                  verbose);
+            if (outfd < 0)
+                return sg_convert_errno(-outfd);
         }
     }
     if ((STDIN_FILENO == infd) && (STDOUT_FILENO == outfd)) {
@@ -1159,16 +1228,23 @@ main(int argc, char * argv[])
         pr2serr("For more information use '--help'\n");
         return SG_LIB_CONTRADICT;
     }
+    if (FT_SG == in_type)
+        sg_ds_init(&in_ds, infd, (verbose > 0) ? verbose - 1 : 0);
+    if (FT_SG == out_type)
+        sg_ds_init(&out_ds, outfd, (verbose > 0) ? verbose - 1 : 0);
     if (dd_count < 0) {
         in_num_sect = -1;
         if (FT_SG == in_type) {
-            res = scsi_read_capacity(infd, &in_num_sect, &in_sect_sz);
+            res = sg_io_read_capacity(&in_ds, &in_num_sect, &in_sect_sz,
+                                      verbose);
             if (SG_LIB_CAT_UNIT_ATTENTION == res) {
                 pr2serr("Unit attention(in), continuing\n");
-                res = scsi_read_capacity(infd, &in_num_sect, &in_sect_sz);
+                res = sg_io_read_capacity(&in_ds, &in_num_sect, &in_sect_sz,
+                                          verbose);
             } else if (SG_LIB_CAT_ABORTED_COMMAND == res) {
                 pr2serr("Aborted command(in), continuing\n");
-                res = scsi_read_capacity(infd, &in_num_sect, &in_sect_sz);
+                res = sg_io_read_capacity(&in_ds, &in_num_sect, &in_sect_sz,
+                                          verbose);
             }
             if (0 != res) {
                 sg_get_category_sense_str(res, sizeof(b), b, verbose);
@@ -1176,7 +1252,8 @@ main(int argc, char * argv[])
                 in_num_sect = -1;
             }
         } else if (FT_BLOCK == in_type) {
-            if (0 != read_blkdev_capacity(infd, &in_num_sect, &in_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(infd, &in_num_sect, &in_sect_sz,
+                                           verbose)) {
                 pr2serr("Unable to read block capacity on %s\n", inf);
                 in_num_sect = -1;
             }
@@ -1191,13 +1268,16 @@ main(int argc, char * argv[])
 
         out_num_sect = -1;
         if (FT_SG == out_type) {
-            res = scsi_read_capacity(outfd, &out_num_sect, &out_sect_sz);
+            res = sg_io_read_capacity(&out_ds, &out_num_sect, &out_sect_sz,
+                                      verbose);
             if (SG_LIB_CAT_UNIT_ATTENTION == res) {
                 pr2serr("Unit attention(out), continuing\n");
-                res = scsi_read_capacity(outfd, &out_num_sect, &out_sect_sz);
+                res = sg_io_read_capacity(&out_ds, &out_num_sect, &out_sect_sz,
+                                          verbose);
             } else if (SG_LIB_CAT_ABORTED_COMMAND == res) {
                 pr2serr("Aborted command(out), continuing\n");
-                res = scsi_read_capacity(outfd, &out_num_sect, &out_sect_sz);
+                res = sg_io_read_capacity(&out_ds, &out_num_sect, &out_sect_sz,
+                                          verbose);
             }
             if (0 != res) {
                 sg_get_category_sense_str(res, sizeof(b), b, verbose);
@@ -1205,8 +1285,8 @@ main(int argc, char * argv[])
                 out_num_sect = -1;
             }
         } else if (FT_BLOCK == out_type) {
-            if (0 != read_blkdev_capacity(outfd, &out_num_sect,
-                                          &out_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(outfd, &out_num_sect,
+                                           &out_sect_sz, verbose)) {
                 pr2serr("Unable to read block capacity on %s\n", outf);
                 out_num_sect = -1;
             }
@@ -1258,23 +1338,20 @@ main(int argc, char * argv[])
         pr2serr(">>> dio only performed on 'of' side when 'if' is an sg "
                 "device\n");
     }
-    if (out_flags.dio) {
-        int fd;
-        char c;
-
-        if ((fd = open(proc_allow_dio, O_RDONLY)) >= 0) {
-            if (1 == read(fd, &c, 1)) {
-                if ('0' == c)
-                    pr2serr(">>> %s set to '0' but should be set to '1' for "
-                            "direct IO\n", proc_allow_dio);
-            }
-            close(fd);
-        }
-    }
+    if (out_flags.dio)
+        sg_io_dio_warn();
 
+    if ((num_in_fds > 1) && ((FT_SG != in_type) || in_flags.excl)) {
+        pr2serr("fds=%d needs IFILE to be a sg device and does not work "
+                "with iflag=excl\n", num_in_fds);
+        return SG_LIB_CONTRADICT;
+    }
     if (wrkMmap) {
         wrkPos = wrkMmap;
     } else {
+        if (verbose)
+            pr2serr("neither IFILE nor OFILE is a sg device so mmap-ed IO "
+                    "is not in effect\n");
         wrkPos = (uint8_t *)sg_memalign(blk_sz * bpt, 0, &wrkBuff,
                                         verbose > 3);
         if (NULL == wrkPos) {
@@ -1298,26 +1375,125 @@ main(int argc, char * argv[])
         start_tm_valid = true;
     }
     req_count = dd_count;
+    if (progress_sec > 0) {
+        ret = sg_io_progress_open(&progress, "sgm_dd", progress_sec, prog_f,
+                                  blk_sz, req_count, ME);
+        if (ret)
+            goto fini;
+    }
 
-    if (verbose && (dd_count > 0) && (! out_flags.dio) &&
-        (FT_SG == in_type) && (FT_SG == out_type))
-        pr2serr("Since both 'if' and 'of' are sg devices, only do mmap-ed "
-                "transfers on 'if'\n");
+    if ((dd_count > 0) && (FT_SG == in_type) && (FT_SG == out_type) &&
+        (1 == num_in_fds) &&
+        (! (in_flags.noshare || out_flags.noshare || out_flags.dio))) {
+        /* each WRITE then takes its data from the READ's kernel buffer */
+        res = scsi_pt_share_fds(infd, outfd, (verbose > 1) ? verbose - 1 : 0);
+        if (0 == res) {
+            rd_ptvp = construct_scsi_pt_obj_with_fd(infd, verbose);
+            wr_ptvp = construct_scsi_pt_obj_with_fd(outfd, verbose);
+            if ((NULL == rd_ptvp) || (NULL == wr_ptvp)) {
+                pr2serr("Not enough user memory\n");
+                ret = sg_convert_errno(ENOMEM);
+                goto fini;
+            }
+            shared = true;
+        } else if (verbose)
+            pr2serr("'if' and 'of' can't share requests (%s)\n",
+                    (res < 0) ? safe_strerror(-res) :
+                                "needs sg v4 driver");
+    }
+    if (verbose && (dd_count > 0) && (FT_SG == in_type) &&
+        (FT_SG == out_type)) {
+        if (shared)
+            pr2serr("Since 'if' and 'of' share requests, data is written "
+                    "from the kernel\nbuffer it was read into\n");
+        else if (! out_flags.dio)
+            pr2serr("Since both 'if' and 'of' are sg devices, only do "
+                    "mmap-ed transfers on 'if'\n");
+    }
 
+    q_lba = skip;
+    q_left = dd_count;
     while (dd_count > 0) {
         blocks = (dd_count > blocks_per) ? blocks_per : dd_count;
-        if (FT_SG == in_type) {
+        if (shared) {
+            bool wr_err;
+
+            ret = sg_shared_rw(rd_ptvp, wr_ptvp, blocks, skip, seek, blk_sz,
+                               scsi_cdbsz_in, scsi_cdbsz_out, &in_flags,
+                               &out_flags, &wr_err);
+            if ((SG_LIB_CAT_UNIT_ATTENTION == ret) ||
+                (SG_LIB_CAT_ABORTED_COMMAND == ret)) {
+                pr2serr("Unit attention or aborted command, continuing "
+                        "(%s)\n", wr_err ? "w" : "r");
+                ++num_retries;
+                ret = sg_shared_rw(rd_ptvp, wr_ptvp, blocks, skip, seek,
+                                   blk_sz, scsi_cdbsz_in, scsi_cdbsz_out,
+                                   &in_flags, &out_flags, &wr_err);
+            }
+            if (0 != ret) {
+                ++unrecovered_errs;
+                if (wr_err) {
+                    in_full += blocks;
+                    pr2serr("sg_write (shared) failed, seek=%" PRId64 "\n",
+                            seek);
+                } else
+                    pr2serr("sg_read (shared) failed, skip=%" PRId64 "\n",
+                            skip);
+                break;
+            }
+            in_full += blocks;
+        } else if (num_in_fds > 1) {
+            struct in_fd_t * ifdp;
+
+            /* top up the READs queued ahead, one per file descriptor */
+            ret = 0;
+            while ((0 == ret) && (q_num < num_in_fds) && (q_left > 0)) {
+                ifdp = in_fds + ((q_head + q_num) % num_in_fds);
+                n = (q_left > blocks_per) ? blocks_per : (int)q_left;
+                ret = sg_read_submit(ifdp, n, q_lba, blk_sz, scsi_cdbsz_in,
+                                     in_flags.fua, in_flags.dpo);
+                if (0 == ret) {
+                    q_lba += n;
+                    q_left -= n;
+                    ++q_num;
+                }
+            }
+            ifdp = in_fds + q_head;
+            if (q_num > 0) {    /* oldest is the chunk starting at skip */
+                ret = sg_read_reap(ifdp);
+                q_head = (q_head + 1) % num_in_fds;
+                --q_num;
+            }
+            if ((SG_LIB_CAT_UNIT_ATTENTION == ret) ||
+                (SG_LIB_CAT_ABORTED_COMMAND == ret)) {
+                pr2serr("Unit attention or aborted command, continuing "
+                        "(r)\n");
+                ++num_retries;
+                ret = sg_read(ifdp->fd, NULL, blocks, skip, blk_sz,
+                              scsi_cdbsz_in, in_flags.fua, in_flags.dpo,
+                              true);
+            }
+            if (0 != ret) {
+                ++unrecovered_errs;
+                pr2serr("sg_read failed, skip=%" PRId64 "\n", skip);
+                break;
+            }
+            in_full += blocks;
+            wrkPos = ifdp->mmap_bp;
+        } else if (FT_SG == in_type) {
             ret = sg_read(infd, wrkPos, blocks, skip, blk_sz, scsi_cdbsz_in,
                           in_flags.fua, in_flags.dpo, true);
             if ((SG_LIB_CAT_UNIT_ATTENTION == ret) ||
                 (SG_LIB_CAT_ABORTED_COMMAND == ret)) {
                 pr2serr("Unit attention or aborted command, continuing "
                         "(r)\n");
+                ++num_retries;
                 ret = sg_read(infd, wrkPos, blocks, skip, blk_sz,
                               scsi_cdbsz_in, in_flags.fua, in_flags.dpo,
                               true);
             }
             if (0 != ret) {
+                ++unrecovered_errs;
                 pr2serr("sg_read failed, skip=%" PRId64 "\n", skip);
                 break;
             }
@@ -1325,9 +1501,7 @@ main(int argc, char * argv[])
                 in_full += blocks;
         }
         else {
-            while (((res = read(infd, wrkPos, blocks * blk_sz)) < 0) &&
-                   ((EINTR == errno) || (EAGAIN == errno)))
-                ;
+            res = sg_io_read_retry(infd, wrkPos, blocks * blk_sz);
             if (verbose > 2)
                 pr2serr("read(unix): count=%d, res=%d\n", blocks * blk_sz,
                         res);
@@ -1352,7 +1526,9 @@ main(int argc, char * argv[])
         if (0 == blocks)
             break;      /* read nothing so leave loop */
 
-        if (FT_SG == out_type) {
+        if (shared)
+            out_full += blocks; /* written from the READ's kernel buffer */
+        else if (FT_SG == out_type) {
             bool dio_res = out_flags.dio;
             bool do_mmap = (FT_SG != in_type);
 
@@ -1361,12 +1537,14 @@ main(int argc, char * argv[])
             if ((SG_LIB_CAT_UNIT_ATTENTION == ret) ||
                 (SG_LIB_CAT_ABORTED_COMMAND == ret)) {
                 pr2serr("Unit attention or aborted command, continuing (w)\n");
+                ++num_retries;
                 dio_res = out_flags.dio;
                 ret = sg_write(outfd, wrkPos, blocks, seek, blk_sz,
                                scsi_cdbsz_out, out_flags.fua, out_flags.dpo,
                                do_mmap, &dio_res);
             }
             if (0 != ret) {
+                ++unrecovered_errs;
                 pr2serr("sg_write failed, seek=%" PRId64 "\n", seek);
                 break;
             }
@@ -1379,9 +1557,7 @@ main(int argc, char * argv[])
         else if (FT_DEV_NULL == out_type)
             out_full += blocks; /* act as if written out without error */
         else {
-            while (((res = write(outfd, wrkPos, blocks * blk_sz)) < 0) &&
-                   ((EINTR == errno) || (EAGAIN == errno)))
-                ;
+            res = sg_io_write_retry(outfd, wrkPos, blocks * blk_sz);
             if (verbose > 2)
                 pr2serr("write(unix): count=%d, res=%d\n", blocks * blk_sz,
                         res);
@@ -1406,7 +1582,13 @@ main(int argc, char * argv[])
             dd_count -= blocks;
         skip += blocks;
         seek += blocks;
+        progress_out(false, (FT_SG == in_type) ? infd : -1, scsi_cdbsz_in,
+                     (FT_SG == out_type) ? outfd : -1, scsi_cdbsz_out);
     }
+    if (num_in_fds > 1)
+        sg_read_drain();
+    progress_out(true, (FT_SG == in_type) ? infd : -1, scsi_cdbsz_in,
+                 (FT_SG == out_type) ? outfd : -1, scsi_cdbsz_out);
 
     if (do_time)
         calc_duration_throughput(false);
@@ -1426,10 +1608,21 @@ main(int argc, char * argv[])
     }
 
 fini:
+    sg_io_progress_close(&progress);
+    if (rd_ptvp)
+        destruct_scsi_pt_obj(rd_ptvp);
+    if (wr_ptvp)
+        destruct_scsi_pt_obj(wr_ptvp);
     if (wrkBuff)
         free(wrkBuff);
     if (STDIN_FILENO != infd)
         close(infd);
+    for (k = 1; k < num_in_fds; ++k) {
+        if (in_fds[k].mmap_bp) {
+            munmap(in_fds[k].mmap_bp, in_fds[k].mmap_len);
+            close(in_fds[k].fd);
+        }
+    }
     if ((STDOUT_FILENO != outfd) && (FT_DEV_NULL != out_type))
         close(outfd);
     if ((0 != dd_count) && (0 == dry_run)) {
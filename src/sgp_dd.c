@@ -45,16 +45,21 @@
 #include <errno.h>
 #include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
+#include <math.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/sysmacros.h>
+#include <dirent.h>
 #ifndef major
 #include <sys/types.h>
 #endif
 #include <sys/time.h>
+#include <sys/syscall.h>
 #include <linux/major.h>        /* for MEM_MAJOR, SCSI_GENERIC_MAJOR, etc */
 #include <linux/fs.h>           /* for BLKSSZGET and friends */
 
@@ -78,12 +83,21 @@
 #endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
+#include "sg_cmds_extra.h"
 #include "sg_io_linux.h"
+#include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#define SGP_HAVE_URING 1
+#endif
+
 
-static const char * version_str = "5.73 20190618";
+static const char * version_str = "5.82 20261014";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -93,7 +107,6 @@ static const char * version_str = "5.73 20190618";
 
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
-#define READ_CAP_REPLY_LEN 8
 #define RCAP16_REPLY_LEN 32
 
 #define DEF_TIMEOUT 60000       /* 60,000 millisecs == 60 seconds */
@@ -101,24 +114,129 @@ static const char * version_str = "5.73 20190618";
 #define SGP_READ10 0x28
 #define SGP_WRITE10 0x2a
 #define DEF_NUM_THREADS 4
-#define MAX_NUM_THREADS 1024  /* was SG_MAX_QUEUE (16) but no longer applies */
+#define AUTO_MAX_THREADS 16     /* most threads engine=auto will use */
+#define AUTO_ELEMS 4            /* elems= chosen by engine=auto */
 
-#ifndef RAW_MAJOR
-#define RAW_MAJOR 255   /*unlikely value */
+#define ENGINE_DEF 0            /* engine= not given */
+#define ENGINE_AUTO 1
+#define ENGINE_SYNC 2           /* one READ per worker thread at a time */
+#define ENGINE_QUEUE 3          /* several READs in flight per thread */
+#define MAX_NUM_THREADS 1024  /* was SG_MAX_QUEUE (16) but no longer applies */
+#define LOG_RING_SZ (64 * 1024) /* per thread, debug output buffering */
+#define LOG_DRAIN_MS 10
+#define MAX_REORDER (64 * 1024) /* in units of BPT blocks */
+#define MAX_ELEMS 256           /* request elements per worker thread */
+#define MAX_NUMA_NODES 1024
+
+#define SGP_WRITE_SAME16 0x93
+#define SGP_UNMAP 0x42
+#define UNMAP_PARAM_LEN 24      /* header plus one block descriptor */
+#define VPD_BLOCK_LIMITS 0xb0
+#define VPD_LB_PROVISIONING 0xb2
+#define VPD_BLOCK_LIMITS_LEN 64
+#define DEALLOC_NONE 0          /* sparse chunk on sg OFILE is bypassed */
+#define DEALLOC_WS16 1          /* ... WRITE SAME(16) with UNMAP bit set */
+#define DEALLOC_UNMAP 2         /* ... UNMAP, LBPRZ set so reads as zeros */
+#define SGP_ZONING_OUT 0x94
+#define SGP_ZONING_IN 0x95
+#define SGP_REPORT_ZONES_SA 0x0
+#define SGP_FINISH_ZONE_SA 0x2
+#define SGP_RESET_WP_SA 0x4
+#define ZBC_CDB_LEN 16
+#define ZBC_RZ_BUFF_LEN (64 * 1024)
+#define ZBC_ZT_CONV 1           /* zone types from REPORT ZONES */
+#define ZBC_ZT_SWP 3            /* sequential write preferred */
+#define ZBC_ZC_EMPTY 0x1        /* zone conditions */
+#define ZBC_ZC_RDONLY 0xd
+#define ZBC_ZC_FULL 0xe
+#define ZBC_ZC_OFFLINE 0xf
+#define VPD_ZBDC 0xb6           /* Zoned Block Device Characteristics */
+#define VPD_ZBDC_LEN 64
+#define SGP_SA_IN16 0x9e         /* SERVICE ACTION IN(16) */
+#define SGP_STREAM_CONTROL_SA 0x14
+#define STREAM_CTL_OPEN 0x1
+#define STREAM_CTL_CLOSE 0x2
+#define STREAM_CTL_RESP_LEN 8
+#define SGP_WRITE_STREAM16 0x9a
+#define MAX_STREAMS 256         /* streams= upper limit */
+#define MAX_FAN_OUT 4           /* of= may be given up to this many times */
+#define FAN_CHUNKS_PER_THR 2    /* chunks queued for extra of= per thread */
+#define MAX_STRIPE 16           /* sg devices in a striped if= or of= */
+#define MAX_MPATH 16            /* paths to one LU in if= or of= */
+#define MPATH_RR 1              /* mpath=rr */
+#define MPATH_LO 2              /* mpath=lo, least outstanding */
+#define MPATH_DI_LEN 1024       /* Device Identification VPD page */
+#define MPATH_REF_LEN 8192      /* REPORT REFERRALS response */
+#define MPATH_MAX_REF 65536     /* user data segments kept from it */
+/* Indexes of the per thread counters in struct thr_stats */
+#define TS_READS 0              /* sg READs completed */
+#define TS_WRITES 1             /* sg WRITEs (and deallocations) done */
+#define TS_RD_BLKS 2            /* blocks read by them */
+#define TS_WR_BLKS 3            /* blocks written */
+#define TS_BYTES 4              /* data transferred, both directions */
+#define TS_RETRIES 5            /* commands to be sent again */
+#define TS_RECOVERED 6
+#define TS_UNRECOVERED 7
+#define TS_DIO_INCOMPLETE 8     /* direct IO done as indirect IO */
+#define TS_RESIDS 9             /* sum of residual counts */
+#define TS_LAT 10               /* first bucket of the latency histogram */
+#define TS_LAT_BUCKETS 32       /* bucket k: [2^k, 2^(k+1)) microseconds */
+#define TS_NUM (TS_LAT + TS_LAT_BUCKETS)
+#define PAT_SEQ 0               /* pattern=seq, the default */
+#define PAT_RAND 1              /* pattern=rand */
+#define PAT_ZIPF 2              /* pattern=zipf[,THETA] */
+#define DEF_ZIPF_THETA 0.99
+#define ZIPF_EXACT_MAX 1000000  /* terms of zeta() summed one at a time */
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1        /* from <linux/mempolicy.h> */
 #endif
 
-#define FT_OTHER 1              /* filetype other than one of the following */
-#define FT_SG 2                 /* filetype is sg char device */
-#define FT_RAW 4                /* filetype is raw char device */
-#define FT_DEV_NULL 8           /* either "/dev/null" or "." as filename */
-#define FT_ST 16                /* filetype is st char device (tape) */
-#define FT_BLOCK 32             /* filetype is a block device */
-#define FT_ERROR 64             /* couldn't "stat" file */
-
-#define DEV_NULL_MINOR_NUM 3
+#define FT_OTHER SG_IO_FT_OTHER
+#define FT_SG SG_IO_FT_SG
+#define FT_RAW SG_IO_FT_RAW
+#define FT_DEV_NULL SG_IO_FT_DEV_NULL
+#define FT_ST SG_IO_FT_ST
+#define FT_BLOCK SG_IO_FT_BLOCK
+#define FT_ERROR SG_IO_FT_ERROR
 
 #define EBUFF_SZ 768
 
+#define SGP_CACHE_LINE 64          /* typical, too big is harmless */
+#define SGP_CL_ALIGNED __attribute__((aligned(SGP_CACHE_LINE)))
+
+#ifdef HAVE_C11_ATOMICS
+
+typedef _Atomic int64_t sgp_atomic_i64;
+typedef atomic_bool sgp_atomic_bool;
+
+#define SGP_FETCH_ADD(_p, _v) atomic_fetch_add(_p, _v)
+/* For counters only written by the thread that owns them, other threads
+ * just read them: no read-modify-write bus locking is needed */
+#define SGP_OWN_ADD(_p, _v)                                             \
+    atomic_store_explicit(_p, atomic_load_explicit(_p,                  \
+                          memory_order_relaxed) + (_v), memory_order_relaxed)
+#define SGP_OWN_LOAD(_p) atomic_load_explicit(_p, memory_order_relaxed)
+
+#else
+
+typedef int64_t sgp_atomic_i64;
+typedef volatile bool sgp_atomic_bool;
+
+static pthread_mutex_t fa_mut = PTHREAD_MUTEX_INITIALIZER;
+
+#define SGP_FETCH_ADD(_p, _v)                           \
+    ( { int64_t _r;                                     \
+        pthread_mutex_lock(&fa_mut);                    \
+        _r = *(_p);                                     \
+        *(_p) += (_v);                                  \
+        pthread_mutex_unlock(&fa_mut);                  \
+        _r; } )
+#define SGP_OWN_ADD(_p, _v) (*(_p) += (_v))
+#define SGP_OWN_LOAD(_p) (*(_p))
+
+#endif
+
 struct flags_t {
     bool append;
     bool coe;
@@ -128,40 +246,210 @@ struct flags_t {
     bool dsync;
     bool excl;
     bool fua;
+    bool sparse;
+    bool zbc;
+    bool zfinish;
+};
+
+typedef struct qd_control
+{       /* adaptive limit on commands in flight to one sg device */
+    bool active;
+    int inflight;               /* -\ */
+    struct sg_pt_qdepth ctl;    /*  | */
+    pthread_mutex_t mutex;      /*  | */
+    pthread_cond_t cv;          /* -/ */
+} Qd_ctl;
+
+struct resume_t
+{       /* resume=CFILE checkpoint, mmap-ed header then bitmap */
+    int fd;
+    size_t len;
+    uint8_t * mp;           /* NULL when resume= not given */
+    int64_t chunks;
+    int64_t done_at_start;  /* chunks already copied when opened */
+};
+
+struct fan_chunk
+{       /* chunk read once and queued to each extra of= (fan-out) */
+    uint8_t * buffp;            /* from sg_hugebuf_get(), put by last ref */
+    int64_t blk;                /* block address on OFILE (seek applied) */
+    int num_blks;
+    int refs;                   /* extra of= yet to write it */
+};
+
+struct fan_target
+{       /* second and later of=, each with its own writer threads */
+    struct request_collection * clp;
+    const char * fname;
+    int outfd;
+    struct fan_chunk ** q;      /* FIFO of fan_max entries, uses fan_mutex */
+    int q_head;
+    int q_len;
+    int64_t out_blks;           /* blocks written, uses fan_mutex */
+    pthread_cond_t cv;          /* signalled when q_len > 0 or stopping */
+};
+
+struct stripe_t
+{       /* if= or of= given as a list of sg devices with stripe=BLKS */
+    int num;                    /* member devices, 0 -> not striped */
+    int64_t stripe;             /* blocks on one member before the next */
+    int fd[MAX_STRIPE];         /* fd[0] is also infd or outfd */
+    const char * fname[MAX_STRIPE];
+};
+
+struct mpath_ref
+{       /* a user data segment from REPORT REFERRALS */
+    uint64_t first;             /* first and last LBA of the segment */
+    uint64_t last;
+    uint32_t paths;             /* bit k set: send down path k, 0 -> any */
+};
+
+struct mpath_t
+{       /* if= or of= given as paths to one logical unit with mpath= */
+    int num;                    /* paths, 0 -> not multipath */
+    int policy;                 /* MPATH_RR or MPATH_LO */
+    int use_num;                /* paths that commands are sent down */
+    int use[MAX_MPATH];         /* indexes into fd[] of those */
+    int fd[MAX_MPATH];          /* fd[0] is also infd or outfd */
+    int tpg[MAX_MPATH];         /* target port group, -1 if not reported */
+    int alua[MAX_MPATH];        /* asymmetric access state, -1 unknown */
+    const char * fname[MAX_MPATH];
+    char found[MAX_MPATH][48];  /* names of paths from mpath=...,auto */
+    int ref_num;                /* user data segments in ref */
+    struct mpath_ref * ref;     /* in ascending LBA order, NULL if none */
+    sgp_atomic_i64 next SGP_CL_ALIGNED; /* where the next pick starts */
+    sgp_atomic_i64 routed;      /* commands sent by a referral */
+    sgp_atomic_i64 outst[MAX_MPATH];    /* commands in flight per path */
+    sgp_atomic_i64 cmds[MAX_MPATH];     /* commands sent per path */
+};
+
+struct thr_stats
+{       /* one for each worker thread, only that thread updates it. Summed
+         * by stats_sum() when output, so the per command path takes no
+         * lock to count */
+    sgp_atomic_i64 c[TS_NUM] SGP_CL_ALIGNED;    /* indexed by TS_* */
+};
+
+struct zbc_zone
+{       /* a zone of an oflag=zbc OFILE that the copy writes to */
+    int64_t start;
+    int64_t len;
+    int64_t wp;                 /* next block to write, uses out_mutex */
+    uint8_t type;               /* ZBC_ZT_* */
+    uint8_t cond;               /* ZBC_ZC_* as reported before the copy */
+    bool busy;                  /* a WRITE is in flight, uses out_mutex */
+};
+
+struct zbc_t
+{       /* oflag=zbc: the zones holding blocks SEEK to SEEK+COUNT-1 */
+    int num;                    /* 0 -> oflag=zbc not given */
+    struct zbc_zone * zp;       /* ascending, each follows the one before */
+    int max_open;               /* write pointer zones written at once */
+    int active;                 /* -\ write pointer zones being written */
+    int next_open;              /* -/ zones opened in order, uses out_mutex */
+};
+
+struct zipf_t
+{       /* pattern=zipf over n chunks, see zipf_init() */
+    int64_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
 };
 
 typedef struct request_collection
 {       /* one instance visible to all threads */
+    /* following members are constant while worker threads run */
     int infd;
     int64_t skip;
     int in_type;
     int cdbsz_in;
     struct flags_t in_flags;
-    int64_t in_blk;                 /* -\ next block address to read */
-    int64_t in_count;               /*  | blocks remaining for next read */
-    int64_t in_rem_count;           /*  | count of remaining in blocks */
-    int in_partial;                   /*  | */
-    bool in_stop;                     /*  | */
-    pthread_mutex_t in_mutex;         /* -/ */
+    struct sg_dev_sess in_ds;   /* of a sg IFILE */
     int outfd;
     int64_t seek;
     int out_type;
     int cdbsz_out;
     struct flags_t out_flags;
-    int64_t out_blk;                /* -\ next block address to write */
+    struct sg_dev_sess out_ds;  /* of a sg OFILE */
+    int bs;
+    int bpt;
+    int rdprotect;                  /* from protect=RDP,WRP */
+    int wrprotect;
+    int in_pi_type;                 /* from READ CAPACITY(16), when */
+    int out_pi_type;                /* ... RDP or WRP > 0 */
+    int debug;
+    int dry_run;
+    int reorder;                    /* 0 -> write in order, else window */
+    int elems;                      /* READs in flight per worker thread */
+    int numa_node;                  /* -1 -> no NUMA placement */
+    cpu_set_t numa_cpus;            /* CPUs of numa_node */
+    int64_t in_total;               /* blocks to read, starting at skip */
+    FILE * dgst_fp;                 /* digest manifest, uses aux_mutex */
+    struct resume_t rsm;            /* bits set under aux_mutex */
+    bool rate_active;               /* rate= or iops= given */
+    struct sg_pt_rate rate;         /* uses aux_mutex */
+    uint32_t out_max_dealloc;       /* 0 -> no limit */
+    uint32_t out_unmap_gran;        /* 0 -> no unmap granularity */
+    uint32_t out_unmap_align;
+    int fan_num;                    /* extra of= targets, 0 -> none */
+    int fan_max;                    /* chunks queued to them at most */
+    struct fan_target fan[MAX_FAN_OUT - 1];
+    struct fan_chunk * fan_chunks;  /* array of fan_max elements */
+    struct stripe_t in_stripe;
+    struct stripe_t out_stripe;
+    struct mpath_t in_mpath;
+    struct mpath_t out_mpath;
+    const struct stripe_t * sched;  /* claims per member of this, or NULL */
+    int64_t sched_base;             /* skip or seek of sched side */
+    int pattern;                    /* PAT_* from pattern= */
+    int mix;                        /* % of chunks only read, -1 -> copy */
+    uint64_t seed;                  /* of the per thread random streams */
+    int64_t wl_chunks;              /* chunks of BPT blocks in the range */
+    struct zipf_t zipf;
+    struct zbc_t zbc;               /* oflag=zbc, see zbc_write() */
+    int num_streams;                /* streams=N opened, 0 -> none */
+    uint16_t str_id[MAX_STREAMS];   /* assigned by STREAM CONTROL(open) */
+    /* Each group below is written by many threads, so give each its own
+     * cache line(s) to stop them invalidating one another */
+    sgp_atomic_i64 in_claimed SGP_CL_ALIGNED;  /* blocks handed to readers */
+    sgp_atomic_bool in_stop;
+    sgp_atomic_i64 st_claimed[MAX_STRIPE] SGP_CL_ALIGNED; /* chunks, sched */
+    sgp_atomic_i64 st_next_member;  /* assigned to the next worker */
+    sgp_atomic_i64 wl_next_thr;     /* pattern=, mix=: number of worker */
+    sgp_atomic_i64 str_next_thr;    /* streams=: str_id[] of next worker */
+    sgp_atomic_i64 wl_reads;        /* ... chunks read and ... */
+    sgp_atomic_i64 wl_writes;       /* ... chunks written */
+    sgp_atomic_i64 in_rem_count SGP_CL_ALIGNED; /* remaining in blocks */
+    int in_partial;                   /* -\ */
+    pthread_mutex_t in_mutex;         /* -/ serializes normal read()s */
+    int64_t out_blk SGP_CL_ALIGNED; /* -\ next block address to write */
     int64_t out_count;              /*  | blocks remaining for next write */
     int64_t out_rem_count;          /*  | count of remaining out blocks */
     int out_partial;                  /*  | */
     bool out_stop;                    /*  | */
+    int64_t ro_low;                 /*  | reorder: first unwritten chunk */
+    int * ro_done;                  /*  | reorder: blocks written by chunk */
+    int out_dealloc;                /*  | oflag=sparse: DEALLOC_* */
+    int64_t out_sparse_num;         /*  | zero blocks bypassed or ... */
+    int64_t out_dealloc_num;        /*  | ... deallocated */
+    int64_t resumed_num;            /*  | copied before (resume=) */
     pthread_mutex_t out_mutex;        /*  | */
     pthread_cond_t out_sync_cv;       /* -/ hold writes until "in order" */
-    int bs;
-    int bpt;
-    int dio_incomplete_count;   /* -\ */
-    int sum_of_resids;          /*  | */
-    pthread_mutex_t aux_mutex;  /* -/ (also serializes some printf()s */
-    int debug;
-    int dry_run;
+    struct thr_stats * thr_st;  /* thr_st_num of them, cache line aligned */
+    int thr_st_num;
+    sgp_atomic_i64 thr_st_next; /* index of the next one handed out */
+    pthread_mutex_t aux_mutex SGP_CL_ALIGNED; /* serializes some printf()s */
+    struct fan_chunk ** fan_free SGP_CL_ALIGNED; /* -\ unused fan_chunks */
+    int fan_free_num;               /*  | */
+    bool fan_done;                  /*  | no more chunks will be queued */
+    bool fan_stop;                  /*  | an extra of= has failed */
+    int64_t fan_waits;              /*  | workers held by back-pressure */
+    pthread_mutex_t fan_mutex;      /*  | */
+    pthread_cond_t fan_free_cv;     /* -/ signalled as chunks are freed */
+    Qd_ctl in_qd SGP_CL_ALIGNED;
+    Qd_ctl out_qd SGP_CL_ALIGNED;
 } Rq_coll;
 
 typedef struct request_element
@@ -169,14 +457,30 @@ typedef struct request_element
     bool wr;
     int infd;
     int outfd;
-    int64_t blk;
+    int io_fd;                  /* fd of the sg command in flight */
+    int member;                 /* claims from this sched member, -1 none */
+    const struct stripe_t * in_stripe;  /* NULL when not striped */
+    const struct stripe_t * out_stripe;
+    struct mpath_t * in_mpath;  /* NULL when a single path */
+    struct mpath_t * out_mpath;
+    int path;                   /* index into the mpath_t fd[] used, or -1 */
+    struct thr_stats * st;      /* counters of this thread, NULL if none */
+    int64_t blk;                /* logical when striped */
     int num_blks;
-    uint8_t * buffp;
-    uint8_t * alloc_bp;
+    bool sparse;                /* chunk is zeros and oflag=sparse */
+    bool done_before;           /* chunk copied by an earlier run */
+    bool recovered;             /* last sg command had recovered error */
+    uint32_t crc;               /* CRC32C of chunk when digest= given */
+    int dealloc;                /* DEALLOC_* instead of WRITE, when sparse */
+    uint16_t str_id;            /* streams=: WRITE STREAM(16), 0 -> none */
+    uint8_t * buffp;            /* from sg_hugebuf_get() */
+    uint8_t unmap_param[UNMAP_PARAM_LEN];
     struct sg_io_hdr io_hdr;
     uint8_t cmd[MAX_SCSI_CDBSZ];
     uint8_t sb[SENSE_BUFF_LEN];
     int bs;
+    int rdprotect;              /* PI follows each block in buffer when */
+    int wrprotect;              /* ... the one for this direction > 0 */
     int dio_incomplete_count;
     int resid;
     int cdbsz_in;
@@ -185,19 +489,55 @@ typedef struct request_element
     struct flags_t out_flags;
     int debug;
     uint32_t pack_id;
+    bool qd_active;             /* timing for adaptive queue depth */
+    bool rate_lat;              /* timing for rate_lat= */
+    uint64_t lat_start_ns;      /* when recording latencies */
+    uint64_t lat_ns;            /* duration of last sg command */
+    bool ur_done;               /* elems=N, normal IFILE: read finished */
+    int ur_res;                 /* ... with bytes read or -errno */
 } Rq_elem;
 
+/* With elems=N (N > 1) and a normal IFILE each worker thread has one of
+ * these. When io_uring_setup() fails (e.g. ENOSYS) ring_fd is -1 and each
+ * read is done by pread() as it is started. */
+struct sgp_uring
+{
+    int ring_fd;
+    bool fixed;                 /* buffers registered, use READ_FIXED */
+#ifdef SGP_HAVE_URING
+    size_t sq_ring_sz;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    void * sq_ring;
+    void * cq_ring;             /* same as sq_ring with single mmap */
+    struct io_uring_sqe * sqes;
+    unsigned int * sq_tail;
+    unsigned int * sq_mask;
+    unsigned int * sq_array;
+    unsigned int * cq_head;
+    unsigned int * cq_tail;
+    unsigned int * cq_mask;
+    struct io_uring_cqe * cqes;
+#endif
+};
+
 static sigset_t signal_set;
 static pthread_t sig_listen_thread_id;
 
-static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
 
 static void sg_in_operation(Rq_coll * clp, Rq_elem * rep);
-static void sg_out_operation(Rq_coll * clp, Rq_elem * rep);
+static int sg_in_start(Rq_coll * clp, Rq_elem * rep);
+static int sg_in_reap(Rq_coll * clp, Rq_elem * rep);
+static bool sg_out_operation(Rq_coll * clp, Rq_elem * rep);
 static bool normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks);
-static void normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks);
+static bool normal_in_resumed(Rq_coll * clp, Rq_elem * rep, int blocks);
+static bool normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks);
+static bool normal_out_sparse(Rq_coll * clp, Rq_elem * rep, int blocks);
 static int sg_start_io(Rq_elem * rep);
+static int mpath_pick(struct mpath_t * mp, int64_t blk, int * pathp);
+static void mpath_put(struct mpath_t * mp, int * pathp);
 static int sg_finish_io(bool wr, Rq_elem * rep, pthread_mutex_t * a_mutp);
+static bool fan_out(Rq_coll * clp, Rq_elem * rep);
 
 #ifdef HAVE_C11_ATOMICS
 
@@ -227,14 +567,32 @@ static int ascending_val = 1;
 static pthread_mutex_t strerr_mut = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_t threads[MAX_NUM_THREADS];
+static pthread_t fan_threads[(MAX_FAN_OUT - 1) * MAX_NUM_THREADS];
 
 static bool shutting_down = false;
+static volatile bool log_drain_stop = false;
+static bool log_thread_started = false;
+static pthread_t log_thread_id;
 static bool do_sync = false;
 static bool do_time = false;
+static bool do_verify = false;
 static Rq_coll rcoll;
 static struct timeval start_tm;
 static int64_t dd_count = -1;
 static int num_threads = DEF_NUM_THREADS;
+static int64_t qd_lat_us = -1;  /* -1: depth fixed by thr=, else AIMD */
+static int64_t rate_bps = 0;    /* rate=: 0 -> no limit on bytes/s */
+static int64_t rate_iops = 0;   /* iops=: 0 -> no limit on READs/s */
+static int64_t rate_lat_us = 0; /* rate_lat=: 0 -> no latency backoff */
+static int numa_req = -2;       /* -2: off, -1: node of device, else node */
+static int streams_req = 0;     /* streams=N: 0 -> plain WRITEs */
+static int progress_sec = 0;    /* progress=SEC[,FILE]: 0 -> none */
+static struct sg_io_progress progress;
+static bool progress_stop = false;      /* uses progress_mutex */
+static pthread_t progress_thread_id;
+static pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t progress_cv = PTHREAD_COND_INITIALIZER;
+static bool lat_table = false;  /* latency table output at end of copy */
 static int exit_status = 0;
 
 static const char * my_name = "sgp_dd: ";
@@ -243,43 +601,30 @@ static const char * my_name = "sgp_dd: ";
 static void
 calc_duration_throughput(int contin)
 {
-    struct timeval end_tm, res_tm;
-    double a, b;
-
-    gettimeofday(&end_tm, NULL);
-    res_tm.tv_sec = end_tm.tv_sec - start_tm.tv_sec;
-    res_tm.tv_usec = end_tm.tv_usec - start_tm.tv_usec;
-    if (res_tm.tv_usec < 0) {
-        --res_tm.tv_sec;
-        res_tm.tv_usec += 1000000;
-    }
-    a = res_tm.tv_sec;
-    a += (0.000001 * res_tm.tv_usec);
-    b = (double)rcoll.bs * (dd_count - rcoll.out_rem_count);
-    pr2serr("time to transfer data %s %d.%06d secs",
-            (contin ? "so far" : "was"), (int)res_tm.tv_sec,
-            (int)res_tm.tv_usec);
-    if ((a > 0.00001) && (b > 511))
-        pr2serr(", %.2f MB/sec\n", b / (a * 1000000.0));
-    else
-        pr2serr("\n");
+    sg_io_print_throughput(&start_tm, dd_count - rcoll.out_rem_count,
+                           rcoll.bs, !! contin);
 }
 
 static void
 print_stats(const char * str)
 {
-    int64_t infull, outfull;
-
-    if (0 != rcoll.out_rem_count)
-        pr2serr("  remaining block count=%" PRId64 "\n",
-                rcoll.out_rem_count);
-    infull = dd_count - rcoll.in_rem_count;
-    pr2serr("%s%" PRId64 "+%d records in\n", str,
-            infull - rcoll.in_partial, rcoll.in_partial);
-
-    outfull = dd_count - rcoll.out_rem_count;
-    pr2serr("%s%" PRId64 "+%d records out\n", str,
-            outfull - rcoll.out_partial, rcoll.out_partial);
+    sg_io_print_records(str, rcoll.out_rem_count,
+                        dd_count - rcoll.in_rem_count, rcoll.in_partial,
+                        dd_count - rcoll.out_rem_count, rcoll.out_partial);
+    if (rcoll.out_flags.sparse &&
+        ((rcoll.out_sparse_num > 0) || (0 == rcoll.out_dealloc_num)))
+        pr2serr("%s%" PRId64 " of them bypassed\n", str,
+                rcoll.out_sparse_num);
+    if (rcoll.out_dealloc_num > 0)
+        pr2serr("%s%" PRId64 " of them deallocated\n", str,
+                rcoll.out_dealloc_num);
+    if (rcoll.resumed_num > 0)
+        pr2serr("%s%" PRId64 " of them bypassed, copied before (resume)\n",
+                str, rcoll.resumed_num);
+    if (rcoll.mix >= 0)
+        pr2serr("%s%" PRId64 " chunks only read, %" PRId64 " only written "
+                "(mix=%d)\n", str, (int64_t)rcoll.wl_reads,
+                (int64_t)rcoll.wl_writes, rcoll.mix);
 }
 
 static void
@@ -338,10 +683,8 @@ tsafe_strerror(int code, char * ebp)
 
     pthread_mutex_lock(&strerr_mut);
     cp = safe_strerror(code);
-    strncpy(ebp, cp, STRERR_BUFF_LEN);
+    snprintf(ebp, STRERR_BUFF_LEN, "%s", cp);
     pthread_mutex_unlock(&strerr_mut);
-
-    ebp[STRERR_BUFF_LEN - 1] = '\0';
     return ebp;
 }
 
@@ -357,31 +700,6 @@ tsafe_strerror(int code, char * ebp)
     } while (0)
 
 
-static int
-dd_filetype(const char * filename)
-{
-    struct stat st;
-    size_t len = strlen(filename);
-
-    if ((1 == len) && ('.' == filename[0]))
-        return FT_DEV_NULL;
-    if (stat(filename, &st) < 0)
-        return FT_ERROR;
-    if (S_ISCHR(st.st_mode)) {
-        if ((MEM_MAJOR == major(st.st_rdev)) &&
-            (DEV_NULL_MINOR_NUM == minor(st.st_rdev)))
-            return FT_DEV_NULL;
-        if (RAW_MAJOR == major(st.st_rdev))
-            return FT_RAW;
-        if (SCSI_GENERIC_MAJOR == major(st.st_rdev))
-            return FT_SG;
-        if (SCSI_TAPE_MAJOR == major(st.st_rdev))
-            return FT_ST;
-    } else if (S_ISBLK(st.st_mode))
-        return FT_BLOCK;
-    return FT_OTHER;
-}
-
 static void
 usage()
 {
@@ -390,13 +708,27 @@ usage()
             "               [obs=BS] [of=OFILE] [oflag=FLAGS] "
             "[seek=SEEK] [skip=SKIP]\n"
             "               [--help] [--version]\n\n");
-    pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [coe=0|1] "
-            "[deb=VERB] [dio=0|1]\n"
-            "               [fua=0|1|2|3] [sync=0|1] [thr=THR] "
-            "[time=0|1] [verbose=VERB]\n"
-            "               [--dry-run] [--verbose]\n"
+    pr2serr("               [bpt=BPT|auto] [cdbsz=6|10|12|16] [coe=0|1] "
+            "[deb=VERB]\n"
+            "               [dio=0|1] [digest=MFILE] [fua=0|1|2|3] "
+            "[sync=0|1] [thr=THR]\n"
+            "               [time=0|1] [verbose=VERB] [verify=0|1]\n"
+            "               [elems=N] [numa=auto|NODE] [protect=RDP[,WRP]] "
+            "[qd_lat=US]\n"
+            "               [rate=BPS] [iops=IOPS] [rate_lat=US] "
+            "[reorder=RW]\n"
+            "               [progress=SEC[,FILE]] [resume=CFILE] "
+            "[stripe=BLKS]\n"
+            "               [pattern=seq|rand|zipf[,THETA]] [mix=RPCT] "
+            "[seed=S]\n"
+            "               [mpath=rr|lo[,auto]]\n"
+            "               [streams=N] [engine=auto|sync|queue] "
+            "[--dry-run]\n"
+            "               [--verbose]\n"
             "  where:\n"
-            "    bpt         is blocks_per_transfer (default is 128)\n"
+            "    bpt         is blocks_per_transfer (default is 128), "
+            "'auto' sizes\n"
+            "                it from the Block Limits VPD page(s)\n"
             "    bs          must be device logical block size (default "
             "512)\n"
             "    cdbsz       size of SCSI READ or WRITE cdb (default is 10)\n"
@@ -405,22 +737,91 @@ usage()
             "    count       number of blocks to copy (def: device size)\n"
             "    deb         for debug, 0->none (def), > 0->varying degrees "
             "of debug\n");
-    pr2serr("    dio         is direct IO, 1->attempt, 0->indirect IO (def)\n"
+    pr2serr("    digest      write CRC32C of each chunk copied to MFILE (a "
+            "manifest)\n"
+            "    dio         is direct IO, 1->attempt, 0->indirect IO (def)\n"
+            "    engine      auto->pick thr=, elems= and dio= from the "
+            "sg driver's\n"
+            "                capabilities, sync->elems=1, queue->elems=4\n"
+            "    elems       READs each thread keeps in flight (def: 1), "
+            "with io_uring\n"
+            "                when IFILE is not sg\n"
             "    fua         force unit access: 0->don't(def), 1->OFILE, "
             "2->IFILE,\n"
             "                3->OFILE+IFILE\n"
             "    if          file or device to read from (def: stdin)\n"
+            "    iops        limit READs of IFILE to IOPS per second "
+            "(def: 0 -> no\n"
+            "                limit)\n"
             "    iflag       comma separated list from: [coe,dio,direct,dpo,"
             "dsync,excl,\n"
             "                fua, null]\n"
+            "    mpath       IFILE and/or OFILE may be a comma separated list "
+            "of sg\n"
+            "                paths to one LU, used round robin (rr) or least "
+            "outstanding\n"
+            "                (lo); ',auto' adds the other sg paths to it\n"
+            "    mix         RPCT percent of chunks only read from IFILE, "
+            "the others\n"
+            "                only written to OFILE (def: each chunk read "
+            "then written)\n"
             "    of          file or device to write to (def: stdout), "
             "OFILE of '.'\n"
-            "                treated as /dev/null\n"
+            "                treated as /dev/null; may be given up to 4 "
+            "times (sg\n"
+            "                devices) to write each chunk read to all of "
+            "them\n"
+            "    numa        run threads on CPUs of NUMA node (auto->that of "
+            "IFILE\n"
+            "                or OFILE), buffers from its memory (def: "
+            "kernel places)\n"
             "    oflag       comma separated list from: [append,coe,dio,"
             "direct,dpo,dsync,\n"
-            "                excl,fua,null]\n"
+            "                excl,fua,null,sparse,zbc,zfinish]\n"
+            "    pattern     chunk offsets: seq (def), rand (uniform) or "
+            "zipf (skewed\n"
+            "                to the start of the range, THETA 0 to 1, def: "
+            "0.99)\n"
+            "    progress    every SEC seconds append a JSON line with the "
+            "copy's\n"
+            "                progress to FILE (def: stderr)\n"
+            "    protect     set RDPROTECT to RDP and WRPROTECT to WRP "
+            "(def: 0,0), PI\n"
+            "                is checked on read, added, moved or removed "
+            "as needed\n"
+            "    qd_lat      adapt commands in flight (up to THR) to keep "
+            "latency\n"
+            "                under US microseconds; 0->only back off on "
+            "BUSY and\n"
+            "                TASK SET FULL (def: fixed at THR)\n"
+            "    rate        limit the copy to BPS bytes per second, "
+            "suffixes like\n"
+            "                k and m allowed (def: 0 -> no limit)\n"
+            "    rate_lat    lower rate= and iops= while the smoothed "
+            "latency of sg\n"
+            "                commands is over US microseconds (def: 0 -> "
+            "don't)\n"
+            "    reorder     write each chunk once read, up to RW chunks "
+            "(of BPT\n"
+            "                blocks) ahead of the first unwritten one (def: "
+            "0 ->\n"
+            "                write in order)\n"
+            "    resume      keep a bitmap of the chunks copied in CFILE, "
+            "chunks copied\n"
+            "                by an earlier run with the same operands are "
+            "bypassed\n"
+            "    seed        of each thread's random stream for pattern= "
+            "and mix=\n"
+            "                (def: from time of day)\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
+            "    stripe      IFILE and/or OFILE may be a comma separated list "
+            "of sg\n"
+            "                devices striped BLKS blocks at a time (RAID-0)\n"
+            "    streams     open N streams on the sg OFILE, each thread "
+            "writes with\n"
+            "                WRITE STREAM(16) to one of them (def: 0 -> "
+            "WRITE)\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
             "after copy\n"
             "    thr         is number of threads, must be > 0, default 4, "
@@ -428,6 +829,9 @@ usage()
             "    time        0->no timing(def), 1->time plus calculate "
             "throughput\n"
             "    verbose     same as 'deb=VERB': increase verbosity\n"
+            "    verify      0->no verify(def), 1->read back OFILE after "
+            "copy and\n"
+            "                compare with CRC32Cs in digest manifest\n"
             "    --dry-run|-d    prepare but bypass copy/read\n"
             "    --help|-h      output this usage message then exit\n"
             "    --verbose|-v   increase verbosity of utility\n"
@@ -459,69 +863,61 @@ guarded_stop_both(Rq_coll * clp)
     guarded_stop_out(clp);
 }
 
-/* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
+/* For protect=: fetches the protection type (1, 2 or 3, or 0 for none)
+ * that the sg device is formatted with. Only one PI tuple per logical
+ * block (P_I_EXPONENT=0) is supported. Return of 0 -> success, see
+ * sg_ll_readcap_16() otherwise */
 static int
-scsi_read_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+read_pi_type(int sg_fd, const char * fn, int * pi_typep)
 {
     int res;
     uint8_t rcBuff[RCAP16_REPLY_LEN];
 
-    res = sg_ll_readcap_10(sg_fd, 0, 0, rcBuff, READ_CAP_REPLY_LEN, false, 0);
-    if (0 != res)
-        return res;
-
-    if ((0xff == rcBuff[0]) && (0xff == rcBuff[1]) && (0xff == rcBuff[2]) &&
-        (0xff == rcBuff[3])) {
-
+    res = sg_ll_readcap_16(sg_fd, 0, 0, rcBuff, RCAP16_REPLY_LEN, false, 0);
+    if (SG_LIB_CAT_UNIT_ATTENTION == res)
         res = sg_ll_readcap_16(sg_fd, 0, 0, rcBuff, RCAP16_REPLY_LEN, false,
                                0);
-        if (0 != res)
-            return res;
-        *num_sect = sg_get_unaligned_be64(rcBuff + 0) + 1;
-        *sect_sz = sg_get_unaligned_be32(rcBuff + 8);
-    } else {
-        /* take care not to sign extend values > 0x7fffffff */
-        *num_sect = (int64_t)sg_get_unaligned_be32(rcBuff + 0) + 1;
-        *sect_sz = sg_get_unaligned_be32(rcBuff + 4);
+    if (res) {
+        pr2serr("%sprotect=: READ CAPACITY(16) failed on %s\n", my_name,
+                fn);
+        return res;
+    }
+    *pi_typep = (rcBuff[12] & 0x1) ? (((rcBuff[12] >> 1) & 0x7) + 1) : 0;
+    if (*pi_typep && (rcBuff[13] & 0xf0)) {
+        pr2serr("%sprotect=: %s has more than one PI tuple per block, not "
+                "supported\n", my_name, fn);
+        return SG_LIB_CAT_OTHER;
     }
     return 0;
 }
 
-/* Return of 0 -> success, -1 -> failure. BLKGETSIZE64, BLKGETSIZE and */
-/* BLKSSZGET macros problematic (from <linux/fs.h> or <sys/mount.h>). */
-static int
-read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+/* With debug output enabled, worker threads write it into their own
+ * lock-free rings (see sg_log_ring_enable()); this thread writes it out. */
+static void *
+log_drain_thread(void * v_clp)
 {
-#ifdef BLKSSZGET
-    if ((ioctl(sg_fd, BLKSSZGET, sect_sz) < 0) && (*sect_sz > 0)) {
-        perror("BLKSSZGET ioctl error");
-        return -1;
-    } else {
- #ifdef BLKGETSIZE64
-        uint64_t ull;
+    struct timespec ts = {0, LOG_DRAIN_MS * 1000000};
 
-        if (ioctl(sg_fd, BLKGETSIZE64, &ull) < 0) {
-
-            perror("BLKGETSIZE64 ioctl error");
-            return -1;
-        }
-        *num_sect = ((int64_t)ull / (int64_t)*sect_sz);
- #else
-        unsigned long ul;
+    if (v_clp) { ; }    /* suppress warning */
+    while (! log_drain_stop) {
+        if (0 == sg_log_ring_drain(false))
+            nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
 
-        if (ioctl(sg_fd, BLKGETSIZE, &ul) < 0) {
-            perror("BLKGETSIZE ioctl error");
-            return -1;
-        }
-        *num_sect = (int64_t)ul;
- #endif
+/* Registered with atexit() so that messages still in the rings, such as
+ * the one from err_exit(), are not lost when exit() is called early. */
+static void
+log_ring_atexit(void)
+{
+    if (log_thread_started && (! pthread_equal(pthread_self(),
+                                               log_thread_id))) {
+        log_drain_stop = true;
+        pthread_join(log_thread_id, NULL);
+        log_thread_started = false;
     }
-    return 0;
-#else
-    *num_sect = 0;
-    *sect_sz = 0;
-    return -1;
-#endif
+    sg_log_ring_drain(true);
 }
 
 static void *
@@ -543,6 +939,83 @@ sig_listen_thread(void * v_clp)
     return NULL;
 }
 
+/* Hands the calling worker thread counters of its own, or NULL if there
+ * are none left */
+static struct thr_stats *
+worker_stats(Rq_coll * clp)
+{
+    int64_t k = SGP_FETCH_ADD(&clp->thr_st_next, 1);
+
+    return (k < clp->thr_st_num) ? (clp->thr_st + k) : NULL;
+}
+
+/* Sums the counters of all worker threads into sum[TS_NUM]. May be called
+ * while they are running. */
+static void
+stats_sum(const Rq_coll * clp, int64_t * sum)
+{
+    int k, j;
+
+    memset(sum, 0, TS_NUM * sizeof(int64_t));
+    for (k = 0; k < clp->thr_st_num; ++k) {
+        for (j = 0; j < TS_NUM; ++j)
+            sum[j] += SGP_OWN_LOAD(clp->thr_st[k].c + j);
+    }
+}
+
+/* With progress=SEC[,FILE]: writes one line holding a JSON object to FILE.
+ * Called every SEC seconds by progress_thread() and, with 'final' set, by
+ * main() once the worker threads have finished. IOPS are estimated from
+ * the blocks written, in chunks of BPT blocks. */
+static void
+progress_out(Rq_coll * clp, bool final)
+{
+    int status;
+    int64_t t[TS_NUM];
+    struct sg_io_progress_cnt cnt;
+
+    cnt.blocks_in = dd_count - clp->in_rem_count;
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    cnt.blocks_out = dd_count - clp->out_rem_count;
+    status = pthread_mutex_unlock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "unlock out_mutex");
+    stats_sum(clp, t);
+    cnt.recovered_errs = t[TS_RECOVERED];
+    cnt.unrecovered_errs = t[TS_UNRECOVERED];
+    cnt.retries = t[TS_RETRIES];
+    cnt.rd_fd = (FT_SG == clp->in_type) ? clp->infd : -1;
+    cnt.rd_opcode = sg_rw_opcode(clp->cdbsz_in, false);
+    cnt.wr_fd = (FT_SG == clp->out_type) ? clp->outfd : -1;
+    cnt.wr_opcode = (clp->num_streams > 0) ? SGP_WRITE_STREAM16 :
+                    sg_rw_opcode(clp->cdbsz_out, true);
+    progress.xfers = cnt.blocks_out / clp->bpt;
+    sg_io_progress_out(&progress, final, &cnt);
+}
+
+static void *
+progress_thread(void * v_clp)
+{
+    int status;
+    struct timespec ts;
+
+    status = pthread_mutex_lock(&progress_mutex);
+    if (0 != status) err_exit(status, "lock progress_mutex");
+    clock_gettime(CLOCK_REALTIME, &ts);
+    while (! progress_stop) {
+        ts.tv_sec += progress_sec;
+        while ((! progress_stop) &&
+               (0 == pthread_cond_timedwait(&progress_cv, &progress_mutex,
+                                            &ts)))
+            ;
+        if (! progress_stop)
+            progress_out((Rq_coll *)v_clp, false);
+    }
+    status = pthread_mutex_unlock(&progress_mutex);
+    if (0 != status) err_exit(status, "unlock progress_mutex");
+    return NULL;
+}
+
 static void
 cleanup_in(void * v_clp)
 {
@@ -567,366 +1040,2683 @@ cleanup_out(void * v_clp)
     pthread_cond_broadcast(&clp->out_sync_cv);
 }
 
-static void *
-read_write_thread(void * v_clp)
+static void
+qd_init(Qd_ctl * qdp, bool active, int max_depth)
 {
-    Rq_coll * clp;
-    Rq_elem rel;
-    Rq_elem * rep = &rel;
-    int sz;
-    volatile bool stop_after_write = false;
-    int64_t seek_skip;
-    int blocks, status;
+    int status;
 
-    clp = (Rq_coll *)v_clp;
-    sz = clp->bpt * clp->bs;
-    seek_skip =  clp->seek - clp->skip;
-    memset(rep, 0, sizeof(Rq_elem));
-    rep->buffp = sg_memalign(sz, 0 /* page align */, &rep->alloc_bp, false);
-    if (NULL == rep->buffp)
-        err_exit(ENOMEM, "out of memory creating user buffers\n");
+    qdp->active = active;
+    qdp->inflight = 0;
+    sg_pt_qdepth_init(&qdp->ctl, 1, max_depth,
+                      (qd_lat_us > 0) ? (uint64_t)qd_lat_us * 1000 : 0);
+    status = pthread_mutex_init(&qdp->mutex, NULL);
+    if (0 != status) err_exit(status, "init qd mutex");
+    status = pthread_cond_init(&qdp->cv, NULL);
+    if (0 != status) err_exit(status, "init qd cv");
+}
 
-    /* Following clp members are constant during lifetime of thread */
-    rep->bs = clp->bs;
-    rep->infd = clp->infd;
-    rep->outfd = clp->outfd;
-    rep->debug = clp->debug;
-    rep->cdbsz_in = clp->cdbsz_in;
-    rep->cdbsz_out = clp->cdbsz_out;
-    rep->in_flags = clp->in_flags;
-    rep->out_flags = clp->out_flags;
+/* Waits until another command may be sent to the device */
+static void
+qd_acquire(Qd_ctl * qdp)
+{
+    int status;
 
-    while(1) {
-        status = pthread_mutex_lock(&clp->in_mutex);
-        if (0 != status) err_exit(status, "lock in_mutex");
-        if (clp->in_stop || (clp->in_count <= 0)) {
-            /* no more to do, exit loop then thread */
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
-            break;
-        }
-        blocks = (clp->in_count > clp->bpt) ? clp->bpt : clp->in_count;
-        rep->wr = false;
-        rep->blk = clp->in_blk;
-        rep->num_blks = blocks;
-        clp->in_blk += blocks;
-        clp->in_count -= blocks;
+    if (! qdp->active)
+        return;
+    status = pthread_mutex_lock(&qdp->mutex);
+    if (0 != status) err_exit(status, "lock qd mutex");
+    while (qdp->inflight >= qdp->ctl.depth) {
+        status = pthread_cond_wait(&qdp->cv, &qdp->mutex);
+        if (0 != status) err_exit(status, "cond qd cv");
+    }
+    ++qdp->inflight;
+    status = pthread_mutex_unlock(&qdp->mutex);
+    if (0 != status) err_exit(status, "unlock qd mutex");
+}
 
-        pthread_cleanup_push(cleanup_in, (void *)clp);
-        if (FT_SG == clp->in_type)
-            sg_in_operation(clp, rep); /* lets go of in_mutex mid operation */
-        else {
-            stop_after_write = normal_in_operation(clp, rep, blocks);
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
-        }
-        pthread_cleanup_pop(0);
+/* Like qd_acquire() but returns false, rather than waiting, when no more
+ * commands may be sent to the device */
+static bool
+qd_try_acquire(Qd_ctl * qdp)
+{
+    bool ok;
+    int status;
 
-        status = pthread_mutex_lock(&clp->out_mutex);
-        if (0 != status) err_exit(status, "lock out_mutex");
-        if (FT_DEV_NULL != clp->out_type) {
-            while ((! clp->out_stop) &&
-                   ((rep->blk + seek_skip) != clp->out_blk)) {
-                /* if write would be out of sequence then wait */
-                pthread_cleanup_push(cleanup_out, (void *)clp);
-                status = pthread_cond_wait(&clp->out_sync_cv, &clp->out_mutex);
-                if (0 != status) err_exit(status, "cond out_sync_cv");
-                pthread_cleanup_pop(0);
-            }
-        }
+    if (! qdp->active)
+        return true;
+    status = pthread_mutex_lock(&qdp->mutex);
+    if (0 != status) err_exit(status, "lock qd mutex");
+    ok = (qdp->inflight < qdp->ctl.depth);
+    if (ok)
+        ++qdp->inflight;
+    status = pthread_mutex_unlock(&qdp->mutex);
+    if (0 != status) err_exit(status, "unlock qd mutex");
+    return ok;
+}
 
-        if (clp->out_stop || (clp->out_count <= 0)) {
-            if (! clp->out_stop)
-                clp->out_stop = true;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-            break;
-        }
-        if (stop_after_write)
-            clp->out_stop = true;
-        rep->wr = true;
-        rep->blk = clp->out_blk;
-        clp->out_blk += blocks;
-        clp->out_count -= blocks;
+/* For a command about to be retried: feeds its outcome to the controller
+ * but keeps its slot */
+static void
+qd_requeue(Qd_ctl * qdp, int scsi_status, uint64_t lat_ns)
+{
+    int status;
 
-        if (0 == rep->num_blks) {
-            clp->out_stop = true;
-            stop_after_write = true;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-            break;      /* read nothing so leave loop */
-        }
+    if (! qdp->active)
+        return;
+    status = pthread_mutex_lock(&qdp->mutex);
+    if (0 != status) err_exit(status, "lock qd mutex");
+    sg_pt_qdepth_update(&qdp->ctl, scsi_status, lat_ns);
+    status = pthread_mutex_unlock(&qdp->mutex);
+    if (0 != status) err_exit(status, "unlock qd mutex");
+}
 
-        pthread_cleanup_push(cleanup_out, (void *)clp);
-        if (FT_SG == clp->out_type)
-            sg_out_operation(clp, rep); /* releases out_mutex mid operation */
-        else if (FT_DEV_NULL == clp->out_type) {
-            /* skip actual write operation */
-            clp->out_rem_count -= blocks;
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-        }
-        else {
-            normal_out_operation(clp, rep, blocks);
-            status = pthread_mutex_unlock(&clp->out_mutex);
-            if (0 != status) err_exit(status, "unlock out_mutex");
-        }
-        pthread_cleanup_pop(0);
+/* scsi_status of -1 when the command did not complete */
+static void
+qd_release(Qd_ctl * qdp, int scsi_status, uint64_t lat_ns)
+{
+    int status;
 
-        if (stop_after_write)
-            break;
-        pthread_cond_broadcast(&clp->out_sync_cv);
-    } /* end of while loop */
-    if (rep->alloc_bp)
-        free(rep->alloc_bp);
-    status = pthread_mutex_lock(&clp->in_mutex);
-    if (0 != status) err_exit(status, "lock in_mutex");
-    if (! clp->in_stop)
-        clp->in_stop = true;  /* flag other workers to stop */
-    status = pthread_mutex_unlock(&clp->in_mutex);
-    if (0 != status) err_exit(status, "unlock in_mutex");
-    pthread_cond_broadcast(&clp->out_sync_cv);
-    return stop_after_write ? NULL : clp;
+    if (! qdp->active)
+        return;
+    status = pthread_mutex_lock(&qdp->mutex);
+    if (0 != status) err_exit(status, "lock qd mutex");
+    --qdp->inflight;
+    sg_pt_qdepth_update(&qdp->ctl, scsi_status, lat_ns);
+    status = pthread_mutex_unlock(&qdp->mutex);
+    if (0 != status) err_exit(status, "unlock qd mutex");
+    pthread_cond_broadcast(&qdp->cv);
 }
 
-static bool
-normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
+static void
+qd_report(const char * leadin, const Qd_ctl * qdp)
 {
-    bool stop_after_write = false;
-    int res;
-    char strerr_buff[STRERR_BUFF_LEN];
+    const struct sg_pt_qdepth * cp = &qdp->ctl;
+
+    if (! qdp->active)
+        return;
+    pr2serr("%sadaptive queue depth: final=%d, increases=%" PRIu64
+            ", decreases=%" PRIu64 "\n", leadin, cp->depth, cp->increases,
+            cp->decreases);
+    if (cp->busy_count || cp->ts_full_count)
+        pr2serr("    BUSY=%" PRIu64 ", TASK SET FULL=%" PRIu64 "\n",
+                cp->busy_count, cp->ts_full_count);
+    if (cp->ewma_ns)
+        pr2serr("    smoothed latency=%.1f us\n", cp->ewma_ns / 1000.0);
+}
 
-    /* enters holding in_mutex */
-    while (((res = read(clp->infd, rep->buffp, blocks * clp->bs)) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
-    if (res < 0) {
-        if (clp->in_flags.coe) {
-            memset(rep->buffp, 0, rep->num_blks * rep->bs);
-            pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
-                    "bytes, %s\n", rep->blk,
-                    rep->num_blks * rep->bs,
-                    tsafe_strerror(errno, strerr_buff));
-            res = rep->num_blks * clp->bs;
-        }
-        else {
-            pr2serr("error in normal read, %s\n",
-                    tsafe_strerror(errno, strerr_buff));
-            clp->in_stop = true;
-            guarded_stop_out(clp);
-            return 1;
-        }
-    }
-    if (res < blocks * clp->bs) {
-        int o_blocks = blocks;
-        stop_after_write = true;
-        blocks = res / clp->bs;
-        if ((res % clp->bs) > 0) {
-            blocks++;
-            clp->in_partial++;
-        }
-        /* Reverse out + re-apply blocks on clp */
-        clp->in_blk -= o_blocks;
-        clp->in_count += o_blocks;
-        rep->num_blks = blocks;
-        clp->in_blk += blocks;
-        clp->in_count -= blocks;
-    }
-    clp->in_rem_count -= blocks;
-    return stop_after_write;
+static void
+rate_report(const Rq_coll * clp)
+{
+    const struct sg_pt_rate * rp = &clp->rate;
+
+    if (! clp->rate_active)
+        return;
+    pr2serr("rate limit: %" PRIu64 " waits totalling %.3f seconds",
+            rp->waits, rp->wait_ns / 1e9);
+    if (rp->target_ns)
+        pr2serr(", latency backoffs=%" PRIu64 ", smoothed latency=%.1f us",
+                rp->backoffs, rp->ewma_ns / 1000.0);
+    pr2serr("\n");
+}
+
+/* With rate= or iops=: takes the tokens of the READ of 'blocks' blocks
+ * about to be issued. Returns the nanoseconds to wait before issuing it. */
+static uint64_t
+rate_take(Rq_coll * clp, int blocks)
+{
+    int status;
+    uint64_t wait_ns;
+
+    if (! clp->rate_active)
+        return 0;
+    status = pthread_mutex_lock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "lock aux_mutex");
+    wait_ns = sg_pt_rate_take(&clp->rate, (uint64_t)blocks * clp->bs);
+    status = pthread_mutex_unlock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "unlock aux_mutex");
+    return wait_ns;
 }
 
+/* As rate_take() then sleeps (not holding aux_mutex) as needed */
 static void
-normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
+rate_wait(Rq_coll * clp, int blocks)
 {
-    int res;
-    char strerr_buff[STRERR_BUFF_LEN];
+    sg_pt_rate_sleep(rate_take(clp, blocks));
+}
 
-    /* enters holding out_mutex */
-    while (((res = write(clp->outfd, rep->buffp, rep->num_blks * clp->bs))
-            < 0) && ((EINTR == errno) || (EAGAIN == errno)))
-        ;
-    if (res < 0) {
-        if (clp->out_flags.coe) {
-            pr2serr(">> ignored error for out blk=%" PRId64 " for %d bytes, "
-                    "%s\n", rep->blk, rep->num_blks * rep->bs,
-                    tsafe_strerror(errno, strerr_buff));
-            res = rep->num_blks * clp->bs;
-        }
+/* With rate_lat=US: feeds the duration of the sg command just finished */
+static void
+rate_lat_update(Rq_coll * clp, const Rq_elem * rep)
+{
+    int status;
+
+    if ((! rep->rate_lat) || (0 == rep->lat_ns))
+        return;
+    status = pthread_mutex_lock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "lock aux_mutex");
+    sg_pt_rate_update(&clp->rate, rep->lat_ns);
+    status = pthread_mutex_unlock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "unlock aux_mutex");
+}
+
+/* Maps the logical block address lba of a striped IFILE or OFILE to the
+ * member holding it, setting *fdp to its fd and returning the address on
+ * that member. A chunk never spans two members since bpt divides the
+ * stripe and skip= and seek= are multiples of bpt. */
+static int64_t
+stripe_map(const struct stripe_t * sp, int64_t lba, int * fdp)
+{
+    int64_t su = lba / sp->stripe;      /* stripe unit across all members */
+
+    *fdp = sp->fd[su % sp->num];
+    return ((su / sp->num) * sp->stripe) + (lba % sp->stripe);
+}
+
+/* Number of chunks before (absolute) chunk a that are on member m, where
+ * each member holds k consecutive chunks of every n * k. */
+static int64_t
+stripe_chunks_before(int64_t a, int m, int n, int64_t k)
+{
+    int64_t r = (a % (n * k)) - (m * k);
+
+    return ((a / (n * k)) * k) + ((r < 0) ? 0 : ((r > k) ? k : r));
+}
+
+/* With a striped IFILE (or else OFILE) a worker reads the chunks of its
+ * own member in ascending order, so every member has READs in flight
+ * however the members differ in speed. Once its member has no more the
+ * worker moves on to the next one. Returns the offset from the start of
+ * the copy (in blocks) or in_total when no member has any left. */
+static int64_t
+stripe_claim(Rq_coll * clp, Rq_elem * rep)
+{
+    const struct stripe_t * sp = clp->sched;
+    int m, t;
+    int n = sp->num;
+    int64_t j, off;
+    int64_t k = sp->stripe / clp->bpt;  /* chunks per stripe unit */
+    int64_t b = clp->sched_base / clp->bpt;
+
+    for (t = 0; t < n; ++t) {
+        m = (rep->member + t) % n;
+        j = SGP_FETCH_ADD(&clp->st_claimed[m], 1);
+        /* j-th chunk on member m, relative to the chunk at sched_base */
+        off = ((((j / k) * n + m) * k) + (j % k) - b) * clp->bpt;
+        if (off < clp->in_total) {
+            rep->member = m;
+            return off;
+        }
+    }
+    return clp->in_total;
+}
+
+/* Hands out the next range of (up to bpt) blocks to read to rep, in
+ * ascending order (per member when striped), without taking a lock.
+ * Returns the number of blocks with rep->blk set to the first one, or 0
+ * when there are no more to read. */
+static int
+in_claim(Rq_coll * clp, Rq_elem * rep)
+{
+    int64_t off;
+
+    if (clp->in_stop)
+        return 0;
+    if (rep->member >= 0)
+        off = stripe_claim(clp, rep);
+    else
+        off = SGP_FETCH_ADD(&clp->in_claimed, clp->bpt);
+    if (off >= clp->in_total)
+        return 0;
+    rep->blk = clp->skip + off;
+    return ((clp->in_total - off) > clp->bpt) ? clp->bpt :
+                                                (int)(clp->in_total - off);
+}
+
+/* Checks the Logical Block Provisioning and Block Limits VPD pages of the
+ * sg OFILE to see how (if at all) chunks of zeros can be deallocated rather
+ * than bypassed when oflag=sparse is given. WRITE SAME(16) with the UNMAP
+ * bit is preferred since the device server either deallocates or writes
+ * the zeros; UNMAP is only used when deallocated blocks read as zeros. */
+static void
+probe_out_dealloc(Rq_coll * clp)
+{
+    int res, resid;
+    int vb = (clp->debug > 1) ? clp->debug - 1 : 0;
+    uint32_t u;
+    uint64_t ull;
+    uint8_t lbp[VPD_BLOCK_LIMITS_LEN];
+    uint8_t bl[VPD_BLOCK_LIMITS_LEN];
+
+    clp->out_dealloc = DEALLOC_NONE;
+    memset(lbp, 0, sizeof(lbp));
+    res = sg_ll_inquiry_v2(clp->outfd, true, VPD_LB_PROVISIONING, lbp,
+                           sizeof(lbp), 0, &resid, false, vb);
+    if (res || ((int)sizeof(lbp) - resid < 8) ||
+        (VPD_LB_PROVISIONING != lbp[1])) {
+        if (clp->debug)
+            pr2serr("oflag=sparse: no Logical Block Provisioning VPD page, "
+                    "will bypass zero chunks\n");
+        return;
+    }
+    memset(bl, 0, sizeof(bl));
+    res = sg_ll_inquiry_v2(clp->outfd, true, VPD_BLOCK_LIMITS, bl,
+                           sizeof(bl), 0, &resid, false, vb);
+    if (res || ((int)sizeof(bl) - resid < 44) || (VPD_BLOCK_LIMITS != bl[1]))
+        memset(bl, 0, sizeof(bl));      /* assume no limits */
+    if (0x40 & lbp[5]) {                /* LBPWS */
+        clp->out_dealloc = DEALLOC_WS16;
+        ull = sg_get_unaligned_be64(bl + 36);   /* max write same length */
+        clp->out_max_dealloc = (ull > UINT32_MAX) ? 0 : (uint32_t)ull;
+    } else if ((0x80 & lbp[5]) && (0x1c & lbp[5])) {    /* LBPU + LBPRZ */
+        if ((bl[3] >= 0x10) && (0 == sg_get_unaligned_be32(bl + 24))) {
+            if (clp->debug)
+                pr2serr("oflag=sparse: max unmap block descriptor count is "
+                        "0, will bypass zero chunks\n");
+            return;
+        }
+        clp->out_dealloc = DEALLOC_UNMAP;
+        u = sg_get_unaligned_be32(bl + 20);     /* max unmap LBA count */
+        clp->out_max_dealloc = (UINT32_MAX == u) ? 0 : u;
+        clp->out_unmap_gran = sg_get_unaligned_be32(bl + 28);
+        if (0x80 & bl[32])  /* UGAVALID */
+            clp->out_unmap_align = sg_get_unaligned_be32(bl + 32) &
+                                   0x7fffffff;
+    } else if (clp->debug)
+        pr2serr("oflag=sparse: OFILE lacks LBPWS and LBPU+LBPRZ, will "
+                "bypass zero chunks\n");
+    if ((clp->debug > 1) && (DEALLOC_NONE != clp->out_dealloc))
+        pr2serr("oflag=sparse: deallocate zero chunks with %s, max blocks "
+                "%u per command\n", (DEALLOC_WS16 == clp->out_dealloc) ?
+                "WRITE SAME(16)" : "UNMAP", clp->out_max_dealloc);
+}
+
+/* Issues the ZONING IN or STREAM CONTROL (with resp as its data-in
+ * buffer) or ZONING OUT command in cdb to the sg device on fd. Returns 0
+ * on success, else an SG_LIB_CAT_* value or one from sg_convert_errno(). */
+static int
+zbc_cmd(int fd, uint8_t * cdb, uint8_t * resp, int mx_resp_len, int * residp,
+        int vb)
+{
+    int res, ret, sense_cat;
+    struct sg_pt_base * ptvp;
+    uint8_t sense_b[SENSE_BUFF_LEN];
+    char b[64];
+
+    sg_get_opcode_sa_name(cdb[0], cdb[1] & 0x1f, -1, sizeof(b), b);
+    ptvp = construct_scsi_pt_obj();
+    if (NULL == ptvp) {
+        pr2serr("%s: out of memory\n", b);
+        return sg_convert_errno(ENOMEM);
+    }
+    set_scsi_pt_cdb(ptvp, cdb, ZBC_CDB_LEN);
+    set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+    if (resp)
+        set_scsi_pt_data_in(ptvp, resp, mx_resp_len);
+    res = do_scsi_pt(ptvp, fd, DEF_TIMEOUT / 1000, vb);
+    ret = sg_cmds_process_resp(ptvp, b, res, true, vb, &sense_cat);
+    if (-1 == ret)
+        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == ret)
+        ret = ((SG_LIB_CAT_RECOVERED == sense_cat) ||
+               (SG_LIB_CAT_NO_SENSE == sense_cat)) ? 0 : sense_cat;
+    else
+        ret = 0;
+    if (residp)
+        *residp = get_scsi_pt_resid(ptvp);
+    destruct_scsi_pt_obj(ptvp);
+    return ret;
+}
+
+/* Sends ZONING OUT with service action sa (e.g. RESET WRITE POINTER) for
+ * the zone starting at zs to the sg OFILE */
+static int
+zbc_zone_out(Rq_coll * clp, int sa, int64_t zs)
+{
+    int vb = (clp->debug > 1) ? clp->debug - 1 : 0;
+    uint8_t cdb[ZBC_CDB_LEN];
+
+    memset(cdb, 0, sizeof(cdb));
+    cdb[0] = SGP_ZONING_OUT;
+    cdb[1] = sa;
+    sg_put_unaligned_be64((uint64_t)zs, cdb + 2);
+    return zbc_cmd(clp->outfd, cdb, NULL, 0, NULL, vb);
+}
+
+/* With oflag=zbc, lists the zones holding blocks SEEK to SEEK+COUNT-1 of
+ * the sg OFILE with REPORT ZONES. A write pointer zone written from its
+ * start has its write pointer reset first (unless dry running); when SEEK
+ * is within a sequential write required zone it must be at its write
+ * pointer. Zones written at once are held to the maximum number of open
+ * sequential write required zones in the Zoned Block Device
+ * Characteristics VPD page, when given. Returns 0 when the copy can go
+ * ahead. */
+static int
+zbc_probe(Rq_coll * clp, const char * outf, int64_t count)
+{
+    int k, res, resid, rlen, num, max_num;
+    int vb = (clp->debug > 1) ? clp->debug - 1 : 0;
+    int resets = 0;
+    uint32_t u;
+    int64_t first;
+    int64_t cur = clp->seek;
+    int64_t last = clp->seek + count;       /* one past the end */
+    uint8_t * buff;
+    uint8_t * free_buff = NULL;
+    const uint8_t * bp;
+    struct zbc_t * zbp = &clp->zbc;
+    struct zbc_zone * zp;
+    uint8_t cdb[ZBC_CDB_LEN];
+    uint8_t vpd[VPD_ZBDC_LEN];
+
+    buff = sg_memalign(ZBC_RZ_BUFF_LEN, 0, &free_buff, false);
+    if (NULL == buff)
+        err_exit(ENOMEM, "out of memory for REPORT ZONES");
+    max_num = 0;
+    res = 0;
+    while (cur < last) {
+        memset(cdb, 0, sizeof(cdb));
+        cdb[0] = SGP_ZONING_IN;
+        cdb[1] = SGP_REPORT_ZONES_SA;
+        sg_put_unaligned_be64((uint64_t)cur, cdb + 2);
+        sg_put_unaligned_be32(ZBC_RZ_BUFF_LEN, cdb + 10);
+        res = zbc_cmd(clp->outfd, cdb, buff, ZBC_RZ_BUFF_LEN, &resid, vb);
+        if (res) {
+            if ((SG_LIB_CAT_INVALID_OP == res) ||
+                (SG_LIB_CAT_ILLEGAL_REQ == res))
+                pr2serr("oflag=zbc: REPORT ZONES refused, is %s a host "
+                        "managed ZBC device?\n", outf);
+            goto fini;
+        }
+        rlen = ZBC_RZ_BUFF_LEN - resid;
+        num = (rlen >= 64) ? ((rlen - 64) / 64) : 0;
+        if (num > (int)(sg_get_unaligned_be32(buff + 0) / 64))
+            num = (int)(sg_get_unaligned_be32(buff + 0) / 64);
+        if (0 == num) {
+            pr2serr("oflag=zbc: REPORT ZONES from LBA 0x%" PRIx64 " found "
+                    "no zones\n", cur);
+            res = SG_LIB_CAT_MALFORMED;
+            goto fini;
+        }
+        for (k = 0, bp = buff + 64; (k < num) && (cur < last);
+             ++k, bp += 64) {
+            if (zbp->num >= max_num) {
+                max_num = max_num ? (2 * max_num) : 256;
+                zp = (struct zbc_zone *)realloc(zbp->zp, max_num *
+                                                sizeof(*zp));
+                if (NULL == zp)
+                    err_exit(ENOMEM, "out of memory for zones");
+                zbp->zp = zp;
+            }
+            zp = zbp->zp + zbp->num;
+            zp->start = (int64_t)sg_get_unaligned_be64(bp + 16);
+            zp->len = (int64_t)sg_get_unaligned_be64(bp + 8);
+            zp->wp = (int64_t)sg_get_unaligned_be64(bp + 24);
+            zp->type = bp[0] & 0xf;
+            zp->cond = (bp[1] >> 4) & 0xf;
+            zp->busy = false;
+            if ((zp->start > cur) || (zp->len <= 0) ||
+                ((zp->start + zp->len) <= cur)) {
+                pr2serr("oflag=zbc: zone at 0x%" PRIx64 " does not hold "
+                        "LBA 0x%" PRIx64 "\n", zp->start, cur);
+                res = SG_LIB_CAT_MALFORMED;
+                goto fini;
+            }
+            cur = zp->start + zp->len;
+            ++zbp->num;
+        }
+    }
+
+    for (k = 0; k < zbp->num; ++k) {
+        zp = zbp->zp + k;
+        first = (zp->start > clp->seek) ? zp->start : clp->seek;
+        if (ZBC_ZT_CONV == zp->type) {
+            zp->wp = first;
+            continue;
+        }
+        if ((ZBC_ZC_RDONLY == zp->cond) || (ZBC_ZC_OFFLINE == zp->cond)) {
+            pr2serr("oflag=zbc: zone at 0x%" PRIx64 " is %s\n", zp->start,
+                    (ZBC_ZC_RDONLY == zp->cond) ? "read only" : "offline");
+            res = SG_LIB_CONTRADICT;
+            goto fini;
+        }
+        if (first == zp->start) {
+            if (ZBC_ZC_EMPTY != zp->cond)
+                ++resets;
+        } else if (ZBC_ZT_SWP == zp->type)
+            zp->wp = first;     /* may be written anywhere */
+        else if ((ZBC_ZC_FULL == zp->cond) || (zp->wp != first)) {
+            pr2serr("oflag=zbc: seek=%" PRId64 " is in the zone at 0x%"
+                    PRIx64 " but that zone's write pointer ", clp->seek,
+                    zp->start);
+            if (ZBC_ZC_FULL == zp->cond)
+                pr2serr("is at its end (full)\n");
+            else
+                pr2serr("is at 0x%" PRIx64 "\n", zp->wp);
+            res = SG_LIB_CONTRADICT;
+            goto fini;
+        }
+    }
+    if (resets > 0)
+        pr2serr("oflag=zbc: %s the write pointer of %d zone%s written from "
+                "the start\n", clp->dry_run ? "would reset" : "resetting",
+                resets, (1 == resets) ? "" : "s");
+    for (k = 0; k < zbp->num; ++k) {
+        zp = zbp->zp + k;
+        if ((ZBC_ZT_CONV == zp->type) || (zp->start < clp->seek))
+            continue;
+        if ((ZBC_ZC_EMPTY != zp->cond) && (clp->dry_run <= 0)) {
+            res = zbc_zone_out(clp, SGP_RESET_WP_SA, zp->start);
+            if (res) {
+                pr2serr("oflag=zbc: reset write pointer of zone at 0x%"
+                        PRIx64 " failed\n", zp->start);
+                goto fini;
+            }
+        }
+        zp->wp = zp->start;
+    }
+
+    zbp->max_open = zbp->num;
+    memset(vpd, 0, sizeof(vpd));
+    if ((0 == sg_ll_inquiry_v2(clp->outfd, true, VPD_ZBDC, vpd, sizeof(vpd),
+                               0, &resid, false, vb)) &&
+        (((int)sizeof(vpd) - resid) >= 20) && (VPD_ZBDC == vpd[1])) {
+        u = sg_get_unaligned_be32(vpd + 16);
+        if ((u > 0) && (u < (uint32_t)zbp->max_open))
+            zbp->max_open = (int)u;
+    }
+    if (clp->debug)
+        pr2serr("oflag=zbc: %d zones from LBA 0x%" PRIx64 ", at most %d "
+                "written at once\n", zbp->num, zbp->zp[0].start,
+                zbp->max_open);
+fini:
+    free(free_buff);
+    return res;
+}
+
+/* With oflag=zfinish, after the copy, finishes each write pointer zone
+ * that it left partly written so those zones are full */
+static int
+zbc_finish(Rq_coll * clp)
+{
+    int k, res;
+    int ret = 0;
+    const struct zbc_zone * zp;
+
+    for (k = 0; k < clp->zbc.num; ++k) {
+        zp = clp->zbc.zp + k;
+        if ((ZBC_ZT_CONV == zp->type) || (zp->wp <= zp->start) ||
+            (zp->wp >= (zp->start + zp->len)))
+            continue;
+        if (clp->debug)
+            pr2serr("oflag=zfinish: finish zone at 0x%" PRIx64 "\n",
+                    zp->start);
+        res = zbc_zone_out(clp, SGP_FINISH_ZONE_SA, zp->start);
+        if (res) {
+            pr2serr("oflag=zfinish: finish zone at 0x%" PRIx64 " failed\n",
+                    zp->start);
+            if (0 == ret)
+                ret = res;
+        }
+    }
+    return ret;
+}
+
+/* resume=CFILE keeps a bit per chunk (of BPT blocks, from SKIP) in CFILE,
+ * set once that chunk has been written to OFILE. CFILE is mmap-ed shared
+ * so the kernel writes it back in the background; a copy that is stopped
+ * and started again with the same operands bypasses the chunks already
+ * copied. CFILE starts with a RESUME_HDR_LEN byte header holding the
+ * operands that must match. Same layout as sg_dd's. */
+/* Closes the streams opened by streams_open(). Returns 0 if all closed,
+ * else the error from the last that failed. */
+static int
+streams_close(Rq_coll * clp)
+{
+    int k, res;
+    int ret = 0;
+    int vb = (clp->debug > 1) ? clp->debug - 1 : 0;
+    uint8_t cdb[ZBC_CDB_LEN];
+    uint8_t resp[STREAM_CTL_RESP_LEN];
+
+    for (k = 0; k < clp->num_streams; ++k) {
+        memset(cdb, 0, sizeof(cdb));
+        cdb[0] = SGP_SA_IN16;
+        cdb[1] = SGP_STREAM_CONTROL_SA | (STREAM_CTL_CLOSE << 5);
+        sg_put_unaligned_be16(clp->str_id[k], cdb + 4);
+        sg_put_unaligned_be32(sizeof(resp), cdb + 10);
+        res = zbc_cmd(clp->outfd, cdb, resp, sizeof(resp), NULL, vb);
+        if (res) {
+            pr2serr("streams=: closing stream id %u failed\n",
+                    clp->str_id[k]);
+            ret = res;
+        } else if (clp->debug)
+            pr2serr("streams=: closed stream id %u\n", clp->str_id[k]);
+    }
+    clp->num_streams = 0;
+    return ret;
+}
+
+/* With streams=N, opens N streams on the sg OFILE with STREAM CONTROL
+ * and keeps the assigned stream identifiers in clp->str_id[]. Each
+ * worker thread then writes with WRITE STREAM(16) using one of them, the
+ * workers taking them in turn. On failure closes any already opened.
+ * Returns 0 on success. */
+static int
+streams_open(Rq_coll * clp, int n)
+{
+    int k, res, resid;
+    int vb = (clp->debug > 1) ? clp->debug - 1 : 0;
+    uint8_t cdb[ZBC_CDB_LEN];
+    uint8_t resp[STREAM_CTL_RESP_LEN];
+    char b[80];
+
+    for (k = 0; k < n; ++k) {
+        memset(cdb, 0, sizeof(cdb));
+        memset(resp, 0, sizeof(resp));
+        cdb[0] = SGP_SA_IN16;
+        cdb[1] = SGP_STREAM_CONTROL_SA | (STREAM_CTL_OPEN << 5);
+        sg_put_unaligned_be32(sizeof(resp), cdb + 10);
+        resid = 0;
+        res = zbc_cmd(clp->outfd, cdb, resp, sizeof(resp), &resid, vb);
+        if ((0 == res) && ((int)sizeof(resp) - resid < 6)) {
+            pr2serr("streams=: STREAM CONTROL(open) response too short\n");
+            res = SG_LIB_CAT_MALFORMED;
+        }
+        if (res) {
+            sg_get_category_sense_str(res, sizeof(b), b, vb);
+            pr2serr("streams=: opening stream %d of %d failed: %s\n", k + 1,
+                    n, b);
+            break;
+        }
+        clp->str_id[k] = sg_get_unaligned_be16(resp + 4);
+        if (0 == clp->str_id[k]) {
+            pr2serr("streams=: device assigned stream id 0\n");
+            res = SG_LIB_CAT_MALFORMED;
+            break;
+        }
+        if (clp->debug)
+            pr2serr("streams=: opened stream id %u\n", clp->str_id[k]);
+    }
+    clp->num_streams = k;
+    if (res) {
+        streams_close(clp);
+        return res;
+    }
+    return 0;
+}
+
+#define RESUME_MAGIC "SG3RSUM1"
+#define RESUME_HDR_LEN 64
+
+/* Opens (creating if need be) and maps the checkpoint file 'fn'. Returns 0
+ * if successful, else sg3_utils error code. */
+static int
+resume_open(struct resume_t * rp, const char * fn, int64_t skip,
+            int64_t seek, int64_t count, int bs, int bpt)
+{
+    bool fresh;
+    int err;
+    int64_t k;
+    uint8_t hdr[RESUME_HDR_LEN];
+    struct stat st;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    memset(rp, 0, sizeof(*rp));
+    rp->chunks = (count + bpt - 1) / bpt;
+    rp->len = RESUME_HDR_LEN + (size_t)((rp->chunks + 7) / 8);
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, RESUME_MAGIC, 8);
+    sg_put_unaligned_be64((uint64_t)skip, hdr + 8);
+    sg_put_unaligned_be64((uint64_t)seek, hdr + 16);
+    sg_put_unaligned_be64((uint64_t)count, hdr + 24);
+    sg_put_unaligned_be32((uint32_t)bs, hdr + 32);
+    sg_put_unaligned_be32((uint32_t)bpt, hdr + 36);
+    if ((rp->fd = open(fn, O_RDWR | O_CREAT, 0644)) < 0) {
+        err = errno;
+        pr2serr("%sresume: could not open %s: %s\n", my_name, fn,
+                tsafe_strerror(err, strerr_buff));
+        return sg_convert_errno(err);
+    }
+    if (fstat(rp->fd, &st) < 0)
+        goto file_err;
+    fresh = (0 == st.st_size);
+    if (fresh) {
+        if (ftruncate(rp->fd, (off_t)rp->len) < 0)
+            goto file_err;
+    } else if ((size_t)st.st_size != rp->len) {
+        pr2serr("%sresume: %s is from a different copy (size)\n", my_name,
+                fn);
+        close(rp->fd);
+        return SG_LIB_CONTRADICT;
+    }
+    rp->mp = (uint8_t *)mmap(NULL, rp->len, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, rp->fd, 0);
+    if (MAP_FAILED == rp->mp) {
+        rp->mp = NULL;
+        goto file_err;
+    }
+    if (fresh)
+        memcpy(rp->mp, hdr, sizeof(hdr));
+    else if (memcmp(rp->mp, hdr, sizeof(hdr))) {
+        pr2serr("%sresume: %s is from a different copy (skip, seek, count, "
+                "bs or bpt differ)\n", my_name, fn);
+        munmap(rp->mp, rp->len);
+        close(rp->fd);
+        rp->mp = NULL;
+        return SG_LIB_CONTRADICT;
+    }
+    for (k = 0; k < rp->chunks; ++k) {
+        if (rp->mp[RESUME_HDR_LEN + (k / 8)] & (1 << (k % 8)))
+            ++rp->done_at_start;
+    }
+    return 0;
+
+file_err:
+    err = errno;
+    pr2serr("%sresume: %s: %s\n", my_name, fn,
+            tsafe_strerror(err, strerr_buff));
+    close(rp->fd);
+    return sg_convert_errno(err);
+}
+
+/* Returns 0 if the bitmap has been written back to CFILE, else -1 */
+static int
+resume_close(struct resume_t * rp)
+{
+    int res = 0;
+
+    if (NULL == rp->mp)
+        return 0;
+    if (msync(rp->mp, rp->len, MS_SYNC) < 0) {
+        perror("sgp_dd: resume: msync");
+        res = -1;
+    }
+    munmap(rp->mp, rp->len);
+    close(rp->fd);
+    rp->mp = NULL;
+    return res;
+}
+
+/* With resume=CFILE, sets rep->done_before (and returns it) when the chunk
+ * just claimed (rep->blk is its IFILE address) was copied by an earlier
+ * run. Those bits are not changed while worker threads run. */
+static bool
+resume_claimed(const Rq_coll * clp, Rq_elem * rep)
+{
+    int64_t chunk;
+
+    rep->done_before = false;
+    if (clp->rsm.mp) {
+        chunk = (rep->blk - clp->skip) / clp->bpt;
+        rep->done_before = (chunk < clp->rsm.chunks) &&
+                           (clp->rsm.mp[RESUME_HDR_LEN + (chunk / 8)] &
+                            (1 << (chunk % 8)));
+    }
+    return rep->done_before;
+}
+
+/* Sets the bit in CFILE of the chunk (index from SKIP) just written. Other
+ * threads set bits in the same bytes, hence aux_mutex. */
+static void
+resume_set_done(Rq_coll * clp, int64_t chunk)
+{
+    int status;
+
+    if ((NULL == clp->rsm.mp) || (chunk >= clp->rsm.chunks))
+        return;
+    status = pthread_mutex_lock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "lock aux_mutex");
+    clp->rsm.mp[RESUME_HDR_LEN + (chunk / 8)] |= (uint8_t)(1 << (chunk % 8));
+    status = pthread_mutex_unlock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "unlock aux_mutex");
+}
+
+/* With digest=MFILE, appends the OFILE address, length and CRC32C of the
+ * chunk just written. Chunks may be written (so listed) out of order. */
+static void
+record_digest(Rq_coll * clp, const Rq_elem * rep)
+{
+    int status;
+
+    status = pthread_mutex_lock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "lock aux_mutex");
+    fprintf(clp->dgst_fp, "%" PRId64 " %d 0x%08x\n", rep->blk,
+            rep->num_blks, rep->crc);
+    status = pthread_mutex_unlock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "unlock aux_mutex");
+}
+
+/* With oflag=sparse, returns true when the chunk just read (rep->blk is
+ * still its IFILE address) is all zeros and is not the last one; the last
+ * is always written so that a regular OFILE gets its full length. */
+static bool
+sparse_chunk(const Rq_coll * clp, const Rq_elem * rep)
+{
+    if ((! clp->out_flags.sparse) || (rep->num_blks <= 0) ||
+        (FT_DEV_NULL == clp->out_type))
+        return false;
+    if ((rep->blk - clp->skip + rep->num_blks) >= clp->in_total)
+        return false;
+    return sg_all_zeros(rep->buffp, rep->num_blks * rep->bs);
+}
+
+/* With oflag=sparse, returns the number of zero blocks ahead of the first
+ * holding data in the chunk just read, for a normal OFILE to bypass before
+ * writing the rest. Returns 0 if the chunk is all zeros, as sparse_chunk()
+ * decides whether to write such a chunk. */
+static int
+sparse_lead(const Rq_coll * clp, const Rq_elem * rep)
+{
+    int k;
+
+    if ((! clp->out_flags.sparse) || (rep->num_blks <= 1))
+        return 0;
+    k = sg_first_non_zero_blk(rep->buffp, clp->bs, rep->num_blks);
+    return (k < rep->num_blks) ? k : 0;
+}
+
+/* For protect=RDP,WRP: the chunk just read has a PI tuple after each block
+ * when RDP > 0, and these are checked. Then the chunk is put in the form
+ * that OFILE takes: with a PI tuple after each block when WRP > 0
+ * (generated if RDP is 0), otherwise just the user data. Returns false,
+ * after stopping the copy, if a check fails. */
+static bool
+pi_chunk(Rq_coll * clp, Rq_elem * rep, int64_t seek_skip)
+{
+    int res, bad;
+    int64_t to_blk = rep->blk + seek_skip;
+
+    if (0 == clp->rdprotect) {
+        sg_t10_pi_expand(rep->buffp, rep->bs, rep->num_blks);
+        sg_t10_pi_gen(rep->buffp, rep->bs, rep->num_blks, 0,
+                      (uint32_t)to_blk, clp->out_pi_type);
+        return true;
+    }
+    res = sg_t10_pi_chk(rep->buffp, rep->bs, rep->num_blks,
+                        (uint32_t)rep->blk, clp->in_pi_type, &bad);
+    if (res) {
+        pr2serr("%sprotect: %s tag check failed at IFILE blk=%" PRId64 "\n",
+                my_name, ((1 == res) ? "guard" : "reference"),
+                rep->blk + bad);
+        if (exit_status <= 0)
+            exit_status = SG_LIB_CAT_PROTECTION;
+        guarded_stop_both(clp);
+        return false;
+    }
+    if (0 == clp->wrprotect)
+        sg_t10_pi_strip(rep->buffp, rep->bs, rep->num_blks);
+    else if ((1 == clp->out_pi_type) &&
+             ((0 != seek_skip) || (1 != clp->in_pi_type)))
+        sg_t10_pi_set_ref(rep->buffp, rep->bs, rep->num_blks,
+                          (uint32_t)to_blk, 1);
+    return true;
+}
+
+/* Write out a chunk with pwrite(), the file position is not used so writes
+ * can be in any order. The first 'zlead' blocks (zeros, see sparse_lead())
+ * are not written. Returns true when all of it was written (or coe ignored
+ * an error), else stops the copy. Enters and exits not holding out_mutex. */
+static bool
+reorder_normal_write(Rq_coll * clp, Rq_elem * rep, int zlead)
+{
+    int len = (rep->num_blks - zlead) * clp->bs;
+    off64_t offset = rep->blk + zlead;
+    int res;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    offset *= clp->bs;
+    while (((res = pwrite(clp->outfd, rep->buffp + (zlead * clp->bs), len,
+                          offset)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        if (clp->out_flags.coe) {
+            pr2serr(">> ignored error for out blk=%" PRId64 " for %d bytes, "
+                    "%s\n", rep->blk, len,
+                    tsafe_strerror(errno, strerr_buff));
+            return true;
+        }
+        pr2serr("error normal write, %s\n",
+                tsafe_strerror(errno, strerr_buff));
+    } else if (res < len)
+        pr2serr("short write at out blk=%" PRId64 ", %d of %d bytes\n",
+                rep->blk, res, len);
+    else
+        return true;
+    guarded_stop_both(clp);
+    return false;
+}
+
+/* Given the chunk (index from SKIP in units of BPT) just written, moves the
+ * first unwritten chunk, and out_blk, past those now written contiguously.
+ * Enters and exits holding out_mutex. */
+static void
+reorder_done(Rq_coll * clp, int64_t chunk, int blocks)
+{
+    int k;
+
+    clp->ro_done[chunk % clp->reorder] = blocks;
+    while ((blocks = clp->ro_done[(k = clp->ro_low % clp->reorder)]) > 0) {
+        clp->ro_done[k] = 0;
+        clp->out_blk += blocks;
+        ++clp->ro_low;
+    }
+}
+
+/* Accounts for a chunk bypassed since it was copied by an earlier run
+ * (resume=). A normal OFILE written in order has its file position moved
+ * past the chunk. Enters and exits holding out_mutex. */
+static bool
+out_resumed(Rq_coll * clp, Rq_elem * rep, int blocks)
+{
+    off64_t offset = (off64_t)blocks * clp->bs;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    if ((0 == clp->reorder) && (FT_SG != clp->out_type) &&
+        (FT_DEV_NULL != clp->out_type) &&
+        (lseek64(clp->outfd, offset, SEEK_CUR) < 0)) {
+        pr2serr("resume: lseek64 on output, out blk=%" PRId64 ", %s\n",
+                rep->blk, tsafe_strerror(errno, strerr_buff));
+        guarded_stop_in(clp);
+        clp->out_stop = true;
+        return false;
+    }
+    clp->out_rem_count -= blocks;
+    clp->resumed_num += blocks;
+    return true;
+}
+
+/* With reorder=RW the chunk just read is written without waiting for those
+ * before it, unless it is RW or more chunks past the first unwritten one.
+ * Returns true when the worker should leave its loop. */
+static bool
+reorder_write(Rq_coll * clp, Rq_elem * rep, int64_t seek_skip,
+              bool stop_after_write)
+{
+    bool ok;
+    bool zeros = (! rep->done_before) && sparse_chunk(clp, rep);
+    int blocks = rep->num_blks;
+    int status;
+    int zlead = 0;
+    int64_t chunk = (rep->blk - clp->skip) / clp->bpt;
+
+    if (0 == blocks)
+        return true;    /* read nothing, earlier chunks may still be busy */
+    if ((clp->rdprotect || clp->wrprotect) && (! rep->done_before) &&
+        (! pi_chunk(clp, rep, seek_skip)))
+        return true;
+    if (clp->dgst_fp)   /* while the chunk is still in the CPU cache */
+        rep->crc = sg_crc32c(0, rep->buffp, blocks * rep->bs);
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    while ((! clp->out_stop) && (chunk >= (clp->ro_low + clp->reorder))) {
+        pthread_cleanup_push(cleanup_out, (void *)clp);
+        status = pthread_cond_wait(&clp->out_sync_cv, &clp->out_mutex);
+        if (0 != status) err_exit(status, "cond out_sync_cv");
+        pthread_cleanup_pop(0);
+    }
+    if (clp->out_stop || (clp->out_count <= 0)) {
+        clp->out_stop = true;
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        return true;
+    }
+    rep->wr = true;
+    rep->blk += seek_skip;
+    clp->out_count -= blocks;
+    if (rep->done_before) {
+        out_resumed(clp, rep, blocks);
+        reorder_done(clp, chunk, blocks);
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        pthread_cond_broadcast(&clp->out_sync_cv);
+        return stop_after_write;
+    }
+
+    rep->sparse = zeros;
+    pthread_cleanup_push(cleanup_out, (void *)clp);
+    if (FT_SG == clp->out_type)
+        ok = sg_out_operation(clp, rep); /* releases out_mutex */
+    else {
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        if ((FT_DEV_NULL == clp->out_type) || zeros)
+            ok = true;
+        else {
+            zlead = sparse_lead(clp, rep);
+            ok = reorder_normal_write(clp, rep, zlead);
+        }
+    }
+    pthread_cleanup_pop(0);
+
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    if (ok) {
+        if (FT_SG != clp->out_type) {
+            clp->out_rem_count -= blocks;
+            clp->out_sparse_num += zeros ? blocks : zlead;
+        }
+        reorder_done(clp, chunk, blocks);
+    }
+    status = pthread_mutex_unlock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "unlock out_mutex");
+    pthread_cond_broadcast(&clp->out_sync_cv);
+    if (ok && clp->fan_num)
+        ok = fan_out(clp, rep);
+    if (ok && clp->dgst_fp)
+        record_digest(clp, rep);
+    if (ok)
+        resume_set_done(clp, chunk);
+    return stop_after_write || (! ok);
+}
+
+/* Writes the chunk just read once it is next in block order. Returns true
+ * when the worker should leave its loop. */
+static bool
+ordered_write(Rq_coll * clp, Rq_elem * rep, int64_t seek_skip,
+              bool stop_after_write, int blocks)
+{
+    volatile bool ok = true;
+    bool zeros = (! rep->done_before) && sparse_chunk(clp, rep);
+    int status;
+    int64_t chunk = (rep->blk - clp->skip) / clp->bpt;
+
+    if ((clp->rdprotect || clp->wrprotect) && (rep->num_blks > 0) &&
+        (! rep->done_before) && (! pi_chunk(clp, rep, seek_skip)))
+        return true;
+    if (clp->dgst_fp && (rep->num_blks > 0))  /* while still in CPU cache */
+        rep->crc = sg_crc32c(0, rep->buffp, rep->num_blks * rep->bs);
+
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    if (FT_DEV_NULL != clp->out_type) {
+        while ((! clp->out_stop) &&
+               ((rep->blk + seek_skip) != clp->out_blk)) {
+            /* if write would be out of sequence then wait */
+            pthread_cleanup_push(cleanup_out, (void *)clp);
+            status = pthread_cond_wait(&clp->out_sync_cv, &clp->out_mutex);
+            if (0 != status) err_exit(status, "cond out_sync_cv");
+            pthread_cleanup_pop(0);
+        }
+    }
+
+    if (clp->out_stop || (clp->out_count <= 0)) {
+        if (! clp->out_stop)
+            clp->out_stop = true;
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        return true;
+    }
+    if (stop_after_write)
+        clp->out_stop = true;
+    rep->wr = true;
+    rep->blk = clp->out_blk;
+    clp->out_blk += blocks;
+    clp->out_count -= blocks;
+
+    if (0 == rep->num_blks) {
+        clp->out_stop = true;
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        return true;    /* read nothing so leave loop */
+    }
+
+    rep->sparse = zeros;
+    pthread_cleanup_push(cleanup_out, (void *)clp);
+    if (rep->done_before) {
+        ok = out_resumed(clp, rep, blocks);
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+    } else if (FT_SG == clp->out_type)
+        ok = sg_out_operation(clp, rep); /* releases out_mutex mid op */
+    else if (FT_DEV_NULL == clp->out_type) {
+        /* skip actual write operation */
+        clp->out_rem_count -= blocks;
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+    } else if (zeros) {
+        ok = normal_out_sparse(clp, rep, blocks);
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+    }
+    else {
+        ok = normal_out_operation(clp, rep, blocks);
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+    }
+    pthread_cleanup_pop(0);
+    if (ok && clp->fan_num && (! rep->done_before))
+        ok = fan_out(clp, rep);
+    if (ok && clp->dgst_fp)
+        record_digest(clp, rep);
+    if (ok && (! rep->done_before))
+        resume_set_done(clp, chunk);
+
+    if (stop_after_write)
+        return true;
+    pthread_cond_broadcast(&clp->out_sync_cv);
+    return false;
+}
+
+/* Returns the oflag=zbc zone holding OFILE block blk */
+static struct zbc_zone *
+zbc_find(const struct zbc_t * zbp, int64_t blk)
+{
+    int lo = 0;
+    int hi = zbp->num - 1;
+    int mid;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (zbp->zp[mid].start <= blk)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return zbp->zp + lo;
+}
+
+/* Waits until blk is at the write pointer of its zone zp, no WRITE to zp
+ * is in flight and zp is open, opening it when its turn comes and there
+ * is room. Enters and exits holding out_mutex. Returns false when the
+ * copy is stopping. */
+static bool
+zbc_wait(Rq_coll * clp, struct zbc_zone * zp, int64_t blk)
+{
+    int status;
+    struct zbc_t * zbp = &clp->zbc;
+    int ind = zp - zbp->zp;
+
+    while ((! clp->out_stop) &&
+           (zp->busy || (zp->wp != blk) || (ind > zbp->next_open) ||
+            ((ind == zbp->next_open) && (ZBC_ZT_CONV != zp->type) &&
+             (zbp->active >= zbp->max_open)))) {
+        pthread_cleanup_push(cleanup_out, (void *)clp);
+        status = pthread_cond_wait(&clp->out_sync_cv, &clp->out_mutex);
+        if (0 != status) err_exit(status, "cond out_sync_cv");
+        pthread_cleanup_pop(0);
+    }
+    if (clp->out_stop)
+        return false;
+    if (ind == zbp->next_open) {
+        ++zbp->next_open;
+        if (ZBC_ZT_CONV != zp->type)
+            ++zbp->active;
+    }
+    return true;
+}
+
+/* Writes the part of a chunk in one zone. Enters and exits holding
+ * out_mutex, which is released while the WRITE is in flight. */
+static bool
+zbc_out_operation(Rq_coll * clp, Rq_elem * rep)
+{
+    volatile bool ok;
+    int status;
+
+    pthread_cleanup_push(cleanup_out, (void *)clp);
+    ok = sg_out_operation(clp, rep); /* releases out_mutex */
+    pthread_cleanup_pop(0);
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    return ok;
+}
+
+/* With oflag=zbc the chunk just read is written, a part per zone it falls
+ * in, once that zone's write pointer reaches it. Each zone has at most one
+ * WRITE in flight (SCSI has no zone append) but different zones are
+ * written in parallel. Zones are opened in ascending order, no more than
+ * max_open write pointer zones at once, so the earliest unwritten chunk
+ * can always go ahead. Returns true when the worker should leave its
+ * loop. */
+static bool
+zbc_write(Rq_coll * clp, Rq_elem * rep, int64_t seek_skip,
+          bool stop_after_write)
+{
+    bool ok = true;
+    int blocks = rep->num_blks;
+    int k, n, status;
+    int64_t blk;
+    int64_t first = rep->blk + seek_skip;
+    int64_t chunk = (rep->blk - clp->skip) / clp->bpt;
+    uint8_t * buffp = rep->buffp;
+    struct zbc_t * zbp = &clp->zbc;
+    struct zbc_zone * zp;
+
+    if (0 == blocks)
+        return true;    /* read nothing, earlier chunks may still be busy */
+    if ((clp->rdprotect || clp->wrprotect) &&
+        (! pi_chunk(clp, rep, seek_skip)))
+        return true;
+    if (clp->dgst_fp)   /* while the chunk is still in the CPU cache */
+        rep->crc = sg_crc32c(0, rep->buffp, blocks * rep->bs);
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    if (clp->out_stop || (clp->out_count <= 0)) {
+        clp->out_stop = true;
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        return true;
+    }
+    clp->out_count -= blocks;
+    rep->wr = true;
+    rep->sparse = false;
+    for (n = 0, blk = first; ok && (n < blocks); n += k, blk += k) {
+        zp = zbc_find(zbp, blk);
+        k = blocks - n;
+        if (k > (zp->start + zp->len - blk))
+            k = (int)(zp->start + zp->len - blk);
+        if (! zbc_wait(clp, zp, blk)) {
+            ok = false;
+            break;
+        }
+        zp->busy = true;
+        rep->blk = blk;
+        rep->num_blks = k;
+        rep->buffp = buffp + ((size_t)n * rep->bs);
+        ok = zbc_out_operation(clp, rep);
+        zp->busy = false;
+        if (ok) {
+            zp->wp += k;
+            if ((zp->wp >= (zp->start + zp->len)) &&
+                (ZBC_ZT_CONV != zp->type))
+                --zbp->active;
+        }
+        pthread_cond_broadcast(&clp->out_sync_cv);
+    }
+    rep->blk = first;
+    rep->num_blks = blocks;
+    rep->buffp = buffp;
+    status = pthread_mutex_unlock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "unlock out_mutex");
+    pthread_cond_broadcast(&clp->out_sync_cv);
+    if (ok && clp->fan_num)
+        ok = fan_out(clp, rep);
+    if (ok && clp->dgst_fp)
+        record_digest(clp, rep);
+    if (ok)
+        resume_set_done(clp, chunk);
+    return stop_after_write || (! ok);
+}
+
+/* Writes the chunk just read as the output options call for. Returns
+ * true when the worker should leave its loop. */
+static bool
+write_chunk(Rq_coll * clp, Rq_elem * rep, int64_t seek_skip,
+            bool stop_after_write, int blocks)
+{
+    if (clp->zbc.num > 0)
+        return zbc_write(clp, rep, seek_skip, stop_after_write);
+    if (clp->reorder > 0)
+        return reorder_write(clp, rep, seek_skip, stop_after_write);
+    return ordered_write(clp, rep, seek_skip, stop_after_write, blocks);
+}
+
+/* Returns the NUMA node of the (sg, block or raw) device open on fd found by
+ * walking up its sysfs directories to one with a "numa_node" attribute (e.g.
+ * of the HBA's PCI function), else -1 */
+/* For engine=auto|sync|queue, after IFILE and OFILE are open. Probes the
+ * sg driver in front of them, then picks the number of worker threads,
+ * whether each keeps several READs in flight (elems=) and direct IO.
+ * Options given explicitly are not overridden; 'no_elems' is set when
+ * other options rule out elems= . Returns 0 or SG_LIB_CONTRADICT . */
+static int
+choose_engine(Rq_coll * clp, int engine, bool thr_given, bool elems_given,
+              bool dio_given, bool no_elems)
+{
+    bool elems_ok;
+    long ncpus;
+    struct stat st;
+    struct sg_io_caps in_caps, out_caps;
+    const struct sg_io_caps * cp;
+    char b[128];
+
+    /* as checked for elems= later: READs in flight need offsets */
+    elems_ok = (! no_elems) &&
+               ((FT_SG == clp->in_type) || (FT_BLOCK == clp->in_type) ||
+                (FT_RAW == clp->in_type) ||
+                ((FT_OTHER == clp->in_type) &&
+                 (0 == fstat(clp->infd, &st)) && S_ISREG(st.st_mode)));
+    if (ENGINE_SYNC == engine) {
+        if (clp->elems > 1) {
+            pr2serr("%sengine=sync contradicts elems=%d\n", my_name,
+                    clp->elems);
+            return SG_LIB_CONTRADICT;
+        }
+        return 0;
+    }
+    if (ENGINE_QUEUE == engine) {
+        if (! elems_ok) {
+            pr2serr("%sengine=queue needs elems= to be usable, see "
+                    "elems=\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if (! elems_given)
+            clp->elems = AUTO_ELEMS;
+        return 0;
+    }
+    /* engine=auto */
+    sg_io_probe_caps((FT_SG == clp->in_type) ? clp->infd : -1, &in_caps,
+                     clp->debug);
+    sg_io_probe_caps((FT_SG == clp->out_type) ? clp->outfd : -1, &out_caps,
+                     clp->debug);
+    cp = (FT_SG == clp->in_type) ? &in_caps : &out_caps;
+    if (! thr_given) {
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpus > AUTO_MAX_THREADS)
+            ncpus = AUTO_MAX_THREADS;
+        if (ncpus > num_threads)
+            num_threads = (int)ncpus;
+    }
+    /* sg READs queue in the driver; normal reads need io_uring */
+    if ((! elems_given) && elems_ok &&
+        ((FT_SG == clp->in_type) || in_caps.uring))
+        clp->elems = AUTO_ELEMS;
+    if ((! dio_given) && in_caps.dio) {
+        if (FT_SG == clp->in_type)
+            clp->in_flags.dio = true;
+        if (FT_SG == clp->out_type)
+            clp->out_flags.dio = true;
+    }
+    pr2serr("%sengine=auto: %s; using thr=%d elems=%d%s\n", my_name,
+            sg_io_caps_str(cp, sizeof(b), b), num_threads, clp->elems,
+            (clp->in_flags.dio || clp->out_flags.dio) ? " with direct IO" :
+                                                        "");
+    if (cp->v4_share && clp->debug)
+        pr2serr("%s    this sg driver also has request sharing, as used by "
+                "sgh_dd\n", my_name);
+    return 0;
+}
+
+static int
+dev_numa_node(int fd)
+{
+    int node = -1;
+    char * cp;
+    FILE * fp;
+    struct stat st;
+    char b[PATH_MAX];
+    char path[PATH_MAX + 16];
+
+    if ((fstat(fd, &st) < 0) ||
+        ! (S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode)))
+        return -1;
+    snprintf(path, sizeof(path), "/sys/dev/%s/%u:%u",
+             S_ISBLK(st.st_mode) ? "block" : "char", major(st.st_rdev),
+             minor(st.st_rdev));
+    if (NULL == realpath(path, b))
+        return -1;
+    while (0 == strncmp(b, "/sys/devices/", 13)) {
+        snprintf(path, sizeof(path), "%s/numa_node", b);
+        if ((fp = fopen(path, "r"))) {
+            if (1 != fscanf(fp, "%d", &node))
+                node = -1;
+            fclose(fp);
+            if (node >= 0)
+                break;
+        }
+        if (NULL == (cp = strrchr(b, '/')))
+            break;
+        *cp = '\0';
+    }
+    return node;
+}
+
+/* Returns the bpt=auto transfer size (in blocks) for the copy between
+ * clp->infd and clp->outfd, see sg_io_auto_bpt(). Returns def_bpt when
+ * neither side is a device. */
+static int
+auto_bpt(Rq_coll * clp, const char * inf, const char * outf, int def_bpt)
+{
+    struct sg_io_bpt_side in_side, out_side;
+
+    memset(&in_side, 0, sizeof(in_side));
+    in_side.fd = clp->infd;
+    in_side.ftype = clp->in_type;
+    in_side.dsp = &clp->in_ds;
+    in_side.fname = inf;
+    out_side = in_side;
+    out_side.fd = clp->outfd;
+    out_side.ftype = clp->out_type;
+    out_side.dsp = &clp->out_ds;
+    out_side.fname = outf;
+    return sg_io_auto_bpt(&in_side, &out_side, clp->bs, def_bpt,
+                          clp->debug);
+}
+
+/* Places the CPUs of the given NUMA node, from its "cpulist" in sysfs
+ * (e.g. "0-7,16-23"), in *csp. Returns the number of CPUs. */
+static int
+numa_node_cpus(int node, cpu_set_t * csp)
+{
+    int lo, hi;
+    char * cp;
+    FILE * fp;
+    char b[1024];
+
+    CPU_ZERO(csp);
+    snprintf(b, sizeof(b), "/sys/devices/system/node/node%d/cpulist", node);
+    if (NULL == (fp = fopen(b, "r")))
+        return 0;
+    cp = fgets(b, sizeof(b), fp);
+    fclose(fp);
+    while (cp && isdigit((uint8_t)*cp)) {
+        lo = (int)strtol(cp, &cp, 10);
+        hi = ('-' == *cp) ? (int)strtol(cp + 1, &cp, 10) : lo;
+        for ( ; (lo <= hi) && (lo < CPU_SETSIZE); ++lo)
+            CPU_SET(lo, csp);
+        if (',' != *cp)
+            break;
+        ++cp;
+    }
+    return CPU_COUNT(csp);
+}
+
+/* Runs the calling worker thread on the CPUs of clp->numa_node and has its
+ * memory (e.g. transfer buffers, on first touch) come from that node */
+static void
+numa_bind_thread(const Rq_coll * clp)
+{
+    int status;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    if (clp->numa_node < 0)
+        return;
+    status = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                    &clp->numa_cpus);
+    if ((0 != status) && clp->debug)
+        pr2serr("%spthread_setaffinity_np: %s\n", my_name,
+                tsafe_strerror(status, strerr_buff));
+#ifdef SYS_set_mempolicy
+    {
+        unsigned long mask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+
+        memset(mask, 0, sizeof(mask));
+        mask[clp->numa_node / (8 * sizeof(unsigned long))] |=
+                1UL << (clp->numa_node % (8 * sizeof(unsigned long)));
+        if ((syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                     MAX_NUMA_NODES + 1) < 0) && clp->debug)
+            perror("sgp_dd: set_mempolicy");
+    }
+#endif
+}
+
+/* Sets up a request element and its buffer for a worker thread */
+/* Returns a buffer for one chunk, exits if there is no memory for it */
+static uint8_t *
+get_rq_buff(const Rq_coll * clp)
+{
+    uint8_t * bp;
+
+    /* dio pins user pages for each command, so pin them once up front */
+    bp = sg_hugebuf_get(clp->bpt * (clp->bs +
+                        ((clp->rdprotect || clp->wrprotect) ?
+                         SG_T10_PI_LEN : 0)),
+                        clp->in_flags.dio || clp->out_flags.dio ||
+                        clp->in_flags.direct || clp->out_flags.direct,
+                        clp->debug > 3);
+    if (NULL == bp)
+        err_exit(ENOMEM, "out of memory creating user buffers\n");
+    return bp;
+}
+
+static void
+init_rq_elem(Rq_coll * clp, Rq_elem * rep)
+{
+    memset(rep, 0, sizeof(Rq_elem));
+    rep->buffp = get_rq_buff(clp);
+    if (clp->numa_node >= 0)      /* fault in from this thread's node */
+        memset(rep->buffp, 0, clp->bpt * clp->bs);
+
+    /* Following clp members are constant during lifetime of thread */
+    rep->bs = clp->bs;
+    rep->rdprotect = clp->rdprotect;
+    rep->wrprotect = clp->wrprotect;
+    rep->infd = clp->infd;
+    rep->outfd = clp->outfd;
+    if (clp->in_stripe.num > 0)
+        rep->in_stripe = &clp->in_stripe;
+    if (clp->out_stripe.num > 0)
+        rep->out_stripe = &clp->out_stripe;
+    if (clp->in_mpath.num > 0)
+        rep->in_mpath = &clp->in_mpath;
+    if (clp->out_mpath.num > 0)
+        rep->out_mpath = &clp->out_mpath;
+    rep->member = -1;
+    rep->path = -1;
+    rep->debug = clp->debug;
+    rep->cdbsz_in = clp->cdbsz_in;
+    rep->cdbsz_out = clp->cdbsz_out;
+    rep->in_flags = clp->in_flags;
+    rep->out_flags = clp->out_flags;
+    rep->qd_active = clp->in_qd.active || clp->out_qd.active;
+    rep->rate_lat = clp->rate_active && (clp->rate.target_ns > 0);
+}
+
+/* Member of clp->sched that the calling worker thread claims from first,
+ * or -1 when claims are not per member. The first worker gets the member
+ * holding the first chunk since the copy waits on it before starting
+ * the other workers. */
+static int
+worker_member(Rq_coll * clp)
+{
+    if (NULL == clp->sched)
+        return -1;
+    return (int)(SGP_FETCH_ADD(&clp->st_next_member, 1) % clp->sched->num);
+}
+
+/* Stream identifier the calling worker thread writes with, or 0 when
+ * streams= not given */
+static uint16_t
+worker_stream(Rq_coll * clp)
+{
+    if (clp->num_streams < 1)
+        return 0;
+    return clp->str_id[SGP_FETCH_ADD(&clp->str_next_thr, 1) %
+                       clp->num_streams];
+}
+
+/* Called as a worker thread leaves, so the others stop reading */
+static void
+worker_fini(Rq_coll * clp)
+{
+    int status;
+
+    status = pthread_mutex_lock(&clp->in_mutex);
+    if (0 != status) err_exit(status, "lock in_mutex");
+    if (! clp->in_stop)
+        clp->in_stop = true;  /* flag other workers to stop */
+    status = pthread_mutex_unlock(&clp->in_mutex);
+    if (0 != status) err_exit(status, "unlock in_mutex");
+    pthread_cond_broadcast(&clp->out_sync_cv);
+}
+
+static void *
+read_write_thread(void * v_clp)
+{
+    Rq_coll * clp;
+    Rq_elem rel;
+    Rq_elem * rep = &rel;
+    volatile bool stop_after_write = false;
+    volatile int blocks;
+    int64_t seek_skip;
+    int status;
+
+    clp = (Rq_coll *)v_clp;
+    seek_skip =  clp->seek - clp->skip;
+    numa_bind_thread(clp);
+    init_rq_elem(clp, rep);
+    rep->member = worker_member(clp);
+    rep->str_id = worker_stream(clp);
+    rep->st = worker_stats(clp);
+
+    while(1) {
+        rep->wr = false;
+        if (FT_SG == clp->in_type) {
+            blocks = in_claim(clp, rep);
+            if (blocks <= 0)
+                break;  /* no more to do, exit loop then thread */
+            rep->num_blks = blocks;
+            if (resume_claimed(clp, rep))
+                SGP_FETCH_ADD(&clp->in_rem_count, -blocks);
+            else {
+                rate_wait(clp, blocks);
+                sg_in_operation(clp, rep);
+            }
+        } else {
+            /* read() uses the file position so claim and read in step */
+            status = pthread_mutex_lock(&clp->in_mutex);
+            if (0 != status) err_exit(status, "lock in_mutex");
+            blocks = in_claim(clp, rep);
+            if (blocks <= 0) {
+                status = pthread_mutex_unlock(&clp->in_mutex);
+                if (0 != status) err_exit(status, "unlock in_mutex");
+                break;
+            }
+            rep->num_blks = blocks;
+            pthread_cleanup_push(cleanup_in, (void *)clp);
+            if (resume_claimed(clp, rep))
+                stop_after_write = normal_in_resumed(clp, rep, blocks);
+            else {
+                rate_wait(clp, blocks);
+                stop_after_write = normal_in_operation(clp, rep, blocks);
+            }
+            pthread_cleanup_pop(0);
+            status = pthread_mutex_unlock(&clp->in_mutex);
+            if (0 != status) err_exit(status, "unlock in_mutex");
+        }
+
+        if (write_chunk(clp, rep, seek_skip, stop_after_write, blocks))
+            break;
+    } /* end of while loop */
+    sg_hugebuf_put(rep->buffp);
+    worker_fini(clp);
+    return stop_after_write ? NULL : clp;
+}
+
+/* xorshift64, as used by sg_bench; the state must not be 0 */
+static uint64_t
+wl_rand(uint64_t * statep)
+{
+    uint64_t x = *statep;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *statep = x;
+    return x;
+}
+
+/* Sum of 1/k^theta for k from 1 to n. Past ZIPF_EXACT_MAX terms the rest
+ * is approximated by the integral, which is close since by then each term
+ * differs little from the next. */
+static double
+zeta(int64_t n, double theta)
+{
+    int64_t k;
+    int64_t m = (n > ZIPF_EXACT_MAX) ? ZIPF_EXACT_MAX : n;
+    double sum = 0.0;
+
+    for (k = 1; k <= m; ++k)
+        sum += 1.0 / pow((double)k, theta);
+    if (n > m)
+        sum += (pow((double)n, 1.0 - theta) - pow((double)m, 1.0 - theta)) /
+               (1.0 - theta);
+    return sum;
+}
+
+/* Prepares a zipf distribution of n chunks with skew theta (0 < theta < 1)
+ * for zipf_next(). This is the method of Gray et al., "Quickly Generating
+ * Billion-Record Synthetic Databases" (SIGMOD 1994), as used by YCSB. */
+static void
+zipf_init(struct zipf_t * zp, int64_t n, double theta)
+{
+    zp->n = n;
+    zp->theta = theta;
+    zp->alpha = 1.0 / (1.0 - theta);
+    zp->zetan = zeta(n, theta);
+    /* with 2 or less chunks zipf_next() never needs eta */
+    zp->eta = (n > 2) ? (1.0 - pow(2.0 / n, 1.0 - theta)) /
+                        (1.0 - zeta(2, theta) / zp->zetan) : 0.0;
+}
+
+/* Returns a chunk index from 0 to n - 1, lower indexes being more likely;
+ * index 0 is chosen about 1/zetan of the time */
+static int64_t
+zipf_next(const struct zipf_t * zp, uint64_t * statep)
+{
+    double u = (wl_rand(statep) >> 11) * (1.0 / 9007199254740992.0);
+    double uz = u * zp->zetan;
+    int64_t k;
+
+    if (uz < 1.0)
+        return 0;
+    if (uz < 1.0 + pow(0.5, zp->theta))
+        return 1;
+    k = (int64_t)(zp->n * pow(zp->eta * u - zp->eta + 1.0, zp->alpha));
+    return (k < zp->n) ? k : zp->n - 1;
+}
+
+/* Worker thread for pattern=rand|zipf or mix=RPCT. With pattern=rand|zipf
+ * each thread issues its share of the chunks in the range at offsets from
+ * its own random stream, seeded from seed=S and the thread's number, so
+ * the sequence each thread issues is the same from run to run. Otherwise
+ * the chunks are claimed in ascending order. Each chunk is read from IFILE
+ * and written to the same offset from SEEK on OFILE; with mix=RPCT that
+ * percentage of the chunks are only read and the others only written (from
+ * the buffer as last read, initially zeros). IFILE and OFILE are each a sg
+ * device or /dev/null. Returns NULL after an error. */
+static void *
+workload_thread(void * v_clp)
+{
+    Rq_coll * clp = (Rq_coll *)v_clp;
+    Rq_elem rel;
+    Rq_elem * rep = &rel;
+    volatile bool ok = true;
+    volatile bool wr;
+    bool rd;
+    volatile int blocks;
+    int status;
+    volatile int64_t off;
+    int64_t k, quota;
+    int64_t thr = SGP_FETCH_ADD(&clp->wl_next_thr, 1);
+    uint64_t rng;
+
+    numa_bind_thread(clp);
+    init_rq_elem(clp, rep);
+    rep->str_id = worker_stream(clp);
+    rep->st = worker_stats(clp);
+    /* the lower numbered threads take any remainder */
+    quota = clp->wl_chunks / num_threads;
+    if (thr < (clp->wl_chunks % num_threads))
+        ++quota;
+    rng = (clp->seed ^ ((uint64_t)(thr + 1) * 0x9e3779b97f4a7c15ULL)) | 1;
+
+    for (k = 0; ok && (! clp->in_stop); ++k) {
+        if (PAT_SEQ == clp->pattern) {
+            off = SGP_FETCH_ADD(&clp->in_claimed, clp->bpt);
+            if (off >= clp->in_total)
+                break;
+        } else {
+            if (k >= quota)
+                break;
+            off = clp->bpt * ((PAT_ZIPF == clp->pattern) ?
+                              zipf_next(&clp->zipf, &rng) :
+                              (int64_t)(wl_rand(&rng) %
+                                        (uint64_t)clp->wl_chunks));
+        }
+        blocks = ((clp->in_total - off) > clp->bpt) ? clp->bpt :
+                                                      (int)(clp->in_total -
+                                                            off);
+        rd = true;
+        wr = true;
+        if (clp->mix >= 0) {
+            rd = ((int)(wl_rand(&rng) % 100) < clp->mix);
+            wr = ! rd;
+        }
+        rep->num_blks = blocks;
+        rate_wait(clp, blocks);
+
+        if (rd) {
+            SGP_FETCH_ADD(&clp->wl_reads, 1);
+            if (FT_SG == clp->in_type) {
+                rep->wr = false;
+                rep->blk = clp->skip + off;
+                sg_in_operation(clp, rep);
+                if (clp->in_stop)
+                    ok = false;
+            } else      /* /dev/null */
+                SGP_FETCH_ADD(&clp->in_rem_count, -blocks);
+        } else          /* not read, but counted as done */
+            SGP_FETCH_ADD(&clp->in_rem_count, -blocks);
+        if (! ok)
+            break;
+
+        status = pthread_mutex_lock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "lock out_mutex");
+        if (clp->out_stop) {
+            status = pthread_mutex_unlock(&clp->out_mutex);
+            if (0 != status) err_exit(status, "unlock out_mutex");
+            ok = false;
+            break;
+        }
+        clp->out_count -= blocks;
+        if (wr)
+            SGP_FETCH_ADD(&clp->wl_writes, 1);
+        pthread_cleanup_push(cleanup_out, (void *)clp);
+        if (wr && (FT_SG == clp->out_type)) {
+            rep->wr = true;
+            rep->blk = clp->seek + off;
+            rep->sparse = false;
+            ok = sg_out_operation(clp, rep); /* releases out_mutex mid op */
+        } else {        /* /dev/null or not written */
+            clp->out_rem_count -= blocks;
+            status = pthread_mutex_unlock(&clp->out_mutex);
+            if (0 != status) err_exit(status, "unlock out_mutex");
+        }
+        pthread_cleanup_pop(0);
+        if (0 == k)     /* main() waits for the first one to finish */
+            pthread_cond_broadcast(&clp->out_sync_cv);
+    }
+    sg_hugebuf_put(rep->buffp);
+    /* taking out_mutex ensures main() is waiting before the broadcast */
+    status = pthread_mutex_lock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "lock out_mutex");
+    status = pthread_mutex_unlock(&clp->out_mutex);
+    if (0 != status) err_exit(status, "unlock out_mutex");
+    pthread_cond_broadcast(&clp->out_sync_cv);
+    return ok ? clp : NULL;
+}
+
+static void
+uring_free(struct sgp_uring * urp)
+{
+#ifdef SGP_HAVE_URING
+    if (urp->sqes)
+        munmap(urp->sqes, urp->sqes_sz);
+    if (urp->cq_ring && (urp->cq_ring != urp->sq_ring))
+        munmap(urp->cq_ring, urp->cq_ring_sz);
+    if (urp->sq_ring)
+        munmap(urp->sq_ring, urp->sq_ring_sz);
+#endif
+    if (urp->ring_fd >= 0)
+        close(urp->ring_fd);
+    memset(urp, 0, sizeof(*urp));
+    urp->ring_fd = -1;
+}
+
+/* Sets up an io_uring with n entries for the normal reads of one worker
+ * thread and registers the buffers of its n request elements with it, so
+ * the kernel need not map them for each read. Neither is an error when
+ * refused (e.g. ENOSYS or RLIMIT_MEMLOCK), pread() or unregistered
+ * buffers are used instead. */
+static void
+uring_setup(Rq_coll * clp, struct sgp_uring * urp, Rq_elem * reps, int n)
+{
+#ifdef SGP_HAVE_URING
+    int k;
+    uint8_t * bp;
+    struct io_uring_params params;
+    struct iovec iov[MAX_ELEMS];
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    memset(urp, 0, sizeof(*urp));
+    memset(&params, 0, sizeof(params));
+    urp->ring_fd = syscall(__NR_io_uring_setup, n, &params);
+    if (urp->ring_fd < 0) {
+        if (clp->debug)
+            pr2serr("%sio_uring_setup: %s, so using pread()\n", my_name,
+                    tsafe_strerror(errno, strerr_buff));
+        return;
+    }
+    urp->sq_ring_sz = params.sq_off.array +
+                      (params.sq_entries * sizeof(unsigned int));
+    urp->cq_ring_sz = params.cq_off.cqes +
+                      (params.cq_entries * sizeof(struct io_uring_cqe));
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (urp->cq_ring_sz > urp->sq_ring_sz)
+            urp->sq_ring_sz = urp->cq_ring_sz;
+        urp->cq_ring_sz = urp->sq_ring_sz;
+    }
+    urp->sq_ring = mmap(NULL, urp->sq_ring_sz, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                        IORING_OFF_SQ_RING);
+    if (MAP_FAILED == urp->sq_ring) {
+        urp->sq_ring = NULL;
+        goto mmap_err;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        urp->cq_ring = urp->sq_ring;
+    else {
+        urp->cq_ring = mmap(NULL, urp->cq_ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                            IORING_OFF_CQ_RING);
+        if (MAP_FAILED == urp->cq_ring) {
+            urp->cq_ring = NULL;
+            goto mmap_err;
+        }
+    }
+    urp->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+    urp->sqes = (struct io_uring_sqe *)mmap(NULL, urp->sqes_sz,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                                IORING_OFF_SQES);
+    if (MAP_FAILED == (void *)urp->sqes) {
+        urp->sqes = NULL;
+        goto mmap_err;
+    }
+    bp = (uint8_t *)urp->sq_ring;
+    urp->sq_tail = (unsigned int *)(bp + params.sq_off.tail);
+    urp->sq_mask = (unsigned int *)(bp + params.sq_off.ring_mask);
+    urp->sq_array = (unsigned int *)(bp + params.sq_off.array);
+    bp = (uint8_t *)urp->cq_ring;
+    urp->cq_head = (unsigned int *)(bp + params.cq_off.head);
+    urp->cq_tail = (unsigned int *)(bp + params.cq_off.tail);
+    urp->cq_mask = (unsigned int *)(bp + params.cq_off.ring_mask);
+    urp->cqes = (struct io_uring_cqe *)(bp + params.cq_off.cqes);
+
+    for (k = 0; k < n; ++k) {
+        iov[k].iov_base = reps[k].buffp;
+        iov[k].iov_len = clp->bpt * clp->bs;
+    }
+    if (0 == syscall(__NR_io_uring_register, urp->ring_fd,
+                     IORING_REGISTER_BUFFERS, iov, n))
+        urp->fixed = true;
+    else if (clp->debug)
+        pr2serr("%sio_uring buffers not registered: %s\n", my_name,
+                tsafe_strerror(errno, strerr_buff));
+    if (clp->debug > 1)
+        pr2serr("%sio_uring with %u entries, %sregistered buffers\n",
+                my_name, params.sq_entries, urp->fixed ? "" : "no ");
+    return;
+mmap_err:
+    if (clp->debug)
+        pr2serr("%smmap() of io_uring: %s, so using pread()\n", my_name,
+                tsafe_strerror(errno, strerr_buff));
+    uring_free(urp);
+#else
+    if (clp->debug > 1)
+        pr2serr("%sno io_uring in this build, so using pread()\n", my_name);
+    memset(urp, 0, sizeof(*urp));
+    urp->ring_fd = -1;
+    if (reps && n) { ; }        /* unused, dummy to suppress warning */
+#endif
+}
+
+/* Starts reading the chunk of rep (one of reps) from a normal IFILE at its
+ * own offset; the file position is not used so neither is in_mutex.
+ * Returns 0 if started, else -1 after stopping the copy. */
+static int
+normal_in_start(Rq_coll * clp, struct sgp_uring * urp, Rq_elem * reps,
+                Rq_elem * rep)
+{
+    int len = rep->num_blks * clp->bs;
+    off64_t offset = rep->blk;
+
+    offset *= clp->bs;
+    rep->ur_done = false;
+    if (urp->ring_fd < 0) {
+        while (((rep->ur_res = pread(clp->infd, rep->buffp, len, offset))
+                < 0) && ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        if (rep->ur_res < 0)
+            rep->ur_res = -errno;
+        rep->ur_done = true;
+        return 0;
+    }
+#ifdef SGP_HAVE_URING
+    {
+        int res;
+        unsigned int tail, idx;
+        struct io_uring_sqe * sqep;
+        char strerr_buff[STRERR_BUFF_LEN];
+
+        tail = *urp->sq_tail;
+        idx = tail & *urp->sq_mask;
+        sqep = urp->sqes + idx;
+        memset(sqep, 0, sizeof(*sqep));
+        sqep->opcode = urp->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqep->fd = clp->infd;
+        sqep->off = (uint64_t)offset;
+        sqep->addr = (uint64_t)(sg_uintptr_t)rep->buffp;
+        sqep->len = len;
+        if (urp->fixed)
+            sqep->buf_index = (uint16_t)(rep - reps);
+        sqep->user_data = (uint64_t)(rep - reps);
+        urp->sq_array[idx] = idx;
+        __atomic_store_n(urp->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        while (((res = syscall(__NR_io_uring_enter, urp->ring_fd, 1, 0, 0,
+                               NULL, 0)) < 0) && (EINTR == errno))
+            ;
+        if (res < 0) {
+            pr2serr("%sio_uring_enter, in blk=%" PRId64 ": %s\n", my_name,
+                    rep->blk, tsafe_strerror(errno, strerr_buff));
+            qd_release(&clp->in_qd, -1, 0);
+            guarded_stop_both(clp);
+            return -1;
+        }
+    }
+#else
+    if (reps) { ; }     /* unused, dummy to suppress warning */
+#endif
+    return 0;
+}
+
+/* Waits until the read of rep (one of reps) has finished, noting those of
+ * the others that finish first. Returns 0 when done, else -1. */
+static int
+normal_in_wait(struct sgp_uring * urp, Rq_elem * reps, Rq_elem * rep)
+{
+#ifdef SGP_HAVE_URING
+    int res;
+    unsigned int head;
+    const struct io_uring_cqe * cqep;
+
+    while (! rep->ur_done) {
+        head = *urp->cq_head;
+        if (head == __atomic_load_n(urp->cq_tail, __ATOMIC_ACQUIRE)) {
+            res = syscall(__NR_io_uring_enter, urp->ring_fd, 0, 1,
+                          IORING_ENTER_GETEVENTS, NULL, 0);
+            if ((res < 0) && (EINTR != errno))
+                return -1;
+            continue;
+        }
+        cqep = urp->cqes + (head & *urp->cq_mask);
+        reps[cqep->user_data].ur_res = cqep->res;
+        reps[cqep->user_data].ur_done = true;
+        __atomic_store_n(urp->cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+#else
+    if (urp && reps && rep) { ; }  /* unused, dummy to suppress warning */
+#endif
+    return 0;
+}
+
+/* Takes the outcome of a read started by normal_in_start(), handled as
+ * normal_in_operation() does. Returns 0 when the data is ready to write,
+ * 1 when the read has been started again (so call this again), 2 when it
+ * was short (end of IFILE) so the copy stops after it is written, else -1
+ * after stopping the copy. */
+static int
+normal_in_reap(Rq_coll * clp, struct sgp_uring * urp, Rq_elem * reps,
+               Rq_elem * rep)
+{
+    int res, status;
+    int len = rep->num_blks * clp->bs;
+    int ret = 0;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    if (normal_in_wait(urp, reps, rep)) {
+        pr2serr("%sio_uring_enter waiting, in blk=%" PRId64 ": %s\n",
+                my_name, rep->blk, tsafe_strerror(errno, strerr_buff));
+        rep->ur_done = true;    /* ring unusable, stop waiting on it */
+        qd_release(&clp->in_qd, -1, 0);
+        guarded_stop_both(clp);
+        return -1;
+    }
+    res = rep->ur_res;
+    if ((-EINTR == res) || (-EAGAIN == res))
+        return normal_in_start(clp, urp, reps, rep) ? -1 : 1;
+    qd_release(&clp->in_qd, (res < 0) ? -1 : 0, 0);
+    if (res < 0) {
+        if (clp->in_flags.coe) {
+            memset(rep->buffp, 0, len);
+            pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
+                    "bytes, %s\n", rep->blk, len,
+                    tsafe_strerror(-res, strerr_buff));
+            res = len;
+        } else {
+            pr2serr("error in normal read, %s\n",
+                    tsafe_strerror(-res, strerr_buff));
+            clp->in_stop = true;
+            guarded_stop_out(clp);
+            return -1;
+        }
+    }
+    if (res < len) {
+        ret = 2;
+        clp->in_stop = true;    /* claim no more */
+        rep->num_blks = res / clp->bs;
+        if ((res % clp->bs) > 0) {
+            rep->num_blks++;
+            status = pthread_mutex_lock(&clp->in_mutex);
+            if (0 != status) err_exit(status, "lock in_mutex");
+            clp->in_partial++;
+            status = pthread_mutex_unlock(&clp->in_mutex);
+            if (0 != status) err_exit(status, "unlock in_mutex");
+        }
+    }
+    SGP_FETCH_ADD(&clp->in_rem_count, -rep->num_blks);
+    return ret;
+}
+
+/* Worker thread used when elems=N (N > 1). Each thread keeps up to N READs
+ * (or, for a normal IFILE, io_uring reads) in flight, taking their
+ * responses (and then writing them out) in the order they were claimed. */
+static void *
+read_write_elems_thread(void * v_clp)
+{
+    Rq_coll * clp = (Rq_coll *)v_clp;
+    bool no_more = false;
+    bool leave = false;
+    bool pending = false;   /* next READ claimed but held by rate= */
+    bool normal_in = (FT_SG != clp->in_type);
+    int k, res, member;
+    int n = clp->elems;
+    uint16_t str_id;
+    int head = 0;
+    int count = 0;      /* number of READs in flight */
+    uint64_t due_ns = 0;    /* when the pending READ may be issued */
+    uint64_t now_ns;
+    int64_t seek_skip = clp->seek - clp->skip;
+    Rq_elem * rep;
+    Rq_elem * reps;
+    struct thr_stats * stp;
+    struct sgp_uring ur;
+
+    numa_bind_thread(clp);
+    reps = (Rq_elem *)calloc(n, sizeof(Rq_elem));
+    if (NULL == reps)
+        err_exit(ENOMEM, "out of memory creating request elements\n");
+    member = worker_member(clp);
+    str_id = worker_stream(clp);
+    stp = worker_stats(clp);
+    for (k = 0; k < n; ++k) {
+        init_rq_elem(clp, reps + k);
+        reps[k].member = member;
+        reps[k].str_id = str_id;
+        reps[k].st = stp;
+    }
+    if (normal_in)
+        uring_setup(clp, &ur, reps, n);
+
+    while (1) {
+        while ((! no_more) && (! leave) && (count < n)) {
+            rep = reps + ((head + count) % n);
+            if (! pending) {
+                /* only block for a slot when holding none, else may
+                 * deadlock */
+                if (0 == count)
+                    qd_acquire(&clp->in_qd);
+                else if (! qd_try_acquire(&clp->in_qd))
+                    break;
+                rep->wr = false;
+                rep->num_blks = in_claim(clp, rep);
+                if (rep->num_blks <= 0) {
+                    qd_release(&clp->in_qd, -1, 0);
+                    no_more = true;
+                    continue;
+                } else if (resume_claimed(clp, rep)) {
+                    qd_release(&clp->in_qd, -1, 0);   /* no READ needed */
+                    ++count;
+                    continue;
+                }
+                due_ns = rate_take(clp, rep->num_blks);
+                if (due_ns > 0)
+                    due_ns += sg_pt_lat_now_ns();
+                pending = true;
+            }
+            if (due_ns > 0) {
+                /* rather than sleep with READs in flight (which would add
+                 * to their apparent latency) take their responses first */
+                now_ns = sg_pt_lat_now_ns();
+                if ((due_ns > now_ns) && (count > 0))
+                    break;
+                if (due_ns > now_ns)
+                    sg_pt_rate_sleep(due_ns - now_ns);
+            }
+            pending = false;
+            if (normal_in ? normal_in_start(clp, &ur, reps, rep) :
+                            sg_in_start(clp, rep))
+                leave = true;
+            else
+                ++count;
+        }
+        if (0 == count)
+            break;
+        rep = reps + head;
+        head = (head + 1) % n;
+        --count;
+        if (leave) {    /* gather responses before buffers are freed */
+            if (rep->done_before)
+                ;
+            else if (normal_in)
+                normal_in_wait(&ur, reps, rep);
+            else {
+                sg_finish_io(rep->wr, rep, &clp->aux_mutex);
+                qd_release(&clp->in_qd, -1, 0);
+            }
+            continue;
+        }
+        if (rep->done_before) {
+            SGP_FETCH_ADD(&clp->in_rem_count, -rep->num_blks);
+            res = 0;
+        } else if (normal_in) {
+            while (1 == (res = normal_in_reap(clp, &ur, reps, rep)))
+                ;
+        } else {
+            while (1 == (res = sg_in_reap(clp, rep)))
+                ;
+        }
+        if (res < 0)
+            leave = true;
+        else if (write_chunk(clp, rep, seek_skip, (2 == res),
+                             rep->num_blks))
+            leave = true;
+        else if (2 == res)
+            leave = true;       /* short read, end of IFILE */
+    }
+    if (pending)        /* claimed READ never issued, copy is stopping */
+        qd_release(&clp->in_qd, -1, 0);
+    if (normal_in)
+        uring_free(&ur);
+    for (k = 0; k < n; ++k)
+        sg_hugebuf_put(reps[k].buffp);
+    free(reps);
+    worker_fini(clp);
+    return clp;
+}
+
+static bool
+normal_in_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
+{
+    bool stop_after_write = false;
+    int res;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    /* enters holding in_mutex */
+    res = sg_io_read_retry(clp->infd, rep->buffp, blocks * clp->bs);
+    if (res < 0) {
+        if (clp->in_flags.coe) {
+            memset(rep->buffp, 0, rep->num_blks * rep->bs);
+            pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
+                    "bytes, %s\n", rep->blk,
+                    rep->num_blks * rep->bs,
+                    tsafe_strerror(errno, strerr_buff));
+            res = rep->num_blks * clp->bs;
+        }
+        else {
+            pr2serr("error in normal read, %s\n",
+                    tsafe_strerror(errno, strerr_buff));
+            clp->in_stop = true;
+            guarded_stop_out(clp);
+            return 1;
+        }
+    }
+    if (res < blocks * clp->bs) {
+        int o_blocks = blocks;
+        stop_after_write = true;
+        blocks = res / clp->bs;
+        if ((res % clp->bs) > 0) {
+            blocks++;
+            clp->in_partial++;
+        }
+        /* Give back the blocks that were not read */
+        SGP_FETCH_ADD(&clp->in_claimed, blocks - o_blocks);
+        rep->num_blks = blocks;
+    }
+    SGP_FETCH_ADD(&clp->in_rem_count, -blocks);
+    return stop_after_write;
+}
+
+/* With resume=CFILE, moves the file position of a normal IFILE past a
+ * chunk copied by an earlier run. Returns true on error (after stopping
+ * the copy), as normal_in_operation() does for a short read. */
+static bool
+normal_in_resumed(Rq_coll * clp, Rq_elem * rep, int blocks)
+{
+    off64_t offset = (off64_t)blocks * clp->bs;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    /* enters holding in_mutex */
+    if (lseek64(clp->infd, offset, SEEK_CUR) < 0) {
+        pr2serr("resume: lseek64 on input, in blk=%" PRId64 ", %s\n",
+                rep->blk, tsafe_strerror(errno, strerr_buff));
+        clp->in_stop = true;
+        guarded_stop_out(clp);
+        return true;
+    }
+    SGP_FETCH_ADD(&clp->in_rem_count, -blocks);
+    return false;
+}
+
+/* With oflag=sparse a chunk of zeros is not written to a normal OFILE,
+ * its file position is moved past it instead */
+static bool
+normal_out_sparse(Rq_coll * clp, Rq_elem * rep, int blocks)
+{
+    off64_t offset = (off64_t)blocks * clp->bs;
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    /* enters holding out_mutex */
+    if (lseek64(clp->outfd, offset, SEEK_CUR) < 0) {
+        pr2serr("oflag=sparse lseek64 on output, out blk=%" PRId64 ", %s\n",
+                rep->blk, tsafe_strerror(errno, strerr_buff));
+        guarded_stop_in(clp);
+        clp->out_stop = true;
+        return false;
+    }
+    clp->out_rem_count -= blocks;
+    clp->out_sparse_num += blocks;
+    return true;
+}
+
+/* Returns true when the write is done (or coe ignored its error). With
+ * oflag=sparse the zero blocks ahead of the first holding data are bypassed,
+ * as normal_out_sparse() does for a chunk of zeros. */
+static bool
+normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
+{
+    int res, len;
+    int zlead = sparse_lead(clp, rep);
+    char strerr_buff[STRERR_BUFF_LEN];
+
+    /* enters holding out_mutex */
+    if ((zlead > 0) && (! normal_out_sparse(clp, rep, zlead)))
+        return false;
+    len = (rep->num_blks - zlead) * clp->bs;
+    res = sg_io_write_retry(clp->outfd, rep->buffp + (zlead * clp->bs), len);
+    if (res < 0) {
+        if (clp->out_flags.coe) {
+            pr2serr(">> ignored error for out blk=%" PRId64 " for %d bytes, "
+                    "%s\n", rep->blk + zlead, len,
+                    tsafe_strerror(errno, strerr_buff));
+            res = len;
+        }
         else {
             pr2serr("error normal write, %s\n",
                     tsafe_strerror(errno, strerr_buff));
             guarded_stop_in(clp);
             clp->out_stop = true;
-            return;
+            return false;
         }
     }
+    blocks -= zlead;    /* normal_out_sparse() counted those */
     if (res < blocks * clp->bs) {
         blocks = res / clp->bs;
         if ((res % clp->bs) > 0) {
             blocks++;
             clp->out_partial++;
         }
-        rep->num_blks = blocks;
+        rep->num_blks = zlead + blocks;
     }
     clp->out_rem_count -= blocks;
+    return true;
 }
 
+
+/* Starts a READ on the sg device, the caller has taken an in_qd slot which
+ * is given back if this fails. Returns 0 if started, else -1 after stopping
+ * the copy. */
 static int
-sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
-                  int64_t start_block, bool write_true, bool fua, bool dpo)
-{
-    int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
-    int wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
-    int sz_ind;
-
-    memset(cdbp, 0, cdb_sz);
-    if (dpo)
-        cdbp[1] |= 0x10;
-    if (fua)
-        cdbp[1] |= 0x8;
-    switch (cdb_sz) {
-    case 6:
-        sz_ind = 0;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
-        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
-        if (blocks > 256) {
-            pr2serr("%sfor 6 byte commands, maximum number of blocks is "
-                    "256\n", my_name);
-            return 1;
+sg_in_start(Rq_coll * clp, Rq_elem * rep)
+{
+    int res;
+
+    res = sg_start_io(rep);
+    if (0 == res)
+        return 0;
+    qd_release(&clp->in_qd, -1, 0);
+    if (1 == res)
+        err_exit(ENOMEM, "sg starting in command");
+    pr2serr("%sinputting to sg failed, blk=%" PRId64 "\n", my_name,
+            rep->blk);
+    guarded_stop_both(clp);
+    return -1;
+}
+
+/* Counts the outcome of the sg command just finished for rep, where 'res'
+ * is the value returned by sg_finish_io(), in the counters of the calling
+ * thread. Those are output by progress=SEC[,FILE] and at the end. */
+static void
+count_errs(const Rq_elem * rep, int res)
+{
+    int k;
+    int64_t us;
+    sgp_atomic_i64 * cp;
+
+    if (NULL == rep->st)
+        return;
+    cp = rep->st->c;
+    if (rep->lat_ns) {
+        for (k = 0, us = rep->lat_ns / 1000; (us > 1) &&
+             (k < (TS_LAT_BUCKETS - 1)); ++k, us >>= 1)
+            ;
+        SGP_OWN_ADD(cp + TS_LAT + k, 1);
+    }
+    if (0 == res) {
+        SGP_OWN_ADD(cp + (rep->wr ? TS_WRITES : TS_READS), 1);
+        SGP_OWN_ADD(cp + (rep->wr ? TS_WR_BLKS : TS_RD_BLKS),
+                    rep->num_blks);
+        if (! rep->dealloc)
+            SGP_OWN_ADD(cp + TS_BYTES, (int64_t)rep->io_hdr.dxfer_len -
+                                       rep->resid);
+        if (rep->dio_incomplete_count)
+            SGP_OWN_ADD(cp + TS_DIO_INCOMPLETE, 1);
+        if (rep->resid)
+            SGP_OWN_ADD(cp + TS_RESIDS, rep->resid);
+        if (! rep->recovered)
+            return;
+    }
+    if (rep->dealloc && ((SG_LIB_CAT_INVALID_OP == res) ||
+                         (SG_LIB_CAT_ILLEGAL_REQ == res)))
+        return;         /* deallocation refused, zeros are written instead */
+    switch (res) {
+    case 0:
+        SGP_OWN_ADD(cp + TS_RECOVERED, 1);
+        break;
+    case SG_LIB_CAT_BUSY:
+    case SG_LIB_CAT_TS_FULL:
+    case SG_LIB_CAT_ABORTED_COMMAND:
+    case SG_LIB_CAT_UNIT_ATTENTION:
+        SGP_OWN_ADD(cp + TS_RETRIES, 1);
+        break;
+    default:
+        SGP_OWN_ADD(cp + TS_UNRECOVERED, 1);
+        break;
+    }
+}
+
+/* Outputs, when deb= is given, the sg commands each worker thread did and
+ * the histogram of their latencies */
+static void
+stats_report(const Rq_coll * clp)
+{
+    int k, j, last;
+    int64_t t[TS_NUM];
+    const sgp_atomic_i64 * cp;
+
+    if ((0 == clp->debug) || (NULL == clp->thr_st))
+        return;
+    for (k = 0; k < clp->thr_st_num; ++k) {
+        cp = clp->thr_st[k].c;
+        if ((0 == cp[TS_READS]) && (0 == cp[TS_WRITES]))
+            continue;
+        pr2serr("%sthread %d: %" PRId64 " READs (%" PRId64 " blocks), %"
+                PRId64 " WRITEs (%" PRId64 " blocks), %" PRId64 " retries\n",
+                my_name, k, (int64_t)cp[TS_READS], (int64_t)cp[TS_RD_BLKS],
+                (int64_t)cp[TS_WRITES], (int64_t)cp[TS_WR_BLKS],
+                (int64_t)cp[TS_RETRIES]);
+    }
+    stats_sum(clp, t);
+    for (last = -1, j = 0; j < TS_LAT_BUCKETS; ++j) {
+        if (t[TS_LAT + j])
+            last = j;
+    }
+    if (last < 0)
+        return;
+    pr2serr("%ssg command latency histogram (microseconds: commands)\n",
+            my_name);
+    for (j = 0; j <= last; ++j) {
+        if (t[TS_LAT + j])
+            pr2serr("    %s%" PRIu64 ": %" PRId64 "\n",
+                    (j < (TS_LAT_BUCKETS - 1)) ? "< " : ">= ",
+                    (j < (TS_LAT_BUCKETS - 1)) ? ((uint64_t)2 << j) :
+                    ((uint64_t)1 << j), t[TS_LAT + j]);
+    }
+}
+
+/* Wakes every thread that may be waiting on the fan-out of chunks to the
+ * extra of=. Called holding fan_mutex. */
+static void
+fan_wake_all(Rq_coll * clp)
+{
+    int k;
+
+    pthread_cond_broadcast(&clp->fan_free_cv);
+    for (k = 0; k < clp->fan_num; ++k)
+        pthread_cond_broadcast(&clp->fan[k].cv);
+}
+
+/* Drops one reference to fcp, the last puts its buffer and frees fcp for
+ * the next chunk. Called holding fan_mutex. */
+static void
+fan_chunk_put(Rq_coll * clp, struct fan_chunk * fcp)
+{
+    if (--fcp->refs > 0)
+        return;
+    sg_hugebuf_put(fcp->buffp);
+    fcp->buffp = NULL;
+    clp->fan_free[clp->fan_free_num++] = fcp;
+    pthread_cond_signal(&clp->fan_free_cv);
+}
+
+/* With more than one of=: queues the chunk just written to the first of=
+ * to each of the others, which then share its buffer, and gives rep a new
+ * buffer. So the slowest of= sets the pace, waits while fan_max chunks
+ * are queued. Returns false if an extra of= has failed. */
+static bool
+fan_out(Rq_coll * clp, Rq_elem * rep)
+{
+    bool waited = false;
+    int k, status;
+    struct fan_chunk * fcp;
+    struct fan_target * tp;
+
+    status = pthread_mutex_lock(&clp->fan_mutex);
+    if (0 != status) err_exit(status, "lock fan_mutex");
+    while ((! clp->fan_stop) && (0 == clp->fan_free_num)) {
+        if (! waited) {
+            waited = true;
+            ++clp->fan_waits;
         }
-        if ((start_block + blocks - 1) & (~0x1fffff)) {
-            pr2serr("%sfor 6 byte commands, can't address blocks beyond "
-                    "%d\n", my_name, 0x1fffff);
-            return 1;
+        status = pthread_cond_wait(&clp->fan_free_cv, &clp->fan_mutex);
+        if (0 != status) err_exit(status, "cond fan_free_cv");
+    }
+    if (clp->fan_stop) {
+        status = pthread_mutex_unlock(&clp->fan_mutex);
+        if (0 != status) err_exit(status, "unlock fan_mutex");
+        return false;
+    }
+    fcp = clp->fan_free[--clp->fan_free_num];
+    fcp->buffp = rep->buffp;
+    fcp->blk = rep->blk;
+    fcp->num_blks = rep->num_blks;
+    fcp->refs = clp->fan_num;
+    for (k = 0; k < clp->fan_num; ++k) {
+        tp = clp->fan + k;
+        tp->q[(tp->q_head + tp->q_len) % clp->fan_max] = fcp;
+        ++tp->q_len;
+        pthread_cond_signal(&tp->cv);
+    }
+    status = pthread_mutex_unlock(&clp->fan_mutex);
+    if (0 != status) err_exit(status, "unlock fan_mutex");
+    rep->buffp = get_rq_buff(clp);
+    return true;
+}
+
+/* Writes the chunk described by rep to an extra of=, retrying after an
+ * aborted command or unit attention. Returns 0 when done (or, with
+ * oflag=coe, a medium error is ignored), else the error. */
+static int
+fan_write(Rq_coll * clp, Rq_elem * rep)
+{
+    int res;
+
+    while (1) {
+        res = sg_start_io(rep);
+        if (1 == res)
+            err_exit(ENOMEM, "sg starting out command");
+        else if (res < 0)
+            return res;
+        res = sg_finish_io(true, rep, &clp->aux_mutex);
+        count_errs(rep, res);
+        switch (res) {
+        case SG_LIB_CAT_ABORTED_COMMAND:
+        case SG_LIB_CAT_UNIT_ATTENTION:
+            break;      /* try again with same addr, count info */
+        case SG_LIB_CAT_MEDIUM_HARD:
+            if (0 == clp->out_flags.coe)
+                return res;
+            pr2serr(">> ignored error for out blk=%" PRId64 " for %d "
+                    "bytes\n", rep->blk, rep->num_blks * rep->bs);
+            return 0;
+        default:
+            return res;
         }
-        if (dpo || fua) {
-            pr2serr("%sfor 6 byte commands, neither dpo nor fua bits "
-                    "supported\n", my_name);
-            return 1;
+    }
+}
+
+/* One or more of these threads for each extra of=, they take the chunks
+ * queued by fan_out() in order and write them */
+static void *
+fan_write_thread(void * v_tp)
+{
+    struct fan_target * tp = (struct fan_target *)v_tp;
+    Rq_coll * clp = tp->clp;
+    struct fan_chunk * fcp;
+    Rq_elem rel;
+    Rq_elem * rep = &rel;
+    int res, status;
+
+    numa_bind_thread(clp);
+    memset(rep, 0, sizeof(Rq_elem));
+    rep->wr = true;
+    rep->bs = clp->bs;
+    rep->outfd = tp->outfd;
+    rep->debug = clp->debug;
+    rep->cdbsz_out = clp->cdbsz_out;
+    rep->out_flags = clp->out_flags;
+    rep->st = worker_stats(clp);
+
+    status = pthread_mutex_lock(&clp->fan_mutex);
+    if (0 != status) err_exit(status, "lock fan_mutex");
+    while (1) {
+        while ((! clp->fan_stop) && (! clp->fan_done) && (0 == tp->q_len)) {
+            status = pthread_cond_wait(&tp->cv, &clp->fan_mutex);
+            if (0 != status) err_exit(status, "cond fan cv");
         }
-        break;
-    case 10:
-        sz_ind = 1;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be16((uint16_t)blocks, cdbp + 7);
-        if (blocks & (~0xffff)) {
-            pr2serr("%sfor 10 byte commands, maximum number of blocks is "
-                    "%d\n", my_name, 0xffff);
-            return 1;
+        if (clp->fan_stop || (0 == tp->q_len))
+            break;
+        fcp = tp->q[tp->q_head];
+        tp->q_head = (tp->q_head + 1) % clp->fan_max;
+        --tp->q_len;
+        status = pthread_mutex_unlock(&clp->fan_mutex);
+        if (0 != status) err_exit(status, "unlock fan_mutex");
+
+        rep->buffp = fcp->buffp;
+        rep->blk = fcp->blk;
+        rep->num_blks = fcp->num_blks;
+        res = fan_write(clp, rep);
+        if (res) {
+            pr2serr("%swriting %s failed (%d), blk=%" PRId64 "\n", my_name,
+                    tp->fname, res, rep->blk);
+            if (exit_status <= 0)
+                exit_status = (res > 0) ? res : SG_LIB_CAT_OTHER;
+            guarded_stop_both(clp);
+            pthread_cond_broadcast(&clp->out_sync_cv);
+        }
+
+        status = pthread_mutex_lock(&clp->fan_mutex);
+        if (0 != status) err_exit(status, "lock fan_mutex");
+        if (res) {
+            clp->fan_stop = true;
+            fan_wake_all(clp);
+        } else
+            tp->out_blks += fcp->num_blks;
+        fan_chunk_put(clp, fcp);
+    }
+    status = pthread_mutex_unlock(&clp->fan_mutex);
+    if (0 != status) err_exit(status, "unlock fan_mutex");
+    return NULL;
+}
+
+/* Sets up the queues to the extra of= and starts thr writer threads for
+ * each of them */
+static void
+fan_start(Rq_coll * clp, int thr)
+{
+    int k, j, status;
+    struct fan_target * tp;
+
+    clp->fan_max = FAN_CHUNKS_PER_THR * thr;
+    clp->fan_chunks = (struct fan_chunk *)calloc(clp->fan_max,
+                                                 sizeof(struct fan_chunk));
+    clp->fan_free = (struct fan_chunk **)calloc(clp->fan_max,
+                                                sizeof(struct fan_chunk *));
+    if ((NULL == clp->fan_chunks) || (NULL == clp->fan_free))
+        err_exit(ENOMEM, "out of memory for of= fan-out");
+    for (k = 0; k < clp->fan_max; ++k)
+        clp->fan_free[k] = clp->fan_chunks + k;
+    clp->fan_free_num = clp->fan_max;
+    status = pthread_mutex_init(&clp->fan_mutex, NULL);
+    if (0 != status) err_exit(status, "init fan_mutex");
+    status = pthread_cond_init(&clp->fan_free_cv, NULL);
+    if (0 != status) err_exit(status, "init fan_free_cv");
+    for (k = 0; k < clp->fan_num; ++k) {
+        tp = clp->fan + k;
+        tp->clp = clp;
+        tp->q = (struct fan_chunk **)calloc(clp->fan_max,
+                                            sizeof(struct fan_chunk *));
+        if (NULL == tp->q)
+            err_exit(ENOMEM, "out of memory for of= fan-out");
+        status = pthread_cond_init(&tp->cv, NULL);
+        if (0 != status) err_exit(status, "init fan cv");
+        for (j = 0; j < thr; ++j) {
+            status = pthread_create(&fan_threads[k * thr + j], NULL,
+                                    fan_write_thread, (void *)tp);
+            if (0 != status) err_exit(status, "pthread_create, fan...");
         }
-        break;
-    case 12:
-        sz_ind = 2;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 6);
-        break;
-    case 16:
-        sz_ind = 3;
-        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
-                                               rd_opcode[sz_ind]);
-        sg_put_unaligned_be64((uint64_t)start_block, cdbp + 2);
-        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 10);
-        break;
-    default:
-        pr2serr("%sexpected cdb size of 6, 10, 12, or 16 but got %d\n",
-                my_name, cdb_sz);
-        return 1;
     }
-    return 0;
 }
 
+/* Called once the worker threads have finished: waits for the writer
+ * threads of the extra of= to write what is queued to them */
 static void
-sg_in_operation(Rq_coll * clp, Rq_elem * rep)
+fan_finish(Rq_coll * clp, int thr)
+{
+    int k, status;
+    void * vp;
+
+    status = pthread_mutex_lock(&clp->fan_mutex);
+    if (0 != status) err_exit(status, "lock fan_mutex");
+    clp->fan_done = true;
+    fan_wake_all(clp);
+    status = pthread_mutex_unlock(&clp->fan_mutex);
+    if (0 != status) err_exit(status, "unlock fan_mutex");
+    for (k = 0; k < (clp->fan_num * thr); ++k) {
+        status = pthread_join(fan_threads[k], &vp);
+        if (0 != status) err_exit(status, "pthread_join, fan...");
+    }
+    for (k = 0; k < clp->fan_num; ++k)
+        free(clp->fan[k].q);
+    free(clp->fan_free);
+    free(clp->fan_chunks);
+}
+
+/* Waits for the response to a READ started by sg_in_start(). Returns 0 when
+ * the data is ready to write, 1 when the READ has been started again (so
+ * call this again), else -1 after stopping the copy. */
+static int
+sg_in_reap(Rq_coll * clp, Rq_elem * rep)
 {
     int res;
-    int status;
 
-    /* enters holding in_mutex */
-    while (1) {
-        res = sg_start_io(rep);
-        if (1 == res)
-            err_exit(ENOMEM, "sg starting in command");
-        else if (res < 0) {
-            pr2serr("%sinputting to sg failed, blk=%" PRId64 "\n", my_name,
-                    rep->blk);
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
+    res = sg_finish_io(rep->wr, rep, &clp->aux_mutex);
+    rate_lat_update(clp, rep);
+    count_errs(rep, res);
+    switch (res) {
+    case SG_LIB_CAT_BUSY:
+    case SG_LIB_CAT_TS_FULL:
+    case SG_LIB_CAT_ABORTED_COMMAND:
+    case SG_LIB_CAT_UNIT_ATTENTION:
+        /* try again with same addr, count info, keeping the in_qd slot */
+        qd_requeue(&clp->in_qd, rep->io_hdr.status, rep->lat_ns);
+        return sg_in_start(clp, rep) ? -1 : 1;
+    default:
+        break;
+    }
+    qd_release(&clp->in_qd, (res < 0) ? -1 : rep->io_hdr.status,
+               rep->lat_ns);
+    switch (res) {
+    case SG_LIB_CAT_MEDIUM_HARD:
+        if (0 == clp->in_flags.coe) {
+            pr2serr("error finishing sg in command (medium)\n");
+            if (exit_status <= 0)
+                exit_status = res;
             guarded_stop_both(clp);
-            return;
+            return -1;
+        } else {
+            memset(rep->buffp, 0, rep->num_blks * rep->bs);
+            pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
+                    "bytes\n", rep->blk, rep->num_blks * rep->bs);
         }
-        /* Now release in mutex to let other reads run in parallel */
-        status = pthread_mutex_unlock(&clp->in_mutex);
-        if (0 != status) err_exit(status, "unlock in_mutex");
-
-        res = sg_finish_io(rep->wr, rep, &clp->aux_mutex);
-        switch (res) {
-        case SG_LIB_CAT_ABORTED_COMMAND:
-        case SG_LIB_CAT_UNIT_ATTENTION:
-            /* try again with same addr, count info */
-            /* now re-acquire in mutex for balance */
-            /* N.B. This re-read could now be out of read sequence */
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            break;
-        case SG_LIB_CAT_MEDIUM_HARD:
-            if (0 == clp->in_flags.coe) {
-                pr2serr("error finishing sg in command (medium)\n");
-                if (exit_status <= 0)
-                    exit_status = res;
-                guarded_stop_both(clp);
-                return;
-            } else {
-                memset(rep->buffp, 0, rep->num_blks * rep->bs);
-                pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
-                        "bytes\n", rep->blk, rep->num_blks * rep->bs);
-            }
 #if defined(__GNUC__)
 #if (__GNUC__ >= 7)
-            __attribute__((fallthrough));
-            /* FALL THROUGH */
+        __attribute__((fallthrough));
+        /* FALL THROUGH */
 #endif
 #endif
-        case 0:
-            if (rep->dio_incomplete_count || rep->resid) {
-                status = pthread_mutex_lock(&clp->aux_mutex);
-                if (0 != status) err_exit(status, "lock aux_mutex");
-                clp->dio_incomplete_count += rep->dio_incomplete_count;
-                clp->sum_of_resids += rep->resid;
-                status = pthread_mutex_unlock(&clp->aux_mutex);
-                if (0 != status) err_exit(status, "unlock aux_mutex");
-            }
-            status = pthread_mutex_lock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "lock in_mutex");
-            clp->in_rem_count -= rep->num_blks;
-            status = pthread_mutex_unlock(&clp->in_mutex);
-            if (0 != status) err_exit(status, "unlock in_mutex");
-            return;
-        default:
-            pr2serr("error finishing sg in command (%d)\n", res);
-            if (exit_status <= 0)
-                exit_status = res;
-            guarded_stop_both(clp);
-            return;
-        }
+    case 0:
+        SGP_FETCH_ADD(&clp->in_rem_count, -rep->num_blks);
+        return 0;
+    default:
+        pr2serr("error finishing sg in command (%d)\n", res);
+        if (exit_status <= 0)
+            exit_status = res;
+        guarded_stop_both(clp);
+        return -1;
     }
 }
 
 static void
+sg_in_operation(Rq_coll * clp, Rq_elem * rep)
+{
+    qd_acquire(&clp->in_qd);
+    if (sg_in_start(clp, rep))
+        return;
+    while (1 == sg_in_reap(clp, rep))
+        ;
+}
+
+/* Returns true when the write is done (or coe ignored its medium error) */
+static bool
 sg_out_operation(Rq_coll * clp, Rq_elem * rep)
 {
     int res;
     int status;
 
     /* enters holding out_mutex */
+    rep->dealloc = rep->sparse ? clp->out_dealloc : DEALLOC_NONE;
+    if (rep->sparse && (DEALLOC_NONE == rep->dealloc)) {
+        clp->out_rem_count -= rep->num_blks;    /* bypass the WRITE */
+        clp->out_sparse_num += rep->num_blks;
+        status = pthread_mutex_unlock(&clp->out_mutex);
+        if (0 != status) err_exit(status, "unlock out_mutex");
+        return true;
+    }
+    if (clp->out_max_dealloc && ((uint32_t)rep->num_blks >
+                                 clp->out_max_dealloc))
+        rep->dealloc = DEALLOC_NONE;            /* so write the zeros */
+    else if ((DEALLOC_UNMAP == rep->dealloc) && (clp->out_unmap_gran > 1) &&
+             (((rep->blk % clp->out_unmap_gran) != clp->out_unmap_align) ||
+              (rep->num_blks % clp->out_unmap_gran)))
+        rep->dealloc = DEALLOC_NONE;
     while (1) {
+        qd_acquire(&clp->out_qd);
         res = sg_start_io(rep);
+        if (res)
+            qd_release(&clp->out_qd, -1, 0);
         if (1 == res)
             err_exit(ENOMEM, "sg starting out command");
         else if (res < 0) {
@@ -935,14 +3725,20 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
             status = pthread_mutex_unlock(&clp->out_mutex);
             if (0 != status) err_exit(status, "unlock out_mutex");
             guarded_stop_both(clp);
-            return;
+            return false;
         }
         /* Now release in mutex to let other reads run in parallel */
         status = pthread_mutex_unlock(&clp->out_mutex);
         if (0 != status) err_exit(status, "unlock out_mutex");
 
         res = sg_finish_io(rep->wr, rep, &clp->aux_mutex);
+        rate_lat_update(clp, rep);
+        count_errs(rep, res);
+        qd_release(&clp->out_qd, (res < 0) ? -1 : rep->io_hdr.status,
+                   rep->lat_ns);
         switch (res) {
+        case SG_LIB_CAT_BUSY:
+        case SG_LIB_CAT_TS_FULL:
         case SG_LIB_CAT_ABORTED_COMMAND:
         case SG_LIB_CAT_UNIT_ATTENTION:
             /* try again with same addr, count info */
@@ -951,13 +3747,32 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
             status = pthread_mutex_lock(&clp->out_mutex);
             if (0 != status) err_exit(status, "lock out_mutex");
             break;
+        case SG_LIB_CAT_INVALID_OP:
+        case SG_LIB_CAT_ILLEGAL_REQ:
+            if (rep->dealloc) {
+                /* deallocation refused, write the zeros and stop trying */
+                status = pthread_mutex_lock(&clp->out_mutex);
+                if (0 != status) err_exit(status, "lock out_mutex");
+                if (DEALLOC_NONE != clp->out_dealloc) {
+                    clp->out_dealloc = DEALLOC_NONE;
+                    pr2serr("oflag=sparse: deallocation refused by OFILE, "
+                            "bypass zero chunks from now on\n");
+                }
+                rep->dealloc = DEALLOC_NONE;
+                break;
+            }
+            pr2serr("error finishing sg out command (%d)\n", res);
+            if (exit_status <= 0)
+                exit_status = res;
+            guarded_stop_both(clp);
+            return false;
         case SG_LIB_CAT_MEDIUM_HARD:
             if (0 == clp->out_flags.coe) {
                 pr2serr("error finishing sg out command (medium)\n");
                 if (exit_status <= 0)
                     exit_status = res;
                 guarded_stop_both(clp);
-                return;
+                return false;
             } else
                 pr2serr(">> ignored error for out blk=%" PRId64 " for %d "
                         "bytes\n", rep->blk, rep->num_blks * rep->bs);
@@ -968,26 +3783,20 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
 #endif
 #endif
         case 0:
-            if (rep->dio_incomplete_count || rep->resid) {
-                status = pthread_mutex_lock(&clp->aux_mutex);
-                if (0 != status) err_exit(status, "lock aux_mutex");
-                clp->dio_incomplete_count += rep->dio_incomplete_count;
-                clp->sum_of_resids += rep->resid;
-                status = pthread_mutex_unlock(&clp->aux_mutex);
-                if (0 != status) err_exit(status, "unlock aux_mutex");
-            }
             status = pthread_mutex_lock(&clp->out_mutex);
             if (0 != status) err_exit(status, "lock out_mutex");
             clp->out_rem_count -= rep->num_blks;
+            if (rep->dealloc)
+                clp->out_dealloc_num += rep->num_blks;
             status = pthread_mutex_unlock(&clp->out_mutex);
             if (0 != status) err_exit(status, "unlock out_mutex");
-            return;
+            return true;
         default:
             pr2serr("error finishing sg out command (%d)\n", res);
             if (exit_status <= 0)
                 exit_status = res;
             guarded_stop_both(clp);
-            return;
+            return false;
         }
     }
 }
@@ -1001,39 +3810,89 @@ sg_start_io(Rq_elem * rep)
     bool dio = rep->wr ? rep->out_flags.dio : rep->in_flags.dio;
     int cdbsz = rep->wr ? rep->cdbsz_out : rep->cdbsz_in;
     int res;
-
-    if (sg_build_scsi_cdb(rep->cmd, cdbsz, rep->num_blks, rep->blk,
-                          rep->wr, fua, dpo)) {
+    int len = rep->bs * rep->num_blks;
+    int64_t blk = rep->blk;
+    uint8_t * dxferp = rep->buffp;
+    const struct stripe_t * sp = rep->wr ? rep->out_stripe : rep->in_stripe;
+    struct mpath_t * mp = rep->wr ? rep->out_mpath : rep->in_mpath;
+
+    rep->io_fd = rep->wr ? rep->outfd : rep->infd;
+    if (sp)
+        blk = stripe_map(sp, rep->blk, &rep->io_fd);
+    else if (mp)
+        rep->io_fd = mpath_pick(mp, rep->blk, &rep->path);
+
+    if (rep->wr && (DEALLOC_WS16 == rep->dealloc)) {
+        /* one block from the buffer (of zeros) is replicated */
+        cdbsz = 16;
+        memset(rep->cmd, 0, cdbsz);
+        rep->cmd[0] = SGP_WRITE_SAME16;
+        rep->cmd[1] = 0x8;              /* UNMAP bit */
+        sg_put_unaligned_be64((uint64_t)blk, rep->cmd + 2);
+        sg_put_unaligned_be32((uint32_t)rep->num_blks, rep->cmd + 10);
+        len = rep->bs;
+    } else if (rep->wr && (DEALLOC_UNMAP == rep->dealloc)) {
+        cdbsz = 10;
+        memset(rep->cmd, 0, cdbsz);
+        rep->cmd[0] = SGP_UNMAP;
+        sg_put_unaligned_be16(UNMAP_PARAM_LEN, rep->cmd + 7);
+        memset(rep->unmap_param, 0, UNMAP_PARAM_LEN);
+        sg_put_unaligned_be16(UNMAP_PARAM_LEN - 2, rep->unmap_param + 0);
+        sg_put_unaligned_be16(16, rep->unmap_param + 2);
+        sg_put_unaligned_be64((uint64_t)blk, rep->unmap_param + 8);
+        sg_put_unaligned_be32((uint32_t)rep->num_blks, rep->unmap_param + 16);
+        len = UNMAP_PARAM_LEN;
+        dxferp = rep->unmap_param;
+    } else if (rep->wr && rep->str_id) {
+        cdbsz = 16;
+        memset(rep->cmd, 0, cdbsz);
+        rep->cmd[0] = SGP_WRITE_STREAM16;
+        rep->cmd[1] = (uint8_t)(rep->wrprotect << 5);
+        if (dpo)
+            rep->cmd[1] |= 0x10;
+        if (fua)
+            rep->cmd[1] |= 0x8;
+        sg_put_unaligned_be64((uint64_t)blk, rep->cmd + 2);
+        sg_put_unaligned_be16(rep->str_id, rep->cmd + 10);
+        sg_put_unaligned_be16((uint16_t)rep->num_blks, rep->cmd + 12);
+        if (rep->wrprotect)
+            len = (rep->bs + SG_T10_PI_LEN) * rep->num_blks;
+    } else if (sg_build_rw_cdb(rep->cmd, cdbsz, rep->num_blks, blk,
+                               rep->wr, fua, dpo, my_name)) {
         pr2serr("%sbad cdb build, start_blk=%" PRId64 ", blocks=%d\n",
-                my_name, rep->blk, rep->num_blks);
+                my_name, blk, rep->num_blks);
         return -1;
+    } else if (rep->wr ? rep->wrprotect : rep->rdprotect) {
+        rep->cmd[1] |= (uint8_t)((rep->wr ? rep->wrprotect :
+                                            rep->rdprotect) << 5);
+        len = (rep->bs + SG_T10_PI_LEN) * rep->num_blks;
     }
     memset(hp, 0, sizeof(struct sg_io_hdr));
     hp->interface_id = 'S';
     hp->cmd_len = cdbsz;
     hp->cmdp = rep->cmd;
     hp->dxfer_direction = rep->wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
-    hp->dxfer_len = rep->bs * rep->num_blks;
-    hp->dxferp = rep->buffp;
+    hp->dxfer_len = len;
+    hp->dxferp = dxferp;
     hp->mx_sb_len = sizeof(rep->sb);
     hp->sbp = rep->sb;
     hp->timeout = DEF_TIMEOUT;
     hp->usr_ptr = rep;
     rep->pack_id = GET_NEXT_PACK_ID(1);
     hp->pack_id = (int)rep->pack_id;
-    if (dio)
+    if (dio && (DEALLOC_NONE == rep->dealloc))
         hp->flags |= SG_FLAG_DIRECT_IO;
     if (rep->debug > 8) {
-        pr2serr("sg_start_io: SCSI %s, blk=%" PRId64 " num_blks=%d\n",
-               rep->wr ? "WRITE" : "READ", rep->blk, rep->num_blks);
+        pr2serr("sg_start_io: SCSI %s, fd=%d blk=%" PRId64 " num_blks=%d\n",
+               rep->wr ? "WRITE" : "READ", rep->io_fd, blk, rep->num_blks);
         sg_print_command(hp->cmdp);
     }
 
-    while (((res = write(rep->wr ? rep->outfd : rep->infd, hp,
-                         sizeof(struct sg_io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    rep->lat_start_ns = sg_pt_lat_now_ns();    /* for the histogram too */
+    res = sg_io_write_retry(rep->io_fd, hp, sizeof(struct sg_io_hdr));
     if (res < 0) {
+        if (mp)
+            mpath_put(mp, &rep->path);
         if (ENOMEM == errno)
             return 1;
         perror("starting io on sg device, error");
@@ -1061,24 +3920,37 @@ sg_finish_io(bool wr, Rq_elem * rep, pthread_mutex_t * a_mutp)
     io_hdr.dxfer_direction = wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
     io_hdr.pack_id = (int)rep->pack_id;
 
-    while (((res = read(wr ? rep->outfd : rep->infd, &io_hdr,
-                        sizeof(struct sg_io_hdr))) < 0) &&
-           ((EINTR == errno) || (EAGAIN == errno)))
-        ;
+    res = sg_io_read_retry(rep->io_fd, &io_hdr, sizeof(struct sg_io_hdr));
+    if (rep->path >= 0)
+        mpath_put(wr ? rep->out_mpath : rep->in_mpath, &rep->path);
     if (res < 0) {
         perror("finishing io on sg device, error");
         return -1;
     }
     if (rep != (Rq_elem *)io_hdr.usr_ptr)
         err_exit(0, "sg_finish_io: bad usr_ptr, request-response mismatch\n");
+    rep->lat_ns = rep->lat_start_ns ?
+                  (sg_pt_lat_now_ns() - rep->lat_start_ns) : 0;
+    if (rep->lat_ns && sg_pt_lat_is_enabled())
+        sg_pt_lat_record(rep->io_fd, rep->cmd[0], rep->lat_ns);
     memcpy(&rep->io_hdr, &io_hdr, sizeof(struct sg_io_hdr));
     hp = &rep->io_hdr;
+    rep->recovered = false;
+
+    /* with an adaptive queue depth, back off (in the caller) and retry */
+    if (rep->qd_active) {
+        if (SAM_STAT_BUSY == hp->status)
+            return SG_LIB_CAT_BUSY;
+        if (SAM_STAT_TASK_SET_FULL == hp->status)
+            return SG_LIB_CAT_TS_FULL;
+    }
 
     res = sg_err_category3(hp);
     switch (res) {
         case SG_LIB_CAT_CLEAN:
             break;
         case SG_LIB_CAT_RECOVERED:
+            rep->recovered = true;
             sg_chk_n_print3((wr ? "writing continuing":
                                        "reading continuing"), hp, false);
             break;
@@ -1117,24 +3989,679 @@ sg_finish_io(bool wr, Rq_elem * rep, pthread_mutex_t * a_mutp)
 }
 
 static int
-sg_prepare(int fd, int bs, int bpt)
+sg_prepare(int fd, int bs, int bpt)
+{
+    int res, t;
+
+    res = ioctl(fd, SG_GET_VERSION_NUM, &t);
+    if ((res < 0) || (t < 30000)) {
+        pr2serr("%ssg driver prior to 3.x.y\n", my_name);
+        return 1;
+    }
+    t = bs * bpt;
+    res = ioctl(fd, SG_SET_RESERVED_SIZE, &t);
+    if (res < 0)
+        perror("sgp_dd: SG_SET_RESERVED_SIZE error");
+    t = 1;
+    res = ioctl(fd, SG_SET_FORCE_PACK_ID, &t);
+    if (res < 0)
+        perror("sgp_dd: SG_SET_FORCE_PACK_ID error");
+    return 0;
+}
+
+/* Splits fname, a comma separated list of sg devices for stripe=BLKS, in
+ * place into the members of sp. Leaves sp->num at 0 when fname has no
+ * comma. Returns 0, else 1 when there are too many members. */
+static int
+stripe_split(char * fname, struct stripe_t * sp, int64_t stripe)
+{
+    char * cp;
+
+    if (NULL == strchr(fname, ','))
+        return 0;
+    for (cp = fname; cp; ++sp->num) {
+        if (sp->num >= MAX_STRIPE) {
+            pr2serr("%sat most %d sg devices can be striped\n", my_name,
+                    MAX_STRIPE);
+            return 1;
+        }
+        sp->fname[sp->num] = cp;
+        if ((cp = strchr(cp, ',')))
+            *cp++ = '\0';
+    }
+    sp->stripe = stripe;
+    return 0;
+}
+
+/* Returns the SG_IO_OPEN_* mask for sg_io_open_dd() from iflag= or
+ * oflag= . */
+static int
+open_fl_mask(const struct flags_t * fp)
+{
+    int fl_mask = 0;
+
+    if (fp->direct)
+        fl_mask |= SG_IO_OPEN_DIRECT;
+    if (fp->excl)
+        fl_mask |= SG_IO_OPEN_EXCL;
+    if (fp->dsync)
+        fl_mask |= SG_IO_OPEN_DSYNC;
+    if (fp->append)
+        fl_mask |= SG_IO_OPEN_APPEND;
+    return fl_mask;
+}
+
+/* Opens the second and later members of a striped IFILE or OFILE, the
+ * first being opened as infd or outfd. Returns 0 or an exit status. */
+static int
+stripe_open(Rq_coll * clp, struct stripe_t * sp, bool wr)
+{
+    int k;
+    const struct flags_t * fp = wr ? &clp->out_flags : &clp->in_flags;
+    sp->fd[0] = wr ? clp->outfd : clp->infd;
+    if (FT_SG != (wr ? clp->out_type : clp->in_type)) {
+        pr2serr("%sstripe=: each %s must be a sg device, %s is not\n",
+                my_name, wr ? "OFILE" : "IFILE", sp->fname[0]);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    for (k = 1; k < sp->num; ++k) {
+        if (FT_SG != sg_io_filetype(sp->fname[k], 0, clp->debug)) {
+            pr2serr("%sstripe=: each %s must be a sg device, %s is not\n",
+                    my_name, wr ? "OFILE" : "IFILE", sp->fname[k]);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        sp->fd[k] = sg_io_open_dd(sp->fname[k], FT_SG, wr, open_fl_mask(fp),
+                                  0, clp->bs, my_name, 0);
+        if (sp->fd[k] < 0)
+            return sg_convert_errno(-sp->fd[k]);
+        if (sg_prepare(sp->fd[k], clp->bs, clp->bpt))
+            return SG_LIB_FILE_ERROR;
+    }
+    return 0;
+}
+
+/* Yields the capacity of a striped IFILE or OFILE in *num_sectp: as many
+ * whole stripes on each member as the smallest member holds. Returns 0,
+ * else -1 after reporting the member that let it down. */
+static int
+stripe_capacity(const Rq_coll * clp, const struct stripe_t * sp,
+                int64_t * num_sectp)
+{
+    int k, res, sect_sz;
+    int64_t num_sect;
+    int64_t min_sect = -1;
+    struct sg_dev_sess ds;
+
+    for (k = 0; k < sp->num; ++k) {
+        sg_ds_init(&ds, sp->fd[k], 0);
+        res = sg_io_read_capacity(&ds, &num_sect, &sect_sz, 0);
+        if (2 == res)
+            res = sg_io_read_capacity(&ds, &num_sect, &sect_sz, 0);
+        if (0 != res) {
+            pr2serr("Unable to read capacity on %s\n", sp->fname[k]);
+            return -1;
+        }
+        if (sect_sz != clp->bs) {
+            pr2serr("logical block size on %s confusion: bs=%d, from "
+                    "device=%d\n", sp->fname[k], clp->bs, sect_sz);
+            return -1;
+        }
+        if ((min_sect < 0) || (num_sect < min_sect))
+            min_sect = num_sect;
+    }
+    *num_sectp = (min_sect / sp->stripe) * sp->stripe * sp->num;
+    return 0;
+}
+
+/* Splits fname, a comma separated list of paths to one logical unit for
+ * mpath=, in place into the members of mp. Returns 0, else 1 when there
+ * are too many paths. */
+static int
+mpath_split(char * fname, struct mpath_t * mp, int policy)
+{
+    char * cp;
+
+    mp->policy = policy;
+    for (cp = fname; cp; ++mp->num) {
+        if (mp->num >= MAX_MPATH) {
+            pr2serr("%sat most %d paths can be given\n", my_name, MAX_MPATH);
+            return 1;
+        }
+        mp->fname[mp->num] = cp;
+        if ((cp = strchr(cp, ',')))
+            *cp++ = '\0';
+    }
+    return 0;
+}
+
+/* Reads the Device Identification VPD page of the sg device open on fd,
+ * or when fd is negative of the sg device called sg_name, from sysfs. On
+ * each path that page holds the target port (group) of that path while
+ * the INQUIRY cache (if enabled) keeps one copy per logical unit, so
+ * sysfs is tried first. Returns the page length or -1. */
+static int
+mpath_read_di(int fd, const char * sg_name, uint8_t * b, int mx_len)
+{
+    int n, len;
+    FILE * fp;
+    struct stat st;
+    char path[PATH_MAX];
+
+    if (fd >= 0) {
+        if ((fstat(fd, &st) < 0) || (! S_ISCHR(st.st_mode)))
+            return -1;
+        snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/vpd_pg83",
+                 major(st.st_rdev), minor(st.st_rdev));
+    } else
+        snprintf(path, sizeof(path),
+                 "/sys/class/scsi_generic/%s/device/vpd_pg83", sg_name);
+    n = -1;
+    if ((fp = fopen(path, "r"))) {
+        n = (int)fread(b, 1, mx_len, fp);
+        fclose(fp);
+    }
+    if ((n < 4) && (fd >= 0)) {
+        if (sg_ll_inquiry_v2(fd, true, 0x83, b, mx_len, 0, &n, false, 0))
+            return -1;
+        n = mx_len - n;         /* less resid */
+    }
+    if ((n < 4) || (0x83 != b[1]))
+        return -1;
+    len = sg_get_unaligned_be16(b + 2) + 4;
+    return (len < n) ? len : n;
+}
+
+/* Yields the designator of the logical unit (NAA, else EUI-64, else SCSI
+ * name string; type and designator in lu[], length in *lu_lenp, 0 if
+ * none) and the target port group of the path (-1 if none) from its
+ * Device Identification VPD page in b */
+static void
+mpath_ids(const uint8_t * b, int len, uint8_t * lu, int * lu_lenp,
+          int * tpgp)
+{
+    int off, n;
+    const uint8_t * dp;
+    struct sg_vpd_dev_id_idx di;
+
+    *lu_lenp = 0;
+    sg_vpd_dev_id_index(b + 4, len - 4, &di);
+    *tpgp = di.tpg_id;
+    if (di.lu_naa >= 0)
+        off = di.lu_naa;
+    else if (di.lu_eui64 >= 0)
+        off = di.lu_eui64;
+    else if (di.lu_sns >= 0)
+        off = di.lu_sns;
+    else
+        return;
+    dp = b + 4 + off;
+    n = dp[3] + 1;      /* with the designator type */
+    if (n > 256)
+        n = 256;
+    lu[0] = dp[1] & 0xf;
+    memcpy(lu + 1, dp + 4, n - 1);
+    *lu_lenp = n;
+}
+
+/* Adds the other sg devices whose logical unit designator is the 'lu_len'
+ * bytes at lu to mp, for mpath=...,auto */
+static void
+mpath_discover(struct mpath_t * mp, const uint8_t * lu, int lu_len)
+{
+    int n, o_len, tpg, k;
+    DIR * dirp;
+    struct dirent * dep;
+    struct stat st, st0;
+    char b[64];
+    uint8_t di[MPATH_DI_LEN];
+    uint8_t olu[256];
+
+    if ((NULL == (dirp = opendir("/sys/class/scsi_generic"))) ||
+        (fstat(mp->fd[0], &st0) < 0)) {
+        if (dirp)
+            closedir(dirp);
+        return;
+    }
+    while ((dep = readdir(dirp)) && (mp->num < MAX_MPATH)) {
+        if (strncmp(dep->d_name, "sg", 2))
+            continue;
+        snprintf(b, sizeof(b), "/dev/%.40s", dep->d_name);
+        if ((stat(b, &st) < 0) || (st.st_rdev == st0.st_rdev))
+            continue;
+        for (k = 1; k < mp->num; ++k) {         /* given already? */
+            struct stat stk;
+
+            if ((0 == stat(mp->fname[k], &stk)) &&
+                (stk.st_rdev == st.st_rdev))
+                break;
+        }
+        if (k < mp->num)
+            continue;
+        if ((n = mpath_read_di(-1, dep->d_name, di, sizeof(di))) < 0)
+            continue;
+        mpath_ids(di, n, olu, &o_len, &tpg);
+        if ((o_len == lu_len) && (0 == memcmp(olu, lu, lu_len))) {
+            snprintf(mp->found[mp->num], sizeof(mp->found[0]), "/dev/%.40s",
+                     dep->d_name);
+            mp->fname[mp->num] = mp->found[mp->num];
+            mp->fd[mp->num] = -1;
+            ++mp->num;
+        }
+    }
+    closedir(dirp);
+}
+
+/* Orders asymmetric access states: active/optimized (or no ALUA) first,
+ * then active/non-optimized, then the rest */
+static int
+mpath_rank(int alua)
+{
+    if ((alua < 0) || (0 == alua))
+        return 0;
+    return (1 == alua) ? 1 : 2;
+}
+
+static const char *
+mpath_state_str(int alua)
+{
+    switch (alua) {
+    case -1: return "no ALUA";
+    case 0x0: return "active/optimized";
+    case 0x1: return "active/non optimized";
+    case 0x2: return "standby";
+    case 0x3: return "unavailable";
+    case 0x4: return "logical block dependent";
+    case 0xe: return "offline";
+    case 0xf: return "transitioning";
+    default: return "reserved";
+    }
+}
+
+/* Builds mp->ref from the user data segment referral descriptors that
+ * REPORT REFERRALS returns on the first path: for each segment the paths
+ * to those of its target port groups with the best asymmetric access
+ * state. Leaves mp->ref NULL if the device does not support referrals. */
+static void
+mpath_referrals(const Rq_coll * clp, struct mpath_t * mp, const char * fn)
+{
+    bool progress;
+    int k, j, res, len, best, rank, mx;
+    uint32_t mask;
+    uint64_t lba = 0;
+    const uint8_t * bp;
+    const uint8_t * tp;
+    struct mpath_ref * rp;
+    uint8_t * b;
+
+    for (k = 0; k < mp->num; ++k) {
+        if (mp->tpg[k] >= 0)
+            break;
+    }
+    if (k >= mp->num)
+        return;         /* no target port groups to route to */
+    if (NULL == (b = (uint8_t *)malloc(MPATH_REF_LEN)))
+        return;
+    for (mx = 0; mp->ref_num < MPATH_MAX_REF; ) {
+        res = sg_ll_report_referrals(mp->fd[0], lba, false, b, MPATH_REF_LEN,
+                                     clp->debug > 1,
+                                     (clp->debug > 1) ? clp->debug - 1 : 0);
+        if (res) {
+            if (clp->debug && (0 == mp->ref_num))
+                pr2serr("%s%s: no referrals, REPORT REFERRALS failed\n",
+                        my_name, fn);
+            break;
+        }
+        len = sg_get_unaligned_be32(b + 0) + 4;
+        progress = false;
+        /* only complete descriptors, the response may be truncated */
+        for (bp = b + 4; ((bp + 20) <= (b + MPATH_REF_LEN)) &&
+             ((bp + 20) <= (b + len)) &&
+             ((bp + 20 + (bp[3] * 4)) <= (b + MPATH_REF_LEN)) &&
+             (mp->ref_num < MPATH_MAX_REF); bp += 20 + (bp[3] * 4)) {
+            for (best = 2, mask = 0, j = 0; j < bp[3]; ++j) {
+                tp = bp + 20 + (j * 4);
+                rank = mpath_rank(tp[0] & 0xf);
+                for (k = 0; k < mp->num; ++k) {
+                    if (mp->tpg[k] != (int)sg_get_unaligned_be16(tp + 2))
+                        continue;
+                    if (rank < best) {
+                        best = rank;
+                        mask = 0;
+                    }
+                    if ((rank < 2) && (rank == best))
+                        mask |= (1U << k);
+                }
+            }
+            if (mp->ref_num >= mx) {
+                mx = mx ? (2 * mx) : 64;
+                rp = (struct mpath_ref *)realloc(mp->ref, mx * sizeof(*rp));
+                if (NULL == rp)
+                    break;
+                mp->ref = rp;
+            }
+            rp = mp->ref + mp->ref_num++;
+            rp->first = sg_get_unaligned_be64(bp + 4);
+            rp->last = sg_get_unaligned_be64(bp + 12);
+            rp->paths = mask;
+            progress = true;
+            if (UINT64_MAX == rp->last)
+                break;
+            lba = rp->last + 1;
+        }
+        if ((len <= MPATH_REF_LEN) || (! progress) ||
+            (UINT64_MAX == mp->ref[mp->ref_num - 1].last))
+            break;
+    }
+    free(b);
+    if (clp->debug && mp->ref_num)
+        pr2serr("%s%s: %d user data segments from REPORT REFERRALS\n",
+                my_name, fn, mp->ref_num);
+}
+
+/* Returns the user data segment holding blk, or NULL */
+static const struct mpath_ref *
+mpath_ref_find(const struct mpath_t * mp, int64_t blk)
+{
+    int lo = 0;
+    int hi = mp->ref_num - 1;
+    int mid;
+    uint64_t lba = (uint64_t)blk;
+
+    while (lo <= hi) {
+        mid = lo + ((hi - lo) / 2);
+        if (lba < mp->ref[mid].first)
+            hi = mid - 1;
+        else if (lba > mp->ref[mid].last)
+            lo = mid + 1;
+        else
+            return mp->ref + mid;
+    }
+    return NULL;
+}
+
+/* Opens the paths of an mpath= IFILE or OFILE after the first (which is
+ * infd or outfd), adding those found with ',auto'. Checks that all lead
+ * to the same logical unit, then picks the paths to use from the target
+ * port group states in a REPORT TARGET PORT GROUPS response: the
+ * active/optimized ones unless there are none. Then fetches the referrals
+ * which override that choice for the LBAs they cover. Returns 0 or an
+ * exit status. */
+static int
+mpath_open(Rq_coll * clp, struct mpath_t * mp, bool wr, bool discover)
+{
+    int k, j, n, lu_len, o_len, best, res;
+    const struct flags_t * fp = wr ? &clp->out_flags : &clp->in_flags;
+    const char * fn = wr ? "OFILE" : "IFILE";
+    uint8_t lu[256];
+    uint8_t olu[256];
+    uint8_t di[MPATH_DI_LEN];
+    mp->fd[0] = wr ? clp->outfd : clp->infd;
+    if (FT_SG != (wr ? clp->out_type : clp->in_type)) {
+        pr2serr("%smpath=: each path of %s must be a sg device, %s is not\n",
+                my_name, fn, mp->fname[0]);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    lu_len = 0;
+    if ((n = mpath_read_di(mp->fd[0], NULL, di, sizeof(di))) >= 0)
+        mpath_ids(di, n, lu, &lu_len, &mp->tpg[0]);
+    if (0 == lu_len) {
+        pr2serr("%smpath=: no logical unit designator from %s\n", my_name,
+                mp->fname[0]);
+        return SG_LIB_CAT_OTHER;
+    }
+    if (discover)
+        mpath_discover(mp, lu, lu_len);
+    for (k = 1; k < mp->num; ++k) {
+        if (FT_SG != sg_io_filetype(mp->fname[k], 0, clp->debug)) {
+            pr2serr("%smpath=: each path of %s must be a sg device, %s is "
+                    "not\n", my_name, fn, mp->fname[k]);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        mp->fd[k] = sg_io_open_dd(mp->fname[k], FT_SG, wr, open_fl_mask(fp),
+                                  0, clp->bs, my_name, 0);
+        if (mp->fd[k] < 0)
+            return sg_convert_errno(-mp->fd[k]);
+        if (sg_prepare(mp->fd[k], clp->bs, clp->bpt))
+            return SG_LIB_FILE_ERROR;
+        o_len = 0;
+        if ((n = mpath_read_di(mp->fd[k], NULL, di, sizeof(di))) >= 0)
+            mpath_ids(di, n, olu, &o_len, &mp->tpg[k]);
+        if ((o_len != lu_len) || memcmp(olu, lu, lu_len)) {
+            pr2serr("%smpath=: %s and %s are not paths to the same logical "
+                    "unit\n", my_name, mp->fname[0], mp->fname[k]);
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    for (k = 0; k < mp->num; ++k)
+        mp->alua[k] = -1;
+    /* any path reports the state of every target port group */
+    res = sg_ll_report_tgt_prt_grp2(mp->fd[0], di, sizeof(di), false, false,
+                                    (clp->debug > 1) ? clp->debug - 1 : 0);
+    if (0 == res) {
+        const uint8_t * bp;
+        int len = sg_get_unaligned_be32(di + 0) + 4;
+
+        if (len > (int)sizeof(di))
+            len = sizeof(di);
+        for (bp = di + 4; (bp + 8) <= (di + len); bp += 8 + (bp[7] * 4)) {
+            for (k = 0; k < mp->num; ++k) {
+                if (mp->tpg[k] == sg_get_unaligned_be16(bp + 2))
+                    mp->alua[k] = bp[0] & 0xf;
+            }
+        }
+    }
+    for (best = 2, k = 0; k < mp->num; ++k) {
+        if (mpath_rank(mp->alua[k]) < best)
+            best = mpath_rank(mp->alua[k]);
+    }
+    for (j = 0, k = 0; k < mp->num; ++k) {
+        if ((2 == best) || (mpath_rank(mp->alua[k]) == best))
+            mp->use[j++] = k;
+    }
+    mp->use_num = j;
+    if (clp->debug || (mp->use_num < mp->num)) {
+        for (k = 0; k < mp->num; ++k) {
+            for (j = 0; j < mp->use_num; ++j) {
+                if (k == mp->use[j])
+                    break;
+            }
+            pr2serr("%s%s path %s: target port group %d, %s%s\n", my_name,
+                    fn, mp->fname[k], mp->tpg[k], mpath_state_str(mp->alua[k]),
+                    (j < mp->use_num) ? "" : " [not used]");
+        }
+    }
+    if (mp->num > 1)
+        mpath_referrals(clp, mp, fn);
+    return 0;
+}
+
+/* Closes the paths after the first, reporting the commands sent down
+ * each when the debug level is raised */
+static void
+mpath_close(const Rq_coll * clp, struct mpath_t * mp, const char * fn)
+{
+    int k;
+
+    for (k = 0; k < mp->num; ++k) {
+        if (clp->debug && mp->use_num)
+            pr2serr("%s%s path %s: %" PRId64 " commands\n", my_name, fn,
+                    mp->fname[k], (int64_t)mp->cmds[k]);
+        if ((k > 0) && (mp->fd[k] >= 0))
+            close(mp->fd[k]);
+    }
+    if (clp->debug && mp->ref_num)
+        pr2serr("%s%s: %" PRId64 " commands routed by referrals\n", my_name,
+                fn, (int64_t)mp->routed);
+    free(mp->ref);
+    mp->ref = NULL;
+}
+
+/* Returns the fd of the path the next command on mp, starting at blk,
+ * goes down, setting *pathp to its index. The candidates are the paths a
+ * referral gives for blk, else the used paths. mpath=rr takes them in
+ * turn, mpath=lo the one with the fewest commands in flight, taking them
+ * in turn to break ties. */
+static int
+mpath_pick(struct mpath_t * mp, int64_t blk, int * pathp)
+{
+    int k, j, p, start;
+    int un = mp->use_num;
+    int64_t n, low;
+    const int * up = mp->use;
+    const struct mpath_ref * rp;
+    int cand[MAX_MPATH];
+
+    if (mp->ref_num && (rp = mpath_ref_find(mp, blk)) && rp->paths) {
+        for (un = 0, k = 0; k < mp->num; ++k) {
+            if (rp->paths & (1U << k))
+                cand[un++] = k;
+        }
+        up = cand;
+        SGP_FETCH_ADD(&mp->routed, 1);
+    }
+    start = (int)(SGP_FETCH_ADD(&mp->next, 1) % un);
+    p = up[start];
+    if (MPATH_LO == mp->policy) {
+        low = mp->outst[p];
+        for (k = 1; (k < un) && (low > 0); ++k) {
+            j = up[(start + k) % un];
+            if ((n = mp->outst[j]) < low) {
+                low = n;
+                p = j;
+            }
+        }
+    }
+    SGP_FETCH_ADD(&mp->outst[p], 1);
+    SGP_FETCH_ADD(&mp->cmds[p], 1);
+    *pathp = p;
+    return mp->fd[p];
+}
+
+/* The command mpath_pick() sent down path *pathp is no longer in flight */
+static void
+mpath_put(struct mpath_t * mp, int * pathp)
+{
+    if (mp && (*pathp >= 0))
+        SGP_FETCH_ADD(&mp->outst[*pathp], -1);
+    *pathp = -1;
+}
+
+/* Reads back 'blocks' blocks starting at 'lba' from the OFILE for
+ * verify=1. Returns 0 when successful. */
+static int
+read_back(Rq_coll * clp, int fd, uint8_t * bp, int blocks, int64_t lba)
 {
-    int res, t;
+    int res;
+    int len = blocks * clp->bs;
+    uint8_t rdCmd[MAX_SCSI_CDBSZ];
+    uint8_t senseBuff[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+    char strerr_buff[STRERR_BUFF_LEN];
 
-    res = ioctl(fd, SG_GET_VERSION_NUM, &t);
-    if ((res < 0) || (t < 30000)) {
-        pr2serr("%ssg driver prior to 3.x.y\n", my_name);
-        return 1;
+    if (FT_SG != clp->out_type) {
+        while (((res = pread(fd, bp, len, (off64_t)lba * clp->bs)) < 0) &&
+               ((EINTR == errno) || (EAGAIN == errno)))
+            ;
+        if (res < 0) {
+            pr2serr("verify read back, %s\n",
+                    tsafe_strerror(errno, strerr_buff));
+            return SG_LIB_FILE_ERROR;
+        }
+        return (res < len) ? SG_LIB_CAT_MISCOMPARE : 0;
     }
-    t = bs * bpt;
-    res = ioctl(fd, SG_SET_RESERVED_SIZE, &t);
-    if (res < 0)
-        perror("sgp_dd: SG_SET_RESERVED_SIZE error");
-    t = 1;
-    res = ioctl(fd, SG_SET_FORCE_PACK_ID, &t);
-    if (res < 0)
-        perror("sgp_dd: SG_SET_FORCE_PACK_ID error");
-    return 0;
+    if (sg_build_rw_cdb(rdCmd, clp->cdbsz_out, blocks, lba, false, false,
+                        false, my_name)) {
+        pr2serr("%sbad verify cdb build, start_blk=%" PRId64 ", blocks=%d\n",
+                my_name, lba, blocks);
+        return -1;
+    }
+    memset(&io_hdr, 0, sizeof(struct sg_io_hdr));
+    io_hdr.interface_id = 'S';
+    io_hdr.cmd_len = clp->cdbsz_out;
+    io_hdr.cmdp = rdCmd;
+    io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
+    io_hdr.dxfer_len = len;
+    io_hdr.dxferp = bp;
+    io_hdr.mx_sb_len = SENSE_BUFF_LEN;
+    io_hdr.sbp = senseBuff;
+    io_hdr.timeout = DEF_TIMEOUT;
+    io_hdr.pack_id = (int)GET_NEXT_PACK_ID(1);
+    while (((res = ioctl(fd, SG_IO, &io_hdr)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        perror("verify reading (SG_IO) on sg device, error");
+        return -1;
+    }
+    res = sg_err_category3(&io_hdr);
+    if ((SG_LIB_CAT_CLEAN == res) || (SG_LIB_CAT_RECOVERED == res))
+        return 0;
+    sg_chk_n_print3("verify reading", &io_hdr, clp->debug > 1);
+    return res;
+}
+
+/* Implements verify=1, after the copy (so single threaded): reads back
+ * each chunk of the OFILE listed in the digest manifest 'mfn' and compares
+ * its CRC32C with the one recorded during the copy. Returns 0 if they all
+ * match. */
+static int
+verify_digests(Rq_coll * clp, const char * mfn, int fd)
+{
+    int blocks, res, path;
+    int ret = 0;
+    unsigned int crc;
+    int64_t lba;
+    int64_t chunks = 0;
+    int64_t v_blocks = 0;
+    int64_t mismatches = 0;
+    uint8_t * bp;
+    FILE * fp;
+    char line[128];
+
+    if (NULL == (fp = fopen(mfn, "r"))) {
+        perror("sgp_dd: verify: unable to re-open digest manifest");
+        return SG_LIB_FILE_ERROR;
+    }
+    bp = sg_hugebuf_get(clp->bpt * clp->bs, true, clp->debug > 3);
+    if (NULL == bp)
+        err_exit(ENOMEM, "out of memory creating verify buffer\n");
+    while (fgets(line, sizeof(line), fp)) {
+        if ('#' == line[0])
+            continue;
+        if ((3 != sscanf(line, "%" SCNd64 " %d %x", &lba, &blocks, &crc)) ||
+            (blocks <= 0) || (blocks > clp->bpt)) {
+            pr2serr("%sverify: bad line in digest manifest: %s", my_name,
+                    line);
+            ret = SG_LIB_FILE_ERROR;
+            break;
+        }
+        if (clp->out_mpath.num > 0) {
+            fd = mpath_pick(&clp->out_mpath, lba, &path);
+            res = read_back(clp, fd, bp, blocks, lba);
+            mpath_put(&clp->out_mpath, &path);
+        } else
+            res = read_back(clp, fd, bp, blocks, lba);
+        if ((0 == res) && (sg_crc32c(0, bp, blocks * clp->bs) != crc))
+            res = SG_LIB_CAT_MISCOMPARE;
+        if (SG_LIB_CAT_MISCOMPARE == res) {
+            ++mismatches;
+            if (clp->debug || (mismatches <= 10))
+                pr2serr("%sverify: miscompare in %d blocks from blk=%" PRId64
+                        "\n", my_name, blocks, lba);
+        } else if (res) {
+            ret = res;
+            break;
+        }
+        ++chunks;
+        v_blocks += blocks;
+    }
+    sg_hugebuf_put(bp);
+    fclose(fp);
+    pr2serr("Verify: %" PRId64 " chunks (%" PRId64 " blocks) read back, %"
+            PRId64 " miscompared\n", chunks, v_blocks, mismatches);
+    if ((0 == ret) && mismatches)
+        ret = SG_LIB_CAT_MISCOMPARE;
+    return ret;
 }
 
 static int
@@ -1173,6 +4700,12 @@ process_flags(const char * arg, struct flags_t * fp)
             fp->fua = true;
         else if (0 == strcmp(cp, "null"))
             ;
+        else if (0 == strcmp(cp, "sparse"))
+            fp->sparse = true;
+        else if (0 == strcmp(cp, "zbc"))
+            fp->zbc = true;
+        else if (0 == strcmp(cp, "zfinish"))
+            fp->zbc = fp->zfinish = true;
         else {
             pr2serr("unrecognised flag: %s\n", cp);
             return 1;
@@ -1211,16 +4744,33 @@ main(int argc, char * argv[])
     int obs = 0;
     int bpt_given = 0;
     int cdbsz_given = 0;
+    bool bpt_auto = false;
+    bool seed_given = false;
+    bool mpath_auto = false;
+    bool thr_given = false;
+    bool elems_given = false;
+    bool dio_given = false;
+    int engine = ENGINE_DEF;
+    int mpath_policy = 0;
+    int64_t stripe_blks = 0;
+    int64_t t[TS_NUM];
+    double theta = DEF_ZIPF_THETA;
     char str[STR_SZ];
     char * key;
     char * buf;
+    char * cp;
     char inf[INOUTF_SZ];
     char outf[INOUTF_SZ];
-    int res, k, err, keylen;
+    char dgst_f[INOUTF_SZ];
+    char rsm_f[INOUTF_SZ];
+    char prog_f[INOUTF_SZ];
+    char fan_f[MAX_FAN_OUT - 1][INOUTF_SZ];
+    int res, k, keylen;
     int64_t in_num_sect = 0;
     int64_t out_num_sect = 0;
     int in_sect_sz, out_sect_sz, status, n, flags;
     void * vp;
+    void * (* volatile worker_fn)(void *);
     Rq_coll * clp = &rcoll;
     char ebuff[EBUFF_SZ];
 #if SG_LIB_ANDROID
@@ -1234,12 +4784,19 @@ main(int argc, char * argv[])
 #endif
     memset(clp, 0, sizeof(*clp));
     clp->bpt = DEF_BLOCKS_PER_TRANSFER;
+    clp->elems = 1;
+    clp->numa_node = -1;
+    clp->pattern = PAT_SEQ;
+    clp->mix = -1;
     clp->in_type = FT_OTHER;
     clp->out_type = FT_OTHER;
     clp->cdbsz_in = DEF_SCSI_CDBSZ;
     clp->cdbsz_out = DEF_SCSI_CDBSZ;
     inf[0] = '\0';
     outf[0] = '\0';
+    dgst_f[0] = '\0';
+    rsm_f[0] = '\0';
+    prog_f[0] = '\0';
 
     for (k = 1; k < argc; k++) {
         if (argv[k]) {
@@ -1254,7 +4811,8 @@ main(int argc, char * argv[])
             *buf++ = '\0';
         keylen = strlen(key);
         if (0 == strcmp(key,"bpt")) {
-            clp->bpt = sg_get_num(buf);
+            bpt_auto = (0 == strcmp(buf, "auto"));
+            clp->bpt = bpt_auto ? DEF_BLOCKS_PER_TRANSFER : sg_get_num(buf);
             if (-1 == clp->bpt) {
                 pr2serr("%sbad argument to 'bpt='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
@@ -1284,9 +4842,33 @@ main(int argc, char * argv[])
         } else if ((0 == strncmp(key,"deb", 3)) ||
                    (0 == strncmp(key,"verb", 4)))
             clp->debug = sg_get_num(buf);
-        else if (0 == strcmp(key,"dio")) {
+        else if (0 == strcmp(key, "digest")) {
+            memcpy(dgst_f, buf, INOUTF_SZ - 1);
+            dgst_f[INOUTF_SZ - 1] = '\0';
+        } else if (0 == strcmp(key,"dio")) {
             clp->in_flags.dio = !! sg_get_num(buf);
             clp->out_flags.dio = clp->in_flags.dio;
+            dio_given = true;
+        } else if (0 == strcmp(key,"elems")) {
+            clp->elems = sg_get_num(buf);
+            if ((clp->elems < 1) || (clp->elems > MAX_ELEMS)) {
+                pr2serr("%sbad argument to 'elems=', expect 1 to %d\n",
+                        my_name, MAX_ELEMS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            elems_given = true;
+        } else if (0 == strcmp(key,"engine")) {
+            if (0 == strcmp(buf, "auto"))
+                engine = ENGINE_AUTO;
+            else if (0 == strcmp(buf, "sync"))
+                engine = ENGINE_SYNC;
+            else if (0 == strcmp(buf, "queue"))
+                engine = ENGINE_QUEUE;
+            else {
+                pr2serr("%sbad argument to 'engine=', expect auto, sync or "
+                        "queue\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"fua")) {
             n = sg_get_num(buf);
             if (n & 1)
@@ -1307,11 +4889,49 @@ main(int argc, char * argv[])
                 memcpy(inf, buf, INOUTF_SZ);
                 inf[INOUTF_SZ - 1] = '\0';
             }
+        } else if (0 == strcmp(key, "iops")) {
+            rate_iops = sg_get_llnum(buf);
+            if (rate_iops < 0) {
+                pr2serr("%sbad argument to 'iops='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "iflag")) {
             if (process_flags(buf, &clp->in_flags)) {
                 pr2serr("%sbad argument to 'iflag='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "mpath")) {
+            if (0 == strncmp(buf, "rr", 2))
+                mpath_policy = MPATH_RR;
+            else if (0 == strncmp(buf, "lo", 2))
+                mpath_policy = MPATH_LO;
+            else
+                mpath_policy = 0;
+            if ((0 == mpath_policy) ||
+                ((',' == buf[2]) ? strcmp(buf + 3, "auto") : buf[2])) {
+                pr2serr("%sbad argument to 'mpath=', expect rr or lo, "
+                        "optionally with ',auto'\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            mpath_auto = (',' == buf[2]);
+        } else if (0 == strcmp(key, "mix")) {
+            clp->mix = sg_get_num(buf);
+            if ((clp->mix < 0) || (clp->mix > 100)) {
+                pr2serr("%sbad argument to 'mix=', expect 0 to 100\n",
+                        my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"numa")) {
+            if (0 == strcmp(buf, "auto"))
+                numa_req = -1;
+            else {
+                numa_req = sg_get_num(buf);
+                if ((numa_req < 0) || (numa_req >= MAX_NUMA_NODES)) {
+                    pr2serr("%sbad argument to 'numa=', expect 'auto' or "
+                            "a node number\n", my_name);
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+            }
         } else if (0 == strcmp(key,"obs")) {
             obs = sg_get_num(buf);
             if (-1 == obs) {
@@ -1319,18 +4939,111 @@ main(int argc, char * argv[])
                 return SG_LIB_SYNTAX_ERROR;
             }
         } else if (strcmp(key,"of") == 0) {
-            if ('\0' != outf[0]) {
-                pr2serr("Second 'of=' argument??\n");
-                return SG_LIB_SYNTAX_ERROR;
-            } else {
+            if ('\0' == outf[0]) {
                 memcpy(outf, buf, INOUTF_SZ);
                 outf[INOUTF_SZ - 1] = '\0';
+            } else if (clp->fan_num < (MAX_FAN_OUT - 1)) {
+                memcpy(fan_f[clp->fan_num], buf, INOUTF_SZ);
+                fan_f[clp->fan_num][INOUTF_SZ - 1] = '\0';
+                clp->fan[clp->fan_num].fname = fan_f[clp->fan_num];
+                ++clp->fan_num;
+            } else {
+                pr2serr("%sat most %d 'of=' arguments\n", my_name,
+                        MAX_FAN_OUT);
+                return SG_LIB_SYNTAX_ERROR;
             }
         } else if (0 == strcmp(key, "oflag")) {
             if (process_flags(buf, &clp->out_flags)) {
                 pr2serr("%sbad argument to 'oflag='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key,"qd_lat")) {
+            qd_lat_us = sg_get_llnum(buf);
+            if (-1LL == qd_lat_us) {
+                pr2serr("%sbad argument to 'qd_lat='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "pattern")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            if (0 == strcmp(buf, "seq"))
+                clp->pattern = PAT_SEQ;
+            else if (0 == strcmp(buf, "rand"))
+                clp->pattern = PAT_RAND;
+            else if (0 == strcmp(buf, "zipf"))
+                clp->pattern = PAT_ZIPF;
+            else {
+                pr2serr("%sbad argument to 'pattern=', expect seq, rand or "
+                        "zipf[,THETA]\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (cp) {
+                char * ep;
+
+                theta = strtod(cp, &ep);
+                if ((PAT_ZIPF != clp->pattern) || ('\0' != *ep) ||
+                    (! (theta > 0.0)) || (! (theta < 1.0))) {
+                    pr2serr("%sbad argument to 'pattern=', THETA only with "
+                            "zipf and between 0 and 1\n", my_name);
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+            }
+        } else if (0 == strcmp(key, "progress")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            progress_sec = sg_get_num(buf);
+            if (progress_sec < 1) {
+                pr2serr("%sbad argument to 'progress=', expect SEC[,FILE] "
+                        "with SEC > 0\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (cp && *cp) {
+                memcpy(prog_f, cp, INOUTF_SZ - 1);
+                prog_f[INOUTF_SZ - 1] = '\0';
+            }
+        } else if (0 == strcmp(key,"protect")) {
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            clp->rdprotect = sg_get_num(buf);
+            clp->wrprotect = cp ? sg_get_num(cp) : 0;
+            if ((clp->rdprotect < 0) || (clp->rdprotect > 7) ||
+                (clp->wrprotect < 0) || (clp->wrprotect > 7)) {
+                pr2serr("%sbad argument to 'protect=', expect RDP[,WRP] "
+                        "each 0 to 7\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "rate")) {
+            rate_bps = sg_get_llnum(buf);
+            if (rate_bps < 0) {
+                pr2serr("%sbad argument to 'rate='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "rate_lat")) {
+            rate_lat_us = sg_get_llnum(buf);
+            if (rate_lat_us < 0) {
+                pr2serr("%sbad argument to 'rate_lat='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"reorder")) {
+            clp->reorder = sg_get_num(buf);
+            if ((clp->reorder < 0) || (clp->reorder > MAX_REORDER)) {
+                pr2serr("%sbad argument to 'reorder=', expect 0 to %d\n",
+                        my_name, MAX_REORDER);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "resume")) {
+            memcpy(rsm_f, buf, INOUTF_SZ - 1);
+            rsm_f[INOUTF_SZ - 1] = '\0';
+        } else if (0 == strcmp(key, "seed")) {
+            clp->seed = (uint64_t)sg_get_llnum(buf);
+            if ((uint64_t)-1LL == clp->seed) {
+                pr2serr("%sbad argument to 'seed='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            seed_given = true;
         } else if (0 == strcmp(key,"seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
@@ -1343,12 +5056,29 @@ main(int argc, char * argv[])
                 pr2serr("%sbad argument to 'skip='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "stripe")) {
+            stripe_blks = sg_get_llnum(buf);
+            if ((stripe_blks < 1) || (stripe_blks > INT_MAX)) {
+                pr2serr("%sbad argument to 'stripe='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "streams")) {
+            streams_req = sg_get_num(buf);
+            if ((streams_req < 0) || (streams_req > MAX_STREAMS)) {
+                pr2serr("%sbad argument to 'streams=', expect 0 to %d\n",
+                        my_name, MAX_STREAMS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"sync"))
             do_sync = !! sg_get_num(buf);
-        else if (0 == strcmp(key,"thr"))
+        else if (0 == strcmp(key,"thr")) {
             num_threads = sg_get_num(buf);
+            thr_given = true;
+        }
         else if (0 == strcmp(key,"time"))
             do_time = !! sg_get_num(buf);
+        else if (0 == strcmp(key, "verify"))
+            do_verify = !! sg_get_num(buf);
         else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
             res = 0;
             n = num_chs_in_str(key + 1, keylen - 1, 'd');
@@ -1449,6 +5179,77 @@ main(int argc, char * argv[])
     if (clp->debug)
         pr2serr("%sif=%s skip=%" PRId64 " of=%s seek=%" PRId64 " count=%"
                 PRId64 "\n", my_name, inf, skip, outf, seek, dd_count);
+    if (mpath_policy) {
+        if (stripe_blks) {
+            pr2serr("%smpath= contradicts stripe=\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if ((strchr(inf, ',') || mpath_auto) &&
+            mpath_split(inf, &clp->in_mpath, mpath_policy))
+            return SG_LIB_SYNTAX_ERROR;
+        if ((strchr(outf, ',') || mpath_auto) &&
+            mpath_split(outf, &clp->out_mpath, mpath_policy))
+            return SG_LIB_SYNTAX_ERROR;
+        if ((0 == clp->in_mpath.num) && (0 == clp->out_mpath.num)) {
+            pr2serr("%smpath= needs 'if=' or 'of=' to be a comma separated "
+                    "list of sg paths,\nor ',auto'\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ((clp->out_mpath.num > 0) && clp->out_flags.zbc) {
+            pr2serr("%soflag=zbc does not work with mpath= on OFILE, zone "
+                    "writes must\nstay in order\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+    } else if (stripe_split(inf, &clp->in_stripe, stripe_blks) ||
+               stripe_split(outf, &clp->out_stripe, stripe_blks))
+        return SG_LIB_SYNTAX_ERROR;
+    if ((clp->in_stripe.num > 0) || (clp->out_stripe.num > 0)) {
+        if (0 == stripe_blks) {
+            pr2serr("%sa list of sg devices for 'if=' or 'of=' needs "
+                    "stripe=BLKS\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (clp->rdprotect || clp->wrprotect ||
+            ((clp->out_stripe.num > 0) &&
+             (clp->fan_num || clp->out_flags.sparse || do_verify))) {
+            pr2serr("%sstripe= does not work with protect=, nor a striped "
+                    "OFILE with more than one 'of=', oflag=sparse or "
+                    "verify=1\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+    } else if (stripe_blks > 0) {
+        pr2serr("%sstripe= needs 'if=' or 'of=' to be a comma separated "
+                "list of sg devices\n", my_name);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((PAT_SEQ != clp->pattern) || (clp->mix >= 0)) {
+        if (stripe_blks || clp->fan_num || (clp->elems > 1) ||
+            (clp->reorder > 0) || rsm_f[0] || dgst_f[0] || do_verify ||
+            clp->out_flags.sparse || clp->rdprotect || clp->wrprotect) {
+            pr2serr("%spattern= and mix= do not work with stripe=, more "
+                    "than one 'of=',\nelems=, reorder=, resume=, digest=, "
+                    "verify=1, oflag=sparse nor protect=\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if (! seed_given) {
+            struct timeval tv;
+
+            gettimeofday(&tv, NULL);
+            clp->seed = ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+        }
+    }
+    if (clp->in_flags.zbc) {
+        pr2serr("%szbc and zfinish are only flags for 'oflag='\n", my_name);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (clp->out_flags.zbc &&
+        ((clp->reorder > 0) || clp->out_flags.sparse || rsm_f[0] ||
+         (clp->out_stripe.num > 0) || (PAT_SEQ != clp->pattern) ||
+         (clp->mix >= 0))) {
+        pr2serr("%soflag=zbc does not work with reorder=, oflag=sparse, "
+                "resume=, a striped\nOFILE, pattern= nor mix=\n", my_name);
+        return SG_LIB_CONTRADICT;
+    }
 
     install_handler(SIGINT, interrupt_handler);
     install_handler(SIGQUIT, interrupt_handler);
@@ -1458,7 +5259,7 @@ main(int argc, char * argv[])
     clp->infd = STDIN_FILENO;
     clp->outfd = STDOUT_FILENO;
     if (inf[0] && ('-' != inf[0])) {
-        clp->in_type = dd_filetype(inf);
+        clp->in_type = sg_io_filetype(inf, 0, clp->debug);
 
         if (FT_ERROR == clp->in_type) {
             pr2serr("%sunable to access %s\n", my_name, inf);
@@ -1467,124 +5268,54 @@ main(int argc, char * argv[])
             pr2serr("%sunable to use scsi tape device %s\n", my_name, inf);
             return SG_LIB_FILE_ERROR;
         } else if (FT_SG == clp->in_type) {
-            flags = O_RDWR;
-            if (clp->in_flags.direct)
-                flags |= O_DIRECT;
-            if (clp->in_flags.excl)
-                flags |= O_EXCL;
-            if (clp->in_flags.dsync)
-                flags |= O_SYNC;
-
-            if ((clp->infd = open(inf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff, EBUFF_SZ, "%scould not open %s for sg "
-                         "reading", my_name, inf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            }
-            if (sg_prepare(clp->infd, clp->bs, clp->bpt))
+            clp->infd = sg_io_open_dd(inf, clp->in_type, false,
+                                      open_fl_mask(&clp->in_flags), 0,
+                                      clp->bs, my_name, 0);
+            if (clp->infd < 0)
+                return sg_convert_errno(-clp->infd);
+            sg_ds_init(&clp->in_ds, clp->infd,
+                       (clp->debug > 1) ? clp->debug - 1 : 0);
+            if (sg_prepare(clp->infd, clp->bs + (clp->rdprotect ?
+                                                 SG_T10_PI_LEN : 0),
+                           clp->bpt))
                 return SG_LIB_FILE_ERROR;
         }
         else {
-            flags = O_RDONLY;
-            if (clp->in_flags.direct)
-                flags |= O_DIRECT;
-            if (clp->in_flags.excl)
-                flags |= O_EXCL;
-            if (clp->in_flags.dsync)
-                flags |= O_SYNC;
-
-            if ((clp->infd = open(inf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff, EBUFF_SZ, "%scould not open %s for reading",
-                         my_name, inf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            }
-            else if (skip > 0) {
-                off64_t offset = skip;
-
-                offset *= clp->bs;       /* could exceed 32 here! */
-                if (lseek64(clp->infd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scouldn't skip to required "
-                             "position on %s", my_name, inf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
+            clp->infd = sg_io_open_dd(inf, clp->in_type, false,
+                                      open_fl_mask(&clp->in_flags), skip,
+                                      clp->bs, my_name, 0);
+            if (clp->infd < 0)
+                return sg_convert_errno(-clp->infd);
         }
     }
     if (outf[0] && ('-' != outf[0])) {
-        clp->out_type = dd_filetype(outf);
+        clp->out_type = sg_io_filetype(outf, 0, clp->debug);
 
         if (FT_ST == clp->out_type) {
             pr2serr("%sunable to use scsi tape device %s\n", my_name, outf);
             return SG_LIB_FILE_ERROR;
         }
         else if (FT_SG == clp->out_type) {
-            flags = O_RDWR;
-            if (clp->out_flags.direct)
-                flags |= O_DIRECT;
-            if (clp->out_flags.excl)
-                flags |= O_EXCL;
-            if (clp->out_flags.dsync)
-                flags |= O_SYNC;
-
-            if ((clp->outfd = open(outf, flags)) < 0) {
-                err = errno;
-                snprintf(ebuff,  EBUFF_SZ, "%scould not open %s for sg "
-                         "writing", my_name, outf);
-                perror(ebuff);
-                return sg_convert_errno(err);
-            }
-
-            if (sg_prepare(clp->outfd, clp->bs, clp->bpt))
+            clp->outfd = sg_io_open_dd(outf, clp->out_type, true,
+                                       open_fl_mask(&clp->out_flags), 0,
+                                       clp->bs, my_name, 0);
+            if (clp->outfd < 0)
+                return sg_convert_errno(-clp->outfd);
+            sg_ds_init(&clp->out_ds, clp->outfd,
+                       (clp->debug > 1) ? clp->debug - 1 : 0);
+            if (sg_prepare(clp->outfd, clp->bs + (clp->wrprotect ?
+                                                  SG_T10_PI_LEN : 0),
+                           clp->bpt))
                 return SG_LIB_FILE_ERROR;
         }
         else if (FT_DEV_NULL == clp->out_type)
             clp->outfd = -1; /* don't bother opening */
         else {
-            if (FT_RAW != clp->out_type) {
-                flags = O_WRONLY | O_CREAT;
-                if (clp->out_flags.direct)
-                    flags |= O_DIRECT;
-                if (clp->out_flags.excl)
-                    flags |= O_EXCL;
-                if (clp->out_flags.dsync)
-                    flags |= O_SYNC;
-                if (clp->out_flags.append)
-                    flags |= O_APPEND;
-
-                if ((clp->outfd = open(outf, flags, 0666)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for "
-                             "writing", my_name, outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            else {      /* raw output file */
-                if ((clp->outfd = open(outf, O_WRONLY)) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for raw "
-                             "writing", my_name, outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
-            if (seek > 0) {
-                off64_t offset = seek;
-
-                offset *= clp->bs;       /* could exceed 32 bits here! */
-                if (lseek64(clp->outfd, offset, SEEK_SET) < 0) {
-                    err = errno;
-                    snprintf(ebuff, EBUFF_SZ, "%scouldn't seek to required "
-                             "position on %s", my_name, outf);
-                    perror(ebuff);
-                    return sg_convert_errno(err);
-                }
-            }
+            clp->outfd = sg_io_open_dd(outf, clp->out_type, true,
+                                       open_fl_mask(&clp->out_flags), seek,
+                                       clp->bs, my_name, 0);
+            if (clp->outfd < 0)
+                return sg_convert_errno(-clp->outfd);
         }
     }
     if ((STDIN_FILENO == clp->infd) && (STDOUT_FILENO == clp->outfd)) {
@@ -1592,14 +5323,272 @@ main(int argc, char * argv[])
         pr2serr("For more information use '--help'\n");
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (bpt_auto) {
+        clp->bpt = auto_bpt(clp, inf, outf, (clp->bs >= 2048) ?
+                            DEF_BLOCKS_PER_2048TRANSFER :
+                            DEF_BLOCKS_PER_TRANSFER);
+        if (((FT_SG == clp->in_type) && (6 == clp->cdbsz_in)) ||
+            ((FT_SG == clp->out_type) && (6 == clp->cdbsz_out)))
+            clp->bpt = (clp->bpt > 256) ? 256 : clp->bpt;
+        if (clp->debug)
+            pr2serr("bpt=auto: using bpt=%d (%d bytes per transfer)\n",
+                    clp->bpt, clp->bpt * clp->bs);
+        /* sg_prepare() sized the reserved buffers for the default bpt */
+        k = (clp->bs + (clp->rdprotect ? SG_T10_PI_LEN : 0)) * clp->bpt;
+        if ((FT_SG == clp->in_type) &&
+            (ioctl(clp->infd, SG_SET_RESERVED_SIZE, &k) < 0))
+            perror("sgp_dd: SG_SET_RESERVED_SIZE error");
+        k = (clp->bs + (clp->wrprotect ? SG_T10_PI_LEN : 0)) * clp->bpt;
+        if ((FT_SG == clp->out_type) &&
+            (ioctl(clp->outfd, SG_SET_RESERVED_SIZE, &k) < 0))
+            perror("sgp_dd: SG_SET_RESERVED_SIZE error");
+    }
+    /* with ',auto' a single IFILE or OFILE that is not a sg device is
+     * simply not multipathed */
+    if ((1 == clp->in_mpath.num) && (FT_SG != clp->in_type))
+        clp->in_mpath.num = 0;
+    if ((1 == clp->out_mpath.num) && (FT_SG != clp->out_type))
+        clp->out_mpath.num = 0;
+    if ((clp->in_mpath.num > 0) &&
+        (res = mpath_open(clp, &clp->in_mpath, false, mpath_auto)))
+        return res;
+    if ((clp->out_mpath.num > 0) &&
+        (res = mpath_open(clp, &clp->out_mpath, true, mpath_auto)))
+        return res;
+    if (engine &&
+        (res = choose_engine(clp, engine, thr_given, elems_given, dio_given,
+                             ((PAT_SEQ != clp->pattern) || (clp->mix >= 0) ||
+                              (clp->fan_num > 0)))))
+        return res;
+    if (stripe_blks > 0) {
+        int64_t a = stripe_blks;
+        int64_t b = clp->bpt;
+        int64_t t;
+        const struct stripe_t * sp;
+
+        while (b > 0) {         /* bpt must divide the stripe */
+            t = a % b;
+            a = b;
+            b = t;
+        }
+        if (a != clp->bpt) {
+            pr2serr("%sstripe=%" PRId64 ": bpt reduced from %d to %d\n",
+                    my_name, stripe_blks, clp->bpt, (int)a);
+            clp->bpt = (int)a;
+        }
+        if (((clp->in_stripe.num > 0) && (skip % clp->bpt)) ||
+            ((clp->out_stripe.num > 0) && (seek % clp->bpt))) {
+            pr2serr("%sstripe=: skip= (seek=) of a striped IFILE (OFILE) "
+                    "must be a multiple of bpt=%d\n", my_name, clp->bpt);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ((clp->in_stripe.num > 0) &&
+            (res = stripe_open(clp, &clp->in_stripe, false)))
+            return res;
+        if ((clp->out_stripe.num > 0) &&
+            (res = stripe_open(clp, &clp->out_stripe, true)))
+            return res;
+        /* READs are scheduled per member of a striped IFILE, otherwise
+         * of a striped OFILE (when IFILE is a sg device) */
+        if (clp->in_stripe.num > 0) {
+            clp->sched = &clp->in_stripe;
+            clp->sched_base = skip;
+        } else if (FT_SG == clp->in_type) {
+            clp->sched = &clp->out_stripe;
+            clp->sched_base = seek;
+        }
+        if ((sp = clp->sched)) {
+            a = stripe_blks / clp->bpt;         /* chunks per stripe unit */
+            b = clp->sched_base / clp->bpt;
+            for (k = 0; k < sp->num; ++k)
+                clp->st_claimed[k] = stripe_chunks_before(b, k, sp->num, a);
+            clp->st_next_member = (b / a) % sp->num;
+            if (num_threads < sp->num) {
+                pr2serr("%sstripe=: thr= raised to %d, one per member\n",
+                        my_name, sp->num);
+                num_threads = sp->num;
+            }
+        }
+    }
+    if (numa_req >= -1) {
+        int node = numa_req;
+        const char * cp = "given";
+
+        if (-1 == node) {
+            if ((FT_SG | FT_BLOCK | FT_RAW) & clp->in_type) {
+                node = dev_numa_node(clp->infd);
+                cp = inf;
+            }
+            if ((node < 0) && ((FT_SG | FT_BLOCK | FT_RAW) & clp->out_type)) {
+                node = dev_numa_node(clp->outfd);
+                cp = outf;
+            }
+        }
+        if (node < 0)
+            pr2serr("%sno NUMA node found for IFILE or OFILE, threads and "
+                    "buffers not placed\n", my_name);
+        else if (0 == numa_node_cpus(node, &clp->numa_cpus))
+            pr2serr("%sno CPUs found for NUMA node %d, threads and buffers "
+                    "not placed\n", my_name, node);
+        else {
+            clp->numa_node = node;
+            if (clp->debug)
+                pr2serr("%sNUMA node %d (%s) with %d CPUs\n", my_name, node,
+                        cp, CPU_COUNT(&clp->numa_cpus));
+        }
+    }
+    if ((clp->elems > 1) && (FT_SG != clp->in_type)) {
+        struct stat st;
+
+        /* normal reads in flight together need offsets, not the file
+         * position */
+        if ((FT_BLOCK != clp->in_type) && (FT_RAW != clp->in_type) &&
+            ((FT_OTHER != clp->in_type) || (fstat(clp->infd, &st) < 0) ||
+             (! S_ISREG(st.st_mode)))) {
+            pr2serr("%selems= needs IFILE to be a sg, block or raw device "
+                    "or a regular file\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (clp->fan_num > 0) {
+        if ((clp->elems > 1) || clp->rdprotect || clp->wrprotect ||
+            rsm_f[0]) {
+            pr2serr("%smore than one 'of=' does not work with elems=, "
+                    "protect= or resume=\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if (FT_SG != clp->out_type) {
+            pr2serr("%swith more than one 'of=' each OFILE must be a sg "
+                    "device\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        for (k = 0; k < clp->fan_num; ++k) {
+            struct fan_target * tp = clp->fan + k;
+
+            if (FT_SG != sg_io_filetype(tp->fname, 0, clp->debug)) {
+                pr2serr("%swith more than one 'of=' each OFILE must be a sg "
+                        "device, %s is not\n", my_name, tp->fname);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            tp->outfd = sg_io_open_dd(tp->fname, FT_SG, true,
+                                      open_fl_mask(&clp->out_flags), 0,
+                                      clp->bs, my_name, 0);
+            if (tp->outfd < 0)
+                return sg_convert_errno(-tp->outfd);
+            if (sg_prepare(tp->outfd, clp->bs, clp->bpt))
+                return SG_LIB_FILE_ERROR;
+        }
+    }
+    if (clp->out_flags.zbc && (FT_SG != clp->out_type)) {
+        pr2serr("%soflag=zbc needs OFILE to be a sg device\n", my_name);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (clp->out_flags.sparse) {
+        struct stat st;
+
+        /* bypassing a chunk needs the block address or lseek() */
+        if ((FT_OTHER == clp->out_type) &&
+            ((fstat(clp->outfd, &st) < 0) || (! S_ISREG(st.st_mode)))) {
+            pr2serr("%soflag=sparse needs OFILE to be a sg, block or raw "
+                    "device or a regular file\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (FT_SG == clp->out_type)
+            probe_out_dealloc(clp);
+    }
+    if (clp->rdprotect || clp->wrprotect) {
+        if ((clp->rdprotect && (FT_SG != clp->in_type)) ||
+            (clp->wrprotect && (FT_SG != clp->out_type))) {
+            pr2serr("%sprotect=RDP,WRP: RDP>0 needs a sg IFILE and WRP>0 "
+                    "a sg OFILE\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if (clp->out_flags.sparse || dgst_f[0] || clp->in_flags.coe) {
+            pr2serr("%sprotect= does not work with digest=, iflag=coe or "
+                    "oflag=sparse\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if ((clp->rdprotect && (6 == clp->cdbsz_in)) ||
+            (clp->wrprotect && (6 == clp->cdbsz_out))) {
+            pr2serr("%sprotect= needs cdbsz=10, 12 or 16\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if ((clp->rdprotect &&
+             (res = read_pi_type(clp->infd, inf, &clp->in_pi_type))) ||
+            (clp->wrprotect &&
+             (res = read_pi_type(clp->outfd, outf, &clp->out_pi_type))))
+            return res;
+        if ((clp->rdprotect && (0 == clp->in_pi_type)) ||
+            (clp->wrprotect && (0 == clp->out_pi_type))) {
+            pr2serr("%sprotect= given but %s not formatted with protection "
+                    "information\n", my_name, (clp->rdprotect &&
+                    (0 == clp->in_pi_type)) ? inf : outf);
+            return SG_LIB_CONTRADICT;
+        }
+        if ((2 == clp->in_pi_type) || (2 == clp->out_pi_type)) {
+            pr2serr("%sprotect=: PI type 2 needs 32 byte cdbs, not "
+                    "supported\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    if (do_verify) {
+        if ('\0' == dgst_f[0]) {
+            pr2serr("%sverify=1 needs digest=MFILE\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if ((STDOUT_FILENO == clp->outfd) ||
+            (FT_DEV_NULL == clp->out_type)) {
+            pr2serr("%sverify=1 needs an OFILE that can be read back\n",
+                    my_name);
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    if ((rate_lat_us > 0) && (0 == rate_bps) && (0 == rate_iops)) {
+        pr2serr("%srate_lat= needs rate= or iops=\n", my_name);
+        return SG_LIB_CONTRADICT;
+    }
+    if (rsm_f[0] && (dgst_f[0] || clp->out_flags.append)) {
+        pr2serr("%sresume= does not work with digest= or oflag=append\n",
+                my_name);
+        return SG_LIB_CONTRADICT;
+    }
+    if (dgst_f[0]) {
+        if (NULL == (clp->dgst_fp = fopen(dgst_f, "w"))) {
+            snprintf(ebuff, EBUFF_SZ, "%scould not open %s for digests",
+                     my_name, dgst_f);
+            perror(ebuff);
+            return SG_LIB_FILE_ERROR;
+        }
+        fprintf(clp->dgst_fp, "# sgp_dd CRC32C digest manifest: of=%s "
+                "bs=%d\n# OFILE_lba blocks crc32c\n", outf, clp->bs);
+    }
+    if (clp->reorder > 0) {
+        struct stat st;
+
+        /* writes out of order need the block address or pwrite() */
+        if ((FT_OTHER == clp->out_type) &&
+            ((fstat(clp->outfd, &st) < 0) || (! S_ISREG(st.st_mode)))) {
+            pr2serr("%sreorder= needs OFILE to be a sg, block or raw "
+                    "device or a regular file\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (clp->out_flags.append) {
+            pr2serr("Can't use both append and reorder= switches\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
     if (dd_count < 0) {
         in_num_sect = -1;
-        if (FT_SG == clp->in_type) {
-            res = scsi_read_capacity(clp->infd, &in_num_sect, &in_sect_sz);
+        if (clp->in_stripe.num > 0) {
+            if (stripe_capacity(clp, &clp->in_stripe, &in_num_sect))
+                in_num_sect = -1;
+        } else if (FT_SG == clp->in_type) {
+            res = sg_io_read_capacity(&clp->in_ds, &in_num_sect,
+                                      &in_sect_sz, 0);
             if (2 == res) {
                 pr2serr("Unit attention, media changed(in), continuing\n");
-                res = scsi_read_capacity(clp->infd, &in_num_sect,
-                                         &in_sect_sz);
+                res = sg_io_read_capacity(&clp->in_ds, &in_num_sect,
+                                          &in_sect_sz, 0);
             }
             if (0 != res) {
                 if (res == SG_LIB_CAT_INVALID_OP)
@@ -1611,8 +5600,8 @@ main(int argc, char * argv[])
                 in_num_sect = -1;
             }
         } else if (FT_BLOCK == clp->in_type) {
-            if (0 != read_blkdev_capacity(clp->infd, &in_num_sect,
-                                          &in_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(clp->infd, &in_num_sect,
+                                           &in_sect_sz, 0)) {
                 pr2serr("Unable to read block capacity on %s\n", inf);
                 in_num_sect = -1;
             }
@@ -1626,12 +5615,16 @@ main(int argc, char * argv[])
             in_num_sect -= skip;
 
         out_num_sect = -1;
-        if (FT_SG == clp->out_type) {
-            res = scsi_read_capacity(clp->outfd, &out_num_sect, &out_sect_sz);
+        if (clp->out_stripe.num > 0) {
+            if (stripe_capacity(clp, &clp->out_stripe, &out_num_sect))
+                out_num_sect = -1;
+        } else if (FT_SG == clp->out_type) {
+            res = sg_io_read_capacity(&clp->out_ds, &out_num_sect,
+                                      &out_sect_sz, 0);
             if (2 == res) {
                 pr2serr("Unit attention, media changed(out), continuing\n");
-                res = scsi_read_capacity(clp->outfd, &out_num_sect,
-                                         &out_sect_sz);
+                res = sg_io_read_capacity(&clp->out_ds, &out_num_sect,
+                                          &out_sect_sz, 0);
             }
             if (0 != res) {
                 if (res == SG_LIB_CAT_INVALID_OP)
@@ -1643,8 +5636,8 @@ main(int argc, char * argv[])
                 out_num_sect = -1;
             }
         } else if (FT_BLOCK == clp->out_type) {
-            if (0 != read_blkdev_capacity(clp->outfd, &out_num_sect,
-                                          &out_sect_sz)) {
+            if (0 != sg_io_blkdev_capacity(clp->outfd, &out_num_sect,
+                                           &out_sect_sz, 0)) {
                 pr2serr("Unable to read block capacity on %s\n", outf);
                 out_num_sect = -1;
             }
@@ -1675,6 +5668,57 @@ main(int argc, char * argv[])
         pr2serr("Couldn't calculate count, please give one\n");
         return SG_LIB_CAT_OTHER;
     }
+    if ((PAT_SEQ != clp->pattern) || (clp->mix >= 0)) {
+        if (! (((FT_SG | FT_DEV_NULL) & clp->in_type) &&
+               ((FT_SG | FT_DEV_NULL) & clp->out_type))) {
+            pr2serr("%spattern= and mix= need IFILE and OFILE to each be a "
+                    "sg device or\n/dev/null\n", my_name);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (PAT_SEQ != clp->pattern) {
+            /* random chunks are whole, so the range is too */
+            if (dd_count < clp->bpt) {
+                pr2serr("%spattern=%s needs a count of at least BPT (%d) "
+                        "blocks\n", my_name, (PAT_RAND == clp->pattern) ?
+                        "rand" : "zipf", clp->bpt);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            if (dd_count % clp->bpt) {
+                if (clp->debug)
+                    pr2serr("count reduced to a multiple of BPT: %" PRId64
+                            "\n", dd_count - (dd_count % clp->bpt));
+                dd_count -= (dd_count % clp->bpt);
+            }
+        }
+        clp->wl_chunks = (dd_count + clp->bpt - 1) / clp->bpt;
+        if (PAT_ZIPF == clp->pattern)
+            zipf_init(&clp->zipf, clp->wl_chunks, theta);
+        if (clp->debug) {
+            if (PAT_ZIPF == clp->pattern)
+                pr2serr("pattern=zipf,%g", theta);
+            else
+                pr2serr("pattern=%s", (PAT_RAND == clp->pattern) ? "rand" :
+                                                                   "seq");
+            pr2serr(" seed=%" PRIu64 " chunks=%" PRId64 " mix=%d\n",
+                    clp->seed, clp->wl_chunks, clp->mix);
+        }
+    }
+    if (streams_req > 0) {
+        if ((FT_SG != clp->out_type) || (clp->out_stripe.num > 0)) {
+            pr2serr("%sstreams= needs a single sg OFILE\n", my_name);
+            return SG_LIB_CONTRADICT;
+        }
+        if (clp->bpt > USHRT_MAX) {
+            pr2serr("%sstreams=: WRITE STREAM(16) takes at most %d blocks, "
+                    "lower bpt=\n", my_name, USHRT_MAX);
+            return SG_LIB_CONTRADICT;
+        }
+        if (streams_req > num_threads) {
+            pr2serr("%sstreams=: only %d worker threads, opening that many "
+                    "streams\n", my_name, num_threads);
+            streams_req = num_threads;
+        }
+    }
     if (! cdbsz_given) {
         if ((FT_SG == clp->in_type) && (MAX_SCSI_CDBSZ != clp->cdbsz_in) &&
             (((dd_count + skip) > UINT_MAX) || (clp->bpt > USHRT_MAX))) {
@@ -1690,27 +5734,91 @@ main(int argc, char * argv[])
         }
     }
 
-    clp->in_count = dd_count;
+    for (k = 0; k < clp->fan_num; ++k) {
+        int64_t num_sect;
+        int sect_sz;
+        const char * fnp = clp->fan[k].fname;
+        struct sg_dev_sess ds;
+
+        sg_ds_init(&ds, clp->fan[k].outfd, 0);
+        res = sg_io_read_capacity(&ds, &num_sect, &sect_sz, 0);
+        if (2 == res)
+            res = sg_io_read_capacity(&ds, &num_sect, &sect_sz, 0);
+        if (0 != res)
+            pr2serr("Unable to read capacity on %s\n", fnp);
+        else if (sect_sz != clp->bs) {
+            pr2serr("logical block size on %s confusion: bs=%d, from "
+                    "device=%d\n", fnp, clp->bs, sect_sz);
+            return SG_LIB_CONTRADICT;
+        } else if ((seek + dd_count) > num_sect) {
+            pr2serr("%s has %" PRId64 " blocks, too few for seek=%" PRId64
+                    " count=%" PRId64 "\n", fnp, num_sect, seek, dd_count);
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+
+    clp->in_total = dd_count;
     clp->in_rem_count = dd_count;
     clp->skip = skip;
-    clp->in_blk = skip;
     clp->out_count = dd_count;
     clp->out_rem_count = dd_count;
     clp->seek = seek;
     clp->out_blk = seek;
+    if (clp->reorder > 0) {
+        clp->ro_done = (int *)calloc(clp->reorder, sizeof(int));
+        if (NULL == clp->ro_done)
+            err_exit(ENOMEM, "out of memory for reorder window");
+    }
+    if (clp->out_flags.zbc && (dd_count > 0) &&
+        (res = zbc_probe(clp, outf, dd_count)))
+        return res;
     status = pthread_mutex_init(&clp->in_mutex, NULL);
     if (0 != status) err_exit(status, "init in_mutex");
     status = pthread_mutex_init(&clp->out_mutex, NULL);
     if (0 != status) err_exit(status, "init out_mutex");
     status = pthread_mutex_init(&clp->aux_mutex, NULL);
     if (0 != status) err_exit(status, "init aux_mutex");
+    /* worker threads (and those writing to the extra of=) */
+    clp->thr_st_num = num_threads * MAX_FAN_OUT;
+    if (posix_memalign((void **)&clp->thr_st, SGP_CACHE_LINE,
+                       clp->thr_st_num * sizeof(struct thr_stats)))
+        err_exit(ENOMEM, "out of memory for thread statistics");
+    memset(clp->thr_st, 0, clp->thr_st_num * sizeof(struct thr_stats));
     status = pthread_cond_init(&clp->out_sync_cv, NULL);
     if (0 != status) err_exit(status, "init out_sync_cv");
+    clp->rate_active = (rate_bps > 0) || (rate_iops > 0);
+    if (clp->rate_active)
+        sg_pt_rate_init(&clp->rate, (uint64_t)rate_bps, (uint64_t)rate_iops,
+                        (uint64_t)rate_lat_us * 1000);
+    qd_init(&clp->in_qd, (qd_lat_us >= 0) && (FT_SG == clp->in_type),
+            num_threads * clp->elems);
+    qd_init(&clp->out_qd, (qd_lat_us >= 0) && (FT_SG == clp->out_type),
+            num_threads);
 
     if (clp->dry_run > 0) {
         pr2serr("Due to --dry-run option, bypass copy/read\n");
         goto fini;
     }
+    if (rsm_f[0]) {
+        res = resume_open(&clp->rsm, rsm_f, skip, seek, dd_count, clp->bs,
+                          clp->bpt);
+        if (res)
+            return res;
+        if (clp->rsm.done_at_start > 0)
+            pr2serr("resume: %" PRId64 " of %" PRId64 " chunks copied "
+                    "before, bypassing them\n", clp->rsm.done_at_start,
+                    clp->rsm.chunks);
+    }
+    lat_table = sg_pt_lat_is_enabled();
+    if (progress_sec > 0) {
+        res = sg_io_progress_open(&progress, "sgp_dd", progress_sec, prog_f,
+                                  clp->bs, dd_count, my_name);
+        if (res)
+            return res;
+    }
+    if ((streams_req > 0) && (clp->out_rem_count > 0) &&
+        (res = streams_open(clp, streams_req)))
+        return res;
     sigemptyset(&signal_set);
     sigaddset(&signal_set, SIGINT);
     status = pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
@@ -1724,13 +5832,36 @@ main(int argc, char * argv[])
         start_tm.tv_usec = 0;
         gettimeofday(&start_tm, NULL);
     }
+    if (clp->debug && (0 == sg_log_ring_enable(LOG_RING_SZ))) {
+        status = pthread_create(&log_thread_id, NULL, log_drain_thread,
+                                (void *)clp);
+        if (0 != status) err_exit(status, "pthread_create, log...");
+        log_thread_started = true;
+        atexit(log_ring_atexit);
+    }
+    if (progress.fp) {
+        progress.xfers = (dd_count - clp->out_rem_count) / clp->bpt;
+        sg_io_progress_start(&progress, dd_count - clp->out_rem_count);
+        status = pthread_create(&progress_thread_id, NULL, progress_thread,
+                                (void *)clp);
+        if (0 != status) err_exit(status, "pthread_create, progress...");
+    }
+
+    if (clp->fan_num > 0)
+        fan_start(clp, num_threads);
 
 /* vvvvvvvvvvv  Start worker threads  vvvvvvvvvvvvvvvvvvvvvvvv */
+    if (clp->wl_chunks > 0)         /* pattern= or mix= given */
+        worker_fn = workload_thread;
+    else if (clp->elems > 1)
+        worker_fn = read_write_elems_thread;
+    else
+        worker_fn = read_write_thread;
     if ((clp->out_rem_count > 0) && (num_threads > 0)) {
         /* Run 1 work thread to shake down infant retryable stuff */
         status = pthread_mutex_lock(&clp->out_mutex);
         if (0 != status) err_exit(status, "lock out_mutex");
-        status = pthread_create(&threads[0], NULL, read_write_thread,
+        status = pthread_create(&threads[0], NULL, worker_fn,
                                 (void *)clp);
         if (0 != status) err_exit(status, "pthread_create");
         if (clp->debug)
@@ -1746,7 +5877,7 @@ main(int argc, char * argv[])
 
         /* now start the rest of the threads */
         for (k = 1; k < num_threads; ++k) {
-            status = pthread_create(&threads[k], NULL, read_write_thread,
+            status = pthread_create(&threads[k], NULL, worker_fn,
                                     (void *)clp);
             if (0 != status) err_exit(status, "pthread_create");
             if (clp->debug)
@@ -1761,10 +5892,34 @@ main(int argc, char * argv[])
                 pr2serr("Worker thread k=%d terminated\n", k);
         }
     }   /* started worker threads and here after they have all exited */
+    if (clp->fan_num > 0)
+        fan_finish(clp, num_threads);
+    if (log_thread_started) {
+        log_drain_stop = true;
+        status = pthread_join(log_thread_id, &vp);
+        if (0 != status) err_exit(status, "pthread_join, log...");
+        sg_log_ring_enable(0);  /* final drain, back to stdio */
+        log_thread_started = false;
+    }
+    if (progress.fp) {
+        status = pthread_mutex_lock(&progress_mutex);
+        if (0 != status) err_exit(status, "lock progress_mutex");
+        progress_stop = true;
+        pthread_cond_signal(&progress_cv);
+        status = pthread_mutex_unlock(&progress_mutex);
+        if (0 != status) err_exit(status, "unlock progress_mutex");
+        status = pthread_join(progress_thread_id, &vp);
+        if (0 != status) err_exit(status, "pthread_join, progress...");
+        progress_out(clp, true);
+        sg_io_progress_close(&progress);
+    }
 
     if (do_time && (start_tm.tv_sec || start_tm.tv_usec))
         calc_duration_throughput(0);
 
+    if (clp->out_flags.zfinish && (exit_status <= 0) &&
+        (0 == clp->out_count) && (res = zbc_finish(clp)))
+        exit_status = res;
     if (do_sync) {
         if (FT_SG == clp->out_type) {
             pr2serr(">> Synchronizing cache on %s\n", outf);
@@ -1777,6 +5932,62 @@ main(int argc, char * argv[])
             if (0 != res)
                 pr2serr("Unable to synchronize cache\n");
         }
+        for (k = 1; k < clp->out_stripe.num; ++k) {
+            pr2serr(">> Synchronizing cache on %s\n",
+                    clp->out_stripe.fname[k]);
+            res = sg_ll_sync_cache_10(clp->out_stripe.fd[k], 0, 0, 0, 0, 0,
+                                      false, 0);
+            if (SG_LIB_CAT_UNIT_ATTENTION == res)
+                res = sg_ll_sync_cache_10(clp->out_stripe.fd[k], 0, 0, 0, 0,
+                                          0, false, 0);
+            if (0 != res)
+                pr2serr("Unable to synchronize cache\n");
+        }
+        for (k = 0; k < clp->fan_num; ++k) {
+            pr2serr(">> Synchronizing cache on %s\n", clp->fan[k].fname);
+            res = sg_ll_sync_cache_10(clp->fan[k].outfd, 0, 0, 0, 0, 0,
+                                      false, 0);
+            if (SG_LIB_CAT_UNIT_ATTENTION == res)
+                res = sg_ll_sync_cache_10(clp->fan[k].outfd, 0, 0, 0, 0, 0,
+                                          false, 0);
+            if (0 != res)
+                pr2serr("Unable to synchronize cache\n");
+        }
+    }
+    if ((clp->num_streams > 0) && (res = streams_close(clp)) &&
+        (exit_status <= 0))
+        exit_status = res;
+    if (resume_close(&clp->rsm) && (exit_status <= 0))
+        exit_status = SG_LIB_FILE_ERROR;
+    if (clp->dgst_fp) {
+        if (fclose(clp->dgst_fp)) {
+            perror("sgp_dd: closing digest manifest");
+            if (exit_status <= 0)
+                exit_status = SG_LIB_FILE_ERROR;
+        }
+        clp->dgst_fp = NULL;
+    }
+    if (do_verify && (exit_status <= 0) && (0 == clp->out_count)) {
+        int vfd = clp->outfd;
+
+        if (FT_SG != clp->out_type) {
+            /* try to bypass the page cache of block devices */
+            flags = (clp->out_flags.direct || (FT_BLOCK == clp->out_type)) ?
+                    O_DIRECT : 0;
+            if ((vfd = open(outf, O_RDONLY | flags)) < 0) {
+                snprintf(ebuff, EBUFF_SZ, "%scould not open %s to verify",
+                         my_name, outf);
+                perror(ebuff);
+                exit_status = SG_LIB_FILE_ERROR;
+            }
+        }
+        if (vfd >= 0) {
+            res = verify_digests(clp, dgst_f, vfd);
+            if (res)
+                exit_status = res;
+            if (vfd != clp->outfd)
+                close(vfd);
+        }
     }
 
 #if 0
@@ -1798,10 +6009,27 @@ main(int argc, char * argv[])
      * _join() to clear heap taken by associated _create() */
 
 fini:
+    if (clp->dgst_fp)
+        fclose(clp->dgst_fp);
+    sg_hugebuf_pool_free();
     if (STDIN_FILENO != clp->infd)
         close(clp->infd);
     if ((STDOUT_FILENO != clp->outfd) && (FT_DEV_NULL != clp->out_type))
         close(clp->outfd);
+    for (k = 0; k < clp->fan_num; ++k) {
+        if (clp->fan[k].outfd > 0)
+            close(clp->fan[k].outfd);
+    }
+    for (k = 1; k < clp->in_stripe.num; ++k) {
+        if (clp->in_stripe.fd[k] > 0)
+            close(clp->in_stripe.fd[k]);
+    }
+    for (k = 1; k < clp->out_stripe.num; ++k) {
+        if (clp->out_stripe.fd[k] > 0)
+            close(clp->out_stripe.fd[k]);
+    }
+    mpath_close(clp, &clp->in_mpath, "IFILE");
+    mpath_close(clp, &clp->out_mpath, "OFILE");
     res = exit_status;
     if ((0 != clp->out_count) && (0 == clp->dry_run)) {
         pr2serr(">>>> Some error occurred, remaining blocks=%" PRId64 "\n",
@@ -1809,24 +6037,62 @@ fini:
         if (0 == res)
             res = SG_LIB_CAT_OTHER;
     }
-    print_stats("");
-    if (clp->dio_incomplete_count) {
-        int fd;
-        char c;
-
-        pr2serr(">> Direct IO requested but incomplete %d times\n",
-                clp->dio_incomplete_count);
-        if ((fd = open(proc_allow_dio, O_RDONLY)) >= 0) {
-            if (1 == read(fd, &c, 1)) {
-                if ('0' == c)
-                    pr2serr(">>> %s set to '0' but should be set to '1' for "
-                            "direct IO\n", proc_allow_dio);
-            }
-            close(fd);
+    if ((clp->reorder > 0) && (clp->out_blk < (clp->seek + dd_count)) &&
+        (0 == clp->dry_run)) {
+        int64_t done = clp->out_blk - clp->seek;
+
+        /* all blocks before out_blk have been written, maybe some after */
+        pr2serr(">> to resume copy use: skip=%" PRId64 " seek=%" PRId64
+                " count=%" PRId64 "\n", clp->skip + done, clp->out_blk,
+                dd_count - done);
+    }
+    if ((clp->zbc.num > 0) && (0 != clp->out_count) &&
+        (0 == clp->dry_run)) {
+        const struct zbc_zone * zp = clp->zbc.zp;
+
+        /* zones are written in order, later ones are reset when resumed */
+        for (k = 0; (k < clp->zbc.num - 1) &&
+                    (zp[k].wp >= (zp[k].start + zp[k].len)); ++k)
+            ;
+        if (zp[k].wp < (clp->seek + dd_count)) {
+            int64_t done = zp[k].wp - clp->seek;
+
+            pr2serr(">> to resume copy use: skip=%" PRId64 " seek=%" PRId64
+                    " count=%" PRId64 "\n", clp->skip + done, zp[k].wp,
+                    dd_count - done);
         }
     }
-    if (clp->sum_of_resids)
-        pr2serr(">> Non-zero sum of residual counts=%d\n",
-               clp->sum_of_resids);
+    free(clp->ro_done);
+    free(clp->zbc.zp);
+    print_stats("");
+    for (k = 0; (k < clp->fan_num) && (0 == clp->dry_run); ++k) {
+        pr2serr("%" PRId64 "+0 records out to %s\n", clp->fan[k].out_blks,
+                clp->fan[k].fname);
+        if ((0 == res) && (clp->fan[k].out_blks != dd_count))
+            res = SG_LIB_CAT_OTHER;
+    }
+    if (clp->fan_waits)
+        pr2serr("of= fan-out: workers waited %" PRId64 " times on the slowest "
+                "OFILE\n", clp->fan_waits);
+    qd_report("in: ", &clp->in_qd);
+    qd_report("out: ", &clp->out_qd);
+    rate_report(clp);
+    if (lat_table) {
+        char b[4096];
+
+        sg_pt_lat_report(sizeof(b), b);
+        pr2serr("%s", b);
+    }
+    stats_report(clp);
+    stats_sum(clp, t);
+    if (t[TS_DIO_INCOMPLETE]) {
+        pr2serr(">> Direct IO requested but incomplete %" PRId64 " times\n",
+                t[TS_DIO_INCOMPLETE]);
+        sg_io_dio_warn();
+    }
+    if (t[TS_RESIDS])
+        pr2serr(">> Non-zero sum of residual counts=%" PRId64 "\n",
+               t[TS_RESIDS]);
+    free(clp->thr_st);
     return (res >= 0) ? res : SG_LIB_CAT_OTHER;
 }
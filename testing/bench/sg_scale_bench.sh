@@ -0,0 +1,240 @@
+#!/bin/bash
+
+###################################################################
+#
+#  Concurrency scaling benchmark of the sg3_utils copy engines and
+#  pass-through test programs, run against the scsi_debug module.
+#
+#  Loads scsi_debug with the given delay and queue depth (two LUNs:
+#  the first is the source, the second the destination of copies),
+#  then runs each scenario for each block size and thread count.
+#  One CSV line is output per run:
+#    scenario,threads,bs,ops,bytes,secs,mb_per_sec,iops,cpu_secs,
+#    cpu_secs_per_gb,rc
+#  where cpu_secs is user plus system time of the scenario's process.
+#
+#  Needs root (modprobe and the sg devices). Must not be run while
+#  scsi_debug is loaded for another purpose unless -D is given.
+#
+##################################################################
+
+bs_list="4096 65536 1048576"
+thr_list="1 2 4 8 16 32 64"
+scenarios="sg_dd,sgm_dd,sgp_dd,sgh_dd,sg_xcopy,sg_bench,sg_tst_async,sg_tst_context,sg_tst_excl"
+copy_mb=64
+loops=1000
+delay=0
+ndelay=""
+qd=192
+keep=""
+out=""
+verbose=0
+devs=""
+here=$(cd "$(dirname "$0")" && pwd)
+bin_dir="${here}/../../src"
+tst_dir="${here}/.."
+loaded=""
+
+usage()
+{
+  echo "Usage: sg_scale_bench.sh [-b BS_LIST] [-B DIR] [-c MB] [-d DELAY]"
+  echo "                         [-D DEV,DEV] [-h] [-k] [-l LOOPS] [-N NDELAY]"
+  echo "                         [-o FILE] [-q QD] [-s SCEN,...] [-t THR_LIST]"
+  echo "                         [-T DIR] [-v]"
+  echo "  where:"
+  echo "    -b BS_LIST    bytes per command, quoted list (def: \"$bs_list\")"
+  echo "    -B DIR        directory of sg3_utils utilities (def: ../../src,"
+  echo "                  else PATH)"
+  echo "    -c MB         megabytes moved by each copy or read run (def: $copy_mb)"
+  echo "    -d DELAY      scsi_debug command delay in jiffies (def: $delay)"
+  echo "    -D DEV,DEV    use these two sg devices, do not load scsi_debug"
+  echo "    -h            print usage message then exit"
+  echo "    -k            keep scsi_debug loaded on exit (def: unload it)"
+  echo "    -l LOOPS      loops per thread of sg_tst_context and sg_tst_excl"
+  echo "                  (def: $loops)"
+  echo "    -N NDELAY     scsi_debug command delay in nanoseconds (overrides"
+  echo "                  -d)"
+  echo "    -o FILE       append CSV to FILE (def: stdout)"
+  echo "    -q QD         scsi_debug queue depth (max_queue) (def: $qd)"
+  echo "    -s SCEN,...   scenarios to run (def: all):"
+  echo "                  $scenarios"
+  echo "    -t THR_LIST   thread counts, quoted list (def: \"$thr_list\")"
+  echo "    -T DIR        directory of the built testing programs (def: ..)"
+  echo "    -v            increase verbosity (show each command line)"
+  echo ""
+  echo "Outputs one CSV line of throughput, IOPS and CPU per GB for each"
+  echo "scenario, block size and thread count"
+}
+
+while getopts "b:B:c:d:D:hkl:N:o:q:s:t:T:v" opt; do
+  case "$opt" in
+    b) bs_list="$OPTARG" ;;
+    B) bin_dir="$OPTARG" ;;
+    c) copy_mb="$OPTARG" ;;
+    d) delay="$OPTARG" ;;
+    D) devs="$OPTARG" ;;
+    h) usage ; exit 0 ;;
+    k) keep=1 ;;
+    l) loops="$OPTARG" ;;
+    N) ndelay="$OPTARG" ;;
+    o) out="$OPTARG" ;;
+    q) qd="$OPTARG" ;;
+    s) scenarios="$OPTARG" ;;
+    t) thr_list="$OPTARG" ;;
+    T) tst_dir="$OPTARG" ;;
+    v) verbose=$((verbose + 1)) ;;
+    *) usage ; exit 1 ;;
+  esac
+done
+
+# Finds a utility in bin_dir, then tst_dir, then PATH; empty if none
+find_prog()
+{
+  if [ -x "${bin_dir}/$1" ] ; then
+    echo "${bin_dir}/$1"
+  elif [ -x "${tst_dir}/$1" ] ; then
+    echo "${tst_dir}/$1"
+  else
+    command -v "$1"
+  fi
+}
+
+cleanup()
+{
+  if [ -n "$loaded" ] && [ -z "$keep" ] ; then
+    modprobe -r scsi_debug
+  fi
+}
+
+load_scsi_debug()
+{
+  local size_mb=$((copy_mb + 16))
+  local dly="delay=$delay"
+
+  if [ -d /sys/module/scsi_debug ] ; then
+    echo "scsi_debug already loaded, remove it or use -D" >&2
+    exit 1
+  fi
+  if [ -n "$ndelay" ] ; then
+    dly="ndelay=$ndelay"
+  fi
+  modprobe scsi_debug dev_size_mb=$size_mb num_tgts=1 max_luns=2 \
+           sector_size=512 max_queue=$qd $dly || exit 1
+  loaded=1
+  trap cleanup EXIT
+  udevadm settle 2> /dev/null
+  devs=""
+  for d in /sys/bus/pseudo/drivers/scsi_debug/adapter*/host*/target*/*/scsi_generic/sg* ; do
+    [ -e "$d" ] || continue
+    devs="${devs:+${devs},}/dev/$(basename "$d")"
+  done
+}
+
+# Outputs the user plus system CPU time, in clock ticks, of the waited
+# for children of this shell
+child_ticks()
+{
+  sed 's/^.*) //' /proc/$$/stat | awk '{print $14 + $15}'
+}
+
+# run_case SCENARIO THREADS BS OPS BYTES COMMAND...
+run_case()
+{
+  local scen=$1 thr=$2 bs=$3 ops=$4 bytes=$5
+  local t0 t1 c0 c1 rc
+
+  shift 5
+  if [ $verbose -gt 0 ] ; then
+    echo "$*" >&2
+  fi
+  c0=$(child_ticks)
+  t0=$(date +%s%N)
+  "$@" > /dev/null 2>&1
+  rc=$?
+  t1=$(date +%s%N)
+  c1=$(child_ticks)
+  awk -v s="$scen" -v t="$thr" -v b="$bs" -v o="$ops" -v by="$bytes" \
+      -v ns=$((t1 - t0)) -v ct=$((c1 - c0)) -v hz="$clk_tck" -v rc=$rc '
+    BEGIN {
+      secs = ns / 1e9; cpu = ct / hz
+      mbps = (secs > 0) ? by / secs / 1e6 : 0
+      iops = (secs > 0) ? o / secs : 0
+      cpg = (by > 0) ? sprintf("%.4f", cpu / (by / 1e9)) : ""
+      printf("%s,%d,%d,%d,%d,%.4f,%.2f,%.1f,%.3f,%s,%d\n", s, t, b, o, by,
+             secs, mbps, iops, cpu, cpg, rc)
+    }' >> "$csv"
+}
+
+# 'want SCEN' is true when SCEN is selected and its program exists
+want()
+{
+  case ",${scenarios}," in
+    *",$1,"*) ;;
+    *) return 1 ;;
+  esac
+  prog=$(find_prog "$1")
+  if [ -z "$prog" ] ; then
+    echo "$1 not found, skip" >&2
+    return 1
+  fi
+  return 0
+}
+
+if [ -z "$devs" ] ; then
+  load_scsi_debug
+fi
+src=${devs%%,*}
+dst=${devs#*,}
+if [ -z "$src" ] || [ "$src" = "$dst" ] ; then
+  echo "need two sg devices, found: \"$devs\"" >&2
+  exit 1
+fi
+clk_tck=$(getconf CLK_TCK)
+csv=${out:-/dev/stdout}
+bytes=$((copy_mb * 1000000))
+
+if [ -z "$out" ] || [ ! -s "$out" ] ; then
+  echo "scenario,threads,bs,ops,bytes,secs,mb_per_sec,iops,cpu_secs,cpu_secs_per_gb,rc" >> "$csv"
+fi
+
+for bs in $bs_list ; do
+  bpt=$((bs / 512))
+  blks=$((bytes / 512 / bpt * bpt))
+  nb=$((blks * 512))
+  ops=$((blks / bpt))
+  # single threaded copy engines, once per block size
+  for scen in sg_dd sgm_dd sg_xcopy ; do
+    want $scen || continue
+    run_case $scen 1 "$bs" $ops $nb "$prog" if="$src" of="$dst" bs=512 \
+             bpt=$bpt count=$blks
+  done
+  for thr in $thr_list ; do
+    for scen in sgp_dd sgh_dd ; do
+      want $scen || continue
+      run_case $scen "$thr" "$bs" $ops $nb "$prog" if="$src" of="$dst" \
+               bs=512 bpt=$bpt count=$blks thr="$thr"
+    done
+    if want sg_bench ; then
+      run_case sg_bench "$thr" "$bs" $ops $nb "$prog" --bs="$bs" \
+               --threads="$thr" --num=$ops --runtime=0 "$src"
+    fi
+    if want sg_tst_async ; then
+      n=$((ops / thr))
+      [ $n -gt 0 ] || n=1
+      run_case sg_tst_async "$thr" "$bs" $((n * thr)) $((n * thr * bs)) \
+               "$prog" --read --szlb=512,$bpt --tnum="$thr" --numpt=$n "$src"
+    fi
+  done
+done
+# open and context contention scenarios do not depend on the block size
+for thr in $thr_list ; do
+  if want sg_tst_context ; then
+    run_case sg_tst_context "$thr" 0 $((loops * thr)) 0 "$prog" -t "$thr" \
+             -n "$loops" "$src"
+  fi
+  if want sg_tst_excl ; then
+    run_case sg_tst_excl "$thr" 0 $((loops * thr)) 0 "$prog" -t "$thr" \
+             -n "$loops" "$src"
+  fi
+done
+exit 0
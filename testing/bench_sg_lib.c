@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+/*
+ * A utility program to time the sg_lib decode functions that the other
+ * utilities spend most of their (non I/O) time in: sense data, ASC/ASCQ
+ * and opcode names, designation descriptors, hex strings and number
+ * parsing. Inputs are built in samples plus any sense data or VPD pages
+ * given with --file= (e.g. examples/ref_sense.txt or inhex/vpd_dev_id.hex).
+ * For each function the time per call and, when built with
+ * BENCH_WRAP_MALLOC (see Makefile), the heap allocations per call made by
+ * the library are reported. Intended as a baseline to check optimizations
+ * of those functions against.
+ */
+
+static const char * version_str = "1.00 20261014";
+
+
+#define DEF_NUM_ITERS 100000
+#define MAX_FILES 32
+#define MAX_SAMPLES 64
+#define MAX_SAMPLE_LEN 1024
+#define OUT_BUFF_LEN 8192
+
+
+static struct option long_options[] = {
+        {"bench",  required_argument, 0, 'b'},
+        {"file",  required_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {"num",  required_argument, 0, 'n'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {0, 0, 0, 0},   /* sentinel */
+};
+
+struct sample_t {
+    int len;
+    uint8_t b[MAX_SAMPLE_LEN];
+};
+
+struct corpus_t {
+    int num_sense;
+    int num_desig;      /* designation descriptors, from VPD page 0x83 */
+    struct sample_t sense[MAX_SAMPLES];
+    struct sample_t desig[MAX_SAMPLES];
+};
+
+struct bench_t {
+    const char * name;
+    void (*fn)(const struct corpus_t * cop, int k, char * b);
+    int per_iter;       /* calls per iteration, set by setup */
+};
+
+static const uint8_t fixed_sense_medium[] = {   /* unrecovered read error */
+    0xf0, 0x0, 0x3, 0x0, 0x12, 0x34, 0x56, 0xa, 0x0, 0x0, 0x0, 0x0,
+    0x11, 0x0, 0x0, 0x0, 0x0, 0x0,
+};
+
+static const uint8_t fixed_sense_ill_req[] = { /* inv field in cdb, byte 2 */
+    0x70, 0x0, 0x5, 0x0, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x0,
+    0x24, 0x0, 0x0, 0xc0, 0x0, 0x2,
+};
+
+static const uint8_t fixed_sense_ua[] = {       /* power on or reset */
+    0x70, 0x0, 0x6, 0x0, 0x0, 0x0, 0x0, 0xa, 0x0, 0x0, 0x0, 0x0,
+    0x29, 0x0, 0x0, 0x0, 0x0, 0x0,
+};
+
+static const uint8_t desc_sense_progress[] = {  /* not ready, format */
+    0x72, 0x2, 0x4, 0x4, 0x0, 0x0, 0x0, 8,
+    0x2, 0x6, 0x0, 0x0, 0x80, 0x40, 0x0, 0x0,
+};
+
+static const uint8_t desc_sense_info[] = {      /* medium err + info */
+    0x72, 0x3, 0x11, 0x0, 0x0, 0x0, 0x0, 12 + 4,
+    0x0, 0xa, 0x80, 0x0, 0x0, 0x0, 0x0, 0x0, 0x12, 0x34, 0x56, 0x78,
+    0x3, 0x2, 0x0, 0x45,
+};
+
+static const uint8_t vpd_dev_id[] = {   /* SAS disk, as inhex/vpd_dev_id.hex */
+    0x00, 0x83, 0x00, 0x48, 0x01, 0x03, 0x00, 0x08,
+    0x50, 0x00, 0xc5, 0x00, 0x30, 0x11, 0xcb, 0x2b,
+    0x61, 0x93, 0x00, 0x08, 0x50, 0x00, 0xc5, 0x00,
+    0x30, 0x11, 0xcb, 0x29, 0x61, 0x94, 0x00, 0x04,
+    0x00, 0x00, 0x00, 0x01, 0x61, 0xa3, 0x00, 0x08,
+    0x50, 0x00, 0xc5, 0x00, 0x30, 0x11, 0xcb, 0x28,
+    0x03, 0x28, 0x00, 0x18, 0x6e, 0x61, 0x61, 0x2e,
+    0x35, 0x30, 0x30, 0x30, 0x43, 0x35, 0x30, 0x30,
+    0x33, 0x30, 0x31, 0x31, 0x43, 0x42, 0x32, 0x38,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+/* (ASC, ASCQ) pairs seen in practice, plus some at the ends of the table
+ * and in the vendor specific range */
+static const uint8_t asc_ascq_arr[][2] = {
+    {0x0, 0x0}, {0x4, 0x1}, {0x4, 0x2}, {0x4, 0x4}, {0x11, 0x0},
+    {0x20, 0x0}, {0x24, 0x0}, {0x25, 0x0}, {0x26, 0x0}, {0x28, 0x0},
+    {0x29, 0x0}, {0x2a, 0x1}, {0x2a, 0x9}, {0x3a, 0x0}, {0x3f, 0xe},
+    {0x5d, 0x10}, {0x5d, 0x72}, {0x0b, 0x1}, {0x67, 0xb}, {0x80, 0x1},
+};
+
+static const char * num_arr[] = {
+    "512", "4096", "4k", "64ki", "1m", "0x1000", "1000h", "2x512",
+    "123456789", "7K", "1g", "bad",
+};
+
+static int hex2str_len = 64;    /* bytes formatted per hex2str() call */
+static uint8_t hex_src[4096];
+
+#ifdef BENCH_WRAP_MALLOC
+/* Linked with -Wl,--wrap=malloc (etc) so these see every heap allocation
+ * made by the library objects (but not by libc itself). */
+static uint64_t alloc_count;
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t nmemb, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+    ++alloc_count;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+    ++alloc_count;
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void * ptr, size_t size)
+{
+    ++alloc_count;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+
+static void
+usage()
+{
+    pr2serr("Usage: bench_sg_lib [--bench=NAME] [--file=FN] [--help] "
+            "[--num=NUM]\n"
+            "                    [--verbose] [--version]\n"
+            "  where:\n"
+            "    --bench=NAME|-b NAME    only run benchmarks starting with "
+            "NAME\n"
+            "    --file=FN|-f FN    add sense data or a VPD page 0x83 in "
+            "ASCII hex\n"
+            "                       from FN to the corpus (may be given "
+            "up to %d times)\n"
+            "    --help|-h          print out usage message then exit\n"
+            "    --num=NUM|-n NUM    iterations of each benchmark (def: "
+            "%d)\n"
+            "    --verbose|-v       increase verbosity (e.g. show corpus)\n"
+            "    --version|-V       print version string and exit\n\n"
+            "Times sg_lib decode functions; reports nanoseconds and heap "
+            "allocations\nper call.\n", MAX_FILES, DEF_NUM_ITERS);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void
+add_sample(struct sample_t * arr, int * nump, const uint8_t * bp, int len)
+{
+    if ((*nump >= MAX_SAMPLES) || (len < 1))
+        return;
+    if (len > MAX_SAMPLE_LEN)
+        len = MAX_SAMPLE_LEN;
+    memcpy(arr[*nump].b, bp, len);
+    arr[*nump].len = len;
+    ++*nump;
+}
+
+/* Splits a Device Identification VPD page into its designation
+ * descriptors. */
+static void
+add_vpd_dev_id(struct corpus_t * cop, const uint8_t * bp, int len)
+{
+    int k, dlen;
+    int plen = ((bp[2] << 8) | bp[3]) + 4;
+
+    if (plen < len)
+        len = plen;
+    for (k = 4; (k + 4) <= len; k += dlen) {
+        dlen = bp[k + 3] + 4;
+        if ((k + dlen) > len)
+            break;
+        add_sample(cop->desig, &cop->num_desig, bp + k, dlen);
+    }
+}
+
+/* Sense data starts with response code 0x70 to 0x73, a VPD page 0x83
+ * has 0x83 in its second byte. Returns 0 on success. */
+static int
+add_file(struct corpus_t * cop, const char * fname, int verbose)
+{
+    int res, len;
+    uint8_t b[MAX_SAMPLE_LEN];
+
+    res = sg_f2hex_arr(fname, false, false, b, &len, sizeof(b));
+    if (res) {
+        pr2serr("unable to decode %s as ASCII hex, res=%d\n", fname, res);
+        return res;
+    }
+    if ((len >= 8) && (0x70 == (0x7c & b[0]))) {
+        add_sample(cop->sense, &cop->num_sense, b, len);
+        if (verbose)
+            pr2serr("%s: %d bytes of sense data\n", fname, len);
+    } else if ((len >= 8) && (0x83 == b[1])) {
+        add_vpd_dev_id(cop, b, len);
+        if (verbose)
+            pr2serr("%s: Device Identification VPD page\n", fname);
+    } else {
+        pr2serr("%s: neither sense data nor a VPD page 0x83\n", fname);
+        return SG_LIB_FILE_ERROR;
+    }
+    return 0;
+}
+
+static void
+bench_sense(const struct corpus_t * cop, int k, char * b)
+{
+    const struct sample_t * sp = cop->sense + (k % cop->num_sense);
+
+    sg_get_sense_str("  ", sp->b, sp->len, false, OUT_BUFF_LEN, b);
+}
+
+static void
+bench_asc_ascq(const struct corpus_t * cop, int k, char * b)
+{
+    const uint8_t * p = asc_ascq_arr[k % SG_ARRAY_SIZE(asc_ascq_arr)];
+
+    (void)cop;
+    sg_get_asc_ascq_str(p[0], p[1], OUT_BUFF_LEN, b);
+}
+
+static void
+bench_opcode(const struct corpus_t * cop, int k, char * b)
+{
+    (void)cop;
+    sg_get_opcode_name((uint8_t)k, 0 /* disk */, OUT_BUFF_LEN, b);
+}
+
+static void
+bench_desig(const struct corpus_t * cop, int k, char * b)
+{
+    const struct sample_t * sp = cop->desig + (k % cop->num_desig);
+
+    sg_get_designation_descriptor_str("  ", sp->b, sp->len, true, false,
+                                      OUT_BUFF_LEN, b);
+}
+
+static void
+bench_hex2str(const struct corpus_t * cop, int k, char * b)
+{
+    (void)cop;
+    (void)k;
+    hex2str(hex_src, hex2str_len, "  ", 1, OUT_BUFF_LEN, b);
+}
+
+static void
+bench_get_num(const struct corpus_t * cop, int k, char * b)
+{
+    (void)cop;
+    b[0] = (char)sg_get_num(num_arr[k % SG_ARRAY_SIZE(num_arr)]);
+}
+
+static struct bench_t bench_arr[] = {
+    {"sg_get_sense_str", bench_sense, 0},
+    {"sg_get_asc_ascq_str", bench_asc_ascq, 0},
+    {"sg_get_opcode_name", bench_opcode, 0},
+    {"sg_get_designation_descriptor_str", bench_desig, 0},
+    {"hex2str(64 bytes)", bench_hex2str, 0},
+    {"sg_get_num", bench_get_num, 0},
+    {NULL, NULL, 0},
+};
+
+/* Each iteration calls fn once for each sample in its corpus so all are
+ * weighted equally. Outputs one line. */
+static void
+run_bench(const struct bench_t * bp, const struct corpus_t * cop,
+          int num_iters, char * b)
+{
+    int j, k;
+    int n = bp->per_iter;
+    uint64_t t, calls;
+#ifdef BENCH_WRAP_MALLOC
+    uint64_t a0;
+#endif
+
+    for (k = 0; k < n; ++k)             /* warm up caches */
+        bp->fn(cop, k, b);
+#ifdef BENCH_WRAP_MALLOC
+    a0 = alloc_count;
+#endif
+    t = now_ns();
+    for (j = 0; j < num_iters; ++j) {
+        for (k = 0; k < n; ++k)
+            bp->fn(cop, k, b);
+    }
+    t = now_ns() - t;
+    calls = (uint64_t)num_iters * n;
+    printf("%-36s %12" PRIu64 " %10.1f", bp->name, calls,
+           (double)t / calls);
+#ifdef BENCH_WRAP_MALLOC
+    printf(" %12.3f\n", (double)(alloc_count - a0) / calls);
+#else
+    printf(" %12s\n", "n/a");
+#endif
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    int c, k, res;
+    int num_files = 0;
+    int num_iters = DEF_NUM_ITERS;
+    int verbose = 0;
+    const char * bench_name = NULL;
+    const char * file_arr[MAX_FILES];
+    struct bench_t * bp;
+    struct corpus_t * cop;
+    char * b;
+
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "b:f:hn:vV", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'b':
+            bench_name = optarg;
+            break;
+        case 'f':
+            if (num_files >= MAX_FILES) {
+                pr2serr("--file= given too often, max: %d\n", MAX_FILES);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            file_arr[num_files++] = optarg;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'n':
+            num_iters = sg_get_num(optarg);
+            if (num_iters < 1) {
+                pr2serr("--num= expects a positive number\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            ++verbose;
+            break;
+        case 'V':
+            pr2serr("version: %s\n", version_str);
+            return 0;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+
+    cop = (struct corpus_t *)calloc(1, sizeof(*cop));
+    b = (char *)malloc(OUT_BUFF_LEN);
+    if ((NULL == cop) || (NULL == b)) {
+        pr2serr("out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    add_sample(cop->sense, &cop->num_sense, fixed_sense_medium,
+               sizeof(fixed_sense_medium));
+    add_sample(cop->sense, &cop->num_sense, fixed_sense_ill_req,
+               sizeof(fixed_sense_ill_req));
+    add_sample(cop->sense, &cop->num_sense, fixed_sense_ua,
+               sizeof(fixed_sense_ua));
+    add_sample(cop->sense, &cop->num_sense, desc_sense_progress,
+               sizeof(desc_sense_progress));
+    add_sample(cop->sense, &cop->num_sense, desc_sense_info,
+               sizeof(desc_sense_info));
+    add_vpd_dev_id(cop, vpd_dev_id, sizeof(vpd_dev_id));
+    for (k = 0; k < num_files; ++k) {
+        res = add_file(cop, file_arr[k], verbose);
+        if (res)
+            return res;
+    }
+    for (k = 0; k < (int)sizeof(hex_src); ++k)
+        hex_src[k] = (uint8_t)(k * 7);
+    if (verbose)
+        pr2serr("corpus: %d sense buffers, %d designation descriptors\n",
+                cop->num_sense, cop->num_desig);
+
+    bench_arr[0].per_iter = cop->num_sense;
+    bench_arr[1].per_iter = SG_ARRAY_SIZE(asc_ascq_arr);
+    bench_arr[2].per_iter = 256;
+    bench_arr[3].per_iter = cop->num_desig;
+    bench_arr[4].per_iter = 1;
+    bench_arr[5].per_iter = SG_ARRAY_SIZE(num_arr);
+
+    printf("%-36s %12s %10s %12s\n", "function", "calls", "ns/call",
+           "allocs/call");
+    for (bp = bench_arr; bp->name; ++bp) {
+        if (bench_name && strncmp(bp->name, bench_name, strlen(bench_name)))
+            continue;
+        if (bp->per_iter > 0)
+            run_bench(bp, cop, num_iters, b);
+    }
+    free(b);
+    free(cop);
+    return 0;
+}
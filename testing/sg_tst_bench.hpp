@@ -0,0 +1,192 @@
+#ifndef SG_TST_BENCH_HPP
+#define SG_TST_BENCH_HPP
+
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Header only timing used by the '-B' (benchmark) option of sg_tst_context
+ * and the sg_tst_excl* programs in this directory. Each worker thread points
+ * sg_tst::cur_rec at its own bench_rec; the hooks below do nothing (not
+ * even read the clock) when it is null, so the tests run as before without
+ * '-B'. A loop is one iteration of a worker (for the sg_tst_excl* programs
+ * an open, several commands then a close). The workers' records are merged
+ * into a bench_run which is reported once all threads have joined. An
+ * uncontended baseline is taken by running a few loops in one thread before
+ * the others start; the difference from it is the latency added by
+ * contention (e.g. on the sg driver's per device locks). */
+
+#include <cstdint>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+namespace sg_tst {
+
+struct lat_samples {
+    std::vector<uint64_t> ns;
+
+    void add(uint64_t v) { ns.push_back(v); }
+    void merge(const lat_samples & o)
+        { ns.insert(ns.end(), o.ns.begin(), o.ns.end()); }
+    void sort() { std::sort(ns.begin(), ns.end()); }
+    double avg_us() const {
+        uint64_t sum = 0;
+
+        for (auto v : ns)
+            sum += v;
+        return ns.empty() ? 0.0 : (double)sum / ns.size() / 1000.0;
+    }
+    /* after sort(), p from 0 to 100 */
+    double pct_us(double p) const {
+        if (ns.empty())
+            return 0.0;
+        size_t k = (size_t)(p / 100.0 * (ns.size() - 1) + 0.5);
+
+        return ns[k] / 1000.0;
+    }
+};
+
+struct bench_rec {
+    lat_samples open;   /* includes the EBUSY (O_EXCL) retries */
+    lat_samples close;
+    lat_samples loop;
+    uint64_t cmds = 0;
+
+    void merge(const bench_rec & o) {
+        open.merge(o.open);
+        close.merge(o.close);
+        loop.merge(o.loop);
+        cmds += o.cmds;
+    }
+    void clear() { *this = bench_rec(); }
+};
+
+inline thread_local bench_rec * cur_rec = nullptr;
+
+/* Returns 0 when this thread is not benchmarking */
+inline uint64_t
+now_ns()
+{
+    if (nullptr == cur_rec)
+        return 0;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void
+open_done(uint64_t t0)
+{
+    if (cur_rec)
+        cur_rec->open.add(now_ns() - t0);
+}
+
+inline void
+close_done(uint64_t t0)
+{
+    if (cur_rec)
+        cur_rec->close.add(now_ns() - t0);
+}
+
+inline void
+loop_done(uint64_t t0)
+{
+    if (cur_rec)
+        cur_rec->loop.add(now_ns() - t0);
+}
+
+inline void
+add_cmds(int n)
+{
+    if (cur_rec)
+        cur_rec->cmds += n;
+}
+
+class bench_run {
+public:
+    /* Called by each worker after its last loop */
+    void merge(const bench_rec & r) {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        total.merge(r);
+    }
+    /* What has been merged so far becomes the uncontended baseline */
+    void take_baseline() {
+        base = total;
+        base.loop.sort();
+        total.clear();
+    }
+    void start() { t_start = std::chrono::steady_clock::now(); }
+    void stop() { t_stop = std::chrono::steady_clock::now(); }
+
+    /* Outputs to stdout, finishing with a single "BENCH:" line of
+     * name=value pairs for scripts. */
+    void report(int num_threads) {
+        double secs = std::chrono::duration<double>(t_stop - t_start).count();
+        size_t n_loops = total.loop.ns.size();
+        size_t n_opens = total.open.ns.size();
+        double loop_rate = (secs > 0) ? n_loops / secs : 0.0;
+        double oc_rate = (secs > 0) ? n_opens / secs : 0.0;
+        double cmd_rate = (secs > 0) ? total.cmds / secs : 0.0;
+        double added = 0.0;
+
+        total.open.sort();
+        total.close.sort();
+        total.loop.sort();
+        printf("Benchmark: %d threads, %zu loops in %.3f secs, %.1f loops "
+               "per sec\n", num_threads, n_loops, secs, loop_rate);
+        printf("  commands: %" PRIu64 ", %.1f per sec, %.1f per sec per "
+               "thread\n", total.cmds, cmd_rate,
+               (num_threads > 0) ? cmd_rate / num_threads : 0.0);
+        if (n_opens > 0) {
+            printf("  opens: %zu, %.1f open/close per sec\n", n_opens,
+                   oc_rate);
+            pr_lat("  open", total.open);
+            pr_lat("  close", total.close);
+        }
+        pr_lat("  loop", total.loop);
+        if (! base.loop.ns.empty()) {
+            added = total.loop.avg_us() - base.loop.avg_us();
+            printf("  uncontended loop (1 thread, %zu loops): avg=%.1f us; "
+                   "contention adds %.1f us (%.0f%%)\n", base.loop.ns.size(),
+                   base.loop.avg_us(), added, (base.loop.avg_us() > 0) ?
+                   100.0 * added / base.loop.avg_us() : 0.0);
+            if (! base.open.ns.empty())
+                printf("  uncontended open avg=%.1f us; contention adds "
+                       "%.1f us\n", base.open.avg_us(),
+                       total.open.avg_us() - base.open.avg_us());
+        }
+        printf("BENCH: threads=%d loops_per_sec=%.1f open_close_per_sec=%.1f "
+               "cmds_per_sec=%.1f loop_avg_us=%.1f loop_p99_us=%.1f "
+               "base_loop_avg_us=%.1f added_us=%.1f\n", num_threads,
+               loop_rate, oc_rate, cmd_rate, total.loop.avg_us(),
+               total.loop.pct_us(99), base.loop.avg_us(), added);
+    }
+
+private:
+    static void pr_lat(const char * leadin, const lat_samples & ls) {
+        if (ls.ns.empty())
+            return;
+        printf("%s latency (us): avg=%.1f p50=%.1f p99=%.1f max=%.1f\n",
+               leadin, ls.avg_us(), ls.pct_us(50), ls.pct_us(99),
+               ls.pct_us(100));
+    }
+
+    std::mutex mtx;
+    bench_rec total;
+    bench_rec base;
+    std::chrono::steady_clock::time_point t_start;
+    std::chrono::steady_clock::time_point t_stop;
+};
+
+}       /* namespace sg_tst */
+
+#endif  /* SG_TST_BENCH_HPP */
@@ -45,8 +45,10 @@
 #include <sys/stat.h>
 #include "sg_lib.h"
 #include "sg_pt.h"
+#include "sg_cdb.hpp"
+#include "sg_tst_bench.hpp"
 
-static const char * version_str = "1.04 20181207";
+static const char * version_str = "1.05 20261014";
 static const char * util_name = "sg_tst_context";
 
 /* This is a test program for checking that file handles keep their
@@ -81,6 +83,7 @@ using namespace std::chrono;
 
 #define DEF_NUM_PER_THREAD 200
 #define DEF_NUM_THREADS 2
+#define BENCH_BASE_LOOPS 50     /* for the uncontended baseline with -B */
 
 #define EBUFF_SZ 256
 
@@ -91,15 +94,20 @@ static unsigned int even_notreadys;
 static unsigned int odd_notreadys;
 static unsigned int ebusy_count;
 static int verbose;
+static sg_tst::bench_run brun;
 
 
 static void
 usage(void)
 {
-    printf("Usage: %s [-e] [-h] [-n <n_per_thr>] [-N] [-R] [-s]\n"
+    printf("Usage: %s [-B] [-e] [-h] [-n <n_per_thr>] [-N] [-R] [-s]\n"
            "                      [-t <num_thrs>] [-v] [-V] <disk_device>\n",
            util_name);
     printf("  where\n");
+    printf("    -B                benchmark: report open/close and command "
+           "rates, and\n"
+           "                      loop latency against an uncontended "
+           "baseline\n");
     printf("    -e                use O_EXCL on open (def: don't)\n");
     printf("    -h                print this usage message then exit\n");
     printf("    -n <n_per_thr>    number of loops per thread "
@@ -174,8 +182,6 @@ pt_cat_no_good(int cat, struct sg_pt_base * ptp, const unsigned char * sbp)
     return -EIO /* -5 */;
 }
 
-#define TUR_CMD_LEN 6
-#define SSU_CMD_LEN 6
 #define NOT_READY SG_LIB_CAT_NOT_READY
 
 /* Returns 0 for good, 1024 for a sense key of NOT_READY, or a negative
@@ -184,11 +190,11 @@ static int
 do_tur(struct sg_pt_base * ptp, int id)
 {
     int slen, res, cat;
-    unsigned char turCmdBlk [TUR_CMD_LEN] = {0x0, 0x0, 0x0, 0x0, 0x0, 0x0};
     unsigned char sense_buffer[64];
 
     clear_scsi_pt_obj(ptp);
-    set_scsi_pt_cdb(ptp, turCmdBlk, sizeof(turCmdBlk));
+    set_scsi_pt_cdb(ptp, sg::test_unit_ready_cdb.data(),
+                    sg::test_unit_ready_cdb.size);
     set_scsi_pt_sense(ptp, sense_buffer, sizeof(sense_buffer));
     res = do_scsi_pt(ptp, -1, 20 /* secs timeout */, verbose);
     if (res) {
@@ -229,13 +235,11 @@ static int
 do_ssu(struct sg_pt_base * ptp, int id, bool start)
 {
     int slen, res, cat;
-    unsigned char ssuCmdBlk [SSU_CMD_LEN] = {0x1b, 0x0, 0x0, 0x0, 0x0, 0x0};
+    const sg::cdb<6> & ssu = start ? sg::start_unit_cdb : sg::stop_unit_cdb;
     unsigned char sense_buffer[64];
 
-    if (start)
-        ssuCmdBlk[4] |= 0x1;
     clear_scsi_pt_obj(ptp);
-    set_scsi_pt_cdb(ptp, ssuCmdBlk, sizeof(ssuCmdBlk));
+    set_scsi_pt_cdb(ptp, ssu.data(), ssu.size);
     set_scsi_pt_sense(ptp, sense_buffer, sizeof(sense_buffer));
     res = do_scsi_pt(ptp, -1, 40 /* secs timeout */, verbose);
     if (res) {
@@ -272,15 +276,16 @@ err:
 
 static void
 work_thread(const char * dev_name, int id, int num, bool share,
-            int pt_fd, int nonblock, int oexcl, bool ready_after)
+            int pt_fd, int nonblock, int oexcl, bool ready_after, bool bench)
 {
     bool started = true;
     int k;
     int res = 0;
+    uint64_t t0;
+    sg_tst::bench_rec rec;
     unsigned int thr_even_notreadys = 0;
     unsigned int thr_odd_notreadys = 0;
     unsigned int thr_ebusy_count = 0;
-    struct sg_pt_base * ptp = NULL;
     char ebuff[EBUFF_SZ];
 
     {
@@ -289,6 +294,8 @@ work_thread(const char * dev_name, int id, int num, bool share,
         cerr << "Enter work_thread id=" << id << " num=" << num << " share="
              << share << endl;
     }
+    if (bench)
+        sg_tst::cur_rec = &rec;
     if (! share) {      /* ignore passed ptp, make this thread's own */
         int oflags = O_RDWR;
 
@@ -296,6 +303,7 @@ work_thread(const char * dev_name, int id, int num, bool share,
             oflags |= O_NONBLOCK;
         if (oexcl)
             oflags |= O_EXCL;
+        t0 = sg_tst::now_ns();
         while (((pt_fd = scsi_pt_open_flags(dev_name, oflags, verbose)) < 0)
                && (-EBUSY == pt_fd)) {
             ++thr_ebusy_count;
@@ -305,8 +313,10 @@ work_thread(const char * dev_name, int id, int num, bool share,
             snprintf(ebuff, EBUFF_SZ, "work_thread id=%d: error opening: %s",
                      id, dev_name);
             perror(ebuff);
+            sg_tst::cur_rec = nullptr;
             return;
         }
+        sg_tst::open_done(t0);
         if (thr_ebusy_count) {
             lock_guard<mutex> lg(count_mutex);
 
@@ -315,13 +325,17 @@ work_thread(const char * dev_name, int id, int num, bool share,
     }
     /* The instance of 'struct sg_pt_base' is local to this thread but the
      * pt_fd it contains may be shared, depending on the 'share' boolean. */
-    ptp = construct_scsi_pt_obj_with_fd(pt_fd, verbose);
-    if (NULL == ptp) {
+    sg::pt_obj pt(pt_fd, verbose);
+    struct sg_pt_base * ptp = pt.get();
+
+    if (! pt) {
         fprintf(stderr, "work_thread id=%d: "
                 "construct_scsi_pt_obj_with_fd() failed, memory?\n", id);
+        sg_tst::cur_rec = nullptr;
         return;
     }
     for (k = 0; k < num; ++k) {
+        t0 = sg_tst::now_ns();
         if (0 == (id % 2)) {
             /* Even thread ids do TEST UNIT READYs */
             res = do_tur(ptp, id);
@@ -339,15 +353,25 @@ work_thread(const char * dev_name, int id, int num, bool share,
                 res = 0;
             }
         }
+        sg_tst::add_cmds(1);
         if (res)
             break;
-        if (ready_after && (! started))
+        if (ready_after && (! started)) {
             do_ssu(ptp, id, true);
+            sg_tst::add_cmds(1);
+        }
+        sg_tst::loop_done(t0);
     }
-    if (ptp)
-        destruct_scsi_pt_obj(ptp);
-    if ((! share) && (pt_fd >= 0))
+    pt.reset();
+    if ((! share) && (pt_fd >= 0)) {
+        t0 = sg_tst::now_ns();
         close(pt_fd);
+        sg_tst::close_done(t0);
+    }
+    if (bench) {
+        brun.merge(rec);
+        sg_tst::cur_rec = nullptr;
+    }
 
     {
         lock_guard<mutex> lg(count_mutex);
@@ -379,12 +403,15 @@ main(int argc, char * argv[])
     int num_per_thread = DEF_NUM_PER_THREAD;
     bool ready_after = false;
     bool share = false;
+    bool bench = false;
     int num_threads = DEF_NUM_THREADS;
     char * dev_name = NULL;
     char ebuff[EBUFF_SZ];
 
     for (k = 1; k < argc; ++k) {
-        if (0 == memcmp("-e", argv[k], 2))
+        if (0 == memcmp("-B", argv[k], 2))
+            bench = true;
+        else if (0 == memcmp("-e", argv[k], 2))
             ++oexcl;
         else if (0 == memcmp("-h", argv[k], 2)) {
             usage();
@@ -458,17 +485,29 @@ main(int argc, char * argv[])
              * thread-safe without user space intervention (e.g. mutexes). */
         }
 
+        if (bench) {
+            /* uncontended baseline: a few TEST UNIT READYs (id 0) in this
+             * thread alone */
+            work_thread(dev_name, 0, (num_per_thread < BENCH_BASE_LOOPS) ?
+                        num_per_thread : BENCH_BASE_LOOPS, share, pt_fd,
+                        nonblock, oexcl, ready_after, true);
+            brun.take_baseline();
+            brun.start();
+        }
+
         vector<thread *> vt;
 
         for (k = 0; k < num_threads; ++k) {
             thread * tp = new thread {work_thread, dev_name, k,
                                       num_per_thread, share, pt_fd, nonblock,
-                                      oexcl, ready_after};
+                                      oexcl, ready_after, bench};
             vt.push_back(tp);
         }
 
         for (k = 0; k < (int)vt.size(); ++k)
             vt[k]->join();
+        if (bench)
+            brun.stop();
 
         for (k = 0; k < (int)vt.size(); ++k)
             delete vt[k];
@@ -482,6 +521,8 @@ main(int argc, char * argv[])
              << odd_notreadys << endl;
         if (ebusy_count)
             cout << "Number of EBUSYs (on open): " << ebusy_count << endl;
+        if (bench)
+            brun.report(num_threads);
 
     }
     catch(system_error& e)  {
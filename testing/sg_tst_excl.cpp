@@ -72,8 +72,9 @@
 #include "sg_lib.h"
 #include "sg_io_linux.h"
 #include "sg_unaligned.h"
+#include "sg_tst_bench.hpp"
 
-static const char * version_str = "1.11 20190121";
+static const char * version_str = "1.12 20261014";
 static const char * util_name = "sg_tst_excl";
 
 /* This is a test program for checking O_EXCL on open() works. It uses
@@ -121,6 +122,7 @@ using namespace std::chrono;
 
 
 #define DEF_LBA 1000
+#define BENCH_BASE_LOOPS 50     /* for the uncontended baseline with -B */
 
 #define EBUFF_SZ 256
 
@@ -130,18 +132,23 @@ static unsigned int odd_count;
 static unsigned int ebusy_count;
 static unsigned int eagain_count;
 static int sg_ifc_ver = 3;
+static sg_tst::bench_run brun;
 
 
 static void
 usage(void)
 {
-    printf("Usage: %s [-b] [-f] [-h] [-i <sg_ver>] [-l <lba>] "
+    printf("Usage: %s [-b] [-B] [-f] [-h] [-i <sg_ver>] [-l <lba>] "
            "[-n <n_per_thr>]\n"
            "                   [-t <num_thrs>] [-V] [-w <wait_ms>] "
            "[-x] [-xx]\n"
            "                   <sg_disk_device>\n", util_name);
     printf("  where\n");
     printf("    -b                block on open (def: O_NONBLOCK)\n");
+    printf("    -B                benchmark: report open/close and command "
+           "rates, and\n"
+           "                      loop latency against an uncontended "
+           "baseline\n");
     printf("    -f                force: any SCSI disk (def: only "
            "scsi_debug)\n");
     printf("                      WARNING: <lba> written to\n");
@@ -191,6 +198,7 @@ do_rd_inc_wr_twice_v3(const char * dev_name, unsigned int lba, int block,
     int k, sg_fd, ok, res;
     int odd = 0;
     unsigned int u = 0;
+    uint64_t t0;
     struct sg_io_hdr pt, pt2;
     unsigned char r16CmdBlk [READ16_CMD_LEN] =
                 {0x88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0};
@@ -208,6 +216,7 @@ do_rd_inc_wr_twice_v3(const char * dev_name, unsigned int lba, int block,
     if (excl)
         open_flags |= O_EXCL;
 
+    t0 = sg_tst::now_ns();
     while (((sg_fd = open(dev_name, open_flags)) < 0) &&
            (EBUSY == errno)) {
         ++ebusy;
@@ -224,6 +233,7 @@ do_rd_inc_wr_twice_v3(const char * dev_name, unsigned int lba, int block,
         perror(ebuff);
         return -1;
     }
+    sg_tst::open_done(t0);
 
     for (k = 0; k < 2; ++k) {
         /* Prepare READ_16 command */
@@ -415,7 +425,10 @@ do_rd_inc_wr_twice_v3(const char * dev_name, unsigned int lba, int block,
             return -1;
         }
     }
+    sg_tst::add_cmds(6);        /* two of: 2 READ_16s, 1 WRITE_16 */
+    t0 = sg_tst::now_ns();
     close(sg_fd);
+    sg_tst::close_done(t0);
     return odd;
 }
 
@@ -433,6 +446,7 @@ do_rd_inc_wr_twice_v4(const char * dev_name, unsigned int lba, int block,
     int k, sg_fd, ok, res;
     int odd = 0;
     unsigned int u = 0;
+    uint64_t t0;
     struct sg_io_v4 pt, pt2;
     unsigned char r16CmdBlk [READ16_CMD_LEN] =
                 {0x88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0};
@@ -450,6 +464,7 @@ do_rd_inc_wr_twice_v4(const char * dev_name, unsigned int lba, int block,
     if (excl)
         open_flags |= O_EXCL;
 
+    t0 = sg_tst::now_ns();
     while (((sg_fd = open(dev_name, open_flags)) < 0) &&
            (EBUSY == errno)) {
         ++ebusy;
@@ -466,6 +481,7 @@ do_rd_inc_wr_twice_v4(const char * dev_name, unsigned int lba, int block,
         perror(ebuff);
         return -1;
     }
+    sg_tst::open_done(t0);
 
     for (k = 0; k < 2; ++k) {
         /* Prepare READ_16 command */
@@ -672,7 +688,10 @@ do_rd_inc_wr_twice_v4(const char * dev_name, unsigned int lba, int block,
             return -1;
         }
     }
+    sg_tst::add_cmds(6);        /* two of: 2 READ_16s, 1 WRITE_16 */
+    t0 = sg_tst::now_ns();
     close(sg_fd);
+    sg_tst::close_done(t0);
     return odd;
 }
 
@@ -771,12 +790,17 @@ do_inquiry_prod_id(const char * dev_name, int block, int wait_ms,
 
 static void
 work_thread(const char * dev_name, unsigned int lba, int id, int block,
-            int excl, int num, int wait_ms)
+            int excl, int num, int wait_ms, bool bench)
 {
     unsigned int thr_odd_count = 0;
     unsigned int thr_ebusy_count = 0;
     unsigned int thr_eagain_count = 0;
     int k, res;
+    uint64_t t0;
+    sg_tst::bench_rec rec;
+
+    if (bench)
+        sg_tst::cur_rec = &rec;
 
     {
         lock_guard<mutex> lg(console_mutex);
@@ -785,6 +809,7 @@ work_thread(const char * dev_name, unsigned int lba, int id, int block,
              << block << endl;
     }
     for (k = 0; k < num; ++k) {
+        t0 = sg_tst::now_ns();
 	if (sg_ifc_ver == 3)
             res = do_rd_inc_wr_twice_v3(dev_name, lba, block, excl, wait_ms,
 					k, thr_ebusy_count, thr_eagain_count);
@@ -799,9 +824,14 @@ work_thread(const char * dev_name, unsigned int lba, int id, int block,
 	}
         if (res < 0)
             break;
+        sg_tst::loop_done(t0);
         if (res)
             ++thr_odd_count;
     }
+    if (bench) {
+        brun.merge(rec);
+        sg_tst::cur_rec = nullptr;
+    }
     {
         lock_guard<mutex> lg(console_mutex);
 
@@ -832,12 +862,15 @@ main(int argc, char * argv[])
     int num_threads = DEF_NUM_THREADS;
     int wait_ms = DEF_WAIT_MS;
     int no_o_excl = 0;
+    bool bench = false;
     char * dev_name = NULL;
     char b[64];
 
     for (k = 1; k < argc; ++k) {
         if (0 == memcmp("-b", argv[k], 2))
             ++block;
+        else if (0 == memcmp("-B", argv[k], 2))
+            bench = true;
         else if (0 == memcmp("-f", argv[k], 2))
             ++force;
         else if (0 == memcmp("-h", argv[k], 2)) {
@@ -933,6 +966,15 @@ main(int argc, char * argv[])
             }
         }
 
+        if (bench) {
+            /* uncontended baseline: a few loops in this thread alone */
+            work_thread(dev_name, lba, -1, block, (no_o_excl > 1) ? 0 : 1,
+                        (num_per_thread < BENCH_BASE_LOOPS) ? num_per_thread :
+                        BENCH_BASE_LOOPS, wait_ms, true);
+            brun.take_baseline();
+            brun.start();
+        }
+
         vector<thread *> vt;
 
         for (k = 0; k < num_threads; ++k) {
@@ -944,13 +986,15 @@ main(int argc, char * argv[])
                 excl = 0;
 
             thread * tp = new thread {work_thread, dev_name, lba, k, block,
-                                      excl, num_per_thread, wait_ms};
+                                      excl, num_per_thread, wait_ms, bench};
             vt.push_back(tp);
         }
 
         // g++ 4.7.3 didn't like range-for loop here
         for (k = 0; k < (int)vt.size(); ++k)
             vt[k]->join();
+        if (bench)
+            brun.stop();
 
         for (k = 0; k < (int)vt.size(); ++k)
             delete vt[k];
@@ -961,6 +1005,8 @@ main(int argc, char * argv[])
             cout << "Expecting odd count of 0, got " << odd_count << endl;
         cout << "Number of EBUSYs: " << ebusy_count << endl;
         cout << "Number of EAGAINs: " << eagain_count << endl;
+        if (bench)
+            brun.report(num_threads);
 
     }
     catch(system_error& e)  {
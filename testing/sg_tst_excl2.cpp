@@ -46,8 +46,9 @@
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_unaligned.h"
+#include "sg_tst_bench.hpp"
 
-static const char * version_str = "1.09 20190321";
+static const char * version_str = "1.10 20261014";
 static const char * util_name = "sg_tst_excl2";
 
 /* This is a test program for checking O_EXCL on open() works. It uses
@@ -93,6 +94,7 @@ using namespace std::chrono;
 #define DEF_WAIT_MS 0          /* 0: yield; -1: don't wait; -2: sleep(0) */
 
 #define DEF_LBA 1000
+#define BENCH_BASE_LOOPS 50     /* for the uncontended baseline with -B */
 
 #define EBUFF_SZ 256
 
@@ -101,17 +103,22 @@ static mutex odd_count_mutex;
 static mutex console_mutex;
 static unsigned int odd_count;
 static unsigned int ebusy_count;
+static sg_tst::bench_run brun;
 
 
 static void
 usage(void)
 {
-    printf("Usage: %s [-b] [-f] [-h] [-l <lba>] [-n <n_per_thr>] "
+    printf("Usage: %s [-b] [-B] [-f] [-h] [-l <lba>] [-n <n_per_thr>] "
            "[-t <num_thrs>]\n"
            "                    [-V] [-w <wait_ms>] [-x] "
            "<disk_device>\n", util_name);
     printf("  where\n");
     printf("    -b                block on open (def: O_NONBLOCK)\n");
+    printf("    -B                benchmark: report open/close and command "
+           "rates, and\n"
+           "                      loop latency against an uncontended "
+           "baseline\n");
     printf("    -f                force: any SCSI disk (def: only "
            "scsi_debug)\n");
     printf("                      WARNING: <lba> written to\n");
@@ -200,6 +207,7 @@ do_rd_inc_wr_twice(const char * dev_name, unsigned int lba, int block,
     int k, sg_fd, res, cat;
     int odd = 0;
     unsigned int u = 0;
+    uint64_t t0;
     struct sg_pt_base * ptp = NULL;
     unsigned char r16CmdBlk [READ16_CMD_LEN] =
                 {0x88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0};
@@ -217,6 +225,7 @@ do_rd_inc_wr_twice(const char * dev_name, unsigned int lba, int block,
     if (excl)
         open_flags |= O_EXCL;
 
+    t0 = sg_tst::now_ns();
     while (((sg_fd = scsi_pt_open_flags(dev_name, open_flags, 0)) < 0) &&
            (-EBUSY == sg_fd)) {
         ++ebusys;
@@ -237,6 +246,7 @@ do_rd_inc_wr_twice(const char * dev_name, unsigned int lba, int block,
         }
         return -1;
     }
+    sg_tst::open_done(t0);
 
     ptp = construct_scsi_pt_obj();
     for (k = 0; k < 2; ++k) {
@@ -246,6 +256,7 @@ do_rd_inc_wr_twice(const char * dev_name, unsigned int lba, int block,
         set_scsi_pt_sense(ptp, sense_buffer, sizeof(sense_buffer));
         set_scsi_pt_data_in(ptp, lb, READ16_REPLY_LEN);
         res = do_scsi_pt(ptp, sg_fd, 20 /* secs timeout */, 1);
+        sg_tst::add_cmds(1);
         if (res) {
             {
                 lock_guard<mutex> lg(console_mutex);
@@ -286,6 +297,7 @@ do_rd_inc_wr_twice(const char * dev_name, unsigned int lba, int block,
         set_scsi_pt_sense(ptp, sense_buffer, sizeof(sense_buffer));
         set_scsi_pt_data_out(ptp, lb, WRITE16_REPLY_LEN);
         res = do_scsi_pt(ptp, sg_fd, 20 /* secs timeout */, 1);
+        sg_tst::add_cmds(1);
         if (res) {
             {
                 lock_guard<mutex> lg(console_mutex);
@@ -309,7 +321,9 @@ do_rd_inc_wr_twice(const char * dev_name, unsigned int lba, int block,
 err:
     if (ptp)
         destruct_scsi_pt_obj(ptp);
+    t0 = sg_tst::now_ns();
     scsi_pt_close_device(sg_fd);
+    sg_tst::close_done(t0);
     return odd;
 }
 
@@ -398,11 +412,13 @@ err:
 
 static void
 work_thread(const char * dev_name, unsigned int lba, int id, int block,
-            int excl, int num, int wait_ms)
+            int excl, int num, int wait_ms, bool bench)
 {
     unsigned int thr_odd_count = 0;
     unsigned int thr_ebusy_count = 0;
     int k, res;
+    uint64_t t0;
+    sg_tst::bench_rec rec;
 
     {
         lock_guard<mutex> lg(console_mutex);
@@ -410,14 +426,22 @@ work_thread(const char * dev_name, unsigned int lba, int id, int block,
         cerr << "Enter work_thread id=" << id << " excl=" << excl << " block="
              << block << endl;
     }
+    if (bench)
+        sg_tst::cur_rec = &rec;
     for (k = 0; k < num; ++k) {
+        t0 = sg_tst::now_ns();
         res = do_rd_inc_wr_twice(dev_name, lba, block, excl, wait_ms,
                                  thr_ebusy_count);
         if (res < 0)
             break;
+        sg_tst::loop_done(t0);
         if (res)
             ++thr_odd_count;
     }
+    if (bench) {
+        brun.merge(rec);
+        sg_tst::cur_rec = nullptr;
+    }
     {
         lock_guard<mutex> lg(console_mutex);
 
@@ -448,12 +472,15 @@ main(int argc, char * argv[])
     int num_threads = DEF_NUM_THREADS;
     int wait_ms = DEF_WAIT_MS;
     int exclude_o_excl = 0;
+    bool bench = false;
     char * dev_name = NULL;
     char b[64];
 
     for (k = 1; k < argc; ++k) {
         if (0 == memcmp("-b", argv[k], 2))
             ++block;
+        else if (0 == memcmp("-B", argv[k], 2))
+            bench = true;
         else if (0 == memcmp("-f", argv[k], 2))
             ++force;
         else if (0 == memcmp("-h", argv[k], 2)) {
@@ -527,24 +554,37 @@ main(int argc, char * argv[])
             }
         }
 
+        if (bench) {
+            /* uncontended baseline: a few loops in this thread alone */
+            work_thread(dev_name, lba, -1, block, 1,
+                        (num_per_thread < BENCH_BASE_LOOPS) ? num_per_thread :
+                        BENCH_BASE_LOOPS, wait_ms, true);
+            brun.take_baseline();
+            brun.start();
+        }
+
         vector<thread *> vt;
 
         for (k = 0; k < num_threads; ++k) {
             int excl = ((0 == k) && exclude_o_excl) ? 0 : 1;
 
             thread * tp = new thread {work_thread, dev_name, lba, k, block,
-                                      excl, num_per_thread, wait_ms};
+                                      excl, num_per_thread, wait_ms, bench};
             vt.push_back(tp);
         }
 
         for (k = 0; k < (int)vt.size(); ++k)
             vt[k]->join();
+        if (bench)
+            brun.stop();
 
         for (k = 0; k < (int)vt.size(); ++k)
             delete vt[k];
 
         cout << "Expecting odd count of 0, got " << odd_count << endl;
         cout << "Number of EBUSYs: " << ebusy_count << endl;
+        if (bench)
+            brun.report(num_threads);
 
     }
     catch(system_error& e)  {
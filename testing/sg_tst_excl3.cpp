@@ -47,8 +47,9 @@
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_unaligned.h"
+#include "sg_tst_bench.hpp"
 
-static const char * version_str = "1.07 20190321";
+static const char * version_str = "1.08 20261014";
 static const char * util_name = "sg_tst_excl3";
 
 /* This is a test program for checking O_EXCL on open() works. It uses
@@ -96,6 +97,7 @@ using namespace std::chrono;
 #define DEF_WAIT_MS 0          /* 0: yield; -1: don't wait; -2: sleep(0) */
 
 #define DEF_LBA 1000
+#define BENCH_BASE_LOOPS 50     /* for the uncontended baseline with -B */
 
 #define EBUFF_SZ 256
 
@@ -104,17 +106,22 @@ static mutex odd_count_mutex;
 static mutex console_mutex;
 static unsigned int odd_count;
 static unsigned int ebusy_count;
+static sg_tst::bench_run brun;
 
 
 static void
 usage(void)
 {
-    printf("Usage: %s [-b] [-f] [-h] [-l <lba>] [-n <n_per_thr>]\n"
+    printf("Usage: %s [-b] [-B] [-f] [-h] [-l <lba>] [-n <n_per_thr>]\n"
            "                    [-R] [-t <num_thrs>] [-V] [-w <wait_ms>] "
            "[-x]\n"
            "                    <disk_device>\n", util_name);
     printf("  where\n");
     printf("    -b                block on open (def: O_NONBLOCK)\n");
+    printf("    -B                benchmark: report open/close and command "
+           "rates, and\n"
+           "                      loop latency against an uncontended "
+           "baseline\n");
     printf("    -f                force: any SCSI disk (def: only "
            "scsi_debug)\n");
     printf("                      WARNING: <lba> written to\n");
@@ -207,6 +214,7 @@ do_rd_inc_wr_twice(const char * dev_name, int read_only, unsigned int lba,
     int k, sg_fd, res, cat;
     int odd = 0;
     unsigned int u = 0;
+    uint64_t t0;
     struct sg_pt_base * ptp = NULL;
     unsigned char r16CmdBlk [READ16_CMD_LEN] =
                 {0x88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0};
@@ -224,6 +232,7 @@ do_rd_inc_wr_twice(const char * dev_name, int read_only, unsigned int lba,
     if (excl)
         open_flags |= O_EXCL;
 
+    t0 = sg_tst::now_ns();
     while (((sg_fd = scsi_pt_open_flags(dev_name, open_flags, 0)) < 0) &&
            (-EBUSY == sg_fd)) {
         ++ebusys;
@@ -244,6 +253,7 @@ do_rd_inc_wr_twice(const char * dev_name, int read_only, unsigned int lba,
         }
         return -1;
     }
+    sg_tst::open_done(t0);
 
     ptp = construct_scsi_pt_obj();
     for (k = 0; k < 2; ++k) {
@@ -253,6 +263,7 @@ do_rd_inc_wr_twice(const char * dev_name, int read_only, unsigned int lba,
         set_scsi_pt_sense(ptp, sense_buffer, sizeof(sense_buffer));
         set_scsi_pt_data_in(ptp, lb, READ16_REPLY_LEN);
         res = do_scsi_pt(ptp, sg_fd, 20 /* secs timeout */, 1);
+        sg_tst::add_cmds(1);
         if (res) {
             {
                 lock_guard<mutex> lg(console_mutex);
@@ -296,6 +307,7 @@ do_rd_inc_wr_twice(const char * dev_name, int read_only, unsigned int lba,
         set_scsi_pt_sense(ptp, sense_buffer, sizeof(sense_buffer));
         set_scsi_pt_data_out(ptp, lb, WRITE16_REPLY_LEN);
         res = do_scsi_pt(ptp, sg_fd, 20 /* secs timeout */, 1);
+        sg_tst::add_cmds(1);
         if (res) {
             {
                 lock_guard<mutex> lg(console_mutex);
@@ -319,7 +331,9 @@ do_rd_inc_wr_twice(const char * dev_name, int read_only, unsigned int lba,
 err:
     if (ptp)
         destruct_scsi_pt_obj(ptp);
+    t0 = sg_tst::now_ns();
     scsi_pt_close_device(sg_fd);
+    sg_tst::close_done(t0);
     return odd;
 }
 
@@ -399,11 +413,13 @@ err:
 
 static void
 work_thread(const char * dev_name, unsigned int lba, int id, int block,
-            int excl, bool all_readers, int num, int wait_ms)
+            int excl, bool all_readers, int num, int wait_ms, bool bench)
 {
     unsigned int thr_odd_count = 0;
     unsigned int thr_ebusy_count = 0;
     int k, res;
+    uint64_t t0;
+    sg_tst::bench_rec rec;
     int reader = ((id > 0) || (all_readers));
 
     {
@@ -412,14 +428,22 @@ work_thread(const char * dev_name, unsigned int lba, int id, int block,
         cerr << "Enter work_thread id=" << id << " excl=" << excl << " block="
              << block << " reader=" << reader << endl;
     }
+    if (bench)
+        sg_tst::cur_rec = &rec;
     for (k = 0; k < num; ++k) {
+        t0 = sg_tst::now_ns();
         res = do_rd_inc_wr_twice(dev_name, reader, lba, block, excl,
                                  wait_ms, thr_ebusy_count);
         if (res < 0)
             break;
+        sg_tst::loop_done(t0);
         if (res)
             ++thr_odd_count;
     }
+    if (bench) {
+        brun.merge(rec);
+        sg_tst::cur_rec = nullptr;
+    }
     {
         lock_guard<mutex> lg(console_mutex);
 
@@ -451,12 +475,15 @@ main(int argc, char * argv[])
     int num_threads = DEF_NUM_THREADS;
     int wait_ms = DEF_WAIT_MS;
     int exclude_o_excl = 0;
+    bool bench = false;
     char * dev_name = NULL;
     char b[64];
 
     for (k = 1; k < argc; ++k) {
         if (0 == memcmp("-b", argv[k], 2))
             ++block;
+        else if (0 == memcmp("-B", argv[k], 2))
+            bench = true;
         else if (0 == memcmp("-f", argv[k], 2))
             ++force;
         else if (0 == memcmp("-h", argv[k], 2)) {
@@ -532,6 +559,15 @@ main(int argc, char * argv[])
             }
         }
 
+        if (bench) {
+            /* uncontended baseline: a few loops in this thread alone */
+            work_thread(dev_name, lba, 0, block, 1, all_readers,
+                        (num_per_thread < BENCH_BASE_LOOPS) ? num_per_thread :
+                        BENCH_BASE_LOOPS, wait_ms, true);
+            brun.take_baseline();
+            brun.start();
+        }
+
         vector<thread *> vt;
 
         for (k = 0; k < num_threads; ++k) {
@@ -539,18 +575,22 @@ main(int argc, char * argv[])
 
             thread * tp = new thread {work_thread, dev_name, lba, k, block,
                                       excl, all_readers, num_per_thread,
-                                      wait_ms};
+                                      wait_ms, bench};
             vt.push_back(tp);
         }
 
         for (k = 0; k < (int)vt.size(); ++k)
             vt[k]->join();
+        if (bench)
+            brun.stop();
 
         for (k = 0; k < (int)vt.size(); ++k)
             delete vt[k];
 
         cout << "Expecting odd count of 0, got " << odd_count << endl;
         cout << "Number of EBUSYs: " << ebusy_count << endl;
+        if (bench)
+            brun.report(num_threads);
 
     }
     catch(system_error& e)  {
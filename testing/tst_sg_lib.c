@@ -44,7 +44,7 @@
  * related to snprintf().
  */
 
-static const char * version_str = "1.13 20190108";
+static const char * version_str = "1.14 20261014";
 
 
 #define MAX_LINE_LEN 1024
@@ -53,8 +53,10 @@ static const char * version_str = "1.13 20190108";
 static struct option long_options[] = {
         {"byteswap",  required_argument, 0, 'b'},
         {"exit", no_argument, 0, 'e'},
+        {"f2hex", no_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
         {"hex2",  no_argument, 0, 'H'},
+        {"lba-set",  no_argument, 0, 'L'},
         {"leadin",  required_argument, 0, 'l'},
         {"num",  required_argument, 0, 'n'},
         {"printf", no_argument, 0, 'p'},
@@ -158,8 +160,9 @@ static void
 usage()
 {
     fprintf(stderr,
-            "Usage: tst_sg_lib [--exit] [--help] [--hex2] [--leadin=STR] "
-            "[--printf]\n"
+            "Usage: tst_sg_lib [--exit] [--f2hex] [--help] [--hex2] "
+            "[--lba-set]\n"
+            "                  [--leadin=STR] [--printf]\n"
             "                  [--sense] [--unaligned] [--verbose] "
             "[--version]\n"
             "  where:\n"
@@ -172,8 +175,12 @@ usage()
 #else
             "    --exit|-e          test exit status strings\n"
 #endif
+            "    --f2hex|-f         test sg_f2hex_arr() and sg_f2hex_next() "
+            "agree\n"
             "    --help|-h          print out usage message\n"
             "    --hex2|-H          test hex2* variants\n"
+            "    --lba-set|-L       test sg_lba_set_read_file() with long "
+            "lines\n"
             "    --leadin=STR|-l STR    every line output by --sense "
             "should\n"
             "                           be prefixed by STR\n"
@@ -189,6 +196,252 @@ usage()
 
 }
 
+/* Writes contents to a new temporary file whose name is placed in fn
+ * (which should start as "/tmp/tst_sg_lib_XXXXXX"). Returns 0 if ok. */
+static int
+tmp_file_from_str(const char * contents, char * fn)
+{
+    int fd;
+    FILE * fp;
+
+    fd = mkstemp(fn);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    fp = fdopen(fd, "w");
+    if (NULL == fp) {
+        perror("fdopen");
+        close(fd);
+        unlink(fn);
+        return -1;
+    }
+    fputs(contents, fp);
+    fclose(fp);
+    return 0;
+}
+
+/* Writes contents to a temporary file, then reads it back with
+ * sg_lba_set_read_file(). Returns what that returned. */
+static int
+lba_set_from_str(struct sg_lba_set * lsp, const char * contents, int flags)
+{
+    int res;
+    char fn[] = "/tmp/tst_sg_lib_XXXXXX";
+
+    if (tmp_file_from_str(contents, fn))
+        return -1;
+    res = sg_lba_set_read_file(lsp, fn, flags);
+    unlink(fn);
+    return res;
+}
+
+/* Lines longer than any internal buffer must not split numbers. Returns
+ * the number of failed checks. */
+static int
+test_lba_set(int vb)
+{
+    int k, res;
+    int fails = 0;
+    size_t n;
+    char * cp;
+    const int num_pairs = 210;
+    const int num_lbas = 500;
+    const size_t sz = 16384;
+    struct sg_lba_set a_set;
+
+    cp = (char *)malloc(sz);
+    if (NULL == cp)
+        return 1;
+    sg_lba_set_init(&a_set);
+
+    /* PAIRS mode: one line of 210 identical LBA,NUM pairs (about 2 KB) */
+    for (k = 0, n = 0; k < num_pairs; ++k)
+        n += snprintf(cp + n, sz - n, "1234567,5 ");
+    snprintf(cp + n, sz - n, "\n");
+    res = lba_set_from_str(&a_set, cp, SG_LBA_SET_PAIRS);
+    if (res || (num_pairs != a_set.num)) {
+        printf("  PAIRS long line: res=%d, %d extents (expect %d)\n", res,
+               a_set.num, num_pairs);
+        ++fails;
+    } else {
+        for (k = 0; k < a_set.num; ++k) {
+            if ((1234567 != a_set.ext[k].lba) || (5 != a_set.ext[k].num)) {
+                printf("  PAIRS long line: extent %d is %" PRIu64 ",%"
+                       PRIu64 "\n", k, a_set.ext[k].lba, a_set.ext[k].num);
+                ++fails;
+                break;
+            }
+        }
+    }
+    sg_lba_set_free(&a_set);
+
+    /* LBAS mode: one line of 500 distinct LBAs (about 4 KB) */
+    for (k = 0, n = 0; k < num_lbas; ++k)
+        n += snprintf(cp + n, sz - n, "%d,", 1000000 + (2 * k));
+    res = lba_set_from_str(&a_set, cp, SG_LBA_SET_LBAS);
+    if (res || (num_lbas != a_set.num)) {
+        printf("  LBAS long line: res=%d, %d extents (expect %d)\n", res,
+               a_set.num, num_lbas);
+        ++fails;
+    } else {
+        for (k = 0; k < a_set.num; ++k) {
+            if (((uint64_t)(1000000 + (2 * k)) != a_set.ext[k].lba) ||
+                (1 != a_set.ext[k].num)) {
+                printf("  LBAS long line: extent %d is %" PRIu64 ",%"
+                       PRIu64 "\n", k, a_set.ext[k].lba, a_set.ext[k].num);
+                ++fails;
+                break;
+            }
+        }
+    }
+    sg_lba_set_free(&a_set);
+
+    /* default mode: LBA,NUM then 3000 bytes of comment, then an LBA */
+    n = snprintf(cp, sz, "0x100,8 ");
+    memset(cp + n, 'x', 3000);
+    n += 3000;
+    snprintf(cp + n, sz - n, "\n77\n");
+    res = lba_set_from_str(&a_set, cp, 0);
+    if (res || (2 != a_set.num) || (0x100 != a_set.ext[0].lba) ||
+        (8 != a_set.ext[0].num) || (77 != a_set.ext[1].lba) ||
+        (1 != a_set.ext[1].num)) {
+        printf("  default long line: res=%d, %d extents (expect 2)\n", res,
+               a_set.num);
+        ++fails;
+    }
+    sg_lba_set_free(&a_set);
+    free(cp);
+    if (vb || fails)
+        printf("sg_lba_set_read_file() long line tests: %d failed\n",
+               fails);
+    return fails;
+}
+
+struct f2hex_case {
+    const char * in;
+    bool no_space;
+    int exp_len;        /* -1 for a syntax error */
+    const char * exp;   /* expected bytes */
+};
+
+static const struct f2hex_case f2hex_cases[] = {
+    {"12 34,56\n", false, 3, "\x12\x34\x56"},
+    {"1\t2\r\n", false, 2, "\x01\x02"},
+    {",12", false, 1, "\x12"},
+    {" ,", false, 0, ""},
+    {"12\n,", false, 1, "\x12"},
+    {"12,,34", false, 2, "\x12\x34"},
+    {"a# c\n", false, 1, "\x0a"},
+    {"ab cd # 99 ee\nef", false, 3, "\xab\xcd\xef"},
+    {"# all comment\n\n", false, 0, ""},
+    {"012 00ff", false, 2, "\x12\xff"},
+    {"0x12", false, -1, ""},
+    {"123", false, -1, ""},
+    {"1g", false, -1, ""},
+    {"0102 03\n04", true, 4, "\x01\x02\x03\x04"},
+    {"a1b2#c3\nd4", true, 3, "\xa1\xb2\xd4"},
+    {"010", true, -1, ""},
+};
+
+/* Decodes the file fn with sg_f2hex_next(), taking 'chunk' bytes per call,
+ * into bp. Returns the number of bytes decoded or -1 on error. */
+static int
+f2hex_strm_all(const char * fn, bool no_space, int chunk, uint8_t * bp,
+               int max_len)
+{
+    int n, res;
+    int off = 0;
+    struct sg_f2hex_strm * fhp;
+
+    fhp = sg_f2hex_open(fn, false, no_space, &res);
+    if (NULL == fhp)
+        return -1;
+    do {
+        if ((off + chunk) > max_len)
+            chunk = max_len - off;
+        if (chunk <= 0)
+            break;
+        res = sg_f2hex_next(fhp, bp + off, chunk, &n);
+        off += n;
+    } while ((0 == res) && (n > 0));
+    sg_f2hex_close(fhp);
+    return res ? -1 : off;
+}
+
+/* Both ASCII hex decoders must accept and reject the same input, giving
+ * the same bytes. Returns the number of failed checks. */
+static int
+test_f2hex(int vb)
+{
+    int k, j, len, n, res;
+    int fails = 0;
+    const int num = (int)(sizeof(f2hex_cases) / sizeof(f2hex_cases[0]));
+    const struct f2hex_case * cp;
+    char * lp;
+    uint8_t a_b[2048];
+    uint8_t s_b[2048];
+    char fn[] = "/tmp/tst_sg_lib_XXXXXX";
+
+    for (k = 0, cp = f2hex_cases; k < num; ++k, ++cp) {
+        strcpy(fn, "/tmp/tst_sg_lib_XXXXXX");
+        if (tmp_file_from_str(cp->in, fn))
+            return fails + 1;
+        res = sg_f2hex_arr(fn, false, cp->no_space, a_b, &len,
+                           sizeof(a_b));
+        if (res)
+            len = -1;
+        for (j = 1; j <= 3; j += 2) {
+            n = f2hex_strm_all(fn, cp->no_space, j, s_b, sizeof(s_b));
+            if ((len != cp->exp_len) || (n != cp->exp_len) ||
+                ((len > 0) && (memcmp(a_b, cp->exp, len) ||
+                               memcmp(s_b, cp->exp, len)))) {
+                printf("  case %d: sg_f2hex_arr() gave %d, sg_f2hex_next() "
+                       "[%d per call] gave %d, expected %d bytes\n", k + 1,
+                       len, j, n, cp->exp_len);
+                ++fails;
+                break;
+            }
+        }
+        if (vb > 1)
+            printf("  case %d: %d bytes\n", k + 1, len);
+        unlink(fn);
+    }
+
+    /* more than 512 lines (once sg_f2hex_arr()'s limit) then overflow */
+    lp = (char *)malloc(3 * 1000 + 1);
+    if (NULL == lp)
+        return fails + 1;
+    for (k = 0; k < 1000; ++k)
+        memcpy(lp + (3 * k), "5a\n", 3);
+    lp[3 * 1000] = '\0';
+    strcpy(fn, "/tmp/tst_sg_lib_XXXXXX");
+    if (tmp_file_from_str(lp, fn)) {
+        free(lp);
+        return fails + 1;
+    }
+    free(lp);
+    res = sg_f2hex_arr(fn, false, false, a_b, &len, sizeof(a_b));
+    n = f2hex_strm_all(fn, false, 7, s_b, sizeof(s_b));
+    if (res || (1000 != len) || (1000 != n) || (0x5a != a_b[999]) ||
+        (0x5a != s_b[999])) {
+        printf("  1000 lines: sg_f2hex_arr() res=%d len=%d, "
+               "sg_f2hex_next() gave %d\n", res, len, n);
+        ++fails;
+    }
+    res = sg_f2hex_arr(fn, false, false, a_b, &len, 999);
+    if ((SG_LIB_LBA_OUT_OF_RANGE != res) || (999 != len)) {
+        printf("  1000 lines into 999: sg_f2hex_arr() res=%d len=%d\n",
+               res, len);
+        ++fails;
+    }
+    unlink(fn);
+    if (vb || fails)
+        printf("sg_f2hex_arr() versus sg_f2hex_next() tests: %d failed\n",
+               fails);
+    return fails;
+}
+
 static char *
 get_exit_status_str(int exit_status, bool longer, int b_len, char * b)
 {
@@ -216,10 +469,12 @@ int
 main(int argc, char * argv[])
 {
     bool do_exit_status = false;
+    bool do_f2hex = false;
     bool ok;
     int k, c, n, len;
     int byteswap_sz = 0;
     int do_hex2 = 0;
+    int do_lba_set = 0;
     int do_num = 1;
     int do_printf = 0;
     int do_sense = 0;
@@ -234,7 +489,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:ehHl:n:psuvV", long_options,
+        c = getopt_long(argc, argv, "b:efhHl:Ln:psuvV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -251,6 +506,9 @@ main(int argc, char * argv[])
         case 'e':
             do_exit_status = true;
             break;
+        case 'f':
+            do_f2hex = true;
+            break;
         case 'h':
         case '?':
             usage();
@@ -261,6 +519,9 @@ main(int argc, char * argv[])
         case 'l':
             leadin = optarg;
             break;
+        case 'L':
+            ++do_lba_set;
+            break;
         case 'n':
             do_num = sg_get_num(optarg);
             if (do_num < 0) {
@@ -652,6 +913,25 @@ main(int argc, char * argv[])
     }
 #endif
 
+    if (do_lba_set) {
+        ++did_something;
+        printf("Test sg_lba_set_read_file() with lines over 1 KB:\n");
+        if (test_lba_set(vb))
+            ret = 1;
+        else
+            printf("  passed\n");
+    }
+
+    if (do_f2hex) {
+        ++did_something;
+        printf("Test sg_f2hex_arr() and sg_f2hex_next() give the same "
+               "results:\n");
+        if (test_f2hex(vb))
+            ret = 1;
+        else
+            printf("  passed\n");
+    }
+
     if (0 == did_something)
         printf("Looks like no tests done, check usage with '-h'\n");
     return ret;
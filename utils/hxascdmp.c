@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#define _XOPEN_SOURCE 600       /* for posix_memalign() and posix_fadvise() */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -24,11 +26,22 @@
 
 static int bytes_per_line = DEF_BYTES_PER_LINE;
 
-static const char * version_str = "1.11 20190527";
+static const char * version_str = "1.12 20261014";
 
 #define CHARS_PER_HEX_BYTE 3
 #define BINARY_START_COL 6
 #define MAX_LINE_LENGTH 257
+#define IN_BUFF_SZ (256 * 1024)     /* bytes in each read() */
+#define OUT_BUFF_SZ (256 * 1024)    /* lines collected for each write() */
+#define BUFF_ALIGN 4096
+
+/* Output lines are collected in out_buff and written to stdout with one
+ * write() each time it fills, rather than a printf() per line */
+static const char * hex_digs = "0123456789abcdef";
+
+static char * out_buff;
+static int out_len;
+static int out_err;     /* errno from first failed write(), then no more */
 
 
 #ifdef SG_LIB_MINGW
@@ -64,6 +77,54 @@ sg_set_binary_mode(int fd)
 }
 #endif
 
+static void *
+buff_alloc(size_t sz)
+{
+#if defined(SG_LIB_MINGW)
+    return malloc(sz);
+#else
+    void * p;
+
+    return (0 == posix_memalign(&p, BUFF_ALIGN, sz)) ? p : NULL;
+#endif
+}
+
+/* Writes what is in out_buff to stdout, continuing after short writes.
+ * Returns 0 if ok, else -1 (and out_err is set). */
+static int
+out_flush(void)
+{
+    int n;
+    const char * p = out_buff;
+
+    while ((out_len > 0) && (0 == out_err)) {
+        n = write(STDOUT_FILENO, p, out_len);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            out_err = errno;
+        } else {
+            p += n;
+            out_len -= n;
+        }
+    }
+    out_len = 0;
+    return out_err ? -1 : 0;
+}
+
+/* Appends s followed by a newline to out_buff, flushing it when full */
+static void
+out_line(const char * s)
+{
+    int n = strlen(s);
+
+    if ((out_len + n + 1) > OUT_BUFF_SZ)
+        out_flush();
+    memcpy(out_buff + out_len, s, n);
+    out_len += n;
+    out_buff[out_len++] = '\n';
+}
+
 /* Returns the number of times 'ch' is found in string 's' given the
  * string's length. */
 static int
@@ -239,7 +300,7 @@ dStrHex(const char* str, int len, long start, int noAddr)
     for(j = 0; j < len; j++) {
         nl = (0 == (j % bytes_per_line));
         if ((j > 0) && nl) {
-            printf("%s\n", buff);
+            out_line(buff);
             bpos = bpstart;
             cpos = cpstart;
             a += bytes_per_line;
@@ -253,14 +314,15 @@ dStrHex(const char* str, int len, long start, int noAddr)
         bpos += (nl && noAddr) ?  0 : CHARS_PER_HEX_BYTE;
         if ((bytes_per_line > 4) && ((j % bytes_per_line) == midline_space))
             bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
+        buff[bpos] = hex_digs[(c >> 4) & 0xf];
+        buff[bpos + 1] = hex_digs[c & 0xf];
         buff[bpos + 2] = ' ';
         if ((c < ' ') || (c >= 0x7f))
             c='.';
         buff[cpos++] = c;
     }
     if (cpos > cpstart)
-        printf("%s\n", buff);
+        out_line(buff);
 }
 
 static void
@@ -295,7 +357,7 @@ dStrHexOnly(const char* str, int len, long start, int noAddr)
     for(j = 0; j < len; j++) {
         nl = (0 == (j % bytes_per_line));
         if ((j > 0) && nl) {
-            printf("%s\n", buff);
+            out_line(buff);
             bpos = bpstart;
             a += bytes_per_line;
             memset(buff,' ', line_length);
@@ -308,11 +370,12 @@ dStrHexOnly(const char* str, int len, long start, int noAddr)
         bpos += (nl && noAddr) ? 0 : CHARS_PER_HEX_BYTE;
         if ((bytes_per_line > 4) && ((j % bytes_per_line) == midline_space))
             bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
+        buff[bpos] = hex_digs[(c >> 4) & 0xf];
+        buff[bpos + 1] = hex_digs[c & 0xf];
         buff[bpos + 2] = ' ';
     }
     if (bpos > bpstart)
-        printf("%s\n", buff);
+        out_line(buff);
 }
 
 static void
@@ -346,8 +409,8 @@ usage()
 int
 main(int argc, const char ** argv)
 {
-    char buff[8192];
-    int num = 8192;
+    char * buff;
+    int num = IN_BUFF_SZ;
     long start = 0;
     int64_t offset = 0;
     int res, k, u, len, n;
@@ -362,6 +425,7 @@ main(int argc, const char ** argv)
     int print2 = 0;
     int ret = 0;
     const char * cp;
+    char b[MAX_LINE_LENGTH + 32];
 
     for (k = 1; k < argc; k++) {
         cp = argv[k];
@@ -439,9 +503,17 @@ main(int argc, const char ** argv)
     /* Make sure num to fetch is integral multiple of bytes_per_line */
     if (0 != (num % bytes_per_line))
         num = (num / bytes_per_line) * bytes_per_line;
+    if (0 == num)
+        num = bytes_per_line;
+    buff = (char *)buff_alloc(num);
+    out_buff = (char *)buff_alloc(OUT_BUFF_SZ);
+    if ((NULL == buff) || (NULL == out_buff)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
 
     if (hasFilename) {
-        for ( ; k < argc; k++)
+        for ( ; (k < argc) && (0 == out_err); k++)
         {
             inFile = open(argv[k], O_RDONLY);
             if (inFile < 0) {
@@ -449,6 +521,9 @@ main(int argc, const char ** argv)
                 ret = 1;
             } else {
                 sg_set_binary_mode(inFile);
+#if defined(POSIX_FADV_SEQUENTIAL) && (! defined(SG_LIB_MINGW))
+                posix_fadvise(inFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
                 if (offset > 0) {
                     int err;
                     int64_t off_res;
@@ -464,24 +539,25 @@ main(int argc, const char ** argv)
                     start = offset;
                 } else
                     start = 0;
-                if (! (doHex || quiet || print1))
-                    printf("ASCII hex dump of file: %s\n", argv[k]);
-                while ((res = read(inFile, buff, num)) > 0) {
+                if (! (doHex || quiet || print1)) {
+                    snprintf(b, sizeof(b), "ASCII hex dump of file: %s",
+                             argv[k]);
+                    out_line(b);
+                }
+                while ((0 == out_err) &&
+                       ((res = read(inFile, buff, num)) > 0)) {
                     if (print1) {
-                        if (1 == print1) {
-                            if (doHex)
-                                printf("0x%02x\n", (uint8_t)(buff[0]));
-                            else
-                                printf("%02x\n", (uint8_t)(buff[0]));
-                        } else {
+                        if (1 == print1)
+                            snprintf(b, sizeof(b), doHex ? "0x%02x" :
+                                     "%02x", (uint8_t)(buff[0]));
+                        else {
                             uint16_t us;
 
                             memcpy(&us, buff, 2);
-                            if (doHex)
-                                printf("0x%04x\n", us);
-                            else
-                                printf("%04x\n", us);
+                            snprintf(b, sizeof(b), doHex ? "0x%04x" :
+                                     "%04x", us);
                         }
+                        out_line(b);
                         break;
                     }
                     if (doHex)
@@ -509,7 +585,7 @@ fini1:
                 }
             } while (offset > 0);
         }
-        while ((res = read(inFile, buff, num)) > 0) {
+        while ((0 == out_err) && ((res = read(inFile, buff, num)) > 0)) {
             if (doHex)
                 dStrHexOnly(buff, res, start, noAddr);
             else
@@ -517,5 +593,12 @@ fini1:
             start += (long)res;
         }
     }
+    if (out_flush() < 0) {
+        if (EPIPE != out_err)
+            fprintf(stderr, "write to stdout: %s\n", strerror(out_err));
+        ret = 1;
+    }
+    free(out_buff);
+    free(buff);
     return ret;
 }